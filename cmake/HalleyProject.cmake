@@ -46,7 +46,11 @@ endif()
 
 # Compiler-specific flags
 if (MSVC)
-	set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} /MP /fp:fast /WX")
+	if (HALLEY_DETERMINISTIC_FLOAT)
+		set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} /MP /fp:precise /WX")
+	else()
+		set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} /MP /fp:fast /WX")
+	endif()
 	if (MSVC_VERSION GREATER_EQUAL 1910)
 		set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} /std:c++14 /permissive-")
 	endif ()
@@ -81,6 +85,11 @@ else()
 	endif()
 	set(CMAKE_CXX_FLAGS_DEBUG "${CMAKE_CXX_FLAGS_DEBUG} -D_DEBUG")
 
+	if (HALLEY_DETERMINISTIC_FLOAT)
+		# No fused multiply-adds, which would round differently depending on the target
+		set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -ffp-contract=off -fno-fast-math")
+	endif()
+
 	if (HALLEY_ENABLE_STATIC_STDLIB)
 		if ("${CMAKE_CXX_COMPILER_ID}" STREQUAL "GNU") 
 			set(CMAKE_C_FLAGS "${CMAKE_C_FLAGS} -static-libgcc")
@@ -104,6 +113,15 @@ set(USE_SDL2 1)
 set(USE_ASIO 1)
 set(USE_WINRT 0)
 set(USE_MEDIA_FOUNDATION 0)
+if (NOT DEFINED USE_FREETYPE)
+	set(USE_FREETYPE 0)
+endif ()
+if (NOT DEFINED USE_LUAJIT)
+	set(USE_LUAJIT 0)
+endif ()
+if (NOT DEFINED USE_LODEPNG_DECODER)
+	set(USE_LODEPNG_DECODER 0)
+endif ()
 
 if (EMSCRIPTEN)
 	set(USE_SDL2 0)
@@ -183,6 +201,31 @@ if (USE_MEDIA_FOUNDATION)
 	add_definitions(-DWITH_MEDIA_FOUNDATION)
 endif()
 
+# FreeType (runtime glyph rasterisation)
+if (USE_FREETYPE)
+	add_definitions(-DWITH_FREETYPE)
+	find_Package(Freetype REQUIRED)
+else ()
+	set(FREETYPE_INCLUDE_DIRS "")
+	set(FREETYPE_LIBRARIES "")
+endif ()
+
+# PNG decoding (built-in fast path for 8-bit images, or lodepng for everything)
+if (USE_LODEPNG_DECODER)
+	add_definitions(-DWITH_LODEPNG_DECODER)
+endif ()
+
+# Lua VM (bundled Lua 5.3, or LuaJIT)
+if (USE_LUAJIT)
+	add_definitions(-DWITH_LUAJIT)
+	find_path(LUAJIT_INCLUDE_DIR luajit.h PATH_SUFFIXES luajit-2.1 luajit-2.0)
+	find_library(LUAJIT_LIBRARIES NAMES luajit-5.1 luajit)
+	set(LUA_INCLUDE_DIRS ${LUAJIT_INCLUDE_DIR})
+else ()
+	set(LUA_INCLUDE_DIRS "${HALLEY_PATH}/src/contrib/lua/src")
+	set(LUAJIT_LIBRARIES "")
+endif ()
+
 
 # Apple frameworks
 if (APPLE)
@@ -226,6 +269,8 @@ set(HALLEY_PROJECT_EXTERNAL_LIBS
 	${SDL2_LIBRARIES}
 	${OPENGL_LIBRARIES}
 	${X11_LIBRARIES}
+	${FREETYPE_LIBRARIES}
+	${LUAJIT_LIBRARIES}
 	${EXTRA_LIBS}
 	)
 
@@ -296,6 +341,28 @@ set(HALLEY_PROJECT_LIBS
 endif ()
 
 
+# Dedicated servers get no video, audio or input backends (see halleyProjectServer)
+set(HALLEY_PROJECT_SERVER_LIBS
+	optimized halley-core
+	optimized halley-entity
+	optimized halley-audio
+	optimized halley-net
+	optimized halley-utils
+	debug halley-core_d
+	debug halley-entity_d
+	debug halley-audio_d
+	debug halley-net_d
+	debug halley-utils_d
+	${EXTRA_LIBS}
+	)
+
+if (USE_ASIO)
+set(HALLEY_PROJECT_SERVER_LIBS
+	optimized halley-asio
+	debug halley-asio_d
+	${HALLEY_PROJECT_SERVER_LIBS}
+	)
+endif ()
 
 set(HALLEY_PROJECT_INCLUDE_DIRS
 	${HALLEY_PATH}/include
@@ -405,6 +472,50 @@ function(halleyProject name sources headers genDefinitions targetDir)
 	endif ()
 endfunction(halleyProject)
 
+# Headless dedicated server build of a project, as a console executable called ${name}-server. It's compiled with HALLEY_DEDICATED_SERVER
+# defined, for the game to return from Game::isDedicatedServer() and to skip registering any plugins other than networking.
+# Call after halleyProject(), from the same directory, as it shares its generated sources.
+function(halleyProjectServer name sources headers genDefinitions targetDir)
+	set(CMAKE_RUNTIME_OUTPUT_DIRECTORY ${targetDir})
+	set(CMAKE_RUNTIME_OUTPUT_DIRECTORY_RELEASE ${targetDir})
+	set(CMAKE_RUNTIME_OUTPUT_DIRECTORY_DEBUG ${targetDir})
+	set(CMAKE_RUNTIME_OUTPUT_DIRECTORY_RELWITHDEBINFO ${targetDir})
+
+	file (GLOB_RECURSE ${name}_sources_gen "gen/*.cpp")
+	file (GLOB_RECURSE ${name}_sources_systems "src/systems/*.cpp")
+	file (GLOB_RECURSE ${name}_headers_gen "gen/*.h")
+
+	set(proj_sources ${sources} ${${name}_sources_gen} ${${name}_sources_systems})
+	set(proj_headers ${headers} ${${name}_headers_gen} ${genDefinitions})
+
+	include_directories("." "gen/cpp" ${HALLEY_PROJECT_INCLUDE_DIRS})
+	link_directories(${HALLEY_PROJECT_LIB_DIRS})
+
+	add_executable(${name}-server ${proj_sources} ${proj_headers})
+	target_compile_definitions(${name}-server PRIVATE HALLEY_EXECUTABLE HALLEY_DEDICATED_SERVER)
+	if (MSVC)
+		# A console program, so it can run as a service and log to stdout
+		set_target_properties(${name}-server PROPERTIES LINK_FLAGS "/SUBSYSTEM:CONSOLE /ENTRY:WinMainCRTStartup")
+	endif ()
+
+	if (TARGET ${name}-codegen)
+		add_dependencies(${name}-server ${name}-codegen)
+	endif ()
+
+	if (TARGET halley-core)
+		target_link_libraries(${name}-server halley-core halley-entity halley-audio halley-net halley-utils ${EXTRA_LIBS})
+		if (USE_ASIO)
+			target_link_libraries(${name}-server halley-asio)
+		endif ()
+	else ()
+		target_link_libraries(${name}-server ${HALLEY_PROJECT_SERVER_LIBS})
+	endif ()
+
+	if (NOT ${CMAKE_SYSTEM_NAME} MATCHES "WindowsStore")
+		set_target_properties(${name}-server PROPERTIES DEBUG_POSTFIX ${CMAKE_DEBUG_POSTFIX})
+	endif ()
+endfunction(halleyProjectServer)
+
 function(halleyProjectCodegen name sources headers genDefinitions targetDir)
 	add_custom_target(${name}-codegen ALL ${HALLEY_PATH}/bin/halley-cmd import ${targetDir}/.. ${HALLEY_PATH} WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR} DEPENDS ${genDefinitions})
 	halleyProject(${name} "${sources}" "${headers}" "${genDefinitions}" "${targetDir}")
@@ -0,0 +1,31 @@
+uniform sampler2D tex0;
+uniform sampler2D tex1;
+
+in vec4 v_colour;
+in vec2 v_offset;
+in vec2 v_screenPos;
+in vec3 v_params;
+
+out vec4 outCol;
+
+void main() {
+	// Blended with Add, which multiplies by alpha, so this un-premultiplies the albedo to keep the output premultiplied
+	vec4 albedo = texture(tex0, v_screenPos);
+	vec3 colour = albedo.a > 0.0 ? albedo.rgb / albedo.a : vec3(0.0, 0.0, 0.0);
+
+	if (v_params.z > 0.5) {
+		// Ambient
+		outCol = vec4(colour * v_colour.rgb, albedo.a);
+		return;
+	}
+
+	vec4 encoded = texture(tex1, v_screenPos);
+	vec3 normal = encoded.a > 0.0 ? normalize(encoded.rgb / encoded.a * 2.0 - 1.0) : vec3(0.0, 0.0, 1.0);
+
+	// Normal maps have y going up, the world has it going down
+	vec3 toLight = normalize(vec3(-v_offset.x, v_offset.y, v_params.y));
+	float diffuse = max(dot(normal, toLight), 0.0);
+	float attenuation = clamp(1.0 - length(v_offset) / v_params.x, 0.0, 1.0);
+
+	outCol = vec4(colour * v_colour.rgb * (diffuse * attenuation * attenuation), albedo.a);
+}
@@ -0,0 +1,33 @@
+Texture2D tex0 : register(t0);
+Texture2D tex1 : register(t1);
+SamplerState sampler0 : register(s0);
+SamplerState sampler1 : register(s1);
+
+struct VOut {
+    float4 position : SV_POSITION;
+    float4 colour : COLOR0;
+    float2 offset : POSITION1;
+    float2 screenPos : TEXCOORD0;
+    float3 params : TEXCOORD1;
+};
+
+float4 main(VOut input) : SV_TARGET {
+	// Blended with Add, which multiplies by alpha, so this un-premultiplies the albedo to keep the output premultiplied
+	float4 albedo = tex0.Sample(sampler0, input.screenPos);
+	float3 colour = albedo.a > 0.0 ? albedo.rgb / albedo.a : float3(0.0, 0.0, 0.0);
+
+	if (input.params.z > 0.5) {
+		// Ambient
+		return float4(colour * input.colour.rgb, albedo.a);
+	}
+
+	float4 encoded = tex1.Sample(sampler1, input.screenPos);
+	float3 normal = encoded.a > 0.0 ? normalize(encoded.rgb / encoded.a * 2.0 - 1.0) : float3(0.0, 0.0, 1.0);
+
+	// Normal maps have y going up, the world has it going down
+	float3 toLight = normalize(float3(-input.offset.x, input.offset.y, input.params.y));
+	float diffuse = max(dot(normal, toLight), 0.0);
+	float attenuation = saturate(1.0 - length(input.offset) / input.params.x);
+
+	return float4(colour * input.colour.rgb * (diffuse * attenuation * attenuation), albedo.a);
+}
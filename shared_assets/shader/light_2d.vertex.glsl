@@ -0,0 +1,25 @@
+layout(std140) uniform HalleyBlock {
+	mat4 u_mvp;
+};
+
+in vec4 a_vertPos;
+in vec2 a_position;
+in vec2 a_size;
+in vec4 a_colour;
+in vec4 a_params;
+
+out vec4 v_colour;
+out vec2 v_offset;
+out vec2 v_screenPos;
+out vec3 v_params;
+
+void main() {
+	vec2 offset = (a_vertPos.xy - vec2(0.5, 0.5)) * a_size;
+	vec4 pos = u_mvp * vec4(a_position + offset, 0.0, 1.0);
+
+	v_colour = a_colour;
+	v_offset = offset;
+	v_screenPos = pos.xy / pos.w * 0.5 + 0.5;
+	v_params = a_params.xyz;
+	gl_Position = pos;
+}
@@ -0,0 +1,34 @@
+cbuffer HalleyBlock : register(b0) {
+    float4x4 u_mvp;
+};
+
+struct VIn {
+    float4 vertPos : VERTPOS;
+    float2 position : POSITION;
+    float2 size : SIZE;
+    float4 colour : COLOUR;
+    float4 params : PARAMS;
+};
+
+struct VOut {
+    float4 position : SV_POSITION;
+    float4 colour : COLOR0;
+    float2 offset : POSITION1;
+    float2 screenPos : TEXCOORD0;
+    float3 params : TEXCOORD1;
+};
+
+VOut main(VIn input) {
+    VOut result;
+
+    float2 offset = (input.vertPos.xy - float2(0.5, 0.5)) * input.size;
+    float4 pos = mul(u_mvp, float4(input.position + offset, 0.0, 1.0));
+
+    result.colour = input.colour;
+    result.offset = offset;
+    result.screenPos = float2(pos.x / pos.w * 0.5 + 0.5, 0.5 - pos.y / pos.w * 0.5);
+    result.params = input.params.xyz;
+    result.position = pos;
+
+    return result;
+}
@@ -0,0 +1,23 @@
+uniform sampler2D tex0;
+uniform sampler2D tex1;
+
+in vec2 v_texCoord0;
+in vec4 v_colour;
+in vec4 v_colourAdd;
+
+out vec4 outCol;
+
+void main() {
+    float y = texture(tex0, v_texCoord0).r;
+    vec2 uv = texture(tex1, v_texCoord0).rg;
+
+    float c = 1.164383 * (y - 0.0625);
+    float d = uv.x - 0.5;
+    float e = uv.y - 0.5;
+
+    float r = c + 1.596027 * e;
+    float g = c - 0.391762 * d - 0.812968 * e;
+    float b = c + 2.017232 * d;
+
+    outCol = vec4(clamp(r, 0, 1), clamp(g, 0, 1), clamp(b, 0, 1), 1.0) * v_colour + v_colourAdd;
+}
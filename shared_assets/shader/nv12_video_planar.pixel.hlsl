@@ -0,0 +1,29 @@
+Texture2D tex0 : register(t0);
+Texture2D tex1 : register(t1);
+SamplerState sampler0 : register(s0);
+SamplerState sampler1 : register(s1);
+
+struct VOut {
+    float4 position : SV_POSITION;
+    float2 texCoord0 : TEXCOORD0;
+    float2 pixelTexCoord0 : TEXCOORD1;
+    float4 colour : COLOR0;
+    float4 colourAdd : COLOR1;
+    float2 vertPos : POSITION1;
+    float2 pixelPos : POSITION2;
+};
+
+float4 main(VOut input) : SV_TARGET {
+    float y = tex0.Sample(sampler0, input.texCoord0).r;
+    float2 uv = tex1.Sample(sampler1, input.texCoord0).rg;
+
+    float c = 1.164383 * (y - 0.0625);
+    float d = uv.x - 0.5;
+    float e = uv.y - 0.5;
+
+    float r = c + 1.596027 * e;
+    float g = c - 0.391762 * d - 0.812968 * e;
+    float b = c + 2.017232 * d;
+
+    return float4(saturate(r), saturate(g), saturate(b), 1.0) * input.colour + input.colourAdd;
+}
@@ -11,6 +11,8 @@ in vec4 a_colour;
 in vec4 a_texCoord0;
 in float a_rotation;
 in float a_textureRotation;
+in float a_depth;
+in vec4 a_clip;
 
 out vec2 v_texCoord0;
 out vec2 v_pixelTexCoord0;
@@ -31,13 +33,20 @@ void getColours(vec4 inColour, out vec4 baseColour, out vec4 addColour) {
 	addColour = clamp(inputCol - baseCol, vec4(0, 0, 0, 0), vec4(1, 1, 1, 0));
 }
 
-vec4 getVertexPosition(vec2 position, vec2 pivot, vec2 size, vec2 vertPos, float angle) {
+vec2 getWorldPosition(vec2 position, vec2 pivot, vec2 size, vec2 vertPos, float angle) {
 	float c = cos(angle);
 	float s = sin(angle);
 	mat2 m = mat2(c, s, -s, c);
 	
-	vec2 pos = position + m * ((vertPos - pivot) * size);
-	return u_mvp * vec4(pos, 0.0, 1.0);
+	return position + m * ((vertPos - pivot) * size);
+}
+
+void setClipDistances(vec2 pos, vec4 clip) {
+	// The rasterizer cuts anything outside, so clipped sprites can share a draw call
+	gl_ClipDistance[0] = pos.x - clip.x;
+	gl_ClipDistance[1] = pos.y - clip.y;
+	gl_ClipDistance[2] = clip.z - pos.x;
+	gl_ClipDistance[3] = clip.w - pos.y;
 }
 
 void main() {
@@ -46,5 +55,7 @@ void main() {
 	v_vertPos = a_vertPos.xy;
 	v_pixelPos = a_size * a_scale * a_vertPos.xy;
 	getColours(a_colour, v_colour, v_colourAdd);
-	gl_Position = getVertexPosition(a_position, a_pivot, a_size * a_scale, a_vertPos.xy, a_rotation);
+	vec2 pos = getWorldPosition(a_position, a_pivot, a_size * a_scale, a_vertPos.xy, a_rotation);
+	gl_Position = u_mvp * vec4(pos, a_depth, 1.0);
+	setClipDistances(pos, a_clip);
 }
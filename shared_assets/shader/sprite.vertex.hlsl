@@ -12,6 +12,8 @@ struct VIn {
     float4 texCoord0 : TEXCOORD0;
     float rotation : ROTATION;
     float textureRotation : TEXTUREROTATION;
+    float depth : DEPTH;
+    float4 clip : CLIP;
 };
 
 struct VOut {
@@ -22,6 +24,7 @@ struct VOut {
     float4 colourAdd : COLOR1;
     float2 vertPos : POSITION1;
     float2 pixelPos : POSITION2;
+    float4 clipDistance : SV_ClipDistance0; // Last, so pixel shaders can leave it out
 };
 
 float2 getTexCoord(float4 texCoords, float2 vertPos, float texCoordRotation) {
@@ -36,13 +39,17 @@ void getColours(float4 inColour, out float4 baseColour, out float4 addColour) {
     addColour = clamp(inputCol - baseCol, float4(0, 0, 0, 0), float4(1, 1, 1, 0));
 }
 
-float4 getVertexPosition(float2 position, float2 pivot, float2 size, float2 vertPos, float angle) {
+float2 getWorldPosition(float2 position, float2 pivot, float2 size, float2 vertPos, float angle) {
     float c = cos(angle);
     float s = sin(angle);
     float2x2 m = { c, -s, s, c };
     
-    float2 pos = position + mul(m, ((vertPos - pivot) * size));
-    return mul(u_mvp, float4(pos, 0.0, 1.0));
+    return position + mul(m, ((vertPos - pivot) * size));
+}
+
+float4 getClipDistances(float2 pos, float4 clip) {
+    // The rasterizer cuts anything outside, so clipped sprites can share a draw call
+    return float4(pos - clip.xy, clip.zw - pos);
 }
 
 VOut main(VIn input) {
@@ -53,7 +60,9 @@ VOut main(VIn input) {
     result.vertPos = input.vertPos.xy;
     result.pixelPos = input.size * input.scale * input.vertPos.xy;
     getColours(input.colour, result.colour, result.colourAdd);
-    result.position = getVertexPosition(input.position, input.pivot, input.size * input.scale, input.vertPos.xy, input.rotation);
+    float2 pos = getWorldPosition(input.position, input.pivot, input.size * input.scale, input.vertPos.xy, input.rotation);
+    result.position = mul(u_mvp, float4(pos, input.depth, 1.0));
+    result.clipDistance = getClipDistances(pos, input.clip);
 
     return result;
 }
@@ -0,0 +1,13 @@
+uniform sampler2DArray tex0;
+
+in vec2 v_texCoord0;
+in vec4 v_colour;
+in vec4 v_colourAdd;
+flat in float v_textureLayer;
+
+out vec4 outCol;
+
+void main() {
+	vec4 col = texture(tex0, vec3(v_texCoord0.xy, v_textureLayer));
+	outCol = col * v_colour + v_colourAdd * col.a;
+}
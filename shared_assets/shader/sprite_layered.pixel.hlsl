@@ -0,0 +1,18 @@
+Texture2DArray tex0 : register(t0);
+SamplerState sampler0 : register(s0);
+
+struct VOut {
+    float4 position : SV_POSITION;
+    float2 texCoord0 : TEXCOORD0;
+    float2 pixelTexCoord0 : TEXCOORD1;
+    float4 colour : COLOR0;
+    float4 colourAdd : COLOR1;
+    float2 vertPos : POSITION1;
+    float2 pixelPos : POSITION2;
+    nointerpolation float textureLayer : TEXCOORD2;
+};
+
+float4 main(VOut input) : SV_TARGET {
+	float4 col = tex0.Sample(sampler0, float3(input.texCoord0.xy, input.textureLayer));
+	return col * input.colour + input.colourAdd * col.a;
+}
@@ -0,0 +1,18 @@
+uniform sampler2D tex0;
+uniform sampler2D tex1;
+
+in vec2 v_texCoord0;
+in vec4 v_colour;
+in vec4 v_colourAdd;
+
+layout(location = 0) out vec4 outCol;
+layout(location = 1) out vec4 outNormal;
+
+void main() {
+	vec4 col = texture(tex0, v_texCoord0.xy);
+	outCol = col * v_colour + v_colourAdd * col.a;
+
+	// Premultiplied like the colour, so that it blends the same way; the lighting pass divides it back out
+	vec3 normal = texture(tex1, v_texCoord0.xy).rgb;
+	outNormal = vec4(normal, 1.0) * outCol.a;
+}
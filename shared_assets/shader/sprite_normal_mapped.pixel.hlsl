@@ -0,0 +1,30 @@
+Texture2D tex0 : register(t0);
+Texture2D tex1 : register(t1);
+SamplerState sampler0 : register(s0);
+SamplerState sampler1 : register(s1);
+
+struct VOut {
+    float4 position : SV_POSITION;
+    float2 texCoord0 : TEXCOORD0;
+    float2 pixelTexCoord0 : TEXCOORD1;
+    float4 colour : COLOR0;
+    float4 colourAdd : COLOR1;
+    float2 vertPos : POSITION1;
+    float2 pixelPos : POSITION2;
+};
+
+struct POut {
+    float4 colour : SV_TARGET0;
+    float4 normal : SV_TARGET1;
+};
+
+POut main(VOut input) {
+	POut result;
+	float4 col = tex0.Sample(sampler0, input.texCoord0.xy);
+	result.colour = col * input.colour + input.colourAdd * col.a;
+
+	// Premultiplied like the colour, so that it blends the same way; the lighting pass divides it back out
+	float3 normal = tex1.Sample(sampler1, input.texCoord0.xy).rgb;
+	result.normal = float4(normal, 1.0) * result.colour.a;
+	return result;
+}
@@ -0,0 +1,31 @@
+layout(std140) uniform MaterialBlock {
+	vec2 u_uvScale;
+	vec2 u_texelSize;
+	float u_sharpness;
+};
+
+uniform sampler2D tex0;
+
+in vec2 v_screenPos;
+
+out vec4 outCol;
+
+void main() {
+	// Filtering must not reach past the edge of what was drawn, as the rest of the texture is whatever was there before
+	vec2 minUV = u_texelSize * 0.5;
+	vec2 maxUV = u_uvScale - u_texelSize * 0.5;
+	vec2 uv = clamp(v_screenPos * u_uvScale, minUV, maxUV);
+
+	vec4 centre = texture(tex0, uv);
+	vec4 left = texture(tex0, clamp(uv - vec2(u_texelSize.x, 0.0), minUV, maxUV));
+	vec4 right = texture(tex0, clamp(uv + vec2(u_texelSize.x, 0.0), minUV, maxUV));
+	vec4 up = texture(tex0, clamp(uv - vec2(0.0, u_texelSize.y), minUV, maxUV));
+	vec4 down = texture(tex0, clamp(uv + vec2(0.0, u_texelSize.y), minUV, maxUV));
+
+	// Pushes each pixel away from its neighbours, to make up for the blur of the bilinear upscale, but never past the brightest or
+	// darkest of them, so edges don't get halos
+	vec4 sharpened = centre + (centre * 4.0 - (left + right + up + down)) * (u_sharpness * 0.25);
+	vec4 lo = min(centre, min(min(left, right), min(up, down)));
+	vec4 hi = max(centre, max(max(left, right), max(up, down)));
+	outCol = clamp(sharpened, lo, hi);
+}
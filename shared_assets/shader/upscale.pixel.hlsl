@@ -0,0 +1,33 @@
+cbuffer MaterialBlock : register(b1) {
+	float2 u_uvScale;
+	float2 u_texelSize;
+	float u_sharpness;
+};
+
+Texture2D tex0 : register(t0);
+SamplerState sampler0 : register(s0);
+
+struct VOut {
+    float4 position : SV_POSITION;
+    float2 screenPos : TEXCOORD0;
+};
+
+float4 main(VOut input) : SV_TARGET {
+	// Filtering must not reach past the edge of what was drawn, as the rest of the texture is whatever was there before
+	float2 minUV = u_texelSize * 0.5;
+	float2 maxUV = u_uvScale - u_texelSize * 0.5;
+	float2 uv = clamp(input.screenPos * u_uvScale, minUV, maxUV);
+
+	float4 centre = tex0.Sample(sampler0, uv);
+	float4 left = tex0.Sample(sampler0, clamp(uv - float2(u_texelSize.x, 0.0), minUV, maxUV));
+	float4 right = tex0.Sample(sampler0, clamp(uv + float2(u_texelSize.x, 0.0), minUV, maxUV));
+	float4 up = tex0.Sample(sampler0, clamp(uv - float2(0.0, u_texelSize.y), minUV, maxUV));
+	float4 down = tex0.Sample(sampler0, clamp(uv + float2(0.0, u_texelSize.y), minUV, maxUV));
+
+	// Pushes each pixel away from its neighbours, to make up for the blur of the bilinear upscale, but never past the brightest or
+	// darkest of them, so edges don't get halos
+	float4 sharpened = centre + (centre * 4.0 - (left + right + up + down)) * (u_sharpness * 0.25);
+	float4 lo = min(centre, min(min(left, right), min(up, down)));
+	float4 hi = max(centre, max(max(left, right), max(up, down)));
+	return clamp(sharpened, lo, hi);
+}
@@ -0,0 +1,17 @@
+layout(std140) uniform HalleyBlock {
+	mat4 u_mvp;
+};
+
+in vec4 a_vertPos;
+in vec2 a_position;
+in vec2 a_size;
+
+out vec2 v_screenPos;
+
+void main() {
+	vec2 offset = (a_vertPos.xy - vec2(0.5, 0.5)) * a_size;
+	vec4 pos = u_mvp * vec4(a_position + offset, 0.0, 1.0);
+
+	v_screenPos = pos.xy / pos.w * 0.5 + 0.5;
+	gl_Position = pos;
+}
@@ -0,0 +1,26 @@
+cbuffer HalleyBlock : register(b0) {
+    float4x4 u_mvp;
+};
+
+struct VIn {
+    float4 vertPos : VERTPOS;
+    float2 position : POSITION;
+    float2 size : SIZE;
+};
+
+struct VOut {
+    float4 position : SV_POSITION;
+    float2 screenPos : TEXCOORD0;
+};
+
+VOut main(VIn input) {
+    VOut result;
+
+    float2 offset = (input.vertPos.xy - float2(0.5, 0.5)) * input.size;
+    float4 pos = mul(u_mvp, float4(input.position + offset, 0.0, 1.0));
+
+    result.screenPos = float2(pos.x / pos.w * 0.5 + 0.5, 0.5 - pos.y / pos.w * 0.5);
+    result.position = pos;
+
+    return result;
+}
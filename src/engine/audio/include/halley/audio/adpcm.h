@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <gsl/gsl>
+#include "halley/utils/utils.h"
+
+namespace Halley {
+	class ResourceDataStatic;
+
+	// IMA ADPCM, at 4 bits per sample (about a quarter of 16-bit PCM, or an eighth of float), for clips that stay compressed in memory.
+	// Each channel is split into blocks that carry their own predictor state, so any position can be read without decoding from the start,
+	// and from any number of threads at once: the data is never modified after loading.
+	class ADPCMData {
+	public:
+		constexpr static size_t samplesPerBlock = 256;
+
+		explicit ADPCMData(std::shared_ptr<ResourceDataStatic> resource);
+
+		static bool isADPCM(gsl::span<const gsl::byte> data);
+		static Bytes encode(gsl::span<const std::vector<float>> channels); // All channels must have the same length
+
+		void read(size_t channel, size_t pos, size_t len, gsl::span<float> dst) const;
+
+		size_t getNumSamples() const; // Per channel
+		size_t getNumChannels() const;
+		size_t getSizeBytes() const;
+
+	private:
+		std::shared_ptr<ResourceDataStatic> resource;
+		const uint8_t* data = nullptr;
+		size_t numChannels = 0;
+		size_t numSamples = 0;
+
+		const uint8_t* getBlock(size_t block, size_t channel) const;
+	};
+}
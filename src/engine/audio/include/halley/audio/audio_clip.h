@@ -7,6 +7,7 @@ namespace Halley
 {
 	class ResourceLoader;
 	class VorbisData;
+	class ADPCMData;
 
 	class IAudioClip
 	{
@@ -20,6 +21,9 @@ namespace Halley
 		virtual bool isLoaded() const { return true; }
 	};
 
+	// Static clips are normally decoded in full when they're loaded. Ones imported with "compression: adpcm" (or "compression: vorbis",
+	// to keep the original Ogg Vorbis) stay compressed in memory instead, and are only decoded when played, into a cache of recently played
+	// clips shared by every voice (see setDecodedCacheBudget()). ADPCM is cheap to decode; Vorbis is smaller, but takes much longer.
 	class AudioClip : public AsyncResource, public IAudioClip
 	{
 	public:
@@ -37,6 +41,9 @@ namespace Halley
 		size_t getLoopPoint() const override; // in samples
 		bool isLoaded() const override;
 
+		bool isCompressed() const;
+		static void setDecodedCacheBudget(size_t bytes); // Defaults to 32 MB
+
 		static std::shared_ptr<AudioClip> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::AudioClip; }
 		void reload(Resource&& resource) override;
@@ -45,14 +52,19 @@ namespace Halley
 		size_t sampleLength = 0;
 		size_t numChannels = 0;
 		size_t loopPoint = 0;
-		mutable size_t streamPos = 0;
 		bool streaming = false;
 
-		// TODO: sort this mess?
-		mutable std::vector<std::vector<AudioConfig::SampleFormat>> temp0;
-		mutable std::vector<std::vector<AudioConfig::SampleFormat>> temp1;
-		mutable std::vector<std::vector<AudioConfig::SampleFormat>> samples;
-		mutable std::unique_ptr<VorbisData> vorbisData;
+		std::vector<std::vector<AudioConfig::SampleFormat>> samples;
+
+		// Compressed clips keep one of these
+		std::unique_ptr<ADPCMData> adpcm;
+		std::shared_ptr<ResourceDataStatic> vorbisData;
+
+		// Streamed clips are decoded ahead on the disk IO thread; shared with the pending decode task
+		struct StreamState;
+		std::shared_ptr<StreamState> stream;
+
+		std::shared_ptr<const std::vector<std::vector<AudioConfig::SampleFormat>>> getDecoded() const;
 	};
 
 	class StreamingAudioClip : public IAudioClip
@@ -26,6 +26,7 @@ namespace Halley
 		void deserialize(Deserializer& s);
 
 		void loadDependencies(Resources& resources) const;
+		std::vector<String> getClips() const;
 
 		void reload(Resource&& resource) override;
 		static std::shared_ptr<AudioEvent> loadResource(ResourceLoader& loader);
@@ -59,6 +60,7 @@ namespace Halley
 		virtual void serialize(Serializer& s) const = 0;
 		virtual void deserialize(Deserializer& s) = 0;
 		virtual void loadDependencies(const Resources& resources) {}
+		virtual void getClips(std::vector<String>& result) const {}
 	};
 
 	class AudioEventActionPlay : public IAudioEventAction
@@ -74,6 +76,7 @@ namespace Halley
 		void deserialize(Deserializer& s) override;
 
 		void loadDependencies(const Resources& resources) override;
+		void getClips(std::vector<String>& result) const override;
 
 	private:
 		std::vector<String> clips;
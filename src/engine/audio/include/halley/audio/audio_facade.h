@@ -4,6 +4,8 @@
 #include <atomic>
 #include <vector>
 #include "halley/core/api/halley_api_internal.h"
+#include "halley/concurrency/executor.h"
+#include "halley/concurrency/spsc_queue.h"
 #include <map>
 
 namespace Halley {
@@ -29,6 +31,7 @@ namespace Halley {
 
 		Vector<std::unique_ptr<const AudioDevice>> getAudioDevices() override;
 		void startPlayback(int deviceNumber) override;
+		void setBufferSize(int samples) override;
 		void stopPlayback() override;
 		void pausePlayback() override;
 		void resumePlayback() override;
@@ -43,10 +46,17 @@ namespace Halley {
 
 		void setMasterVolume(float volume = 1.0f) override;
 		void setGroupVolume(const String& groupName, float volume = 1.0f) override;
+		void setMaxVoices(size_t maxVoices) override;
+		void setGroupMaxVoices(const String& groupName, size_t maxVoices) override;
 
 	    void setOutputChannels(std::vector<AudioChannelData> audioChannelData) override;
 	    void setListener(AudioListenerData listener) override;
 
+		void setGroupParent(const String& groupName, const String& parentName) override;
+		void setGroupListener(const String& groupName, AudioListenerData listener) override;
+		void clearGroupListener(const String& groupName) override;
+		void setGroupEffects(const String& groupName, std::vector<AudioEffectConfig> effects) override;
+
 		void onAudioException(std::exception& e);
 
     private:
@@ -56,18 +66,19 @@ namespace Halley {
 		std::unique_ptr<AudioEngine> engine;
 
 		std::thread audioThread;
-		std::mutex audioMutex;
 		std::mutex exceptionMutex;
 		std::atomic<bool> running;
 		std::atomic<bool> started;
 	    AudioSpec audioSpec;
+		int bufferSize = 512;
 
-		std::vector<std::function<void()>> outbox;
-		std::vector<std::function<void()>> inbox;
-		std::vector<std::function<void()>> inboxProcessing;
+		// The game and audio threads never wait on each other: commands go through a lock-free queue, and anything that
+		// doesn't fit waits in the outbox for the next pump(). Playing sounds come back the other way, the same way.
+		std::vector<TaskBase> outbox;
+		SPSCQueue<TaskBase> commands;
+		SPSCQueue<std::vector<size_t>> playingSoundsQueue;
 		std::vector<String> exceptions;
 		std::vector<size_t> playingSounds;
-		std::vector<size_t> playingSoundsNext;
 
 		std::map<int, AudioHandle> musicTracks;
 
@@ -76,7 +87,8 @@ namespace Halley {
 
 	    void run();
 	    void stepAudio();
-	    void enqueue(std::function<void()> action);
+	    void enqueue(TaskBase action);
+		void clearCommands();
 		
 		void stopMusic(AudioHandle& handle, float fade);
 
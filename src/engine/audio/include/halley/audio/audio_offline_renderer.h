@@ -0,0 +1,65 @@
+#pragma once
+#include <memory>
+#include <cstdint>
+#include "halley/core/api/audio_api.h"
+#include "audio_position.h"
+
+namespace Halley
+{
+	class AudioEngine;
+	class AudioProfiler;
+	class IAudioClip;
+
+	enum class AudioMixerType
+	{
+		Default, // The best one available
+		Scalar,
+		SSE,
+		AVX,
+		NEON
+	};
+
+	struct AudioBufferStats
+	{
+		int64_t total = 0; // Nanoseconds
+		int64_t mixer = 0;
+		int64_t decoder = 0;
+		int64_t resampler = 0;
+		int64_t effects = 0;
+		size_t voices = 0; // Actually mixed
+		size_t virtualVoices = 0;
+	};
+
+	// Drives the audio engine without an AudioOutputAPI, generating buffers as fast as it can, on the calling thread.
+	// For benchmarks and stress tests: each buffer is timed, and split between mixing, reading clips and resampling.
+	// Anything that takes longer than getBufferBudget() would underrun on a real device.
+	class AudioOfflineRenderer
+	{
+	public:
+		explicit AudioOfflineRenderer(AudioSpec spec, AudioMixerType mixer = AudioMixerType::Default);
+		~AudioOfflineRenderer();
+
+		static bool isMixerSupported(AudioMixerType mixer);
+
+		// A pitch other than 1 goes through a resampler, just like an event's would
+		void play(std::shared_ptr<const IAudioClip> clip, AudioPosition position, float volume, bool loop, const String& group = "", float pitch = 1.0f);
+		void setGroupGain(const String& group, float gain);
+		void setGroupParent(const String& group, const String& parent);
+		void setGroupEffects(const String& group, std::vector<AudioEffectConfig> effects);
+		void setMaxVoices(size_t n);
+		void setListener(AudioListenerData listener);
+
+		const AudioBufferStats& generateBuffer();
+		int64_t getBufferBudget() const; // Nanoseconds of audio in each buffer
+
+	private:
+		class NullOutput;
+
+		AudioSpec spec;
+		std::unique_ptr<NullOutput> output;
+		std::unique_ptr<AudioEngine> engine;
+		std::unique_ptr<AudioProfiler> profiler;
+		AudioBufferStats stats;
+		size_t uniqueId = 0;
+	};
+}
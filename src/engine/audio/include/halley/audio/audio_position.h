@@ -31,6 +31,12 @@ namespace Halley
 		void setMix(size_t srcChannels, gsl::span<const AudioChannelData> dstChannels, gsl::span<float, 16> dst, float gain, const AudioListenerData& listener) const;
 		void setPosition(Vector3f position);
 
+		// How much distance lowers the volume, from 1 (not at all) to 0 (out of range)
+		float getAttenuation(const AudioListenerData& listener) const;
+
+		// If this is positional with just one source, which is what AudioMixer::spatialize batches; nullptr otherwise
+		const SpatialSource* getSingleSource() const;
+
 	private:
 		std::vector<SpatialSource> sources;
 		float pan = 0;
@@ -40,5 +46,6 @@ namespace Halley
 		void setMixFixed(size_t srcChannels, gsl::span<const AudioChannelData> dstChannels, gsl::span<float, 16> dst, float gain, const AudioListenerData& listener) const;
 		void setMixUI(gsl::span<const AudioChannelData> dstChannels, gsl::span<float, 16> dst, float gain, const AudioListenerData& listener) const;
 		void setMixPositional(gsl::span<const AudioChannelData> dstChannels, gsl::span<float, 16> dst, float gain, const AudioListenerData& listener) const;
+		float getProximity(const AudioListenerData& listener, float& pan) const;
 	};
 }
@@ -5,5 +5,6 @@ namespace Halley {}
 #include "audio_clip.h"
 #include "audio_config.h"
 #include "audio_event.h"
+#include "audio_offline_renderer.h"
 #include "audio_emitter_behaviour.h"
 #include "audio_position.h"
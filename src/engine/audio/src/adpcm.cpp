@@ -0,0 +1,199 @@
+#include "adpcm.h"
+#include "halley/resources/resource_data.h"
+#include "halley/support/exception.h"
+#include <array>
+#include <cmath>
+
+using namespace Halley;
+
+namespace {
+	// Header: "HADP", then the number of channels, samples per channel and samples per block, as little-endian uint32
+	constexpr size_t headerSize = 16;
+	constexpr size_t blockHeaderSize = 4; // int16 predictor, uint8 step index, one byte of padding
+	constexpr size_t blockSize = blockHeaderSize + ADPCMData::samplesPerBlock / 2;
+
+	constexpr std::array<int, 16> indexTable = {{ -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 }};
+	constexpr std::array<int, 89> stepTable = {{
+		7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143,
+		157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552,
+		1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487,
+		12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+	}};
+
+	struct State
+	{
+		int predictor = 0;
+		int index = 0;
+
+		int decode(int nibble)
+		{
+			const int step = stepTable[index];
+			int diff = step >> 3;
+			if (nibble & 4) {
+				diff += step;
+			}
+			if (nibble & 2) {
+				diff += step >> 1;
+			}
+			if (nibble & 1) {
+				diff += step >> 2;
+			}
+			predictor = clamp(nibble & 8 ? predictor - diff : predictor + diff, -32768, 32767);
+			index = clamp(index + indexTable[nibble], 0, 88);
+			return predictor;
+		}
+
+		int encode(int sample)
+		{
+			int step = stepTable[index];
+			int diff = sample - predictor;
+			int nibble = 0;
+			if (diff < 0) {
+				nibble = 8;
+				diff = -diff;
+			}
+			for (int bit = 4; bit > 0; bit >>= 1) {
+				if (diff >= step) {
+					nibble |= bit;
+					diff -= step;
+				}
+				step >>= 1;
+			}
+
+			// Track what the decoder will actually see, so errors don't accumulate
+			decode(nibble);
+			return nibble;
+		}
+	};
+
+	void writeU32(Bytes& dst, uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i) {
+			dst.push_back(Byte((value >> (8 * i)) & 0xFF));
+		}
+	}
+
+	uint32_t readU32(const uint8_t* src)
+	{
+		return uint32_t(src[0]) | (uint32_t(src[1]) << 8) | (uint32_t(src[2]) << 16) | (uint32_t(src[3]) << 24);
+	}
+}
+
+constexpr size_t ADPCMData::samplesPerBlock;
+
+ADPCMData::ADPCMData(std::shared_ptr<ResourceDataStatic> res)
+	: resource(std::move(res))
+{
+	const auto span = resource->getSpan();
+	if (!isADPCM(span)) {
+		throw Exception("Not ADPCM data: " + resource->getPath(), HalleyExceptions::AudioEngine);
+	}
+
+	data = reinterpret_cast<const uint8_t*>(span.data());
+	numChannels = readU32(data + 4);
+	numSamples = readU32(data + 8);
+	if (readU32(data + 12) != samplesPerBlock) {
+		throw Exception("Unsupported ADPCM block size in " + resource->getPath(), HalleyExceptions::AudioEngine);
+	}
+
+	const size_t nBlocks = (numSamples + samplesPerBlock - 1) / samplesPerBlock;
+	if (numChannels == 0 || size_t(span.size()) < headerSize + nBlocks * numChannels * blockSize) {
+		throw Exception("Truncated ADPCM data in " + resource->getPath(), HalleyExceptions::AudioEngine);
+	}
+}
+
+bool ADPCMData::isADPCM(gsl::span<const gsl::byte> data)
+{
+	return data.size() >= ptrdiff_t(headerSize) && memcmp(data.data(), "HADP", 4) == 0;
+}
+
+Bytes ADPCMData::encode(gsl::span<const std::vector<float>> channels)
+{
+	const auto nChannels = size_t(channels.size());
+	const size_t length = nChannels > 0 ? channels[0].size() : 0;
+	const size_t nBlocks = (length + samplesPerBlock - 1) / samplesPerBlock;
+
+	Bytes result;
+	result.reserve(headerSize + nBlocks * nChannels * blockSize);
+	for (char c: { 'H', 'A', 'D', 'P' }) {
+		result.push_back(Byte(c));
+	}
+	writeU32(result, uint32_t(nChannels));
+	writeU32(result, uint32_t(length));
+	writeU32(result, uint32_t(samplesPerBlock));
+
+	std::vector<State> states(nChannels);
+	for (size_t block = 0; block < nBlocks; ++block) {
+		for (size_t c = 0; c < nChannels; ++c) {
+			auto& state = states[c];
+			const auto predictor = uint16_t(int16_t(state.predictor));
+			result.push_back(Byte(predictor & 0xFF));
+			result.push_back(Byte(predictor >> 8));
+			result.push_back(Byte(state.index));
+			result.push_back(0);
+
+			const auto& src = channels[c];
+			for (size_t i = 0; i < samplesPerBlock; i += 2) {
+				const size_t pos = block * samplesPerBlock + i;
+				const auto toInt = [&] (size_t p) { return p < length ? int(std::lround(clamp(src[p], -1.0f, 1.0f) * 32767.0f)) : 0; };
+				const int lo = state.encode(toInt(pos));
+				const int hi = state.encode(toInt(pos + 1));
+				result.push_back(Byte(lo | (hi << 4)));
+			}
+		}
+	}
+
+	return result;
+}
+
+void ADPCMData::read(size_t channel, size_t pos, size_t len, gsl::span<float> dst) const
+{
+	Expects(channel < numChannels);
+	Expects(pos + len <= numSamples);
+	Expects(size_t(dst.size()) >= len);
+
+	constexpr float scale = 1.0f / 32768.0f;
+	size_t written = 0;
+	while (written < len) {
+		const size_t cur = pos + written;
+		const size_t blockIdx = cur / samplesPerBlock;
+		const size_t start = cur % samplesPerBlock;
+		const size_t n = std::min(len - written, samplesPerBlock - start);
+
+		const uint8_t* block = getBlock(blockIdx, channel);
+		State state;
+		state.predictor = int(int16_t(uint16_t(block[0]) | (uint16_t(block[1]) << 8)));
+		state.index = clamp(int(block[2]), 0, 88);
+		const uint8_t* nibbles = block + blockHeaderSize;
+
+		// Whatever comes before the start in this block still has to be decoded, to get the state there
+		for (size_t i = 0; i < start + n; ++i) {
+			const int nibble = (nibbles[i >> 1] >> ((i & 1) * 4)) & 0xF;
+			const int sample = state.decode(nibble);
+			if (i >= start) {
+				dst[written + i - start] = float(sample) * scale;
+			}
+		}
+		written += n;
+	}
+}
+
+size_t ADPCMData::getNumSamples() const
+{
+	return numSamples;
+}
+
+size_t ADPCMData::getNumChannels() const
+{
+	return numChannels;
+}
+
+size_t ADPCMData::getSizeBytes() const
+{
+	return resource->getSize();
+}
+
+const uint8_t* ADPCMData::getBlock(size_t block, size_t channel) const
+{
+	return data + headerSize + (block * numChannels + channel) * blockSize;
+}
@@ -1,4 +1,5 @@
 #include "audio_buffer.h"
+#include "halley/support/memory_tracker.h"
 
 using namespace Halley;
 
@@ -119,6 +120,15 @@ std::array<gsl::span<AudioConfig::SampleFormat>, AudioConfig::maxChannels> Audio
 	return sampleSpans;
 }
 
+AudioBufferPool::~AudioBufferPool()
+{
+	for (auto& buffers: buffersTable) {
+		for (auto& b: buffers) {
+			MemoryTracker::onFree(MemoryTags::Audio, b.buffer->packs.size() * sizeof(AudioSamplePack));
+		}
+	}
+}
+
 AudioBufferRef AudioBufferPool::getBuffer(size_t numSamples)
 {
 	return AudioBufferRef(allocBuffer(numSamples), *this);
@@ -154,6 +164,7 @@ AudioBuffer& AudioBufferPool::allocBuffer(size_t numSamples)
 	// Couldn't find a free one, create new
 	buffers.emplace_back(std::make_unique<AudioBuffer>());
 	buffers.back().buffer->packs.resize(1LL << idx);
+	MemoryTracker::onAlloc(MemoryTags::Audio, buffers.back().buffer->packs.size() * sizeof(AudioSamplePack));
 	return *buffers.back().buffer;
 }
 
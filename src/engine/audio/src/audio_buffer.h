@@ -61,6 +61,9 @@ namespace Halley
 	class AudioBufferPool
 	{
 	public:
+		AudioBufferPool() = default;
+		~AudioBufferPool();
+
 		AudioBufferRef getBuffer(size_t numSamples);
 		AudioBuffersRef getBuffers(size_t n, size_t numSamples);
 		void returnBuffer(AudioBuffer& buffer);
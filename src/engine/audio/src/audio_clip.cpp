@@ -1,12 +1,229 @@
 #include "audio_clip.h"
 #include "halley/resources/resource_data.h"
 #include "vorbis_dec.h"
+#include "adpcm.h"
+#include "audio_clip_cache.h"
 #include "halley/resources/metadata.h"
 #include "halley/concurrency/concurrent.h"
 #include "halley/text/string_converter.h"
+#include <array>
+#include <atomic>
+#include <limits>
+#include <mutex>
 
 using namespace Halley;
 
+struct AudioClip::StreamState : std::enable_shared_from_this<StreamState>
+{
+	// About 0.7s of audio decoded ahead
+	constexpr static size_t chunkSize = 4096;
+	constexpr static size_t numChunks = 8;
+
+	struct Chunk
+	{
+		std::atomic<bool> ready;
+		size_t startPos = 0;
+		size_t length = 0;
+		std::vector<std::vector<AudioConfig::SampleFormat>> samples;
+
+		Chunk() : ready(false) {}
+	};
+
+	StreamState(std::unique_ptr<VorbisData> vorbis, size_t numChannels, size_t sampleLength, size_t loopPoint)
+		: vorbis(std::move(vorbis))
+		, numChannels(numChannels)
+		, sampleLength(sampleLength)
+		, loopPoint(loopPoint < sampleLength ? loopPoint : 0)
+		, fillScheduled(false)
+		, stopped(false)
+	{
+		for (auto& c: chunks) {
+			c.samples.resize(numChannels);
+		}
+		for (auto& t: temp) {
+			t.resize(numChannels);
+		}
+	}
+
+	size_t read(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst)
+	{
+		// Only one thread can read from the chunks at a time; anyone else just decodes directly
+		const bool isReader = !reading.test_and_set(std::memory_order_acquire);
+		if (isReader) {
+			const bool ok = readChunks(channelN, pos, len, dst);
+			if (ok) {
+				reading.clear(std::memory_order_release);
+				return len;
+			}
+		}
+
+		readDirect(channelN, pos, len, dst, isReader);
+		if (isReader) {
+			reading.clear(std::memory_order_release);
+		}
+		return len;
+	}
+
+	void scheduleFill()
+	{
+		if (!fillScheduled.exchange(true)) {
+			std::weak_ptr<StreamState> weak = shared_from_this();
+			Concurrent::executeDetached(Executors::getDiskIO(), [weak] ()
+			{
+				auto state = weak.lock();
+				if (state) {
+					state->fill();
+				}
+			});
+		}
+	}
+
+	void stop()
+	{
+		stopped = true;
+	}
+
+private:
+	std::unique_ptr<VorbisData> vorbis;
+	const size_t numChannels;
+	const size_t sampleLength;
+	const size_t loopPoint;
+
+	std::array<Chunk, numChunks> chunks;
+	std::atomic<bool> fillScheduled;
+	std::atomic<bool> stopped;
+	std::atomic_flag reading = ATOMIC_FLAG_INIT;
+
+	// Reader only
+	size_t readIdx = 0;
+	size_t expectedPos = 0; // Where the chunk at readIdx will start, once decoded
+
+	// Under decodeMutex
+	std::mutex decodeMutex;
+	size_t writeIdx = 0;
+	size_t decodePos = 0;
+	size_t vorbisPos = 0;
+	std::array<std::vector<std::vector<AudioConfig::SampleFormat>>, 2> temp;
+	std::array<size_t, 2> tempPos = {{ std::numeric_limits<size_t>::max(), std::numeric_limits<size_t>::max() }};
+	std::array<size_t, 2> tempLen = {{ 0, 0 }};
+
+	bool readChunks(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst)
+	{
+		size_t idx = readIdx;
+		size_t cur = pos;
+		size_t written = 0;
+		while (written < len) {
+			auto& chunk = chunks[idx];
+			if (!chunk.ready.load(std::memory_order_acquire) || cur < chunk.startPos || cur >= chunk.startPos + chunk.length) {
+				return false;
+			}
+
+			const size_t n = std::min(len - written, chunk.startPos + chunk.length - cur);
+			memcpy(dst.data() + written, chunk.samples[channelN].data() + (cur - chunk.startPos), n * sizeof(AudioConfig::SampleFormat));
+			written += n;
+			cur += n;
+			if (written < len) {
+				idx = (idx + 1) % numChunks;
+			}
+		}
+
+		// Channels are read in order for each block, so chunks can go once the last one is done with them
+		if (channelN + 1 == numChannels) {
+			while (chunks[readIdx].ready.load(std::memory_order_acquire) && cur >= chunks[readIdx].startPos + chunks[readIdx].length) {
+				release();
+			}
+			scheduleFill();
+		}
+		return true;
+	}
+
+	void release()
+	{
+		auto& chunk = chunks[readIdx];
+		const size_t end = chunk.startPos + chunk.length;
+		expectedPos = end >= sampleLength ? loopPoint : end;
+		chunk.ready.store(false, std::memory_order_release);
+		readIdx = (readIdx + 1) % numChunks;
+	}
+
+	void readDirect(size_t channelN, size_t pos, size_t len, gsl::span<AudioConfig::SampleFormat> dst, bool isReader)
+	{
+		std::unique_lock<std::mutex> lock(decodeMutex);
+
+		const size_t tempIdx = pos == 0 ? 0 : 1; // pos == 0 has a different buffer because if it loops around, it will be used together with another buffer
+		auto& buffer = temp[tempIdx];
+		if (tempPos[tempIdx] != pos || tempLen[tempIdx] < len) {
+			// VorbisData reads as much as the buffers hold, so they must be exactly this size
+			for (auto& b: buffer) {
+				b.resize(len);
+			}
+			decode(pos, buffer);
+			tempPos[tempIdx] = pos;
+			tempLen[tempIdx] = len;
+		}
+		memcpy(dst.data(), buffer[channelN].data(), len * sizeof(AudioConfig::SampleFormat));
+
+		if (!isReader || channelN + 1 != numChannels) {
+			return;
+		}
+
+		// If the chunks are just running late, let them catch up; otherwise, this was a seek, so decode from here on
+		const bool catchingUp = !chunks[readIdx].ready.load(std::memory_order_acquire) && pos >= expectedPos && pos < expectedPos + chunkSize * numChunks;
+		if (!catchingUp) {
+			for (auto& c: chunks) {
+				c.ready.store(false, std::memory_order_release);
+			}
+			readIdx = 0;
+			writeIdx = 0;
+			decodePos = pos + len >= sampleLength ? loopPoint : pos + len;
+			expectedPos = decodePos;
+			lock.unlock();
+			scheduleFill();
+		}
+	}
+
+	void fill()
+	{
+		fillScheduled = false;
+
+		while (!stopped) {
+			std::unique_lock<std::mutex> lock(decodeMutex);
+			auto& chunk = chunks[writeIdx];
+			if (chunk.ready.load(std::memory_order_acquire)) {
+				return;
+			}
+
+			if (decodePos >= sampleLength) {
+				decodePos = loopPoint;
+			}
+			const size_t len = std::min(chunkSize, sampleLength - decodePos);
+			for (auto& s: chunk.samples) {
+				s.resize(len);
+			}
+			decode(decodePos, chunk.samples);
+
+			chunk.startPos = decodePos;
+			chunk.length = len;
+			chunk.ready.store(true, std::memory_order_release);
+			decodePos += len;
+			writeIdx = (writeIdx + 1) % numChunks;
+		}
+	}
+
+	void decode(size_t pos, std::vector<std::vector<AudioConfig::SampleFormat>>& dst)
+	{
+		if (pos != vorbisPos) {
+			vorbis->seek(pos);
+			vorbisPos = pos;
+		}
+		vorbis->read(dst);
+		vorbisPos += dst.at(0).size();
+	}
+};
+
+constexpr size_t AudioClip::StreamState::chunkSize;
+constexpr size_t AudioClip::StreamState::numChunks;
+
 AudioClip::AudioClip(size_t numChannels)
 	: numChannels(numChannels)
 {
@@ -15,6 +232,10 @@ AudioClip::AudioClip(size_t numChannels)
 
 AudioClip::~AudioClip()
 {
+	if (stream) {
+		stream->stop();
+	}
+	AudioClipCache::remove(this);
 }
 
 AudioClip& AudioClip::operator=(AudioClip&& other) noexcept
@@ -24,13 +245,16 @@ AudioClip& AudioClip::operator=(AudioClip&& other) noexcept
 	sampleLength = other.sampleLength;
 	numChannels = other.numChannels;
 	loopPoint = other.loopPoint;
-	streamPos = other.streamPos;
 	streaming = other.streaming;
 
-	temp0 = std::move(other.temp0);
-	temp1 = std::move(other.temp1);
 	samples = std::move(other.samples);
+	adpcm = std::move(other.adpcm);
 	vorbisData = std::move(other.vorbisData);
+	AudioClipCache::remove(this);
+	if (stream) {
+		stream->stop();
+	}
+	stream = std::move(other.stream);
 
 	doneLoading();
 
@@ -39,14 +263,31 @@ AudioClip& AudioClip::operator=(AudioClip&& other) noexcept
 
 void AudioClip::loadFromStatic(std::shared_ptr<ResourceDataStatic> data, Metadata metadata)
 {
+	loopPoint = metadata.getInt("loopPoint", 0);
+	streaming = false;
+
+	if (ADPCMData::isADPCM(data->getSpan())) {
+		// The importer has already resampled these to the right rate
+		adpcm = std::make_unique<ADPCMData>(data);
+		numChannels = adpcm->getNumChannels();
+		sampleLength = adpcm->getNumSamples();
+		doneLoading();
+		return;
+	}
+
 	VorbisData vorbis(data);
 	if (vorbis.getSampleRate() != AudioConfig::sampleRate) {
 		throw Exception("Sound clip should be " + toString(AudioConfig::sampleRate) + " Hz.", HalleyExceptions::AudioEngine);
 	}	
 	numChannels = vorbis.getNumChannels();
 	sampleLength = vorbis.getNumSamples();
-	loopPoint = metadata.getInt("loopPoint", 0);
-	streaming = false;
+
+	if (metadata.getString("compression", "none") == "vorbis") {
+		vorbis.close();
+		vorbisData = std::move(data);
+		doneLoading();
+		return;
+	}
 
 	samples.resize(numChannels);
 	for (size_t i = 0; i < numChannels; ++i) {
@@ -60,18 +301,18 @@ void AudioClip::loadFromStatic(std::shared_ptr<ResourceDataStatic> data, Metadat
 
 void AudioClip::loadFromStream(std::shared_ptr<ResourceDataStream> data, Metadata metadata)
 {
-	vorbisData = std::make_unique<VorbisData>(data);
-	size_t nChannels = vorbisData->getNumChannels();
-	if (vorbisData->getSampleRate() != AudioConfig::sampleRate) {
+	auto vorbis = std::make_unique<VorbisData>(data);
+	if (vorbis->getSampleRate() != AudioConfig::sampleRate) {
 		throw Exception("Sound clip should be " + toString(AudioConfig::sampleRate) + " Hz.", HalleyExceptions::AudioEngine);
 	}
-	
-	samples.resize(nChannels);
-	numChannels = nChannels;
-	sampleLength = vorbisData->getNumSamples();
+
+	numChannels = vorbis->getNumChannels();
+	sampleLength = vorbis->getNumSamples();
 	loopPoint = metadata.getInt("loopPoint", 0);
-	streamPos = 0;
 	streaming = true;
+
+	stream = std::make_shared<StreamState>(std::move(vorbis), numChannels, sampleLength, loopPoint);
+	stream->scheduleFill();
 	doneLoading();
 }
 
@@ -80,33 +321,10 @@ size_t AudioClip::copyChannelData(size_t channelN, size_t pos, size_t len, gsl::
 	Expects(pos + len <= sampleLength);
 
 	if (streaming) {
-		auto& temp = pos == 0 ? temp0 : temp1; // pos == 0 has a different buffer because if it loops around, it will be used together with another buffer
-		if (temp.size() != numChannels) {
-			temp.resize(numChannels);
-		}
-
-		if (channelN == 0) { // TODO: this assumes the channels will be read in order. This will break threading.
-			if (pos != streamPos) {
-				vorbisData->seek(pos);
-				streamPos = pos;
-			}
-
-			size_t toRead = len;
-			for (size_t i = 0; i < numChannels; ++i) {
-				if (temp[i].size() < toRead) {
-					temp[i].resize(toRead);
-				}
-			}
-			vorbisData->read(temp);
-			streamPos += len;
-		}
-
-		auto& buf = samples.at(channelN);
-		if (buf.size() < len) {
-			buf.resize(len);
-		}
-
-		memcpy(dst.data(), temp[channelN].data(), len * sizeof(AudioConfig::SampleFormat));
+		return stream->read(channelN, pos, len, dst);
+	} else if (isCompressed()) {
+		const auto decoded = getDecoded();
+		memcpy(dst.data(), decoded->at(channelN).data() + pos, len * sizeof(AudioConfig::SampleFormat));
 		return len;
 	} else {
 		memcpy(dst.data(), samples.at(channelN).data() + pos, len * sizeof(AudioConfig::SampleFormat));
@@ -136,6 +354,39 @@ bool AudioClip::isLoaded() const
 	return AsyncResource::isLoaded();
 }
 
+bool AudioClip::isCompressed() const
+{
+	return adpcm || vorbisData;
+}
+
+void AudioClip::setDecodedCacheBudget(size_t bytes)
+{
+	AudioClipCache::setBudget(bytes);
+}
+
+std::shared_ptr<const std::vector<std::vector<AudioConfig::SampleFormat>>> AudioClip::getDecoded() const
+{
+	auto cached = AudioClipCache::get(this);
+	if (cached) {
+		return cached;
+	}
+
+	// Compressed clips are meant to be short, so this decodes the whole thing, the first time it's needed
+	AudioClipCache::Samples decoded(numChannels);
+	for (auto& s: decoded) {
+		s.resize(sampleLength);
+	}
+	if (adpcm) {
+		for (size_t i = 0; i < numChannels; ++i) {
+			adpcm->read(i, 0, sampleLength, decoded[i]);
+		}
+	} else {
+		VorbisData vorbis(vorbisData);
+		vorbis.read(decoded);
+	}
+	return AudioClipCache::insert(this, std::move(decoded));
+}
+
 std::shared_ptr<AudioClip> AudioClip::loadResource(ResourceLoader& loader)
 {
 	auto meta = loader.getMeta();
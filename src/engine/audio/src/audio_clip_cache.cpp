@@ -0,0 +1,108 @@
+#include "audio_clip_cache.h"
+#include "halley/data_structures/hash_map.h"
+#include "halley/support/memory_tracker.h"
+#include <list>
+#include <mutex>
+
+using namespace Halley;
+
+namespace {
+	struct Entry
+	{
+		const void* clip;
+		std::shared_ptr<const AudioClipCache::Samples> samples;
+		size_t bytes;
+	};
+
+	struct CacheState
+	{
+		std::mutex mutex;
+		std::list<Entry> entries; // Most recently used first
+		HashMap<const void*, std::list<Entry>::iterator> index;
+		size_t bytes = 0;
+		size_t budget = 32 * 1024 * 1024;
+
+		void erase(std::list<Entry>::iterator iter)
+		{
+			bytes -= iter->bytes;
+			MemoryTracker::onFree(MemoryTags::Audio, iter->bytes);
+			index.erase(iter->clip);
+			entries.erase(iter);
+		}
+
+		void trim()
+		{
+			// Always keeps the newest one, even if it's over budget by itself
+			while (bytes > budget && entries.size() > 1) {
+				erase(std::prev(entries.end()));
+			}
+		}
+	};
+
+	CacheState& getState()
+	{
+		static CacheState state;
+		return state;
+	}
+}
+
+std::shared_ptr<const AudioClipCache::Samples> AudioClipCache::get(const void* clip)
+{
+	auto& state = getState();
+	std::unique_lock<std::mutex> lock(state.mutex);
+	const auto iter = state.index.find(clip);
+	if (iter == state.index.end()) {
+		return {};
+	}
+	state.entries.splice(state.entries.begin(), state.entries, iter->second);
+	return iter->second->samples;
+}
+
+std::shared_ptr<const AudioClipCache::Samples> AudioClipCache::insert(const void* clip, Samples samples)
+{
+	size_t bytes = 0;
+	for (auto& s: samples) {
+		bytes += s.size() * sizeof(AudioConfig::SampleFormat);
+	}
+	auto shared = std::make_shared<const Samples>(std::move(samples));
+
+	auto& state = getState();
+	std::unique_lock<std::mutex> lock(state.mutex);
+	const auto iter = state.index.find(clip);
+	if (iter != state.index.end()) {
+		state.entries.splice(state.entries.begin(), state.entries, iter->second);
+		return iter->second->samples;
+	}
+
+	state.entries.push_front(Entry{ clip, shared, bytes });
+	state.index[clip] = state.entries.begin();
+	state.bytes += bytes;
+	MemoryTracker::onAlloc(MemoryTags::Audio, bytes);
+	state.trim();
+	return shared;
+}
+
+void AudioClipCache::remove(const void* clip)
+{
+	auto& state = getState();
+	std::unique_lock<std::mutex> lock(state.mutex);
+	const auto iter = state.index.find(clip);
+	if (iter != state.index.end()) {
+		state.erase(iter->second);
+	}
+}
+
+void AudioClipCache::setBudget(size_t bytes)
+{
+	auto& state = getState();
+	std::unique_lock<std::mutex> lock(state.mutex);
+	state.budget = bytes;
+	state.trim();
+}
+
+size_t AudioClipCache::getBytes()
+{
+	auto& state = getState();
+	std::unique_lock<std::mutex> lock(state.mutex);
+	return state.bytes;
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "halley/core/api/audio_api.h"
+
+namespace Halley
+{
+	// Decoded PCM for clips that are kept compressed in memory, shared by every voice playing them.
+	// Least recently used clips are dropped once it goes over budget; anything still being played holds on to its own reference.
+	// Safe to use from any thread, but the lock is only held for the lookup, never while decoding.
+	class AudioClipCache
+	{
+	public:
+		using Samples = std::vector<std::vector<AudioConfig::SampleFormat>>;
+
+		static std::shared_ptr<const Samples> get(const void* clip); // nullptr if it's not there
+		static std::shared_ptr<const Samples> insert(const void* clip, Samples samples); // If another thread got there first, returns theirs
+		static void remove(const void* clip);
+
+		static void setBudget(size_t bytes);
+		static size_t getBytes();
+	};
+}
@@ -0,0 +1,277 @@
+#include "audio_effects.h"
+#include "audio_mixer.h"
+#include "halley/maths/angle.h"
+#include "halley/support/exception.h"
+#include "halley/utils/utils.h"
+#include <cmath>
+
+using namespace Halley;
+
+namespace {
+	constexpr float sampleRate = float(AudioConfig::sampleRate);
+	constexpr float packRate = sampleRate / AudioSamplePack::NumSamples;
+
+	// Decaying feedback eventually reaches denormals, which are very slow on x86
+	inline float undenormalise(float x)
+	{
+		return std::abs(x) < 1e-15f ? 0.0f : x;
+	}
+
+	inline float dbToGain(float db)
+	{
+		return std::pow(10.0f, db / 20.0f);
+	}
+
+	// Freeverb's tunings, which were for 44.1 kHz
+	constexpr size_t scaleTuning(size_t samples)
+	{
+		return samples * AudioConfig::sampleRate / 44100;
+	}
+	constexpr std::array<size_t, 4> combTunings = {{ scaleTuning(1116), scaleTuning(1188), scaleTuning(1277), scaleTuning(1356) }};
+	constexpr std::array<size_t, 2> allPassTunings = {{ scaleTuning(556), scaleTuning(441) }};
+	constexpr size_t stereoSpread = scaleTuning(23);
+
+	// Early reflections between 4 and 45 ms
+	constexpr size_t earlyLength = 2400;
+	constexpr size_t numTaps = 6;
+	constexpr std::array<size_t, numTaps> tapDelays = {{ 199, 761, 1039, 1381, 1823, 2203 }};
+	constexpr std::array<float, numTaps> tapGains = {{ 0.42f, 0.30f, 0.24f, 0.19f, 0.15f, 0.12f }};
+
+	constexpr float reverbInputGain = 0.03f;
+	constexpr float reverbTailGain = 3.0f;
+	constexpr float reverbEarlyGain = 0.5f;
+}
+
+AudioEffectContext::AudioEffectContext(AudioMixer& mixer, AudioBufferPool& pool, size_t numPacks, gsl::span<const float> sidechain)
+	: mixer(mixer)
+	, pool(pool)
+	, numPacks(numPacks)
+	, sidechain(sidechain)
+{}
+
+std::unique_ptr<AudioEffect> AudioEffect::make(const AudioEffectConfig& config)
+{
+	switch (config.type) {
+	case AudioEffectType::LowPass:
+	case AudioEffectType::HighPass:
+	case AudioEffectType::BandPass:
+	case AudioEffectType::Peak:
+		return std::make_unique<AudioBiquadFilter>(config);
+	case AudioEffectType::Compressor:
+		return std::make_unique<AudioCompressor>(config);
+	case AudioEffectType::Reverb:
+		return std::make_unique<AudioReverb>(config);
+	default:
+		throw Exception("Unknown audio effect type: " + toString(config.type), HalleyExceptions::AudioEngine);
+	}
+}
+
+AudioBiquadFilter::AudioBiquadFilter(const AudioEffectConfig& config)
+{
+	AudioBiquadFilter::setConfig(config);
+}
+
+void AudioBiquadFilter::setConfig(const AudioEffectConfig& config)
+{
+	const float freq = clamp(config.frequency, 10.0f, sampleRate * 0.45f);
+	const float w0 = 2.0f * PI_CONSTANT_F * freq / sampleRate;
+	const float cosW0 = std::cos(w0);
+	const float alpha = std::sin(w0) / (2.0f * std::max(config.q, 0.01f));
+
+	float a0 = 1.0f + alpha;
+	switch (config.type) {
+	case AudioEffectType::LowPass:
+		b0 = (1.0f - cosW0) * 0.5f;
+		b1 = 1.0f - cosW0;
+		b2 = b0;
+		break;
+	case AudioEffectType::HighPass:
+		b0 = (1.0f + cosW0) * 0.5f;
+		b1 = -(1.0f + cosW0);
+		b2 = b0;
+		break;
+	case AudioEffectType::BandPass:
+		b0 = alpha;
+		b1 = 0.0f;
+		b2 = -alpha;
+		break;
+	case AudioEffectType::Peak:
+		{
+			const float a = std::pow(10.0f, config.gainDb / 40.0f);
+			b0 = 1.0f + alpha * a;
+			b1 = -2.0f * cosW0;
+			b2 = 1.0f - alpha * a;
+			a0 = 1.0f + alpha / a;
+			a1 = -2.0f * cosW0 / a0;
+			a2 = (1.0f - alpha / a) / a0;
+			b0 /= a0;
+			b1 /= a0;
+			b2 /= a0;
+			return;
+		}
+	default:
+		throw Exception("Not a filter: " + toString(config.type), HalleyExceptions::AudioEngine);
+	}
+
+	b0 /= a0;
+	b1 /= a0;
+	b2 /= a0;
+	a1 = -2.0f * cosW0 / a0;
+	a2 = (1.0f - alpha) / a0;
+}
+
+void AudioBiquadFilter::process(gsl::span<AudioBuffer*> channels, const AudioEffectContext& context)
+{
+	const auto nChannels = size_t(channels.size());
+	if (state.size() < nChannels) {
+		state.resize(nChannels);
+	}
+
+	// The recursion makes each sample depend on the previous two, so this can't go wide within a channel
+	const size_t nSamples = context.numPacks * AudioSamplePack::NumSamples;
+	for (size_t c = 0; c < nChannels; ++c) {
+		float* samples = channels[c]->packs.data()->samples.data();
+		float z1 = state[c].z1;
+		float z2 = state[c].z2;
+		for (size_t i = 0; i < nSamples; ++i) {
+			const float x = samples[i];
+			const float y = b0 * x + z1;
+			z1 = b1 * x - a1 * y + z2;
+			z2 = b2 * x - a2 * y;
+			samples[i] = y;
+		}
+		state[c].z1 = undenormalise(z1);
+		state[c].z2 = undenormalise(z2);
+	}
+}
+
+AudioCompressor::AudioCompressor(const AudioEffectConfig& config)
+{
+	AudioCompressor::setConfig(config);
+}
+
+void AudioCompressor::setConfig(const AudioEffectConfig& config)
+{
+	thresholdDb = config.thresholdDb;
+	slope = 1.0f - 1.0f / std::max(config.ratio, 1.0f);
+	makeUpDb = config.gainDb;
+	attackCoef = std::exp(-1.0f / (std::max(config.attack, 0.0001f) * packRate));
+	releaseCoef = std::exp(-1.0f / (std::max(config.release, 0.0001f) * packRate));
+	keyed = !config.sidechain.isEmpty();
+}
+
+void AudioCompressor::process(gsl::span<AudioBuffer*> channels, const AudioEffectContext& context)
+{
+	const size_t numPacks = context.numPacks;
+	const auto nChannels = size_t(channels.size());
+	const auto nSidechain = size_t(context.sidechain.size());
+
+	auto gainsRef = context.pool.getBuffer(numPacks * AudioSamplePack::NumSamples);
+	auto gains = gainsRef.getSpan().subspan(0, numPacks);
+
+	for (size_t p = 0; p < numPacks; ++p) {
+		float level = 0.0f;
+		if (keyed) {
+			if (nSidechain > 0) {
+				level = context.sidechain[p * nSidechain / numPacks];
+			}
+		} else {
+			for (size_t c = 0; c < nChannels; ++c) {
+				for (auto s: channels[c]->packs[p].samples) {
+					level = std::max(level, std::abs(s));
+				}
+			}
+		}
+
+		envelope = level + (level > envelope ? attackCoef : releaseCoef) * (envelope - level);
+		envelope = undenormalise(envelope);
+		const float levelDb = envelope > 0.000001f ? 20.0f * std::log10(envelope) : -120.0f;
+		const float over = levelDb - thresholdDb;
+		const float gain = dbToGain(makeUpDb - (over > 0 ? over * slope : 0.0f));
+
+		auto& dst = gains[p].samples;
+		for (size_t i = 0; i < AudioSamplePack::NumSamples; ++i) {
+			dst[i] = lerp(lastGain, gain, float(i + 1) / AudioSamplePack::NumSamples);
+		}
+		lastGain = gain;
+	}
+
+	for (size_t c = 0; c < nChannels; ++c) {
+		context.mixer.multiplyAudio(gains, gsl::span<AudioSamplePack>(channels[c]->packs).subspan(0, numPacks));
+	}
+}
+
+AudioReverb::AudioReverb(const AudioEffectConfig& config)
+{
+	AudioReverb::setConfig(config);
+}
+
+void AudioReverb::setConfig(const AudioEffectConfig& config)
+{
+	feedback = 0.7f + 0.28f * clamp(config.roomSize, 0.0f, 1.0f);
+	damp = 0.4f * clamp(config.damping, 0.0f, 1.0f);
+	wet = config.wet;
+	dry = config.dry;
+}
+
+void AudioReverb::initChannel(Channel& channel, size_t index)
+{
+	// Odd channels get slightly longer delays, so the tail isn't identical on both sides
+	const size_t spread = (index & 1) * stereoSpread;
+	channel.early.buffer.resize(earlyLength, 0.0f);
+	for (size_t i = 0; i < numCombs; ++i) {
+		channel.combs[i].buffer.resize(combTunings[i] + spread, 0.0f);
+	}
+	for (size_t i = 0; i < numAllPasses; ++i) {
+		channel.allPasses[i].buffer.resize(allPassTunings[i] + spread, 0.0f);
+	}
+}
+
+void AudioReverb::process(gsl::span<AudioBuffer*> channels, const AudioEffectContext& context)
+{
+	const auto nChannels = size_t(channels.size());
+	while (state.size() < nChannels) {
+		state.emplace_back();
+		initChannel(state.back(), state.size() - 1);
+	}
+
+	const size_t nSamples = context.numPacks * AudioSamplePack::NumSamples;
+	for (size_t c = 0; c < nChannels; ++c) {
+		auto& ch = state[c];
+		float* samples = channels[c]->packs.data()->samples.data();
+
+		for (size_t i = 0; i < nSamples; ++i) {
+			const float x = samples[i];
+
+			// Early reflections
+			auto& early = ch.early;
+			early.buffer[early.pos] = x;
+			float er = 0.0f;
+			for (size_t t = 0; t < numTaps; ++t) {
+				er += tapGains[t] * early.buffer[(early.pos + earlyLength - tapDelays[t]) % earlyLength];
+			}
+			early.pos = (early.pos + 1) % earlyLength;
+
+			// Late tail: parallel damped combs...
+			const float input = (x + er) * reverbInputGain;
+			float tail = 0.0f;
+			for (auto& comb: ch.combs) {
+				const float out = comb.buffer[comb.pos];
+				comb.filterStore = undenormalise(out * (1.0f - damp) + comb.filterStore * damp);
+				comb.buffer[comb.pos] = input + comb.filterStore * feedback;
+				comb.pos = comb.pos + 1 == comb.buffer.size() ? 0 : comb.pos + 1;
+				tail += out;
+			}
+
+			// ...diffused by allpasses in series
+			for (auto& ap: ch.allPasses) {
+				const float bufOut = ap.buffer[ap.pos];
+				ap.buffer[ap.pos] = undenormalise(tail + bufOut * 0.5f);
+				ap.pos = ap.pos + 1 == ap.buffer.size() ? 0 : ap.pos + 1;
+				tail = bufOut - tail;
+			}
+
+			samples[i] = x * dry + (er * reverbEarlyGain + tail * reverbTailGain) * wet;
+		}
+	}
+}
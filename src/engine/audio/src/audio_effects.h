@@ -0,0 +1,115 @@
+#pragma once
+#include <gsl/span>
+#include <memory>
+#include <vector>
+#include "halley/core/api/audio_api.h"
+#include "audio_buffer.h"
+
+namespace Halley
+{
+	class AudioMixer;
+
+	struct AudioEffectContext
+	{
+		AudioMixer& mixer;
+		AudioBufferPool& pool;
+		size_t numPacks;
+		gsl::span<const float> sidechain; // Peak level of each pack in the sidechain group's most recent buffer, if any
+
+		AudioEffectContext(AudioMixer& mixer, AudioBufferPool& pool, size_t numPacks, gsl::span<const float> sidechain);
+	};
+
+	// One stage of a group's effect chain, processing its channels in place a whole buffer at a time, on the audio thread.
+	// Each one keeps its own state per channel, so changing the config in place (rather than making a new one) doesn't click.
+	class AudioEffect
+	{
+	public:
+		virtual ~AudioEffect() {}
+
+		virtual void setConfig(const AudioEffectConfig& config) = 0;
+		virtual void process(gsl::span<AudioBuffer*> channels, const AudioEffectContext& context) = 0;
+
+		static std::unique_ptr<AudioEffect> make(const AudioEffectConfig& config);
+	};
+
+	// RBJ cookbook biquads, in transposed direct form II
+	class AudioBiquadFilter final : public AudioEffect
+	{
+	public:
+		explicit AudioBiquadFilter(const AudioEffectConfig& config);
+
+		void setConfig(const AudioEffectConfig& config) override;
+		void process(gsl::span<AudioBuffer*> channels, const AudioEffectContext& context) override;
+
+	private:
+		struct State
+		{
+			float z1 = 0;
+			float z2 = 0;
+		};
+
+		float b0 = 1;
+		float b1 = 0;
+		float b2 = 0;
+		float a1 = 0;
+		float a2 = 0;
+		std::vector<State> state;
+	};
+
+	// Feed-forward compressor; the envelope is followed once per pack, and the gain is interpolated between packs
+	class AudioCompressor final : public AudioEffect
+	{
+	public:
+		explicit AudioCompressor(const AudioEffectConfig& config);
+
+		void setConfig(const AudioEffectConfig& config) override;
+		void process(gsl::span<AudioBuffer*> channels, const AudioEffectContext& context) override;
+
+	private:
+		float thresholdDb = 0;
+		float slope = 0;
+		float makeUpDb = 0;
+		float attackCoef = 0;
+		float releaseCoef = 0;
+		bool keyed = false;
+
+		float envelope = 0;
+		float lastGain = 1;
+	};
+
+	// A few sparse early reflection taps (a very short convolution), followed by a Schroeder-Moorer tail of damped combs into allpasses
+	class AudioReverb final : public AudioEffect
+	{
+	public:
+		explicit AudioReverb(const AudioEffectConfig& config);
+
+		void setConfig(const AudioEffectConfig& config) override;
+		void process(gsl::span<AudioBuffer*> channels, const AudioEffectContext& context) override;
+
+	private:
+		constexpr static size_t numCombs = 4;
+		constexpr static size_t numAllPasses = 2;
+
+		struct Delay
+		{
+			std::vector<float> buffer;
+			size_t pos = 0;
+			float filterStore = 0;
+		};
+
+		struct Channel
+		{
+			Delay early;
+			std::array<Delay, numCombs> combs;
+			std::array<Delay, numAllPasses> allPasses;
+		};
+
+		float feedback = 0;
+		float damp = 0;
+		float wet = 0;
+		float dry = 1;
+		std::vector<Channel> state;
+
+		void initChannel(Channel& channel, size_t index);
+	};
+}
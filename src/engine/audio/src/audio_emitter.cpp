@@ -3,6 +3,7 @@
 #include "audio_mixer.h"
 #include "audio_emitter_behaviour.h"
 #include "audio_source.h"
+#include "audio_profiler.h"
 #include "halley/support/logger.h"
 
 using namespace Halley;
@@ -96,12 +97,46 @@ float AudioEmitter::getGain() const
 	return gain;
 }
 
+float AudioEmitter::getAudibility() const
+{
+	return audibility;
+}
+
+void AudioEmitter::setVirtual(bool virt)
+{
+	if (virt == virtualised) {
+		return;
+	}
+
+	virtualised = virt;
+	if (virt) {
+		// Mix one last buffer, ramping down to silence
+		fadingOut = true;
+		channelMix.fill(0.0f);
+	} else {
+		// Ramp up from silence, from wherever playback has got to
+		fadingOut = false;
+		prevChannelMix.fill(0.0f);
+	}
+}
+
+bool AudioEmitter::isVirtual() const
+{
+	return virtualised;
+}
+
 size_t AudioEmitter::getNumberOfChannels() const
 {
 	return nChannels;
 }
 
 void AudioEmitter::update(gsl::span<const AudioChannelData> channels, const AudioListenerData& listener, float groupGain)
+{
+	updateBehaviour();
+	updateMix(channels, listener, groupGain);
+}
+
+void AudioEmitter::updateBehaviour()
 {
 	Expects(playing);
 
@@ -112,10 +147,34 @@ void AudioEmitter::update(gsl::span<const AudioChannelData> channels, const Audi
 		}
 		elapsedTime = 0;
 	}
+}
 
+void AudioEmitter::updateMix(gsl::span<const AudioChannelData> channels, const AudioListenerData& listener, float groupGain)
+{
 	prevChannelMix = channelMix;
 	sourcePos.setMix(nChannels, channels, channelMix, gain * groupGain, listener);
-	
+	onMixUpdated(gain * groupGain * sourcePos.getAttenuation(listener));
+}
+
+void AudioEmitter::updateMix(const AudioSpatialBatch& batch, size_t index, size_t nDstChannels)
+{
+	Expects(index < batch.count);
+
+	prevChannelMix = channelMix;
+	for (size_t i = 0; i < nDstChannels; ++i) {
+		channelMix[i] = batch.mix[i * batch.stride + index];
+	}
+	onMixUpdated(batch.gain[index] * batch.proximity[index]);
+}
+
+const AudioPosition::SpatialSource* AudioEmitter::getSpatialSource() const
+{
+	return nChannels == 1 ? sourcePos.getSingleSource() : nullptr;
+}
+
+void AudioEmitter::onMixUpdated(float value)
+{
+	audibility = value;
 	if (isFirstUpdate) {
 		prevChannelMix = channelMix;
 		isFirstUpdate = false;
@@ -127,6 +186,17 @@ void AudioEmitter::mixTo(size_t numSamples, gsl::span<AudioBuffer*> dst, AudioMi
 	Expects(dst.size() > 0);
 	Expects(numSamples % 16 == 0);
 
+	if (virtualised && !fadingOut) {
+		AudioProfiler::Scope scope(AudioProfileStage::Decoder);
+		const bool isPlaying = source->skipAudioData(numSamples);
+		advancePlayback(numSamples);
+		if (!isPlaying) {
+			stop();
+		}
+		return;
+	}
+	fadingOut = false;
+
 	const size_t numPacks = numSamples / 16;
 	Expects(dst[0]->packs.size() >= numPacks);
 	const size_t nSrcChannels = getNumberOfChannels();
@@ -149,10 +219,15 @@ void AudioEmitter::mixTo(size_t numSamples, gsl::span<AudioBuffer*> dst, AudioMi
 		audioData[srcChannel] = bufferRefs[srcChannel].getSpan().subspan(0, numPacks);
 		audioSampleData[srcChannel] = audioData[srcChannel].data()->samples;
 	}
-	bool isPlaying = source->getAudioData(numSamples, audioSampleData);
+	bool isPlaying;
+	{
+		AudioProfiler::Scope scope(AudioProfileStage::Decoder);
+		isPlaying = source->getAudioData(numSamples, audioSampleData, pool);
+	}
 
 	// If we're audible, render
 	if (totalMix >= 0.0001f) {
+		AudioProfiler::Scope scope(AudioProfileStage::Mixer);
 		// Render each emitter channel
 		for (size_t srcChannel = 0; srcChannel < nSrcChannels; ++srcChannel) {
 			// Read to buffer
@@ -9,6 +9,7 @@ namespace Halley {
 	class AudioMixer;
 	class AudioEmitterBehaviour;
 	class AudioSource;
+	struct AudioSpatialBatch;
 
 	class AudioEmitter {
     public:
@@ -27,9 +28,16 @@ namespace Halley {
 		void setAudioSourcePosition(AudioPosition sourcePos);
 
 		float getGain() const;
+		float getAudibility() const;
 		size_t getNumberOfChannels() const;
 
 		void update(gsl::span<const AudioChannelData> channels, const AudioListenerData& listener, float groupGain);
+
+		// update() in two steps, so the mix can be set from an AudioSpatialBatch instead, if there's getSpatialSource()
+		void updateBehaviour();
+		void updateMix(gsl::span<const AudioChannelData> channels, const AudioListenerData& listener, float groupGain);
+		void updateMix(const AudioSpatialBatch& batch, size_t index, size_t nDstChannels);
+		const AudioPosition::SpatialSource* getSpatialSource() const;
 		void mixTo(size_t numSamples, gsl::span<AudioBuffer*> dst, AudioMixer& mixer, AudioBufferPool& pool);
 		
 		void setId(size_t id);
@@ -39,6 +47,10 @@ namespace Halley {
 		
 		int getGroup() const;
 
+		// Virtual emitters keep advancing, but don't decode or mix anything
+		void setVirtual(bool virt);
+		bool isVirtual() const;
+
 	private:
 		std::shared_ptr<AudioSource> source;
 		std::shared_ptr<AudioEmitterBehaviour> behaviour;
@@ -48,8 +60,11 @@ namespace Halley {
 		bool playing = false;
 		bool done = false;
 		bool isFirstUpdate = true;
+		bool virtualised = false;
+		bool fadingOut = false;
     	float gain;
 		float elapsedTime = 0.0f;
+		float audibility = 0.0f;
 
 		size_t nChannels = 0;
 		std::array<float, 16> channelMix;
@@ -58,5 +73,6 @@ namespace Halley {
 		size_t id = std::numeric_limits<size_t>::max();
 
 		void advancePlayback(size_t samples);
+		void onMixUpdated(float audibility);
     };
 }
@@ -1,12 +1,15 @@
 #include "audio_engine.h"
 #include "audio_mixer.h"
+#include "audio_profiler.h"
 #include <thread>
 #include <chrono>
+#include <limits>
 #include "audio_source_clip.h"
 #include "audio_filter_resample.h"
 #include "halley/support/debug.h"
 #include "halley/core/resources/resources.h"
 #include "audio_event.h"
+#include "halley/concurrency/concurrent.h"
 
 using namespace Halley;
 
@@ -15,12 +18,18 @@ AudioEngine::AudioEngine()
 	, pool(std::make_unique<AudioBufferPool>())
 	, running(true)
 	, needsBuffer(true)
+	, lastNumVoices(0)
+	, lastNumVirtualVoices(0)
+	, lastNumEmitters(0)
 {
 	rng.setSeed(Random::getGlobal().getRawInt());
+	Telemetry::addSource(*this);
 }
 
 AudioEngine::~AudioEngine()
 {
+	Telemetry::removeSource(*this);
+	voiceThreads.reset();
 }
 
 void AudioEngine::postEvent(size_t id, std::shared_ptr<const AudioEvent> event, const AudioPosition& position)
@@ -101,10 +110,25 @@ void AudioEngine::start(AudioSpec s, AudioOutputAPI& o)
 	channels[1].pan = 1.0f;
 
 	if (spec.sampleRate != 48000) {
-		outResampler = std::make_unique<AudioResampler>(48000, spec.sampleRate, spec.numChannels, Debug::isDebug() ? 0.0f : 0.5f);
+		outResampler = std::make_unique<AudioPolyphaseResampler>(48000, spec.sampleRate, size_t(spec.numChannels), Debug::isDebug() ? AudioResamplerQuality::Fast : AudioResamplerQuality::High);
 	}
 }
 
+void AudioEngine::startVoiceThreads(ThreadPool::MakeThread makeThread)
+{
+#if HAS_THREADS
+	// Keep it small, as the game itself still needs the other cores
+	const size_t nCores = std::thread::hardware_concurrency();
+	const size_t nThreads = nCores > 2 ? std::min(size_t(3), nCores / 2) : 0;
+	if (nThreads > 0 && !voiceThreads) {
+		for (size_t i = 0; i < nThreads; ++i) {
+			voicePools.push_back(std::make_unique<AudioBufferPool>());
+		}
+		voiceThreads = std::make_unique<ThreadPool>("Audio Voices", voiceQueue, nThreads, std::move(makeThread));
+	}
+#endif
+}
+
 void AudioEngine::resume()
 {
 	running = true;
@@ -130,11 +154,15 @@ void AudioEngine::generateBuffer()
 
 	auto bufferRef = pool->getBuffer(samplesToRead * numChannels);
 	auto buffer = bufferRef.getSpan().subspan(0, packsToRead * numChannels);
-	mixer->interleaveChannels(buffer, channelBuffers);
-	mixer->compressRange(buffer);
+	{
+		AudioProfiler::Scope scope(AudioProfileStage::Mixer);
+		mixer->interleaveChannels(buffer, channelBuffers);
+		mixer->compressRange(buffer);
+	}
 
 	// Resample to output sample rate, if necessary
 	if (outResampler) {
+		AudioProfiler::Scope scope(AudioProfileStage::Resampler);
 		auto resampledBuffer = pool->getBuffer(samplesToRead * numChannels * spec.sampleRate / 48000 + 16);
 		auto result = outResampler->resampleInterleaved(bufferRef.getSampleSpan().subspan(0, samplesToRead * numChannels), resampledBuffer.getSampleSpan());
 		if (result.nRead != samplesToRead) {
@@ -163,27 +191,357 @@ void AudioEngine::setMasterGain(float gain)
 
 void AudioEngine::setGroupGain(const String& name, float gain)
 {
-	groupGains[getGroupId(name)] = gain;
+	buses[getGroupId(name)].gain = gain;
 }
 
-void AudioEngine::mixEmitters(size_t numSamples, size_t nChannels, gsl::span<AudioBuffer*> buffers)
+void AudioEngine::setGroupParent(const String& name, const String& parent)
+{
+	const int id = getGroupId(name);
+	const int parentId = parent.isEmpty() ? -1 : getGroupId(parent);
+	for (int p = parentId; p != -1; p = buses[p].parent) {
+		if (p == id) {
+			throw Exception("Routing audio group \"" + name + "\" into \"" + parent + "\" would create a cycle.", HalleyExceptions::AudioEngine);
+		}
+	}
+	buses[id].parent = parentId;
+	routingDirty = true;
+}
+
+void AudioEngine::setGroupListener(const String& name, Maybe<AudioListenerData> l)
 {
-	// Clear buffers
-	for (size_t i = 0; i < nChannels; ++i) {
-		clearBuffer(buffers[i]->packs);
+	buses[getGroupId(name)].listener = l;
+}
+
+void AudioEngine::setGroupEffects(const String& name, std::vector<AudioEffectConfig> configs)
+{
+	const int id = getGroupId(name);
+	std::vector<int> sidechains;
+	for (auto& config: configs) {
+		sidechains.push_back(config.sidechain.isEmpty() ? -1 : getGroupId(config.sidechain));
+	}
+
+	// If it's the same chain with different settings, keep the effects' state (filter history, reverb tails)
+	auto& effects = buses[id].effects;
+	const bool sameChain = effects.size() == configs.size() && std::equal(effects.begin(), effects.end(), configs.begin(), [] (const BusEffect& e, const AudioEffectConfig& c)
+	{
+		return e.type == c.type;
+	});
+
+	if (sameChain) {
+		for (size_t i = 0; i < configs.size(); ++i) {
+			effects[i].effect->setConfig(configs[i]);
+			effects[i].sidechain = sidechains[i];
+		}
+	} else {
+		effects.clear();
+		for (size_t i = 0; i < configs.size(); ++i) {
+			BusEffect e;
+			e.type = configs[i].type;
+			e.sidechain = sidechains[i];
+			e.effect = AudioEffect::make(configs[i]);
+			effects.push_back(std::move(e));
+		}
 	}
+	routingDirty = true;
+}
+
+void AudioEngine::setMaxVoices(size_t n)
+{
+	maxVoices = n;
+}
 
-	// Mix every emitter
+void AudioEngine::setGroupMaxVoices(const String& name, size_t n)
+{
+	buses[getGroupId(name)].maxVoices = n;
+}
+
+void AudioEngine::setMixer(std::unique_ptr<AudioMixer> m)
+{
+	Expects(m);
+	mixer = std::move(m);
+}
+
+size_t AudioEngine::getNumVoices() const
+{
+	return voices.size();
+}
+
+size_t AudioEngine::getNumVirtualVoices() const
+{
+	return virtualVoices.size();
+}
+
+void AudioEngine::getTelemetry(std::vector<TelemetryValue>& values) const
+{
+	values.emplace_back("audio.voices", double(lastNumVoices.load(std::memory_order_relaxed)));
+	values.emplace_back("audio.virtualVoices", double(lastNumVirtualVoices.load(std::memory_order_relaxed)));
+	values.emplace_back("audio.emitters", double(lastNumEmitters.load(std::memory_order_relaxed)));
+}
+
+void AudioEngine::updateVoices()
+{
+	voices.clear();
+	virtualVoices.clear();
+
+	// Bus gains are applied to each emitter rather than to the bus' mix, so that they count towards its audibility
+	groupTotalGains.resize(buses.size());
+	for (size_t i = 0; i < buses.size(); ++i) {
+		groupTotalGains[i] = masterGain * getGroupGain(int(i));
+	}
+
+	spatialBatch.clear();
 	for (auto& e: emitters) {
 		// Start playing if necessary
 		if (!e->isPlaying() && !e->isDone() && e->isReady()) {
 			e->start();
 		}
 
-		// Mix it in!
 		if (e->isPlaying()) {
-			e->update(channels, listener, masterGain * getGroupGain(e->getGroup()));
-			e->mixTo(numSamples, buffers, *mixer, *pool);
+			const int group = e->getGroup();
+			const auto& groupListener = getGroupListener(group);
+			e->updateBehaviour();
+			if (const auto* source = e->getSpatialSource()) {
+				// Mixed all at once below
+				spatialBatch.add(source->pos - groupListener.position, groupListener.referenceDistance, source->referenceDistance, source->maxDistance, e->getGain() * groupTotalGains[group]);
+			} else {
+				e->updateMix(channels, groupListener, groupTotalGains[group]);
+			}
+			voices.push_back(e.get());
+		}
+	}
+
+	if (spatialBatch.count > 0) {
+		spatialBatch.finish(channels.size());
+		mixer->spatialize(spatialBatch, channels);
+		size_t idx = 0;
+		for (auto* e: voices) {
+			if (e->getSpatialSource()) {
+				e->updateMix(spatialBatch, idx++, channels.size());
+			}
+		}
+		Ensures(idx == spatialBatch.count);
+	}
+
+	// Voices that already have a real voice get a bit of an edge, so two similar ones don't keep trading places
+	constexpr float hysteresis = 1.25f;
+	const auto getPriority = [] (const AudioEmitter* e) { return e->getAudibility() * (e->isVirtual() ? 1.0f : hysteresis); };
+	std::stable_sort(voices.begin(), voices.end(), [&] (const AudioEmitter* a, const AudioEmitter* b)
+	{
+		return getPriority(a) > getPriority(b);
+	});
+
+	groupVoiceCount.assign(buses.size(), 0);
+	size_t nReal = 0;
+	size_t nMixed = 0;
+	for (auto* e: voices) {
+		const int group = e->getGroup();
+		const bool real = e->getAudibility() >= 0.0001f && nReal < maxVoices && groupVoiceCount[group] < buses[group].maxVoices;
+		if (real) {
+			++nReal;
+			++groupVoiceCount[group];
+		}
+
+		// Voices that just went virtual still need to be mixed this time, to fade out
+		const bool wasVirtual = e->isVirtual();
+		e->setVirtual(!real);
+		if (real || !wasVirtual) {
+			voices[nMixed++] = e;
+		} else {
+			virtualVoices.push_back(e);
+		}
+	}
+	voices.resize(nMixed);
+
+	lastNumVoices.store(nReal, std::memory_order_relaxed);
+	lastNumVirtualVoices.store(virtualVoices.size(), std::memory_order_relaxed);
+	lastNumEmitters.store(emitters.size(), std::memory_order_relaxed);
+}
+
+void AudioEngine::updateRouting()
+{
+	for (auto& bus: buses) {
+		bus.isSidechain = false;
+	}
+	for (auto& bus: buses) {
+		for (auto& e: bus.effects) {
+			if (e.sidechain >= 0) {
+				buses[e.sidechain].isSidechain = true;
+			}
+		}
+	}
+
+	// Deepest first, so each bus has had everything mixed into it before it runs its own effects
+	std::vector<size_t> depth(buses.size(), 0);
+	processOrder.clear();
+	for (size_t i = 0; i < buses.size(); ++i) {
+		for (int p = buses[i].parent; p != -1; p = buses[p].parent) {
+			++depth[i];
+		}
+		if (!buses[i].effects.empty() || buses[i].isSidechain) {
+			processOrder.push_back(int(i));
+		}
+	}
+	std::stable_sort(processOrder.begin(), processOrder.end(), [&] (int a, int b) { return depth[a] > depth[b]; });
+
+	std::vector<size_t> ownSlot(buses.size(), 0);
+	for (size_t i = 0; i < processOrder.size(); ++i) {
+		ownSlot[processOrder[i]] = i + 1;
+	}
+	const auto findSlot = [&] (int id) -> size_t
+	{
+		for (int b = id; b != -1; b = buses[b].parent) {
+			if (ownSlot[b] != 0) {
+				return ownSlot[b];
+			}
+		}
+		return 0;
+	};
+
+	for (size_t i = 0; i < buses.size(); ++i) {
+		auto& bus = buses[i];
+		bus.slot = findSlot(int(i));
+		bus.outSlot = findSlot(bus.parent);
+		if (!bus.isSidechain) {
+			bus.levels.clear();
+		}
+	}
+
+	routingDirty = false;
+}
+
+std::vector<AudioBuffer*> AudioEngine::getSlotBuffers(size_t nChannels, size_t numSamples, gsl::span<AudioBuffer*> output, std::vector<AudioBuffersRef>& refs, AudioBufferPool& bufferPool)
+{
+	// Each slot is one buffer per channel, laid out one slot after the other; slot 0 is the output, if one is given
+	const size_t numPacks = numSamples / AudioSamplePack::NumSamples;
+	const size_t nSlots = processOrder.size() + 1;
+	std::vector<AudioBuffer*> result;
+	result.reserve(nSlots * nChannels);
+	refs.reserve(nSlots);
+
+	for (size_t slot = 0; slot < nSlots; ++slot) {
+		gsl::span<AudioBuffer*> slotBuffers = output;
+		if (slot > 0 || output.empty()) {
+			refs.push_back(bufferPool.getBuffers(nChannels, numSamples));
+			slotBuffers = refs.back().getBuffers();
+		}
+		for (auto* b: slotBuffers) {
+			clearBuffer(gsl::span<AudioSamplePack>(b->packs).subspan(0, numPacks));
+			result.push_back(b);
+		}
+	}
+	return result;
+}
+
+void AudioEngine::mixEmitters(size_t numSamples, size_t nChannels, gsl::span<AudioBuffer*> buffers)
+{
+	if (routingDirty) {
+		updateRouting();
+	}
+
+	updateVoices();
+
+	const size_t numPacks = numSamples / AudioSamplePack::NumSamples;
+	std::vector<AudioBuffersRef> busBuffers;
+	auto slots = getSlotBuffers(nChannels, numSamples, buffers, busBuffers, *pool);
+
+	// Virtual voices don't render anything, so they're cheap enough to just advance here
+	for (auto* e: virtualVoices) {
+		e->mixTo(numSamples, gsl::span<AudioBuffer*>(slots).subspan(buses[e->getGroup()].slot * nChannels, nChannels), *mixer, *pool);
+	}
+
+	// Not worth waking other threads for just a few voices
+	constexpr size_t minVoicesPerJob = 8;
+	const size_t nVoices = voices.size();
+	const size_t nJobs = std::min(voicePools.size() + 1, std::max(size_t(1), nVoices / minVoicesPerJob));
+	if (nJobs == 1) {
+		mixVoiceRange(0, nVoices, numSamples, nChannels, slots, *pool);
+	} else {
+		// Each job always gets the same contiguous range of voices and mixes it into its own buffers, which are then summed in order,
+		// so the output doesn't depend on how the threads were scheduled
+		std::vector<std::vector<AudioBuffersRef>> jobBuffers(nJobs - 1);
+		std::vector<std::vector<AudioBuffer*>> jobSlots(nJobs - 1);
+		std::vector<std::exception_ptr> jobErrors(nJobs - 1);
+		std::vector<Future<void>> tasks;
+		for (size_t job = 1; job < nJobs; ++job) {
+			auto& jobPool = *voicePools[job - 1];
+			auto& dst = jobSlots[job - 1];
+			dst = getSlotBuffers(nChannels, numSamples, gsl::span<AudioBuffer*>(), jobBuffers[job - 1], jobPool);
+
+			const size_t start = nVoices * job / nJobs;
+			const size_t end = nVoices * (job + 1) / nJobs;
+			auto& error = jobErrors[job - 1];
+			tasks.push_back(Concurrent::execute(voiceQueue, [this, start, end, numSamples, nChannels, &dst, &jobPool, &error] ()
+			{
+				try {
+					mixVoiceRange(start, end, numSamples, nChannels, dst, jobPool);
+				} catch (...) {
+					error = std::current_exception();
+				}
+			}));
+		}
+
+		// The first range is mixed here, straight into the output
+		mixVoiceRange(0, nVoices / nJobs, numSamples, nChannels, slots, *pool);
+		Concurrent::whenAll(tasks.begin(), tasks.end()).get();
+
+		for (auto& error: jobErrors) {
+			if (error) {
+				std::rethrow_exception(error);
+			}
+		}
+
+		AudioProfiler::Scope scope(AudioProfileStage::Mixer);
+		for (auto& src: jobSlots) {
+			for (size_t i = 0; i < slots.size(); ++i) {
+				mixer->mixAudio(gsl::span<const AudioSamplePack>(src[i]->packs).subspan(0, numPacks), gsl::span<AudioSamplePack>(slots[i]->packs).subspan(0, numPacks), 1.0f, 1.0f);
+			}
+		}
+	}
+
+	processBuses(numPacks, nChannels, slots);
+}
+
+void AudioEngine::mixVoiceRange(size_t start, size_t end, size_t numSamples, size_t nChannels, gsl::span<AudioBuffer*> slots, AudioBufferPool& pool)
+{
+	for (size_t i = start; i < end; ++i) {
+		voices[i]->mixTo(numSamples, slots.subspan(buses[voices[i]->getGroup()].slot * nChannels, nChannels), *mixer, pool);
+	}
+}
+
+void AudioEngine::processBuses(size_t numPacks, size_t nChannels, gsl::span<AudioBuffer*> slots)
+{
+	if (processOrder.empty()) {
+		return;
+	}
+
+	AudioProfiler::Scope scope(AudioProfileStage::Effects);
+	for (int id: processOrder) {
+		auto& bus = buses[id];
+		auto busChannels = slots.subspan(bus.slot * nChannels, nChannels);
+
+		for (auto& e: bus.effects) {
+			// Keyed on whatever the sidechain bus produced last, which is the previous buffer if it's processed after this one
+			gsl::span<const float> sidechain;
+			if (e.sidechain >= 0) {
+				sidechain = buses[e.sidechain].levels;
+			}
+			e.effect->process(busChannels, AudioEffectContext(*mixer, *pool, numPacks, sidechain));
+		}
+
+		if (bus.isSidechain) {
+			bus.levels.assign(numPacks, 0.0f);
+			for (auto* channel: busChannels) {
+				for (size_t p = 0; p < numPacks; ++p) {
+					for (auto s: channel->packs[p].samples) {
+						bus.levels[p] = std::max(bus.levels[p], std::abs(s));
+					}
+				}
+			}
+		}
+
+		auto dst = slots.subspan(bus.outSlot * nChannels, nChannels);
+		for (size_t i = 0; i < nChannels; ++i) {
+			mixer->mixAudio(gsl::span<const AudioSamplePack>(busChannels[i]->packs).subspan(0, numPacks), gsl::span<AudioSamplePack>(dst[i]->packs).subspan(0, numPacks), 1.0f, 1.0f);
 		}
 	}
 }
@@ -217,17 +575,32 @@ void AudioEngine::clearBuffer(gsl::span<AudioSamplePack> dst)
 
 int AudioEngine::getGroupId(const String& group)
 {
-	auto iter = std::find(groupNames.begin(), groupNames.end(), group);
-	if (iter != groupNames.end()) {
-		return iter - groupNames.begin();
+	auto iter = std::find_if(buses.begin(), buses.end(), [&] (const MixBus& bus) { return bus.name == group; });
+	if (iter != buses.end()) {
+		return int(iter - buses.begin());
 	} else {
-		groupNames.push_back(group);
-		groupGains.push_back(1.0f);
-		return int(groupNames.size()) - 1;
+		buses.emplace_back();
+		buses.back().name = group;
+		routingDirty = true;
+		return int(buses.size()) - 1;
 	}
 }
 
 float AudioEngine::getGroupGain(int id) const
 {
-	return groupGains[id];
+	float gain = 1.0f;
+	for (int b = id; b != -1; b = buses[b].parent) {
+		gain *= buses[b].gain;
+	}
+	return gain;
+}
+
+const AudioListenerData& AudioEngine::getGroupListener(int id) const
+{
+	for (int b = id; b != -1; b = buses[b].parent) {
+		if (buses[b].listener) {
+			return buses[b].listener.get();
+		}
+	}
+	return listener;
 }
@@ -1,21 +1,25 @@
 #pragma once
 #include "audio_buffer.h"
-#include <mutex>
+#include "audio_effects.h"
+#include "audio_mixer.h"
+#include <limits>
 #include <atomic>
-#include <condition_variable>
 #include <map>
 #include <vector>
 #include "audio_emitter.h"
-#include "halley/audio/resampler.h"
+#include "halley/audio/polyphase_resampler.h"
 #include "halley/maths/random.h"
 #include "halley/data_structures/flat_map.h"
+#include "halley/data_structures/maybe.h"
+#include "halley/concurrency/executor.h"
+#include "halley/support/telemetry.h"
 
 namespace Halley {
 	class AudioMixer;
 	class IAudioClip;
 	class Resources;
 
-    class AudioEngine
+    class AudioEngine : public ITelemetrySource
     {
     public:
 	    AudioEngine();
@@ -33,6 +37,7 @@ namespace Halley {
 
 		void run();
 		void start(AudioSpec spec, AudioOutputAPI& out);
+		void startVoiceThreads(ThreadPool::MakeThread makeThread);
 		void resume();
 		void pause();
 
@@ -45,17 +50,30 @@ namespace Halley {
 		void setGroupGain(const String& name, float gain);
 		int getGroupId(const String& group);
 
+		// See AudioAPI::setGroupParent()
+		void setGroupParent(const String& name, const String& parent);
+		void setGroupListener(const String& name, Maybe<AudioListenerData> listener);
+		void setGroupEffects(const String& name, std::vector<AudioEffectConfig> effects);
+
+		// Only the most audible emitters are actually mixed, the others are virtualised
+		void setMaxVoices(size_t n);
+		void setGroupMaxVoices(const String& name, size_t n);
+
+		void setMixer(std::unique_ptr<AudioMixer> mixer);
+		size_t getNumVoices() const; // In the last buffer
+		size_t getNumVirtualVoices() const;
+
+		void getTelemetry(std::vector<TelemetryValue>& values) const override; // Safe from any thread
+
     private:
 		AudioSpec spec;
 		AudioOutputAPI* out;
 		std::unique_ptr<AudioMixer> mixer;
 		std::unique_ptr<AudioBufferPool> pool;
-		std::unique_ptr<AudioResampler> outResampler;
+		std::unique_ptr<AudioPolyphaseResampler> outResampler;
 
 		std::atomic<bool> running;
 		std::atomic<bool> needsBuffer;
-		std::mutex mutex;
-		std::condition_variable backBufferCondition;
 
 		std::vector<std::unique_ptr<AudioEmitter>> emitters;
 		std::vector<AudioChannelData> channels;
@@ -63,18 +81,72 @@ namespace Halley {
 		std::map<size_t, std::vector<AudioEmitter*>> idToSource;
 		std::vector<AudioEmitter*> dummyIdSource;
 
+		// Each group is a mix bus. Only the ones that have effects (or key another's compressor) get their own buffers, and the
+		// others just mix straight into their closest ancestor that does, so plain groups cost nothing over a flat mix.
+		struct BusEffect
+		{
+			AudioEffectType type;
+			int sidechain = -1;
+			std::unique_ptr<AudioEffect> effect;
+		};
+
+		struct MixBus
+		{
+			String name;
+			float gain = 1.0f;
+			size_t maxVoices = std::numeric_limits<size_t>::max();
+			int parent = -1; // The master
+			Maybe<AudioListenerData> listener;
+			std::vector<BusEffect> effects;
+
+			// Set by updateRouting()
+			size_t slot = 0; // Where its emitters mix to, 0 being the output
+			size_t outSlot = 0; // Where its own buffers mix to, if it has them
+			bool isSidechain = false;
+			std::vector<float> levels; // Peak of each pack in its last buffer, if it's a sidechain
+
+			MixBus() = default;
+			MixBus(const MixBus& other) = delete;
+			MixBus(MixBus&& other) = default;
+		};
+
 		float masterGain = 1.0f;
-		std::vector<String> groupNames;
-    	std::vector<float> groupGains;
+		std::vector<MixBus> buses;
+		std::vector<int> processOrder; // Buses with their own buffers, children before parents
+		bool routingDirty = true;
+		size_t maxVoices = 64;
+
+		// Rebuilt for every buffer
+		std::vector<AudioEmitter*> voices;
+		std::vector<AudioEmitter*> virtualVoices;
+		std::vector<size_t> groupVoiceCount;
+		std::vector<float> groupTotalGains;
+		AudioSpatialBatch spatialBatch;
+
+		// Copies of the counts above, for telemetry from other threads
+		std::atomic<size_t> lastNumVoices;
+		std::atomic<size_t> lastNumVirtualVoices;
+		std::atomic<size_t> lastNumEmitters;
 
 		AudioListenerData listener;
 
 		Random rng;
 
+		// Voices are split between the audio thread and these, each mixing with its own scratch pool
+		ExecutionQueue voiceQueue;
+		std::vector<std::unique_ptr<AudioBufferPool>> voicePools;
+		std::unique_ptr<ThreadPool> voiceThreads;
+
+		void updateVoices();
+		void updateRouting();
 		void mixEmitters(size_t numSamples, size_t channels, gsl::span<AudioBuffer*> buffers);
+		void mixVoiceRange(size_t start, size_t end, size_t numSamples, size_t nChannels, gsl::span<AudioBuffer*> slots, AudioBufferPool& pool);
+		void processBuses(size_t numPacks, size_t nChannels, gsl::span<AudioBuffer*> slots);
+		std::vector<AudioBuffer*> getSlotBuffers(size_t nChannels, size_t numSamples, gsl::span<AudioBuffer*> output, std::vector<AudioBuffersRef>& refs, AudioBufferPool& pool);
 	    void removeFinishedEmitters();
 		void clearBuffer(gsl::span<AudioSamplePack> dst);
 
-    	float getGroupGain(int group) const;
+    	float getGroupGain(int group) const; // Including its ancestors'
+		const AudioListenerData& getGroupListener(int group) const;
     };
 }
@@ -128,7 +128,7 @@ void AudioEventActionPlay::run(AudioEngine& engine, size_t id, const AudioPositi
 
 	std::shared_ptr<AudioSource> source = std::make_shared<AudioSourceClip>(clip, loop, lround(delay * sampleRate));
 	if (std::abs(curPitch - 1.0f) > 0.01f) {
-		source = std::make_shared<AudioFilterResample>(source, int(lround(sampleRate * curPitch)), sampleRate, engine.getPool());
+		source = std::make_shared<AudioFilterResample>(source, int(lround(sampleRate * curPitch)), sampleRate);
 	}
 	engine.addEmitter(id, std::make_unique<AudioEmitter>(source, position, curVolume, engine.getGroupId(group)));
 }
@@ -177,9 +177,23 @@ void AudioEventActionPlay::loadDependencies(const Resources& resources)
 	}
 }
 
+void AudioEventActionPlay::getClips(std::vector<String>& result) const
+{
+	result.insert(result.end(), clips.begin(), clips.end());
+}
+
 void AudioEvent::loadDependencies(Resources& resources) const
 {
 	for (auto& a: actions) {
 		a->loadDependencies(resources);
 	}
 }
+
+std::vector<String> AudioEvent::getClips() const
+{
+	std::vector<String> result;
+	for (auto& a: actions) {
+		a->getClips(result);
+	}
+	return result;
+}
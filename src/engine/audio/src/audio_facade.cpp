@@ -14,6 +14,8 @@ AudioFacade::AudioFacade(AudioOutputAPI& o, SystemAPI& system)
 	, system(system)
 	, running(false)
 	, started(false)
+	, commands(2048)
+	, playingSoundsQueue(4)
 	, ownAudioThread(o.needsAudioThread())
 {
 }
@@ -57,9 +59,10 @@ void AudioFacade::startPlayback(int deviceNumber)
 	auto devices = getAudioDevices();
 	if (int(devices.size()) > deviceNumber) {
 		engine = std::make_unique<AudioEngine>();
+		engine->startVoiceThreads([this] (String name, std::function<void()> runnable) { return system.createThread(name, ThreadPriority::Realtime, runnable); });
 
 		AudioSpec format;
-		format.bufferSize = 512;
+		format.bufferSize = bufferSize;
 		format.format = AudioSampleFormat::Float;
 		format.numChannels = 2;
 		format.sampleRate = 48000;
@@ -73,7 +76,7 @@ void AudioFacade::startPlayback(int deviceNumber)
 			std::cout << "\tSample rate: " << audioSpec.sampleRate << "\n";
 			std::cout << "\tChannels: " << audioSpec.numChannels << "\n";
 			std::cout << "\tFormat: " << toString(audioSpec.format) << "\n";
-			std::cout << "\tBuffer size: " << audioSpec.bufferSize << std::endl;
+			std::cout << "\tBuffer size: " << audioSpec.bufferSize << " (" << toString(1000.0f * audioSpec.bufferSize / audioSpec.sampleRate, 1) << " ms)" << std::endl;
 
 			resumePlayback();
 		} catch (...) {
@@ -82,10 +85,16 @@ void AudioFacade::startPlayback(int deviceNumber)
 	}
 }
 
+void AudioFacade::setBufferSize(int samples)
+{
+	bufferSize = clamp(samples, AudioSpec::minBufferSize, AudioSpec::maxBufferSize);
+}
+
 void AudioFacade::stopPlayback()
 {
 	if (started) {
 		pausePlayback();
+		clearCommands();
 		musicTracks.clear();
 		engine.reset();
 		output.closeAudioDevice();
@@ -104,7 +113,7 @@ void AudioFacade::resumePlayback()
 		running = true;
 
 		if (ownAudioThread) {
-			audioThread = system.createThread("Audio", ThreadPriority::High, [this]() { run(); });
+			audioThread = system.createThread("Audio", ThreadPriority::Realtime, [this]() { run(); });
 		}
 
 		output.startPlayback();
@@ -114,11 +123,8 @@ void AudioFacade::resumePlayback()
 void AudioFacade::pausePlayback()
 {
 	if (running) {
-		{
-			std::unique_lock<std::mutex> lock(audioMutex);
-			running = false;
-			engine->pause();
-		}
+		running = false;
+		engine->pause();
 		if (ownAudioThread) {
 			audioThread.join();
 			audioThread = {};
@@ -211,6 +217,20 @@ void AudioFacade::setGroupVolume(const String& groupName, float volume)
 	});
 }
 
+void AudioFacade::setMaxVoices(size_t maxVoices)
+{
+	enqueue([=] () {
+		engine->setMaxVoices(maxVoices);
+	});
+}
+
+void AudioFacade::setGroupMaxVoices(const String& groupName, size_t maxVoices)
+{
+	enqueue([=] () {
+		engine->setGroupMaxVoices(groupName, maxVoices);
+	});
+}
+
 void AudioFacade::setOutputChannels(std::vector<AudioChannelData> audioChannelData)
 {
 	enqueue([=, audioChannelData = std::move(audioChannelData)] () mutable
@@ -242,6 +262,35 @@ void AudioFacade::setListener(AudioListenerData listener)
 	});
 }
 
+void AudioFacade::setGroupParent(const String& groupName, const String& parentName)
+{
+	enqueue([=] () {
+		engine->setGroupParent(groupName, parentName);
+	});
+}
+
+void AudioFacade::setGroupListener(const String& groupName, AudioListenerData listener)
+{
+	enqueue([=] () {
+		engine->setGroupListener(groupName, listener);
+	});
+}
+
+void AudioFacade::clearGroupListener(const String& groupName)
+{
+	enqueue([=] () {
+		engine->setGroupListener(groupName, {});
+	});
+}
+
+void AudioFacade::setGroupEffects(const String& groupName, std::vector<AudioEffectConfig> effects)
+{
+	enqueue([=, effects = std::move(effects)] () mutable
+	{
+		engine->setGroupEffects(groupName, std::move(effects));
+	});
+}
+
 void AudioFacade::onAudioException(std::exception& e)
 {
 	std::unique_lock<std::mutex> lock(exceptionMutex);
@@ -258,20 +307,18 @@ void AudioFacade::run()
 void AudioFacade::stepAudio()
 {
 	try {
-		{
-			std::unique_lock<std::mutex> lock(audioMutex);
-			if (!running) {
-				return;
-			}
-			std::swap(inbox, inboxProcessing);
-			inbox.clear();
-			playingSoundsNext = engine->getPlayingSounds();
+		if (!running) {
+			return;
 		}
 
-		for (auto& action : inboxProcessing) {
+		TaskBase action;
+		while (commands.tryPop(action)) {
 			action();
 		}
 
+		// If the game hasn't picked up the last few yet, it'll get the next one
+		playingSoundsQueue.tryPush(engine->getPlayingSounds());
+
 		if (ownAudioThread) {
 			engine->run();
 		} else {
@@ -282,13 +329,23 @@ void AudioFacade::stepAudio()
 	}
 }
 
-void AudioFacade::enqueue(std::function<void()> action)
+void AudioFacade::enqueue(TaskBase action)
 {
 	if (running) {
 		outbox.emplace_back(std::move(action));
 	}
 }
 
+void AudioFacade::clearCommands()
+{
+	// Only safe while the audio thread isn't running, as this takes its place as the consumer
+	TaskBase action;
+	while (commands.tryPop(action)) {}
+	std::vector<size_t> sounds;
+	while (playingSoundsQueue.tryPop(sounds)) {}
+	outbox.clear();
+}
+
 void AudioFacade::pump()
 {
 	{
@@ -305,19 +362,20 @@ void AudioFacade::pump()
 	}
 
 	if (running) {
-		std::unique_lock<std::mutex> lock(audioMutex);
-		if (!outbox.empty()) {
-			size_t i = inbox.size();
-			inbox.resize(i + outbox.size());
-			for (auto& o: outbox) {
-				inbox[i++] = std::move(o);
+		size_t nSent = 0;
+		for (auto& o: outbox) {
+			if (!commands.tryPush(std::move(o))) {
+				break;
 			}
-			outbox.clear();
+			++nSent;
 		}
+		outbox.erase(outbox.begin(), outbox.begin() + nSent);
 
-		playingSounds = playingSoundsNext;
+		std::vector<size_t> sounds;
+		while (playingSoundsQueue.tryPop(sounds)) {
+			playingSounds = std::move(sounds);
+		}
 	} else {
-		inbox.clear();
-		outbox.clear();
+		clearCommands();
 	}
 }
@@ -1,11 +1,11 @@
 #include "audio_filter_resample.h"
 #include "halley/support/debug.h"
+#include "audio_profiler.h"
 
 using namespace Halley;
 
-AudioFilterResample::AudioFilterResample(std::shared_ptr<AudioSource> source, int fromHz, int toHz, AudioBufferPool& pool)
-	: pool(pool)
-	, source(source)
+AudioFilterResample::AudioFilterResample(std::shared_ptr<AudioSource> source, int fromHz, int toHz)
+	: source(source)
 	, fromHz(fromHz)
 	, toHz(toHz)
 {
@@ -21,51 +21,48 @@ bool AudioFilterResample::isReady() const
 	return source->isReady();
 }
 
-bool AudioFilterResample::getAudioData(size_t numSamples, AudioSourceData& dstBuffers)
+bool AudioFilterResample::getAudioData(size_t numSamples, AudioSourceData& dstBuffers, AudioBufferPool& pool)
 {
-	const size_t nChannels = source->getNumberOfChannels();
-	const size_t additionalPaddingSamples = 2;
-	const size_t nLeftOver = leftoverSamples[0].n;
-	const size_t samplesToGenerate = numSamples - nLeftOver;
-	const size_t numSamplesSrc = samplesToGenerate * fromHz / toHz + additionalPaddingSamples;
+	if (fromHz == toHz) {
+		return source->getAudioData(numSamples, dstBuffers, pool);
+	}
 
-	if (resamplers.empty()) {
-		for (size_t i = 0; i < nChannels; ++i) {
-			resamplers.push_back(std::make_unique<AudioResampler>(fromHz, toHz, 1, Debug::isDebug() ? 0.0f : 0.3f));
-		}
+	const size_t nChannels = source->getNumberOfChannels();
+	if (!resampler) {
+		resampler = std::make_unique<AudioPolyphaseResampler>(fromHz, toHz, nChannels, Debug::isDebug() ? AudioResamplerQuality::Fast : AudioResamplerQuality::Normal);
 	}
 
-	// Read upstream data
-	auto srcBuffers = pool.getBuffers(nChannels, numSamplesSrc);
+	// Read exactly as much upstream data as this needs
+	const size_t numSamplesSrc = resampler->getInputSamplesNeeded(numSamples);
+	auto srcBuffers = pool.getBuffers(nChannels, std::max(numSamplesSrc, size_t(1)));
 	auto srcs = srcBuffers.getSampleSpans();
-	bool playing = source->getAudioData(numSamplesSrc, srcs);
+	const bool playing = numSamplesSrc > 0 ? source->getAudioData(numSamplesSrc, srcs, pool) : true;
 
-	// Prepare temporary destination data
-	auto tmpBuffer = pool.getBuffer(numSamples + 2 * AudioSamplePack::NumSamples);
-	auto tmp = tmpBuffer.getSampleSpan();
-	
 	// Resample
+	AudioProfiler::Scope scope(AudioProfileStage::Resampler);
 	for (size_t channel = 0; channel < nChannels; ++channel) {
-		// First copy any leftovers
-		Expects(leftoverSamples[channel].n == nLeftOver);
-		for (size_t i = 0; i < nLeftOver; ++i) {
-			tmp[i] = leftoverSamples[channel].samples[i];
-		}
-
-		auto result = resamplers[channel]->resample(srcs[channel].subspan(0, numSamplesSrc), tmp.subspan(nLeftOver), 0);
+		auto result = resampler->resample(srcs[channel].subspan(0, numSamplesSrc), dstBuffers[channel].subspan(0, numSamples), channel);
 		Expects(result.nRead == numSamplesSrc);
-		Expects(result.nWritten >= samplesToGenerate);
+		Expects(result.nWritten == numSamples);
+	}
+
+	return playing;
+}
+
+bool AudioFilterResample::skipAudioData(size_t numSamples)
+{
+	if (fromHz == toHz) {
+		return source->skipAudioData(numSamples);
+	}
 
-		// Store left overs
-		size_t leftOver = result.nWritten + nLeftOver - numSamples;
-		for (size_t i = 0; i < leftOver; ++i) {
-			leftoverSamples[channel].samples[i] = tmp[i + numSamples];
-		}
-		leftoverSamples[channel].n = leftOver;
+	// Carry the fractional part over, so that skipping doesn't drift away from where playback would have been
+	const size_t total = numSamples * size_t(fromHz) + skipRemainder;
+	skipRemainder = total % size_t(toHz);
 
-		// Copy to destination
-		memcpy(dstBuffers[channel].data(), tmp.data(), numSamples * sizeof(AudioConfig::SampleFormat));
+	// Whatever the filter was holding is stale now
+	if (resampler) {
+		resampler->reset();
 	}
 
-	return playing;
+	return source->skipAudioData(total / size_t(toHz));
 }
@@ -1,6 +1,6 @@
 #pragma once
 #include "audio_source.h"
-#include "halley/audio/resampler.h"
+#include "halley/audio/polyphase_resampler.h"
 #include "audio_buffer.h"
 
 namespace Halley
@@ -8,24 +8,18 @@ namespace Halley
 	class AudioFilterResample : public AudioSource
 	{
 	public:
-		AudioFilterResample(std::shared_ptr<AudioSource> source, int fromHz, int toHz, AudioBufferPool& pool);
+		AudioFilterResample(std::shared_ptr<AudioSource> source, int fromHz, int toHz);
 
 		size_t getNumberOfChannels() const override;
 		bool isReady() const override;
-		bool getAudioData(size_t numSamples, AudioSourceData& dst) override;
+		bool getAudioData(size_t numSamples, AudioSourceData& dst, AudioBufferPool& pool) override;
+		bool skipAudioData(size_t numSamples) override;
 
 	private:
-		AudioBufferPool& pool;
 		std::shared_ptr<AudioSource> source;
-		std::vector<std::unique_ptr<AudioResampler>> resamplers;
+		std::unique_ptr<AudioPolyphaseResampler> resampler;
 		int fromHz;
 		int toHz;
-
-		struct LeftOverData
-		{
-			std::array<AudioConfig::SampleFormat, 8> samples;
-			size_t n = 0;
-		};
-		std::array<LeftOverData, AudioConfig::maxChannels> leftoverSamples;
+		size_t skipRemainder = 0;
 	};
 }
@@ -2,9 +2,66 @@
 #include "halley/utils/utils.h"
 #include "audio_mixer_sse.h"
 #include "audio_mixer_avx.h"
+#include "audio_mixer_neon.h"
+#include <cmath>
 
 using namespace Halley;
 
+void AudioSpatialBatch::clear()
+{
+	dx.clear();
+	dy.clear();
+	dz.clear();
+	listenerReference.clear();
+	referenceDistance.clear();
+	maxDistance.clear();
+	gain.clear();
+	count = 0;
+	stride = 0;
+}
+
+void AudioSpatialBatch::add(Vector3f delta, float listenerRef, float refDistance, float maxDist, float g)
+{
+	dx.push_back(delta.x);
+	dy.push_back(delta.y);
+	dz.push_back(delta.z);
+	listenerReference.push_back(listenerRef);
+	referenceDistance.push_back(refDistance);
+	maxDistance.push_back(maxDist);
+	gain.push_back(g);
+	++count;
+}
+
+void AudioSpatialBatch::finish(size_t nChannels)
+{
+	const size_t n = count;
+	while (dx.size() % 8 != 0) {
+		add(Vector3f(), 1.0f, 1.0f, 2.0f, 0.0f);
+	}
+	count = n;
+	stride = dx.size();
+	proximity.resize(stride);
+	mix.resize(stride * nChannels);
+}
+
+void AudioMixer::spatialize(AudioSpatialBatch& batch, gsl::span<const AudioChannelData> channels)
+{
+	constexpr float piOverTwo = 3.1415926535897932384626433832795f / 2.0f;
+	const size_t nChannels = size_t(channels.size());
+
+	for (size_t i = 0; i < batch.count; ++i) {
+		const float pan = clamp(batch.dx[i] / batch.listenerReference[i], -1.0f, 1.0f);
+		const float len = std::sqrt(batch.dx[i] * batch.dx[i] + batch.dy[i] * batch.dy[i] + batch.dz[i] * batch.dz[i]);
+		const float proximity = 1.0f - clamp((len - batch.referenceDistance[i]) / (batch.maxDistance[i] - batch.referenceDistance[i]), 0.0f, 1.0f);
+
+		batch.proximity[i] = proximity;
+		for (size_t c = 0; c < nChannels; ++c) {
+			const float panGain = std::sin(std::max(0.0f, 1.0f - 0.5f * std::abs(pan - channels[c].pan)) * piOverTwo);
+			batch.mix[c * batch.stride + i] = panGain * batch.gain[i] * proximity * channels[c].gain;
+		}
+	}
+}
+
 void AudioMixer::mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst, float gain0, float gain1)
 {
 	const size_t nPacks = size_t(src.size());
@@ -27,6 +84,16 @@ void AudioMixer::mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioS
 	}
 }
 
+void AudioMixer::multiplyAudio(gsl::span<const AudioSamplePack> gains, gsl::span<AudioSamplePack> dst)
+{
+	const size_t nPacks = size_t(dst.size());
+	for (size_t i = 0; i < nPacks; ++i) {
+		for (size_t j = 0; j < AudioSamplePack::NumSamples; ++j) {
+			dst[i].samples[j] *= gains[i].samples[j];
+		}
+	}
+}
+
 void AudioMixer::interleaveChannels(gsl::span<AudioSamplePack> dstBuffer, gsl::span<AudioBuffer*> src)
 {
 	size_t n = 0;
@@ -77,11 +144,6 @@ static inline unsigned long long _xgetbv(unsigned int index){
 #ifdef HAS_AVX
 static bool hasAVX()
 {
-#ifndef _MSC_VER
-    // It's crashing on Linux :(
-    return false;
-#endif
-
 #ifdef HAS_SSE
 	int regs[4];
 	int i = 1;
@@ -118,9 +180,35 @@ std::unique_ptr<AudioMixer> AudioMixer::makeMixer()
 	} else {
 		return std::make_unique<AudioMixerSSE>();
 	}
-#elif HAS_SEE
+#elif defined(HAS_SSE)
 	return std::make_unique<AudioMixerSSE>();
+#elif defined(HAS_NEON)
+	return std::make_unique<AudioMixerNEON>();
 #else
 	return std::make_unique<AudioMixer>();
 #endif
 }
+
+std::unique_ptr<AudioMixer> AudioMixer::makeMixer(AudioMixerType type)
+{
+	switch (type) {
+	case AudioMixerType::Default:
+		return makeMixer();
+	case AudioMixerType::Scalar:
+		return std::make_unique<AudioMixer>();
+#ifdef HAS_SSE
+	case AudioMixerType::SSE:
+		return std::make_unique<AudioMixerSSE>();
+#endif
+#ifdef HAS_AVX
+	case AudioMixerType::AVX:
+		return hasAVX() ? std::make_unique<AudioMixerAVX>() : std::unique_ptr<AudioMixer>();
+#endif
+#ifdef HAS_NEON
+	case AudioMixerType::NEON:
+		return std::make_unique<AudioMixerNEON>();
+#endif
+	default:
+		return {};
+	}
+}
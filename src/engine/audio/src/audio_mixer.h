@@ -2,12 +2,11 @@
 #include <gsl/span>
 #include "halley/core/api/audio_api.h"
 #include "audio_buffer.h"
+#include "audio_offline_renderer.h"
 
 #if defined(_M_X64) || defined(__x86_64__)
 #define HAS_SSE
-#if !defined(__linux__)
-#define HAS_AVX
-#endif
+#define HAS_AVX // Picked at runtime, see AudioMixer::makeMixer()
 #endif
 
 #if defined(_M_IX86) || defined(__i386)
@@ -15,16 +14,47 @@
 #define HAS_SSE
 #endif
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#endif
+
 namespace Halley
 {
+	// Emitters with a single positional source, gathered so their mixes can all be worked out at once by AudioMixer::spatialize
+	struct AudioSpatialBatch
+	{
+		// In, one per emitter, padded with silent ones to a multiple of 8
+		std::vector<float> dx, dy, dz; // Source position relative to its listener
+		std::vector<float> listenerReference;
+		std::vector<float> referenceDistance;
+		std::vector<float> maxDistance;
+		std::vector<float> gain;
+
+		// Out
+		std::vector<float> proximity; // 1 within the reference distance, 0 outside the maximum distance
+		std::vector<float> mix; // Gain into each channel, one channel after the other: mix[channel * stride + emitter]
+
+		size_t count = 0;
+		size_t stride = 0; // count, padded
+
+		void clear();
+		void add(Vector3f delta, float listenerReference, float referenceDistance, float maxDistance, float gain);
+		void finish(size_t nChannels); // Pads the input and sizes the output
+	};
+
 	class AudioMixer
 	{
 	public:
 		virtual ~AudioMixer() {}
 
+		// The same mix as AudioPosition gives each of them, working on several emitters at a time where there's SIMD for it
+		virtual void spatialize(AudioSpatialBatch& batch, gsl::span<const AudioChannelData> channels);
+
 		virtual void mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst, float gainStart, float gainEnd);
+		virtual void multiplyAudio(gsl::span<const AudioSamplePack> gains, gsl::span<AudioSamplePack> dst); // dst *= gains, sample by sample
 		virtual void interleaveChannels(gsl::span<AudioSamplePack> dst, gsl::span<AudioBuffer*> src);
 		virtual void compressRange(gsl::span<AudioSamplePack> buffer);
 		static std::unique_ptr<AudioMixer> makeMixer();
+		static std::unique_ptr<AudioMixer> makeMixer(AudioMixerType type); // nullptr if it's not available here
 	};
 }
@@ -1,32 +1,38 @@
 #include "audio_mixer_avx.h"
 
 #ifdef HAS_AVX
-#include <xmmintrin.h>
-
-#ifdef __clang__
 #include <immintrin.h>
-#endif
 
 #ifdef _MSC_VER
 #include <intrin.h>
+#define AVX_FUNCTION
+#else
+// Only these functions are built for AVX, rather than the whole file; otherwise inline functions from headers could be compiled with AVX too, and picked by the linker for callers on CPUs without it
+#define AVX_FUNCTION __attribute__((target("avx")))
 #endif
 
 using namespace Halley;
 
-void AudioMixerAVX::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<AudioSamplePack> dstRaw, float gain0, float gain1)
+// Note: std::vector doesn't honour AudioSamplePack's alignment before C++17, so only 16-byte alignment can be assumed, hence the unaligned loads and stores
+
+AVX_FUNCTION void AudioMixerAVX::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<AudioSamplePack> dstRaw, float gain0, float gain1)
 {
-	gsl::span<const __m256> src(reinterpret_cast<const __m256*>(srcRaw.data()), srcRaw.size() * 2);
-	gsl::span<__m256> dst(reinterpret_cast<__m256*>(dstRaw.data()), dstRaw.size() * 2);
-	const size_t nSamples = size_t(src.size());
+	const float* src = srcRaw.data()->samples.data();
+	float* dst = dstRaw.data()->samples.data();
+	const size_t nSamples = size_t(srcRaw.size()) * 2;
 
 	if (gain0 == gain1) {
 		__m256 gain = _mm256_broadcast_ss(&gain0);
 		for (size_t i = 0; i < nSamples; i += 2) {
-			dst[i] = _mm256_add_ps(dst[i], _mm256_mul_ps(src[i], gain));
-			dst[i + 1] = _mm256_add_ps(dst[i + 1], _mm256_mul_ps(src[i + 1], gain));
+			__m256 d0 = _mm256_loadu_ps(dst + i * 8);
+			__m256 d1 = _mm256_loadu_ps(dst + i * 8 + 8);
+			d0 = _mm256_add_ps(d0, _mm256_mul_ps(_mm256_loadu_ps(src + i * 8), gain));
+			d1 = _mm256_add_ps(d1, _mm256_mul_ps(_mm256_loadu_ps(src + i * 8 + 8), gain));
+			_mm256_storeu_ps(dst + i * 8, d0);
+			_mm256_storeu_ps(dst + i * 8 + 8, d1);
 		}
 	} else {
-		const float sc = 1.0f / (dst.size() * 16);
+		const float sc = 1.0f / (dstRaw.size() * AudioSamplePack::NumSamples);
 		const float gainDiff = gain1 - gain0;
 		const float eight = 8.0f;
 
@@ -34,27 +40,87 @@ void AudioMixerAVX::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<
 		__m256 gain1p = _mm256_broadcast_ss(&gainDiff);
 		__m256 scale = _mm256_broadcast_ss(&sc);
 		__m256 inc = _mm256_broadcast_ss(&eight);
-		__m256 offset = { 0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f };
+		__m256 offset = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
 		for (size_t i = 0; i < nSamples; ++i) {
 			__m256 t = _mm256_mul_ps(offset, scale);
 			__m256 gain = _mm256_add_ps(gain0p, _mm256_mul_ps(gain1p, t));
 			offset = _mm256_add_ps(offset, inc);
-			dst[i] = _mm256_add_ps(dst[i], _mm256_mul_ps(src[i], gain));
+			__m256 d = _mm256_add_ps(_mm256_loadu_ps(dst + i * 8), _mm256_mul_ps(_mm256_loadu_ps(src + i * 8), gain));
+			_mm256_storeu_ps(dst + i * 8, d);
 		}
 	}
 }
 
-void AudioMixerAVX::compressRange(gsl::span<AudioSamplePack> buffer)
+AVX_FUNCTION void AudioMixerAVX::multiplyAudio(gsl::span<const AudioSamplePack> gainsRaw, gsl::span<AudioSamplePack> dstRaw)
+{
+	const float* gains = gainsRaw.data()->samples.data();
+	float* dst = dstRaw.data()->samples.data();
+	const size_t nSamples = size_t(dstRaw.size()) * 2;
+
+	for (size_t i = 0; i < nSamples; ++i) {
+		_mm256_storeu_ps(dst + i * 8, _mm256_mul_ps(_mm256_loadu_ps(dst + i * 8), _mm256_loadu_ps(gains + i * 8)));
+	}
+}
+
+AVX_FUNCTION void AudioMixerAVX::compressRange(gsl::span<AudioSamplePack> buffer)
 {
-	gsl::span<__m256> dst(reinterpret_cast<__m256*>(buffer.data()), buffer.size() * 2);
-	const size_t nSamples = size_t(dst.size());
+	float* dst = buffer.data()->samples.data();
+	const size_t nSamples = size_t(buffer.size()) * 2;
 
 	float val = 0.99995f;
-	__m256 minVal = { -val, -val, -val, -val, -val, -val, -val, -val };
-	__m256 maxVal = { val, val, val, val, val, val, val, val };
+	float negVal = -val;
+	__m256 minVal = _mm256_broadcast_ss(&negVal);
+	__m256 maxVal = _mm256_broadcast_ss(&val);
 
 	for (size_t i = 0; i < nSamples; ++i) {
-		dst[i] = _mm256_max_ps(minVal, _mm256_min_ps(dst[i], maxVal));
+		_mm256_storeu_ps(dst + i * 8, _mm256_max_ps(minVal, _mm256_min_ps(_mm256_loadu_ps(dst + i * 8), maxVal)));
+	}
+}
+
+namespace {
+	// sin(x) for x in [0, pi/2], from its Taylor series, to within 1e-7
+	AVX_FUNCTION inline __m256 sinQuarter(__m256 x)
+	{
+		const __m256 x2 = _mm256_mul_ps(x, x);
+		__m256 p = _mm256_set1_ps(-2.5052108e-8f);
+		p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(2.7557319e-6f));
+		p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(-1.9841270e-4f));
+		p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(8.3333333e-3f));
+		p = _mm256_add_ps(_mm256_mul_ps(p, x2), _mm256_set1_ps(-1.6666667e-1f));
+		return _mm256_add_ps(x, _mm256_mul_ps(_mm256_mul_ps(x, x2), p));
+	}
+}
+
+AVX_FUNCTION void AudioMixerAVX::spatialize(AudioSpatialBatch& batch, gsl::span<const AudioChannelData> channels)
+{
+	const size_t nChannels = size_t(channels.size());
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 minusOne = _mm256_set1_ps(-1.0f);
+	const __m256 half = _mm256_set1_ps(0.5f);
+	const __m256 piOverTwo = _mm256_set1_ps(3.1415926535897932384626433832795f / 2.0f);
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+
+	for (size_t i = 0; i < batch.stride; i += 8) {
+		const __m256 dx = _mm256_loadu_ps(batch.dx.data() + i);
+		const __m256 dy = _mm256_loadu_ps(batch.dy.data() + i);
+		const __m256 dz = _mm256_loadu_ps(batch.dz.data() + i);
+		const __m256 ref = _mm256_loadu_ps(batch.referenceDistance.data() + i);
+		const __m256 maxDistance = _mm256_loadu_ps(batch.maxDistance.data() + i);
+		const __m256 gain = _mm256_loadu_ps(batch.gain.data() + i);
+
+		const __m256 pan = _mm256_min_ps(_mm256_max_ps(_mm256_div_ps(dx, _mm256_loadu_ps(batch.listenerReference.data() + i)), minusOne), one);
+		const __m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+		const __m256 t = _mm256_div_ps(_mm256_sub_ps(len, ref), _mm256_sub_ps(maxDistance, ref));
+		const __m256 proximity = _mm256_sub_ps(one, _mm256_min_ps(_mm256_max_ps(t, zero), one));
+		_mm256_storeu_ps(batch.proximity.data() + i, proximity);
+
+		for (size_t c = 0; c < nChannels; ++c) {
+			const __m256 panDistance = _mm256_andnot_ps(signMask, _mm256_sub_ps(pan, _mm256_set1_ps(channels[c].pan)));
+			const __m256 panGain = sinQuarter(_mm256_mul_ps(_mm256_max_ps(zero, _mm256_sub_ps(one, _mm256_mul_ps(half, panDistance))), piOverTwo));
+			const __m256 mix = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(panGain, gain), proximity), _mm256_set1_ps(channels[c].gain));
+			_mm256_storeu_ps(batch.mix.data() + c * batch.stride + i, mix);
+		}
 	}
 }
 
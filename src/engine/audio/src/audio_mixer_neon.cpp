@@ -0,0 +1,90 @@
+#include "audio_mixer_neon.h"
+
+#ifdef HAS_NEON
+#include <arm_neon.h>
+
+using namespace Halley;
+
+void AudioMixerNEON::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<AudioSamplePack> dstRaw, float gain0, float gain1)
+{
+	const float* src = srcRaw.data()->samples.data();
+	float* dst = dstRaw.data()->samples.data();
+	const size_t nSamples = size_t(srcRaw.size()) * 4;
+
+	if (gain0 == gain1) {
+		float32x4_t gain = vdupq_n_f32(gain0);
+		for (size_t i = 0; i < nSamples; i += 4) {
+			float* d = dst + i * 4;
+			const float* s = src + i * 4;
+			vst1q_f32(d, vmlaq_f32(vld1q_f32(d), vld1q_f32(s), gain));
+			vst1q_f32(d + 4, vmlaq_f32(vld1q_f32(d + 4), vld1q_f32(s + 4), gain));
+			vst1q_f32(d + 8, vmlaq_f32(vld1q_f32(d + 8), vld1q_f32(s + 8), gain));
+			vst1q_f32(d + 12, vmlaq_f32(vld1q_f32(d + 12), vld1q_f32(s + 12), gain));
+		}
+	} else {
+		const float sc = 1.0f / (dstRaw.size() * AudioSamplePack::NumSamples);
+		const float gainDiff = gain1 - gain0;
+
+		float32x4_t gain0p = vdupq_n_f32(gain0);
+		float32x4_t gain1p = vdupq_n_f32(gainDiff);
+		float32x4_t scale = vdupq_n_f32(sc);
+		const float offsetInit[4] = { 0.0f, 1.0f, 2.0f, 3.0f };
+		float32x4_t offset = vld1q_f32(offsetInit);
+		float32x4_t inc = vdupq_n_f32(4.0f);
+		for (size_t i = 0; i < nSamples; ++i) {
+			float32x4_t t = vmulq_f32(offset, scale);
+			float32x4_t gain = vmlaq_f32(gain0p, gain1p, t);
+			offset = vaddq_f32(offset, inc);
+			vst1q_f32(dst + i * 4, vmlaq_f32(vld1q_f32(dst + i * 4), vld1q_f32(src + i * 4), gain));
+		}
+	}
+}
+
+void AudioMixerNEON::multiplyAudio(gsl::span<const AudioSamplePack> gainsRaw, gsl::span<AudioSamplePack> dstRaw)
+{
+	const float* gains = gainsRaw.data()->samples.data();
+	float* dst = dstRaw.data()->samples.data();
+	const size_t nSamples = size_t(dstRaw.size()) * 4;
+
+	for (size_t i = 0; i < nSamples; ++i) {
+		vst1q_f32(dst + i * 4, vmulq_f32(vld1q_f32(dst + i * 4), vld1q_f32(gains + i * 4)));
+	}
+}
+
+void AudioMixerNEON::interleaveChannels(gsl::span<AudioSamplePack> dstBuffer, gsl::span<AudioBuffer*> src)
+{
+	// Each destination pack holds 8 stereo frames, taken from one half of a source pack
+	const size_t halfPack = AudioSamplePack::NumSamples / 2;
+	for (size_t i = 0; i < size_t(dstBuffer.size()); ++i) {
+		float* dst = dstBuffer[i].samples.data();
+		const size_t srcIdx = i >> 1;
+		const size_t srcOff = (i & 1) * halfPack;
+		const float* left = src[0]->packs[srcIdx].samples.data() + srcOff;
+		const float* right = src[1]->packs[srcIdx].samples.data() + srcOff;
+
+		float32x4x2_t frames0;
+		frames0.val[0] = vld1q_f32(left);
+		frames0.val[1] = vld1q_f32(right);
+		vst2q_f32(dst, frames0);
+
+		float32x4x2_t frames1;
+		frames1.val[0] = vld1q_f32(left + 4);
+		frames1.val[1] = vld1q_f32(right + 4);
+		vst2q_f32(dst + 8, frames1);
+	}
+}
+
+void AudioMixerNEON::compressRange(gsl::span<AudioSamplePack> buffer)
+{
+	float* dst = buffer.data()->samples.data();
+	const size_t nSamples = size_t(buffer.size()) * 4;
+
+	float32x4_t minVal = vdupq_n_f32(-0.99995f);
+	float32x4_t maxVal = vdupq_n_f32(0.99995f);
+
+	for (size_t i = 0; i < nSamples; ++i) {
+		vst1q_f32(dst + i * 4, vmaxq_f32(minVal, vminq_f32(vld1q_f32(dst + i * 4), maxVal)));
+	}
+}
+
+#endif
@@ -0,0 +1,16 @@
+#pragma once
+#include "audio_mixer.h"
+
+#ifdef HAS_NEON
+namespace Halley
+{
+	class AudioMixerNEON : public AudioMixer
+	{
+	public:
+		void mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst, float gainStart, float gainEnd) override;
+		void multiplyAudio(gsl::span<const AudioSamplePack> gains, gsl::span<AudioSamplePack> dst) override;
+		void interleaveChannels(gsl::span<AudioSamplePack> dst, gsl::span<AudioBuffer*> src) override;
+		void compressRange(gsl::span<AudioSamplePack> buffer) override;
+	};
+}
+#endif
@@ -24,7 +24,7 @@ void AudioMixerSSE::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<
 			dst[i + 3] = _mm_add_ps(dst[i + 3], _mm_mul_ps(src[i + 3], gain));
 		}
 	} else {
-		const float sc = 1.0f / (dst.size() * 16);
+		const float sc = 1.0f / (dstRaw.size() * AudioSamplePack::NumSamples);
 		const float gainDiff = gain1 - gain0;
 
 		__m128 gain0p = { gain0, gain0, gain0, gain0 };
@@ -41,6 +41,20 @@ void AudioMixerSSE::mixAudio(gsl::span<const AudioSamplePack> srcRaw, gsl::span<
 	}
 }
 
+void AudioMixerSSE::multiplyAudio(gsl::span<const AudioSamplePack> gainsRaw, gsl::span<AudioSamplePack> dstRaw)
+{
+	gsl::span<const __m128> gains(reinterpret_cast<const __m128*>(gainsRaw.data()), gainsRaw.size() * 4);
+	gsl::span<__m128> dst(reinterpret_cast<__m128*>(dstRaw.data()), dstRaw.size() * 4);
+	const size_t nSamples = size_t(dst.size());
+
+	for (size_t i = 0; i < nSamples; i += 4) {
+		dst[i] = _mm_mul_ps(dst[i], gains[i]);
+		dst[i + 1] = _mm_mul_ps(dst[i + 1], gains[i + 1]);
+		dst[i + 2] = _mm_mul_ps(dst[i + 2], gains[i + 2]);
+		dst[i + 3] = _mm_mul_ps(dst[i + 3], gains[i + 3]);
+	}
+}
+
 void AudioMixerSSE::compressRange(gsl::span<AudioSamplePack> buffer)
 {
 	gsl::span<__m128> dst(reinterpret_cast<__m128*>(buffer.data()), buffer.size() * 4);
@@ -55,4 +69,51 @@ void AudioMixerSSE::compressRange(gsl::span<AudioSamplePack> buffer)
 	}
 }
 
+namespace {
+	// sin(x) for x in [0, pi/2], from its Taylor series, to within 1e-7
+	inline __m128 sinQuarter(__m128 x)
+	{
+		const __m128 x2 = _mm_mul_ps(x, x);
+		__m128 p = _mm_set1_ps(-2.5052108e-8f);
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(2.7557319e-6f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.9841270e-4f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(8.3333333e-3f));
+		p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.6666667e-1f));
+		return _mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(x, x2), p));
+	}
+}
+
+void AudioMixerSSE::spatialize(AudioSpatialBatch& batch, gsl::span<const AudioChannelData> channels)
+{
+	const size_t nChannels = size_t(channels.size());
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 piOverTwo = _mm_set1_ps(3.1415926535897932384626433832795f / 2.0f);
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+
+	for (size_t i = 0; i < batch.stride; i += 4) {
+		const __m128 dx = _mm_loadu_ps(batch.dx.data() + i);
+		const __m128 dy = _mm_loadu_ps(batch.dy.data() + i);
+		const __m128 dz = _mm_loadu_ps(batch.dz.data() + i);
+		const __m128 ref = _mm_loadu_ps(batch.referenceDistance.data() + i);
+		const __m128 maxDistance = _mm_loadu_ps(batch.maxDistance.data() + i);
+		const __m128 gain = _mm_loadu_ps(batch.gain.data() + i);
+
+		const __m128 pan = _mm_min_ps(_mm_max_ps(_mm_div_ps(dx, _mm_loadu_ps(batch.listenerReference.data() + i)), minusOne), one);
+		const __m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		const __m128 t = _mm_div_ps(_mm_sub_ps(len, ref), _mm_sub_ps(maxDistance, ref));
+		const __m128 proximity = _mm_sub_ps(one, _mm_min_ps(_mm_max_ps(t, zero), one));
+		_mm_storeu_ps(batch.proximity.data() + i, proximity);
+
+		for (size_t c = 0; c < nChannels; ++c) {
+			const __m128 panDistance = _mm_andnot_ps(signMask, _mm_sub_ps(pan, _mm_set1_ps(channels[c].pan)));
+			const __m128 panGain = sinQuarter(_mm_mul_ps(_mm_max_ps(zero, _mm_sub_ps(one, _mm_mul_ps(half, panDistance))), piOverTwo));
+			const __m128 mix = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(panGain, gain), proximity), _mm_set1_ps(channels[c].gain));
+			_mm_storeu_ps(batch.mix.data() + c * batch.stride + i, mix);
+		}
+	}
+}
+
 #endif
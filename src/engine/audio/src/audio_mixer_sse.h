@@ -8,7 +8,9 @@ namespace Halley
 	{
 	public:
 		void mixAudio(gsl::span<const AudioSamplePack> src, gsl::span<AudioSamplePack> dst, float gainStart, float gainEnd) override;
+		void multiplyAudio(gsl::span<const AudioSamplePack> gains, gsl::span<AudioSamplePack> dst) override;
 		void compressRange(gsl::span<AudioSamplePack> buffer) override;
+		void spatialize(AudioSpatialBatch& batch, gsl::span<const AudioChannelData> channels) override;
 	};
 }
 #endif
@@ -0,0 +1,112 @@
+#include "audio_offline_renderer.h"
+#include "audio_engine.h"
+#include "audio_mixer.h"
+#include "audio_profiler.h"
+#include "audio_source_clip.h"
+#include "audio_filter_resample.h"
+#include "halley/support/exception.h"
+
+using namespace Halley;
+
+class AudioOfflineRenderer::NullOutput final : public AudioOutputAPI
+{
+public:
+	Vector<std::unique_ptr<const AudioDevice>> getAudioDevices() override { return {}; }
+	AudioSpec openAudioDevice(const AudioSpec& requestedFormat, const AudioDevice*, AudioCallback) override { return requestedFormat; }
+	void closeAudioDevice() override {}
+
+	void startPlayback() override {}
+	void stopPlayback() override {}
+
+	void queueAudio(gsl::span<const float>) override {}
+	bool needsMoreAudio() override { return true; }
+
+	bool needsAudioThread() const override { return false; }
+};
+
+AudioOfflineRenderer::AudioOfflineRenderer(AudioSpec spec, AudioMixerType mixer)
+	: spec(spec)
+	, output(std::make_unique<NullOutput>())
+	, engine(std::make_unique<AudioEngine>())
+	, profiler(std::make_unique<AudioProfiler>())
+{
+	auto m = AudioMixer::makeMixer(mixer);
+	if (!m) {
+		throw Exception("Audio mixer not supported on this platform: " + toString(int(mixer)), HalleyExceptions::AudioEngine);
+	}
+	engine->setMixer(std::move(m));
+	engine->start(spec, *output);
+}
+
+AudioOfflineRenderer::~AudioOfflineRenderer() = default;
+
+bool AudioOfflineRenderer::isMixerSupported(AudioMixerType mixer)
+{
+	return static_cast<bool>(AudioMixer::makeMixer(mixer));
+}
+
+void AudioOfflineRenderer::play(std::shared_ptr<const IAudioClip> clip, AudioPosition position, float volume, bool loop, const String& group, float pitch)
+{
+	constexpr int sampleRate = 48000;
+
+	std::shared_ptr<AudioSource> source = std::make_shared<AudioSourceClip>(clip, loop, 0);
+	if (std::abs(pitch - 1.0f) > 0.01f) {
+		source = std::make_shared<AudioFilterResample>(source, int(lround(sampleRate * pitch)), sampleRate);
+	}
+	engine->addEmitter(uniqueId++, std::make_unique<AudioEmitter>(source, position, volume, engine->getGroupId(group)));
+}
+
+void AudioOfflineRenderer::setGroupGain(const String& group, float gain)
+{
+	engine->setGroupGain(group, gain);
+}
+
+void AudioOfflineRenderer::setGroupParent(const String& group, const String& parent)
+{
+	engine->setGroupParent(group, parent);
+}
+
+void AudioOfflineRenderer::setGroupEffects(const String& group, std::vector<AudioEffectConfig> effects)
+{
+	engine->setGroupEffects(group, std::move(effects));
+}
+
+void AudioOfflineRenderer::setMaxVoices(size_t n)
+{
+	engine->setMaxVoices(n);
+}
+
+void AudioOfflineRenderer::setListener(AudioListenerData listener)
+{
+	engine->setListener(listener);
+}
+
+const AudioBufferStats& AudioOfflineRenderer::generateBuffer()
+{
+	profiler->reset();
+	AudioProfiler::bind(profiler.get());
+
+	const auto start = std::chrono::steady_clock::now();
+	try {
+		engine->generateBuffer();
+	} catch (...) {
+		AudioProfiler::bind(nullptr);
+		throw;
+	}
+	const auto end = std::chrono::steady_clock::now();
+	AudioProfiler::bind(nullptr);
+
+	stats.total = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+	stats.mixer = profiler->getNanoSeconds(AudioProfileStage::Mixer);
+	stats.decoder = profiler->getNanoSeconds(AudioProfileStage::Decoder);
+	stats.resampler = profiler->getNanoSeconds(AudioProfileStage::Resampler);
+	stats.effects = profiler->getNanoSeconds(AudioProfileStage::Effects);
+	stats.voices = engine->getNumVoices();
+	stats.virtualVoices = engine->getNumVirtualVoices();
+	return stats;
+}
+
+int64_t AudioOfflineRenderer::getBufferBudget() const
+{
+	return int64_t(spec.bufferSize) * 1000000000ll / int64_t(spec.sampleRate);
+}
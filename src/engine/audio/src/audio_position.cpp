@@ -141,9 +141,37 @@ void AudioPosition::setMixPositional(gsl::span<const AudioChannelData> dstChanne
 		return;
 	}
 
+	float resultPan = 0;
+	const float proximity = getProximity(listener, resultPan);
+
+	for (size_t i = 0; i < nDstChannels; ++i) {
+		dst[i] = gain2DPan(resultPan, dstChannels[i].pan) * gain * proximity * dstChannels[i].gain;
+	}
+}
+
+const AudioPosition::SpatialSource* AudioPosition::getSingleSource() const
+{
+	return isPannable && !isUI && sources.size() == 1 ? &sources[0] : nullptr;
+}
+
+float AudioPosition::getAttenuation(const AudioListenerData& listener) const
+{
+	if (!isPannable || isUI) {
+		return 1.0f;
+	}
+	if (sources.empty()) {
+		return 0.0f;
+	}
+
+	float resultPan;
+	return getProximity(listener, resultPan);
+}
+
+float AudioPosition::getProximity(const AudioListenerData& listener, float& resultPan) const
+{
 	// Proximity means 1 within the reference distance, 0 outside the maximum distance, and between 0 and 1 between them
 	float proximity = 0;
-	float resultPan = 0;
+	resultPan = 0;
 
 	if (sources.size() == 1) {
 		// One source, do the simple algorithm
@@ -171,7 +199,5 @@ void AudioPosition::setMixPositional(gsl::span<const AudioChannelData> dstChanne
 		}
 	}
 
-	for (size_t i = 0; i < nDstChannels; ++i) {
-		dst[i] = gain2DPan(resultPan, dstChannels[i].pan) * gain * proximity * dstChannels[i].gain;
-	}
+	return proximity;
 }
@@ -0,0 +1,46 @@
+#include "audio_profiler.h"
+
+using namespace Halley;
+
+namespace {
+	thread_local AudioProfiler* boundProfiler = nullptr;
+}
+
+AudioProfiler::Scope::Scope(AudioProfileStage stage)
+	: profiler(boundProfiler)
+	, parent(nullptr)
+	, stage(stage)
+{
+	if (profiler) {
+		parent = profiler->current;
+		profiler->current = this;
+		start = std::chrono::steady_clock::now();
+	}
+}
+
+AudioProfiler::Scope::~Scope()
+{
+	if (profiler) {
+		const int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		profiler->times[size_t(stage)] += elapsed - childTime;
+		if (parent) {
+			parent->childTime += elapsed;
+		}
+		profiler->current = parent;
+	}
+}
+
+void AudioProfiler::bind(AudioProfiler* profiler)
+{
+	boundProfiler = profiler;
+}
+
+void AudioProfiler::reset()
+{
+	times = {};
+}
+
+int64_t AudioProfiler::getNanoSeconds(AudioProfileStage stage) const
+{
+	return times[size_t(stage)];
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+namespace Halley
+{
+	enum class AudioProfileStage
+	{
+		Mixer,
+		Decoder,
+		Resampler,
+		Effects,
+
+		NumStages
+	};
+
+	// Splits the time taken generating buffers between stages, for AudioOfflineRenderer. It only measures anything on a thread
+	// it's been bound to, so normal playback only pays for checking that it isn't.
+	// Scopes can nest, e.g. a resampler reading from its source: time spent in the inner one only counts towards its own stage.
+	class AudioProfiler
+	{
+	public:
+		class Scope
+		{
+		public:
+			explicit Scope(AudioProfileStage stage);
+			~Scope();
+
+			Scope(const Scope&) = delete;
+			Scope& operator=(const Scope&) = delete;
+
+		private:
+			AudioProfiler* profiler;
+			Scope* parent;
+			AudioProfileStage stage;
+			std::chrono::steady_clock::time_point start;
+			int64_t childTime = 0;
+		};
+
+		static void bind(AudioProfiler* profiler); // To the calling thread, nullptr unbinds
+
+		void reset();
+		int64_t getNanoSeconds(AudioProfileStage stage) const;
+
+	private:
+		std::array<int64_t, size_t(AudioProfileStage::NumStages)> times = {};
+		Scope* current = nullptr;
+	};
+}
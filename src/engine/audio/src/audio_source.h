@@ -6,6 +6,7 @@
 
 namespace Halley
 {
+	class AudioBufferPool;
 	using AudioSourceData = std::array<gsl::span<AudioConfig::SampleFormat>, AudioConfig::maxChannels>;
 
 	class AudioSource {
@@ -14,6 +15,9 @@ namespace Halley
 
 		virtual size_t getNumberOfChannels() const = 0;
 		virtual bool isReady() const { return true; }
-		virtual bool getAudioData(size_t numSamples, AudioSourceData& dst) = 0;
+		// pool is the calling thread's scratch pool
+		virtual bool getAudioData(size_t numSamples, AudioSourceData& dst, AudioBufferPool& pool) = 0;
+		// Moves playback forward as if getAudioData had been called, but without producing any audio
+		virtual bool skipAudioData(size_t numSamples) = 0;
 	};
 }
@@ -23,7 +23,7 @@ bool AudioSourceClip::isReady() const
 	return clip->isLoaded();
 }
 
-bool AudioSourceClip::getAudioData(size_t samplesRequested, AudioSourceData& dstChannels)
+bool AudioSourceClip::getAudioData(size_t samplesRequested, AudioSourceData& dstChannels, AudioBufferPool& pool)
 {
 	Expects(isReady());
 	if (!initialised) {
@@ -93,3 +93,38 @@ bool AudioSourceClip::getAudioData(size_t samplesRequested, AudioSourceData& dst
 
 	return isPlaying;
 }
+
+bool AudioSourceClip::skipAudioData(size_t samplesRequested)
+{
+	Expects(isReady());
+	const auto playbackLength = int64_t(clip->getLength());
+	auto samplesLeft = int64_t(samplesRequested);
+
+	if (playbackPos < 0) {
+		const int64_t delaySamples = std::min(-playbackPos, samplesLeft);
+		playbackPos += delaySamples;
+		samplesLeft -= delaySamples;
+	}
+
+	// Same looping rules as getAudioData
+	while (samplesLeft > 0) {
+		if (playbackPos >= playbackLength) {
+			if (looping) {
+				playbackPos = int64_t(clip->getLoopPoint());
+				if (playbackPos >= playbackLength) {
+					looping = false;
+					playbackPos = playbackLength;
+					return false;
+				}
+			} else {
+				return false;
+			}
+		}
+
+		const int64_t samplesToSkip = std::min(samplesLeft, playbackLength - playbackPos);
+		playbackPos += samplesToSkip;
+		samplesLeft -= samplesToSkip;
+	}
+
+	return true;
+}
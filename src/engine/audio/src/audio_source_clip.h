@@ -9,7 +9,8 @@ namespace Halley
 		AudioSourceClip(std::shared_ptr<const IAudioClip> clip, bool looping, int64_t delaySamples);
 
 		size_t getNumberOfChannels() const override;
-		bool getAudioData(size_t numSamples, AudioSourceData& dst) override;
+		bool getAudioData(size_t numSamples, AudioSourceData& dst, AudioBufferPool& pool) override;
+		bool skipAudioData(size_t numSamples) override;
 		bool isReady() const override;
 
 	private:
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "save_data.h"
+#include "halley/concurrency/future.h"
+#include <map>
+#include <mutex>
+#include <memory>
+
+namespace Halley {
+	// Wraps another ISaveData so that writes don't block the caller.
+	// setData and removeData only take a copy of the bytes (setSerializedData doesn't even do that, it shares the chunks); commit hands
+	// everything since the last commit to the disk IO thread as a single batch, where it's compressed and written (and encrypted, if the
+	// wrapped container does that). Chunks are compressed without joining them first.
+	// Writing the same path again before a commit replaces the earlier write, and reads see the latest data even if it's not on disk yet.
+	class AsyncSaveData : public ISaveData {
+	public:
+		explicit AsyncSaveData(std::shared_ptr<ISaveData> saveData, bool compress = false);
+		~AsyncSaveData();
+
+		bool isReady() const override;
+
+		Bytes getData(const String& path) override;
+		void removeData(const String& path) override;
+		std::vector<String> enumerate(const String& root) override;
+
+		void setData(const String& path, const Bytes& data, bool commit = true) override;
+		void setSerializedData(const String& path, const SerializedChunks& data, bool commit = true) override;
+		void commit() override;
+		size_t getFreeSpace() override;
+
+		// Resolves to false if anything in the batch failed to be written
+		Future<bool> commitAsync();
+
+		// Reads on the disk IO thread, seeing writes made before this was called, like getData()
+		Future<Bytes> getDataAsync(const String& path);
+		bool isCommitting() const;
+		void waitForCommits();
+
+	private:
+		struct Write
+		{
+			std::shared_ptr<const SerializedChunks> data; // Null if removed
+			uint64_t version;
+		};
+		using Batch = std::vector<std::pair<String, Write>>;
+
+		std::shared_ptr<ISaveData> saveData;
+		const bool compress;
+
+		mutable std::mutex mutex;
+		std::map<String, Write> pending; // Not committed yet
+		std::map<String, Write> unwritten; // Everything not on disk yet, committed or not
+		uint64_t nextVersion = 1;
+		Future<bool> lastCommit;
+
+		std::mutex saveDataMutex;
+
+		void addWrite(const String& path, std::shared_ptr<const SerializedChunks> data);
+		bool writeBatch(const Batch& batch);
+
+		static Bytes pack(const SerializedChunks& data);
+		static Bytes unpack(Bytes data);
+	};
+}
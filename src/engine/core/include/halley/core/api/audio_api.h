@@ -59,6 +59,9 @@ namespace Halley
 	class AudioSpec
 	{
 	public:
+		constexpr static int minBufferSize = 128; // Under 3 ms at 48 kHz
+		constexpr static int maxBufferSize = 8192;
+
 		int sampleRate;
 		int numChannels;
 		int bufferSize;
@@ -93,6 +96,60 @@ namespace Halley
 		float gain = 1.0f;
 	};
 
+	enum class AudioEffectType
+	{
+		LowPass,
+		HighPass,
+		BandPass,
+		Peak, // Boosts or cuts gainDb around frequency
+		Compressor,
+		Reverb
+	};
+
+	template <>
+	struct EnumNames<AudioEffectType> {
+		constexpr std::array<const char*, 6> operator()() const {
+			return{{
+				"lowPass",
+				"highPass",
+				"bandPass",
+				"peak",
+				"compressor",
+				"reverb"
+			}};
+		}
+	};
+
+	// One stage of a group's effect chain; each type only looks at the fields that apply to it
+	class AudioEffectConfig
+	{
+	public:
+		AudioEffectType type = AudioEffectType::LowPass;
+
+		// Filters
+		float frequency = 1000.0f; // Hz
+		float q = 0.7071f;
+		float gainDb = 0.0f; // Peak filter boost/cut, or compressor make-up gain
+
+		// Compressor
+		float thresholdDb = -18.0f;
+		float ratio = 4.0f;
+		float attack = 0.01f; // Seconds
+		float release = 0.2f;
+		String sidechain; // If set, it's keyed on that group instead of its own input, e.g. music ducking under dialogue
+
+		// Reverb
+		float roomSize = 0.5f; // 0 to 1
+		float damping = 0.5f; // 0 to 1
+		float wet = 0.3f;
+		float dry = 1.0f;
+
+		AudioEffectConfig() {}
+		explicit AudioEffectConfig(AudioEffectType type)
+			: type(type)
+		{}
+	};
+
 	using AudioCallback = std::function<void()>;
 
 	class AudioOutputAPI
@@ -136,6 +193,7 @@ namespace Halley
 
 		virtual Vector<std::unique_ptr<const AudioDevice>> getAudioDevices() = 0;
 		virtual void startPlayback(int deviceNumber = 0) = 0;
+		virtual void setBufferSize(int samples) = 0; // For the next startPlayback(). Smaller is lower latency, but costs more CPU and risks underruns
 		virtual void stopPlayback() = 0;
 		virtual void pausePlayback() = 0;
 		virtual void resumePlayback() = 0;
@@ -150,8 +208,18 @@ namespace Halley
 
 		virtual void setMasterVolume(float gain = 1.0f) = 0;
 		virtual void setGroupVolume(const String& groupName, float gain = 1.0f) = 0;
+		virtual void setMaxVoices(size_t maxVoices) = 0; // Quieter sounds beyond this are virtualised
+		virtual void setGroupMaxVoices(const String& groupName, size_t maxVoices) = 0;
 		virtual void setOutputChannels(std::vector<AudioChannelData> audioChannelData) = 0;
 
 		virtual void setListener(AudioListenerData listener) = 0;
+
+		// Groups are mix buses: each one can be routed into a parent group (an empty parentName goes straight to the master),
+		// hear its emitters from its own listener, and run its mix through a chain of effects before passing it on.
+		// Groups without a listener use their parent's, and so on up to the one from setListener().
+		virtual void setGroupParent(const String& groupName, const String& parentName) = 0;
+		virtual void setGroupListener(const String& groupName, AudioListenerData listener) = 0;
+		virtual void clearGroupListener(const String& groupName) = 0;
+		virtual void setGroupEffects(const String& groupName, std::vector<AudioEffectConfig> effects) = 0;
 	};
 }
@@ -4,18 +4,36 @@
 #include "halley/core/game/environment.h"
 #include "halley/time/stopwatch.h"
 #include <cstdint>
+#include <memory>
+#include <halley/data_structures/vector.h>
+#include <halley/text/halleystring.h>
 
 namespace Halley
 {
 	class Resources;
 	class Stage;
 	class HalleyStatics;
+	class LateLatch;
+	class FramePacer;
 
 	enum class CoreAPITimer
 	{
 		Engine,
 		Game,
-		Vsync
+		Vsync,
+		Idle
+	};
+
+	// Deferrable work that Core runs once per frame, after rendering, e.g. stepping a script VM's garbage collector.
+	// Each task is responsible for keeping within its own time budget.
+	class IIdleTask
+	{
+	public:
+		virtual ~IIdleTask() {}
+		virtual void runIdle() = 0;
+
+		// One line for the stats view, or blank for nothing
+		virtual String getIdleStats() const { return ""; }
 	};
 
 	class CoreAPI
@@ -28,11 +46,32 @@ namespace Halley
 		virtual void initStage(Stage& stage) = 0;
 		virtual Stage& getCurrentStage() = 0;
 
+		// Loads a stage in the background while the current one keeps running. If startWhenReady, it's switched to at the end
+		// of the frame it finishes loading on; otherwise, that's done by calling startPreloadedStage() once isStagePreloaded().
+		virtual void preloadStage(StageID stage, bool startWhenReady = true) = 0;
+		virtual void preloadStage(std::unique_ptr<Stage> stage, bool startWhenReady = true) = 0;
+		virtual bool isStagePreloaded() const = 0;
+		virtual float getStagePreloadProgress() const = 0;
+		virtual void startPreloadedStage() = 0;
+
 		virtual const HalleyStatics& getStatics() = 0;
 		
 		virtual Resources& getResources() = 0;
 		virtual const Environment& getEnvironment() = 0;
 
 		virtual int64_t getTime(CoreAPITimer timer, TimeLine tl, StopwatchAveraging::Mode mode) const = 0;
+
+		// Tasks aren't owned, remove them before destroying them
+		virtual void addIdleTask(IIdleTask& task) = 0;
+		virtual void removeIdleTask(IIdleTask& task) = 0;
+		virtual const Vector<IIdleTask*>& getIdleTasks() const = 0;
+
+		virtual LateLatch& getLateLatch() = 0;
+
+		// Only while the main loop runs at a fixed rate
+		virtual const FramePacer* getFramePacer() const = 0;
+
+		// See Game::isDedicatedServer()
+		virtual bool isDedicatedServer() const = 0;
 	};
 }
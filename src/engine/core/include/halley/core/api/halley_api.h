@@ -1,4 +1,6 @@
 #pragma once
+#include <thread>
+#include <exception>
 #include "halley_api_internal.h"
 #include "halley/core/resources/resources.h"
 
@@ -29,6 +31,9 @@ namespace Halley
 		std::unique_ptr<NetworkAPIInternal> networkInternal;
 		std::unique_ptr<MovieAPIInternal> movieInternal;
 
+		std::thread backgroundInit;
+		std::exception_ptr backgroundInitError;
+
 	public:
 		~HalleyAPI();
 		CoreAPI* core;
@@ -50,6 +55,7 @@ namespace Halley
 		friend class Core;
 
 		void init();
+		void waitForInit(); // Until the APIs initializing in the background are done, rethrowing anything they threw
 		void deInit();
 		void assign();
 		static std::unique_ptr<HalleyAPI> create(CoreAPIInternal* core, int flags);
@@ -25,6 +25,9 @@ namespace Halley
 		virtual void init() = 0;
 		virtual void deInit() = 0;
 
+		// Whether init() can run on a worker thread, alongside the other APIs' init() and the loading of resources
+		virtual bool canInitInBackground() const { return false; }
+
 		virtual void onSuspend() {}
 		virtual void onResume() {}
 	};
@@ -35,6 +38,11 @@ namespace Halley
 		virtual ~VideoAPIInternal() {}
 
 		virtual std::unique_ptr<Painter> makePainter(Resources& resources) = 0;
+
+		// A painter that can be used from another thread, recording into a command list instead of drawing, or nullptr if unsupported.
+		// Each frame it records (startRender() to endRender()) is played back on the main thread by submitDeferred(), or at finishRender() if it wasn't.
+		virtual std::unique_ptr<Painter> makeDeferredPainter(Resources& resources);
+		virtual void submitDeferred(Painter& painter) {}
 	};
 
 	class InputAPIInternal : public InputAPI, public HalleyAPIInternal
@@ -43,6 +51,9 @@ namespace Halley
 		virtual ~InputAPIInternal() {}
 
 		virtual void beginEvents(Time t) = 0;
+
+		// Events are then collected by a thread of the backend's own, and only handed to devices as each frame's events are pumped
+		virtual void setEventThreadEnabled(bool enabled) {}
 	};
 
 	class AudioAPIInternal : public AudioAPI, public HalleyAPIInternal
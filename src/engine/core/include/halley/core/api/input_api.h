@@ -3,8 +3,10 @@
 #include <functional>
 #include "halley/maths/vector2.h"
 #include "halley/core/input/input_device.h"
+#include "halley/core/input/input_event_queue.h"
 #include "halley/maths/colour.h"
 #include "halley/data_structures/maybe.h"
+#include "halley/concurrency/future.h"
 
 namespace Halley
 {
@@ -37,6 +39,12 @@ namespace Halley
 
 		virtual void setMouseRemapping(std::function<Vector2f(Vector2i)> remapFunction) = 0;
 
+		// Timestamped presses and releases of every device, if the backend provides them (see InputVirtual::setEventQueue)
+		virtual std::shared_ptr<InputEventQueue> getEventQueue() const { return {}; }
+
+		// Reads the latest mouse positions from the OS, outside of the usual event pump; used by LateLatch
+		virtual void sampleLateInput() {}
+
 		virtual Future<bool> requestControllerSetup(int minControllers, int maxControllers, Maybe<std::vector<InputControllerData>> controllerData = {})
 		{
 			Promise<bool> promise;
@@ -4,6 +4,8 @@
 namespace Halley
 {
 	class NetworkService;
+	class HTTPRequest;
+	class String;
 
 	enum class NetworkProtocol
 	{
@@ -16,5 +18,13 @@ namespace Halley
 	public:
 		virtual ~NetworkAPI() {}
 		virtual std::unique_ptr<NetworkService> createService(NetworkProtocol protocol, int port = 0) = 0;
+
+		// For servers running many sessions at once. Where supported, UDP services receive on numSockets sockets sharing the port
+		// (one per core if 0), each drained by a thread of its own; otherwise, this is the same as createService.
+		virtual std::unique_ptr<NetworkService> createHighFanInService(NetworkProtocol protocol, int port, size_t numSockets = 0);
+
+		// Requests to the same host share keep-alive connections, and run in the background without tying up a thread each.
+		// Returns empty if not supported.
+		virtual std::unique_ptr<HTTPRequest> makeHTTPRequest(const String& method, const String& url) = 0;
 	};
 }
@@ -1,7 +1,9 @@
 #pragma once
 
+#include <functional>
 #include <memory>
 #include <map>
+#include <gsl/gsl>
 #include <halley/concurrency/future.h>
 #include <halley/utils/utils.h>
 #include "halley/text/i18n.h"
@@ -32,6 +34,10 @@ namespace Halley
 		virtual void setPostData(const String& contentType, const Bytes& data) = 0;
 		virtual void setHeader(const String& headerName, const String& headerValue) = 0;
 		virtual Future<std::unique_ptr<HTTPResponse>> send() = 0;
+
+		// Hands the body over as it arrives, instead of collecting it into the response (return false to stop receiving).
+		// It might be called from any thread. Returns false if this implementation can't, in which case the body is collected as usual.
+		virtual bool setResponseSink(std::function<bool(gsl::span<const gsl::byte>)> sink) { return false; }
 	};
 
 	class AuthorisationToken {
@@ -3,6 +3,7 @@
 #include <array>
 #include <halley/utils/utils.h>
 #include <halley/text/string_converter.h>
+#include <halley/bytes/byte_serializer.h>
 #include <limits>
 
 #ifdef max
@@ -40,6 +41,7 @@ namespace Halley {
 		virtual std::vector<String> enumerate(const String& root) = 0;
 
 		virtual void setData(const String& path, const Bytes& data, bool commit = true) = 0;
+		virtual void setSerializedData(const String& path, const SerializedChunks& data, bool commit = true) { setData(path, data.toBytes(), commit); } // See Serializer::toChunks
 		virtual void commit() = 0;
 		virtual size_t getFreeSpace() { return std::numeric_limits<size_t>::max(); }
 	};
@@ -5,6 +5,7 @@
 #include "halley/core/graphics/window.h"
 #include "halley/concurrency/concurrent.h"
 #include "halley/data_structures/maybe.h"
+#include "halley/support/profiler.h"
 
 namespace Halley
 {
@@ -20,6 +21,7 @@ namespace Halley
 	public:
 		virtual ~GLContext() {}
 		virtual void bind() = 0;
+		virtual void unbind() = 0;
 		virtual std::unique_ptr<GLContext> createSharedContext() = 0;
 	};
 
@@ -50,11 +52,14 @@ namespace Halley
 		{
 			return std::thread([=] () {
 				setThreadName(name);
+				setThreadPriority(priority);
+				Profiler::setThreadName(name);
 				runnable();
 			});
 		}
 
 		virtual void setThreadName(const String& name) {}
+		virtual void setThreadPriority(ThreadPriority priority) {} // Of the calling thread
 
 		virtual void runGame(std::function<void()> runnable) { runnable(); }
 		virtual bool canExit() { return false; }
@@ -3,6 +3,8 @@
 #include <halley/maths/rect.h>
 #include <halley/text/halleystring.h>
 #include <halley/file/path.h>
+#include <memory>
+#include <vector>
 
 namespace Halley
 {
@@ -11,6 +13,7 @@ namespace Halley
 	class Painter;
 	class Texture;
 	class TextureDescriptor;
+	class TextureUploadQueue;
 	class TextureRenderTarget;
 	class ScreenRenderTarget;
 	class Shader;
@@ -39,6 +42,27 @@ namespace Halley
 
 		virtual String getShaderLanguage() = 0;
 
+		// Where textures loaded as resources are uploaded from, if this API paces them; otherwise they're loaded as soon as they're read
+		virtual TextureUploadQueue* getTextureUploadQueue() { return nullptr; }
+
+		// GPU time taken by a recent frame, from startRender() to finishRender(), on APIs with timer queries.
+		// Results are read back a few frames late so the CPU never waits for them; 0 if there isn't one yet.
+		virtual int64_t getGPUFrameNanoSeconds() const { return 0; }
+
+		// For rendering on a thread other than the one that created the window. The calling thread takes
+		// ownership of the device context in acquireRenderContext(), after the previous owner released it.
+		// Only true if textures, shaders and render targets can still be created, loaded and destroyed from
+		// the thread that gave the context away, as resources keep doing that from the main thread.
+		virtual bool canRenderOnAnotherThread() const { return false; }
+		virtual void acquireRenderContext() {}
+		virtual void releaseRenderContext() {}
+
+		// Copies a texture owned by the underlying graphics API (e.g. a hardware decoder's output surface, with type
+		// "ID3D11Texture2D") into planes, without going through the CPU. Multi-planar formats get one texture per plane,
+		// so NV12 becomes luma and chroma. Planes that are passed in with the right size are reused.
+		// Returns false if this API can't handle the type or format, in which case the caller should read it back instead.
+		virtual bool copyNativeTexture(const String& type, void* handle, int arraySlice, std::vector<std::shared_ptr<Texture>>& planes) { return false; }
+
 		virtual void* getImplementationPointer(const String& id) { return nullptr; }
 	};
 }
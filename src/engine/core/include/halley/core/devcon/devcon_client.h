@@ -3,6 +3,7 @@
 #include "halley/text/halleystring.h"
 #include "halley/support/logger.h"
 #include "devcon_server.h"
+#include <chrono>
 
 namespace Halley
 {
@@ -20,6 +21,9 @@ namespace Halley
 		void update();
 
 		void onReceiveReloadAssets(const DevCon::ReloadAssetsMsg& msg);
+		void onReceiveSetProfiler(const DevCon::SetProfilerMsg& msg);
+		void onReceiveSetNetworkStats(const DevCon::SetNetworkStatsMsg& msg);
+		void onReceiveSetTelemetry(const DevCon::SetTelemetryMsg& msg);
 
 	private:
 		const HalleyAPI& api;
@@ -29,7 +33,19 @@ namespace Halley
 
 		std::shared_ptr<MessageQueue> queue;
 
+		bool streamingProfiler = false;
+		ProfilerCursor profilerCursor;
+
+		bool streamingNetworkStats = false;
+		std::chrono::steady_clock::time_point lastNetworkStatsSent;
+
+		bool streamingTelemetry = false;
+		std::chrono::steady_clock::time_point lastTelemetrySent;
+
 		void connect();
+		void sendProfilerCapture();
+		void sendNetworkStats();
+		void sendTelemetry();
 		void log(LoggerLevel level, const String& msg) override;
 	};
 }
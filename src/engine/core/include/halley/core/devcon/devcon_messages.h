@@ -1,6 +1,9 @@
 #pragma once
 #include "halley/support/logger.h"
+#include "halley/support/profiler.h"
+#include "halley/support/telemetry.h"
 #include "halley/net/connection/network_message.h"
+#include "halley/net/connection/network_stats.h"
 #include <gsl/gsl>
 
 namespace Halley
@@ -17,7 +20,13 @@ namespace Halley
 		enum class MessageType
 		{
 			Log,
-			ReloadAssets
+			ReloadAssets,
+			SetProfiler,
+			ProfilerCapture,
+			SetNetworkStats,
+			NetworkStats,
+			SetTelemetry,
+			Telemetry
 		};
 
 
@@ -60,5 +69,101 @@ namespace Halley
 		private:
 			std::vector<String> ids;
 		};
+
+		class SetProfilerMsg : public DevConMessage
+		{
+		public:
+			SetProfilerMsg(gsl::span<const gsl::byte> data);
+			SetProfilerMsg(bool enabled);
+
+			void serialize(Serializer& s) const override;
+
+			bool isEnabled() const;
+
+			MessageType getMessageType() const override;
+
+		private:
+			bool enabled;
+		};
+
+		class ProfilerCaptureMsg : public DevConMessage
+		{
+		public:
+			ProfilerCaptureMsg(gsl::span<const gsl::byte> data);
+			ProfilerCaptureMsg(Halley::ProfilerCapture capture);
+
+			void serialize(Serializer& s) const override;
+
+			const Halley::ProfilerCapture& getCapture() const;
+
+			MessageType getMessageType() const override;
+
+		private:
+			Halley::ProfilerCapture capture;
+		};
+
+		class SetNetworkStatsMsg : public DevConMessage
+		{
+		public:
+			SetNetworkStatsMsg(gsl::span<const gsl::byte> data);
+			SetNetworkStatsMsg(bool enabled);
+
+			void serialize(Serializer& s) const override;
+
+			bool isEnabled() const;
+
+			MessageType getMessageType() const override;
+
+		private:
+			bool enabled;
+		};
+
+		class NetworkStatsMsg : public DevConMessage
+		{
+		public:
+			NetworkStatsMsg(gsl::span<const gsl::byte> data);
+			NetworkStatsMsg(std::vector<NetworkConnectionStats> stats);
+
+			void serialize(Serializer& s) const override;
+
+			const std::vector<NetworkConnectionStats>& getStats() const;
+
+			MessageType getMessageType() const override;
+
+		private:
+			std::vector<NetworkConnectionStats> stats;
+		};
+
+		class SetTelemetryMsg : public DevConMessage
+		{
+		public:
+			SetTelemetryMsg(gsl::span<const gsl::byte> data);
+			SetTelemetryMsg(bool enabled);
+
+			void serialize(Serializer& s) const override;
+
+			bool isEnabled() const;
+
+			MessageType getMessageType() const override;
+
+		private:
+			bool enabled;
+		};
+
+		class TelemetryMsg : public DevConMessage
+		{
+		public:
+			TelemetryMsg(gsl::span<const gsl::byte> data);
+			TelemetryMsg(std::vector<TelemetryValue> values);
+
+			void serialize(Serializer& s) const override;
+
+			const std::vector<TelemetryValue>& getValues() const;
+
+			MessageType getMessageType() const override;
+
+		private:
+			std::vector<TelemetryValue> values;
+		};
 	}
 }
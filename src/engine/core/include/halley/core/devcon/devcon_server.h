@@ -3,6 +3,8 @@
 #include <vector>
 #include <memory>
 #include "halley/text/halleystring.h"
+#include "halley/support/profiler.h"
+#include "halley/support/telemetry.h"
 #include <set>
 
 namespace Halley
@@ -10,27 +12,47 @@ namespace Halley
 	class NetworkService;
 	class IConnection;
 	class MessageQueue;
+	struct NetworkConnectionStats;
 
 	namespace DevCon {
 		constexpr static int devConPort = 12500;
 		class LogMsg;
 		class ReloadAssetsMsg;
+		class ProfilerCaptureMsg;
+		class SetProfilerMsg;
+		class SetNetworkStatsMsg;
+		class NetworkStatsMsg;
+		class SetTelemetryMsg;
+		class TelemetryMsg;
 	}
 
 	class DevConServerConnection
 	{
 	public:
 		DevConServerConnection(std::shared_ptr<IConnection> connection);
+		~DevConServerConnection();
 		
 		void update();
 		
 		void reloadAssets(const std::vector<String>& assetIds);
+		void setProfilerEnabled(bool enabled);
+		ProfilerCapture takeProfilerCapture();
+		void setNetworkStatsEnabled(bool enabled);
+		const std::vector<NetworkConnectionStats>& getNetworkStats() const;
+		void setTelemetryEnabled(bool enabled);
+		std::vector<std::vector<TelemetryValue>> takeTelemetry();
 
 	private:
 		std::shared_ptr<IConnection> connection;
 		std::shared_ptr<MessageQueue> queue;
+		ProfilerCapture profilerCapture;
+		std::vector<NetworkConnectionStats> networkStats;
+		std::vector<std::vector<TelemetryValue>> telemetry;
 
 		void onReceiveLogMsg(const DevCon::LogMsg& msg);
+		void onReceiveProfilerCaptureMsg(const DevCon::ProfilerCaptureMsg& msg);
+		void onReceiveNetworkStatsMsg(const DevCon::NetworkStatsMsg& msg);
+		void onReceiveTelemetryMsg(const DevCon::TelemetryMsg& msg);
 	};
 
 	class DevConServer
@@ -43,8 +65,22 @@ namespace Halley
 		void reloadAssets(std::vector<String> assetIds);
 		void reloadAssets(std::set<String> assetIds);
 
+		// While enabled, connected games stream their profiler events here
+		void setProfilerEnabled(bool enabled);
+		ProfilerCapture takeProfilerCapture();
+
+		// While enabled, connected games periodically report the stats of all their network connections
+		void setNetworkStatsEnabled(bool enabled);
+		std::vector<NetworkConnectionStats> getNetworkStats() const;
+
+		// While enabled, connected games send a few samples a second of everything registered with Telemetry.
+		// Games that connect later are enabled too. Returns the samples received since the last call, oldest first.
+		void setTelemetryEnabled(bool enabled);
+		std::vector<std::vector<TelemetryValue>> takeTelemetry();
+
 	private:
 		std::unique_ptr<NetworkService> service;
 		std::vector<std::shared_ptr<DevConServerConnection>> connections;
+		bool telemetryEnabled = false;
 	};
 }
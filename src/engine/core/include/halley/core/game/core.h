@@ -6,12 +6,16 @@
 #include <halley/time/stopwatch.h>
 #include <halley/support/redirect_stream.h>
 #include <halley/core/stage/stage.h>
+#include <halley/core/stage/hot_reload_state.h>
 #include <halley/runner/main_loop.h>
 #include <halley/plugin/plugin.h>
 #include <halley/core/api/halley_api_internal.h>
 #include "halley_statics.h"
 #include <halley/data_structures/tree_map.h>
+#include <halley/concurrency/future.h>
+#include <exception>
 #include "halley/support/logger.h"
+#include "halley/support/telemetry.h"
 
 namespace Halley
 {
@@ -19,12 +23,16 @@ namespace Halley
 	class HalleyAPI;
 	class Stage;
 	class Painter;
+	class RecordingPainter;
+	class RenderCommandList;
+	class RenderThread;
 	class Camera;
 	class RenderTarget;
 	class Environment;
 	class DevConClient;
+	class LateLatch;
 
-	class Core final : public CoreAPIInternal, public IMainLoopable, public ILoggerSink
+	class Core final : public CoreAPIInternal, public IMainLoopable, public ILoggerSink, public ITelemetrySource
 	{
 	public:
 		Core(std::unique_ptr<Game> game, Vector<std::string> args);
@@ -35,10 +43,23 @@ namespace Halley
 		void setStage(std::unique_ptr<Stage> stage) override;
 		void initStage(Stage& stage) override;
 		Stage& getCurrentStage() override;
+		void preloadStage(StageID stage, bool startWhenReady) override;
+		void preloadStage(std::unique_ptr<Stage> stage, bool startWhenReady) override;
+		bool isStagePreloaded() const override;
+		float getStagePreloadProgress() const override;
+		void startPreloadedStage() override;
 		void quit(int exitCode = 0) override;
 		Resources& getResources() override;
 		const Environment& getEnvironment() override;
 		int64_t getTime(CoreAPITimer timer, TimeLine tl, StopwatchAveraging::Mode mode) const override;
+		void addIdleTask(IIdleTask& task) override;
+		void removeIdleTask(IIdleTask& task) override;
+		const Vector<IIdleTask*>& getIdleTasks() const override;
+		LateLatch& getLateLatch() override;
+		const FramePacer* getFramePacer() const override;
+		void setFramePacer(FramePacer* pacer) override;
+		bool isDedicatedServer() const override { return dedicatedServer; }
+		void onServerPoll() override;
 
 		void onFixedUpdate(Time time) override;
 		void onVariableUpdate(Time time) override;
@@ -57,6 +78,7 @@ namespace Halley
 		Vector<Plugin*> getPlugins(PluginType type) override;
 
 		void log(LoggerLevel level, const String& msg) override;
+		void getTelemetry(std::vector<TelemetryValue>& values) const override;
 
 		int getExitCode() const { return exitCode; }
 
@@ -64,20 +86,28 @@ namespace Halley
 		void deInit();
 
 		void initResources();
+		void finishStartupTrace();
 		void setOutRedirect(bool appendToExisting);
 
 		void doFixedUpdate(Time time);
 		void doVariableUpdate(Time time);
 		void doRender(Time time);
+		void doIdle();
+		void startRenderThread();
+		void stopRenderThread();
 
 		void showComputerInfo() const;
 
 		void pumpEvents(Time time);
+		void updateStagePreload();
+		void cancelStagePreload();
 		void pumpAudio();
 
 		std::array<StopwatchAveraging, int(TimeLine::NUMBER_OF_TIMELINES)> engineTimers;
 		std::array<StopwatchAveraging, int(TimeLine::NUMBER_OF_TIMELINES)> gameTimers;
 		StopwatchAveraging vsyncTimer;
+		StopwatchAveraging idleTimer;
+		Vector<IIdleTask*> idleTasks;
 
 		Vector<String> args;
 
@@ -87,17 +117,33 @@ namespace Halley
 		std::unique_ptr<Resources> resources;
 
 		std::unique_ptr<Painter> painter;
+		std::unique_ptr<RecordingPainter> recordingPainter;
+		std::unique_ptr<RenderCommandList> frameCommands;
+		std::unique_ptr<RenderThread> renderThread;
 		std::unique_ptr<Camera> camera;
 		std::unique_ptr<RenderTarget> screenTarget;
+		std::unique_ptr<LateLatch> lateLatch;
+		FramePacer* framePacer = nullptr;
 		Vector2i prevWindowSize = Vector2i(-1, -1);
 
 		std::unique_ptr<Stage> currentStage;
 		std::unique_ptr<Stage> nextStage;
 		bool pendingStageTransition = false;
+		std::unique_ptr<HotReloadState> reloadState; // Given to the stage replacing the current one after a hot reload
+
+		std::unique_ptr<Stage> preloadingStage;
+		ResourcePrefetch stagePrefetch;
+		Future<std::exception_ptr> stageLoad; // Bound once stagePrefetch is done and loadAsync() is running
+		bool stageLoadStarted = false;
+		bool startPreloadedWhenReady = false;
 
 		bool running = true;
 		bool hasError = false;
 		bool hasConsole = false;
+		bool dedicatedServer = false;
+		bool tracingStartup = false; // Enabled with --trace-startup
+		bool profilerWasEnabled = false;
+		int64_t startupBeginTime = 0;
 		int exitCode = 0;
 		std::unique_ptr<RedirectStream> out;
 
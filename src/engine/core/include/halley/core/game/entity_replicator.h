@@ -0,0 +1,103 @@
+#pragma once
+
+#include <map>
+#include <halley/entity/service.h>
+#include <halley/entity/entity_id.h>
+#include <halley/maths/rect.h>
+#include <halley/maths/vector2.h>
+#include <halley/time/halleytime.h>
+#include <halley/data_structures/flat_hash_map.h>
+#include <halley/data_structures/vector.h>
+#include <halley/utils/utils.h>
+#include "halley/net/connection/network_packet.h"
+
+namespace Halley {
+	class World;
+	class NetworkSession;
+
+	// Replicates the host's entities to clients over a NetworkSession, sending each peer only what's relevant to it.
+	// The host tells it where each peer is looking from with setPeerView(). Using the world's SpatialIndexService, entities within the
+	// peer's visible area, or within one of the distance buckets around its viewpoint, are relevant to that peer; the rest aren't, and are
+	// destroyed on its side. Relevant entities accumulate priority every update, at their bucket's rate, and are sent highest priority first
+	// until the peer's bandwidth budget runs out. Whatever is sent starts over from zero. So nearby and visible entities update often, distant
+	// ones now and then, and a crowd costs the same bandwidth as a few, only updating less often.
+	//
+	// Only components marked as replicated in their schema are sent. Clients create, update and destroy their own copies of whatever
+	// they're sent, and must call initializeReplicatedComponents() from the generated registry before receiving anything.
+	// As with RollbackSession, once it's in use all other game traffic must go through its send() and receive(), as they share the session.
+	class EntityReplicator : public Service
+	{
+	public:
+		struct RelevancyBucket
+		{
+			float maxDistance; // From the peer's viewpoint
+			float priority; // Accumulated per second
+		};
+
+		struct Config
+		{
+			Vector<RelevancyBucket> buckets = { { 256.0f, 30.0f }, { 768.0f, 10.0f }, { 2048.0f, 2.0f } };
+			float visiblePriority = 60.0f; // Within the peer's visible area, wherever that is
+			float bytesPerSecond = 32.0f * 1024.0f; // Per peer
+			size_t maxPacketSize = 1200; // Bytes, so packets don't get fragmented
+			Time resendInterval = 1.0; // Packets may be lost, so unchanged entities are still sent this often
+			int destroyRedundancy = 4; // Destroys go in this many consecutive packets
+		};
+
+		EntityReplicator(World& world, NetworkSession& session, Config config);
+
+		// Host only
+		void setPeerView(int peerId, Vector2f position, Rect4f visibleArea);
+		void removePeer(int peerId);
+		void setAlwaysRelevant(EntityId id, bool alwaysRelevant); // To every peer, at visiblePriority; e.g. entities that aren't in the spatial index
+		void update(Time elapsed); // Sends what fits in each peer's budget; the spatial index should be synced before this
+
+		// Client only
+		EntityId getLocalEntity(EntityId hostId) const; // Invalid if it's not replicated here
+
+		void send(OutboundNetworkPacket&& packet);
+		bool receive(InboundNetworkPacket& packet);
+
+	private:
+		struct EntityState
+		{
+			float priority = 0;
+			float rate = 0;
+			Time sinceSent = 0;
+			uint64_t lastHash = 0;
+			uint32_t lastRelevant = 0;
+			bool sent = false;
+		};
+
+		struct Peer
+		{
+			Vector2f position;
+			Rect4f visibleArea;
+			float budget = 0; // Bytes, and may go negative, as an entity is never split across packets
+			FlatHashMap<EntityId, EntityState> entities;
+			Vector<std::pair<EntityId, int>> pendingDestroys; // With how many more packets they go in
+		};
+
+		World& world;
+		NetworkSession& session;
+		const Config config;
+
+		std::map<int, Peer> peers;
+		Vector<EntityId> alwaysRelevant;
+		uint32_t updateId = 0;
+
+		FlatHashMap<EntityId, EntityId> hostToLocal;
+		Vector<InboundNetworkPacket> gameInbox;
+
+		// Scratch, kept around to reuse their memory
+		Vector<EntityId> queryResults;
+		Vector<std::pair<float, EntityId>> sendOrder;
+
+		void updatePeer(Peer& peer, Time elapsed);
+		void markRelevant(Peer& peer, EntityId id, float rate);
+		void sendReplicas(int peerId, Peer& peer);
+
+		void receivePackets();
+		void onReplication(gsl::span<const gsl::byte> data);
+	};
+}
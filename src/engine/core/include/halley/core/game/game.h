@@ -9,6 +9,8 @@ namespace Halley
 	class Stage;
 	class Environment;
 	class GameConsole;
+	class FramePacer;
+	struct ExecutorsTopology;
 	
 	class Game
 	{
@@ -24,6 +26,12 @@ namespace Halley
 		virtual bool isDevMode() const = 0;
 		virtual bool shouldCreateSeparateConsole() const { return isDevMode(); }
 
+		// Runs headless: no video, audio, input or movie APIs are created, whatever initPlugins() asks for, only data resources
+		// (config, text and binary files) can be loaded, and worlds don't create their render systems. Frames only run when a fixed
+		// step is due, with the wait in between spent in Stage::onServerPoll(). Targets made with halleyProjectServer() define
+		// HALLEY_DEDICATED_SERVER and link no graphics or audio backends, so games can return that from here.
+		virtual bool isDedicatedServer() const { return false; }
+
 		virtual std::unique_ptr<Stage> startGame(const HalleyAPI*) = 0;
 		virtual void endGame() {}
 
@@ -31,6 +39,21 @@ namespace Halley
 
 		virtual int getTargetFPS() const { return 60; }
 
+		// Frame cap, catch-up limits, refresh rate and power mode; fixed steps always run at getTargetFPS()
+		virtual void setupFramePacer(FramePacer& pacer) const {}
+
+		// Thread counts and CPU placement of the CPU, CPUAux and IO pools, before they start; e.g. keeping CPUAux on efficiency cores
+		virtual void setupExecutors(ExecutorsTopology& topology) const {}
+
+		// Records each frame on the main thread and submits it to the video backend on a separate one, so the next frame can be
+		// updated in the meantime. Render targets must then outlive the frame after the one they were last used in.
+		// Ignored unless the video plugin supports it (see VideoAPI::canRenderOnAnotherThread()).
+		virtual bool shouldRenderOnSeparateThread() const { return false; }
+
+		// Takes input events from the backend on a thread of their own as they arrive, instead of once per frame, so they're read at the same
+		// pace however long frames take. Where the backend supports it (see InputAPIInternal::setEventThreadEnabled).
+		virtual bool shouldProcessInputOnSeparateThread() const { return false; }
+
 		virtual String getDevConAddress() const { return ""; }
 		virtual int getDevConPort() const { return 12500; }
 
@@ -5,6 +5,7 @@ namespace Halley
 {
 	class HalleyStaticsPimpl;
 	class SystemAPI;
+	struct ExecutorsTopology;
 
 	class HalleyStatics
 	{
@@ -12,6 +13,7 @@ namespace Halley
 		HalleyStatics();
 		~HalleyStatics();
 		void setupGlobals() const;
+		void setExecutorsTopology(const ExecutorsTopology& topology); // Takes effect on the next resume()
 		void resume(SystemAPI* system);
 		void suspend();
 
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vector>
+#include <halley/entity/service.h>
+#include <halley/time/halleytime.h>
+#include <halley/utils/utils.h>
+#include "halley/net/connection/network_packet.h"
+
+namespace Halley {
+	class World;
+	class NetworkSession;
+
+	// Rollback netcode over a NetworkSession, where each peer is one player, for a World in deterministic mode.
+	// Local input is sampled every fixed step and applied inputDelay frames later. Every peer sends its inputs to all the others, and
+	// frames go ahead without waiting for them, predicting that each remote player keeps doing what they last did. When a remote input
+	// arrives that doesn't match its prediction, the world is rolled back to its snapshot from before that frame, and every frame since is
+	// simulated again (only the FixedUpdate timeline, with World::isResimulating() set).
+	// At 60 Hz, the defaults (2 frames of input delay, rolling back up to 8) hide round trips of about 150 ms; past that, frames stall
+	// until the inputs catch up.
+	//
+	// Add it to the world as a service, so systems can read the inputs of the frame being simulated with getInput(). Once it's in use,
+	// all other game traffic must go through its send() and receive(), as they share the session.
+	class RollbackSession : public Service
+	{
+	public:
+		struct Config
+		{
+			Time fixedStep = 1.0 / 60.0;
+			int numPlayers = 2;
+			int inputDelay = 2; // Frames
+			int maxRollback = 8; // Frames
+			int inputRedundancy = 8; // Inputs aren't sent reliably, so each one goes in this many consecutive packets
+		};
+
+		RollbackSession(World& world, NetworkSession& session, Config config);
+
+		void setLocalInput(Bytes input); // Sampled on every fixed step from now on, until it's changed
+		void update(Time elapsed); // Receives inputs, rolls back if needed, then runs however many fixed steps are due
+
+		const Bytes& getInput(int player) const; // For the frame being simulated
+		bool isInputPredicted(int player) const;
+		uint32_t getFrame() const; // The next frame to simulate
+		uint32_t getConfirmedFrame() const; // Every frame before this one was simulated with everyone's actual inputs
+		int getLastRollbackLength() const; // Frames resimulated by the last update()
+		bool isStalled() const; // Waiting on a remote player's inputs, as it can't roll back any further
+
+		void send(OutboundNetworkPacket&& packet);
+		bool receive(InboundNetworkPacket& packet);
+
+	private:
+		struct InputSlot
+		{
+			uint32_t frame = 0;
+			bool confirmed = false;
+			Bytes input;
+			uint32_t usedFrame = uint32_t(-1);
+			Bytes used; // What the frame was last simulated with
+		};
+
+		struct Player
+		{
+			std::vector<InputSlot> slots; // Ring, by frame
+			uint32_t confirmedUpTo = 0; // First frame without an input
+		};
+
+		struct Snapshot
+		{
+			uint32_t frame = uint32_t(-1);
+			Bytes data;
+		};
+
+		World& world;
+		NetworkSession& session;
+		const Config config;
+		const size_t historySize;
+
+		std::vector<Player> players;
+		std::vector<Snapshot> snapshots; // Ring, by frame
+		std::vector<InboundNetworkPacket> gameInbox;
+
+		Bytes localInput;
+		std::vector<const Bytes*> frameInputs;
+		std::vector<char> framePredicted;
+
+		Time accumulator = 0;
+		uint32_t frame = 0;
+		uint32_t rollbackFrom = uint32_t(-1);
+		uint32_t nextHashFrame = 0;
+		int lastRollbackLength = 0;
+		bool stalled = false;
+
+		int getLocalPlayer() const;
+		InputSlot& getSlot(int player, uint32_t frame);
+		void confirmInput(int player, uint32_t frame, Bytes input);
+
+		void receivePackets();
+		void onInputs(gsl::span<const gsl::byte> data);
+		void sendLocalInputs(uint32_t lastFrame);
+
+		bool canAdvance() const;
+		void simulateFrame(uint32_t frame, bool takeSnapshot);
+		void rollback();
+		void reportHashes();
+	};
+}
@@ -25,6 +25,7 @@
 #include "halley/maths/angle.h"
 #include "halley/maths/rect.h"
 #include "halley/maths/matrix4.h"
+#include "halley/maths/transform_2d.h"
 #include "halley/data_structures/maybe.h"
 
 namespace Halley {
@@ -39,6 +40,7 @@ namespace Halley {
 		Camera& setPosition(Vector2f pos);
 		Camera& setAngle(Angle1f angle);
 		Camera& setZoom(float zoom);
+		Camera& setTransform(const Transform2D& transform); // Position and angle only, as zoom works the other way around from scale
 
 		Camera& resetRenderTarget();
 		Camera& setRenderTarget(RenderTarget& target);
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <halley/maths/vector2.h>
+#include <halley/maths/vector4.h>
+#include <halley/time/halleytime.h>
+#include "halley/core/graphics/camera.h"
+#include "halley/core/graphics/render_graph.h"
+
+namespace Halley
+{
+	class Resources;
+	class Material;
+	class Painter;
+	class VideoAPI;
+
+	struct UpscaleVertexAttrib
+	{
+		// This structure must match the layout of the shader
+		// See shared_assets/material/upscale.yaml for reference
+		Vector4f vertPos;
+		Vector2f position;
+		Vector2f size;
+	};
+
+	// Lowers the resolution the scene is drawn at whenever the GPU can't keep up, and raises it back once it can.
+	// The scene is drawn into a target of the output's size, but only into the top-left part of it, scaled down, so changing the scale
+	// never reallocates anything. That part is then upscaled into the output, with a bit of sharpening to make up for the filtering.
+	// The scale follows the GPU time of each frame, as measured by the video plugin, which is assumed proportional to the number of
+	// pixels drawn. Without a measurement (getGPUFrameNanoSeconds() returning 0) it stays wherever it was.
+	//
+	// Only the scene is scaled: the UI should be drawn by a pass that writes output after the ones added here, e.g. with UIRoot::draw(),
+	// so it stays at native resolution.
+	class DynamicResolution
+	{
+	public:
+		struct Config
+		{
+			Time targetGPUTime = 1.0 / 60.0 * 0.9; // Seconds per frame; leave some room for the CPU and the vsync
+			float headroom = 0.15f; // The scale only goes up once frames take less than this fraction under the target
+			float minScale = 0.5f;
+			float maxScale = 1.0f;
+			float responsiveness = 0.5f; // How much of the way to the ideal scale each change goes [0..1]
+			int settleFrames = 4; // The GPU time lags behind, so it waits this many frames after each change
+			float sharpness = 0.5f; // Of the upscale [0..1]
+		};
+
+		DynamicResolution(Resources& resources, Config config);
+
+		// Call once a frame, before drawing, to adjust the scale from the last frame's GPU time
+		void update(const VideoAPI& video);
+
+		void setAutomatic(bool automatic); // If false, the scale only changes through setScale()
+		bool isAutomatic() const;
+		void setScale(float scale);
+		float getScale() const;
+		Vector2i getScaledSize(Vector2i nativeSize) const;
+
+		// Adds both passes, writing to output, which must be size. drawScene draws the scene, through camera, which must cover the
+		// whole of output. camera and drawScene are used every time the graph executes, so they have to outlive it.
+		void addPasses(RenderGraph& graph, RenderGraph::TargetId output, Vector2i size, Camera& camera, std::function<void(Painter&)> drawScene);
+
+		RenderGraph::TargetId getSceneTarget() const;
+
+	private:
+		const Config config;
+		std::shared_ptr<Material> upscaleMaterial;
+		float scale;
+		bool automatic = true;
+		Time averageGPUTime = 0;
+		int framesSinceChange = 0;
+
+		Camera sceneCamera;
+		Vector2i nativeSize;
+		Vector2i drawnSize; // By the last scene pass, so the upscale matches it even if the scale changes in between
+		RenderGraph::TargetId scene = -1;
+
+		void drawUpscale(Painter& painter, const RenderGraph& graph);
+	};
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <cstdint>
+#include <halley/data_structures/vector.h>
+#include <halley/maths/vector2.h>
+#include <halley/text/halleystring.h>
+
+namespace Halley {
+	class Material;
+	class InputAPI;
+	class InputDevice;
+
+	// Material values sampled again at the last moment before a frame is submitted, replacing what they were set to during update,
+	// so things that follow the mouse (cursors, mouse-driven cameras) are drawn where it is now, rather than where it was at the start of the frame.
+	// With a render thread, that's just before the recorded frame is handed over; otherwise, draws go out as they're made, so it's just before rendering starts.
+	class LateLatch {
+	public:
+		using Handle = uint32_t;
+		using Sampler = std::function<void(Material& material)>;
+
+		Handle add(std::shared_ptr<Material> material, Sampler sampler);
+
+		// Sets parameter to the mouse's position, through transform if given (e.g. from screen to world coordinates)
+		Handle addMousePosition(std::shared_ptr<Material> material, const String& parameter, std::shared_ptr<InputDevice> mouse, std::function<Vector2f(Vector2f)> transform = {});
+
+		void remove(Handle handle);
+
+		// Called by Core
+		void latch(InputAPI* input);
+
+	private:
+		struct Entry {
+			Handle handle;
+			std::shared_ptr<Material> material;
+			Sampler sampler;
+		};
+
+		Vector<Entry> entries;
+		Handle nextHandle = 1;
+	};
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <halley/maths/vector2.h>
+#include <halley/maths/vector4.h>
+#include <halley/maths/colour.h>
+#include <halley/data_structures/vector.h>
+#include "halley/core/graphics/render_graph.h"
+
+namespace Halley
+{
+	class Resources;
+	class Material;
+	class Painter;
+	class Camera;
+
+	struct PointLight2D
+	{
+		Vector2f position;
+		float radius = 100;
+		float height = 50; // Above the sprites, for normal mapping; lower lights graze more
+		Colour4f colour = Colour4f(1, 1, 1, 1);
+		float intensity = 1;
+	};
+
+	struct Light2DVertexAttrib
+	{
+		// This structure must match the layout of the shader
+		// See shared_assets/material/light_2d.yaml for reference
+		Vector4f vertPos;
+		Vector2f position;
+		Vector2f size;
+		Colour4f colour;
+		Vector4f params;
+	};
+
+	// 2D deferred lighting, as two RenderGraph passes. The first draws the scene once, into an albedo and a normal target at the same
+	// time; its sprites should use a material that writes both, such as Halley/SpriteNormalMapped with the normal map as tex1.
+	// The second draws every light as an instance of a quad that just covers its radius, adding its contribution to the output, so
+	// each light only costs the pixels it can reach. The normal of each pixel isn't rotated along with its sprite.
+	class DeferredLighting
+	{
+	public:
+		explicit DeferredLighting(Resources& resources);
+
+		void setAmbient(Colour4f colour);
+		Colour4f getAmbient() const;
+
+		// Lights are kept until cleared, so static ones only need adding once
+		void clearLights();
+		void addLight(const PointLight2D& light);
+		size_t getNumLights() const;
+
+		// Adds both passes, writing the lit scene to output, which must be size. drawScene draws what's to be lit, through camera.
+		// camera and drawScene are used every time the graph executes, so they have to outlive it.
+		void addPasses(RenderGraph& graph, RenderGraph::TargetId output, Vector2i size, Camera& camera, std::function<void(Painter&)> drawScene);
+
+		RenderGraph::TargetId getAlbedoTarget() const;
+		RenderGraph::TargetId getNormalTarget() const;
+
+	private:
+		std::shared_ptr<Material> lightMaterial;
+		Colour4f ambient = Colour4f(0, 0, 0, 1);
+		Vector<PointLight2D> lights;
+		Vector<Light2DVertexAttrib> vertices;
+		RenderGraph::TargetId albedo = -1;
+		RenderGraph::TargetId normals = -1;
+
+		void drawLights(Painter& painter, const RenderGraph& graph);
+	};
+}
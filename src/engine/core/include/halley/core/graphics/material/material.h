@@ -4,6 +4,7 @@
 #include "halley/text/halleystring.h"
 #include "halley/core/graphics/texture.h"
 #include <gsl/gsl>
+#include <type_traits>
 
 namespace Halley
 {
@@ -44,20 +45,27 @@ namespace Halley
 		MaterialDataBlock(MaterialDataBlock&& other) noexcept;
 
 		MaterialConstantBuffer& getConstantBuffer() const;
-		int getAddress(int pass, ShaderType stage) const;
+		int getAddress(int pass, ShaderType stage, int variant = 0) const;
 		int getBindPoint() const;
 		gsl::span<const gsl::byte> getData() const;
 		MaterialDataBlockType getType() const;
+		uint64_t getHash() const;
 
 	private:
-		std::unique_ptr<MaterialConstantBuffer> constantBuffer;
+		// Shared by every block with the same contents, see upload()
+		std::shared_ptr<MaterialConstantBuffer> constantBuffer;
 		Bytes data;
 		Vector<int> addresses;
 		MaterialDataBlockType dataBlockType;
 		int bindPoint = 0;
+		int numVariants = 1;
 		bool dirty = true;
+		mutable bool needToUpdateHash = true;
+		mutable uint64_t hashValue = 0;
+		uint64_t uploadedHash = 0;
 
 		bool setUniform(size_t offset, ShaderParameterType type, void* data);
+		bool setData(gsl::span<const gsl::byte> data);
 		void upload(VideoAPI* api);
 	};
 	
@@ -90,6 +98,13 @@ namespace Halley
 		void setPassEnabled(int pass, bool enabled);
 		bool isPassEnabled(int pass) const;
 
+		// Picks which of the shader variants compiled for the material's keywords is bound (throws if that combination wasn't)
+		Material& setKeyword(const String& keyword, bool enabled);
+		Material& setKeywords(uint32_t keywordMask);
+		bool hasKeyword(const String& keyword) const;
+		uint32_t getKeywords() const { return keywordMask; }
+		int getVariant() const { return variant; } // Index into the definition's variants
+
 		Material& set(const String& name, const std::shared_ptr<const Texture>& texture);
 		Material& set(const String& name, const std::shared_ptr<Texture>& texture);
 
@@ -102,6 +117,25 @@ namespace Halley
 			return *this;
 		}
 
+		// By index, as resolved from MaterialDefinition::getUniformIndex()
+		template <typename T>
+		Material& set(int uniformIndex, const T& value)
+		{
+			getParameter(uniformIndex) = value;
+			return *this;
+		}
+
+		// Writes a whole uniform block at once (by MaterialDefinition::getUniformBlockIndex()), e.g. from a struct mirroring its layout,
+		// where each uniform is aligned to its own size, up to 16 bytes. The size has to match the block's exactly.
+		Material& setBlockData(int blockIndex, gsl::span<const gsl::byte> data);
+
+		template <typename T>
+		Material& setBlock(int blockIndex, const T& value)
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "Uniform block data must be trivially copyable");
+			return setBlockData(blockIndex, gsl::as_bytes(gsl::span<const T>(&value, 1)));
+		}
+
 		uint64_t getHash() const;
 
 	private:
@@ -113,6 +147,8 @@ namespace Halley
 		std::vector<std::shared_ptr<const Texture>> textures;
 
 		std::vector<char> passEnabled;
+		uint32_t keywordMask = 0;
+		int variant = 0;
 
 		mutable uint64_t hashValue;
 		mutable bool needToUpdateHash = true;
@@ -120,6 +156,7 @@ namespace Halley
 
 		void initUniforms(bool forceLocalBlocks);
 		MaterialParameter& getParameter(const String& name);
+		MaterialParameter& getParameter(int index);
 
 		void setUniform(int blockNumber, size_t offset, ShaderParameterType type, void* data);
 		uint64_t computeHash() const;
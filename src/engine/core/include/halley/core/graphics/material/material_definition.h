@@ -29,6 +29,7 @@ namespace Halley
 		Matrix3,
 		Matrix4,
 		Texture2D,
+		Texture2DArray,
 		Invalid
 	};
 
@@ -122,6 +123,7 @@ namespace Halley
 		ShaderParameterType type;
 		int location;
 		int offset;
+		bool instanced = false; // Read once per instance rather than once per vertex, when drawing instanced
 
 		MaterialAttribute();
 		MaterialAttribute(String name, ShaderParameterType type, int location, int offset = 0);
@@ -153,9 +155,24 @@ namespace Halley
 		size_t getVertexSize() const;
 		size_t getVertexStride() const;
 		size_t getVertexPosOffset() const;
+		bool isInstanced() const;
+		bool hasShaderClip() const; // Its shaders clip to each vertex's a_clip rect, see Sprite::setClip
 		const Vector<MaterialAttribute>& getAttributes() const { return attributes; }
 		const Vector<MaterialUniformBlock>& getUniformBlocks() const { return uniformBlocks; }
 		const Vector<String>& getTextures() const { return textures; }
+
+		// Uniforms are numbered across all blocks, in order, the same in every Material made from this definition.
+		// Resolve them once (e.g. when the system or widget is created) and set them by index, rather than by name on every change.
+		int getUniformIndex(const String& name) const; // -1 if there's no such uniform
+		int getUniformBlockIndex(const String& name) const; // -1 if there's no such block
+
+		// Keywords are #defined (or not) in the shaders, and each combination used is compiled at import time as a separate variant.
+		// Variants are identified by a bitmask of keywords, with the first one always being the one with none of them.
+		const Vector<String>& getKeywords() const { return keywords; }
+		uint32_t getKeywordMask(const String& keyword) const;
+		const Vector<uint32_t>& getVariants() const { return variants; }
+		int getNumVariants() const { return int(variants.size()); }
+		int getVariantIndex(uint32_t keywordMask) const; // -1 if that combination wasn't compiled
 		
 		void addPass(const MaterialPass& materialPass);
 
@@ -175,10 +192,15 @@ namespace Halley
 		Vector<MaterialAttribute> attributes;
 		int vertexSize = 0;
 		int vertexPosOffset = 0;
+		bool instanced = false;
+		bool shaderClip = false;
+		Vector<String> keywords;
+		Vector<uint32_t> variants = { 0 };
 
 		void loadUniforms(const ConfigNode& node);
 		void loadTextures(const ConfigNode& node);
 		void loadAttributes(const ConfigNode& node);
+		void loadVariants(const ConfigNode& node);
 		ShaderParameterType parseParameterType(String rawType) const;
 	};
 
@@ -193,6 +215,9 @@ namespace Halley
 		void serialize(Serializer& s) const;
 		void deserialize(Deserializer& s);
 
+		bool operator==(const MaterialDepthStencil& other) const;
+		bool operator!=(const MaterialDepthStencil& other) const;
+
 		bool isDepthTestEnabled() const;
 		bool isDepthWriteEnabled() const;
 		bool isStencilTestEnabled() const;
@@ -234,16 +259,18 @@ namespace Halley
 		explicit MaterialPass(const String& shaderAssetId, const ConfigNode& node);
 
 		BlendType getBlend() const { return blend; }
-		Shader& getShader() const { return *shader; }
+		Shader& getShader(int variant = 0) const { return *shaders[variant]; }
 		const MaterialDepthStencil& getDepthStencil() const { return depthStencil; }
 
 		void serialize(Serializer& s) const;
 		void deserialize(Deserializer& s);
 
-		void createShader(ResourceLoader& loader, String name, const Vector<MaterialAttribute>& attributes);
+		void createShaders(ResourceLoader& loader, String name, const Vector<MaterialAttribute>& attributes, const Vector<uint32_t>& variants);
+
+		static String getShaderAssetId(const String& passName, uint32_t variant);
 
 	private:
-		std::shared_ptr<Shader> shader;
+		Vector<std::shared_ptr<Shader>> shaders; // One per variant of the material
 		BlendType blend;
 		MaterialDepthStencil depthStencil;
 		
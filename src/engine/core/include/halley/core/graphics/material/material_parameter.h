@@ -20,11 +20,12 @@ namespace Halley
 	{
 	public:
 		MaterialTextureParameter(Material& material, const String& name);
-		unsigned int getAddress(int pass, ShaderType stage) const;
+		unsigned int getAddress(int pass, ShaderType stage, int variant = 0) const;
 
 	private:
 		String name;
 		Vector<int> addresses;
+		int numVariants = 1;
 	};
 
 	class MaterialParameter
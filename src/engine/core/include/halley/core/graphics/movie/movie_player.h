@@ -7,6 +7,8 @@
 #include <thread>
 #include <mutex>
 #include <atomic>
+#include <list>
+#include <vector>
 
 namespace Halley
 {
@@ -17,6 +19,7 @@ namespace Halley
 	class StreamingAudioClip;
 	class IAudioHandle;
 	class TextureRenderTarget;
+	class Material;
 
 	enum class MoviePlayerState
 	{
@@ -48,6 +51,7 @@ namespace Halley
 	{
 		std::shared_ptr<Texture> texture;
 		Time time;
+		std::shared_ptr<Texture> chroma; // Only for frames copied from native NV12 textures, where texture is the luma plane
 	};
 
 	struct MoviePlayerAliveFlag
@@ -94,6 +98,9 @@ namespace Halley
 
 		void onVideoFrameAvailable(Time time, TextureDescriptor&& descriptor);
 		void onVideoFrameAvailable(Time time, std::shared_ptr<Texture> texture);
+		// For decoders that output textures of the video API (see VideoAPI::copyNativeTexture), which never go through the CPU.
+		// Returns false if the video API can't take it, in which case the frame should be read back and sent as a TextureDescriptor.
+		bool onNativeVideoFrameAvailable(Time time, const String& type, void* handle, int arraySlice);
 		void onAudioFrameAvailable(Time time, gsl::span<const short> samples);
 		void onAudioFrameAvailable(Time time, gsl::span<const float> samples);
 
@@ -113,6 +120,9 @@ namespace Halley
 
 		Vector2i videoSize;
 		std::shared_ptr<Texture> currentTexture;
+		std::shared_ptr<Texture> currentChroma;
+		std::list<std::vector<std::shared_ptr<Texture>>> recycleNativeFrames;
+		std::shared_ptr<Material> nativeMaterial;
 		std::shared_ptr<TextureRenderTarget> renderTarget;
 		std::shared_ptr<Texture> renderTexture;
 
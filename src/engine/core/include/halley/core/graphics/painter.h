@@ -2,7 +2,10 @@
 #include "camera.h"
 #include "blend.h"
 #include "halley/maths/colour.h"
+#include "halley/data_structures/maybe.h"
+#include <array>
 #include <condition_variable>
+#include <mutex>
 #include <halley/maths/vector4.h>
 
 namespace Halley
@@ -13,21 +16,38 @@ namespace Halley
 	class MaterialDefinition;
 	class Camera;
 	class RenderContext;
+	class RenderTarget;
 	class Core;
+	class RenderCommandList;
+	class StaticVertexBuffer;
+
+	struct GPUScopeTiming
+	{
+		String name;
+		int depth = 0; // The whole frame is the only one at 0
+		int64_t elapsedNs = 0;
+	};
 
 	class Painter
 	{
 		friend class RenderContext;
 		friend class Core;
+		friend class RenderCommandList;
 
+	public:
+		// Batches are always indexed with these. Backends that can't draw them (see supports32BitIndices) get batches of
+		// at most 65536 vertices, so they can narrow them to 16 bits.
+		using IndexType = uint32_t;
+
+	private:
 		struct PainterVertexData
 		{
 			char* dstVertex;
-			unsigned short* dstIndex;
+			IndexType* dstIndex;
 			size_t vertexSize;
 			size_t vertexStride;
 			size_t dataSize;
-			unsigned short firstIndex;
+			IndexType firstIndex;
 		};
 
 	public:
@@ -40,7 +60,8 @@ namespace Halley
 		Camera& getCurrentCamera() const { return *camera; }
 		Rect4f getWorldViewAABB() const;
 
-		virtual void clear(Colour colour) = 0;
+		// Anything left empty is kept; depth and stencil are only cleared if the render target has them
+		void clear(Maybe<Colour> colour, Maybe<float> depth = 1.0f, Maybe<uint8_t> stencil = 0);
 		virtual void setMaterialPass(const Material& material, int pass) = 0;
 		virtual void setMaterialData(const Material& material) = 0;
 
@@ -51,8 +72,13 @@ namespace Halley
 		// Draws quads to the screen
 		void drawQuads(std::shared_ptr<Material> material, size_t numVertices, const void* vertexData);
 
+		// Draws quads, as above, from a buffer that backends which support it keep on the GPU, only uploading it again when it's replaced.
+		// The whole buffer is a single draw call, so it can't have more than 65536 vertices, unless the backend supports 32-bit indices.
+		void drawStaticQuads(std::shared_ptr<Material> material, std::shared_ptr<const StaticVertexBuffer> buffer);
+
 		// Draw sprites takes a single vertex per sprite, duplicates the data across multiple vertices, and draws
 		// vertPosOffset is the offset, in bytes, from the start of each vertex's data, to a Vector2f which will be filled with the vertex's position in 0-1 space.
+		// With an instanced material, on backends that support it, each sprite's data is uploaded once instead, and drawn over a shared unit quad.
 		void drawSprites(std::shared_ptr<Material> material, size_t numSprites, const void* vertexData);
 
 		// Draw one sliced sprite. Slices -> x = left, y = top, z = right, w = bottom, in [0..1] space relative to the texture
@@ -61,24 +87,79 @@ namespace Halley
 		size_t getNumDrawCalls() const { return nDrawCalls; }
 		size_t getNumVertices() const { return nVertices; }
 		size_t getNumTriangles() const { return nTriangles; }
+		size_t getNumElidedStateChanges() const { return nElidedStateChanges; }
 
 		size_t getPrevDrawCalls() const { return prevDrawCalls; }
 		size_t getPrevVertices() const { return prevVertices; }
 		size_t getPrevTriangles() const { return prevTriangles; }
+		size_t getPrevElidedStateChanges() const { return prevElidedStateChanges; }
+
+		// GPU time spent on the frame and on named scopes within it, on backends that support timestamp queries. Scopes nest, and flush
+		// batches when they begin and end, so this is disabled by default. Results come in a few frames late, as the GPU gets to them:
+		// getPrevGPUTimings() has those of the latest frame to finish, whole frame first, then scopes in the order they began.
+		void setGPUTimingEnabled(bool enabled);
+		bool isGPUTimingEnabled() const { return gpuTimingEnabled; }
+		void beginGPUScope(const String& name);
+		void endGPUScope();
+		virtual Vector<GPUScopeTiming> getPrevGPUTimings() const;
 
 	protected:
 		virtual void startDrawCall() {}
 		virtual void endDrawCall() {}
 		virtual void doStartRender() = 0;
 		virtual void doEndRender() = 0;
-		virtual void setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, unsigned short* indices, bool standardQuadsOnly) = 0;
+		virtual void doClear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil) = 0;
+		virtual void setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly) = 0;
+
+		// Backends that can expose GPU-visible memory override this, so vertices get written straight into it instead of
+		// into a temporary buffer. Returns at least minBytes (setting capacity to the actual amount), or nullptr if it can't;
+		// the next setVertices will then receive that same pointer.
+		virtual char* beginVertexStream(size_t minBytes, size_t& capacity) { return nullptr; }
 		virtual void drawTriangles(size_t numIndices) = 0;
 
+		// Batches are drawn once they hold getMaxBatchBytes() of vertices, or as many vertices as their indices can address.
+		// Backends that can draw 32-bit indices override supports32BitIndices, and otherwise only need to keep the lower 16 bits.
+		virtual bool supports32BitIndices() const { return false; }
+		virtual size_t getMaxBatchBytes() const { return 4 * 1024 * 1024; }
+
+		// Backends that can draw instanced quads override these. Each instance is one vertex's worth of the material's attributes,
+		// except for a_vertPos, which the backend provides from a unit quad. instanceData can come from beginVertexStream too.
+		virtual bool supportsInstancing() const { return false; }
+		virtual void setInstances(const MaterialDefinition& material, size_t numInstances, void* instanceData) {}
+		virtual void drawInstancedQuads(size_t numInstances) {}
+
+		// Backends that can keep vertices on the GPU between frames override these. setStaticVertices binds buffer, uploading it
+		// the first time that it's seen, along with standard quad indices for all of it; drawTriangles then draws it as usual.
+		virtual bool supportsStaticVertices() const { return false; }
+		virtual void setStaticVertices(const MaterialDefinition& material, const std::shared_ptr<const StaticVertexBuffer>& buffer) {}
+
+		// Backends that can time the GPU override these, keeping up to maxGPUTimestamps queries for each of gpuTimerFrames frames in flight.
+		// writeGPUTimestamp has the GPU record the time it gets there into query idx of that frame. readGPUTimestamps doesn't wait: it returns
+		// false while the frame's queries aren't all done, and otherwise fills dst with them, in nanoseconds (or leaves it empty if they're unusable).
+		virtual bool supportsGPUTimers() const { return false; }
+		virtual void beginGPUTimerFrame(size_t frame) {}
+		virtual void writeGPUTimestamp(size_t frame, size_t idx) {}
+		virtual void endGPUTimerFrame(size_t frame) {}
+		virtual bool readGPUTimestamps(size_t frame, size_t count, Vector<int64_t>& dst) { return false; }
+		constexpr static size_t gpuTimerFrames = 4;
+		constexpr static size_t maxGPUTimestamps = 256;
+
+		virtual void doBeginGPUScope(const String& name);
+		virtual void doEndGPUScope();
+
 		virtual void setViewPort(Rect4i rect) = 0;
 		virtual void setClip(Rect4i clip, bool enable) = 0;
 
 		virtual void onUpdateProjection(Material& material) = 0;
-		void generateQuadIndices(unsigned short firstVertex, size_t numQuads, unsigned short* target);
+		virtual void onBindRenderTarget(RenderTarget& target);
+		virtual void onUnbindRenderTarget(RenderTarget& target);
+		virtual void executeDrawTriangles(const std::shared_ptr<Material>& material, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly);
+		virtual void executeDrawInstancedQuads(const std::shared_ptr<Material>& material, size_t numInstances, void* instanceData);
+		virtual void executeDrawStaticQuads(const std::shared_ptr<Material>& material, const std::shared_ptr<const StaticVertexBuffer>& buffer);
+
+		void logDrawCall(size_t numVertices, size_t numIndices);
+		void logElidedStateChanges(size_t n); // Calls a backend skipped because that state was already bound
+		void generateQuadIndices(IndexType firstVertex, size_t numQuads, IndexType* target);
 		RenderTarget& getActiveRenderTarget();
 
 	private:
@@ -91,20 +172,51 @@ namespace Halley
 		size_t verticesPending = 0;
 		size_t bytesPending = 0;
 		size_t indicesPending = 0;
+		size_t maxBatchVertices = 65536;
+		size_t maxBatchBytes = 0;
 		bool allIndicesAreQuads = true;
+		bool pendingInstanced = false; // If set, verticesPending is a number of instances, and there are no indices
 		Vector<char> vertexBuffer;
-		Vector<unsigned short> indexBuffer;
+		Vector<char> expandedVertexBuffer;
+		char* streamVertices = nullptr;
+		size_t streamCapacity = 0;
+		Vector<IndexType> indexBuffer;
 		std::shared_ptr<Material> materialPending;
 		std::unique_ptr<Material> halleyGlobalMaterial;
+		int mvpIndex;
 
 		size_t nDrawCalls = 0;
 		size_t nVertices = 0;
 		size_t nTriangles = 0;
+		size_t nElidedStateChanges = 0;
 		size_t prevDrawCalls = 0;
 		size_t prevVertices = 0;
 		size_t prevTriangles = 0;
+		size_t prevElidedStateChanges = 0;
 
-		Vector<unsigned short> stdQuadIndexCache;
+		struct GPUTimerFrame
+		{
+			struct Scope
+			{
+				String name;
+				int depth;
+				size_t begin;
+				size_t end;
+			};
+			Vector<Scope> scopes;
+			size_t timestamps = 0;
+		};
+		bool gpuTimingEnabled = false;
+		bool gpuTimingActive = false; // For the frame being rendered
+		std::array<GPUTimerFrame, gpuTimerFrames> gpuFrames;
+		uint64_t gpuFramesStarted = 0;
+		uint64_t gpuFramesRead = 0;
+		Vector<size_t> gpuScopeStack;
+		Vector<int64_t> gpuTimestamps;
+		mutable std::mutex gpuTimingsMutex; // Results are read by whoever displays them, which might not be the thread rendering
+		Vector<GPUScopeTiming> gpuTimings;
+
+		Vector<IndexType> stdQuadIndexCache;
 
 		void bind(RenderContext& context);
 		void unbind(RenderContext& context);
@@ -112,17 +224,23 @@ namespace Halley
 		void startRender();
 		void endRender();
 		
+		void startGPUTimerFrame();
+		void endGPUTimerFrame();
+		void readGPUTimerFrames();
+
 		void resetPending();
 		void startDrawCall(std::shared_ptr<Material>& material);
 		void flushPending();
-		void executeDrawTriangles(Material& material, size_t numVertices, void* vertexData, size_t numIndices, unsigned short* indices);
+		void drawPending();
+		char* getPendingVertices();
 
 		void makeSpaceForPendingVertices(size_t numBytes);
 		void makeSpaceForPendingIndices(size_t numIndices);
 		PainterVertexData addDrawData(std::shared_ptr<Material>& material, size_t numVertices, size_t numIndices, bool standardQuadsOnly);
+		PainterVertexData addInstanceData(std::shared_ptr<Material>& material, size_t numInstances);
 
-		unsigned short* getStandardQuadIndices(size_t numQuads);
-		void generateQuadIndicesOffset(unsigned short firstVertex, unsigned short lineStride, unsigned short* target);
+		IndexType* getStandardQuadIndices(size_t numQuads);
+		void generateQuadIndicesOffset(IndexType firstVertex, IndexType lineStride, IndexType* target);
 
 		void updateProjection();
 
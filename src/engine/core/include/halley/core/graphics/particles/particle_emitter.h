@@ -0,0 +1,102 @@
+#pragma once
+
+#include <halley/maths/vector2.h>
+#include <halley/maths/colour.h>
+#include <halley/maths/angle.h>
+#include <halley/maths/range.h>
+#include <halley/maths/random.h>
+#include <halley/time/halleytime.h>
+#include <halley/data_structures/vector.h>
+#include <memory>
+#include "halley/core/graphics/sprite/sprite.h"
+
+namespace Halley
+{
+	class ConfigNode;
+	class Resources;
+	class Material;
+	class Painter;
+
+	// What an emitter spawns, loaded from a config asset, e.g.:
+	//   image: particles/spark.png  # Or spriteSheet and sprite
+	//   material: Halley/SpriteAdd
+	//   maxParticles: 2000
+	//   spawnRate: 300              # Per second
+	//   lifetime: [0.5, 1.2]        # Ranges can also be a single number
+	//   speed: [50, 150]
+	//   direction: 270              # Degrees
+	//   spread: 30                  # Degrees, either way of direction
+	//   acceleration: [0, 200]
+	//   drag: 0.5                   # Fraction of velocity lost per second
+	//   scale: [1, 0]               # At birth and at death
+	//   colour: ["#FFFFFF", "#FF000000"]
+	class ParticleEmitterDefinition
+	{
+	public:
+		ParticleEmitterDefinition();
+		ParticleEmitterDefinition(const ConfigNode& node, Resources& resources);
+
+		Sprite sprite;
+		int maxParticles = 1000;
+		float spawnRate = 100;
+		Range<float> lifetime = Range<float>(1, 1);
+		Range<float> speed = Range<float>(0, 0);
+		Range<float> rotationSpeed = Range<float>(0, 0); // Degrees per second
+		Angle1f direction;
+		Angle1f spread;
+		Vector2f spawnArea; // Half extents of the box that particles appear in, around the emitter
+		Vector2f acceleration;
+		float drag = 0;
+		float startScale = 1;
+		float endScale = 1;
+		Colour4f startColour = Colour4f(1, 1, 1, 1);
+		Colour4f endColour = Colour4f(1, 1, 1, 1);
+	};
+
+	// Simulates particles on the CPU, as structure-of-arrays vectorised with SSE or NEON where available, and draws all of them
+	// with a single Painter::drawSprites, which is an instanced draw when the material and backend allow it.
+	// Particles live in world space, so moving the emitter doesn't drag the ones already out with it.
+	class ParticleEmitter
+	{
+	public:
+		explicit ParticleEmitter(std::shared_ptr<const ParticleEmitterDefinition> definition, uint32_t seed = 0);
+
+		void setPosition(Vector2f position);
+		Vector2f getPosition() const;
+		void setEnabled(bool enabled); // Disabled emitters stop spawning, but keep simulating what they already have
+		bool isEnabled() const;
+
+		void burst(int count);
+		void clear();
+		void update(Time t);
+		void draw(Painter& painter) const;
+
+		size_t getNumParticles() const;
+		bool isFinished() const; // Disabled, with nothing left alive
+
+	private:
+		std::shared_ptr<const ParticleEmitterDefinition> definition;
+		std::shared_ptr<Material> material;
+		Random rng;
+		Vector2f position;
+		bool enabled = true;
+		float spawnAccumulator = 0;
+
+		// SoA, only the first numParticles are alive
+		size_t numParticles = 0;
+		Vector<float> posX;
+		Vector<float> posY;
+		Vector<float> velX;
+		Vector<float> velY;
+		Vector<float> rotation;
+		Vector<float> rotationSpeed;
+		Vector<float> age; // 0 to 1, over the particle's lifetime
+		Vector<float> ageRate; // 1 / lifetime
+
+		mutable Vector<SpriteVertexAttrib> vertices;
+
+		void spawn(size_t count);
+		void simulate(float t);
+		void removeDead();
+	};
+}
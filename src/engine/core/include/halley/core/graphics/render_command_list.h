@@ -0,0 +1,135 @@
+#pragma once
+#include "painter.h"
+#include <halley/data_structures/hash_map.h>
+#include <halley/maths/rect.h>
+
+namespace Halley
+{
+	class Material;
+	class RenderTarget;
+	class StaticVertexBuffer;
+
+	// A frame's worth of backend calls, as recorded by RecordingPainter, to be replayed later (possibly on another thread) onto a real Painter.
+	// Materials are immutable snapshots and vertex/index data is owned by the list (or, for static vertices, shared with it, as
+	// those can't change), so nothing recorded depends on game state.
+	// Render targets, however, are referenced directly, so they have to outlive the frame's replay.
+	class RenderCommandList
+	{
+	public:
+		void clear();
+		bool empty() const { return commands.empty(); }
+
+		void addClear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil);
+		void addSetViewPort(Rect4i rect);
+		void addSetClip(Rect4i rect, bool enable);
+		void addBindRenderTarget(RenderTarget& target);
+		void addUnbindRenderTarget(RenderTarget& target);
+		void addUpdateProjection(std::shared_ptr<Material> material);
+		void addDraw(std::shared_ptr<Material> material, size_t numVertices, const void* vertexData, size_t numIndices, const Painter::IndexType* indices, bool standardQuadsOnly);
+		void addDrawInstancedQuads(std::shared_ptr<Material> material, size_t numInstances, const void* instanceData);
+		void addDrawStaticQuads(std::shared_ptr<Material> material, std::shared_ptr<const StaticVertexBuffer> buffer);
+		void addBeginGPUScope(const String& name);
+		void addEndGPUScope();
+
+		// Runs a whole frame on painter, from startRender() to endRender()
+		void submit(Painter& painter);
+
+	private:
+		enum class CommandType
+		{
+			Clear,
+			SetViewPort,
+			SetClip,
+			BindRenderTarget,
+			UnbindRenderTarget,
+			UpdateProjection,
+			Draw,
+			DrawInstancedQuads,
+			DrawStaticQuads,
+			BeginGPUScope,
+			EndGPUScope
+		};
+
+		struct Command
+		{
+			CommandType type;
+			Maybe<Colour> colour;
+			Maybe<float> depth;
+			Maybe<uint8_t> stencil;
+			Rect4i rect;
+			bool flag = false;
+			RenderTarget* target = nullptr;
+			std::shared_ptr<Material> material;
+			std::shared_ptr<const StaticVertexBuffer> staticVertices;
+			size_t vertexOffset = 0;
+			size_t vertexBytes = 0;
+			size_t numVertices = 0; // Or number of instances
+			size_t indexOffset = 0;
+			size_t numIndices = 0;
+			String name;
+
+			explicit Command(CommandType type) : type(type) {}
+		};
+
+		Vector<Command> commands;
+		Vector<char> vertexData;
+		Vector<Painter::IndexType> indexData;
+
+		void replay(Painter& painter, Command& command);
+	};
+
+	// A Painter that, instead of talking to a video backend, records everything into a RenderCommandList
+	class RecordingPainter final : public Painter
+	{
+	public:
+		explicit RecordingPainter(Resources& resources);
+
+		// Swaps the recorded frame with commands (which should be empty or already submitted)
+		void takeCommands(RenderCommandList& commands);
+
+		void setMaterialPass(const Material& material, int pass) override;
+		void setMaterialData(const Material& material) override;
+
+		// GPU timings are those of the painter that the commands are replayed onto
+		void setGPUTimingSource(const Painter& painter);
+		Vector<GPUScopeTiming> getPrevGPUTimings() const override;
+
+	protected:
+		void doStartRender() override;
+		void doEndRender() override;
+		void doClear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil) override;
+		void setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly) override;
+		void drawTriangles(size_t numIndices) override;
+
+		// Whether the backend can actually do it is only known on replay, which falls back to regular quads if not
+		bool supportsInstancing() const override;
+		// Batches keep to 16-bit indices, though, as every backend can replay those
+
+		void setViewPort(Rect4i rect) override;
+		void setClip(Rect4i clip, bool enable) override;
+
+		void onUpdateProjection(Material& material) override;
+		void onBindRenderTarget(RenderTarget& target) override;
+		void onUnbindRenderTarget(RenderTarget& target) override;
+		void executeDrawTriangles(const std::shared_ptr<Material>& material, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly) override;
+		void executeDrawInstancedQuads(const std::shared_ptr<Material>& material, size_t numInstances, void* instanceData) override;
+		void executeDrawStaticQuads(const std::shared_ptr<Material>& material, const std::shared_ptr<const StaticVertexBuffer>& buffer) override;
+
+		void doBeginGPUScope(const String& name) override;
+		void doEndGPUScope() override;
+
+	private:
+		struct Snapshot
+		{
+			std::shared_ptr<Material> material;
+			uint64_t lastFrame = 0;
+		};
+
+		RenderCommandList commands;
+		HashMap<uint64_t, Snapshot> snapshots;
+		uint64_t frameNumber = 0;
+		const Painter* gpuTimingSource = nullptr;
+
+		std::shared_ptr<Material> getSnapshot(const Material& material);
+	};
+}
@@ -20,6 +20,18 @@ namespace Halley
 			popContext();
 		}
 
+		// As above, timing the GPU work done inside it (see Painter::beginGPUScope)
+		void bind(const String& gpuScopeName, std::function<void(Painter&)> f)
+		{
+			painter.beginGPUScope(gpuScopeName);
+			bind(std::move(f));
+			painter.endGPUScope();
+		}
+
+		// For timing more than one bind together, e.g. a whole render system
+		void beginGPUScope(const String& name) { painter.beginGPUScope(name); }
+		void endGPUScope() { painter.endGPUScope(); }
+
 		RenderContext(RenderContext&& context) noexcept;
 
 		RenderContext with(Camera& camera) const;
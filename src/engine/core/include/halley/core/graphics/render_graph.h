@@ -0,0 +1,107 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include "halley/data_structures/vector.h"
+#include "halley/text/halleystring.h"
+#include "halley/maths/vector2.h"
+#include "render_target/render_target_pool.h"
+
+namespace Halley
+{
+	class VideoAPI;
+	class RenderContext;
+	class RenderTarget;
+	class TextureRenderTarget;
+	class Texture;
+
+	// Renders a frame as a list of passes that declare which targets they read and write, instead of binding render targets by hand.
+	// Transient targets only exist for as long as the graph needs them: passes that nothing visible depends on are culled, and targets
+	// whose lifetimes don't overlap share the same texture. Passes run in the order they're added, which is also what decides
+	// which write each read sees.
+	//
+	// Build it once and call execute() every frame. Textures come from a RenderTargetPool, so they're kept between frames, and across
+	// reset() (e.g. to rebuild the graph after a resize) for as long as the pool keeps them.
+	class RenderGraph
+	{
+	public:
+		using TargetId = int;
+		using TargetDefinition = RenderTargetPool::Definition;
+
+		class PassBuilder
+		{
+			friend class RenderGraph;
+
+		public:
+			void read(TargetId target);
+			void write(TargetId target); // Colour targets become attachments in the order they're written, depth ones the depth attachment
+
+		private:
+			RenderGraph& graph;
+			size_t pass;
+
+			PassBuilder(RenderGraph& graph, size_t pass);
+		};
+
+		// The pass's context renders to the targets it writes; getTexture() gives the ones it reads
+		using PassCallback = std::function<void(RenderContext& context, const RenderGraph& graph)>;
+
+		explicit RenderGraph(VideoAPI& video);
+		RenderGraph(VideoAPI& video, RenderTargetPool& pool); // Shares the pool with whatever else uses it, which must then call its endFrame()
+		~RenderGraph();
+
+		TargetId createTarget(const String& name, TargetDefinition definition);
+		TargetId importTarget(const String& name, RenderTarget& target); // e.g. the screen; anything written to one is kept
+		// If setup doesn't write to anything, the pass draws to the context given to execute()
+		void addPass(const String& name, std::function<void(PassBuilder&)> setup, PassCallback callback);
+
+		void execute(RenderContext& context);
+		void reset(); // Removes every target and pass, but keeps textures around for the next ones
+
+		std::shared_ptr<Texture> getTexture(TargetId target) const;
+
+		size_t getNumCulledPasses() const;
+		size_t getNumTextures() const; // In its pool
+
+	private:
+		struct Target
+		{
+			String name;
+			TargetDefinition definition;
+			RenderTarget* imported = nullptr;
+			int firstUse = -1;
+			int lastUse = -1;
+			std::shared_ptr<Texture> texture;
+		};
+
+		struct Pass
+		{
+			String name;
+			Vector<TargetId> reads;
+			Vector<TargetId> writes;
+			PassCallback callback;
+			bool culled = false;
+
+			Vector<TargetId> acquires; // Targets that need a texture before this pass
+			Vector<TargetId> releases; // Targets nothing needs after it
+			Vector<std::shared_ptr<Texture>> bound; // What its render target currently has attached
+		};
+
+		VideoAPI& video;
+		std::unique_ptr<RenderTargetPool> ownPool;
+		RenderTargetPool& pool;
+		Vector<Target> targets;
+		Vector<Pass> passes;
+		Vector<std::unique_ptr<TextureRenderTarget>> renderTargets;
+		bool compiled = false;
+
+		void compile();
+		void cullPasses();
+		void computeLifetimes();
+
+		RenderTarget& getPassRenderTarget(size_t passIdx);
+
+		Target& getTarget(TargetId id);
+		const Target& getTarget(TargetId id) const;
+	};
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include "halley/data_structures/vector.h"
+#include "halley/maths/vector2.h"
+#include "../texture_descriptor.h"
+
+namespace Halley
+{
+	class VideoAPI;
+	class Texture;
+
+	// Textures to render to, reused by anything that asks for one of the same size, format and filtering.
+	// Released textures stay around for a few frames before they're destroyed, so effects that come and go, or that alternate
+	// between a few sizes (e.g. dynamic resolution), find them still there instead of creating them again every frame.
+	// Destruction only happens in endFrame(), all at once, so a resize reallocates everything in the first frame at the new size
+	// and frees everything at the old one together, however many targets there are.
+	class RenderTargetPool
+	{
+	public:
+		struct Definition
+		{
+			Vector2i size;
+			TextureFormat format = TextureFormat::RGBA; // DEPTH makes a depth-stencil target, anything else a colour one
+			bool useFiltering = false;
+
+			Definition() = default;
+			Definition(Vector2i size, TextureFormat format = TextureFormat::RGBA, bool useFiltering = false);
+
+			bool operator==(const Definition& other) const;
+			bool operator!=(const Definition& other) const;
+		};
+
+		explicit RenderTargetPool(VideoAPI& video, int framesToKeep = 3);
+		~RenderTargetPool();
+
+		// The texture is only handed out again once it's released
+		std::shared_ptr<Texture> acquire(const Definition& definition);
+		void release(const std::shared_ptr<Texture>& texture);
+
+		void endFrame(); // Destroys whatever hasn't been acquired for framesToKeep frames
+		void clear(); // Destroys everything that isn't in use now
+
+		size_t getNumTextures() const;
+		size_t getNumTexturesInUse() const;
+		size_t getNumTexturesCreated() const; // Since the pool was created, to tell how much it's churning
+
+	private:
+		struct Entry
+		{
+			Definition definition;
+			std::shared_ptr<Texture> texture;
+			uint64_t lastFrame = 0;
+			bool inUse = false;
+		};
+
+		VideoAPI& video;
+		const int framesToKeep;
+		uint64_t frame = 0;
+		size_t nCreated = 0;
+		Vector<Entry> entries;
+
+		std::shared_ptr<Texture> create(const Definition& definition);
+	};
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "render_command_list.h"
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace Halley
+{
+	class SystemAPI;
+	class VideoAPI;
+
+	// Owns the video context and submits recorded frames to the backend painter, one frame behind the main thread
+	class RenderThread
+	{
+	public:
+		RenderThread(SystemAPI& system, VideoAPI& video, Painter& painter);
+		~RenderThread();
+
+		// Waits for the previous frame to finish, then hands this one over; commands receives an empty list to record the next frame into.
+		// Rethrows anything that went wrong while submitting the previous frame.
+		void submit(RenderCommandList& commands);
+
+		// Waits for the frame in flight, e.g. before destroying render targets it might be referencing
+		void waitForIdle();
+
+	private:
+		VideoAPI& video;
+		Painter& painter;
+
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+
+		RenderCommandList pending;
+		bool hasPending = false;
+		bool busy = false;
+		bool running = true;
+		std::exception_ptr error;
+
+		void run();
+		void waitForIdle(std::unique_lock<std::mutex>& lock);
+	};
+}
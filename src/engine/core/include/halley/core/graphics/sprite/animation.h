@@ -121,6 +121,8 @@ namespace Halley
 		void reload(Resource&& resource) override;
 
 		const String& getName() const { return name; }
+		const String& getSpriteSheetName() const { return spriteSheetName; }
+		const String& getMaterialName() const { return materialName; }
 		const SpriteSheet& getSpriteSheet() const { return *spriteSheet; }
 		std::shared_ptr<Material> getMaterial() const { return material; }
 		const AnimationSequence& getSequence(const String& name) const;
@@ -130,6 +132,14 @@ namespace Halley
 
 		bool hasSequence(const String& name) const;
 
+		// Integer ids, for callers that resolve names once up front; getSequenceId and getDirectionId return -1 if not found.
+		// They're assigned at import, in the order the sequences and directions are listed in, so they only change if the asset does.
+		int getSequenceId(const String& name) const;
+		const AnimationSequence& getSequence(int id) const;
+		int getDirectionId(const String& name) const;
+		size_t getNumSequences() const { return sequences.size(); }
+		size_t getNumDirections() const { return directions.size(); }
+
 		void serialize(Serializer& s) const;
 		void deserialize(Deserializer& s);
 		void loadDependencies(ResourceLoader& loader);
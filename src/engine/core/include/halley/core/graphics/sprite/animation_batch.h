@@ -0,0 +1,119 @@
+#pragma once
+#include "animation.h"
+#include "sprite_sheet.h"
+#include <halley/time/halleytime.h>
+#include <halley/data_structures/vector.h>
+#include <cstdint>
+
+namespace Halley
+{
+	class Sprite;
+
+	// Plays a large number of animation instances at once, as an alternative to one AnimationPlayer per entity.
+	// Animations are compiled when added, so sequences and directions are referred to by integer ids, and per-instance
+	// state is kept in parallel arrays. Advancing time is one flat loop over those arrays; only the instances that crossed
+	// into a new frame take the slow path, and only those get written to their sprites on updateSprites().
+	class AnimationBatch
+	{
+	public:
+		using AnimationId = int;
+		using InstanceId = uint32_t;
+
+		AnimationBatch();
+
+		AnimationId addAnimation(std::shared_ptr<const Animation> animation);
+		AnimationId getAnimationId(const Animation& animation) const; // -1 if not added
+		int getSequenceId(AnimationId animation, const String& sequence) const; // -1 if not found
+		int getDirectionId(AnimationId animation, const String& direction) const; // -1 if not found
+
+		InstanceId add(AnimationId animation, int sequence = 0, int direction = 0);
+		void remove(InstanceId instance);
+		void clear();
+		size_t size() const;
+
+		void setSequence(InstanceId instance, int sequence); // Restarts only if different
+		void playOnce(InstanceId instance, int sequence);
+		void setDirection(InstanceId instance, int direction);
+		void setPlaybackSpeed(InstanceId instance, float speed);
+
+		bool isPlaying(InstanceId instance) const;
+		int getSequence(InstanceId instance) const;
+		int getFrame(InstanceId instance) const;
+		const SpriteSheetEntry& getSpriteEntry(InstanceId instance) const;
+
+		void update(Time time);
+
+		// Writes every instance that changed frame, sequence or direction since the last call.
+		// getSprite is called as Sprite*(InstanceId) and can return nullptr to skip an instance.
+		template <typename F>
+		void updateSprites(F&& getSprite)
+		{
+			for (auto idx: changed) {
+				Sprite* sprite = getSprite(ids[idx]);
+				if (sprite) {
+					applyToSprite(idx, *sprite);
+				}
+			}
+			clearChanged();
+		}
+
+		void updateSprite(InstanceId instance, Sprite& sprite) const;
+
+	private:
+		struct CompiledSequence {
+			uint32_t firstFrame;
+			uint32_t numFrames;
+			uint32_t firstSprite; // Frame n, direction d at firstSprite + n * numDirections + d
+			bool loop;
+			bool noFlip;
+		};
+
+		struct CompiledAnimation {
+			std::shared_ptr<const Animation> animation;
+			ResourceObserver observer;
+			uint32_t firstSequence = 0;
+			uint32_t numSequences = 0;
+			uint32_t numDirections = 0;
+			Vector<bool> dirFlip;
+		};
+
+		constexpr static uint8_t flagPlaying = 1;
+		constexpr static uint8_t flagLooping = 2;
+		constexpr static uint8_t flagChanged = 4;
+
+		Vector<CompiledAnimation> animations;
+		Vector<CompiledSequence> sequences;
+		Vector<float> frameDurations; // Seconds, per frame
+		Vector<const SpriteSheetEntry*> frameSprites;
+
+		// Per instance, indexed by dense index
+		Vector<InstanceId> ids;
+		Vector<uint16_t> instAnimation;
+		Vector<uint32_t> instSequence; // Local to the animation
+		Vector<uint32_t> instFrame; // Local to the sequence
+		Vector<uint16_t> instDirection;
+		Vector<float> instFrameTime;
+		Vector<float> instFrameLen;
+		Vector<float> instSpeed;
+		Vector<uint8_t> instFlags;
+
+		// InstanceId -> dense index, with a free list for reuse
+		Vector<uint32_t> denseIndex;
+		Vector<InstanceId> freeIds;
+
+		Vector<uint32_t> changed;
+
+		void compile();
+		void compileAnimation(CompiledAnimation& anim);
+		void checkForReloads();
+
+		uint32_t getIndex(InstanceId instance) const;
+		const CompiledSequence& getCompiledSequence(uint32_t idx) const;
+		void startSequence(uint32_t idx, int sequence, bool loop);
+		void advance(uint32_t idx);
+		void resolveFrame(uint32_t idx);
+		void markChanged(uint32_t idx);
+		void clearChanged();
+		void applyToSprite(uint32_t idx, Sprite& sprite) const;
+	};
+}
@@ -17,6 +17,7 @@ namespace Halley
 
 		AnimationPlayer& setAnimation(std::shared_ptr<const Animation> animation, const String& sequence = "default", const String& direction = "default");
 		AnimationPlayer& setSequence(const String& sequence);
+		AnimationPlayer& setSequence(int sequenceId); // From Animation::getSequenceId, so states that change often don't look up names each time
 		AnimationPlayer& setDirection(int direction);
 		AnimationPlayer& setDirection(const String& direction);
 		bool trySetSequence(const String& sequence);
@@ -33,10 +34,12 @@ namespace Halley
 
 		bool isPlaying() const;
 		String getCurrentSequenceName() const;
+		int getCurrentSequenceId() const; // -1 if none
 		Time getCurrentSequenceTime() const;
 		int getCurrentSequenceFrame() const;
 
 		String getCurrentDirectionName() const;
+		int getCurrentDirectionId() const; // -1 if none
 
 		AnimationPlayer& setPlaybackSpeed(float value);
 		float getPlaybackSpeed() const;
@@ -48,6 +51,7 @@ namespace Halley
 
 	private:
 		void resolveSprite();
+		void startSequence(int id);
 
 		void onSequenceStarted();
 		void onSequenceDone();
@@ -71,6 +75,7 @@ namespace Halley
 
 		size_t seqLen;
 
+		int seqId = -1;
 		int dirId;
 		int curFrame;
 		float playbackSpeed = 1.0f;
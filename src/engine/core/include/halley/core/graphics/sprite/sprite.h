@@ -16,6 +16,7 @@ namespace Halley
 	class Texture;
 	class MaterialDefinition;
 	class Painter;
+	class Transform2D;
 
 	struct SpriteVertexAttrib
 	{
@@ -30,7 +31,9 @@ namespace Halley
 		Rect4f texRect;
 		float rotation = 0;
 		float textureRotation = 0;
-		char _padding[8];
+		float depth = 0;
+		float textureLayer = 0;
+		Rect4f clip = Rect4f(Vector2f(-1e30f, -1e30f), Vector2f(1e30f, 1e30f)); // World space
 	};
 
 	class Sprite
@@ -42,12 +45,14 @@ namespace Halley
 		void drawNormal(Painter& painter) const;
 		void drawSliced(Painter& painter) const;
 		void drawSliced(Painter& painter, Vector4s slices) const;
+		void drawAtDepth(Painter& painter, float depth) const; // As draw(), but with depth instead of the sprite's own (see SpritePainter)
 		static void draw(const Sprite* sprites, size_t n, Painter& painter);
 		static void drawMixedMaterials(const Sprite* sprites, size_t n, Painter& painter);
 
 		Sprite& setMaterial(Resources& resources, String materialName = "");
 		Sprite& setMaterial(std::shared_ptr<Material> m);
 		Material& getMaterial() const { return *material; }
+		const std::shared_ptr<Material>& getMaterialPtr() const { return material; }
 		bool hasMaterial() const { return material != nullptr; }
 
 		Sprite& setImage(Resources& resources, String imageName, String materialName = "");
@@ -69,6 +74,7 @@ namespace Halley
 		Vector2f getAbsolutePivot() const;
 
 		Sprite& setRotation(Angle1f angle);
+		Sprite& setTransform(const Transform2D& transform); // Position, rotation and scale, e.g. a world transform from TransformHierarchyService
 
 		Sprite& setSize(Vector2f size);
 		Sprite& setScale(Vector2f scale);
@@ -86,15 +92,26 @@ namespace Halley
 		Sprite& setColour(Colour4f colour);
 		Colour4f getColour() const;
 
+		// Only matters for materials that use the depth buffer; larger is closer to the camera, within (-1000, 0]
+		Sprite& setDepth(float depth);
+		float getDepth() const;
+
 		Sprite& setTexRect(Rect4f texRect);
 		Rect4f getTexRect() const;
 
+		// Only matters for materials that sample a texture array (e.g. Halley/SpriteLayered). Sprites from different layers still share the
+		// material, so they're drawn together, where sprites from different atlases would otherwise need a draw each.
+		Sprite& setTextureLayer(int layer);
+		int getTextureLayer() const;
+
 		Sprite& setSliced(Vector4s slices);
 		Sprite& setNotSliced();
 
 		Sprite& setVisible(bool visible);
 		bool isVisible() const;
 
+		// Relative to the sprite's position, unless it's absolute. Materials with shaderClip (e.g. Halley/Sprite) clip in the vertex shader,
+		// so sprites with different clips are still drawn together; others use the scissor, which needs a separate draw call.
 		Sprite& setClip(Rect4f clip);
 		Sprite& setAbsoluteClip(Rect4f clip);
 		Sprite& setClip();
@@ -108,6 +125,14 @@ namespace Halley
 
 		Sprite clone() const;
 
+		// What draw() uploads, for drawing many variations of it straight through Painter::drawSprites
+		const SpriteVertexAttrib& getVertexAttrib() const { return vertexAttrib; }
+
+		// Whether draw() is a single sprite for drawSprites(), so it can be drawn in one go with others of the same material.
+		// If so, getBatchVertexAttrib() is what it passes it, as getVertexAttrib() with the clip applied.
+		bool isBatchable() const;
+		SpriteVertexAttrib getBatchVertexAttrib() const;
+
 	private:
 		std::shared_ptr<Material> material;
 		SpriteVertexAttrib vertexAttrib;
@@ -122,5 +147,8 @@ namespace Halley
 		bool sliced = false;
 
 		void computeSize();
+		void applyShaderClip(SpriteVertexAttrib& attrib) const;
+		void drawNormal(Painter& painter, const SpriteVertexAttrib& attrib) const;
+		void drawSliced(Painter& painter, Vector4s slices, const SpriteVertexAttrib& attrib) const;
 	};
 }
@@ -1,7 +1,11 @@
 #pragma once
 
 #include <halley/data_structures/vector.h>
+#include <array>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <gsl/span>
 #include "halley/maths/rect.h"
 #include <limits>
 
@@ -11,6 +15,7 @@ namespace Halley
 	class String;
 	class Sprite;
 	class Painter;
+	struct SpriteVertexAttrib;
 
 	enum class SpritePainterEntryType
 	{
@@ -23,12 +28,15 @@ namespace Halley
 	class SpritePainterEntry
 	{
 	public:
+		SpritePainterEntry() = default;
 		SpritePainterEntry(const Sprite& sprite, int mask, int layer, float tieBreaker);
 		SpritePainterEntry(const TextRenderer& text, int mask, int layer, float tieBreaker);
 		SpritePainterEntry(SpritePainterEntryType type, size_t spriteIdx, int mask, int layer, float tieBreaker);
 
 		bool operator<(const SpritePainterEntry& o) const;
 		SpritePainterEntryType getType() const;
+		int getLayer() const;
+		float getTieBreaker() const;
 		const Sprite& getSprite() const;
 		const TextRenderer& getText() const;
 		size_t getIndex() const;
@@ -37,10 +45,31 @@ namespace Halley
 	private:
 		const void* ptr = nullptr;
 		unsigned int index = std::numeric_limits<unsigned int>::max();
-		SpritePainterEntryType type;
-		int layer;
-		int mask;
-		float tieBreaker;
+		SpritePainterEntryType type = SpritePainterEntryType::SpriteRef;
+		int layer = 0;
+		int mask = 0;
+		float tieBreaker = 0;
+	};
+
+	// What one thread adds to a SpritePainter while others add theirs; see SpritePainter::getBuckets()
+	class SpritePainterBucket
+	{
+	public:
+		void add(const Sprite& sprite, int mask, int layer, float tieBreaker);
+		void addCopy(const Sprite& sprite, int mask, int layer, float tieBreaker);
+		void add(const TextRenderer& text, int mask, int layer, float tieBreaker);
+		void addCopy(const TextRenderer& text, int mask, int layer, float tieBreaker);
+
+		size_t size() const;
+
+	private:
+		friend class SpritePainter;
+
+		Vector<SpritePainterEntry> sprites;
+		Vector<Sprite> cachedSprites;
+		Vector<TextRenderer> cachedText;
+
+		void clear();
 	};
 
 	class SpritePainter
@@ -51,15 +80,77 @@ namespace Halley
 		void addCopy(const Sprite& sprite, int mask, int layer, float tieBreaker);
 		void add(const TextRenderer& sprite, int mask, int layer, float tieBreaker);
 		void addCopy(const TextRenderer& text, int mask, int layer, float tieBreaker);
+
+		// n more buckets, which n threads can each add to at the same time. At the next draw(), they're merged in after whatever was added
+		// before, in order, as if everything had been added from a single thread. Only valid until getBuckets(), gather() or draw() are next called.
+		gsl::span<SpritePainterBucket> getBuckets(size_t n);
+
+		// Calls f(bucket, start, end) on the CPU executor, for chunks of [0, n), e.g. to add the sprites of a family's entities in that range
+		void gather(size_t n, const std::function<void(SpritePainterBucket&, size_t, size_t)>& f);
+
+		// Everything outside of the camera's view is culled before sorting, so it costs nothing past add()
+		// Sprites whose material depth tests are given a depth from their place in the draw order. Opaque ones that write depth,
+		// and that are behind everything which doesn't depth test, are drawn first and front to back, so the GPU can skip
+		// whatever they cover. The render target needs a depth buffer, cleared before this, for that to work.
 		void draw(int mask, Painter& painter);
 
+		// For drawing the same sprites to several views (e.g. split-screen, or a minimap), by calling draw() under the camera of each.
+		// Everything is sorted once, on the first draw() after the sprites change, and each view after that only culls, keeping that order.
+		void setMultipleViews(bool enabled);
+
+		// Sprites in an unordered layer are grouped by material before tie breaker, so that they batch better.
+		// Only use it for layers where the draw order of overlapping sprites doesn't matter.
+		void setLayerUnordered(int layer, bool unordered);
+
 	private:
+		struct SortEntry
+		{
+			uint64_t key;
+			uint32_t idx;
+		};
+
 		Vector<SpritePainterEntry> sprites;
 		Vector<Sprite> cachedSprites;
 		Vector<TextRenderer> cachedText;
+		Vector<SpritePainterBucket> buckets;
+		size_t bucketsUsed = 0;
+		Vector<int> unorderedLayers;
+		Vector<SortEntry> sortEntries;
+		Vector<SortEntry> sortScratch;
+		Vector<std::array<uint32_t, 256>> chunkHistograms; // Of each chunk sorted in parallel
+		Vector<SpriteVertexAttrib> batchVertices; // Of sprites sharing a material, drawn as one
+		Vector<uint32_t> visible;
+		Vector<uint8_t> depthModes; // Of each sort entry
 		bool dirty = false;
 
-		void draw(const Sprite& sprite, Painter& painter, Rect4f view);
-		void draw(const TextRenderer& text, Painter& painter, Rect4f view);
+		bool multipleViews = false;
+		bool allSorted = false;
+		Vector<uint32_t> allIndices;
+		Vector<SortEntry> allSortEntries; // Of every sprite, when drawing multiple views
+		Vector<uint8_t> inView;
+
+		// Bounds of each entry, kept apart so that the culling pass can test several at once
+		Vector<float> boundsMinX;
+		Vector<float> boundsMinY;
+		Vector<float> boundsMaxX;
+		Vector<float> boundsMaxY;
+		Vector<Vector2f> quadPositions;
+		Vector<Vector2f> quadPivots;
+		Vector<Vector2f> quadSizes;
+		Vector<float> quadRotations;
+
+		void mergeBuckets();
+		void updateBounds();
+		void cull(Rect4f view, int mask);
+		void sort(const Vector<uint32_t>& indices); // Into sortEntries
+		uint64_t getSortKey(const SpritePainterEntry& entry) const;
+		uint16_t getMaterialKey(const SpritePainterEntry& entry) const;
+		uint8_t getDepthMode(const SpritePainterEntry& entry) const;
+		const Sprite* getSprite(const SpritePainterEntry& entry) const;
+
+		void draw(const SpritePainterEntry& entry, Painter& painter, float zoom, uint8_t depthMode, float depth);
+
+		void draw(const Sprite& sprite, Painter& painter);
+		void draw(const TextRenderer& text, Painter& painter);
 	};
 }
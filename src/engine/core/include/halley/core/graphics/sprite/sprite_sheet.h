@@ -3,9 +3,11 @@
 #include <halley/maths/vector2.h>
 #include <halley/maths/rect.h>
 #include <memory>
+#include <deque>
 #include <halley/resources/resource.h>
 #include <halley/text/halleystring.h>
 #include <halley/data_structures/hash_map.h>
+#include <halley/data_structures/maybe.h>
 #include <gsl/span>
 #include "halley/maths/vector4.h"
 
@@ -49,6 +51,12 @@ namespace Halley
 	class SpriteSheet : public Resource
 	{
 	public:
+		SpriteSheet() = default;
+		SpriteSheet(const SpriteSheet& other) = delete; // The names would still point into the other one's
+		SpriteSheet(SpriteSheet&& other) = default;
+		SpriteSheet& operator=(const SpriteSheet& other) = delete;
+		SpriteSheet& operator=(SpriteSheet&& other) = default;
+
 		const std::shared_ptr<const Texture>& getTexture() const;
 		const SpriteSheetEntry& getSprite(const String& name) const;
 		const SpriteSheetEntry& getSprite(size_t idx) const;
@@ -58,12 +66,14 @@ namespace Halley
 
 		size_t getSpriteCount() const;
 		size_t getIndex(const String& name) const;
+		Maybe<size_t> tryGetIndex(const String& name) const; // Resolve once, then use getSprite(idx) from then on
 		bool hasSprite(const String& name) const;
 
 		void loadJson(gsl::span<const gsl::byte> data);
 
 		void addSprite(String name, const SpriteSheetEntry& sprite);
 		void setTextureName(String name);
+		const String& getTextureName() const { return textureName; }
 
 		static std::unique_ptr<SpriteSheet> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::SpriteSheet; }
@@ -77,11 +87,16 @@ namespace Halley
 
 		mutable std::shared_ptr<const Texture> texture;
 		std::vector<SpriteSheetEntry> sprites;
-		HashMap<String, uint32_t> spriteIdx;
+
+		// Names point into the data the sheet was loaded from, so loading doesn't allocate a String per sprite; those added otherwise are kept here
+		std::shared_ptr<ResourceDataStatic> dataOwner;
+		std::deque<String> ownedNames;
+		HashMap<StringView, uint32_t> spriteIdx;
 		std::vector<SpriteSheetFrameTag> frameTags;
 		String textureName;
 
 		void loadTexture(Resources& resources) const;
+		void setIndex(const String& name, uint32_t idx);
 	};
 
 	class SpriteResource : public Resource
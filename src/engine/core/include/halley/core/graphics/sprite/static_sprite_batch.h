@@ -0,0 +1,61 @@
+#pragma once
+
+#include <halley/maths/rect.h>
+#include <halley/data_structures/vector.h>
+#include <memory>
+#include "sprite.h"
+
+namespace Halley
+{
+	class Material;
+	class Painter;
+	class StaticVertexBuffer;
+
+	// Sprites that don't change from one frame to the next, such as background scenery, drawn without going through SpritePainter.
+	// They're grouped by material and expanded into vertices once, into StaticVertexBuffers, so backends that support it keep them on the GPU
+	// and draw() only costs a drawStaticQuads() per group (more for groups past what one buffer can address), skipping those out of view.
+	// Changing the sprites rebuilds everything on the next draw(). Within a group, sprites are drawn in the order they were added, but
+	// groups are drawn one after the other, in the order their materials first appeared, so only overlap sprites of different materials
+	// where that doesn't matter. Sprites have to be isBatchable(), so sliced ones, or ones clipped by the scissor, can't be added.
+	class StaticSpriteBatch
+	{
+	public:
+		void clear();
+		void add(const Sprite& sprite);
+		void set(size_t idx, const Sprite& sprite);
+		const Sprite& get(size_t idx) const;
+		size_t size() const;
+		bool empty() const;
+
+		// For changes the batch can't see, such as to a material the sprites share
+		void invalidate();
+
+		Rect4f getBounds() const; // Of the visible sprites
+
+		// Draws what's within the painter's current camera
+		void draw(Painter& painter);
+
+	private:
+		constexpr static size_t maxSpritesPerBuffer = 16384; // 65536 vertices, within what 16-bit indices can address
+
+		struct Buffer
+		{
+			std::shared_ptr<const StaticVertexBuffer> vertices;
+			Rect4f bounds;
+		};
+
+		struct Group
+		{
+			std::shared_ptr<Material> material;
+			Vector<size_t> sprites;
+			Vector<Buffer> buffers;
+		};
+
+		Vector<Sprite> sprites;
+		Vector<Group> groups;
+		bool dirty = false;
+
+		void rebuild();
+		Buffer makeBuffer(const size_t* spriteIdxs, size_t n) const;
+	};
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <halley/maths/vector2.h>
+#include <halley/maths/rect.h>
+#include <halley/maths/colour.h>
+#include <halley/data_structures/vector.h>
+#include <memory>
+
+namespace Halley
+{
+	class SpriteSheet;
+	class Material;
+	class MaterialDefinition;
+	class Painter;
+	class StaticVertexBuffer;
+
+	// A grid of tiles from a sprite sheet, in one or more layers, drawn without a Sprite per tile.
+	// Each layer is split into chunks of chunkSize x chunkSize tiles, and each chunk is a single drawStaticQuads(), so its vertices
+	// stay on the GPU. Changing a tile only marks its chunk as dirty; draw() rebuilds the dirty chunks that the camera can see,
+	// and skips the rest altogether. Layers can be drawn one at a time, to draw other things between them.
+	// Tiles are stretched to fill their cell, so tilesets shouldn't be trimmed.
+	class Tilemap
+	{
+	public:
+		constexpr static int chunkSize = 32; // 4096 vertices, within what 16-bit indices can address
+		constexpr static int emptyTile = -1;
+
+		Tilemap(std::shared_ptr<const SpriteSheet> tileset, std::shared_ptr<const MaterialDefinition> material, Vector2i size, Vector2f tileSize, int numLayers = 1);
+
+		Vector2i getSize() const;
+		Vector2f getTileSize() const;
+		int getNumLayers() const;
+		const std::shared_ptr<Material>& getMaterial() const;
+
+		// Of the top left corner of tile (0, 0)
+		void setPosition(Vector2f position);
+		Vector2f getPosition() const;
+		Rect4f getBounds() const;
+		Vector2i getTileAt(Vector2f worldPosition) const; // Not clamped to the map
+
+		// Tiles are indices into the tileset, or emptyTile
+		void setTile(int layer, Vector2i position, int tile);
+		int getTile(int layer, Vector2i position) const;
+		void fill(int layer, Rect4i area, int tile); // Area is in tiles, and clipped to the map
+
+		void setLayerColour(int layer, Colour4f colour);
+		Colour4f getLayerColour(int layer) const;
+		void setLayerVisible(int layer, bool visible);
+		bool isLayerVisible(int layer) const;
+
+		// Draws what's within the painter's current camera
+		void draw(Painter& painter); // Every visible layer, in order
+		void draw(int layer, Painter& painter);
+
+	private:
+		struct Chunk
+		{
+			std::shared_ptr<const StaticVertexBuffer> vertices; // Null if there's nothing in it
+			bool dirty = true;
+		};
+
+		struct Layer
+		{
+			Vector<int> tiles;
+			Vector<Chunk> chunks;
+			Colour4f colour = Colour4f(1, 1, 1, 1);
+			bool visible = true;
+		};
+
+		std::shared_ptr<const SpriteSheet> tileset;
+		std::shared_ptr<Material> material;
+		Vector2i size;
+		Vector2i numChunks;
+		Vector2f tileSize;
+		Vector2f position;
+		Vector<Layer> layers;
+
+		Layer& getLayer(int layer);
+		const Layer& getLayer(int layer) const;
+		size_t getTileIndex(Vector2i position) const;
+		Chunk& getChunk(Layer& layer, Vector2i tilePosition);
+		void markAllDirty(Layer& layer);
+		void rebuildChunk(const Layer& layer, Vector2i chunkPosition, Chunk& chunk) const;
+	};
+}
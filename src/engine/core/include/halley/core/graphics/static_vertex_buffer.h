@@ -0,0 +1,28 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <halley/data_structures/vector.h>
+
+namespace Halley {
+	// Vertices that stay the same for many frames, which backends that support it keep on the GPU instead of streaming on every draw.
+	// The contents can't change: to draw something else, make a new one. That way a draw recorded for the render thread keeps
+	// the vertices it was recorded with, and the backend knows when to upload again just from the id.
+	class StaticVertexBuffer {
+	public:
+		StaticVertexBuffer(Vector<char> data, size_t numVertices);
+
+		uint64_t getId() const { return id; }
+		size_t getNumVertices() const { return numVertices; }
+		const char* getData() const { return data.data(); }
+		size_t getSize() const { return data.size(); }
+
+	private:
+		static std::atomic<uint64_t> nextId;
+
+		Vector<char> data;
+		size_t numVertices;
+		uint64_t id;
+	};
+}
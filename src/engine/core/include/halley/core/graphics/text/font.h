@@ -10,6 +10,8 @@ namespace Halley
 {
 	class Deserializer;
 	class Serializer;
+	class GlyphCache;
+	class BinaryFile;
 
 	class Font : public Resource
 	{
@@ -23,6 +25,7 @@ namespace Halley
 			Vector2f horizontalBearing;
 			Vector2f verticalBearing;
 			Vector2f advance;
+			int page = -1; // Atlas page in the font's GlyphCache, for glyphs rasterised at runtime (not serialized)
 			
 			Glyph();
 			Glyph(const Glyph& other) = default;
@@ -40,6 +43,7 @@ namespace Halley
 		Font(String name, String imageName, float ascender, float height, float sizePt, float replacementScale, float distanceFieldSmoothRadius, std::vector<String> fallback);
 
 		explicit Font(ResourceLoader& loader);
+		~Font();
 
 		static std::unique_ptr<Font> loadResource(ResourceLoader& loader);
 		constexpr static AssetType getAssetType() { return AssetType::Font; }
@@ -56,10 +60,22 @@ namespace Halley
 		float getReplacementScale() const;
 		String getName() const;
 		bool isDistanceField() const;
+		const String& getImageName() const { return imageName; }
+		const std::vector<String>& getFallback() const { return fallback; }
 
 		void addGlyph(const Glyph& glyph);
 
+		// Glyphs missing from the baked atlas can be rasterised at runtime from the original font file, a BinaryFile asset.
+		// Those are plain coverage, drawn with the sprite material even if the font is a distance field.
+		void setDynamicGlyphSource(String binaryFileName);
+		bool hasDynamicGlyphs() const;
+		// Changes whenever glyphs rasterised here or by fallbacks may have moved; layouts made before then are stale
+		uint64_t getGlyphGeneration() const;
+		// Uploads glyphs rasterised since the last call, call before drawing
+		void updateGlyphCache() const;
+
 		std::shared_ptr<Material> getMaterial() const;
+		std::shared_ptr<Material> getMaterial(const Glyph& glyph) const;
 
 		void serialize(Serializer& deserializer) const;
 		void deserialize(Deserializer& deserializer);
@@ -78,7 +94,14 @@ namespace Halley
 		std::vector<std::shared_ptr<const Font>> fallbackFont;
 		std::vector<String> fallback;
 
+		String dynamicGlyphSource;
+
 		std::shared_ptr<Material> material;
 		FlatMap<int, Glyph> glyphs;
+		std::shared_ptr<const BinaryFile> dynamicGlyphData;
+		std::shared_ptr<GlyphCache> glyphCache;
+
+		bool hasGlyph(int code) const;
+		const Glyph* findGlyph(int code) const;
 	};
 }
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include "font.h"
+#include "halley/data_structures/hash_map.h"
+#include "halley/data_structures/maybe.h"
+#include "halley/data_structures/vector.h"
+
+namespace Halley
+{
+	class VideoAPI;
+	class MaterialDefinition;
+	class Material;
+
+	// Source of glyphs for a GlyphCache, e.g. FreeType reading the original font file
+	class IGlyphRasterizer
+	{
+	public:
+		struct GlyphImage
+		{
+			Vector2i size;
+			Vector<uint8_t> coverage; // One byte per pixel, rows top to bottom
+			Vector2f bearing; // From the pen position to the top left of the image, y up
+			Vector2f advance;
+		};
+
+		virtual ~IGlyphRasterizer() {}
+
+		virtual bool hasGlyph(int charcode) const = 0;
+		virtual Maybe<GlyphImage> rasterize(int charcode) = 0;
+	};
+
+	// Glyphs rasterised on demand into atlas pages, for fonts that can't reasonably bake all of them (e.g. CJK).
+	// When every page is full, the least recently used one is cleared and the generation goes up, so anything
+	// holding on to glyph areas knows to look them up again. Main thread only.
+	class GlyphCache
+	{
+	public:
+		GlyphCache(VideoAPI& video, std::shared_ptr<const MaterialDefinition> materialDefinition, std::unique_ptr<IGlyphRasterizer> rasterizer, int pageSize = 1024, size_t maxPages = 4);
+		~GlyphCache();
+
+		bool hasGlyph(int charcode) const;
+
+		// Returns nullptr if the rasterizer doesn't have it, or it doesn't fit in a page
+		const Font::Glyph* getGlyph(int charcode);
+
+		std::shared_ptr<Material> getMaterial(int page) const;
+		uint64_t getGeneration() const;
+
+		// Uploads any pages that got new glyphs
+		void update();
+
+	private:
+		struct Shelf
+		{
+			int y;
+			int height;
+			int x;
+		};
+
+		struct Page
+		{
+			Vector<uint8_t> pixels;
+			Vector<Shelf> shelves;
+			Vector<int> glyphs;
+			int nextShelfY = 0;
+			uint64_t lastUse = 0;
+			bool dirty = false;
+			std::shared_ptr<Material> material;
+		};
+
+		constexpr static int padding = 1;
+
+		VideoAPI& video;
+		std::shared_ptr<const MaterialDefinition> materialDefinition;
+		std::unique_ptr<IGlyphRasterizer> rasterizer;
+		const int pageSize;
+		const size_t maxPages;
+
+		Vector<std::unique_ptr<Page>> pages;
+		HashMap<int, Font::Glyph> glyphs;
+		uint64_t useCounter = 0;
+		uint64_t generation = 0;
+
+		const Font::Glyph* addGlyph(int charcode);
+		Maybe<Vector2i> allocate(Page& page, Vector2i size) const;
+		int getPageWithSpace(Vector2i size, Vector2i& pos);
+		void evict(int pageIdx);
+		void upload(Page& page);
+	};
+}
@@ -15,6 +15,7 @@ namespace Halley
 	class Painter;
 	class Material;
 	class Sprite;
+	struct SpriteVertexAttrib;
 
 	using ColourOverride = std::pair<size_t, Maybe<Colour4f>>;
 
@@ -46,7 +47,7 @@ namespace Halley
 
 		TextRenderer clone() const;
 
-		void generateSprites(std::vector<Sprite>& sprites) const;
+		void generateSprites(std::vector<Sprite>& sprites) const; // Only needed to do something with the glyphs; draw() doesn't make sprites
 		void draw(Painter& painter) const;
 
 		void setSpriteFilter(SpriteFilter f);
@@ -94,10 +95,43 @@ namespace Halley
 
 		std::vector<ColourOverride> colourOverrides;
 
-		mutable Vector<Sprite> spritesCache;
+		// What a glyph needs to be drawn, a fraction of a Sprite; they're turned into vertices straight into the painter
+		struct GlyphInstance {
+			Vector2f offset; // From the origin, alignment included
+			Vector2f size;
+			Vector2f pivot;
+			Rect4f texRect;
+			Colour4f colour;
+			float scale;
+			uint32_t material; // In glyphMaterials
+			uint32_t character; // Where in the text it came from
+		};
+
+		// Laid out once, then only colours are patched as those change.
+		// Text changes keep the layout of every line before the first one that changed.
+		mutable Vector<GlyphInstance> glyphs;
+		mutable Vector<std::shared_ptr<Material>> glyphMaterials;
+		mutable Vector<SpriteVertexAttrib> glyphVertices; // Reused by every draw
+		mutable Vector<Sprite> filteredSprites;
+		mutable Vector2f layoutExtents;
+		mutable size_t layoutValidLength = 0;
+		mutable size_t lastLineStart = 0;
+		mutable size_t lastLineGlyph = 0;
+		mutable float lastLineY = 0;
+		mutable float widthBeforeLastLine = 0;
+		mutable uint64_t glyphGeneration = 0;
+
 		mutable bool materialDirty = true;
-		mutable bool glyphsDirty = true;
-		mutable bool positionDirty = true;
+		mutable bool layoutDirty = true;
+		mutable bool colourDirty = true;
+
+		void invalidateLayout() const;
+		void updateLayout() const;
+		void updateGlyphs() const;
+		Vector2f getOrigin() const;
+		uint32_t getGlyphMaterialIndex(const std::shared_ptr<Material>& material) const;
+		Sprite makeSprite(const GlyphInstance& glyph, Vector2f origin) const;
+		void drawGlyphs(Painter& painter) const;
 
 		std::shared_ptr<Material> getMaterial(const Font& font) const;
 		void updateMaterial(Material& material, const Font& font) const;
@@ -2,17 +2,22 @@
 
 #include "halley/resources/resource.h"
 #include "halley/maths/vector2.h"
+#include <functional>
 #include <memory>
 
 namespace Halley
 {
 	class TextureDescriptor;
 	class ResourceLoader;
+	class ResourceDataStatic;
+	class VideoAPI;
+	class TextureUploadQueue;
 
 	class Texture : public AsyncResource
 	{
 	public:
 		Texture(Vector2i size);
+		~Texture();
 
 		virtual void load(TextureDescriptor&& descriptor);
 
@@ -20,8 +25,30 @@ namespace Halley
 		constexpr static AssetType getAssetType() { return AssetType::Texture; }
 
 		Vector2i getSize() const { return size; }
+		int getLayers() const { return layers; } // More than one if it's an array, sampled with sampler2DArray / Texture2DArray
+		size_t getMemoryUsage() const override;
+
+		// Textures imported with "mipStreaming" start with only their coarser mip levels; finer ones are loaded when asked for.
+		// Call from the main thread, where the finer version is also swapped in once it's ready.
+		bool isMipStreamed() const;
+		int getResidentMipLevel() const;
+		void requestMipLevel(int level) const;
+
+		// The mip level to sample something drawn at this many screen pixels per texel
+		static int getMipLevelFor(float pixelsPerTexel);
+
+		// What renderers should bind for this texture. While it waits for its turn in the video API's TextureUploadQueue, that's the
+		// queue's placeholder (unless imported with "placeholder: false", in which case it's moved to the front and bound anyway).
+		const Texture& getBindable() const;
 
 	protected:
 		Vector2i size;
+		int layers = 1;
+
+	private:
+		struct MipStream;
+		std::unique_ptr<MipStream> mipStream;
+		TextureUploadQueue* uploadQueue = nullptr;
+		bool usePlaceholder = false;
 	};
 }
@@ -3,6 +3,7 @@
 #include <halley/maths/vector2.h>
 #include "halley/file_formats/image.h"
 #include "halley/data_structures/maybe.h"
+#include "halley/resources/resource_data.h"
 
 namespace Halley
 {
@@ -11,17 +12,21 @@ namespace Halley
 		Indexed,
 		RGB,
 		RGBA,
-		DEPTH
+		DEPTH,
+		BC1,
+		BC3
 	};
 
 	template <>
 	struct EnumNames<TextureFormat> {
-		constexpr std::array<const char*, 4> operator()() const {
+		constexpr std::array<const char*, 6> operator()() const {
 			return{{
 				"indexed",
 				"rgb",
 				"rgba",
-				"depth"
+				"depth",
+				"bc1",
+				"bc3"
 			}};
 		}
 	};
@@ -41,6 +46,8 @@ namespace Halley
 		TextureDescriptorImageData(Bytes&& bytes, Maybe<int> stride = {});
 		TextureDescriptorImageData(TextureDescriptorImageData&& other) noexcept;
 		TextureDescriptorImageData(gsl::span<const gsl::byte> bytes, Maybe<int> stride = {});
+		// Keeps data alive and uploads straight from view (e.g. into a memory-mapped pack), without copying
+		TextureDescriptorImageData(std::shared_ptr<const ResourceDataStatic> data, gsl::span<const gsl::byte> view, Maybe<int> stride = {});
 
 		TextureDescriptorImageData& operator=(TextureDescriptorImageData&& other) noexcept;
 
@@ -56,6 +63,8 @@ namespace Halley
 	private:
 		std::unique_ptr<Image> img;
 		Bytes rawBytes;
+		std::shared_ptr<const ResourceDataStatic> source;
+		gsl::span<const gsl::byte> sourceView;
 		Maybe<int> stride;
 		bool isRaw = false;
 	};
@@ -68,6 +77,7 @@ namespace Halley
 		TextureFormat format = TextureFormat::RGBA;
 		PixelDataFormat pixelFormat = PixelDataFormat::Image;
 		TextureDescriptorImageData pixelData;
+		int layers = 1; // Texture arrays have more, all the same size, with each layer's pixel data (and mip levels) after the previous one's
 
 		bool useMipMap = false;
 		bool useFiltering = false;
@@ -84,5 +94,11 @@ namespace Halley
 		TextureDescriptor& operator=(TextureDescriptor&& other) noexcept;
 
 		static int getBitsPerPixel(TextureFormat format);
+
+		// Block-compressed formats store 4x4 pixel blocks, and their pixel data holds every mip level, largest first
+		static bool isCompressed(TextureFormat format);
+		static size_t getLevelByteSize(Vector2i size, TextureFormat format);
+		static int getNumMipLevels(Vector2i size);
+		static Vector2i getMipLevelSize(Vector2i size, int level);
 	};
 }
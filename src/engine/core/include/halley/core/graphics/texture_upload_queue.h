@@ -0,0 +1,54 @@
+#pragma once
+
+#include <memory>
+#include <functional>
+#include "texture_descriptor.h"
+
+namespace Halley
+{
+	class Texture;
+	class VideoAPI;
+	class ExecutionQueue;
+
+	// Paces the uploads of textures loaded as resources, so many finishing at once don't all go to the GPU in the same frame.
+	// Video plugins own one (see VideoAPI::getTextureUploadQueue) and call onFrame() as each frame starts. Uploads then run on the
+	// executor, up to a budget of bytes per frame, those drawn recently first. Until a texture is uploaded, renderers bind its
+	// Texture::getBindable(), which is the placeholder, or the texture itself (moved to the front of the queue) when it can't be substituted.
+	class TextureUploadQueue
+	{
+	public:
+		struct Config
+		{
+			size_t bytesPerFrame = 16 * 1024 * 1024; // At least one upload is done each frame, however big
+			int maxFrameWaitMs = 100; // Uploads carry on at this pace if frames stop coming, e.g. while something waits for a texture
+		};
+
+		explicit TextureUploadQueue(ExecutionQueue& executor);
+		TextureUploadQueue(ExecutionQueue& executor, Config config);
+		~TextureUploadQueue();
+
+		TextureUploadQueue(const TextureUploadQueue& other) = delete;
+		TextureUploadQueue& operator=(const TextureUploadQueue& other) = delete;
+
+		// A texture to bind in place of those that aren't uploaded yet; uploaded ahead of anything else
+		void createPlaceholder(VideoAPI& video);
+		const Texture* getPlaceholder() const;
+
+		// Loads descriptor into texture when its turn comes. If that throws, onFailed is called instead of marking the texture as failed.
+		void enqueue(std::shared_ptr<Texture> texture, TextureDescriptor descriptor, std::function<void()> onFailed = {});
+
+		// From the thread that renders
+		void onFrame();
+		void onWanted(const Texture& texture, bool urgent); // Urgent ones are uploaded regardless of budget, as something is waiting for them
+
+		// Anything still queued is dropped, with its texture marked as loaded so nothing waits on it forever
+		void clear();
+
+	private:
+		struct State;
+		std::shared_ptr<State> state;
+
+		static void scheduleDrain(const std::shared_ptr<State>& state);
+		static void drain(const std::shared_ptr<State>& state);
+	};
+}
@@ -3,6 +3,7 @@
 namespace Halley {} // Get GitHub to realise this is C++ :3
 
 #include "api/halley_api.h"
+#include "api/async_save_data.h"
 
 #include "game/core.h"
 #include "game/environment.h"
@@ -13,9 +14,11 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 #include "graphics/blend.h"
 #include "graphics/painter.h"
 #include "graphics/render_context.h"
+#include "graphics/render_graph.h"
 #include "graphics/shader.h"
 #include "graphics/texture.h"
 #include "graphics/texture_descriptor.h"
+#include "graphics/texture_upload_queue.h"
 
 #include "graphics/material/material.h"
 #include "graphics/material/material_definition.h"
@@ -25,6 +28,7 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 
 #include "graphics/render_target/render_target.h"
 #include "graphics/render_target/render_target_screen.h"
+#include "graphics/render_target/render_target_pool.h"
 #include "graphics/render_target/render_target_texture.h"
 
 #include "graphics/text/font.h"
@@ -32,10 +36,19 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 
 #include "graphics/sprite/animation.h"
 #include "graphics/sprite/animation_player.h"
+#include "graphics/sprite/animation_batch.h"
 #include "graphics/sprite/sprite.h"
 #include "graphics/sprite/sprite_painter.h"
 #include "graphics/sprite/sprite_sheet.h"
+#include "graphics/sprite/static_sprite_batch.h"
+#include "graphics/sprite/tilemap.h"
 
+#include "graphics/particles/particle_emitter.h"
+
+#include "graphics/lighting/deferred_lighting.h"
+#include "graphics/dynamic_resolution.h"
+
+#include "graphics/static_vertex_buffer.h"
 #include "graphics/window.h"
 
 #include "input/input_joystick.h"
@@ -52,6 +65,7 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 
 #include "stage/stage.h"
 #include "stage/entity_stage.h"
+#include "stage/hot_reload_state.h"
 
 #include "utils/world_stats.h"
 
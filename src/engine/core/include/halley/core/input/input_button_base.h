@@ -22,6 +22,7 @@
 #pragma once
 
 #include "input_device.h"
+#include "input_event_queue.h"
 #include <halley/support/exception.h>
 
 namespace Halley {
@@ -53,12 +54,16 @@ namespace Halley {
 		void setParent(InputDevice* parent) override;
 		InputDevice* getParent() const override;
 
+		// Presses and releases are also pushed to the queue, as they come in
+		virtual void setEventQueue(std::shared_ptr<InputEventQueue> queue);
+
 	protected:
 		Vector<char> buttonPressed;
 		Vector<char> buttonPressedRepeat;
 		Vector<char> buttonReleased;
 		Vector<char> buttonDown;
 		InputDevice* parent = nullptr;
+		std::shared_ptr<InputEventQueue> eventQueue;
 
 		void init(int nButtons);
 
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <halley/data_structures/vector.h>
+
+namespace Halley {
+	class InputDevice;
+
+	struct InputButtonEvent {
+		int64_t timestamp = 0; // Nanoseconds, on InputEventQueue::getTime()
+		InputDevice* device = nullptr;
+		int button = 0;
+		bool down = false;
+	};
+
+	// Button transitions of the devices attached to it, in the order they happened, timestamped as precisely as the backend can.
+	// Backends may push from whichever thread they receive OS events on.
+	// Each reader keeps its own cursor, so any number of them can read the same queue. Only the last capacity events are kept;
+	// a reader that falls further behind than that skips what it missed.
+	class InputEventQueue {
+	public:
+		explicit InputEventQueue(size_t capacity = 1024);
+
+		// Monotonic clock that timestamps are on
+		static int64_t getTime();
+
+		// Timestamp for events pushed from now on, for backends that know when the OS received them. 0 stamps them when they're pushed.
+		void setEventTime(int64_t time);
+		void push(InputDevice& device, int button, bool down);
+
+		// A cursor at the end skips everything queued so far
+		uint64_t getEnd() const;
+
+		// Appends events from cursor onwards with timestamp up to until, in order, and advances the cursor past them
+		void read(uint64_t& cursor, int64_t until, Vector<InputButtonEvent>& dst) const;
+
+	private:
+		mutable std::mutex mutex;
+		Vector<InputButtonEvent> events;
+		uint64_t end = 0;
+		int64_t eventTime = 0;
+		int64_t lastTimestamp = 0;
+	};
+}
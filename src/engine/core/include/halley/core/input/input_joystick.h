@@ -76,6 +76,8 @@ namespace Halley {
 
 		void clearAxes();
 
+		void setEventQueue(std::shared_ptr<InputEventQueue> queue) override;
+
 		bool isAnyButtonPressed() override;
 		bool isAnyButtonReleased() override;
 		bool isAnyButtonDown() override;
@@ -83,6 +83,13 @@ namespace Halley {
 
 		void update(Time t);
 
+		// For when the order and timing of presses within a frame matter: consumeEvents(until) gathers the bound devices'
+		// presses and releases from the queue, up to that time on InputEventQueue::getTime() (e.g. the end of the current fixed step).
+		// getEvents() then has them oldest first, with button being the virtual button.
+		void setEventQueue(std::shared_ptr<InputEventQueue> queue);
+		void consumeEvents(int64_t until);
+		const Vector<InputButtonEvent>& getEvents() const;
+
 		void setRepeat(float first, float hold);
 
 		InputDevice* getLastDevice() const;
@@ -146,6 +153,11 @@ namespace Halley {
 		float repeatDelayFirst;
 		float repeatDelayHold;
 
+		std::shared_ptr<InputEventQueue> eventQueue;
+		uint64_t eventCursor = 0;
+		Vector<InputButtonEvent> deviceEvents;
+		Vector<InputButtonEvent> events;
+
 		std::set<spInputDevice> getAllDevices() const;
 	};
 
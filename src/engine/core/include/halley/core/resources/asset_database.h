@@ -4,11 +4,22 @@
 #include "halley/data_structures/tree_map.h"
 #include "halley/data_structures/hash_map.h"
 #include "halley/resources/metadata.h"
+#include "halley/utils/utils.h"
+#include <vector>
+#include <utility>
+#include <functional>
+#include <memory>
+#include <gsl/span>
 
 namespace Halley
 {
 	enum class AssetType;
+	class CompactTypedDB;
 
+	// Asset packs store the database in a compact layout, which is used in place (e.g. straight from the memory mapped pack) instead of
+	// being parsed at load: each type has a minimal perfect hash over its asset names, flat records, and a pool with the names and entries.
+	// Entries are only decoded the first time they're looked up. A compact database can't be modified in place, so adding or removing
+	// assets copies it out first.
 	class AssetDatabase
 	{
 	public:
@@ -17,9 +28,10 @@ namespace Halley
 		public:
 			String path;
 			Metadata meta;
+			std::vector<std::pair<AssetType, String>> dependencies; // Loaded whenever this is, as recorded by the importer
 
 			Entry();
-			Entry(const String& path, const Metadata& meta);
+			Entry(const String& path, const Metadata& meta, std::vector<std::pair<AssetType, String>> dependencies = {});
 
 			void serialize(Serializer& s) const;
 			void deserialize(Deserializer& s);
@@ -27,27 +39,43 @@ namespace Halley
 
 		class TypedDB
 		{
+			friend class AssetDatabase;
+
 		public:
 			void add(const String& name, Entry&& asset);
+			void remove(const String& name);
 			const Entry& get(const String& name) const;
+			const Entry* tryGet(const String& name) const;
 
 			void serialize(Serializer& s) const;
 			void deserialize(Deserializer& s);
 
-			const HashMap<String, Entry>& getAssets() const;
+			size_t size() const;
+			std::vector<String> getNames() const;
+			void forEach(const std::function<void(const String&, const Entry&)>& f) const; // Decodes every entry, if it's compact
 
 		private:
 			HashMap<String, Entry> assets;
+			std::shared_ptr<const CompactTypedDB> compact;
+
+			void expand();
 		};
 
 		void addAsset(const String& name, AssetType type, Entry&& entry);
+		void removeAsset(const String& name, AssetType type);
 		const TypedDB& getDatabase(AssetType type) const;
+		std::vector<AssetType> getTypes() const;
 		std::vector<String> getAssets() const;
 
 		void serialize(Serializer& s) const;
 		void deserialize(Deserializer& s);
 		std::vector<String> enumerate(AssetType type) const;
 
+		Bytes toCompact() const;
+		static bool isCompact(gsl::span<const gsl::byte> data);
+		void loadCompact(gsl::span<const gsl::byte> data, bool inPlace); // In place, data must outlive the database
+		void loadPacked(gsl::span<const gsl::byte> data, bool inPlace); // Either compact, or compressed and serialized, as older packs have it
+
 	private:
 		mutable TreeMap<int, TypedDB> dbs;
 	};
@@ -1,9 +1,13 @@
 #pragma once
 #include "halley/utils/utils.h"
 #include "halley/text/halleystring.h"
+#include <atomic>
 #include <memory>
 #include <gsl/span>
 #include "halley/resources/resource_data.h"
+#include "halley/utils/encrypt.h"
+#include "halley/bytes/compression.h"
+#include <mutex>
 
 namespace Halley {
 	enum class AssetType;
@@ -12,6 +16,7 @@ namespace Halley {
 	class AssetDatabase;
 	class ResourceData;
 	class ResourceDataReader;
+	class MemoryMappedFile;
 
 	struct AssetPackHeader {
 		std::array<char, 8> identifier;
@@ -28,6 +33,8 @@ namespace Halley {
 		AssetPack(const AssetPack& other) = delete;
 		AssetPack(AssetPack&& other);
 		AssetPack(std::unique_ptr<ResourceDataReader> reader, const String& encryptionKey = "", bool preLoad = false);
+		// Asset data is then read straight from the mapping, without copies or locking (unless the pack is encrypted, in which case it's decrypted as it's read)
+		AssetPack(std::unique_ptr<MemoryMappedFile> mappedFile, const String& encryptionKey = "");
 		~AssetPack();
 
 		AssetPack& operator=(const AssetPack& other) = delete;
@@ -38,26 +45,43 @@ namespace Halley {
 		Bytes& getData();
 		const Bytes& getData() const;
 
-		Bytes writeOut() const;
+		// Any spare room after the asset database lets tools rewrite it in place later, without moving the data
+		Bytes writeOut(size_t assetDbCapacity = 0) const;
 
 		std::unique_ptr<ResourceData> getData(const String& asset, AssetType type, bool stream);
 
 		void readToMemory();
+		// Packs are encrypted in counter mode, so ranges can be decrypted as they're read instead of all up front.
+		// Packs from before that (CBC) can still be loaded, but are decrypted whole at load.
 		void encrypt(const String& key);
 		void decrypt(const String& key);
+		bool isEncrypted() const { return cipher != nullptr; } // Whether data is decrypted as it's read
 	    
     	void readData(size_t pos, gsl::span<gsl::byte> dst);
 
 		std::unique_ptr<ResourceDataReader> extractReader();
 
+		bool isMemoryMapped() const { return mappedFile != nullptr; }
+		gsl::span<const gsl::byte> getMappedData(size_t pos, size_t size) const;
+
     private:
 		std::unique_ptr<AssetDatabase> assetDb;
 		std::unique_ptr<ResourceDataReader> reader;
+		std::unique_ptr<MemoryMappedFile> mappedFile;
+		gsl::span<const gsl::byte> mappedData;
 		std::atomic<bool> hasReader;
 		std::mutex readerMutex;
 		size_t dataOffset = 0;
 		Bytes data;
 		std::array<char, 16> iv;
+		bool counterMode = false;
+		std::unique_ptr<Encrypt::CounterMode> cipher; // Set while data at rest is still encrypted
+
+		void loadHeader(const AssetPackHeader& header, size_t totalSize);
+		void loadAssetDatabase(gsl::span<const gsl::byte> assetDbBytes, bool inPlace);
+		bool needsDecryption(const String& encryptionKey) const;
+		Bytes getIVBytes() const;
+		void doReadData(size_t pos, gsl::span<gsl::byte> dst);
     };
 
 
@@ -75,7 +99,35 @@ namespace Halley {
 		AssetPack& pack;
 		const size_t startPos;
 		const size_t fileSize;
+		gsl::span<const gsl::byte> mappedData;
+		std::atomic<size_t> curPos;
+	};
+
+	// Reads a streamed asset packed with Compression::compressChunked, as if it was uncompressed.
+	// Seeking only moves the position; reads decompress just the chunks they touch, in parallel if there's several.
+	class ChunkedPackDataReader : public ResourceDataReader {
+	public:
+		ChunkedPackDataReader(AssetPack& pack, size_t startPos, size_t fileSize, String codec);
+
+		size_t size() const override;
+		int read(gsl::span<gsl::byte> dst) override;
+		void seek(int64_t pos, int whence) override;
+		size_t tell() const override;
+		void close() override;
+
+	private:
+		AssetPack& pack;
+		const size_t startPos;
+		const size_t fileSize;
+		const String codec;
+		Compression::ChunkedHeader header;
+		std::vector<uint64_t> offsets;
+
+		std::mutex mutex;
 		size_t curPos = 0;
-		mutable std::mutex mutex;
+		size_t cachedChunk = std::numeric_limits<size_t>::max();
+		Bytes cachedData; // Last chunk decompressed, as sequential reads are usually smaller than a chunk
+
+		Bytes decompressChunk(size_t chunk);
 	};
 }
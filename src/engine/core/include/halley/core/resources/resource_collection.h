@@ -4,8 +4,12 @@
 #include <memory>
 #include <functional>
 #include <halley/text/halleystring.h>
+#include <halley/text/string_id.h>
 #include <halley/resources/resource_data.h>
-#include <halley/data_structures/hash_map.h>
+#include <halley/data_structures/flat_hash_map.h>
+#include <halley/time/halleytime.h>
+#include <halley/concurrency/future.h>
+#include "resource_streamer.h"
 
 namespace Halley
 {
@@ -14,23 +18,60 @@ namespace Halley
 	class Resources;
 	class ResourceLoader;
 
+	// A resource which might still be loading. get() blocks until it's ready, and must be called from the main thread.
+	template <typename T>
+	class ResourceHandle
+	{
+	public:
+		ResourceHandle() = default;
+
+		ResourceHandle(std::shared_ptr<const T> resource)
+			: resource(std::move(resource))
+		{}
+
+		ResourceHandle(std::shared_ptr<ResourceStreamRequest> request, std::function<std::shared_ptr<Resource>(ResourceStreamRequest&)> finish)
+			: request(std::move(request))
+			, finish(std::move(finish))
+		{}
+
+		bool isValid() const { return resource || request; }
+		bool isReady() const;
+		std::shared_ptr<const T> get() const;
+
+	private:
+		mutable std::shared_ptr<const T> resource;
+		mutable std::shared_ptr<ResourceStreamRequest> request;
+		std::function<std::shared_ptr<Resource>(ResourceStreamRequest&)> finish;
+	};
+
 	class ResourceCollectionBase
 	{
+		friend class Resources;
+
 		class Wrapper
 		{
 		public:
 			Wrapper(Wrapper&& other) noexcept
-				: res(std::move(other.res))
+				: assetId(std::move(other.assetId))
+				, res(std::move(other.res))
 				, depth(other.depth)
+				, bytes(other.bytes)
+				, lastUsedFrame(other.lastUsedFrame)
 			{}
 
-			Wrapper(std::shared_ptr<Resource> resource, int loadDepth)
-				: res(resource)
+			Wrapper(String assetId, std::shared_ptr<Resource> resource, int loadDepth, size_t bytes, uint64_t frame)
+				: assetId(std::move(assetId))
+				, res(resource)
 				, depth(loadDepth)
+				, bytes(bytes)
+				, lastUsedFrame(frame)
 			{}
 
+			String assetId;
 			std::shared_ptr<Resource> res;
 			int depth;
+			size_t bytes;
+			uint64_t lastUsedFrame;
 		};
 
 	public:
@@ -52,17 +93,41 @@ namespace Halley
 
 		std::vector<String> enumerate() const;
 
+		// When more than this is resident, resources nothing else holds on to are unloaded, least recently used first. 0 means no limit.
+		void setMemoryBudget(size_t bytes);
+		size_t getMemoryBudget() const;
+		size_t getResidentBytes() const;
+		size_t getNumResident() const;
+
+		// Returns how many bytes were released
+		size_t evict(size_t targetBytes);
+
 	protected:
 		virtual std::shared_ptr<Resource> loadResource(ResourceLoader& loader) = 0;
 
-		std::shared_ptr<Resource> doGet(const String& name, ResourceLoadPriority priority);
-		std::shared_ptr<Resource> loadAsset(const String& assetId, ResourceLoadPriority priority);
+		std::shared_ptr<Resource> doGet(StringView name, ResourceLoadPriority priority);
+		std::shared_ptr<Resource> doGet(const StringId& name, ResourceLoadPriority priority);
+		std::shared_ptr<Resource> doGetAsync(const String& name, ResourceLoadPriority priority, Time deadline, std::shared_ptr<ResourceStreamRequest>& request);
+		std::shared_ptr<Resource> loadAsset(const String& assetId, ResourceLoadPriority priority, std::unique_ptr<ResourceDataStatic> prefetched = {});
+
+		// Blocks until the request's data is fetched, then constructs it on this thread
+		std::shared_ptr<Resource> finishStreaming(ResourceStreamRequest& request);
+		// Calls back once it's done, with nullptr if it failed; right away if it already is
+		void onStreamed(ResourceStreamRequest& request, std::function<void(std::shared_ptr<Resource>)> callback);
 
 	private:
 		Resources& parent;
-		HashMap<String, Wrapper> resources;
+		FlatHashMap<uint64_t, Wrapper> resources; // By StringId::hash of the asset id, which saves comparing strings on lookup
 		AssetType type;
 		ResourceLoaderFunc resourceLoader;
+		size_t memoryBudget = 0;
+		size_t residentBytes = 0;
+		bool destroyOnMainThread; // If it might release video objects
+
+		std::shared_ptr<Resource> doGet(uint64_t key, StringView name, ResourceLoadPriority priority);
+		void addResource(const String& assetId, std::shared_ptr<Resource> resource, int depth);
+		void unload(uint64_t key);
+		void onResourceRemoved(Wrapper& wrapper);
 	};
 
 	template <typename T>
@@ -75,14 +140,67 @@ namespace Halley
 			: ResourceCollectionBase(parent, type)
 		{}
 
-		std::shared_ptr<const T> get(const String& assetId, ResourceLoadPriority priority = ResourceLoadPriority::Normal)
+		// Only makes a String of the id if it isn't loaded yet, so lookups by a view into something else don't allocate
+		std::shared_ptr<const T> get(StringView assetId, ResourceLoadPriority priority = ResourceLoadPriority::Normal)
 		{
 			return std::static_pointer_cast<T>(doGet(assetId, priority));
 		}
 
+		std::shared_ptr<const T> get(const StringId& assetId, ResourceLoadPriority priority = ResourceLoadPriority::Normal)
+		{
+			return std::static_pointer_cast<T>(doGet(assetId, priority));
+		}
+
+		// Fetches the data in the background; the resource itself is constructed by Resources::update() or on the first get()
+		ResourceHandle<T> getAsync(const String& assetId, ResourceLoadPriority priority = ResourceLoadPriority::Normal, Time deadline = 0)
+		{
+			std::shared_ptr<ResourceStreamRequest> request;
+			auto res = doGetAsync(assetId, priority, deadline, request);
+			if (res) {
+				return ResourceHandle<T>(std::static_pointer_cast<const T>(res));
+			}
+			return ResourceHandle<T>(std::move(request), [this] (ResourceStreamRequest& req) { return finishStreaming(req); });
+		}
+
+		// Like getAsync(), for chaining with Future::then/thenAsync. It resolves once the resource is constructed, on the main thread,
+		// by Resources::update() or a get(), to nullptr if it failed to load. Must be called from the main thread.
+		Future<std::shared_ptr<const T>> getFuture(const String& assetId, ResourceLoadPriority priority = ResourceLoadPriority::Normal, Time deadline = 0)
+		{
+			Promise<std::shared_ptr<const T>> promise;
+			auto future = promise.getFuture();
+
+			std::shared_ptr<ResourceStreamRequest> request;
+			auto res = doGetAsync(assetId, priority, deadline, request);
+			if (res) {
+				promise.setValue(std::static_pointer_cast<const T>(res));
+			} else {
+				onStreamed(*request, [promise] (std::shared_ptr<Resource> r) mutable
+				{
+					promise.setValue(std::static_pointer_cast<const T>(r));
+				});
+			}
+			return future;
+		}
+
 	protected:
 		std::shared_ptr<Resource> loadResource(ResourceLoader& loader) override {
 			return T::loadResource(loader);
 		}
 	};
+
+	template <typename T>
+	bool ResourceHandle<T>::isReady() const
+	{
+		return resource || (request && request->isDone());
+	}
+
+	template <typename T>
+	std::shared_ptr<const T> ResourceHandle<T>::get() const
+	{
+		if (!resource && request) {
+			resource = std::static_pointer_cast<const T>(finish(*request));
+			request.reset();
+		}
+		return resource;
+	}
 }
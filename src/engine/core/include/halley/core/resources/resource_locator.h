@@ -25,14 +25,14 @@
 #include <halley/text/halleystring.h>
 #include <halley/resources/resource_data.h>
 #include <halley/data_structures/hash_map.h>
+#include <halley/data_structures/tree_map.h>
 #include <halley/data_structures/vector.h>
+#include "asset_database.h"
 
 namespace Halley {
 	enum class AssetType;
 	class ResourceData;
 	class SystemAPI;
-	class AssetDatabase;
-
 	class IResourceLocatorProvider {
 	public:
 		virtual ~IResourceLocatorProvider() {}
@@ -42,15 +42,26 @@ namespace Halley {
 		virtual void purge(SystemAPI& system) = 0;
 	};
 
+	// Finds which provider each asset comes from through an index of every provider's assets, by type and name, built as they're added.
+	// Where several have an asset, the one with the highest priority wins (the first added, between equals), and the others are kept
+	// in line for it, so removing a provider (e.g. unmounting a DLC pack) only touches the assets it had.
 	class ResourceLocator : public IResourceLocator
 	{
 	public:
 		explicit ResourceLocator(SystemAPI& system);
 		void add(std::unique_ptr<IResourceLocatorProvider> locator);
 		void addFileSystem(const Path& path);
-		void addPack(const Path& path, const String& encryptionKey = "", bool preLoad = false, bool allowFailure = false);
+		// memoryMap maps the pack instead of reading it, where the platform allows it; preLoad is then ignored
+		void addPack(const Path& path, const String& encryptionKey = "", bool preLoad = false, bool allowFailure = false, bool memoryMap = false);
+
+		// Resources already loaded from them stay loaded, but anything still streaming from them must be done first
+		void remove(const IResourceLocatorProvider& locator);
+		bool removePack(const Path& path); // False if no pack was added from path
 		
 		const Metadata& getMetaData(const String& resource, AssetType type) const override;
+		// Assets the importer recorded as loaded along with this one; empty if it has none or isn't found
+		const std::vector<std::pair<AssetType, String>>& getDependencies(const String& resource, AssetType type) const;
+		bool exists(const String& asset, AssetType type) const;
 
 		std::unique_ptr<ResourceDataStatic> getStatic(const String& asset, AssetType type) override;
 		std::unique_ptr<ResourceDataStream> getStream(const String& asset, AssetType type) override;
@@ -60,10 +71,19 @@ namespace Halley {
 		bool exists(const String& asset);
 
 	private:
+		using Candidates = Vector<IResourceLocatorProvider*>; // Winner first
+
 		SystemAPI& system;
-		HashMap<String, IResourceLocatorProvider*> locators;
+		TreeMap<int, HashMap<String, Candidates>> assetIndex; // By type, then name
 		Vector<std::unique_ptr<IResourceLocatorProvider>> locatorList;
+		HashMap<String, IResourceLocatorProvider*> packs; // By path
 
 		std::unique_ptr<ResourceData> getResource(const String& asset, AssetType type, bool stream);
+		IResourceLocatorProvider* findProvider(const String& asset, AssetType type) const;
+		const AssetDatabase::Entry* findEntry(const String& asset, AssetType type) const;
+
+		void addToIndex(IResourceLocatorProvider& locator);
+		void removeFromIndex(IResourceLocatorProvider& locator);
+		void purge(IResourceLocatorProvider& locator);
 	};
 }
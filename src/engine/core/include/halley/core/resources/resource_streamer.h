@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <halley/text/halleystring.h>
+#include <halley/resources/resource_data.h>
+#include <halley/data_structures/hash_map.h>
+#include <halley/data_structures/vector.h>
+#include <halley/time/halleytime.h>
+
+namespace Halley
+{
+	enum class AssetType;
+	class Resource;
+	class ResourceCollectionBase;
+
+	// The shared state of one asynchronous load
+	class ResourceStreamRequest
+	{
+		friend class ResourceStreamer;
+		friend class ResourceCollectionBase;
+		friend class Resources;
+		friend class ResourcePrefetch;
+
+	public:
+		enum class State
+		{
+			Queued,   // Waiting for a disk worker
+			Fetching, // Being read and decompressed
+			Fetched,  // Data is ready, waiting to be constructed on the main thread
+			Done
+		};
+
+		ResourceStreamRequest(ResourceCollectionBase& collection, AssetType type, const String& assetId, ResourceLoadPriority priority, std::chrono::steady_clock::time_point deadline, uint64_t sequence, bool prefetch);
+
+		const String& getAssetId() const { return assetId; }
+		AssetType getAssetType() const { return type; }
+		State getState() const { return state.load(std::memory_order_acquire); }
+		bool isDone() const { return getState() == State::Done; }
+
+	private:
+		ResourceCollectionBase& collection;
+		const AssetType type;
+		const String assetId;
+		ResourceLoadPriority priority;
+		std::chrono::steady_clock::time_point deadline;
+		const uint64_t sequence;
+		const bool prefetch;
+
+		std::atomic<State> state;
+		std::unique_ptr<ResourceDataStatic> data;
+		size_t dataSize = 0;
+		std::exception_ptr error;
+		std::shared_ptr<Resource> result;
+		Vector<std::function<void(std::shared_ptr<Resource>)>> onDone; // Only touched on the main thread
+	};
+
+	// Reads and decompresses resource data on Executors::getDiskIO(), in order of priority and then deadline.
+	// Requests for the same asset are merged, and reading pauses while more than the memory budget is waiting to be constructed.
+	class ResourceStreamer
+	{
+	public:
+		explicit ResourceStreamer(IResourceLocator& locator);
+		~ResourceStreamer();
+
+		// Returns the request already in flight for this asset, if any (raising its priority/deadline if needed)
+		std::shared_ptr<ResourceStreamRequest> request(ResourceCollectionBase& collection, AssetType type, const String& assetId, ResourceLoadPriority priority, Time deadline, bool prefetch);
+		std::shared_ptr<ResourceStreamRequest> find(AssetType type, const String& assetId) const;
+
+		// Fetches on the calling thread if no worker got to it yet, otherwise waits for the worker
+		void waitForFetch(ResourceStreamRequest& request);
+		// Fetched requests, most urgent first
+		Vector<std::shared_ptr<ResourceStreamRequest>> getFetched() const;
+		// Called once the resource has been constructed (or failed to)
+		void complete(ResourceStreamRequest& request);
+
+		void setMemoryBudget(size_t bytes);
+		void setMaxConcurrentFetches(size_t n);
+		size_t getBytesStaged() const;
+		size_t getNumInFlight() const;
+
+	private:
+		IResourceLocator& locator;
+
+		mutable std::mutex mutex;
+		std::condition_variable fetchDone;
+
+		Vector<std::shared_ptr<ResourceStreamRequest>> queue; // Heap, most urgent at the front
+		Vector<std::shared_ptr<ResourceStreamRequest>> fetched;
+		HashMap<String, std::shared_ptr<ResourceStreamRequest>> inFlight;
+
+		uint64_t nextSequence = 0;
+		size_t memoryBudget = 256 * 1024 * 1024;
+		size_t bytesStaged = 0;
+		size_t maxWorkers = 2;
+		size_t activeWorkers = 0;
+		bool stopping = false;
+
+		static String makeKey(AssetType type, const String& assetId);
+		static bool isLessUrgent(const std::shared_ptr<ResourceStreamRequest>& a, const std::shared_ptr<ResourceStreamRequest>& b);
+
+		size_t reserveWorkers();
+		void startWorkers(size_t n);
+		void runWorker();
+		void fetch(ResourceStreamRequest& request);
+		void onFetched(const std::shared_ptr<ResourceStreamRequest>& request);
+	};
+}
@@ -23,17 +23,54 @@
 
 #include <ctime>
 #include <algorithm>
+#include <set>
 #include <halley/support/exception.h>
+#include <halley/support/telemetry.h>
 #include "halley/resources/resource.h"
 #include "resource_collection.h"
+#include "resource_streamer.h"
 #include "halley/text/string_converter.h"
+#include "halley/concurrency/deferred_destructor.h"
 
 namespace Halley {
 	
 	class ResourceLocator;
 	class HalleyAPI;
+	class Path;
+
+	// A group of resources being loaded by Resources::prefetch.
+	// Once isDone(), get() can be called from any thread, as it only looks at what this already holds.
+	class ResourcePrefetch
+	{
+		friend class Resources;
+
+	public:
+		bool isDone() const;
+		float getProgress() const;
+		size_t size() const { return entries.size(); }
+
+		// nullptr if it wasn't part of the prefetch or failed to load
+		template <typename T>
+		std::shared_ptr<const T> get(const String& assetId) const
+		{
+			return std::static_pointer_cast<const T>(getResource(T::getAssetType(), assetId));
+		}
+
+	private:
+		struct Entry
+		{
+			AssetType type;
+			String assetId;
+			std::shared_ptr<Resource> resource; // If it was already loaded
+			std::shared_ptr<ResourceStreamRequest> request;
+		};
+
+		Vector<Entry> entries;
+
+		std::shared_ptr<Resource> getResource(AssetType type, const String& assetId) const;
+	};
 	
-	class Resources {
+	class Resources : public ITelemetrySource {
 		friend class ResourceCollectionBase;
 
 	public:
@@ -57,15 +94,67 @@ namespace Halley {
 
 		ResourceCollectionBase& ofType(AssetType assetType) const
 		{
-			return *resources[int(assetType)];
+			const auto id = size_t(assetType);
+			if (id >= resources.size() || !resources[id]) {
+				throwTypeNotInitialized(assetType);
+			}
+			return *resources[id];
+		}
+
+		template <typename T>
+		std::shared_ptr<const T> get(StringView name, ResourceLoadPriority priority = ResourceLoadPriority::Normal) const
+		{
+			return of<T>().get(name, priority);
 		}
 
+		// Skips hashing the name; worth it for lookups made every frame
 		template <typename T>
-		std::shared_ptr<const T> get(const String& name, ResourceLoadPriority priority = ResourceLoadPriority::Normal) const
+		std::shared_ptr<const T> get(const StringId& name, ResourceLoadPriority priority = ResourceLoadPriority::Normal) const
 		{
 			return of<T>().get(name, priority);
 		}
 
+		template <typename T>
+		ResourceHandle<T> getAsync(const String& name, ResourceLoadPriority priority = ResourceLoadPriority::Normal, Time deadline = 0) const
+		{
+			return of<T>().getAsync(name, priority, deadline);
+		}
+
+		template <typename T>
+		Future<std::shared_ptr<const T>> getFuture(const String& name, ResourceLoadPriority priority = ResourceLoadPriority::Normal, Time deadline = 0) const
+		{
+			return of<T>().getFuture(name, priority, deadline);
+		}
+
+		// Starts loading these assets and everything they depend on, as recorded in the asset database at import time.
+		// All the data is read in parallel; dependencies are requested first, so they're constructed before whatever uses them.
+		ResourcePrefetch prefetch(const Vector<std::pair<AssetType, String>>& assets, ResourceLoadPriority priority = ResourceLoadPriority::Normal, Time deadline = 0);
+
+		// Constructs streamed resources whose data has arrived, most urgent first, for up to maxTime seconds.
+		// Also destroys some of what's been unloaded, for up to the destruction budget.
+		void update(Time maxTime);
+
+		// Unloaded resources aren't destroyed right away, but by update(): those that can't hold on to video objects (or observers) on a worker,
+		// and the rest a few at a time, within this many seconds per update
+		void setDestructionBudget(Time maxTime);
+		DeferredDestructor& getDeferredDestructor() { return destructor; }
+
+		ResourceStreamer& getStreamer() const { return *streamer; }
+
+		// Unreferenced resources of this type are evicted, least recently used first, once more than bytes are resident. 0 disables it.
+		void setMemoryBudget(AssetType type, size_t bytes);
+		size_t getResidentBytes(AssetType type) const;
+		size_t getResidentBytes() const;
+
+		void getTelemetry(std::vector<TelemetryValue>& values) const override; // Resident count and bytes of each type
+
+		// Records the assets asked for from now on, each once, in the order they're first asked for (e.g. while a level loads).
+		// Saved as text with one "type:name" per line in the project's access_traces folder, the asset packer lays packs out in that order.
+		void startAccessTrace();
+		Vector<String> stopAccessTrace();
+		void stopAccessTrace(const Path& path);
+		bool isTracingAccesses() const { return accessTrace != nullptr; }
+
 		template <typename T>
 		void unload(const String& name) const
 		{
@@ -91,8 +180,23 @@ namespace Halley {
 		}
 		
 	private:
+		struct AccessTrace
+		{
+			Vector<String> order;
+			std::set<std::pair<AssetType, String>> seen;
+		};
+
 		const std::unique_ptr<ResourceLocator> locator;
 		Vector<std::unique_ptr<ResourceCollectionBase>> resources;
 		const HalleyAPI* const api;
+		uint64_t curFrame = 0;
+		std::unique_ptr<AccessTrace> accessTrace;
+		DeferredDestructor destructor;
+		Time destructionBudget = 0.001;
+		std::unique_ptr<ResourceStreamer> streamer; // Declared last, so in-flight fetches stop before anything they reference goes away
+
+		void addToPrefetch(AssetType type, const String& assetId, ResourceLoadPriority priority, Time deadline, std::set<std::pair<AssetType, String>>& visited, ResourcePrefetch& result);
+		void recordAccess(AssetType type, StringView assetId);
+		[[noreturn]] void throwTypeNotInitialized(AssetType type) const;
 	};
 }
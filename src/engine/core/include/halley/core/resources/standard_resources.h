@@ -7,6 +7,6 @@ namespace Halley
 	class StandardResources
 	{
 	public:
-		static void initialize(Resources& resources);
+		static void initialize(Resources& resources, bool dataOnly = false); // dataOnly for dedicated servers, which can't load anything that needs video or audio
 	};
 }
\ No newline at end of file
@@ -4,10 +4,18 @@
 namespace Halley
 {
 	class System;
+	class ConfigFile;
 
 	class EntityStage : public Stage
 	{
 	public:
 		std::unique_ptr<World> createWorld(String configName, std::function<std::unique_ptr<System>(String)> createFunction);
+
+		// Doesn't touch Resources, so it can be used from loadAsync(), with a config from getPreloadAssets()
+		std::unique_ptr<World> createWorld(const ConfigFile& config, std::function<std::unique_ptr<System>(String)> createFunction);
+
+		// Tears the world down over the next few frames, within Resources' destruction budget, instead of all at once as the stage goes.
+		// Call it from the stage's destructor with its world; the next stage starts meanwhile.
+		void destroyWorldDeferred(std::unique_ptr<World> world);
 	};
 }
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <halley/data_structures/hash_map.h>
+#include <halley/data_structures/vector.h>
+#include <halley/text/halleystring.h>
+#include <halley/utils/utils.h>
+
+namespace Halley
+{
+	class World;
+
+	// What a stage keeps across hot reloading the game's code (see Stage::onSaveReloadState())
+	class HotReloadState
+	{
+	public:
+		// Kept as a snapshot (see World::saveSnapshot()), which is raw component memory, so it's only loaded back if no component
+		// that was saved changed size; that won't catch members being reordered, or changing type to one of the same size.
+		void saveWorld(const String& key, World& world);
+		bool loadWorld(const String& key, World& world) const; // False if it wasn't saved, or couldn't be loaded
+
+		void setData(const String& key, Bytes data);
+		const Bytes* getData(const String& key) const;
+
+	private:
+		struct SavedWorld
+		{
+			Bytes snapshot;
+			Vector<size_t> componentSizes; // By component index, 0 for unknown types
+		};
+
+		HashMap<String, SavedWorld> worlds;
+		HashMap<String, Bytes> data;
+	};
+}
@@ -13,6 +13,7 @@ namespace Halley
 	class VideoAPI;
 	class CoreAPI;
 	class Game;
+	class HotReloadState;
 
 	class Stage
 	{
@@ -22,9 +23,23 @@ namespace Halley
 		virtual void onFixedUpdate(Time) {}
 		virtual void onVariableUpdate(Time) {}
 		virtual void onRender(RenderContext&) const {}
+		virtual void onServerPoll() {} // Dedicated servers only, between frames; e.g. to update network sessions
 
 		virtual void init() {}
 
+		// Used when preloaded with CoreAPI::preloadStage: these assets and their dependencies are loaded first, then loadAsync()
+		// runs on a worker thread while the current stage keeps going, and init() runs on the main thread once it's switched to.
+		// loadAsync() must not use the video API or Resources; it gets what it needs from the preloaded assets.
+		virtual Vector<std::pair<AssetType, String>> getPreloadAssets() const { return {}; }
+		virtual void loadAsync(const ResourcePrefetch& preloaded) {}
+
+		// Hot reloading (see halley-runner) swaps the game's code under its live objects, which go wrong if their layout changed.
+		// Before the old code is unloaded, the stage saves whatever it wants to keep. If makeReloadedStage() then returns a new stage,
+		// that one replaces it, and gets the state back once it's initialised.
+		virtual void onSaveReloadState(HotReloadState&) {}
+		virtual std::unique_ptr<Stage> makeReloadedStage() { return {}; }
+		virtual void onLoadReloadState(const HotReloadState&) {}
+
 		const HalleyAPI& getAPI() const { return *api; }
 
 	protected:
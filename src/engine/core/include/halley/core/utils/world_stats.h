@@ -1,5 +1,7 @@
 #pragma once
 #include "halley/core/graphics/text/text_renderer.h"
+#include "halley/maths/rolling_stats.h"
+#include "halley/time/halleytime.h"
 #include <cstdint>
 
 namespace Halley
@@ -17,11 +19,31 @@ namespace Halley
 		void draw(RenderContext& context);
 		void setWorld(const World* world);
 
+		// When a frame takes longer than budget (in seconds, 0 to disable), its breakdown is logged and the view
+		// freezes on it until clearSpike() is called
+		void setSpikeTrigger(Time budget);
+		bool hasSpike() const;
+		void clearSpike();
+
 	private:
 		String formatTime(int64_t ns) const;
 
+		void updateTracking();
+		void checkSpike();
+		String describeFrame(int64_t frameNs) const;
+
+		constexpr static int armDelayFrames = 60; // The first few frames are always slow, from loading
+		constexpr static size_t maxFamiliesListed = 6;
+
 		const CoreAPI& coreAPI;
 		const World* world = nullptr;
 		TextRenderer text;
+
+		RollingStats entityCount;
+		Vector<size_t> familyPeaks;
+
+		int64_t spikeBudgetNs = 0;
+		int framesUntilArmed = armDelayFrames;
+		String spikeReport;
 	};
 }
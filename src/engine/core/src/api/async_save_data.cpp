@@ -0,0 +1,231 @@
+#include "api/async_save_data.h"
+#include "halley/concurrency/concurrent.h"
+#include "halley/bytes/compression.h"
+#include "halley/support/logger.h"
+#include <set>
+#include <cstring>
+
+using namespace Halley;
+
+namespace {
+	constexpr size_t compressedMagicSize = 8;
+	const char* compressedMagic = "HLLYZSV1";
+}
+
+AsyncSaveData::AsyncSaveData(std::shared_ptr<ISaveData> saveData, bool compress)
+	: saveData(std::move(saveData))
+	, compress(compress)
+{
+	Expects(this->saveData);
+
+	Promise<bool> done;
+	done.setValue(true);
+	lastCommit = done.getFuture();
+}
+
+AsyncSaveData::~AsyncSaveData()
+{
+	// Nothing written is lost, this just stops blocking the caller until now
+	commitAsync();
+	waitForCommits();
+
+	// Reads made by getDataAsync() can be queued after the last commit, but not after this
+	Concurrent::execute(Executors::getDiskIO(), [] () {}).wait();
+}
+
+bool AsyncSaveData::isReady() const
+{
+	return saveData->isReady();
+}
+
+Bytes AsyncSaveData::getData(const String& path)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		const auto iter = unwritten.find(path);
+		if (iter != unwritten.end()) {
+			return iter->second.data ? iter->second.data->toBytes() : Bytes();
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(saveDataMutex);
+	return unpack(saveData->getData(path));
+}
+
+Future<Bytes> AsyncSaveData::getDataAsync(const String& path)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	const auto iter = unwritten.find(path);
+	if (iter != unwritten.end()) {
+		Promise<Bytes> result;
+		result.setValue(iter->second.data ? iter->second.data->toBytes() : Bytes());
+		return result.getFuture();
+	}
+
+	// Queued after any commits, so if it was written since, it's on disk by the time this reads it
+	auto result = Concurrent::execute(Executors::getDiskIO(), [this, path] () -> Bytes
+	{
+		std::unique_lock<std::mutex> saveDataLock(saveDataMutex);
+		return unpack(saveData->getData(path));
+	});
+	return result;
+}
+
+void AsyncSaveData::removeData(const String& path)
+{
+	Expects(!path.isEmpty());
+	addWrite(path, {});
+}
+
+std::vector<String> AsyncSaveData::enumerate(const String& root)
+{
+	std::set<String> names;
+	{
+		std::unique_lock<std::mutex> lock(saveDataMutex);
+		for (auto& name: saveData->enumerate(root)) {
+			names.insert(name);
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(mutex);
+	for (auto& w: unwritten) {
+		if (w.first.startsWith(root)) {
+			if (w.second.data) {
+				names.insert(w.first);
+			} else {
+				names.erase(w.first);
+			}
+		}
+	}
+	return std::vector<String>(names.begin(), names.end());
+}
+
+void AsyncSaveData::setData(const String& path, const Bytes& data, bool commit)
+{
+	Expects(!path.isEmpty());
+	addWrite(path, std::make_shared<const SerializedChunks>(Bytes(data)));
+	if (commit) {
+		commitAsync();
+	}
+}
+
+void AsyncSaveData::setSerializedData(const String& path, const SerializedChunks& data, bool commit)
+{
+	Expects(!path.isEmpty());
+	addWrite(path, std::make_shared<const SerializedChunks>(data));
+	if (commit) {
+		commitAsync();
+	}
+}
+
+void AsyncSaveData::commit()
+{
+	commitAsync();
+}
+
+size_t AsyncSaveData::getFreeSpace()
+{
+	std::unique_lock<std::mutex> lock(saveDataMutex);
+	return saveData->getFreeSpace();
+}
+
+Future<bool> AsyncSaveData::commitAsync()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	if (pending.empty()) {
+		return lastCommit;
+	}
+
+	auto batch = std::make_shared<Batch>(pending.begin(), pending.end());
+	pending.clear();
+
+	// The disk IO queue runs one job at a time, in order, so batches can't overtake each other
+	lastCommit = Concurrent::execute(Executors::getDiskIO(), [this, batch] () -> bool
+	{
+		return writeBatch(*batch);
+	});
+	return lastCommit;
+}
+
+bool AsyncSaveData::isCommitting() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return !lastCommit.isReady();
+}
+
+void AsyncSaveData::waitForCommits()
+{
+	Future<bool> commit;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		commit = lastCommit;
+	}
+	commit.wait();
+}
+
+void AsyncSaveData::addWrite(const String& path, std::shared_ptr<const SerializedChunks> data)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	const Write write{ std::move(data), nextVersion++ };
+	pending[path] = write;
+	unwritten[path] = write;
+}
+
+bool AsyncSaveData::writeBatch(const Batch& batch)
+{
+	bool ok = true;
+	{
+		std::unique_lock<std::mutex> lock(saveDataMutex);
+		for (auto& w: batch) {
+			try {
+				if (w.second.data) {
+					if (compress) {
+						saveData->setData(w.first, pack(*w.second.data), false);
+					} else {
+						saveData->setSerializedData(w.first, *w.second.data, false);
+					}
+				} else {
+					saveData->removeData(w.first);
+				}
+			} catch (std::exception& e) {
+				Logger::logError("Unable to save \"" + w.first + "\": " + e.what());
+				ok = false;
+			}
+		}
+
+		try {
+			saveData->commit();
+		} catch (std::exception& e) {
+			Logger::logError("Unable to commit save data: " + String(e.what()));
+			ok = false;
+		}
+	}
+
+	// Reads can go to the container now, unless the path was written to again in the meantime
+	std::unique_lock<std::mutex> lock(mutex);
+	for (auto& w: batch) {
+		const auto iter = unwritten.find(w.first);
+		if (iter != unwritten.end() && iter->second.version == w.second.version) {
+			unwritten.erase(iter);
+		}
+	}
+	return ok;
+}
+
+Bytes AsyncSaveData::pack(const SerializedChunks& data)
+{
+	auto compressed = Compression::compress(data);
+	Bytes result(compressedMagicSize + compressed.size());
+	memcpy(result.data(), compressedMagic, compressedMagicSize);
+	memcpy(result.data() + compressedMagicSize, compressed.data(), compressed.size());
+	return result;
+}
+
+Bytes AsyncSaveData::unpack(Bytes data)
+{
+	// Checked even when not compressing, so saves written with compression on can still be read
+	if (data.size() >= compressedMagicSize && memcmp(data.data(), compressedMagic, compressedMagicSize) == 0) {
+		return Compression::decompress(gsl::as_bytes(gsl::span<const Byte>(data)).subspan(compressedMagicSize));
+	}
+	return data;
+}
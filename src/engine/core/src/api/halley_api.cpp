@@ -2,9 +2,30 @@
 #include "api/halley_api.h"
 #include <halley/plugin/plugin.h>
 #include "halley/audio/audio_facade.h"
+#include <halley/support/profiler.h>
+#include "halley/net/connection/network_service.h"
+#include "graphics/painter.h"
 
 using namespace Halley;
 
+namespace {
+	struct APIInit
+	{
+		const char* name;
+		HalleyAPIInternal* api;
+		HalleyAPIInternal* dependent; // Initialized right after api, on the same thread
+	};
+
+	void initAPI(const APIInit& init)
+	{
+		HALLEY_PROFILE_SCOPE(init.name);
+		init.api->init();
+		if (init.dependent) {
+			init.dependent->init();
+		}
+	}
+}
+
 HalleyAPI::~HalleyAPI()
 {
 	deInit();
@@ -42,33 +63,68 @@ void HalleyAPI::assign()
 void HalleyAPI::init()
 {
 	if (systemInternal) {
+		HALLEY_PROFILE_SCOPE("SystemAPI::init");
 		systemInternal->init();
 	}
-	if (videoInternal) {
-		videoInternal->init();
-	}
-	if (inputInternal) {
-		inputInternal->init();
-	}
-	if (audioOutputInternal) {
-		audioOutputInternal->init();
+
+	// Everything else only depends on the system API. Those that allow it are initialized on a worker thread, in order,
+	// while the rest are initialized here and Core goes on to load resources, until it calls waitForInit().
+	const APIInit inits[] = {
+		{ "VideoAPI::init", videoInternal.get(), nullptr },
+		{ "InputAPI::init", inputInternal.get(), nullptr },
+		{ "AudioAPI::init", audioOutputInternal.get(), audioInternal.get() }, // The facade lists the output's devices
+		{ "PlatformAPI::init", platformInternal.get(), nullptr },
+		{ "NetworkAPI::init", networkInternal.get(), nullptr },
+		{ "MovieAPI::init", movieInternal.get(), nullptr }
+	};
+
+	std::vector<APIInit> background;
+	for (auto& init: inits) {
+		if (init.api && init.api->canInitInBackground()) {
+			background.push_back(init);
+		}
 	}
-	if (audioInternal) {
-		audioInternal->init();
+	if (!background.empty()) {
+		backgroundInit = std::thread([this, background] ()
+		{
+			Profiler::setThreadName("API init");
+			try {
+				for (auto& init: background) {
+					initAPI(init);
+				}
+			} catch (...) {
+				backgroundInitError = std::current_exception();
+			}
+		});
 	}
-	if (platformInternal) {
-		platformInternal->init();
+
+	for (auto& init: inits) {
+		if (init.api && !init.api->canInitInBackground()) {
+			initAPI(init);
+		}
 	}
-	if (networkInternal) {
-		networkInternal->init();
+}
+
+void HalleyAPI::waitForInit()
+{
+	if (backgroundInit.joinable()) {
+		HALLEY_PROFILE_SCOPE("HalleyAPI::waitForInit");
+		backgroundInit.join();
 	}
-	if (movieInternal) {
-		movieInternal->init();
+	if (backgroundInitError) {
+		auto error = backgroundInitError;
+		backgroundInitError = nullptr;
+		std::rethrow_exception(error);
 	}
 }
 
 void HalleyAPI::deInit()
 {
+	// If startup failed before waiting for it
+	if (backgroundInit.joinable()) {
+		backgroundInit.join();
+	}
+
 	if (movieInternal) {
 		movieInternal->deInit();
 	}
@@ -176,3 +232,13 @@ std::unique_ptr<HalleyAPI> HalleyAPI::create(CoreAPIInternal* core, int flags)
 	api->assign();
 	return api;
 }
+
+std::unique_ptr<Painter> VideoAPIInternal::makeDeferredPainter(Resources& resources)
+{
+	return {};
+}
+
+std::unique_ptr<NetworkService> NetworkAPI::createHighFanInService(NetworkProtocol protocol, int port, size_t numSockets)
+{
+	return createService(protocol, port);
+}
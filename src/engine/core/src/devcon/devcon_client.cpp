@@ -40,10 +40,32 @@ void DevConClient::update()
 			onReceiveReloadAssets(dynamic_cast<DevCon::ReloadAssetsMsg&>(msg));
 			break;
 
+		case DevCon::MessageType::SetProfiler:
+			onReceiveSetProfiler(dynamic_cast<DevCon::SetProfilerMsg&>(msg));
+			break;
+
+		case DevCon::MessageType::SetNetworkStats:
+			onReceiveSetNetworkStats(dynamic_cast<DevCon::SetNetworkStatsMsg&>(msg));
+			break;
+
+		case DevCon::MessageType::SetTelemetry:
+			onReceiveSetTelemetry(dynamic_cast<DevCon::SetTelemetryMsg&>(msg));
+			break;
+
 		default:
 			break;
 		}
 	}
+
+	if (streamingProfiler) {
+		sendProfilerCapture();
+	}
+	if (streamingNetworkStats) {
+		sendNetworkStats();
+	}
+	if (streamingTelemetry) {
+		sendTelemetry();
+	}
 }
 
 void DevConClient::onReceiveReloadAssets(const DevCon::ReloadAssetsMsg& msg)
@@ -88,6 +110,61 @@ void DevConClient::onReceiveReloadAssets(const DevCon::ReloadAssetsMsg& msg)
 	}
 }
 
+void DevConClient::onReceiveSetProfiler(const DevCon::SetProfilerMsg& msg)
+{
+	streamingProfiler = msg.isEnabled();
+	Profiler::setEnabled(streamingProfiler);
+	if (streamingProfiler) {
+		// Only stream what happens from now on
+		Profiler::capture(profilerCursor);
+	}
+}
+
+void DevConClient::sendProfilerCapture()
+{
+	if (queue->isConnected()) {
+		auto capture = Profiler::capture(profilerCursor);
+		if (!capture.empty()) {
+			queue->enqueue(std::make_unique<DevCon::ProfilerCaptureMsg>(std::move(capture)), 0);
+			queue->sendAll();
+		}
+	}
+}
+
+void DevConClient::onReceiveSetNetworkStats(const DevCon::SetNetworkStatsMsg& msg)
+{
+	streamingNetworkStats = msg.isEnabled();
+	lastNetworkStatsSent = {};
+}
+
+void DevConClient::sendNetworkStats()
+{
+	// They're cumulative counters, so there's no point in sending them every frame
+	const auto now = std::chrono::steady_clock::now();
+	if (queue->isConnected() && now - lastNetworkStatsSent > std::chrono::milliseconds(500)) {
+		lastNetworkStatsSent = now;
+		queue->enqueue(std::make_unique<DevCon::NetworkStatsMsg>(NetworkStats::capture()), 0);
+		queue->sendAll();
+	}
+}
+
+void DevConClient::onReceiveSetTelemetry(const DevCon::SetTelemetryMsg& msg)
+{
+	streamingTelemetry = msg.isEnabled();
+	lastTelemetrySent = {};
+}
+
+void DevConClient::sendTelemetry()
+{
+	// Timings are already averaged over several frames, so a few samples a second is plenty for graphing
+	const auto now = std::chrono::steady_clock::now();
+	if (queue->isConnected() && now - lastTelemetrySent > std::chrono::milliseconds(100)) {
+		lastTelemetrySent = now;
+		queue->enqueue(std::make_unique<DevCon::TelemetryMsg>(Telemetry::capture()), 0);
+		queue->sendAll();
+	}
+}
+
 void DevConClient::connect()
 {
 	queue = std::make_shared<MessageQueueTCP>(service->connect(address, port));
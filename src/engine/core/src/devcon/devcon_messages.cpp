@@ -12,6 +12,12 @@ void DevCon::setupMessageQueue(MessageQueue& queue)
 
 	queue.addFactory<LogMsg>();
 	queue.addFactory<ReloadAssetsMsg>();
+	queue.addFactory<SetProfilerMsg>();
+	queue.addFactory<ProfilerCaptureMsg>();
+	queue.addFactory<SetNetworkStatsMsg>();
+	queue.addFactory<NetworkStatsMsg>();
+	queue.addFactory<SetTelemetryMsg>();
+	queue.addFactory<TelemetryMsg>();
 }
 
 LogMsg::LogMsg(gsl::span<const gsl::byte> data)
@@ -72,3 +78,159 @@ MessageType ReloadAssetsMsg::getMessageType() const
 {
 	return MessageType::ReloadAssets;
 }
+
+
+SetProfilerMsg::SetProfilerMsg(gsl::span<const gsl::byte> data)
+{
+	Deserializer s(data);
+	s >> enabled;
+}
+
+SetProfilerMsg::SetProfilerMsg(bool enabled)
+	: enabled(enabled)
+{}
+
+void SetProfilerMsg::serialize(Serializer& s) const
+{
+	s << enabled;
+}
+
+bool SetProfilerMsg::isEnabled() const
+{
+	return enabled;
+}
+
+MessageType SetProfilerMsg::getMessageType() const
+{
+	return MessageType::SetProfiler;
+}
+
+
+ProfilerCaptureMsg::ProfilerCaptureMsg(gsl::span<const gsl::byte> data)
+{
+	Deserializer s(data);
+	s >> capture;
+}
+
+ProfilerCaptureMsg::ProfilerCaptureMsg(Halley::ProfilerCapture capture)
+	: capture(std::move(capture))
+{}
+
+void ProfilerCaptureMsg::serialize(Serializer& s) const
+{
+	s << capture;
+}
+
+const Halley::ProfilerCapture& ProfilerCaptureMsg::getCapture() const
+{
+	return capture;
+}
+
+MessageType ProfilerCaptureMsg::getMessageType() const
+{
+	return MessageType::ProfilerCapture;
+}
+
+
+SetNetworkStatsMsg::SetNetworkStatsMsg(gsl::span<const gsl::byte> data)
+{
+	Deserializer s(data);
+	s >> enabled;
+}
+
+SetNetworkStatsMsg::SetNetworkStatsMsg(bool enabled)
+	: enabled(enabled)
+{}
+
+void SetNetworkStatsMsg::serialize(Serializer& s) const
+{
+	s << enabled;
+}
+
+bool SetNetworkStatsMsg::isEnabled() const
+{
+	return enabled;
+}
+
+MessageType SetNetworkStatsMsg::getMessageType() const
+{
+	return MessageType::SetNetworkStats;
+}
+
+
+NetworkStatsMsg::NetworkStatsMsg(gsl::span<const gsl::byte> data)
+{
+	Deserializer s(data);
+	s >> stats;
+}
+
+NetworkStatsMsg::NetworkStatsMsg(std::vector<NetworkConnectionStats> stats)
+	: stats(std::move(stats))
+{}
+
+void NetworkStatsMsg::serialize(Serializer& s) const
+{
+	s << stats;
+}
+
+const std::vector<NetworkConnectionStats>& NetworkStatsMsg::getStats() const
+{
+	return stats;
+}
+
+MessageType NetworkStatsMsg::getMessageType() const
+{
+	return MessageType::NetworkStats;
+}
+
+
+SetTelemetryMsg::SetTelemetryMsg(gsl::span<const gsl::byte> data)
+{
+	Deserializer s(data);
+	s >> enabled;
+}
+
+SetTelemetryMsg::SetTelemetryMsg(bool enabled)
+	: enabled(enabled)
+{}
+
+void SetTelemetryMsg::serialize(Serializer& s) const
+{
+	s << enabled;
+}
+
+bool SetTelemetryMsg::isEnabled() const
+{
+	return enabled;
+}
+
+MessageType SetTelemetryMsg::getMessageType() const
+{
+	return MessageType::SetTelemetry;
+}
+
+
+TelemetryMsg::TelemetryMsg(gsl::span<const gsl::byte> data)
+{
+	Deserializer s(data);
+	s >> values;
+}
+
+TelemetryMsg::TelemetryMsg(std::vector<TelemetryValue> values)
+	: values(std::move(values))
+{}
+
+void TelemetryMsg::serialize(Serializer& s) const
+{
+	s << values;
+}
+
+const std::vector<TelemetryValue>& TelemetryMsg::getValues() const
+{
+	return values;
+}
+
+MessageType TelemetryMsg::getMessageType() const
+{
+	return MessageType::Telemetry;
+}
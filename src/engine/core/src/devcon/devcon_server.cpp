@@ -16,6 +16,8 @@ DevConServerConnection::DevConServerConnection(std::shared_ptr<IConnection> conn
 	DevCon::setupMessageQueue(*queue);
 }
 
+DevConServerConnection::~DevConServerConnection() = default;
+
 void DevConServerConnection::update()
 {
 	for (auto& m: queue->receiveAll()) {
@@ -25,6 +27,18 @@ void DevConServerConnection::update()
 			onReceiveLogMsg(dynamic_cast<DevCon::LogMsg&>(msg));
 			break;
 
+		case DevCon::MessageType::ProfilerCapture:
+			onReceiveProfilerCaptureMsg(dynamic_cast<DevCon::ProfilerCaptureMsg&>(msg));
+			break;
+
+		case DevCon::MessageType::NetworkStats:
+			onReceiveNetworkStatsMsg(dynamic_cast<DevCon::NetworkStatsMsg&>(msg));
+			break;
+
+		case DevCon::MessageType::Telemetry:
+			onReceiveTelemetryMsg(dynamic_cast<DevCon::TelemetryMsg&>(msg));
+			break;
+
 		case DevCon::MessageType::ReloadAssets:
 			// TODO;
 
@@ -40,11 +54,69 @@ void DevConServerConnection::reloadAssets(const std::vector<String>& ids)
 	queue->sendAll();
 }
 
+void DevConServerConnection::setProfilerEnabled(bool enabled)
+{
+	queue->enqueue(std::make_unique<DevCon::SetProfilerMsg>(enabled), 0);
+	queue->sendAll();
+}
+
+ProfilerCapture DevConServerConnection::takeProfilerCapture()
+{
+	ProfilerCapture result = std::move(profilerCapture);
+	profilerCapture = ProfilerCapture();
+	return result;
+}
+
+void DevConServerConnection::setNetworkStatsEnabled(bool enabled)
+{
+	queue->enqueue(std::make_unique<DevCon::SetNetworkStatsMsg>(enabled), 0);
+	queue->sendAll();
+	if (!enabled) {
+		networkStats.clear();
+	}
+}
+
+const std::vector<NetworkConnectionStats>& DevConServerConnection::getNetworkStats() const
+{
+	return networkStats;
+}
+
+void DevConServerConnection::setTelemetryEnabled(bool enabled)
+{
+	queue->enqueue(std::make_unique<DevCon::SetTelemetryMsg>(enabled), 0);
+	queue->sendAll();
+	if (!enabled) {
+		telemetry.clear();
+	}
+}
+
+std::vector<std::vector<TelemetryValue>> DevConServerConnection::takeTelemetry()
+{
+	auto result = std::move(telemetry);
+	telemetry.clear();
+	return result;
+}
+
 void DevConServerConnection::onReceiveLogMsg(const DevCon::LogMsg& msg)
 {
 	Logger::log(msg.getLevel(), "[REMOTE] " + msg.getMessage());
 }
 
+void DevConServerConnection::onReceiveProfilerCaptureMsg(const DevCon::ProfilerCaptureMsg& msg)
+{
+	profilerCapture.append(msg.getCapture());
+}
+
+void DevConServerConnection::onReceiveNetworkStatsMsg(const DevCon::NetworkStatsMsg& msg)
+{
+	networkStats = msg.getStats();
+}
+
+void DevConServerConnection::onReceiveTelemetryMsg(const DevCon::TelemetryMsg& msg)
+{
+	telemetry.push_back(msg.getValues());
+}
+
 DevConServer::DevConServer(std::unique_ptr<NetworkService> s, int port)
 	: service(std::move(s))
 {
@@ -59,6 +131,9 @@ void DevConServer::update()
 	if (newCon) {
 		Logger::logInfo("New incoming DevCon connection.");
 		connections.push_back(std::make_shared<DevConServerConnection>(newCon));
+		if (telemetryEnabled) {
+			connections.back()->setTelemetryEnabled(true);
+		}
 	}
 
 	for (auto& c: connections) {
@@ -82,3 +157,56 @@ void DevConServer::reloadAssets(std::set<String> assetIdsSet)
 	}
 	reloadAssets(std::move(assetIds));
 }
+
+void DevConServer::setProfilerEnabled(bool enabled)
+{
+	for (auto& c: connections) {
+		c->setProfilerEnabled(enabled);
+	}
+}
+
+ProfilerCapture DevConServer::takeProfilerCapture()
+{
+	ProfilerCapture result;
+	for (auto& c: connections) {
+		result.append(c->takeProfilerCapture());
+	}
+	return result;
+}
+
+void DevConServer::setNetworkStatsEnabled(bool enabled)
+{
+	for (auto& c: connections) {
+		c->setNetworkStatsEnabled(enabled);
+	}
+}
+
+std::vector<NetworkConnectionStats> DevConServer::getNetworkStats() const
+{
+	std::vector<NetworkConnectionStats> result;
+	for (auto& c: connections) {
+		auto& stats = c->getNetworkStats();
+		result.insert(result.end(), stats.begin(), stats.end());
+	}
+	return result;
+}
+
+void DevConServer::setTelemetryEnabled(bool enabled)
+{
+	telemetryEnabled = enabled;
+	for (auto& c: connections) {
+		c->setTelemetryEnabled(enabled);
+	}
+}
+
+std::vector<std::vector<TelemetryValue>> DevConServer::takeTelemetry()
+{
+	std::vector<std::vector<TelemetryValue>> result;
+	for (auto& c: connections) {
+		auto samples = c->takeTelemetry();
+		for (auto& sample: samples) {
+			result.push_back(std::move(sample));
+		}
+	}
+	return result;
+}
@@ -1,4 +1,5 @@
 #include "dummy_network.h"
+#include "api/platform_api.h"
 
 using namespace Halley;
 
@@ -10,6 +11,11 @@ std::unique_ptr<NetworkService> DummyNetworkAPI::createService(NetworkProtocol p
 	return std::make_unique<DummyNetworkService>();
 }
 
+std::unique_ptr<HTTPRequest> DummyNetworkAPI::makeHTTPRequest(const String& method, const String& url)
+{
+	return {};
+}
+
 void DummyNetworkService::update()
 {	
 }
@@ -10,6 +10,7 @@ namespace Halley {
 		void deInit() override;
 
 		std::unique_ptr<NetworkService> createService(NetworkProtocol protocol, int port) override;
+		std::unique_ptr<HTTPRequest> makeHTTPRequest(const String& method, const String& url) override;
 	};
 
 	class DummyNetworkService : public NetworkService
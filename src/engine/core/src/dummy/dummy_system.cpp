@@ -1,10 +1,86 @@
 #include "dummy_system.h"
+#include "halley/resources/resource_data.h"
+#include "halley/support/exception.h"
+#include "halley/text/string_converter.h"
+#include <fstream>
 
 using namespace Halley;
 
+namespace {
+	// Plain file reads, so dedicated servers built without SDL can still load their assets
+	class DummyFileReader : public ResourceDataReader {
+	public:
+		DummyFileReader(std::ifstream stream, int64_t start, int64_t end)
+			: stream(std::move(stream))
+			, start(start)
+			, end(end)
+		{
+			if (this->end == -1) {
+				this->stream.seekg(0, std::ios::end);
+				this->end = int64_t(this->stream.tellg());
+			}
+			if (this->end < start) {
+				throw Exception("Invalid file size for resource: " + toString(this->end - start) + " bytes.", HalleyExceptions::SystemPlugin);
+			}
+			pos = start;
+		}
+
+		size_t size() const override
+		{
+			return size_t(end - start);
+		}
+
+		int read(gsl::span<gsl::byte> dst) override
+		{
+			if (!stream.is_open()) {
+				return -1;
+			}
+			const auto toRead = std::min(int64_t(dst.size()), end - pos);
+			stream.seekg(pos);
+			stream.read(reinterpret_cast<char*>(dst.data()), toRead);
+			const auto n = int(stream.gcount());
+			stream.clear();
+			pos += n;
+			return n;
+		}
+
+		void seek(int64_t offset, int whence) override
+		{
+			if (whence == SEEK_SET) {
+				pos = start + offset;
+			} else if (whence == SEEK_CUR) {
+				pos += offset;
+			} else if (whence == SEEK_END) {
+				pos = end + offset;
+			}
+		}
+
+		size_t tell() const override
+		{
+			return size_t(pos - start);
+		}
+
+		void close() override
+		{
+			stream.close();
+			pos = end;
+		}
+
+	private:
+		std::ifstream stream;
+		int64_t start;
+		int64_t end;
+		int64_t pos;
+	};
+}
+
 std::unique_ptr<ResourceDataReader> DummySystemAPI::getDataReader(String path, int64_t start, int64_t end)
 {
-	return {};
+	std::ifstream stream(path.cppStr(), std::ios::binary);
+	if (!stream.is_open()) {
+		return {};
+	}
+	return std::make_unique<DummyFileReader>(std::move(stream), start, end);
 }
 
 std::unique_ptr<GLContext> DummySystemAPI::createGLContext()
@@ -78,12 +154,13 @@ void DummySystemAPI::deInit()
 
 Path DummySystemAPI::getAssetsPath(const Path& gamePath) const
 {
-	return gamePath;
+	// Same layout as the SDL system's, so a server can share the client's assets
+	return gamePath / ".." / "assets";
 }
 
 Path DummySystemAPI::getUnpackedAssetsPath(const Path& gamePath) const
 {
-	return gamePath;
+	return gamePath / ".." / "assets_unpacked";
 }
 
 
@@ -104,15 +104,15 @@ DummyPainter::DummyPainter(Resources& resources)
 	: Painter(resources)
 {}
 
-void DummyPainter::clear(Colour colour) {}
-
 void DummyPainter::setMaterialPass(const Material&, int) {}
 
 void DummyPainter::doStartRender() {}
 
 void DummyPainter::doEndRender() {}
 
-void DummyPainter::setVertices(const MaterialDefinition&, size_t, void*, size_t, unsigned short*, bool) {}
+void DummyPainter::doClear(Maybe<Colour>, Maybe<float>, Maybe<uint8_t>) {}
+
+void DummyPainter::setVertices(const MaterialDefinition&, size_t, void*, size_t, IndexType*, bool) {}
 
 void DummyPainter::drawTriangles(size_t) {}
 
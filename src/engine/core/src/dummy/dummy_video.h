@@ -54,11 +54,11 @@ namespace Halley {
 	{
 	public:
 		explicit DummyPainter(Resources& resources);
-		void clear(Colour colour) override;
 		void setMaterialPass(const Material& material, int pass) override;
 		void doStartRender() override;
 		void doEndRender() override;
-		void setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, unsigned short* indices, bool standardQuadsOnly) override;
+		void doClear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil) override;
+		void setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly) override;
 		void drawTriangles(size_t numIndices) override;
 		void setViewPort(Rect4i rect) override;
 		void setClip(Rect4i clip, bool enable) override;
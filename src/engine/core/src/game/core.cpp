@@ -5,18 +5,28 @@
 #include "api/halley_api.h"
 #include "graphics/camera.h"
 #include "graphics/render_context.h"
+#include "graphics/render_command_list.h"
+#include "graphics/render_thread.h"
+#include "graphics/late_latch.h"
 #include "graphics/render_target/render_target_screen.h"
 #include "graphics/window.h"
 #include "resources/resources.h"
 #include "resources/resource_locator.h"
 #include "resources/standard_resources.h"
+#include <halley/file_formats/config_file.h>
 #include <halley/os/os.h>
 #include <halley/support/debug.h>
 #include <halley/support/console.h>
 #include <halley/concurrency/concurrent.h>
+#include <halley/support/profiler.h>
+#include <halley/support/memory_tracker.h>
+#include <halley/data_structures/memory_pool.h>
+#include "halley/runner/frame_pacer.h"
 #include <fstream>
 #include <chrono>
 #include <ctime>
+#include <algorithm>
+#include <map>
 #include "../dummy/dummy_plugins.h"
 #include "halley/core/devcon/devcon_client.h"
 #include "halley/net/connection/network_service.h"
@@ -29,10 +39,24 @@ using namespace Halley;
 
 Core::Core(std::unique_ptr<Game> g, Vector<std::string> _args)
 {
-	statics.setupGlobals();
+	// Startup trace, which profiles everything up to the first frame
+	tracingStartup = std::find(_args.begin(), _args.end(), "--trace-startup") != _args.end();
+	if (tracingStartup) {
+		profilerWasEnabled = Profiler::isEnabled();
+		Profiler::setEnabled(true);
+		Profiler::setThreadName("main");
+	}
+	startupBeginTime = Profiler::getTime();
+
+	{
+		HALLEY_PROFILE_SCOPE("Statics::setupGlobals");
+		statics.setupGlobals();
+	}
 	Logger::addSink(*this);
+	Telemetry::addSource(*this);
 
 	game = std::move(g);
+	lateLatch = std::make_unique<LateLatch>();
 
 	// Set paths
 	environment = std::make_unique<Environment>();
@@ -44,7 +68,11 @@ Core::Core(std::unique_ptr<Game> g, Vector<std::string> _args)
 	environment->setDataPath(game->getDataPath());
 
 	// Basic initialization
-	game->init(*environment, args);
+	{
+		HALLEY_PROFILE_SCOPE("Game::init");
+		game->init(*environment, args);
+	}
+	dedicatedServer = game->isDedicatedServer();
 
 	// Console
 	if (game->shouldCreateSeparateConsole()) {
@@ -80,8 +108,15 @@ Core::Core(std::unique_ptr<Game> g, Vector<std::string> _args)
 #endif
 
 	// Create API
-	registerDefaultPlugins();
-	api = HalleyAPI::create(this, game->initPlugins(*this));
+	{
+		HALLEY_PROFILE_SCOPE("Core::createAPI");
+		registerDefaultPlugins();
+		int apiFlags = game->initPlugins(*this);
+		if (dedicatedServer) {
+			apiFlags &= HalleyAPIFlags::Network | HalleyAPIFlags::Platform;
+		}
+		api = HalleyAPI::create(this, apiFlags);
+	}
 }
 
 Core::~Core()
@@ -97,6 +132,11 @@ const HalleyStatics& Core::getStatics()
 void Core::onSuspended()
 {
 	HALLEY_DEBUG_TRACE();
+	if (currentStage) {
+		reloadState = std::make_unique<HotReloadState>();
+		currentStage->onSaveReloadState(*reloadState);
+	}
+	stopRenderThread();
 	if (api->videoInternal) {
 		api->videoInternal->onSuspend();
 	}
@@ -120,6 +160,7 @@ void Core::onReloaded()
 	statics.resume(api->system);
 	if (api->system) {
 		api->system->setThreadName("main");
+		Profiler::setThreadName("main");
 	}
 	
 	if (api->inputInternal) {
@@ -128,11 +169,27 @@ void Core::onReloaded()
 	if (api->videoInternal) {
 		api->videoInternal->onResume();
 	}
+	if (painter) {
+		startRenderThread();
+	}
+
+	if (currentStage && reloadState) {
+		// Swapped in by transitionStage(), like any other stage, and given the state in initStage()
+		auto reloaded = currentStage->makeReloadedStage();
+		if (reloaded) {
+			setStage(std::move(reloaded));
+		} else {
+			reloadState.reset();
+		}
+	}
 	HALLEY_DEBUG_TRACE();
 }
 
 void Core::onTerminatedInError(const std::string& error)
 {
+	// Whatever was logged leading up to this is still queued
+	Logger::flush();
+
 	if (!error.empty()) {
 		std::cout << ConsoleColour(Console::RED) << "\n\nUnhandled exception: " << ConsoleColour(Console::DARK_RED) << error << ConsoleColour() << std::endl;
 	} else {
@@ -154,17 +211,34 @@ int Core::getTargetFPS()
 
 void Core::init()
 {
-	// Initialize API
+	HALLEY_PROFILE_SCOPE("Core::init");
+
+	// Initialize API; some of it may carry on in the background, while resources are set up
 	api->init();
 	api->systemInternal->setEnvironment(environment.get());
+	ExecutorsTopology topology;
+	game->setupExecutors(topology);
+	statics.setExecutorsTopology(topology);
 	statics.resume(api->system);
 	if (api->system) {
 		api->system->setThreadName("main");
+		Profiler::setThreadName("main");
+	}
+#if HAS_THREADS
+	if (api->inputInternal && !dedicatedServer) {
+		api->inputInternal->setEventThreadEnabled(game->shouldProcessInputOnSeparateThread());
 	}
+#endif
 
 	// Resources
 	initResources();
 
+	// Everything from here on may use any API
+	api->waitForInit();
+	if (api->audioInternal) {
+		api->audioInternal->setResources(*resources);
+	}
+
 	// Create devcon connection
 	String devConAddress = game->getDevConAddress();
 	if (!devConAddress.isEmpty()) {
@@ -172,11 +246,17 @@ void Core::init()
 	}
 
 	// Start game
-	setStage(game->startGame(&*api));
+	{
+		HALLEY_PROFILE_SCOPE("Game::startGame");
+		setStage(game->startGame(&*api));
+	}
 	
 	// Get video resources
 	if (api->video) {
+		HALLEY_PROFILE_SCOPE("VideoAPI::makePainter");
 		painter = api->videoInternal->makePainter(api->core->getResources());
+		painter->setGPUTimingEnabled(game->isDevMode());
+		startRenderThread();
 	}
 }
 
@@ -184,8 +264,15 @@ void Core::deInit()
 {
 	std::cout << "Game shutting down." << std::endl;
 
+	// Shutdown is logged as it happens, so the sinks aren't written to from another thread while they're torn down
+	Logger::setAsync(false);
+
+	// Finish any frame in flight before tearing down what it might be using
+	stopRenderThread();
+
 	// Ensure stage is cleaned up
 	running = false;
+	cancelStagePreload();
 	transitionStage();
 
 	// Deinit game
@@ -196,8 +283,11 @@ void Core::deInit()
 	if (devConClient) {
 		devConClient.reset();
 	}
+	Telemetry::removeSource(*this);
 
 	// Deinit painter
+	recordingPainter.reset();
+	frameCommands.reset();
 	painter.reset();
 
 	// Stop audio playback before releasing resources
@@ -229,12 +319,49 @@ void Core::deInit()
 
 void Core::initResources()
 {
+	HALLEY_PROFILE_SCOPE("Core::initResources");
 	auto locator = std::make_unique<ResourceLocator>(*api->system);
 	auto gamePath = environment->getProgramPath();
 	game->initResourceLocator(gamePath, api->system->getAssetsPath(gamePath.string()), api->system->getUnpackedAssetsPath(gamePath.string()), *locator);
 	resources = std::make_unique<Resources>(std::move(locator), &*api);
-	StandardResources::initialize(*resources);
-	api->audioInternal->setResources(*resources);
+	StandardResources::initialize(*resources, dedicatedServer);
+}
+
+void Core::finishStartupTrace()
+{
+	tracingStartup = false;
+	auto capture = Profiler::capture();
+	if (!profilerWasEnabled) {
+		Profiler::setEnabled(false);
+	}
+
+	// Only what happened during startup, which may have been preceded by whatever was profiled before the trace started
+	capture.events.erase(std::remove_if(capture.events.begin(), capture.events.end(), [&] (const ProfilerCapture::Event& e)
+	{
+		return e.startNs < startupBeginTime;
+	}), capture.events.end());
+	std::sort(capture.events.begin(), capture.events.end(), [] (const ProfilerCapture::Event& a, const ProfilerCapture::Event& b)
+	{
+		return a.startNs < b.startNs;
+	});
+
+	const auto toMs = [] (int64_t ns) { return toString(double(ns) / 1000000.0, 1); };
+	std::cout << ConsoleColour(Console::GREEN) << "Startup took " << toMs(Profiler::getTime() - startupBeginTime) << " ms to the first frame:" << ConsoleColour() << std::endl;
+	for (auto& e: capture.events) {
+		if (e.depth <= 1) {
+			const auto& threadName = e.thread < int(capture.threadNames.size()) ? capture.threadNames[e.thread] : String();
+			std::cout << "\t" << std::string(size_t(e.depth) * 2, ' ') << e.name << ": " << toMs(e.endNs - e.startNs) << " ms, from " << toMs(e.startNs - startupBeginTime) << " ms";
+			if (threadName != "main") {
+				std::cout << " on \"" << threadName << "\"";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	const auto path = environment->getDataPath() / "startup_trace.json";
+	const auto trace = capture.toChromeTrace();
+	Path::writeFile(path, Bytes(reinterpret_cast<const Byte*>(trace.c_str()), reinterpret_cast<const Byte*>(trace.c_str()) + trace.size()));
+	std::cout << "Startup trace written to " << path.string() << std::endl;
 }
 
 void Core::setOutRedirect(bool appendToExisting)
@@ -255,11 +382,14 @@ void Core::setOutRedirect(bool appendToExisting)
 
 void Core::pumpEvents(Time time)
 {
-	auto video = dynamic_cast<VideoAPIInternal*>(&*api->video);
-	auto input = dynamic_cast<InputAPIInternal*>(&*api->input);
-	input->beginEvents(time);
-	if (!api->system->generateEvents(video, input)) {
-		quit(0); // System close event
+	// Dedicated servers have no window to get events from
+	if (!dedicatedServer) {
+		auto video = dynamic_cast<VideoAPIInternal*>(&*api->video);
+		auto input = dynamic_cast<InputAPIInternal*>(&*api->input);
+		input->beginEvents(time);
+		if (!api->system->generateEvents(video, input)) {
+			quit(0); // System close event
+		}
 	}
 
 	if (devConClient) {
@@ -290,13 +420,32 @@ void Core::onVariableUpdate(Time time)
 	}
 
 	if (isRunning()) {
-		doRender(time);
+		if (!dedicatedServer) {
+			doRender(time);
+		}
+		doIdle();
+	}
+
+	if (tracingStartup) {
+		finishStartupTrace();
+	}
+}
+
+void Core::onServerPoll()
+{
+	if (running && currentStage) {
+		try {
+			currentStage->onServerPoll();
+		} catch (Exception& e) {
+			game->onUncaughtException(e, TimeLine::VariableUpdate);
+		}
 	}
 }
 
 void Core::doFixedUpdate(Time time)
 {
 	HALLEY_DEBUG_TRACE();
+	HALLEY_PROFILE_SCOPE("Core::doFixedUpdate");
 	auto& engineTimer = engineTimers[int(TimeLine::FixedUpdate)];
 	auto& gameTimer = gameTimers[int(TimeLine::FixedUpdate)];
 	engineTimer.beginSample();
@@ -319,11 +468,18 @@ void Core::doFixedUpdate(Time time)
 void Core::doVariableUpdate(Time time)
 {
 	HALLEY_DEBUG_TRACE();
+	HALLEY_PROFILE_SCOPE("Core::doVariableUpdate");
 	auto& engineTimer = engineTimers[int(TimeLine::VariableUpdate)];
 	auto& gameTimer = gameTimers[int(TimeLine::VariableUpdate)];
 	engineTimer.beginSample();
 
 	pumpEvents(time);
+	if (resources) {
+		// Keep construction of streamed resources from eating into the frame
+		resources->update(0.002);
+	}
+	ConfigObserver::dispatchChanges();
+	updateStagePreload();
 	gameTimer.beginSample();
 	if (running && currentStage) {
 		try {
@@ -349,27 +505,39 @@ void Core::doVariableUpdate(Time time)
 void Core::doRender(Time)
 {
 	HALLEY_DEBUG_TRACE();
+	HALLEY_PROFILE_SCOPE("Core::doRender");
 	auto& engineTimer = engineTimers[int(TimeLine::Render)];
 	auto& gameTimer = gameTimers[int(TimeLine::Render)];
 	bool gameSampled = false;
 	engineTimer.beginSample();
 
 	if (api->video) {
-		api->video->startRender();
-		painter->startRender();
+		Painter& framePainter = renderThread ? *recordingPainter : *painter;
+		if (!renderThread) {
+			api->video->startRender();
+		}
+		framePainter.startRender();
 
 		if (currentStage) {
 			auto windowSize = api->video->getWindow().getDefinition().getSize();
 			if (windowSize != prevWindowSize) {
+				if (renderThread) {
+					renderThread->waitForIdle();
+				}
 				screenTarget.reset();
 				screenTarget = api->video->createScreenRenderTarget();
 				camera = std::make_unique<Camera>(Vector2f(windowSize) * 0.5f);
 				prevWindowSize = windowSize;
 			}
-			RenderContext context(*painter, *camera, *screenTarget);
+			RenderContext context(framePainter, *camera, *screenTarget);
 
 			gameTimer.beginSample();
 
+			if (!renderThread) {
+				// Draws are submitted as they're made, so this is as late as it gets
+				lateLatch->latch(api->input);
+			}
+
 			try {
 				currentStage->onRender(context);
 			} catch (Exception& e) {
@@ -380,10 +548,19 @@ void Core::doRender(Time)
 			gameSampled = true;
 		}
 
-		painter->endRender();
+		framePainter.endRender();
 
 		vsyncTimer.beginSample();
-		api->video->finishRender();
+		if (renderThread) {
+			// Blocks while the previous frame is still being submitted, which includes waiting for vsync
+			recordingPainter->takeCommands(*frameCommands);
+			renderThread->waitForIdle();
+			lateLatch->latch(api->input);
+			renderThread->submit(*frameCommands);
+		} else {
+			HALLEY_PROFILE_SCOPE("VideoAPI::finishRender");
+			api->video->finishRender();
+		}
 		vsyncTimer.endSample();
 	}
 
@@ -396,6 +573,40 @@ void Core::doRender(Time)
 	HALLEY_DEBUG_TRACE();
 }
 
+void Core::doIdle()
+{
+	HALLEY_PROFILE_SCOPE("Core::doIdle");
+	idleTimer.beginSample();
+	for (auto task: idleTasks) {
+		try {
+			task->runIdle();
+		} catch (Exception& e) {
+			game->onUncaughtException(e, TimeLine::Render);
+		}
+	}
+	idleTimer.endSample();
+}
+
+void Core::startRenderThread()
+{
+#if HAS_THREADS
+	if (!renderThread && game->shouldRenderOnSeparateThread() && api->video->canRenderOnAnotherThread()) {
+		if (!recordingPainter) {
+			recordingPainter = std::make_unique<RecordingPainter>(*resources);
+			recordingPainter->setGPUTimingEnabled(painter->isGPUTimingEnabled());
+			recordingPainter->setGPUTimingSource(*painter);
+			frameCommands = std::make_unique<RenderCommandList>();
+		}
+		renderThread = std::make_unique<RenderThread>(*api->system, *api->video, *painter);
+	}
+#endif
+}
+
+void Core::stopRenderThread()
+{
+	renderThread.reset();
+}
+
 void Core::showComputerInfo() const
 {
 	time_t rawtime;
@@ -455,16 +666,99 @@ int64_t Core::getTime(CoreAPITimer timerType, TimeLine tl, StopwatchAveraging::M
 		return gameTimers[int(tl)].elapsedNanoSeconds(mode);
 	case CoreAPITimer::Vsync:
 		return vsyncTimer.elapsedNanoSeconds(mode);
+	case CoreAPITimer::Idle:
+		return idleTimer.elapsedNanoSeconds(mode);
 	default:
 		return 0;
 	}
 }
 
+void Core::getTelemetry(std::vector<TelemetryValue>& values) const
+{
+	const char* timelineNames[] = { "fixed", "variable", "render" };
+	for (int i = 0; i < int(TimeLine::NUMBER_OF_TIMELINES); ++i) {
+		const String prefix = String("core.") + timelineNames[i];
+		values.emplace_back(prefix + ".engine.ms", double(engineTimers[i].averageElapsedNanoSeconds()) / 1'000'000.0);
+		values.emplace_back(prefix + ".game.ms", double(gameTimers[i].averageElapsedNanoSeconds()) / 1'000'000.0);
+	}
+	values.emplace_back("core.vsync.ms", double(vsyncTimer.averageElapsedNanoSeconds()) / 1'000'000.0);
+	values.emplace_back("core.idle.ms", double(idleTimer.averageElapsedNanoSeconds()) / 1'000'000.0);
+
+	if (painter) {
+		values.emplace_back("painter.drawCalls", double(painter->getPrevDrawCalls()));
+		values.emplace_back("painter.triangles", double(painter->getPrevTriangles()));
+		values.emplace_back("painter.vertices", double(painter->getPrevVertices()));
+		values.emplace_back("painter.elidedStateChanges", double(painter->getPrevElidedStateChanges()));
+
+		// Scopes that share a name (e.g. a render system drawing more than one world) are added up
+		std::map<String, int64_t> gpuTimes;
+		for (auto& timing: painter->getPrevGPUTimings()) {
+			gpuTimes[timing.depth == 0 ? String("gpu.frame.ms") : "gpu.scope." + timing.name + ".ms"] += timing.elapsedNs;
+		}
+		for (auto& t: gpuTimes) {
+			values.emplace_back(t.first, double(t.second) / 1'000'000.0);
+		}
+	}
+
+	if (framePacer) {
+		values.emplace_back("core.frameTime.ms", framePacer->getStats().averageFrameTime * 1000.0);
+	}
+
+	values.emplace_back("memory.process.bytes", double(OS::get().getMemoryUsage()));
+	for (auto& tag: MemoryTracker::getAllStats()) {
+		values.emplace_back("memory." + tag.name + ".bytes", double(tag.bytes));
+		values.emplace_back("memory." + tag.name + ".peakBytes", double(tag.peakBytes));
+	}
+	for (auto& pool: SizePool::getAllStats()) {
+		const String name = pool.name ? String(pool.name) : "size" + toString(pool.blockSize);
+		values.emplace_back("memory.pool." + name + ".bytes", double(pool.capacity * pool.blockSize));
+		values.emplace_back("memory.pool." + name + ".inUseBytes", double(pool.inUse * pool.blockSize));
+	}
+}
+
+void Core::addIdleTask(IIdleTask& task)
+{
+	idleTasks.push_back(&task);
+}
+
+void Core::removeIdleTask(IIdleTask& task)
+{
+	idleTasks.erase(std::remove(idleTasks.begin(), idleTasks.end(), &task), idleTasks.end());
+}
+
+const Vector<IIdleTask*>& Core::getIdleTasks() const
+{
+	return idleTasks;
+}
+
+LateLatch& Core::getLateLatch()
+{
+	return *lateLatch;
+}
+
+const FramePacer* Core::getFramePacer() const
+{
+	return framePacer;
+}
+
+void Core::setFramePacer(FramePacer* pacer)
+{
+	framePacer = pacer;
+	if (framePacer) {
+		game->setupFramePacer(*framePacer);
+	}
+}
+
 void Core::initStage(Stage& stage)
 {
 	stage.api = &*api;
 	stage.setGame(*game);
 	stage.init();
+
+	if (reloadState) {
+		stage.onLoadReloadState(*reloadState);
+		reloadState.reset();
+	}
 }
 
 Stage& Core::getCurrentStage()
@@ -472,6 +766,91 @@ Stage& Core::getCurrentStage()
 	return *currentStage;
 }
 
+void Core::preloadStage(StageID stage, bool startWhenReady)
+{
+	preloadStage(game->makeStage(stage), startWhenReady);
+}
+
+void Core::preloadStage(std::unique_ptr<Stage> stage, bool startWhenReady)
+{
+	Expects(stage);
+	cancelStagePreload();
+
+	preloadingStage = std::move(stage);
+	preloadingStage->api = &*api;
+	preloadingStage->setGame(*game);
+	startPreloadedWhenReady = startWhenReady;
+	stagePrefetch = resources->prefetch(preloadingStage->getPreloadAssets());
+	updateStagePreload();
+}
+
+bool Core::isStagePreloaded() const
+{
+	return preloadingStage && stageLoadStarted && stageLoad.isReady();
+}
+
+float Core::getStagePreloadProgress() const
+{
+	if (!preloadingStage) {
+		return 0.0f;
+	}
+	// The assets are normally the bulk of it, so loadAsync() only gets the last bit
+	return stagePrefetch.getProgress() * 0.9f + (isStagePreloaded() ? 0.1f : 0.0f);
+}
+
+void Core::startPreloadedStage()
+{
+	Expects(isStagePreloaded());
+
+	auto error = stageLoad.get();
+	auto stage = std::move(preloadingStage);
+	stagePrefetch = ResourcePrefetch();
+	stageLoadStarted = false;
+	if (error) {
+		std::rethrow_exception(error);
+	}
+
+	// Swapped in by transitionStage(), at the end of this frame
+	setStage(std::move(stage));
+}
+
+void Core::updateStagePreload()
+{
+	if (!preloadingStage) {
+		return;
+	}
+
+	if (!stageLoadStarted && stagePrefetch.isDone()) {
+		stageLoadStarted = true;
+		auto stage = preloadingStage.get();
+		auto prefetch = &stagePrefetch;
+		stageLoad = Concurrent::execute(Executors::getCPU(), [stage, prefetch] () -> std::exception_ptr
+		{
+			try {
+				stage->loadAsync(*prefetch);
+			} catch (...) {
+				return std::current_exception();
+			}
+			return {};
+		});
+	}
+
+	if (startPreloadedWhenReady && isStagePreloaded()) {
+		startPreloadedStage();
+	}
+}
+
+void Core::cancelStagePreload()
+{
+	if (stageLoadStarted) {
+		// loadAsync() can't be interrupted, so wait for it to finish before destroying the stage
+		stageLoad.wait();
+	}
+	preloadingStage.reset();
+	stagePrefetch = ResourcePrefetch();
+	stageLoadStarted = false;
+}
+
 bool Core::transitionStage()
 {
 	// If it's not running anymore, reset stage
@@ -0,0 +1,312 @@
+#include "game/entity_replicator.h"
+#include "halley/entity/world.h"
+#include "halley/entity/spatial_index_service.h"
+#include "halley/net/session/network_session.h"
+#include "halley/bytes/byte_serializer.h"
+#include "halley/support/exception.h"
+#include "halley/text/string_converter.h"
+#include "halley/utils/hash.h"
+#include <algorithm>
+
+using namespace Halley;
+
+namespace {
+	enum class ReplicationPacketType : uint8_t {
+		Replication,
+		Game
+	};
+
+	struct ReplicationPacketHeader
+	{
+		ReplicationPacketType type;
+	};
+
+	struct ReplicationMsg
+	{
+		Vector<EntityId> destroyed;
+		Vector<std::pair<EntityId, Bytes>> updated;
+
+		void serialize(Serializer& s) const
+		{
+			s << uint16_t(destroyed.size());
+			for (auto& id: destroyed) {
+				s << id;
+			}
+			s << uint16_t(updated.size());
+			for (auto& u: updated) {
+				s << u.first;
+				s << u.second;
+			}
+		}
+
+		void deserialize(Deserializer& s)
+		{
+			uint16_t n;
+			s >> n;
+			destroyed.resize(n);
+			for (auto& id: destroyed) {
+				s >> id;
+			}
+			s >> n;
+			updated.resize(n);
+			for (auto& u: updated) {
+				s >> u.first;
+				s >> u.second;
+			}
+		}
+	};
+
+	// Upper bounds of what each part takes once serialized, to know when a packet is full
+	constexpr size_t msgOverhead = sizeof(ReplicationPacketHeader) + 2 * sizeof(uint16_t);
+	constexpr size_t destroyOverhead = sizeof(int64_t);
+	constexpr size_t updateOverhead = sizeof(int64_t) + sizeof(uint32_t);
+
+	constexpr Time maxBurst = 0.25; // Budget saved up while idle is capped at this many seconds' worth
+}
+
+EntityReplicator::EntityReplicator(World& world, NetworkSession& session, Config config)
+	: world(world)
+	, session(session)
+	, config(std::move(config))
+{
+	Expects(this->config.bytesPerSecond > 0);
+	Expects(this->config.maxPacketSize > msgOverhead + updateOverhead);
+	Expects(this->config.destroyRedundancy > 0);
+}
+
+void EntityReplicator::setPeerView(int peerId, Vector2f position, Rect4f visibleArea)
+{
+	if (session.getType() != NetworkSessionType::Host) {
+		throw Exception("Only the host replicates entities.", HalleyExceptions::Network);
+	}
+	Expects(peerId != session.getMyPeerId());
+
+	auto& peer = peers[peerId];
+	peer.position = position;
+	peer.visibleArea = visibleArea;
+}
+
+void EntityReplicator::removePeer(int peerId)
+{
+	peers.erase(peerId);
+}
+
+void EntityReplicator::setAlwaysRelevant(EntityId id, bool relevant)
+{
+	auto iter = std::find(alwaysRelevant.begin(), alwaysRelevant.end(), id);
+	if (relevant && iter == alwaysRelevant.end()) {
+		alwaysRelevant.push_back(id);
+	} else if (!relevant && iter != alwaysRelevant.end()) {
+		alwaysRelevant.erase(iter);
+	}
+}
+
+void EntityReplicator::update(Time elapsed)
+{
+	receivePackets();
+	if (peers.empty()) {
+		return;
+	}
+
+	++updateId;
+	for (auto& p: peers) {
+		updatePeer(p.second, elapsed);
+		sendReplicas(p.first, p.second);
+	}
+}
+
+EntityId EntityReplicator::getLocalEntity(EntityId hostId) const
+{
+	auto iter = hostToLocal.find(hostId);
+	return iter != hostToLocal.end() ? iter->second : EntityId();
+}
+
+void EntityReplicator::send(OutboundNetworkPacket&& packet)
+{
+	ReplicationPacketHeader header;
+	header.type = ReplicationPacketType::Game;
+	packet.addHeader(header);
+	session.send(std::move(packet));
+}
+
+bool EntityReplicator::receive(InboundNetworkPacket& packet)
+{
+	receivePackets();
+	if (gameInbox.empty()) {
+		return false;
+	}
+	packet = std::move(gameInbox.front());
+	gameInbox.erase(gameInbox.begin());
+	return true;
+}
+
+void EntityReplicator::updatePeer(Peer& peer, Time elapsed)
+{
+	const float rate = config.bytesPerSecond;
+	peer.budget = std::min(peer.budget + rate * float(elapsed), rate * float(maxBurst));
+
+	// The visible area goes first, as its priority is usually the highest; each entity keeps the best rate it's found at
+	auto& index = world.getService<SpatialIndexService>();
+	queryResults.clear();
+	index.query(peer.visibleArea, queryResults);
+	for (auto& id: queryResults) {
+		markRelevant(peer, id, config.visiblePriority);
+	}
+	for (auto& bucket: config.buckets) {
+		queryResults.clear();
+		index.queryRadius(peer.position, bucket.maxDistance, queryResults);
+		for (auto& id: queryResults) {
+			markRelevant(peer, id, bucket.priority);
+		}
+	}
+	for (auto& id: alwaysRelevant) {
+		markRelevant(peer, id, config.visiblePriority);
+	}
+
+	// Whatever wasn't found this time is no longer relevant
+	for (auto iter = peer.entities.begin(); iter != peer.entities.end(); ) {
+		auto& state = iter->second;
+		if (state.lastRelevant != updateId) {
+			if (state.sent) {
+				peer.pendingDestroys.emplace_back(iter->first, config.destroyRedundancy);
+			}
+			iter = peer.entities.erase(iter);
+		} else {
+			state.priority += state.rate * float(elapsed);
+			state.sinceSent += elapsed;
+			++iter;
+		}
+	}
+}
+
+void EntityReplicator::markRelevant(Peer& peer, EntityId id, float rate)
+{
+	auto iter = peer.entities.find(id);
+	if (iter == peer.entities.end()) {
+		if (!world.hasReplicatedComponents(id)) {
+			return;
+		}
+		iter = peer.entities.emplace(id, EntityState()).first;
+
+		// Back in view before its destroy was done being sent
+		peer.pendingDestroys.erase(std::remove_if(peer.pendingDestroys.begin(), peer.pendingDestroys.end(), [&] (const std::pair<EntityId, int>& d) { return d.first == id; }), peer.pendingDestroys.end());
+	} else if (iter->second.lastRelevant == updateId) {
+		iter->second.rate = std::max(iter->second.rate, rate);
+		return;
+	}
+
+	iter->second.rate = rate;
+	iter->second.lastRelevant = updateId;
+}
+
+void EntityReplicator::sendReplicas(int peerId, Peer& peer)
+{
+	sendOrder.clear();
+	for (auto& e: peer.entities) {
+		sendOrder.emplace_back(e.second.priority, e.first);
+	}
+	std::sort(sendOrder.begin(), sendOrder.end(), [] (const std::pair<float, EntityId>& a, const std::pair<float, EntityId>& b)
+	{
+		return a.first != b.first ? a.first > b.first : a.second < b.second;
+	});
+
+	ReplicationMsg msg;
+	size_t msgSize = msgOverhead;
+	auto flush = [&] ()
+	{
+		if (msg.destroyed.empty() && msg.updated.empty()) {
+			return;
+		}
+		OutboundNetworkPacket packet(Serializer::toBytes(msg));
+		ReplicationPacketHeader header;
+		header.type = ReplicationPacketType::Replication;
+		packet.addHeader(header);
+		session.sendToPeer(std::move(packet), peerId);
+
+		msg.destroyed.clear();
+		msg.updated.clear();
+		msgSize = msgOverhead;
+	};
+
+	// Destroys are tiny, and the client is left with a stale entity until one arrives, so they always go
+	for (auto& d: peer.pendingDestroys) {
+		if (msgSize + destroyOverhead > config.maxPacketSize) {
+			flush();
+		}
+		msg.destroyed.push_back(d.first);
+		msgSize += destroyOverhead;
+		peer.budget -= float(destroyOverhead);
+		--d.second;
+	}
+	peer.pendingDestroys.erase(std::remove_if(peer.pendingDestroys.begin(), peer.pendingDestroys.end(), [] (const std::pair<EntityId, int>& d) { return d.second <= 0; }), peer.pendingDestroys.end());
+
+	for (auto& o: sendOrder) {
+		if (peer.budget <= 0) {
+			break;
+		}
+
+		const EntityId id = o.second;
+		auto& state = peer.entities.at(id);
+
+		Bytes replica = Serializer::toBytes([&] (Serializer& s) { world.saveReplica(id, s); });
+		const uint64_t hash = Hash::hashXXH64(gsl::as_bytes(gsl::span<const Byte>(replica)));
+		if (state.sent && hash == state.lastHash && state.sinceSent < config.resendInterval) {
+			// Nothing new, so it doesn't cost anything, and doesn't get to jump the queue next time either
+			state.priority = 0;
+			continue;
+		}
+
+		const size_t size = updateOverhead + replica.size();
+		if (msgSize + size > config.maxPacketSize) {
+			flush();
+		}
+		msg.updated.emplace_back(id, std::move(replica));
+		msgSize += size;
+		peer.budget -= float(size);
+
+		state.priority = 0;
+		state.sinceSent = 0;
+		state.lastHash = hash;
+		state.sent = true;
+	}
+
+	flush();
+}
+
+void EntityReplicator::receivePackets()
+{
+	InboundNetworkPacket packet;
+	while (session.receive(packet)) {
+		ReplicationPacketHeader header;
+		packet.extractHeader(header);
+		if (header.type == ReplicationPacketType::Replication) {
+			if (session.getType() == NetworkSessionType::Client) {
+				onReplication(packet.getBytes());
+			}
+		} else {
+			gameInbox.emplace_back(std::move(packet));
+		}
+	}
+}
+
+void EntityReplicator::onReplication(gsl::span<const gsl::byte> data)
+{
+	auto msg = Deserializer::fromBytes<ReplicationMsg>(data);
+
+	for (auto& id: msg.destroyed) {
+		auto iter = hostToLocal.find(id);
+		if (iter != hostToLocal.end()) {
+			world.destroyEntity(iter->second);
+			hostToLocal.erase(iter);
+		}
+	}
+
+	for (auto& u: msg.updated) {
+		auto iter = hostToLocal.find(u.first);
+		if (iter == hostToLocal.end()) {
+			iter = hostToLocal.emplace(u.first, world.createEntity().getEntityId()).first;
+		}
+		Deserializer s(u.second);
+		world.loadReplica(iter->second, s);
+	}
+}
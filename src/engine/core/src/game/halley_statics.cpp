@@ -39,6 +39,7 @@ namespace Halley {
 		Logger* logger;
 		
 		std::unique_ptr<Executors> executors;
+		ExecutorsTopology topology;
 		std::unique_ptr<ThreadPool> cpuThreadPool;
 		std::unique_ptr<ThreadPool> cpuAuxThreadPool;
 		std::unique_ptr<ThreadPool> diskIOThreadPool;
@@ -71,12 +72,20 @@ void HalleyStatics::resume(SystemAPI* system)
 		}
 	};
 
-	pimpl->cpuThreadPool = std::make_unique<ThreadPool>("CPU", pimpl->executors->getCPU(), std::thread::hardware_concurrency(), makeThread);
-	pimpl->cpuAuxThreadPool = std::make_unique<ThreadPool>("CPUAux", pimpl->executors->getCPUAux(), std::thread::hardware_concurrency(), makeThread);
-	pimpl->diskIOThreadPool = std::make_unique<ThreadPool>("IO", pimpl->executors->getDiskIO(), 1, makeThread);
+	const auto& topology = pimpl->topology;
+	pimpl->cpuThreadPool = std::make_unique<ThreadPool>("CPU", pimpl->executors->getCPU(), topology.cpu, makeThread);
+	pimpl->cpuAuxThreadPool = std::make_unique<ThreadPool>("CPUAux", pimpl->executors->getCPUAux(), topology.cpuAux, makeThread);
+	pimpl->diskIOThreadPool = std::make_unique<ThreadPool>("IO", pimpl->executors->getDiskIO(), topology.diskIO, makeThread);
+
+	Logger::setAsync(true);
 #endif
 }
 
+void HalleyStatics::setExecutorsTopology(const ExecutorsTopology& topology)
+{
+	pimpl->topology = topology;
+}
+
 void HalleyStatics::setupGlobals() const
 {
 	Logger::setInstance(*pimpl->logger);
@@ -90,6 +99,7 @@ void HalleyStatics::setupGlobals() const
 
 void HalleyStatics::suspend()
 {
+	Logger::setAsync(false);
 	pimpl->diskIOThreadPool.reset();
 	pimpl->cpuThreadPool.reset();
 	pimpl->cpuAuxThreadPool.reset();
@@ -0,0 +1,337 @@
+#include "game/rollback_session.h"
+#include "halley/entity/world.h"
+#include "halley/net/session/network_session.h"
+#include "halley/bytes/byte_serializer.h"
+#include "halley/support/exception.h"
+#include "halley/text/string_converter.h"
+#include "halley/utils/hash.h"
+
+using namespace Halley;
+
+namespace {
+	enum class RollbackPacketType : uint8_t {
+		Inputs,
+		Game
+	};
+
+	struct RollbackPacketHeader
+	{
+		RollbackPacketType type;
+	};
+
+	struct RollbackInputsMsg
+	{
+		int8_t player = -1;
+		uint32_t firstFrame = 0;
+		std::vector<Bytes> inputs;
+
+		void serialize(Serializer& s) const
+		{
+			s << player;
+			s << firstFrame;
+			s << uint8_t(inputs.size());
+			for (auto& i: inputs) {
+				s << i;
+			}
+		}
+
+		void deserialize(Deserializer& s)
+		{
+			uint8_t count;
+			s >> player;
+			s >> firstFrame;
+			s >> count;
+			inputs.resize(count);
+			for (auto& i: inputs) {
+				s >> i;
+			}
+		}
+	};
+}
+
+RollbackSession::RollbackSession(World& world, NetworkSession& session, Config config)
+	: world(world)
+	, session(session)
+	, config(config)
+	, historySize(size_t(config.maxRollback + config.inputDelay + config.inputRedundancy) * 2)
+{
+	Expects(config.numPlayers > 0);
+	Expects(config.inputDelay >= 0);
+	Expects(config.maxRollback > 0);
+	Expects(config.inputRedundancy > 0);
+
+	if (!world.isDeterministic()) {
+		throw Exception("Rollback requires a World in deterministic mode.", HalleyExceptions::Network);
+	}
+
+	players.resize(config.numPlayers);
+	for (int i = 0; i < config.numPlayers; ++i) {
+		players[i].slots.resize(historySize);
+
+		// Nobody has any input for the first few frames
+		for (int j = 0; j < config.inputDelay; ++j) {
+			confirmInput(i, uint32_t(j), Bytes());
+		}
+	}
+	snapshots.resize(size_t(config.maxRollback) + 2);
+	frameInputs.resize(config.numPlayers, nullptr);
+	framePredicted.resize(config.numPlayers, 0);
+}
+
+void RollbackSession::setLocalInput(Bytes input)
+{
+	localInput = std::move(input);
+}
+
+void RollbackSession::update(Time elapsed)
+{
+	const int local = getLocalPlayer();
+	if (local < 0) {
+		// Not connected yet
+		return;
+	}
+
+	receivePackets();
+	lastRollbackLength = 0;
+	if (rollbackFrom < frame) {
+		rollback();
+	}
+	rollbackFrom = uint32_t(-1);
+
+	accumulator += elapsed;
+	stalled = false;
+	while (accumulator >= config.fixedStep) {
+		if (!canAdvance()) {
+			// Don't try to catch up all at once when the inputs do arrive
+			stalled = true;
+			accumulator = std::min(accumulator, config.fixedStep);
+			break;
+		}
+		accumulator -= config.fixedStep;
+
+		const uint32_t inputFrame = frame + uint32_t(config.inputDelay);
+		confirmInput(local, inputFrame, localInput);
+		sendLocalInputs(inputFrame);
+		simulateFrame(frame, true);
+		++frame;
+	}
+
+	reportHashes();
+}
+
+const Bytes& RollbackSession::getInput(int player) const
+{
+	const auto input = frameInputs.at(player);
+	if (!input) {
+		throw Exception("No frame is being simulated.", HalleyExceptions::Network);
+	}
+	return *input;
+}
+
+bool RollbackSession::isInputPredicted(int player) const
+{
+	return framePredicted.at(player) != 0;
+}
+
+uint32_t RollbackSession::getFrame() const
+{
+	return frame;
+}
+
+uint32_t RollbackSession::getConfirmedFrame() const
+{
+	uint32_t result = frame;
+	for (auto& p: players) {
+		result = std::min(result, p.confirmedUpTo);
+	}
+	return result;
+}
+
+int RollbackSession::getLastRollbackLength() const
+{
+	return lastRollbackLength;
+}
+
+bool RollbackSession::isStalled() const
+{
+	return stalled;
+}
+
+void RollbackSession::send(OutboundNetworkPacket&& packet)
+{
+	RollbackPacketHeader header;
+	header.type = RollbackPacketType::Game;
+	packet.addHeader(header);
+	session.send(std::move(packet));
+}
+
+bool RollbackSession::receive(InboundNetworkPacket& packet)
+{
+	receivePackets();
+	if (gameInbox.empty()) {
+		return false;
+	}
+	packet = std::move(gameInbox.front());
+	gameInbox.erase(gameInbox.begin());
+	return true;
+}
+
+int RollbackSession::getLocalPlayer() const
+{
+	const int id = session.getMyPeerId();
+	return id < config.numPlayers ? id : -1;
+}
+
+RollbackSession::InputSlot& RollbackSession::getSlot(int player, uint32_t f)
+{
+	return players[player].slots[f % historySize];
+}
+
+void RollbackSession::confirmInput(int player, uint32_t f, Bytes input)
+{
+	auto& p = players[player];
+	if (f < p.confirmedUpTo || f >= p.confirmedUpTo + historySize) {
+		// Either a resend of something we already have, or too far ahead to keep
+		return;
+	}
+
+	auto& slot = getSlot(player, f);
+	if (slot.frame == f && slot.confirmed) {
+		return;
+	}
+	if (slot.usedFrame == f && slot.used != input) {
+		rollbackFrom = std::min(rollbackFrom, f);
+	}
+	slot.frame = f;
+	slot.confirmed = true;
+	slot.input = std::move(input);
+
+	while (true) {
+		auto& next = getSlot(player, p.confirmedUpTo);
+		if (next.frame != p.confirmedUpTo || !next.confirmed) {
+			break;
+		}
+		++p.confirmedUpTo;
+	}
+}
+
+void RollbackSession::receivePackets()
+{
+	InboundNetworkPacket packet;
+	while (session.receive(packet)) {
+		RollbackPacketHeader header;
+		packet.extractHeader(header);
+		if (header.type == RollbackPacketType::Inputs) {
+			onInputs(packet.getBytes());
+		} else {
+			gameInbox.emplace_back(std::move(packet));
+		}
+	}
+}
+
+void RollbackSession::onInputs(gsl::span<const gsl::byte> data)
+{
+	auto msg = Deserializer::fromBytes<RollbackInputsMsg>(data);
+	if (msg.player < 0 || msg.player >= config.numPlayers || msg.player == getLocalPlayer()) {
+		return;
+	}
+	for (size_t i = 0; i < msg.inputs.size(); ++i) {
+		confirmInput(msg.player, msg.firstFrame + uint32_t(i), std::move(msg.inputs[i]));
+	}
+}
+
+void RollbackSession::sendLocalInputs(uint32_t lastFrame)
+{
+	const int local = getLocalPlayer();
+	const uint32_t count = std::min(uint32_t(config.inputRedundancy), lastFrame + 1);
+
+	RollbackInputsMsg msg;
+	msg.player = int8_t(local);
+	msg.firstFrame = lastFrame + 1 - count;
+	for (uint32_t f = msg.firstFrame; f <= lastFrame; ++f) {
+		msg.inputs.push_back(getSlot(local, f).input);
+	}
+
+	OutboundNetworkPacket packet(Serializer::toBytes(msg));
+	RollbackPacketHeader header;
+	header.type = RollbackPacketType::Inputs;
+	packet.addHeader(header);
+	session.send(std::move(packet));
+}
+
+bool RollbackSession::canAdvance() const
+{
+	// The snapshot before the oldest frame anyone might still send a correction for must stay in the ring
+	for (auto& p: players) {
+		if (frame >= p.confirmedUpTo + uint32_t(config.maxRollback)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void RollbackSession::simulateFrame(uint32_t f, bool takeSnapshot)
+{
+	if (takeSnapshot) {
+		auto& snapshot = snapshots[f % snapshots.size()];
+		snapshot.frame = f;
+		world.saveSnapshot(snapshot.data);
+	}
+
+	for (int i = 0; i < config.numPlayers; ++i) {
+		const auto& p = players[i];
+		auto& slot = getSlot(i, f);
+		if (slot.frame != f) {
+			slot.frame = f;
+			slot.confirmed = false;
+			slot.input.clear();
+		}
+
+		// Remote players are assumed to keep doing whatever they were last known to do
+		const bool predicted = !slot.confirmed;
+		slot.usedFrame = f;
+		if (predicted) {
+			slot.used = p.confirmedUpTo > 0 ? getSlot(i, p.confirmedUpTo - 1).input : Bytes();
+		} else {
+			slot.used = slot.input;
+		}
+		frameInputs[i] = &slot.used;
+		framePredicted[i] = predicted ? 1 : 0;
+	}
+
+	world.step(TimeLine::FixedUpdate, config.fixedStep);
+
+	for (auto& i: frameInputs) {
+		i = nullptr;
+	}
+}
+
+void RollbackSession::rollback()
+{
+	const auto& snapshot = snapshots[rollbackFrom % snapshots.size()];
+	if (snapshot.frame != rollbackFrom) {
+		throw Exception("Can't roll back to frame " + toString(rollbackFrom) + ", as its snapshot is gone.", HalleyExceptions::Network);
+	}
+
+	world.loadSnapshot(snapshot.data);
+	world.setResimulating(true);
+	for (uint32_t f = rollbackFrom; f < frame; ++f) {
+		// The first one's snapshot is what was just loaded
+		simulateFrame(f, f != rollbackFrom);
+	}
+	world.setResimulating(false);
+	lastRollbackLength = int(frame - rollbackFrom);
+}
+
+void RollbackSession::reportHashes()
+{
+	// A frame is final once everyone's inputs for it are in; the state after it is the snapshot taken before the next one
+	const uint32_t confirmed = getConfirmedFrame();
+	while (nextHashFrame < confirmed && nextHashFrame + 1 < frame) {
+		const auto& snapshot = snapshots[(nextHashFrame + 1) % snapshots.size()];
+		if (snapshot.frame == nextHashFrame + 1) {
+			session.reportStateHash(nextHashFrame, Hash::hashXXH64(gsl::as_bytes(gsl::span<const Byte>(snapshot.data))));
+		}
+		++nextHashFrame;
+	}
+}
@@ -52,6 +52,12 @@ Camera& Camera::setAngle(Angle1f _angle)
 	return *this;
 }
 
+Camera& Camera::setTransform(const Transform2D& transform)
+{
+	setPosition(transform.position);
+	return setAngle(transform.rotation);
+}
+
 
 Camera& Camera::setZoom(float _zoom)
 {
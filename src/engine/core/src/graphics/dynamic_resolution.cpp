@@ -0,0 +1,146 @@
+#include "halley/core/graphics/dynamic_resolution.h"
+#include "halley/core/graphics/material/material.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include "halley/core/graphics/material/material_parameter.h"
+#include "halley/core/graphics/painter.h"
+#include "halley/core/graphics/render_context.h"
+#include "halley/core/graphics/texture.h"
+#include "halley/core/api/video_api.h"
+#include "resources/resources.h"
+#include <halley/utils/utils.h>
+#include <gsl/gsl_assert>
+#include <cmath>
+
+using namespace Halley;
+
+DynamicResolution::DynamicResolution(Resources& resources, Config config)
+	: config(config)
+	, upscaleMaterial(std::make_shared<Material>(resources.get<MaterialDefinition>("Halley/Upscale")))
+	, scale(config.maxScale)
+{
+	Expects(upscaleMaterial->getDefinition().getVertexStride() == sizeof(UpscaleVertexAttrib));
+	Expects(config.targetGPUTime > 0);
+	Expects(config.minScale > 0 && config.minScale <= config.maxScale);
+	Expects(config.maxScale <= 1.0f); // The target is only as big as the output
+}
+
+void DynamicResolution::update(const VideoAPI& video)
+{
+	const int64_t gpuTime = video.getGPUFrameNanoSeconds();
+	if (!automatic || gpuTime <= 0) {
+		return;
+	}
+
+	// Smoothed, so a single slow frame doesn't drop the resolution
+	const Time frameTime = Time(gpuTime) / 1000000000.0;
+	averageGPUTime = averageGPUTime > 0 ? lerp(averageGPUTime, frameTime, 0.25f) : frameTime;
+
+	if (++framesSinceChange < config.settleFrames) {
+		return;
+	}
+
+	// Between the lower and the upper end of the budget, it's close enough, so it stays put instead of going back and forth
+	const Time upper = config.targetGPUTime;
+	const Time lower = config.targetGPUTime * (1.0 - config.headroom);
+	if (averageGPUTime <= upper && averageGPUTime >= lower) {
+		return;
+	}
+	if (averageGPUTime < lower && scale >= config.maxScale) {
+		return;
+	}
+	if (averageGPUTime > upper && scale <= config.minScale) {
+		return;
+	}
+
+	// Aims for the middle of the budget, assuming the time goes with the number of pixels, i.e. the square of the scale
+	const float ideal = scale * float(std::sqrt((upper + lower) * 0.5 / averageGPUTime));
+	setScale(lerp(scale, ideal, config.responsiveness));
+}
+
+void DynamicResolution::setAutomatic(bool a)
+{
+	automatic = a;
+}
+
+bool DynamicResolution::isAutomatic() const
+{
+	return automatic;
+}
+
+void DynamicResolution::setScale(float s)
+{
+	const float newScale = clamp(s, config.minScale, config.maxScale);
+	if (newScale != scale) {
+		scale = newScale;
+		framesSinceChange = 0;
+	}
+}
+
+float DynamicResolution::getScale() const
+{
+	return scale;
+}
+
+Vector2i DynamicResolution::getScaledSize(Vector2i size) const
+{
+	return Vector2i(std::max(1, int(std::lround(size.x * scale))), std::max(1, int(std::lround(size.y * scale))));
+}
+
+void DynamicResolution::addPasses(RenderGraph& graph, RenderGraph::TargetId output, Vector2i size, Camera& camera, std::function<void(Painter&)> drawScene)
+{
+	Expects(drawScene);
+
+	nativeSize = size;
+	scene = graph.createTarget("dynamicResolutionScene", RenderGraph::TargetDefinition(size, TextureFormat::RGBA, true));
+
+	graph.addPass("dynamicResolutionScene", [=] (RenderGraph::PassBuilder& pass)
+	{
+		pass.write(scene);
+	}, [this, &camera, drawScene] (RenderContext& context, const RenderGraph&)
+	{
+		// The same view, squeezed into the scaled down part of the target
+		drawnSize = getScaledSize(nativeSize);
+		sceneCamera = camera;
+		sceneCamera.setViewPort(Rect4i(Vector2i(), drawnSize));
+		sceneCamera.setZoom(camera.getZoom() * float(drawnSize.x) / float(nativeSize.x));
+
+		context.with(sceneCamera).bind([&] (Painter& painter)
+		{
+			painter.clear(Colour4f(0, 0, 0, 1));
+			drawScene(painter);
+		});
+	});
+
+	graph.addPass("dynamicResolutionUpscale", [=] (RenderGraph::PassBuilder& pass)
+	{
+		pass.read(scene);
+		pass.write(output);
+	}, [this, &camera] (RenderContext& context, const RenderGraph& graph)
+	{
+		context.with(camera).bind([&] (Painter& painter)
+		{
+			drawUpscale(painter, graph);
+		});
+	});
+}
+
+RenderGraph::TargetId DynamicResolution::getSceneTarget() const
+{
+	return scene;
+}
+
+void DynamicResolution::drawUpscale(Painter& painter, const RenderGraph& graph)
+{
+	const Rect4f view = painter.getCurrentCamera().getClippingRectangle();
+	UpscaleVertexAttrib vertex;
+	vertex.position = view.getCenter();
+	vertex.size = view.getSize();
+
+	// Nothing to make up for when it's drawn at full size
+	const bool scaled = drawnSize != nativeSize;
+	upscaleMaterial->set("tex0", graph.getTexture(scene));
+	upscaleMaterial->set("u_uvScale", Vector2f(drawnSize) / Vector2f(nativeSize));
+	upscaleMaterial->set("u_texelSize", Vector2f(1.0f / nativeSize.x, 1.0f / nativeSize.y));
+	upscaleMaterial->set("u_sharpness", scaled ? config.sharpness : 0.0f);
+	painter.drawSprites(upscaleMaterial, 1, &vertex);
+}
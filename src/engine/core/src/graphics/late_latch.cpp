@@ -0,0 +1,48 @@
+#include "graphics/late_latch.h"
+#include "graphics/material/material.h"
+#include "graphics/material/material_parameter.h"
+#include "api/input_api.h"
+#include <algorithm>
+#include <gsl/gsl_assert>
+
+using namespace Halley;
+
+LateLatch::Handle LateLatch::add(std::shared_ptr<Material> material, Sampler sampler)
+{
+	Expects(material);
+	Expects(sampler);
+
+	const Handle handle = nextHandle++;
+	entries.push_back(Entry{ handle, std::move(material), std::move(sampler) });
+	return handle;
+}
+
+LateLatch::Handle LateLatch::addMousePosition(std::shared_ptr<Material> material, const String& parameter, std::shared_ptr<InputDevice> mouse, std::function<Vector2f(Vector2f)> transform)
+{
+	Expects(mouse);
+
+	return add(std::move(material), [=] (Material& m)
+	{
+		const auto pos = mouse->getPosition();
+		m.set(parameter, transform ? transform(pos) : pos);
+	});
+}
+
+void LateLatch::remove(Handle handle)
+{
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [&] (const Entry& e) { return e.handle == handle; }), entries.end());
+}
+
+void LateLatch::latch(InputAPI* input)
+{
+	if (entries.empty()) {
+		return;
+	}
+
+	if (input) {
+		input->sampleLateInput();
+	}
+	for (auto& entry: entries) {
+		entry.sampler(*entry.material);
+	}
+}
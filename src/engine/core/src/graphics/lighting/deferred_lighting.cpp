@@ -0,0 +1,120 @@
+#include "halley/core/graphics/lighting/deferred_lighting.h"
+#include "halley/core/graphics/material/material.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include "halley/core/graphics/material/material_parameter.h"
+#include "halley/core/graphics/painter.h"
+#include "halley/core/graphics/camera.h"
+#include "halley/core/graphics/render_context.h"
+#include "halley/core/graphics/texture.h"
+#include "resources/resources.h"
+#include <gsl/gsl_assert>
+
+using namespace Halley;
+
+DeferredLighting::DeferredLighting(Resources& resources)
+	: lightMaterial(std::make_shared<Material>(resources.get<MaterialDefinition>("Halley/Light2D")))
+{
+	Expects(lightMaterial->getDefinition().getVertexStride() == sizeof(Light2DVertexAttrib));
+}
+
+void DeferredLighting::setAmbient(Colour4f colour)
+{
+	ambient = colour;
+}
+
+Colour4f DeferredLighting::getAmbient() const
+{
+	return ambient;
+}
+
+void DeferredLighting::clearLights()
+{
+	lights.clear();
+}
+
+void DeferredLighting::addLight(const PointLight2D& light)
+{
+	Expects(light.radius > 0);
+	lights.push_back(light);
+}
+
+size_t DeferredLighting::getNumLights() const
+{
+	return lights.size();
+}
+
+void DeferredLighting::addPasses(RenderGraph& graph, RenderGraph::TargetId output, Vector2i size, Camera& camera, std::function<void(Painter&)> drawScene)
+{
+	Expects(drawScene);
+
+	albedo = graph.createTarget("lightingAlbedo", RenderGraph::TargetDefinition(size));
+	normals = graph.createTarget("lightingNormals", RenderGraph::TargetDefinition(size));
+
+	graph.addPass("lightingScene", [=] (RenderGraph::PassBuilder& pass)
+	{
+		pass.write(albedo);
+		pass.write(normals);
+	}, [&camera, drawScene] (RenderContext& context, const RenderGraph&)
+	{
+		context.with(camera).bind([&] (Painter& painter)
+		{
+			// Nothing drawn means no normal, which lighting treats as facing the camera
+			painter.clear(Colour4f(0, 0, 0, 0));
+			drawScene(painter);
+		});
+	});
+
+	graph.addPass("lightingLights", [=] (RenderGraph::PassBuilder& pass)
+	{
+		pass.read(albedo);
+		pass.read(normals);
+		pass.write(output);
+	}, [this, &camera] (RenderContext& context, const RenderGraph& graph)
+	{
+		context.with(camera).bind([&] (Painter& painter)
+		{
+			painter.clear(Colour4f(0, 0, 0, 0));
+			drawLights(painter, graph);
+		});
+	});
+}
+
+RenderGraph::TargetId DeferredLighting::getAlbedoTarget() const
+{
+	return albedo;
+}
+
+RenderGraph::TargetId DeferredLighting::getNormalTarget() const
+{
+	return normals;
+}
+
+void DeferredLighting::drawLights(Painter& painter, const RenderGraph& graph)
+{
+	const Rect4f view = painter.getCurrentCamera().getClippingRectangle();
+
+	// The ambient term is just another instance, covering the whole view
+	vertices.clear();
+	Light2DVertexAttrib vertex;
+	vertex.position = view.getCenter();
+	vertex.size = view.getSize();
+	vertex.colour = ambient;
+	vertex.params = Vector4f(1, 0, 1, 0);
+	vertices.push_back(vertex);
+
+	for (auto& light: lights) {
+		const Rect4f bounds(light.position - Vector2f(light.radius, light.radius), light.position + Vector2f(light.radius, light.radius));
+		if (!bounds.overlaps(view)) {
+			continue;
+		}
+		vertex.position = light.position;
+		vertex.size = Vector2f(light.radius, light.radius) * 2;
+		vertex.colour = Colour4f(light.colour.r * light.intensity, light.colour.g * light.intensity, light.colour.b * light.intensity, 1);
+		vertex.params = Vector4f(light.radius, light.height, 0, 0);
+		vertices.push_back(vertex);
+	}
+
+	lightMaterial->set("tex0", graph.getTexture(albedo));
+	lightMaterial->set("tex1", graph.getTexture(normals));
+	painter.drawSprites(lightMaterial, vertices.size(), vertices.data());
+}
@@ -6,38 +6,109 @@
 #include "halley/core/graphics/shader.h"
 #include "api/video_api.h"
 #include "halley/utils/hash.h"
+#include "halley/data_structures/hash_map.h"
+#include <mutex>
 
 using namespace Halley;
 
-static Material* currentMaterial = nullptr;
-static int currentPass = 0;
+// Per thread, as frames can be submitted from a render thread while another one is recording
+static thread_local Material* currentMaterial = nullptr;
+static thread_local int currentPass = 0;
 
 constexpr static int shaderStageCount = int(ShaderType::NumOfShaderTypes);
 
+namespace {
+	// Blocks with the same contents share a constant buffer, e.g. across clones of a material, or UI elements of the same colour.
+	// A buffer only ever has the contents it's keyed by, so it's only updated in place when a single block owns it.
+	class ConstantBufferCache
+	{
+	public:
+		std::shared_ptr<MaterialConstantBuffer> get(VideoAPI& api, const MaterialDataBlock& block, std::shared_ptr<MaterialConstantBuffer> current, uint64_t currentHash)
+		{
+			const uint64_t hash = block.getHash();
+
+			std::unique_lock<std::mutex> lock(mutex);
+			auto iter = buffers.find(hash);
+			if (iter != buffers.end()) {
+				auto buffer = iter->second.lock();
+				if (buffer) {
+					return buffer;
+				}
+			}
+
+			std::shared_ptr<MaterialConstantBuffer> buffer;
+			if (current && current.use_count() == 1) {
+				// Nobody else can see it, so it can take the new contents
+				auto oldIter = buffers.find(currentHash);
+				if (oldIter != buffers.end() && oldIter->second.lock() == current) {
+					buffers.erase(oldIter);
+				}
+				buffer = std::move(current);
+			} else {
+				buffer = api.createConstantBuffer();
+			}
+			buffer->update(block);
+			buffers[hash] = buffer;
+
+			if (buffers.size() > sweepThreshold) {
+				for (auto i = buffers.begin(); i != buffers.end(); ) {
+					if (i->second.expired()) {
+						i = buffers.erase(i);
+					} else {
+						++i;
+					}
+				}
+				sweepThreshold = std::max(size_t(64), buffers.size() * 2);
+			}
+
+			return buffer;
+		}
+
+	private:
+		std::mutex mutex;
+		HashMap<uint64_t, std::weak_ptr<MaterialConstantBuffer>> buffers;
+		size_t sweepThreshold = 64;
+	};
+
+	ConstantBufferCache& getConstantBufferCache()
+	{
+		static ConstantBufferCache cache;
+		return cache;
+	}
+}
+
 MaterialDataBlock::MaterialDataBlock()
 {
 }
 
 MaterialDataBlock::MaterialDataBlock(MaterialDataBlockType type, size_t size, int bindPoint, const String& name, const MaterialDefinition& def)
 	: data(type == MaterialDataBlockType::SharedExternal ? 0 : size, 0)
-	, addresses(def.getNumPasses() * shaderStageCount)
+	, addresses(def.getNumPasses() * def.getNumVariants() * shaderStageCount)
 	, dataBlockType(type)
 	, bindPoint(bindPoint)
+	, numVariants(def.getNumVariants())
 {
 	for (int i = 0; i < def.getNumPasses(); ++i) {
-		auto& shader = def.getPass(i).getShader();
-		for (int j = 0; j < shaderStageCount; ++j) {
-			addresses[i * shaderStageCount + j] = shader.getBlockLocation(name, ShaderType(j));
+		for (int v = 0; v < numVariants; ++v) {
+			auto& shader = def.getPass(i).getShader(v);
+			for (int j = 0; j < shaderStageCount; ++j) {
+				addresses[(i * numVariants + v) * shaderStageCount + j] = shader.getBlockLocation(name, ShaderType(j));
+			}
 		}
 	}
 }
 
 MaterialDataBlock::MaterialDataBlock(const MaterialDataBlock& other)
-	: data(other.data)
+	: constantBuffer(other.constantBuffer)
+	, data(other.data)
 	, addresses(other.addresses)
 	, dataBlockType(other.dataBlockType)
 	, bindPoint(other.bindPoint)
-	, dirty(true)
+	, numVariants(other.numVariants)
+	, dirty(other.dirty)
+	, needToUpdateHash(other.needToUpdateHash)
+	, hashValue(other.hashValue)
+	, uploadedHash(other.uploadedHash)
 {}
 
 MaterialDataBlock::MaterialDataBlock(MaterialDataBlock&& other) noexcept
@@ -46,7 +117,11 @@ MaterialDataBlock::MaterialDataBlock(MaterialDataBlock&& other) noexcept
 	, addresses(std::move(other.addresses))
 	, dataBlockType(other.dataBlockType)
 	, bindPoint(other.bindPoint)
+	, numVariants(other.numVariants)
 	, dirty(other.dirty)
+	, needToUpdateHash(other.needToUpdateHash)
+	, hashValue(other.hashValue)
+	, uploadedHash(other.uploadedHash)
 {}
 
 MaterialConstantBuffer& MaterialDataBlock::getConstantBuffer() const
@@ -55,9 +130,9 @@ MaterialConstantBuffer& MaterialDataBlock::getConstantBuffer() const
 	return *constantBuffer;
 }
 
-int MaterialDataBlock::getAddress(int pass, ShaderType stage) const
+int MaterialDataBlock::getAddress(int pass, ShaderType stage, int variant) const
 {
-	return addresses[pass * shaderStageCount + int(stage)];
+	return addresses[(pass * numVariants + variant) * shaderStageCount + int(stage)];
 }
 
 int MaterialDataBlock::getBindPoint() const
@@ -75,6 +150,17 @@ MaterialDataBlockType MaterialDataBlock::getType() const
 	return dataBlockType;
 }
 
+uint64_t MaterialDataBlock::getHash() const
+{
+	if (needToUpdateHash) {
+		Hash::Hasher hasher;
+		hasher.feedBytes(getData());
+		hashValue = hasher.digest();
+		needToUpdateHash = false;
+	}
+	return hashValue;
+}
+
 bool MaterialDataBlock::setUniform(size_t offset, ShaderParameterType type, void* srcData)
 {
 	Expects(dataBlockType != MaterialDataBlockType::SharedExternal);
@@ -86,6 +172,22 @@ bool MaterialDataBlock::setUniform(size_t offset, ShaderParameterType type, void
 	if (memcmp(data.data() + offset, srcData, size) != 0) {
 		memcpy(data.data() + offset, srcData, size);
 		dirty = true;
+		needToUpdateHash = true;
+		return true;
+	} else {
+		return false;
+	}
+}
+
+bool MaterialDataBlock::setData(gsl::span<const gsl::byte> srcData)
+{
+	Expects(dataBlockType != MaterialDataBlockType::SharedExternal);
+	Expects(size_t(srcData.size()) == data.size());
+
+	if (memcmp(data.data(), srcData.data(), data.size()) != 0) {
+		memcpy(data.data(), srcData.data(), data.size());
+		dirty = true;
+		needToUpdateHash = true;
 		return true;
 	} else {
 		return false;
@@ -94,15 +196,10 @@ bool MaterialDataBlock::setUniform(size_t offset, ShaderParameterType type, void
 
 void MaterialDataBlock::upload(VideoAPI* api)
 {
-	if (dataBlockType != MaterialDataBlockType::SharedExternal) {
-		if (!constantBuffer) {
-			constantBuffer = api->createConstantBuffer();
-			dirty = true;
-		}
-		if (dirty) {
-			constantBuffer->update(*this);
-			dirty = false;
-		}
+	if (dataBlockType != MaterialDataBlockType::SharedExternal && (dirty || !constantBuffer)) {
+		constantBuffer = getConstantBufferCache().get(*api, *this, std::move(constantBuffer), uploadedHash);
+		uploadedHash = getHash();
+		dirty = false;
 	}
 }
 
@@ -113,6 +210,8 @@ Material::Material(const Material& other)
 	, dataBlocks(other.dataBlocks)
 	, textures(other.textures)
 	, passEnabled(other.passEnabled)
+	, keywordMask(other.keywordMask)
+	, variant(other.variant)
 {
 	for (auto& u: uniforms) {
 		u.rebind(*this);
@@ -164,6 +263,41 @@ void Material::bind(int passNumber, Painter& painter)
 	painter.setMaterialPass(*this, passNumber);
 }
 
+Material& Material::setKeyword(const String& keyword, bool enabled)
+{
+	const uint32_t bit = materialDefinition->getKeywordMask(keyword);
+	return setKeywords(enabled ? (keywordMask | bit) : (keywordMask & ~bit));
+}
+
+Material& Material::setKeywords(uint32_t mask)
+{
+	if (mask != keywordMask) {
+		const int index = materialDefinition->getVariantIndex(mask);
+		if (index == -1) {
+			String names;
+			for (size_t i = 0; i < materialDefinition->getKeywords().size(); ++i) {
+				if (mask & (uint32_t(1) << i)) {
+					names += (names.isEmpty() ? "" : ", ") + materialDefinition->getKeywords()[i];
+				}
+			}
+			throw Exception("Material \"" + materialDefinition->getName() + "\" has no variant compiled with keywords [" + names + "]", HalleyExceptions::Graphics);
+		}
+
+		keywordMask = mask;
+		variant = index;
+		needToUpdateHash = true;
+		if (currentMaterial == this) {
+			currentMaterial = nullptr;
+		}
+	}
+	return *this;
+}
+
+bool Material::hasKeyword(const String& keyword) const
+{
+	return (keywordMask & materialDefinition->getKeywordMask(keyword)) != 0;
+}
+
 void Material::uploadData(Painter& painter)
 {	
 	if (needToUploadData) {
@@ -245,6 +379,18 @@ void Material::setUniform(int blockNumber, size_t offset, ShaderParameterType ty
 	}
 }
 
+Material& Material::setBlockData(int blockIndex, gsl::span<const gsl::byte> data)
+{
+	if (blockIndex < 0 || blockIndex >= int(dataBlocks.size())) {
+		throw Exception("Uniform block " + toString(blockIndex) + " not available in material \"" + materialDefinition->getName() + "\"", HalleyExceptions::Graphics);
+	}
+	if (dataBlocks[blockIndex].setData(data)) {
+		needToUploadData = true;
+		needToUpdateHash = true;
+	}
+	return *this;
+}
+
 uint64_t Material::computeHash() const
 {
 	Hash::Hasher hasher;
@@ -254,10 +400,11 @@ uint64_t Material::computeHash() const
 	}
 
 	for (const auto& dataBlock: dataBlocks) {
-		hasher.feedBytes(dataBlock.getData());
+		hasher.feed(dataBlock.getHash());
 	}
 
 	hasher.feedBytes(gsl::as_bytes(gsl::span<const char>(passEnabled.data(), passEnabled.size())));
+	hasher.feed(keywordMask);
 
 	return hasher.digest();
 }
@@ -349,6 +496,14 @@ MaterialParameter& Material::getParameter(const String& name)
 	throw Exception("Uniform \"" + name + "\" not available in material \"" + materialDefinition->getName() + "\"", HalleyExceptions::Graphics);
 }
 
+MaterialParameter& Material::getParameter(int index)
+{
+	if (index < 0 || index >= int(uniforms.size())) {
+		throw Exception("Uniform " + toString(index) + " not available in material \"" + materialDefinition->getName() + "\"", HalleyExceptions::Graphics);
+	}
+	return uniforms[index];
+}
+
 std::shared_ptr<Material> Material::clone() const
 {
 	return std::make_shared<Material>(*this);
@@ -9,6 +9,7 @@
 #include "halley/text/string_converter.h"
 #include "halley/file_formats/binary_file.h"
 #include "halley/file_formats/config_file.h"
+#include <algorithm>
 
 using namespace Halley;
 
@@ -71,6 +72,7 @@ void MaterialAttribute::serialize(Serializer& s) const
 	s << type;
 	s << location;
 	s << offset;
+	s << instanced;
 }
 
 void MaterialAttribute::deserialize(Deserializer& s)
@@ -79,6 +81,7 @@ void MaterialAttribute::deserialize(Deserializer& s)
 	s >> type;
 	s >> location;
 	s >> offset;
+	s >> instanced;
 }
 
 size_t MaterialAttribute::getAttributeSize(ShaderParameterType type)
@@ -96,6 +99,7 @@ size_t MaterialAttribute::getAttributeSize(ShaderParameterType type)
 		case ShaderParameterType::Matrix3: return 36;
 		case ShaderParameterType::Matrix4: return 64;
 		case ShaderParameterType::Texture2D: return 4;
+		case ShaderParameterType::Texture2DArray: return 4;
 		default: throw Exception("Unknown type: " + toString(int(type)), HalleyExceptions::Resources);
 	}
 }
@@ -111,7 +115,7 @@ MaterialDefinition::MaterialDefinition(ResourceLoader& loader)
 	api = loader.getAPI().video;
 	int i = 0;
 	for (auto& p: passes) {
-		p.createShader(loader, name + "/pass" + toString(i++), attributes);
+		p.createShaders(loader, name + "/pass" + toString(i++), attributes, variants);
 	}
 }
 
@@ -136,6 +140,31 @@ void MaterialDefinition::load(const ConfigNode& root)
 	if (root.hasKey("textures")) {
 		loadTextures(root["textures"]);
 	}
+
+	// Inherited from the base material unless overriden; applies to its attributes too
+	if (root.hasKey("instanced")) {
+		instanced = root["instanced"].asBool();
+	}
+	if (instanced) {
+		auto iter = std::find_if(attributes.begin(), attributes.end(), [] (const MaterialAttribute& a) { return a.name == "a_vertPos"; });
+		if (iter == attributes.end() || iter->type != ShaderParameterType::Float4) {
+			throw Exception("Instanced material \"" + name + "\" needs an a_vertPos vec4 attribute", HalleyExceptions::Resources);
+		}
+	}
+	for (auto& a: attributes) {
+		a.instanced = instanced && a.name != "a_vertPos";
+	}
+
+	// Not inherited, as it depends on the shaders
+	shaderClip = root["shaderClip"].asBool(false);
+	if (shaderClip) {
+		auto iter = std::find_if(attributes.begin(), attributes.end(), [] (const MaterialAttribute& a) { return a.name == "a_clip"; });
+		if (iter == attributes.end() || iter->type != ShaderParameterType::Float4) {
+			throw Exception("Material \"" + name + "\" clips in its shaders, so it needs an a_clip vec4 attribute", HalleyExceptions::Resources);
+		}
+	}
+
+	loadVariants(root);
 }
 
 int MaterialDefinition::getNumPasses() const
@@ -177,6 +206,56 @@ size_t MaterialDefinition::getVertexPosOffset() const
 	return size_t(vertexPosOffset);
 }
 
+bool MaterialDefinition::isInstanced() const
+{
+	return instanced;
+}
+
+bool MaterialDefinition::hasShaderClip() const
+{
+	return shaderClip;
+}
+
+uint32_t MaterialDefinition::getKeywordMask(const String& keyword) const
+{
+	for (size_t i = 0; i < keywords.size(); ++i) {
+		if (keywords[i] == keyword) {
+			return uint32_t(1) << i;
+		}
+	}
+	throw Exception("Keyword \"" + keyword + "\" not available in material \"" + name + "\"", HalleyExceptions::Graphics);
+}
+
+int MaterialDefinition::getVariantIndex(uint32_t keywordMask) const
+{
+	auto iter = std::find(variants.begin(), variants.end(), keywordMask);
+	return iter != variants.end() ? int(iter - variants.begin()) : -1;
+}
+
+int MaterialDefinition::getUniformIndex(const String& uniformName) const
+{
+	int index = 0;
+	for (auto& block: uniformBlocks) {
+		for (auto& uniform: block.uniforms) {
+			if (uniform.name == uniformName) {
+				return index;
+			}
+			++index;
+		}
+	}
+	return -1;
+}
+
+int MaterialDefinition::getUniformBlockIndex(const String& blockName) const
+{
+	for (size_t i = 0; i < uniformBlocks.size(); ++i) {
+		if (uniformBlocks[i].name == blockName) {
+			return int(i);
+		}
+	}
+	return -1;
+}
+
 void MaterialDefinition::addPass(const MaterialPass& materialPass)
 {
 	passes.push_back(materialPass);
@@ -196,6 +275,10 @@ void MaterialDefinition::serialize(Serializer& s) const
 	s << attributes;
 	s << vertexSize;
 	s << vertexPosOffset;
+	s << instanced;
+	s << shaderClip;
+	s << keywords;
+	s << variants;
 }
 
 void MaterialDefinition::deserialize(Deserializer& s)
@@ -207,6 +290,50 @@ void MaterialDefinition::deserialize(Deserializer& s)
 	s >> attributes;
 	s >> vertexSize;
 	s >> vertexPosOffset;
+	s >> instanced;
+	s >> shaderClip;
+	s >> keywords;
+	s >> variants;
+}
+
+void MaterialDefinition::loadVariants(const ConfigNode& root)
+{
+	// Inherited from the base material unless overriden; without an explicit list, every combination of keywords is compiled
+	constexpr size_t maxKeywords = 32;
+	constexpr size_t maxImplicitKeywords = 6;
+
+	if (root.hasKey("keywords")) {
+		keywords.clear();
+		for (auto& k: root["keywords"].asSequence()) {
+			keywords.push_back(k.asString());
+		}
+		if (keywords.size() > maxKeywords) {
+			throw Exception("Material \"" + name + "\" has more than " + toString(maxKeywords) + " keywords", HalleyExceptions::Resources);
+		}
+
+		variants.clear();
+		if (!root.hasKey("variants")) {
+			if (keywords.size() > maxImplicitKeywords) {
+				throw Exception("Material \"" + name + "\" has " + toString(keywords.size()) + " keywords; list the \"variants\" it uses instead of compiling every combination", HalleyExceptions::Resources);
+			}
+			for (uint32_t mask = 0; mask < (uint32_t(1) << keywords.size()); ++mask) {
+				variants.push_back(mask);
+			}
+		}
+	}
+
+	if (root.hasKey("variants")) {
+		variants = { 0 };
+		for (auto& variantNode: root["variants"].asSequence()) {
+			uint32_t mask = 0;
+			for (auto& k: variantNode.asSequence()) {
+				mask |= getKeywordMask(k.asString());
+			}
+			if (getVariantIndex(mask) == -1) {
+				variants.push_back(mask);
+			}
+		}
+	}
 }
 
 void MaterialDefinition::loadUniforms(const ConfigNode& node)
@@ -236,8 +363,8 @@ void MaterialDefinition::loadTextures(const ConfigNode& node)
 		for (auto& it: attribEntry.asMap()) {
 			String name = it.first;
 			ShaderParameterType type = parseParameterType(it.second.asString());
-			if (type != ShaderParameterType::Texture2D) {
-				throw Exception("Texture \"" + name + "\" must be sampler2D", HalleyExceptions::Resources);
+			if (type != ShaderParameterType::Texture2D && type != ShaderParameterType::Texture2DArray) {
+				throw Exception("Texture \"" + name + "\" must be sampler2D or sampler2DArray", HalleyExceptions::Resources);
 			}
 
 			textures.push_back(name);
@@ -288,6 +415,8 @@ ShaderParameterType MaterialDefinition::parseParameterType(String rawType) const
 		return ShaderParameterType::Matrix4;
 	} else if (rawType == "sampler2D") {
 		return ShaderParameterType::Texture2D;
+	} else if (rawType == "sampler2DArray") {
+		return ShaderParameterType::Texture2DArray;
 	} else {
 		throw Exception("Unknown attribute type: " + rawType, HalleyExceptions::Resources);
 	}
@@ -354,6 +483,26 @@ void MaterialDepthStencil::deserialize(Deserializer& s)
 	s >> stencilOpStencilFail;
 }
 
+bool MaterialDepthStencil::operator==(const MaterialDepthStencil& other) const
+{
+	return enableDepthTest == other.enableDepthTest
+		&& enableDepthWrite == other.enableDepthWrite
+		&& enableStencilTest == other.enableStencilTest
+		&& stencilReference == other.stencilReference
+		&& stencilWriteMask == other.stencilWriteMask
+		&& stencilReadMask == other.stencilReadMask
+		&& depthComparison == other.depthComparison
+		&& stencilComparison == other.stencilComparison
+		&& stencilOpPass == other.stencilOpPass
+		&& stencilOpDepthFail == other.stencilOpDepthFail
+		&& stencilOpStencilFail == other.stencilOpStencilFail;
+}
+
+bool MaterialDepthStencil::operator!=(const MaterialDepthStencil& other) const
+{
+	return !(*this == other);
+}
+
 bool MaterialDepthStencil::isDepthTestEnabled() const
 {
 	return enableDepthTest;
@@ -454,16 +603,25 @@ void MaterialPass::deserialize(Deserializer& s)
 	s >> depthStencil;
 }
 
-void MaterialPass::createShader(ResourceLoader& loader, String name, const Vector<MaterialAttribute>& attributes)
+void MaterialPass::createShaders(ResourceLoader& loader, String name, const Vector<MaterialAttribute>& attributes, const Vector<uint32_t>& variants)
 {
 	auto& api = loader.getAPI();
 	auto& video = *api.video;
-	auto shaderData = api.getResource<ShaderFile>(shaderAssetId + ":" + video.getShaderLanguage());
 
-	ShaderDefinition definition;
-	definition.name = name;
-	definition.vertexAttributes = attributes;
-	definition.shaders = shaderData->shaders;
+	shaders.clear();
+	for (auto variant: variants) {
+		auto shaderData = api.getResource<ShaderFile>(getShaderAssetId(shaderAssetId, variant) + ":" + video.getShaderLanguage());
 
-	shader = video.createShader(definition);
+		ShaderDefinition definition;
+		definition.name = variant == 0 ? name : name + "/v" + toString(variant, 16);
+		definition.vertexAttributes = attributes;
+		definition.shaders = shaderData->shaders;
+
+		shaders.push_back(video.createShader(definition));
+	}
+}
+
+String MaterialPass::getShaderAssetId(const String& passName, uint32_t variant)
+{
+	return variant == 0 ? passName : passName + "_v" + toString(variant, 16);
 }
@@ -5,7 +5,9 @@
 #include "halley/core/graphics/texture.h"
 #include "halley/core/graphics/render_target/render_target_texture.h"
 #include "halley/core/api/video_api.h"
+#include "halley/core/graphics/material/material.h"
 #include "halley/core/graphics/material/material_definition.h"
+#include "halley/core/graphics/material/material_parameter.h"
 #include "halley/core/graphics/render_context.h"
 #include "halley/audio/audio_clip.h"
 #include <chrono>
@@ -90,6 +92,7 @@ void MoviePlayer::reset()
 	time = 0;
 
 	currentTexture.reset();
+	currentChroma.reset();
 	pendingFrames.clear();
 	streamingClip.reset();
 	if (audioHandle) {
@@ -129,13 +132,16 @@ void MoviePlayer::update(Time t)
 			if (!pendingFrames.empty()) {
 				auto& next = pendingFrames.front();
 				if (time >= next.time) {
-					if (currentTexture) {
+					if (currentChroma) {
+						recycleNativeFrames.push_back({ currentTexture, currentChroma });
+					} else if (currentTexture) {
 						if (shouldRecycleTextures()) {
 							recycleTexture.push_back(currentTexture);
 						}
 						onDoneUsingTexture(currentTexture);
 					}
 					currentTexture = next.texture;
+					currentChroma = next.chroma;
 					pendingFrames.pop_front();
 				}
 			}
@@ -167,9 +173,24 @@ void MoviePlayer::render(Resources& resources, RenderContext& rc)
 		auto c = rc.with(*renderTarget).with(cam);
 		c.bind([&] (Painter& painter)
 		{
-			auto matDef = resources.get<MaterialDefinition>("Halley/NV12Video");
-			Sprite().setImage(currentTexture, matDef).setTexRect(Rect4f(0, 0, 1, 1)).setSize(Vector2f(videoSize)).draw(painter);
+			if (currentChroma) {
+				if (!nativeMaterial) {
+					nativeMaterial = std::make_shared<Material>(resources.get<MaterialDefinition>("Halley/NV12VideoPlanar"));
+				}
+				nativeMaterial->set("tex0", currentTexture).set("tex1", currentChroma);
+				const auto texRect = Rect4f(Vector2f(), Vector2f(videoSize) / Vector2f(currentTexture->getSize()));
+				Sprite().setMaterial(nativeMaterial).setTexRect(texRect).setSize(Vector2f(videoSize)).draw(painter);
+			} else {
+				auto matDef = resources.get<MaterialDefinition>("Halley/NV12Video");
+				Sprite().setImage(currentTexture, matDef).setTexRect(Rect4f(0, 0, 1, 1)).setSize(Vector2f(videoSize)).draw(painter);
+			}
 		});
+
+		if (currentChroma) {
+			std::unique_lock<std::mutex> lock(aliveFlag->mutex);
+			recycleNativeFrames.push_back({ currentTexture, currentChroma });
+			currentChroma.reset();
+		}
 		currentTexture.reset();
 	}
 }
@@ -402,6 +423,37 @@ void MoviePlayer::onVideoFrameAvailable(Time time, std::shared_ptr<Texture> text
 	pendingFrames.push_back({texture, time});
 }
 
+bool MoviePlayer::onNativeVideoFrameAvailable(Time time, const String& type, void* handle, int arraySlice)
+{
+	std::shared_ptr<MoviePlayerAliveFlag> alive = getAliveFlag();
+	std::vector<std::shared_ptr<Texture>> planes;
+	{
+		std::unique_lock<std::mutex> lock(alive->mutex);
+		if (!recycleNativeFrames.empty()) {
+			planes = std::move(recycleNativeFrames.front());
+			recycleNativeFrames.pop_front();
+		}
+	}
+
+	// Straight into the queue, as the copy has already been issued on the GPU
+	const bool ok = video.copyNativeTexture(type, handle, arraySlice, planes);
+
+	std::unique_lock<std::mutex> lock(alive->mutex);
+	if (!ok) {
+		if (!planes.empty()) {
+			recycleNativeFrames.push_back(std::move(planes));
+		}
+		return false;
+	}
+
+	const auto iter = std::find_if(pendingFrames.begin(), pendingFrames.end(), [=] (const PendingFrame& f)
+	{
+		return f.time > time;
+	});
+	pendingFrames.insert(iter, { planes.at(0), time, planes.size() > 1 ? planes[1] : std::shared_ptr<Texture>() });
+	return true;
+}
+
 void MoviePlayer::onAudioFrameAvailable(Time time, gsl::span<const short> origSamples)
 {
 	std::vector<AudioConfig::SampleFormat> samples(origSamples.size());
@@ -4,14 +4,20 @@
 #include "halley/core/graphics/material/material.h"
 #include "halley/core/graphics/material/material_definition.h"
 #include "halley/core/graphics/material/material_parameter.h"
+#include "halley/core/graphics/static_vertex_buffer.h"
+#include <algorithm>
 #include <cstring> // memmove
+#include <limits>
 #include <gsl/gsl_assert>
+#include <halley/support/profiler.h>
+#include <halley/concurrency/concurrent.h>
 #include "resources/resources.h"
 
 using namespace Halley;
 
 Painter::Painter(Resources& resources)
 	: halleyGlobalMaterial(std::make_unique<Material>(resources.get<MaterialDefinition>("Halley/MaterialBase"), true))
+	, mvpIndex(halleyGlobalMaterial->getDefinition().getUniformIndex("u_mvp"))
 {
 }
 
@@ -25,20 +31,38 @@ void Painter::startRender()
 	prevDrawCalls = nDrawCalls;
 	prevTriangles = nTriangles;
 	prevVertices = nVertices;
-	nDrawCalls = nTriangles = nVertices = 0;
+	prevElidedStateChanges = nElidedStateChanges;
+	nDrawCalls = nTriangles = nVertices = nElidedStateChanges = 0;
+
+	maxBatchVertices = supports32BitIndices() ? size_t(std::numeric_limits<IndexType>::max() & ~IndexType(3)) : 65536; // Whole quads
+	maxBatchBytes = getMaxBatchBytes();
 
 	resetPending();
 	doStartRender();
+
+	gpuTimingActive = gpuTimingEnabled && supportsGPUTimers();
+	if (gpuTimingActive) {
+		startGPUTimerFrame();
+	}
 }
 
 void Painter::endRender()
 {
 	flush();
+	if (gpuTimingActive) {
+		endGPUTimerFrame();
+		gpuTimingActive = false;
+	}
 	doEndRender();
 	camera = nullptr;
 	viewPort = Rect4i(0, 0, 0, 0);
 }
 
+void Painter::clear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil)
+{
+	doClear(colour, depth, stencil);
+}
+
 void Painter::flush()
 {
 	flushPending();
@@ -56,25 +80,59 @@ static Vector4f& getVertPos(char* vertexAttrib, size_t vertPosOffset)
 	return *reinterpret_cast<Vector4f*>(vertexAttrib + vertPosOffset);
 }
 
+static void expandSprites(const MaterialDefinition& definition, size_t numSprites, const char* src, char* dst)
+{
+	const size_t verticesPerSprite = 4;
+	const size_t vertexSize = definition.getVertexSize();
+	const size_t vertexStride = definition.getVertexStride();
+	const size_t vertPosOffset = definition.getVertexPosOffset();
+
+	for (size_t i = 0; i < numSprites; i++) {
+		for (size_t j = 0; j < verticesPerSprite; j++) {
+			size_t srcOffset = i * vertexStride;
+			size_t dstOffset = (i * verticesPerSprite + j) * vertexStride;
+			memmove(dst + dstOffset, src + srcOffset, vertexSize);
+
+			// j -> vertPos
+			// 0 -> 0, 0
+			// 1 -> 1, 0
+			// 2 -> 1, 1
+			// 3 -> 0, 1
+			const float x = ((j & 1) ^ ((j & 2) >> 1)) * 1.0f;
+			const float y = ((j & 2) >> 1) * 1.0f;
+			getVertPos(dst + dstOffset, vertPosOffset) = Vector4f(x, y, x, y);
+		}
+	}
+}
+
 Painter::PainterVertexData Painter::addDrawData(std::shared_ptr<Material>& material, size_t numVertices, size_t numIndices, bool standardQuadsOnly)
 {
 	Expects(material);
 	Expects(numVertices > 0);
 	Expects(numIndices >= numVertices);
+	Expects(numVertices <= maxBatchVertices);
 
+	if (pendingInstanced && verticesPending > 0) {
+		flushPending();
+	}
 	startDrawCall(material);
+	pendingInstanced = false;
 
 	PainterVertexData result;
 
 	result.vertexSize = material->getDefinition().getVertexSize();
 	result.vertexStride = material->getDefinition().getVertexStride();
 	result.dataSize = numVertices * result.vertexStride;
+	if (verticesPending + numVertices > maxBatchVertices || bytesPending + result.dataSize > maxBatchBytes) {
+		// Draw what's there (keeping the material) and carry on after it
+		drawPending();
+	}
 	makeSpaceForPendingVertices(result.dataSize);
 	makeSpaceForPendingIndices(numIndices);
 
-	result.dstVertex = vertexBuffer.data() + bytesPending;
+	result.dstVertex = getPendingVertices() + bytesPending;
 	result.dstIndex = indexBuffer.data() + indicesPending;
-	result.firstIndex = static_cast<unsigned short>(verticesPending);
+	result.firstIndex = static_cast<IndexType>(verticesPending);
 
 	indicesPending += numIndices;
 	verticesPending += numVertices;
@@ -84,47 +142,101 @@ Painter::PainterVertexData Painter::addDrawData(std::shared_ptr<Material>& mater
 	return result;
 }
 
+Painter::PainterVertexData Painter::addInstanceData(std::shared_ptr<Material>& material, size_t numInstances)
+{
+	Expects(material);
+	Expects(numInstances > 0);
+
+	if (!pendingInstanced && verticesPending > 0) {
+		flushPending();
+	}
+	startDrawCall(material);
+	pendingInstanced = true;
+
+	PainterVertexData result;
+
+	result.vertexSize = material->getDefinition().getVertexSize();
+	result.vertexStride = material->getDefinition().getVertexStride();
+	result.dataSize = numInstances * result.vertexStride;
+	if (bytesPending + result.dataSize > maxBatchBytes) {
+		drawPending();
+	}
+	makeSpaceForPendingVertices(result.dataSize);
+
+	result.dstVertex = getPendingVertices() + bytesPending;
+	result.dstIndex = nullptr;
+	result.firstIndex = 0;
+
+	verticesPending += numInstances;
+	bytesPending += result.dataSize;
+
+	return result;
+}
+
 void Painter::drawQuads(std::shared_ptr<Material> material, size_t numVertices, const void* vertexData)
 {
 	Expects(numVertices % 4 == 0);
 	Expects(vertexData != nullptr);
 
-	auto result = addDrawData(material, numVertices, numVertices * 3 / 2, true);
-
-	memmove(result.dstVertex, vertexData, result.dataSize);
-	generateQuadIndices(result.firstIndex, numVertices / 4, result.dstIndex);
+	const size_t stride = material->getDefinition().getVertexStride();
+	const char* src = reinterpret_cast<const char*>(vertexData);
+	for (size_t start = 0; start < numVertices; start += maxBatchVertices) {
+		const size_t n = std::min(numVertices - start, maxBatchVertices);
+		auto result = addDrawData(material, n, n * 3 / 2, true);
+		memmove(result.dstVertex, src + start * stride, result.dataSize);
+		generateQuadIndices(result.firstIndex, n / 4, result.dstIndex);
+	}
 }
 
-void Painter::drawSprites(std::shared_ptr<Material> material, size_t numSprites, const void* vertexData)
+void Painter::drawStaticQuads(std::shared_ptr<Material> material, std::shared_ptr<const StaticVertexBuffer> buffer)
 {
-	Expects(vertexData != nullptr);
+	Expects(material);
+	Expects(buffer);
+	Expects(buffer->getNumVertices() % 4 == 0);
 
-	const size_t verticesPerSprite = 4;
-	const size_t numVertices = verticesPerSprite * numSprites;
-	const size_t vertPosOffset = material->getDefinition().getVertexPosOffset();
+	if (buffer->getNumVertices() == 0) {
+		return;
+	}
 
-	auto result = addDrawData(material, numVertices, numSprites * 6, true);
+	// Nothing to batch it with, since its vertices are somewhere else
+	flushPending();
+	Expects(buffer->getNumVertices() <= maxBatchVertices);
+	executeDrawStaticQuads(material, buffer);
+}
 
-	const char* const src = reinterpret_cast<const char*>(vertexData);
+void Painter::drawSprites(std::shared_ptr<Material> material, size_t numSprites, const void* vertexData)
+{
+	Expects(vertexData != nullptr);
 
-	for (size_t i = 0; i < numSprites; i++) {
-		for (size_t j = 0; j < verticesPerSprite; j++) {
-			size_t srcOffset = i * result.vertexStride;
-			size_t dstOffset = (i * verticesPerSprite + j) * result.vertexStride;
-			memmove(result.dstVertex + dstOffset, src + srcOffset, result.vertexSize);
+	if (material->getDefinition().isInstanced() && supportsInstancing()) {
+		auto result = addInstanceData(material, numSprites);
+		memmove(result.dstVertex, vertexData, result.dataSize);
+		return;
+	}
 
-			// j -> vertPos
-			// 0 -> 0, 0
-			// 1 -> 1, 0
-			// 2 -> 1, 1
-			// 3 -> 0, 1
-			const float x = ((j & 1) ^ ((j & 2) >> 1)) * 1.0f;
-			const float y = ((j & 2) >> 1) * 1.0f;
-			getVertPos(result.dstVertex + dstOffset, vertPosOffset) = Vector4f(x, y, x, y);
+	const size_t verticesPerSprite = 4;
+	const size_t maxSprites = maxBatchVertices / verticesPerSprite;
+	const size_t stride = material->getDefinition().getVertexStride();
+	const char* src = reinterpret_cast<const char*>(vertexData);
+
+	for (size_t start = 0; start < numSprites; start += maxSprites) {
+		const size_t n = std::min(numSprites - start, maxSprites);
+		auto result = addDrawData(material, n * verticesPerSprite, n * 6, true);
+
+		// Large batches are split into ranges of sprites, each expanded by a thread into its own part of the buffers
+		constexpr size_t parallelGrainSize = 2048;
+		const size_t nChunks = n >= 2 * parallelGrainSize && Executors::isDefined() ? Concurrent::getChunkCount(Executors::getCPU(), n, parallelGrainSize) : 1;
+		if (nChunks > 1) {
+			Concurrent::forChunks(Executors::getCPU(), n, nChunks, [&] (size_t, size_t chunkStart, size_t chunkEnd)
+			{
+				expandSprites(material->getDefinition(), chunkEnd - chunkStart, src + (start + chunkStart) * stride, result.dstVertex + chunkStart * verticesPerSprite * stride);
+				generateQuadIndices(IndexType(result.firstIndex + chunkStart * verticesPerSprite), chunkEnd - chunkStart, result.dstIndex + chunkStart * 6);
+			});
+		} else {
+			expandSprites(material->getDefinition(), n, src + start * stride, result.dstVertex);
+			generateQuadIndices(result.firstIndex, n, result.dstIndex);
 		}
 	}
-
-	generateQuadIndices(result.firstIndex, numSprites, result.dstIndex);
 }
 
 void Painter::drawSlicedSprite(std::shared_ptr<Material> material, Vector2f scale, Vector4f slices, const void* vertexData)
@@ -169,10 +281,10 @@ void Painter::drawSlicedSprite(std::shared_ptr<Material> material, Vector2f scal
 	}
 
 	// Indices
-	unsigned short* dstIndex = result.dstIndex;
+	IndexType* dstIndex = result.dstIndex;
 	for (size_t y = 0; y < 3; y++) {
 		for (size_t x = 0; x < 3; x++) {
-			generateQuadIndicesOffset(static_cast<unsigned short>(result.firstIndex + x + (y * 4)), 4, dstIndex);
+			generateQuadIndicesOffset(static_cast<IndexType>(result.firstIndex + x + (y * 4)), 4, dstIndex);
 			dstIndex += 6;
 		}
 	}
@@ -181,11 +293,33 @@ void Painter::drawSlicedSprite(std::shared_ptr<Material> material, Vector2f scal
 void Painter::makeSpaceForPendingVertices(size_t numBytes)
 {
 	size_t requiredSize = bytesPending + numBytes;
+	if (streamVertices) {
+		if (requiredSize <= streamCapacity) {
+			return;
+		}
+
+		// Out of room in the stream, draw what's there (keeping the material) and carry on after it
+		drawPending();
+		requiredSize = numBytes;
+	}
+
+	if (bytesPending == 0) {
+		streamVertices = beginVertexStream(numBytes, streamCapacity);
+		if (streamVertices) {
+			return;
+		}
+	}
+
 	if (vertexBuffer.size() < requiredSize) {
 		vertexBuffer.resize(requiredSize * 2);
 	}
 }
 
+char* Painter::getPendingVertices()
+{
+	return streamVertices ? streamVertices : vertexBuffer.data();
+}
+
 void Painter::makeSpaceForPendingIndices(size_t numIndices)
 {
 	size_t requiredSize = indicesPending + numIndices;
@@ -203,7 +337,7 @@ void Painter::bind(RenderContext& context)
 
 	// Set render target
 	activeRenderTarget = &camera->getActiveRenderTarget();
-	activeRenderTarget->onBind(*this);
+	onBindRenderTarget(*activeRenderTarget);
 
 	// Set viewport
 	viewPort = camera->getActiveViewPort();
@@ -217,7 +351,7 @@ void Painter::bind(RenderContext& context)
 void Painter::unbind(RenderContext& context)
 {
 	flush();
-	activeRenderTarget->onUnbind(*this);
+	onUnbindRenderTarget(*activeRenderTarget);
 	activeRenderTarget = nullptr;
 	camera->rendering = false;
 }
@@ -275,12 +409,28 @@ void Painter::startDrawCall(std::shared_ptr<Material>& material)
 }
 
 void Painter::flushPending()
+{
+	HALLEY_PROFILE_SCOPE("Painter::flushPending");
+	drawPending();
+	resetPending();
+}
+
+void Painter::drawPending()
 {
 	if (verticesPending > 0) {
-		executeDrawTriangles(*materialPending, verticesPending, vertexBuffer.data(), indicesPending, indexBuffer.data());
+		if (pendingInstanced) {
+			executeDrawInstancedQuads(materialPending, verticesPending, getPendingVertices());
+		} else {
+			executeDrawTriangles(materialPending, verticesPending, getPendingVertices(), indicesPending, indexBuffer.data(), allIndicesAreQuads);
+		}
 	}
 
-	resetPending();
+	bytesPending = 0;
+	verticesPending = 0;
+	indicesPending = 0;
+	allIndicesAreQuads = true;
+	streamVertices = nullptr;
+	streamCapacity = 0;
 }
 
 void Painter::resetPending()
@@ -289,18 +439,22 @@ void Painter::resetPending()
 	verticesPending = 0;
 	indicesPending = 0;
 	allIndicesAreQuads = true;
+	pendingInstanced = false;
+	streamVertices = nullptr;
+	streamCapacity = 0;
 	if (materialPending) {
 		Material::resetBindCache();
 		materialPending.reset();
 	}
 }
 
-void Painter::executeDrawTriangles(Material& material, size_t numVertices, void* vertexData, size_t numIndices, unsigned short* indices)
+void Painter::executeDrawTriangles(const std::shared_ptr<Material>& materialPtr, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly)
 {
+	auto& material = *materialPtr;
 	startDrawCall();
 
 	// Load vertices
-	setVertices(material.getDefinition(), numVertices, vertexData, numIndices, indices, allIndicesAreQuads);
+	setVertices(material.getDefinition(), numVertices, vertexData, numIndices, indices, standardQuadsOnly);
 
 	// Load material uniforms
 	material.uploadData(*this);
@@ -314,25 +468,264 @@ void Painter::executeDrawTriangles(Material& material, size_t numVertices, void*
 
 			// Draw
 			drawTriangles(numIndices);
+			logDrawCall(numVertices, numIndices);
+		}
+	}
+
+	endDrawCall();
+}
+
+void Painter::executeDrawInstancedQuads(const std::shared_ptr<Material>& materialPtr, size_t numInstances, void* instanceData)
+{
+	auto& material = *materialPtr;
+	auto& definition = material.getDefinition();
+
+	if (!supportsInstancing()) {
+		// Only happens when replaying a recording on a backend without instancing, so expand them into regular quads
+		const size_t maxInstancesPerDraw = maxBatchVertices / 4;
+		const size_t stride = definition.getVertexStride();
+		const char* src = static_cast<const char*>(instanceData);
+		for (size_t start = 0; start < numInstances; start += maxInstancesPerDraw) {
+			const size_t n = std::min(numInstances - start, maxInstancesPerDraw);
+			const size_t bytes = n * 4 * stride;
+			size_t capacity = 0;
+			char* dst = beginVertexStream(bytes, capacity);
+			if (!dst) {
+				if (expandedVertexBuffer.size() < bytes) {
+					expandedVertexBuffer.resize(bytes);
+				}
+				dst = expandedVertexBuffer.data();
+			}
+			expandSprites(definition, n, src + start * stride, dst);
+			executeDrawTriangles(materialPtr, n * 4, dst, n * 6, getStandardQuadIndices(n), true);
+		}
+		return;
+	}
+
+	startDrawCall();
+
+	// Load instances
+	setInstances(definition, numInstances, instanceData);
+
+	// Load material uniforms
+	material.uploadData(*this);
+	setMaterialData(material);
+
+	// Go through each pass
+	for (int i = 0; i < definition.getNumPasses(); i++) {
+		if (material.isPassEnabled(i)) {
+			// Bind pass
+			material.bind(i, *this);
 
-			// Log stats
-			nDrawCalls++;
-			nTriangles += numIndices / 3;
-			nVertices += numVertices;
+			// Draw
+			drawInstancedQuads(numInstances);
+			logDrawCall(numInstances * 4, numInstances * 6);
 		}
 	}
 
 	endDrawCall();
 }
 
-unsigned short* Painter::getStandardQuadIndices(size_t numQuads)
+void Painter::executeDrawStaticQuads(const std::shared_ptr<Material>& materialPtr, const std::shared_ptr<const StaticVertexBuffer>& buffer)
+{
+	auto& material = *materialPtr;
+	const size_t numVertices = buffer->getNumVertices();
+	const size_t numIndices = numVertices * 3 / 2;
+
+	if (!supportsStaticVertices()) {
+		// Stream it like any other quads
+		size_t capacity = 0;
+		char* dst = beginVertexStream(buffer->getSize(), capacity);
+		if (!dst) {
+			if (expandedVertexBuffer.size() < buffer->getSize()) {
+				expandedVertexBuffer.resize(buffer->getSize());
+			}
+			dst = expandedVertexBuffer.data();
+		}
+		memcpy(dst, buffer->getData(), buffer->getSize());
+		executeDrawTriangles(materialPtr, numVertices, dst, numIndices, getStandardQuadIndices(numVertices / 4), true);
+		return;
+	}
+
+	startDrawCall();
+
+	// Bind vertices
+	setStaticVertices(material.getDefinition(), buffer);
+
+	// Load material uniforms
+	material.uploadData(*this);
+	setMaterialData(material);
+
+	// Go through each pass
+	for (int i = 0; i < material.getDefinition().getNumPasses(); i++) {
+		if (material.isPassEnabled(i)) {
+			// Bind pass
+			material.bind(i, *this);
+
+			// Draw
+			drawTriangles(numIndices);
+			logDrawCall(numVertices, numIndices);
+		}
+	}
+
+	endDrawCall();
+}
+
+void Painter::logDrawCall(size_t numVertices, size_t numIndices)
+{
+	nDrawCalls++;
+	nTriangles += numIndices / 3;
+	nVertices += numVertices;
+}
+
+void Painter::logElidedStateChanges(size_t n)
+{
+	nElidedStateChanges += n;
+}
+
+void Painter::setGPUTimingEnabled(bool enabled)
+{
+	gpuTimingEnabled = enabled;
+	if (!enabled) {
+		std::unique_lock<std::mutex> lock(gpuTimingsMutex);
+		gpuTimings.clear();
+	}
+}
+
+void Painter::beginGPUScope(const String& name)
+{
+	if (gpuTimingEnabled) {
+		flushPending();
+		doBeginGPUScope(name);
+	}
+}
+
+void Painter::endGPUScope()
+{
+	if (gpuTimingEnabled) {
+		flushPending();
+		doEndGPUScope();
+	}
+}
+
+Vector<GPUScopeTiming> Painter::getPrevGPUTimings() const
+{
+	std::unique_lock<std::mutex> lock(gpuTimingsMutex);
+	return gpuTimings;
+}
+
+void Painter::doBeginGPUScope(const String& name)
+{
+	if (!gpuTimingActive) {
+		return;
+	}
+
+	const auto frameIdx = size_t(gpuFramesStarted % gpuTimerFrames);
+	auto& frame = gpuFrames[frameIdx];
+	const int depth = int(gpuScopeStack.size());
+	gpuScopeStack.push_back(frame.scopes.size());
+
+	// Scopes that don't fit (keeping enough for those already open to end) aren't timed, but are kept track of, to match their ends
+	if (frame.timestamps + depth + 2 > maxGPUTimestamps) {
+		frame.scopes.push_back(GPUTimerFrame::Scope{ name, depth, std::numeric_limits<size_t>::max(), 0 });
+		return;
+	}
+	frame.scopes.push_back(GPUTimerFrame::Scope{ name, depth, frame.timestamps, 0 });
+	writeGPUTimestamp(frameIdx, frame.timestamps++);
+}
+
+void Painter::doEndGPUScope()
+{
+	if (!gpuTimingActive || gpuScopeStack.empty()) {
+		return;
+	}
+
+	const auto frameIdx = size_t(gpuFramesStarted % gpuTimerFrames);
+	auto& frame = gpuFrames[frameIdx];
+	auto& scope = frame.scopes[gpuScopeStack.back()];
+	gpuScopeStack.pop_back();
+	if (scope.begin != std::numeric_limits<size_t>::max()) {
+		scope.end = frame.timestamps;
+		writeGPUTimestamp(frameIdx, frame.timestamps++);
+	}
+}
+
+void Painter::startGPUTimerFrame()
+{
+	readGPUTimerFrames();
+
+	// If the GPU is so far behind that the oldest frame is still going, its queries are reused, and its results never read
+	if (gpuFramesStarted - gpuFramesRead >= gpuTimerFrames) {
+		++gpuFramesRead;
+	}
+
+	auto& frame = gpuFrames[gpuFramesStarted % gpuTimerFrames];
+	frame.scopes.clear();
+	frame.timestamps = 0;
+	gpuScopeStack.clear();
+
+	beginGPUTimerFrame(size_t(gpuFramesStarted % gpuTimerFrames));
+	doBeginGPUScope("Frame");
+}
+
+void Painter::endGPUTimerFrame()
+{
+	while (!gpuScopeStack.empty()) {
+		doEndGPUScope();
+	}
+	endGPUTimerFrame(size_t(gpuFramesStarted % gpuTimerFrames));
+	++gpuFramesStarted;
+}
+
+void Painter::readGPUTimerFrames()
+{
+	// Oldest first, stopping at the first one that isn't done, as the ones after it won't be either
+	bool gotAny = false;
+	Vector<GPUScopeTiming> timings;
+	while (gpuFramesRead < gpuFramesStarted) {
+		const auto frameIdx = size_t(gpuFramesRead % gpuTimerFrames);
+		const auto& frame = gpuFrames[frameIdx];
+		gpuTimestamps.clear();
+		if (!readGPUTimestamps(frameIdx, frame.timestamps, gpuTimestamps)) {
+			break;
+		}
+		++gpuFramesRead;
+
+		if (gpuTimestamps.size() == frame.timestamps) {
+			timings.clear();
+			for (auto& scope: frame.scopes) {
+				if (scope.begin != std::numeric_limits<size_t>::max()) {
+					timings.push_back(GPUScopeTiming{ scope.name, scope.depth, std::max(gpuTimestamps[scope.end] - gpuTimestamps[scope.begin], int64_t(0)) });
+				}
+			}
+			gotAny = true;
+		}
+	}
+
+	if (gotAny) {
+		std::unique_lock<std::mutex> lock(gpuTimingsMutex);
+		gpuTimings = std::move(timings);
+	}
+}
+
+void Painter::onBindRenderTarget(RenderTarget& target)
+{
+	target.onBind(*this);
+}
+
+void Painter::onUnbindRenderTarget(RenderTarget& target)
+{
+	target.onUnbind(*this);
+}
+
+Painter::IndexType* Painter::getStandardQuadIndices(size_t numQuads)
 {
 	size_t sz = numQuads * 6;
 	size_t oldSize = stdQuadIndexCache.size();
 
 	if (oldSize < sz) {
 		stdQuadIndexCache.resize(sz);
-		unsigned short pos = static_cast<unsigned short>(oldSize * 2 / 3);
+		IndexType pos = static_cast<IndexType>(oldSize * 2 / 3);
 		for (size_t i = oldSize; i < sz; i += 6) {
 			// A-----B
 			// |     |
@@ -352,7 +745,7 @@ unsigned short* Painter::getStandardQuadIndices(size_t numQuads)
 	return stdQuadIndexCache.data();
 }
 
-void Painter::generateQuadIndices(unsigned short pos, size_t numQuads, unsigned short* target)
+void Painter::generateQuadIndices(IndexType pos, size_t numQuads, IndexType* target)
 {
 	size_t numIndices = numQuads * 6;
 	for (size_t i = 0; i < numIndices; i += 6) {
@@ -377,7 +770,7 @@ RenderTarget& Painter::getActiveRenderTarget()
 	return *activeRenderTarget;
 }
 
-void Painter::generateQuadIndicesOffset(unsigned short pos, unsigned short lineStride, unsigned short* target)
+void Painter::generateQuadIndicesOffset(IndexType pos, IndexType lineStride, IndexType* target)
 {
 	// A-----B
 	// |     |
@@ -397,9 +790,9 @@ void Painter::updateProjection()
 	camera->updateProjection(activeRenderTarget->getProjectionFlipVertical());
 	projection = camera->getProjection();
 	
-	auto old = halleyGlobalMaterial->clone();
-	halleyGlobalMaterial->set("u_mvp", projection);
-	if (*old != *halleyGlobalMaterial) {
+	const auto oldHash = halleyGlobalMaterial->getHash();
+	halleyGlobalMaterial->set(mvpIndex, projection);
+	if (halleyGlobalMaterial->getHash() != oldHash) {
 		onUpdateProjection(*halleyGlobalMaterial);
 	}
 }
@@ -0,0 +1,284 @@
+#include "halley/core/graphics/particles/particle_emitter.h"
+#include "halley/core/graphics/material/material.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include "halley/core/graphics/material/material_parameter.h"
+#include "halley/core/graphics/painter.h"
+#include "halley/file_formats/config_file.h"
+#include "resources/resources.h"
+#include <halley/utils/utils.h>
+#include <gsl/gsl_assert>
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386)
+#define HAS_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace Halley;
+
+namespace {
+	Range<float> readRange(const ConfigNode& node, Range<float> defaultValue)
+	{
+		switch (node.getType()) {
+		case ConfigNodeType::Undefined:
+			return defaultValue;
+		case ConfigNodeType::Sequence:
+		case ConfigNodeType::Int2:
+		case ConfigNodeType::Float2:
+			{
+				const auto v = node.asVector2f();
+				return Range<float>(v.x, v.y);
+			}
+		default:
+			return Range<float>(node.asFloat(), node.asFloat());
+		}
+	}
+
+	float getInRange(Random& rng, Range<float> range)
+	{
+		return range.start < range.end ? rng.getFloat(range.start, range.end) : range.start;
+	}
+}
+
+ParticleEmitterDefinition::ParticleEmitterDefinition() = default;
+
+ParticleEmitterDefinition::ParticleEmitterDefinition(const ConfigNode& node, Resources& resources)
+{
+	const auto materialName = node["material"].asString("");
+	if (node.hasKey("spriteSheet")) {
+		sprite.setSprite(resources, node["spriteSheet"].asString(), node["sprite"].asString(), materialName);
+	} else {
+		sprite.setImage(resources, node["image"].asString(), materialName);
+	}
+
+	maxParticles = node["maxParticles"].asInt(maxParticles);
+	spawnRate = node["spawnRate"].asFloat(spawnRate);
+	lifetime = readRange(node["lifetime"], lifetime);
+	speed = readRange(node["speed"], speed);
+	rotationSpeed = readRange(node["rotationSpeed"], rotationSpeed);
+	direction = Angle1f::fromDegrees(node["direction"].asFloat(0));
+	spread = Angle1f::fromDegrees(node["spread"].asFloat(0));
+	spawnArea = node["spawnArea"].asVector2f(spawnArea);
+	acceleration = node["acceleration"].asVector2f(acceleration);
+	drag = node["drag"].asFloat(drag);
+
+	if (node.hasKey("scale")) {
+		auto scale = node["scale"].getType() == ConfigNodeType::Sequence ? node["scale"].asVector2f() : Vector2f(node["scale"].asFloat(), node["scale"].asFloat());
+		startScale = scale.x;
+		endScale = scale.y;
+	}
+
+	if (node.hasKey("colour")) {
+		if (node["colour"].getType() == ConfigNodeType::Sequence) {
+			startColour = Colour4f::fromString(node["colour"][0].asString());
+			endColour = Colour4f::fromString(node["colour"][1].asString());
+		} else {
+			startColour = endColour = Colour4f::fromString(node["colour"].asString());
+		}
+	}
+
+	if (maxParticles <= 0) {
+		throw Exception("Particle emitters need a positive maxParticles.", HalleyExceptions::Resources);
+	}
+	if (lifetime.start <= 0) {
+		throw Exception("Particle emitters need a positive lifetime.", HalleyExceptions::Resources);
+	}
+}
+
+ParticleEmitter::ParticleEmitter(std::shared_ptr<const ParticleEmitterDefinition> def, uint32_t seed)
+	: definition(std::move(def))
+	, rng(seed)
+{
+	Expects(definition);
+	Expects(definition->sprite.hasMaterial());
+
+	material = std::make_shared<Material>(definition->sprite.getMaterial());
+
+	const size_t capacity = size_t(definition->maxParticles);
+	for (auto* v: { &posX, &posY, &velX, &velY, &rotation, &rotationSpeed, &age, &ageRate }) {
+		v->resize(capacity);
+	}
+}
+
+void ParticleEmitter::setPosition(Vector2f p)
+{
+	position = p;
+}
+
+Vector2f ParticleEmitter::getPosition() const
+{
+	return position;
+}
+
+void ParticleEmitter::setEnabled(bool e)
+{
+	enabled = e;
+	if (!enabled) {
+		spawnAccumulator = 0;
+	}
+}
+
+bool ParticleEmitter::isEnabled() const
+{
+	return enabled;
+}
+
+void ParticleEmitter::burst(int count)
+{
+	Expects(count >= 0);
+	spawn(size_t(count));
+}
+
+void ParticleEmitter::clear()
+{
+	numParticles = 0;
+	spawnAccumulator = 0;
+}
+
+void ParticleEmitter::update(Time time)
+{
+	const float t = float(time);
+	simulate(t);
+	removeDead();
+
+	if (enabled) {
+		spawnAccumulator += definition->spawnRate * t;
+		const float whole = std::floor(spawnAccumulator);
+		spawnAccumulator -= whole;
+		spawn(size_t(whole));
+	}
+}
+
+void ParticleEmitter::draw(Painter& painter) const
+{
+	if (numParticles == 0) {
+		return;
+	}
+
+	const auto& def = *definition;
+	SpriteVertexAttrib vertex = def.sprite.getVertexAttrib();
+	const Vector2f baseScale = vertex.scale;
+	const float baseRotation = vertex.rotation;
+
+	vertices.resize(numParticles);
+	for (size_t i = 0; i < numParticles; ++i) {
+		const float a = age[i];
+		const float scale = lerp(def.startScale, def.endScale, a);
+		vertex.pos = Vector2f(posX[i], posY[i]);
+		vertex.scale = baseScale * scale;
+		vertex.colour = lerp(def.startColour, def.endColour, a);
+		vertex.rotation = baseRotation + rotation[i];
+		vertices[i] = vertex;
+	}
+
+	painter.drawSprites(material, numParticles, vertices.data());
+}
+
+size_t ParticleEmitter::getNumParticles() const
+{
+	return numParticles;
+}
+
+bool ParticleEmitter::isFinished() const
+{
+	return !enabled && numParticles == 0;
+}
+
+void ParticleEmitter::spawn(size_t count)
+{
+	const auto& def = *definition;
+	const size_t end = std::min(numParticles + count, posX.size());
+	const float baseAngle = def.direction.getRadians();
+	const float spread = def.spread.getRadians();
+	const float rotSpeedScale = float(pi()) / 180.0f;
+
+	for (size_t i = numParticles; i < end; ++i) {
+		const float angle = spread > 0 ? baseAngle + rng.getFloat(-spread, spread) : baseAngle;
+		const float speed = getInRange(rng, def.speed);
+		posX[i] = position.x + (def.spawnArea.x > 0 ? rng.getFloat(-def.spawnArea.x, def.spawnArea.x) : 0);
+		posY[i] = position.y + (def.spawnArea.y > 0 ? rng.getFloat(-def.spawnArea.y, def.spawnArea.y) : 0);
+		velX[i] = std::cos(angle) * speed;
+		velY[i] = std::sin(angle) * speed;
+		rotation[i] = 0;
+		rotationSpeed[i] = getInRange(rng, def.rotationSpeed) * rotSpeedScale;
+		age[i] = 0;
+		ageRate[i] = 1.0f / getInRange(rng, def.lifetime);
+	}
+	numParticles = end;
+}
+
+void ParticleEmitter::simulate(float t)
+{
+	const auto& def = *definition;
+	const float ax = def.acceleration.x * t;
+	const float ay = def.acceleration.y * t;
+	const float damping = std::max(0.0f, 1.0f - def.drag * t);
+	const size_t n = numParticles;
+
+	size_t i = 0;
+#if defined(HAS_SSE)
+	const __m128 vt = _mm_set1_ps(t);
+	const __m128 vax = _mm_set1_ps(ax);
+	const __m128 vay = _mm_set1_ps(ay);
+	const __m128 vdamp = _mm_set1_ps(damping);
+	for (; i + 4 <= n; i += 4) {
+		const __m128 vx = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velX.data() + i), vax), vdamp);
+		const __m128 vy = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(velY.data() + i), vay), vdamp);
+		_mm_storeu_ps(velX.data() + i, vx);
+		_mm_storeu_ps(velY.data() + i, vy);
+		_mm_storeu_ps(posX.data() + i, _mm_add_ps(_mm_loadu_ps(posX.data() + i), _mm_mul_ps(vx, vt)));
+		_mm_storeu_ps(posY.data() + i, _mm_add_ps(_mm_loadu_ps(posY.data() + i), _mm_mul_ps(vy, vt)));
+		_mm_storeu_ps(rotation.data() + i, _mm_add_ps(_mm_loadu_ps(rotation.data() + i), _mm_mul_ps(_mm_loadu_ps(rotationSpeed.data() + i), vt)));
+		_mm_storeu_ps(age.data() + i, _mm_add_ps(_mm_loadu_ps(age.data() + i), _mm_mul_ps(_mm_loadu_ps(ageRate.data() + i), vt)));
+	}
+#elif defined(HAS_NEON)
+	const float32x4_t vax = vdupq_n_f32(ax);
+	const float32x4_t vay = vdupq_n_f32(ay);
+	const float32x4_t vdamp = vdupq_n_f32(damping);
+	for (; i + 4 <= n; i += 4) {
+		const float32x4_t vx = vmulq_f32(vaddq_f32(vld1q_f32(velX.data() + i), vax), vdamp);
+		const float32x4_t vy = vmulq_f32(vaddq_f32(vld1q_f32(velY.data() + i), vay), vdamp);
+		vst1q_f32(velX.data() + i, vx);
+		vst1q_f32(velY.data() + i, vy);
+		vst1q_f32(posX.data() + i, vmlaq_n_f32(vld1q_f32(posX.data() + i), vx, t));
+		vst1q_f32(posY.data() + i, vmlaq_n_f32(vld1q_f32(posY.data() + i), vy, t));
+		vst1q_f32(rotation.data() + i, vmlaq_n_f32(vld1q_f32(rotation.data() + i), vld1q_f32(rotationSpeed.data() + i), t));
+		vst1q_f32(age.data() + i, vmlaq_n_f32(vld1q_f32(age.data() + i), vld1q_f32(ageRate.data() + i), t));
+	}
+#endif
+	for (; i < n; ++i) {
+		velX[i] = (velX[i] + ax) * damping;
+		velY[i] = (velY[i] + ay) * damping;
+		posX[i] += velX[i] * t;
+		posY[i] += velY[i] * t;
+		rotation[i] += rotationSpeed[i] * t;
+		age[i] += ageRate[i] * t;
+	}
+}
+
+void ParticleEmitter::removeDead()
+{
+	// Order doesn't matter, so the last live particle takes the place of each dead one
+	size_t i = 0;
+	while (i < numParticles) {
+		if (age[i] >= 1.0f) {
+			const size_t last = --numParticles;
+			posX[i] = posX[last];
+			posY[i] = posY[last];
+			velX[i] = velX[last];
+			velY[i] = velY[last];
+			rotation[i] = rotation[last];
+			rotationSpeed[i] = rotationSpeed[last];
+			age[i] = age[last];
+			ageRate[i] = ageRate[last];
+		} else {
+			++i;
+		}
+	}
+}
@@ -0,0 +1,355 @@
+#include "halley/core/graphics/render_command_list.h"
+#include "halley/core/graphics/render_target/render_target.h"
+#include "halley/core/graphics/material/material.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include "halley/core/graphics/static_vertex_buffer.h"
+#include <cstring>
+#include <gsl/gsl_assert>
+#include <halley/support/profiler.h>
+
+using namespace Halley;
+
+void RenderCommandList::clear()
+{
+	// Keeps capacity, so steady-state recording doesn't allocate
+	commands.clear();
+	vertexData.clear();
+	indexData.clear();
+}
+
+void RenderCommandList::addClear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil)
+{
+	commands.emplace_back(CommandType::Clear);
+	commands.back().colour = colour;
+	commands.back().depth = depth;
+	commands.back().stencil = stencil;
+}
+
+void RenderCommandList::addSetViewPort(Rect4i rect)
+{
+	commands.emplace_back(CommandType::SetViewPort);
+	commands.back().rect = rect;
+}
+
+void RenderCommandList::addSetClip(Rect4i rect, bool enable)
+{
+	commands.emplace_back(CommandType::SetClip);
+	commands.back().rect = rect;
+	commands.back().flag = enable;
+}
+
+void RenderCommandList::addBindRenderTarget(RenderTarget& target)
+{
+	commands.emplace_back(CommandType::BindRenderTarget);
+	commands.back().target = &target;
+}
+
+void RenderCommandList::addUnbindRenderTarget(RenderTarget& target)
+{
+	commands.emplace_back(CommandType::UnbindRenderTarget);
+	commands.back().target = &target;
+}
+
+void RenderCommandList::addUpdateProjection(std::shared_ptr<Material> material)
+{
+	commands.emplace_back(CommandType::UpdateProjection);
+	commands.back().material = std::move(material);
+}
+
+void RenderCommandList::addDraw(std::shared_ptr<Material> material, size_t numVertices, const void* vertices, size_t numIndices, const Painter::IndexType* indices, bool standardQuadsOnly)
+{
+	Expects(material);
+
+	commands.emplace_back(CommandType::Draw);
+	auto& cmd = commands.back();
+	cmd.material = std::move(material);
+	cmd.flag = standardQuadsOnly;
+	cmd.numVertices = numVertices;
+	cmd.vertexBytes = numVertices * cmd.material->getDefinition().getVertexStride();
+	cmd.vertexOffset = vertexData.size();
+	cmd.numIndices = numIndices;
+	cmd.indexOffset = indexData.size();
+
+	auto src = reinterpret_cast<const char*>(vertices);
+	vertexData.insert(vertexData.end(), src, src + cmd.vertexBytes);
+	indexData.insert(indexData.end(), indices, indices + numIndices);
+}
+
+void RenderCommandList::addDrawInstancedQuads(std::shared_ptr<Material> material, size_t numInstances, const void* instances)
+{
+	Expects(material);
+
+	commands.emplace_back(CommandType::DrawInstancedQuads);
+	auto& cmd = commands.back();
+	cmd.material = std::move(material);
+	cmd.numVertices = numInstances;
+	cmd.vertexBytes = numInstances * cmd.material->getDefinition().getVertexStride();
+	cmd.vertexOffset = vertexData.size();
+
+	auto src = reinterpret_cast<const char*>(instances);
+	vertexData.insert(vertexData.end(), src, src + cmd.vertexBytes);
+}
+
+void RenderCommandList::addDrawStaticQuads(std::shared_ptr<Material> material, std::shared_ptr<const StaticVertexBuffer> buffer)
+{
+	Expects(material);
+	Expects(buffer);
+
+	commands.emplace_back(CommandType::DrawStaticQuads);
+	auto& cmd = commands.back();
+	cmd.material = std::move(material);
+	cmd.staticVertices = std::move(buffer);
+}
+
+void RenderCommandList::addBeginGPUScope(const String& name)
+{
+	commands.emplace_back(CommandType::BeginGPUScope);
+	commands.back().name = name;
+}
+
+void RenderCommandList::addEndGPUScope()
+{
+	commands.emplace_back(CommandType::EndGPUScope);
+}
+
+void RenderCommandList::submit(Painter& painter)
+{
+	HALLEY_PROFILE_SCOPE("RenderCommandList::submit");
+	painter.startRender();
+	for (auto& cmd: commands) {
+		replay(painter, cmd);
+	}
+	painter.endRender();
+}
+
+void RenderCommandList::replay(Painter& painter, Command& cmd)
+{
+	switch (cmd.type) {
+	case CommandType::Clear:
+		painter.clear(cmd.colour, cmd.depth, cmd.stencil);
+		break;
+
+	case CommandType::SetViewPort:
+		painter.setViewPort(cmd.rect);
+		break;
+
+	case CommandType::SetClip:
+		painter.setClip(cmd.rect, cmd.flag);
+		break;
+
+	case CommandType::BindRenderTarget:
+		painter.activeRenderTarget = cmd.target;
+		painter.onBindRenderTarget(*cmd.target);
+		break;
+
+	case CommandType::UnbindRenderTarget:
+		painter.onUnbindRenderTarget(*cmd.target);
+		painter.activeRenderTarget = nullptr;
+		break;
+
+	case CommandType::UpdateProjection:
+		painter.onUpdateProjection(*cmd.material);
+		break;
+
+	case CommandType::Draw:
+		{
+			// Prefer the backend's streaming memory, same as a direct draw would
+			char* vertices = vertexData.data() + cmd.vertexOffset;
+			size_t capacity = 0;
+			char* stream = painter.beginVertexStream(cmd.vertexBytes, capacity);
+			if (stream) {
+				memcpy(stream, vertices, cmd.vertexBytes);
+				vertices = stream;
+			}
+			painter.executeDrawTriangles(cmd.material, cmd.numVertices, vertices, cmd.numIndices, indexData.data() + cmd.indexOffset, cmd.flag);
+		}
+		break;
+
+	case CommandType::DrawInstancedQuads:
+		{
+			// Without instancing, the painter expands them into its own stream
+			char* instances = vertexData.data() + cmd.vertexOffset;
+			if (painter.supportsInstancing()) {
+				size_t capacity = 0;
+				char* stream = painter.beginVertexStream(cmd.vertexBytes, capacity);
+				if (stream) {
+					memcpy(stream, instances, cmd.vertexBytes);
+					instances = stream;
+				}
+			}
+			painter.executeDrawInstancedQuads(cmd.material, cmd.numVertices, instances);
+		}
+		break;
+
+	case CommandType::DrawStaticQuads:
+		// Streamed instead by backends that can't keep it
+		painter.executeDrawStaticQuads(cmd.material, cmd.staticVertices);
+		break;
+
+	case CommandType::BeginGPUScope:
+		painter.beginGPUScope(cmd.name);
+		break;
+
+	case CommandType::EndGPUScope:
+		painter.endGPUScope();
+		break;
+	}
+}
+
+RecordingPainter::RecordingPainter(Resources& resources)
+	: Painter(resources)
+{
+}
+
+void RecordingPainter::takeCommands(RenderCommandList& dst)
+{
+	std::swap(commands, dst);
+}
+
+void RecordingPainter::setGPUTimingSource(const Painter& painter)
+{
+	gpuTimingSource = &painter;
+}
+
+Vector<GPUScopeTiming> RecordingPainter::getPrevGPUTimings() const
+{
+	return gpuTimingSource ? gpuTimingSource->getPrevGPUTimings() : Vector<GPUScopeTiming>();
+}
+
+void RecordingPainter::doBeginGPUScope(const String& name)
+{
+	commands.addBeginGPUScope(name);
+}
+
+void RecordingPainter::doEndGPUScope()
+{
+	commands.addEndGPUScope();
+}
+
+void RecordingPainter::doClear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil)
+{
+	commands.addClear(colour, depth, stencil);
+}
+
+void RecordingPainter::setMaterialPass(const Material&, int)
+{
+	// Materials are only bound on replay
+}
+
+void RecordingPainter::setMaterialData(const Material&)
+{
+	// Materials are only uploaded on replay
+}
+
+void RecordingPainter::doStartRender()
+{
+	commands.clear();
+	++frameNumber;
+
+	// Snapshots that haven't been used in a while are unlikely to come back; any commands still referencing them keep them alive
+	for (auto iter = snapshots.begin(); iter != snapshots.end(); ) {
+		if (iter->second.lastFrame + 2 < frameNumber) {
+			iter = snapshots.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+}
+
+void RecordingPainter::doEndRender()
+{
+}
+
+void RecordingPainter::setVertices(const MaterialDefinition&, size_t, void*, size_t, IndexType*, bool)
+{
+	// Never reached, as executeDrawTriangles is overriden
+}
+
+void RecordingPainter::drawTriangles(size_t)
+{
+	// Never reached, as executeDrawTriangles is overriden
+}
+
+bool RecordingPainter::supportsInstancing() const
+{
+	return true;
+}
+
+void RecordingPainter::setViewPort(Rect4i rect)
+{
+	commands.addSetViewPort(rect);
+}
+
+void RecordingPainter::setClip(Rect4i clip, bool enable)
+{
+	commands.addSetClip(clip, enable);
+}
+
+void RecordingPainter::onUpdateProjection(Material& material)
+{
+	// The global material is modified in place, so it can't be shared with snapshots of later frames
+	auto snapshot = material.clone();
+	snapshot->getHash();
+	commands.addUpdateProjection(std::move(snapshot));
+}
+
+void RecordingPainter::onBindRenderTarget(RenderTarget& target)
+{
+	commands.addBindRenderTarget(target);
+}
+
+void RecordingPainter::onUnbindRenderTarget(RenderTarget& target)
+{
+	commands.addUnbindRenderTarget(target);
+}
+
+void RecordingPainter::executeDrawTriangles(const std::shared_ptr<Material>& material, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly)
+{
+	commands.addDraw(getSnapshot(*material), numVertices, vertexData, numIndices, indices, standardQuadsOnly);
+
+	for (int i = 0; i < material->getDefinition().getNumPasses(); i++) {
+		if (material->isPassEnabled(i)) {
+			logDrawCall(numVertices, numIndices);
+		}
+	}
+}
+
+void RecordingPainter::executeDrawInstancedQuads(const std::shared_ptr<Material>& material, size_t numInstances, void* instanceData)
+{
+	commands.addDrawInstancedQuads(getSnapshot(*material), numInstances, instanceData);
+
+	for (int i = 0; i < material->getDefinition().getNumPasses(); i++) {
+		if (material->isPassEnabled(i)) {
+			logDrawCall(numInstances * 4, numInstances * 6);
+		}
+	}
+}
+
+void RecordingPainter::executeDrawStaticQuads(const std::shared_ptr<Material>& material, const std::shared_ptr<const StaticVertexBuffer>& buffer)
+{
+	commands.addDrawStaticQuads(getSnapshot(*material), buffer);
+
+	const size_t numVertices = buffer->getNumVertices();
+	for (int i = 0; i < material->getDefinition().getNumPasses(); i++) {
+		if (material->isPassEnabled(i)) {
+			logDrawCall(numVertices, numVertices * 3 / 2);
+		}
+	}
+}
+
+std::shared_ptr<Material> RecordingPainter::getSnapshot(const Material& material)
+{
+	// Materials which compare equal share a snapshot, so their constant buffers are only uploaded once by the backend
+	const uint64_t key = material.getHash() ^ (uint64_t(reinterpret_cast<uintptr_t>(&material.getDefinition())) * 0x9E3779B97F4A7C15ull);
+	auto iter = snapshots.find(key);
+	if (iter != snapshots.end()) {
+		iter->second.lastFrame = frameNumber;
+		return iter->second.material;
+	}
+
+	// Compute the hash now, so the replaying thread never writes to anything that recording reads
+	auto snapshot = material.clone();
+	snapshot->getHash();
+	snapshots[key] = Snapshot{ snapshot, frameNumber };
+	return snapshot;
+}
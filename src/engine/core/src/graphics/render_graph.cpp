@@ -0,0 +1,276 @@
+#include "graphics/render_graph.h"
+#include "graphics/render_context.h"
+#include "graphics/render_target/render_target_texture.h"
+#include "graphics/texture.h"
+#include "api/video_api.h"
+#include "halley/support/exception.h"
+#include <gsl/gsl>
+#include <algorithm>
+
+using namespace Halley;
+
+RenderGraph::PassBuilder::PassBuilder(RenderGraph& graph, size_t pass)
+	: graph(graph)
+	, pass(pass)
+{}
+
+void RenderGraph::PassBuilder::read(TargetId target)
+{
+	graph.getTarget(target);
+	graph.passes[pass].reads.push_back(target);
+}
+
+void RenderGraph::PassBuilder::write(TargetId target)
+{
+	graph.getTarget(target);
+	graph.passes[pass].writes.push_back(target);
+}
+
+RenderGraph::RenderGraph(VideoAPI& video)
+	: video(video)
+	, ownPool(std::make_unique<RenderTargetPool>(video))
+	, pool(*ownPool)
+{}
+
+RenderGraph::RenderGraph(VideoAPI& video, RenderTargetPool& pool)
+	: video(video)
+	, pool(pool)
+{}
+
+RenderGraph::~RenderGraph() = default;
+
+RenderGraph::TargetId RenderGraph::createTarget(const String& name, TargetDefinition definition)
+{
+	Expects(definition.size.x > 0 && definition.size.y > 0);
+
+	Target target;
+	target.name = name;
+	target.definition = definition;
+	targets.push_back(std::move(target));
+	compiled = false;
+	return TargetId(targets.size() - 1);
+}
+
+RenderGraph::TargetId RenderGraph::importTarget(const String& name, RenderTarget& renderTarget)
+{
+	Target target;
+	target.name = name;
+	target.imported = &renderTarget;
+	targets.push_back(std::move(target));
+	compiled = false;
+	return TargetId(targets.size() - 1);
+}
+
+void RenderGraph::addPass(const String& name, std::function<void(PassBuilder&)> setup, PassCallback callback)
+{
+	Pass pass;
+	pass.name = name;
+	pass.callback = std::move(callback);
+	passes.push_back(std::move(pass));
+
+	PassBuilder builder(*this, passes.size() - 1);
+	setup(builder);
+	compiled = false;
+}
+
+void RenderGraph::execute(RenderContext& context)
+{
+	if (!compiled) {
+		compile();
+	}
+
+	for (size_t i = 0; i < passes.size(); ++i) {
+		auto& pass = passes[i];
+		if (pass.culled) {
+			continue;
+		}
+
+		for (auto& id: pass.acquires) {
+			auto& target = getTarget(id);
+			target.texture = pool.acquire(target.definition);
+		}
+
+		if (pass.writes.empty()) {
+			pass.callback(context, *this);
+		} else {
+			auto passContext = context.with(getPassRenderTarget(i));
+			pass.callback(passContext, *this);
+		}
+
+		for (auto& id: pass.releases) {
+			auto& target = getTarget(id);
+			pool.release(target.texture);
+			target.texture.reset();
+		}
+	}
+
+	if (ownPool) {
+		ownPool->endFrame();
+	}
+}
+
+void RenderGraph::reset()
+{
+	targets.clear();
+	passes.clear();
+	renderTargets.clear();
+	compiled = false;
+}
+
+std::shared_ptr<Texture> RenderGraph::getTexture(TargetId id) const
+{
+	auto& target = getTarget(id);
+	if (target.imported) {
+		throw Exception("Render graph target \"" + target.name + "\" is imported, so it has no texture.", HalleyExceptions::Graphics);
+	}
+	return target.texture;
+}
+
+size_t RenderGraph::getNumCulledPasses() const
+{
+	return size_t(std::count_if(passes.begin(), passes.end(), [] (const Pass& p) { return p.culled; }));
+}
+
+size_t RenderGraph::getNumTextures() const
+{
+	return pool.getNumTextures();
+}
+
+void RenderGraph::compile()
+{
+	cullPasses();
+	computeLifetimes();
+	renderTargets.clear();
+	for (auto& p: passes) {
+		p.bound.clear();
+	}
+	compiled = true;
+}
+
+void RenderGraph::cullPasses()
+{
+	// Walking backwards, a pass is needed if it writes to something that's needed, and then everything it reads is too.
+	// Passes that don't write anything draw straight to the context they're executed with, so they're always needed.
+	// Writes don't stop earlier writes from being needed, as passes can draw on top of what's there.
+	Vector<bool> needed(targets.size(), false);
+	for (size_t i = 0; i < targets.size(); ++i) {
+		needed[i] = targets[i].imported != nullptr;
+	}
+
+	for (size_t i = passes.size(); i-- > 0; ) {
+		auto& pass = passes[i];
+		pass.culled = !pass.writes.empty() && std::none_of(pass.writes.begin(), pass.writes.end(), [&] (TargetId id) { return needed[id]; });
+		if (!pass.culled) {
+			for (auto& id: pass.reads) {
+				needed[id] = true;
+			}
+		}
+	}
+}
+
+void RenderGraph::computeLifetimes()
+{
+	for (auto& t: targets) {
+		t.firstUse = -1;
+		t.lastUse = -1;
+		t.texture.reset();
+	}
+
+	for (size_t i = 0; i < passes.size(); ++i) {
+		auto& pass = passes[i];
+		pass.acquires.clear();
+		pass.releases.clear();
+		if (pass.culled) {
+			continue;
+		}
+
+		for (auto& id: pass.reads) {
+			auto& target = targets[id];
+			if (target.firstUse == -1 && !target.imported) {
+				throw Exception("Render graph pass \"" + pass.name + "\" reads target \"" + target.name + "\" before anything writes to it.", HalleyExceptions::Graphics);
+			}
+			target.lastUse = int(i);
+		}
+
+		int nDepth = 0;
+		for (auto& id: pass.writes) {
+			auto& target = targets[id];
+			if (target.imported && pass.writes.size() > 1) {
+				throw Exception("Render graph pass \"" + pass.name + "\" writes to imported target \"" + target.name + "\" alongside other targets.", HalleyExceptions::Graphics);
+			}
+			if (target.firstUse == -1) {
+				target.firstUse = int(i);
+			}
+			target.lastUse = int(i);
+			nDepth += !target.imported && target.definition.format == TextureFormat::DEPTH ? 1 : 0;
+		}
+		if (nDepth > 1) {
+			throw Exception("Render graph pass \"" + pass.name + "\" writes to more than one depth target.", HalleyExceptions::Graphics);
+		}
+	}
+
+	for (size_t i = 0; i < targets.size(); ++i) {
+		auto& target = targets[i];
+		if (!target.imported && target.firstUse != -1) {
+			passes[target.firstUse].acquires.push_back(TargetId(i));
+			passes[target.lastUse].releases.push_back(TargetId(i));
+		}
+	}
+}
+
+RenderTarget& RenderGraph::getPassRenderTarget(size_t passIdx)
+{
+	auto& pass = passes[passIdx];
+	auto& first = getTarget(pass.writes[0]);
+	if (first.imported) {
+		return *first.imported;
+	}
+
+	if (renderTargets.size() <= passIdx) {
+		renderTargets.resize(passIdx + 1);
+	}
+	auto& renderTarget = renderTargets[passIdx];
+	if (!renderTarget) {
+		renderTarget = video.createTextureRenderTarget();
+	}
+
+	// Aliasing is deterministic, so this only changes when textures are first created or the pool is rebuilt
+	pass.bound.resize(pass.writes.size());
+	int attachment = 0;
+	for (size_t i = 0; i < pass.writes.size(); ++i) {
+		auto& target = getTarget(pass.writes[i]);
+		const bool isDepth = target.definition.format == TextureFormat::DEPTH;
+		if (pass.bound[i] != target.texture) {
+			pass.bound[i] = target.texture;
+			if (isDepth) {
+				renderTarget->setDepthTexture(target.texture);
+			} else {
+				renderTarget->setTarget(attachment, target.texture);
+			}
+		}
+		if (!isDepth) {
+			++attachment;
+		}
+	}
+	if (attachment == 0) {
+		renderTarget->setViewPort(Rect4i(Vector2i(), first.definition.size));
+	}
+
+	return *renderTarget;
+}
+
+RenderGraph::Target& RenderGraph::getTarget(TargetId id)
+{
+	if (id < 0 || size_t(id) >= targets.size()) {
+		throw Exception("Invalid render graph target: " + toString(id), HalleyExceptions::Graphics);
+	}
+	return targets[id];
+}
+
+const RenderGraph::Target& RenderGraph::getTarget(TargetId id) const
+{
+	if (id < 0 || size_t(id) >= targets.size()) {
+		throw Exception("Invalid render graph target: " + toString(id), HalleyExceptions::Graphics);
+	}
+	return targets[id];
+}
@@ -0,0 +1,105 @@
+#include "halley/core/graphics/render_target/render_target_pool.h"
+#include "graphics/texture.h"
+#include "api/video_api.h"
+#include <gsl/gsl_assert>
+#include <algorithm>
+
+using namespace Halley;
+
+RenderTargetPool::Definition::Definition(Vector2i size, TextureFormat format, bool useFiltering)
+	: size(size)
+	, format(format)
+	, useFiltering(useFiltering)
+{}
+
+bool RenderTargetPool::Definition::operator==(const Definition& other) const
+{
+	return size == other.size && format == other.format && useFiltering == other.useFiltering;
+}
+
+bool RenderTargetPool::Definition::operator!=(const Definition& other) const
+{
+	return !(*this == other);
+}
+
+RenderTargetPool::RenderTargetPool(VideoAPI& video, int framesToKeep)
+	: video(video)
+	, framesToKeep(framesToKeep)
+{
+	Expects(framesToKeep >= 0);
+}
+
+RenderTargetPool::~RenderTargetPool() = default;
+
+std::shared_ptr<Texture> RenderTargetPool::acquire(const Definition& definition)
+{
+	Expects(definition.size.x > 0 && definition.size.y > 0);
+
+	for (auto& e: entries) {
+		if (!e.inUse && e.definition == definition) {
+			e.inUse = true;
+			e.lastFrame = frame;
+			return e.texture;
+		}
+	}
+
+	Entry entry;
+	entry.definition = definition;
+	entry.texture = create(definition);
+	entry.lastFrame = frame;
+	entry.inUse = true;
+	entries.push_back(entry);
+	return entry.texture;
+}
+
+void RenderTargetPool::release(const std::shared_ptr<Texture>& texture)
+{
+	for (auto& e: entries) {
+		if (e.texture == texture) {
+			e.inUse = false;
+			e.lastFrame = frame;
+			return;
+		}
+	}
+}
+
+void RenderTargetPool::endFrame()
+{
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [&] (const Entry& e)
+	{
+		return !e.inUse && e.lastFrame + uint64_t(framesToKeep) <= frame;
+	}), entries.end());
+	++frame;
+}
+
+void RenderTargetPool::clear()
+{
+	entries.erase(std::remove_if(entries.begin(), entries.end(), [] (const Entry& e) { return !e.inUse; }), entries.end());
+}
+
+size_t RenderTargetPool::getNumTextures() const
+{
+	return entries.size();
+}
+
+size_t RenderTargetPool::getNumTexturesInUse() const
+{
+	return size_t(std::count_if(entries.begin(), entries.end(), [] (const Entry& e) { return e.inUse; }));
+}
+
+size_t RenderTargetPool::getNumTexturesCreated() const
+{
+	return nCreated;
+}
+
+std::shared_ptr<Texture> RenderTargetPool::create(const Definition& definition)
+{
+	std::shared_ptr<Texture> texture = video.createTexture(definition.size);
+	auto desc = TextureDescriptor(definition.size, definition.format);
+	desc.useFiltering = definition.useFiltering;
+	desc.isRenderTarget = definition.format != TextureFormat::DEPTH;
+	desc.isDepthStencil = definition.format == TextureFormat::DEPTH;
+	texture->load(std::move(desc));
+	++nCreated;
+	return texture;
+}
@@ -0,0 +1,102 @@
+#include "halley/core/graphics/render_thread.h"
+#include "halley/core/api/system_api.h"
+#include "halley/core/api/video_api.h"
+#include <halley/support/profiler.h>
+
+using namespace Halley;
+
+RenderThread::RenderThread(SystemAPI& system, VideoAPI& video, Painter& painter)
+	: video(video)
+	, painter(painter)
+{
+	video.releaseRenderContext();
+	thread = system.createThread("Render", ThreadPriority::High, [this] () { run(); });
+}
+
+RenderThread::~RenderThread()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		waitForIdle(lock);
+		running = false;
+	}
+	condition.notify_all();
+	thread.join();
+
+	// Hand the context back to whoever created us
+	video.acquireRenderContext();
+}
+
+void RenderThread::submit(RenderCommandList& commands)
+{
+	HALLEY_PROFILE_SCOPE("RenderThread::submit");
+	std::exception_ptr prevError;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		waitForIdle(lock);
+		std::swap(pending, commands);
+		hasPending = true;
+		prevError = error;
+		error = std::exception_ptr();
+	}
+	condition.notify_all();
+
+	if (prevError) {
+		std::rethrow_exception(prevError);
+	}
+}
+
+void RenderThread::waitForIdle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	waitForIdle(lock);
+}
+
+void RenderThread::waitForIdle(std::unique_lock<std::mutex>& lock)
+{
+	condition.wait(lock, [&] () { return !hasPending && !busy; });
+}
+
+void RenderThread::run()
+{
+	video.acquireRenderContext();
+
+	RenderCommandList frame;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		condition.wait(lock, [&] () { return hasPending || !running; });
+		if (!hasPending) {
+			break;
+		}
+
+		std::swap(frame, pending);
+		hasPending = false;
+		busy = true;
+		lock.unlock();
+
+		std::exception_ptr frameError;
+		try {
+			video.startRender();
+			frame.submit(painter);
+			{
+				HALLEY_PROFILE_SCOPE("VideoAPI::finishRender");
+				video.finishRender();
+			}
+		} catch (...) {
+			frameError = std::current_exception();
+		}
+
+		// Release this frame's snapshots here, while the context is still current
+		frame.clear();
+
+		lock.lock();
+		busy = false;
+		if (frameError) {
+			error = frameError;
+		}
+		condition.notify_all();
+	}
+	lock.unlock();
+
+	video.releaseRenderContext();
+}
@@ -271,6 +271,32 @@ bool Animation::hasSequence(const String& seqName) const
 	return false;
 }
 
+int Animation::getSequenceId(const String& seqName) const
+{
+	for (size_t i = 0; i < sequences.size(); ++i) {
+		if (sequences[i].getName() == seqName) {
+			return int(i);
+		}
+	}
+	return -1;
+}
+
+const AnimationSequence& Animation::getSequence(int id) const
+{
+	Expects(id >= 0 && id < int(sequences.size()));
+	return sequences[id];
+}
+
+int Animation::getDirectionId(const String& dirName) const
+{
+	for (auto& dir: directions) {
+		if (dir.name == dirName) {
+			return dir.id;
+		}
+	}
+	return -1;
+}
+
 void Animation::serialize(Serializer& s) const
 {
 	s << name;
@@ -0,0 +1,392 @@
+#include "graphics/sprite/animation_batch.h"
+#include "graphics/sprite/sprite.h"
+#include <gsl/gsl_assert>
+#include <limits>
+#include <algorithm>
+
+using namespace Halley;
+
+constexpr static uint32_t invalidIndex = std::numeric_limits<uint32_t>::max();
+
+AnimationBatch::AnimationBatch() = default;
+
+AnimationBatch::AnimationId AnimationBatch::addAnimation(std::shared_ptr<const Animation> animation)
+{
+	Expects(animation);
+	Expects(animation->getNumSequences() > 0);
+	Expects(animation->getNumDirections() > 0);
+
+	const auto existing = getAnimationId(*animation);
+	if (existing >= 0) {
+		return existing;
+	}
+
+	Expects(animations.size() < std::numeric_limits<uint16_t>::max());
+	animations.emplace_back();
+	auto& anim = animations.back();
+	anim.animation = std::move(animation);
+	anim.observer.startObserving(*anim.animation);
+	compileAnimation(anim);
+	return AnimationId(animations.size() - 1);
+}
+
+AnimationBatch::AnimationId AnimationBatch::getAnimationId(const Animation& animation) const
+{
+	for (size_t i = 0; i < animations.size(); ++i) {
+		if (animations[i].animation.get() == &animation) {
+			return AnimationId(i);
+		}
+	}
+	return -1;
+}
+
+int AnimationBatch::getSequenceId(AnimationId animation, const String& sequence) const
+{
+	return animations.at(animation).animation->getSequenceId(sequence);
+}
+
+int AnimationBatch::getDirectionId(AnimationId animation, const String& direction) const
+{
+	auto& anim = *animations.at(animation).animation;
+	for (size_t i = 0; i < anim.getNumDirections(); ++i) {
+		if (anim.getDirection(int(i)).getName() == direction) {
+			return int(i);
+		}
+	}
+	return -1;
+}
+
+AnimationBatch::InstanceId AnimationBatch::add(AnimationId animation, int sequence, int direction)
+{
+	Expects(animation >= 0 && animation < int(animations.size()));
+	Expects(direction >= 0 && direction < int(animations[animation].numDirections));
+
+	InstanceId id;
+	if (freeIds.empty()) {
+		id = InstanceId(denseIndex.size());
+		denseIndex.push_back(invalidIndex);
+	} else {
+		id = freeIds.back();
+		freeIds.pop_back();
+	}
+
+	const auto idx = uint32_t(ids.size());
+	denseIndex[id] = idx;
+	ids.push_back(id);
+	instAnimation.push_back(uint16_t(animation));
+	instSequence.push_back(0);
+	instFrame.push_back(0);
+	instDirection.push_back(uint16_t(direction));
+	instFrameTime.push_back(0);
+	instFrameLen.push_back(0);
+	instSpeed.push_back(1.0f);
+	instFlags.push_back(0);
+
+	startSequence(idx, sequence, getCompiledSequence(idx).loop);
+	return id;
+}
+
+void AnimationBatch::remove(InstanceId instance)
+{
+	const auto idx = getIndex(instance);
+	const auto last = uint32_t(ids.size() - 1);
+
+	if (instFlags[idx] & flagChanged) {
+		const auto iter = std::find(changed.begin(), changed.end(), idx);
+		*iter = changed.back();
+		changed.pop_back();
+	}
+
+	if (idx != last) {
+		if (instFlags[last] & flagChanged) {
+			*std::find(changed.begin(), changed.end(), last) = idx;
+		}
+		ids[idx] = ids[last];
+		instAnimation[idx] = instAnimation[last];
+		instSequence[idx] = instSequence[last];
+		instFrame[idx] = instFrame[last];
+		instDirection[idx] = instDirection[last];
+		instFrameTime[idx] = instFrameTime[last];
+		instFrameLen[idx] = instFrameLen[last];
+		instSpeed[idx] = instSpeed[last];
+		instFlags[idx] = instFlags[last];
+		denseIndex[ids[idx]] = idx;
+	}
+
+	ids.pop_back();
+	instAnimation.pop_back();
+	instSequence.pop_back();
+	instFrame.pop_back();
+	instDirection.pop_back();
+	instFrameTime.pop_back();
+	instFrameLen.pop_back();
+	instSpeed.pop_back();
+	instFlags.pop_back();
+
+	denseIndex[instance] = invalidIndex;
+	freeIds.push_back(instance);
+}
+
+void AnimationBatch::clear()
+{
+	ids.clear();
+	instAnimation.clear();
+	instSequence.clear();
+	instFrame.clear();
+	instDirection.clear();
+	instFrameTime.clear();
+	instFrameLen.clear();
+	instSpeed.clear();
+	instFlags.clear();
+	denseIndex.clear();
+	freeIds.clear();
+	changed.clear();
+}
+
+size_t AnimationBatch::size() const
+{
+	return ids.size();
+}
+
+void AnimationBatch::setSequence(InstanceId instance, int sequence)
+{
+	const auto idx = getIndex(instance);
+	if (int(instSequence[idx]) != sequence) {
+		startSequence(idx, sequence, animations[instAnimation[idx]].animation->getSequence(sequence).isLooping());
+	}
+}
+
+void AnimationBatch::playOnce(InstanceId instance, int sequence)
+{
+	startSequence(getIndex(instance), sequence, false);
+}
+
+void AnimationBatch::setDirection(InstanceId instance, int direction)
+{
+	const auto idx = getIndex(instance);
+	Expects(direction >= 0 && direction < int(animations[instAnimation[idx]].numDirections));
+	if (instDirection[idx] != direction) {
+		instDirection[idx] = uint16_t(direction);
+		markChanged(idx);
+	}
+}
+
+void AnimationBatch::setPlaybackSpeed(InstanceId instance, float speed)
+{
+	instSpeed[getIndex(instance)] = speed;
+}
+
+bool AnimationBatch::isPlaying(InstanceId instance) const
+{
+	return (instFlags[getIndex(instance)] & flagPlaying) != 0;
+}
+
+int AnimationBatch::getSequence(InstanceId instance) const
+{
+	return int(instSequence[getIndex(instance)]);
+}
+
+int AnimationBatch::getFrame(InstanceId instance) const
+{
+	return int(instFrame[getIndex(instance)]);
+}
+
+const SpriteSheetEntry& AnimationBatch::getSpriteEntry(InstanceId instance) const
+{
+	const auto idx = getIndex(instance);
+	auto& seq = getCompiledSequence(idx);
+	return *frameSprites[seq.firstSprite + instFrame[idx] * animations[instAnimation[idx]].numDirections + instDirection[idx]];
+}
+
+void AnimationBatch::update(Time time)
+{
+	checkForReloads();
+
+	const float dt = float(time);
+	const size_t n = ids.size();
+	float* frameTime = instFrameTime.data();
+	const float* frameLen = instFrameLen.data();
+	const float* speed = instSpeed.data();
+
+	// No branches or indirection here, so this vectorizes
+	for (size_t i = 0; i < n; ++i) {
+		frameTime[i] += dt * speed[i];
+	}
+
+	// Instances that are done have an infinite frame length, so only the ones moving to another frame get through
+	for (size_t i = 0; i < n; ++i) {
+		if (frameTime[i] >= frameLen[i]) {
+			advance(uint32_t(i));
+		}
+	}
+}
+
+void AnimationBatch::updateSprite(InstanceId instance, Sprite& sprite) const
+{
+	applyToSprite(getIndex(instance), sprite);
+}
+
+void AnimationBatch::compile()
+{
+	sequences.clear();
+	frameDurations.clear();
+	frameSprites.clear();
+	for (auto& anim: animations) {
+		compileAnimation(anim);
+	}
+
+	// The animations might have lost sequences, directions or frames
+	for (uint32_t idx = 0; idx < uint32_t(ids.size()); ++idx) {
+		auto& anim = animations[instAnimation[idx]];
+		if (instSequence[idx] >= anim.numSequences) {
+			instSequence[idx] = 0;
+			instFrame[idx] = 0;
+		}
+		if (instDirection[idx] >= anim.numDirections) {
+			instDirection[idx] = 0;
+		}
+		instFrame[idx] = std::min(instFrame[idx], getCompiledSequence(idx).numFrames - 1);
+		if (instFlags[idx] & flagPlaying) {
+			resolveFrame(idx);
+		}
+		markChanged(idx);
+	}
+}
+
+void AnimationBatch::compileAnimation(CompiledAnimation& anim)
+{
+	auto& animation = *anim.animation;
+	anim.firstSequence = uint32_t(sequences.size());
+	anim.numSequences = uint32_t(animation.getNumSequences());
+	anim.numDirections = uint32_t(animation.getNumDirections());
+
+	anim.dirFlip.resize(anim.numDirections);
+	for (uint32_t d = 0; d < anim.numDirections; ++d) {
+		anim.dirFlip[d] = animation.getDirection(int(d)).shouldFlip();
+	}
+
+	for (uint32_t s = 0; s < anim.numSequences; ++s) {
+		auto& seq = animation.getSequence(int(s));
+		Expects(seq.numFrames() > 0);
+
+		CompiledSequence compiled;
+		compiled.firstFrame = uint32_t(frameDurations.size());
+		compiled.numFrames = uint32_t(seq.numFrames());
+		compiled.firstSprite = uint32_t(frameSprites.size());
+		compiled.loop = seq.isLooping();
+		compiled.noFlip = seq.isNoFlip();
+		sequences.push_back(compiled);
+
+		for (size_t f = 0; f < seq.numFrames(); ++f) {
+			auto& frame = seq.getFrame(f);
+			frameDurations.push_back(std::max(1, frame.getDuration()) * 0.001f); // 1ms minimum
+			for (uint32_t d = 0; d < anim.numDirections; ++d) {
+				frameSprites.push_back(&frame.getSprite(int(d)));
+			}
+		}
+	}
+}
+
+void AnimationBatch::checkForReloads()
+{
+	bool needsCompile = false;
+	for (auto& anim: animations) {
+		if (anim.observer.needsUpdate()) {
+			anim.observer.update();
+			needsCompile = true;
+		}
+	}
+	if (needsCompile) {
+		compile();
+	}
+}
+
+uint32_t AnimationBatch::getIndex(InstanceId instance) const
+{
+	Expects(instance < denseIndex.size());
+	const auto idx = denseIndex[instance];
+	Expects(idx != invalidIndex);
+	return idx;
+}
+
+const AnimationBatch::CompiledSequence& AnimationBatch::getCompiledSequence(uint32_t idx) const
+{
+	return sequences[animations[instAnimation[idx]].firstSequence + instSequence[idx]];
+}
+
+void AnimationBatch::startSequence(uint32_t idx, int sequence, bool loop)
+{
+	Expects(sequence >= 0 && sequence < int(animations[instAnimation[idx]].numSequences));
+
+	instSequence[idx] = uint32_t(sequence);
+	instFrame[idx] = 0;
+	instFrameTime[idx] = 0;
+	instFlags[idx] = uint8_t((instFlags[idx] & flagChanged) | flagPlaying | (loop ? flagLooping : 0));
+	resolveFrame(idx);
+	markChanged(idx);
+}
+
+void AnimationBatch::advance(uint32_t idx)
+{
+	auto& seq = getCompiledSequence(idx);
+	const auto prevFrame = instFrame[idx];
+	auto& frame = instFrame[idx];
+	auto& frameTime = instFrameTime[idx];
+	auto& frameLen = instFrameLen[idx];
+
+	for (int i = 0; i < 5 && frameTime >= frameLen; ++i) {
+		frameTime -= frameLen;
+		++frame;
+
+		if (frame >= seq.numFrames) {
+			if (instFlags[idx] & flagLooping) {
+				frame = 0;
+			} else {
+				frame = seq.numFrames - 1;
+				instFlags[idx] &= ~flagPlaying;
+				frameTime = 0;
+				frameLen = std::numeric_limits<float>::infinity();
+				break;
+			}
+		}
+		frameLen = frameDurations[seq.firstFrame + frame];
+	}
+
+	if (frame != prevFrame) {
+		markChanged(idx);
+	}
+}
+
+void AnimationBatch::resolveFrame(uint32_t idx)
+{
+	instFrameLen[idx] = frameDurations[getCompiledSequence(idx).firstFrame + instFrame[idx]];
+}
+
+void AnimationBatch::markChanged(uint32_t idx)
+{
+	if (!(instFlags[idx] & flagChanged)) {
+		instFlags[idx] |= flagChanged;
+		changed.push_back(idx);
+	}
+}
+
+void AnimationBatch::clearChanged()
+{
+	for (auto idx: changed) {
+		instFlags[idx] &= ~flagChanged;
+	}
+	changed.clear();
+}
+
+void AnimationBatch::applyToSprite(uint32_t idx, Sprite& sprite) const
+{
+	auto& anim = animations[instAnimation[idx]];
+	auto& seq = getCompiledSequence(idx);
+	const auto dir = instDirection[idx];
+	auto& entry = *frameSprites[seq.firstSprite + instFrame[idx] * anim.numDirections + dir];
+
+	sprite.setMaterial(anim.animation->getMaterial());
+	sprite.setSprite(entry, false);
+	sprite.setPivot(entry.pivot);
+	sprite.setFlip(anim.dirFlip[dir] && !seq.noFlip);
+}
@@ -49,24 +49,41 @@ AnimationPlayer& AnimationPlayer::setSequence(const String& sequence)
 	updateIfNeeded();
 
 	if (animation && (!curSeq || curSeq->getName() != sequence)) {
-		curSeqTime = 0;
-		curFrameTime = 0;
-		curFrame = 0;
-		curFrameLen = 0;
-		curSeq = &animation->getSequence(sequence);
-		Expects(curSeq);
-
-		seqLen = curSeq->numFrames();
-		seqLooping = curSeq->isLooping();
-		seqNoFlip = curSeq->isNoFlip();
+		const int id = animation->getSequenceId(sequence);
+		startSequence(id >= 0 ? id : 0);
+	}
+	return *this;
+}
 
-		dirty = true;
+AnimationPlayer& AnimationPlayer::setSequence(int sequenceId)
+{
+	updateIfNeeded();
 
-		onSequenceStarted();
+	if (animation && (!curSeq || seqId != sequenceId)) {
+		startSequence(sequenceId);
+		curSeqName = curSeq->getName(); // Only when it changes, and needed to find it again if the animation is reloaded
 	}
 	return *this;
 }
 
+void AnimationPlayer::startSequence(int id)
+{
+	curSeqTime = 0;
+	curFrameTime = 0;
+	curFrame = 0;
+	curFrameLen = 0;
+	seqId = id;
+	curSeq = &animation->getSequence(id);
+
+	seqLen = curSeq->numFrames();
+	seqLooping = curSeq->isLooping();
+	seqNoFlip = curSeq->isNoFlip();
+
+	dirty = true;
+
+	onSequenceStarted();
+}
+
 AnimationPlayer& AnimationPlayer::setDirection(int direction)
 {
 	updateIfNeeded();
@@ -200,6 +217,11 @@ String AnimationPlayer::getCurrentSequenceName() const
 	return curSeq ? curSeq->getName() : "";
 }
 
+int AnimationPlayer::getCurrentSequenceId() const
+{
+	return curSeq ? seqId : -1;
+}
+
 Time AnimationPlayer::getCurrentSequenceTime() const
 {
 	return curSeqTime;
@@ -215,6 +237,11 @@ String AnimationPlayer::getCurrentDirectionName() const
 	return curDir ? curDir->getName() : "default";
 }
 
+int AnimationPlayer::getCurrentDirectionId() const
+{
+	return curDir ? dirId : -1;
+}
+
 AnimationPlayer& AnimationPlayer::setPlaybackSpeed(float value)
 {
 	playbackSpeed = value;
@@ -6,6 +6,8 @@
 #include "halley/core/graphics/material/material_definition.h"
 #include "halley/core/graphics/material/material_parameter.h"
 #include "halley/core/graphics/texture.h"
+#include "halley/maths/transform_2d.h"
+#include "halley/maths/batch_transform.h"
 #include "resources/resources.h"
 #include <gsl/gsl_assert>
 
@@ -26,15 +28,38 @@ void Sprite::draw(Painter& painter) const
 	}
 }
 
+void Sprite::drawAtDepth(Painter& painter, float depth) const
+{
+	auto attrib = vertexAttrib;
+	attrib.depth = depth;
+	if (sliced) {
+		drawSliced(painter, slices, attrib);
+	} else {
+		drawNormal(painter, attrib);
+	}
+}
+
 void Sprite::drawNormal(Painter& painter) const
+{
+	drawNormal(painter, vertexAttrib);
+}
+
+void Sprite::drawNormal(Painter& painter, const SpriteVertexAttrib& attrib) const
 {
 	Expects(material);
 	Expects(material->getDefinition().getVertexStride() == sizeof(SpriteVertexAttrib));
+
+	if (clip && material->getDefinition().hasShaderClip()) {
+		auto clipped = attrib;
+		applyShaderClip(clipped);
+		painter.drawSprites(material, 1, &clipped);
+		return;
+	}
 	
 	if (clip) {
-		painter.setRelativeClip(clip.get() + (absoluteClip ? Vector2f() : vertexAttrib.pos));
+		painter.setRelativeClip(clip.get() + (absoluteClip ? Vector2f() : attrib.pos));
 	}
-	painter.drawSprites(material, 1, &vertexAttrib);
+	painter.drawSprites(material, 1, &attrib);
 	if (clip) {
 		painter.setClip();
 	}
@@ -46,6 +71,11 @@ void Sprite::drawSliced(Painter& painter) const
 }
 
 void Sprite::drawSliced(Painter& painter, Vector4s slicesPixel) const
+{
+	drawSliced(painter, slicesPixel, vertexAttrib);
+}
+
+void Sprite::drawSliced(Painter& painter, Vector4s slicesPixel, const SpriteVertexAttrib& attrib) const
 {
 	Expects(material);
 	Expects(material->getDefinition().getVertexStride() == sizeof(SpriteVertexAttrib));
@@ -56,10 +86,17 @@ void Sprite::drawSliced(Painter& painter, Vector4s slicesPixel) const
 	slices.z /= size.x;
 	slices.w /= size.y;
 
+	if (clip && material->getDefinition().hasShaderClip()) {
+		auto clipped = attrib;
+		applyShaderClip(clipped);
+		painter.drawSlicedSprite(material, attrib.scale, slices, &clipped);
+		return;
+	}
+
 	if (clip) {
-		painter.setRelativeClip(clip.get() + vertexAttrib.pos);
+		painter.setRelativeClip(clip.get() + (absoluteClip ? Vector2f() : attrib.pos));
 	}
-	painter.drawSlicedSprite(material, vertexAttrib.scale, slices, &vertexAttrib);
+	painter.drawSlicedSprite(material, attrib.scale, slices, &attrib);
 	if (clip) {
 		painter.setClip();
 	}
@@ -86,10 +123,15 @@ void Sprite::draw(const Sprite* sprites, size_t n, Painter& painter) // static
 		vertexData = vertices.data();
 	}
 
+	const bool shaderClip = material->getDefinition().hasShaderClip();
 	for (size_t i = 0; i < n; i++) {
 		auto& sprite = sprites[i];
 		Expects(sprite.material == material);
 		memcpy(&vertexData[i * spriteSize], &sprite.vertexAttrib, spriteSize);
+		if (shaderClip) {
+			// Otherwise, as with drawMixedMaterials, the clip is up to the caller
+			sprite.applyShaderClip(*reinterpret_cast<SpriteVertexAttrib*>(&vertexData[i * spriteSize]));
+		}
 	}
 
 	painter.drawSprites(material, n, vertexData);
@@ -122,9 +164,11 @@ Rect4f Sprite::getAABB() const
 		Vector2f sz = getScaledSize();
 		return Rect4f(pos - sz * vertexAttrib.pivot, pos + sz * (Vector2f(1, 1) - vertexAttrib.pivot));
 	} else {
-		// This is a coarse test; will give a few false positives
-		Vector2f sz = getScaledSize() * 1.4142136f; // sqrt(2)
-		return Rect4f(pos - sz, pos + sz); // Could use offset here, but that would also need to take rotation into account
+		// Exact too, same as SpritePainter's culling
+		Rect4f result;
+		const Vector2f sz = getScaledSize();
+		BatchTransform::computeAABBs(gsl::span<const Vector2f>(&pos, 1), gsl::span<const Vector2f>(&vertexAttrib.pivot, 1), gsl::span<const Vector2f>(&sz, 1), gsl::span<const float>(&vertexAttrib.rotation, 1), gsl::span<Rect4f>(&result, 1));
+		return result;
 	}
 }
 
@@ -148,6 +192,17 @@ Colour4f Sprite::getColour() const
 	return vertexAttrib.colour;
 }
 
+Sprite& Sprite::setDepth(float depth)
+{
+	vertexAttrib.depth = depth;
+	return *this;
+}
+
+float Sprite::getDepth() const
+{
+	return vertexAttrib.depth;
+}
+
 Sprite& Sprite::setPos(Vector2f v)
 {
 	vertexAttrib.pos = v;
@@ -166,6 +221,13 @@ Sprite& Sprite::setRotation(Angle1f v)
 	return *this;
 }
 
+Sprite& Sprite::setTransform(const Transform2D& transform)
+{
+	setPosition(transform.position);
+	setRotation(transform.rotation);
+	return setScale(transform.scale);
+}
+
 Sprite& Sprite::setColour(Colour4f v)
 {
 	vertexAttrib.colour = v;
@@ -244,6 +306,17 @@ Rect4f Sprite::getTexRect() const
 	return vertexAttrib.texRect;
 }
 
+Sprite& Sprite::setTextureLayer(int layer)
+{
+	vertexAttrib.textureLayer = float(layer);
+	return *this;
+}
+
+int Sprite::getTextureLayer() const
+{
+	return int(vertexAttrib.textureLayer);
+}
+
 Sprite& Sprite::setMaterial(Resources& resources, String materialName)
 {
 	if (materialName == "") {
@@ -398,6 +471,29 @@ Maybe<Rect4f> Sprite::getClip() const
 	return clip;
 }
 
+bool Sprite::isBatchable() const
+{
+	if (!material || sliced) {
+		return false;
+	}
+	auto& definition = material->getDefinition();
+	return definition.getVertexStride() == sizeof(SpriteVertexAttrib) && (!clip || definition.hasShaderClip());
+}
+
+SpriteVertexAttrib Sprite::getBatchVertexAttrib() const
+{
+	auto attrib = vertexAttrib;
+	applyShaderClip(attrib);
+	return attrib;
+}
+
+void Sprite::applyShaderClip(SpriteVertexAttrib& attrib) const
+{
+	if (clip) {
+		attrib.clip = clip.get() + (absoluteClip ? Vector2f() : attrib.pos);
+	}
+}
+
 Sprite Sprite::clone() const
 {
 	return *this;
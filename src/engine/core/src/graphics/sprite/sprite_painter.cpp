@@ -3,9 +3,75 @@
 #include "graphics/painter.h"
 #include <gsl/gsl>
 #include "graphics/text/text_renderer.h"
+#include "graphics/material/material.h"
+#include "graphics/material/material_definition.h"
+#include "graphics/texture.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <halley/utils/utils.h>
+#include <halley/maths/batch_transform.h>
+#include <halley/concurrency/concurrent.h>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386)
+#define HAS_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#include <arm_neon.h>
+#endif
 
 using namespace Halley;
 
+namespace {
+	// How a sprite's material uses the depth buffer
+	constexpr uint8_t DepthModeNone = 0;
+	constexpr uint8_t DepthModeTested = 1;
+	constexpr uint8_t DepthModeOpaque = 2; // Also writes it, and covers whatever's behind
+
+	// Passes over fewer sprites than this stay on the calling thread
+	constexpr size_t parallelThreshold = 8192;
+	constexpr size_t parallelGrainSize = 4096;
+
+	size_t getNumChunks(size_t n)
+	{
+		return n >= parallelThreshold && Executors::isDefined() ? std::max(size_t(1), Concurrent::getChunkCount(Executors::getCPU(), n, parallelGrainSize)) : 1;
+	}
+
+	// As Concurrent::forChunks, on the CPU executor, or on this thread for a single chunk
+	template <typename F>
+	void runChunks(size_t n, size_t nChunks, F f)
+	{
+		if (nChunks > 1 && Executors::isDefined()) {
+			Concurrent::forChunks(Executors::getCPU(), n, nChunks, f);
+		} else {
+			const size_t base = n / std::max(size_t(1), nChunks);
+			const size_t extra = n % std::max(size_t(1), nChunks);
+			for (size_t j = 0; j < nChunks; ++j) {
+				f(j, j * base + std::min(j, extra), (j + 1) * base + std::min(j + 1, extra));
+			}
+		}
+	}
+
+	// Lets mip streamed textures know how much detail this sprite needs on screen
+	void requestMipLevels(const Sprite& sprite, float zoom)
+	{
+		if (!sprite.hasMaterial()) {
+			return;
+		}
+		const auto scale = sprite.getScale();
+		const float pixelsPerTexel = std::max(std::abs(scale.x), std::abs(scale.y)) * zoom;
+		for (auto& texture: sprite.getMaterial().getTextures()) {
+			if (texture && texture->isMipStreamed()) {
+				texture->requestMipLevel(Texture::getMipLevelFor(pixelsPerTexel));
+			}
+		}
+	}
+}
+
 SpritePainterEntry::SpritePainterEntry(const Sprite& sprite, int mask, int layer, float tieBreaker)
 	: ptr(&sprite)
 	, type(SpritePainterEntryType::SpriteRef)
@@ -47,6 +113,16 @@ SpritePainterEntryType SpritePainterEntry::getType() const
 	return type;
 }
 
+int SpritePainterEntry::getLayer() const
+{
+	return layer;
+}
+
+float SpritePainterEntry::getTieBreaker() const
+{
+	return tieBreaker;
+}
+
 const Sprite& SpritePainterEntry::getSprite() const
 {
 	Expects(ptr != nullptr);
@@ -72,6 +148,40 @@ int SpritePainterEntry::getMask() const
 	return mask;
 }
 
+void SpritePainterBucket::add(const Sprite& sprite, int mask, int layer, float tieBreaker)
+{
+	sprites.push_back(SpritePainterEntry(sprite, mask, layer, tieBreaker));
+}
+
+void SpritePainterBucket::addCopy(const Sprite& sprite, int mask, int layer, float tieBreaker)
+{
+	sprites.push_back(SpritePainterEntry(SpritePainterEntryType::SpriteCached, cachedSprites.size(), mask, layer, tieBreaker));
+	cachedSprites.push_back(sprite);
+}
+
+void SpritePainterBucket::add(const TextRenderer& text, int mask, int layer, float tieBreaker)
+{
+	sprites.push_back(SpritePainterEntry(text, mask, layer, tieBreaker));
+}
+
+void SpritePainterBucket::addCopy(const TextRenderer& text, int mask, int layer, float tieBreaker)
+{
+	sprites.push_back(SpritePainterEntry(SpritePainterEntryType::TextCached, cachedText.size(), mask, layer, tieBreaker));
+	cachedText.push_back(text);
+}
+
+size_t SpritePainterBucket::size() const
+{
+	return sprites.size();
+}
+
+void SpritePainterBucket::clear()
+{
+	sprites.clear();
+	cachedSprites.clear();
+	cachedText.clear();
+}
+
 void SpritePainter::start(size_t nSprites)
 {
 	if (sprites.capacity() < nSprites) {
@@ -80,6 +190,11 @@ void SpritePainter::start(size_t nSprites)
 	sprites.clear();
 	cachedSprites.clear();
 	cachedText.clear();
+	for (size_t i = 0; i < bucketsUsed; ++i) {
+		buckets[i].clear();
+	}
+	bucketsUsed = 0;
+	dirty = true;
 }
 
 void SpritePainter::add(const Sprite& sprite, int mask, int layer, float tieBreaker)
@@ -108,47 +223,459 @@ void SpritePainter::addCopy(const TextRenderer& text, int mask, int layer, float
 	dirty = true;
 }
 
+gsl::span<SpritePainterBucket> SpritePainter::getBuckets(size_t n)
+{
+	const size_t first = bucketsUsed;
+	bucketsUsed += n;
+	if (buckets.size() < bucketsUsed) {
+		buckets.resize(bucketsUsed);
+	}
+	dirty = true;
+	return gsl::span<SpritePainterBucket>(buckets.data() + first, std::ptrdiff_t(n));
+}
+
+void SpritePainter::gather(size_t n, const std::function<void(SpritePainterBucket&, size_t, size_t)>& f)
+{
+	auto& executor = Executors::getCPU();
+	const size_t nChunks = Concurrent::getChunkCount(executor, n);
+	auto chunkBuckets = getBuckets(nChunks);
+	Concurrent::forChunks(executor, n, nChunks, [&] (size_t chunk, size_t start, size_t end)
+	{
+		f(chunkBuckets[chunk], start, end);
+	});
+}
+
 void SpritePainter::draw(int mask, Painter& painter)
 {
 	if (dirty) {
-		// TODO: implement hierarchical bucketing.
-		// - one bucket per layer
-		// - for each layer, one bucket per vertical band of the screen (32px or so)
-		// - sort each leaf bucket
-		std::sort(sprites.begin(), sprites.end()); // lol
+		mergeBuckets();
+		updateBounds();
 		dirty = false;
+		allSorted = false;
 	}
 
 	// View
 	auto& cam = painter.getCurrentCamera();
 	Rect4f view = cam.getClippingRectangle();
 
-	// Draw!
-	for (auto& s : sprites) {
-		if ((s.getMask() & mask) != 0) {
-			auto type = s.getType();
-			if (type == SpritePainterEntryType::SpriteRef) {
-				draw(s.getSprite(), painter, view);
-			} else if (type == SpritePainterEntryType::SpriteCached) {
-				draw(cachedSprites[s.getIndex()], painter, view);
-			} else if (type == SpritePainterEntryType::TextRef) {
-				draw(s.getText(), painter, view);
-			} else if (type == SpritePainterEntryType::TextCached) {
-				draw(cachedText[s.getIndex()], painter, view);
+	cull(view, mask);
+	if (multipleViews) {
+		if (!allSorted) {
+			allIndices.resize(sprites.size());
+			for (size_t i = 0; i < allIndices.size(); ++i) {
+				allIndices[i] = uint32_t(i);
 			}
+			sort(allIndices);
+			std::swap(allSortEntries, sortEntries);
+			allSorted = true;
+		}
+
+		// What this view sees, in the shared order
+		inView.assign(sprites.size(), 0);
+		for (auto idx: visible) {
+			inView[idx] = 1;
+		}
+		sortEntries.clear();
+		for (auto& e: allSortEntries) {
+			if (inView[e.idx]) {
+				sortEntries.push_back(e);
+			}
+		}
+	} else {
+		sort(visible);
+	}
+
+	// Everything behind the first entry that ignores depth can rely on the depth buffer for its order
+	const size_t n = sortEntries.size();
+	depthModes.resize(n);
+	runChunks(n, getNumChunks(n), [&] (size_t, size_t start, size_t end)
+	{
+		for (size_t i = start; i < end; ++i) {
+			depthModes[i] = getDepthMode(sprites[sortEntries[i].idx]);
+		}
+	});
+	const size_t depthPrefix = std::find(depthModes.begin(), depthModes.end(), DepthModeNone) - depthModes.begin();
+
+	// Later in the draw order is closer, and everything stays within the camera's depth range
+	const float depthStep = 999.0f / float(n + 1);
+	auto getDepth = [&] (size_t i) { return -depthStep * float(n - i); };
+
+	// Consecutive sprites of the same material go to the painter in one call, which can then generate their vertices in parallel
+	const float zoom = cam.getZoom();
+	const std::shared_ptr<Material>* batchMaterial = nullptr;
+	auto flushBatch = [&] ()
+	{
+		if (!batchVertices.empty()) {
+			painter.drawSprites(*batchMaterial, batchVertices.size(), batchVertices.data());
+			batchVertices.clear();
+		}
+	};
+	auto drawEntry = [&] (size_t i)
+	{
+		auto& entry = sprites[sortEntries[i].idx];
+		const Sprite* sprite = getSprite(entry);
+		if (sprite && sprite->isBatchable()) {
+			if (!batchVertices.empty() && batchMaterial->get() != sprite->getMaterialPtr().get()) {
+				flushBatch();
+			}
+			requestMipLevels(*sprite, zoom);
+			batchMaterial = &sprite->getMaterialPtr();
+			batchVertices.push_back(sprite->getBatchVertexAttrib());
+			if (depthModes[i] != DepthModeNone) {
+				batchVertices.back().depth = getDepth(i);
+			}
+		} else {
+			flushBatch();
+			draw(entry, painter, zoom, depthModes[i], getDepth(i));
+		}
+	};
+
+	// Draw!
+	for (size_t i = depthPrefix; i-- > 0; ) {
+		if (depthModes[i] == DepthModeOpaque) {
+			drawEntry(i);
 		}
 	}
+	for (size_t i = 0; i < n; ++i) {
+		if (i >= depthPrefix || depthModes[i] != DepthModeOpaque) {
+			drawEntry(i);
+		}
+	}
+	flushBatch();
 	painter.flush();
 }
 
-void SpritePainter::draw(const Sprite& sprite, Painter& painter, Rect4f view)
+void SpritePainter::setLayerUnordered(int layer, bool unordered)
 {
-	if (sprite.isInView(view)) {
-		sprite.draw(painter);
+	auto iter = std::find(unorderedLayers.begin(), unorderedLayers.end(), layer);
+	if (unordered && iter == unorderedLayers.end()) {
+		unorderedLayers.push_back(layer);
+	} else if (!unordered && iter != unorderedLayers.end()) {
+		unorderedLayers.erase(iter);
 	}
+	allSorted = false;
+}
+
+void SpritePainter::setMultipleViews(bool enabled)
+{
+	if (multipleViews != enabled) {
+		multipleViews = enabled;
+		allSorted = false;
+		allSortEntries.clear();
+	}
+}
+
+void SpritePainter::mergeBuckets()
+{
+	if (bucketsUsed == 0) {
+		return;
+	}
+
+	struct Offsets
+	{
+		size_t sprites;
+		size_t cachedSprites;
+		size_t cachedText;
+	};
+	Vector<Offsets> offsets(bucketsUsed);
+	Offsets total{ sprites.size(), cachedSprites.size(), cachedText.size() };
+	for (size_t i = 0; i < bucketsUsed; ++i) {
+		offsets[i] = total;
+		total.sprites += buckets[i].sprites.size();
+		total.cachedSprites += buckets[i].cachedSprites.size();
+		total.cachedText += buckets[i].cachedText.size();
+	}
+	const size_t nAdded = total.sprites - sprites.size();
+	sprites.resize(total.sprites);
+	cachedSprites.resize(total.cachedSprites);
+	cachedText.resize(total.cachedText);
+
+	// Each bucket goes to a range of its own, so they can all be copied at once
+	runChunks(bucketsUsed, nAdded >= parallelThreshold ? bucketsUsed : 1, [&] (size_t, size_t start, size_t end)
+	{
+		for (size_t i = start; i < end; ++i) {
+			auto& bucket = buckets[i];
+			const auto& offset = offsets[i];
+			for (size_t j = 0; j < bucket.sprites.size(); ++j) {
+				const auto& e = bucket.sprites[j];
+				const auto type = e.getType();
+				if (type == SpritePainterEntryType::SpriteCached || type == SpritePainterEntryType::TextCached) {
+					const size_t idx = e.getIndex() + (type == SpritePainterEntryType::SpriteCached ? offset.cachedSprites : offset.cachedText);
+					sprites[offset.sprites + j] = SpritePainterEntry(type, idx, e.getMask(), e.getLayer(), e.getTieBreaker());
+				} else {
+					sprites[offset.sprites + j] = e;
+				}
+			}
+			std::move(bucket.cachedSprites.begin(), bucket.cachedSprites.end(), cachedSprites.begin() + offset.cachedSprites);
+			std::move(bucket.cachedText.begin(), bucket.cachedText.end(), cachedText.begin() + offset.cachedText);
+			bucket.clear();
+		}
+	});
+	bucketsUsed = 0;
+}
+
+void SpritePainter::updateBounds()
+{
+	const size_t n = sprites.size();
+	boundsMinX.resize(n);
+	boundsMinY.resize(n);
+	boundsMaxX.resize(n);
+	boundsMaxY.resize(n);
+
+	quadPositions.resize(n);
+	quadPivots.resize(n);
+	quadSizes.resize(n);
+	quadRotations.resize(n);
+	runChunks(n, getNumChunks(n), [&] (size_t, size_t start, size_t end)
+	{
+		for (size_t i = start; i < end; ++i) {
+			const Sprite* sprite = getSprite(sprites[i]);
+			if (sprite) {
+				const auto& vertex = sprite->getVertexAttrib();
+				quadPositions[i] = vertex.pos;
+				quadPivots[i] = vertex.pivot;
+				quadSizes[i] = vertex.size * vertex.scale;
+				quadRotations[i] = vertex.rotation;
+			} else {
+				quadPositions[i] = Vector2f();
+				quadPivots[i] = Vector2f();
+				quadSizes[i] = Vector2f();
+				quadRotations[i] = 0;
+			}
+		}
+
+		const auto count = std::ptrdiff_t(end - start);
+		BatchTransform::computeAABBs(gsl::span<const Vector2f>(quadPositions.data() + start, count), gsl::span<const Vector2f>(quadPivots.data() + start, count),
+			gsl::span<const Vector2f>(quadSizes.data() + start, count), gsl::span<const float>(quadRotations.data() + start, count),
+			gsl::span<float>(boundsMinX.data() + start, count), gsl::span<float>(boundsMinY.data() + start, count),
+			gsl::span<float>(boundsMaxX.data() + start, count), gsl::span<float>(boundsMaxY.data() + start, count));
+
+		// Then the ones that don't go by their quad
+		constexpr float inf = std::numeric_limits<float>::infinity();
+		for (size_t i = start; i < end; ++i) {
+			const Sprite* sprite = getSprite(sprites[i]);
+
+			if (!sprite) {
+				// Text doesn't know its bounds, so it's never culled
+				boundsMinX[i] = -inf;
+				boundsMinY[i] = -inf;
+				boundsMaxX[i] = inf;
+				boundsMaxY[i] = inf;
+			} else if (!sprite->isVisible()) {
+				// Inverted bounds, which overlap nothing
+				boundsMinX[i] = inf;
+				boundsMinY[i] = inf;
+				boundsMaxX[i] = -inf;
+				boundsMaxY[i] = -inf;
+			}
+		}
+	});
+}
+
+void SpritePainter::cull(Rect4f view, int mask)
+{
+	// Same test as Rect4f::overlaps
+	const size_t n = sprites.size();
+	visible.clear();
+
+	auto addIfInMask = [&] (size_t i)
+	{
+		if ((sprites[i].getMask() & mask) != 0) {
+			visible.push_back(uint32_t(i));
+		}
+	};
+
+	size_t i = 0;
+#if defined(HAS_SSE)
+	const __m128 viewMinX = _mm_set1_ps(view.getLeft());
+	const __m128 viewMinY = _mm_set1_ps(view.getTop());
+	const __m128 viewMaxX = _mm_set1_ps(view.getRight());
+	const __m128 viewMaxY = _mm_set1_ps(view.getBottom());
+	for (; i + 4 <= n; i += 4) {
+		const __m128 inX = _mm_and_ps(_mm_cmpgt_ps(_mm_loadu_ps(boundsMaxX.data() + i), viewMinX), _mm_cmplt_ps(_mm_loadu_ps(boundsMinX.data() + i), viewMaxX));
+		const __m128 inY = _mm_and_ps(_mm_cmpgt_ps(_mm_loadu_ps(boundsMaxY.data() + i), viewMinY), _mm_cmplt_ps(_mm_loadu_ps(boundsMinY.data() + i), viewMaxY));
+		const int bits = _mm_movemask_ps(_mm_and_ps(inX, inY));
+		for (size_t j = 0; bits != 0 && j < 4; ++j) {
+			if (bits & (1 << j)) {
+				addIfInMask(i + j);
+			}
+		}
+	}
+#elif defined(HAS_NEON)
+	const float32x4_t viewMinX = vdupq_n_f32(view.getLeft());
+	const float32x4_t viewMinY = vdupq_n_f32(view.getTop());
+	const float32x4_t viewMaxX = vdupq_n_f32(view.getRight());
+	const float32x4_t viewMaxY = vdupq_n_f32(view.getBottom());
+	for (; i + 4 <= n; i += 4) {
+		const uint32x4_t inX = vandq_u32(vcgtq_f32(vld1q_f32(boundsMaxX.data() + i), viewMinX), vcltq_f32(vld1q_f32(boundsMinX.data() + i), viewMaxX));
+		const uint32x4_t inY = vandq_u32(vcgtq_f32(vld1q_f32(boundsMaxY.data() + i), viewMinY), vcltq_f32(vld1q_f32(boundsMinY.data() + i), viewMaxY));
+		uint32_t lanes[4];
+		vst1q_u32(lanes, vandq_u32(inX, inY));
+		for (size_t j = 0; j < 4; ++j) {
+			if (lanes[j] != 0) {
+				addIfInMask(i + j);
+			}
+		}
+	}
+#endif
+	for (; i < n; ++i) {
+		if (boundsMaxX[i] > view.getLeft() && boundsMinX[i] < view.getRight() && boundsMaxY[i] > view.getTop() && boundsMinY[i] < view.getBottom()) {
+			addIfInMask(i);
+		}
+	}
+}
+
+void SpritePainter::sort(const Vector<uint32_t>& indices)
+{
+	const size_t n = indices.size();
+	sortEntries.resize(n);
+	sortScratch.resize(n);
+
+	// Large sorts are split into chunks, each with a histogram of its own, and scattered in parallel
+	const size_t nChunks = getNumChunks(n);
+	chunkHistograms.resize(nChunks);
+	Vector<std::pair<uint64_t, uint64_t>> chunkBits(nChunks);
+	runChunks(n, nChunks, [&] (size_t chunk, size_t start, size_t end)
+	{
+		uint64_t keysOr = 0;
+		uint64_t keysAnd = ~uint64_t(0);
+		for (size_t i = start; i < end; ++i) {
+			const uint32_t idx = indices[i];
+			const uint64_t key = getSortKey(sprites[idx]);
+			sortEntries[i] = SortEntry{ key, idx };
+			keysOr |= key;
+			keysAnd &= key;
+		}
+		chunkBits[chunk] = std::make_pair(keysOr, keysAnd);
+	});
+	uint64_t allKeysOr = 0;
+	uint64_t allKeysAnd = ~uint64_t(0);
+	for (auto& b: chunkBits) {
+		allKeysOr |= b.first;
+		allKeysAnd &= b.second;
+	}
+
+	// LSD radix sort, 8 bits per pass. It's stable, so ties keep their insertion order; each digit's entries are placed chunk by chunk.
+	// Passes where every key has the same digit (e.g. a single layer) are skipped.
+	const uint64_t varyingBits = allKeysOr ^ allKeysAnd;
+	for (int shift = 0; shift < 64; shift += 8) {
+		if (((varyingBits >> shift) & 0xFF) == 0) {
+			continue;
+		}
+
+		runChunks(n, nChunks, [&] (size_t chunk, size_t start, size_t end)
+		{
+			auto& histogram = chunkHistograms[chunk];
+			histogram.fill(0);
+			for (size_t i = start; i < end; ++i) {
+				++histogram[(sortEntries[i].key >> shift) & 0xFF];
+			}
+		});
+		uint32_t total = 0;
+		for (size_t digit = 0; digit < 256; ++digit) {
+			for (auto& histogram: chunkHistograms) {
+				const uint32_t count = histogram[digit];
+				histogram[digit] = total;
+				total += count;
+			}
+		}
+		runChunks(n, nChunks, [&] (size_t chunk, size_t start, size_t end)
+		{
+			auto& histogram = chunkHistograms[chunk];
+			for (size_t i = start; i < end; ++i) {
+				const auto& e = sortEntries[i];
+				sortScratch[histogram[(e.key >> shift) & 0xFF]++] = e;
+			}
+		});
+		std::swap(sortEntries, sortScratch);
+	}
+}
+
+uint64_t SpritePainter::getSortKey(const SpritePainterEntry& entry) const
+{
+	// Layer, biased so negative layers come first; everything outside of 16 bits gets clamped
+	const uint64_t layer = uint64_t(clamp(entry.getLayer() + 32768, 0, 65535));
+
+	// Flips the float bits so that they compare as unsigned integers in the same order
+	uint32_t depth;
+	const float tieBreaker = entry.getTieBreaker();
+	std::memcpy(&depth, &tieBreaker, sizeof(depth));
+	depth = (depth & 0x80000000u) ? ~depth : (depth | 0x80000000u);
+
+	const uint64_t material = getMaterialKey(entry);
+
+	const bool unordered = std::find(unorderedLayers.begin(), unorderedLayers.end(), entry.getLayer()) != unorderedLayers.end();
+	if (unordered) {
+		return (layer << 48) | (material << 32) | depth;
+	} else {
+		return (layer << 48) | (uint64_t(depth) << 16) | material;
+	}
+}
+
+uint16_t SpritePainter::getMaterialKey(const SpritePainterEntry& entry) const
+{
+	const Sprite* sprite = getSprite(entry);
+
+	if (!sprite || !sprite->hasMaterial()) {
+		return 0;
+	}
+
+	// Materials that compare equal have the same hash, so folding it keeps them together
+	const uint64_t hash = sprite->getMaterial().getHash();
+	return uint16_t(hash ^ (hash >> 16) ^ (hash >> 32) ^ (hash >> 48));
+}
+
+const Sprite* SpritePainter::getSprite(const SpritePainterEntry& entry) const
+{
+	auto type = entry.getType();
+	if (type == SpritePainterEntryType::SpriteRef) {
+		return &entry.getSprite();
+	} else if (type == SpritePainterEntryType::SpriteCached) {
+		return &cachedSprites[entry.getIndex()];
+	}
+	return nullptr;
+}
+
+uint8_t SpritePainter::getDepthMode(const SpritePainterEntry& entry) const
+{
+	const Sprite* sprite = getSprite(entry);
+	if (!sprite || !sprite->hasMaterial()) {
+		return DepthModeNone;
+	}
+
+	auto& pass = sprite->getMaterial().getDefinition().getPass(0);
+	auto& depthStencil = pass.getDepthStencil();
+	if (!depthStencil.isDepthTestEnabled()) {
+		return DepthModeNone;
+	}
+	const bool opaque = depthStencil.isDepthWriteEnabled() && pass.getBlend() == BlendType::Opaque && sprite->getMaterial().getDefinition().getNumPasses() == 1;
+	return opaque ? DepthModeOpaque : DepthModeTested;
+}
+
+void SpritePainter::draw(const SpritePainterEntry& entry, Painter& painter, float zoom, uint8_t depthMode, float depth)
+{
+	auto type = entry.getType();
+	if (type == SpritePainterEntryType::SpriteRef || type == SpritePainterEntryType::SpriteCached) {
+		auto& sprite = *getSprite(entry);
+		requestMipLevels(sprite, zoom);
+		if (depthMode != DepthModeNone) {
+			sprite.drawAtDepth(painter, depth);
+		} else {
+			draw(sprite, painter);
+		}
+	} else if (type == SpritePainterEntryType::TextRef) {
+		draw(entry.getText(), painter);
+	} else if (type == SpritePainterEntryType::TextCached) {
+		draw(cachedText[entry.getIndex()], painter);
+	}
+}
+
+void SpritePainter::draw(const Sprite& sprite, Painter& painter)
+{
+	sprite.draw(painter);
 }
 
-void SpritePainter::draw(const TextRenderer& text, Painter& painter, Rect4f view)
+void SpritePainter::draw(const TextRenderer& text, Painter& painter)
 {
 	text.draw(painter);
 }
@@ -5,6 +5,7 @@
 #include "halley/file_formats/json/json.h"
 #include <halley/file_formats/json_file.h>
 #include "halley/bytes/byte_serializer.h"
+#include "halley/resources/resource_data.h"
 
 using namespace Halley;
 
@@ -92,7 +93,7 @@ std::vector<String> SpriteSheet::getSpriteNames() const
 {
 	std::vector<String> result;
 	for (auto& f: spriteIdx) {
-		result.push_back(f.first);
+		result.push_back(String(f.first));
 	}
 	return result;
 }
@@ -115,7 +116,7 @@ size_t SpriteSheet::getIndex(const String& name) const
 			} else {
 				names += "\", \"";
 			}
-			names += f.first;
+			names += String(f.first);
 		}
 		if (!spriteIdx.empty()) {
 			names += "\"";
@@ -126,6 +127,15 @@ size_t SpriteSheet::getIndex(const String& name) const
 	}
 }
 
+Maybe<size_t> SpriteSheet::tryGetIndex(const String& name) const
+{
+	const auto iter = spriteIdx.find(StringView(name));
+	if (iter == spriteIdx.end()) {
+		return {};
+	}
+	return size_t(iter->second);
+}
+
 bool SpriteSheet::hasSprite(const String& name) const
 {
 	return spriteIdx.find(name) != spriteIdx.end();
@@ -135,8 +145,8 @@ std::unique_ptr<SpriteSheet> SpriteSheet::loadResource(ResourceLoader& loader)
 {
 	auto result = std::make_unique<SpriteSheet>();
 	result->resources = &loader.getAPI().core->getResources();
-	auto data = loader.getStatic();
-	Deserializer s(data->getSpan());
+	result->dataOwner = loader.getStatic();
+	Deserializer s(result->dataOwner->getSpan(), true);
 	result->deserialize(s);
 
 	return result;
@@ -150,7 +160,18 @@ void SpriteSheet::loadTexture(Resources& resources) const
 void SpriteSheet::addSprite(String name, const SpriteSheetEntry& sprite)
 {
 	sprites.push_back(sprite);
-	spriteIdx[name] = uint32_t(sprites.size() - 1);
+	setIndex(name, uint32_t(sprites.size() - 1));
+}
+
+void SpriteSheet::setIndex(const String& name, uint32_t idx)
+{
+	const auto iter = spriteIdx.find(StringView(name));
+	if (iter != spriteIdx.end()) {
+		iter->second = idx;
+	} else {
+		ownedNames.push_back(name);
+		spriteIdx[StringView(ownedNames.back())] = idx;
+	}
 }
 
 void SpriteSheet::setTextureName(String name)
@@ -175,7 +196,19 @@ void SpriteSheet::deserialize(Deserializer& s)
 {
 	s >> textureName;
 	s >> sprites;
-	s >> spriteIdx;
+
+	spriteIdx.clear();
+	ownedNames.clear();
+	if (s.canBorrow()) {
+		s >> spriteIdx;
+	} else {
+		HashMap<String, uint32_t> names;
+		s >> names;
+		for (auto& n: names) {
+			setIndex(n.first, n.second);
+		}
+	}
+
 	s >> frameTags;
 }
 
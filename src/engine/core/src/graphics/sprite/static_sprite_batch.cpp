@@ -0,0 +1,141 @@
+#include "halley/core/graphics/sprite/static_sprite_batch.h"
+#include "halley/core/graphics/material/material.h"
+#include "halley/core/graphics/painter.h"
+#include "halley/core/graphics/static_vertex_buffer.h"
+#include <algorithm>
+#include <cstring>
+#include <gsl/gsl_assert>
+
+using namespace Halley;
+
+namespace {
+	Rect4f merge(Rect4f a, Rect4f b)
+	{
+		return Rect4f(Vector2f::min(a.getTopLeft(), b.getTopLeft()), Vector2f::max(a.getBottomRight(), b.getBottomRight()));
+	}
+}
+
+void StaticSpriteBatch::clear()
+{
+	sprites.clear();
+	groups.clear();
+	dirty = false;
+}
+
+void StaticSpriteBatch::add(const Sprite& sprite)
+{
+	Expects(sprite.isBatchable());
+	sprites.push_back(sprite);
+	dirty = true;
+}
+
+void StaticSpriteBatch::set(size_t idx, const Sprite& sprite)
+{
+	Expects(idx < sprites.size());
+	Expects(sprite.isBatchable());
+	sprites[idx] = sprite;
+	dirty = true;
+}
+
+const Sprite& StaticSpriteBatch::get(size_t idx) const
+{
+	Expects(idx < sprites.size());
+	return sprites[idx];
+}
+
+size_t StaticSpriteBatch::size() const
+{
+	return sprites.size();
+}
+
+bool StaticSpriteBatch::empty() const
+{
+	return sprites.empty();
+}
+
+void StaticSpriteBatch::invalidate()
+{
+	dirty = true;
+}
+
+Rect4f StaticSpriteBatch::getBounds() const
+{
+	Rect4f result;
+	bool first = true;
+	for (auto& sprite: sprites) {
+		if (sprite.isVisible()) {
+			result = first ? sprite.getAABB() : merge(result, sprite.getAABB());
+			first = false;
+		}
+	}
+	return result;
+}
+
+void StaticSpriteBatch::draw(Painter& painter)
+{
+	if (dirty) {
+		rebuild();
+	}
+
+	const Rect4f view = painter.getCurrentCamera().getClippingRectangle();
+	for (auto& group: groups) {
+		for (auto& buffer: group.buffers) {
+			if (buffer.bounds.overlaps(view)) {
+				painter.drawStaticQuads(group.material, buffer.vertices);
+			}
+		}
+	}
+}
+
+void StaticSpriteBatch::rebuild()
+{
+	dirty = false;
+	groups.clear();
+
+	// Materials that compare equal are drawn as one, as the painter would batch them anyway
+	for (size_t i = 0; i < sprites.size(); ++i) {
+		auto& sprite = sprites[i];
+		if (!sprite.isVisible()) {
+			continue;
+		}
+		auto& material = sprite.getMaterialPtr();
+		auto iter = std::find_if(groups.begin(), groups.end(), [&] (const Group& g) { return g.material == material || *g.material == *material; });
+		if (iter == groups.end()) {
+			groups.push_back(Group{ material, {}, {} });
+			iter = groups.end() - 1;
+		}
+		iter->sprites.push_back(i);
+	}
+
+	for (auto& group: groups) {
+		for (size_t start = 0; start < group.sprites.size(); start += maxSpritesPerBuffer) {
+			group.buffers.push_back(makeBuffer(group.sprites.data() + start, std::min(group.sprites.size() - start, maxSpritesPerBuffer)));
+		}
+		group.sprites.clear();
+	}
+}
+
+StaticSpriteBatch::Buffer StaticSpriteBatch::makeBuffer(const size_t* spriteIdxs, size_t n) const
+{
+	// The same vertices that Painter::drawSprites would expand each sprite into
+	Buffer result;
+	Vector<char> data(n * 4 * sizeof(SpriteVertexAttrib));
+	char* dst = data.data();
+	for (size_t i = 0; i < n; ++i) {
+		const auto& sprite = sprites[spriteIdxs[i]];
+		const auto aabb = sprite.getAABB();
+		result.bounds = i == 0 ? aabb : merge(result.bounds, aabb);
+
+		auto vertex = sprite.getBatchVertexAttrib();
+		for (int j = 0; j < 4; ++j) {
+			// A, B, C, D, as with the standard quad indices
+			const float vx = ((j & 1) ^ ((j & 2) >> 1)) * 1.0f;
+			const float vy = ((j & 2) >> 1) * 1.0f;
+			vertex.vertPos = Vector4f(vx, vy, vx, vy);
+			memcpy(dst, &vertex, sizeof(vertex));
+			dst += sizeof(vertex);
+		}
+	}
+	result.vertices = std::make_shared<StaticVertexBuffer>(std::move(data), n * 4);
+	return result;
+}
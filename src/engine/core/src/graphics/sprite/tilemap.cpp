@@ -0,0 +1,253 @@
+#include "halley/core/graphics/sprite/tilemap.h"
+#include "halley/core/graphics/sprite/sprite.h"
+#include "halley/core/graphics/sprite/sprite_sheet.h"
+#include "halley/core/graphics/material/material.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include "halley/core/graphics/material/material_parameter.h"
+#include "halley/core/graphics/painter.h"
+#include "halley/core/graphics/static_vertex_buffer.h"
+#include <algorithm>
+#include <cstring>
+#include <gsl/gsl_assert>
+
+using namespace Halley;
+
+Tilemap::Tilemap(std::shared_ptr<const SpriteSheet> tileset, std::shared_ptr<const MaterialDefinition> materialDefinition, Vector2i size, Vector2f tileSize, int numLayers)
+	: tileset(std::move(tileset))
+	, size(size)
+	, numChunks((size.x + chunkSize - 1) / chunkSize, (size.y + chunkSize - 1) / chunkSize)
+	, tileSize(tileSize)
+{
+	Expects(this->tileset);
+	Expects(materialDefinition);
+	Expects(materialDefinition->getVertexStride() == sizeof(SpriteVertexAttrib));
+	Expects(size.x >= 0 && size.y >= 0);
+	Expects(numLayers > 0);
+
+	material = std::make_shared<Material>(materialDefinition);
+	material->set("tex0", this->tileset->getTexture());
+
+	layers.resize(numLayers);
+	for (auto& layer: layers) {
+		layer.tiles.resize(size_t(size.x) * size_t(size.y), emptyTile);
+		layer.chunks.resize(size_t(numChunks.x) * size_t(numChunks.y));
+	}
+}
+
+Vector2i Tilemap::getSize() const
+{
+	return size;
+}
+
+Vector2f Tilemap::getTileSize() const
+{
+	return tileSize;
+}
+
+int Tilemap::getNumLayers() const
+{
+	return int(layers.size());
+}
+
+const std::shared_ptr<Material>& Tilemap::getMaterial() const
+{
+	return material;
+}
+
+void Tilemap::setPosition(Vector2f p)
+{
+	if (position != p) {
+		position = p;
+		for (auto& layer: layers) {
+			markAllDirty(layer);
+		}
+	}
+}
+
+Vector2f Tilemap::getPosition() const
+{
+	return position;
+}
+
+Rect4f Tilemap::getBounds() const
+{
+	return Rect4f(position, position + Vector2f(size) * tileSize);
+}
+
+Vector2i Tilemap::getTileAt(Vector2f worldPosition) const
+{
+	return Vector2i(((worldPosition - position) / tileSize).floor());
+}
+
+void Tilemap::setTile(int layerIdx, Vector2i pos, int tile)
+{
+	Expects(tile == emptyTile || (tile >= 0 && size_t(tile) < tileset->getSpriteCount()));
+
+	auto& layer = getLayer(layerIdx);
+	auto& cur = layer.tiles[getTileIndex(pos)];
+	if (cur != tile) {
+		cur = tile;
+		getChunk(layer, pos).dirty = true;
+	}
+}
+
+int Tilemap::getTile(int layer, Vector2i pos) const
+{
+	return getLayer(layer).tiles[getTileIndex(pos)];
+}
+
+void Tilemap::fill(int layer, Rect4i area, int tile)
+{
+	const auto clipped = area.intersection(Rect4i(Vector2i(), size));
+	for (int y = clipped.getTop(); y < clipped.getBottom(); ++y) {
+		for (int x = clipped.getLeft(); x < clipped.getRight(); ++x) {
+			setTile(layer, Vector2i(x, y), tile);
+		}
+	}
+}
+
+void Tilemap::setLayerColour(int layerIdx, Colour4f colour)
+{
+	auto& layer = getLayer(layerIdx);
+	if (layer.colour != colour) {
+		layer.colour = colour;
+		markAllDirty(layer);
+	}
+}
+
+Colour4f Tilemap::getLayerColour(int layer) const
+{
+	return getLayer(layer).colour;
+}
+
+void Tilemap::setLayerVisible(int layer, bool visible)
+{
+	getLayer(layer).visible = visible;
+}
+
+bool Tilemap::isLayerVisible(int layer) const
+{
+	return getLayer(layer).visible;
+}
+
+void Tilemap::draw(Painter& painter)
+{
+	for (int i = 0; i < int(layers.size()); ++i) {
+		if (layers[i].visible) {
+			draw(i, painter);
+		}
+	}
+}
+
+void Tilemap::draw(int layerIdx, Painter& painter)
+{
+	auto& layer = getLayer(layerIdx);
+	if (numChunks.x == 0 || numChunks.y == 0) {
+		return;
+	}
+
+	// Chunks overlapping the view
+	const Rect4f view = painter.getCurrentCamera().getClippingRectangle();
+	const Vector2f chunkWorldSize = tileSize * float(chunkSize);
+	const Vector2i first = Vector2i(((view.getTopLeft() - position) / chunkWorldSize).floor());
+	const Vector2i last = Vector2i(((view.getBottomRight() - position) / chunkWorldSize).floor());
+	const int x0 = std::max(first.x, 0);
+	const int y0 = std::max(first.y, 0);
+	const int x1 = std::min(last.x, numChunks.x - 1);
+	const int y1 = std::min(last.y, numChunks.y - 1);
+
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			auto& chunk = layer.chunks[size_t(y) * size_t(numChunks.x) + size_t(x)];
+			if (chunk.dirty) {
+				rebuildChunk(layer, Vector2i(x, y), chunk);
+			}
+			if (chunk.vertices) {
+				painter.drawStaticQuads(material, chunk.vertices);
+			}
+		}
+	}
+}
+
+Tilemap::Layer& Tilemap::getLayer(int layer)
+{
+	Expects(layer >= 0 && layer < int(layers.size()));
+	return layers[layer];
+}
+
+const Tilemap::Layer& Tilemap::getLayer(int layer) const
+{
+	Expects(layer >= 0 && layer < int(layers.size()));
+	return layers[layer];
+}
+
+size_t Tilemap::getTileIndex(Vector2i pos) const
+{
+	Expects(pos.x >= 0 && pos.y >= 0 && pos.x < size.x && pos.y < size.y);
+	return size_t(pos.y) * size_t(size.x) + size_t(pos.x);
+}
+
+Tilemap::Chunk& Tilemap::getChunk(Layer& layer, Vector2i tilePos)
+{
+	return layer.chunks[size_t(tilePos.y / chunkSize) * size_t(numChunks.x) + size_t(tilePos.x / chunkSize)];
+}
+
+void Tilemap::markAllDirty(Layer& layer)
+{
+	for (auto& chunk: layer.chunks) {
+		chunk.dirty = true;
+	}
+}
+
+void Tilemap::rebuildChunk(const Layer& layer, Vector2i chunkPos, Chunk& chunk) const
+{
+	const Vector2i start = chunkPos * chunkSize;
+	const Vector2i end = Vector2i(std::min(start.x + chunkSize, size.x), std::min(start.y + chunkSize, size.y));
+
+	size_t numTiles = 0;
+	for (int y = start.y; y < end.y; ++y) {
+		for (int x = start.x; x < end.x; ++x) {
+			if (layer.tiles[getTileIndex(Vector2i(x, y))] != emptyTile) {
+				++numTiles;
+			}
+		}
+	}
+
+	chunk.dirty = false;
+	if (numTiles == 0) {
+		chunk.vertices.reset();
+		return;
+	}
+
+	// The same vertices that Painter::drawSprites would expand a sprite into, with the pivot at the top left of the tile
+	Vector<char> data(numTiles * 4 * sizeof(SpriteVertexAttrib));
+	char* dst = data.data();
+	SpriteVertexAttrib vertex;
+	vertex.pivot = Vector2f();
+	vertex.size = tileSize;
+	vertex.scale = Vector2f(1, 1);
+	vertex.colour = layer.colour;
+	for (int y = start.y; y < end.y; ++y) {
+		for (int x = start.x; x < end.x; ++x) {
+			const int tile = layer.tiles[getTileIndex(Vector2i(x, y))];
+			if (tile == emptyTile) {
+				continue;
+			}
+
+			const auto& entry = tileset->getSprite(size_t(tile));
+			vertex.pos = position + Vector2f(Vector2i(x, y)) * tileSize;
+			vertex.texRect = entry.coords;
+			vertex.textureRotation = entry.rotated ? 1.0f : 0.0f;
+			for (int j = 0; j < 4; ++j) {
+				// A, B, C, D, as with the standard quad indices
+				const float vx = ((j & 1) ^ ((j & 2) >> 1)) * 1.0f;
+				const float vy = ((j & 2) >> 1) * 1.0f;
+				vertex.vertPos = Vector4f(vx, vy, vx, vy);
+				memcpy(dst, &vertex, sizeof(vertex));
+				dst += sizeof(vertex);
+			}
+		}
+	}
+
+	chunk.vertices = std::make_shared<StaticVertexBuffer>(std::move(data), numTiles * 4);
+}
@@ -0,0 +1,14 @@
+#include "halley/core/graphics/static_vertex_buffer.h"
+#include <gsl/gsl_assert>
+
+using namespace Halley;
+
+std::atomic<uint64_t> StaticVertexBuffer::nextId(1);
+
+StaticVertexBuffer::StaticVertexBuffer(Vector<char> d, size_t numVertices)
+	: data(std::move(d))
+	, numVertices(numVertices)
+	, id(nextId++)
+{
+	Expects(numVertices == 0 || data.size() % numVertices == 0);
+}
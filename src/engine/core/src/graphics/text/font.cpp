@@ -1,4 +1,5 @@
 #include "graphics/text/font.h"
+#include "graphics/text/glyph_cache.h"
 #include "halley/core/graphics/material/material.h"
 #include "halley/core/graphics/material/material_definition.h"
 #include "halley/core/graphics/material/material_parameter.h"
@@ -6,6 +7,12 @@
 #include "halley/bytes/byte_serializer.h"
 #include "resources/resources.h"
 #include "halley/text/string_converter.h"
+#include "halley/file_formats/binary_file.h"
+#include "halley/support/logger.h"
+
+#ifdef WITH_FREETYPE
+#include "freetype_glyph_rasterizer.h"
+#endif
 
 using namespace Halley;
 
@@ -74,8 +81,21 @@ Font::Font(ResourceLoader& loader)
 	auto matDef = loader.getAPI().getResource<MaterialDefinition>(distanceField ? "Halley/Text" : "Halley/Sprite");
 	material = std::make_unique<Material>(matDef);
 	material->set("tex0", texture);
+
+	if (!dynamicGlyphSource.isEmpty()) {
+#ifdef WITH_FREETYPE
+		auto& api = loader.getAPI();
+		dynamicGlyphData = api.getResource<BinaryFile>(dynamicGlyphSource);
+		auto rasterizer = std::make_unique<FreeTypeGlyphRasterizer>(dynamicGlyphData->getSpan(), sizePt);
+		glyphCache = std::make_shared<GlyphCache>(*api.video, api.getResource<MaterialDefinition>("Halley/Sprite"), std::move(rasterizer));
+#else
+		Logger::logWarning("Font \"" + name + "\" has dynamic glyphs, but Halley was built without FreeType.");
+#endif
+	}
 }
 
+Font::~Font() = default;
+
 std::unique_ptr<Font> Font::loadResource(ResourceLoader& loader)
 {
 	return std::make_unique<Font>(loader);
@@ -96,23 +116,22 @@ void Font::onLoaded(Resources& resources)
 const Font::Glyph& Font::getGlyph(int code) const
 {
 	auto& font = getFontForGlyph(code);
-	auto iter = font.glyphs.find(code);
-	if (iter == font.glyphs.end()) {
-		iter = font.glyphs.find(0);
+	auto glyph = font.findGlyph(code);
+	if (!glyph) {
+		auto iter = font.glyphs.find(0);
 		if (iter == font.glyphs.end()) {
 			throw Exception("Unable to load fallback character, needed for character " + toString(code), HalleyExceptions::Graphics);
 		}
 		return iter->second;
 	}
-	return iter->second;
+	return *glyph;
 }
 
 const Font& Font::getFontForGlyph(int code) const
 {
-	auto iter = glyphs.find(code);
-	if (iter == glyphs.end()) {
+	if (!hasGlyph(code)) {
 		for (auto& font: fallbackFont) {
-			if (font->glyphs.find(code) != font->glyphs.end()) {
+			if (font->hasGlyph(code)) {
 				return *font;
 			}
 		}
@@ -120,6 +139,20 @@ const Font& Font::getFontForGlyph(int code) const
 	return *this;
 }
 
+bool Font::hasGlyph(int code) const
+{
+	return glyphs.find(code) != glyphs.end() || (glyphCache && glyphCache->hasGlyph(code));
+}
+
+const Font::Glyph* Font::findGlyph(int code) const
+{
+	auto iter = glyphs.find(code);
+	if (iter != glyphs.end()) {
+		return &iter->second;
+	}
+	return glyphCache ? glyphCache->getGlyph(code) : nullptr;
+}
+
 float Font::getLineHeightAtSize(float size) const
 {
 	return height * size / sizePt;
@@ -165,11 +198,48 @@ void Font::addGlyph(const Glyph& glyph)
 	glyphs[glyph.charcode] = glyph;
 }
 
+void Font::setDynamicGlyphSource(String binaryFileName)
+{
+	dynamicGlyphSource = std::move(binaryFileName);
+}
+
+bool Font::hasDynamicGlyphs() const
+{
+	return static_cast<bool>(glyphCache);
+}
+
+uint64_t Font::getGlyphGeneration() const
+{
+	uint64_t result = glyphCache ? glyphCache->getGeneration() : 0;
+	for (auto& font: fallbackFont) {
+		result += font->getGlyphGeneration();
+	}
+	return result;
+}
+
+void Font::updateGlyphCache() const
+{
+	if (glyphCache) {
+		glyphCache->update();
+	}
+	for (auto& font: fallbackFont) {
+		font->updateGlyphCache();
+	}
+}
+
 std::shared_ptr<Material> Font::getMaterial() const
 {
 	return material;
 }
 
+std::shared_ptr<Material> Font::getMaterial(const Glyph& glyph) const
+{
+	if (glyph.page >= 0 && glyphCache) {
+		return glyphCache->getMaterial(glyph.page);
+	}
+	return material;
+}
+
 void Font::serialize(Serializer& s) const
 {
 	s << name;
@@ -182,6 +252,7 @@ void Font::serialize(Serializer& s) const
 	s << replacementScale;
 	s << glyphs;
 	s << fallback;
+	s << dynamicGlyphSource;
 }
 
 void Font::deserialize(Deserializer& s)
@@ -196,6 +267,7 @@ void Font::deserialize(Deserializer& s)
 	s >> replacementScale;
 	s >> glyphs;
 	s >> fallback;
+	s >> dynamicGlyphSource;
 
 	for (auto& g: glyphs) {
 		g.second.charcode = g.first;
@@ -0,0 +1,78 @@
+#ifdef WITH_FREETYPE
+
+#include "freetype_glyph_rasterizer.h"
+#include "halley/support/exception.h"
+#include "halley/text/string_converter.h"
+#include <ft2build.h>
+#include <cmath>
+#include FT_FREETYPE_H
+
+using namespace Halley;
+
+namespace Halley {
+	class FreeTypeGlyphRasterizerPimpl
+	{
+	public:
+		FT_Library library = nullptr;
+		FT_Face face = nullptr;
+	};
+}
+
+FreeTypeGlyphRasterizer::FreeTypeGlyphRasterizer(gsl::span<const gsl::byte> fontData, float pixelSize)
+	: pimpl(std::make_unique<FreeTypeGlyphRasterizerPimpl>())
+{
+	int error = FT_Init_FreeType(&pimpl->library);
+	if (error) {
+		throw Exception("Unable to initialize FreeType", HalleyExceptions::Graphics);
+	}
+	error = FT_New_Memory_Face(pimpl->library, reinterpret_cast<const FT_Byte*>(fontData.data()), FT_Long(fontData.size()), 0, &pimpl->face);
+	if (error) {
+		throw Exception("Unable to load font face", HalleyExceptions::Graphics);
+	}
+	FT_Set_Char_Size(pimpl->face, 0, FT_F26Dot6(std::lround(pixelSize * 64)), 72, 0);
+}
+
+FreeTypeGlyphRasterizer::~FreeTypeGlyphRasterizer()
+{
+	if (pimpl->face) {
+		FT_Done_Face(pimpl->face);
+	}
+	if (pimpl->library) {
+		FT_Done_FreeType(pimpl->library);
+	}
+}
+
+bool FreeTypeGlyphRasterizer::hasGlyph(int charcode) const
+{
+	return charcode > 0 && FT_Get_Char_Index(pimpl->face, FT_ULong(charcode)) != 0;
+}
+
+Maybe<IGlyphRasterizer::GlyphImage> FreeTypeGlyphRasterizer::rasterize(int charcode)
+{
+	const auto index = FT_Get_Char_Index(pimpl->face, FT_ULong(charcode));
+	if (index == 0) {
+		return {};
+	}
+
+	if (FT_Load_Glyph(pimpl->face, index, FT_LOAD_DEFAULT) != 0) {
+		throw Exception("Unable to load glyph " + toString(charcode), HalleyExceptions::Graphics);
+	}
+	auto glyph = pimpl->face->glyph;
+	if (FT_Render_Glyph(glyph, FT_RENDER_MODE_NORMAL) != 0) {
+		throw Exception("Unable to render glyph " + toString(charcode), HalleyExceptions::Graphics);
+	}
+
+	GlyphImage result;
+	const auto& bmp = glyph->bitmap;
+	result.size = Vector2i(int(bmp.width), int(bmp.rows));
+	result.coverage.resize(size_t(bmp.width) * size_t(bmp.rows));
+	for (unsigned int y = 0; y < bmp.rows; ++y) {
+		const auto src = bmp.buffer + int(y) * bmp.pitch;
+		std::copy(src, src + bmp.width, result.coverage.begin() + size_t(y) * bmp.width);
+	}
+	result.bearing = Vector2f(float(glyph->bitmap_left), float(glyph->bitmap_top));
+	result.advance = Vector2f(float(glyph->metrics.horiAdvance), float(glyph->metrics.vertAdvance)) / 64.0f;
+	return result;
+}
+
+#endif
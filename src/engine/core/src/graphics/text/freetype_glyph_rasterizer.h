@@ -0,0 +1,27 @@
+#pragma once
+
+#ifdef WITH_FREETYPE
+
+#include "halley/core/graphics/text/glyph_cache.h"
+#include <gsl/gsl>
+
+namespace Halley
+{
+	class FreeTypeGlyphRasterizerPimpl;
+
+	// Renders anti-aliased glyphs at a fixed pixel size; the font data must outlive it
+	class FreeTypeGlyphRasterizer final : public IGlyphRasterizer
+	{
+	public:
+		FreeTypeGlyphRasterizer(gsl::span<const gsl::byte> fontData, float pixelSize);
+		~FreeTypeGlyphRasterizer();
+
+		bool hasGlyph(int charcode) const override;
+		Maybe<GlyphImage> rasterize(int charcode) override;
+
+	private:
+		std::unique_ptr<FreeTypeGlyphRasterizerPimpl> pimpl;
+	};
+}
+
+#endif
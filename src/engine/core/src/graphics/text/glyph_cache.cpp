@@ -0,0 +1,180 @@
+#include "graphics/text/glyph_cache.h"
+#include "halley/core/api/halley_api.h"
+#include "halley/core/graphics/material/material.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include "halley/core/graphics/material/material_parameter.h"
+#include "halley/core/graphics/texture.h"
+#include "halley/core/graphics/texture_descriptor.h"
+#include <algorithm>
+
+using namespace Halley;
+
+GlyphCache::GlyphCache(VideoAPI& video, std::shared_ptr<const MaterialDefinition> materialDefinition, std::unique_ptr<IGlyphRasterizer> rasterizer, int pageSize, size_t maxPages)
+	: video(video)
+	, materialDefinition(std::move(materialDefinition))
+	, rasterizer(std::move(rasterizer))
+	, pageSize(pageSize)
+	, maxPages(maxPages)
+{
+	Expects(this->rasterizer);
+	Expects(pageSize > 0);
+	Expects(maxPages > 0);
+}
+
+GlyphCache::~GlyphCache() = default;
+
+bool GlyphCache::hasGlyph(int charcode) const
+{
+	return glyphs.find(charcode) != glyphs.end() || rasterizer->hasGlyph(charcode);
+}
+
+const Font::Glyph* GlyphCache::getGlyph(int charcode)
+{
+	auto iter = glyphs.find(charcode);
+	if (iter != glyphs.end()) {
+		pages[iter->second.page]->lastUse = ++useCounter;
+		return &iter->second;
+	}
+	return addGlyph(charcode);
+}
+
+std::shared_ptr<Material> GlyphCache::getMaterial(int page) const
+{
+	return pages.at(page)->material;
+}
+
+uint64_t GlyphCache::getGeneration() const
+{
+	return generation;
+}
+
+void GlyphCache::update()
+{
+	for (auto& page: pages) {
+		if (page->dirty) {
+			upload(*page);
+		}
+	}
+}
+
+const Font::Glyph* GlyphCache::addGlyph(int charcode)
+{
+	if (!rasterizer->hasGlyph(charcode)) {
+		return nullptr;
+	}
+	auto image = rasterizer->rasterize(charcode);
+	if (!image) {
+		return nullptr;
+	}
+
+	const auto size = image->size + Vector2i(2 * padding, 2 * padding);
+	Vector2i pos;
+	const int pageIdx = getPageWithSpace(size, pos);
+	if (pageIdx < 0) {
+		return nullptr;
+	}
+	auto& page = *pages[pageIdx];
+
+	// White, with the coverage in alpha, so it can be drawn with the regular sprite material
+	for (int y = 0; y < image->size.y; ++y) {
+		uint8_t* dst = page.pixels.data() + (size_t(pos.y + padding + y) * pageSize + size_t(pos.x + padding)) * 4;
+		const uint8_t* src = image->coverage.data() + size_t(y) * image->size.x;
+		for (int x = 0; x < image->size.x; ++x) {
+			dst[x * 4 + 3] = src[x];
+		}
+	}
+	page.glyphs.push_back(charcode);
+	page.lastUse = ++useCounter;
+	page.dirty = true;
+
+	// Same conventions as the glyphs baked by the font generator
+	const auto area = Rect4f(Vector2f(pos), Vector2f(pos + size)) / float(pageSize);
+	const auto bearing = image->bearing + Vector2f(float(-padding), float(padding));
+	auto glyph = Font::Glyph(charcode, area, Vector2f(size), bearing, bearing, image->advance);
+	glyph.page = pageIdx;
+	return &(glyphs[charcode] = glyph);
+}
+
+Maybe<Vector2i> GlyphCache::allocate(Page& page, Vector2i size) const
+{
+	// Shelf packing; glyphs at one size are similar enough in height for it to do well
+	for (auto& shelf: page.shelves) {
+		if (size.y <= shelf.height && size.y * 4 >= shelf.height * 3 && shelf.x + size.x <= pageSize) {
+			const auto pos = Vector2i(shelf.x, shelf.y);
+			shelf.x += size.x;
+			return pos;
+		}
+	}
+
+	if (page.nextShelfY + size.y <= pageSize && size.x <= pageSize) {
+		page.shelves.push_back(Shelf{ page.nextShelfY, size.y, size.x });
+		const auto pos = Vector2i(0, page.nextShelfY);
+		page.nextShelfY += size.y;
+		return pos;
+	}
+
+	return {};
+}
+
+int GlyphCache::getPageWithSpace(Vector2i size, Vector2i& pos)
+{
+	if (size.x > pageSize || size.y > pageSize) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < pages.size(); ++i) {
+		auto result = allocate(*pages[i], size);
+		if (result) {
+			pos = result.get();
+			return int(i);
+		}
+	}
+
+	int pageIdx;
+	if (pages.size() < maxPages) {
+		pageIdx = int(pages.size());
+		auto page = std::make_unique<Page>();
+		page->material = std::make_shared<Material>(materialDefinition);
+		pages.push_back(std::move(page));
+	} else {
+		const auto iter = std::min_element(pages.begin(), pages.end(), [] (const std::unique_ptr<Page>& a, const std::unique_ptr<Page>& b) { return a->lastUse < b->lastUse; });
+		pageIdx = int(iter - pages.begin());
+		evict(pageIdx);
+	}
+
+	auto& page = *pages[pageIdx];
+	page.pixels.resize(size_t(pageSize) * size_t(pageSize) * 4);
+	for (size_t i = 0; i < page.pixels.size(); i += 4) {
+		page.pixels[i] = page.pixels[i + 1] = page.pixels[i + 2] = 255;
+		page.pixels[i + 3] = 0;
+	}
+
+	pos = allocate(page, size).get();
+	return pageIdx;
+}
+
+void GlyphCache::evict(int pageIdx)
+{
+	auto& page = *pages[pageIdx];
+	for (int charcode: page.glyphs) {
+		glyphs.erase(charcode);
+	}
+	page.glyphs.clear();
+	page.shelves.clear();
+	page.nextShelfY = 0;
+	++generation;
+}
+
+void GlyphCache::upload(Page& page)
+{
+	// Always a new texture, as not every video plugin can update one in place
+	TextureDescriptor descriptor(Vector2i(pageSize, pageSize), TextureFormat::RGBA);
+	descriptor.useFiltering = true;
+	descriptor.pixelFormat = PixelDataFormat::Precompiled;
+	descriptor.pixelData = TextureDescriptorImageData(gsl::as_bytes(gsl::span<const uint8_t>(page.pixels.data(), page.pixels.size())));
+
+	std::shared_ptr<Texture> texture = video.createTexture(descriptor.size);
+	texture->load(std::move(descriptor));
+	page.material->set("tex0", texture);
+	page.dirty = false;
+}
@@ -3,7 +3,10 @@
 #include "halley/core/graphics/painter.h"
 #include "halley/core/graphics/material/material.h"
 #include "halley/core/graphics/material/material_parameter.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include "halley/core/graphics/sprite/sprite.h"
 #include <gsl/gsl_assert>
+#include <algorithm>
 #include "halley/text/i18n.h"
 
 using namespace Halley;
@@ -24,10 +27,7 @@ TextRenderer::TextRenderer(std::shared_ptr<const Font> font, String text, float
 
 TextRenderer& TextRenderer::setPosition(Vector2f pos)
 {
-	if (position != pos) {
-		position = pos;
-		positionDirty = true;
-	}
+	position = pos;
 	return *this;
 }
 
@@ -35,6 +35,7 @@ TextRenderer& TextRenderer::setFont(std::shared_ptr<const Font> v)
 {
 	if (font != v) {
 		font = v;
+		invalidateLayout();
 
 		if (font->isDistanceField()) {
 			materialDirty = true;
@@ -46,38 +47,36 @@ TextRenderer& TextRenderer::setFont(std::shared_ptr<const Font> v)
 
 TextRenderer& TextRenderer::setText(const String& v)
 {
-	const auto newText = v.getUTF32();
-	if (newText != text) {
-		text = newText;
-		glyphsDirty = true;
-	}
-	return *this;
+	return setText(v.getUTF32());
 }
 
 TextRenderer& TextRenderer::setText(const StringUTF32& v)
 {
 	if (v != text) {
+		// Anything after the common prefix needs laying out again, but the lines before it can stay
+		const size_t n = std::min(text.size(), v.size());
+		size_t prefix = 0;
+		while (prefix < n && text[prefix] == v[prefix]) {
+			++prefix;
+		}
+		layoutValidLength = std::min(layoutValidLength, prefix);
+
 		text = v;
-		glyphsDirty = true;
+		layoutDirty = true;
 	}
 	return *this;
 }
 
 TextRenderer& TextRenderer::setText(const LocalisedString& v)
 {
-	const auto newText = v.getString().getUTF32();
-	if (newText != text) {
-		text = newText;
-		glyphsDirty = true;
-	}
-	return *this;
+	return setText(v.getString().getUTF32());
 }
 
 TextRenderer& TextRenderer::setSize(float v)
 {
 	if (size != v) {
 		size = v;
-		glyphsDirty = true;
+		invalidateLayout();
 	}
 	return *this;
 }
@@ -86,7 +85,7 @@ TextRenderer& TextRenderer::setColour(Colour v)
 {
 	if (colour != v) {
 		colour = v;
-		glyphsDirty = true;
+		colourDirty = true;
 	}
 	return *this;
 }
@@ -104,17 +103,14 @@ TextRenderer& TextRenderer::setAlignment(float v)
 {
 	if (align != v) {
 		align = v;
-		glyphsDirty = true;
+		invalidateLayout();
 	}
 	return *this;
 }
 
 TextRenderer& TextRenderer::setOffset(Vector2f v)
 {
-	if (offset != v) {
-		offset = v;
-		glyphsDirty = true;
-	}
+	offset = v;
 	return *this;
 }
 
@@ -141,10 +137,7 @@ TextRenderer& TextRenderer::setSmoothness(float s)
 
 TextRenderer& TextRenderer::setPixelOffset(Vector2f offset)
 {
-	if (pixelOffset != offset) {
-		pixelOffset = offset;
-		glyphsDirty = true;
-	}
+	pixelOffset = offset;
 	return *this;
 }
 
@@ -152,7 +145,7 @@ TextRenderer& TextRenderer::setColourOverride(const std::vector<ColourOverride>&
 {
 	if (colourOverrides != colOverride) {
 		colourOverrides = colOverride;
-		glyphsDirty = true;
+		colourDirty = true;
 	}
 	return *this;
 }
@@ -161,7 +154,7 @@ TextRenderer& TextRenderer::setLineSpacing(float spacing)
 {
 	if (lineSpacing != spacing) {
 		lineSpacing = spacing;
-		glyphsDirty = true;
+		invalidateLayout();
 	}
 	return *this;
 }
@@ -182,116 +175,266 @@ TextRenderer TextRenderer::clone() const
 
 void TextRenderer::generateSprites(std::vector<Sprite>& sprites) const
 {
-	Expects(font);
+	updateGlyphs();
 
-	const bool hasMaterialOverride = font->isDistanceField();
-	if (hasMaterialOverride && materialDirty) {
-		updateMaterials();
-		materialDirty = false;
+	const auto origin = getOrigin();
+	sprites.clear();
+	sprites.reserve(glyphs.size());
+	for (auto& g: glyphs) {
+		sprites.push_back(makeSprite(g, origin));
+	}
+}
+
+void TextRenderer::draw(Painter& painter) const
+{
+	updateGlyphs();
+
+	if (!spriteFilter) {
+		drawGlyphs(painter);
+		return;
 	}
 
-	if (glyphsDirty || positionDirty) {
-		float mainScale = getScale(*font);
-		Vector2f p = (position + Vector2f(0, font->getAscenderDistance() * mainScale)).floor();
-		if (offset != Vector2f(0, 0)) {
-			p -= (getExtents() * offset).floor();
+	// We don't know what the user will do with glyphs, so give them sprites
+	const auto origin = getOrigin();
+	filteredSprites.clear();
+	filteredSprites.reserve(glyphs.size());
+	for (auto& g: glyphs) {
+		filteredSprites.push_back(makeSprite(g, origin));
+	}
+	spriteFilter(gsl::span<Sprite>(filteredSprites.data(), filteredSprites.size()));
+
+	Sprite* sprites = filteredSprites.data();
+	const size_t nSprites = filteredSprites.size();
+	if (clip && std::all_of(sprites, sprites + nSprites, [] (const Sprite& s) { return s.getMaterial().getDefinition().hasShaderClip(); })) {
+		// Each glyph takes the clip, so clipped text can be drawn along with everything else
+		for (size_t i = 0; i < nSprites; ++i) {
+			sprites[i].setAbsoluteClip(clip.get() + position);
 		}
+		Sprite::drawMixedMaterials(sprites, nSprites, painter);
+		return;
+	}
 
-		size_t startPos = 0;
-		size_t spritesInserted = 0;
-		Vector2f lineOffset;
-
-		auto flush = [&] ()
-		{
-			// Line break, update previous characters!
-			if (align != 0) {
-				Vector2f off = (-lineOffset * align).floor();
-				for (size_t j = startPos; j < spritesInserted; j++) {
-					auto& sprite = sprites[j];
-					sprite.setPos(sprite.getPosition() + off);
-				}
-			}
+	if (clip) {
+		painter.setRelativeClip(clip.get() + position);
+	}
+	Sprite::drawMixedMaterials(sprites, nSprites, painter);
+	if (clip) {
+		painter.setClip();
+	}
+}
 
-			// Move pen
-			p.y += getLineHeight();
+void TextRenderer::drawGlyphs(Painter& painter) const
+{
+	if (glyphs.empty()) {
+		return;
+	}
 
-			// Reset
-			startPos = spritesInserted;
-			lineOffset.x = 0;
-		};
+	// Each glyph takes the clip, if its material can clip in its shaders, so clipped text can be drawn along with everything else
+	const bool shaderClip = clip && std::all_of(glyphMaterials.begin(), glyphMaterials.end(), [] (const std::shared_ptr<Material>& m) { return m->getDefinition().hasShaderClip(); });
+	if (clip && !shaderClip) {
+		painter.setRelativeClip(clip.get() + position);
+	}
 
-		auto curCol = colour;
-		size_t curOverride = 0;
+	const auto origin = getOrigin();
+	const auto glyphClip = shaderClip ? clip.get() + position : SpriteVertexAttrib().clip;
+	const size_t n = glyphs.size();
+	glyphVertices.resize(n);
+
+	// One run of vertices per material, as it changes; each is one instanced draw, on backends that support it
+	size_t start = 0;
+	for (size_t i = 0; i < n; ++i) {
+		const auto& g = glyphs[i];
+		auto& v = glyphVertices[i];
+		v.pos = origin + g.offset;
+		v.pivot = g.pivot;
+		v.size = g.size;
+		v.scale = Vector2f(g.scale, g.scale);
+		v.colour = g.colour;
+		v.texRect = g.texRect;
+		v.clip = glyphClip;
+
+		if (i + 1 == n || glyphs[i + 1].material != g.material) {
+			auto& material = glyphMaterials[g.material];
+			Expects(material->getDefinition().getVertexStride() == sizeof(SpriteVertexAttrib));
+			painter.drawSprites(material, i + 1 - start, glyphVertices.data() + start);
+			start = i + 1;
+		}
+	}
 
-		const size_t n = text.size();
+	if (clip && !shaderClip) {
+		painter.setClip();
+	}
+}
 
-		size_t nGlyphs = 0;
-		for (size_t i = 0; i < n; i++) {
-			if (text[i] != '\n') {
-				++nGlyphs;
-			}
+Sprite TextRenderer::makeSprite(const GlyphInstance& glyph, Vector2f origin) const
+{
+	return Sprite()
+		.setMaterial(glyphMaterials[glyph.material])
+		.setSize(glyph.size)
+		.setTexRect(glyph.texRect)
+		.setPivot(glyph.pivot)
+		.setScale(glyph.scale)
+		.setColour(glyph.colour)
+		.setPos(origin + glyph.offset);
+}
+
+uint32_t TextRenderer::getGlyphMaterialIndex(const std::shared_ptr<Material>& material) const
+{
+	// Texts rarely use more than a couple, so this is quicker than a map
+	for (size_t i = glyphMaterials.size(); i > 0; --i) {
+		if (glyphMaterials[i - 1] == material) {
+			return uint32_t(i - 1);
 		}
-		sprites.resize(nGlyphs);
+	}
+	glyphMaterials.push_back(material);
+	return uint32_t(glyphMaterials.size() - 1);
+}
 
-		for (size_t i = 0; i < n; i++) {
-			int c = text[i];
+void TextRenderer::invalidateLayout() const
+{
+	layoutDirty = true;
+	layoutValidLength = 0;
+}
 
-			// Check for colour override
-			while (curOverride < colourOverrides.size() && colourOverrides[curOverride].first == i) {
-				curCol = colourOverrides[curOverride].second ? colourOverrides[curOverride].second.get() : colour;
-				++curOverride;
+void TextRenderer::updateLayout() const
+{
+	Expects(font);
+
+	// Glyphs rasterised at runtime might have been evicted from their atlas page
+	const auto generation = font->getGlyphGeneration();
+	if (generation != glyphGeneration) {
+		glyphGeneration = generation;
+		invalidateLayout();
+	}
+
+	if (!layoutDirty) {
+		return;
+	}
+
+	// Resume from the start of the last line, if nothing before it changed
+	const bool incremental = layoutValidLength >= lastLineStart;
+	const size_t startChar = incremental ? lastLineStart : 0;
+	size_t glyphIdx = incremental ? lastLineGlyph : 0;
+	float lineY = incremental ? lastLineY : 0;
+	float maxWidth = incremental ? widthBeforeLastLine : 0;
+	if (!incremental) {
+		lastLineStart = 0;
+		lastLineGlyph = 0;
+		lastLineY = 0;
+		widthBeforeLastLine = 0;
+		glyphMaterials.clear();
+	}
+
+	const size_t n = text.size();
+	size_t nGlyphs = glyphIdx;
+	for (size_t i = startChar; i < n; i++) {
+		if (text[i] != '\n') {
+			++nGlyphs;
+		}
+	}
+	glyphs.resize(nGlyphs);
+
+	const bool hasMaterialOverride = font->isDistanceField();
+	const float lineHeight = getLineHeight();
+	size_t lineStartGlyph = glyphIdx;
+	float lineWidth = 0;
+
+	auto flush = [&] ()
+	{
+		// Line break, update previous characters!
+		if (align != 0) {
+			const Vector2f off = (-Vector2f(lineWidth, 0) * align).floor();
+			for (size_t j = lineStartGlyph; j < glyphIdx; j++) {
+				glyphs[j].offset += off;
 			}
-			
-			if (c == '\n') {
+		}
+
+		// Move pen
+		maxWidth = std::max(maxWidth, lineWidth);
+		lineY += lineHeight;
+
+		// Reset
+		lineStartGlyph = glyphIdx;
+		lineWidth = 0;
+	};
+
+	for (size_t i = startChar; i < n; i++) {
+		int c = text[i];
+
+		if (c == '\n') {
+			flush();
+			lastLineStart = i + 1;
+			lastLineGlyph = glyphIdx;
+			lastLineY = lineY;
+			widthBeforeLastLine = maxWidth;
+		} else {
+			auto& fontForGlyph = font->getFontForGlyph(c);
+			auto& glyph = fontForGlyph.getGlyph(c);
+			const float scale = getScale(fontForGlyph);
+			const auto fontAdjustment = (Vector2f(0, fontForGlyph.getAscenderDistance() - font->getAscenderDistance()) * scale).floor();
+
+			const bool overrideMaterial = hasMaterialOverride && fontForGlyph.isDistanceField() && glyph.page < 0;
+			std::shared_ptr<Material> materialToUse = overrideMaterial ? getMaterial(fontForGlyph) : fontForGlyph.getMaterial(glyph);
+
+			auto& g = glyphs[glyphIdx];
+			g.offset = Vector2f(lineWidth, lineY) + fontAdjustment;
+			g.size = glyph.size;
+			g.pivot = glyph.horizontalBearing / glyph.size * Vector2f(-1, 1);
+			g.texRect = glyph.area;
+			g.scale = scale;
+			g.material = getGlyphMaterialIndex(materialToUse);
+			g.character = uint32_t(i);
+			++glyphIdx;
+
+			lineWidth += glyph.advance.x * scale;
+
+			if (i == n - 1) {
 				flush();
-			} else {
-				auto& fontForGlyph = font->getFontForGlyph(c);
-				auto& glyph = fontForGlyph.getGlyph(c);
-				const float scale = getScale(fontForGlyph);
-				const auto fontAdjustment = (Vector2f(0, fontForGlyph.getAscenderDistance() - font->getAscenderDistance()) * scale).floor();
-
-				std::shared_ptr<Material> materialToUse = hasMaterialOverride ? getMaterial(fontForGlyph) : fontForGlyph.getMaterial();
-
-				sprites[spritesInserted++] = Sprite()
-					.setMaterial(materialToUse)
-					.setSize(glyph.size)
-					.setTexRect(glyph.area)
-					.setColour(curCol)
-					.setPivot(glyph.horizontalBearing / glyph.size * Vector2f(-1, 1))
-					.setScale(scale)
-					.setPos(p + lineOffset + pixelOffset + fontAdjustment);
-
-				lineOffset.x += glyph.advance.x * scale;
-
-				if (i == n - 1) {
-					flush();
-				}
 			}
 		}
-
-		glyphsDirty = false;
-		positionDirty = false;
 	}
+
+	layoutExtents = Vector2f(maxWidth, lastLineY + lineHeight);
+	layoutValidLength = n;
+	layoutDirty = false;
+	colourDirty = true;
+
+	font->updateGlyphCache();
 }
 
-void TextRenderer::draw(Painter& painter) const
+void TextRenderer::updateGlyphs() const
 {
-	generateSprites(spritesCache);
+	Expects(font);
 
-	if (spriteFilter) {
-		// We don't know what the user will do with glyphs, so mark them as dirty
-		spriteFilter(gsl::span<Sprite>(spritesCache.data(), spritesCache.size()));
-		glyphsDirty = true;
-		positionDirty = true;
+	if (font->isDistanceField() && materialDirty) {
+		updateMaterials();
+		materialDirty = false;
 	}
 
-	if (clip) {
-		painter.setRelativeClip(clip.get() + position);
+	updateLayout();
+
+	if (colourDirty) {
+		auto curCol = colour;
+		size_t curOverride = 0;
+		for (auto& g: glyphs) {
+			// Check for colour override
+			while (curOverride < colourOverrides.size() && colourOverrides[curOverride].first <= g.character) {
+				curCol = colourOverrides[curOverride].second ? colourOverrides[curOverride].second.get() : colour;
+				++curOverride;
+			}
+			g.colour = curCol;
+		}
+		colourDirty = false;
 	}
-	Sprite::drawMixedMaterials(spritesCache.data(), spritesCache.size(), painter);
-	if (clip) {
-		painter.setClip();
+}
+
+Vector2f TextRenderer::getOrigin() const
+{
+	Vector2f p = (position + Vector2f(0, font->getAscenderDistance() * getScale(*font))).floor();
+	if (offset != Vector2f(0, 0)) {
+		p -= (layoutExtents * offset).floor();
 	}
+	return p + pixelOffset;
 }
 
 void TextRenderer::setSpriteFilter(SpriteFilter f)
@@ -301,7 +444,8 @@ void TextRenderer::setSpriteFilter(SpriteFilter f)
 
 Vector2f TextRenderer::getExtents() const
 {
-	return getExtents(text);
+	updateLayout();
+	return layoutExtents;
 }
 
 Vector2f TextRenderer::getExtents(const StringUTF32& str) const
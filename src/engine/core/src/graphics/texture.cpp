@@ -1,20 +1,229 @@
 #include "halley/core/graphics/texture.h"
 #include "halley/core/api/halley_api.h"
 #include "halley/core/graphics/texture_descriptor.h"
+#include "halley/core/graphics/texture_upload_queue.h"
 #include <halley/file_formats/image.h>
 #include <halley/resources/metadata.h>
 #include "halley/concurrency/concurrent.h"
+#include "halley/support/logger.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
 
 using namespace Halley;
 
+namespace {
+	TextureFormat getFormat(const Metadata& meta)
+	{
+		auto formatStr = meta.getString("format", "rgba");
+		if (formatStr == "rgba_premultiplied") {
+			formatStr = "rgba";
+		}
+		return fromString<TextureFormat>(formatStr);
+	}
+
+	TextureDescriptor makeDescriptor(const Metadata& meta, TextureDescriptorImageData img, Vector2i size)
+	{
+		TextureDescriptor descriptor(size);
+		descriptor.useFiltering = meta.getBool("filtering", false);
+		descriptor.useMipMap = meta.getBool("mipmap", false);
+		descriptor.clamp = meta.getBool("clamp", true);
+		descriptor.format = getFormat(meta);
+		descriptor.pixelData = std::move(img);
+		descriptor.pixelFormat = meta.getString("compression") == "png" ? PixelDataFormat::Image : PixelDataFormat::Precompiled;
+		return descriptor;
+	}
+
+	// The importer stores every mip level, largest first
+	TextureDescriptorImageData getMipLevels(std::shared_ptr<const ResourceDataStatic> data, const Metadata& meta, Vector2i size, int firstLevel)
+	{
+		const auto format = getFormat(meta);
+		size_t offset = 0;
+		for (int i = 0; i < firstLevel; ++i) {
+			offset += TextureDescriptor::getLevelByteSize(TextureDescriptor::getMipLevelSize(size, i), format);
+		}
+
+		const auto span = data->getSpan();
+		if (offset >= size_t(span.size())) {
+			throw Exception("Texture data doesn't have mip level " + toString(firstLevel), HalleyExceptions::Graphics);
+		}
+		return TextureDescriptorImageData(std::move(data), span.subspan(offset));
+	}
+
+	int getMipStreamingStart(const Metadata& meta, Vector2i size)
+	{
+		const int nLevels = meta.getInt("mipLevels", 1);
+		const int maxSize = meta.getInt("mipStreamingSize", 512);
+		int level = 0;
+		while (level < nLevels - 1) {
+			const auto levelSize = TextureDescriptor::getMipLevelSize(size, level);
+			if (std::max(levelSize.x, levelSize.y) <= maxSize) {
+				break;
+			}
+			++level;
+		}
+		return level;
+	}
+}
+
+struct Texture::MipStream
+{
+	VideoAPI& video;
+	std::function<std::unique_ptr<ResourceDataStatic>()> fetch;
+	int residentLevel;
+
+	// A new texture with more levels, loading in the background
+	std::shared_ptr<Texture> incoming;
+	std::shared_ptr<std::atomic<bool>> incomingFailed;
+	int incomingLevel = 0;
+	bool failed = false;
+
+	MipStream(VideoAPI& video, std::function<std::unique_ptr<ResourceDataStatic>()> fetch, int residentLevel)
+		: video(video)
+		, fetch(std::move(fetch))
+		, residentLevel(residentLevel)
+	{}
+};
+
 Texture::Texture(Vector2i size)
 	: size(size)
 {}
 
+Texture::~Texture() = default;
+
 void Texture::load(TextureDescriptor&& descriptor)
 {
 }
 
+size_t Texture::getMemoryUsage() const
+{
+	auto& meta = getMeta();
+	const auto format = meta.getString("format", "rgba");
+	const size_t pixels = size_t(std::max(size.x, 0)) * size_t(std::max(size.y, 0));
+	size_t bytes;
+	if (format == "bc1") {
+		bytes = pixels / 2;
+	} else if (format == "bc3") {
+		bytes = pixels;
+	} else {
+		bytes = pixels * (format == "indexed" ? 1 : (format == "rgb" ? 3 : 4));
+	}
+
+	// Each level skipped by mip streaming is a quarter of the one before
+	if (mipStream) {
+		bytes >>= 2 * mipStream->residentLevel;
+	}
+
+	// A full mip chain adds a third
+	return meta.getBool("mipmap", false) ? bytes * 4 / 3 : bytes;
+}
+
+bool Texture::isMipStreamed() const
+{
+	return static_cast<bool>(mipStream);
+}
+
+int Texture::getResidentMipLevel() const
+{
+	return mipStream ? mipStream->residentLevel : 0;
+}
+
+void Texture::requestMipLevel(int level) const
+{
+	if (!mipStream || mipStream->failed) {
+		return;
+	}
+	auto& stream = *mipStream;
+
+	if (stream.incoming) {
+		if (!stream.incoming->isLoaded()) {
+			return;
+		}
+
+		if (*stream.incomingFailed) {
+			// Don't keep reading it again every frame
+			stream.failed = true;
+		} else {
+			// Swap in the finer version; the stream state isn't part of it, so it stays with this texture
+			auto& self = const_cast<Texture&>(*this);
+			self.reload(std::move(*stream.incoming));
+			stream.residentLevel = stream.incomingLevel;
+		}
+		stream.incoming.reset();
+		stream.incomingFailed.reset();
+		if (stream.failed) {
+			return;
+		}
+	}
+
+	level = std::max(level, 0);
+	if (level >= stream.residentLevel) {
+		return;
+	}
+
+	auto incoming = std::shared_ptr<Texture>(stream.video.createTexture(size));
+	auto failed = std::make_shared<std::atomic<bool>>(false);
+	incoming->setMeta(getMeta());
+	incoming->setAssetId(getAssetId());
+	incoming->uploadQueue = uploadQueue; // Nothing binds it, so it's only paced
+	stream.incoming = incoming;
+	stream.incomingFailed = failed;
+	stream.incomingLevel = level;
+
+	Concurrent::execute(Executors::getDiskIO(), [fetch = stream.fetch] () -> std::unique_ptr<ResourceDataStatic>
+	{
+		try {
+			return fetch();
+		} catch (std::exception& e) {
+			Logger::logException(e);
+			return {};
+		}
+	})
+	.then(Executors::getVideoAux(), [incoming, failed, level] (std::unique_ptr<ResourceDataStatic> data)
+	{
+		try {
+			if (!data) {
+				throw Exception("Unable to read texture data again", HalleyExceptions::Resources);
+			}
+			auto& meta = incoming->getMeta();
+			const auto levelSize = TextureDescriptor::getMipLevelSize(incoming->getSize(), level);
+			auto descriptor = makeDescriptor(meta, getMipLevels(std::move(data), meta, incoming->getSize(), level), levelSize);
+			if (incoming->uploadQueue) {
+				incoming->uploadQueue->enqueue(incoming, std::move(descriptor), [incoming, failed] ()
+				{
+					*failed = true;
+					incoming->doneLoading();
+				});
+			} else {
+				incoming->load(std::move(descriptor));
+			}
+		} catch (std::exception& e) {
+			Logger::logError("Failed to stream in mip levels of texture \"" + incoming->getAssetId() + "\": " + e.what());
+			*failed = true;
+			incoming->doneLoading();
+		}
+	});
+}
+
+const Texture& Texture::getBindable() const
+{
+	if (!uploadQueue || isLoaded()) {
+		return *this;
+	}
+
+	const auto placeholder = usePlaceholder ? uploadQueue->getPlaceholder() : nullptr;
+	uploadQueue->onWanted(*this, !placeholder);
+	return placeholder ? *placeholder : *this;
+}
+
+int Texture::getMipLevelFor(float pixelsPerTexel)
+{
+	if (pixelsPerTexel <= 0) {
+		return 0;
+	}
+	return std::max(0, int(std::floor(-std::log2(pixelsPerTexel))));
+}
+
 std::shared_ptr<Texture> Texture::loadResource(ResourceLoader& loader)
 {
 	auto& meta = loader.getMeta();
@@ -23,37 +232,43 @@ std::shared_ptr<Texture> Texture::loadResource(ResourceLoader& loader)
 		throw Exception("Unable to load texture \"" + loader.getName() + "\" due to missing asset data.", HalleyExceptions::Graphics);
 	}
 
-	std::shared_ptr<Texture> texture = loader.getAPI().video->createTexture(size);
+	auto& video = *loader.getAPI().video;
+	std::shared_ptr<Texture> texture = video.createTexture(size);
 	texture->setMeta(meta);
+	texture->uploadQueue = video.getTextureUploadQueue();
+	texture->usePlaceholder = meta.getBool("placeholder", true);
+
+	// Only raw data with a stored mip chain can be uploaded a few levels down
+	int firstLevel = 0;
+	if (meta.getBool("mipStreaming", false) && meta.getString("compression") == "raw" && meta.getInt("mipLevels", 1) > 1) {
+		firstLevel = getMipStreamingStart(meta, size);
+		if (firstLevel > 0) {
+			texture->mipStream = std::make_unique<MipStream>(video, loader.getFetcher(), firstLevel);
+		}
+	}
 
 	loader.getAsync()
-	.then([texture](std::unique_ptr<ResourceDataStatic> data) -> TextureDescriptorImageData
+	.then([texture, firstLevel](std::unique_ptr<ResourceDataStatic> data) -> TextureDescriptorImageData
 	{
 		auto& meta = texture->getMeta();
 		if (meta.getString("compression") == "png") {
 			return TextureDescriptorImageData(std::make_unique<Image>(*data, meta));
+		} else if (firstLevel > 0) {
+			return getMipLevels(std::move(data), meta, texture->getSize(), firstLevel);
 		} else {
-			return TextureDescriptorImageData(data->getSpan());
+			// Uploaded from the resource data itself, which for a memory-mapped pack is the mapping
+			const auto span = data->getSpan();
+			return TextureDescriptorImageData(std::move(data), span);
 		}
 	})
-	.then(Executors::getVideoAux(), [texture](TextureDescriptorImageData img)
+	.then(Executors::getVideoAux(), [texture, firstLevel](TextureDescriptorImageData img)
 	{
-		auto& meta = texture->getMeta();
-
-		auto formatStr = meta.getString("format", "rgba");
-		if (formatStr == "rgba_premultiplied") {
-			formatStr = "rgba";
+		auto descriptor = makeDescriptor(texture->getMeta(), std::move(img), TextureDescriptor::getMipLevelSize(texture->getSize(), firstLevel));
+		if (texture->uploadQueue) {
+			texture->uploadQueue->enqueue(texture, std::move(descriptor));
+		} else {
+			texture->load(std::move(descriptor));
 		}
-
-		Vector2i size(meta.getInt("width"), meta.getInt("height"));
-		TextureDescriptor descriptor(size);
-		descriptor.useFiltering = meta.getBool("filtering", false);
-		descriptor.useMipMap = meta.getBool("mipmap", false);
-		descriptor.clamp = meta.getBool("clamp", true);
-		descriptor.format = fromString<TextureFormat>(formatStr);
-		descriptor.pixelData = std::move(img);
-		descriptor.pixelFormat = meta.getString("compression") == "png" ? PixelDataFormat::Image : PixelDataFormat::Precompiled;
-		texture->load(std::move(descriptor));
 	});
 
 	return texture;
@@ -1,4 +1,5 @@
 #include "halley/core/graphics/texture_descriptor.h"
+#include <algorithm>
 
 using namespace Halley;
 
@@ -20,6 +21,8 @@ TextureDescriptorImageData::TextureDescriptorImageData(Bytes&& bytes, Maybe<int>
 TextureDescriptorImageData::TextureDescriptorImageData(TextureDescriptorImageData&& other) noexcept
 	: img(move(other.img))
 	, rawBytes(move(other.rawBytes))
+	, source(move(other.source))
+	, sourceView(other.sourceView)
 	, stride(other.stride)
 	, isRaw(other.isRaw)
 {}
@@ -32,10 +35,21 @@ TextureDescriptorImageData::TextureDescriptorImageData(gsl::span<const gsl::byte
 	memcpy(rawBytes.data(), bytes.data(), bytes.size_bytes());
 }
 
+TextureDescriptorImageData::TextureDescriptorImageData(std::shared_ptr<const ResourceDataStatic> data, gsl::span<const gsl::byte> view, Maybe<int> stride)
+	: source(move(data))
+	, sourceView(view)
+	, stride(stride)
+	, isRaw(true)
+{
+	Expects(source);
+}
+
 TextureDescriptorImageData& TextureDescriptorImageData::operator=(TextureDescriptorImageData&& other) noexcept
 {
 	img = move(other.img);
 	rawBytes = move(other.rawBytes);
+	source = move(other.source);
+	sourceView = other.sourceView;
 	stride = other.stride;
 	isRaw = other.isRaw;
 	return *this;
@@ -43,17 +57,26 @@ TextureDescriptorImageData& TextureDescriptorImageData::operator=(TextureDescrip
 
 bool TextureDescriptorImageData::empty() const
 {
+	if (source) {
+		return sourceView.empty();
+	}
 	return isRaw ? rawBytes.empty() : !img;
 }
 
 Byte* TextureDescriptorImageData::getBytes()
 {
+	if (source) {
+		// Read-only, as it may point into a mapped file
+		return const_cast<Byte*>(reinterpret_cast<const Byte*>(sourceView.data()));
+	}
 	return isRaw ? rawBytes.data() : reinterpret_cast<Byte*>(img->getPixels());
 }
 
 gsl::span<const gsl::byte> TextureDescriptorImageData::getSpan() const
 {
-	if (isRaw) {
+	if (source) {
+		return sourceView;
+	} else if (isRaw) {
 		return gsl::as_bytes(gsl::span<const Byte>(rawBytes.data(), rawBytes.size()));
 	} else {
 		return gsl::as_bytes(gsl::span<char>(img->getPixels(), img->getByteSize()));
@@ -62,7 +85,13 @@ gsl::span<const gsl::byte> TextureDescriptorImageData::getSpan() const
 
 Bytes TextureDescriptorImageData::moveBytes()
 {
-	if (isRaw) {
+	if (source) {
+		Bytes result(size_t(sourceView.size()));
+		memcpy(result.data(), sourceView.data(), result.size());
+		source.reset();
+		sourceView = {};
+		return result;
+	} else if (isRaw) {
 		return move(rawBytes);
 	} else {
 		if (!img || img->getByteSize() == 0) {
@@ -102,6 +131,7 @@ TextureDescriptor& TextureDescriptor::operator=(TextureDescriptor&& other) noexc
 	format = other.format;
 	pixelFormat = other.pixelFormat;
 	pixelData = std::move(other.pixelData);
+	layers = other.layers;
 	useMipMap = other.useMipMap;
 	useFiltering = other.useFiltering;
 	clamp = other.clamp;
@@ -122,6 +152,37 @@ int TextureDescriptor::getBitsPerPixel(TextureFormat format)
 		return 3;
 	case TextureFormat::Indexed:
 		return 1;
+	case TextureFormat::BC1:
+	case TextureFormat::BC3:
+		throw Exception("Block-compressed formats have no per-pixel size: " + toString(format), HalleyExceptions::Graphics);
 	}
 	throw Exception("Unknown image format: " + toString(format), HalleyExceptions::Graphics);
 }
+
+bool TextureDescriptor::isCompressed(TextureFormat format)
+{
+	return format == TextureFormat::BC1 || format == TextureFormat::BC3;
+}
+
+size_t TextureDescriptor::getLevelByteSize(Vector2i size, TextureFormat format)
+{
+	if (isCompressed(format)) {
+		const size_t blockBytes = format == TextureFormat::BC1 ? 8 : 16;
+		return size_t((size.x + 3) / 4) * size_t((size.y + 3) / 4) * blockBytes;
+	}
+	return size_t(size.x) * size_t(size.y) * size_t(getBitsPerPixel(format));
+}
+
+int TextureDescriptor::getNumMipLevels(Vector2i size)
+{
+	int levels = 1;
+	for (int s = std::max(size.x, size.y); s > 1; s /= 2) {
+		++levels;
+	}
+	return levels;
+}
+
+Vector2i TextureDescriptor::getMipLevelSize(Vector2i size, int level)
+{
+	return Vector2i(std::max(size.x >> level, 1), std::max(size.y >> level, 1));
+}
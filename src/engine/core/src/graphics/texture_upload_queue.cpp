@@ -0,0 +1,263 @@
+#include "halley/core/graphics/texture_upload_queue.h"
+#include "halley/core/graphics/texture.h"
+#include "halley/core/api/video_api.h"
+#include "halley/concurrency/concurrent.h"
+#include "halley/data_structures/flat_hash_map.h"
+#include "halley/support/logger.h"
+#include "halley/support/profiler.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+using namespace Halley;
+
+namespace {
+	size_t getUploadBytes(const TextureDescriptor& descriptor)
+	{
+		size_t bytes = TextureDescriptor::getLevelByteSize(descriptor.size, descriptor.format) * size_t(std::max(descriptor.layers, 1));
+		return descriptor.useMipMap ? bytes * 4 / 3 : bytes;
+	}
+}
+
+struct TextureUploadQueue::State
+{
+	struct Entry
+	{
+		std::shared_ptr<Texture> texture;
+		TextureDescriptor descriptor;
+		std::function<void()> onFailed;
+		size_t bytes = 0;
+		uint64_t order = 0;
+	};
+
+	struct Wanted
+	{
+		uint32_t frame = 0;
+		bool urgent = false;
+	};
+
+	ExecutionQueue& executor;
+	const Config config;
+
+	std::mutex mutex;
+	std::condition_variable frameStarted;
+	std::vector<Entry> pending;
+	FlatHashMap<const Texture*, Wanted> wanted; // Including ones still being read, which get their priority once they're queued
+	std::shared_ptr<Texture> placeholder;
+	uint64_t nextOrder = 0;
+	uint32_t frame = 1;
+	int64_t budget;
+	bool draining = false;
+
+	State(ExecutionQueue& executor, Config config)
+		: executor(executor)
+		, config(config)
+		, budget(int64_t(config.bytesPerFrame))
+	{}
+
+	bool hasUrgent() const
+	{
+		for (auto& e: pending) {
+			auto iter = wanted.find(e.texture.get());
+			if (iter != wanted.end() && iter->second.urgent) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Urgent first, then by how recently they were drawn, then in order of arrival
+	std::vector<Entry>::iterator getNext(bool& urgent)
+	{
+		auto getKey = [&] (const Entry& e)
+		{
+			auto iter = wanted.find(e.texture.get());
+			const auto w = iter != wanted.end() ? iter->second : Wanted();
+			return std::make_tuple(w.urgent ? 1 : 0, w.frame, ~e.order);
+		};
+
+		auto best = pending.begin();
+		auto bestKey = getKey(*best);
+		for (auto i = best + 1; i != pending.end(); ++i) {
+			const auto key = getKey(*i);
+			if (key > bestKey) {
+				best = i;
+				bestKey = key;
+			}
+		}
+		urgent = std::get<0>(bestKey) != 0;
+		return best;
+	}
+};
+
+TextureUploadQueue::TextureUploadQueue(ExecutionQueue& executor)
+	: TextureUploadQueue(executor, Config())
+{
+}
+
+TextureUploadQueue::TextureUploadQueue(ExecutionQueue& executor, Config config)
+	: state(std::make_shared<State>(executor, config))
+{
+}
+
+TextureUploadQueue::~TextureUploadQueue()
+{
+	clear();
+}
+
+void TextureUploadQueue::createPlaceholder(VideoAPI& video)
+{
+	auto placeholder = std::shared_ptr<Texture>(video.createTexture(Vector2i(1, 1)));
+	placeholder->setAssetId("!placeholder");
+
+	TextureDescriptor descriptor(Vector2i(1, 1), TextureFormat::RGBA);
+	descriptor.pixelFormat = PixelDataFormat::Precompiled;
+	descriptor.pixelData = TextureDescriptorImageData(Bytes(4, 0));
+
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->placeholder = placeholder;
+		state->wanted[placeholder.get()] = State::Wanted{ state->frame, true };
+	}
+	enqueue(std::move(placeholder), std::move(descriptor));
+}
+
+const Texture* TextureUploadQueue::getPlaceholder() const
+{
+	std::unique_lock<std::mutex> lock(state->mutex);
+	return state->placeholder.get();
+}
+
+void TextureUploadQueue::enqueue(std::shared_ptr<Texture> texture, TextureDescriptor descriptor, std::function<void()> onFailed)
+{
+	Expects(texture);
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		State::Entry entry;
+		entry.bytes = getUploadBytes(descriptor);
+		entry.texture = std::move(texture);
+		entry.descriptor = std::move(descriptor);
+		entry.onFailed = std::move(onFailed);
+		entry.order = state->nextOrder++;
+		state->pending.push_back(std::move(entry));
+	}
+	state->frameStarted.notify_all();
+	scheduleDrain(state);
+}
+
+void TextureUploadQueue::onFrame()
+{
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		++state->frame;
+		state->budget = int64_t(state->config.bytesPerFrame);
+
+		// Forget about textures that haven't been asked for in a while, including any that never made it to the queue
+		const auto frame = state->frame;
+		for (auto i = state->wanted.begin(); i != state->wanted.end(); ) {
+			if (!i->second.urgent && i->second.frame + 8 < frame) {
+				i = state->wanted.erase(i);
+			} else {
+				++i;
+			}
+		}
+	}
+	state->frameStarted.notify_all();
+	scheduleDrain(state);
+}
+
+void TextureUploadQueue::onWanted(const Texture& texture, bool urgent)
+{
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		auto& w = state->wanted[&texture];
+		w.frame = state->frame;
+		w.urgent = w.urgent || urgent;
+	}
+	if (urgent) {
+		state->frameStarted.notify_all();
+	}
+}
+
+void TextureUploadQueue::clear()
+{
+	std::vector<State::Entry> dropped;
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		dropped = std::move(state->pending);
+		state->pending.clear();
+		state->wanted.clear();
+		state->placeholder.reset();
+	}
+	state->frameStarted.notify_all();
+
+	for (auto& e: dropped) {
+		e.texture->doneLoading();
+	}
+}
+
+void TextureUploadQueue::scheduleDrain(const std::shared_ptr<State>& state)
+{
+	{
+		std::unique_lock<std::mutex> lock(state->mutex);
+		if (state->draining || state->pending.empty()) {
+			return;
+		}
+		state->draining = true;
+	}
+	Concurrent::executeDetached(state->executor, [state] () { drain(state); });
+}
+
+void TextureUploadQueue::drain(const std::shared_ptr<State>& state)
+{
+	auto& s = *state;
+	while (true) {
+		State::Entry entry;
+		{
+			std::unique_lock<std::mutex> lock(s.mutex);
+			if (s.pending.empty()) {
+				s.draining = false;
+				return;
+			}
+
+			bool urgent = false;
+			auto next = s.getNext(urgent);
+			if (!urgent && s.budget <= 0) {
+				// Out of budget, so wait for the next frame, or for something urgent; if frames stop coming, carry on anyway after a while
+				const auto frame = s.frame;
+				const bool woken = s.frameStarted.wait_for(lock, std::chrono::milliseconds(s.config.maxFrameWaitMs), [&] ()
+				{
+					return s.frame != frame || s.pending.empty() || s.hasUrgent();
+				});
+				if (!woken) {
+					s.budget = int64_t(s.config.bytesPerFrame);
+				}
+
+				// Let anything else on the executor have its turn before carrying on
+				lock.unlock();
+				Concurrent::executeDetached(s.executor, [state] () { drain(state); });
+				return;
+			}
+
+			entry = std::move(*next);
+			s.pending.erase(next);
+			s.wanted.erase(entry.texture.get());
+			s.budget -= int64_t(entry.bytes);
+		}
+
+		HALLEY_PROFILE_SCOPE("TextureUploadQueue::upload");
+		try {
+			entry.texture->load(std::move(entry.descriptor));
+		} catch (std::exception& e) {
+			Logger::logError("Failed to upload texture \"" + entry.texture->getAssetId() + "\": " + e.what());
+			if (entry.onFailed) {
+				entry.onFailed();
+			} else {
+				entry.texture->loadingFailed();
+			}
+		}
+	}
+}
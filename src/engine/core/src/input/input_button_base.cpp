@@ -44,6 +44,9 @@ void InputButtonBase::onButtonPressed(int code)
 		buttonPressed[code] = true;
 		// Note that this doesn't set released as false. It's possible to get a press and a release on the same step.
 		buttonDown[code] = true;
+		if (eventQueue) {
+			eventQueue->push(*this, code, true);
+		}
 	}
 }
 
@@ -53,6 +56,9 @@ void InputButtonBase::onButtonReleased(int code)
 		// See comment on method above
 		buttonReleased[code] = true;
 		buttonDown[code] = false;
+		if (eventQueue) {
+			eventQueue->push(*this, code, false);
+		}
 	}
 }
 
@@ -67,6 +73,9 @@ void InputButtonBase::onButtonStatus(int code, bool down)
 		buttonPressed[code] = true;
 		buttonPressedRepeat[code] = true;
 	}
+	if (eventQueue && wasDown != down) {
+		eventQueue->push(*this, code, down);
+	}
 }
 
 void InputButtonBase::setParent(InputDevice* p)
@@ -79,6 +88,11 @@ InputDevice* InputButtonBase::getParent() const
 	return parent;
 }
 
+void InputButtonBase::setEventQueue(std::shared_ptr<InputEventQueue> queue)
+{
+	eventQueue = std::move(queue);
+}
+
 void InputButtonBase::clearPresses()
 {
 	size_t len = buttonPressed.size();
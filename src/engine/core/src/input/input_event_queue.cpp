@@ -0,0 +1,59 @@
+#include "input/input_event_queue.h"
+#include <algorithm>
+#include <chrono>
+#include <gsl/gsl_assert>
+
+using namespace Halley;
+
+InputEventQueue::InputEventQueue(size_t capacity)
+	: events(capacity)
+{
+	Expects(capacity > 0);
+}
+
+int64_t InputEventQueue::getTime()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void InputEventQueue::setEventTime(int64_t time)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	eventTime = time;
+}
+
+void InputEventQueue::push(InputDevice& device, int button, bool down)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	// Readers stop at the first event past their time, so timestamps can't go backwards
+	lastTimestamp = std::max(lastTimestamp, eventTime != 0 ? eventTime : getTime());
+
+	auto& event = events[end % events.size()];
+	event.timestamp = lastTimestamp;
+	event.device = &device;
+	event.button = button;
+	event.down = down;
+	++end;
+}
+
+uint64_t InputEventQueue::getEnd() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return end;
+}
+
+void InputEventQueue::read(uint64_t& cursor, int64_t until, Vector<InputButtonEvent>& dst) const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	const uint64_t capacity = events.size();
+	cursor = std::max(cursor, end > capacity ? end - capacity : 0);
+	for (; cursor < end; ++cursor) {
+		auto& event = events[cursor % capacity];
+		if (event.timestamp > until) {
+			break;
+		}
+		dst.push_back(event);
+	}
+}
@@ -102,6 +102,14 @@ void InputJoystick::clearAxes()
 	}
 }
 
+void InputJoystick::setEventQueue(std::shared_ptr<InputEventQueue> queue)
+{
+	for (auto& hat: hats) {
+		hat->setEventQueue(queue);
+	}
+	InputButtonBase::setEventQueue(std::move(queue));
+}
+
 bool InputJoystick::isAnyButtonPressed()
 {
 	for (auto& hat: hats) {
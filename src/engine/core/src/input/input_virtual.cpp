@@ -388,6 +388,40 @@ InputDevice* InputVirtual::getLastDevice() const
 	return lastDevice;
 }
 
+void InputVirtual::setEventQueue(std::shared_ptr<InputEventQueue> queue)
+{
+	eventQueue = std::move(queue);
+	eventCursor = eventQueue ? eventQueue->getEnd() : 0;
+	events.clear();
+}
+
+void InputVirtual::consumeEvents(int64_t until)
+{
+	events.clear();
+	if (!eventQueue) {
+		return;
+	}
+
+	deviceEvents.clear();
+	eventQueue->read(eventCursor, until, deviceEvents);
+	for (auto& event: deviceEvents) {
+		for (size_t i = 0; i < buttons.size(); ++i) {
+			for (auto& bind: buttons[i]) {
+				if (bind.device.get() == event.device && bind.a == event.button && !bind.isAxisEmulation) {
+					auto virtualEvent = event;
+					virtualEvent.button = int(i);
+					events.push_back(virtualEvent);
+				}
+			}
+		}
+	}
+}
+
+const Vector<InputButtonEvent>& InputVirtual::getEvents() const
+{
+	return events;
+}
+
 void InputVirtual::updateLastDevice()
 {
 	if (!lastDeviceFrozen) {
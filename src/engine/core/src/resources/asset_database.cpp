@@ -1,56 +1,259 @@
 #include "halley/core/resources/asset_database.h"
 #include "halley/bytes/byte_serializer.h"
+#include "halley/bytes/compression.h"
 #include "halley/support/exception.h"
+#include "halley/utils/hash.h"
+#include <algorithm>
+#include <atomic>
 #include <set>
 
 using namespace Halley;
 
+namespace {
+	// All offsets are from the start of the database, and every table is 4-byte aligned
+	struct CompactHeader
+	{
+		std::array<char, 4> identifier; // "HADB"
+		uint32_t version;
+		uint32_t numTypes;
+		uint32_t totalSize;
+	};
+
+	struct CompactTypeHeader
+	{
+		int32_t type;
+		uint32_t numEntries;
+		uint32_t numSeeds;
+		uint32_t seedsOffset;
+		uint32_t recordsOffset;
+	};
+
+	struct CompactRecord
+	{
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		uint32_t entryOffset; // The serialized Entry
+		uint32_t entryLength;
+	};
+
+	constexpr uint32_t compactVersion = 1;
+	constexpr size_t entriesPerSeed = 4;
+
+	// Names are hashed once; the bucket comes from the top half, the slot from its seed mixed into the whole thing
+	uint64_t hashName(const char* name, size_t length)
+	{
+		return Hash::hashXXH64(gsl::as_bytes(gsl::span<const char>(name, length)));
+	}
+
+	uint32_t getBucket(uint64_t hash, uint32_t numSeeds)
+	{
+		return uint32_t(hash >> 32) % numSeeds;
+	}
+
+	uint32_t getSlot(uint64_t hash, uint32_t seed, uint32_t numEntries)
+	{
+		uint64_t x = hash + (uint64_t(seed) + 1) * 0x9E3779B97F4A7C15ull;
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		x = x ^ (x >> 31);
+		return uint32_t(x % numEntries);
+	}
+
+	size_t align4(size_t size)
+	{
+		return (size + 3) & ~size_t(3);
+	}
+}
+
+namespace Halley {
+	class CompactTypedDB
+	{
+	public:
+		CompactTypedDB(std::shared_ptr<const Bytes> storage, const gsl::byte* base, const CompactTypeHeader& header)
+			: storage(std::move(storage))
+			, base(base)
+			, seeds(reinterpret_cast<const uint32_t*>(base + header.seedsOffset))
+			, records(reinterpret_cast<const CompactRecord*>(base + header.recordsOffset))
+			, numSeeds(header.numSeeds)
+			, numEntries(header.numEntries)
+			, decoded(new std::atomic<AssetDatabase::Entry*>[header.numEntries]())
+		{}
+
+		~CompactTypedDB()
+		{
+			for (size_t i = 0; i < numEntries; ++i) {
+				delete decoded[i].load(std::memory_order_relaxed);
+			}
+		}
+
+		size_t size() const
+		{
+			return numEntries;
+		}
+
+		const AssetDatabase::Entry* find(const String& name) const
+		{
+			if (numEntries == 0) {
+				return nullptr;
+			}
+
+			const uint64_t hash = hashName(name.c_str(), name.size());
+			const uint32_t idx = getSlot(hash, seeds[getBucket(hash, numSeeds)], numEntries);
+
+			// The hash is only perfect over the names in it, anything else lands on some other entry
+			const auto& record = records[idx];
+			if (record.nameLength != name.size() || memcmp(base + record.nameOffset, name.c_str(), record.nameLength) != 0) {
+				return nullptr;
+			}
+			return &getEntry(idx);
+		}
+
+		String getName(size_t idx) const
+		{
+			const auto& record = records[idx];
+			return String(reinterpret_cast<const char*>(base + record.nameOffset), record.nameLength);
+		}
+
+		const AssetDatabase::Entry& getEntry(size_t idx) const
+		{
+			auto& slot = decoded[idx];
+			auto entry = slot.load(std::memory_order_acquire);
+			if (!entry) {
+				const auto& record = records[idx];
+				auto result = std::make_unique<AssetDatabase::Entry>();
+				Deserializer s(gsl::span<const gsl::byte>(base + record.entryOffset, record.entryLength));
+				s >> *result;
+
+				// Someone else might have got here first, in which case theirs is kept
+				if (slot.compare_exchange_strong(entry, result.get(), std::memory_order_acq_rel)) {
+					entry = result.release();
+				}
+			}
+			return *entry;
+		}
+
+	private:
+		std::shared_ptr<const Bytes> storage; // Unless it's in place
+		const gsl::byte* base;
+		const uint32_t* seeds;
+		const CompactRecord* records;
+		const uint32_t numSeeds;
+		const uint32_t numEntries;
+		std::unique_ptr<std::atomic<AssetDatabase::Entry*>[]> decoded;
+	};
+}
+
 AssetDatabase::Entry::Entry() {}
 
-AssetDatabase::Entry::Entry(const String& path, const Metadata& meta)
+AssetDatabase::Entry::Entry(const String& path, const Metadata& meta, std::vector<std::pair<AssetType, String>> dependencies)
 	: path(path)
 	, meta(meta)
+	, dependencies(std::move(dependencies))
 {}
 
 void AssetDatabase::Entry::serialize(Serializer& s) const
 {
 	s << path;
 	s << meta;
+	s << dependencies;
 }
 
 void AssetDatabase::Entry::deserialize(Deserializer& s)
 {
 	s >> path;
 	s >> meta;
+	s >> dependencies;
 }
 
 void AssetDatabase::TypedDB::add(const String& name, Entry&& asset)
 {
+	expand();
 	assets[name] = std::move(asset);
 }
 
+void AssetDatabase::TypedDB::remove(const String& name)
+{
+	expand();
+	assets.erase(name);
+}
+
 const AssetDatabase::Entry& AssetDatabase::TypedDB::get(const String& name) const
 {
-	auto i = assets.find(name);
-	if (i == assets.end()) {
+	auto entry = tryGet(name);
+	if (!entry) {
 		throw Exception("Asset not found: " + name, HalleyExceptions::Resources);
 	}
-	return i->second;
+	return *entry;
+}
+
+const AssetDatabase::Entry* AssetDatabase::TypedDB::tryGet(const String& name) const
+{
+	if (compact) {
+		return compact->find(name);
+	}
+	auto i = assets.find(name);
+	return i != assets.end() ? &i->second : nullptr;
 }
 
 void AssetDatabase::TypedDB::serialize(Serializer& s) const
 {
-	s << assets;
+	if (compact) {
+		HashMap<String, Entry> all;
+		forEach([&] (const String& name, const Entry& entry) { all[name] = entry; });
+		s << all;
+	} else {
+		s << assets;
+	}
 }
 
 void AssetDatabase::TypedDB::deserialize(Deserializer& s)
 {
+	compact.reset();
 	s >> assets;
 }
 
-const HashMap<String, AssetDatabase::Entry>& AssetDatabase::TypedDB::getAssets() const
+size_t AssetDatabase::TypedDB::size() const
+{
+	return compact ? compact->size() : assets.size();
+}
+
+std::vector<String> AssetDatabase::TypedDB::getNames() const
+{
+	std::vector<String> result;
+	result.reserve(size());
+	if (compact) {
+		for (size_t i = 0; i < compact->size(); ++i) {
+			result.push_back(compact->getName(i));
+		}
+	} else {
+		for (auto& asset: assets) {
+			result.push_back(asset.first);
+		}
+	}
+	return result;
+}
+
+void AssetDatabase::TypedDB::forEach(const std::function<void(const String&, const Entry&)>& f) const
+{
+	if (compact) {
+		for (size_t i = 0; i < compact->size(); ++i) {
+			f(compact->getName(i), compact->getEntry(i));
+		}
+	} else {
+		for (auto& asset: assets) {
+			f(asset.first, asset.second);
+		}
+	}
+}
+
+void AssetDatabase::TypedDB::expand()
 {
-	return assets;
+	if (compact) {
+		for (size_t i = 0; i < compact->size(); ++i) {
+			assets[compact->getName(i)] = compact->getEntry(i);
+		}
+		compact.reset();
+	}
 }
 
 void AssetDatabase::addAsset(const String& name, AssetType type, Entry&& entry)
@@ -58,18 +261,31 @@ void AssetDatabase::addAsset(const String& name, AssetType type, Entry&& entry)
 	dbs[int(type)].add(name, std::move(entry));
 }
 
+void AssetDatabase::removeAsset(const String& name, AssetType type)
+{
+	dbs[int(type)].remove(name);
+}
+
 const AssetDatabase::TypedDB& AssetDatabase::getDatabase(AssetType type) const
 {
 	return dbs[int(type)];
 }
 
+std::vector<AssetType> AssetDatabase::getTypes() const
+{
+	std::vector<AssetType> result;
+	for (auto& db: dbs) {
+		result.push_back(AssetType(db.first));
+	}
+	return result;
+}
+
 std::vector<String> AssetDatabase::getAssets() const
 {
 	std::set<String> contains;
 	std::vector<String> result;
 	for (auto& db: dbs) {
-		for (auto& asset: db.second.getAssets()) {
-			const String& name = asset.first;
+		for (auto& name: db.second.getNames()) {
 			if (contains.find(name) == contains.end()) {
 				contains.insert(name);
 				result.push_back(name);
@@ -92,9 +308,191 @@ void AssetDatabase::deserialize(Deserializer& s)
 
 std::vector<String> AssetDatabase::enumerate(AssetType type) const
 {
-	std::vector<String> result;
-	for (auto& asset: getDatabase(type).getAssets()) {
-		result.push_back(asset.first);
+	return getDatabase(type).getNames();
+}
+
+Bytes AssetDatabase::toCompact() const
+{
+	struct TypeData
+	{
+		CompactTypeHeader header;
+		std::vector<uint32_t> seeds;
+		std::vector<CompactRecord> records;
+	};
+	std::vector<TypeData> types;
+	Bytes pool;
+
+	auto addToPool = [&] (gsl::span<const gsl::byte> data) -> uint32_t
+	{
+		const size_t pos = pool.size();
+		pool.resize(pos + size_t(data.size()));
+		memcpy(pool.data() + pos, data.data(), size_t(data.size()));
+		return uint32_t(pos);
+	};
+
+	for (auto& db: dbs) {
+		std::vector<std::pair<String, Entry>> entries;
+		db.second.forEach([&] (const String& name, const Entry& entry) { entries.emplace_back(name, entry); });
+		const auto n = uint32_t(entries.size());
+
+		types.emplace_back();
+		auto& type = types.back();
+		type.header.type = int32_t(db.first);
+		type.header.numEntries = n;
+		type.header.numSeeds = uint32_t(std::max(size_t(1), (entries.size() + entriesPerSeed - 1) / entriesPerSeed));
+		type.seeds.resize(type.header.numSeeds, 0);
+		type.records.resize(n);
+
+		// Hash and displace: the fullest buckets pick their seeds first, while there's still plenty of free slots
+		std::vector<uint64_t> hashes(n);
+		std::vector<std::vector<uint32_t>> buckets(type.header.numSeeds);
+		for (uint32_t i = 0; i < n; ++i) {
+			const auto& name = entries[i].first;
+			hashes[i] = hashName(name.c_str(), name.size());
+			buckets[getBucket(hashes[i], type.header.numSeeds)].push_back(i);
+		}
+		std::vector<uint32_t> order(buckets.size());
+		for (uint32_t i = 0; i < uint32_t(order.size()); ++i) {
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&] (uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+		std::vector<char> taken(n, 0);
+		std::vector<uint32_t> slots;
+		for (auto b: order) {
+			const auto& bucket = buckets[b];
+			if (bucket.empty()) {
+				break;
+			}
+			for (uint32_t seed = 0; ; ++seed) {
+				if (seed == std::numeric_limits<uint32_t>::max()) {
+					throw Exception("Unable to build perfect hash for asset database.", HalleyExceptions::Resources);
+				}
+				slots.clear();
+				bool ok = true;
+				for (auto i: bucket) {
+					const uint32_t slot = getSlot(hashes[i], seed, n);
+					if (taken[slot] || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+						ok = false;
+						break;
+					}
+					slots.push_back(slot);
+				}
+				if (ok) {
+					type.seeds[b] = seed;
+					for (size_t j = 0; j < bucket.size(); ++j) {
+						taken[slots[j]] = 1;
+						auto& record = type.records[slots[j]];
+						const auto& entry = entries[bucket[j]];
+						const auto entryBytes = Serializer::toBytes(entry.second);
+						record.nameOffset = addToPool(gsl::as_bytes(gsl::span<const char>(entry.first.c_str(), entry.first.size())));
+						record.nameLength = uint32_t(entry.first.size());
+						record.entryOffset = addToPool(gsl::as_bytes(gsl::span<const Byte>(entryBytes)));
+						record.entryLength = uint32_t(entryBytes.size());
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	// Lay it all out, now that the sizes are known
+	size_t pos = sizeof(CompactHeader) + types.size() * sizeof(CompactTypeHeader);
+	for (auto& type: types) {
+		type.header.seedsOffset = uint32_t(pos);
+		pos += type.seeds.size() * sizeof(uint32_t);
+		type.header.recordsOffset = uint32_t(pos);
+		pos += type.records.size() * sizeof(CompactRecord);
+	}
+	const size_t poolOffset = align4(pos);
+	const size_t totalSize = poolOffset + pool.size();
+	if (totalSize > std::numeric_limits<uint32_t>::max()) {
+		throw Exception("Asset database is too large.", HalleyExceptions::Resources);
+	}
+
+	Bytes result(totalSize, 0);
+	CompactHeader header;
+	memcpy(header.identifier.data(), "HADB", 4);
+	header.version = compactVersion;
+	header.numTypes = uint32_t(types.size());
+	header.totalSize = uint32_t(totalSize);
+	memcpy(result.data(), &header, sizeof(header));
+
+	pos = sizeof(CompactHeader);
+	for (auto& type: types) {
+		for (auto& record: type.records) {
+			record.nameOffset += uint32_t(poolOffset);
+			record.entryOffset += uint32_t(poolOffset);
+		}
+		memcpy(result.data() + pos, &type.header, sizeof(CompactTypeHeader));
+		pos += sizeof(CompactTypeHeader);
+		memcpy(result.data() + type.header.seedsOffset, type.seeds.data(), type.seeds.size() * sizeof(uint32_t));
+		memcpy(result.data() + type.header.recordsOffset, type.records.data(), type.records.size() * sizeof(CompactRecord));
 	}
+	memcpy(result.data() + poolOffset, pool.data(), pool.size());
+
 	return result;
 }
+
+bool AssetDatabase::isCompact(gsl::span<const gsl::byte> data)
+{
+	return data.size() >= std::ptrdiff_t(sizeof(CompactHeader)) && memcmp(data.data(), "HADB", 4) == 0;
+}
+
+void AssetDatabase::loadCompact(gsl::span<const gsl::byte> data, bool inPlace)
+{
+	if (!isCompact(data)) {
+		throw Exception("Asset database is not compact.", HalleyExceptions::Resources);
+	}
+	CompactHeader header;
+	memcpy(&header, data.data(), sizeof(header));
+	if (header.version != compactVersion) {
+		throw Exception("Unsupported asset database version: " + toString(header.version), HalleyExceptions::Resources);
+	}
+	if (header.totalSize > size_t(data.size()) || sizeof(CompactHeader) + size_t(header.numTypes) * sizeof(CompactTypeHeader) > header.totalSize) {
+		throw Exception("Asset database is invalid (truncated).", HalleyExceptions::Resources);
+	}
+
+	// Tables are read in place, so they need to be aligned; a heap copy always is
+	std::shared_ptr<const Bytes> storage;
+	const gsl::byte* base = data.data();
+	if (!inPlace || (reinterpret_cast<uintptr_t>(base) & 3) != 0) {
+		auto copy = std::make_shared<Bytes>(header.totalSize);
+		memcpy(copy->data(), base, copy->size());
+		base = reinterpret_cast<const gsl::byte*>(copy->data());
+		storage = std::move(copy);
+	}
+
+	dbs.clear();
+	for (uint32_t i = 0; i < header.numTypes; ++i) {
+		CompactTypeHeader typeHeader;
+		memcpy(&typeHeader, base + sizeof(CompactHeader) + i * sizeof(CompactTypeHeader), sizeof(typeHeader));
+
+		const bool valid = typeHeader.numSeeds > 0
+			&& typeHeader.seedsOffset % 4 == 0 && typeHeader.recordsOffset % 4 == 0
+			&& size_t(typeHeader.seedsOffset) + size_t(typeHeader.numSeeds) * sizeof(uint32_t) <= header.totalSize
+			&& size_t(typeHeader.recordsOffset) + size_t(typeHeader.numEntries) * sizeof(CompactRecord) <= header.totalSize;
+		if (!valid) {
+			throw Exception("Asset database is invalid (bad table).", HalleyExceptions::Resources);
+		}
+		auto records = reinterpret_cast<const CompactRecord*>(base + typeHeader.recordsOffset);
+		for (uint32_t j = 0; j < typeHeader.numEntries; ++j) {
+			if (size_t(records[j].nameOffset) + records[j].nameLength > header.totalSize || size_t(records[j].entryOffset) + records[j].entryLength > header.totalSize) {
+				throw Exception("Asset database is invalid (bad record).", HalleyExceptions::Resources);
+			}
+		}
+
+		dbs[typeHeader.type].compact = std::make_shared<CompactTypedDB>(storage, base, typeHeader);
+	}
+}
+
+void AssetDatabase::loadPacked(gsl::span<const gsl::byte> data, bool inPlace)
+{
+	if (isCompact(data)) {
+		loadCompact(data, inPlace);
+	} else {
+		Bytes compressed(size_t(data.size()));
+		memcpy(compressed.data(), data.data(), compressed.size());
+		Deserializer::fromBytes<AssetDatabase>(*this, Compression::decompress(compressed));
+	}
+}
@@ -5,6 +5,9 @@
 #include "halley/bytes/compression.h"
 #include "halley/maths/random.h"
 #include "halley/utils/encrypt.h"
+#include "halley/os/os.h"
+#include "halley/concurrency/concurrent.h"
+#include <gsl/gsl_assert>
 
 using namespace Halley;
 
@@ -42,11 +45,7 @@ AssetPack::AssetPack(std::unique_ptr<ResourceDataReader> _reader, const String&
 	if (nRead != int(sizeof(header))) {
 		throw Exception("Unable to read header", HalleyExceptions::Resources);
 	}
-	if (memcmp(header.identifier.data(), "HALLEYPK", 8) != 0) {
-		throw Exception("Asset pack is invalid (invalid identifier)", HalleyExceptions::Resources);
-	}
-	iv = header.iv;
-	dataOffset = size_t(header.dataStartPos);
+	loadHeader(header, totalSize);
 
 	// Read asset database
 	{
@@ -56,23 +55,92 @@ AssetPack::AssetPack(std::unique_ptr<ResourceDataReader> _reader, const String&
 		if (nRead != int(assetDbBytes.size())) {
 			throw Exception("Unable to read header", HalleyExceptions::Resources);
 		}
-		assetDb = std::make_unique<AssetDatabase>();
-		Deserializer::fromBytes<AssetDatabase>(*assetDb, Compression::decompress(assetDbBytes));
+		loadAssetDatabase(gsl::as_bytes(gsl::span<const Byte>(assetDbBytes)), false);
 	}
 
-	std::array<char, 16> ivEmpty;
-	memset(ivEmpty.data(), 0, ivEmpty.size());
-	const bool hasCrypt = memcmp(iv.data(), ivEmpty.data(), iv.size()) != 0 && !encryptionKey.isEmpty();
+	const bool hasCrypt = needsDecryption(encryptionKey);
+	if (hasCrypt && counterMode) {
+		cipher = std::make_unique<Encrypt::CounterMode>(getIVBytes(), encryptionKey);
+	}
 
-	if (preLoad || hasCrypt) {
+	// CBC can only be decrypted all at once
+	if (preLoad || (hasCrypt && !counterMode)) {
 		readToMemory();
 	}
 
-	if (hasCrypt) {
+	if (hasCrypt && (preLoad || !counterMode)) {
 		decrypt(encryptionKey);
 	}
 }
 
+AssetPack::AssetPack(std::unique_ptr<MemoryMappedFile> file, const String& encryptionKey)
+	: mappedFile(std::move(file))
+	, hasReader(false)
+{
+	Expects(mappedFile);
+	auto fileData = mappedFile->getData();
+
+	// Read header
+	const size_t totalSize = size_t(fileData.size());
+	if (totalSize < sizeof(AssetPackHeader)) {
+		throw Exception("Asset pack is invalid (too small)", HalleyExceptions::Resources);
+	}
+	AssetPackHeader header;
+	memcpy(&header, fileData.data(), sizeof(header));
+	loadHeader(header, totalSize);
+
+	// Read asset database, in place unless the mapping is about to go (see below)
+	const bool keepsMapping = !needsDecryption(encryptionKey) || counterMode;
+	const auto assetDbStart = std::ptrdiff_t(header.assetDbStartPos);
+	loadAssetDatabase(fileData.subspan(assetDbStart, std::ptrdiff_t(header.dataStartPos) - assetDbStart), keepsMapping);
+	mappedData = fileData.subspan(std::ptrdiff_t(dataOffset));
+
+	if (needsDecryption(encryptionKey)) {
+		if (counterMode) {
+			cipher = std::make_unique<Encrypt::CounterMode>(getIVBytes(), encryptionKey);
+		} else {
+			readToMemory();
+			decrypt(encryptionKey);
+		}
+	}
+}
+
+void AssetPack::loadHeader(const AssetPackHeader& header, size_t totalSize)
+{
+	if (memcmp(header.identifier.data(), "HALLEYPC", 8) == 0) {
+		counterMode = true;
+	} else if (memcmp(header.identifier.data(), "HALLEYPK", 8) == 0) {
+		counterMode = false;
+	} else {
+		throw Exception("Asset pack is invalid (invalid identifier)", HalleyExceptions::Resources);
+	}
+	if (header.assetDbStartPos > header.dataStartPos || header.dataStartPos > totalSize) {
+		throw Exception("Asset pack is invalid (truncated)", HalleyExceptions::Resources);
+	}
+	iv = header.iv;
+	dataOffset = size_t(header.dataStartPos);
+}
+
+void AssetPack::loadAssetDatabase(gsl::span<const gsl::byte> assetDbBytes, bool inPlace)
+{
+	assetDb = std::make_unique<AssetDatabase>();
+	assetDb->loadPacked(assetDbBytes, inPlace);
+}
+
+bool AssetPack::needsDecryption(const String& encryptionKey) const
+{
+	std::array<char, 16> ivEmpty;
+	memset(ivEmpty.data(), 0, ivEmpty.size());
+	return memcmp(iv.data(), ivEmpty.data(), iv.size()) != 0 && !encryptionKey.isEmpty();
+}
+
+Bytes AssetPack::getIVBytes() const
+{
+	Bytes ivBytes(iv.size());
+	memcpy(ivBytes.data(), iv.data(), iv.size());
+	return ivBytes;
+}
+
 AssetPack::~AssetPack()
 {
 }
@@ -84,11 +152,17 @@ AssetPack& AssetPack::operator=(AssetPack&& other)
 	assetDb = std::move(other.assetDb);
 	dataOffset = other.dataOffset;
 	reader = std::move(other.reader);
+	mappedFile = std::move(other.mappedFile);
+	mappedData = other.mappedData;
 	data = std::move(other.data);
+	iv = other.iv;
+	counterMode = other.counterMode;
+	cipher = std::move(other.cipher);
 	hasReader = !!reader;
 
 	other.hasReader = false;
 	other.reader.reset();
+	other.mappedData = gsl::span<const gsl::byte>();
 
 	return *this;
 }
@@ -113,12 +187,15 @@ const Bytes& AssetPack::getData() const
 	return data;
 }
 
-Bytes AssetPack::writeOut() const
+Bytes AssetPack::writeOut(size_t assetDbCapacity) const
 {
-	auto assetDbBytes = Compression::compress(Serializer::toBytes(*assetDb));
+	auto assetDbBytes = assetDb->toCompact();
 	AssetPackHeader header;
-	header.init(assetDbBytes.size());
+	header.init(std::max(assetDbBytes.size(), assetDbCapacity));
 	header.iv = iv;
+	if (counterMode) {
+		memcpy(header.identifier.data(), "HALLEYPC", 8);
+	}
 
 	auto result = Bytes(size_t(header.dataStartPos + data.size()));
 	memcpy(result.data(), &header, sizeof(AssetPackHeader));
@@ -130,16 +207,27 @@ Bytes AssetPack::writeOut() const
 std::unique_ptr<ResourceData> AssetPack::getData(const String& asset, AssetType type, bool stream)
 {
 	auto path = asset;
-	auto ps = assetDb->getDatabase(type).get(asset).path.split(':');
+	const auto& entry = assetDb->getDatabase(type).get(asset);
+	auto ps = entry.path.split(':');
 	size_t pos = size_t(ps.at(0).toInteger());
 	size_t size = size_t(ps.at(1).toInteger());
 
 	if (stream) {
+		const auto chunkedCodec = entry.meta.getString("asset_stream_compression", "");
+		if (!chunkedCodec.isEmpty()) {
+			return std::make_unique<ResourceDataStream>(path, [=] () -> std::unique_ptr<ResourceDataReader> {
+				return std::make_unique<ChunkedPackDataReader>(*this, pos, size, chunkedCodec);
+			});
+		}
 		return std::make_unique<ResourceDataStream>(path, [=] () -> std::unique_ptr<ResourceDataReader> {
 			return std::make_unique<PackDataReader>(*this, pos, size);
 		});
 	} else {
-		if (hasReader) {
+		if (mappedFile && !cipher) {
+			// Zero-copy, the pack outlives its resources
+			auto span = getMappedData(pos, size);
+			return std::make_unique<ResourceDataStatic>(span.data(), size, path, false);
+		} else if (mappedFile || hasReader || cipher) {
 			auto result = new char[size];
 			try {
 				readData(pos, gsl::as_writeable_bytes(gsl::span<char>(result, size)));
@@ -162,8 +250,15 @@ std::unique_ptr<ResourceData> AssetPack::getData(const String& asset, AssetType
 void AssetPack::readToMemory()
 {
 	std::unique_lock<std::mutex> lock(readerMutex);
-	reader->seek(dataOffset, SEEK_SET);
-	data = reader->readAll();
+	if (mappedFile) {
+		data = Bytes(size_t(mappedData.size()));
+		memcpy(data.data(), mappedData.data(), data.size());
+		mappedData = gsl::span<const gsl::byte>();
+		mappedFile.reset();
+	} else {
+		reader->seek(dataOffset, SEEK_SET);
+		data = reader->readAll();
+	}
 	hasReader = false;
 	reader.reset();
 }
@@ -172,22 +267,54 @@ void AssetPack::encrypt(const String& key)
 {
 	// Generate IV
 	Random::getGlobal().getBytes(gsl::as_writeable_bytes(gsl::span<char>(iv)));
-	Bytes ivBytes(iv.size());
-	memcpy(ivBytes.data(), iv.data(), iv.size());
 
-	data = Encrypt::encrypt(ivBytes, key, data);
+	Encrypt::CounterMode(getIVBytes(), key).apply(gsl::as_writeable_bytes(gsl::span<Byte>(data)), 0);
+	counterMode = true;
 }
 
 void AssetPack::decrypt(const String& key)
 {
-	Bytes ivBytes(iv.size());
-	memcpy(ivBytes.data(), iv.data(), iv.size());
+	if (!counterMode) {
+		data = Encrypt::decrypt(getIVBytes(), key, data);
+		return;
+	}
+
+	if (!cipher) {
+		cipher = std::make_unique<Encrypt::CounterMode>(getIVBytes(), key);
+	}
 
-	data = Encrypt::decrypt(ivBytes, key, data);
+	// Every range decrypts independently, so the whole pack can be split across threads
+	constexpr size_t chunkSize = 1024 * 1024;
+	Vector<size_t> chunks;
+	for (size_t pos = 0; pos < data.size(); pos += chunkSize) {
+		chunks.push_back(pos);
+	}
+	auto& c = *cipher;
+	Concurrent::foreach(Executors::getCPU(), chunks.begin(), chunks.end(), [&] (size_t pos)
+	{
+		c.apply(gsl::as_writeable_bytes(gsl::span<Byte>(data.data() + pos, std::min(chunkSize, data.size() - pos))), pos);
+	}, 1);
+	cipher.reset();
 }
 
 void AssetPack::readData(size_t pos, gsl::span<gsl::byte> dst)
 {
+	doReadData(pos, dst);
+
+	// Outside of the reader lock, so reads from several threads decrypt in parallel
+	if (cipher) {
+		cipher->apply(dst, pos);
+	}
+}
+
+void AssetPack::doReadData(size_t pos, gsl::span<gsl::byte> dst)
+{
+	if (mappedFile) {
+		auto src = getMappedData(pos, size_t(dst.size()));
+		memcpy(dst.data(), src.data(), dst.size());
+		return;
+	}
+
 	if (hasReader) {
 		std::unique_lock<std::mutex> lock(readerMutex);
 		if (reader) {
@@ -204,6 +331,15 @@ void AssetPack::readData(size_t pos, gsl::span<gsl::byte> dst)
 	memcpy(dst.data(), data.data() + pos, dst.size());
 }
 
+gsl::span<const gsl::byte> AssetPack::getMappedData(size_t pos, size_t size) const
+{
+	Expects(mappedFile);
+	if (pos + size > size_t(mappedData.size())) {
+		throw Exception("Asset data is out of pack bounds.", HalleyExceptions::Resources);
+	}
+	return mappedData.subspan(std::ptrdiff_t(pos), std::ptrdiff_t(size));
+}
+
 std::unique_ptr<ResourceDataReader> AssetPack::extractReader()
 {
 	std::unique_lock<std::mutex> lock(readerMutex);
@@ -215,7 +351,11 @@ PackDataReader::PackDataReader(AssetPack& pack, size_t startPos, size_t fileSize
 	: pack(pack)
 	, startPos(startPos)
 	, fileSize(fileSize)
+	, curPos(0)
 {
+	if (pack.isMemoryMapped() && !pack.isEncrypted()) {
+		mappedData = pack.getMappedData(startPos, fileSize);
+	}
 }
 
 size_t PackDataReader::size() const
@@ -224,18 +364,128 @@ size_t PackDataReader::size() const
 }
 
 int PackDataReader::read(gsl::span<gsl::byte> dst)
+{
+	// Claim the range first, so concurrent reads never overlap
+	size_t pos = curPos.load(std::memory_order_relaxed);
+	size_t toRead;
+	do {
+		toRead = std::min(fileSize - std::min(pos, fileSize), size_t(dst.size()));
+	} while (!curPos.compare_exchange_weak(pos, pos + toRead, std::memory_order_relaxed));
+
+	if (mappedData.data()) {
+		memcpy(dst.data(), mappedData.data() + pos, toRead);
+	} else {
+		pack.readData(startPos + pos, dst.subspan(0, toRead));
+	}
+
+	return int(toRead);
+}
+
+void PackDataReader::seek(int64_t pos, int whence)
+{
+	switch (whence) {
+	case SEEK_SET:
+		curPos.store(size_t(pos), std::memory_order_relaxed);
+		break;
+	case SEEK_CUR:
+		curPos.fetch_add(size_t(pos), std::memory_order_relaxed);
+		break;
+	case SEEK_END:
+		curPos.store(size_t(fileSize + pos), std::memory_order_relaxed);
+		break;
+	}
+}
+
+size_t PackDataReader::tell() const
+{
+	return curPos.load(std::memory_order_relaxed);
+}
+
+void PackDataReader::close()
+{
+}
+
+ChunkedPackDataReader::ChunkedPackDataReader(AssetPack& pack, size_t startPos, size_t fileSize, String codec)
+	: pack(pack)
+	, startPos(startPos)
+	, fileSize(fileSize)
+	, codec(std::move(codec))
+{
+	if (fileSize < sizeof(header)) {
+		throw Exception("Chunked asset data is too small.", HalleyExceptions::Resources);
+	}
+	pack.readData(startPos, gsl::as_writeable_bytes(gsl::span<Compression::ChunkedHeader>(&header, 1)));
+
+	offsets.resize(size_t(header.numChunks) + 1);
+	const size_t indexSize = offsets.size() * sizeof(uint64_t);
+	if (header.chunkSize == 0 || sizeof(header) + indexSize > fileSize) {
+		throw Exception("Chunked asset index is invalid.", HalleyExceptions::Resources);
+	}
+	pack.readData(startPos + sizeof(header), gsl::as_writeable_bytes(gsl::span<uint64_t>(offsets)));
+	if (offsets.back() > fileSize) {
+		throw Exception("Chunked asset index is out of bounds.", HalleyExceptions::Resources);
+	}
+}
+
+size_t ChunkedPackDataReader::size() const
+{
+	return size_t(header.totalSize);
+}
+
+int ChunkedPackDataReader::read(gsl::span<gsl::byte> dst)
 {
 	std::unique_lock<std::mutex> lock(mutex);
-	size_t available = fileSize - curPos;
-	size_t toRead = std::min(available, size_t(dst.size()));
 
-	pack.readData(startPos + curPos, dst.subspan(0, toRead));
-	curPos += toRead;
+	const size_t totalSize = size();
+	const size_t pos = std::min(curPos, totalSize);
+	const size_t toRead = std::min(totalSize - pos, size_t(dst.size()));
+	if (toRead == 0) {
+		return 0;
+	}
+
+	const size_t chunkSize = header.chunkSize;
+	const size_t firstChunk = pos / chunkSize;
+	const size_t lastChunk = (pos + toRead - 1) / chunkSize;
+
+	auto copyFrom = [&] (size_t chunk, const Bytes& chunkData)
+	{
+		const size_t chunkStart = chunk * chunkSize;
+		const size_t start = std::max(pos, chunkStart);
+		const size_t end = std::min(pos + toRead, chunkStart + chunkData.size());
+		if (end > start) {
+			memcpy(dst.data() + (start - pos), chunkData.data() + (start - chunkStart), end - start);
+		}
+	};
+
+	if (firstChunk == lastChunk) {
+		if (cachedChunk != firstChunk) {
+			cachedData = decompressChunk(firstChunk);
+			cachedChunk = firstChunk;
+		}
+		copyFrom(firstChunk, cachedData);
+	} else {
+		std::vector<size_t> chunks;
+		for (size_t i = firstChunk; i <= lastChunk; ++i) {
+			chunks.push_back(i);
+		}
+		std::vector<Bytes> decompressed(chunks.size());
+		Concurrent::foreach(Executors::getCPU(), chunks.begin(), chunks.end(), [&] (size_t chunk)
+		{
+			decompressed[chunk - firstChunk] = decompressChunk(chunk);
+		}, 1);
+
+		for (size_t i = firstChunk; i <= lastChunk; ++i) {
+			copyFrom(i, decompressed[i - firstChunk]);
+		}
+		cachedData = std::move(decompressed.back());
+		cachedChunk = lastChunk;
+	}
 
+	curPos = pos + toRead;
 	return int(toRead);
 }
 
-void PackDataReader::seek(int64_t pos, int whence)
+void ChunkedPackDataReader::seek(int64_t pos, int whence)
 {
 	std::unique_lock<std::mutex> lock(mutex);
 	switch (whence) {
@@ -243,21 +493,35 @@ void PackDataReader::seek(int64_t pos, int whence)
 		curPos = size_t(pos);
 		break;
 	case SEEK_CUR:
-		curPos = size_t(curPos + pos);
+		curPos = size_t(int64_t(curPos) + pos);
 		break;
 	case SEEK_END:
-		curPos = size_t(fileSize + pos);
+		curPos = size_t(int64_t(size()) + pos);
 		break;
 	}
 }
 
-size_t PackDataReader::tell() const
+size_t ChunkedPackDataReader::tell() const
 {
-	std::unique_lock<std::mutex> lock(mutex);
 	return curPos;
 }
 
-void PackDataReader::close()
+void ChunkedPackDataReader::close()
 {
+	std::unique_lock<std::mutex> lock(mutex);
+	cachedData = Bytes();
+	cachedChunk = std::numeric_limits<size_t>::max();
 }
 
+Bytes ChunkedPackDataReader::decompressChunk(size_t chunk)
+{
+	const size_t start = size_t(offsets.at(chunk));
+	const size_t end = size_t(offsets.at(chunk + 1));
+	if (end < start) {
+		throw Exception("Chunked asset index is invalid.", HalleyExceptions::Resources);
+	}
+
+	Bytes compressed(end - start);
+	pack.readData(startPos + start, gsl::as_writeable_bytes(gsl::span<Byte>(compressed)));
+	return Compression::decompress(gsl::as_bytes(gsl::span<const Byte>(compressed)), codec, header.chunkSize);
+}
@@ -1,53 +1,94 @@
 #include "resources/resource_collection.h"
 #include "resources/resource_locator.h"
 #include "resources/resources.h"
+#include "resources/resource_streamer.h"
+#include <halley/resources/metadata.h>
+#include <algorithm>
 #include <halley/resources/resource.h>
 #include "halley/support/logger.h"
+#include "halley/support/profiler.h"
 
 using namespace Halley;
 
 
+namespace {
+	bool isDestroyedOnMainThread(AssetType type)
+	{
+		switch (type) {
+		case AssetType::BinaryFile:
+		case AssetType::TextFile:
+		case AssetType::Image:
+		case AssetType::AudioClip:
+		case AssetType::AudioEvent:
+		case AssetType::StringTable:
+			return false;
+		default:
+			// Textures, shaders and materials, or anything that might hold the last reference to one.
+			// Config files too, as destroying one detaches its ConfigObservers, which are read on the main thread without a lock.
+			return true;
+		}
+	}
+}
+
 ResourceCollectionBase::ResourceCollectionBase(Resources& parent, AssetType type)
 	: parent(parent)
 	, type(type)
+	, destroyOnMainThread(isDestroyedOnMainThread(type))
 {
 }
 
 void ResourceCollectionBase::clear()
 {
+	for (auto& r: resources) {
+		onResourceRemoved(r.second);
+	}
 	resources.clear();
+	residentBytes = 0;
 }
 
 void ResourceCollectionBase::unload(const String& assetId)
 {
-	resources.erase(assetId);
+	unload(StringId::hash(assetId));
+}
+
+void ResourceCollectionBase::unload(uint64_t key)
+{
+	auto res = resources.find(key);
+	if (res != resources.end()) {
+		onResourceRemoved(res->second);
+		resources.erase(res);
+	}
 }
 
 void ResourceCollectionBase::unloadAll(int minDepth)
 {
 	for (auto iter = resources.begin(); iter != resources.end(); ) {
-		auto next = iter;
-		++next;
-
 		auto& res = (*iter).second;
 		if (res.depth >= minDepth) {
-			resources.erase(iter);
+			onResourceRemoved(res);
+			iter = resources.erase(iter);
+		} else {
+			++iter;
 		}
-
-		iter = next;
 	}
 }
 
 void ResourceCollectionBase::reload(const String& assetId)
 {
-	auto res = resources.find(assetId);
-	if (res != resources.end()) {
-		auto& resWrap = res->second;
+	const uint64_t key = StringId::hash(assetId);
+	if (resources.find(key) != resources.end()) {
 		try {
 			std::shared_ptr<Resource> newAsset = loadAsset(assetId, ResourceLoadPriority::High);
 			newAsset->setAssetId(assetId);
 			newAsset->onLoaded(parent);
+
+			// Loading may have added other resources, which moves the ones already there
+			auto& resWrap = resources.find(key)->second;
 			resWrap.res->reloadResource(std::move(*newAsset));
+
+			residentBytes -= resWrap.bytes;
+			resWrap.bytes = resWrap.res->getMemoryUsage();
+			residentBytes += resWrap.bytes;
 		} catch (std::exception& e) {
 			Logger::logError("Error while reloading " + assetId + ": " + e.what());
 		} catch (...) {
@@ -68,7 +109,8 @@ std::vector<String> ResourceCollectionBase::enumerate() const
 	return parent.locator->enumerate(type);
 }
 
-std::shared_ptr<Resource> ResourceCollectionBase::loadAsset(const String& assetId, ResourceLoadPriority priority) {
+std::shared_ptr<Resource> ResourceCollectionBase::loadAsset(const String& assetId, ResourceLoadPriority priority, std::unique_ptr<ResourceDataStatic> prefetched) {
+	HALLEY_PROFILE_SCOPE_DETAIL("Resources::loadAsset", assetId);
 	std::shared_ptr<Resource> newRes;
 
 	if (resourceLoader) {
@@ -77,6 +119,7 @@ std::shared_ptr<Resource> ResourceCollectionBase::loadAsset(const String& assetI
 	} else {
 		// Normal loading
 		auto resLoader = ResourceLoader(*(parent.locator), assetId, type, priority, parent.api);
+		resLoader.prefetched = std::move(prefetched);
 		newRes = loadResource(resLoader);
 		if (!newRes && resLoader.loaded) {
 			throw Exception("Unable to construct resource from data: " + assetId, HalleyExceptions::Resources);
@@ -89,29 +132,126 @@ std::shared_ptr<Resource> ResourceCollectionBase::loadAsset(const String& assetI
 	return newRes;
 }
 
-std::shared_ptr<Resource> ResourceCollectionBase::doGet(const String& assetId, ResourceLoadPriority priority)
+std::shared_ptr<Resource> ResourceCollectionBase::doGet(StringView assetId, ResourceLoadPriority priority)
 {
+	return doGet(StringId::hash(assetId.data(), assetId.size()), assetId, priority);
+}
+
+std::shared_ptr<Resource> ResourceCollectionBase::doGet(const StringId& assetId, ResourceLoadPriority priority)
+{
+	return doGet(assetId.getHash(), assetId.getString(), priority);
+}
+
+std::shared_ptr<Resource> ResourceCollectionBase::doGet(uint64_t key, StringView name, ResourceLoadPriority priority)
+{
+	if (parent.accessTrace) {
+		parent.recordAccess(type, name);
+	}
+
 	// Look in cache and return if it's there
-	auto res = resources.find(assetId);
+	auto res = resources.find(key);
 	if (res != resources.end()) {
+		res->second.lastUsedFrame = parent.curFrame;
 		return res->second.res;
 	}
+	const String assetId(name);
 	
+	// Already being streamed in, so don't read it twice
+	if (auto request = parent.streamer->find(type, assetId)) {
+		return finishStreaming(*request);
+	}
+
 	// Load resource from disk
 	std::shared_ptr<Resource> newRes = loadAsset(assetId, priority);
 
 	// Store in cache
 	newRes->setAssetId(assetId);
-	resources.emplace(assetId, Wrapper(newRes, 0));
+	addResource(assetId, newRes, 0);
 	newRes->onLoaded(parent);
 
 	return newRes;
 }
 
+std::shared_ptr<Resource> ResourceCollectionBase::doGetAsync(const String& assetId, ResourceLoadPriority priority, Time deadline, std::shared_ptr<ResourceStreamRequest>& request)
+{
+	if (parent.accessTrace) {
+		parent.recordAccess(type, assetId);
+	}
+
+	auto res = resources.find(StringId::hash(assetId));
+	if (res != resources.end()) {
+		res->second.lastUsedFrame = parent.curFrame;
+		return res->second.res;
+	}
+
+	// Custom loaders and streamed resources are constructed on the main thread, all we can do ahead of time is queue them
+	bool prefetch = !resourceLoader;
+	if (prefetch) {
+		try {
+			prefetch = !parent.locator->getMetaData(assetId, type).getBool("streaming", false);
+		} catch (...) {
+			// Let the error surface when it's constructed
+			prefetch = false;
+		}
+	}
+	request = parent.streamer->request(*this, type, assetId, priority, deadline, prefetch);
+	return {};
+}
+
+std::shared_ptr<Resource> ResourceCollectionBase::finishStreaming(ResourceStreamRequest& request)
+{
+	Expects(&request.collection == this);
+
+	if (!request.isDone()) {
+		parent.streamer->waitForFetch(request);
+
+		// The request might have been finished while waiting, e.g. by a synchronous get()
+		if (!request.isDone()) {
+			auto res = resources.find(StringId::hash(request.assetId));
+			if (res != resources.end()) {
+				request.result = res->second.res;
+			} else if (!request.error) {
+				try {
+					auto newRes = loadAsset(request.assetId, request.priority, std::move(request.data));
+					newRes->setAssetId(request.assetId);
+					addResource(request.assetId, newRes, 0);
+					newRes->onLoaded(parent);
+					request.result = newRes;
+				} catch (...) {
+					request.error = std::current_exception();
+				}
+			}
+			parent.streamer->complete(request);
+
+			auto callbacks = std::move(request.onDone);
+			request.onDone.clear();
+			for (auto& callback: callbacks) {
+				callback(request.error ? std::shared_ptr<Resource>() : request.result);
+			}
+		}
+	}
+
+	if (request.error) {
+		std::rethrow_exception(request.error);
+	}
+	return request.result;
+}
+
+void ResourceCollectionBase::onStreamed(ResourceStreamRequest& request, std::function<void(std::shared_ptr<Resource>)> callback)
+{
+	Expects(&request.collection == this);
+
+	if (request.isDone()) {
+		callback(request.error ? std::shared_ptr<Resource>() : request.result);
+	} else {
+		request.onDone.push_back(std::move(callback));
+	}
+}
+
 bool ResourceCollectionBase::exists(const String& assetId)
 {
 	// Look in cache
-	auto res = resources.find(assetId);
+	auto res = resources.find(StringId::hash(assetId));
 	if (res != resources.end()) {
 		return true;
 	}
@@ -120,10 +260,81 @@ bool ResourceCollectionBase::exists(const String& assetId)
 }
 
 void ResourceCollectionBase::setResource(int curDepth, const String& name, std::shared_ptr<Resource> resource) {
-	resources.emplace(name, Wrapper(resource, curDepth));
+	addResource(name, std::move(resource), curDepth);
+}
+
+void ResourceCollectionBase::addResource(const String& assetId, std::shared_ptr<Resource> resource, int depth)
+{
+	const size_t bytes = resource->getMemoryUsage();
+	auto result = resources.emplace(StringId::hash(assetId), Wrapper(assetId, std::move(resource), depth, bytes, parent.curFrame));
+	if (result.second) {
+		residentBytes += result.first->second.bytes;
+	} else if (result.first->second.assetId != assetId) {
+		throw Exception("Asset id hash collision between \"" + result.first->second.assetId + "\" and \"" + assetId + "\"", HalleyExceptions::Resources);
+	}
+}
+
+void ResourceCollectionBase::onResourceRemoved(Wrapper& wrapper)
+{
+	residentBytes -= wrapper.bytes;
+
+	// Only worth deferring if nothing else is holding on to it, as then it'd be destroyed right now
+	if (wrapper.res.use_count() == 1) {
+		if (destroyOnMainThread) {
+			parent.destructor.destroyOnMainThread(std::move(wrapper.res));
+		} else {
+			parent.destructor.destroyOnWorker(std::move(wrapper.res));
+		}
+	}
 }
 
 void ResourceCollectionBase::setResourceLoader(ResourceLoaderFunc loader)
 {
 	resourceLoader = loader;
 }
+
+void ResourceCollectionBase::setMemoryBudget(size_t bytes)
+{
+	memoryBudget = bytes;
+}
+
+size_t ResourceCollectionBase::getMemoryBudget() const
+{
+	return memoryBudget;
+}
+
+size_t ResourceCollectionBase::getResidentBytes() const
+{
+	return residentBytes;
+}
+
+size_t ResourceCollectionBase::getNumResident() const
+{
+	return resources.size();
+}
+
+size_t ResourceCollectionBase::evict(size_t targetBytes)
+{
+	if (residentBytes <= targetBytes) {
+		return 0;
+	}
+
+	// Only resources which nobody else references can go, and never ones used this frame or the previous one
+	std::vector<std::pair<uint64_t, uint64_t>> candidates;
+	for (auto& r: resources) {
+		auto& wrapper = r.second;
+		if (wrapper.res.use_count() == 1 && wrapper.bytes > 0 && wrapper.lastUsedFrame + 1 < parent.curFrame) {
+			candidates.emplace_back(wrapper.lastUsedFrame, r.first);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end());
+
+	const size_t startBytes = residentBytes;
+	for (auto& c: candidates) {
+		if (residentBytes <= targetBytes) {
+			break;
+		}
+		unload(c.second);
+	}
+	return startBytes - residentBytes;
+}
@@ -1,11 +1,13 @@
 #include "resource_filesystem.h"
 #include "resources/resource_locator.h"
+#include <algorithm>
 #include <iostream>
 #include <set>
 #include <halley/support/exception.h>
 #include "resource_pack.h"
 #include "halley/support/logger.h"
 #include "api/system_api.h"
+#include "halley/os/os.h"
 
 using namespace Halley;
 
@@ -16,21 +18,97 @@ ResourceLocator::ResourceLocator(SystemAPI& system)
 
 void ResourceLocator::add(std::unique_ptr<IResourceLocatorProvider> locator)
 {
-	auto& db = locator->getAssetDatabase();
-	for (auto& asset: db.getAssets()) {
-		auto result = locators.find(asset);
-		if (result == locators.end() || result->second->getPriority() < locator->getPriority()) {
-			locators[asset] = locator.get();
+	addToIndex(*locator);
+	locatorList.emplace_back(std::move(locator));
+}
+
+void ResourceLocator::remove(const IResourceLocatorProvider& locator)
+{
+	auto iter = std::find_if(locatorList.begin(), locatorList.end(), [&] (const std::unique_ptr<IResourceLocatorProvider>& l) { return l.get() == &locator; });
+	if (iter == locatorList.end()) {
+		return;
+	}
+
+	removeFromIndex(**iter);
+	for (auto p = packs.begin(); p != packs.end(); ++p) {
+		if (p->second == &locator) {
+			packs.erase(p);
+			break;
 		}
 	}
-	locatorList.emplace_back(std::move(locator));
+	locatorList.erase(iter);
+}
+
+bool ResourceLocator::removePack(const Path& path)
+{
+	auto iter = packs.find(path.string());
+	if (iter == packs.end()) {
+		return false;
+	}
+	remove(*iter->second);
+	return true;
+}
+
+void ResourceLocator::addToIndex(IResourceLocatorProvider& locator)
+{
+	const int priority = locator.getPriority();
+	auto& db = locator.getAssetDatabase();
+	for (auto type: db.getTypes()) {
+		auto& byName = assetIndex[int(type)];
+		for (auto& name: db.getDatabase(type).getNames()) {
+			// After those of the same priority, so the first one added keeps winning
+			auto& candidates = byName[name];
+			auto pos = std::find_if(candidates.begin(), candidates.end(), [&] (const IResourceLocatorProvider* l) { return l->getPriority() < priority; });
+			candidates.insert(pos, &locator);
+		}
+	}
+}
+
+void ResourceLocator::removeFromIndex(IResourceLocatorProvider& locator)
+{
+	auto& db = locator.getAssetDatabase();
+	for (auto type: db.getTypes()) {
+		auto byName = assetIndex.find(int(type));
+		if (byName == assetIndex.end()) {
+			continue;
+		}
+		for (auto& name: db.getDatabase(type).getNames()) {
+			auto iter = byName->second.find(name);
+			if (iter != byName->second.end()) {
+				auto& candidates = iter->second;
+				candidates.erase(std::remove(candidates.begin(), candidates.end(), &locator), candidates.end());
+				if (candidates.empty()) {
+					byName->second.erase(iter);
+				}
+			}
+		}
+	}
+}
+
+void ResourceLocator::purge(IResourceLocatorProvider& locator)
+{
+	// Its assets might be different once it's reloaded
+	removeFromIndex(locator);
+	locator.purge(system);
+	addToIndex(locator);
+}
+
+IResourceLocatorProvider* ResourceLocator::findProvider(const String& asset, AssetType type) const
+{
+	auto byName = assetIndex.find(int(type));
+	if (byName != assetIndex.end()) {
+		auto iter = byName->second.find(asset);
+		if (iter != byName->second.end()) {
+			return iter->second.front();
+		}
+	}
+	return nullptr;
 }
 
 std::unique_ptr<ResourceData> ResourceLocator::getResource(const String& asset, AssetType type, bool stream)
 {
-	auto result = locators.find(asset);
-	if (result != locators.end()) {
-		auto data = result->second->getData(asset, type, stream);
+	if (auto locator = findProvider(asset, type)) {
+		auto data = locator->getData(asset, type, stream);
 		if (data) {
 			return data;
 		} else {
@@ -65,24 +143,29 @@ std::unique_ptr<ResourceDataStream> ResourceLocator::getStream(const String& ass
 
 void ResourceLocator::purge(const String& asset, AssetType type)
 {
-	auto result = locators.find(asset);
-	if (result != locators.end()) {
+	if (auto locator = findProvider(asset, type)) {
 		// Found the locator for this file, purge it
-		result->second->purge(system);
+		purge(*locator);
 	} else {
 		// Couldn't find a locator (new file?), purge everything
 		for (auto& l: locatorList) {
 			l->purge(system);
 		}
+		assetIndex.clear();
+		for (auto& l: locatorList) {
+			addToIndex(*l);
+		}
 	}
 }
 
 std::vector<String> ResourceLocator::enumerate(const AssetType type)
 {
 	std::vector<String> result;
-	for (auto& l: locatorList) {
-		for (auto& r: l->getAssetDatabase().enumerate(type)) {
-			result.push_back(std::move(r));
+	auto byName = assetIndex.find(int(type));
+	if (byName != assetIndex.end()) {
+		result.reserve(byName->second.size());
+		for (auto& a: byName->second) {
+			result.push_back(a.first);
 		}
 	}
 	return result;
@@ -93,11 +176,24 @@ void ResourceLocator::addFileSystem(const Path& path)
 	add(std::make_unique<FileSystemResourceLocator>(system, path));
 }
 
-void ResourceLocator::addPack(const Path& path, const String& encryptionKey, bool preLoad, bool allowFailure)
+void ResourceLocator::addPack(const Path& path, const String& encryptionKey, bool preLoad, bool allowFailure, bool memoryMap)
 {
+	if (memoryMap) {
+		auto mappedFile = OS::get().mapFile(path);
+		if (mappedFile) {
+			auto pack = std::make_unique<PackResourceLocator>(std::move(mappedFile), path, encryptionKey);
+			packs[path.string()] = pack.get();
+			add(std::move(pack));
+			return;
+		}
+		Logger::logWarning("Unable to memory map resource pack \"" + path.string() + "\", reading it instead.");
+	}
+
 	auto dataReader = system.getDataReader(path.string());
 	if (dataReader) {
-		add(std::make_unique<PackResourceLocator>(std::move(dataReader), path, encryptionKey, preLoad));
+		auto pack = std::make_unique<PackResourceLocator>(std::move(dataReader), path, encryptionKey, preLoad);
+		packs[path.string()] = pack.get();
+		add(std::move(pack));
 	} else {
 		if (allowFailure) {
 			Logger::logWarning("Resource pack not found: \"" + path.string() + "\"");
@@ -109,15 +205,39 @@ void ResourceLocator::addPack(const Path& path, const String& encryptionKey, boo
 
 const Metadata& ResourceLocator::getMetaData(const String& asset, AssetType type) const
 {
-	auto result = locators.find(asset);
-	if (result != locators.end()) {
-		return result->second->getAssetDatabase().getDatabase(type).get(asset).meta;
-	} else {
+	const auto entry = findEntry(asset, type);
+	if (!entry) {
 		throw Exception("Unable to locate resource: " + asset, HalleyExceptions::Resources);
 	}
+	return entry->meta;
+}
+
+const std::vector<std::pair<AssetType, String>>& ResourceLocator::getDependencies(const String& asset, AssetType type) const
+{
+	static const std::vector<std::pair<AssetType, String>> none;
+	const auto entry = findEntry(asset, type);
+	return entry ? entry->dependencies : none;
 }
 
 bool ResourceLocator::exists(const String& asset)
 {
-	return locators.find(asset) != locators.end();
+	for (auto& byName: assetIndex) {
+		if (byName.second.find(asset) != byName.second.end()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ResourceLocator::exists(const String& asset, AssetType type) const
+{
+	return findEntry(asset, type) != nullptr;
+}
+
+const AssetDatabase::Entry* ResourceLocator::findEntry(const String& asset, AssetType type) const
+{
+	if (auto locator = findProvider(asset, type)) {
+		return locator->getAssetDatabase().getDatabase(type).tryGet(asset);
+	}
+	return nullptr;
 }
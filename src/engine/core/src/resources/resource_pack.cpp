@@ -2,6 +2,7 @@
 #include <utility>
 #include "resources/asset_pack.h"
 #include "api/system_api.h"
+#include "halley/os/os.h"
 using namespace Halley;
 
 PackResourceLocator::PackResourceLocator(std::unique_ptr<ResourceDataReader> reader, Path path, String key, bool preLoad)
@@ -12,6 +13,15 @@ PackResourceLocator::PackResourceLocator(std::unique_ptr<ResourceDataReader> rea
 	assetPack = std::make_unique<AssetPack>(std::move(reader), encryptionKey, preLoad);
 }
 
+PackResourceLocator::PackResourceLocator(std::unique_ptr<MemoryMappedFile> mappedFile, Path path, String key)
+	: path(std::move(path))
+	, encryptionKey(std::move(key))
+	, preLoad(false)
+	, memoryMapped(true)
+{
+	assetPack = std::make_unique<AssetPack>(std::move(mappedFile), encryptionKey);
+}
+
 PackResourceLocator::~PackResourceLocator()
 {
 }
@@ -40,5 +50,12 @@ void PackResourceLocator::purge(SystemAPI& sys)
 
 void PackResourceLocator::loadAfterPurge()
 {
+	if (memoryMapped) {
+		auto mappedFile = OS::get().mapFile(path);
+		if (mappedFile) {
+			assetPack = std::make_unique<AssetPack>(std::move(mappedFile), encryptionKey);
+			return;
+		}
+	}
 	assetPack = std::make_unique<AssetPack>(system->getDataReader(path.string()), encryptionKey, preLoad);
 }
@@ -6,10 +6,12 @@
 namespace Halley {
 	class SystemAPI;
 	class AssetPack;
+	class MemoryMappedFile;
 
 	class PackResourceLocator : public IResourceLocatorProvider {
 	public:
 		explicit PackResourceLocator(std::unique_ptr<ResourceDataReader> reader, Path path, String encryptionKey = "", bool preLoad = false);
+		explicit PackResourceLocator(std::unique_ptr<MemoryMappedFile> mappedFile, Path path, String encryptionKey = "");
 		~PackResourceLocator();
 
 	protected:
@@ -25,6 +27,7 @@ namespace Halley {
 		Path path;
 		String encryptionKey; // :(
 		bool preLoad;
+		bool memoryMapped = false;
 		SystemAPI* system = nullptr;
 	};
 }
@@ -0,0 +1,244 @@
+#include "resources/resource_streamer.h"
+#include <algorithm>
+#include <halley/concurrency/concurrent.h>
+#include <halley/resources/metadata.h>
+#include <halley/support/profiler.h>
+#include <halley/text/string_converter.h>
+
+using namespace Halley;
+
+ResourceStreamRequest::ResourceStreamRequest(ResourceCollectionBase& collection, AssetType type, const String& assetId, ResourceLoadPriority priority, std::chrono::steady_clock::time_point deadline, uint64_t sequence, bool prefetch)
+	: collection(collection)
+	, type(type)
+	, assetId(assetId)
+	, priority(priority)
+	, deadline(deadline)
+	, sequence(sequence)
+	, prefetch(prefetch)
+	, state(State::Queued)
+{
+}
+
+ResourceStreamer::ResourceStreamer(IResourceLocator& locator)
+	: locator(locator)
+{
+}
+
+ResourceStreamer::~ResourceStreamer()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	stopping = true;
+	queue.clear();
+	fetchDone.wait(lock, [&] () { return activeWorkers == 0; });
+}
+
+std::shared_ptr<ResourceStreamRequest> ResourceStreamer::request(ResourceCollectionBase& collection, AssetType type, const String& assetId, ResourceLoadPriority priority, Time deadline, bool prefetch)
+{
+	const auto deadlineTime = deadline > 0
+		? std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<Time>(deadline))
+		: std::chrono::steady_clock::time_point::max();
+	const auto key = makeKey(type, assetId);
+
+	size_t nWorkers = 0;
+	std::shared_ptr<ResourceStreamRequest> result;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		auto iter = inFlight.find(key);
+		if (iter != inFlight.end()) {
+			result = iter->second;
+			if (result->getState() == ResourceStreamRequest::State::Queued && (priority > result->priority || deadlineTime < result->deadline)) {
+				result->priority = std::max(priority, result->priority);
+				result->deadline = std::min(deadlineTime, result->deadline);
+				std::make_heap(queue.begin(), queue.end(), &isLessUrgent);
+			}
+			return result;
+		}
+
+		result = std::make_shared<ResourceStreamRequest>(collection, type, assetId, priority, deadlineTime, nextSequence++, prefetch);
+		inFlight[key] = result;
+		queue.push_back(result);
+		std::push_heap(queue.begin(), queue.end(), &isLessUrgent);
+		nWorkers = reserveWorkers();
+	}
+
+	startWorkers(nWorkers);
+	return result;
+}
+
+std::shared_ptr<ResourceStreamRequest> ResourceStreamer::find(AssetType type, const String& assetId) const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	auto iter = inFlight.find(makeKey(type, assetId));
+	if (iter != inFlight.end()) {
+		return iter->second;
+	}
+	return {};
+}
+
+void ResourceStreamer::waitForFetch(ResourceStreamRequest& request)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	if (request.getState() == ResourceStreamRequest::State::Queued) {
+		// Nobody picked it up yet, so don't wait behind everything else
+		auto iter = std::find_if(queue.begin(), queue.end(), [&] (const std::shared_ptr<ResourceStreamRequest>& r) { return r.get() == &request; });
+		Expects(iter != queue.end());
+		auto req = *iter;
+		queue.erase(iter);
+		std::make_heap(queue.begin(), queue.end(), &isLessUrgent);
+		req->state.store(ResourceStreamRequest::State::Fetching, std::memory_order_release);
+
+		lock.unlock();
+		fetch(*req);
+		lock.lock();
+		onFetched(req);
+	} else {
+		fetchDone.wait(lock, [&] () { return request.getState() != ResourceStreamRequest::State::Fetching; });
+	}
+}
+
+Vector<std::shared_ptr<ResourceStreamRequest>> ResourceStreamer::getFetched() const
+{
+	Vector<std::shared_ptr<ResourceStreamRequest>> result;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		result = fetched;
+	}
+	std::sort(result.begin(), result.end(), [] (const std::shared_ptr<ResourceStreamRequest>& a, const std::shared_ptr<ResourceStreamRequest>& b)
+	{
+		return isLessUrgent(b, a);
+	});
+	return result;
+}
+
+void ResourceStreamer::complete(ResourceStreamRequest& request)
+{
+	size_t nWorkers = 0;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		fetched.erase(std::remove_if(fetched.begin(), fetched.end(), [&] (const std::shared_ptr<ResourceStreamRequest>& r) { return r.get() == &request; }), fetched.end());
+		inFlight.erase(makeKey(request.type, request.assetId));
+		bytesStaged -= request.dataSize;
+		request.dataSize = 0;
+		request.data.reset();
+		request.state.store(ResourceStreamRequest::State::Done, std::memory_order_release);
+
+		// Freeing budget might let paused workers carry on
+		nWorkers = reserveWorkers();
+	}
+	startWorkers(nWorkers);
+}
+
+void ResourceStreamer::setMemoryBudget(size_t bytes)
+{
+	size_t nWorkers = 0;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		memoryBudget = bytes;
+		nWorkers = reserveWorkers();
+	}
+	startWorkers(nWorkers);
+}
+
+void ResourceStreamer::setMaxConcurrentFetches(size_t n)
+{
+	Expects(n > 0);
+	size_t nWorkers = 0;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		maxWorkers = n;
+		nWorkers = reserveWorkers();
+	}
+	startWorkers(nWorkers);
+}
+
+size_t ResourceStreamer::getBytesStaged() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return bytesStaged;
+}
+
+size_t ResourceStreamer::getNumInFlight() const
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	return inFlight.size();
+}
+
+String ResourceStreamer::makeKey(AssetType type, const String& assetId)
+{
+	return toString(int(type)) + ":" + assetId;
+}
+
+bool ResourceStreamer::isLessUrgent(const std::shared_ptr<ResourceStreamRequest>& a, const std::shared_ptr<ResourceStreamRequest>& b)
+{
+	if (a->priority != b->priority) {
+		return a->priority < b->priority;
+	}
+	if (a->deadline != b->deadline) {
+		return a->deadline > b->deadline;
+	}
+	return a->sequence > b->sequence;
+}
+
+size_t ResourceStreamer::reserveWorkers()
+{
+	// Called with the mutex held; workers are only started once it's released, in case the executor runs them inline
+	size_t n = 0;
+	const size_t pending = queue.size();
+	while (!stopping && activeWorkers < maxWorkers && n < pending && bytesStaged < memoryBudget) {
+		++activeWorkers;
+		++n;
+	}
+	return n;
+}
+
+void ResourceStreamer::startWorkers(size_t n)
+{
+	for (size_t i = 0; i < n; ++i) {
+		Concurrent::executeDetached(Executors::getDiskIO(), [this] () { runWorker(); });
+	}
+}
+
+void ResourceStreamer::runWorker()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	// Requests are picked when a worker is free rather than when they're queued, so later urgent ones overtake
+	while (!stopping && !queue.empty() && bytesStaged < memoryBudget) {
+		std::pop_heap(queue.begin(), queue.end(), &isLessUrgent);
+		auto req = std::move(queue.back());
+		queue.pop_back();
+		req->state.store(ResourceStreamRequest::State::Fetching, std::memory_order_release);
+
+		lock.unlock();
+		fetch(*req);
+		lock.lock();
+		onFetched(req);
+	}
+
+	--activeWorkers;
+	fetchDone.notify_all();
+}
+
+void ResourceStreamer::fetch(ResourceStreamRequest& request)
+{
+	if (!request.prefetch) {
+		// Constructed the usual way on the main thread (e.g. streamed or custom-loaded resources)
+		return;
+	}
+
+	HALLEY_PROFILE_SCOPE_DETAIL("ResourceStreamer::fetch", request.assetId);
+	try {
+		auto& meta = locator.getMetaData(request.assetId, request.type);
+		request.data = ResourceLoader::fetchStatic(locator, request.assetId, request.type, meta);
+		request.dataSize = request.data ? request.data->getSize() : 0;
+	} catch (...) {
+		request.error = std::current_exception();
+	}
+}
+
+void ResourceStreamer::onFetched(const std::shared_ptr<ResourceStreamRequest>& request)
+{
+	request->state.store(ResourceStreamRequest::State::Fetched, std::memory_order_release);
+	bytesStaged += request->dataSize;
+	fetched.push_back(request);
+	fetchDone.notify_all();
+}
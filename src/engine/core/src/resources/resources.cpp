@@ -1,12 +1,195 @@
 #include "resources/resources.h"
 #include "resources/resource_locator.h"
 #include "api/halley_api.h"
+#include "halley/support/logger.h"
+#include "halley/support/profiler.h"
+#include "halley/file/path.h"
+#include <chrono>
+#include <algorithm>
 
 using namespace Halley;
 
 Resources::Resources(std::unique_ptr<ResourceLocator> locator, const HalleyAPI* api)
 	: locator(std::move(locator))
 	, api(api)
-{}
+	, streamer(std::make_unique<ResourceStreamer>(*this->locator))
+{
+	Telemetry::addSource(*this);
+}
 
-Resources::~Resources() = default;
+Resources::~Resources()
+{
+	Telemetry::removeSource(*this);
+	destructor.flush();
+}
+
+void Resources::throwTypeNotInitialized(AssetType type) const
+{
+	// Most likely a dedicated server asking for something that only a client could load
+	throw Exception("Resources of type " + toString(type) + " are not available.", HalleyExceptions::Resources);
+}
+
+bool ResourcePrefetch::isDone() const
+{
+	return std::all_of(entries.begin(), entries.end(), [] (const Entry& e) { return !e.request || e.request->isDone(); });
+}
+
+float ResourcePrefetch::getProgress() const
+{
+	if (entries.empty()) {
+		return 1.0f;
+	}
+	const auto done = std::count_if(entries.begin(), entries.end(), [] (const Entry& e) { return !e.request || e.request->isDone(); });
+	return float(done) / float(entries.size());
+}
+
+std::shared_ptr<Resource> ResourcePrefetch::getResource(AssetType type, const String& assetId) const
+{
+	for (auto& e: entries) {
+		if (e.type == type && e.assetId == assetId) {
+			if (e.resource) {
+				return e.resource;
+			}
+			Expects(e.request->isDone());
+			return e.request->result;
+		}
+	}
+	return {};
+}
+
+ResourcePrefetch Resources::prefetch(const Vector<std::pair<AssetType, String>>& assets, ResourceLoadPriority priority, Time deadline)
+{
+	ResourcePrefetch result;
+	std::set<std::pair<AssetType, String>> visited;
+	for (auto& asset: assets) {
+		addToPrefetch(asset.first, asset.second, priority, deadline, visited, result);
+	}
+	return result;
+}
+
+void Resources::addToPrefetch(AssetType type, const String& assetId, ResourceLoadPriority priority, Time deadline, std::set<std::pair<AssetType, String>>& visited, ResourcePrefetch& result)
+{
+	if (!visited.insert(std::make_pair(type, assetId)).second) {
+		return;
+	}
+
+	// Dependencies can name assets that aren't there, e.g. shaders for other video APIs
+	const auto id = size_t(type);
+	if (id >= resources.size() || !resources[id] || !locator->exists(assetId, type)) {
+		return;
+	}
+
+	// Dependencies first, so they come out of the streamer ahead of this, all else being equal
+	for (auto& dep: locator->getDependencies(assetId, type)) {
+		addToPrefetch(dep.first, dep.second, priority, deadline, visited, result);
+	}
+
+	ResourcePrefetch::Entry entry;
+	entry.type = type;
+	entry.assetId = assetId;
+	entry.resource = resources[id]->doGetAsync(assetId, priority, deadline, entry.request);
+	result.entries.push_back(std::move(entry));
+}
+
+void Resources::startAccessTrace()
+{
+	accessTrace = std::make_unique<AccessTrace>();
+}
+
+Vector<String> Resources::stopAccessTrace()
+{
+	Vector<String> result;
+	if (accessTrace) {
+		result = std::move(accessTrace->order);
+		accessTrace.reset();
+	}
+	return result;
+}
+
+void Resources::stopAccessTrace(const Path& path)
+{
+	String text;
+	for (auto& key: stopAccessTrace()) {
+		text += key + "\n";
+	}
+	Path::writeFile(path, Bytes(text.cppStr().begin(), text.cppStr().end()));
+}
+
+void Resources::recordAccess(AssetType type, StringView assetId)
+{
+	auto key = std::make_pair(type, String(assetId));
+	if (accessTrace->seen.find(key) == accessTrace->seen.end()) {
+		accessTrace->order.push_back(toString(type) + ":" + key.second);
+		accessTrace->seen.insert(std::move(key));
+	}
+}
+
+void Resources::setDestructionBudget(Time maxTime)
+{
+	destructionBudget = maxTime;
+}
+
+void Resources::update(Time maxTime)
+{
+	HALLEY_PROFILE_SCOPE("Resources::update");
+
+	++curFrame;
+	for (auto& collection: resources) {
+		if (collection && collection->getMemoryBudget() > 0) {
+			collection->evict(collection->getMemoryBudget());
+		}
+	}
+
+	destructor.update(destructionBudget);
+
+	auto fetched = streamer->getFetched();
+	const auto start = std::chrono::steady_clock::now();
+	for (auto& request: fetched) {
+		try {
+			request->collection.finishStreaming(*request);
+		} catch (std::exception& e) {
+			Logger::logError("Error while streaming " + request->getAssetId() + ": " + e.what());
+		} catch (...) {
+			Logger::logError("Unknown error while streaming " + request->getAssetId());
+		}
+
+		if (std::chrono::duration<Time>(std::chrono::steady_clock::now() - start).count() >= maxTime) {
+			break;
+		}
+	}
+}
+
+void Resources::setMemoryBudget(AssetType type, size_t bytes)
+{
+	ofType(type).setMemoryBudget(bytes);
+}
+
+size_t Resources::getResidentBytes(AssetType type) const
+{
+	return ofType(type).getResidentBytes();
+}
+
+void Resources::getTelemetry(std::vector<TelemetryValue>& values) const
+{
+	size_t totalBytes = 0;
+	for (size_t i = 0; i < resources.size(); ++i) {
+		if (const auto& collection = resources[i]) {
+			const String prefix = "resources." + toString(AssetType(i));
+			values.emplace_back(prefix + ".count", double(collection->getNumResident()));
+			values.emplace_back(prefix + ".bytes", double(collection->getResidentBytes()));
+			totalBytes += collection->getResidentBytes();
+		}
+	}
+	values.emplace_back("resources.bytes", double(totalBytes));
+}
+
+size_t Resources::getResidentBytes() const
+{
+	size_t total = 0;
+	for (auto& collection: resources) {
+		if (collection) {
+			total += collection->getResidentBytes();
+		}
+	}
+	return total;
+}
@@ -12,11 +12,20 @@
 #include "halley/audio/audio_event.h"
 #include "halley/file_formats/binary_file.h"
 #include "halley/file_formats/image.h"
+#include "halley/text/string_table.h"
 
 using namespace Halley;
 
-void StandardResources::initialize(Resources& resources)
+void StandardResources::initialize(Resources& resources, bool dataOnly)
 {
+	resources.init<BinaryFile>();
+	resources.init<TextFile>();
+	resources.init<ConfigFile>();
+	resources.init<StringTable>();
+	if (dataOnly) {
+		return;
+	}
+
 	resources.init<Animation>();
 	resources.init<SpriteSheet>();
 	resources.init<SpriteResource>();
@@ -24,10 +33,7 @@ void StandardResources::initialize(Resources& resources)
 	resources.init<Image>();
 	resources.init<MaterialDefinition>();
 	resources.init<ShaderFile>();
-	resources.init<BinaryFile>();
-	resources.init<TextFile>();
 	resources.init<Font>();
-	resources.init<ConfigFile>();
 	resources.init<AudioClip>();
 	resources.init<AudioEvent>();
 
@@ -3,14 +3,28 @@
 #include <halley/entity/system.h>
 #include "halley/file_formats/config_file.h"
 #include "game/game.h"
+#include "resources/resources.h"
 using namespace Halley;
 
 std::unique_ptr<World> EntityStage::createWorld(String configName, std::function<std::unique_ptr<System>(String)> createFunction)
 {
-	auto world = std::make_unique<World>(&getAPI(), getGame().isDevMode());
-
-	auto config = getResource<ConfigFile>(configName);
-	world->loadSystems(getResource<ConfigFile>(configName)->getRoot(), createFunction);
+	return createWorld(*getResource<ConfigFile>(configName), createFunction);
+}
 
+std::unique_ptr<World> EntityStage::createWorld(const ConfigFile& config, std::function<std::unique_ptr<System>(String)> createFunction)
+{
+	auto world = std::make_unique<World>(&getAPI(), getGame().isDevMode());
+	world->loadSystems(config.getRoot(), createFunction, !getCoreAPI().isDedicatedServer());
 	return world;
 }
+
+void EntityStage::destroyWorldDeferred(std::unique_ptr<World> world)
+{
+	if (world) {
+		std::shared_ptr<World> w = std::move(world);
+		getResources().getDeferredDestructor().destroyIncrementally([w] (Time maxTime)
+		{
+			return w->destroyIncrementally(maxTime);
+		});
+	}
+}
@@ -0,0 +1,65 @@
+#include "stage/hot_reload_state.h"
+#include <halley/entity/world.h>
+#include <halley/entity/type_deleter.h>
+#include "halley/support/logger.h"
+#include "halley/text/string_converter.h"
+
+using namespace Halley;
+
+namespace {
+	Vector<size_t> getComponentSizes()
+	{
+		Vector<size_t> result;
+		if (auto deleters = ComponentDeleterTable::getDeleters()) {
+			result.reserve(deleters->size());
+			for (auto& d: *deleters) {
+				result.push_back(d ? d->getSize() : 0);
+			}
+		}
+		return result;
+	}
+}
+
+void HotReloadState::saveWorld(const String& key, World& world)
+{
+	auto& saved = worlds[key];
+	world.saveSnapshot(saved.snapshot);
+	saved.componentSizes = getComponentSizes();
+}
+
+bool HotReloadState::loadWorld(const String& key, World& world) const
+{
+	auto iter = worlds.find(key);
+	if (iter == worlds.end()) {
+		return false;
+	}
+	auto& saved = iter->second;
+
+	// Deleters live on from before the reload, patched to the new code, so they report the new sizes
+	const auto sizes = getComponentSizes();
+	for (size_t i = 0; i < saved.componentSizes.size() && i < sizes.size(); ++i) {
+		if (saved.componentSizes[i] != 0 && sizes[i] != 0 && saved.componentSizes[i] != sizes[i]) {
+			Logger::logWarning("Not restoring world \"" + key + "\" after reload, as component #" + toString(i) + " changed size from " + toString(saved.componentSizes[i]) + " to " + toString(sizes[i]) + " bytes.");
+			return false;
+		}
+	}
+
+	try {
+		world.loadSnapshot(saved.snapshot);
+	} catch (std::exception& e) {
+		Logger::logWarning("Not restoring world \"" + key + "\" after reload: " + e.what());
+		return false;
+	}
+	return true;
+}
+
+void HotReloadState::setData(const String& key, Bytes bytes)
+{
+	data[key] = std::move(bytes);
+}
+
+const Bytes* HotReloadState::getData(const String& key) const
+{
+	auto iter = data.find(key);
+	return iter != data.end() ? &iter->second : nullptr;
+}
@@ -6,6 +6,9 @@
 #include <halley/entity/world.h>
 #include <halley/entity/system.h>
 #include "halley/text/string_converter.h"
+#include "halley/runner/frame_pacer.h"
+#include "halley/support/logger.h"
+#include <algorithm>
 
 using namespace Halley;
 
@@ -17,7 +20,16 @@ WorldStatsView::WorldStatsView(CoreAPI& coreAPI)
 
 void WorldStatsView::draw(RenderContext& context)
 {
+	updateTracking();
+	checkSpike();
+
 	context.bind([&] (Painter& painter) {
+		if (!spikeReport.isEmpty()) {
+			text.setColour(Colour(1.0f, 0.5f, 0.4f)).setAlignment(0).setText(spikeReport).setPosition(Vector2f(20, 20)).draw(painter);
+			text.setColour(Colour(1, 1, 1));
+			return;
+		}
+
 		int64_t grandTotal = 0;
 
 		TimeLine timelines[] = { TimeLine::FixedUpdate, TimeLine::VariableUpdate, TimeLine::Render };
@@ -25,14 +37,19 @@ void WorldStatsView::draw(RenderContext& context)
 		int i = 0;
 		float width = (float(context.getCamera().getActiveViewPort().getWidth()) - 40.0f) / 3.0f;
 
-		auto drawStats = [&] (String name, int nEntities, int64_t time, Vector2f& basePos)
+		auto drawStats = [&] (String name, int nEntities, int64_t time, Vector2f& basePos, const RollingStats* history = nullptr)
 		{
 			text.setText(name).setAlignment(0).setPosition(basePos + Vector2f(10, 0)).draw(painter);
 			text.setAlignment(1);
 			if (nEntities > 0) {
-				text.setText(toString(nEntities)).setPosition(basePos + Vector2f(width - 120, 0)).draw(painter);
+				text.setText(toString(nEntities)).setPosition(basePos + Vector2f(width - 250, 0)).draw(painter);
+			}
+			text.setText(formatTime(time)).setPosition(basePos + Vector2f(width - 190, 0)).draw(painter);
+			if (history && history->getNumSamples() > 0) {
+				text.setText(formatTime(history->getPercentile(0.5f))).setPosition(basePos + Vector2f(width - 130, 0)).draw(painter);
+				text.setText(formatTime(history->getPercentile(0.95f))).setPosition(basePos + Vector2f(width - 70, 0)).draw(painter);
+				text.setText(formatTime(history->getMax())).setPosition(basePos + Vector2f(width - 10, 0)).draw(painter);
 			}
-			text.setText(formatTime(time)).setPosition(basePos + Vector2f(width - 50, 0)).draw(painter);
 			text.setAlignment(0);
 			basePos.y += 20;
 		};
@@ -44,6 +61,13 @@ void WorldStatsView::draw(RenderContext& context)
 
 			Vector2f pos = Vector2f(20 + (i++) * width, 60);
 			text.setColour(Colour(0.2f, 1.0f, 0.3f)).setText(String(timelineLabels[int(timeline)]) + ": ").setPosition(pos).draw(painter);
+			text.setColour(Colour(0.6f, 0.6f, 0.6f));
+			text.setAlignment(1);
+			const char* columns[] = { "avg", "p50", "p95", "max" };
+			for (int c = 0; c < 4; ++c) {
+				text.setText(columns[c]).setPosition(pos + Vector2f(width - 190 + 60 * c, 0)).draw(painter);
+			}
+			text.setAlignment(0);
 			text.setColour(Colour(1, 1, 1));
 			pos.y += 20;
 
@@ -56,11 +80,12 @@ void WorldStatsView::draw(RenderContext& context)
 					int64_t ns = system->getNanoSecondsTakenAvg();
 					sysTotal += ns;
 
-					drawStats(name, int(system->getEntityCount()), ns, pos);
+					drawStats(name, int(system->getEntityCount()), ns, pos, &system->getTimeHistory());
 				}
 
 				text.setColour(Colour(0.8f, 0.8f, 0.8f));
 				drawStats("[World]", 0, worldTotal - sysTotal, pos);
+				drawStats("[World total]", 0, worldTotal, pos, &world->getTimeHistory(timeline));
 			}
 
 			drawStats("[Game]", 0, gameTotal - worldTotal, pos);
@@ -74,17 +99,165 @@ void WorldStatsView::draw(RenderContext& context)
 			drawStats("[Engine]", 0, total - gameTotal - vsyncTime, pos);
 			text.setColour(Colour(0.8f, 1.0f, 0.8f));
 			drawStats("Total", world ? int(world->numEntities()) : 0, total, pos);
+
+			if (timeline == TimeLine::Render && !coreAPI.getIdleTasks().empty()) {
+				// Not part of the total, it only uses time left in the frame
+				text.setColour(Colour(0.8f, 0.8f, 0.8f));
+				drawStats("[Idle]", 0, coreAPI.getTime(CoreAPITimer::Idle, TimeLine::Render, StopwatchAveraging::Mode::Average), pos);
+				for (auto task: coreAPI.getIdleTasks()) {
+					auto stats = task->getIdleStats();
+					if (!stats.isEmpty()) {
+						text.setText(stats).setPosition(pos + Vector2f(10, 0)).draw(painter);
+						pos.y += 20;
+					}
+				}
+			}
+		}
+
+		String pacing;
+		if (auto pacer = coreAPI.getFramePacer()) {
+			const auto& stats = pacer->getStats();
+			pacing = " Frame time " + formatTime(int64_t(stats.averageFrameTime * 1'000'000'000.0)) + " ms +/- " + formatTime(int64_t(stats.frameTimeDeviation * 1'000'000'000.0))
+				+ " (max " + formatTime(int64_t(stats.maxFrameTime * 1'000'000'000.0)) + "), time dilation " + toString(int(lround(stats.timeDilation * 100))) + "%.";
+		}
+
+		// A few frames old, as that's when the GPU's timestamps come back; only the frame and its outermost scopes are listed
+		String gpu;
+		const auto gpuTimings = painter.getPrevGPUTimings();
+		if (!gpuTimings.empty()) {
+			gpu = "\nGPU: " + formatTime(gpuTimings[0].elapsedNs) + " ms";
+			String separator = " (";
+			for (size_t j = 1; j < gpuTimings.size(); ++j) {
+				if (gpuTimings[j].depth == 1) {
+					gpu += separator + gpuTimings[j].name + " " + formatTime(gpuTimings[j].elapsedNs);
+					separator = ", ";
+				}
+			}
+			if (separator != " (") {
+				gpu += ")";
+			}
+			gpu += ".";
 		}
 
 		int maxFPS = int(lround(1'000'000'000.0 / grandTotal));
 		text
 			.setColour(Colour(1, 1, 1))
-			.setText("Total elapsed: " + formatTime(grandTotal) + " ms [" + toString(maxFPS) + " FPS maximum].\n" + toString(painter.getPrevDrawCalls()) + " draw calls, " + toString(painter.getPrevTriangles()) + " triangles, " + toString(painter.getPrevVertices()) + " vertices.")
+			.setText("Total elapsed: " + formatTime(grandTotal) + " ms [" + toString(maxFPS) + " FPS maximum]." + pacing + "\n" + toString(painter.getPrevDrawCalls()) + " draw calls, " + toString(painter.getPrevTriangles()) + " triangles, " + toString(painter.getPrevVertices()) + " vertices, " + toString(painter.getPrevElidedStateChanges()) + " redundant state changes skipped." + gpu)
 			.setPosition(Vector2f(20, 20))
 			.draw(painter);
+
+		if (world) {
+			// Biggest families, with the most they've held recently
+			auto& families = world->getFamilies();
+			Vector<size_t> order(families.size());
+			for (size_t j = 0; j < order.size(); ++j) {
+				order[j] = j;
+			}
+			std::sort(order.begin(), order.end(), [&] (size_t a, size_t b) { return families[a]->count() > families[b]->count(); });
+			order.resize(std::min(order.size(), maxFamiliesListed));
+
+			String familyText = "Entities: " + toString(world->numEntities()) + " (p95 " + toString(entityCount.getPercentile(0.95f)) + ", max " + toString(entityCount.getMax()) + ")";
+			for (auto j: order) {
+				familyText += "\nFamily #" + toString(j) + " [" + toString(families[j]->getComponentCount()) + " components]: " + toString(families[j]->count()) + " (peak " + toString(familyPeaks[j]) + ")";
+			}
+			const auto viewPort = context.getCamera().getActiveViewPort();
+			text.setText(familyText).setOffset(Vector2f(0, 1)).setPosition(Vector2f(20, float(viewPort.getHeight()) - 20)).draw(painter);
+			text.setOffset(Vector2f(0, 0));
+		}
 	});
 }
 
+void WorldStatsView::setSpikeTrigger(Time budget)
+{
+	spikeBudgetNs = int64_t(budget * 1'000'000'000.0);
+	framesUntilArmed = armDelayFrames;
+}
+
+bool WorldStatsView::hasSpike() const
+{
+	return !spikeReport.isEmpty();
+}
+
+void WorldStatsView::clearSpike()
+{
+	spikeReport = "";
+	framesUntilArmed = armDelayFrames;
+}
+
+void WorldStatsView::updateTracking()
+{
+	if (!world) {
+		return;
+	}
+
+	entityCount.add(int64_t(world->numEntities()));
+
+	auto& families = world->getFamilies();
+	familyPeaks.resize(families.size(), 0);
+	for (size_t i = 0; i < families.size(); ++i) {
+		familyPeaks[i] = std::max(familyPeaks[i], families[i]->count());
+	}
+}
+
+void WorldStatsView::checkSpike()
+{
+	if (spikeBudgetNs <= 0 || hasSpike()) {
+		return;
+	}
+	if (framesUntilArmed > 0) {
+		--framesUntilArmed;
+		return;
+	}
+
+	// The render timeline of this frame is still in progress, so this is all about the previous one
+	int64_t frameNs = 0;
+	for (int i = 0; i < int(TimeLine::NUMBER_OF_TIMELINES); ++i) {
+		frameNs += coreAPI.getTime(CoreAPITimer::Engine, TimeLine(i), StopwatchAveraging::Mode::Latest);
+	}
+	frameNs -= coreAPI.getTime(CoreAPITimer::Vsync, TimeLine::Render, StopwatchAveraging::Mode::Latest);
+
+	if (frameNs > spikeBudgetNs) {
+		spikeReport = describeFrame(frameNs);
+		Logger::logWarning(spikeReport);
+	}
+}
+
+String WorldStatsView::describeFrame(int64_t frameNs) const
+{
+	String result = "Frame spike: " + formatTime(frameNs) + " ms, over the budget of " + formatTime(spikeBudgetNs) + " ms.";
+
+	TimeLine timelines[] = { TimeLine::FixedUpdate, TimeLine::VariableUpdate, TimeLine::Render };
+	String timelineLabels[] = { "Fixed", "Variable", "Render" };
+	for (auto timeline: timelines) {
+		const int64_t engine = coreAPI.getTime(CoreAPITimer::Engine, timeline, StopwatchAveraging::Mode::Latest);
+		const int64_t game = coreAPI.getTime(CoreAPITimer::Game, timeline, StopwatchAveraging::Mode::Latest);
+		result += "\n\n" + timelineLabels[int(timeline)] + ": " + formatTime(engine) + " ms engine, " + formatTime(game) + " ms game";
+		if (timeline == TimeLine::Render) {
+			result += ", " + formatTime(coreAPI.getTime(CoreAPITimer::Vsync, TimeLine::Render, StopwatchAveraging::Mode::Latest)) + " ms vsync";
+		}
+
+		if (world) {
+			const auto& b = world->getLastFrameBreakdown(timeline);
+			result += "\n  World " + formatTime(b.totalNs) + " ms: spawn " + formatTime(b.spawnNs) + ", updateEntities " + formatTime(b.updateEntitiesNs)
+				+ ", systems " + formatTime(b.systemsNs) + " (of which messages " + formatTime(b.messagesNs) + ")";
+
+			for (auto& system: world->getSystems(timeline)) {
+				auto& history = system->getTimeHistory();
+				result += "\n  " + system->getName() + ": " + formatTime(system->getNanoSecondsTaken()) + " ms";
+				if (system->getNanoSecondsInMessages() > 0) {
+					result += " (messages " + formatTime(system->getNanoSecondsInMessages()) + ")";
+				}
+				result += ", p50 " + formatTime(history.getPercentile(0.5f)) + ", p95 " + formatTime(history.getPercentile(0.95f)) + ", " + toString(system->getEntityCount()) + " entities";
+			}
+		}
+	}
+
+	if (world) {
+		result += "\n\n" + toString(world->numEntities()) + " entities.";
+	}
+	return result;
+}
+
 void WorldStatsView::setWorld(const World* w)
 {
 	world = w;
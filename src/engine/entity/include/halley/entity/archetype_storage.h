@@ -0,0 +1,82 @@
+#pragma once
+
+#include <memory>
+#include <cstdint>
+#include "family_mask.h"
+#include <halley/data_structures/vector.h>
+#include <halley/data_structures/tree_map.h>
+
+namespace Halley {
+	class Entity;
+
+	// Stores the components of up to "capacity" entities sharing the same mask, one array per component type
+	class ArchetypeChunk
+	{
+	public:
+		ArchetypeChunk(FamilyMaskType mask, size_t index, Vector<int> componentIds, uint32_t capacity);
+		~ArchetypeChunk();
+
+		ArchetypeChunk(const ArchetypeChunk& other) = delete;
+		ArchetypeChunk& operator=(const ArchetypeChunk& other) = delete;
+
+		bool isFull() const { return freeSlots.empty(); }
+		bool isEmpty() const { return freeSlots.size() == capacity; }
+		bool owns(const void* ptr) const;
+
+		FamilyMaskType getMask() const { return mask; }
+		size_t getIndex() const { return index; }
+		uint32_t getCapacity() const { return capacity; }
+		size_t getLiveCount() const { return capacity - freeSlots.size(); }
+
+		uint32_t allocSlot(Entity& owner);
+		void freeSlot(uint32_t slot);
+		Entity* getOwner(uint32_t slot) const { return owners[slot]; }
+		void* getComponent(int componentId, uint32_t slot) const;
+
+	private:
+		FamilyMaskType mask;
+		size_t index;
+		Vector<int> componentIds;
+		Vector<size_t> columnOffsets;
+		Vector<size_t> componentSizes;
+		Vector<uint32_t> freeSlots;
+		Vector<Entity*> owners;
+		std::unique_ptr<char[]> data;
+		size_t dataSize = 0;
+		uint32_t capacity;
+	};
+
+	// Moves the components of entities into chunks grouped by their family mask, so that
+	// families iterate over (mostly) contiguous memory instead of pool-allocated components
+	class ArchetypeStorage
+	{
+	public:
+		explicit ArchetypeStorage(uint32_t chunkCapacity = 128);
+		~ArchetypeStorage();
+
+		void relocate(Entity& entity);
+		// For an entity whose mask is set but has no components constructed yet; points them at a slot, for them to be constructed in
+		void allocate(Entity& entity);
+		void release(ArchetypeChunk* chunk, uint32_t slot);
+
+		// Moves entities out of the last chunks of each archetype into the gaps left in the ones before, and frees the chunks emptied,
+		// until each archetype uses as few chunks as it can. Stops after maxMoves entities; returns true if there was nothing left to move.
+		// Entities moved are added to moved, and their components must be reloaded by anything pointing to them.
+		bool compact(Vector<Entity*>& moved, size_t maxMoves);
+
+		size_t getNumChunks() const;
+
+	private:
+		struct Archetype
+		{
+			Vector<std::unique_ptr<ArchetypeChunk>> chunks;
+			size_t firstNonFull = 0;
+		};
+
+		TreeMap<FamilyMaskType, Archetype> archetypes;
+		uint32_t chunkCapacity;
+
+		ArchetypeChunk& getChunkWithSpace(Archetype& archetype, const Entity& entity);
+		void moveTo(Entity& entity, ArchetypeChunk& chunk);
+	};
+}
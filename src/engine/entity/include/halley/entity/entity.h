@@ -12,17 +12,7 @@
 namespace Halley {
 	class World;
 	class System;
-
-	class MessageEntry
-	{
-	public:
-		std::unique_ptr<Message> msg;
-		int type = -1;
-		int age = -1;
-
-		MessageEntry() {}
-		MessageEntry(std::unique_ptr<Message> msg, int type, int age) : msg(std::move(msg)), type(type), age(age) {}
-	};
+	class ArchetypeChunk;
 
 	class EntityRef;
 
@@ -31,6 +21,7 @@ namespace Halley {
 		friend class World;
 		friend class System;
 		friend class EntityRef;
+		friend class ArchetypeStorage;
 
 	public:
 		~Entity();
@@ -39,6 +30,13 @@ namespace Halley {
 		T* tryGetComponent()
 		{
 			constexpr int id = FamilyMask::RetrieveComponentIndex<T>::componentIndex;
+			if (!dirty || pristinePrefab) {
+				// Components are sorted by index whenever the mask is up to date, so the mask knows where each one is
+				const auto slot = componentSlots[id];
+				return slot != FamilyMask::noComponentSlot ? static_cast<T*>(components[slot].second) : nullptr;
+			}
+
+			// Added or removed since the last refresh
 			for (size_t i = 0; i < components.size(); i++) {
 				if (components[i].first == id) {
 					return static_cast<T*>(components[i].second);
@@ -62,7 +60,7 @@ namespace Halley {
 		bool hasComponent()
 		{
 			if (dirty) {
-				return getComponent<T>() != nullptr;
+				return tryGetComponent<T>() != nullptr;
 			} else {
 				return FamilyMask::hasBit(mask, FamilyMask::RetrieveComponentIndex<T>::componentIndex);
 			}
@@ -85,12 +83,16 @@ namespace Halley {
 
 	private:
 		Vector<std::pair<int, Component*>> components;
-		Vector<MessageEntry> inbox;
 		FamilyMaskType mask;
+		const uint8_t* componentSlots; // From mask
 		EntityId uid;
+		ArchetypeChunk* chunk = nullptr;
+		uint32_t chunkSlot = 0;
+		uint32_t worldIndex = 0;
 		int liveComponents = 0;
 		bool dirty = false;
 		bool alive = true;
+		bool pristinePrefab = false; // Instantiated and not changed since, so its mask is still the prefab's
 
 		Entity();
 
@@ -119,6 +121,7 @@ namespace Halley {
 			return *this;
 		}
 
+		void setMask(FamilyMaskType mask);
 		void addComponent(Component* component, int id);
 		void removeComponentAt(int index);
 		void deleteComponent(Component* component, int id);
@@ -138,7 +141,7 @@ namespace Halley {
 			static_assert(std::is_base_of<Component, T>::value, "Components must extend the Component class");
 			static_assert(!std::is_polymorphic<T>::value, "Components cannot be polymorphic (i.e. they can't have virtual methods)");
 			static_assert(std::is_default_constructible<T>::value, "Components must have a default constructor");
-			entity.addComponent(world, new T(std::move(component)));
+			entity.addComponent(world, ::new(PoolAllocator<T>::alloc()) T(std::move(component)));
 			return *this;
 		}
 
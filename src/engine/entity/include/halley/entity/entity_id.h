@@ -3,6 +3,7 @@
 #include <cstdint>
 #include "halley/text/halleystring.h"
 #include "halley/text/string_converter.h"
+#include "halley/bytes/byte_serializer.h"
 
 namespace Halley {
 	struct alignas(8) EntityId {
@@ -27,6 +28,16 @@ namespace Halley {
 		{
 			return Halley::toString(value);
 		}
+
+		void serialize(Serializer& s) const
+		{
+			s << value;
+		}
+
+		void deserialize(Deserializer& s)
+		{
+			s >> value;
+		}
 	};
 }
 
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <gsl/gsl>
+#include <functional>
+#include "entity_id.h"
+#include "family_binding.h"
+#include <halley/data_structures/flat_hash_map.h>
+#include <halley/data_structures/tree_map.h>
+#include <halley/data_structures/vector.h>
+
+namespace Halley {
+	// Entities by the value of a key (e.g. a team, an owner or a grid cell), so finding them doesn't take a scan of their family.
+	// Kept up to date like SpatialIndexService: sync() it with a family once per update, which only moves entities whose key changed,
+	// or set() and remove() entities as they change. Component members marked with "index" in their schema get an alias for theirs.
+	template <typename Key, typename Buckets>
+	class EntityIndex {
+	public:
+		// Makes the index match the family, with keys given by getKey(const F&).
+		// To index several families at once, call beginSync(), set() for each of their entities, and endSync().
+		template <typename F, typename G>
+		void sync(FamilyBinding<F>& family, G getKey)
+		{
+			beginSync();
+			for (auto& e: family) {
+				set(e.entityId, getKey(e));
+			}
+			endSync();
+		}
+
+		void beginSync()
+		{
+			++syncId;
+		}
+
+		void endSync() // Removes everything that wasn't set since beginSync()
+		{
+			for (auto& e: entries) {
+				if (e.second.lastSync != syncId) {
+					toRemove.push_back(e.first);
+				}
+			}
+			for (auto& id: toRemove) {
+				remove(id);
+			}
+			toRemove.clear();
+		}
+
+		void set(EntityId entity, const Key& key)
+		{
+			auto iter = entries.find(entity);
+			if (iter == entries.end()) {
+				entries[entity] = Entry{ key, addToBucket(entity, key), syncId };
+			} else {
+				auto& entry = iter->second;
+				entry.lastSync = syncId;
+				if (!(entry.key == key)) {
+					removeFromBucket(entry);
+					entry.pos = addToBucket(entity, key);
+					entry.key = key;
+				}
+			}
+		}
+
+		void remove(EntityId entity)
+		{
+			auto iter = entries.find(entity);
+			if (iter != entries.end()) {
+				removeFromBucket(iter->second);
+				entries.erase(iter);
+			}
+		}
+
+		void clear()
+		{
+			buckets.clear();
+			entries.clear();
+		}
+
+		size_t size() const
+		{
+			return entries.size();
+		}
+
+		const Key* tryGetKey(EntityId entity) const
+		{
+			auto iter = entries.find(entity);
+			return iter != entries.end() ? &iter->second.key : nullptr;
+		}
+
+		// In no particular order; only valid until the index is next changed
+		gsl::span<const EntityId> find(const Key& key) const
+		{
+			auto iter = buckets.find(key);
+			return iter != buckets.end() ? gsl::span<const EntityId>(iter->second) : gsl::span<const EntityId>();
+		}
+
+		size_t count(const Key& key) const
+		{
+			auto iter = buckets.find(key);
+			return iter != buckets.end() ? iter->second.size() : 0;
+		}
+
+	protected:
+		Buckets buckets;
+
+	private:
+		struct Entry {
+			Key key;
+			uint32_t pos; // In its bucket
+			uint32_t lastSync;
+		};
+
+		FlatHashMap<EntityId, Entry> entries;
+		Vector<EntityId> toRemove;
+		uint32_t syncId = 0;
+
+		uint32_t addToBucket(EntityId entity, const Key& key)
+		{
+			auto& ids = buckets[key];
+			ids.push_back(entity);
+			return uint32_t(ids.size() - 1);
+		}
+
+		void removeFromBucket(const Entry& entry)
+		{
+			auto iter = buckets.find(entry.key);
+			Expects(iter != buckets.end());
+			auto& ids = iter->second;
+			Expects(entry.pos < ids.size());
+
+			// Swap with the last one, which then needs to know where it went
+			if (entry.pos + 1 != ids.size()) {
+				ids[entry.pos] = ids.back();
+				entries.find(ids[entry.pos])->second.pos = entry.pos;
+			}
+			ids.pop_back();
+			if (ids.empty()) {
+				buckets.erase(iter);
+			}
+		}
+	};
+
+	// Finds entities with a key in O(1)
+	template <typename Key, typename Hash = std::hash<Key>>
+	class HashEntityIndex : public EntityIndex<Key, FlatHashMap<Key, Vector<EntityId>, Hash>> {
+	};
+
+	// Finds entities with a key in O(log n), and those with keys in a range in O(log n) plus the number found
+	template <typename Key>
+	class SortedEntityIndex : public EntityIndex<Key, TreeMap<Key, Vector<EntityId>>> {
+	public:
+		// Within [minKey, maxKey], in order of key; doesn't clear results
+		void findRange(const Key& minKey, const Key& maxKey, Vector<EntityId>& results) const
+		{
+			if (maxKey < minKey) {
+				return;
+			}
+			auto& buckets = this->buckets;
+			const auto end = buckets.upper_bound(maxKey);
+			for (auto iter = buckets.lower_bound(minKey); iter != end; ++iter) {
+				results.insert(results.end(), iter->second.begin(), iter->second.end());
+			}
+		}
+	};
+}
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <algorithm>
+#include <functional>
 #include <gsl/gsl_assert>
 #include "family_type.h"
 #include "family_mask.h"
 #include "entity_id.h"
 #include "halley/data_structures/nullable_reference.h"
+#include "halley/data_structures/flat_hash_map.h"
 #include "halley/support/exception.h"
 #include "halley/support/debug.h"
 #include "halley/utils/utils.h"
@@ -18,7 +20,7 @@ namespace Halley {
 		friend class World;
 
 	public:
-		Family(FamilyMaskType mask);
+		Family(FamilyMaskType mask, gsl::span<const int> componentIndices);
 		virtual ~Family() {}
 
 		size_t count() const
@@ -26,11 +28,21 @@ namespace Halley {
 			return elemCount;
 		}
 
+		size_t getComponentCount() const
+		{
+			return componentIndices.size();
+		}
+
 		void* getElement(size_t n) const
 		{
 			return static_cast<char*>(elems) + (n * elemSize);
 		}
 
+		size_t getElementSize() const
+		{
+			return elemSize;
+		}
+
 		void addOnEntitiesAdded(FamilyBindingBase* bind);
 		void removeOnEntityAdded(FamilyBindingBase* bind);
 		void addOnEntitiesRemoved(FamilyBindingBase* bind);
@@ -43,7 +55,10 @@ namespace Halley {
 		virtual void addEntity(Entity& entity) = 0;
 		void removeEntity(Entity& entity);
 		virtual void updateEntities() = 0;
+		virtual void removeDeadEntities() = 0;
 		virtual void clearEntities() = 0;
+		virtual void reloadEntity(Entity& entity) = 0; // Its components moved, see World::compactStorage()
+		virtual void shrinkToFit() = 0;
 		
 		void* elems = nullptr;
 		size_t elemCount = 0;
@@ -55,6 +70,9 @@ namespace Halley {
 
 	private:
 		FamilyMaskType inclusionMask;
+		Vector<int> componentIndices;
+
+		bool hasLayout(gsl::span<const int> indices) const;
 	};
 
 	class FamilyBase {
@@ -100,16 +118,29 @@ namespace Halley {
 		};
 
 	public:
-		FamilyImpl() : Family(T::Type::inclusionMask()) {}
+		FamilyImpl() : Family(T::Type::inclusionMask(), T::Type::componentIndices())
+		{
+			elemSize = sizeof(StorageType);
+		}
 				
 	protected:
 		void addEntity(Entity& entity) override
 		{
+			const auto id = entity.getEntityId();
+			const auto slot = uint32_t(entities.size());
 			entities.push_back(StorageType());
 			auto& e = entities.back();
-			e.entityId = entity.getEntityId();
+			e.entityId = id;
 			T::Type::loadComponents(entity, &e.data[0]);
 
+			// If it was removed and added again in the same frame, the old entry is still here, and is the one to be removed
+			auto iter = slots.find(id);
+			if (iter == slots.end()) {
+				slots[id] = slot;
+			} else {
+				readded.emplace_back(id, slot);
+			}
+
 			dirty = true;
 		}
 
@@ -137,59 +168,79 @@ namespace Halley {
 		{
 			notifyRemove(entities.data(), entities.size());
 			entities.clear();
+			slots.clear();
+			readded.clear();
 			updateElems();
 		}
 
-	private:
-		Vector<StorageType> entities;
-		bool dirty = false;
+		void reloadEntity(Entity& entity) override
+		{
+			auto iter = slots.find(entity.getEntityId());
+			Expects(iter != slots.end());
+			T::Type::loadComponents(entity, &entities[iter->second].data[0]);
+		}
 
-		void updateElems()
+		void shrinkToFit() override
 		{
-			elems = entities.empty() ? nullptr : entities.data();
-			elemCount = entities.size();
-			elemSize = sizeof(StorageType);
+			// Only once it's mostly empty, so it doesn't keep shrinking and growing back
+			if (entities.capacity() > 64 && entities.size() * 4 < entities.capacity()) {
+				entities.shrink_to_fit();
+				removeSlots.shrink_to_fit();
+				updateElems();
+			}
+			if (slots.bucket_count() > 64 && slots.size() * 4 < slots.bucket_count()) {
+				FlatHashMap<EntityId, uint32_t> shrunk;
+				shrunk.reserve(slots.size());
+				for (auto& s: slots) {
+					shrunk[s.first] = s.second;
+				}
+				slots = std::move(shrunk);
+			}
 		}
 
-		void removeDeadEntities()
+		void removeDeadEntities() override
 		{
-			// Performance-critical code
-			// Benchmarks suggest that using a Vector is faster than std::set and std::unordered_set
+			// Performance-critical code; costs depend on how many are removed, not on how many are in the family
 			if (!toRemove.empty()) {
 				HALLEY_DEBUG_TRACE();
 				size_t removeCount = toRemove.size();
 				Expects(removeCount > 0);
 				Expects(removeCount <= entities.size());
-				std::sort(toRemove.begin(), toRemove.end());
 
-				for (size_t i = 1; i < toRemove.size(); ++i) {
-					Expects(toRemove[i - 1] != toRemove[i]);
+				removeSlots.clear();
+				for (auto& id: toRemove) {
+					auto iter = slots.find(id);
+					Expects(iter != slots.end());
+					removeSlots.push_back(iter->second);
+					slots.erase(iter);
 				}
+				toRemove.clear();
 
-				// Move all entities to be removed to the back of the vector
+				// Move all entities to be removed to the back of the vector, starting from the last, so the one swapped in is never to be removed
+				std::sort(removeSlots.begin(), removeSlots.end(), std::greater<uint32_t>());
 				{
-					int n = int(entities.size());
-					// Note: it's important to scan it forward. Scanning backwards would improve performance for short-lived entities,
-					// but it causes an issue where an entity is removed and added to the same family in one frame.
-					for (int i = 0; i < n; i++) {
-						EntityId id = entities[i].entityId;
-						auto iter = std::lower_bound(toRemove.begin(), toRemove.end(), id);
-						if (iter != toRemove.end() && id == *iter) {
-							toRemove.erase(iter);
-							if (i != n - 1) {
-								std::swap(entities[i], entities[n - 1]);
-								i--;
-							}
-							n--;
-							if (toRemove.empty()) {
-								break;
-							}
+					auto n = uint32_t(entities.size());
+					for (auto slot: removeSlots) {
+						const auto last = --n;
+						if (slot != last) {
+							std::swap(entities[slot], entities[last]);
+							moveSlot(entities[slot].entityId, last, slot);
 						}
 					}
 					Ensures(size_t(n) + removeCount == entities.size());
 				}
 
-				Expects(toRemove.empty());
+				// Entries added again after being removed now take the place of the old ones
+				if (!readded.empty()) {
+					for (size_t i = 0; i < readded.size(); ) {
+						if (slots.find(readded[i].first) == slots.end()) {
+							slots[readded[i].first] = readded[i].second;
+							readded.erase(readded.begin() + i);
+						} else {
+							++i;
+						}
+					}
+				}
 
 				// Notify removal
 				size_t newSize = entities.size() - removeCount;
@@ -202,5 +253,33 @@ namespace Halley {
 			}
 			Ensures(toRemove.empty());
 		}
+
+	private:
+		Vector<StorageType> entities;
+		FlatHashMap<EntityId, uint32_t> slots; // Where each entity is in entities
+		Vector<std::pair<EntityId, uint32_t>> readded; // Entities added while their previous entry is still waiting to be removed; rare
+		Vector<uint32_t> removeSlots;
+		bool dirty = false;
+
+		void moveSlot(EntityId id, uint32_t from, uint32_t to)
+		{
+			auto iter = slots.find(id);
+			if (iter != slots.end() && iter->second == from) {
+				iter->second = to;
+			} else {
+				for (auto& r: readded) {
+					if (r.second == from) {
+						r.second = to;
+					}
+				}
+			}
+		}
+
+		void updateElems()
+		{
+			elems = entities.empty() ? nullptr : entities.data();
+			elemCount = entities.size();
+			elemSize = sizeof(StorageType);
+		}
 	};
 }
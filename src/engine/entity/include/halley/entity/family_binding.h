@@ -24,8 +24,13 @@ namespace Halley {
 		void setOnEntitiesAdded(std::function<void(void*, size_t)> callback);
 		void setOnEntitiesRemoved(std::function<void(void*, size_t)> callback);
 
+		// Additions are only recorded here, and reported by flushPendingAdds() when the system next runs, so however many times entities
+		// are spawned in between, it gets one call per contiguous run of them. Removals are reported straight away, as the family is
+		// about to destroy them; anything removed before its addition was reported is dropped from both.
 		void onEntitiesAdded(void* entities, size_t count);
 		void onEntitiesRemoved(void* entities, size_t count);
+		void discardPendingAdds(void* entities, size_t count);
+		void flushPendingAdds();
 
 	private:
 		friend class System;
@@ -36,6 +41,10 @@ namespace Halley {
 		const FamilyMaskType writeMask;
 		std::function<void(void*, size_t)> addedCallback;
 		std::function<void(void*, size_t)> removedCallback;
+		Vector<EntityId> pendingAdds;
+
+		bool isPendingAdd(EntityId id) const;
+		EntityId getEntityId(void* entities, size_t index) const;
 	};
 
 	template <typename T>
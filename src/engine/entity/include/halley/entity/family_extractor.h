@@ -6,12 +6,12 @@ namespace Halley {
 	{
 		template <typename T>
 		struct StripMaybeRef {
-			using type = T;
+			using type = typename std::remove_const<T>::type;
 		};
 
 		template <typename T>
 		struct StripMaybeRef<MaybeRef<T>> {
-			using type = T;
+			using type = typename std::remove_const<T>::type;
 		};
 
 
@@ -1,11 +1,14 @@
 #pragma once
 
 #include <bitset>
+#include <cstdint>
+#include <type_traits>
 #include "halley/data_structures/maybe_ref.h"
 
 namespace Halley {
 	namespace FamilyMask {
 		using RealType = std::bitset<256>;
+		constexpr uint8_t noComponentSlot = 0xFF;
 
 
 		class Handle
@@ -27,6 +30,10 @@ namespace Halley {
 			const RealType& getRealValue() const;
 			
 			bool contains(const Handle& handle) const;
+			int getIndex() const { return value; } // Masks are interned, so equal masks have equal indices
+
+			// For each component index, where it is in the components of an entity with this mask (kept sorted by index), or noComponentSlot
+			const uint8_t* getComponentSlots() const;
 
 		private:
 			int value = -1;
@@ -87,6 +94,13 @@ namespace Halley {
 
 		
 
+		template <typename T>
+		struct IsReadOnly : std::is_const<T> {};
+
+		template <typename T>
+		struct IsReadOnly<MaybeRef<T>> : std::is_const<T> {};
+
+
 		template <typename... Ts>
 		struct MutableEvaluator;
 
@@ -100,10 +114,10 @@ namespace Halley {
 		template <typename T, typename... Ts>
 		struct MutableEvaluator <T, Ts...> {
 			static void makeMask(RealType& mask) {
-				if (std::is_const<T>::value) {
+				if (!IsReadOnly<T>::value) {
 					FamilyMask::setBit(mask, RetrieveComponentIndex<T>::componentIndex);
 				}
-				Evaluator<Ts...>::makeMask(mask);
+				MutableEvaluator<Ts...>::makeMask(mask);
 			}
 
 			static HandleType getMask() {
@@ -157,3 +171,14 @@ namespace Halley {
 
 	using FamilyMaskType = FamilyMask::HandleType;
 }
+
+namespace std {
+	template<>
+	struct hash<Halley::FamilyMask::Handle>
+	{
+		size_t operator()(const Halley::FamilyMask::Handle& v) const
+		{
+			return std::hash<int>()(v.getIndex());
+		}
+	};
+}
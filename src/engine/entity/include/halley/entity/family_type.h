@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <gsl/span>
 #include "family_extractor.h"
 
 namespace Halley {
@@ -18,6 +20,12 @@ namespace Halley {
 			return FamilyMask::InclusionEvaluator<Ts...>::getMask();
 		}
 
+		// The order components are stored in, which along with the inclusion mask decides if two families can be shared
+		static gsl::span<const int> componentIndices() {
+			static const std::array<int, sizeof...(Ts)> indices = {{ FamilyMask::RetrieveComponentIndex<Ts>::componentIndex... }};
+			return indices;
+		}
+
 		static void loadComponents(Entity& entity, char* data) {
 			Halley::FamilyExtractor::Evaluator<Ts...>::buildEntity(entity, reinterpret_cast<void**>(data), 0);
 		}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <gsl/gsl_assert>
+#include "message.h"
+#include "entity_id.h"
+
+namespace Halley {
+	// Holds the messages of a single type sent by a single system.
+	// Appending is lock-free, so a system can send from several threads at once, and memory is kept
+	// around after clear(), so steady-state sending does no heap allocations.
+	class MessageBucket
+	{
+	public:
+		MessageBucket(int type, size_t messageSize);
+		virtual ~MessageBucket();
+
+		MessageBucket(const MessageBucket& other) = delete;
+		MessageBucket& operator=(const MessageBucket& other) = delete;
+
+		int getType() const { return type; }
+
+		// Only safe to read once all senders are done, i.e. outside of the sending system's update
+		size_t size() const { return count.load(std::memory_order_acquire); }
+		bool empty() const { return size() == 0; }
+		EntityId getTarget(size_t idx) const;
+		Message* getMessage(size_t idx) const;
+
+		void clear();
+
+		virtual std::unique_ptr<MessageBucket> makeEmpty() const = 0; // Same message type
+		virtual void moveFrom(MessageBucket& other) = 0; // Appends all of other's messages, in order, and clears it
+
+	protected:
+		void* allocate(EntityId target);
+
+		virtual Message* toMessage(void* data) const = 0;
+		virtual void destroy(void* data) const = 0;
+
+	private:
+		constexpr static size_t firstBlockSize = 64;
+		constexpr static size_t maxBlocks = 24;
+
+		struct Block
+		{
+			std::unique_ptr<EntityId[]> targets;
+			std::unique_ptr<char[]> data;
+		};
+
+		const int type;
+		const size_t messageSize;
+		std::atomic<size_t> count;
+		std::array<std::atomic<Block*>, maxBlocks> blocks;
+		std::mutex blockMutex;
+
+		void* getData(size_t idx, EntityId*& target) const;
+		static void locate(size_t idx, size_t& blockIdx, size_t& offset);
+		Block& getBlock(size_t blockIdx);
+	};
+
+	template <typename T>
+	class MessageBucketOf final : public MessageBucket
+	{
+	public:
+		MessageBucketOf()
+			: MessageBucket(T::messageIndex, sizeof(T))
+		{
+			static_assert(alignof(T) <= alignof(std::max_align_t), "Message has unsupported alignment");
+		}
+
+		~MessageBucketOf()
+		{
+			clear();
+		}
+
+		void push(EntityId target, const T& msg)
+		{
+			new(allocate(target)) T(msg);
+		}
+
+		std::unique_ptr<MessageBucket> makeEmpty() const override
+		{
+			return std::make_unique<MessageBucketOf<T>>();
+		}
+
+		void moveFrom(MessageBucket& other) override
+		{
+			Expects(other.getType() == getType());
+			const size_t n = other.size();
+			for (size_t i = 0; i < n; ++i) {
+				new(allocate(other.getTarget(i))) T(std::move(*static_cast<T*>(other.getMessage(i))));
+			}
+			other.clear();
+		}
+
+	protected:
+		Message* toMessage(void* data) const override
+		{
+			return static_cast<T*>(data);
+		}
+
+		void destroy(void* data) const override
+		{
+			static_cast<T*>(data)->~T();
+		}
+	};
+}
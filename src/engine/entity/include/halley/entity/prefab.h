@@ -0,0 +1,62 @@
+#pragma once
+
+#include <gsl/gsl>
+#include "component.h"
+#include "family_mask.h"
+#include "type_deleter.h"
+#include <halley/data_structures/vector.h>
+
+namespace Halley {
+	class SizePool;
+
+	// A set of components to stamp out entities from, see World::instantiate.
+	// The components are built once, along with the family mask they add up to, so each instance is only a copy of them.
+	class Prefab
+	{
+		friend class World;
+
+	public:
+		Prefab();
+		// Data as written by serialize(), e.g. a prefab asset loaded as a BinaryFile
+		explicit Prefab(gsl::span<const gsl::byte> data);
+		~Prefab();
+
+		Prefab(Prefab&& other) noexcept;
+		Prefab& operator=(Prefab&& other) noexcept;
+		Prefab(const Prefab& other) = delete;
+		Prefab& operator=(const Prefab& other) = delete;
+
+		template <typename T>
+		Prefab& addComponent(T&& component)
+		{
+			static_assert(std::is_base_of<Component, T>::value, "Components must extend the Component class");
+			static_assert(std::is_copy_constructible<T>::value, "Components in a prefab must be copyable");
+			TypeDeleter<T>::initialize();
+			addComponent(T::componentIndex, ::new(PoolAllocator<T>::alloc()) T(std::move(component)));
+			return *this;
+		}
+
+		// Components are written as in world snapshots, so the same rules apply: raw copies unless they have serializers
+		Bytes serialize() const;
+
+		FamilyMaskType getMask() const { return mask; }
+		size_t getNumComponents() const { return components.size(); }
+
+	private:
+		struct ComponentTemplate
+		{
+			int id;
+			TypeDeleterBase* deleter;
+			SizePool* pool;
+			void* data;
+			size_t size;
+			bool trivial; // Copied with memcpy
+		};
+
+		Vector<ComponentTemplate> components;
+		FamilyMaskType mask;
+
+		void addComponent(int id, void* data);
+		void clear();
+	};
+}
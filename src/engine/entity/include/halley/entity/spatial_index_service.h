@@ -0,0 +1,59 @@
+#pragma once
+
+#include <gsl/gsl>
+#include "service.h"
+#include "entity_id.h"
+#include "family_binding.h"
+#include <halley/data_structures/hierarchical_grid.h>
+#include <halley/data_structures/flat_hash_map.h>
+#include <halley/data_structures/vector.h>
+
+namespace Halley {
+	// Broadphase index of entity bounds, shared by every system that needs to find entities by area
+	class SpatialIndexService : public Service {
+	public:
+		explicit SpatialIndexService(float minCellSize = 32.0f);
+
+		// Makes the index match the family, with bounds given by getBounds(const F&).
+		// To index several families at once, call beginSync(), setBounds() for each of their entities, and endSync().
+		template <typename F, typename G>
+		void sync(FamilyBinding<F>& family, G getBounds)
+		{
+			beginSync();
+			for (auto& e: family) {
+				setBounds(e.entityId, getBounds(e));
+			}
+			endSync();
+		}
+
+		void beginSync();
+		void endSync(); // Removes everything that wasn't set since beginSync()
+
+		void setBounds(EntityId entity, Rect4f bounds);
+		void remove(EntityId entity);
+		void clear();
+		size_t size() const;
+
+		// Queries don't clear results, and are safe to run concurrently outside of the methods above
+		void query(Rect4f rect, Vector<EntityId>& results) const;
+		void queryRadius(Vector2f centre, float radius, Vector<EntityId>& results) const;
+		void queryRay(Vector2f origin, Vector2f dir, float maxDistance, Vector<std::pair<float, EntityId>>& results) const; // Sorted by distance
+		void queryFrustum(const Polygon& frustum, Vector<EntityId>& results) const; // e.g. a camera's view, rotated or not
+
+		// Runs each query on Executors::getCPU(), results[i] is for rects[i]
+		void queryBatch(gsl::span<const Rect4f> rects, Vector<Vector<EntityId>>& results) const;
+
+	private:
+		using Handle = HierarchicalGrid<EntityId>::Handle;
+
+		struct Entry {
+			Handle handle;
+			uint32_t lastSync;
+		};
+
+		HierarchicalGrid<EntityId> grid;
+		FlatHashMap<EntityId, Entry> entries;
+		Vector<EntityId> toRemove;
+		uint32_t syncId = 0;
+	};
+}
@@ -2,12 +2,21 @@
 
 #include <halley/data_structures/vector.h>
 #include <halley/concurrency/concurrent.h>
+#include <halley/data_structures/hash_map.h>
+#include <halley/data_structures/flat_hash_map.h>
+#include <halley/data_structures/frame_arena.h>
+#include <halley/maths/rolling_stats.h>
+#include <halley/support/memory_tracker.h>
 #include <initializer_list>
+#include <array>
+#include <atomic>
+#include <mutex>
 
 #include "family_binding.h"
 #include "family_mask.h"
 #include "family_type.h"
 #include "entity.h"
+#include "message_bucket.h"
 #include "halley/utils/type_traits.h"
 
 namespace Halley {
@@ -28,22 +37,46 @@ namespace Halley {
 	template <class, class, class = Halley::void_t<>> struct HasOnEntitiesRemoved : std::false_type {};
 	template <class T, class F> struct HasOnEntitiesRemoved<T, F, decltype(std::declval<T>().onEntitiesRemoved(std::declval<Span<F>>()))> : std::true_type { };
 
+	// Describes whether the parallel scheduler may run a system alongside others
+	enum class SystemConcurrency
+	{
+		Exclusive,      // Touches the world/API directly; runs alone on the calling thread
+		CallingThread,  // Shares a batch, but runs on the calling thread (e.g. it spawns its own parallel tasks)
+		Any             // Shares a batch, and can run on any thread
+	};
+
+	// How the chunks of a parallel system's family are assigned to threads
+	enum class ParallelAffinity
+	{
+		Any,    // Whichever thread is free
+		Sticky  // Each chunk prefers the same worker every update, so its entities tend to stay in that core's cache
+	};
 	
 	class System
 	{
 	public:
-		System(std::initializer_list<FamilyBindingBase*> families, std::initializer_list<int> messageTypesReceived);
+		System(std::initializer_list<FamilyBindingBase*> families, std::initializer_list<int> messageTypesReceived, std::initializer_list<int> messageTypesSent = {}, SystemConcurrency concurrency = SystemConcurrency::Exclusive);
 		virtual ~System() {}
 
 		String getName() const { return name; }
-		void setName(String n) { name = n; }
+		void setName(String n);
 		size_t getEntityCount() const;
 		void tryInit();
 
 		long long getNanoSecondsTaken() const { return timer.lastElapsedNanoSeconds(); }
 		long long getNanoSecondsTakenAvg() const { return timer.averageElapsedNanoSeconds(); }
+		long long getNanoSecondsInMessages() const { return messagesNs; } // Part of the last getNanoSecondsTaken()
+		const RollingStats& getTimeHistory() const { return timeHistory; }
+		MemoryTag getMemoryTag() const { return memoryTag; } // Current while this updates or renders, named "system:<name>"
 		void setCollectSamples(bool collect);
 
+		// Whether it runs when the world is replaying frames after a rollback; only turn it off for systems with no effect on the simulation
+		void setRunDuringResimulation(bool run) { runDuringResimulation = run; }
+		bool runsDuringResimulation() const { return runDuringResimulation; }
+
+		SystemConcurrency getConcurrency() const { return concurrency; }
+		bool conflictsWith(const System& other) const;
+
 	protected:
 		const HalleyAPI& doGetAPI() const { return *api; }
 		World& doGetWorld() const { return *world; }
@@ -61,20 +94,92 @@ namespace Halley {
 			}
 		}
 
+		// Splits the family into balanced chunks of about grainSize entities (0 picks a few per thread). Messages sent from each chunk
+		// are held in that chunk, and appended to the outbox in chunk order once they're all done, so they end up in the same order
+		// as if the family had been updated serially, however the chunks were scheduled.
 		template <typename F, typename V>
-		static void invokeParallel(F&& f, V& fam)
+		void invokeParallel(F&& f, V& fam, size_t grainSize = 0, ParallelAffinity affinity = ParallelAffinity::Any)
 		{
-			Concurrent::foreach(std::begin(fam), std::end(fam), [&] (auto& e) {
-				f(e);
-			});
+			auto& queue = Executors::getCPU();
+			const size_t n = fam.count();
+			const size_t nChunks = Concurrent::getChunkCount(queue, n, grainSize);
+			beginParallelChunks(nChunks);
+			Concurrent::forChunks(queue, n, nChunks, [&] (size_t chunk, size_t start, size_t end)
+			{
+				ParallelChunkScope scope(*this, chunk);
+				const auto first = std::begin(fam);
+				for (auto i = first + start; i < first + end; ++i) {
+					f(*i);
+				}
+			}, affinity == ParallelAffinity::Sticky);
+			endParallelChunks(nChunks);
+		}
+
+		// Smeared systems update a rotating 1/nSlices of their family each step. Entities are sliced by their id's slot rather than by
+		// their position in the family, so one stays in the same slice however the family changes around it. Each is passed the time
+		// since its slice last ran in place of the step's own time (normally nSlices steps' worth).
+		template <typename F, typename V>
+		void invokeSmeared(F&& f, V& fam, size_t nSlices, Time time)
+		{
+			size_t slice;
+			const Time elapsed = beginSmearedStep(nSlices, time, slice);
+			for (auto& e : fam) {
+				if (isInSmearedSlice(e.entityId, nSlices, slice)) {
+					f(e, elapsed);
+				}
+			}
+		}
+
+		// As invokeSmeared, with this step's slice then split into chunks as in invokeParallel
+		template <typename F, typename V>
+		void invokeSmearedParallel(F&& f, V& fam, size_t nSlices, Time time, size_t grainSize = 0, ParallelAffinity affinity = ParallelAffinity::Any)
+		{
+			size_t slice;
+			const Time elapsed = beginSmearedStep(nSlices, time, slice);
+			smearedIndices.clear();
+			const size_t count = fam.count();
+			const auto first = std::begin(fam);
+			for (size_t i = 0; i < count; ++i) {
+				if (isInSmearedSlice(first[i].entityId, nSlices, slice)) {
+					smearedIndices.push_back(uint32_t(i));
+				}
+			}
+
+			auto& queue = Executors::getCPU();
+			const size_t n = smearedIndices.size();
+			const size_t nChunks = Concurrent::getChunkCount(queue, n, grainSize);
+			beginParallelChunks(nChunks);
+			Concurrent::forChunks(queue, n, nChunks, [&] (size_t chunk, size_t start, size_t end)
+			{
+				ParallelChunkScope scope(*this, chunk);
+				for (size_t i = start; i < end; ++i) {
+					f(first[smearedIndices[i]], elapsed);
+				}
+			}, affinity == ParallelAffinity::Sticky);
+			endParallelChunks(nChunks);
+		}
+
+		// Scratch storage for the parallel chunk currently running on this thread, default-constructed on first use. It's kept between
+		// updates (chunk i gets the same one each time), so containers in it can keep their capacity. Each system can only use one type.
+		template <typename S>
+		S& getChunkScratch()
+		{
+			auto& chunk = getCurrentChunk();
+			static const char typeTag = 0;
+			if (!chunk.scratch) {
+				chunk.scratch = std::shared_ptr<void>(new S(), [] (void* p) { delete static_cast<S*>(p); });
+				chunk.scratchType = &typeTag;
+			} else if (chunk.scratchType != &typeTag) {
+				throw Exception("System " + name + " is using more than one type of chunk scratch", HalleyExceptions::Entity);
+			}
+			return *static_cast<S*>(chunk.scratch.get());
 		}
 
 		template <typename T>
 		void sendMessageGeneric(EntityId entityId, const T& msg)
 		{
-			auto toSend = std::make_unique<T>();
-			*toSend = msg;
-			doSendMessage(entityId, std::move(toSend), sizeof(T), T::messageIndex);
+			auto& bucket = getOutbox(T::messageIndex, [] () -> std::unique_ptr<MessageBucket> { return std::make_unique<MessageBucketOf<T>>(); });
+			static_cast<MessageBucketOf<T>&>(bucket).push(entityId, msg);
 		}
 
 		template <typename T, typename std::enable_if<HasInitMember<T>::value, int>::type = 0>
@@ -125,26 +230,82 @@ namespace Halley {
 
 		Vector<FamilyBindingBase*> families;
 		Vector<int> messageTypesReceived;
-		Vector<EntityId> messagesSentTo;
-		Vector<std::pair<EntityId, MessageEntry>> outbox;
+		Vector<int> messageTypesSent;
+
+		// Fixed-size, so it can be searched without locking while other threads are sending
+		constexpr static size_t maxOutboxes = 32;
+		std::array<std::unique_ptr<MessageBucket>, maxOutboxes> outbox;
+		std::atomic<size_t> outboxCount;
+		std::mutex outboxMutex;
+
+		struct ParallelChunk
+		{
+			std::array<std::unique_ptr<MessageBucket>, maxOutboxes> outbox;
+			size_t outboxCount = 0;
+			std::shared_ptr<void> scratch;
+			const void* scratchType = nullptr;
+		};
+		Vector<std::unique_ptr<ParallelChunk>> parallelChunks;
+
+		Vector<Time> smearedTime; // Accumulated per slice since it last ran
+		size_t smearedSlice = 0;
+		Vector<uint32_t> smearedIndices;
+
+		class ParallelChunkScope
+		{
+		public:
+			ParallelChunkScope(System& system, size_t chunk);
+			~ParallelChunkScope();
+
+		private:
+			const System* prevSystem;
+			ParallelChunk* prevChunk;
+		};
+
+		Vector<Message*> inboxMessages;
+		Vector<size_t> inboxElems;
+		FlatHashMap<EntityId, size_t> inboxElemLookup;
 
 		World* world = nullptr;
 		const HalleyAPI* api = nullptr;
 		String name;
+		const char* profilerName = "System";
+		MemoryTag memoryTag = MemoryTags::Untagged;
 		int systemId = -1;
 		bool initialised = false;
 		bool collectSamples = false;
+		bool runDuringResimulation = true;
+		SystemConcurrency concurrency = SystemConcurrency::Exclusive;
 
 		StopwatchAveraging timer;
+		RollingStats timeHistory;
+		int64_t messagesNs = 0;
 
 		void doUpdate(Time time);
 		void doRender(RenderContext& rc);
 		void onAddedToWorld(World& world, int id);
 
+		void runUpdate(Time time);
+		FamilyMask::RealType getReadMask() const;
+		FamilyMask::RealType getWriteMask() const;
+
 		void purgeMessages();
 		void processMessages();
-		void doSendMessage(EntityId target, std::unique_ptr<Message> msg, size_t msgSize, int msgId);
-		void dispatchMessages();
+		MessageBucket& getOutbox(int msgType, std::unique_ptr<MessageBucket>(*createBucket)());
+		MessageBucket* tryGetOutbox(int msgType) const;
+		MessageBucket& addOutbox(std::unique_ptr<MessageBucket> bucket);
+
+		void beginParallelChunks(size_t nChunks);
+		void endParallelChunks(size_t nChunks);
+		ParallelChunk& getCurrentChunk() const;
+		ParallelChunk* tryGetCurrentChunk() const;
+
+		Time beginSmearedStep(size_t nSlices, Time time, size_t& slice);
+		static bool isInSmearedSlice(EntityId id, size_t nSlices, size_t slice)
+		{
+			// The low half of an id is its slot in the world, which is dense and reused, so slices stay about the same size
+			return size_t(uint32_t(id.value)) % nSlices == slice;
+		}
 	};
 
 }
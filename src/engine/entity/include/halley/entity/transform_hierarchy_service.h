@@ -0,0 +1,81 @@
+#pragma once
+
+#include "service.h"
+#include "entity_id.h"
+#include "spatial_index_service.h"
+#include <halley/maths/transform_2d.h>
+#include <halley/data_structures/flat_hash_map.h>
+#include <halley/data_structures/vector.h>
+
+namespace Halley {
+	// Parent/child transforms for entities, so each game doesn't have to roll its own.
+	// World transforms are stored as structure-of-arrays, sorted by depth, and update() only recomputes the subtrees under
+	// something that changed, one depth level at a time, spreading big levels over Executors::getCPU().
+	// Nothing here is thread-safe, but the getters are const and can run concurrently outside of update() and the setters.
+	class TransformHierarchyService : public Service {
+	public:
+		TransformHierarchyService();
+
+		void add(EntityId entity, const Transform2D& local = Transform2D(), EntityId parent = EntityId());
+		void remove(EntityId entity); // Its children become roots, keeping their local transforms
+		void clear();
+		bool contains(EntityId entity) const;
+		size_t size() const;
+
+		void setParent(EntityId entity, EntityId parent); // An invalid parent makes it a root
+		EntityId getParent(EntityId entity) const;
+		void setLocal(EntityId entity, const Transform2D& local);
+		Transform2D getLocal(EntityId entity) const;
+
+		void update();
+
+		// As of the last update()
+		Affine2D getWorld(EntityId entity) const;
+		Transform2D getWorldTransform(EntityId entity) const;
+		Vector2f getWorldPosition(EntityId entity) const;
+		const Vector<EntityId>& getChanged() const; // What got a new world transform in the last update()
+
+		// Moves just the entities that changed in the last update(), with getLocalBounds(EntityId) in their own space
+		template <typename F>
+		void updateSpatialIndex(SpatialIndexService& index, F getLocalBounds) const
+		{
+			for (auto& id: changed) {
+				index.setBounds(id, getWorld(id).transformBounds(getLocalBounds(id)));
+			}
+		}
+
+	private:
+		constexpr static uint32_t noParent = uint32_t(-1);
+
+		FlatHashMap<EntityId, uint32_t> indices;
+		Vector<EntityId> ids;
+		Vector<uint32_t> parents;
+		Vector<char> dirty;
+		Vector<char> removed;
+		Vector<char> changedFlags;
+
+		// Local
+		Vector<float> posX;
+		Vector<float> posY;
+		Vector<float> rotation;
+		Vector<float> scaleX;
+		Vector<float> scaleY;
+
+		// World, as the Affine2D fields
+		Vector<float> worldA;
+		Vector<float> worldB;
+		Vector<float> worldC;
+		Vector<float> worldD;
+		Vector<float> worldX;
+		Vector<float> worldY;
+
+		Vector<uint32_t> levelStart; // Index of the first node at each depth, plus the total at the end
+		Vector<uint32_t> order; // 0..n-1, just to iterate over with Concurrent::foreach
+		Vector<EntityId> changed;
+		bool structureDirty = false;
+
+		uint32_t getIndex(EntityId entity) const;
+		void rebuild();
+		void updateNode(uint32_t i);
+	};
+}
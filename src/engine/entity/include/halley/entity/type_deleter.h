@@ -1,6 +1,13 @@
 #pragma once
 
+#include <new>
+#include <utility>
+#include <type_traits>
+#include <typeinfo>
 #include <halley/data_structures/vector.h>
+#include <halley/bytes/byte_serializer.h>
+#include <halley/support/exception.h>
+#include <halley/data_structures/memory_pool.h>
 
 namespace Halley {
 	class TypeDeleterBase
@@ -8,9 +15,39 @@ namespace Halley {
 	public:
 		virtual ~TypeDeleterBase() {}
 		virtual size_t getSize() = 0;
+		virtual SizePool& getPool() = 0; // Components of each type get a pool of their own
 		virtual void callDestructor(void* ptr) = 0;
+		virtual void moveConstruct(void* dst, void* src) = 0;
+
+		// Used by world snapshots
+		virtual void* create() = 0;
+		virtual void serialize(Serializer& s, const void* ptr) = 0;
+		virtual void deserialize(Deserializer& s, void* ptr) = 0;
+
+		// Used by replication
+		virtual bool isReplicated() = 0;
+		virtual void serializeReplica(Serializer& s, const void* ptr) = 0;
+		virtual void deserializeReplica(Deserializer& s, void* ptr) = 0;
+
+		// Used by prefabs
+		virtual bool isTriviallyCopyable() = 0;
+		virtual bool isCopyConstructible() = 0;
+		virtual void copyConstruct(void* dst, const void* src) = 0;
 	};
 
+	template <typename T, typename = void>
+	struct HasSerializeMethods : std::false_type {};
+
+	template <typename T>
+	struct HasSerializeMethods<T, decltype(std::declval<const T&>().serialize(std::declval<Serializer&>()), std::declval<T&>().deserialize(std::declval<Deserializer&>()), void())> : std::true_type {};
+
+	// Components marked as replicated in their schema get "static constexpr bool replicated = true;"
+	template <typename T, typename = void>
+	struct IsReplicatedComponent : std::false_type {};
+
+	template <typename T>
+	struct IsReplicatedComponent<T, typename std::enable_if<T::replicated>::type> : std::true_type {};
+
 	class ComponentDeleterTable
 	{
 	public:
@@ -28,6 +65,12 @@ namespace Halley {
 			return (*getDeleters())[uid];
 		}
 
+		static TypeDeleterBase* tryGet(int uid)
+		{
+			auto& m = *getDeleters();
+			return uid >= 0 && uid < int(m.size()) ? m[uid] : nullptr;
+		}
+
 		static Vector<TypeDeleterBase*>*& getDeleters()
 		{
 			static Vector<TypeDeleterBase*>* map;
@@ -53,6 +96,11 @@ namespace Halley {
 			return sizeof(T);
 		}
 
+		SizePool& getPool() override
+		{
+			return PoolAllocator<T>::getPool();
+		}
+
 		void callDestructor(void* ptr) override
 		{
 #ifdef _MSC_VER
@@ -60,5 +108,106 @@ namespace Halley {
 #endif
 			static_cast<T*>(ptr)->~T();
 		}
+
+		void moveConstruct(void* dst, void* src) override
+		{
+			::new(dst) T(std::move(*static_cast<T*>(src)));
+		}
+
+		void* create() override
+		{
+			return ::new(PoolAllocator<T>::alloc()) T();
+		}
+
+		void serialize(Serializer& s, const void* ptr) override
+		{
+			doSerialize(s, *static_cast<const T*>(ptr), SnapshotMethod());
+		}
+
+		void deserialize(Deserializer& s, void* ptr) override
+		{
+			doDeserialize(s, *static_cast<T*>(ptr), SnapshotMethod());
+		}
+
+		bool isReplicated() override
+		{
+			return IsReplicatedComponent<T>::value;
+		}
+
+		void serializeReplica(Serializer& s, const void* ptr) override
+		{
+			doSerialize(s, *static_cast<const T*>(ptr), ReplicaMethod());
+		}
+
+		void deserializeReplica(Deserializer& s, void* ptr) override
+		{
+			doDeserialize(s, *static_cast<T*>(ptr), ReplicaMethod());
+		}
+
+		bool isTriviallyCopyable() override
+		{
+			return std::is_trivially_copyable<T>::value;
+		}
+
+		bool isCopyConstructible() override
+		{
+			return std::is_copy_constructible<T>::value;
+		}
+
+		void copyConstruct(void* dst, const void* src) override
+		{
+			doCopyConstruct(dst, *static_cast<const T*>(src), std::is_copy_constructible<T>());
+		}
+
+	private:
+		static void doCopyConstruct(void* dst, const T& src, std::true_type)
+		{
+			::new(dst) T(src);
+		}
+
+		static void doCopyConstruct(void*, const T&, std::false_type)
+		{
+			throw Exception(String("Component ") + typeid(T).name() + " can't be copied, so it can't be instantiated from a prefab.", HalleyExceptions::Entity);
+		}
+
+		// Plain data is copied as is, which is both the fastest option and needs no code from the component
+		using RawCopy = std::integral_constant<int, 0>;
+		using Serialized = std::integral_constant<int, 1>;
+		using Unsupported = std::integral_constant<int, 2>;
+		using SnapshotMethod = std::integral_constant<int, std::is_trivially_copyable<T>::value ? 0 : (HasSerializeMethods<T>::value ? 1 : 2)>;
+
+		// Replicas go over the network, so whatever bit-packing or quantization the schema asks for is worth the extra time
+		using ReplicaMethod = std::integral_constant<int, HasSerializeMethods<T>::value ? 1 : (std::is_trivially_copyable<T>::value ? 0 : 2)>;
+
+		static void doSerialize(Serializer& s, const T& value, RawCopy)
+		{
+			s << gsl::as_bytes(gsl::span<const T>(&value, 1));
+		}
+
+		static void doDeserialize(Deserializer& s, T& value, RawCopy)
+		{
+			auto dst = gsl::as_writeable_bytes(gsl::span<T>(&value, 1));
+			s >> dst;
+		}
+
+		static void doSerialize(Serializer& s, const T& value, Serialized)
+		{
+			s << value;
+		}
+
+		static void doDeserialize(Deserializer& s, T& value, Serialized)
+		{
+			s >> value;
+		}
+
+		static void doSerialize(Serializer&, const T&, Unsupported)
+		{
+			throw Exception(String("Component ") + typeid(T).name() + " can't be snapshotted. Mark it as serializable in its schema.", HalleyExceptions::Entity);
+		}
+
+		static void doDeserialize(Deserializer&, T&, Unsupported)
+		{
+			throw Exception(String("Component ") + typeid(T).name() + " can't be snapshotted. Mark it as serializable in its schema.", HalleyExceptions::Entity);
+		}
 	};
 }
@@ -8,11 +8,17 @@
 #include "family.h"
 #include <halley/time/halleytime.h>
 #include <halley/text/halleystring.h>
-#include <halley/data_structures/mapped_pool.h>
+#include <halley/text/string_id.h>
+#include <halley/data_structures/slot_map.h>
 #include <halley/time/stopwatch.h>
+#include <halley/maths/rolling_stats.h>
 #include <halley/data_structures/vector.h>
 #include <halley/data_structures/tree_map.h>
+#include <halley/data_structures/hash_map.h>
+#include <halley/data_structures/flat_hash_map.h>
+#include <halley/support/telemetry.h>
 #include "service.h"
+#include "entity.h"
 
 namespace Halley {
 	class ConfigNode;
@@ -21,18 +27,39 @@ namespace Halley {
 	class System;
 	class Painter;
 	class HalleyAPI;
+	class ArchetypeStorage;
+	class Prefab;
+	class Random;
 
-	class World
+	class World : public ITelemetrySource
 	{
 	public:
+		// Where the time of the last step (or render) of a timeline went, if collecting metrics
+		struct FrameBreakdown
+		{
+			int64_t totalNs = 0;
+			int64_t spawnNs = 0; // Adding newly created entities
+			int64_t updateEntitiesNs = 0; // Moving entities between families
+			int64_t systemsNs = 0; // Everything else, including messagesNs
+			int64_t messagesNs = 0; // Systems going through the messages they received
+		};
+
 		World(const HalleyAPI* api, bool collectMetrics);
 		~World();
 
+		// Tears the world down a bit at a time, for up to maxTime seconds per call, until it returns true; the world can't be used after
+		// the first call, and destroying it afterwards is cheap. See EntityStage::destroyWorldDeferred().
+		bool destroyIncrementally(Time maxTime);
+
 		void step(TimeLine timeline, Time elapsed);
 		void render(RenderContext& rc) const;
 		bool hasSystemsOnTimeLine(TimeLine timeline) const;
 		
 		int64_t getAverageTime(TimeLine timeline) const;
+		void getTelemetry(std::vector<TelemetryValue>& values) const override; // Only registered if collecting metrics
+		const FrameBreakdown& getLastFrameBreakdown(TimeLine timeline) const;
+		const RollingStats& getTimeHistory(TimeLine timeline) const;
+		const Vector<std::unique_ptr<Family>>& getFamilies() const;
 
 		System& addSystem(std::unique_ptr<System> system, TimeLine timeline);
 		void removeSystem(System& system);
@@ -42,13 +69,14 @@ namespace Halley {
 		const Vector<std::unique_ptr<System>>& getSystems(TimeLine timeline) const;
 
 		Service& addService(std::shared_ptr<Service> service);
-		void loadSystems(const ConfigNode& config, std::function<std::unique_ptr<System>(String)> createFunction);
+		void loadSystems(const ConfigNode& config, std::function<std::unique_ptr<System>(String)> createFunction, bool renderSystems = true); // Dedicated servers skip render systems
 
 		template <typename T>
 		T& getService() const
 		{
 			static_assert(std::is_base_of<Service, T>::value, "Must extend Service");
-			return *dynamic_cast<T*>(&getService(typeid(T).name()));
+			static const StringId id(typeid(T).name());
+			return *dynamic_cast<T*>(&getService(id));
 		}
 
 		EntityRef createEntity();
@@ -57,26 +85,87 @@ namespace Halley {
 		Entity* tryGetEntity(EntityId id);
 		size_t numEntities() const;
 
+		// Creates n entities with copies of the prefab's components. They join their families together on the next
+		// spawnPending(), without going through the per-entity refresh, unless components are added or removed before then.
+		Vector<EntityId> instantiate(const Prefab& prefab, size_t n);
+
+		// onCreated is called as (EntityRef&, size_t index) for each, e.g. to set up positions
+		template <typename F>
+		void instantiate(const Prefab& prefab, size_t n, F&& onCreated)
+		{
+			const size_t first = instantiated.size();
+			doInstantiate(prefab, n);
+			for (size_t i = 0; i < n; ++i) {
+				EntityRef ref(*instantiated[first + i], *this);
+				onCreated(ref, i);
+			}
+		}
+
 		void spawnPending(); // Warning: use with care, will invalidate entities
 
-		void onEntityDirty();
+		void onEntityDirty(Entity& entity);
+
+		// Keeps components of entities with the same mask in contiguous chunks, instead of individually pooled
+		// Warning: components may move whenever an entity's mask changes, don't hold on to pointers to them
+		void setArchetypeStorage(bool enabled);
+		bool hasArchetypeStorage() const;
+
+		// Gives back memory left over from heavy spawning and despawning, spending up to maxTime seconds; meant for frames with time to
+		// spare, and returns true once there's nothing left to do. With archetype storage, components are moved out of each archetype's
+		// last chunks into the gaps of the others, so there are as few chunks as possible (and families are pointed at where they went).
+		// Family storage is shrunk either way. Does nothing while there are entity changes waiting for spawnPending().
+		bool compactStorage(Time maxTime);
+
+		// Binary image of every entity and its components, for rollback or quick save/load.
+		// Components are copied raw unless they're not trivially copyable, so snapshots are only valid for the same build.
+		// Loading updates entities in place, and entity ids are allocated just as they would have been after saving.
+		void saveSnapshot(Bytes& dst); // Reuses dst's memory
+		void loadSnapshot(const Bytes& src);
+
+		// State of an entity's replicated components only (those marked as replicated in their schema), for EntityReplicator.
+		// Loading adds, updates and removes replicated components to match, and leaves every other component alone.
+		bool hasReplicatedComponents(EntityId id);
+		void saveReplica(EntityId id, Serializer& s);
+		void loadReplica(EntityId id, Deserializer& s);
+
+		// Runs non-conflicting systems of each timeline concurrently on Executors::getCPU()
+		void setParallelSystems(bool enabled);
+		bool hasParallelSystems() const;
+
+		// For lockstep simulations, which must stay bitwise identical on every peer. Systems always run one at a time, in the order they
+		// were added (overriding setParallelSystems), and getRandom() streams are seeded from the given seed. Floats will only match
+		// between builds of the same code, made with HALLEY_DETERMINISTIC_FLOAT, and only as long as systems stick to getRandom().
+		void setDeterministic(bool enabled, uint64_t seed = 0);
+		bool isDeterministic() const;
+
+		// Each named stream is seeded from the world seed and its name, so using one doesn't change the sequence of any other
+		Random& getRandom(const String& stream);
+
+		// Hash of what saveSnapshot() would write, for comparing between peers (see NetworkSession::reportStateHash()).
+		// Unlike saveSnapshot(), it doesn't spawn pending entities first, so asking for it never changes the world;
+		// those only count through the ids allocated for them. Components with padding need to zero it, or it'll differ for no reason.
+		uint64_t getStateHash() const;
+
+		// Set while rolling back and replaying frames that were already simulated (see RollbackSession). Systems that only produce
+		// presentation side effects, like sounds or particles, should opt out with System::setRunDuringResimulation(false).
+		void setResimulating(bool resimulating);
+		bool isResimulating() const;
 
 		template <typename T>
 		Family& getFamily()
 		{
-			// Disable re-using of families due to optional components messing them up
-			/*
-			FamilyMaskType mask = T::Type::readMask();
-			auto iter = families.find(mask);
-			if (iter != families.end()) {
-				return *iter->second;
+			// Shared between every binding with the same components in the same order, so each entity is only added once.
+			// Optional components don't affect which entities are in it, but they're still part of the layout, so families
+			// with the same inclusion mask and different optional components are kept apart.
+			const FamilyMaskType mask = T::Type::inclusionMask();
+			const auto layout = T::Type::componentIndices();
+			if (Family* existing = tryGetFamily(mask, layout)) {
+				return *existing;
 			}
-			*/
 
 			auto newFam = std::make_unique<FamilyImpl<T>>();
 			Family* newFamPtr = newFam.get();
 			onAddFamily(*newFamPtr);
-			//families[mask] = std::move(newFam);
 			families.emplace_back(std::move(newFam));
 			return *newFamPtr;
 		}
@@ -86,30 +175,67 @@ namespace Halley {
 		std::array<Vector<std::unique_ptr<System>>, static_cast<int>(TimeLine::NUMBER_OF_TIMELINES)> systems;
 		bool collectMetrics = false;
 		bool entityDirty = false;
+		bool parallelSystems = false;
+		bool deterministic = false;
+		bool resimulating = false;
+		bool tearingDown = false;
+		uint64_t randomSeed = 0;
+		HashMap<String, std::unique_ptr<Random>> randomStreams;
+		mutable Bytes stateHashSnapshot;
 		
 		Vector<Entity*> entities;
 		Vector<Entity*> entitiesPendingCreation;
-		MappedPool<Entity*> entityMap;
+		Vector<Entity*> instantiated; // From prefabs, since the last updateEntities()
+		Vector<Entity*> dirtyEntities;
+		Vector<Entity*> dirtyEntitiesProcessing; // Kept around to reuse its memory
+
+		struct PendingMaskChange {
+			FamilyMaskType mask;
+			Entity* entity;
+
+			PendingMaskChange(FamilyMaskType mask, Entity* entity) : mask(mask), entity(entity) {}
+			bool operator<(const PendingMaskChange& other) const { return mask < other.mask; }
+		};
+		Vector<PendingMaskChange> pendingRemoves;
+		Vector<PendingMaskChange> pendingAdds;
+		Vector<Entity*> entitiesRemoved;
+		Vector<Entity*> entitiesToRelocate;
+		Vector<Entity*> entitiesCompacted;
+		SlotMap<Entity*> entityMap;
+		size_t entityPeak = 0;
+		std::unique_ptr<ArchetypeStorage> archetypeStorage;
+		bool useArchetypeStorage = false;
 
-		//TreeMap<FamilyMaskType, std::unique_ptr<Family>> families;
 		Vector<std::unique_ptr<Family>> families;
-		TreeMap<String, std::shared_ptr<Service>> services;
+		FlatHashMap<FamilyMaskType, Vector<Family*>> familiesByMask; // By inclusion mask, see getFamily()
+		FlatHashMap<StringId, std::shared_ptr<Service>> services;
 
-		TreeMap<FamilyMaskType, std::vector<Family*>> familyCache;
+		FlatHashMap<FamilyMaskType, std::vector<Family*>> familyCache; // Families each entity mask belongs to
+		std::array<Vector<Vector<System*>>, static_cast<int>(TimeLine::NUMBER_OF_TIMELINES)> systemBatches;
 
 		mutable std::array<StopwatchAveraging, 3> timer;
+		mutable std::array<RollingStats, 3> timeHistory;
+		mutable std::array<FrameBreakdown, 3> lastBreakdown;
+		FrameBreakdown curBreakdown; // Of the step in progress
 
 		void allocateEntity(Entity* entity);
+		void shrinkEntityStorage();
+		void doInstantiate(const Prefab& prefab, size_t n);
 		void updateEntities();
 		void initSystems() const;
 		void deleteEntity(Entity* entity);
+		void writeSnapshot(Bytes& dst) const;
+		bool loadSnapshotComponents(Entity& entity, Deserializer& s);
 
 		void updateSystems(TimeLine timeline, Time elapsed);
+		void updateSystemsParallel(TimeLine timeline, Time elapsed);
+		const Vector<Vector<System*>>& getSystemBatches(TimeLine timeline);
 		void renderSystems(RenderContext& rc) const;
 		
 		void onAddFamily(Family& family);
+		Family* tryGetFamily(FamilyMaskType mask, gsl::span<const int> layout) const;
 
-		Service& getService(const String& name) const;
+		Service& getService(StringId id) const;
 
 		const std::vector<Family*>& getFamiliesFor(const FamilyMaskType& mask);
 	};
@@ -0,0 +1,199 @@
+#include <algorithm>
+#include <cstddef>
+#include <halley/data_structures/memory_pool.h>
+#include <halley/utils/utils.h>
+#include "archetype_storage.h"
+#include "entity.h"
+#include "type_deleter.h"
+
+using namespace Halley;
+
+ArchetypeChunk::ArchetypeChunk(FamilyMaskType mask, size_t index, Vector<int> ids, uint32_t capacity)
+	: mask(mask)
+	, index(index)
+	, componentIds(std::move(ids))
+	, capacity(capacity)
+{
+	std::sort(componentIds.begin(), componentIds.end());
+
+	// One column per component type, each aligned to the largest fundamental alignment
+	for (auto id: componentIds) {
+		size_t size = ComponentDeleterTable::get(id)->getSize();
+		columnOffsets.push_back(dataSize);
+		componentSizes.push_back(size);
+		dataSize += alignUp(size * capacity, alignof(std::max_align_t));
+	}
+	data.reset(new char[std::max(dataSize, size_t(1))]);
+
+	owners.resize(capacity, nullptr);
+	freeSlots.reserve(capacity);
+	for (uint32_t i = capacity; i > 0; --i) {
+		freeSlots.push_back(i - 1);
+	}
+}
+
+ArchetypeChunk::~ArchetypeChunk()
+{
+	// Entities destroy their own components, so by now this only owns raw memory
+}
+
+bool ArchetypeChunk::owns(const void* ptr) const
+{
+	auto p = static_cast<const char*>(ptr);
+	return p >= data.get() && p < data.get() + dataSize;
+}
+
+uint32_t ArchetypeChunk::allocSlot(Entity& owner)
+{
+	Expects(!isFull());
+	uint32_t slot = freeSlots.back();
+	freeSlots.pop_back();
+	owners[slot] = &owner;
+	return slot;
+}
+
+void ArchetypeChunk::freeSlot(uint32_t slot)
+{
+	Expects(slot < capacity);
+	owners[slot] = nullptr;
+	freeSlots.push_back(slot);
+}
+
+void* ArchetypeChunk::getComponent(int componentId, uint32_t slot) const
+{
+	auto iter = std::lower_bound(componentIds.begin(), componentIds.end(), componentId);
+	Expects(iter != componentIds.end() && *iter == componentId);
+	size_t column = iter - componentIds.begin();
+	return data.get() + columnOffsets[column] + componentSizes[column] * slot;
+}
+
+ArchetypeStorage::ArchetypeStorage(uint32_t chunkCapacity)
+	: chunkCapacity(chunkCapacity)
+{
+	Expects(chunkCapacity > 0);
+}
+
+ArchetypeStorage::~ArchetypeStorage() = default;
+
+void ArchetypeStorage::relocate(Entity& entity)
+{
+	if (entity.chunk && entity.chunk->getMask() == entity.getMask()) {
+		return;
+	}
+
+	moveTo(entity, getChunkWithSpace(archetypes[entity.getMask()], entity));
+}
+
+void ArchetypeStorage::allocate(Entity& entity)
+{
+	Expects(!entity.chunk);
+
+	auto& chunk = getChunkWithSpace(archetypes[entity.getMask()], entity);
+	const uint32_t slot = chunk.allocSlot(entity);
+	for (auto& c: entity.components) {
+		c.second = static_cast<Component*>(chunk.getComponent(c.first, slot));
+	}
+	entity.chunk = &chunk;
+	entity.chunkSlot = slot;
+}
+
+void ArchetypeStorage::release(ArchetypeChunk* chunk, uint32_t slot)
+{
+	if (chunk) {
+		chunk->freeSlot(slot);
+		auto& archetype = archetypes.at(chunk->getMask());
+		archetype.firstNonFull = std::min(archetype.firstNonFull, chunk->getIndex());
+	}
+}
+
+bool ArchetypeStorage::compact(Vector<Entity*>& moved, size_t maxMoves)
+{
+	for (auto iter = archetypes.begin(); iter != archetypes.end(); ) {
+		auto& archetype = iter->second;
+		auto& chunks = archetype.chunks;
+
+		while (!chunks.empty()) {
+			auto& last = *chunks.back();
+			if (last.isEmpty()) {
+				chunks.pop_back();
+				archetype.firstNonFull = std::min(archetype.firstNonFull, chunks.size());
+				continue;
+			}
+
+			size_t live = 0;
+			for (auto& c: chunks) {
+				live += c->getLiveCount();
+			}
+			if (chunks.size() <= (live + chunkCapacity - 1) / chunkCapacity) {
+				break;
+			}
+
+			// There's room for all of these in the chunks before, and every chunk before firstNonFull is full, so they never land in last
+			for (uint32_t slot = 0; slot < last.getCapacity() && !last.isEmpty(); ++slot) {
+				if (auto entity = last.getOwner(slot)) {
+					if (maxMoves == 0) {
+						return false;
+					}
+					auto& dst = getChunkWithSpace(archetype, *entity);
+					Expects(&dst != &last);
+					moveTo(*entity, dst);
+					moved.push_back(entity);
+					--maxMoves;
+				}
+			}
+		}
+
+		if (chunks.empty()) {
+			iter = archetypes.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+	return true;
+}
+
+size_t ArchetypeStorage::getNumChunks() const
+{
+	size_t n = 0;
+	for (auto& a: archetypes) {
+		n += a.second.chunks.size();
+	}
+	return n;
+}
+
+ArchetypeChunk& ArchetypeStorage::getChunkWithSpace(Archetype& archetype, const Entity& entity)
+{
+	auto& chunks = archetype.chunks;
+	for (size_t i = archetype.firstNonFull; i < chunks.size(); ++i) {
+		if (!chunks[i]->isFull()) {
+			archetype.firstNonFull = i;
+			return *chunks[i];
+		}
+	}
+
+	Vector<int> ids;
+	ids.reserve(entity.components.size());
+	for (auto& c: entity.components) {
+		ids.push_back(c.first);
+	}
+	archetype.firstNonFull = chunks.size();
+	chunks.emplace_back(std::make_unique<ArchetypeChunk>(entity.getMask(), chunks.size(), std::move(ids), chunkCapacity));
+	return *chunks.back();
+}
+
+void ArchetypeStorage::moveTo(Entity& entity, ArchetypeChunk& chunk)
+{
+	const uint32_t slot = chunk.allocSlot(entity);
+
+	for (auto& c: entity.components) {
+		auto deleter = ComponentDeleterTable::get(c.first);
+		void* dst = chunk.getComponent(c.first, slot);
+		deleter->moveConstruct(dst, c.second);
+		entity.deleteComponent(c.second, c.first);
+		c.second = static_cast<Component*>(dst);
+	}
+
+	release(entity.chunk, entity.chunkSlot);
+	entity.chunk = &chunk;
+	entity.chunkSlot = slot;
+}
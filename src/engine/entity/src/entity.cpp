@@ -1,10 +1,13 @@
 #include <halley/data_structures/memory_pool.h>
 #include "entity.h"
 #include "world.h"
+#include "archetype_storage.h"
+#include <algorithm>
 
 using namespace Halley;
 
 Entity::Entity()
+	: componentSlots(mask.getComponentSlots())
 {
 	liveComponents = 0;
 }
@@ -19,6 +22,7 @@ Entity::~Entity()
 
 void Entity::addComponent(Component* component, int id)
 {
+	pristinePrefab = false;
 	components.push_back(std::pair<int, Component*>(id, component));
 	if (liveComponents < int(components.size())) {
 		// Swap with first non-live component
@@ -29,8 +33,9 @@ void Entity::addComponent(Component* component, int id)
 
 void Entity::removeComponentAt(int i)
 {
-	// Put it at the end and decrease live count
-	std::swap(components[i], components.back());
+	pristinePrefab = false;
+	// Put it at the end of the live ones and decrease live count
+	std::swap(components[i], components[liveComponents - 1]);
 	--liveComponents;
 }
 
@@ -38,7 +43,11 @@ void Entity::deleteComponent(Component* component, int id)
 {
 	TypeDeleterBase* deleter = ComponentDeleterTable::get(id);
 	deleter->callDestructor(component);
-	PoolPool::getPool(deleter->getSize())->free(component);
+
+	// Components living in an archetype chunk are released along with the entity's slot
+	if (!chunk || !chunk->owns(component)) {
+		deleter->getPool().free(component);
+	}
 }
 
 void Entity::onReady()
@@ -49,7 +58,7 @@ void Entity::markDirty(World& world)
 {
 	if (!dirty) {
 		dirty = true;
-		world.onEntityDirty();
+		world.onEntityDirty(*this);
 	}
 }
 
@@ -69,15 +78,22 @@ void Entity::refresh()
 		}
 		components.resize(liveComponents);
 
-		// Re-generate mask
+		// Re-generate mask, with components in the order it expects them in
+		std::sort(components.begin(), components.end(), [] (const std::pair<int, Component*>& a, const std::pair<int, Component*>& b) { return a.first < b.first; });
 		auto m = FamilyMask::RealType();
 		for (auto i : components) {
 			FamilyMask::setBit(m, i.first);
 		}
-		mask = FamilyMask::getHandle(m);
+		setMask(FamilyMask::getHandle(m));
 	}
 }
 
+void Entity::setMask(FamilyMaskType m)
+{
+	mask = m;
+	componentSlots = mask.getComponentSlots();
+}
+
 EntityId Entity::getEntityId() const
 {
 	if (!uid.isValid()) {
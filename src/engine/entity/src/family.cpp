@@ -3,14 +3,22 @@
 
 using namespace Halley;
 
-Family::Family(FamilyMaskType mask) 
+Family::Family(FamilyMaskType mask, gsl::span<const int> componentIndices)
 	: inclusionMask(mask)
+	, componentIndices(componentIndices.begin(), componentIndices.end())
 {}
 
+bool Family::hasLayout(gsl::span<const int> indices) const
+{
+	return std::equal(componentIndices.begin(), componentIndices.end(), indices.begin(), indices.end());
+}
+
 void Family::addOnEntitiesAdded(FamilyBindingBase* bind)
 {
 	addEntityCallbacks.push_back(bind);
-	bind->onEntitiesAdded(elems, elemCount);
+
+	// Whatever's already in the family is reported straight away, rather than waiting for the system to run
+	bind->addedCallback(elems, elemCount);
 }
 
 void Family::removeOnEntityAdded(FamilyBindingBase* bind)
@@ -40,6 +48,9 @@ void Family::notifyRemove(void* entities, size_t count)
 	for (auto& c: removeEntityCallbacks) {
 		c->onEntitiesRemoved(entities, count);
 	}
+	for (auto& c: addEntityCallbacks) {
+		c->discardPendingAdds(entities, count);
+	}
 }
 
 void Family::removeEntity(Entity& entity)
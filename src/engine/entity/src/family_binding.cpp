@@ -1,4 +1,5 @@
 ﻿#include "family_binding.h"
+#include <algorithm>
 
 using namespace Halley;
 
@@ -19,14 +20,91 @@ FamilyBindingBase::FamilyBindingBase(FamilyMaskType readMask, FamilyMaskType wri
 {
 }
 
-void FamilyBindingBase::onEntitiesAdded(void* entity, size_t count)
+void FamilyBindingBase::onEntitiesAdded(void* entities, size_t count)
 {
-	addedCallback(entity, count);
+	for (size_t i = 0; i < count; ++i) {
+		pendingAdds.push_back(getEntityId(entities, i));
+	}
+}
+
+void FamilyBindingBase::onEntitiesRemoved(void* entities, size_t count)
+{
+	if (pendingAdds.empty()) {
+		removedCallback(entities, count);
+		return;
+	}
+
+	// Only report the runs of entities the system has actually been told about
+	std::sort(pendingAdds.begin(), pendingAdds.end());
+	const size_t elemSize = family->getElementSize();
+	size_t runStart = 0;
+	for (size_t i = 0; i <= count; ++i) {
+		if (i == count || isPendingAdd(getEntityId(entities, i))) {
+			if (i > runStart) {
+				removedCallback(static_cast<char*>(entities) + runStart * elemSize, i - runStart);
+			}
+			runStart = i + 1;
+		}
+	}
+}
+
+void FamilyBindingBase::discardPendingAdds(void* entities, size_t count)
+{
+	if (pendingAdds.empty()) {
+		return;
+	}
+
+	std::sort(pendingAdds.begin(), pendingAdds.end());
+	for (size_t i = 0; i < count; ++i) {
+		const auto id = getEntityId(entities, i);
+		auto iter = std::lower_bound(pendingAdds.begin(), pendingAdds.end(), id);
+		if (iter != pendingAdds.end() && *iter == id) {
+			pendingAdds.erase(iter);
+		}
+	}
+}
+
+void FamilyBindingBase::flushPendingAdds()
+{
+	if (pendingAdds.empty()) {
+		return;
+	}
+
+	// New entities are appended, so they're normally one run at the back; removals may have swapped some of them further in
+	std::sort(pendingAdds.begin(), pendingAdds.end());
+	pendingAdds.erase(std::unique(pendingAdds.begin(), pendingAdds.end()), pendingAdds.end());
+	size_t remaining = pendingAdds.size();
+
+	void* elems = family->getElement(0);
+	Vector<std::pair<size_t, size_t>> runs;
+	size_t i = family->count();
+	while (i > 0 && remaining > 0) {
+		if (!isPendingAdd(getEntityId(elems, i - 1))) {
+			--i;
+			continue;
+		}
+		const size_t end = i;
+		while (i > 0 && remaining > 0 && isPendingAdd(getEntityId(elems, i - 1))) {
+			--i;
+			--remaining;
+		}
+		runs.emplace_back(i, end);
+	}
+	pendingAdds.clear();
+
+	for (auto iter = runs.rbegin(); iter != runs.rend(); ++iter) {
+		addedCallback(family->getElement(iter->first), iter->second - iter->first);
+	}
+}
+
+bool FamilyBindingBase::isPendingAdd(EntityId id) const
+{
+	return std::binary_search(pendingAdds.begin(), pendingAdds.end(), id);
 }
 
-void FamilyBindingBase::onEntitiesRemoved(void* entity, size_t count)
+EntityId FamilyBindingBase::getEntityId(void* entities, size_t index) const
 {
-	removedCallback(entity, count);
+	return reinterpret_cast<FamilyBase*>(static_cast<char*>(entities) + index * family->getElementSize())->entityId;
 }
 
 void FamilyBindingBase::setFamily(Family* f) {
@@ -1,5 +1,6 @@
 #include "family_mask.h"
 #include <unordered_set>
+#include <array>
 #include <halley/data_structures/vector.h>
 #include <functional>
 
@@ -10,10 +11,12 @@ struct MaskEntry
 {
 	RealType mask;
 	int idx;
+	std::array<uint8_t, RealType().size()> slots; // Only filled in for the stored entry, see getHandle()
 
 	MaskEntry(MaskEntry&& o) noexcept
 		: mask(std::move(o.mask))
 		, idx(o.idx)
+		, slots(o.slots)
 	{}
 
 	MaskEntry(const RealType& m, int i)
@@ -63,6 +66,10 @@ public:
 			// Not found
 			int idx = static_cast<int>(instance.values.size());
 			entry.idx = idx;
+			uint8_t next = 0;
+			for (size_t bit = 0; bit < value.size(); ++bit) {
+				entry.slots[bit] = value[bit] ? next++ : noComponentSlot;
+			}
 			auto result = instance.entries.insert(std::move(entry));
 			instance.values.push_back(const_cast<MaskEntry*>(&*result.first));
 			return idx;
@@ -72,6 +79,21 @@ public:
 		}
 	}
 
+	static const uint8_t* retrieveSlots(int handle)
+	{
+		static const auto none = [] ()
+		{
+			std::array<uint8_t, RealType().size()> slots;
+			slots.fill(noComponentSlot);
+			return slots;
+		}();
+		if (handle == -1) {
+			return none.data();
+		} else {
+			return (*getInstance()).values[handle]->slots.data();
+		}
+	}
+
 	static RealType& retrieve(int handle)
 	{
 		static RealType dummy;
@@ -139,6 +161,11 @@ const RealType& Handle::getRealValue() const
 	return MaskStorage::retrieve(value);
 }
 
+const uint8_t* Handle::getComponentSlots() const
+{
+	return MaskStorage::retrieveSlots(value);
+}
+
 bool Handle::contains(const Handle& handle) const
 {
 	auto& mine = getRealValue();
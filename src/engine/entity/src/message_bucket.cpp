@@ -0,0 +1,103 @@
+#include "message_bucket.h"
+#include <gsl/gsl_assert>
+
+using namespace Halley;
+
+MessageBucket::MessageBucket(int type, size_t messageSize)
+	: type(type)
+	, messageSize(messageSize)
+	, count(0)
+{
+	for (auto& b: blocks) {
+		b.store(nullptr);
+	}
+}
+
+MessageBucket::~MessageBucket()
+{
+	// Messages themselves are destroyed by the typed subclass, via clear()
+	for (auto& b: blocks) {
+		delete b.load();
+	}
+}
+
+EntityId MessageBucket::getTarget(size_t idx) const
+{
+	EntityId* target;
+	getData(idx, target);
+	return *target;
+}
+
+Message* MessageBucket::getMessage(size_t idx) const
+{
+	EntityId* target;
+	return toMessage(getData(idx, target));
+}
+
+void MessageBucket::clear()
+{
+	const size_t n = count.load(std::memory_order_acquire);
+	EntityId* target;
+	for (size_t i = 0; i < n; ++i) {
+		destroy(getData(i, target));
+	}
+	count.store(0, std::memory_order_release);
+}
+
+void* MessageBucket::allocate(EntityId target)
+{
+	const size_t idx = count.fetch_add(1, std::memory_order_acq_rel);
+
+	size_t blockIdx;
+	size_t offset;
+	locate(idx, blockIdx, offset);
+	Expects(blockIdx < maxBlocks);
+
+	auto& block = getBlock(blockIdx);
+	block.targets[offset] = target;
+	return block.data.get() + offset * messageSize;
+}
+
+void* MessageBucket::getData(size_t idx, EntityId*& target) const
+{
+	size_t blockIdx;
+	size_t offset;
+	locate(idx, blockIdx, offset);
+
+	auto block = blocks[blockIdx].load(std::memory_order_acquire);
+	Expects(block != nullptr);
+	target = &block->targets[offset];
+	return block->data.get() + offset * messageSize;
+}
+
+void MessageBucket::locate(size_t idx, size_t& blockIdx, size_t& offset)
+{
+	// Blocks double in size, so only a handful of steps are ever needed
+	size_t blockStart = 0;
+	size_t blockSize = firstBlockSize;
+	blockIdx = 0;
+	while (idx >= blockStart + blockSize) {
+		blockStart += blockSize;
+		blockSize *= 2;
+		++blockIdx;
+	}
+	offset = idx - blockStart;
+}
+
+MessageBucket::Block& MessageBucket::getBlock(size_t blockIdx)
+{
+	auto block = blocks[blockIdx].load(std::memory_order_acquire);
+	if (!block) {
+		// Only taken the first time a block is needed; its memory is then kept for the lifetime of the bucket
+		std::unique_lock<std::mutex> lock(blockMutex);
+		block = blocks[blockIdx].load(std::memory_order_acquire);
+		if (!block) {
+			const size_t blockSize = firstBlockSize << blockIdx;
+			block = new Block();
+			block->targets.reset(new EntityId[blockSize]);
+			block->data.reset(new char[blockSize * messageSize]);
+			blocks[blockIdx].store(block, std::memory_order_release);
+		}
+	}
+	return *block;
+}
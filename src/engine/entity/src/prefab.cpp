@@ -0,0 +1,109 @@
+#include <halley/data_structures/memory_pool.h>
+#include <halley/text/string_converter.h>
+#include "prefab.h"
+#include <algorithm>
+
+using namespace Halley;
+
+Prefab::Prefab() = default;
+
+Prefab::Prefab(gsl::span<const gsl::byte> data)
+{
+	Deserializer s(data);
+	uint16_t nComponents;
+	s >> nComponents;
+
+	for (int i = 0; i < int(nComponents); ++i) {
+		int32_t id;
+		s >> id;
+		auto deleter = ComponentDeleterTable::tryGet(id);
+		if (!deleter) {
+			throw Exception("Prefab has unknown component " + toString(id), HalleyExceptions::Entity);
+		}
+
+		auto component = deleter->create();
+		deleter->deserialize(s, component);
+		addComponent(id, component);
+	}
+}
+
+Prefab::~Prefab()
+{
+	clear();
+}
+
+Prefab::Prefab(Prefab&& other) noexcept
+	: components(std::move(other.components))
+	, mask(other.mask)
+{
+	other.components.clear();
+}
+
+Prefab& Prefab::operator=(Prefab&& other) noexcept
+{
+	if (this != &other) {
+		clear();
+		components = std::move(other.components);
+		mask = other.mask;
+		other.components.clear();
+	}
+	return *this;
+}
+
+Bytes Prefab::serialize() const
+{
+	auto write = [&] (Serializer& s)
+	{
+		s << uint16_t(components.size());
+		for (auto& c: components) {
+			s << int32_t(c.id);
+			c.deleter->serialize(s, c.data);
+		}
+	};
+
+	Serializer dry;
+	write(dry);
+	Bytes result(dry.getSize());
+	Serializer s(gsl::as_writeable_bytes(gsl::span<Byte>(result)));
+	write(s);
+	return result;
+}
+
+void Prefab::addComponent(int id, void* data)
+{
+	auto deleter = ComponentDeleterTable::get(id);
+	if (!deleter->isCopyConstructible()) {
+		deleter->callDestructor(data);
+		deleter->getPool().free(data);
+		throw Exception("Component " + toString(id) + " can't be copied, so it can't be in a prefab.", HalleyExceptions::Entity);
+	}
+
+	// Adding the same component twice replaces it
+	for (auto& c: components) {
+		if (c.id == id) {
+			c.deleter->callDestructor(c.data);
+			c.pool->free(c.data);
+			c.data = data;
+			return;
+		}
+	}
+
+	const auto size = deleter->getSize();
+	auto pos = std::find_if(components.begin(), components.end(), [&] (const ComponentTemplate& c) { return c.id > id; }); // Sorted, like entities'
+	components.insert(pos, ComponentTemplate{ id, deleter, &deleter->getPool(), data, size, deleter->isTriviallyCopyable() });
+
+	auto m = FamilyMask::RealType();
+	for (auto& c: components) {
+		FamilyMask::setBit(m, c.id);
+	}
+	mask = FamilyMask::getHandle(m);
+}
+
+void Prefab::clear()
+{
+	for (auto& c: components) {
+		c.deleter->callDestructor(c.data);
+		c.pool->free(c.data);
+	}
+	components.clear();
+}
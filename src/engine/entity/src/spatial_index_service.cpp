@@ -0,0 +1,95 @@
+#include "spatial_index_service.h"
+#include <halley/concurrency/concurrent.h>
+
+using namespace Halley;
+
+SpatialIndexService::SpatialIndexService(float minCellSize)
+	: grid(minCellSize)
+{
+}
+
+void SpatialIndexService::beginSync()
+{
+	++syncId;
+}
+
+void SpatialIndexService::endSync()
+{
+	for (auto& e: entries) {
+		if (e.second.lastSync != syncId) {
+			toRemove.push_back(e.first);
+		}
+	}
+	for (auto& id: toRemove) {
+		remove(id);
+	}
+	toRemove.clear();
+}
+
+void SpatialIndexService::setBounds(EntityId entity, Rect4f bounds)
+{
+	auto iter = entries.find(entity);
+	if (iter == entries.end()) {
+		entries[entity] = Entry{ grid.add(bounds, entity), syncId };
+	} else {
+		grid.update(iter->second.handle, bounds);
+		iter->second.lastSync = syncId;
+	}
+}
+
+void SpatialIndexService::remove(EntityId entity)
+{
+	auto iter = entries.find(entity);
+	if (iter != entries.end()) {
+		grid.remove(iter->second.handle);
+		entries.erase(iter);
+	}
+}
+
+void SpatialIndexService::clear()
+{
+	grid.clear();
+	entries.clear();
+}
+
+size_t SpatialIndexService::size() const
+{
+	return grid.size();
+}
+
+void SpatialIndexService::query(Rect4f rect, Vector<EntityId>& results) const
+{
+	grid.query(rect, results);
+}
+
+void SpatialIndexService::queryRadius(Vector2f centre, float radius, Vector<EntityId>& results) const
+{
+	grid.queryRadius(centre, radius, results);
+}
+
+void SpatialIndexService::queryRay(Vector2f origin, Vector2f dir, float maxDistance, Vector<std::pair<float, EntityId>>& results) const
+{
+	grid.queryRay(origin, dir, maxDistance, results);
+}
+
+void SpatialIndexService::queryFrustum(const Polygon& frustum, Vector<EntityId>& results) const
+{
+	grid.queryPolygon(frustum, results);
+}
+
+void SpatialIndexService::queryBatch(gsl::span<const Rect4f> rects, Vector<Vector<EntityId>>& results) const
+{
+	const size_t n = size_t(rects.size());
+	results.resize(n);
+
+	Vector<size_t> indices(n);
+	for (size_t i = 0; i < n; ++i) {
+		indices[i] = i;
+		results[i].clear();
+	}
+
+	Concurrent::foreach(Executors::getCPU(), indices.begin(), indices.end(), [&] (size_t i)
+	{
+		grid.query(rects[i], results[i]);
+	});
+}
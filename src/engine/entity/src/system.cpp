@@ -1,13 +1,35 @@
 #include "system.h"
-#include <halley/data_structures/flat_map.h>
+#include "world.h"
 #include "halley/support/debug.h"
+#include "halley/support/profiler.h"
 
 using namespace Halley;
 
-System::System(std::initializer_list<FamilyBindingBase*> uninitializedFamilies, std::initializer_list<int> messageTypesReceived)
+namespace {
+	// The parallel chunk running on this thread, if any. A chunk can end up running another system's chunks while it waits
+	// on a nested foreach, so this is saved and restored rather than just cleared.
+	struct CurrentChunk
+	{
+		const System* system = nullptr;
+		void* chunk = nullptr;
+	};
+	thread_local CurrentChunk currentChunk;
+}
+
+System::System(std::initializer_list<FamilyBindingBase*> uninitializedFamilies, std::initializer_list<int> messageTypesReceived, std::initializer_list<int> messageTypesSent, SystemConcurrency concurrency)
 	: families(uninitializedFamilies)
 	, messageTypesReceived(messageTypesReceived)
+	, messageTypesSent(messageTypesSent)
+	, outboxCount(0)
+	, concurrency(concurrency)
+{
+}
+
+void System::setName(String n)
 {
+	name = n;
+	profilerName = Profiler::intern(name);
+	memoryTag = MemoryTracker::registerTag("system:" + name);
 }
 
 size_t System::getEntityCount() const
@@ -32,6 +54,43 @@ void System::setCollectSamples(bool collect)
 	collectSamples = collect;
 }
 
+bool System::conflictsWith(const System& other) const
+{
+	if (concurrency == SystemConcurrency::Exclusive || other.concurrency == SystemConcurrency::Exclusive) {
+		return true;
+	}
+
+	// Read masks include every component accessed, write masks only the mutable ones
+	if ((getWriteMask() & other.getReadMask()).any() || (other.getWriteMask() & getReadMask()).any()) {
+		return true;
+	}
+
+	// Messages are dispatched and purged between batches, so senders and receivers must keep their order
+	auto sharesMessages = [] (const Vector<int>& sent, const Vector<int>& received)
+	{
+		return std::find_first_of(sent.begin(), sent.end(), received.begin(), received.end()) != sent.end();
+	};
+	return sharesMessages(messageTypesSent, other.messageTypesReceived) || sharesMessages(other.messageTypesSent, messageTypesReceived);
+}
+
+FamilyMask::RealType System::getReadMask() const
+{
+	FamilyMask::RealType result;
+	for (auto f : families) {
+		result |= f->readMask.getRealValue();
+	}
+	return result;
+}
+
+FamilyMask::RealType System::getWriteMask() const
+{
+	FamilyMask::RealType result;
+	for (auto f : families) {
+		result |= f->writeMask.getRealValue();
+	}
+	return result;
+}
+
 void System::onAddedToWorld(World& w, int id) {
 	world = &w;
 	systemId = id;
@@ -42,103 +101,240 @@ void System::onAddedToWorld(World& w, int id) {
 
 void System::purgeMessages()
 {
-	if (messagesSentTo.size() > 0) {
-		for (auto& target: messagesSentTo) {
-			// Purge all messages of this age
-			Entity* entity = world->tryGetEntity(target);
-
-			if (entity) {
-				auto& inbox = entity->inbox;
-				inbox.erase(std::remove_if(inbox.begin(), inbox.end(), [&] (const MessageEntry& e) { return e.age == systemId; }), inbox.end());
-			}
-		}
-		messagesSentTo.clear();
+	// Messages live until their sender runs again
+	const size_t n = outboxCount.load(std::memory_order_acquire);
+	for (size_t i = 0; i < n; ++i) {
+		outbox[i]->clear();
 	}
 }
 
 void System::processMessages()
 {
-	// This whole method is probably very inefficient.
-	struct MessageBox
-	{
-		Vector<Message*> msg;
-		Vector<size_t> elemIdx;
-	};
-	FlatMap<int, MessageBox> inboxes;
-
-	if (!families.empty()) {
-		auto& fam = *families[0];
-		size_t sz = fam.count();
-		for (size_t i = 0; i < sz; i++) {
-			FamilyBase* elem = reinterpret_cast<FamilyBase*>(fam.getElement(i));
-			Entity* entity = world->tryGetEntity(elem->entityId);
-			if (entity) {
-				for (const auto& msg: entity->inbox) {
-					if (std::find(messageTypesReceived.begin(), messageTypesReceived.end(), msg.type) != messageTypesReceived.end()) {
-						auto& inbox = inboxes[msg.type];
-						inbox.msg.emplace_back(msg.msg.get());
-						inbox.elemIdx.emplace_back(i);
+	if (families.empty()) {
+		return;
+	}
+	auto& fam = *families[0];
+
+	for (int type: messageTypesReceived) {
+		inboxMessages.clear();
+		inboxElems.clear();
+
+		for (int tl = 0; tl < int(TimeLine::NUMBER_OF_TIMELINES); ++tl) {
+			for (auto& sender: world->getSystems(TimeLine(tl))) {
+				auto bucket = sender->tryGetOutbox(type);
+				if (!bucket || bucket->empty()) {
+					continue;
+				}
+
+				// Only built when there are messages to deliver
+				if (inboxElemLookup.empty()) {
+					const size_t sz = fam.count();
+					for (size_t i = 0; i < sz; i++) {
+						inboxElemLookup[reinterpret_cast<FamilyBase*>(fam.getElement(i))->entityId] = i;
 					}
 				}
+
+				const size_t n = bucket->size();
+				for (size_t i = 0; i < n; ++i) {
+					auto iter = inboxElemLookup.find(bucket->getTarget(i));
+					if (iter != inboxElemLookup.end()) {
+						inboxMessages.push_back(bucket->getMessage(i));
+						inboxElems.push_back(iter->second);
+					}
+				}
+			}
+		}
+
+		if (!inboxMessages.empty()) {
+			onMessagesReceived(type, inboxMessages.data(), inboxElems.data(), inboxMessages.size());
+		}
+	}
+
+	inboxElemLookup.clear();
+}
+
+MessageBucket& System::getOutbox(int msgType, std::unique_ptr<MessageBucket>(*createBucket)())
+{
+	// Only one thread runs each chunk, so its outbox needs no locking
+	auto chunk = tryGetCurrentChunk();
+	if (chunk) {
+		for (size_t i = 0; i < chunk->outboxCount; ++i) {
+			if (chunk->outbox[i]->getType() == msgType) {
+				return *chunk->outbox[i];
 			}
 		}
-		for (auto& iter : inboxes) {
-			int id = iter.first;
-			auto& inbox = iter.second;
-			onMessagesReceived(id, inbox.msg.data(), inbox.elemIdx.data(), inbox.msg.size());
+		if (chunk->outboxCount == maxOutboxes) {
+			throw Exception("Too many message types sent by system " + name, HalleyExceptions::Entity);
+		}
+		chunk->outbox[chunk->outboxCount] = createBucket();
+		return *chunk->outbox[chunk->outboxCount++];
+	}
+
+	auto bucket = tryGetOutbox(msgType);
+	if (bucket) {
+		return *bucket;
+	}
+	return addOutbox(createBucket());
+}
+
+MessageBucket& System::addOutbox(std::unique_ptr<MessageBucket> bucket)
+{
+	const int msgType = bucket->getType();
+	std::unique_lock<std::mutex> lock(outboxMutex);
+	const size_t n = outboxCount.load(std::memory_order_acquire);
+	for (size_t i = 0; i < n; ++i) {
+		if (outbox[i]->getType() == msgType) {
+			return *outbox[i];
+		}
+	}
+	if (n == maxOutboxes) {
+		throw Exception("Too many message types sent by system " + name, HalleyExceptions::Entity);
+	}
+	outbox[n] = std::move(bucket);
+	outboxCount.store(n + 1, std::memory_order_release);
+	return *outbox[n];
+}
+
+MessageBucket* System::tryGetOutbox(int msgType) const
+{
+	const size_t n = outboxCount.load(std::memory_order_acquire);
+	for (size_t i = 0; i < n; ++i) {
+		if (outbox[i]->getType() == msgType) {
+			return outbox[i].get();
 		}
 	}
+	return nullptr;
 }
 
-void System::doSendMessage(EntityId entityId, std::unique_ptr<Message> msg, size_t, int id)
+void System::beginParallelChunks(size_t nChunks)
 {
-	outbox.emplace_back(std::make_pair(entityId, MessageEntry(std::move(msg), id, systemId)));
+	while (parallelChunks.size() < nChunks) {
+		parallelChunks.push_back(std::make_unique<ParallelChunk>());
+	}
 }
 
-void System::dispatchMessages()
+void System::endParallelChunks(size_t nChunks)
 {
-	if (!outbox.empty()) {
-		for (auto& o: outbox) {
-			Entity* entity = world->tryGetEntity(o.first);
-			if (entity) {
-				entity->inbox.emplace_back(std::move(o.second));
-				messagesSentTo.push_back(o.first);
+	for (size_t i = 0; i < nChunks; ++i) {
+		auto& chunk = *parallelChunks[i];
+		for (size_t j = 0; j < chunk.outboxCount; ++j) {
+			auto& src = *chunk.outbox[j];
+			if (!src.empty()) {
+				auto dst = tryGetOutbox(src.getType());
+				if (!dst) {
+					dst = &addOutbox(src.makeEmpty());
+				}
+				dst->moveFrom(src);
 			}
 		}
-		outbox.clear();
 	}
 }
 
+Time System::beginSmearedStep(size_t nSlices, Time time, size_t& slice)
+{
+	Expects(nSlices > 0);
+	if (smearedTime.size() != nSlices) {
+		smearedTime.clear();
+		smearedTime.resize(nSlices, 0);
+		smearedSlice = 0;
+	}
+
+	for (auto& t: smearedTime) {
+		t += time;
+	}
+	slice = smearedSlice;
+	smearedSlice = (smearedSlice + 1) % nSlices;
+
+	const Time elapsed = smearedTime[slice];
+	smearedTime[slice] = 0;
+	return elapsed;
+}
+
+System::ParallelChunk& System::getCurrentChunk() const
+{
+	auto chunk = tryGetCurrentChunk();
+	if (!chunk) {
+		throw Exception("System " + name + " is not running a parallel chunk on this thread", HalleyExceptions::Entity);
+	}
+	return *chunk;
+}
+
+System::ParallelChunk* System::tryGetCurrentChunk() const
+{
+	return currentChunk.system == this ? static_cast<ParallelChunk*>(currentChunk.chunk) : nullptr;
+}
+
+System::ParallelChunkScope::ParallelChunkScope(System& system, size_t chunk)
+	: prevSystem(currentChunk.system)
+	, prevChunk(static_cast<ParallelChunk*>(currentChunk.chunk))
+{
+	currentChunk.system = &system;
+	currentChunk.chunk = system.parallelChunks[chunk].get();
+}
+
+System::ParallelChunkScope::~ParallelChunkScope()
+{
+	currentChunk.system = prevSystem;
+	currentChunk.chunk = prevChunk;
+}
+
 void System::doUpdate(Time time) {
+	purgeMessages();
+	runUpdate(time);
+}
+
+void System::runUpdate(Time time) {
+	if (!runDuringResimulation && world->isResimulating()) {
+		return;
+	}
+
 	HALLEY_DEBUG_TRACE_COMMENT(name.c_str());
+	ProfilerScope profilerScope(profilerName);
+	MemoryTagScope memoryScope(memoryTag);
 	if (collectSamples) {
 		timer.beginSample();
 	}
 
-	purgeMessages();
+	for (auto f: families) {
+		f->flushPendingAdds();
+	}
+
 	if (!messageTypesReceived.empty()) {
-		processMessages();
+		if (collectSamples) {
+			Stopwatch messageTimer;
+			processMessages();
+			messagesNs = messageTimer.elapsedNanoSeconds();
+		} else {
+			processMessages();
+		}
 	}
 	
 	updateBase(time);
-	dispatchMessages();
 
 	if (collectSamples) {
 		timer.endSample();
+		timeHistory.add(timer.lastElapsedNanoSeconds());
 	}
 	HALLEY_DEBUG_TRACE_COMMENT(name.c_str());
 }
 
 void System::doRender(RenderContext& rc) {
 	HALLEY_DEBUG_TRACE_COMMENT(name.c_str());
+	ProfilerScope profilerScope(profilerName);
+	MemoryTagScope memoryScope(memoryTag);
 	if (collectSamples) {
 		timer.beginSample();
 	}
 
+	for (auto f: families) {
+		f->flushPendingAdds();
+	}
+
 	renderBase(rc);
 
 	if (collectSamples) {
 		timer.endSample();
+		timeHistory.add(timer.lastElapsedNanoSeconds());
 	}
 	HALLEY_DEBUG_TRACE_COMMENT(name.c_str());
 }
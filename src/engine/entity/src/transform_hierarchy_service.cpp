@@ -0,0 +1,304 @@
+#include "transform_hierarchy_service.h"
+#include <halley/concurrency/concurrent.h>
+#include <halley/support/exception.h>
+#include <numeric>
+
+using namespace Halley;
+
+namespace {
+	constexpr size_t minParallelLevel = 2048;
+	constexpr size_t parallelGrain = 512;
+
+	template <typename T>
+	void permute(Vector<T>& values, const Vector<uint32_t>& newOrder)
+	{
+		Vector<T> result;
+		result.reserve(newOrder.size());
+		for (auto i: newOrder) {
+			result.push_back(values[i]);
+		}
+		values = std::move(result);
+	}
+}
+
+TransformHierarchyService::TransformHierarchyService()
+{
+	levelStart.push_back(0);
+}
+
+void TransformHierarchyService::add(EntityId entity, const Transform2D& local, EntityId parent)
+{
+	if (contains(entity)) {
+		throw Exception("Entity " + entity.toString() + " is already in the transform hierarchy.", HalleyExceptions::Entity);
+	}
+
+	const uint32_t parentIdx = parent.isValid() ? getIndex(parent) : noParent;
+	const auto idx = uint32_t(ids.size());
+	indices[entity] = idx;
+	ids.push_back(entity);
+	parents.push_back(parentIdx);
+	dirty.push_back(1);
+	removed.push_back(0);
+	changedFlags.push_back(0);
+
+	posX.push_back(local.position.x);
+	posY.push_back(local.position.y);
+	rotation.push_back(local.rotation.getRadians());
+	scaleX.push_back(local.scale.x);
+	scaleY.push_back(local.scale.y);
+
+	const Affine2D identity;
+	worldA.push_back(identity.a);
+	worldB.push_back(identity.b);
+	worldC.push_back(identity.c);
+	worldD.push_back(identity.d);
+	worldX.push_back(identity.tx);
+	worldY.push_back(identity.ty);
+
+	structureDirty = true;
+}
+
+void TransformHierarchyService::remove(EntityId entity)
+{
+	auto iter = indices.find(entity);
+	if (iter != indices.end()) {
+		// Children get detached in rebuild(), rather than searching for them here
+		removed[iter->second] = 1;
+		indices.erase(iter);
+		structureDirty = true;
+	}
+}
+
+void TransformHierarchyService::clear()
+{
+	*this = TransformHierarchyService();
+}
+
+bool TransformHierarchyService::contains(EntityId entity) const
+{
+	return indices.find(entity) != indices.end();
+}
+
+size_t TransformHierarchyService::size() const
+{
+	return indices.size();
+}
+
+void TransformHierarchyService::setParent(EntityId entity, EntityId parent)
+{
+	const auto idx = getIndex(entity);
+	const uint32_t parentIdx = parent.isValid() ? getIndex(parent) : noParent;
+	for (auto p = parentIdx; p != noParent; p = parents[p]) {
+		if (p == idx) {
+			throw Exception("Making " + parent.toString() + " the parent of " + entity.toString() + " would create a cycle.", HalleyExceptions::Entity);
+		}
+	}
+
+	if (parents[idx] != parentIdx) {
+		parents[idx] = parentIdx;
+		dirty[idx] = 1;
+		structureDirty = true;
+	}
+}
+
+EntityId TransformHierarchyService::getParent(EntityId entity) const
+{
+	const auto p = parents[getIndex(entity)];
+	return p == noParent || removed[p] ? EntityId() : ids[p];
+}
+
+void TransformHierarchyService::setLocal(EntityId entity, const Transform2D& local)
+{
+	const auto i = getIndex(entity);
+	posX[i] = local.position.x;
+	posY[i] = local.position.y;
+	rotation[i] = local.rotation.getRadians();
+	scaleX[i] = local.scale.x;
+	scaleY[i] = local.scale.y;
+	dirty[i] = 1;
+}
+
+Transform2D TransformHierarchyService::getLocal(EntityId entity) const
+{
+	const auto i = getIndex(entity);
+	return Transform2D(Vector2f(posX[i], posY[i]), Angle1f::fromRadians(rotation[i]), Vector2f(scaleX[i], scaleY[i]));
+}
+
+void TransformHierarchyService::update()
+{
+	if (structureDirty) {
+		rebuild();
+	}
+
+	std::fill(changedFlags.begin(), changedFlags.end(), char(0));
+
+	// Parents are always on an earlier level, so each level only reads what the previous ones have finished writing
+	for (size_t level = 0; level + 1 < levelStart.size(); ++level) {
+		const auto start = order.begin() + levelStart[level];
+		const auto end = order.begin() + levelStart[level + 1];
+		if (size_t(end - start) >= minParallelLevel) {
+			Concurrent::foreach(Executors::getCPU(), start, end, [this] (uint32_t i)
+			{
+				updateNode(i);
+			}, parallelGrain);
+		} else {
+			for (auto i = start; i != end; ++i) {
+				updateNode(*i);
+			}
+		}
+	}
+
+	changed.clear();
+	for (size_t i = 0; i < changedFlags.size(); ++i) {
+		if (changedFlags[i]) {
+			changed.push_back(ids[i]);
+		}
+	}
+}
+
+Affine2D TransformHierarchyService::getWorld(EntityId entity) const
+{
+	const auto i = getIndex(entity);
+	return Affine2D(worldA[i], worldB[i], worldC[i], worldD[i], worldX[i], worldY[i]);
+}
+
+Transform2D TransformHierarchyService::getWorldTransform(EntityId entity) const
+{
+	return getWorld(entity).decompose();
+}
+
+Vector2f TransformHierarchyService::getWorldPosition(EntityId entity) const
+{
+	const auto i = getIndex(entity);
+	return Vector2f(worldX[i], worldY[i]);
+}
+
+const Vector<EntityId>& TransformHierarchyService::getChanged() const
+{
+	return changed;
+}
+
+uint32_t TransformHierarchyService::getIndex(EntityId entity) const
+{
+	const auto iter = indices.find(entity);
+	if (iter == indices.end()) {
+		throw Exception("Entity " + entity.toString() + " is not in the transform hierarchy.", HalleyExceptions::Entity);
+	}
+	return iter->second;
+}
+
+void TransformHierarchyService::rebuild()
+{
+	const auto n = uint32_t(ids.size());
+
+	// Orphans of removed nodes become roots
+	for (uint32_t i = 0; i < n; ++i) {
+		if (!removed[i] && parents[i] != noParent && removed[parents[i]]) {
+			parents[i] = noParent;
+			dirty[i] = 1;
+		}
+	}
+
+	// Depth of each node, filling in whole chains at once so it stays linear
+	constexpr uint32_t unknown = uint32_t(-1);
+	Vector<uint32_t> depth(n, unknown);
+	Vector<uint32_t> chain;
+	uint32_t maxDepth = 0;
+	for (uint32_t i = 0; i < n; ++i) {
+		if (removed[i] || depth[i] != unknown) {
+			continue;
+		}
+		uint32_t cur = i;
+		while (cur != noParent && depth[cur] == unknown) {
+			chain.push_back(cur);
+			cur = parents[cur];
+		}
+		uint32_t d = cur == noParent ? 0 : depth[cur] + 1;
+		for (auto iter = chain.rbegin(); iter != chain.rend(); ++iter) {
+			depth[*iter] = d++;
+		}
+		maxDepth = std::max(maxDepth, d - 1);
+		chain.clear();
+	}
+
+	// Counting sort by depth, which keeps the previous relative order within each level
+	levelStart.assign(maxDepth + 2, 0);
+	for (uint32_t i = 0; i < n; ++i) {
+		if (!removed[i]) {
+			++levelStart[depth[i] + 1];
+		}
+	}
+	std::partial_sum(levelStart.begin(), levelStart.end(), levelStart.begin());
+	if (levelStart.back() == 0) {
+		levelStart.assign(1, 0);
+	}
+
+	Vector<uint32_t> newOrder(levelStart.back());
+	Vector<uint32_t> remap(n, noParent);
+	{
+		Vector<uint32_t> next(levelStart.begin(), levelStart.end());
+		for (uint32_t i = 0; i < n; ++i) {
+			if (!removed[i]) {
+				const auto pos = next[depth[i]]++;
+				newOrder[pos] = i;
+				remap[i] = pos;
+			}
+		}
+	}
+
+	permute(ids, newOrder);
+	permute(parents, newOrder);
+	permute(dirty, newOrder);
+	permute(posX, newOrder);
+	permute(posY, newOrder);
+	permute(rotation, newOrder);
+	permute(scaleX, newOrder);
+	permute(scaleY, newOrder);
+	permute(worldA, newOrder);
+	permute(worldB, newOrder);
+	permute(worldC, newOrder);
+	permute(worldD, newOrder);
+	permute(worldX, newOrder);
+	permute(worldY, newOrder);
+
+	const auto newN = uint32_t(newOrder.size());
+	for (auto& p: parents) {
+		if (p != noParent) {
+			p = remap[p];
+		}
+	}
+	removed.assign(newN, 0);
+	changedFlags.assign(newN, 0);
+	order.resize(newN);
+	std::iota(order.begin(), order.end(), uint32_t(0));
+
+	indices.clear();
+	for (uint32_t i = 0; i < newN; ++i) {
+		indices[ids[i]] = i;
+	}
+
+	structureDirty = false;
+}
+
+void TransformHierarchyService::updateNode(uint32_t i)
+{
+	const auto p = parents[i];
+	const bool parentChanged = p != noParent && changedFlags[p];
+	if (!dirty[i] && !parentChanged) {
+		return;
+	}
+
+	Affine2D world(Transform2D(Vector2f(posX[i], posY[i]), Angle1f::fromRadians(rotation[i]), Vector2f(scaleX[i], scaleY[i])));
+	if (p != noParent) {
+		world = Affine2D(worldA[p], worldB[p], worldC[p], worldD[p], worldX[p], worldY[p]) * world;
+	}
+
+	worldA[i] = world.a;
+	worldB[i] = world.b;
+	worldC[i] = world.c;
+	worldD[i] = world.d;
+	worldX[i] = world.tx;
+	worldY[i] = world.ty;
+	dirty[i] = 0;
+	changedFlags[i] = 1;
+}
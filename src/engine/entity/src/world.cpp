@@ -1,25 +1,40 @@
 #include <iostream>
 #include <chrono>
+#include <cstring>
+#include <algorithm>
 #include <halley/support/exception.h>
 #include <halley/data_structures/memory_pool.h>
 #include <halley/utils/utils.h>
 #include "world.h"
 #include "system.h"
 #include "family.h"
+#include "archetype_storage.h"
+#include "prefab.h"
 #include "halley/text/string_converter.h"
 #include "halley/support/debug.h"
 #include "halley/file_formats/config_file.h"
+#include "halley/concurrency/concurrent.h"
+#include "halley/maths/random.h"
+#include "halley/utils/hash.h"
 
 using namespace Halley;
 
 World::World(const HalleyAPI* api, bool collectMetrics)
 	: api(api)
 	, collectMetrics(collectMetrics)
-{	
+	, randomSeed(Random::getGlobal().getRawInt() | (uint64_t(Random::getGlobal().getRawInt()) << 32))
+{
+	if (collectMetrics) {
+		Telemetry::addSource(*this);
+	}
 }
 
 World::~World()
 {
+	if (collectMetrics && !tearingDown) {
+		Telemetry::removeSource(*this);
+	}
+
 	for (auto& f: families) {
 		//f.second->clearEntities();
 		f->clearEntities();
@@ -34,9 +49,44 @@ World::~World()
 		deleteEntity(e);
 	}
 	families.clear();
+	familiesByMask.clear();
+	familyCache.clear();
 	services.clear();
 }
 
+bool World::destroyIncrementally(Time maxTime)
+{
+	// Systems and families go first, as in the destructor, so nothing is left looking at entities as they're deleted
+	if (!tearingDown) {
+		tearingDown = true;
+		if (collectMetrics) {
+			Telemetry::removeSource(*this);
+		}
+		for (auto& f: families) {
+			f->clearEntities();
+		}
+		for (auto& tl: systems) {
+			tl.clear();
+		}
+	}
+
+	// A batch at a time, as checking the clock for each would cost more than most entities take
+	constexpr size_t batchSize = 256;
+	const auto start = std::chrono::steady_clock::now();
+	for (auto* list: { &entitiesPendingCreation, &entities }) {
+		while (!list->empty()) {
+			for (size_t i = std::min(batchSize, list->size()); i > 0; --i) {
+				deleteEntity(list->back());
+				list->pop_back();
+			}
+			if (std::chrono::duration<Time>(std::chrono::steady_clock::now() - start).count() >= maxTime) {
+				return entitiesPendingCreation.empty() && entities.empty();
+			}
+		}
+	}
+	return true;
+}
+
 System& World::addSystem(std::unique_ptr<System> system, TimeLine timelineType)
 {
 	system->api = api;
@@ -45,15 +95,18 @@ System& World::addSystem(std::unique_ptr<System> system, TimeLine timelineType)
 	auto& timeline = getSystems(timelineType);
 	timeline.emplace_back(std::move(system));
 	ref.onAddedToWorld(*this, int(timeline.size()));
+	systemBatches[int(timelineType)].clear();
 	return ref;
 }
 
 void World::removeSystem(System& system)
 {
-	for (auto& sys : systems) {
+	for (size_t tl = 0; tl < systems.size(); tl++) {
+		auto& sys = systems[tl];
 		for (size_t i = 0; i < sys.size(); i++) {
 			if (sys[i].get() == &system) {
 				sys.erase(sys.begin() + i);
+				systemBatches[tl].clear();
 				return;
 			}
 		}
@@ -102,11 +155,11 @@ System& World::getSystem(const String& name)
 Service& World::addService(std::shared_ptr<Service> service)
 {
 	auto& ref = *service;
-	services[service->getName()] = std::move(service);
+	services[StringId(service->getName())] = std::move(service);
 	return ref;
 }
 
-void World::loadSystems(const ConfigNode& root, std::function<std::unique_ptr<System>(String)> createFunction)
+void World::loadSystems(const ConfigNode& root, std::function<std::unique_ptr<System>(String)> createFunction, bool renderSystems)
 {
 	auto timelines = root["timelines"].asMap();
 	for (auto iter = timelines.begin(); iter != timelines.end(); ++iter) {
@@ -121,6 +174,9 @@ void World::loadSystems(const ConfigNode& root, std::function<std::unique_ptr<Sy
 		} else {
 			throw Exception("Unknown timeline: " + timelineName, HalleyExceptions::Entity);
 		}
+		if (timeline == TimeLine::Render && !renderSystems) {
+			continue;
+		}
 
 		for (auto& sysName: iter->second) {
 			String name = sysName.asString();
@@ -129,11 +185,11 @@ void World::loadSystems(const ConfigNode& root, std::function<std::unique_ptr<Sy
 	}
 }
 
-Service& World::getService(const String& name) const
+Service& World::getService(StringId id) const
 {
-	auto iter = services.find(name);
+	auto iter = services.find(id);
 	if (iter == services.end()) {
-		throw Exception("Service not found: " + name, HalleyExceptions::Entity);
+		throw Exception("Service not found: " + id.getString(), HalleyExceptions::Entity);
 	}
 	return *iter->second;
 }
@@ -149,11 +205,77 @@ EntityRef World::createEntity()
 	return EntityRef(*entity, *this);
 }
 
+Vector<EntityId> World::instantiate(const Prefab& prefab, size_t n)
+{
+	Vector<EntityId> ids;
+	ids.reserve(n);
+	const size_t first = instantiated.size();
+	doInstantiate(prefab, n);
+	for (size_t i = 0; i < n; ++i) {
+		ids.push_back(instantiated[first + i]->getEntityId());
+	}
+	return ids;
+}
+
+void World::doInstantiate(const Prefab& prefab, size_t n)
+{
+	HALLEY_DEBUG_TRACE();
+	auto& templates = prefab.components;
+	const size_t nComponents = templates.size();
+	entitiesPendingCreation.reserve(entitiesPendingCreation.size() + n);
+	instantiated.reserve(instantiated.size() + n);
+
+	for (size_t i = 0; i < n; ++i) {
+		Entity* entity = new(PoolAllocator<Entity>::alloc()) Entity();
+		if (entity == nullptr) {
+			throw Exception("Error creating entity - out of memory?", HalleyExceptions::Entity);
+		}
+		allocateEntity(entity);
+
+		// Dirty from the start, so nothing else queues it for a refresh; updateEntities() picks it up from instantiated instead
+		entity->components.resize(nComponents);
+		for (size_t j = 0; j < nComponents; ++j) {
+			entity->components[j] = std::make_pair(templates[j].id, static_cast<Component*>(nullptr));
+		}
+		entity->liveComponents = int(nComponents);
+		entity->setMask(prefab.mask); // Prefab components are kept sorted, so this matches
+		entity->dirty = true;
+		entity->pristinePrefab = true;
+
+		// Straight into their archetype chunk, if enabled, so they don't have to be relocated later
+		if (useArchetypeStorage) {
+			archetypeStorage->allocate(*entity);
+		}
+		for (size_t j = 0; j < nComponents; ++j) {
+			auto& t = templates[j];
+			auto& dst = entity->components[j].second;
+			if (!dst) {
+				dst = static_cast<Component*>(t.pool->alloc());
+			}
+			if (t.trivial) {
+				memcpy(dst, t.data, t.size);
+			} else {
+				t.deleter->copyConstruct(dst, t.data);
+			}
+		}
+
+		entitiesPendingCreation.push_back(entity);
+		instantiated.push_back(entity);
+	}
+
+	entityDirty = true;
+	HALLEY_DEBUG_TRACE();
+}
+
 void World::destroyEntity(EntityId id)
 {
 	auto e = tryGetEntity(id);
 	if (e) {
+		const bool wasDirty = e->needsRefresh();
 		e->destroy();
+		if (!wasDirty) {
+			dirtyEntities.push_back(e);
+		}
 		entityDirty = true;
 	}
 }
@@ -181,18 +303,349 @@ size_t World::numEntities() const
 	return entities.size();
 }
 
-void World::onEntityDirty()
+void World::onEntityDirty(Entity& entity)
 {
+	dirtyEntities.push_back(&entity);
 	entityDirty = true;
 }
 
+void World::setArchetypeStorage(bool enabled)
+{
+	useArchetypeStorage = enabled;
+	if (enabled && !archetypeStorage) {
+		// Never destroyed before the world, since entities might still live in it after disabling
+		archetypeStorage = std::make_unique<ArchetypeStorage>();
+	}
+}
+
+bool World::hasArchetypeStorage() const
+{
+	return useArchetypeStorage;
+}
+
+bool World::compactStorage(Time maxTime)
+{
+	if (entityDirty || !entitiesPendingCreation.empty()) {
+		return false;
+	}
+
+	Stopwatch timer;
+	for (auto& family: families) {
+		family->shrinkToFit();
+	}
+	if (!archetypeStorage) {
+		return true;
+	}
+
+	// A batch at a time, so the timer isn't checked for every entity; always at least one, so it gets somewhere on any budget
+	constexpr size_t batchSize = 64;
+	bool done = false;
+	do {
+		done = archetypeStorage->compact(entitiesCompacted, batchSize);
+		for (auto& e: entitiesCompacted) {
+			for (auto& fam: getFamiliesFor(e->getMask())) {
+				fam->reloadEntity(*e);
+			}
+		}
+		entitiesCompacted.clear();
+	} while (!done && timer.elapsedSeconds() < maxTime);
+	if (done) {
+		entitiesCompacted.shrink_to_fit();
+	}
+	return done;
+}
+
+void World::setParallelSystems(bool enabled)
+{
+	parallelSystems = enabled;
+}
+
+bool World::hasParallelSystems() const
+{
+	return parallelSystems;
+}
+
+void World::setDeterministic(bool enabled, uint64_t seed)
+{
+	deterministic = enabled;
+	if (enabled) {
+		randomSeed = seed;
+		randomStreams.clear();
+	}
+}
+
+bool World::isDeterministic() const
+{
+	return deterministic;
+}
+
+Random& World::getRandom(const String& stream)
+{
+	auto iter = randomStreams.find(stream);
+	if (iter != randomStreams.end()) {
+		return *iter->second;
+	}
+
+	// hashXXH64, unlike std::hash, is the same on every platform
+	const std::array<uint64_t, 2> seed = {{ randomSeed, Hash::hashXXH64(gsl::as_bytes(gsl::span<const char>(stream.c_str(), stream.size()))) }};
+	auto& result = randomStreams[stream];
+	result = std::make_unique<Random>(gsl::as_bytes(gsl::span<const uint64_t>(seed)));
+	return *result;
+}
+
+void World::setResimulating(bool value)
+{
+	resimulating = value;
+}
+
+bool World::isResimulating() const
+{
+	return resimulating;
+}
+
+uint64_t World::getStateHash() const
+{
+	writeSnapshot(stateHashSnapshot);
+	return Hash::hashXXH64(gsl::as_bytes(gsl::span<const Byte>(stateHashSnapshot)));
+}
+
 void World::deleteEntity(Entity* entity)
 {
 	Expects (entity);
+	auto chunk = entity->chunk;
+	auto chunkSlot = entity->chunkSlot;
 	entity->~Entity();
+	if (chunk) {
+		archetypeStorage->release(chunk, chunkSlot);
+	}
 	PoolAllocator<Entity>::free(entity);
 }
 
+namespace {
+	constexpr uint32_t snapshotVersion = 2;
+}
+
+void World::saveSnapshot(Bytes& dst)
+{
+	spawnPending();
+	writeSnapshot(dst);
+}
+
+void World::writeSnapshot(Bytes& dst) const
+{
+	auto write = [&] (Serializer& s)
+	{
+		s << snapshotVersion << uint32_t(entities.size());
+		for (auto& e: entities) {
+			s << e->uid << uint16_t(e->liveComponents);
+			for (int i = 0; i < e->liveComponents; ++i) {
+				auto& c = e->components[i];
+				s << int32_t(c.first);
+				ComponentDeleterTable::get(c.first)->serialize(s, c.second);
+			}
+		}
+		entityMap.serializeAllocationState(s);
+	};
+
+	// Dry run first, so it's written straight into dst without growing
+	Serializer dry;
+	write(dry);
+	dst.resize(dry.getSize());
+	Serializer s(gsl::as_writeable_bytes(gsl::span<Byte>(dst)));
+	write(s);
+}
+
+void World::loadSnapshot(const Bytes& src)
+{
+	spawnPending();
+
+	Deserializer s(src);
+	uint32_t version;
+	s >> version;
+	if (version != snapshotVersion) {
+		throw Exception("Unsupported world snapshot version: " + toString(version), HalleyExceptions::Entity);
+	}
+
+	uint32_t n;
+	s >> n;
+
+	Vector<Entity*> loaded(n);
+	Vector<Entity*> created;
+	Vector<char> kept(entities.size(), 0);
+	for (uint32_t i = 0; i < n; ++i) {
+		EntityId id;
+		s >> id;
+
+		// Reuse whatever still exists, so components are overwritten where they are
+		Entity* entity = tryGetEntity(id);
+		if (entity) {
+			kept[entity->worldIndex] = 1;
+			if (loadSnapshotComponents(*entity, s)) {
+				entity->markDirty(*this);
+			}
+		} else {
+			entity = new(PoolAllocator<Entity>::alloc()) Entity();
+			entity->uid = id;
+			loadSnapshotComponents(*entity, s);
+			created.push_back(entity);
+		}
+		loaded[i] = entity;
+	}
+
+	// Anything that didn't exist back then goes, and has to be gone before the id allocation state is replaced.
+	// Refreshed the way a frame does it, spawning before updateEntities(); the entities created above aren't queued yet.
+	for (size_t i = 0; i < kept.size(); ++i) {
+		if (!kept[i]) {
+			destroyEntity(entities[i]->getEntityId());
+		}
+	}
+	spawnPending();
+
+	entityMap.deserializeAllocationState(s);
+	for (auto& e: loaded) {
+		auto slot = entityMap.get(e->uid.value);
+		if (!slot) {
+			throw Exception("World snapshot is corrupted: entity " + toString(e->uid) + " is not allocated.", HalleyExceptions::Entity);
+		}
+		*slot = e;
+	}
+
+	for (auto& e: created) {
+		entitiesPendingCreation.push_back(e);
+		e->markDirty(*this);
+	}
+	spawnPending();
+}
+
+bool World::loadSnapshotComponents(Entity& entity, Deserializer& s)
+{
+	uint16_t nComponents;
+	s >> nComponents;
+
+	// Components that are in the snapshot get moved to the front as they're found, whatever is left past them is removed
+	bool changed = false;
+	for (int i = 0; i < int(nComponents); ++i) {
+		int32_t id;
+		s >> id;
+		auto deleter = ComponentDeleterTable::tryGet(id);
+		if (!deleter) {
+			throw Exception("World snapshot has unknown component " + toString(id), HalleyExceptions::Entity);
+		}
+
+		int idx = -1;
+		for (int j = i; j < entity.liveComponents; ++j) {
+			if (entity.components[j].first == id) {
+				idx = j;
+				break;
+			}
+		}
+		if (idx == -1) {
+			entity.addComponent(static_cast<Component*>(deleter->create()), id);
+			idx = entity.liveComponents - 1;
+			changed = true;
+		}
+
+		deleter->deserialize(s, entity.components[idx].second);
+		std::swap(entity.components[idx], entity.components[i]);
+	}
+
+	while (entity.liveComponents > int(nComponents)) {
+		entity.removeComponentAt(entity.liveComponents - 1);
+		changed = true;
+	}
+
+	return changed;
+}
+
+bool World::hasReplicatedComponents(EntityId id)
+{
+	auto entity = tryGetEntity(id);
+	if (!entity) {
+		return false;
+	}
+	for (int i = 0; i < entity->liveComponents; ++i) {
+		if (ComponentDeleterTable::get(entity->components[i].first)->isReplicated()) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void World::saveReplica(EntityId id, Serializer& s)
+{
+	auto entity = tryGetEntity(id);
+	if (!entity) {
+		throw Exception("Can't replicate entity " + toString(id) + ", as it doesn't exist.", HalleyExceptions::Entity);
+	}
+
+	uint16_t n = 0;
+	for (int i = 0; i < entity->liveComponents; ++i) {
+		if (ComponentDeleterTable::get(entity->components[i].first)->isReplicated()) {
+			++n;
+		}
+	}
+
+	s << n;
+	for (int i = 0; i < entity->liveComponents; ++i) {
+		auto& c = entity->components[i];
+		auto deleter = ComponentDeleterTable::get(c.first);
+		if (deleter->isReplicated()) {
+			s << int32_t(c.first);
+			deleter->serializeReplica(s, c.second);
+		}
+	}
+}
+
+void World::loadReplica(EntityId id, Deserializer& s)
+{
+	auto entity = tryGetEntity(id);
+	if (!entity) {
+		throw Exception("Can't load replica into entity " + toString(id) + ", as it doesn't exist.", HalleyExceptions::Entity);
+	}
+
+	uint16_t n;
+	s >> n;
+
+	bool changed = false;
+	Vector<int32_t> received(n);
+	for (auto& componentId: received) {
+		s >> componentId;
+		auto deleter = ComponentDeleterTable::tryGet(componentId);
+		if (!deleter || !deleter->isReplicated()) {
+			// Nothing has added one of these on this side yet, see initializeReplicatedComponents() in the generated registry
+			throw Exception("Replica has unknown component " + toString(componentId), HalleyExceptions::Entity);
+		}
+
+		Component* component = nullptr;
+		for (int j = 0; j < entity->liveComponents; ++j) {
+			if (entity->components[j].first == componentId) {
+				component = entity->components[j].second;
+				break;
+			}
+		}
+		if (!component) {
+			component = static_cast<Component*>(deleter->create());
+			entity->addComponent(component, componentId);
+			changed = true;
+		}
+
+		deleter->deserializeReplica(s, component);
+	}
+
+	// Removing swaps with the last live component, which has been looked at already
+	for (int i = entity->liveComponents - 1; i >= 0; --i) {
+		const int componentId = entity->components[i].first;
+		if (ComponentDeleterTable::get(componentId)->isReplicated() && std::find(received.begin(), received.end(), componentId) == received.end()) {
+			entity->removeComponentAt(i);
+			changed = true;
+		}
+	}
+
+	if (changed) {
+		entity->markDirty(*this);
+	}
+}
+
 bool World::hasSystemsOnTimeLine(TimeLine timeline) const
 {
 	return getSystems(timeline).size() > 0;
@@ -203,10 +656,39 @@ int64_t World::getAverageTime(TimeLine timeline) const
 	return timer[int(timeline)].averageElapsedNanoSeconds();
 }
 
+void World::getTelemetry(std::vector<TelemetryValue>& values) const
+{
+	const char* timelineNames[] = { "fixed", "variable", "render" };
+	for (int i = 0; i < int(TimeLine::NUMBER_OF_TIMELINES); ++i) {
+		const String prefix = String("world.") + timelineNames[i];
+		values.emplace_back(prefix + ".ms", double(getAverageTime(TimeLine(i))) / 1'000'000.0);
+		for (auto& system: systems[i]) {
+			values.emplace_back(prefix + ".system." + system->getName() + ".ms", double(system->getNanoSecondsTakenAvg()) / 1'000'000.0);
+		}
+	}
+	values.emplace_back("world.entities", double(numEntities()));
+}
+
+const World::FrameBreakdown& World::getLastFrameBreakdown(TimeLine timeline) const
+{
+	return lastBreakdown[int(timeline)];
+}
+
+const RollingStats& World::getTimeHistory(TimeLine timeline) const
+{
+	return timeHistory[int(timeline)];
+}
+
+const Vector<std::unique_ptr<Family>>& World::getFamilies() const
+{
+	return families;
+}
+
 void World::step(TimeLine timeline, Time elapsed)
 {
 	auto& t = timer[int(timeline)];
 	if (collectMetrics) {
+		curBreakdown = FrameBreakdown();
 		t.beginSample();
 	}
 
@@ -215,8 +697,17 @@ void World::step(TimeLine timeline, Time elapsed)
 	initSystems();
 	updateSystems(timeline, elapsed);
 
+	FrameArena::endFrame();
+
 	if (collectMetrics) {
 		t.endSample();
+		curBreakdown.totalNs = t.lastElapsedNanoSeconds();
+		curBreakdown.systemsNs = curBreakdown.totalNs - curBreakdown.spawnNs - curBreakdown.updateEntitiesNs;
+		for (auto& system: getSystems(timeline)) {
+			curBreakdown.messagesNs += system->getNanoSecondsInMessages();
+		}
+		lastBreakdown[int(timeline)] = curBreakdown;
+		timeHistory[int(timeline)].add(curBreakdown.totalNs);
 	}
 }
 
@@ -232,29 +723,53 @@ void World::render(RenderContext& rc) const
 
 	if (collectMetrics) {
 		t.endSample();
+		auto& breakdown = lastBreakdown[int(TimeLine::Render)];
+		breakdown = FrameBreakdown();
+		breakdown.totalNs = t.lastElapsedNanoSeconds();
+		breakdown.systemsNs = breakdown.totalNs;
+		timeHistory[int(TimeLine::Render)].add(breakdown.totalNs);
 	}
 }
 
 void World::allocateEntity(Entity* entity) {
-	auto res = entityMap.alloc();
-	*res.first = entity;
-	entity->uid.value = res.second;
+	entity->uid.value = entityMap.insert(entity);
+}
+
+void World::shrinkEntityStorage()
+{
+	// After a mass despawn (e.g. unloading a level), give memory back. Each attempt needs the count to have halved since
+	// the last one, so a live entity holding on to a high slot doesn't get this tried again on every removal.
+	entityPeak = std::max(entityPeak, entityMap.size());
+	if (entityMap.getNumSlots() > 1024 && entityMap.size() * 4 < entityMap.getNumSlots() && entityMap.size() * 2 < entityPeak) {
+		entityMap.shrinkToFit();
+		entities.shrink_to_fit();
+		entityPeak = entityMap.size();
+	}
 }
 
 void World::spawnPending()
 {
+	Stopwatch spawnTimer(collectMetrics);
 	if (!entitiesPendingCreation.empty()) {
 		HALLEY_DEBUG_TRACE();
 		for (auto& e : entitiesPendingCreation) {
 			e->onReady();
+			e->worldIndex = uint32_t(entities.size());
+			entities.push_back(e);
 		}
-		std::move(entitiesPendingCreation.begin(), entitiesPendingCreation.end(), std::insert_iterator<decltype(entities)>(entities, entities.end()));
 		entitiesPendingCreation.clear();
 		entityDirty = true;
 		HALLEY_DEBUG_TRACE();
 	}
 
-	updateEntities();
+	if (collectMetrics) {
+		curBreakdown.spawnNs += spawnTimer.elapsedNanoSeconds();
+		Stopwatch updateTimer;
+		updateEntities();
+		curBreakdown.updateEntitiesNs += updateTimer.elapsedNanoSeconds();
+	} else {
+		updateEntities();
+	}
 }
 
 void World::updateEntities()
@@ -264,57 +779,99 @@ void World::updateEntities()
 	}
 
 	HALLEY_DEBUG_TRACE();
-	size_t nEntities = entities.size();
+	// Only look at entities that were marked dirty, so this scales with the number of changes, not the world size.
+	// Swap the list out first, as family callbacks might dirty more entities while this runs.
+	std::swap(dirtyEntities, dirtyEntitiesProcessing);
+	entityDirty = false;
 
-	std::vector<size_t> entitiesRemoved;
+	// Instantiated from prefabs, never in any family yet. Unless they were changed since, their mask is already right.
+	for (auto& entity: instantiated) {
+		if (!entity->isAlive()) {
+			entitiesRemoved.push_back(entity);
+			continue;
+		}
 
-	struct FamilyTodo {
-		std::vector<Entity*> toAdd;
-		std::vector<Entity*> toRemove;
-	};
-	std::map<FamilyMaskType, FamilyTodo> pending;
+		if (entity->pristinePrefab) {
+			entity->dirty = false;
+			entity->pristinePrefab = false;
+		} else {
+			entity->refresh();
+			if (useArchetypeStorage) {
+				entitiesToRelocate.push_back(entity);
+			}
+		}
+		pendingAdds.emplace_back(entity->getMask(), entity);
+	}
+	instantiated.clear();
 
-	// Update all entities
-	// This loop should be as fast as reasonably possible
-	for (size_t i = 0; i < nEntities; i++) {
-		auto& entity = *entities[i];
-		if (i + 20 < nEntities) { // Watch out for sign! Don't subtract!
-			prefetchL2(entities[i + 20]);
+	const size_t nDirty = dirtyEntitiesProcessing.size();
+	for (size_t i = 0; i < nDirty; i++) {
+		auto& entity = *dirtyEntitiesProcessing[i];
+		if (i + 20 < nDirty) { // Watch out for sign! Don't subtract!
+			prefetchL2(dirtyEntitiesProcessing[i + 20]);
 		}
 
-		// Check if it needs any sort of updating
-		if (entity.needsRefresh()) {
-			// First of all, let's check if it's dead
-			if (!entity.isAlive()) {
-				// Remove from systems
-				pending[entity.getMask()].toRemove.push_back(&entity);
-				entitiesRemoved.push_back(i);
-			} else {
-				// It's alive, so check old and new system inclusions
-				FamilyMaskType oldMask = entity.getMask();
-				entity.refresh();
-				FamilyMaskType newMask = entity.getMask();
-
-				// Did it change?
-				if (oldMask != newMask) {
-					pending[oldMask].toRemove.push_back(&entity);
-					pending[newMask].toAdd.push_back(&entity);
+		// First of all, let's check if it's dead
+		if (!entity.isAlive()) {
+			// Remove from systems
+			pendingRemoves.emplace_back(entity.getMask(), &entity);
+			entitiesRemoved.push_back(&entity);
+		} else if (entity.needsRefresh()) {
+			// It's alive, so check old and new system inclusions
+			FamilyMaskType oldMask = entity.getMask();
+			entity.refresh();
+			FamilyMaskType newMask = entity.getMask();
+
+			// Did it change?
+			if (oldMask != newMask) {
+				pendingRemoves.emplace_back(oldMask, &entity);
+				pendingAdds.emplace_back(newMask, &entity);
+				if (useArchetypeStorage) {
+					entitiesToRelocate.push_back(&entity);
 				}
 			}
 		}
 	}
+	dirtyEntitiesProcessing.clear();
 
-	HALLEY_DEBUG_TRACE();
-	for (auto& todo: pending) {
-		for (auto& fam: getFamiliesFor(todo.first)) {
-			for (auto& e: todo.second.toRemove) {
-				fam->removeEntity(*e);
+	// Group by mask, so each mask only looks up its families once. Stable, to keep the order they were added in.
+	std::stable_sort(pendingRemoves.begin(), pendingRemoves.end());
+	std::stable_sort(pendingAdds.begin(), pendingAdds.end());
+
+	auto forEachMask = [&] (const Vector<PendingMaskChange>& changes, auto f)
+	{
+		for (size_t i = 0; i < changes.size(); ) {
+			size_t j = i + 1;
+			while (j < changes.size() && changes[j].mask == changes[i].mask) {
+				++j;
 			}
-			for (auto& e: todo.second.toAdd) {
-				fam->addEntity(*e);
+			for (auto& fam: getFamiliesFor(changes[i].mask)) {
+				for (size_t k = i; k < j; ++k) {
+					f(*fam, *changes[k].entity);
+				}
 			}
+			i = j;
 		}
+	};
+
+	HALLEY_DEBUG_TRACE();
+	// Remove first, so families are notified while components are still where they expect them
+	forEachMask(pendingRemoves, [] (Family& fam, Entity& e) { fam.removeEntity(e); });
+	for (auto& iter : families) {
+		iter->removeDeadEntities();
 	}
+	pendingRemoves.clear();
+
+	HALLEY_DEBUG_TRACE();
+	// Move components into the chunk of their new archetype before anyone grabs pointers to them
+	for (auto& e: entitiesToRelocate) {
+		archetypeStorage->relocate(*e);
+	}
+	entitiesToRelocate.clear();
+
+	HALLEY_DEBUG_TRACE();
+	forEachMask(pendingAdds, [] (Family& fam, Entity& e) { fam.addEntity(e); });
+	pendingAdds.clear();
 
 	HALLEY_DEBUG_TRACE();
 	// Update families
@@ -324,23 +881,22 @@ void World::updateEntities()
 
 	HALLEY_DEBUG_TRACE();
 	// Actually remove dead entities
-	if (!entitiesRemoved.empty()) {
-		size_t livingEntityCount = entities.size();
-		for (int i = int(entitiesRemoved.size()); --i >= 0; ) {
-			size_t idx = entitiesRemoved[i];
-			auto& entity = *entities[idx];
+	for (auto& entity: entitiesRemoved) {
+		// Swap with the last living entity, so it's removed from the back of the array
+		const uint32_t idx = entity->worldIndex;
+		Expects(entities[idx] == entity);
+		entities[idx] = entities.back();
+		entities[idx]->worldIndex = idx;
+		entities.pop_back();
 
-			// Remove
-			entityMap.freeId(entity.getEntityId().value);
-			deleteEntity(&entity);
-
-			// Put it at the back of the array, so it's removed when the array gets resized
-			std::swap(entities[idx], entities[--livingEntityCount]);
-		}
-		entities.resize(livingEntityCount);
+		entityMap.erase(entity->getEntityId().value);
+		deleteEntity(entity);
 	}
+	if (!entitiesRemoved.empty()) {
+		shrinkEntityStorage();
+	}
+	entitiesRemoved.clear();
 
-	entityDirty = false;
 	HALLEY_DEBUG_TRACE();
 }
 
@@ -355,12 +911,81 @@ void World::initSystems() const
 
 void World::updateSystems(TimeLine timeline, Time time)
 {
+	if (parallelSystems && !deterministic && Executors::getCPU().threadCount() > 0) {
+		updateSystemsParallel(timeline, time);
+		return;
+	}
+
 	for (auto& system : getSystems(timeline)) {
 		system->doUpdate(time);
 		spawnPending();
 	}
 }
 
+void World::updateSystemsParallel(TimeLine timeline, Time time)
+{
+	FrameVector<Future<void>> tasks;
+
+	for (auto& batch : getSystemBatches(timeline)) {
+		if (batch.size() == 1) {
+			batch[0]->doUpdate(time);
+		} else {
+			HALLEY_DEBUG_TRACE();
+			// Outboxes are only read while the batch is running, so they're purged before it starts
+			for (auto& system : batch) {
+				system->purgeMessages();
+			}
+
+			tasks.clear();
+			for (auto& system : batch) {
+				if (system->getConcurrency() == SystemConcurrency::Any) {
+					tasks.push_back(Concurrent::execute(Executors::getCPU(), [system, time] () {
+						system->runUpdate(time);
+					}));
+				}
+			}
+			for (auto& system : batch) {
+				if (system->getConcurrency() != SystemConcurrency::Any) {
+					system->runUpdate(time);
+				}
+			}
+			auto batchDone = Concurrent::whenAll(tasks.begin(), tasks.end());
+			Concurrent::helpUntilReady(Executors::getCPU(), batchDone);
+			HALLEY_DEBUG_TRACE();
+		}
+
+		// Sync point: structural changes made by the batch are applied here
+		spawnPending();
+	}
+}
+
+const Vector<Vector<System*>>& World::getSystemBatches(TimeLine timeline)
+{
+	auto& batches = systemBatches[int(timeline)];
+	auto& timelineSystems = getSystems(timeline);
+	if (batches.empty() && !timelineSystems.empty()) {
+		// Each system goes in the batch right after the last earlier system it conflicts with.
+		// This preserves the original ordering between any two systems that share data or messages.
+		const size_t n = timelineSystems.size();
+		Vector<size_t> level(n, 0);
+		size_t nLevels = 0;
+		for (size_t i = 0; i < n; ++i) {
+			for (size_t j = 0; j < i; ++j) {
+				if (level[j] >= level[i] && timelineSystems[i]->conflictsWith(*timelineSystems[j])) {
+					level[i] = level[j] + 1;
+				}
+			}
+			nLevels = std::max(nLevels, level[i] + 1);
+		}
+
+		batches.resize(nLevels);
+		for (size_t i = 0; i < n; ++i) {
+			batches[level[i]].push_back(timelineSystems[i].get());
+		}
+	}
+	return batches;
+}
+
 void World::renderSystems(RenderContext& rc) const
 {
 	for (auto& system : getSystems(TimeLine::Render)) {
@@ -380,9 +1005,23 @@ void World::onAddFamily(Family& family)
 			family.addEntity(entity);
 		}
 	}
+	familiesByMask[family.inclusionMask].push_back(&family);
 	familyCache.clear();
 }
 
+Family* World::tryGetFamily(FamilyMaskType mask, gsl::span<const int> layout) const
+{
+	auto iter = familiesByMask.find(mask);
+	if (iter != familiesByMask.end()) {
+		for (auto& family: iter->second) {
+			if (family->hasLayout(layout)) {
+				return family;
+			}
+		}
+	}
+	return nullptr;
+}
+
 const std::vector<Family*>& World::getFamiliesFor(const FamilyMaskType& mask)
 {
 	auto i = familyCache.find(mask);
@@ -390,14 +1029,11 @@ const std::vector<Family*>& World::getFamiliesFor(const FamilyMaskType& mask)
 		return i->second;
 	} else {
 		std::vector<Family*> result;
-		for (auto& iter : families) {
-			auto& family = *iter;
-			FamilyMaskType famMask = family.inclusionMask;
-			if (mask.contains(famMask)) {
-				result.push_back(&family);
+		for (auto& iter : familiesByMask) {
+			if (mask.contains(iter.first)) {
+				result.insert(result.end(), iter.second.begin(), iter.second.end());
 			}
 		}
-		familyCache[mask] = std::move(result);
-		return familyCache[mask];
+		return familyCache.emplace(mask, std::move(result)).first->second;
 	}
 }
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <halley/concurrency/future.h>
+#include <halley/text/halleystring.h>
+#include <halley/time/halleytime.h>
+#include "lua_reference.h"
+
+struct lua_State;
+
+namespace Halley {
+	class LuaState;
+
+	// Runs Lua functions as coroutines that wait for something, and only resumes them once it happens, so idle scripts cost nothing.
+	// While it's running, a coroutine can call, from halleyAPI.scheduler:
+	//   wait(seconds)      resumes after that long, on a timer wheel with a slot per tick
+	//   waitMessage(name)  resumes after notify(name)
+	//   waitTicket(ticket) resumes after completeTicket(ticket), which any thread can call, e.g. when a Future resolves
+	// A plain coroutine.yield() resumes on the next update().
+	class LuaCoroutineScheduler {
+	public:
+		using CoroutineId = uint32_t;
+		using Ticket = uint32_t;
+
+		explicit LuaCoroutineScheduler(LuaState& state, Time tickLength = 1.0 / 60.0, size_t wheelSize = 256);
+		~LuaCoroutineScheduler();
+
+		LuaCoroutineScheduler(const LuaCoroutineScheduler& other) = delete;
+		LuaCoroutineScheduler& operator=(const LuaCoroutineScheduler& other) = delete;
+
+		// Runs function until it first waits, which might be never
+		CoroutineId start(const LuaReference& function);
+		void stop(CoroutineId id);
+		bool isRunning(CoroutineId id) const;
+
+		// Resumes whatever is due, in the order it became due
+		void update(Time t);
+		void notify(const String& message);
+
+		Ticket makeTicket();
+		void completeTicket(Ticket ticket);
+
+		// A ticket that's completed when future resolves; the scheduler must outlive it
+		template <typename T>
+		Ticket makeTicket(Future<T> future)
+		{
+			const auto ticket = makeTicket();
+			future.then([this, ticket] (auto&&...) { completeTicket(ticket); });
+			return ticket;
+		}
+
+		size_t getNumCoroutines() const;
+		size_t getNumWaiting() const; // Those not due to run on the next update
+
+	private:
+		enum class WaitType {
+			None, // Runs on the next update
+			Time,
+			Message,
+			Ticket
+		};
+
+		struct Coroutine {
+			LuaReference thread;
+			lua_State* raw = nullptr;
+			WaitType waitType = WaitType::None;
+			uint32_t serial = 0; // Identifies the current wait, so anything left over from earlier ones is ignored
+			bool stopped = false;
+		};
+
+		struct Waiter {
+			CoroutineId id;
+			uint32_t serial;
+		};
+
+		struct TimerEntry {
+			Waiter waiter;
+			uint64_t tick;
+		};
+
+		LuaState& state;
+		const Time tickLength;
+
+		std::unordered_map<CoroutineId, Coroutine> coroutines;
+		std::unordered_map<lua_State*, CoroutineId> byThread;
+		CoroutineId nextId = 1;
+		std::vector<CoroutineId> running; // Innermost last, as one can start another
+
+		std::vector<Waiter> ready;
+		std::vector<Waiter> resuming;
+
+		std::vector<std::vector<TimerEntry>> wheel;
+		uint64_t curTick = 0;
+		Time curTime = 0;
+
+		std::unordered_map<String, std::vector<Waiter>> messageWaiters;
+		std::unordered_map<Ticket, Waiter> ticketWaiters;
+		std::unordered_set<Ticket> completedTickets; // Before anything waited for them
+
+		mutable std::mutex ticketMutex;
+		std::vector<Ticket> ticketsDone; // By completeTicket, from any thread
+		Ticket nextTicket = 1;
+
+		void resume(CoroutineId id);
+		void advanceTimers(uint64_t targetTick);
+		void drainTickets();
+		void makeReady(const Waiter& waiter);
+		Coroutine* beginWait(lua_State* thread, WaitType type);
+
+		static int luaWait(lua_State* lua);
+		static int luaWaitMessage(lua_State* lua);
+		static int luaWaitTicket(lua_State* lua);
+	};
+}
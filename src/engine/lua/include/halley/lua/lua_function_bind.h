@@ -1,5 +1,6 @@
 #pragma once
 #include "lua_stack_ops.h"
+#include <cstring>
 
 namespace Halley {
 	class String;
@@ -11,6 +12,7 @@ namespace Halley {
 		static void startCall(LuaState& state);
 		static void call(LuaState& state, int nArgs, int nRets);
 		static void endCall(LuaState& state);
+		static void pushRawCallback(LuaState& state, LuaRawCallback callback, const void* data, size_t size);
 	};
 
 	template <typename T>
@@ -41,7 +43,7 @@ namespace Halley {
 		static void call(LuaState& state, int nArgs, int nRets, U u, Us... us)
 		{
 			ToLua<U>()(state, u);
-			LuaFunctionBind<Us...>::call(state, nArgs + 1, nRets, us...);
+			LuaFunctionBind<Us...>::call(state, nArgs + 1, nRets, std::move(us)...);
 		}
 	};
 
@@ -105,6 +107,35 @@ namespace Halley {
 				return 1;
 			};
 		}
+
+		// Same as bind, but as a plain struct that can live in Lua userdata, so calling it doesn't go through std::function
+		template <typename T, typename R, typename... Ps>
+		struct MethodBinding {
+			T* obj;
+			R (T::*f)(Ps...);
+
+			static int invoke(LuaState& state, const void* data)
+			{
+				MethodBinding binding;
+				memcpy(&binding, data, sizeof(binding));
+				return binding.doInvoke(state, 0);
+			}
+
+			template <typename R2 = R>
+			int doInvoke(LuaState& state, std::enable_if_t<std::is_void<R2>::value, int>) const
+			{
+				call(obj, f, makeTuple<Ps...>(state));
+				return 0;
+			}
+
+			template <typename R2 = R>
+			int doInvoke(LuaState& state, std::enable_if_t<!std::is_void<R2>::value, int>) const
+			{
+				R result = call(obj, f, makeTuple<Ps...>(state));
+				ToLua<R>()(state, result);
+				return 1;
+			}
+		};
 	}
 
 	template <typename T, typename R, typename... Ps>
@@ -112,4 +143,14 @@ namespace Halley {
 	{
 		return LuaCallbackBindDetails::bind(obj, f, 0);
 	}
+
+	// Pushes obj->f to the stack as a Lua function. Unlike pushing a LuaCallbackBind, the binding is stored in the closure itself.
+	template <typename T, typename R, typename... Ps>
+	void pushLuaMethod(LuaState& state, T* obj, R (T::*f)(Ps...))
+	{
+		using Binding = LuaCallbackBindDetails::MethodBinding<T, R, Ps...>;
+		static_assert(std::is_trivially_copyable<Binding>::value, "Method binding must be trivially copyable");
+		const Binding binding{ obj, f };
+		LuaFunctionCaller::pushRawCallback(state, &Binding::invoke, &binding, sizeof(binding));
+	}
 }
@@ -47,7 +47,7 @@ namespace Halley {
 		{
 			LuaFunctionCaller::startCall(*lua);
 			pushToLuaStack();
-			LuaFunctionBind<Us...>::call(*lua, 0, LuaReturnSize<T>::value, us...);
+			LuaFunctionBind<Us...>::call(*lua, 0, LuaReturnSize<T>::value, std::move(us)...);
 			return LuaReturnHelper<T>::cleanUpAndReturn(*lua);
 		}
 
@@ -64,9 +64,8 @@ namespace Halley {
 		T callMethod(const String& methodName, Us... us) const
 		{
 			LuaFunctionCaller::startCall(*lua);
-			operator[](methodName).pushToLuaStack();
-			pushToLuaStack();
-			LuaFunctionBind<Us...>::call(*lua, 1, LuaReturnSize<T>::value, us...);
+			pushMethodToLuaStack(methodName);
+			LuaFunctionBind<Us...>::call(*lua, 1, LuaReturnSize<T>::value, std::move(us)...);
 			return LuaReturnHelper<T>::cleanUpAndReturn(*lua);
 		}
 
@@ -74,7 +73,27 @@ namespace Halley {
 		T callMethod(const String& methodName) const
 		{
 			LuaFunctionCaller::startCall(*lua);
-			operator[](methodName).pushToLuaStack();
+			pushMethodToLuaStack(methodName);
+			LuaFunctionBind<>::call(*lua, 1, LuaReturnSize<T>::value);
+			return LuaReturnHelper<T>::cleanUpAndReturn(*lua);
+		}
+
+		// For methods called often: get the method once with operator[], and keep the reference around
+		template <typename T, typename... Us>
+		T callMethod(const LuaReference& method, Us... us) const
+		{
+			LuaFunctionCaller::startCall(*lua);
+			method.pushToLuaStack();
+			pushToLuaStack();
+			LuaFunctionBind<Us...>::call(*lua, 1, LuaReturnSize<T>::value, std::move(us)...);
+			return LuaReturnHelper<T>::cleanUpAndReturn(*lua);
+		}
+
+		template <typename T>
+		T callMethod(const LuaReference& method) const
+		{
+			LuaFunctionCaller::startCall(*lua);
+			method.pushToLuaStack();
 			pushToLuaStack();
 			LuaFunctionBind<>::call(*lua, 1, LuaReturnSize<T>::value);
 			return LuaReturnHelper<T>::cleanUpAndReturn(*lua);
@@ -85,6 +104,9 @@ namespace Halley {
 	private:
 		LuaState* lua;
 		int refId = -1;
+
+		// Pushes the method and then this as its self, without taking a reference to the method
+		void pushMethodToLuaStack(const String& methodName) const;
 	};
 	
 	template <>
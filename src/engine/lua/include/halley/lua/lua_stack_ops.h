@@ -10,6 +10,7 @@ namespace Halley {
 	class LuaState;
 
 	using LuaCallback = std::function<int(LuaState&)>;
+	using LuaRawCallback = int(*)(LuaState& state, const void* data);
 
 	class LuaStackOps {
 	public:
@@ -3,6 +3,7 @@
 #include <gsl/gsl>
 #include <halley/text/halleystring.h>
 #include "lua_reference.h"
+#include "halley/core/api/core_api.h"
 #include <unordered_map>
 
 struct lua_State;
@@ -11,7 +12,19 @@ namespace Halley {
 	class Resources;
 	class LuaState;
 
-	class LuaState {
+	enum class LuaGCMode {
+		Incremental,
+		Generational
+	};
+
+	struct LuaGCStats {
+		size_t memoryBytes = 0;
+		int64_t lastStepNs = 0;
+		int lastStepCount = 0;
+		int cyclesCompleted = 0;
+	};
+
+	class LuaState : public IIdleTask {
 	public:
 		LuaState(Resources& resources);
 		~LuaState();
@@ -27,6 +40,8 @@ namespace Halley {
 		lua_State* getRawState();
 		
 		void pushCallback(LuaCallback&& callback);
+		// Copies size bytes of data into a userdata owned by the closure; data must be trivially copyable
+		void pushCallback(LuaRawCallback callback, const void* data, size_t size);
 
 		void pushErrorHandler();
 		void popErrorHandler();
@@ -34,6 +49,20 @@ namespace Halley {
 		void popLuaState();
 		String errorHandler(String message);
 
+		// Generational needs Lua 5.4; the bundled 5.3 and LuaJIT only collect incrementally
+		void setGCMode(LuaGCMode mode);
+
+		// By default, Lua collects whenever allocating triggers it. With a budget, that's stopped, and the GC only runs in stepGC,
+		// for up to that many microseconds; the budget has to be enough to keep up with what the scripts allocate.
+		// Zero goes back to automatic collection.
+		void setGCBudget(int64_t microseconds);
+		void stepGC();
+		const LuaGCStats& getGCStats() const;
+
+		// Adding the state with CoreAPI::addIdleTask steps the GC after each frame's render
+		void runIdle() override;
+		String getIdleStats() const override;
+
 	private:
 		lua_State* lua;
 		std::vector<lua_State*> pushedStates;
@@ -44,6 +73,9 @@ namespace Halley {
 		std::unique_ptr<LuaReference> errorHandlerRef;
 		std::vector<int> errorHandlerStackPos;
 
+		int64_t gcBudget = 0;
+		LuaGCStats gcStats;
+
 		LuaReference loadScript(const String& chunkName, gsl::span<const gsl::byte> data);
 
 		void print(String string);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <halley/concurrency/concurrent.h>
+#include "lua_state.h"
+
+namespace Halley {
+	class Resources;
+
+	// A set of independent LuaStates, so scripts can run on Executors::getCPU() in parallel.
+	// Each state is only used by one job at a time, but jobs don't get to choose which one they get; keep per-entity data out of the globals.
+	class LuaStatePool {
+	public:
+		// Zero states means one per CPU worker
+		LuaStatePool(Resources& resources, size_t nStates = 0);
+		~LuaStatePool();
+
+		LuaStatePool(const LuaStatePool& other) = delete;
+		LuaStatePool& operator=(const LuaStatePool& other) = delete;
+
+		// Loads the module into every state, from the one copy of the (possibly precompiled) script, once they're all free.
+		// Resources can't be used from the workers, so anything the jobs require must be loaded through here first.
+		void loadModule(const String& moduleName);
+		void unloadModule(const String& moduleName);
+
+		size_t size() const;
+
+		// Runs job(LuaState&) on a free state. Its result is the only way data comes back, so it has to be a plain C++ value:
+		// a LuaReference can't be used outside of the state it came from.
+		template <typename F>
+		auto run(F job) -> Future<typename std::result_of<F(LuaState&)>::type>
+		{
+			return Concurrent::execute(Executors::getCPU(), [this, job] () {
+				Lease lease(*this);
+				return job(lease.getState());
+			});
+		}
+
+	private:
+		class Lease {
+		public:
+			Lease(LuaStatePool& pool);
+			~Lease();
+
+			LuaState& getState() const;
+
+		private:
+			LuaStatePool& pool;
+			LuaState* state;
+		};
+
+		std::vector<std::unique_ptr<LuaState>> states;
+		std::vector<LuaState*> freeStates;
+		std::mutex mutex;
+		std::condition_variable stateReleased;
+		Resources& resources;
+
+		std::unique_lock<std::mutex> waitForAllStates();
+		LuaState& acquire();
+		void release(LuaState& state);
+	};
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <lua.hpp>
+
+#ifdef WITH_LUAJIT
+#include <cmath>
+
+// LuaJIT implements the Lua 5.1 API; these are the newer calls used here.
+// Unlike the real ones, they don't go through metamethods.
+
+inline int lua_isinteger(lua_State* lua, int idx)
+{
+	if (lua_type(lua, idx) != LUA_TNUMBER) {
+		return 0;
+	}
+	const lua_Number n = lua_tonumber(lua, idx);
+	return std::floor(n) == n ? 1 : 0;
+}
+
+inline size_t lua_rawlen(lua_State* lua, int idx)
+{
+	return lua_objlen(lua, idx);
+}
+
+inline void lua_len(lua_State* lua, int idx)
+{
+	lua_pushinteger(lua, lua_Integer(lua_objlen(lua, idx)));
+}
+
+inline int lua_geti(lua_State* lua, int idx, lua_Integer i)
+{
+	lua_rawgeti(lua, idx, int(i));
+	return lua_type(lua, -1);
+}
+
+inline int lua_resume(lua_State* lua, lua_State* /*from*/, int nArgs)
+{
+	return lua_resume(lua, nArgs);
+}
+#endif
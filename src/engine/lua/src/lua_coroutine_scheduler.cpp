@@ -0,0 +1,292 @@
+#include "lua_compat.h"
+#include "lua_coroutine_scheduler.h"
+#include "lua_state.h"
+#include "halley/support/exception.h"
+#include "halley/support/logger.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Halley;
+
+LuaCoroutineScheduler::LuaCoroutineScheduler(LuaState& state, Time tickLength, size_t wheelSize)
+	: state(state)
+	, tickLength(tickLength)
+	, wheel(wheelSize)
+{
+	Expects(tickLength > 0);
+	Expects(wheelSize > 0);
+
+	auto lua = state.getRawState();
+	lua_getglobal(lua, "halleyAPI");
+	lua_newtable(lua);
+	const std::pair<const char*, lua_CFunction> functions[] = {
+		{ "wait", &luaWait },
+		{ "waitMessage", &luaWaitMessage },
+		{ "waitTicket", &luaWaitTicket }
+	};
+	for (auto& f: functions) {
+		// Plain C functions, as yielding skips over anything on the C++ stack
+		lua_pushlightuserdata(lua, this);
+		lua_pushcclosure(lua, f.second, 1);
+		lua_setfield(lua, -2, f.first);
+	}
+	lua_setfield(lua, -2, "scheduler");
+	lua_pop(lua, 1);
+}
+
+LuaCoroutineScheduler::~LuaCoroutineScheduler()
+{
+	auto lua = state.getRawState();
+	lua_getglobal(lua, "halleyAPI");
+	lua_pushnil(lua);
+	lua_setfield(lua, -2, "scheduler");
+	lua_pop(lua, 1);
+}
+
+LuaCoroutineScheduler::CoroutineId LuaCoroutineScheduler::start(const LuaReference& function)
+{
+	auto lua = state.getRawState();
+	auto thread = lua_newthread(lua);
+	LuaReference threadRef(state);
+
+	const auto id = nextId++;
+	Coroutine& co = coroutines[id];
+	co.thread = std::move(threadRef);
+	co.raw = thread;
+	byThread[thread] = id;
+
+	function.pushToLuaStack();
+	lua_xmove(lua, thread, 1);
+	resume(id);
+	return id;
+}
+
+void LuaCoroutineScheduler::stop(CoroutineId id)
+{
+	// Whatever it was waiting for is left to be ignored, as its id won't be found
+	const auto iter = coroutines.find(id);
+	if (iter != coroutines.end()) {
+		if (std::find(running.begin(), running.end(), id) != running.end()) {
+			// Stopping itself, or one further up that resumed it indirectly; done once it yields back to resume()
+			iter->second.stopped = true;
+			++iter->second.serial;
+		} else {
+			byThread.erase(iter->second.raw);
+			coroutines.erase(iter);
+		}
+	}
+}
+
+bool LuaCoroutineScheduler::isRunning(CoroutineId id) const
+{
+	return coroutines.find(id) != coroutines.end();
+}
+
+void LuaCoroutineScheduler::update(Time t)
+{
+	curTime += t;
+	advanceTimers(uint64_t(std::floor(curTime / tickLength)));
+	drainTickets();
+
+	// Anything made ready while these run waits for the next update, so a coroutine that keeps yielding can't stall this one
+	std::swap(resuming, ready);
+	for (auto& w: resuming) {
+		const auto iter = coroutines.find(w.id);
+		if (iter != coroutines.end() && iter->second.serial == w.serial) {
+			resume(w.id);
+		}
+	}
+	resuming.clear();
+}
+
+void LuaCoroutineScheduler::notify(const String& message)
+{
+	const auto iter = messageWaiters.find(message);
+	if (iter != messageWaiters.end()) {
+		auto waiters = std::move(iter->second);
+		messageWaiters.erase(iter);
+		for (auto& w: waiters) {
+			makeReady(w);
+		}
+	}
+}
+
+LuaCoroutineScheduler::Ticket LuaCoroutineScheduler::makeTicket()
+{
+	std::unique_lock<std::mutex> lock(ticketMutex);
+	return nextTicket++;
+}
+
+void LuaCoroutineScheduler::completeTicket(Ticket ticket)
+{
+	std::unique_lock<std::mutex> lock(ticketMutex);
+	ticketsDone.push_back(ticket);
+}
+
+size_t LuaCoroutineScheduler::getNumCoroutines() const
+{
+	return coroutines.size();
+}
+
+size_t LuaCoroutineScheduler::getNumWaiting() const
+{
+	size_t n = 0;
+	for (auto& c: coroutines) {
+		if (c.second.waitType != WaitType::None) {
+			++n;
+		}
+	}
+	return n;
+}
+
+void LuaCoroutineScheduler::resume(CoroutineId id)
+{
+	auto& co = coroutines.at(id);
+	auto thread = co.raw;
+	co.waitType = WaitType::None;
+	++co.serial;
+
+	running.push_back(id);
+
+#if LUA_VERSION_NUM >= 504
+	int nResults = 0;
+	const int result = lua_resume(thread, state.getRawState(), 0, &nResults);
+#else
+	const int result = lua_resume(thread, state.getRawState(), 0);
+#endif
+
+	running.pop_back();
+
+	// Looked up again, as the coroutine might have started others; it's still there, as stop() leaves the running one to this
+	auto iter = coroutines.find(id);
+	if (result == LUA_YIELD && !iter->second.stopped) {
+		lua_settop(thread, 0);
+		if (iter->second.waitType == WaitType::None) {
+			// Yielded without waiting on anything, so it goes again next update
+			ready.push_back(Waiter{ id, iter->second.serial });
+		}
+		return;
+	}
+
+	String error;
+	if (result != LUA_YIELD && result != 0) {
+		const char* message = lua_tostring(thread, -1);
+		LuaStateOverrider overrider(state, thread);
+		error = state.errorHandler(message ? message : "(error object is not a string)");
+	}
+	byThread.erase(thread);
+	coroutines.erase(iter); // Lets go of the thread only now that it isn't running
+	if (!error.isEmpty()) {
+		Logger::logError("Lua coroutine failed:\n\t" + error);
+	}
+}
+
+void LuaCoroutineScheduler::advanceTimers(uint64_t targetTick)
+{
+	if (targetTick <= curTick) {
+		return;
+	}
+
+	// Only the slots of the ticks that went by are looked at; past a whole turn of the wheel, that's all of them, once
+	const auto nSlots = uint64_t(wheel.size());
+	const auto nTicks = std::min(targetTick - curTick, nSlots);
+	for (uint64_t i = 0; i < nTicks; ++i) {
+		auto& slot = wheel[(targetTick - i) % nSlots];
+		size_t kept = 0;
+		for (size_t j = 0; j < slot.size(); ++j) {
+			if (slot[j].tick <= targetTick) {
+				makeReady(slot[j].waiter);
+			} else {
+				slot[kept++] = slot[j];
+			}
+		}
+		slot.resize(kept);
+	}
+	curTick = targetTick;
+}
+
+void LuaCoroutineScheduler::drainTickets()
+{
+	std::vector<Ticket> done;
+	{
+		std::unique_lock<std::mutex> lock(ticketMutex);
+		done = std::move(ticketsDone);
+		ticketsDone.clear();
+	}
+
+	for (auto ticket: done) {
+		const auto iter = ticketWaiters.find(ticket);
+		if (iter != ticketWaiters.end()) {
+			makeReady(iter->second);
+			ticketWaiters.erase(iter);
+		} else {
+			completedTickets.insert(ticket);
+		}
+	}
+}
+
+void LuaCoroutineScheduler::makeReady(const Waiter& waiter)
+{
+	const auto iter = coroutines.find(waiter.id);
+	if (iter != coroutines.end() && iter->second.serial == waiter.serial) {
+		iter->second.waitType = WaitType::None;
+		ready.push_back(waiter);
+	}
+}
+
+LuaCoroutineScheduler::Coroutine* LuaCoroutineScheduler::beginWait(lua_State* thread, WaitType type)
+{
+	const auto iter = byThread.find(thread);
+	if (iter == byThread.end()) {
+		return nullptr;
+	}
+	auto& co = coroutines.at(iter->second);
+	co.waitType = type;
+	return &co;
+}
+
+int LuaCoroutineScheduler::luaWait(lua_State* lua)
+{
+	auto& scheduler = *static_cast<LuaCoroutineScheduler*>(lua_touserdata(lua, lua_upvalueindex(1)));
+	const Time seconds = std::max(lua_Number(0), luaL_checknumber(lua, 1));
+	auto co = scheduler.beginWait(lua, WaitType::Time);
+	if (!co) {
+		return luaL_error(lua, "scheduler.wait can only be called from a coroutine started by the scheduler");
+	}
+
+	// Due on the first tick at or after the time, and never on the current one, which update() has already been through
+	const auto tick = std::max(scheduler.curTick + 1, uint64_t(std::ceil((scheduler.curTime + seconds) / scheduler.tickLength)));
+	scheduler.wheel[tick % scheduler.wheel.size()].push_back(TimerEntry{ Waiter{ scheduler.byThread.at(lua), co->serial }, tick });
+	return lua_yield(lua, 0);
+}
+
+int LuaCoroutineScheduler::luaWaitMessage(lua_State* lua)
+{
+	auto& scheduler = *static_cast<LuaCoroutineScheduler*>(lua_touserdata(lua, lua_upvalueindex(1)));
+	const auto message = String(luaL_checkstring(lua, 1));
+	auto co = scheduler.beginWait(lua, WaitType::Message);
+	if (!co) {
+		return luaL_error(lua, "scheduler.waitMessage can only be called from a coroutine started by the scheduler");
+	}
+
+	scheduler.messageWaiters[message].push_back(Waiter{ scheduler.byThread.at(lua), co->serial });
+	return lua_yield(lua, 0);
+}
+
+int LuaCoroutineScheduler::luaWaitTicket(lua_State* lua)
+{
+	auto& scheduler = *static_cast<LuaCoroutineScheduler*>(lua_touserdata(lua, lua_upvalueindex(1)));
+	const auto ticket = Ticket(luaL_checkinteger(lua, 1));
+	auto co = scheduler.beginWait(lua, WaitType::Ticket);
+	if (!co) {
+		return luaL_error(lua, "scheduler.waitTicket can only be called from a coroutine started by the scheduler");
+	}
+
+	const Waiter waiter{ scheduler.byThread.at(lua), co->serial };
+	if (scheduler.completedTickets.erase(ticket) > 0) {
+		scheduler.makeReady(waiter);
+	} else {
+		scheduler.ticketWaiters[ticket] = waiter;
+	}
+	return lua_yield(lua, 0);
+}
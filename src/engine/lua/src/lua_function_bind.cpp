@@ -15,3 +15,8 @@ void Halley::LuaFunctionCaller::endCall(LuaState& state)
 {
 	state.popErrorHandler();
 }
+
+void Halley::LuaFunctionCaller::pushRawCallback(LuaState& state, LuaRawCallback callback, const void* data, size_t size)
+{
+	state.pushCallback(callback, data, size);
+}
@@ -1,4 +1,4 @@
-#include <lua.hpp>
+#include "lua_compat.h"
 #include "lua_reference.h"
 #include "lua_state.h"
 #include "halley/support/exception.h"
@@ -57,3 +57,14 @@ LuaReference LuaReference::operator[](const String& name) const
 	lua_remove(lua->getRawState(), -2);
 	return LuaReference(*lua);
 }
+
+void LuaReference::pushMethodToLuaStack(const String& methodName) const
+{
+	pushToLuaStack();
+	lua_getfield(lua->getRawState(), -1, methodName.c_str());
+	if (lua_isnil(lua->getRawState(), -1)) {
+		lua_pop(lua->getRawState(), 2);
+		throw Exception("Unknown field: " + methodName, HalleyExceptions::Lua);
+	}
+	lua_insert(lua->getRawState(), -2);
+}
@@ -1,4 +1,4 @@
-#include "../../../../../contrib/lua/src/lua.hpp"
+#include "lua_compat.h"
 #include "lua_stack_ops.h"
 #include "lua_state.h"
 
@@ -36,7 +36,7 @@ void LuaStackOps::push(const char* v)
 
 void LuaStackOps::push(const String& v)
 {
-	lua_pushstring(state.getRawState(), v.c_str());
+	lua_pushlstring(state.getRawState(), v.c_str(), v.size());
 }
 
 void LuaStackOps::push(Vector2i v)
@@ -98,7 +98,9 @@ double LuaStackOps::popDouble()
 
 String LuaStackOps::popString()
 {
-	String value = lua_tostring(state.getRawState(), -1);
+	size_t len = 0;
+	const char* str = lua_tolstring(state.getRawState(), -1, &len);
+	String value(str, len);
 	pop();
 	return value;
 }
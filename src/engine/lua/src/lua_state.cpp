@@ -1,9 +1,12 @@
-#include <lua.hpp>
+#include "lua_compat.h"
 #include "lua_state.h"
 #include "halley/support/exception.h"
 #include "halley/support/logger.h"
 #include "halley/core/resources/resources.h"
 #include "halley/file_formats/binary_file.h"
+#include "halley/text/string_converter.h"
+#include "halley/time/stopwatch.h"
+#include <cstring>
 
 using namespace Halley;
 
@@ -32,12 +35,16 @@ LuaState::LuaState(Resources& resources)
 	// TODO: convert this into an automatic table
 	LuaStackUtils u(*this);
 	u.pushTable();
-	u.setField("print", LuaCallbackBind(this, &LuaState::print));
-	u.setField("errorHandler", LuaCallbackBind(this, &LuaState::errorHandler));
-	u.setField("packageLoader", LuaCallbackBind(this, &LuaState::packageLoader));
+	LuaStackOps ops(*this);
+	pushLuaMethod(*this, this, &LuaState::print);
+	ops.setField("print");
+	pushLuaMethod(*this, this, &LuaState::errorHandler);
+	ops.setField("errorHandler");
+	pushLuaMethod(*this, this, &LuaState::packageLoader);
+	ops.setField("packageLoader");
 
 	pushCallback(&handleCoroutineError);
-	LuaStackOps(*this).setField("handleCoroutineError");
+	ops.setField("handleCoroutineError");
 
 	u.makeGlobal("halleyAPI");
 
@@ -117,9 +124,11 @@ lua_State* LuaState::getRawState()
 
 LuaReference LuaState::loadScript(const String& chunkName, gsl::span<const gsl::byte> data)
 {
+	// Either source or the bytecode the importer precompiles scripts to, Lua tells them apart by the signature
 	int result = luaL_loadbuffer(lua, reinterpret_cast<const char*>(data.data()), data.size_bytes(), chunkName.c_str());
 	if (result != 0) {
-		throw Exception("Error loading Lua chunk:\n\t" + LuaStackOps(*this).popString(), HalleyExceptions::Lua);
+		const bool isBytecode = !data.empty() && char(data[0]) == LUA_SIGNATURE[0];
+		throw Exception("Error loading Lua chunk:\n\t" + LuaStackOps(*this).popString() + (isBytecode ? "\n\tIt was precompiled; bytecode only loads on the VM and word sizes it was compiled for (see \"precompile\" in the script's meta)" : ""), HalleyExceptions::Lua);
 	}
 	call(0, 1);
 
@@ -150,6 +159,27 @@ void LuaState::pushCallback(LuaCallback&& callback)
 	lua_pushcclosure(lua, luaClosureInvoker, 2);
 }
 
+static int luaRawClosureInvoker(lua_State* lua)
+{
+	auto data = reinterpret_cast<const char*>(lua_touserdata(lua, lua_upvalueindex(1)));
+	LuaState* state = reinterpret_cast<LuaState*>(lua_touserdata(lua, lua_upvalueindex(2)));
+	LuaRawCallback callback;
+	memcpy(&callback, data, sizeof(callback));
+	LuaStateOverrider overrider(*state, lua);
+	return callback(*state, data + sizeof(callback));
+}
+
+void LuaState::pushCallback(LuaRawCallback callback, const void* data, size_t size)
+{
+	// Lua owns the binding, so there's nothing to keep in closures
+	auto dst = reinterpret_cast<char*>(lua_newuserdata(lua, sizeof(callback) + size));
+	memcpy(dst, &callback, sizeof(callback));
+	memcpy(dst + sizeof(callback), data, size);
+
+	lua_pushlightuserdata(lua, this);
+	lua_pushcclosure(lua, luaRawClosureInvoker, 2);
+}
+
 void LuaState::pushErrorHandler()
 {
 	if (errorHandlerRef) {
@@ -211,6 +241,72 @@ String LuaState::errorHandler(String message)
 	return result;
 }
 
+void LuaState::setGCMode(LuaGCMode mode)
+{
+	switch (mode) {
+	case LuaGCMode::Incremental:
+#ifdef LUA_GCINC
+		lua_gc(lua, LUA_GCINC, 0);
+#endif
+		break;
+	case LuaGCMode::Generational:
+#ifdef LUA_GCGEN
+		lua_gc(lua, LUA_GCGEN, 0);
+#else
+		throw Exception("Generational GC is not supported by this version of Lua.", HalleyExceptions::Lua);
+#endif
+		break;
+	}
+}
+
+void LuaState::setGCBudget(int64_t microseconds)
+{
+	Expects(microseconds >= 0);
+	gcBudget = microseconds;
+	lua_gc(lua, gcBudget > 0 ? LUA_GCSTOP : LUA_GCRESTART, 0);
+}
+
+void LuaState::stepGC()
+{
+	gcStats.lastStepCount = 0;
+	gcStats.lastStepNs = 0;
+
+	if (gcBudget > 0) {
+		// Basic steps are small enough to not overshoot the budget by much; stops at the end of a cycle, rather than starting the next one
+		Stopwatch timer;
+		bool finished = false;
+		do {
+			finished = lua_gc(lua, LUA_GCSTEP, 0) != 0;
+			++gcStats.lastStepCount;
+		} while (!finished && timer.elapsedMicroSeconds() < gcBudget);
+		if (finished) {
+			++gcStats.cyclesCompleted;
+		}
+		gcStats.lastStepNs = timer.elapsedNanoSeconds();
+	}
+
+	gcStats.memoryBytes = size_t(lua_gc(lua, LUA_GCCOUNT, 0)) * 1024 + size_t(lua_gc(lua, LUA_GCCOUNTB, 0));
+}
+
+const LuaGCStats& LuaState::getGCStats() const
+{
+	return gcStats;
+}
+
+void LuaState::runIdle()
+{
+	stepGC();
+}
+
+String LuaState::getIdleStats() const
+{
+	String result = "Lua: " + String::prettySize(gcStats.memoryBytes);
+	if (gcBudget > 0) {
+		result += ", GC " + toString(gcStats.lastStepNs / 1000) + " us in " + toString(gcStats.lastStepCount) + " steps, " + toString(gcStats.cyclesCompleted) + " cycles";
+	}
+	return result;
+}
+
 const LuaReference& LuaState::packageLoader(String module)
 {
 	return getOrLoadModule(module);
@@ -0,0 +1,87 @@
+#include "lua_state_pool.h"
+#include "halley/core/resources/resources.h"
+#include "halley/file_formats/binary_file.h"
+#include <algorithm>
+
+using namespace Halley;
+
+LuaStatePool::LuaStatePool(Resources& resources, size_t nStates)
+	: resources(resources)
+{
+	if (nStates == 0) {
+		nStates = std::max(Executors::getCPU().threadCount(), size_t(1));
+	}
+	for (size_t i = 0; i < nStates; ++i) {
+		states.push_back(std::make_unique<LuaState>(resources));
+		freeStates.push_back(states.back().get());
+	}
+}
+
+LuaStatePool::~LuaStatePool()
+{
+	waitForAllStates();
+}
+
+void LuaStatePool::loadModule(const String& moduleName)
+{
+	auto res = resources.get<BinaryFile>("lua/" + moduleName + ".lua");
+	auto lock = waitForAllStates();
+	for (auto& state: states) {
+		state->loadModule(moduleName, res->getSpan());
+	}
+}
+
+void LuaStatePool::unloadModule(const String& moduleName)
+{
+	auto lock = waitForAllStates();
+	for (auto& state: states) {
+		state->unloadModule(moduleName);
+	}
+}
+
+size_t LuaStatePool::size() const
+{
+	return states.size();
+}
+
+std::unique_lock<std::mutex> LuaStatePool::waitForAllStates()
+{
+	// Jobs can't acquire a state while the lock is held
+	std::unique_lock<std::mutex> lock(mutex);
+	stateReleased.wait(lock, [&] () { return freeStates.size() == states.size(); });
+	return lock;
+}
+
+LuaState& LuaStatePool::acquire()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	stateReleased.wait(lock, [&] () { return !freeStates.empty(); });
+	auto state = freeStates.back();
+	freeStates.pop_back();
+	return *state;
+}
+
+void LuaStatePool::release(LuaState& state)
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		freeStates.push_back(&state);
+	}
+	stateReleased.notify_all();
+}
+
+LuaStatePool::Lease::Lease(LuaStatePool& pool)
+	: pool(pool)
+	, state(&pool.acquire())
+{
+}
+
+LuaStatePool::Lease::~Lease()
+{
+	pool.release(*state);
+}
+
+LuaState& LuaStatePool::Lease::getState() const
+{
+	return *state;
+}
@@ -10,10 +10,11 @@ namespace Halley
 	struct ChannelSettings
 	{
 	public:
-		ChannelSettings(bool reliable = false, bool ordered = false, bool keepLastSent = false);
+		ChannelSettings(bool reliable = false, bool ordered = false, bool keepLastSent = false, int priority = 0);
 		bool reliable;
 		bool ordered;
 		bool keepLastSent;
+		int priority; // When the link can't take everything, higher priority channels go first
 	};
 
 	class MessageQueue
@@ -2,13 +2,16 @@
 
 #include "message_queue.h"
 #include "iconnection.h"
+#include "halley/utils/utils.h"
 
 namespace Halley
 {	
+	// Messages enqueued between calls to sendAll() are coalesced into a single packet, which is compressed with LZ4 once it's at least
+	// compressionThreshold bytes (0 never compresses). Each packet says whether it's compressed, so the two ends don't need the same threshold.
 	class MessageQueueTCP : public MessageQueue
 	{
 	public:
-		MessageQueueTCP(std::shared_ptr<IConnection> connection);
+		MessageQueueTCP(std::shared_ptr<IConnection> connection, size_t compressionThreshold = 1024);
 
 		bool isConnected() const override;
 		void enqueue(std::unique_ptr<NetworkMessage> msg, int channel) override;
@@ -17,5 +20,7 @@ namespace Halley
 				
 	private:
 		std::shared_ptr<IConnection> connection;
+		const size_t compressionThreshold;
+		Bytes pending; // Each message as its type, its size, then its data
 	};
 }
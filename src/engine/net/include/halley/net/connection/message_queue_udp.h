@@ -5,7 +5,6 @@
 #include <vector>
 #include <map>
 #include "reliable_connection.h"
-#include <list>
 #include <chrono>
 #include "message_queue.h"
 
@@ -13,7 +12,7 @@ namespace Halley
 {
 	class ReliableConnection;
 
-	class MessageQueueUDP : public MessageQueue, private IReliableConnectionAckListener
+	class MessageQueueUDP : public MessageQueue, private IReliableConnectionAckListener, public INetworkStatsSource
 	{
 		struct PendingPacket
 		{
@@ -22,6 +21,7 @@ namespace Halley
 			size_t size;
 			unsigned short seq;
 			bool reliable;
+			bool lost = false; // Timed out, waiting for room in the congestion window to be re-sent
 		};
 
 		struct Channel
@@ -33,6 +33,7 @@ namespace Halley
 			unsigned short lastReceivedSeq = 0;
 			ChannelSettings settings;
 			bool initialized = false;
+			NetworkChannelStats stats;
 
 			void getReadyMessages(std::vector<std::unique_ptr<NetworkMessage>>& out);
 		};
@@ -41,6 +42,7 @@ namespace Halley
 		MessageQueueUDP(std::shared_ptr<ReliableConnection> connection);
 		~MessageQueueUDP();
 		
+		bool isConnected() const override;
 		void setChannel(int channel, ChannelSettings settings) override;
 
 		std::vector<std::unique_ptr<NetworkMessage>> receiveAll() override;
@@ -48,20 +50,42 @@ namespace Halley
 		void enqueue(std::unique_ptr<NetworkMessage> msg, int channel) override;
 		void sendAll() override;
 
+		// Shows up in NetworkStats::capture() under this name
+		void setStatsName(const String& name);
+		NetworkConnectionStats getStats() const override;
+
 	private:
 		std::shared_ptr<ReliableConnection> connection;
 		std::vector<Channel> channels;
+		String statsName;
 
-		std::list<std::unique_ptr<NetworkMessage>> pendingMsgs;
+		std::vector<std::unique_ptr<NetworkMessage>> pendingMsgs;
 		std::map<int, PendingPacket> pendingPackets;
+		std::vector<ReliableSubPacket> toSend;
+		std::vector<std::vector<std::unique_ptr<NetworkMessage>>> spareMsgLists;
 		int nextPacketId = 0;
 
+		// AIMD congestion control, in bytes
+		size_t congestionWindow;
+		size_t slowStartThreshold;
+		size_t bytesInFlight = 0;
+		std::chrono::steady_clock::time_point lastCongestionEvent;
+		bool hasChannelPriorities = false;
+
 		void onPacketAcked(int tag) override;
 		void checkReSend(std::vector<ReliableSubPacket>& collect);
+		void erasePendingPacket(std::map<int, PendingPacket>::iterator iter);
+
+		bool canSend() const;
+		void onCongestion();
+		void coalesceUnreliable();
+		void dropUnreliable();
+		void sendPackets(gsl::span<ReliableSubPacket> packets);
 
 		ReliableSubPacket createPacket();
 		ReliableSubPacket makeTaggedPacket(std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size, bool resends = false, unsigned short resendSeq = 0);
-		std::vector<gsl::byte> serializeMessages(const std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size) const;
+		size_t getSizeWithHeader(NetworkMessage& msg) const;
+		NetworkPacketBuffer serializeMessages(const std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size) const;
 
 		void receiveMessages();
 	};
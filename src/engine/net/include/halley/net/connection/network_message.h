@@ -21,20 +21,25 @@ namespace Halley
 	public:
 		virtual ~NetworkMessage() = default;
 
+		// Messages are created and destroyed every frame, so they're recycled through a pool instead of the heap
+		static void* operator new(size_t size);
+		static void operator delete(void* ptr, size_t size);
+
 		size_t getSerializedSize() const
 		{
-			if (!serialized) {
-				serialized = Serializer::toBytes(*this);
+			if (!serializedSize) {
+				Serializer dry;
+				serialize(dry);
+				serializedSize = dry.getSize();
 			}
-			return serialized.get().size();
+			return serializedSize.get();
 		}
 
 		void serializeTo(gsl::span<gsl::byte> dst) const
 		{
-			if (!serialized) {
-				serialized = Serializer::toBytes(*this);
-			}
-			memcpy(dst.data(), serialized.get().data(), serialized.get().size());
+			Expects(size_t(dst.size_bytes()) >= getSerializedSize());
+			Serializer s(dst);
+			serialize(s);
 		}
 
 		virtual void serialize(Serializer& s) const = 0;
@@ -43,7 +48,7 @@ namespace Halley
 		unsigned short seq = 0;
 		char channel = -1;
 
-		mutable Maybe<Bytes> serialized;
+		mutable Maybe<size_t> serializedSize;
 	};
 
 	class NetworkMessageFactoryBase
@@ -5,6 +5,42 @@
 
 namespace Halley
 {
+	// Byte buffer for packet data, taken from a shared pool and returned to it when destroyed
+	// Pooled buffers have room for a full packet plus headers, so the network layer doesn't allocate per packet
+	class NetworkPacketBuffer
+	{
+	public:
+		constexpr static size_t pooledCapacity = 2048 + 128;
+
+		NetworkPacketBuffer();
+		explicit NetworkPacketBuffer(size_t size);
+		explicit NetworkPacketBuffer(gsl::span<const gsl::byte> src);
+		NetworkPacketBuffer(const NetworkPacketBuffer& other);
+		NetworkPacketBuffer(NetworkPacketBuffer&& other) noexcept;
+		~NetworkPacketBuffer();
+
+		NetworkPacketBuffer& operator=(const NetworkPacketBuffer& other);
+		NetworkPacketBuffer& operator=(NetworkPacketBuffer&& other) noexcept;
+
+		gsl::byte* data() { return bytes.data(); }
+		const gsl::byte* data() const { return bytes.data(); }
+		size_t size() const { return bytes.size(); }
+		bool empty() const { return bytes.empty(); }
+
+		gsl::span<gsl::byte> getSpan() { return gsl::span<gsl::byte>(bytes); }
+		gsl::span<const gsl::byte> getSpan() const { return gsl::span<const gsl::byte>(bytes); }
+
+		// Growing past pooledCapacity is allowed (e.g. for TCP), but will allocate
+		void resize(size_t size);
+		void clear();
+
+	private:
+		std::vector<gsl::byte> bytes;
+
+		void acquire();
+		void release();
+	};
+
 	class NetworkPacketBase
 	{
 	public:
@@ -20,7 +56,7 @@ namespace Halley
 		NetworkPacketBase(gsl::span<const gsl::byte> data, size_t prePadding);
 
 		size_t dataStart;
-		std::vector<gsl::byte> data;
+		NetworkPacketBuffer data;
 	};
 
 	class OutboundNetworkPacket : public NetworkPacketBase
@@ -48,6 +84,7 @@ namespace Halley
 		InboundNetworkPacket();
 		explicit InboundNetworkPacket(InboundNetworkPacket&& other);
 		explicit InboundNetworkPacket(gsl::span<const gsl::byte> data);
+		InboundNetworkPacket(NetworkPacketBuffer&& buffer, size_t dataStart); // Takes the buffer as received, whose first dataStart bytes are headers
 		void extractHeader(gsl::span<gsl::byte> dst);
 
 		template <typename T>
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "halley/text/halleystring.h"
+
+namespace Halley
+{
+	class Serializer;
+	class Deserializer;
+
+	// Round-trip times between sending a packet and getting it acked
+	class NetworkLatencyHistogram
+	{
+	public:
+		constexpr static size_t numBuckets = 10;
+
+		// In seconds; the last bucket has no upper bound
+		static float getBucketUpperBound(size_t bucket);
+
+		void add(float rtt);
+		uint64_t getCount(size_t bucket) const { return counts[bucket]; }
+		uint64_t getTotal() const;
+
+		// Upper bound of the bucket that the given fraction of samples falls under, e.g. 0.95f for p95
+		float getPercentile(float fraction) const;
+
+		void serialize(Serializer& s) const;
+		void deserialize(Deserializer& s);
+
+	private:
+		std::array<uint64_t, numBuckets> counts = {};
+	};
+
+	struct NetworkChannelStats
+	{
+		int channel = -1;
+		uint64_t messagesSent = 0;
+		uint64_t messagesResent = 0;
+		uint64_t messagesDropped = 0; // Unreliable messages that were superseded, or didn't fit in the congestion window
+		uint64_t messagesReceived = 0;
+		uint64_t bytesSent = 0; // Including message headers, but not packet headers
+		uint64_t bytesReceived = 0;
+
+		size_t queuedToSend = 0;
+		size_t waitingForAck = 0;
+		size_t waitingForDelivery = 0; // Received, but held back for ordering
+
+		void serialize(Serializer& s) const;
+		void deserialize(Deserializer& s);
+	};
+
+	struct NetworkConnectionStats
+	{
+		String name;
+
+		uint64_t packetsSent = 0;
+		uint64_t packetsReceived = 0;
+		uint64_t bytesSent = 0;
+		uint64_t bytesReceived = 0;
+		uint64_t subPacketsSent = 0;
+		uint64_t subPacketsResent = 0;
+		uint64_t subPacketsAcked = 0;
+		uint64_t subPacketsLost = 0; // Fell out of the ack window without being acked
+
+		float latency = 0; // Smoothed round-trip time, in seconds
+		float packetLoss = 0; // Recent fraction of sub-packets lost, between 0 and 1
+		NetworkLatencyHistogram rtt;
+
+		// Only reported by connections that do congestion control
+		size_t congestionWindow = 0;
+		size_t bytesInFlight = 0;
+
+		std::vector<NetworkChannelStats> channels;
+
+		void serialize(Serializer& s) const;
+		void deserialize(Deserializer& s);
+	};
+
+	class INetworkStatsSource
+	{
+	public:
+		virtual ~INetworkStatsSource() {}
+		virtual NetworkConnectionStats getStats() const = 0;
+	};
+
+	// Every live connection registers here, so tools can inspect all of them without the game plumbing them through
+	class NetworkStats
+	{
+	public:
+		static void addSource(INetworkStatsSource& source);
+		static void removeSource(INetworkStatsSource& source);
+
+		static std::vector<NetworkConnectionStats> capture();
+	};
+}
@@ -2,6 +2,7 @@
 
 #include "iconnection.h"
 #include "network_packet.h"
+#include "network_stats.h"
 #include <memory>
 #include <vector>
 #include <chrono>
@@ -21,7 +22,7 @@ namespace Halley
 	class ReliableSubPacket
 	{
 	public:
-		std::vector<gsl::byte> data;
+		NetworkPacketBuffer data;
 		int tag = -1;
 		//bool reliable = false;
 		bool resends = false;
@@ -32,14 +33,15 @@ namespace Halley
 		{}
 
 		ReliableSubPacket(ReliableSubPacket&& other) = default;
+		ReliableSubPacket& operator=(ReliableSubPacket&& other) = default;
 
-		ReliableSubPacket(std::vector<gsl::byte>&& data)
-			: data(data)
+		ReliableSubPacket(NetworkPacketBuffer&& data)
+			: data(std::move(data))
 			, resends(false)
 		{}
 
-		ReliableSubPacket(std::vector<gsl::byte>&& data, unsigned short resendSeq)
-			: data(data)
+		ReliableSubPacket(NetworkPacketBuffer&& data, unsigned short resendSeq)
+			: data(std::move(data))
 			, resends(true)
 			, resendSeq(resendSeq)
 		{}
@@ -72,6 +74,9 @@ namespace Halley
 		float getTimeSinceLastSend() const;
 		float getTimeSinceLastReceive() const;
 
+		// Counters since the connection was created; channels are left for the layer above to fill in
+		NetworkConnectionStats getStats() const;
+
 	private:
 		std::shared_ptr<IConnection> parent;
 
@@ -85,6 +90,8 @@ namespace Halley
 		std::vector<IReliableConnectionAckListener*> ackListeners;
 
 		float lag = 1; // Start at 1 second
+		NetworkConnectionStats stats;
+		unsigned short nextLossCheck = 0;
 		Clock::time_point lastReceive;
 		Clock::time_point lastSend;
 
@@ -94,6 +101,7 @@ namespace Halley
 		void processReceivedAcks(unsigned short ack, unsigned int ackBits);
 		bool onSeqReceived(unsigned short sequence, bool isResend, unsigned short resendOf);
 		void onAckReceived(unsigned short sequence);
+		void checkForLostPackets(unsigned short ack);
 		void reportLatency(float lag);
 	};
 }
@@ -6,6 +6,7 @@
 #include "network_session_messages.h"
 #include "shared_data.h"
 #include "network_session_control_messages.h"
+#include "network_session_peer.h"
 
 namespace Halley {
 	class NetworkService;
@@ -33,6 +34,12 @@ namespace Halley {
 		ConnectionStatus getStatus() const override;
 		void send(OutboundNetworkPacket&& packet) override;
 		bool receive(InboundNetworkPacket& packet) override;
+		void sendToPeer(OutboundNetworkPacket&& packet, int peerId); // Only to that peer, which must be the host (peer 0) if this is a client
+
+		// Desync detection for lockstep simulations: every peer reports the hash of its state after each frame (e.g. World::getStateHash()),
+		// with the host's taken as the reference. Whenever a client's differs, both the client and the host get onDesync().
+		// The hashes aren't sent reliably, so a lost one only means that frame isn't checked.
+		void reportStateHash(uint32_t frame, uint64_t hash);
 
 	protected:
 		SharedData& doGetMySharedData();
@@ -49,6 +56,7 @@ namespace Halley {
 		virtual void onHosting();
 		virtual void onConnected(int peerId);
 		virtual void onDisconnected(int peerId);
+		virtual void onDesync(int peerId, uint32_t frame, uint64_t myHash, uint64_t theirHash);
 		
 	private:
 		NetworkService& service;
@@ -60,24 +68,34 @@ namespace Halley {
 		std::unique_ptr<SharedData> sessionSharedData;
 		std::map<int, std::unique_ptr<SharedData>> sharedData;
 
-		std::vector<std::shared_ptr<IConnection>> connections;
+		std::vector<std::unique_ptr<NetworkSessionPeer>> peers;
 		std::vector<InboundNetworkPacket> inbox;
 
+		constexpr static uint32_t stateHashHistory = 256; // Frames
+		std::map<uint32_t, uint64_t> myStateHashes;
+		std::map<std::pair<int, uint32_t>, uint64_t> peerStateHashes; // Ones that arrived before we had our own for that frame
+		uint32_t lastStateHashFrame = 0;
+
 		OutboundNetworkPacket makeOutbound(gsl::span<const gsl::byte> data, NetworkSessionMessageHeader header);
 		void sendToAll(OutboundNetworkPacket&& packet, int except = -1);
 		void closeConnection(int peerId, const String& reason);
 		void processReceive();
 
-		void retransmitControlMessage(int peerId, gsl::span<const gsl::byte> bytes);
+		NetworkSessionPeer& getPeer(int peerId);
 		void receiveControlMessage(int peerId, InboundNetworkPacket& packet);
 		void onControlMessage(int peerId, const ControlMsgSetPeerId& msg);
 		void onControlMessage(int peerId, const ControlMsgSetPeerState& msg);
 		void onControlMessage(int peerId, const ControlMsgSetSessionState& msg);
+		void onControlMessage(int peerId, const ControlMsgStateHash& msg);
+		void compareStateHash(int peerId, uint32_t frame, uint64_t theirHash);
 
 		void setMyPeerId(int id);
 
+		SharedData& getSharedData(int ownerId);
 		void checkForOutboundStateChanges(int ownerId);
-		OutboundNetworkPacket makeUpdateSharedDataPacket(int ownerId);
+		void resendSharedData();
+		void sendSharedData(NetworkSessionPeer& peer, int ownerId, const Bytes& state, bool isResend = false);
+		OutboundNetworkPacket makeUpdateSharedDataPacket(int ownerId, const SharedDataUpdate& update);
 		
 		OutboundNetworkPacket doMakeControlPacket(NetworkSessionControlMessageType msgType, OutboundNetworkPacket&& packet);
 	};
@@ -6,7 +6,8 @@ namespace Halley {
 	enum class NetworkSessionControlMessageType : int8_t {
 		SetPeerId,
 		SetSessionState,
-		SetPeerState
+		SetPeerState,
+		StateHash
 	};
 
 	struct ControlMsgHeader
@@ -22,8 +23,19 @@ namespace Halley {
 		void deserialize(Deserializer& s);
 	};
 
+	// A SharedData snapshot, either whole or XOR'd against an earlier one that the receiver acknowledged
+	struct SharedDataUpdate {
+		uint16_t seq = 0;
+		bool delta = false;
+		uint16_t baseSeq = 0;
+		Bytes data;
+
+		void serialize(Serializer& s) const;
+		void deserialize(Deserializer& s);
+	};
+
 	struct ControlMsgSetSessionState {
-		Bytes state;
+		SharedDataUpdate update;
 
 		void serialize(Serializer& s) const;
 		void deserialize(Deserializer& s);
@@ -31,7 +43,16 @@ namespace Halley {
 
 	struct ControlMsgSetPeerState {
 		int8_t peerId;
-		Bytes state;
+		SharedDataUpdate update;
+
+		void serialize(Serializer& s) const;
+		void deserialize(Deserializer& s);
+	};
+
+	struct ControlMsgStateHash {
+		int8_t peerId;
+		uint32_t frame;
+		uint64_t hash;
 
 		void serialize(Serializer& s) const;
 		void deserialize(Deserializer& s);
@@ -1,10 +1,54 @@
 #pragma once
-#include "../connection/iconnection.h"
+#include "../connection/reliable_connection.h"
+#include "network_session_control_messages.h"
+#include "halley/data_structures/maybe.h"
+#include <chrono>
+#include <map>
 #include <memory>
 
 namespace Halley {
-	class NetworkSessionPeer {
+	// A connection in a session, along with which SharedData states the other end is known to have
+	class NetworkSessionPeer : public IReliableConnectionAckListener, public INetworkStatsSource {
 	public:
-		std::shared_ptr<IConnection> connection;
+		explicit NetworkSessionPeer(std::shared_ptr<IConnection> connection);
+		~NetworkSessionPeer();
+
+		NetworkSessionPeer(const NetworkSessionPeer& other) = delete;
+		NetworkSessionPeer& operator=(const NetworkSessionPeer& other) = delete;
+
+		ReliableConnection& getConnection() const;
+		void update();
+
+		// Encoded against the latest state this peer acknowledged, if any
+		SharedDataUpdate makeSharedDataUpdate(int ownerId, const Bytes& state);
+		void sendSharedDataUpdate(int ownerId, const SharedDataUpdate& update, OutboundNetworkPacket&& packet, bool isResend = false);
+		std::vector<int> getSharedDataNeedingResend() const;
+
+		// Returns the full state, unless an even newer one was already received
+		Maybe<Bytes> receiveSharedDataUpdate(int ownerId, const SharedDataUpdate& update);
+
+		void onPacketAcked(int tag) override;
+		NetworkConnectionStats getStats() const override; // SharedData updates are reported as channel -1
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		struct OutboundState {
+			uint16_t nextSeq = 0;
+			Maybe<uint16_t> ackedSeq;
+			Bytes acked;
+			std::map<uint16_t, Bytes> inFlight;
+			Clock::time_point lastSend;
+		};
+
+		struct InboundState {
+			Maybe<uint16_t> latestSeq;
+			std::map<uint16_t, Bytes> history;
+		};
+
+		std::shared_ptr<ReliableConnection> connection;
+		std::map<int, OutboundState> outbound;
+		std::map<int, InboundState> inbound;
+		NetworkChannelStats sharedDataStats;
 	};
 }
@@ -15,6 +15,11 @@ namespace Halley {
 		virtual void serialize(Serializer& s) const = 0;
 		virtual void deserialize(Deserializer& s) = 0;
 
+	protected:
+		// Opt-in for floats that don't need full precision: they're sent as a multiple of step, so jitter doesn't bloat the deltas
+		static void serializeQuantized(Serializer& s, float value, float step);
+		static float deserializeQuantized(Deserializer& s, float step);
+
 	private:
 		bool modified = false;
     };
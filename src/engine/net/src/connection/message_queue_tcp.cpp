@@ -1,9 +1,27 @@
 #include "halley/net/connection/message_queue_tcp.h"
 #include "connection/network_packet.h"
+#include "halley/bytes/compression.h"
+#include "halley/support/logger.h"
+#include <cstring>
 using namespace Halley;
 
-MessageQueueTCP::MessageQueueTCP(std::shared_ptr<IConnection> connection)
+namespace {
+	enum class BatchFlags : uint8_t {
+		None = 0,
+		LZ4 = 1
+	};
+
+	struct MessageHeader {
+		int32_t type;
+		uint32_t size;
+	};
+
+	constexpr size_t maxBatchSize = 128 * 1024 * 1024; // Same as the largest packet a TCP connection takes
+}
+
+MessageQueueTCP::MessageQueueTCP(std::shared_ptr<IConnection> connection, size_t compressionThreshold)
 	: connection(connection)
+	, compressionThreshold(compressionThreshold)
 {
 }
 
@@ -15,14 +33,41 @@ bool MessageQueueTCP::isConnected() const
 void MessageQueueTCP::enqueue(std::unique_ptr<NetworkMessage> msg, int channel)
 {
 	if (isConnected()) {
-		auto packet = OutboundNetworkPacket(Serializer::toBytes(*msg));
-		packet.addHeader(getMessageType(*msg));
-		connection->send(std::move(packet));
+		const auto data = Serializer::toBytes(*msg);
+		MessageHeader header;
+		header.type = int32_t(getMessageType(*msg));
+		header.size = uint32_t(data.size());
+
+		const size_t pos = pending.size();
+		pending.resize(pos + sizeof(header) + data.size());
+		memcpy(pending.data() + pos, &header, sizeof(header));
+		memcpy(pending.data() + pos + sizeof(header), data.data(), data.size());
 	}
 }
 
 void MessageQueueTCP::sendAll()
 {
+	if (pending.empty()) {
+		return;
+	}
+	if (!isConnected()) {
+		pending.clear();
+		return;
+	}
+
+	auto flags = BatchFlags::None;
+	Bytes compressed;
+	if (compressionThreshold > 0 && pending.size() >= compressionThreshold) {
+		compressed = Compression::compressLZ4(gsl::as_bytes(gsl::span<const Byte>(pending)));
+		if (compressed.size() < pending.size()) {
+			flags = BatchFlags::LZ4;
+		}
+	}
+
+	auto packet = OutboundNetworkPacket(flags == BatchFlags::LZ4 ? compressed : pending);
+	packet.addHeader(flags);
+	connection->send(std::move(packet));
+	pending.clear();
 }
 
 std::vector<std::unique_ptr<NetworkMessage>> MessageQueueTCP::receiveAll()
@@ -32,9 +77,40 @@ std::vector<std::unique_ptr<NetworkMessage>> MessageQueueTCP::receiveAll()
 	if (isConnected()) {
 		InboundNetworkPacket packet;
 		while (connection->receive(packet)) {
-			int messageType = -1;
-			packet.extractHeader(messageType);
-			result.push_back(deserializeMessage(packet.getBytes(), messageType, 0));
+			auto flags = BatchFlags::None;
+			packet.extractHeader(flags);
+
+			Bytes decompressed;
+			auto data = packet.getBytes();
+			if (flags == BatchFlags::LZ4) {
+				decompressed = Compression::decompressLZ4(data, maxBatchSize);
+				data = gsl::as_bytes(gsl::span<const Byte>(decompressed));
+			} else if (flags != BatchFlags::None) {
+				Logger::logError("Unknown message batch flags: " + toString(int(flags)));
+				connection->close();
+				break;
+			}
+
+			size_t pos = 0;
+			const auto size = size_t(data.size());
+			while (pos < size) {
+				MessageHeader header;
+				if (size - pos < sizeof(header)) {
+					break;
+				}
+				memcpy(&header, data.data() + pos, sizeof(header));
+				pos += sizeof(header);
+				if (size - pos < header.size) {
+					break;
+				}
+				result.push_back(deserializeMessage(data.subspan(pos, header.size), header.type, 0));
+				pos += header.size;
+			}
+			if (pos != size) {
+				Logger::logError("Truncated message batch.");
+				connection->close();
+				break;
+			}
 		}
 	}
 
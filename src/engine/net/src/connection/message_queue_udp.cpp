@@ -1,10 +1,19 @@
 #include "halley/net/connection/message_queue_udp.h"
+#include <algorithm>
 using namespace Halley;
 
-ChannelSettings::ChannelSettings(bool reliable, bool ordered, bool keepLastSent)
+namespace {
+	constexpr size_t maxPacketSize = 1200;
+	constexpr size_t minCongestionWindow = 2 * maxPacketSize;
+	constexpr size_t initialCongestionWindow = 8 * maxPacketSize;
+	constexpr size_t maxCongestionWindow = 256 * maxPacketSize;
+}
+
+ChannelSettings::ChannelSettings(bool reliable, bool ordered, bool keepLastSent, int priority)
 	: reliable(reliable)
 	, ordered(ordered)
 	, keepLastSent(keepLastSent)
+	, priority(priority)
 {}
 
 void MessageQueueUDP::Channel::getReadyMessages(std::vector<std::unique_ptr<NetworkMessage>>& out)
@@ -62,16 +71,25 @@ void MessageQueueUDP::Channel::getReadyMessages(std::vector<std::unique_ptr<Netw
 MessageQueueUDP::MessageQueueUDP(std::shared_ptr<ReliableConnection> conn)
 	: connection(conn)
 	, channels(32)
+	, congestionWindow(initialCongestionWindow)
+	, slowStartThreshold(maxCongestionWindow)
 {
 	Expects(connection);
 	connection->addAckListener(*this);
+	NetworkStats::addSource(*this);
 }
 
 MessageQueueUDP::~MessageQueueUDP()
 {
+	NetworkStats::removeSource(*this);
 	connection->removeAckListener(*this);
 }
 
+bool MessageQueueUDP::isConnected() const
+{
+	return connection->getStatus() == ConnectionStatus::Connected;
+}
+
 void MessageQueueUDP::setChannel(int channel, ChannelSettings settings)
 {
 	Expects(channel >= 0);
@@ -84,6 +102,7 @@ void MessageQueueUDP::setChannel(int channel, ChannelSettings settings)
 	auto& c = channels[channel];
 	c.settings = settings;
 	c.initialized = true;
+	hasChannelPriorities = hasChannelPriorities || settings.priority != 0;
 }
 
 void MessageQueueUDP::receiveMessages()
@@ -94,6 +113,8 @@ void MessageQueueUDP::receiveMessages()
 			auto data = packet.getBytes();
 
 			while (data.size() > 0) {
+				const auto msgStart = data.size();
+
 				// Read channel
 				char channelN;
 				memcpy(&channelN, data.data(), 1);
@@ -158,6 +179,9 @@ void MessageQueueUDP::receiveMessages()
 				}
 				channel.receiveQueue.emplace_back(deserializeMessage(data.subspan(0, size), msgType, sequence));
 				data = data.subspan(size);
+
+				++channel.stats.messagesReceived;
+				channel.stats.bytesReceived += uint64_t(msgStart - data.size());
 			}
 		}
 	} catch (std::exception& e) {
@@ -174,7 +198,13 @@ std::vector<std::unique_ptr<NetworkMessage>> MessageQueueUDP::receiveAll()
 		receiveMessages();
 	}
 
+	size_t nQueued = 0;
+	for (auto& c: channels) {
+		nQueued += c.receiveQueue.size();
+	}
+
 	std::vector<std::unique_ptr<NetworkMessage>> result;
+	result.reserve(nQueued);
 	for (auto& c: channels) {
 		c.getReadyMessages(result);
 	}
@@ -199,22 +229,34 @@ void MessageQueueUDP::enqueue(std::unique_ptr<NetworkMessage> msg, int channelNu
 
 void MessageQueueUDP::sendAll()
 {
-	//int firstTag = nextPacketId;
-	std::vector<ReliableSubPacket> toSend;
+	// Kept between calls so its storage gets reused
+	toSend.clear();
 
 	// Add packets which need to be re-sent
 	checkReSend(toSend);
 
-	// Create packets of pending messages
-	while (!pendingMsgs.empty()) {
+	// Create packets of pending messages, for as long as the link can take them
+	coalesceUnreliable();
+	if (hasChannelPriorities) {
+		std::stable_sort(pendingMsgs.begin(), pendingMsgs.end(), [&] (const std::unique_ptr<NetworkMessage>& a, const std::unique_ptr<NetworkMessage>& b)
+		{
+			return channels[a->channel].settings.priority > channels[b->channel].settings.priority;
+		});
+	}
+	while (!pendingMsgs.empty() && canSend()) {
 		toSend.emplace_back(createPacket());
+		bytesInFlight += toSend.back().data.size();
 	}
 
+	// Anything unreliable that didn't make it is stale by the next send, so don't let it pile up
+	dropUnreliable();
+
 	// Send and update sequences
-	connection->sendTagged(toSend);
+	sendPackets(toSend);
 	for (auto& pending: toSend) {
 		pendingPackets[pending.tag].seq = pending.seq;
 	}
+	toSend.clear();
 }
 
 void MessageQueueUDP::onPacketAcked(int tag)
@@ -233,67 +275,201 @@ void MessageQueueUDP::onPacketAcked(int tag)
 			}
 		}
 
+		// Grow the window: exponentially until the first loss, then by about one packet per round-trip
+		if (!packet.lost) {
+			bytesInFlight -= std::min(bytesInFlight, packet.size);
+			if (congestionWindow < slowStartThreshold) {
+				congestionWindow += packet.size;
+			} else {
+				congestionWindow += std::max(size_t(1), maxPacketSize * packet.size / congestionWindow);
+			}
+			congestionWindow = std::min(congestionWindow, maxCongestionWindow);
+		}
+
 		// Remove pending
-		pendingPackets.erase(tag);
+		erasePendingPacket(i);
 	}
 }
 
 void MessageQueueUDP::checkReSend(std::vector<ReliableSubPacket>& collect)
 {
+	const auto now = std::chrono::steady_clock::now();
 	auto next = pendingPackets.begin();
 	for (auto iter = pendingPackets.begin(); iter != pendingPackets.end(); iter = next) {
 		++next;
 		auto& pending = iter->second;
+		if (pending.lost) {
+			continue;
+		}
 
 		// Check how long it's been waiting
-		float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - pending.timeSent).count();
+		float elapsed = std::chrono::duration<float>(now - pending.timeSent).count();
 		if (elapsed > 0.1f && elapsed > connection->getLatency() * 3.0f) {
-			// Re-send if it's reliable
+			bytesInFlight -= std::min(bytesInFlight, pending.size);
+			onCongestion();
+
+			// Re-send if it's reliable, otherwise it's gone
 			if (pending.reliable) {
-				collect.push_back(makeTaggedPacket(pending.msgs, pending.size, true, pending.seq));
+				pending.lost = true;
+			} else {
+				erasePendingPacket(iter);
+			}
+		}
+	}
+
+	// Oldest first, so the receiver can deliver ordered messages sooner
+	for (auto iter = pendingPackets.begin(); iter != pendingPackets.end() && canSend(); iter = next) {
+		next = iter;
+		++next;
+		auto& pending = iter->second;
+		if (pending.lost) {
+			collect.push_back(makeTaggedPacket(pending.msgs, pending.size, true, pending.seq));
+			bytesInFlight += pending.size;
+			erasePendingPacket(iter);
+		}
+	}
+}
+
+bool MessageQueueUDP::canSend() const
+{
+	// Always let something through when nothing is in flight, or the window could never recover
+	return bytesInFlight == 0 || bytesInFlight < congestionWindow;
+}
+
+void MessageQueueUDP::onCongestion()
+{
+	// A burst of losses is one congestion event, so only back off once per round-trip
+	const auto now = std::chrono::steady_clock::now();
+	const float sinceLast = std::chrono::duration<float>(now - lastCongestionEvent).count();
+	if (sinceLast > std::max(0.1f, connection->getLatency())) {
+		lastCongestionEvent = now;
+		// Backs off less than halving, since wireless links lose packets without being congested
+		slowStartThreshold = std::max(minCongestionWindow, congestionWindow * 7 / 10);
+		congestionWindow = slowStartThreshold;
+	}
+}
+
+void MessageQueueUDP::coalesceUnreliable()
+{
+	// Unreliable ordered channels only ever deliver their latest message, so only send that one
+	uint32_t seen = 0;
+	size_t nKept = pendingMsgs.size();
+	for (size_t i = pendingMsgs.size(); i-- > 0; ) {
+		auto& msg = pendingMsgs[i];
+		auto& channel = channels[msg->channel];
+		if (!channel.settings.reliable && channel.settings.ordered) {
+			const uint32_t bit = 1u << uint32_t(msg->channel);
+			if (seen & bit) {
+				++channel.stats.messagesDropped;
+				continue;
 			}
-			pendingPackets.erase(iter);
+			seen |= bit;
+		}
+		--nKept;
+		if (nKept != i) {
+			pendingMsgs[nKept] = std::move(msg);
 		}
 	}
+	pendingMsgs.erase(pendingMsgs.begin(), pendingMsgs.begin() + nKept);
+}
+
+void MessageQueueUDP::dropUnreliable()
+{
+	size_t nKept = 0;
+	for (size_t i = 0; i < pendingMsgs.size(); ++i) {
+		auto& msg = pendingMsgs[i];
+		auto& channel = channels[msg->channel];
+		if (!channel.settings.reliable) {
+			++channel.stats.messagesDropped;
+			continue;
+		}
+		if (nKept != i) {
+			pendingMsgs[nKept] = std::move(msg);
+		}
+		++nKept;
+	}
+	pendingMsgs.resize(nKept);
+}
+
+void MessageQueueUDP::sendPackets(gsl::span<ReliableSubPacket> packets)
+{
+	if (packets.empty()) {
+		// Still goes out, as it carries acks
+		connection->sendTagged(packets);
+		return;
+	}
+
+	// Group as many as will fit in one datagram
+	size_t start = 0;
+	size_t groupSize = 0;
+	for (size_t i = 0; i < size_t(packets.size()); ++i) {
+		const size_t size = packets[i].data.size();
+		if (i > start && groupSize + size > maxPacketSize) {
+			connection->sendTagged(packets.subspan(start, i - start));
+			start = i;
+			groupSize = 0;
+		}
+		groupSize += size;
+	}
+	connection->sendTagged(packets.subspan(start));
+}
+
+void MessageQueueUDP::erasePendingPacket(std::map<int, PendingPacket>::iterator iter)
+{
+	// Hold on to the message list, so the next packet doesn't have to allocate one
+	auto& msgs = iter->second.msgs;
+	if (msgs.capacity() > 0 && spareMsgLists.size() < 64) {
+		msgs.clear();
+		spareMsgLists.push_back(std::move(msgs));
+	}
+	pendingPackets.erase(iter);
 }
 
 ReliableSubPacket MessageQueueUDP::createPacket()
 {
 	std::vector<std::unique_ptr<NetworkMessage>> sentMsgs;
-	size_t maxSize = 1200;
+	if (!spareMsgLists.empty()) {
+		sentMsgs = std::move(spareMsgLists.back());
+		spareMsgLists.pop_back();
+	}
+	size_t maxSize = maxPacketSize;
 	size_t size = 0;
 	bool first = true;
 	bool packetReliable = false;
 
-	// Figure out what messages are going in this packet
-	auto next = pendingMsgs.begin();
-	for (auto iter = pendingMsgs.begin(); iter != pendingMsgs.end(); iter = next) {
-		++next;
-		auto& msg = *iter;
+	// Figure out what messages are going in this packet; the ones left behind are compacted in order
+	size_t nKept = 0;
+	for (size_t i = 0; i < pendingMsgs.size(); ++i) {
+		auto& msg = pendingMsgs[i];
+		bool taken = false;
 
 		// Check if this message is compatible
 		auto& channel = channels[msg->channel];
 		bool isReliable = channel.settings.reliable;
-		bool isOrdered = channel.settings.ordered;
 		if (first || isReliable == packetReliable) {
 			// Check if the message fits
-			size_t msgSize = (*iter)->getSerializedSize();
-			int msgType = getMessageType(**iter);
-			size_t headerSize = 1 + (isOrdered ? 2 : 0) + (msgSize >= 128 ? 2 : 1) + (msgType >= 128 ? 2 : 1);
-			size_t totalSize = headerSize + msgSize;
+			size_t totalSize = getSizeWithHeader(*msg);
 
 			if (size + totalSize <= maxSize) {
 				// It fits, so add it
 				size += totalSize;
 
-				sentMsgs.push_back(std::move(*iter));
-				pendingMsgs.erase(iter);
+				sentMsgs.push_back(std::move(msg));
+				taken = true;
 
 				first = false;
 				packetReliable = isReliable;
 			}
 		}
+
+		if (!taken) {
+			if (nKept != i) {
+				pendingMsgs[nKept] = std::move(msg);
+			}
+			++nKept;
+		}
 	}
+	pendingMsgs.resize(nKept);
 
 	if (sentMsgs.empty()) {
 		throw Exception("Was not able to fit any messages into packet!", HalleyExceptions::Network);
@@ -307,6 +483,15 @@ ReliableSubPacket MessageQueueUDP::makeTaggedPacket(std::vector<std::unique_ptr<
 	bool reliable = !msgs.empty() && channels[msgs[0]->channel].settings.reliable;
 
 	auto data = serializeMessages(msgs, size);
+	for (auto& msg: msgs) {
+		auto& stats = channels[msg->channel].stats;
+		if (resends) {
+			++stats.messagesResent;
+		} else {
+			++stats.messagesSent;
+		}
+		stats.bytesSent += getSizeWithHeader(*msg);
+	}
 
 	int tag = nextPacketId++;
 	auto& pendingData = pendingPackets[tag];
@@ -322,9 +507,19 @@ ReliableSubPacket MessageQueueUDP::makeTaggedPacket(std::vector<std::unique_ptr<
 	return result;
 }
 
-std::vector<gsl::byte> MessageQueueUDP::serializeMessages(const std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size) const
+size_t MessageQueueUDP::getSizeWithHeader(NetworkMessage& msg) const
+{
+	size_t msgSize = msg.getSerializedSize();
+	int msgType = getMessageType(msg);
+	bool isOrdered = channels[msg.channel].settings.ordered;
+	size_t headerSize = 1 + (isOrdered ? 2 : 0) + (msgSize >= 128 ? 2 : 1) + (msgType >= 128 ? 2 : 1);
+	return headerSize + msgSize;
+}
+
+NetworkPacketBuffer MessageQueueUDP::serializeMessages(const std::vector<std::unique_ptr<NetworkMessage>>& msgs, size_t size) const
 {
-	std::vector<gsl::byte> result(size);
+	// Messages are serialized straight into the packet's buffer
+	NetworkPacketBuffer result(size);
 	size_t pos = 0;
 	
 	for (auto& msg: msgs) {
@@ -336,41 +531,78 @@ std::vector<gsl::byte> MessageQueueUDP::serializeMessages(const std::vector<std:
 		bool isOrdered = channel.settings.ordered;
 
 		// Write header
-		memcpy(&result[pos], &channelN, 1);
+		memcpy(result.data() + pos, &channelN, 1);
 		pos += 1;
 		if (isOrdered) {
 			unsigned short sequence = static_cast<unsigned short>(msg->seq);
-			memcpy(&result[pos], &sequence, 2);
+			memcpy(result.data() + pos, &sequence, 2);
 			pos += 2;
 		}
 		if (msgSize >= 128) {
 			std::array<unsigned char, 2> bytes;
 			bytes[0] = static_cast<unsigned char>(msgSize >> 8) | 0x80;
 			bytes[1] = static_cast<unsigned char>(msgSize & 0xFF);
-			memcpy(&result[pos], bytes.data(), 2);
+			memcpy(result.data() + pos, bytes.data(), 2);
 			pos += 2;
 		} else {
 			unsigned char byte = msgSize & 0x7F;
-			memcpy(&result[pos], &byte, 1);
+			memcpy(result.data() + pos, &byte, 1);
 			pos += 1;
 		}
 		if (msgType >= 128) {
 			std::array<unsigned char, 2> bytes;
 			bytes[0] = static_cast<unsigned char>(msgType >> 8) | 0x80;
 			bytes[1] = static_cast<unsigned char>(msgType & 0xFF);
-			memcpy(&result[pos], bytes.data(), 2);
+			memcpy(result.data() + pos, bytes.data(), 2);
 			pos += 2;
 		}
 		else {
 			unsigned char byte = msgType & 0x7F;
-			memcpy(&result[pos], &byte, 1);
+			memcpy(result.data() + pos, &byte, 1);
 			pos += 1;
 		}
 
 		// Write message
-		msg->serializeTo(gsl::span<gsl::byte>(result).subspan(pos, msgSize));
+		msg->serializeTo(result.getSpan().subspan(pos, msgSize));
 		pos += msgSize;
 	}
 
 	return result;
 }
+
+void MessageQueueUDP::setStatsName(const String& name)
+{
+	statsName = name;
+}
+
+NetworkConnectionStats MessageQueueUDP::getStats() const
+{
+	auto result = connection->getStats();
+	result.name = statsName;
+	result.congestionWindow = congestionWindow;
+	result.bytesInFlight = bytesInFlight;
+
+	std::vector<NetworkChannelStats> channelStats(channels.size());
+	for (size_t i = 0; i < channels.size(); ++i) {
+		channelStats[i] = channels[i].stats;
+		channelStats[i].channel = int(i);
+		channelStats[i].waitingForDelivery = channels[i].receiveQueue.size();
+	}
+	for (auto& msg: pendingMsgs) {
+		++channelStats[msg->channel].queuedToSend;
+	}
+	for (auto& packet: pendingPackets) {
+		for (auto& msg: packet.second.msgs) {
+			if (msg) {
+				++channelStats[msg->channel].waitingForAck;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < channels.size(); ++i) {
+		if (channels[i].initialized) {
+			result.channels.push_back(channelStats[i]);
+		}
+	}
+	return result;
+}
@@ -0,0 +1,93 @@
+#include "connection/network_message.h"
+#include <array>
+#include <mutex>
+#include <new>
+
+using namespace Halley;
+
+namespace {
+	class NetworkMessagePool
+	{
+	public:
+		static NetworkMessagePool& get()
+		{
+			// Never destroyed, as messages owned by statics can still be freed during shutdown
+			static auto* pool = new NetworkMessagePool();
+			return *pool;
+		}
+
+		void* allocate(size_t size)
+		{
+			if (size > maxSize) {
+				return ::operator new(size);
+			}
+
+			auto& bucket = buckets[getBucket(size)];
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (bucket.head) {
+					auto block = bucket.head;
+					bucket.head = block->next;
+					--bucket.count;
+					return block;
+				}
+			}
+			return ::operator new(getBucketSize(size));
+		}
+
+		void deallocate(void* ptr, size_t size)
+		{
+			if (size <= maxSize) {
+				auto& bucket = buckets[getBucket(size)];
+				std::unique_lock<std::mutex> lock(mutex);
+				if (bucket.count < maxBlocksPerBucket) {
+					auto block = static_cast<FreeBlock*>(ptr);
+					block->next = bucket.head;
+					bucket.head = block;
+					++bucket.count;
+					return;
+				}
+			}
+			::operator delete(ptr);
+		}
+
+	private:
+		constexpr static size_t granularity = 16;
+		constexpr static size_t maxSize = 512;
+		constexpr static size_t maxBlocksPerBucket = 1024;
+
+		struct FreeBlock
+		{
+			FreeBlock* next;
+		};
+
+		struct Bucket
+		{
+			FreeBlock* head = nullptr;
+			size_t count = 0;
+		};
+
+		std::mutex mutex;
+		std::array<Bucket, maxSize / granularity> buckets;
+
+		static size_t getBucket(size_t size)
+		{
+			return (size + granularity - 1) / granularity - 1;
+		}
+
+		static size_t getBucketSize(size_t size)
+		{
+			return (getBucket(size) + 1) * granularity;
+		}
+	};
+}
+
+void* NetworkMessage::operator new(size_t size)
+{
+	return NetworkMessagePool::get().allocate(size);
+}
+
+void NetworkMessage::operator delete(void* ptr, size_t size)
+{
+	NetworkMessagePool::get().deallocate(ptr, size);
+}
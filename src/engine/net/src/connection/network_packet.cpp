@@ -1,9 +1,130 @@
 #include "connection/network_packet.h"
 #include <halley/support/exception.h>
 #include <cassert>
+#include <mutex>
 
 using namespace Halley;
 
+namespace {
+	class NetworkPacketBufferPool
+	{
+	public:
+		NetworkPacketBufferPool()
+		{
+			buffers.reserve(maxBuffers);
+		}
+
+		static NetworkPacketBufferPool& get()
+		{
+			// Never destroyed, as packets owned by statics can still be returning buffers during shutdown
+			static auto* pool = new NetworkPacketBufferPool();
+			return *pool;
+		}
+
+		void acquire(std::vector<gsl::byte>& dst)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (!buffers.empty()) {
+					dst = std::move(buffers.back());
+					buffers.pop_back();
+					return;
+				}
+			}
+			dst.reserve(NetworkPacketBuffer::pooledCapacity);
+		}
+
+		void release(std::vector<gsl::byte>& src)
+		{
+			// Anything that grew way past a packet's size is probably a one-off, so let it go
+			if (src.capacity() > 4 * NetworkPacketBuffer::pooledCapacity) {
+				std::vector<gsl::byte>().swap(src);
+				return;
+			}
+
+			src.clear();
+			std::unique_lock<std::mutex> lock(mutex);
+			if (buffers.size() < maxBuffers) {
+				buffers.push_back(std::move(src));
+			}
+		}
+
+	private:
+		constexpr static size_t maxBuffers = 1024;
+
+		std::mutex mutex;
+		std::vector<std::vector<gsl::byte>> buffers;
+	};
+}
+
+NetworkPacketBuffer::NetworkPacketBuffer()
+{}
+
+NetworkPacketBuffer::NetworkPacketBuffer(size_t size)
+{
+	resize(size);
+}
+
+NetworkPacketBuffer::NetworkPacketBuffer(gsl::span<const gsl::byte> src)
+{
+	resize(size_t(src.size_bytes()));
+	memcpy(bytes.data(), src.data(), src.size_bytes());
+}
+
+NetworkPacketBuffer::NetworkPacketBuffer(const NetworkPacketBuffer& other)
+	: NetworkPacketBuffer(other.getSpan())
+{}
+
+NetworkPacketBuffer::NetworkPacketBuffer(NetworkPacketBuffer&& other) noexcept
+	: bytes(std::move(other.bytes))
+{}
+
+NetworkPacketBuffer::~NetworkPacketBuffer()
+{
+	release();
+}
+
+NetworkPacketBuffer& NetworkPacketBuffer::operator=(const NetworkPacketBuffer& other)
+{
+	if (this != &other) {
+		resize(other.size());
+		memcpy(bytes.data(), other.bytes.data(), other.size());
+	}
+	return *this;
+}
+
+NetworkPacketBuffer& NetworkPacketBuffer::operator=(NetworkPacketBuffer&& other) noexcept
+{
+	// The other buffer will return ours to the pool
+	std::swap(bytes, other.bytes);
+	return *this;
+}
+
+void NetworkPacketBuffer::resize(size_t size)
+{
+	if (bytes.capacity() == 0 && size > 0) {
+		acquire();
+	}
+	bytes.resize(size);
+}
+
+void NetworkPacketBuffer::clear()
+{
+	bytes.clear();
+}
+
+void NetworkPacketBuffer::acquire()
+{
+	NetworkPacketBufferPool::get().acquire(bytes);
+}
+
+void NetworkPacketBuffer::release()
+{
+	if (bytes.capacity() > 0) {
+		NetworkPacketBufferPool::get().release(bytes);
+	}
+}
+
 NetworkPacketBase::NetworkPacketBase()
 	: dataStart(0)
 {}
@@ -32,7 +153,7 @@ size_t NetworkPacketBase::getSize() const
 
 gsl::span<const gsl::byte> NetworkPacketBase::getBytes() const
 {
-	return gsl::span<const gsl::byte>(data).subspan(dataStart, getSize());
+	return data.getSpan().subspan(dataStart, getSize());
 }
 
 OutboundNetworkPacket::OutboundNetworkPacket(const OutboundNetworkPacket& other)
@@ -44,7 +165,7 @@ OutboundNetworkPacket::OutboundNetworkPacket(const OutboundNetworkPacket& other)
 
 OutboundNetworkPacket::OutboundNetworkPacket(OutboundNetworkPacket&& other) noexcept
 {
-	data = other.data;
+	data = std::move(other.data);
 	dataStart = other.dataStart;
 	other.dataStart = 0;
 }
@@ -68,7 +189,7 @@ void OutboundNetworkPacket::addHeader(gsl::span<const gsl::byte> src)
 
 OutboundNetworkPacket& OutboundNetworkPacket::operator=(OutboundNetworkPacket&& other) noexcept
 {
-	data = other.data;
+	data = std::move(other.data);
 	dataStart = other.dataStart;
 	other.dataStart = 0;
 	return *this;
@@ -81,7 +202,7 @@ InboundNetworkPacket::InboundNetworkPacket()
 InboundNetworkPacket::InboundNetworkPacket(InboundNetworkPacket&& other)
 	: NetworkPacketBase()
 {
-	data = other.data;
+	data = std::move(other.data);
 	dataStart = other.dataStart;
 	other.dataStart = 0;
 }
@@ -90,6 +211,14 @@ InboundNetworkPacket::InboundNetworkPacket(gsl::span<const gsl::byte> data)
 	: NetworkPacketBase(data, 0)
 {}
 
+InboundNetworkPacket::InboundNetworkPacket(NetworkPacketBuffer&& buffer, size_t start)
+	: NetworkPacketBase()
+{
+	Expects(start <= buffer.size());
+	data = std::move(buffer);
+	dataStart = start;
+}
+
 void InboundNetworkPacket::extractHeader(gsl::span<gsl::byte> dst)
 {
 	Expects(dst.size_bytes() <= signed(data.size()));
@@ -100,7 +229,7 @@ void InboundNetworkPacket::extractHeader(gsl::span<gsl::byte> dst)
 
 InboundNetworkPacket& InboundNetworkPacket::operator=(InboundNetworkPacket&& other)
 {
-	data = other.data;
+	data = std::move(other.data);
 	dataStart = other.dataStart;
 	other.dataStart = 0;
 	return *this;
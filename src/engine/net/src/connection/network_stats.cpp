@@ -0,0 +1,173 @@
+#include "connection/network_stats.h"
+#include "halley/bytes/byte_serializer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+using namespace Halley;
+
+namespace {
+	constexpr std::array<float, NetworkLatencyHistogram::numBuckets - 1> bucketBounds = {{ 0.005f, 0.01f, 0.02f, 0.04f, 0.08f, 0.16f, 0.32f, 0.64f, 1.28f }};
+
+	std::mutex& getSourcesMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	std::vector<INetworkStatsSource*>& getSources()
+	{
+		static std::vector<INetworkStatsSource*> sources;
+		return sources;
+	}
+}
+
+float NetworkLatencyHistogram::getBucketUpperBound(size_t bucket)
+{
+	return bucket < bucketBounds.size() ? bucketBounds[bucket] : std::numeric_limits<float>::infinity();
+}
+
+void NetworkLatencyHistogram::add(float rtt)
+{
+	const size_t bucket = size_t(std::lower_bound(bucketBounds.begin(), bucketBounds.end(), rtt) - bucketBounds.begin());
+	++counts[bucket];
+}
+
+uint64_t NetworkLatencyHistogram::getTotal() const
+{
+	uint64_t total = 0;
+	for (auto c: counts) {
+		total += c;
+	}
+	return total;
+}
+
+float NetworkLatencyHistogram::getPercentile(float fraction) const
+{
+	const uint64_t total = getTotal();
+	if (total == 0) {
+		return 0;
+	}
+
+	const auto threshold = uint64_t(std::ceil(double(total) * double(fraction)));
+	uint64_t acc = 0;
+	for (size_t i = 0; i < numBuckets; ++i) {
+		acc += counts[i];
+		if (acc >= threshold) {
+			return getBucketUpperBound(i);
+		}
+	}
+	return getBucketUpperBound(numBuckets - 1);
+}
+
+void NetworkLatencyHistogram::serialize(Serializer& s) const
+{
+	for (auto c: counts) {
+		s << c;
+	}
+}
+
+void NetworkLatencyHistogram::deserialize(Deserializer& s)
+{
+	for (auto& c: counts) {
+		s >> c;
+	}
+}
+
+void NetworkChannelStats::serialize(Serializer& s) const
+{
+	s << channel;
+	s << messagesSent;
+	s << messagesResent;
+	s << messagesDropped;
+	s << messagesReceived;
+	s << bytesSent;
+	s << bytesReceived;
+	s << uint64_t(queuedToSend);
+	s << uint64_t(waitingForAck);
+	s << uint64_t(waitingForDelivery);
+}
+
+void NetworkChannelStats::deserialize(Deserializer& s)
+{
+	s >> channel;
+	s >> messagesSent;
+	s >> messagesResent;
+	s >> messagesDropped;
+	s >> messagesReceived;
+	s >> bytesSent;
+	s >> bytesReceived;
+
+	uint64_t value;
+	s >> value;
+	queuedToSend = size_t(value);
+	s >> value;
+	waitingForAck = size_t(value);
+	s >> value;
+	waitingForDelivery = size_t(value);
+}
+
+void NetworkConnectionStats::serialize(Serializer& s) const
+{
+	s << name;
+	s << packetsSent;
+	s << packetsReceived;
+	s << bytesSent;
+	s << bytesReceived;
+	s << subPacketsSent;
+	s << subPacketsResent;
+	s << subPacketsAcked;
+	s << subPacketsLost;
+	s << latency;
+	s << packetLoss;
+	s << rtt;
+	s << uint64_t(congestionWindow);
+	s << uint64_t(bytesInFlight);
+	s << channels;
+}
+
+void NetworkConnectionStats::deserialize(Deserializer& s)
+{
+	s >> name;
+	s >> packetsSent;
+	s >> packetsReceived;
+	s >> bytesSent;
+	s >> bytesReceived;
+	s >> subPacketsSent;
+	s >> subPacketsResent;
+	s >> subPacketsAcked;
+	s >> subPacketsLost;
+	s >> latency;
+	s >> packetLoss;
+	s >> rtt;
+	uint64_t value;
+	s >> value;
+	congestionWindow = size_t(value);
+	s >> value;
+	bytesInFlight = size_t(value);
+	s >> channels;
+}
+
+void NetworkStats::addSource(INetworkStatsSource& source)
+{
+	std::unique_lock<std::mutex> lock(getSourcesMutex());
+	getSources().push_back(&source);
+}
+
+void NetworkStats::removeSource(INetworkStatsSource& source)
+{
+	std::unique_lock<std::mutex> lock(getSourcesMutex());
+	auto& sources = getSources();
+	sources.erase(std::remove(sources.begin(), sources.end(), &source), sources.end());
+}
+
+std::vector<NetworkConnectionStats> NetworkStats::capture()
+{
+	std::unique_lock<std::mutex> lock(getSourcesMutex());
+	std::vector<NetworkConnectionStats> result;
+	for (auto& source: getSources()) {
+		result.push_back(source->getStats());
+	}
+	return result;
+}
@@ -46,7 +46,7 @@ void ReliableConnection::send(OutboundNetworkPacket&& packet)
 {
 	ReliableSubPacket subPacket;
 	subPacket.data.resize(packet.getSize());
-	packet.copyTo(subPacket.data);
+	packet.copyTo(subPacket.data.getSpan());
 	subPacket.resends = false;
 	subPacket.tag = -1;
 
@@ -65,6 +65,9 @@ void ReliableConnection::sendTagged(gsl::span<ReliableSubPacket> subPackets)
 		bool isResend = subPacket.resends;
 		unsigned short resending = subPacket.resendSeq;
 		size_t size = subPacket.data.size();
+		if (pos + size + 4 > dst.size()) {
+			throw Exception("Packet too large to send: " + toString(pos + size + 4) + " bytes, maximum is " + toString(dst.size()) + " bytes.", HalleyExceptions::Network);
+		}
 		bool longSize = size >= 64;
 		if (longSize) {
 			std::array<unsigned char, 2> b;
@@ -98,6 +101,11 @@ void ReliableConnection::sendTagged(gsl::span<ReliableSubPacket> subPackets)
 		sent.tag = subPacket.tag;
 		lastSend = sent.timestamp = Clock::now();
 
+		++stats.subPacketsSent;
+		if (isResend) {
+			++stats.subPacketsResent;
+		}
+
 		// Update caller on the sequence number of this
 		subPacket.seq = seq;
 		if (subPacket.resends) {
@@ -118,6 +126,8 @@ void ReliableConnection::sendTagged(gsl::span<ReliableSubPacket> subPackets)
 #endif
 
 	// Send
+	++stats.packetsSent;
+	stats.bytesSent += pos;
 	parent->send(OutboundNetworkPacket(dst.subspan(0, pos)));
 }
 
@@ -128,6 +138,8 @@ bool ReliableConnection::receive(InboundNetworkPacket& packet)
 		InboundNetworkPacket tmp;
 		while (parent->receive(tmp)) {
 			lastReceive = Clock::now();
+			++stats.packetsReceived;
+			stats.bytesReceived += tmp.getSize();
 			processReceivedPacket(tmp);
 		}
 	} catch (std::exception& e) {
@@ -221,6 +233,27 @@ void ReliableConnection::processReceivedAcks(unsigned short ack, unsigned int ac
 		}
 	}
 	onAckReceived(ack);
+	checkForLostPackets(ack);
+}
+
+void ReliableConnection::checkForLostPackets(unsigned short ack)
+{
+	// Once a sequence is older than everything the ack bits cover, it's never going to be acked
+	const unsigned short windowStart = static_cast<unsigned short>(ack - 32);
+	while (nextLossCheck != nextSequenceToSend) {
+		const unsigned short behind = windowStart - nextLossCheck;
+		if (behind == 0 || behind >= 0x8000) {
+			break;
+		}
+
+		auto& data = sentPackets[nextLossCheck % BUFFER_SIZE];
+		if (data.waiting) {
+			data.waiting = false;
+			++stats.subPacketsLost;
+			stats.packetLoss = lerp(stats.packetLoss, 1.0f, 0.02f);
+		}
+		++nextLossCheck;
+	}
 }
 
 bool ReliableConnection::onSeqReceived(unsigned short seq, bool isResend, unsigned short resendOf)
@@ -246,7 +279,8 @@ bool ReliableConnection::onSeqReceived(unsigned short seq, bool isResend, unsign
 	}
 
 	if (receivedSeqs[bufferPos] != 0 || (isResend && receivedSeqs[resendPos] != 0)) {
-		// Already received
+		// Already received, but ack this one too, or the sender will keep re-sending it
+		receivedSeqs[bufferPos] |= 1;
 		return false;
 	}
 
@@ -271,6 +305,10 @@ void ReliableConnection::onAckReceived(unsigned short sequence)
 		}
 		float msgLag = std::chrono::duration<float>(Clock::now() - data.timestamp).count();
 		reportLatency(msgLag);
+
+		++stats.subPacketsAcked;
+		stats.packetLoss = lerp(stats.packetLoss, 0.0f, 0.02f);
+		stats.rtt.add(msgLag);
 	}
 }
 
@@ -305,3 +343,10 @@ float ReliableConnection::getTimeSinceLastReceive() const
 	return std::chrono::duration<float>(Clock::now() - lastReceive).count();
 }
 
+
+NetworkConnectionStats ReliableConnection::getStats() const
+{
+	auto result = stats;
+	result.latency = lag;
+	return result;
+}
@@ -33,7 +33,7 @@ void NetworkSession::join(const String& address, int port)
 {
 	Expects(type == NetworkSessionType::Undefined);
 
-	connections.emplace_back(service.connect(address, port));
+	peers.push_back(std::make_unique<NetworkSessionPeer>(service.connect(address, port)));
 	
 	type = NetworkSessionType::Client;
 
@@ -42,10 +42,10 @@ void NetworkSession::join(const String& address, int port)
 
 void NetworkSession::close()
 {
-	for (auto& c: connections) {
-		c->close();
+	for (auto& p: peers) {
+		p->getConnection().close();
 	}
-	connections.clear();
+	peers.clear();
 
 	type = NetworkSessionType::Undefined;
 	myPeerId = -1;
@@ -73,8 +73,8 @@ int NetworkSession::getClientCount() const
 		//return getStatus() != ConnectionStatus::Open ? 0 : 2; // TODO
 	} else if (type == NetworkSessionType::Host) {
 		int i = 1;
-		for (auto& c: connections) {
-			if (c->getStatus() == ConnectionStatus::Connected) {
+		for (auto& p: peers) {
+			if (p->getConnection().getStatus() == ConnectionStatus::Connected) {
 				++i;
 			}
 		}
@@ -86,18 +86,20 @@ int NetworkSession::getClientCount() const
 
 void NetworkSession::acceptConnection(std::shared_ptr<IConnection> incoming)
 {
-	connections.emplace_back(std::move(incoming));
+	peers.push_back(std::make_unique<NetworkSessionPeer>(std::move(incoming)));
 
 	ControlMsgSetPeerId msg;
-	msg.peerId = int8_t(connections.size());
+	msg.peerId = int8_t(peers.size());
 	Bytes bytes = Serializer::toBytes(msg);
 	sharedData[msg.peerId] = makePeerSharedData();
 
-	auto& conn = *connections.back();
-	conn.send(doMakeControlPacket(NetworkSessionControlMessageType::SetPeerId, OutboundNetworkPacket(bytes)));
-	conn.send(makeUpdateSharedDataPacket(-1));
+	auto& peer = *peers.back();
+	peer.getConnection().send(doMakeControlPacket(NetworkSessionControlMessageType::SetPeerId, OutboundNetworkPacket(bytes)));
+	sendSharedData(peer, -1, Serializer::toBytes(*sessionSharedData));
 	for (auto& i: sharedData) {
-		conn.send(makeUpdateSharedDataPacket(i.first));
+		if (i.first != msg.peerId) {
+			sendSharedData(peer, i.first, Serializer::toBytes(*i.second));
+		}
 	}
 	onConnected(msg.peerId);
 }
@@ -106,7 +108,7 @@ void NetworkSession::update()
 {
 	// Remove dead connections
 	service.update();
-	connections.erase(std::remove_if(connections.begin(), connections.end(), [] (const std::shared_ptr<IConnection>& c) { return c->getStatus() == ConnectionStatus::Closed; }), connections.end());
+	peers.erase(std::remove_if(peers.begin(), peers.end(), [] (const std::unique_ptr<NetworkSessionPeer>& p) { return p->getConnection().getStatus() == ConnectionStatus::Closed; }), peers.end());
 
 	if (type == NetworkSessionType::Host) {
 		if (getClientCount() < maxClients) { // I'm also a client!
@@ -119,22 +121,24 @@ void NetworkSession::update()
 			service.setAcceptingConnections(false);
 		}
 
+		// Includes whatever was received from clients, which is relayed to the others
 		checkForOutboundStateChanges(-1);
+		for (auto& i: sharedData) {
+			checkForOutboundStateChanges(i.first);
+		}
 	}
 
 	if (type == NetworkSessionType::Client) {
-		if (connections.empty()) {
+		if (peers.empty()) {
 			close();
+		} else if (myPeerId != -1 && sharedData.find(myPeerId) != sharedData.end()) {
+			checkForOutboundStateChanges(myPeerId);
 		}
 	}
 
-	if (type == NetworkSessionType::Host || type == NetworkSessionType::Client) {
-		if (myPeerId != -1) {
-			auto iter = sharedData.find(myPeerId);
-			if (iter != sharedData.end()) {
-				checkForOutboundStateChanges(myPeerId);
-			}
-		}
+	resendSharedData();
+	for (auto& p: peers) {
+		p->update();
 	}
 
 	// Update again to dispatch anything
@@ -210,18 +214,75 @@ void NetworkSession::onDisconnected(int peerId)
 {
 }
 
+void NetworkSession::onDesync(int peerId, uint32_t frame, uint64_t myHash, uint64_t theirHash)
+{
+}
+
+void NetworkSession::reportStateHash(uint32_t frame, uint64_t hash)
+{
+	myStateHashes[frame] = hash;
+	lastStateHashFrame = std::max(lastStateHashFrame, frame);
+
+	// Forget about frames too old to matter, including hashes from peers that never got a matching one from us
+	if (lastStateHashFrame >= stateHashHistory) {
+		const uint32_t oldest = lastStateHashFrame - stateHashHistory;
+		myStateHashes.erase(myStateHashes.begin(), myStateHashes.lower_bound(oldest));
+		for (auto iter = peerStateHashes.begin(); iter != peerStateHashes.end(); ) {
+			iter = iter->first.second < oldest ? peerStateHashes.erase(iter) : std::next(iter);
+		}
+	}
+
+	for (auto iter = peerStateHashes.begin(); iter != peerStateHashes.end(); ) {
+		if (iter->first.second == frame) {
+			const auto peerId = iter->first.first;
+			const auto theirHash = iter->second;
+			iter = peerStateHashes.erase(iter);
+			compareStateHash(peerId, frame, theirHash);
+		} else {
+			++iter;
+		}
+	}
+
+	if (peers.empty()) {
+		return;
+	}
+	ControlMsgStateHash msg;
+	msg.peerId = int8_t(myPeerId);
+	msg.frame = frame;
+	msg.hash = hash;
+	auto packet = doMakeControlPacket(NetworkSessionControlMessageType::StateHash, OutboundNetworkPacket(Serializer::toBytes(msg)));
+	if (type == NetworkSessionType::Host) {
+		sendToAll(std::move(packet));
+	} else if (type == NetworkSessionType::Client) {
+		peers[0]->getConnection().send(std::move(packet));
+	}
+}
+
+void NetworkSession::compareStateHash(int peerId, uint32_t frame, uint64_t theirHash)
+{
+	const auto iter = myStateHashes.find(frame);
+	if (iter == myStateHashes.end()) {
+		if (frame + stateHashHistory >= lastStateHashFrame) {
+			peerStateHashes[std::make_pair(peerId, frame)] = theirHash;
+		}
+	} else if (iter->second != theirHash) {
+		onDesync(peerId, frame, iter->second, theirHash);
+	}
+}
+
 ConnectionStatus NetworkSession::getStatus() const
 {
 	if (type == NetworkSessionType::Undefined) {
 		return ConnectionStatus::Undefined;
 	} else if (type == NetworkSessionType::Client) {
-		if (connections.empty()) {
+		if (peers.empty()) {
 			return ConnectionStatus::Closed;
 		} else {
-			if (connections[0]->getStatus() == ConnectionStatus::Connected) {
+			const auto status = peers[0]->getConnection().getStatus();
+			if (status == ConnectionStatus::Connected) {
 				return myPeerId != -1 && sessionSharedData ? ConnectionStatus::Connected : ConnectionStatus::Connecting;
 			} else {
-				return connections[0]->getStatus();
+				return status;
 			}
 		}
 	} else if (type == NetworkSessionType::Host) {
@@ -240,9 +301,9 @@ OutboundNetworkPacket NetworkSession::makeOutbound(gsl::span<const gsl::byte> da
 
 void NetworkSession::sendToAll(OutboundNetworkPacket&& packet, int except)
 {
-	for (size_t i = 0; i < connections.size(); ++i) {
+	for (size_t i = 0; i < peers.size(); ++i) {
 		if (int(i) != except) {
-			connections[i]->send(OutboundNetworkPacket(packet));
+			peers[i]->getConnection().send(OutboundNetworkPacket(packet));
 		}
 	}
 }
@@ -254,9 +315,25 @@ void NetworkSession::send(OutboundNetworkPacket&& packet)
 	header.srcPeerId = myPeerId;
 
 	auto out = makeOutbound(packet.getBytes(), header);
-	for (auto& c: connections) {
-		c->send(OutboundNetworkPacket(out));
+	for (auto& p: peers) {
+		p->getConnection().send(OutboundNetworkPacket(out));
+	}
+}
+
+void NetworkSession::sendToPeer(OutboundNetworkPacket&& packet, int peerId)
+{
+	NetworkSessionMessageHeader header;
+	if (type == NetworkSessionType::Host) {
+		// Clients take these as they take anything broadcast, but the host knows better than to send it to anyone else
+		header.type = NetworkSessionMessageType::ToPeers;
+	} else if (type == NetworkSessionType::Client && peerId == 0) {
+		header.type = NetworkSessionMessageType::ToMaster;
+	} else {
+		throw Exception("Can't send to peer " + toString(peerId) + " from this session.", HalleyExceptions::Network);
 	}
+	header.srcPeerId = myPeerId;
+
+	getPeer(peerId).getConnection().send(makeOutbound(packet.getBytes(), header));
 }
 
 bool NetworkSession::receive(InboundNetworkPacket& packet)
@@ -272,9 +349,9 @@ bool NetworkSession::receive(InboundNetworkPacket& packet)
 void NetworkSession::processReceive()
 {
 	InboundNetworkPacket packet;
-	for (size_t i = 0; i < connections.size(); ++i) {
-		bool gotMessage = connections[i]->receive(packet);
-		if (gotMessage) {
+	for (size_t i = 0; i < peers.size(); ++i) {
+		// Drain everything, otherwise each peer is capped at one packet per update and the backlog only grows under load
+		while (peers[i]->getConnection().receive(packet)) {
 			// Get header
 			int peerId = type == NetworkSessionType::Host ? int(i) + 1 : 0;
 			NetworkSessionMessageHeader header;
@@ -316,28 +393,27 @@ void NetworkSession::processReceive()
 			else {
 				throw Exception("NetworkSession in invalid state.", HalleyExceptions::Network);
 			}
+
+			if (peers[i]->getConnection().getStatus() == ConnectionStatus::Closed) {
+				break;
+			}
 		}
 	}
 }
 
 void NetworkSession::closeConnection(int peerId, const String& reason)
 {
-	int connId = type == NetworkSessionType::Host ? peerId - 1 : 0;
-	connections.at(connId)->close();
+	getPeer(peerId).getConnection().close();
 }
 
-void NetworkSession::retransmitControlMessage(int peerId, gsl::span<const gsl::byte> bytes)
+NetworkSessionPeer& NetworkSession::getPeer(int peerId)
 {
-	NetworkSessionMessageHeader header;
-	header.type = NetworkSessionMessageType::Control;
-	header.srcPeerId = peerId;
-	sendToAll(makeOutbound(bytes, header), peerId);
+	const int connId = type == NetworkSessionType::Host ? peerId - 1 : 0;
+	return *peers.at(connId);
 }
 
 void NetworkSession::receiveControlMessage(int peerId, InboundNetworkPacket& packet)
 {
-	auto origData = packet.getBytes();
-
 	ControlMsgHeader header;
 	packet.extractHeader(header);
 
@@ -358,7 +434,12 @@ void NetworkSession::receiveControlMessage(int peerId, InboundNetworkPacket& pac
 		{
 			ControlMsgSetPeerState msg = Deserializer::fromBytes<ControlMsgSetPeerState>(packet.getBytes());
 			onControlMessage(peerId, msg);
-			retransmitControlMessage(peerId, origData);
+		}
+		break;
+	case NetworkSessionControlMessageType::StateHash:
+		{
+			ControlMsgStateHash msg = Deserializer::fromBytes<ControlMsgStateHash>(packet.getBytes());
+			onControlMessage(peerId, msg);
 		}
 		break;
 	default:
@@ -378,15 +459,30 @@ void NetworkSession::onControlMessage(int peerId, const ControlMsgSetPeerState&
 {
 	if (peerId != 0 && peerId != msg.peerId) {
 		closeConnection(peerId, "Unauthorised control message: SetPeerState");
+		return;
 	}
-	auto iter = sharedData.find(msg.peerId);
 
-	auto s = Deserializer(msg.state);
-	if (iter != sharedData.end()) {
-		iter->second->deserialize(s);
-	} else {
-		sharedData[msg.peerId] = makePeerSharedData();
-		sharedData[msg.peerId]->deserialize(s);
+	Maybe<Bytes> state;
+	try {
+		state = getPeer(peerId).receiveSharedDataUpdate(msg.peerId, msg.update);
+	} catch (Exception& e) {
+		closeConnection(peerId, e.what());
+		return;
+	}
+	if (!state) {
+		return;
+	}
+
+	auto& data = sharedData[msg.peerId];
+	if (!data) {
+		data = makePeerSharedData();
+	}
+	auto s = Deserializer(state.get());
+	data->deserialize(s);
+
+	if (type == NetworkSessionType::Host) {
+		// Relay it to everyone else
+		data->markModified();
 	}
 }
 
@@ -396,13 +492,34 @@ void NetworkSession::onControlMessage(int peerId, const ControlMsgSetSessionStat
 		closeConnection(peerId, "Unauthorised control message: SetSessionState");
 	}
 
+	Maybe<Bytes> state;
+	try {
+		state = getPeer(peerId).receiveSharedDataUpdate(-1, msg.update);
+	} catch (Exception& e) {
+		closeConnection(peerId, e.what());
+		return;
+	}
+	if (!state) {
+		return;
+	}
+
 	if (!sessionSharedData) {
 		sessionSharedData = makeSessionSharedData();
 	}
-	auto s = Deserializer(msg.state);
+	auto s = Deserializer(state.get());
 	sessionSharedData->deserialize(s);
 }
 
+void NetworkSession::onControlMessage(int peerId, const ControlMsgStateHash& msg)
+{
+	// Clients only compare against the host, and the host against each client
+	if (msg.peerId != peerId || (type == NetworkSessionType::Client && peerId != 0)) {
+		closeConnection(peerId, "Unauthorised control message: StateHash");
+		return;
+	}
+	compareStateHash(peerId, msg.frame, msg.hash);
+}
+
 void NetworkSession::setMyPeerId(int id)
 {
 	Expects (myPeerId == -1);
@@ -412,27 +529,55 @@ void NetworkSession::setMyPeerId(int id)
 	onPeerIdAssigned();
 }
 
+SharedData& NetworkSession::getSharedData(int ownerId)
+{
+	return ownerId == -1 ? *sessionSharedData : *sharedData.at(ownerId);
+}
+
 void NetworkSession::checkForOutboundStateChanges(int ownerId)
 {
-	SharedData& data = ownerId == -1 ? *sessionSharedData : *sharedData.at(ownerId);
+	SharedData& data = getSharedData(ownerId);
 	if (data.isModified()) {
-		sendToAll(makeUpdateSharedDataPacket(ownerId));
+		// Every peer gets a delta against whatever it last acknowledged, so the encoding is per peer; the owner itself doesn't need it
+		const Bytes state = Serializer::toBytes(data);
+		const int ownerConnection = type == NetworkSessionType::Host ? ownerId - 1 : -1;
+		for (size_t i = 0; i < peers.size(); ++i) {
+			if (int(i) != ownerConnection) {
+				sendSharedData(*peers[i], ownerId, state);
+			}
+		}
 		data.markUnmodified();
 	}
 }
 
-OutboundNetworkPacket NetworkSession::makeUpdateSharedDataPacket(int ownerId)
+void NetworkSession::resendSharedData()
+{
+	for (auto& p: peers) {
+		for (int ownerId: p->getSharedDataNeedingResend()) {
+			if (ownerId == -1 ? bool(sessionSharedData) : sharedData.find(ownerId) != sharedData.end()) {
+				sendSharedData(*p, ownerId, Serializer::toBytes(getSharedData(ownerId)), true);
+			}
+		}
+	}
+}
+
+void NetworkSession::sendSharedData(NetworkSessionPeer& peer, int ownerId, const Bytes& state, bool isResend)
+{
+	auto update = peer.makeSharedDataUpdate(ownerId, state);
+	peer.sendSharedDataUpdate(ownerId, update, makeUpdateSharedDataPacket(ownerId, update), isResend);
+}
+
+OutboundNetworkPacket NetworkSession::makeUpdateSharedDataPacket(int ownerId, const SharedDataUpdate& update)
 {
-	SharedData& data = ownerId == -1 ? *sessionSharedData : *sharedData.at(ownerId);
 	if (ownerId == -1) {
 		ControlMsgSetSessionState state;
-		state.state = Serializer::toBytes(data);
+		state.update = update;
 		Bytes bytes = Serializer::toBytes(state);
 		return doMakeControlPacket(NetworkSessionControlMessageType::SetSessionState, OutboundNetworkPacket(bytes));
 	} else {
 		ControlMsgSetPeerState state;
 		state.peerId = ownerId;
-		state.state = Serializer::toBytes(data);
+		state.update = update;
 		Bytes bytes = Serializer::toBytes(state);
 		return doMakeControlPacket(NetworkSessionControlMessageType::SetPeerState, OutboundNetworkPacket(bytes));
 	}
@@ -11,24 +11,58 @@ void ControlMsgSetPeerId::deserialize(Deserializer& s)
 	s >> peerId;
 }
 
+void SharedDataUpdate::serialize(Serializer& s) const
+{
+	s << seq;
+	s << delta;
+	if (delta) {
+		s << baseSeq;
+	}
+	s << data;
+}
+
+void SharedDataUpdate::deserialize(Deserializer& s)
+{
+	s >> seq;
+	s >> delta;
+	if (delta) {
+		s >> baseSeq;
+	}
+	s >> data;
+}
+
 void ControlMsgSetSessionState::serialize(Serializer& s) const
 {
-	s << state;
+	s << update;
 }
 
 void ControlMsgSetSessionState::deserialize(Deserializer& s)
 {
-	s >> state;
+	s >> update;
 }
 
 void ControlMsgSetPeerState::serialize(Serializer& s) const
 {
 	s << peerId;
-	s << state;
+	s << update;
 }
 
 void ControlMsgSetPeerState::deserialize(Deserializer& s)
 {
 	s >> peerId;
-	s >> state;
+	s >> update;
+}
+
+void ControlMsgStateHash::serialize(Serializer& s) const
+{
+	s << peerId;
+	s << frame;
+	s << hash;
+}
+
+void ControlMsgStateHash::deserialize(Deserializer& s)
+{
+	s >> peerId;
+	s >> frame;
+	s >> hash;
 }
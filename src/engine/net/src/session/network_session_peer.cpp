@@ -0,0 +1,278 @@
+#include "session/network_session_peer.h"
+#include "connection/network_packet.h"
+#include "halley/support/exception.h"
+#include "halley/text/string_converter.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace Halley;
+
+namespace {
+	// Past this many unacknowledged updates, send full states until the peer catches up
+	constexpr size_t maxInFlight = 32;
+
+	// Must comfortably cover maxInFlight, as anything in it can become the baseline
+	constexpr uint16_t historySize = 64;
+
+	constexpr float keepAliveInterval = 0.1f;
+	constexpr float minResendTime = 0.25f;
+
+	bool isNewer(uint16_t a, uint16_t b)
+	{
+		const uint16_t diff = uint16_t(a - b);
+		return diff != 0 && diff < 0x8000;
+	}
+
+	int makeTag(int ownerId, uint16_t seq)
+	{
+		return ((ownerId + 1) << 16) | int(seq);
+	}
+
+	// Layout: total size (uint32), one bit per 8-byte group saying whether it changed,
+	// then for each changed group, a mask of which bytes changed followed by those bytes XOR'd with the baseline
+	Bytes makeDelta(const Bytes& baseline, const Bytes& state)
+	{
+		const size_t n = state.size();
+		const size_t nGroups = (n + 7) / 8;
+
+		Bytes result(sizeof(uint32_t) + (nGroups + 7) / 8, 0);
+		const auto size = uint32_t(n);
+		memcpy(result.data(), &size, sizeof(size));
+
+		const size_t groupMaskStart = sizeof(uint32_t);
+		for (size_t g = 0; g < nGroups; ++g) {
+			std::array<Byte, 8> values;
+			size_t nValues = 0;
+			Byte mask = 0;
+			for (size_t j = 0; j < 8; ++j) {
+				const size_t i = g * 8 + j;
+				if (i >= n) {
+					break;
+				}
+				const Byte x = state[i] ^ (i < baseline.size() ? baseline[i] : 0);
+				if (x != 0) {
+					mask |= Byte(1 << j);
+					values[nValues++] = x;
+				}
+			}
+
+			if (mask != 0) {
+				result[groupMaskStart + g / 8] |= Byte(1 << (g % 8));
+				result.push_back(mask);
+				result.insert(result.end(), values.begin(), values.begin() + nValues);
+			}
+		}
+
+		return result;
+	}
+
+	Bytes applyDelta(const Bytes& baseline, const Bytes& delta)
+	{
+		uint32_t size;
+		if (delta.size() < sizeof(size)) {
+			throw Exception("SharedData delta is truncated.", HalleyExceptions::Network);
+		}
+		memcpy(&size, delta.data(), sizeof(size));
+
+		const size_t n = size;
+		const size_t nGroups = (n + 7) / 8;
+		const size_t groupMaskStart = sizeof(uint32_t);
+		size_t pos = groupMaskStart + (nGroups + 7) / 8;
+		if (delta.size() < pos) {
+			throw Exception("SharedData delta is truncated.", HalleyExceptions::Network);
+		}
+
+		Bytes result(n, 0);
+		memcpy(result.data(), baseline.data(), std::min(n, baseline.size()));
+
+		for (size_t g = 0; g < nGroups; ++g) {
+			if ((delta[groupMaskStart + g / 8] & (1 << (g % 8))) == 0) {
+				continue;
+			}
+
+			if (pos >= delta.size()) {
+				throw Exception("SharedData delta is truncated.", HalleyExceptions::Network);
+			}
+			const Byte mask = delta[pos++];
+			for (size_t j = 0; j < 8; ++j) {
+				if (mask & (1 << j)) {
+					const size_t i = g * 8 + j;
+					if (pos >= delta.size() || i >= n) {
+						throw Exception("SharedData delta is malformed.", HalleyExceptions::Network);
+					}
+					result[i] ^= delta[pos++];
+				}
+			}
+		}
+
+		return result;
+	}
+}
+
+NetworkSessionPeer::NetworkSessionPeer(std::shared_ptr<IConnection> conn)
+	: connection(std::make_shared<ReliableConnection>(std::move(conn)))
+{
+	connection->addAckListener(*this);
+	NetworkStats::addSource(*this);
+}
+
+NetworkSessionPeer::~NetworkSessionPeer()
+{
+	NetworkStats::removeSource(*this);
+	connection->removeAckListener(*this);
+}
+
+ReliableConnection& NetworkSessionPeer::getConnection() const
+{
+	return *connection;
+}
+
+void NetworkSessionPeer::update()
+{
+	// Acks only travel on outgoing packets, so make sure some go out even when there's nothing to say
+	if (connection->getStatus() == ConnectionStatus::Connected && connection->getTimeSinceLastSend() > keepAliveInterval) {
+		connection->sendTagged(gsl::span<ReliableSubPacket>());
+	}
+}
+
+SharedDataUpdate NetworkSessionPeer::makeSharedDataUpdate(int ownerId, const Bytes& state)
+{
+	auto& out = outbound[ownerId];
+
+	SharedDataUpdate update;
+	update.seq = out.nextSeq++;
+	if (out.ackedSeq && out.inFlight.size() < maxInFlight) {
+		auto delta = makeDelta(out.acked, state);
+		if (delta.size() < state.size()) {
+			update.delta = true;
+			update.baseSeq = out.ackedSeq.get();
+			update.data = std::move(delta);
+		}
+	}
+	if (!update.delta) {
+		update.data = state;
+	}
+
+	// Don't hold on to updates that will never be acked
+	for (auto iter = out.inFlight.begin(); iter != out.inFlight.end(); ) {
+		if (uint16_t(update.seq - iter->first) >= historySize) {
+			iter = out.inFlight.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+	out.inFlight[update.seq] = state;
+
+	return update;
+}
+
+void NetworkSessionPeer::sendSharedDataUpdate(int ownerId, const SharedDataUpdate& update, OutboundNetworkPacket&& packet, bool isResend)
+{
+	ReliableSubPacket subPacket;
+	subPacket.data.resize(packet.getSize());
+	packet.copyTo(subPacket.data.getSpan());
+	subPacket.tag = makeTag(ownerId, update.seq);
+	connection->sendTagged(gsl::span<ReliableSubPacket>(&subPacket, 1));
+
+	outbound[ownerId].lastSend = Clock::now();
+	++sharedDataStats.messagesSent;
+	sharedDataStats.bytesSent += subPacket.data.size();
+	if (isResend) {
+		++sharedDataStats.messagesResent;
+	}
+}
+
+std::vector<int> NetworkSessionPeer::getSharedDataNeedingResend() const
+{
+	// Anything still in flight was sent after the latest ack; if that's taking too long, it was probably lost
+	const auto timeout = std::chrono::duration<float>(std::max(minResendTime, 3.0f * connection->getLatency()));
+	const auto now = Clock::now();
+
+	std::vector<int> result;
+	for (auto& o: outbound) {
+		if (!o.second.inFlight.empty() && now - o.second.lastSend > timeout) {
+			result.push_back(o.first);
+		}
+	}
+	return result;
+}
+
+Maybe<Bytes> NetworkSessionPeer::receiveSharedDataUpdate(int ownerId, const SharedDataUpdate& update)
+{
+	auto& in = inbound[ownerId];
+	++sharedDataStats.messagesReceived;
+	sharedDataStats.bytesReceived += update.data.size();
+
+	Bytes state;
+	if (update.delta) {
+		auto iter = in.history.find(update.baseSeq);
+		if (iter == in.history.end()) {
+			throw Exception("SharedData delta for owner " + toString(ownerId) + " is based on unknown state " + toString(update.baseSeq), HalleyExceptions::Network);
+		}
+		state = applyDelta(iter->second, update.data);
+	} else {
+		state = update.data;
+	}
+
+	// Even if it arrived out of order, the sender might use this as a baseline later
+	const bool isLatest = !in.latestSeq || isNewer(update.seq, in.latestSeq.get());
+	in.history[update.seq] = state;
+	if (!isLatest) {
+		return {};
+	}
+
+	in.latestSeq = update.seq;
+	for (auto iter = in.history.begin(); iter != in.history.end(); ) {
+		if (uint16_t(update.seq - iter->first) >= historySize) {
+			iter = in.history.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+	return state;
+}
+
+void NetworkSessionPeer::onPacketAcked(int tag)
+{
+	const int ownerId = (tag >> 16) - 1;
+	const auto seq = uint16_t(tag & 0xFFFF);
+
+	auto outIter = outbound.find(ownerId);
+	if (outIter == outbound.end()) {
+		return;
+	}
+	auto& out = outIter->second;
+
+	auto iter = out.inFlight.find(seq);
+	if (iter == out.inFlight.end()) {
+		return;
+	}
+
+	if (!out.ackedSeq || isNewer(seq, out.ackedSeq.get())) {
+		out.acked = std::move(iter->second);
+		out.ackedSeq = seq;
+	}
+
+	// Everything up to the baseline is now irrelevant
+	const uint16_t baseline = out.ackedSeq.get();
+	for (auto i = out.inFlight.begin(); i != out.inFlight.end(); ) {
+		if (!isNewer(i->first, baseline)) {
+			i = out.inFlight.erase(i);
+		} else {
+			++i;
+		}
+	}
+}
+
+NetworkConnectionStats NetworkSessionPeer::getStats() const
+{
+	auto result = connection->getStats();
+	result.name = "NetworkSession peer";
+
+	auto sharedData = sharedDataStats;
+	for (auto& o: outbound) {
+		sharedData.waitingForAck += o.second.inFlight.size();
+	}
+	result.channels.push_back(sharedData);
+	return result;
+}
@@ -1,4 +1,6 @@
 #include "session/shared_data.h"
+#include "halley/bytes/byte_serializer.h"
+#include <cmath>
 using namespace Halley;
 
 void SharedData::markModified()
@@ -15,3 +17,16 @@ bool SharedData::isModified() const
 {
 	return modified;
 }
+
+void SharedData::serializeQuantized(Serializer& s, float value, float step)
+{
+	Expects(step > 0);
+	s << int32_t(std::lround(value / step));
+}
+
+float SharedData::deserializeQuantized(Deserializer& s, float step)
+{
+	int32_t value;
+	s >> value;
+	return float(value) * step;
+}
@@ -82,7 +82,7 @@ namespace Halley {
 
 		bool canHandle(const UIEvent& event) const;
 		void queue(const UIEvent& event);
-		void pump();
+		bool pump(); // Returns true if it handled anything
 		void setWidget(UIWidget* uiWidget);
 
 	private:
@@ -35,6 +35,14 @@ namespace Halley
 		std::shared_ptr<UIWidget> makeUI(const String& configName, std::vector<String> conditions);
 		std::shared_ptr<UIWidget> makeUIFromNode(const ConfigNode& node);
 
+		// Like makeUI, but keeps the trees it makes and hands them out again once they're done with (removed from the UI, and held by
+		// nothing else), so UI that's opened often, such as popups and tooltips, isn't built from scratch each time.
+		// Reused trees come back as they were left apart from transient state (see UIWidget::resetForReuse), so callers set up whatever they
+		// change (e.g. text) every time, and trees whose structure is changed after making them shouldn't be pooled.
+		std::shared_ptr<UIWidget> makePooledUI(const String& configName);
+		void setMaxPooledUI(size_t maxPerConfig);
+		void clearPooledUI();
+
 		void setInputButtons(const String& key, UIInputButtons buttons);
 		void applyInputButtons(UIWidget& widget, const String& key);
 
@@ -104,5 +112,12 @@ namespace Halley
 
 		std::map<String, WidgetFactory> factories;
 		std::map<String, UIInputButtons> inputButtons;
+
+		struct PooledUI {
+			std::shared_ptr<UIWidget> widget;
+			int configVersion;
+		};
+		std::map<String, std::vector<PooledUI>> pooledUI; // By config name and conditions
+		size_t maxPooledUI = 4;
 	};
 }
@@ -1,24 +1,32 @@
 #pragma once
+#include <vector>
 #include "halley/maths/rect.h"
 #include "halley/data_structures/maybe.h"
+#include "halley/core/graphics/sprite/sprite.h"
+#include "halley/core/graphics/text/text_renderer.h"
 
 namespace Halley {
-	class TextRenderer;
-	class Sprite;
 	class SpritePainter;
+	class UIRenderCache;
 
 	class UIPainter {
+		friend class UIRenderCache;
+
 	public:
 		UIPainter(SpritePainter& painter, int mask, int layer);
 
 		void draw(const Sprite& sprite, bool forceCopy = false);
 		void draw(const TextRenderer& text, bool forceCopy = false);
+		void draw(const UIRenderCache& cache);
 
 		UIPainter clone();
 		UIPainter withAdjustedLayer(int delta);
 		UIPainter withClip(Maybe<Rect4f> clip);
 		UIPainter withMask(int mask);
 
+		// Everything drawn through the returned painter goes into the cache instead
+		UIPainter withRecorder(UIRenderCache& cache);
+
 	private:
 		SpritePainter& painter;
 		Maybe<Rect4f> clip;
@@ -26,7 +34,37 @@ namespace Halley {
 		int layer;
 		int n;
 		UIPainter* parent = nullptr;
+		UIRenderCache* recorder = nullptr;
 
 		float getCurrentPriority();
+		void add(const Sprite& sprite, int mask, int layer, bool copy);
+		void add(const TextRenderer& text, int mask, int layer, bool copy);
+	};
+
+	// Draw calls recorded from a UIPainter, so a subtree that didn't change can be drawn again without visiting its widgets
+	class UIRenderCache {
+		friend class UIPainter;
+
+	public:
+		bool isValidFor(const UIPainter& painter) const;
+		void invalidate();
+
+	private:
+		struct Entry {
+			bool isText;
+			size_t index;
+			int mask;
+			int layer;
+		};
+
+		std::vector<Sprite> sprites;
+		std::vector<TextRenderer> texts;
+		std::vector<Entry> entries;
+
+		// The painter state it was recorded with
+		bool valid = false;
+		int mask = 0;
+		int layer = 0;
+		Maybe<Rect4f> clip;
 	};
 }
@@ -29,6 +29,7 @@ namespace Halley {
 		bool isWaitingToSpawnChildren() const;
 
 		virtual void markAsNeedingLayout();
+		virtual void markAsNeedingRedraw();
 
 		std::vector<std::shared_ptr<UIWidget>>& getChildren();
 		const std::vector<std::shared_ptr<UIWidget>>& getChildren() const;
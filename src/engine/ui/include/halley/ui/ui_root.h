@@ -6,6 +6,7 @@
 #include "ui_parent.h"
 #include "ui_input.h"
 #include "halley/core/api/audio_api.h"
+#include "halley/data_structures/hierarchical_grid.h"
 
 namespace Halley {
 	class SpritePainter;
@@ -34,6 +35,7 @@ namespace Halley {
 		void draw(SpritePainter& painter, int mask, int layer);
 		void mouseOverNext(bool forward = true);
 		void runLayout();
+		void markAsNeedingLayout() override;
 		
 		Maybe<AudioHandle> playSound(const String& eventName);
 		void sendEvent(UIEvent&& event) const override;
@@ -65,12 +67,30 @@ namespace Halley {
 
 		std::function<Vector2f(Vector2f)> mouseRemap;
 
+		struct MouseTarget {
+			UIWidget* widget;
+			bool enabled;
+		};
+
+		struct InputTarget {
+			UIWidget* widget;
+			bool accepting;
+		};
+
+		// Flattened from the tree whenever anything in it needs layout, in the order they get to claim the mouse / input.
+		// Widgets only leave the tree through paths that mark it, so the raw pointers are safe to use after updateTargets().
+		mutable std::vector<MouseTarget> mouseTargets;
+		mutable HierarchicalGrid<uint32_t> mouseTargetGrid;
+		mutable std::vector<InputTarget> inputTargets;
+		mutable bool targetsDirty = true;
+		UIInputType lastInputType = UIInputType::Undefined;
+
 		void updateMouse(spInputDevice mouse);
-		void updateInputTree(const spInputDevice& input, UIWidget& c, std::vector<UIWidget*>& inputTargets, UIInput::Priority& bestPriority, bool accepting);
 		void updateInput(spInputDevice input);
 
+		void updateTargets() const;
+		void collectTargets(UIWidget& widget, bool enabled, bool reachable) const;
 		std::shared_ptr<UIWidget> getWidgetUnderMouse(Vector2f mousePos, bool includeDisabled = false) const;
-		std::shared_ptr<UIWidget> getWidgetUnderMouse(const std::shared_ptr<UIWidget>& start, Vector2f mousePos, bool includeDisabled = false) const;
 		void updateMouseOver(const std::shared_ptr<UIWidget>& underMouse);
 		void collectWidgets(const std::shared_ptr<UIWidget>& start, std::vector<std::shared_ptr<UIWidget>>& output);
 	};
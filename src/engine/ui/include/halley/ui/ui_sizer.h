@@ -130,6 +130,7 @@ namespace Halley {
 
 		UIParent* curParent = nullptr;
 
+		void markAsNeedingLayout();
 		void reparentEntry(UISizerEntry& entry);
 		void unparentEntry(UISizerEntry& entry);
 
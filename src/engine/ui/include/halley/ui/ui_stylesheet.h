@@ -3,6 +3,7 @@
 #include "halley/core/graphics/sprite/sprite.h"
 #include "halley/core/graphics/text/text_renderer.h"
 #include "halley/data_structures/flat_map.h"
+#include "halley/data_structures/hash_map.h"
 #include <map>
 
 namespace Halley {
@@ -30,12 +31,15 @@ namespace Halley {
 		const ConfigNode& node;
 		Resources& resources;
 
-		mutable FlatMap<String, Sprite> sprites;
-		mutable FlatMap<String, TextRenderer> textRenderers;
-		mutable FlatMap<String, Vector4f> borders;
-		mutable FlatMap<String, String> strings;
-		mutable FlatMap<String, float> floats;
-		mutable FlatMap<String, std::shared_ptr<const UIStyleDefinition>> subStyles;
+		// Hash maps, as references into these are handed out while they're still being filled in
+		mutable HashMap<String, Sprite> sprites;
+		mutable HashMap<String, TextRenderer> textRenderers;
+		mutable HashMap<String, Vector4f> borders;
+		mutable HashMap<String, String> strings;
+		mutable HashMap<String, float> floats;
+		mutable HashMap<String, std::shared_ptr<const UIStyleDefinition>> subStyles;
+
+		void preload();
 	};
 
 	class UIStyleSheet {
@@ -44,6 +48,8 @@ namespace Halley {
 	public:
 		UIStyleSheet(Resources& resources);
 		UIStyleSheet(Resources& resources, const ConfigFile& file);
+		UIStyleSheet(const UIStyleSheet& other) = delete;
+		UIStyleSheet& operator=(const UIStyleSheet& other) = delete;
 
 		void load(const ConfigFile& file);
 
@@ -54,6 +60,7 @@ namespace Halley {
 		Resources& resources;
 		FlatMap<String, std::shared_ptr<UIStyleDefinition>> styles;
 		std::map<String, ConfigObserver> observers;
+		bool changed = false;
 
 		void load(const ConfigNode& node);
 		std::shared_ptr<const UIStyleDefinition> getStyle(const String& styleName) const;
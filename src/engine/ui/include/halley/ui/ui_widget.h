@@ -97,6 +97,10 @@ namespace Halley {
 		void destroy();
 		void forceDestroy();
 
+		// Brings back a widget that was destroyed or removed, and that nothing else holds on to, to be used again (see UIFactory::makePooledUI).
+		// Transient state (focus, mouse over, input, layout) is cleared throughout the tree; everything set on it is kept.
+		void resetForReuse();
+
 		void setEventHandler(std::shared_ptr<UIEventHandler> handler);
 		UIEventHandler& getEventHandler();
 		void setHandle(UIEventType type, UIEventCallback handler);
@@ -149,6 +153,13 @@ namespace Halley {
 		bool needsLayout() const;
 		void markAsNeedingLayout() override;
 
+		// Cached subtrees are drawn from what they drew last time, until something in them calls markAsNeedingRedraw().
+		// Layout, focus, mouse over, enabled and active changes, events and data binds do that automatically;
+		// widgets that change how they look by any other means should call it themselves.
+		void setRenderCached(bool cached);
+		bool isRenderCached() const;
+		void markAsNeedingRedraw() override;
+
 	protected:
 		virtual void draw(UIPainter& painter) const;
 		virtual void drawAfterChildren(UIPainter& painter) const;
@@ -161,6 +172,7 @@ namespace Halley {
 		virtual void onFocusLost();
 		virtual void onLayout();
 		virtual void onDestroyRequested();
+		virtual void onResetForReuse();
 
 		void notifyDataBind(bool data) const;
 		void notifyDataBind(int data) const;
@@ -177,13 +189,16 @@ namespace Halley {
 
 		virtual void checkActive();
 
+		void setWidgetRect(Rect4f rect);
+
 		UIInputType lastInputType = UIInputType::Undefined;
 
 	private:
 		void setParent(UIParent* parent);
 
-		void setWidgetRect(Rect4f rect);
+		void drawContents(UIPainter& painter) const;
 		void resetInputResults();
+		void revive();
 		void updateActive(bool wasActiveBefore);
 
 		UIParent* parent = nullptr;
@@ -203,6 +218,8 @@ namespace Halley {
 
 		mutable Vector2f layoutSize;
 		mutable int layoutNeeded = 1;
+		bool placementNeeded = true; // Set along with layoutNeeded, but only cleared once the subtree was placed again
+		Rect4f placedRect;
 
 		std::shared_ptr<UIEventHandler> eventHandler;
 		std::shared_ptr<UIValidator> validator;
@@ -210,6 +227,8 @@ namespace Halley {
 		std::unique_ptr<UIAnchor> anchor;
 		std::vector<std::shared_ptr<UIBehaviour>> behaviours;
 
+		std::unique_ptr<UIRenderCache> renderCache;
+
 		int childLayerAdjustment = 0;
 
 		bool activeByUser = true;
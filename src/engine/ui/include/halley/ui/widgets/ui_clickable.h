@@ -38,6 +38,7 @@ namespace Halley {
 		bool updateButton();
 		void doForceUpdate();
 		void onEnabledChanged() override;
+		void onResetForReuse() override;
 		virtual void onShortcutPressed();
 
 	private:
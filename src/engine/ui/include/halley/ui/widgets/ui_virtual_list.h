@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../ui_widget.h"
+#include <functional>
+
+namespace Halley {
+	// List meant to go inside a UIScrollPane, which only has widgets for the items in view (plus a margin around it).
+	// Items scrolling out of view go back to a pool, and are bound again to whichever items scroll into view.
+	// Items either all have a fixed size, or start at an estimated size and are measured once they've been in view.
+	class UIVirtualList : public UIWidget {
+	public:
+		using ItemFactory = std::function<std::shared_ptr<UIWidget>()>;
+		using ItemBinder = std::function<void(UIWidget& widget, size_t index)>;
+
+		UIVirtualList(const String& id, ItemFactory factory, ItemBinder binder, UISizerType orientation = UISizerType::Vertical, float gap = 0);
+
+		void setCount(size_t count);
+		size_t getCount() const;
+
+		void setItemSize(float size);
+		void setEstimatedItemSize(float size);
+		void setMargin(float margin);
+
+		// Binds the items in view again, e.g. after the data behind them changed
+		void refresh();
+		void refresh(size_t index);
+
+		// Returns nullptr if the item isn't in view
+		std::shared_ptr<UIWidget> getItemWidget(size_t index) const;
+		Rect4f getItemRect(size_t index) const;
+		void showItem(size_t index, bool centre = false);
+
+		Vector2f getLayoutMinimumSize(bool force) const override;
+		void setRect(Rect4f rect) override;
+
+	protected:
+		void update(Time t, bool moved) override;
+
+	private:
+		ItemFactory factory;
+		ItemBinder binder;
+		UISizerType orientation;
+		float gap;
+		float margin = 100.0f;
+		float itemSize = 0;
+		bool fixedSize = true;
+		size_t count = 0;
+
+		std::vector<float> sizes; // Only with estimated sizes
+		mutable std::vector<float> offsets;
+		mutable bool offsetsDirty = false;
+
+		size_t firstVisible = 0;
+		std::vector<std::shared_ptr<UIWidget>> visible;
+		std::vector<std::shared_ptr<UIWidget>> pool;
+
+		int getAxis() const;
+		float getItemOffset(size_t index) const;
+		float getItemSize(size_t index) const;
+		float getTotalSize() const;
+		size_t getIndexAt(float offset) const;
+		void updateOffsets() const;
+
+		void updateVisible();
+		bool getViewRange(float& start, float& end) const;
+		std::shared_ptr<UIWidget> acquire(size_t index);
+		void release(std::shared_ptr<UIWidget> widget);
+		void releaseAll();
+	};
+}
@@ -55,6 +55,7 @@ void UIDataBind::pushData()
 {
 	Expects(widgetBound != nullptr);
 	widgetBound->readFromDataBind();
+	widgetBound->markAsNeedingRedraw();
 }
 
 void UIDataBind::setWidget(UIWidget* widget)
@@ -145,15 +145,18 @@ void UIEventHandler::queue(const UIEvent& event)
 	eventQueue.push_back(event);
 }
 
-void UIEventHandler::pump()
+bool UIEventHandler::pump()
 {
+	bool handledAny = false;
 	while (!eventQueue.empty()) {
 		decltype(eventQueue) events = std::move(eventQueue);
 		eventQueue.clear();
 		for (auto& event: events) {
 			handle(event);
 		}
+		handledAny = true;
 	}
+	return handledAny;
 }
 
 void UIEventHandler::setWidget(UIWidget* uiWidget)
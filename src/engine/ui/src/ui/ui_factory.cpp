@@ -17,6 +17,7 @@
 #include "halley/ui/widgets/ui_slider.h"
 #include "halley/ui/widgets/ui_paged_pane.h"
 #include "halley/support/logger.h"
+#include <algorithm>
 #include "ui_validator.h"
 #include "halley/ui/widgets/ui_framed_image.h"
 #include "halley/ui/widgets/ui_hybrid_list.h"
@@ -108,6 +109,49 @@ std::shared_ptr<UIWidget> UIFactory::makeUIFromNode(const ConfigNode& node)
 	return makeWidget(node);
 }
 
+std::shared_ptr<UIWidget> UIFactory::makePooledUI(const String& configName)
+{
+	auto config = resources.get<ConfigFile>(configName);
+	const int version = config->getAssetVersion();
+
+	String key = configName;
+	for (auto& c: conditions) {
+		key += ":" + c;
+	}
+	auto& pool = pooledUI[key];
+
+	// Those made from an older version of the config are let go of, even if in use
+	pool.erase(std::remove_if(pool.begin(), pool.end(), [&] (const PooledUI& p) { return p.configVersion != version; }), pool.end());
+
+	for (auto& p: pool) {
+		if (p.widget.use_count() == 1) {
+			p.widget->resetForReuse();
+			return p.widget;
+		}
+	}
+
+	auto widget = makeUIFromNode(config->getRoot());
+	if (pool.size() < maxPooledUI) {
+		pool.push_back(PooledUI{ widget, version });
+	}
+	return widget;
+}
+
+void UIFactory::setMaxPooledUI(size_t maxPerConfig)
+{
+	maxPooledUI = maxPerConfig;
+	for (auto& pool: pooledUI) {
+		if (pool.second.size() > maxPerConfig) {
+			pool.second.resize(maxPerConfig);
+		}
+	}
+}
+
+void UIFactory::clearPooledUI()
+{
+	pooledUI.clear();
+}
+
 void UIFactory::setInputButtons(const String& key, UIInputButtons buttons)
 {
 	inputButtons[key] = buttons;
@@ -145,6 +189,9 @@ std::shared_ptr<UIWidget> UIFactory::makeWidget(const ConfigNode& entryNode)
 	if (widgetNode.hasKey("childLayerAdjustment")) {
 		widget->setChildLayerAdjustment(widgetNode["childLayerAdjustment"].asInt());
 	}
+	if (widgetNode.hasKey("renderCached")) {
+		widget->setRenderCached(widgetNode["renderCached"].asBool(false));
+	}
 	return widget;
 }
 
@@ -17,6 +17,7 @@ UIPainter UIPainter::clone()
 	auto result = UIPainter(painter, mask, layer);
 	result.parent = this;
 	result.clip = clip;
+	result.recorder = recorder;
 	return result;
 }
 
@@ -47,6 +48,21 @@ UIPainter UIPainter::withMask(int mask)
 	return result;
 }
 
+UIPainter UIPainter::withRecorder(UIRenderCache& cache)
+{
+	cache.sprites.clear();
+	cache.texts.clear();
+	cache.entries.clear();
+	cache.valid = true;
+	cache.mask = mask;
+	cache.layer = layer;
+	cache.clip = clip;
+
+	auto result = clone();
+	result.recorder = &cache;
+	return result;
+}
+
 float UIPainter::getCurrentPriority()
 {
 	if (parent) {
@@ -66,14 +82,10 @@ void UIPainter::draw(const Sprite& sprite, bool forceCopy)
 
 		auto onScreen = sprite.getAABB().intersection(targetClip + sprite.getPosition());
 		if (onScreen.getWidth() > 0.1f && onScreen.getHeight() > 0.1f) {
-			painter.addCopy(sprite.clone().setClip(targetClip), mask, layer, getCurrentPriority());
+			add(sprite.clone().setClip(targetClip), mask, layer, true);
 		}
 	} else {
-		if (forceCopy) {
-			painter.addCopy(sprite, mask, layer, getCurrentPriority());
-		} else {
-			painter.add(sprite, mask, layer, getCurrentPriority());
-		}
+		add(sprite, mask, layer, forceCopy);
 	}
 }
 
@@ -87,13 +99,55 @@ void UIPainter::draw(const TextRenderer& text, bool forceCopy)
 		
 		auto onScreen = Rect4f(Vector2f(), text.getExtents()).intersection(targetClip);
 		if (onScreen.getWidth() > 0.1f && onScreen.getHeight() > 0.1f) {
-			painter.addCopy(text.clone().setClip(clip.get() - text.getPosition()), mask, layer, getCurrentPriority());
+			add(text.clone().setClip(clip.get() - text.getPosition()), mask, layer, true);
 		}
 	} else {
-		if (forceCopy) {
-			painter.addCopy(text, mask, layer, getCurrentPriority());
+		add(text, mask, layer, forceCopy);
+	}
+}
+
+void UIPainter::draw(const UIRenderCache& cache)
+{
+	// Clipping was already applied when recording; the cache outlives the frame, so nothing needs copying
+	for (auto& entry: cache.entries) {
+		if (entry.isText) {
+			add(cache.texts[entry.index], entry.mask, entry.layer, false);
 		} else {
-			painter.add(text, mask, layer, getCurrentPriority());
+			add(cache.sprites[entry.index], entry.mask, entry.layer, false);
 		}
 	}
 }
+
+void UIPainter::add(const Sprite& sprite, int mask, int layer, bool copy)
+{
+	if (recorder) {
+		recorder->entries.push_back(UIRenderCache::Entry{ false, recorder->sprites.size(), mask, layer });
+		recorder->sprites.push_back(sprite);
+	} else if (copy) {
+		painter.addCopy(sprite, mask, layer, getCurrentPriority());
+	} else {
+		painter.add(sprite, mask, layer, getCurrentPriority());
+	}
+}
+
+void UIPainter::add(const TextRenderer& text, int mask, int layer, bool copy)
+{
+	if (recorder) {
+		recorder->entries.push_back(UIRenderCache::Entry{ true, recorder->texts.size(), mask, layer });
+		recorder->texts.push_back(text);
+	} else if (copy) {
+		painter.addCopy(text, mask, layer, getCurrentPriority());
+	} else {
+		painter.add(text, mask, layer, getCurrentPriority());
+	}
+}
+
+bool UIRenderCache::isValidFor(const UIPainter& painter) const
+{
+	return valid && mask == painter.mask && layer == painter.layer && clip == painter.clip;
+}
+
+void UIRenderCache::invalidate()
+{
+	valid = false;
+}
@@ -75,6 +75,8 @@ bool UIParent::isWaitingToSpawnChildren() const
 
 void UIParent::markAsNeedingLayout() {}
 
+void UIParent::markAsNeedingRedraw() {}
+
 std::vector<std::shared_ptr<UIWidget>>& UIParent::getChildren()
 {
 	/*
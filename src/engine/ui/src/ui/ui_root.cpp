@@ -5,6 +5,7 @@
 #include "halley/audio/audio_position.h"
 #include "halley/audio/audio_clip.h"
 #include "halley/maths/random.h"
+#include <limits>
 
 using namespace Halley;
 
@@ -49,6 +50,12 @@ void UIRoot::update(Time t, UIInputType activeInputType, spInputDevice mouse, sp
 	auto joystickType = manual->getJoystickType();
 	bool first = true;
 
+	if (activeInputType != lastInputType) {
+		// Some widgets only interact with the mouse under some input types
+		lastInputType = activeInputType;
+		targetsDirty = true;
+	}
+
 	do {
 		// Spawn & Update input
 		addNewChildren(activeInputType);
@@ -130,54 +137,29 @@ void UIRoot::updateMouse(spInputDevice mouse)
 	updateMouseOver(activeMouseOver);
 }
 
-void UIRoot::updateInputTree(const spInputDevice& input, UIWidget& widget, std::vector<UIWidget*>& inputTargets, UIInput::Priority& bestPriority, bool accepting)
+void UIRoot::updateInput(spInputDevice input)
 {
-	if (!widget.isActive()) {
-		return;
-	}
-
-	if (!widget.isEnabled()) {
-		accepting = false;
-	}
-
-	for (auto& c: widget.getChildren()) {
-		// Depth-first
-		updateInputTree(input, *c, inputTargets, bestPriority, accepting);
-	}
+	updateTargets();
 
-	if (widget.inputButtons) {
+	std::vector<UIWidget*> bestTargets;
+	UIInput::Priority bestPriority = UIInput::Priority::Lowest;
+	for (auto& target: inputTargets) {
+		auto& widget = *target.widget;
 		widget.inputResults.reset();
-		if (accepting) {
+		if (target.accepting) {
 			auto priority = widget.getInputPriority();
 
 			if (int(priority) > int(bestPriority)) {
 				bestPriority = priority;
-				inputTargets.clear();
+				bestTargets.clear();
 			}
 			if (priority == bestPriority) {
-				inputTargets.push_back(&widget);
+				bestTargets.push_back(&widget);
 			}
 		}
 	}
-}
-
-void UIRoot::updateInput(spInputDevice input)
-{
-	auto& cs = getChildren();
-	std::vector<UIWidget*> inputTargets;
-	UIInput::Priority bestPriority = UIInput::Priority::Lowest;
-
-	bool accepting = true;
-	for (int i = int(cs.size()); --i >= 0; ) {
-		auto& c = *cs[i];
-		updateInputTree(input, c, inputTargets, bestPriority, accepting);
-				
-		if (c.isMouseBlocker()) {
-			accepting = false;
-		}
-	}
 
-	for (auto& target: inputTargets) {
+	for (auto& target: bestTargets) {
 		auto& b = *target->inputButtons;
 		auto& results = target->inputResults;
 		results.reset();
@@ -230,6 +212,11 @@ void UIRoot::runLayout()
 	}
 }
 
+void UIRoot::markAsNeedingLayout()
+{
+	targetsDirty = true;
+}
+
 void UIRoot::setFocus(std::shared_ptr<UIWidget> focus)
 {
 	auto curFocus = currentFocus.lock();
@@ -260,43 +247,68 @@ void UIRoot::updateMouseOver(const std::shared_ptr<UIWidget>& underMouse)
 }
 
 
-std::shared_ptr<UIWidget> UIRoot::getWidgetUnderMouse(Vector2f mousePos, bool includeDisabled) const
+void UIRoot::updateTargets() const
 {
+	if (!targetsDirty) {
+		return;
+	}
+	targetsDirty = false;
+
+	mouseTargets.clear();
+	mouseTargetGrid.clear();
+	inputTargets.clear();
+
+	// Nothing behind a mouse blocker can get the mouse or input
 	auto& cs = getChildren();
+	bool reachable = true;
 	for (int i = int(cs.size()); --i >= 0; ) {
-		auto curRootWidget = cs[i];
-		auto widget = getWidgetUnderMouse(curRootWidget, mousePos, includeDisabled);
-		if (widget) {
-			return widget;
-		} else {
-			if (curRootWidget->isMouseBlocker()) {
-				return {};
-			}
+		auto& c = *cs[i];
+		collectTargets(c, true, reachable);
+		if (c.isMouseBlocker()) {
+			reachable = false;
 		}
 	}
-	return {};
 }
 
-std::shared_ptr<UIWidget> UIRoot::getWidgetUnderMouse(const std::shared_ptr<UIWidget>& start, Vector2f mousePos, bool includeDisabled) const
+void UIRoot::collectTargets(UIWidget& widget, bool enabled, bool reachable) const
 {
-	if (!start->isActive() || (!includeDisabled && !start->isEnabled())) {
-		return {};
+	if (!widget.isActive()) {
+		return;
 	}
+	enabled = enabled && widget.isEnabled();
 
 	// Depth first
-	for (auto& c: start->getChildren()) {
-		auto result = getWidgetUnderMouse(c, mousePos, includeDisabled);
-		if (result) {
-			return result;
-		}
+	for (auto& c: widget.getChildren()) {
+		collectTargets(*c, enabled, reachable);
 	}
 
-	auto rect = start->getMouseRect();
-	if (start->canInteractWithMouse() && rect.contains(mousePos)) {
-		return start;
-	} else {
+	if (reachable && widget.canInteractWithMouse()) {
+		mouseTargetGrid.add(widget.getMouseRect(), uint32_t(mouseTargets.size()));
+		mouseTargets.push_back(MouseTarget{ &widget, enabled });
+	}
+
+	if (widget.inputButtons) {
+		inputTargets.push_back(InputTarget{ &widget, reachable && enabled });
+	}
+}
+
+std::shared_ptr<UIWidget> UIRoot::getWidgetUnderMouse(Vector2f mousePos, bool includeDisabled) const
+{
+	updateTargets();
+
+	// Whichever comes first in the flattened order wins
+	auto best = std::numeric_limits<uint32_t>::max();
+	mouseTargetGrid.forEachInRect(Rect4f(mousePos, mousePos), [&] (uint32_t index, const Rect4f& rect)
+	{
+		if (index < best && rect.contains(mousePos) && (includeDisabled || mouseTargets[index].enabled)) {
+			best = index;
+		}
+	});
+
+	if (best == std::numeric_limits<uint32_t>::max()) {
 		return {};
 	}
+	return mouseTargets[best].widget->shared_from_this();
 }
 
 void UIRoot::setUIMouseRemapping(std::function<Vector2f(Vector2f)> remapFunction) {
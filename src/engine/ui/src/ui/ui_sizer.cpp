@@ -150,16 +150,19 @@ void UISizer::add(std::shared_ptr<IUIElement> element, float proportion, Vector4
 {
 	entries.emplace_back(UISizerEntry(element, proportion, border, fillFlags));
 	reparentEntry(entries.back());
+	markAsNeedingLayout();
 }
 
 void UISizer::addSpacer(float size)
 {
 	entries.emplace_back(UISizerEntry({}, 0, Vector4f(type == UISizerType::Horizontal ? size : 0.0f, type == UISizerType::Vertical ? size : 0.0f, 0.0f, 0.0f), {}));
+	markAsNeedingLayout();
 }
 
 void UISizer::addStretchSpacer(float proportion)
 {
 	entries.emplace_back(UISizerEntry({}, proportion, {}, {}));
+	markAsNeedingLayout();
 }
 
 void UISizer::reparent(UIParent& parent)
@@ -178,6 +181,14 @@ void UISizer::reparent(UIParent& parent)
 	}
 }
 
+void UISizer::markAsNeedingLayout()
+{
+	// Widgets only lay out their sizer again when something marks them
+	if (curParent) {
+		curParent->markAsNeedingLayout();
+	}
+}
+
 void UISizer::reparentEntry(UISizerEntry& entry)
 {
 	if (curParent != nullptr) {
@@ -233,6 +244,7 @@ void UISizer::updateEnabled() const
 void UISizer::swapItems(int idxA, int idxB)
 {
 	std::swap(entries[idxA], entries[idxB]);
+	markAsNeedingLayout();
 }
 
 void UISizer::clear()
@@ -249,6 +261,7 @@ void UISizer::clear()
 		}
 	}
 	entries.clear();
+	markAsNeedingLayout();
 }
 
 bool UISizer::isActive() const
@@ -264,6 +277,7 @@ bool UISizer::isActive() const
 void UISizer::setColumnProportions(const std::vector<float>& values)
 {
 	columnProportions = values;
+	markAsNeedingLayout();
 }
 
 void UISizer::setEvenColumns()
@@ -272,12 +286,14 @@ void UISizer::setEvenColumns()
 	for (auto& c: columnProportions) {
 		c = 1.0f;
 	}
+	markAsNeedingLayout();
 }
 
 
 void UISizer::setRowProportions(const std::vector<float>& values)
 {
 	rowProportions = values;
+	markAsNeedingLayout();
 }
 
 Vector2f UISizer::computeMinimumSizeBox(bool includeProportional) const
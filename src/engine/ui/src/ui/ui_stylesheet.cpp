@@ -70,7 +70,15 @@ void loadStyleData(Resources& resources, const String& name, const ConfigNode& n
 }
 
 template <typename T>
-const T& getValue(const ConfigNode& node, Resources& resources, const String& name, const String& key, FlatMap<String, T>& cache)
+void preloadValue(Resources& resources, const String& key, const ConfigNode& node, HashMap<String, T>& cache)
+{
+	T data;
+	loadStyleData(resources, key, node, data);
+	cache[key] = std::move(data);
+}
+
+template <typename T>
+const T& getValue(const ConfigNode& node, Resources& resources, const String& name, const String& key, HashMap<String, T>& cache)
 {
 	// Is it already in cache?
 	const auto iter = cache.find(key);
@@ -88,8 +96,9 @@ const T& getValue(const ConfigNode& node, Resources& resources, const String& na
 		// Not found. Use a default.
 		const auto iter2 = cache.find(":default");
 		if (iter2 != cache.end()) {
+			// Only warn once, every widget using this style will ask for it again
 			Logger::logWarning(String(typeid(T).name()) + " not found in UI style: " + name + "." + key);
-			return iter2->second;
+			return cache[key] = T(iter2->second);
 		} else {
 			throw Exception(String(typeid(T).name()) + " not found in UI style: " + name + "." + key + ". Additionally, default was not set.", HalleyExceptions::Tools);
 		}
@@ -97,14 +106,9 @@ const T& getValue(const ConfigNode& node, Resources& resources, const String& na
 }
 
 template <typename T>
-bool hasValue(const ConfigNode& node, Resources& resources, const String& name, const String& key, FlatMap<String, T>& cache)
+bool hasValue(const ConfigNode& node, Resources& resources, const String& name, const String& key, HashMap<String, T>& cache)
 {
-	// Is it already in cache?
-	const auto iter = cache.find(key);
-	if (iter != cache.end()) {
-		return true;
-	}
-
+	// Not the cache, as that also remembers the defaults handed out for missing keys
 	return node.hasKey(key);
 }
 
@@ -120,6 +124,48 @@ UIStyleDefinition::UIStyleDefinition(String styleName, const ConfigNode& node, R
 	borders[":default"] = Vector4f();
 	strings[":default"] = "";
 	subStyles[":default"] = {};
+
+	preload();
+}
+
+void UIStyleDefinition::preload()
+{
+	// Anything whose type can be told from the config is loaded here, so creating widgets doesn't go back to it.
+	// Strings could be sprite names as well as plain strings, so those still load the first time they're asked for.
+	if (node.getType() != ConfigNodeType::Map) {
+		return;
+	}
+
+	for (auto& entry: node.asMap()) {
+		const auto& key = entry.first;
+		const auto& value = entry.second;
+		try {
+			switch (value.getType()) {
+			case ConfigNodeType::Map:
+				if (value.hasKey("font")) {
+					preloadValue(resources, key, value, textRenderers);
+				} else if (value.hasKey("img")) {
+					preloadValue(resources, key, value, sprites);
+				} else {
+					preloadValue(resources, key, value, subStyles);
+				}
+				break;
+			case ConfigNodeType::Sequence:
+				if (value.asSequence().size() == 4) {
+					preloadValue(resources, key, value, borders);
+				}
+				break;
+			case ConfigNodeType::Int:
+			case ConfigNodeType::Float:
+				preloadValue(resources, key, value, floats);
+				break;
+			default:
+				break;
+			}
+		} catch (...) {
+			// Left for when it's asked for, which reports it if it ever is
+		}
+	}
 }
 
 std::shared_ptr<const UIStyleDefinition> UIStyleDefinition::getSubStyle(const String& name) const
@@ -171,21 +217,19 @@ UIStyleSheet::UIStyleSheet(Resources& resources, const ConfigFile& file)
 void UIStyleSheet::load(const ConfigFile& file)
 {
 	load(file.getRoot());
-	observers[file.getAssetId()] = ConfigObserver(file);
+	auto& observer = observers[file.getAssetId()];
+	observer = ConfigObserver(file);
+	observer.setListener([this] () { changed = true; });
 }
 
 bool UIStyleSheet::needsUpdate() const
 {
-	for (auto& o: observers) {
-		if (o.second.needsUpdate()) {
-			return true;
-		}
-	}
-	return false;
+	return changed;
 }
 
 void UIStyleSheet::update()
 {
+	changed = false;
 	for (auto& o: observers) {
 		o.second.update();
 		load(o.second.getRoot());
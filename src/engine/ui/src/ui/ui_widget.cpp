@@ -30,17 +30,30 @@ UIWidget::~UIWidget()
 void UIWidget::doDraw(UIPainter& painter) const
 {
 	if (isActive()) {
-		draw(painter);
-
-		if (childLayerAdjustment == 0) {
-			drawChildren(painter);
+		if (renderCache) {
+			if (!renderCache->isValidFor(painter)) {
+				auto recorder = painter.withRecorder(*renderCache);
+				drawContents(recorder);
+			}
+			painter.draw(*renderCache);
 		} else {
-			UIPainter p2 = painter.withAdjustedLayer(childLayerAdjustment);
-			drawChildren(p2);
+			drawContents(painter);
 		}
+	}
+}
+
+void UIWidget::drawContents(UIPainter& painter) const
+{
+	draw(painter);
 
-		drawAfterChildren(painter);
+	if (childLayerAdjustment == 0) {
+		drawChildren(painter);
+	} else {
+		UIPainter p2 = painter.withAdjustedLayer(childLayerAdjustment);
+		drawChildren(p2);
 	}
+
+	drawAfterChildren(painter);
 }
 
 void UIWidget::doUpdate(UIWidgetUpdateType updateType, Time t, UIInputType inputType, JoystickType joystickType)
@@ -73,8 +86,9 @@ void UIWidget::doUpdate(UIWidgetUpdateType updateType, Time t, UIInputType input
 
 		removeDeadChildren();
 
-		if (eventHandler) {
-			eventHandler->pump();
+		if (eventHandler && eventHandler->pump()) {
+			// Handlers frequently change how things look
+			markAsNeedingRedraw();
 		}
 	}
 }
@@ -102,6 +116,13 @@ Vector2f UIWidget::getLayoutMinimumSize(bool force) const
 
 void UIWidget::setRect(Rect4f rect)
 {
+	// Nothing in this subtree changed since it was last placed here, so everything in it is still in place
+	if (!placementNeeded && rect == placedRect) {
+		return;
+	}
+	placementNeeded = false;
+	placedRect = rect;
+
 	setWidgetRect(rect);
 	if (sizer) {
 		auto border = getInnerBorder();
@@ -254,6 +275,10 @@ Rect4f UIWidget::getRect() const
 
 void UIWidget::setPosition(Vector2f pos)
 {
+	if (position != pos) {
+		// Children need placing again, even if whoever lays this out next gives it the same rect
+		markAsNeedingLayout();
+	}
 	position = pos;
 	positionUpdated = true;
 }
@@ -278,6 +303,7 @@ void UIWidget::setFocused(bool f)
 {
 	if (focused != f) {
 		focused = f;
+		markAsNeedingRedraw();
 		if (focused) {
 			onFocus();
 			sendEvent(UIEvent(UIEventType::FocusGained, getId()));
@@ -290,7 +316,10 @@ void UIWidget::setFocused(bool f)
 
 void UIWidget::setMouseOver(bool mo)
 {
-	mouseOver = mo;
+	if (mouseOver != mo) {
+		mouseOver = mo;
+		markAsNeedingRedraw();
+	}
 }
 
 void UIWidget::pressMouse(Vector2f mousePos, int button)
@@ -577,6 +606,7 @@ const std::vector<UIInputType>& UIWidget::getOnlyEnabledWithInput() const
 void UIWidget::setInputButtons(const UIInputButtons& buttons)
 {
 	inputButtons = std::make_unique<UIInputButtons>(buttons);
+	markAsNeedingLayout();
 }
 
 Rect4f UIWidget::getMouseRect() const
@@ -637,6 +667,36 @@ void UIWidget::onDestroyRequested()
 {
 }
 
+void UIWidget::resetForReuse()
+{
+	// Dead widgets aren't told when their parent lets go of them, so this may still point to it
+	parent = nullptr;
+	revive();
+}
+
+void UIWidget::revive()
+{
+	alive = true;
+	destroying = false;
+
+	focused = false;
+	mouseOver = false;
+	positionUpdated = false;
+	inputResults.reset();
+	markAsNeedingLayout();
+
+	onResetForReuse();
+	for (auto& c: getChildren()) {
+		if (c->isAlive()) {
+			c->revive();
+		}
+	}
+}
+
+void UIWidget::onResetForReuse()
+{
+}
+
 void UIWidget::sendEvent(UIEvent&& event) const
 {
 	if (canSendEvents) {
@@ -681,6 +741,10 @@ bool UIWidget::needsLayout() const
 void UIWidget::markAsNeedingLayout()
 {
 	layoutNeeded = 1;
+	placementNeeded = true;
+	if (renderCache) {
+		renderCache->invalidate();
+	}
 	if (parent) {
 		parent->markAsNeedingLayout();
 	}
@@ -689,19 +753,49 @@ void UIWidget::markAsNeedingLayout()
 	}
 }
 
+void UIWidget::setRenderCached(bool cached)
+{
+	if (cached && !renderCache) {
+		renderCache = std::make_unique<UIRenderCache>();
+	} else if (!cached) {
+		renderCache.reset();
+	}
+}
+
+bool UIWidget::isRenderCached() const
+{
+	return static_cast<bool>(renderCache);
+}
+
+void UIWidget::markAsNeedingRedraw()
+{
+	if (renderCache) {
+		renderCache->invalidate();
+	}
+	if (parent) {
+		parent->markAsNeedingRedraw();
+	}
+}
+
 void UIWidget::checkActive()
 {
 }
 
 void UIWidget::setWidgetRect(Rect4f rect)
 {
+	bool changed = false;
 	if (position != rect.getTopLeft()) {
 		position = rect.getTopLeft();
-		positionUpdated = true;
+		changed = true;
 	}
 	if (size != rect.getSize()) {
 		size = rect.getSize();
+		changed = true;
+	}
+
+	if (changed) {
 		positionUpdated = true;
+		markAsNeedingRedraw();
 	}
 }
 
@@ -806,7 +900,10 @@ bool UIWidget::isMouseBlocker() const
 
 void UIWidget::setMouseBlocker(bool blocker)
 {
-	mouseBlocker = blocker;
+	if (mouseBlocker != blocker) {
+		mouseBlocker = blocker;
+		markAsNeedingLayout();
+	}
 }
 
 bool UIWidget::shrinksOnLayout() const
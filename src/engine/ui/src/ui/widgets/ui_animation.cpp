@@ -43,6 +43,7 @@ void UIAnimation::update(Time t, bool moved)
 		animation.update(t);
 		animation.updateSprite(sprite);
 		sprite.setPos(getPosition() + offset);
+		markAsNeedingRedraw();
 	}
 }
 
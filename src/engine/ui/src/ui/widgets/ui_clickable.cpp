@@ -100,6 +100,7 @@ bool UIClickable::setState(State state)
 	if (state != curState || forceUpdate) {
 		curState = state;
 		doSetState(state);
+		markAsNeedingRedraw();
 		return true;
 	}
 	return false;
@@ -113,6 +114,12 @@ void UIClickable::onEnabledChanged()
 	doForceUpdate();
 }
 
+void UIClickable::onResetForReuse()
+{
+	held = false;
+	setState(State::Up);
+}
+
 void UIClickable::onShortcutPressed()
 {
 }
@@ -49,12 +49,16 @@ void UIFramedImage::update(Time t, bool moved)
 {
 	const auto bgSize = framedSprite.getSize();
 	scrollPos = (scrollPos + float(t) * scrollSpeed).modulo(bgSize);
+	if (scrollSpeed != Vector2f()) {
+		markAsNeedingRedraw();
+	}
 	UIImage::update(t, moved);
 }
 
 void UIFramedImage::setFramedSprite(const Sprite& sprite)
 {
 	framedSprite = sprite;
+	markAsNeedingRedraw();
 }
 
 Sprite& UIFramedImage::getFramedSprite()
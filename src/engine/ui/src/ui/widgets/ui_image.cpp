@@ -39,6 +39,9 @@ void UIImage::update(Time t, bool moved)
 		sprite
 			.setPos(basePos)
 			.setScale(getSize() / imgBaseSize);
+		if (dirty) {
+			markAsNeedingRedraw();
+		}
 		dirty = false;
 	}
 }
@@ -76,11 +79,13 @@ const Sprite& UIImage::getSprite() const
 void UIImage::setLayerAdjustment(int adjustment)
 {
 	layerAdjustment = adjustment;
+	markAsNeedingRedraw();
 }
 
 void UIImage::setWorldClip(Maybe<Rect4f> wc)
 {
 	worldClip = wc;
+	markAsNeedingRedraw();
 }
 
 void UIImage::setSelectable(Colour4f normalColour, Colour4f selColour)
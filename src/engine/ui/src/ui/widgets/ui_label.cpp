@@ -28,6 +28,9 @@ void UILabel::update(Time t, bool moved)
 	if (text.checkForUpdates()) {
 		updateText();
 	}
+	if (marquee && needsClip) {
+		markAsNeedingRedraw();
+	}
 	if (moved || marquee) {
 		renderer.setPosition(getPosition() + Vector2f(renderer.getAlignment() * textExtents.x - marqueePos, 0.0f));
 	}
@@ -65,6 +68,7 @@ void UILabel::updateMinSize()
 		needsClip = true;
 	}
 	setMinSize(textExtents);
+	markAsNeedingRedraw();
 }
 
 void UILabel::updateText() {
@@ -105,6 +109,7 @@ void UILabel::setText(const LocalisedString& t)
 void UILabel::setColourOverride(const std::vector<ColourOverride>& overrides)
 {
 	renderer.setColourOverride(overrides);
+	markAsNeedingRedraw();
 }
 
 void UILabel::setMaxWidth(float m)
@@ -147,6 +152,7 @@ bool UILabel::isClipped() const
 void UILabel::setAlignment(float alignment)
 {
 	renderer.setAlignment(alignment);
+	markAsNeedingRedraw();
 }
 
 TextRenderer& UILabel::getTextRenderer()
@@ -174,6 +180,7 @@ void UILabel::setTextRenderer(TextRenderer r)
 void UILabel::setColour(Colour4f colour)
 {
 	renderer.setColour(colour);
+	markAsNeedingRedraw();
 }
 
 void UILabel::setSelectable(TextRenderer normalRenderer, TextRenderer selectedRenderer)
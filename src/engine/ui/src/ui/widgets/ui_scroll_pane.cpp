@@ -38,6 +38,8 @@ Vector2f UIScrollPane::getRelativeScrollPosition() const
 
 void UIScrollPane::scrollTo(Vector2f position)
 {	
+	const auto prevPos = scrollPos;
+
 	if (scrollHorizontal) {
 		scrollPos.x = clamp2(position.x, 0.0f, contentsSize.x - getSize().x);
 	}
@@ -45,6 +47,11 @@ void UIScrollPane::scrollTo(Vector2f position)
 	if (scrollVertical) {
 		scrollPos.y = clamp2(position.y, 0.0f, contentsSize.y - getSize().y);
 	}
+
+	if (scrollPos != prevPos) {
+		// Contents are placed relative to the scroll position
+		markAsNeedingLayout();
+	}
 }
 
 void UIScrollPane::scrollBy(Vector2f delta)
@@ -59,6 +66,7 @@ void UIScrollPane::setScrollSpeed(float speed)
 
 void UIScrollPane::update(Time t, bool moved)
 {
+	const auto prevPos = scrollPos;
 	if (!scrollHorizontal) {
 		clipSize.x = getSize().x;
 		scrollPos.x = 0;
@@ -67,6 +75,9 @@ void UIScrollPane::update(Time t, bool moved)
 		clipSize.y = getSize().y;
 		scrollPos.y = 0;
 	}
+	if (scrollPos != prevPos) {
+		markAsNeedingLayout();
+	}
 	contentsSize = UIWidget::getLayoutMinimumSize(false);
 	setMouseClip(Rect4f(getPosition(), getPosition() + getSize()));
 }
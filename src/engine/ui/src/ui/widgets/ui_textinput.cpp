@@ -208,6 +208,9 @@ void UITextInput::update(Time t, bool moved)
 	if (moved) {
 		sprite.setPos(getPosition()).scaleTo(getSize());
 	}
+
+	// The label and caret are rebuilt every update
+	markAsNeedingRedraw();
 }
 
 void UITextInput::onFocus()
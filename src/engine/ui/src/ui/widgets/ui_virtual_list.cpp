@@ -0,0 +1,301 @@
+#include "widgets/ui_virtual_list.h"
+#include "widgets/ui_scroll_pane.h"
+#include <algorithm>
+
+using namespace Halley;
+
+UIVirtualList::UIVirtualList(const String& id, ItemFactory factory, ItemBinder binder, UISizerType orientation, float gap)
+	: UIWidget(id)
+	, factory(std::move(factory))
+	, binder(std::move(binder))
+	, orientation(orientation)
+	, gap(gap)
+{
+	Expects(this->factory);
+	Expects(this->binder);
+	Expects(orientation == UISizerType::Horizontal || orientation == UISizerType::Vertical);
+}
+
+void UIVirtualList::setCount(size_t n)
+{
+	// Measurements are kept for the items that are still around, so appending doesn't move anything
+	count = n;
+	if (!fixedSize) {
+		sizes.resize(count, itemSize);
+		offsetsDirty = true;
+	}
+	releaseAll();
+	markAsNeedingLayout();
+}
+
+size_t UIVirtualList::getCount() const
+{
+	return count;
+}
+
+void UIVirtualList::setItemSize(float size)
+{
+	fixedSize = true;
+	itemSize = size;
+	sizes.clear();
+	offsets.clear();
+	markAsNeedingLayout();
+}
+
+void UIVirtualList::setEstimatedItemSize(float size)
+{
+	fixedSize = false;
+	itemSize = size;
+	sizes.assign(count, size);
+	offsetsDirty = true;
+	markAsNeedingLayout();
+}
+
+void UIVirtualList::setMargin(float m)
+{
+	margin = m;
+}
+
+void UIVirtualList::refresh()
+{
+	for (size_t i = 0; i < visible.size(); ++i) {
+		binder(*visible[i], firstVisible + i);
+	}
+	markAsNeedingLayout();
+}
+
+void UIVirtualList::refresh(size_t index)
+{
+	auto widget = getItemWidget(index);
+	if (widget) {
+		binder(*widget, index);
+		markAsNeedingLayout();
+	}
+}
+
+std::shared_ptr<UIWidget> UIVirtualList::getItemWidget(size_t index) const
+{
+	if (index >= firstVisible && index < firstVisible + visible.size()) {
+		return visible[index - firstVisible];
+	}
+	return {};
+}
+
+Rect4f UIVirtualList::getItemRect(size_t index) const
+{
+	Expects(index < count);
+
+	const int axis = getAxis();
+	Vector2f pos;
+	Vector2f size = getSize();
+	pos[axis] = getItemOffset(index);
+	size[axis] = getItemSize(index);
+	return Rect4f(pos, pos + size);
+}
+
+void UIVirtualList::showItem(size_t index, bool centre)
+{
+	sendEvent(UIEvent(centre ? UIEventType::MakeAreaVisibleCentered : UIEventType::MakeAreaVisible, getId(), getItemRect(index)));
+}
+
+Vector2f UIVirtualList::getLayoutMinimumSize(bool force) const
+{
+	if (!isActive() && !force) {
+		return {};
+	}
+
+	const int axis = getAxis();
+	Vector2f size;
+	for (auto& widget: visible) {
+		size[1 - axis] = std::max(size[1 - axis], widget->getLayoutMinimumSize(false)[1 - axis]);
+	}
+	size[axis] = getTotalSize();
+	return Vector2f::max(getMinimumSize(), size);
+}
+
+void UIVirtualList::setRect(Rect4f rect)
+{
+	setWidgetRect(rect);
+
+	const int axis = getAxis();
+	if (!fixedSize) {
+		bool changed = false;
+		for (size_t i = 0; i < visible.size(); ++i) {
+			const float size = visible[i]->getLayoutMinimumSize(false)[axis];
+			auto& cur = sizes[firstVisible + i];
+			if (cur != size) {
+				cur = size;
+				changed = true;
+			}
+		}
+		if (changed) {
+			// Everything after these moved, including the total size
+			offsetsDirty = true;
+			markAsNeedingLayout();
+		}
+	}
+
+	for (size_t i = 0; i < visible.size(); ++i) {
+		const size_t index = firstVisible + i;
+		Vector2f pos = rect.getTopLeft();
+		Vector2f size = rect.getSize();
+		pos[axis] += getItemOffset(index);
+		size[axis] = getItemSize(index);
+		visible[i]->setRect(Rect4f(pos, pos + size));
+	}
+}
+
+void UIVirtualList::update(Time t, bool moved)
+{
+	updateVisible();
+}
+
+int UIVirtualList::getAxis() const
+{
+	return orientation == UISizerType::Horizontal ? 0 : 1;
+}
+
+float UIVirtualList::getItemOffset(size_t index) const
+{
+	if (fixedSize) {
+		return float(index) * (itemSize + gap);
+	}
+	updateOffsets();
+	return offsets[index];
+}
+
+float UIVirtualList::getItemSize(size_t index) const
+{
+	return fixedSize ? itemSize : sizes[index];
+}
+
+float UIVirtualList::getTotalSize() const
+{
+	if (count == 0) {
+		return 0;
+	}
+	return getItemOffset(count - 1) + getItemSize(count - 1);
+}
+
+size_t UIVirtualList::getIndexAt(float offset) const
+{
+	if (count == 0 || offset <= 0) {
+		return 0;
+	}
+	if (fixedSize) {
+		const float stride = itemSize + gap;
+		return stride > 0 ? std::min(size_t(offset / stride), count - 1) : 0;
+	}
+	updateOffsets();
+	const auto iter = std::upper_bound(offsets.begin(), offsets.end(), offset);
+	return size_t(iter - offsets.begin()) - 1;
+}
+
+void UIVirtualList::updateOffsets() const
+{
+	if (offsetsDirty) {
+		offsets.resize(count);
+		float pos = 0;
+		for (size_t i = 0; i < count; ++i) {
+			offsets[i] = pos;
+			pos += sizes[i] + gap;
+		}
+		offsetsDirty = false;
+	}
+}
+
+void UIVirtualList::updateVisible()
+{
+	size_t first = 0;
+	size_t last = 0;
+	float start;
+	float end;
+	if (getViewRange(start, end)) {
+		first = getIndexAt(start);
+		last = getIndexAt(end) + 1;
+	}
+
+	if (first == firstVisible && last - first == visible.size()) {
+		return;
+	}
+
+	// Release first, so the ones coming into view can reuse them
+	std::vector<std::shared_ptr<UIWidget>> newVisible(last - first);
+	for (size_t i = 0; i < visible.size(); ++i) {
+		const size_t index = firstVisible + i;
+		if (index >= first && index < last) {
+			newVisible[index - first] = std::move(visible[i]);
+		} else {
+			release(std::move(visible[i]));
+		}
+	}
+	for (size_t index = first; index < last; ++index) {
+		auto& widget = newVisible[index - first];
+		if (!widget) {
+			widget = acquire(index);
+		}
+	}
+
+	visible = std::move(newVisible);
+	firstVisible = first;
+	markAsNeedingLayout();
+}
+
+bool UIVirtualList::getViewRange(float& start, float& end) const
+{
+	if (count == 0) {
+		return false;
+	}
+
+	const int axis = getAxis();
+	start = 0;
+	end = getSize()[axis];
+
+	// Without a scroll pane, everything is in view
+	for (auto parent = getParent(); parent; ) {
+		auto pane = dynamic_cast<UIScrollPane*>(parent);
+		if (pane) {
+			const auto paneRect = pane->getRect();
+			const auto pos = getPosition()[axis];
+			start = std::max(start, (axis == 0 ? paneRect.getLeft() : paneRect.getTop()) - pos);
+			end = std::min(end, (axis == 0 ? paneRect.getRight() : paneRect.getBottom()) - pos);
+			break;
+		}
+		auto widget = dynamic_cast<UIWidget*>(parent);
+		parent = widget ? widget->getParent() : nullptr;
+	}
+
+	start -= margin;
+	end += margin;
+	return end >= start;
+}
+
+std::shared_ptr<UIWidget> UIVirtualList::acquire(size_t index)
+{
+	std::shared_ptr<UIWidget> widget;
+	if (pool.empty()) {
+		widget = factory();
+		addChild(widget);
+	} else {
+		widget = std::move(pool.back());
+		pool.pop_back();
+		widget->setActive(true);
+	}
+	binder(*widget, index);
+	return widget;
+}
+
+void UIVirtualList::release(std::shared_ptr<UIWidget> widget)
+{
+	widget->setActive(false);
+	pool.push_back(std::move(widget));
+}
+
+void UIVirtualList::releaseAll()
+{
+	for (auto& widget: visible) {
+		release(std::move(widget));
+	}
+	visible.clear();
+	firstVisible = 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <gsl/gsl>
+#include <memory>
+#include <vector>
+#include "resampler.h"
+
+namespace Halley
+{
+	enum class AudioResamplerQuality
+	{
+		Fast,
+		Normal,
+		High
+	};
+
+	// Windowed sinc resampler for realtime use; works on one channel at a time, or on interleaved data
+	// Rates that reduce to a small ratio (including integer ones) use an exact filter bank, others interpolate between phases
+	class AudioPolyphaseResampler
+	{
+	public:
+		AudioPolyphaseResampler(int from, int to, size_t nChannels, AudioResamplerQuality quality = AudioResamplerQuality::Normal);
+		~AudioPolyphaseResampler();
+
+		// Only reads as much of src as is needed to fill dst
+		AudioResamplerResult resample(gsl::span<const float> src, gsl::span<float> dst, size_t channel);
+		AudioResamplerResult resampleInterleaved(gsl::span<const float> src, gsl::span<float> dst);
+
+		// Number of input samples (per channel) to read in order to write exactly numOutputSamples
+		size_t getInputSamplesNeeded(size_t numOutputSamples) const;
+		size_t numOutputSamples(size_t numInputSamples) const;
+
+		void reset();
+
+		struct FilterTable;
+
+	private:
+		struct ChannelState
+		{
+			std::vector<float> buffer;
+			size_t pos = 0;
+			uint64_t phase = 0;
+		};
+
+		std::shared_ptr<const FilterTable> table;
+		std::vector<ChannelState> channels;
+		uint64_t upFactor;
+		uint64_t downFactor;
+		size_t stepInt;
+		uint64_t stepFrac;
+
+		size_t getInputSamplesNeeded(const ChannelState& state, size_t numOutputSamples) const;
+		AudioResamplerResult process(ChannelState& state, const float* src, size_t srcLen, size_t srcStride, float* dst, size_t dstLen, size_t dstStride);
+		float filterSample(const float* src, uint64_t phase) const;
+	};
+}
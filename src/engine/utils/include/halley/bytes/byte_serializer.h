@@ -12,16 +12,65 @@
 #include <cstdint>
 #include <utility>
 #include <set>
+#include <cmath>
+#include <algorithm>
+#include <type_traits>
 #include <boost/optional.hpp>
+#include <memory>
 #include "halley/maths/vector4.h"
+#include "halley/text/string_view.h"
 
 namespace Halley {
 	class String;
 
+	// Serialized bytes kept as a sequence of chunks, so they never need to be sized in advance or held in one allocation.
+	// Chunks are immutable once added and shared between copies, so appending one SerializedChunks to another doesn't copy any bytes.
+	class SerializedChunks {
+	public:
+		SerializedChunks() = default;
+		explicit SerializedChunks(Bytes bytes);
+
+		size_t getSize() const { return size; }
+		bool isEmpty() const { return size == 0; }
+		const std::vector<std::shared_ptr<const Bytes>>& getChunks() const { return chunks; }
+
+		void append(Bytes bytes);
+		void append(const SerializedChunks& other);
+
+		Bytes toBytes() const;
+
+	private:
+		std::vector<std::shared_ptr<const Bytes>> chunks;
+		size_t size = 0;
+	};
+
 	class Serializer {
 	public:
+		constexpr static size_t defaultChunkSize = 256 * 1024;
+
 		Serializer();
 		explicit Serializer(gsl::span<gsl::byte> dst);
+		explicit Serializer(SerializedChunks& dst, size_t chunkSize = defaultChunkSize); // Writes in one pass, adding chunks to dst as they fill up
+		~Serializer();
+
+		Serializer(const Serializer& other) = delete;
+		Serializer& operator=(const Serializer& other) = delete;
+
+		// Unlike toBytes, makes a single pass, with no dry run to find the size first
+		template <typename T, typename std::enable_if<std::is_convertible<T, std::function<void(Serializer&)>>::value, int>::type = 0>
+		static SerializedChunks toChunks(const T& f, int version = 0, size_t chunkSize = defaultChunkSize)
+		{
+			SerializedChunks result;
+			{
+				Serializer s(result, chunkSize);
+				s.setVersion(version);
+				f(s);
+			}
+			return result;
+		}
+
+		// Adds what has been written so far to the chunks; also done when the Serializer is destroyed
+		void flush();
 
 		template <typename T, typename std::enable_if<std::is_convertible<T, std::function<void(Serializer&)>>::value, int>::type = 0>
 		static Bytes toBytes(const T& f)
@@ -56,6 +105,7 @@ namespace Halley {
 
 		Serializer& operator<<(const std::string& str);
 		Serializer& operator<<(const String& str);
+		Serializer& operator<<(StringView str); // Same as a String
 		Serializer& operator<<(const Path& path);
 		Serializer& operator<<(gsl::span<const gsl::byte> span);
 		Serializer& operator<<(const Bytes& bytes);
@@ -166,26 +216,86 @@ namespace Halley {
 			return *this;
 		}
 
+		// Consecutive calls share bytes; anything else written afterwards starts on a new byte
+		template <typename T>
+		Serializer& serializeBits(T value, int nBits)
+		{
+			static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "Only integers and enums can be bit-packed");
+			return writeBits(static_cast<uint64_t>(value), nBits);
+		}
+
+		// Values outside [min, max] are clamped
+		template <typename T>
+		Serializer& serializeQuantized(T value, T min, T max, int nBits)
+		{
+			static_assert(std::is_arithmetic<T>::value, "Only numbers can be quantized");
+			Expects(max > min);
+			const T clamped = std::max(min, std::min(max, value));
+			return writeBits(quantize(clamped, min, max, nBits, std::is_floating_point<T>()), nBits);
+		}
+
+		void setVersion(int version);
+		int getVersion() const;
+
 	private:
 		bool dryRun;
 		size_t size = 0;
 		gsl::span<gsl::byte> dst;
+		size_t pos = 0; // Into dst, which is the chunk being written to, if writing to chunks
+		int bitOffset = 0; // Bits already used in the last byte, if it's being shared
+		int version = 0;
+
+		SerializedChunks* chunks = nullptr;
+		size_t chunkSize = 0;
+		Bytes chunk;
 
 		template <typename T>
 		Serializer& serializePod(T val)
 		{
 			if (!dryRun) {
-				memcpy(dst.data() + size, &val, sizeof(T));
+				memcpy(getWritePtr(sizeof(T)), &val, sizeof(T));
 			}
 			size += sizeof(T);
+			bitOffset = 0;
 			return *this;
 		}
+
+		gsl::byte* getWritePtr(size_t n)
+		{
+			if (chunks && pos + n > size_t(dst.size())) {
+				nextChunk();
+			}
+			auto result = dst.data() + pos;
+			pos += n;
+			return result;
+		}
+
+		void nextChunk();
+		Serializer& writeBits(uint64_t value, int nBits);
+
+		template <typename T>
+		static uint64_t quantize(T value, T min, T max, int nBits, std::true_type)
+		{
+			const double maxValue = double(nBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << nBits) - 1);
+			return static_cast<uint64_t>(std::llround(double(value - min) / double(max - min) * maxValue));
+		}
+
+		template <typename T>
+		static uint64_t quantize(T value, T min, T, int, std::false_type)
+		{
+			return static_cast<uint64_t>(value - min);
+		}
 	};
 
 	class Deserializer {
 	public:
 		Deserializer(gsl::span<const gsl::byte> src);
 		explicit Deserializer(const Bytes& src);
+
+		// When whatever is read is known not to outlive src (e.g. a resource holding on to its ResourceDataStatic), strings and bytes
+		// can be borrowed from it as views, rather than copied into a String or Bytes for every field
+		Deserializer(gsl::span<const gsl::byte> src, bool canBorrow);
+		bool canBorrow() const { return borrowing; }
 		
 		template <typename T>
 		static T fromBytes(const Bytes& src)
@@ -237,6 +347,10 @@ namespace Halley {
 		Deserializer& operator>>(gsl::span<gsl::byte>& span);
 		Deserializer& operator>>(Bytes& bytes);
 
+		// These two are only for when canBorrow(), and point into src
+		Deserializer& operator>>(StringView& str); // Reads a String
+		Deserializer& borrow(gsl::span<const gsl::byte>& bytes); // Reads Bytes
+
 		template <typename T>
 		Deserializer& operator>>(std::vector<T>& val)
 		{
@@ -387,6 +501,30 @@ namespace Halley {
 			return *this;
 		}
 
+		// Signed values are sign-extended from nBits
+		template <typename T>
+		Deserializer& deserializeBits(T& value, int nBits)
+		{
+			static_assert(std::is_integral<T>::value || std::is_enum<T>::value, "Only integers and enums can be bit-packed");
+			using I = typename std::conditional<std::is_enum<T>::value, std::underlying_type<T>, std::common_type<T>>::type::type;
+
+			uint64_t bits = readBits(nBits);
+			if (std::is_signed<I>::value && nBits < 64 && (bits >> (nBits - 1)) & 1) {
+				bits |= ~uint64_t(0) << nBits;
+			}
+			value = static_cast<T>(static_cast<I>(bits));
+			return *this;
+		}
+
+		template <typename T>
+		Deserializer& deserializeQuantized(T& value, T min, T max, int nBits)
+		{
+			static_assert(std::is_arithmetic<T>::value, "Only numbers can be quantized");
+			Expects(max > min);
+			value = dequantize(readBits(nBits), min, max, nBits, std::is_floating_point<T>());
+			return *this;
+		}
+
 		void setVersion(int version);
 		int getVersion() const;
 
@@ -394,6 +532,23 @@ namespace Halley {
 		size_t pos = 0;
 		gsl::span<const gsl::byte> src;
 		int version = 0;
+		bool borrowing = false;
+		int bitOffset = 0; // Bits already read from the last byte, if it's being shared
+
+		uint64_t readBits(int nBits);
+
+		template <typename T>
+		static T dequantize(uint64_t bits, T min, T max, int nBits, std::true_type)
+		{
+			const double maxValue = double(nBits >= 64 ? ~uint64_t(0) : (uint64_t(1) << nBits) - 1);
+			return static_cast<T>(double(min) + double(bits) / maxValue * double(max - min));
+		}
+
+		template <typename T>
+		static T dequantize(uint64_t bits, T min, T max, int, std::false_type)
+		{
+			return std::min(max, static_cast<T>(min + static_cast<T>(bits)));
+		}
 
 		template <typename T>
 		Deserializer& deserializePod(T& val)
@@ -401,6 +556,7 @@ namespace Halley {
 			ensureSufficientBytesRemaining(sizeof(T));
 			memcpy(&val, src.data() + pos, sizeof(T));
 			pos += sizeof(T);
+			bitOffset = 0;
 			return *this;
 		}
 
@@ -1,18 +1,42 @@
 #pragma once
 #include "../utils/utils.h"
+#include "../text/halleystring.h"
 #include <gsl/gsl>
 #include <limits>
 
 namespace Halley {
+	class SerializedChunks;
+
 	class Compression {
 	public:
+		// Codecs are named as in the "asset_compression" metadata: "deflate" is dense, "lz4" is much faster to decompress
+		static bool isValidCodec(const String& codec);
+		static Bytes compress(gsl::span<const gsl::byte> bytes, const String& codec);
+		static Bytes decompress(gsl::span<const gsl::byte> bytes, const String& codec, size_t maxSize = std::numeric_limits<size_t>::max());
+
+
 		static Bytes compress(const Bytes& bytes);
 		static Bytes compress(gsl::span<const gsl::byte> bytes);
+		static Bytes compress(const SerializedChunks& chunks); // Same output as compressing them joined, without joining them
 		static Bytes decompress(const Bytes& bytes, size_t maxSize = std::numeric_limits<size_t>::max());
 		static Bytes decompress(gsl::span<const gsl::byte> bytes, size_t maxSize = std::numeric_limits<size_t>::max());
 		static std::shared_ptr<const char> decompressToSharedPtr(gsl::span<const gsl::byte> bytes, size_t& outSize, size_t maxSize = std::numeric_limits<size_t>::max());
+		static std::shared_ptr<const char> decompressToSharedPtr(gsl::span<const gsl::byte> bytes, const String& codec, size_t& outSize, size_t maxSize = std::numeric_limits<size_t>::max());
 
 		static Bytes compressRaw(gsl::span<const gsl::byte> bytes, bool insertLength);
 		static Bytes decompressRaw(gsl::span<const gsl::byte> bytes, size_t maxSize, size_t expectedSize = 0);
+
+		// LZ4 block format, prefixed with the uncompressed length like compress()
+		static Bytes compressLZ4(gsl::span<const gsl::byte> bytes);
+		static Bytes decompressLZ4(gsl::span<const gsl::byte> bytes, size_t maxSize = std::numeric_limits<size_t>::max());
+
+		// Blocks of chunkSize bytes compressed independently with codec, so a range can be decompressed without starting from the beginning.
+		// Laid out as a ChunkedHeader, then numChunks + 1 uint64 offsets from the start of the data (the last one is the end), then the blocks.
+		struct ChunkedHeader {
+			uint32_t chunkSize;
+			uint32_t numChunks;
+			uint64_t totalSize;
+		};
+		static Bytes compressChunked(gsl::span<const gsl::byte> bytes, const String& codec, size_t chunkSize = 64 * 1024);
 	};
 }
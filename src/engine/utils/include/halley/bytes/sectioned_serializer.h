@@ -0,0 +1,44 @@
+#pragma once
+
+#include "byte_serializer.h"
+#include "halley/text/halleystring.h"
+#include <functional>
+#include <map>
+
+namespace Halley {
+	// Serializes a save (or anything else big) as named sections, each written by its own function.
+	// Only sections marked dirty since the last serialize() are written again; the rest reuse the chunks they produced last time,
+	// so a save where little changed costs little more than the changes, and the result shares its bytes with those sections.
+	// Laid out as a uint32 header size, then the header (a magic number, then each section's name and size), then the sections in order.
+	class SectionedSerializer {
+	public:
+		using Writer = std::function<void(Serializer&)>;
+
+		void setSection(const String& name, Writer writer); // Dirty until the next serialize()
+		void removeSection(const String& name);
+
+		void markDirty(const String& name);
+		void markAllDirty();
+		bool isDirty(const String& name) const;
+
+		void setVersion(int version); // Passed to each section's Serializer; changing it marks them all dirty
+
+		SerializedChunks serialize();
+
+		// The spans point into data
+		static std::map<String, gsl::span<const gsl::byte>> deserialize(gsl::span<const gsl::byte> data);
+
+	private:
+		struct Section {
+			Writer writer;
+			SerializedChunks data;
+			bool dirty = true;
+		};
+
+		std::map<String, Section> sections;
+		int version = 0;
+
+		Section& getSection(const String& name);
+		const Section& getSection(const String& name) const;
+	};
+}
@@ -1,6 +1,11 @@
 #pragma once
-#include <array>
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include <halley/text/halleystring.h>
 #include "executor.h"
 #include "future.h"
@@ -13,7 +18,8 @@ namespace Halley
 	enum class ThreadPriority {
 		Low,
 		Normal,
-		High
+		High,
+		Realtime // Time-critical work that can't miss a deadline, like audio; keep whatever runs at this short and non-blocking
 	};
 
 	namespace Concurrent
@@ -52,34 +58,199 @@ namespace Halley
 			return future.getFuture();
 		}
 
+		// Fire and forget: no Future or shared state is created, so nothing can wait on the result
+		template <typename F>
+		void executeDetached(ExecutionQueue& e, F&& f)
+		{
+			e.addToQueue(TaskBase(std::forward<F>(f)));
+		}
+
+		template <typename F>
+		void executeDetached(F&& f)
+		{
+			executeDetached(ExecutionQueue::getDefault(), std::forward<F>(f));
+		}
+
+		// Blocks until isDone() returns true, running other tasks from the queue in the meantime
+		template <typename F>
+		void helpUntil(ExecutionQueue& e, F isDone)
+		{
+			while (!isDone()) {
+				if (!e.tryRunNext()) {
+					std::this_thread::yield();
+				}
+			}
+		}
+
+		// Blocks until the future is ready, running other tasks from the queue in the meantime
+		template <typename T>
+		void helpUntilReady(ExecutionQueue& e, Future<T>& future)
+		{
+			helpUntil(e, [&] () { return future.isReady(); });
+		}
+
+		// Counts the chunks of a parallel loop still queued, and keeps the first exception any chunk threw. Chunks must never
+		// throw out of their task, or they'd never be counted as done and the caller would wait forever.
+		class ChunkTracker
+		{
+		public:
+			explicit ChunkTracker(size_t queued)
+				: pending(queued)
+			{}
+
+			template <typename F>
+			void run(F&& f) noexcept
+			{
+				try {
+					f();
+				} catch (...) {
+					std::unique_lock<std::mutex> lock(mutex);
+					if (!error) {
+						error = std::current_exception();
+					}
+				}
+			}
+
+			void onQueuedDone() { pending.fetch_sub(1, std::memory_order_release); }
+			bool isDone() const { return pending.load(std::memory_order_acquire) == 0; }
+
+			// Only once isDone(), on the thread that queued the chunks
+			void rethrowIfFailed()
+			{
+				if (error) {
+					std::rethrow_exception(error);
+				}
+			}
+
+		private:
+			std::atomic<size_t> pending;
+			std::mutex mutex;
+			std::exception_ptr error;
+		};
+
+		// grainSize is the number of elements per task; 0 picks a few tasks per thread, so idle threads have something to steal.
+		// If f throws, the first exception is rethrown here once every chunk is done (the rest of a chunk that threw is skipped).
 		template <typename T, typename F>
-		void foreach(ExecutionQueue& e, T begin, T end, F f)
+		void foreach(ExecutionQueue& e, T begin, T end, F f, size_t grainSize = 0)
 		{
 			const size_t n = end - begin;
-			constexpr size_t maxThreads = 8;
-			size_t nThreads = std::max(size_t(1), std::min(maxThreads, e.threadCount()));
-			std::array<Future<void>, maxThreads> futures;
-
-			size_t prevEnd = 0;
-			for (size_t j = 0; j < nThreads; ++j) {
-				size_t curStart = prevEnd;
-				size_t curEnd = n * (j + 1) / nThreads;
-				prevEnd = curEnd;
-
-				futures[j] = execute([begin, f, curStart, curEnd]() {
-					for (auto i = begin + curStart; i < begin + curEnd; ++i) {
-						f(*i);
-					}
+			const size_t nThreads = e.threadCount();
+			if (grainSize == 0) {
+				grainSize = std::max(size_t(1), n / (std::max(size_t(1), nThreads) * 4));
+			}
+			const size_t nChunks = (n + grainSize - 1) / grainSize;
+
+			if (nChunks <= 1 || nThreads == 0) {
+				for (auto i = begin; i < end; ++i) {
+					f(*i);
+				}
+				return;
+			}
+
+			// The chunks don't need futures of their own, as this waits for all of them before returning (or rethrowing what they threw)
+			ChunkTracker tracker(nChunks - 1);
+			for (size_t j = 1; j < nChunks; ++j) {
+				size_t curStart = j * grainSize;
+				size_t curEnd = std::min(n, curStart + grainSize);
+
+				executeDetached(e, [begin, &f, &tracker, curStart, curEnd]() {
+					tracker.run([&] () {
+						for (auto i = begin + curStart; i < begin + curEnd; ++i) {
+							f(*i);
+						}
+					});
+					tracker.onQueuedDone();
 				});
 			}
 
-			whenAll(futures.data(), futures.data() + nThreads).wait();
+			// Do the first chunk here, then help with the rest, so nested calls from a worker can't starve the pool
+			tracker.run([&] () {
+				for (auto i = begin; i < begin + std::min(n, grainSize); ++i) {
+					f(*i);
+				}
+			});
+			helpUntil(e, [&] () { return tracker.isDone(); });
+			tracker.rethrowIfFailed();
+		}
+
+		// How many chunks foreach() and forChunks() split n elements into, for a given grainSize (0 picks as foreach() does)
+		inline size_t getChunkCount(ExecutionQueue& e, size_t n, size_t grainSize = 0)
+		{
+			if (grainSize == 0) {
+				grainSize = std::max(size_t(1), n / (std::max(size_t(1), e.threadCount()) * 4));
+			}
+			return e.threadCount() == 0 ? std::min(n, size_t(1)) : (n + grainSize - 1) / grainSize;
+		}
+
+		// Calls f(chunkIdx, start, end) for each of nChunks ranges covering [0, n), in parallel. The ranges are balanced (their sizes differ
+		// by at most one), rather than leaving a short one at the end. With sticky set, chunk i is always queued on the same worker, so
+		// the same ranges tend to be processed by the same thread (and stay in its cache) from one call to the next.
+		// Exceptions are handled as in foreach().
+		template <typename F>
+		void forChunks(ExecutionQueue& e, size_t n, size_t nChunks, F f, bool sticky = false)
+		{
+			if (nChunks == 0) {
+				return;
+			}
+			const size_t base = n / nChunks;
+			const size_t extra = n % nChunks;
+			auto chunkStart = [=] (size_t j) { return j * base + std::min(j, extra); };
+
+			if (nChunks == 1 || e.threadCount() == 0) {
+				for (size_t j = 0; j < nChunks; ++j) {
+					f(j, chunkStart(j), chunkStart(j + 1));
+				}
+				return;
+			}
+
+			ChunkTracker tracker(nChunks - 1);
+			for (size_t j = 1; j < nChunks; ++j) {
+				auto task = [&f, &tracker, j, start = chunkStart(j), end = chunkStart(j + 1)] () {
+					tracker.run([&] () { f(j, start, end); });
+					tracker.onQueuedDone();
+				};
+				if (sticky) {
+					e.addToWorker(j - 1, TaskBase(std::move(task)));
+				} else {
+					executeDetached(e, std::move(task));
+				}
+			}
+
+			tracker.run([&] () { f(0, 0, chunkStart(1)); });
+			helpUntil(e, [&] () { return tracker.isDone(); });
+			tracker.rethrowIfFailed();
+		}
+
+		// Reduces [begin, end) to combine(...combine(combine(identity, map(e0)), map(e1))...), in parallel. Each chunk of grainSize
+		// elements is reduced on its own, and the partial results are then combined in order. As the chunks only depend on grainSize,
+		// never on the number of threads, the result is the same on every machine, even when floating point combine isn't associative.
+		template <typename R, typename T, typename M, typename C>
+		R reduce(ExecutionQueue& e, T begin, T end, R identity, M map, C combine, size_t grainSize)
+		{
+			Expects(grainSize > 0);
+			const size_t n = end - begin;
+			const size_t nChunks = (n + grainSize - 1) / grainSize;
+			std::vector<R> partials(nChunks, identity);
+			forChunks(e, n, nChunks, [&] (size_t chunk, size_t start, size_t chunkEnd)
+			{
+				R acc = identity;
+				for (auto i = begin + start; i < begin + chunkEnd; ++i) {
+					acc = combine(acc, map(*i));
+				}
+				partials[chunk] = acc;
+			});
+
+			R result = identity;
+			for (auto& p: partials) {
+				result = combine(result, p);
+			}
+			return result;
 		}
 
 		template <typename T, typename F>
-		void foreach(T begin, T end, F f)
+		void foreach(T begin, T end, F f, size_t grainSize = 0)
 		{
-			foreach(ExecutionQueue::getDefault(), begin, end, f);
+			foreach(ExecutionQueue::getDefault(), begin, end, f, grainSize);
 		}
 	}
 }
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include "future.h"
+#include "halley/time/halleytime.h"
+#include "halley/data_structures/vector.h"
+
+namespace Halley {
+	// Destroys things after whoever owned them is done with them, so letting go of a lot at once (e.g. when leaving a level) doesn't stall the frame.
+	// Anything that only frees memory can be destroyed on a worker. Anything that releases video objects has to be destroyed on the main thread,
+	// so it's destroyed a few at a time, within a time budget, on each update(); anything that can be torn down in steps is given a step each update().
+	// Must only be used from the main thread.
+	class DeferredDestructor {
+	public:
+		DeferredDestructor() = default;
+		~DeferredDestructor(); // Destroys whatever's still pending
+
+		DeferredDestructor(const DeferredDestructor& other) = delete;
+		DeferredDestructor& operator=(const DeferredDestructor& other) = delete;
+
+		void destroyOnWorker(std::shared_ptr<void> object);
+		void destroyOnMainThread(std::shared_ptr<void> object);
+
+		// Calls step(maxTime) once per update() until it returns true, then lets go of it
+		void destroyIncrementally(std::function<bool(Time maxTime)> step);
+
+		// At least one thing on the main thread is destroyed, and one step taken, however small maxTime is
+		void update(Time maxTime);
+		void flush(); // Destroys everything now, waiting for workers
+
+		size_t getNumPending() const;
+
+	private:
+		Vector<std::shared_ptr<void>> toWorker;
+		std::deque<std::shared_ptr<void>> onMainThread;
+		std::deque<std::function<bool(Time)>> incremental;
+		Vector<Future<void>> onWorkers;
+	};
+}
@@ -1,41 +1,174 @@
 #pragma once
+#include <array>
 #include <deque>
+#include <memory>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <functional>
 #include <atomic>
+#include <cstddef>
+#include <new>
+#include <type_traits>
 #include <vector>
 #include "halley/text/halleystring.h"
+#include "halley/data_structures/maybe.h"
+#include "halley/os/cpu_topology.h"
 
 namespace Halley
 {
-	using TaskBase = std::function<void()>;
+	// Move-only void() callable. Small callables (such as the ones made by Task) are stored inline,
+	// so queueing them doesn't need to allocate; anything larger falls back to the heap.
+	class TaskBase
+	{
+	public:
+		constexpr static size_t inlineSize = 6 * sizeof(void*);
+
+		TaskBase() = default;
+
+		template <typename F, typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, TaskBase>::value>::type>
+		TaskBase(F&& f)
+		{
+			using Fn = typename std::decay<F>::type;
+			constexpr bool fitsInline = sizeof(Fn) <= inlineSize && alignof(Fn) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<Fn>::value;
+			init<Fn>(std::forward<F>(f), std::integral_constant<bool, fitsInline>());
+		}
+
+		TaskBase(TaskBase&& other) noexcept
+		{
+			moveFrom(other);
+		}
+
+		TaskBase& operator=(TaskBase&& other) noexcept
+		{
+			if (this != &other) {
+				reset();
+				moveFrom(other);
+			}
+			return *this;
+		}
+
+		TaskBase(const TaskBase& other) = delete;
+		TaskBase& operator=(const TaskBase& other) = delete;
+
+		~TaskBase()
+		{
+			reset();
+		}
+
+		void operator()()
+		{
+			ops->call(&storage);
+		}
+
+		explicit operator bool() const
+		{
+			return ops != nullptr;
+		}
+
+	private:
+		struct Ops
+		{
+			void (*call)(void* storage);
+			void (*move)(void* dst, void* src);
+			void (*destroy)(void* storage);
+		};
+
+		typename std::aligned_storage<inlineSize, alignof(std::max_align_t)>::type storage;
+		const Ops* ops = nullptr;
+
+		template <typename Fn, typename F>
+		void init(F&& f, std::true_type)
+		{
+			static const Ops inlineOps = {
+				[] (void* s) { (*static_cast<Fn*>(s))(); },
+				[] (void* dst, void* src) { new (dst) Fn(std::move(*static_cast<Fn*>(src))); static_cast<Fn*>(src)->~Fn(); },
+				[] (void* s) { static_cast<Fn*>(s)->~Fn(); }
+			};
+			new (&storage) Fn(std::forward<F>(f));
+			ops = &inlineOps;
+		}
+
+		template <typename Fn, typename F>
+		void init(F&& f, std::false_type)
+		{
+			static const Ops heapOps = {
+				[] (void* s) { (**static_cast<Fn**>(s))(); },
+				[] (void* dst, void* src) { *static_cast<Fn**>(dst) = *static_cast<Fn**>(src); },
+				[] (void* s) { delete *static_cast<Fn**>(s); }
+			};
+			*reinterpret_cast<Fn**>(&storage) = new Fn(std::forward<F>(f));
+			ops = &heapOps;
+		}
+
+		void moveFrom(TaskBase& other) noexcept
+		{
+			if (other.ops) {
+				other.ops->move(&storage, &other.storage);
+				ops = other.ops;
+				other.ops = nullptr;
+			}
+		}
+
+		void reset()
+		{
+			if (ops) {
+				ops->destroy(&storage);
+				ops = nullptr;
+			}
+		}
+	};
 
 	class ExecutionQueue
 	{
 	public:
 		ExecutionQueue();
 		void addToQueue(TaskBase task);
+		void addToWorker(size_t worker, TaskBase task); // Queues on that worker's own deque (modulo the number of attached workers), though others may still steal it
 
 		TaskBase getNext();
 		std::vector<TaskBase> getAll();
 
+		// Runs one pending task on the calling thread, if there's any; use it to help instead of blocking
+		bool tryRunNext();
+
 		size_t threadCount() const;
-		void onAttached();
-		void onDetached();
+		int onAttached();
+		void onDetached(int worker);
 		void abort();
 
+		void setWorkerThread(int worker);
+
 		static ExecutionQueue& getDefault();
 
 	private:
+		// Each attached executor gets its own deque. Tasks queued from a worker go to its own deque, and are
+		// run newest-first by it; idle workers steal the oldest tasks from the others.
+		// Slots are never freed, so others can look at them without locking the queue; a detached executor's is given to the next one.
+		struct WorkerQueue
+		{
+			std::mutex mutex;
+			std::deque<TaskBase> tasks;
+			std::atomic<bool> attached;
+
+			WorkerQueue() : attached(true) {}
+		};
+		constexpr static int maxWorkers = 64;
+
 		std::deque<TaskBase> queue;
 		std::mutex mutex;
 		std::condition_variable condition;
 
+		std::array<std::unique_ptr<WorkerQueue>, maxWorkers> workers;
+		std::atomic<int> workerCount; // Slots in use, including detached ones
+		std::atomic<int> queuedCount;
+
 		std::atomic<int> attachedCount;
 		std::atomic<bool> hasTasks;
 		std::atomic<bool> aborted;
+
+		bool tryGetTask(TaskBase& task);
+		int getCurrentWorker() const;
 	};
 
 	class Executors
@@ -43,6 +176,7 @@ namespace Halley
 	public:
 		static Executors& get();
 		static void set(Executors& e);
+		static bool isDefined() { return instance != nullptr; }
 
 		static ExecutionQueue& getCPU() { return instance->cpu; }
 		static ExecutionQueue& getCPUAux() { return instance->cpuAux; }
@@ -73,6 +207,32 @@ namespace Halley
 	private:
 		ExecutionQueue& queue;
 		std::atomic<bool> running;
+		int workerIdx = -1;
+	};
+
+	// How many threads a pool has, and which CPUs they can run on. By default, one per logical CPU, left entirely to the OS.
+	struct ThreadPoolTopology
+	{
+		size_t threads = 0; // 0 is one per CPU they're allowed on
+		Maybe<CPUCoreClass> coreClass; // Only on cores of this class, if the CPU has any
+		Maybe<int> numaNode; // Only on this node, if it exists
+		std::vector<int> cpus; // Only on these logical CPUs, regardless of the above
+		bool pinToCores = false; // Each thread on a single CPU, round robin, rather than anywhere among them
+		bool spreadNumaNodes = true; // With several nodes, each thread stays on one, round robin, so what it allocates is close by
+
+		ThreadPoolTopology() = default;
+		explicit ThreadPoolTopology(size_t threads) : threads(threads) {}
+
+		// The CPUs each thread can run on, empty for any
+		std::vector<std::vector<int>> getPlacement(const std::vector<CPUCore>& cores) const;
+	};
+
+	// Set up by Game::setupExecutors(); videoAux and mainThread have no pools of their own
+	struct ExecutorsTopology
+	{
+		ThreadPoolTopology cpu;
+		ThreadPoolTopology cpuAux;
+		ThreadPoolTopology diskIO = ThreadPoolTopology(1);
 	};
 
 	class ThreadPool
@@ -81,11 +241,14 @@ namespace Halley
 		using MakeThread = std::function<std::thread(String, std::function<void()>)>;
 
 		ThreadPool(const String& name, ExecutionQueue& queue, size_t n, MakeThread makeThread);
+		ThreadPool(const String& name, ExecutionQueue& queue, const ThreadPoolTopology& topology, MakeThread makeThread); // Placed on OS::getCPUTopology()
 		~ThreadPool();
 
 	private:
 		String name;
 		std::vector<std::unique_ptr<Executor>> executors;
 		std::vector<std::thread> threads;
+
+		ThreadPool(const String& name, ExecutionQueue& queue, std::vector<std::vector<int>> placement, MakeThread makeThread);
 	};
 }
@@ -8,12 +8,23 @@
 #include <mutex>
 #include <condition_variable>
 #include <halley/support/exception.h>
+#include <halley/data_structures/memory_pool.h>
 
 namespace Halley
 {
 	template <typename T>
 	class Task;
 
+	template <typename T>
+	class Promise;
+
+	// Future states and payloads are allocated for every task, so keep them off the global heap
+	template <typename T, typename... Args>
+	std::shared_ptr<T> makePooledShared(Args&&... args)
+	{
+		return std::allocate_shared<T>(ThreadLocalPoolAllocator<T>(), std::forward<Args>(args)...);
+	}
+
 	struct VoidWrapper
 	{};
 
@@ -41,6 +52,12 @@ namespace Halley
 				promise.setValue(std::move(callable()));
 			}
 		}
+
+		template <typename P>
+		static void setValue(P& promise, DataType&& value)
+		{
+			promise.setValue(std::move(value));
+		}
 	};
 
 	template <>
@@ -68,6 +85,12 @@ namespace Halley
 				promise.set();
 			}
 		}
+
+		template <typename P>
+		static void setValue(P& promise, DataType&&)
+		{
+			promise.set();
+		}
 	};
 
 	template <typename T>
@@ -190,9 +213,14 @@ namespace Halley
 	template <typename T>
 	class Future
 	{
+		template <typename U>
+		friend class Future;
+
 		using DataType = typename TaskHelper<T>::DataType;
 
 	public:
+		using ValueType = T;
+
 		Future()
 		{}
 
@@ -248,6 +276,18 @@ namespace Halley
 		template <typename E, typename F>
 		auto then(E& e, F f)->Future<typename TaskHelper<T>::template FunctionHelper<F>::ReturnType>;
 
+		// For continuations that start more asynchronous work: f returns a Future, and what this returns resolves along with it,
+		// so multi-step flows (e.g. load, then decode, then upload) chain one after the other instead of nesting or blocking a worker.
+		// Each f runs on the queue it's given, e.g. Executors::getMainThread() for a step that needs to be there.
+		template <typename F>
+		auto thenAsync(F f) -> typename TaskHelper<T>::template FunctionHelper<F>::ReturnType
+		{
+			return thenAsync(ExecutionQueue::getDefault(), f);
+		}
+
+		template <typename E, typename F>
+		auto thenAsync(E& e, F f) -> typename TaskHelper<T>::template FunctionHelper<F>::ReturnType;
+
 		template <typename F>
 		auto thenNotify(F joinFuture) -> void
 		{
@@ -268,7 +308,7 @@ namespace Halley
 
 	public:
 		Promise()
-			: futureData(std::make_shared<FutureData<DataType>>())
+			: futureData(makePooledShared<FutureData<DataType>>())
 			, future(futureData)
 		{
 		}
@@ -298,7 +338,7 @@ namespace Halley
 	{
 	public:
 		Promise()
-			: futureData(std::make_shared<FutureData<VoidWrapper>>())
+			: futureData(makePooledShared<FutureData<VoidWrapper>>())
 			, future(futureData)
 		{
 		}
@@ -357,7 +397,7 @@ namespace Halley
 	{
 	public:
 		JoinFuture(int n)
-			: data(std::make_shared<JoinFutureData>(n))
+			: data(makePooledShared<JoinFutureData>(n))
 		{
 			if (n == 0) {
 				promise.set();
@@ -395,7 +435,7 @@ namespace Halley
 	{
 	public:
 		MovableStdFunction(std::function<T()> f)
-			: f(f)
+			: f(std::move(f))
 		{}
 
 		T operator()() override {
@@ -432,12 +472,12 @@ namespace Halley
 		{}
 
 		MovableFunction(std::function<T()> f)
-			: f(std::make_shared<MovableStdFunction<T>>(f))
+			: f(makePooledShared<MovableStdFunction<T>>(std::move(f)))
 		{}
 
 		template <typename F, typename U>
 		MovableFunction(F f, U&& v)
-			: f(std::make_shared<MovableBoundFunction<T, U>>(f, std::move(v)))
+			: f(makePooledShared<MovableBoundFunction<T, U>>(f, std::move(v)))
 		{}
 
 		T operator()() {
@@ -456,7 +496,7 @@ namespace Halley
 		{}
 
 		Task(std::function<T()> f)
-			: payload(MovableStdFunction<T>(f))
+			: payload(std::move(f))
 		{}
 
 		Task(MovableFunction<T> f)
@@ -505,4 +545,24 @@ namespace Halley
 		});
 		return task.getFuture();
 	}
+
+	template<typename T>
+	template<typename E, typename F>
+	inline auto Future<T>::thenAsync(E& e, F f) -> typename TaskHelper<T>::template FunctionHelper<F>::ReturnType
+	{
+		using R = typename TaskHelper<T>::template FunctionHelper<F>::ReturnType;
+		using U = typename R::ValueType;
+		std::reference_wrapper<E> executor(e);
+
+		Promise<U> promise;
+		data->addContinuation([promise, f, executor](typename TaskHelper<T>::DataType v) mutable {
+			executor.get().addToQueue([promise, f, v = std::move(v)]() mutable {
+				R next = TaskHelper<T>::template FunctionHelper<F>::call(f, std::move(v));
+				next.data->addContinuation([promise](typename TaskHelper<U>::DataType u) mutable {
+					TaskHelper<U>::setValue(promise, std::move(u));
+				});
+			});
+		});
+		return promise.getFuture();
+	}
 }
@@ -0,0 +1,81 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include "halley/utils/utils.h"
+
+namespace Halley
+{
+	// Bounded lock-free queue between exactly one producer thread and exactly one consumer thread, for handing work to
+	// threads that must never block, such as audio. Neither side takes a lock or allocates after construction:
+	// tryPush() fails if the queue is full (leaving the value untouched, so it can be retried later), and tryPop() if it's empty.
+	template <typename T>
+	class SPSCQueue
+	{
+	public:
+		explicit SPSCQueue(size_t minCapacity)
+			: slots(nextPowerOf2(std::max(minCapacity, size_t(2))))
+			, mask(slots.size() - 1)
+		{}
+
+		SPSCQueue(const SPSCQueue& other) = delete;
+		SPSCQueue& operator=(const SPSCQueue& other) = delete;
+
+		// Producer thread only
+		bool tryPush(T&& value)
+		{
+			const size_t t = tail.load(std::memory_order_relaxed);
+			if (t - cachedHead == slots.size()) {
+				cachedHead = head.load(std::memory_order_acquire);
+				if (t - cachedHead == slots.size()) {
+					return false;
+				}
+			}
+			slots[t & mask] = std::move(value);
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer thread only
+		bool tryPop(T& value)
+		{
+			const size_t h = head.load(std::memory_order_relaxed);
+			if (h == cachedTail) {
+				cachedTail = tail.load(std::memory_order_acquire);
+				if (h == cachedTail) {
+					return false;
+				}
+			}
+			value = std::move(slots[h & mask]);
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+
+		size_t capacity() const
+		{
+			return slots.size();
+		}
+
+		// Only a snapshot, as the other thread may be changing it
+		size_t size() const
+		{
+			return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+		}
+
+	private:
+		std::vector<T> slots;
+		const size_t mask;
+
+		// Each side's index gets its own cache line, next to its cached copy of the other side's. Padded rather than aligned,
+		// as over-aligned types aren't safe to allocate with new before C++17.
+		constexpr static size_t cacheLine = 64;
+		char padding0[cacheLine];
+		std::atomic<size_t> head { 0 };
+		size_t cachedTail = 0;
+		char padding1[cacheLine];
+		std::atomic<size_t> tail { 0 };
+		size_t cachedHead = 0;
+		char padding2[cacheLine];
+	};
+}
@@ -41,15 +41,17 @@ namespace Halley
 	class BinPackResult
 	{
 	public:
-		BinPackResult(Rect4i rect, bool rotated, void* data)
+		BinPackResult(Rect4i rect, bool rotated, void* data, int page = 0)
 			: rect(rect)
 			, rotated(rotated)
 			, data(data)
+			, page(page)
 		{}
 
 		Rect4i rect;
 		bool rotated;
 		void* data;
+		int page;
 	};
 
 	class BinPack
@@ -57,5 +59,9 @@ namespace Halley
 	public:
 		static boost::optional<Vector<BinPackResult>> pack(const std::vector<BinPackEntry>& entries, Vector2i binSize);
 		static boost::optional<Vector<BinPackResult>> fastPack(const std::vector<BinPackEntry>& entries, Vector2i binSize);
+
+		// MaxRects with best short side fit, which packs tighter than pack(). Whatever doesn't fit in the first bin goes
+		// into another of the same size, up to maxPages; each result says which page it ended up in.
+		static boost::optional<Vector<BinPackResult>> maxRectsPack(const std::vector<BinPackEntry>& entries, Vector2i binSize, int maxPages = 1);
 	};
 }
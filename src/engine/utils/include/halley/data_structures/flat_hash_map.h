@@ -0,0 +1,697 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "halley/support/exception.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386) || defined(__SSE2__)
+#define HALLEY_FLAT_HASH_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HALLEY_FLAT_HASH_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Halley {
+	namespace FlatHashDetail {
+		// One control byte per slot: the low 7 bits of the hash if it's full, or one of these
+		using Ctrl = int8_t;
+		constexpr Ctrl Empty = -128;
+		constexpr Ctrl Deleted = -2;
+		constexpr size_t GroupSize = 16;
+
+		inline uint32_t countTrailingZeros(uint64_t x)
+		{
+#if defined(_MSC_VER) && defined(_M_X64)
+			unsigned long result;
+			_BitScanForward64(&result, x);
+			return uint32_t(result);
+#elif defined(_MSC_VER)
+			unsigned long result;
+			if (_BitScanForward(&result, uint32_t(x))) {
+				return uint32_t(result);
+			}
+			_BitScanForward(&result, uint32_t(x >> 32));
+			return uint32_t(result) + 32;
+#else
+			return uint32_t(__builtin_ctzll(x));
+#endif
+		}
+
+		// Which slots of a group matched, as one bit (SSE2) or one nibble (NEON) per slot
+		class BitMask {
+		public:
+#if defined(HALLEY_FLAT_HASH_NEON)
+			constexpr static uint32_t shift = 2;
+#else
+			constexpr static uint32_t shift = 0;
+#endif
+			explicit BitMask(uint64_t mask) : mask(mask) {}
+
+			bool any() const { return mask != 0; }
+			uint32_t lowest() const { return countTrailingZeros(mask) >> shift; }
+			void removeLowest()
+			{
+				constexpr uint64_t slotBits = (uint64_t(1) << (uint64_t(1) << shift)) - 1;
+				mask &= ~(slotBits << (uint64_t(lowest()) << shift));
+			}
+
+		private:
+			uint64_t mask;
+		};
+
+		// GroupSize control bytes, compared all at once
+		class Group {
+		public:
+			explicit Group(const Ctrl* pos)
+			{
+#if defined(HALLEY_FLAT_HASH_SSE2)
+				ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+#elif defined(HALLEY_FLAT_HASH_NEON)
+				ctrl = vld1q_s8(pos);
+#else
+				memcpy(ctrl, pos, GroupSize);
+#endif
+			}
+
+			BitMask match(Ctrl h2) const
+			{
+#if defined(HALLEY_FLAT_HASH_SSE2)
+				return BitMask(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)))));
+#elif defined(HALLEY_FLAT_HASH_NEON)
+				return toMask(vceqq_s8(ctrl, vdupq_n_s8(h2)));
+#else
+				uint64_t result = 0;
+				for (size_t i = 0; i < GroupSize; ++i) {
+					result |= uint64_t(ctrl[i] == h2) << i;
+				}
+				return BitMask(result);
+#endif
+			}
+
+			BitMask matchEmpty() const
+			{
+				return match(Empty);
+			}
+
+			// Empty or deleted, i.e. anything that isn't full; those are the only negative values
+			BitMask matchFree() const
+			{
+#if defined(HALLEY_FLAT_HASH_SSE2)
+				return BitMask(uint32_t(_mm_movemask_epi8(ctrl)));
+#elif defined(HALLEY_FLAT_HASH_NEON)
+				return toMask(vcltq_s8(ctrl, vdupq_n_s8(0)));
+#else
+				uint64_t result = 0;
+				for (size_t i = 0; i < GroupSize; ++i) {
+					result |= uint64_t(ctrl[i] < 0) << i;
+				}
+				return BitMask(result);
+#endif
+			}
+
+		private:
+#if defined(HALLEY_FLAT_HASH_SSE2)
+			__m128i ctrl;
+#elif defined(HALLEY_FLAT_HASH_NEON)
+			int8x16_t ctrl;
+
+			static BitMask toMask(uint8x16_t matches)
+			{
+				// NEON has no movemask; narrowing each 16-bit lane by 4 leaves a nibble per byte
+				const uint8x8_t narrowed = vshrn_n_u16(vreinterpretq_u16_u8(matches), 4);
+				return BitMask(vget_lane_u64(vreinterpret_u64_u8(narrowed), 0));
+			}
+#else
+			Ctrl ctrl[GroupSize];
+#endif
+		};
+
+		// std::hash is the identity for integers, which would leave the top and bottom bits (what the table uses) poorly distributed
+		inline uint64_t mixHash(size_t hash)
+		{
+			uint64_t h = uint64_t(hash) * 0x9E3779B97F4A7C15ull;
+			return h ^ (h >> 32);
+		}
+
+		template <typename... Ts> struct MakeVoid { using type = void; };
+		template <typename T, typename = void> struct IsTransparent : std::false_type {};
+		template <typename T> struct IsTransparent<T, typename MakeVoid<typename T::is_transparent>::type> : std::true_type {};
+
+		struct MapKeyOf
+		{
+			template <typename K, typename V>
+			const K& operator()(const std::pair<const K, V>& v) const { return v.first; }
+		};
+
+		struct SetKeyOf
+		{
+			template <typename K>
+			const K& operator()(const K& v) const { return v; }
+		};
+	}
+
+	// Open addressing hash table, Swiss table style: one byte of metadata per slot, holding 7 bits of the hash, so a lookup checks a
+	// whole group of 16 slots with a couple of SIMD instructions and only compares keys whose bits match. Values are stored inline,
+	// so there's no allocation per element, and iterating goes through contiguous memory.
+	// Unlike the node-based HashMap, inserting can move every element, which invalidates all iterators, pointers and references
+	// to them; erasing only invalidates the erased one. Hash and KeyEqual with an is_transparent member enable lookups by anything
+	// they accept, e.g. StringViewHash and StringViewEqual to find String keys by StringView.
+	template <typename Value, typename Key, typename KeyOf, typename Hash, typename KeyEqual>
+	class FlatHashTable {
+	public:
+		using key_type = Key;
+		using value_type = Value;
+		using size_type = size_t;
+		using hasher = Hash;
+		using key_equal = KeyEqual;
+
+		template <bool IsConst>
+		class Iterator {
+			friend class FlatHashTable;
+
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = Value;
+			using difference_type = ptrdiff_t;
+			using pointer = typename std::conditional<IsConst, const Value*, Value*>::type;
+			using reference = typename std::conditional<IsConst, const Value&, Value&>::type;
+
+			Iterator() = default;
+			Iterator(const Iterator<false>& other) : ctrl(other.ctrl), slot(other.slot), ctrlEnd(other.ctrlEnd) {} // Non-const to const
+
+			reference operator*() const { return *slot; }
+			pointer operator->() const { return slot; }
+
+			Iterator& operator++()
+			{
+				++ctrl;
+				++slot;
+				skipFree();
+				return *this;
+			}
+
+			Iterator operator++(int)
+			{
+				auto result = *this;
+				++(*this);
+				return result;
+			}
+
+			bool operator==(const Iterator& other) const { return slot == other.slot; }
+			bool operator!=(const Iterator& other) const { return slot != other.slot; }
+
+		private:
+			friend class Iterator<!IsConst>;
+
+			const FlatHashDetail::Ctrl* ctrl = nullptr;
+			Value* slot = nullptr;
+			const FlatHashDetail::Ctrl* ctrlEnd = nullptr;
+
+			Iterator(const FlatHashDetail::Ctrl* ctrl, Value* slot, const FlatHashDetail::Ctrl* ctrlEnd)
+				: ctrl(ctrl), slot(slot), ctrlEnd(ctrlEnd)
+			{}
+
+			void skipFree()
+			{
+				while (ctrl != ctrlEnd && *ctrl < 0) {
+					++ctrl;
+					++slot;
+				}
+			}
+		};
+
+		using iterator = Iterator<false>;
+		using const_iterator = Iterator<true>;
+
+		FlatHashTable() = default;
+
+		FlatHashTable(const FlatHashTable& other)
+			: hashFunction(other.hashFunction)
+			, equalFunction(other.equalFunction)
+		{
+			reserve(other.size());
+			for (auto& v: other) {
+				insertUnique(v);
+			}
+		}
+
+		FlatHashTable(FlatHashTable&& other) noexcept
+		{
+			swap(other);
+		}
+
+		FlatHashTable(std::initializer_list<Value> values)
+		{
+			reserve(values.size());
+			for (auto& v: values) {
+				insert(v);
+			}
+		}
+
+		~FlatHashTable()
+		{
+			destroyAll();
+			deallocate();
+		}
+
+		FlatHashTable& operator=(const FlatHashTable& other)
+		{
+			if (this != &other) {
+				FlatHashTable tmp(other);
+				swap(tmp);
+			}
+			return *this;
+		}
+
+		FlatHashTable& operator=(FlatHashTable&& other) noexcept
+		{
+			if (this != &other) {
+				FlatHashTable tmp(std::move(other));
+				swap(tmp);
+			}
+			return *this;
+		}
+
+		void swap(FlatHashTable& other) noexcept
+		{
+			std::swap(ctrl, other.ctrl);
+			std::swap(slots, other.slots);
+			std::swap(capacity, other.capacity);
+			std::swap(nElements, other.nElements);
+			std::swap(growthLeft, other.growthLeft);
+			std::swap(hashFunction, other.hashFunction);
+			std::swap(equalFunction, other.equalFunction);
+		}
+
+		iterator begin() { return makeIterator(0, true); }
+		iterator end() { return makeIterator(capacity, false); }
+		const_iterator begin() const { return const_cast<FlatHashTable*>(this)->begin(); }
+		const_iterator end() const { return const_cast<FlatHashTable*>(this)->end(); }
+		const_iterator cbegin() const { return begin(); }
+		const_iterator cend() const { return end(); }
+
+		size_t size() const { return nElements; }
+		bool empty() const { return nElements == 0; }
+		size_t bucket_count() const { return capacity; }
+
+		// Keeps the memory, so refilling it to the same size doesn't allocate
+		void clear()
+		{
+			destroyAll();
+			if (capacity > 0) {
+				resetCtrl();
+			}
+			nElements = 0;
+			growthLeft = maxLoad(capacity);
+		}
+
+		void reserve(size_t n)
+		{
+			if (n > maxLoad(capacity)) {
+				rehash(capacityFor(n));
+			}
+		}
+
+		iterator find(const Key& key)
+		{
+			return findImpl(key);
+		}
+
+		const_iterator find(const Key& key) const
+		{
+			return const_cast<FlatHashTable*>(this)->findImpl(key);
+		}
+
+		template <typename K, typename H = Hash, typename std::enable_if<FlatHashDetail::IsTransparent<H>::value && FlatHashDetail::IsTransparent<KeyEqual>::value, int>::type = 0>
+		iterator find(const K& key)
+		{
+			return findImpl(key);
+		}
+
+		template <typename K, typename H = Hash, typename std::enable_if<FlatHashDetail::IsTransparent<H>::value && FlatHashDetail::IsTransparent<KeyEqual>::value, int>::type = 0>
+		const_iterator find(const K& key) const
+		{
+			return const_cast<FlatHashTable*>(this)->findImpl(key);
+		}
+
+		size_t count(const Key& key) const
+		{
+			return find(key) != end() ? 1 : 0;
+		}
+
+		bool contains(const Key& key) const
+		{
+			return find(key) != end();
+		}
+
+		std::pair<iterator, bool> insert(const Value& value)
+		{
+			return emplaceKey(KeyOf()(value), value);
+		}
+
+		std::pair<iterator, bool> insert(Value&& value)
+		{
+			const Key& key = KeyOf()(value);
+			return emplaceKey(key, std::move(value));
+		}
+
+		template <typename... Args>
+		std::pair<iterator, bool> emplace(Args&&... args)
+		{
+			// The key has to be known before finding where it goes, so this is a temporary that's moved in
+			Value value(std::forward<Args>(args)...);
+			const Key& key = KeyOf()(value);
+			return emplaceKey(key, std::move(value));
+		}
+
+		// Returns the iterator following the erased element
+		iterator erase(const_iterator pos)
+		{
+			const size_t idx = size_t(pos.slot - slots);
+			eraseAt(idx);
+			auto result = makeIterator(idx, false);
+			result.skipFree();
+			return result;
+		}
+
+		iterator erase(iterator pos)
+		{
+			return erase(const_iterator(pos));
+		}
+
+		size_t erase(const Key& key)
+		{
+			auto iter = find(key);
+			if (iter == end()) {
+				return 0;
+			}
+			eraseAt(size_t(iter.slot - slots));
+			return 1;
+		}
+
+	protected:
+		template <typename K, typename... Args>
+		std::pair<iterator, bool> emplaceKey(const K& key, Args&&... args)
+		{
+			const uint64_t hash = hashKey(key);
+			const size_t existing = findIndex(key, hash);
+			if (existing != npos) {
+				return std::make_pair(makeIterator(existing, false), false);
+			}
+
+			// A rehash would move the arguments' source element if it's in this table, so build the value first
+			if (growthLeft == 0) {
+				Value value(std::forward<Args>(args)...);
+				growIfNeeded();
+				const size_t idx = prepareInsert(hash);
+				new (slots + idx) Value(std::move(value));
+				return std::make_pair(makeIterator(idx, false), true);
+			}
+
+			const size_t idx = prepareInsert(hash);
+			new (slots + idx) Value(std::forward<Args>(args)...);
+			return std::make_pair(makeIterator(idx, false), true);
+		}
+
+	private:
+		constexpr static size_t npos = size_t(-1);
+		using Ctrl = FlatHashDetail::Ctrl;
+		using Group = FlatHashDetail::Group;
+		constexpr static size_t GroupSize = FlatHashDetail::GroupSize;
+
+		// ctrl has GroupSize extra bytes at the end, mirroring the first ones, so a group can be loaded from any slot without wrapping
+		Ctrl* ctrl = nullptr;
+		Value* slots = nullptr;
+		size_t capacity = 0; // Power of two, and at least GroupSize, or 0
+		size_t nElements = 0;
+		size_t growthLeft = 0; // Inserts into empty slots before it needs a rehash; deleted ones don't count as free
+		Hash hashFunction;
+		KeyEqual equalFunction;
+
+		static size_t maxLoad(size_t cap)
+		{
+			return cap - cap / 8;
+		}
+
+		static size_t capacityFor(size_t n)
+		{
+			size_t cap = GroupSize;
+			while (maxLoad(cap) < n) {
+				cap *= 2;
+			}
+			return cap;
+		}
+
+		template <typename K>
+		uint64_t hashKey(const K& key) const
+		{
+			return FlatHashDetail::mixHash(hashFunction(key));
+		}
+
+		static Ctrl h2(uint64_t hash)
+		{
+			return Ctrl(hash & 0x7F);
+		}
+
+		iterator makeIterator(size_t idx, bool skip)
+		{
+			iterator result(ctrl + idx, slots + idx, ctrl + capacity);
+			if (skip) {
+				result.skipFree();
+			}
+			return result;
+		}
+
+		template <typename K>
+		iterator findImpl(const K& key)
+		{
+			const size_t idx = findIndex(key, hashKey(key));
+			return idx == npos ? end() : makeIterator(idx, false);
+		}
+
+		template <typename K>
+		size_t findIndex(const K& key, uint64_t hash) const
+		{
+			if (capacity == 0) {
+				return npos;
+			}
+
+			const size_t mask = capacity - 1;
+			const Ctrl tag = h2(hash);
+			size_t pos = size_t(hash >> 7) & mask;
+			size_t step = 0;
+			while (true) {
+				const Group group(ctrl + pos);
+				for (auto m = group.match(tag); m.any(); m.removeLowest()) {
+					const size_t idx = (pos + m.lowest()) & mask;
+					if (equalFunction(KeyOf()(slots[idx]), key)) {
+						return idx;
+					}
+				}
+				if (group.matchEmpty().any()) {
+					// Probing stops at the first group with an empty slot, as an insert would have used it
+					return npos;
+				}
+				step += GroupSize;
+				pos = (pos + step) & mask;
+			}
+		}
+
+		// Claims the first free slot along the hash's probe sequence; there must be room
+		size_t prepareInsert(uint64_t hash)
+		{
+			const size_t mask = capacity - 1;
+			size_t pos = size_t(hash >> 7) & mask;
+			size_t step = 0;
+			while (true) {
+				const Group group(ctrl + pos);
+				auto m = group.matchFree();
+				if (m.any()) {
+					const size_t idx = (pos + m.lowest()) & mask;
+					if (ctrl[idx] == FlatHashDetail::Empty) {
+						--growthLeft;
+					}
+					setCtrl(idx, h2(hash));
+					++nElements;
+					return idx;
+				}
+				step += GroupSize;
+				pos = (pos + step) & mask;
+			}
+		}
+
+		void setCtrl(size_t idx, Ctrl value)
+		{
+			ctrl[idx] = value;
+			if (idx < GroupSize) {
+				ctrl[capacity + idx] = value;
+			}
+		}
+
+		void eraseAt(size_t idx)
+		{
+			slots[idx].~Value();
+			--nElements;
+
+			// If no run of GroupSize occupied slots goes through this one, no probe can have gone past it, so it can go back to being empty
+			const size_t mask = capacity - 1;
+			size_t after = 0;
+			while (after < GroupSize && ctrl[(idx + after) & mask] != FlatHashDetail::Empty) {
+				++after;
+			}
+			size_t before = 0;
+			while (before < GroupSize && ctrl[(idx - 1 - before) & mask] != FlatHashDetail::Empty) {
+				++before;
+			}
+			if (before + after < GroupSize) {
+				setCtrl(idx, FlatHashDetail::Empty);
+				++growthLeft;
+			} else {
+				setCtrl(idx, FlatHashDetail::Deleted);
+			}
+		}
+
+		void growIfNeeded()
+		{
+			// Plenty of tombstones means it's enough to clean them up, without growing
+			if (capacity > 0 && nElements <= maxLoad(capacity) / 2) {
+				rehash(capacity);
+			} else {
+				rehash(capacity == 0 ? GroupSize : capacity * 2);
+			}
+		}
+
+		void rehash(size_t newCapacity)
+		{
+			Ctrl* oldCtrl = ctrl;
+			Value* oldSlots = slots;
+			const size_t oldCapacity = capacity;
+
+			capacity = newCapacity;
+			ctrl = new Ctrl[capacity + GroupSize];
+			slots = std::allocator<Value>().allocate(capacity);
+			resetCtrl();
+			nElements = 0;
+			growthLeft = maxLoad(capacity);
+
+			for (size_t i = 0; i < oldCapacity; ++i) {
+				if (oldCtrl[i] >= 0) {
+					const size_t idx = prepareInsert(hashKey(KeyOf()(oldSlots[i])));
+					new (slots + idx) Value(std::move(oldSlots[i]));
+					oldSlots[i].~Value();
+				}
+			}
+
+			if (oldCtrl) {
+				delete[] oldCtrl;
+				std::allocator<Value>().deallocate(oldSlots, oldCapacity);
+			}
+		}
+
+		void resetCtrl()
+		{
+			memset(ctrl, uint8_t(FlatHashDetail::Empty), capacity + GroupSize);
+		}
+
+		void destroyAll()
+		{
+			if (!std::is_trivially_destructible<Value>::value) {
+				for (size_t i = 0; i < capacity; ++i) {
+					if (ctrl[i] >= 0) {
+						slots[i].~Value();
+					}
+				}
+			}
+		}
+
+		void deallocate()
+		{
+			if (ctrl) {
+				delete[] ctrl;
+				std::allocator<Value>().deallocate(slots, capacity);
+				ctrl = nullptr;
+				slots = nullptr;
+				capacity = 0;
+			}
+		}
+
+		void insertUnique(const Value& value)
+		{
+			const size_t idx = prepareInsert(hashKey(KeyOf()(value)));
+			new (slots + idx) Value(value);
+		}
+	};
+
+	template <typename Key, typename T, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+	class FlatHashMap : public FlatHashTable<std::pair<const Key, T>, Key, FlatHashDetail::MapKeyOf, Hash, KeyEqual> {
+		using Base = FlatHashTable<std::pair<const Key, T>, Key, FlatHashDetail::MapKeyOf, Hash, KeyEqual>;
+
+	public:
+		using mapped_type = T;
+		using Base::Base;
+
+		FlatHashMap() = default;
+
+		// Unlike emplace(), only constructs the value if the key isn't there
+		template <typename... Args>
+		std::pair<typename Base::iterator, bool> try_emplace(const Key& key, Args&&... args)
+		{
+			return this->emplaceKey(key, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+		}
+
+		template <typename... Args>
+		std::pair<typename Base::iterator, bool> try_emplace(Key&& key, Args&&... args)
+		{
+			// The key is only moved from once it's known not to be there
+			return this->emplaceKey(key, std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<Args>(args)...));
+		}
+
+		T& operator[](const Key& key)
+		{
+			return try_emplace(key).first->second;
+		}
+
+		T& operator[](Key&& key)
+		{
+			return try_emplace(std::move(key)).first->second;
+		}
+
+		T& at(const Key& key)
+		{
+			auto iter = this->find(key);
+			if (iter == this->end()) {
+				throw Exception("Key not found in FlatHashMap", HalleyExceptions::Utils);
+			}
+			return iter->second;
+		}
+
+		const T& at(const Key& key) const
+		{
+			auto iter = this->find(key);
+			if (iter == this->end()) {
+				throw Exception("Key not found in FlatHashMap", HalleyExceptions::Utils);
+			}
+			return iter->second;
+		}
+	};
+
+	template <typename Key, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+	class FlatHashSet : public FlatHashTable<Key, Key, FlatHashDetail::SetKeyOf, Hash, KeyEqual> {
+		using Base = FlatHashTable<Key, Key, FlatHashDetail::SetKeyOf, Hash, KeyEqual>;
+
+	public:
+		using Base::Base;
+
+		FlatHashSet() = default;
+	};
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+
+#if HAS_EASTL
+#include <EASTL/vector.h>
+#endif
+
+namespace Halley {
+	// Bump allocator for scratch memory that only lives for the current frame. Each thread has its own, so it needs no locking.
+	// Everything allocated from it is released at once when the frame ends (World::step calls endFrame()), so never hold on to
+	// anything allocated from it past that. Each arena resets itself on its thread's first allocation of the new frame.
+	class FrameArena
+	{
+	public:
+		~FrameArena();
+
+		static FrameArena& get(); // This thread's
+		static void endFrame();
+
+		void* allocate(size_t size, size_t alignment);
+		void deallocate(void* p, size_t size); // Only reclaims anything if it was the last allocation, e.g. a vector growing
+
+		size_t getCapacity() const;
+
+	private:
+		struct Block
+		{
+			char* data;
+			size_t size;
+		};
+
+		static std::atomic<uint64_t> currentFrame;
+		constexpr static size_t minBlockSize = 64 * 1024;
+
+		std::vector<Block> blocks;
+		char* top = nullptr;
+		char* end = nullptr;
+		size_t usedInPreviousBlocks = 0;
+		uint64_t frame = 0;
+
+		void reset();
+		void addBlock(size_t minSize);
+	};
+
+	// Standard allocator backed by FrameArena, e.g. std::vector<T, FrameAllocator<T>> (see FrameVector)
+	template <typename T>
+	struct FrameAllocator
+	{
+		using value_type = T;
+
+		FrameAllocator() = default;
+
+		template <typename U>
+		FrameAllocator(const FrameAllocator<U>&) {}
+
+		T* allocate(size_t n)
+		{
+			return static_cast<T*>(FrameArena::get().allocate(n * sizeof(T), alignof(T)));
+		}
+
+		void deallocate(T* p, size_t n)
+		{
+			FrameArena::get().deallocate(p, n * sizeof(T));
+		}
+
+		template <typename U>
+		bool operator==(const FrameAllocator<U>&) const { return true; }
+
+		template <typename U>
+		bool operator!=(const FrameAllocator<U>&) const { return false; }
+	};
+
+#if HAS_EASTL
+	class EASTLFrameAllocator
+	{
+	public:
+		EASTLFrameAllocator(const char* = nullptr) {}
+
+		void* allocate(size_t n, int = 0) { return FrameArena::get().allocate(n, alignof(std::max_align_t)); }
+		void* allocate(size_t n, size_t alignment, size_t, int = 0) { return FrameArena::get().allocate(n, alignment); }
+		void deallocate(void* p, size_t n) { FrameArena::get().deallocate(p, n); }
+
+		const char* get_name() const { return "FrameArena"; }
+		void set_name(const char*) {}
+
+		bool operator==(const EASTLFrameAllocator&) const { return true; }
+		bool operator!=(const EASTLFrameAllocator&) const { return false; }
+	};
+
+	template<typename T> using FrameVector = eastl::vector<T, EASTLFrameAllocator>;
+#else
+	template<typename T> using FrameVector = std::vector<T, FrameAllocator<T>>;
+#endif
+}
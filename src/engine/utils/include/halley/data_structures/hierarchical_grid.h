@@ -0,0 +1,394 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <gsl/gsl>
+#include "vector.h"
+#include "hash_map.h"
+#include "halley/maths/rect.h"
+#include "halley/maths/polygon.h"
+#include "halley/utils/utils.h"
+
+namespace Halley {
+	// Loose hierarchical grid over float bounds, unbounded in every direction.
+	// Each value goes in the first level with cells at least as large as it, in the cell that holds its centre,
+	// so moving it only touches the grid when its centre changes cells.
+	// Queries are const, and can run concurrently as long as nothing modifies the grid meanwhile.
+	template <typename T>
+	class HierarchicalGrid {
+	public:
+		using Handle = uint32_t;
+
+		explicit HierarchicalGrid(float minCellSize = 32.0f, size_t nLevels = 12)
+		{
+			Expects(minCellSize > 0);
+			Expects(nLevels > 0 && nLevels < 32);
+
+			levels.resize(nLevels);
+			for (size_t i = 0; i < nLevels; ++i) {
+				levels[i].cellSize = minCellSize * float(1u << i);
+			}
+		}
+
+		Handle add(Rect4f bounds, T value)
+		{
+			Handle handle;
+			if (firstFree != invalidHandle) {
+				handle = firstFree;
+				firstFree = nodes[handle].nextFree;
+			} else {
+				handle = Handle(nodes.size());
+				nodes.emplace_back();
+			}
+
+			auto& node = nodes[handle];
+			node.value = std::move(value);
+			node.bounds = bounds;
+			node.used = true;
+			insert(handle);
+			++count;
+			return handle;
+		}
+
+		void update(Handle handle, Rect4f bounds)
+		{
+			auto& node = nodes.at(handle);
+			Expects(node.used);
+
+			const size_t level = getLevel(bounds);
+			if (level == node.level && getCellKey(bounds, level) == node.cell) {
+				node.bounds = bounds;
+				growMargin(level, bounds);
+			} else {
+				erase(handle);
+				node.bounds = bounds;
+				insert(handle);
+			}
+		}
+
+		void remove(Handle handle)
+		{
+			auto& node = nodes.at(handle);
+			Expects(node.used);
+
+			erase(handle);
+			node.used = false;
+			node.value = T();
+			node.nextFree = firstFree;
+			firstFree = handle;
+			--count;
+		}
+
+		void clear()
+		{
+			nodes.clear();
+			for (auto& level: levels) {
+				level.cells.clear();
+				level.margin = 0;
+			}
+			firstFree = invalidHandle;
+			count = 0;
+		}
+
+		size_t size() const
+		{
+			return count;
+		}
+
+		const T& get(Handle handle) const
+		{
+			return nodes.at(handle).value;
+		}
+
+		Rect4f getBounds(Handle handle) const
+		{
+			return nodes.at(handle).bounds;
+		}
+
+		// Calls f(value, bounds) for everything overlapping rect, touching edges included
+		template <typename F>
+		void forEachInRect(Rect4f rect, F f) const
+		{
+			for (auto& level: levels) {
+				if (level.cells.empty()) {
+					continue;
+				}
+
+				// Loose cells: anything overlapping the rect has its centre no further than the margin out of it
+				const auto area = rect.grow(level.margin);
+				const int x0 = getCellCoord(area.getLeft(), level.cellSize);
+				const int x1 = getCellCoord(area.getRight(), level.cellSize);
+				const int y0 = getCellCoord(area.getTop(), level.cellSize);
+				const int y1 = getCellCoord(area.getBottom(), level.cellSize);
+
+				auto visitCell = [&] (const Vector<Handle>& cell)
+				{
+					for (auto handle: cell) {
+						auto& node = nodes[handle];
+						if (overlaps(node.bounds, rect)) {
+							f(node.value, node.bounds);
+						}
+					}
+				};
+
+				const int64_t nCells = (int64_t(x1) - x0 + 1) * (int64_t(y1) - y0 + 1);
+				if (nCells > int64_t(level.cells.size())) {
+					// Huge query compared to how many cells are in use
+					for (auto& cell: level.cells) {
+						const int x = getCellX(cell.first);
+						const int y = getCellY(cell.first);
+						if (x >= x0 && x <= x1 && y >= y0 && y <= y1) {
+							visitCell(cell.second);
+						}
+					}
+				} else {
+					for (int y = y0; y <= y1; ++y) {
+						for (int x = x0; x <= x1; ++x) {
+							auto iter = level.cells.find(makeCellKey(x, y));
+							if (iter != level.cells.end()) {
+								visitCell(iter->second);
+							}
+						}
+					}
+				}
+			}
+		}
+
+		void query(Rect4f rect, Vector<T>& results) const
+		{
+			forEachInRect(rect, [&] (const T& value, const Rect4f&)
+			{
+				results.push_back(value);
+			});
+		}
+
+		void queryRadius(Vector2f centre, float radius, Vector<T>& results) const
+		{
+			const float radius2 = radius * radius;
+			const auto extent = Vector2f(radius, radius);
+			forEachInRect(Rect4f(centre - extent, centre + extent), [&] (const T& value, const Rect4f& bounds)
+			{
+				const auto closest = Vector2f(clamp(centre.x, bounds.getLeft(), bounds.getRight()), clamp(centre.y, bounds.getTop(), bounds.getBottom()));
+				if ((closest - centre).squaredLength() <= radius2) {
+					results.push_back(value);
+				}
+			});
+		}
+
+		// Results are sorted by how far along the ray it first touches each of them
+		void queryRay(Vector2f origin, Vector2f dir, float maxDistance, Vector<std::pair<float, T>>& results) const
+		{
+			Expects(dir.squaredLength() > 0);
+			const auto unitDir = dir.normalized();
+			const size_t start = results.size();
+			forEachInRect(Rect4f(origin, origin + unitDir * maxDistance), [&] (const T& value, const Rect4f& bounds)
+			{
+				float distance;
+				if (intersectRay(origin, unitDir, maxDistance, bounds, distance)) {
+					results.emplace_back(distance, value);
+				}
+			});
+			std::sort(results.begin() + start, results.end(), [] (const std::pair<float, T>& a, const std::pair<float, T>& b) { return a.first < b.first; });
+		}
+
+		// The polygon must be convex, e.g. a camera's view
+		void queryPolygon(const Polygon& polygon, Vector<T>& results) const
+		{
+			auto& vertices = polygon.getVertices();
+			if (vertices.empty()) {
+				return;
+			}
+
+			const auto origin = polygon.getOrigin();
+			Vector2f p1 = origin + vertices[0];
+			Vector2f p2 = p1;
+			for (auto& v: vertices) {
+				const auto p = origin + v;
+				p1 = Vector2f(std::min(p1.x, p.x), std::min(p1.y, p.y));
+				p2 = Vector2f(std::max(p2.x, p.x), std::max(p2.y, p.y));
+			}
+
+			forEachInRect(Rect4f(p1, p2), [&] (const T& value, const Rect4f& bounds)
+			{
+				if (overlapsPolygon(polygon, bounds)) {
+					results.push_back(value);
+				}
+			});
+		}
+
+	private:
+		constexpr static Handle invalidHandle = std::numeric_limits<Handle>::max();
+
+		struct Node {
+			Rect4f bounds;
+			T value = T();
+			int64_t cell = 0;
+			uint32_t level = 0;
+			uint32_t indexInCell = 0;
+			Handle nextFree = invalidHandle;
+			bool used = false;
+		};
+
+		struct Level {
+			float cellSize = 1;
+			float margin = 0; // Largest half-size of anything that was ever in this level, since the last clear
+			HashMap<int64_t, Vector<Handle>> cells;
+		};
+
+		Vector<Node> nodes;
+		Vector<Level> levels;
+		Handle firstFree = invalidHandle;
+		size_t count = 0;
+
+		size_t getLevel(Rect4f bounds) const
+		{
+			const float size = std::max(bounds.getWidth(), bounds.getHeight());
+			for (size_t i = 0; i < levels.size(); ++i) {
+				if (size <= levels[i].cellSize) {
+					return i;
+				}
+			}
+			return levels.size() - 1;
+		}
+
+		int64_t getCellKey(Rect4f bounds, size_t level) const
+		{
+			const auto centre = bounds.getCenter();
+			const float cellSize = levels[level].cellSize;
+			return makeCellKey(getCellCoord(centre.x, cellSize), getCellCoord(centre.y, cellSize));
+		}
+
+		void growMargin(size_t level, Rect4f bounds)
+		{
+			auto& margin = levels[level].margin;
+			margin = std::max(margin, 0.5f * std::max(bounds.getWidth(), bounds.getHeight()));
+		}
+
+		void insert(Handle handle)
+		{
+			auto& node = nodes[handle];
+			const size_t level = getLevel(node.bounds);
+			node.level = uint32_t(level);
+			node.cell = getCellKey(node.bounds, level);
+			growMargin(level, node.bounds);
+
+			auto& cell = levels[level].cells[node.cell];
+			node.indexInCell = uint32_t(cell.size());
+			cell.push_back(handle);
+		}
+
+		void erase(Handle handle)
+		{
+			auto& node = nodes[handle];
+			auto& cells = levels[node.level].cells;
+			auto iter = cells.find(node.cell);
+			Expects(iter != cells.end());
+
+			// Swap with the last one in the cell
+			auto& cell = iter->second;
+			const Handle last = cell.back();
+			cell[node.indexInCell] = last;
+			nodes[last].indexInCell = node.indexInCell;
+			cell.pop_back();
+			if (cell.empty()) {
+				cells.erase(iter);
+			}
+		}
+
+		static int getCellCoord(float value, float cellSize)
+		{
+			const float cell = std::floor(value / cellSize);
+			return int(clamp(cell, -2147483520.0f, 2147483520.0f));
+		}
+
+		static int64_t makeCellKey(int x, int y)
+		{
+			return int64_t(uint64_t(uint32_t(x)) << 32 | uint64_t(uint32_t(y)));
+		}
+
+		static int getCellX(int64_t key)
+		{
+			return int(int32_t(uint32_t(uint64_t(key) >> 32)));
+		}
+
+		static int getCellY(int64_t key)
+		{
+			return int(int32_t(uint32_t(uint64_t(key) & 0xFFFFFFFFull)));
+		}
+
+		static bool overlaps(const Rect4f& a, const Rect4f& b)
+		{
+			return a.getLeft() <= b.getRight() && b.getLeft() <= a.getRight() && a.getTop() <= b.getBottom() && b.getTop() <= a.getBottom();
+		}
+
+		static bool intersectRay(Vector2f origin, Vector2f dir, float maxDistance, const Rect4f& bounds, float& distance)
+		{
+			// Slab test
+			float tMin = 0;
+			float tMax = maxDistance;
+			for (int axis = 0; axis < 2; ++axis) {
+				const float o = axis == 0 ? origin.x : origin.y;
+				const float d = axis == 0 ? dir.x : dir.y;
+				const float lo = axis == 0 ? bounds.getLeft() : bounds.getTop();
+				const float hi = axis == 0 ? bounds.getRight() : bounds.getBottom();
+				if (std::abs(d) < 1e-12f) {
+					if (o < lo || o > hi) {
+						return false;
+					}
+				} else {
+					float t0 = (lo - o) / d;
+					float t1 = (hi - o) / d;
+					if (t0 > t1) {
+						std::swap(t0, t1);
+					}
+					tMin = std::max(tMin, t0);
+					tMax = std::min(tMax, t1);
+					if (tMin > tMax) {
+						return false;
+					}
+				}
+			}
+			distance = tMin;
+			return true;
+		}
+
+		static bool overlapsPolygon(const Polygon& polygon, const Rect4f& bounds)
+		{
+			// Separating axis test, the rect's own axes were already covered by the bounding box
+			auto& vertices = polygon.getVertices();
+			const auto origin = polygon.getOrigin();
+			const std::array<Vector2f, 4> corners = { bounds.getTopLeft(), bounds.getTopRight(), bounds.getBottomRight(), bounds.getBottomLeft() };
+
+			const size_t n = vertices.size();
+			for (size_t i = 0; i < n; ++i) {
+				const auto edge = vertices[(i + 1) % n] - vertices[i];
+				const auto axis = Vector2f(-edge.y, edge.x);
+
+				float polyMin = std::numeric_limits<float>::max();
+				float polyMax = std::numeric_limits<float>::lowest();
+				for (auto& v: vertices) {
+					const float p = (origin + v).dot(axis);
+					polyMin = std::min(polyMin, p);
+					polyMax = std::max(polyMax, p);
+				}
+
+				float rectMin = std::numeric_limits<float>::max();
+				float rectMax = std::numeric_limits<float>::lowest();
+				for (auto& c: corners) {
+					const float p = c.dot(axis);
+					rectMin = std::min(rectMin, p);
+					rectMax = std::max(rectMax, p);
+				}
+
+				if (rectMax < polyMin || polyMax < rectMin) {
+					return false;
+				}
+			}
+			return true;
+		}
+	};
+}
@@ -22,6 +22,8 @@
 \*****************************************************************/
 
 #include <cstdint>
+#include <array>
+#include <type_traits>
 
 namespace Halley {
 	template <typename T, size_t blockLen = 16384>
@@ -111,6 +113,46 @@ namespace Halley {
 			return reinterpret_cast<T*>(&(data.data));
 		}
 
+		// Free list and revisions, but not the values. Restoring it means ids will be handed out exactly as they would have been.
+		template <typename S>
+		void serializeAllocationState(S& s) const
+		{
+			s << next << uint32_t(blocks.size());
+			for (auto& block: blocks) {
+				for (auto& entry: block.data) {
+					s << entry.nextFreeEntryIndex << entry.revision;
+				}
+			}
+		}
+
+		// Values are all cleared, as stale ids could otherwise resolve to them. It's up to the caller to put back the ones still in use.
+		template <typename D>
+		void deserializeAllocationState(D& s)
+		{
+			static_assert(std::is_trivial<T>::value, "Only pools of trivial values can have their state restored");
+
+			uint32_t nBlocks;
+			s >> next >> nBlocks;
+
+			while (blocks.size() < nBlocks) {
+				blocks.push_back(Block(blocks.size()));
+			}
+			for (size_t i = 0; i < blocks.size(); i++) {
+				auto& block = blocks[i];
+				for (size_t j = 0; j < blockLen; j++) {
+					auto& entry = block.data[j];
+					entry.data.fill(0);
+					if (i < nBlocks) {
+						s >> entry.nextFreeEntryIndex >> entry.revision;
+					} else {
+						// Blocks past the saved ones go back to how they were first built, the saved free list ends up pointing into them
+						entry.nextFreeEntryIndex = static_cast<uint32_t>(j + 1 + i * blockLen);
+						entry.revision = 0;
+					}
+				}
+			}
+		}
+
 	private:
 		Vector<Block> blocks;
 		uint32_t next = 0;
@@ -1,18 +1,41 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <new>
+#include <mutex>
+#include <typeinfo>
+#include <vector>
 #include "flat_map.h"
+#include "halley/support/memory_tracker.h"
 
 namespace Halley {
+	// Fixed-size blocks, safe to allocate and free from any thread. Each thread keeps a small cache of free blocks,
+	// topped up from and spilled back to a central depot a batch at a time, so the lock is only taken once per batch.
+	// Blocks freed on another thread than the one that allocated them end up in that thread's cache.
 	class SizePool
 	{
 	public:
-		explicit SizePool(size_t size);
+		struct Stats
+		{
+			const char* name; // Type name for per-type pools, nullptr for those shared by size
+			size_t blockSize;
+			size_t capacity; // Blocks ever obtained from the system
+			size_t inUse;
+			size_t freeInDepot;
+			size_t freeInThreadCaches;
+		};
+
+		explicit SizePool(size_t size, const char* name = nullptr, MemoryTag tag = MemoryTags::Pools); // Blocks obtained from the system are reported to tag
 		~SizePool();
 
 		size_t getSize() const { return size; }
 		void* alloc();
 		void free(void* p);
 
+		Stats getStats() const;
+		static std::vector<Stats> getAllStats(); // Every pool currently alive
+
 	private:
 		void* pimpl;
 		size_t size;
@@ -27,36 +50,127 @@ namespace Halley {
 	private:
 		static PoolPool& get();
 
+		std::mutex mutex;
 		FlatMap<size_t, SizePool*> pools;
 	};
 
+	// A pool of its own per type, e.g. so components of one type are close together in memory
 	template <typename T>
 	struct PoolAllocator
 	{
 	public:
 		static void* alloc()
 		{
-			return get().pool->alloc();
+			return getPool().alloc();
+		}
+
+		static void free(void* p)
+		{
+			getPool().free(p);
+		}
+
+		static SizePool& getPool()
+		{
+			static SizePool pool(sizeof(T), typeid(T).name());
+			return pool;
+		}
+	};
+
+	// A free list of fixed-size blocks, one per thread, so it needs no locking.
+	// Blocks can be freed on a different thread than the one that allocated them; they simply
+	// end up cached there, up to maxCached, after which they go back to the heap.
+	template <size_t Size>
+	class ThreadLocalFreeList
+	{
+	public:
+		static void* alloc()
+		{
+			auto& list = get();
+			if (list.head) {
+				Node* node = list.head;
+				list.head = node->next;
+				--list.count;
+				return node;
+			}
+			return ::operator new(std::max(Size, sizeof(Node)));
 		}
 
 		static void free(void* p)
 		{
-			get().pool->free(p);
+			auto& list = get();
+			if (list.count < maxCached) {
+				Node* node = static_cast<Node*>(p);
+				node->next = list.head;
+				list.head = node;
+				++list.count;
+			} else {
+				::operator delete(p);
+			}
 		}
 
 	private:
-		PoolAllocator()
+		constexpr static size_t maxCached = 256;
+
+		struct Node
+		{
+			Node* next;
+		};
+
+		struct List
+		{
+			Node* head = nullptr;
+			size_t count = 0;
+
+			~List()
+			{
+				while (head) {
+					Node* next = head->next;
+					::operator delete(head);
+					head = next;
+				}
+			}
+		};
+
+		static List& get()
+		{
+			thread_local List list;
+			return list;
+		}
+	};
+
+	// Standard allocator backed by ThreadLocalFreeList, for use with std::allocate_shared and friends
+	template <typename T>
+	struct ThreadLocalPoolAllocator
+	{
+		using value_type = T;
+
+		ThreadLocalPoolAllocator() = default;
+
+		template <typename U>
+		ThreadLocalPoolAllocator(const ThreadLocalPoolAllocator<U>&) {}
+
+		T* allocate(size_t n)
 		{
-			pool = new SizePool(sizeof(T));
+			if (n == 1) {
+				return static_cast<T*>(ThreadLocalFreeList<sizeof(T)>::alloc());
+			}
+			return static_cast<T*>(::operator new(n * sizeof(T)));
 		}
 
-		static PoolAllocator& get()
+		void deallocate(T* p, size_t n)
 		{
-			static PoolAllocator instance;
-			return instance;
+			if (n == 1) {
+				ThreadLocalFreeList<sizeof(T)>::free(p);
+			} else {
+				::operator delete(p);
+			}
 		}
 
-		SizePool* pool;
+		template <typename U>
+		bool operator==(const ThreadLocalPoolAllocator<U>&) const { return true; }
+
+		template <typename U>
+		bool operator!=(const ThreadLocalPoolAllocator<U>&) const { return false; }
 	};
 	
 }
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include "vector.h"
+
+namespace Halley {
+	// Generational index map. Ids are handed out like MappedPool's (index in the low 32 bits, generation above it), but
+	// generations and dense indices live in their own arrays, and the values are packed together so they can be iterated
+	// contiguously. Removing swaps with the last value, so pointers returned by get() only last until the next insert or erase.
+	template <typename T>
+	class SlotMap {
+	public:
+		int64_t insert(T value)
+		{
+			uint32_t slot;
+			if (freeSlots.empty()) {
+				slot = uint32_t(generations.size());
+				generations.push_back(baseGeneration);
+				denseIndex.push_back(uint32_t(invalidIndex));
+			} else {
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+			}
+
+			denseIndex[slot] = uint32_t(values.size());
+			values.push_back(std::move(value));
+			slots.push_back(slot);
+			return makeId(slot, generations[slot]);
+		}
+
+		bool erase(int64_t id)
+		{
+			const auto slot = getSlot(id);
+			if (slot == invalidIndex) {
+				return false;
+			}
+
+			const auto idx = denseIndex[slot];
+			const auto last = uint32_t(values.size() - 1);
+			if (idx != last) {
+				values[idx] = std::move(values[last]);
+				slots[idx] = slots[last];
+				denseIndex[slots[idx]] = idx;
+			}
+			values.pop_back();
+			slots.pop_back();
+
+			// Bumping the generation makes any copies of the id stale
+			denseIndex[slot] = invalidIndex;
+			++generations[slot];
+			freeSlots.push_back(slot);
+			return true;
+		}
+
+		T* get(int64_t id)
+		{
+			const auto slot = getSlot(id);
+			return slot == invalidIndex ? nullptr : &values[denseIndex[slot]];
+		}
+
+		const T* get(int64_t id) const
+		{
+			const auto slot = getSlot(id);
+			return slot == invalidIndex ? nullptr : &values[denseIndex[slot]];
+		}
+
+		bool contains(int64_t id) const
+		{
+			return getSlot(id) != invalidIndex;
+		}
+
+		// Id of the i-th value, in iteration order
+		int64_t getId(size_t i) const
+		{
+			const auto slot = slots[i];
+			return makeId(slot, generations[slot]);
+		}
+
+		size_t size() const { return values.size(); }
+		bool empty() const { return values.empty(); }
+		size_t getNumSlots() const { return generations.size(); }
+
+		typename Vector<T>::iterator begin() { return values.begin(); }
+		typename Vector<T>::iterator end() { return values.end(); }
+		typename Vector<T>::const_iterator begin() const { return values.begin(); }
+		typename Vector<T>::const_iterator end() const { return values.end(); }
+
+		void clear()
+		{
+			for (auto& slot: slots) {
+				denseIndex[slot] = invalidIndex;
+				++generations[slot];
+				freeSlots.push_back(slot);
+			}
+			values.clear();
+			slots.clear();
+		}
+
+		// Drops the free slots at the end of the map and releases spare memory. Live ids stay valid; slots that get
+		// recreated later start above any generation dropped here, so stale ids into them still won't resolve.
+		void shrinkToFit()
+		{
+			const auto prevSlots = generations.size();
+			while (!generations.empty() && denseIndex.back() == invalidIndex) {
+				baseGeneration = std::max(baseGeneration, generations.back() + 1);
+				generations.pop_back();
+				denseIndex.pop_back();
+			}
+
+			if (generations.size() != prevSlots) {
+				const auto n = uint32_t(generations.size());
+				freeSlots.erase(std::remove_if(freeSlots.begin(), freeSlots.end(), [&] (uint32_t slot) { return slot >= n; }), freeSlots.end());
+			}
+
+			generations.shrink_to_fit();
+			denseIndex.shrink_to_fit();
+			freeSlots.shrink_to_fit();
+			values.shrink_to_fit();
+			slots.shrink_to_fit();
+		}
+
+		// Generations and free list, but not the values. Restoring it means ids will be handed out exactly as they would have been.
+		template <typename S>
+		void serializeAllocationState(S& s) const
+		{
+			s << baseGeneration << uint32_t(generations.size());
+			for (auto& g: generations) {
+				s << g;
+			}
+			s << uint32_t(freeSlots.size());
+			for (auto& slot: freeSlots) {
+				s << slot;
+			}
+		}
+
+		// Every slot allocated at the time gets a default constructed value, as whatever was here before could otherwise be
+		// reached through stale ids. It's up to the caller to put back the ones still in use.
+		template <typename D>
+		void deserializeAllocationState(D& s)
+		{
+			uint32_t nSlots;
+			s >> baseGeneration >> nSlots;
+			generations.resize(nSlots);
+			for (auto& g: generations) {
+				s >> g;
+			}
+
+			uint32_t nFree;
+			s >> nFree;
+			freeSlots.resize(nFree);
+			denseIndex.assign(nSlots, 0);
+			for (auto& slot: freeSlots) {
+				s >> slot;
+				denseIndex.at(slot) = invalidIndex;
+			}
+
+			values.clear();
+			slots.clear();
+			for (uint32_t slot = 0; slot < nSlots; ++slot) {
+				if (denseIndex[slot] != invalidIndex) {
+					denseIndex[slot] = uint32_t(values.size());
+					values.push_back(T());
+					slots.push_back(slot);
+				}
+			}
+		}
+
+	private:
+		constexpr static uint32_t invalidIndex = std::numeric_limits<uint32_t>::max();
+
+		Vector<uint32_t> generations;
+		Vector<uint32_t> denseIndex; // Into values, or invalidIndex for free slots
+		Vector<T> values;
+		Vector<uint32_t> slots; // Slot of each value
+		Vector<uint32_t> freeSlots;
+		uint32_t baseGeneration = 0;
+
+		static int64_t makeId(uint32_t slot, uint32_t generation)
+		{
+			return static_cast<int64_t>(slot) | (static_cast<int64_t>(generation & 0x7FFFFFFF) << 32);
+		}
+
+		uint32_t getSlot(int64_t id) const
+		{
+			const auto slot = static_cast<uint32_t>(id & 0xFFFFFFFFll);
+			const auto generation = static_cast<uint32_t>(id >> 32);
+			if (slot >= generations.size() || denseIndex[slot] == invalidIndex || (generations[slot] & 0x7FFFFFFF) != generation) {
+				return invalidIndex;
+			}
+			return slot;
+		}
+	};
+}
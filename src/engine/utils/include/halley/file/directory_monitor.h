@@ -1,21 +1,45 @@
 #pragma once
 
 #include <memory>
+#include <vector>
+#include "halley/text/halleystring.h"
 
 namespace Halley
 {
 	class Path;
 	class DirectoryMonitorPimpl;
-	
+
 	class DirectoryMonitor
 	{
 	public:
+		enum class ChangeType
+		{
+			Unknown, // Something changed, but it's not known what (e.g. too many changes at once), so everything should be looked at again
+			FileAdded,
+			FileRemoved,
+			FileModified,
+			FileRenamed
+		};
+
+		struct Event
+		{
+			ChangeType type;
+			String name; // Relative to the monitored directory, with forward slashes
+			String oldName; // Only for FileRenamed
+
+			Event(ChangeType type, String name = "", String oldName = "");
+		};
+
 		explicit DirectoryMonitor(const Path& p);
 		~DirectoryMonitor();
 
 		bool poll();
 		bool hasRealImplementation() const;
 
+		// Everything that changed since the last call. Names can be of directories as well as files.
+		// Without a real implementation, this always returns a single Unknown event.
+		std::vector<Event> getChanges();
+
 	private:
 		std::unique_ptr<DirectoryMonitorPimpl> pimpl;
 	};
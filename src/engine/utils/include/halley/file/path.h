@@ -62,7 +62,7 @@ namespace Halley
 	private:
 		std::vector<String> pathParts;
 		void normalise();
-		void setPath(const String& value);
+		void setPath(StringView value);
 
 		explicit Path(std::vector<String> parts);
 	};
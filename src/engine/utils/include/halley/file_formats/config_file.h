@@ -2,6 +2,9 @@
 
 #include <map>
 #include <vector>
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include "halley/text/halleystring.h"
 #include "halley/maths/vector2.h"
 #include "halley/resources/resource.h"
@@ -43,6 +46,7 @@ namespace Halley
 	};
 
 	class ConfigFile;
+	class ConfigObserver;
 	
 	class ConfigNode
 	{
@@ -97,6 +101,7 @@ namespace Halley
 		Vector2i asVector2i() const;
 		Vector2f asVector2f() const;
 		String asString() const;
+		StringView asStringView() const; // Only for strings, as there's nothing for a view of a number to point to; doesn't copy it
 		const Bytes& asBytes() const;
 
 		int asInt(int defaultValue) const;
@@ -162,10 +167,13 @@ namespace Halley
 
 	class ConfigFile : public Resource
 	{
+		friend class ConfigObserver;
+
 	public:
 		ConfigFile();
 		ConfigFile(const ConfigFile& other) = delete;
 		ConfigFile(ConfigFile&& other);
+		~ConfigFile();
 
 		ConfigFile& operator=(const ConfigFile& other) = delete;
 		ConfigFile& operator=(ConfigFile&& other);
@@ -182,17 +190,45 @@ namespace Halley
 		void reload(Resource&& resource) override;
 
 	private:
-		ConfigNode root;
+		struct BinaryLayout;
+
+		mutable ConfigNode root;
+
+		// Packed files keep their binary layout (interned string table, flat node array) and are only turned into a tree when the root is first accessed
+		mutable std::shared_ptr<const void> binaryOwner;
+		mutable gsl::span<const gsl::byte> binary;
+		mutable std::atomic<bool> materialized;
+		mutable std::mutex materializeMutex;
+
+		// Observers with a listener, told when this is reloaded; not moved along with the contents, as they're watching this object
+		mutable std::vector<ConfigObserver*> observers;
+
+		void updateRoot() const;
+		void setBinary(std::shared_ptr<const void> owner, gsl::span<const gsl::byte> data);
+		void materialize() const;
 
-		void updateRoot();
+		static Bytes toBinary(const ConfigNode& root);
+		static void fromBinary(const BinaryLayout& layout, uint32_t idx, ConfigNode& dst);
 	};
 
+	// Watches a ConfigFile for reloads. It can be polled with needsUpdate(), or given a listener, which the next dispatchChanges() calls
+	// (once, however many times the file was reloaded) after the file tells the observer about a reload, so nothing is spent on it
+	// while the file doesn't change. Listeners are called on the thread calling dispatchChanges(), which Core does at the start of each
+	// variable update. Copies don't take the listener along; moves do.
 	class ConfigObserver
 	{
+		friend class ConfigFile;
+
 	public:
 		ConfigObserver();
 		ConfigObserver(const ConfigNode& node);
 		ConfigObserver(const ConfigFile& file);
+		ConfigObserver(const ConfigObserver& other);
+		ConfigObserver(ConfigObserver&& other) noexcept;
+		~ConfigObserver();
+
+		ConfigObserver& operator=(const ConfigObserver& other);
+		ConfigObserver& operator=(ConfigObserver&& other) noexcept;
 
 		const ConfigNode& getRoot() const;
 		
@@ -200,9 +236,18 @@ namespace Halley
 		void update();
 		String getAssetId() const;
 
+		void setListener(std::function<void()> listener); // The listener will usually call update()
+		static void dispatchChanges();
+
 	private:
 		int assetVersion = 0;
 		const ConfigFile* file = nullptr;
 		const ConfigNode* node = nullptr;
+		std::function<void()> listener;
+		bool subscribed = false;
+		bool pending = false;
+
+		void subscribe(bool markPending);
+		bool unsubscribe();
 	};
 }
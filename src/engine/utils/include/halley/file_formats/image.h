@@ -52,7 +52,7 @@ namespace Halley {
 		void setSize(Vector2i size);
 
 		void load(gsl::span<const gsl::byte> bytes, Format format = Format::Undefined);
-		Bytes savePNGToBytes(bool allowDepthReduce = true) const;
+		Bytes savePNGToBytes(bool allowDepthReduce = true, bool fastCompression = false) const; // fastCompression trades a bigger file for much less time
 		static Vector2i getImageSize(gsl::span<const gsl::byte> bytes);
 		static Format getImageFormat(gsl::span<const gsl::byte> bytes);
 		static bool isPNG(gsl::span<const gsl::byte> bytes);
@@ -74,7 +74,7 @@ namespace Halley {
 		int getBytesPerPixel() const;
 		Format getFormat() const;
 
-		Rect4i getTrimRect() const;
+		Rect4i getTrimRect() const; // Smallest rect containing every pixel that isn't fully transparent
 		Rect4i getRect() const;
 
 		void clear(int colour);
@@ -98,6 +98,13 @@ namespace Halley {
 
 		void preMultiply();
 
+		// Reorders the channels of an RGBA image: each argument is the channel (0 to 3, for R, G, B and A) that it's taken from
+		void swizzle(int r, int g, int b, int a);
+
+		// Extends the pixels on the edges of rect outwards by up to amount pixels, so filtering near the edges of a packed sprite
+		// doesn't pick up its neighbours
+		void bleedEdges(Rect4i rect, int amount);
+
 	private:
 		std::unique_ptr<char, void(*)(char*)> px;
 		size_t dataLen = 0;
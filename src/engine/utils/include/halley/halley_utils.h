@@ -3,21 +3,28 @@
 namespace Halley {} // Get GitHub to realise this is C++ :3
 
 #include "concurrency/concurrent.h"
+#include "concurrency/deferred_destructor.h"
+#include "concurrency/spsc_queue.h"
 
 #include "bytes/byte_serializer.h"
 #include "bytes/compression.h"
 #include "bytes/fuzzer.h"
+#include "bytes/sectioned_serializer.h"
 
 #include "data_structures/bin_pack.h"
 #include "data_structures/circular_buffer.h"
 #include "data_structures/dynamic_grid.h"
 #include "data_structures/hash_map.h"
+#include "data_structures/flat_hash_map.h"
+#include "data_structures/hierarchical_grid.h"
 #include "data_structures/mapped_pool.h"
 #include "data_structures/maybe.h"
 #include "data_structures/maybe_ref.h"
 #include "data_structures/memory_pool.h"
+#include "data_structures/frame_arena.h"
 #include "data_structures/nullable_reference.h"
 #include "data_structures/rect_spatial_checker.h"
+#include "data_structures/slot_map.h"
 #include "data_structures/tree_map.h"
 #include "data_structures/vector.h"
 
@@ -36,19 +43,24 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 #include "maths/aabb.h"
 #include "maths/angle.h"
 #include "maths/base_transform.h"
+#include "maths/batch_transform.h"
+#include "maths/transform_2d.h"
 #include "maths/box.h"
 #include "maths/colour.h"
 #include "maths/line.h"
 #include "maths/matrix4.h"
 #include "maths/polygon.h"
+#include "maths/polygon_batch.h"
 #include "maths/random.h"
 #include "maths/range.h"
 #include "maths/rect.h"
+#include "maths/rolling_stats.h"
 #include "maths/tween.h"
 #include "maths/vector2.h"
 #include "maths/vector3.h"
 #include "maths/vector4.h"
 
+#include "os/cpu_topology.h"
 #include "os/os.h"
 
 #include "plugin/plugin.h"
@@ -58,17 +70,23 @@ namespace Halley {} // Get GitHub to realise this is C++ :3
 #include "resources/resource_data.h"
 
 #include "support/assert.h"
+#include "support/benchmark_report.h"
 #include "support/console.h"
 #include "support/debug.h"
 #include "support/exception.h"
 #include "support/logger.h"
+#include "support/memory_tracker.h"
 #include "support/redirect_stream.h"
+#include "support/telemetry.h"
 
 #include "text/encode.h"
 #include "text/halleystring.h"
 #include "text/i18n.h"
+#include "text/string_table.h"
 #include "text/string_converter.h"
+#include "text/string_id.h"
 #include "text/string_serializer.h"
+#include "text/string_view.h"
 
 #include "time/halleytime.h"
 #include "time/stopwatch.h"
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <gsl/gsl>
+#include "vector2.h"
+#include "rect.h"
+
+namespace Halley {
+	class Matrix4f;
+
+	// Maths on many points or quads at once, four at a time with SSE or NEON where available.
+	// Quads are the same as sprites': each is size (already scaled) in world units, placed so that pivot (in [0..1] of the size) sits at
+	// position, then rotated around it by rotation radians, exactly as sprite.vertex does on the GPU.
+	class BatchTransform {
+	public:
+		// Same as m * src[i] for each, including the divide by w. dst can be src.
+		static void transformPoints(const Matrix4f& m, gsl::span<const Vector2f> src, gsl::span<Vector2f> dst);
+
+		// Four corners per quad, in the same order as the sprite vertices: (0, 0), (1, 0), (1, 1), (0, 1)
+		static void computeQuads(gsl::span<const Vector2f> positions, gsl::span<const Vector2f> pivots, gsl::span<const Vector2f> sizes, gsl::span<const float> rotations, gsl::span<Vector2f> corners);
+
+		// Exact bounds of the rotated quads, either as rectangles or split into one array per edge
+		static void computeAABBs(gsl::span<const Vector2f> positions, gsl::span<const Vector2f> pivots, gsl::span<const Vector2f> sizes, gsl::span<const float> rotations, gsl::span<Rect4f> aabbs);
+		static void computeAABBs(gsl::span<const Vector2f> positions, gsl::span<const Vector2f> pivots, gsl::span<const Vector2f> sizes, gsl::span<const float> rotations,
+			gsl::span<float> minX, gsl::span<float> minY, gsl::span<float> maxX, gsl::span<float> maxY);
+	};
+}
@@ -45,6 +45,7 @@ namespace Halley {
 		void setOrigin(const Vertex& _origin) { origin = _origin; }
 		const VertexList& getVertices() const { return vertices; }
 		const Vertex& getOrigin() const { return origin; }
+		const Vector<Vector2f>& getNormals() const { return normals; } // Unit normal of each edge, from vertex i to i + 1
 		void rotate(Angle<float> angle);
 		void rotateAndScale(Angle<float> angle, Vector2f scale);
 		bool isClockwise() const;
@@ -53,6 +54,7 @@ namespace Halley {
 	private:
 		float outerRadius;
 		VertexList vertices;
+		Vector<Vector2f> normals;
 		Vertex origin;
 		AABB aabb;
 
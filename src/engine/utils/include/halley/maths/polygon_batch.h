@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <gsl/gsl>
+#include <halley/data_structures/vector.h>
+#include "polygon.h"
+
+namespace Halley {
+	// Many polygons laid out for testing them against each other in bulk.
+	// Vertices and separating axes are kept in flat arrays of x and y, padded so each polygon's vertices can be projected four at a time.
+	// Queries give the same yes/no answer as Polygon::overlaps(); use that on the hits if the translation or collision point is needed.
+	class PolygonBatch {
+	public:
+		using PolygonId = uint32_t;
+
+		PolygonId add(const Polygon& polygon);
+		void setOrigin(PolygonId id, Vector2f origin);
+		Vector2f getOrigin(PolygonId id) const;
+		size_t size() const;
+		void clear(); // Changing the shape of polygons means building the batch again
+
+		bool overlaps(PolygonId id, const Polygon& polygon) const;
+		bool overlaps(PolygonId id, const PolygonBatch& other, PolygonId otherId) const;
+
+		// Appends the ids of all polygons overlapping polygon, or only of the candidates that do, e.g. from a broadphase
+		void getOverlapping(const Polygon& polygon, Vector<PolygonId>& result) const;
+		void getOverlapping(const Polygon& polygon, gsl::span<const PolygonId> candidates, Vector<PolygonId>& result) const;
+
+		// Appends the index into pairs of each pair that overlaps. The first of each pair is in this batch, the second in other, which can be this one
+		void getOverlappingPairs(const PolygonBatch& other, gsl::span<const std::pair<PolygonId, PolygonId>> pairs, Vector<size_t>& result) const;
+
+		struct Shape; // One polygon's slice of the arrays, as the kernels see it
+
+	private:
+		Vector<float> vertexX;
+		Vector<float> vertexY;
+		Vector<float> axisX;
+		Vector<float> axisY;
+
+		Vector<uint32_t> vertexStart;
+		Vector<uint32_t> vertexCount; // Padded to a multiple of 4
+		Vector<uint32_t> axisStart;
+		Vector<uint32_t> axisCount;
+		Vector<float> originX;
+		Vector<float> originY;
+		Vector<float> radius;
+
+		Shape getShape(PolygonId id) const;
+	};
+}
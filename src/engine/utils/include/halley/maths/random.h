@@ -25,17 +25,29 @@
 #include <halley/support/exception.h>
 #include <gsl/span>
 #include <cstdint>
+#include <array>
 
 namespace Halley {
 	class MT199937AR;
 
 	class Random {
 	public:
+		// MT19937 is the default, and what the global one uses. Xoshiro256 (xoshiro256**) is much faster, and its whole state is 32
+		// bytes, so it's cheap to seed and to keep one per entity or per thread; it can also jump ahead to make independent streams.
+		// The two give different sequences for the same seed.
+		enum class Algorithm : uint8_t {
+			MT19937,
+			Xoshiro256
+		};
+
 		static Random& getGlobal();
 
 		Random();
 		Random(uint32_t seed);
 		Random(gsl::span<const gsl::byte> data);
+		explicit Random(Algorithm algorithm);
+		Random(uint32_t seed, Algorithm algorithm);
+		Random(gsl::span<const gsl::byte> data, Algorithm algorithm);
 		~Random();
 
 		Random(const Random& other) = delete;
@@ -71,12 +83,30 @@ namespace Halley {
 		void setSeed(uint32_t seed);
 		void setSeed(gsl::span<const gsl::byte> data);
 
+		// Same as calling getFloat() or getRawInt() for each, but without going through the generator's dispatch every time
+		void fill(gsl::span<float> dst); // [0, 1)
+		void fill(gsl::span<float> dst, float min, float max); // [min, max)
+		void fill(gsl::span<uint32_t> dst);
+
+		Algorithm getAlgorithm() const;
+
+		// Xoshiro256 only. jump() skips 2^128 numbers ahead, so streams made by splitStream() never overlap in practice.
+		// splitStream() returns a generator carrying on from the current state, then jumps this one past it, so e.g. calling it once
+		// per thread from a single seeded Random gives each thread its own stream, all reproducible from that seed.
+		void jump();
+		Random splitStream();
+
 		uint32_t getRawInt();
 		float getRawFloat();
 		double getRawDouble();
 
 	private:
-		std::unique_ptr<MT199937AR> generator;
+		Algorithm algorithm = Algorithm::MT19937;
+		std::unique_ptr<MT199937AR> generator; // Only for MT19937
+		std::array<uint64_t, 4> state = {{ 0, 0, 0, 0 }}; // Only for Xoshiro256
+
+		uint64_t getRawInt64();
+		uint64_t nextXoshiro();
 	};
 
 }
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include "halley/data_structures/vector.h"
+
+namespace Halley {
+	// The last few samples of something, e.g. nanoseconds per frame, so spikes can be told apart from the average
+	class RollingStats {
+	public:
+		explicit RollingStats(size_t maxSamples = 120);
+
+		void add(int64_t value);
+		void clear();
+
+		size_t getNumSamples() const { return samples.size(); }
+		int64_t getLatest() const;
+		int64_t getMax() const;
+		int64_t getAverage() const;
+
+		// E.g. 0.95f for p95; nearest rank, so it's always one of the samples
+		int64_t getPercentile(float fraction) const;
+
+	private:
+		Vector<int64_t> samples;
+		size_t maxSamples;
+		size_t next = 0;
+	};
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "vector2.h"
+#include "angle.h"
+#include "rect.h"
+#include "matrix4.h"
+
+namespace Halley {
+	// Position, rotation and scale, applied to a point as scale, then rotation, then translation
+	class Transform2D {
+	public:
+		Transform2D();
+		explicit Transform2D(Vector2f position, Angle1f rotation = Angle1f(), Vector2f scale = Vector2f(1, 1));
+
+		bool operator==(const Transform2D& other) const;
+		bool operator!=(const Transform2D& other) const;
+
+		Vector2f position;
+		Angle1f rotation;
+		Vector2f scale;
+	};
+
+	// The top two rows of a 3x3 matrix: x' = a * x + c * y + tx, y' = b * x + d * y + ty
+	// Unlike Transform2D, composing these is exact even with non-uniformly scaled parents.
+	class Affine2D {
+	public:
+		float a = 1;
+		float b = 0;
+		float c = 0;
+		float d = 1;
+		float tx = 0;
+		float ty = 0;
+
+		Affine2D() = default;
+		Affine2D(float a, float b, float c, float d, float tx, float ty);
+		explicit Affine2D(const Transform2D& transform);
+
+		Affine2D operator*(const Affine2D& child) const; // Child is in this one's space
+
+		Vector2f transformPoint(Vector2f p) const;
+		Vector2f transformVector(Vector2f v) const;
+		Rect4f transformBounds(Rect4f bounds) const; // Axis-aligned bounds of the transformed rect
+
+		Transform2D decompose() const; // Any shear is lost
+		Matrix4f toMatrix() const;
+	};
+}
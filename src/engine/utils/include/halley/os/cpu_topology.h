@@ -0,0 +1,16 @@
+#pragma once
+
+#include <vector>
+
+namespace Halley {
+	enum class CPUCoreClass {
+		Performance, // Big or P-cores, and all of them on CPUs that don't have two kinds
+		Efficiency // LITTLE or E-cores
+	};
+
+	struct CPUCore {
+		int id = 0; // Logical CPU, as given to OS::setThreadAffinity()
+		CPUCoreClass coreClass = CPUCoreClass::Performance;
+		int numaNode = 0;
+	};
+}
@@ -24,6 +24,8 @@
 #include "halley/text/halleystring.h"
 #include "halley/file/path.h"
 #include "halley/core/api/system_api.h"
+#include "halley/os/cpu_topology.h"
+#include <gsl/span>
 
 namespace Halley {
 	class ComputerData {
@@ -36,6 +38,13 @@ namespace Halley {
 		long long RAM = 0;
 	};
 
+	// A read-only view of a whole file, unmapped on destruction
+	class MemoryMappedFile {
+	public:
+		virtual ~MemoryMappedFile() {}
+		virtual gsl::span<const gsl::byte> getData() const = 0;
+	};
+
 	class OS {
 	public:
 		virtual ~OS() {}
@@ -58,6 +67,8 @@ namespace Halley {
 		virtual void createDirectories(const Path& path);
 		virtual void atomicWriteFile(const Path& path, const Bytes& data, Maybe<Path> backupOldVersionPath = {});
 		virtual std::vector<Path> enumerateDirectory(const Path& path);
+		virtual std::unique_ptr<MemoryMappedFile> mapFile(const Path& path); // Returns null if unsupported or the file can't be mapped
+		virtual bool evictFileCache(const Path& path); // Drops the file from the OS's cache, so it's next read from disk; false if unsupported or it failed
 
 		virtual void setConsoleColor(int foreground, int background);
 		virtual int runCommand(String command);
@@ -66,6 +77,11 @@ namespace Halley {
 
 		virtual void openURL(const String& url);
 
+		virtual uint64_t getMemoryUsage(); // Resident bytes of this process, or 0 if unknown
+
+		virtual std::vector<CPUCore> getCPUTopology(); // Online logical CPUs; by default, as many as the hardware has, alike and on one node
+		virtual bool setThreadAffinity(const std::vector<int>& cpus); // Keeps the calling thread on those CPUs; false if unsupported or it failed
+
 	private:
 		static OS* osInstance;
 	};
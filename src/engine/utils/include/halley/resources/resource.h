@@ -22,11 +22,13 @@ namespace Halley
 		Material,
 		Animation,
 		Config,
+		StringTable,
 		Audio,
 		AudioEvent,
 		Sprite,
 		SpriteSheet,
-		Shader
+		Shader,
+		LuaScript
 	};
 
 	// This order matters.
@@ -46,12 +48,13 @@ namespace Halley
 		Animation,
 		Font,
 		AudioClip,
-		AudioEvent
+		AudioEvent,
+		StringTable
 	};
 
 	template <>
 	struct EnumNames<AssetType> {
-		constexpr std::array<const char*, 13> operator()() const {
+		constexpr std::array<const char*, 14> operator()() const {
 			return{{
 				"binaryFile",
 				"textFile",
@@ -65,7 +68,8 @@ namespace Halley
 				"animation",
 				"font",
 				"audioClip",
-				"audioEvent"
+				"audioEvent",
+				"stringTable"
 			}};
 		}
 	};
@@ -83,6 +87,9 @@ namespace Halley
 		void setAssetId(const String& name);
 		const String& getAssetId() const;
 		virtual void onLoaded(Resources& resources);
+
+		// Approximate memory held by this resource, used for residency budgets
+		virtual size_t getMemoryUsage() const;
 		
 		int getAssetVersion() const;
 		void reloadResource(Resource&& resource);
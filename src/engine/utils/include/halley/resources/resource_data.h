@@ -67,7 +67,7 @@ namespace Halley {
 		gsl::span<const gsl::byte> getSpan() const;
 		size_t getSize() const;
 		String getString() const;
-		void inflate();
+		void inflate(const String& codec = "deflate");
 
 		static std::unique_ptr<ResourceDataStatic> loadFromFileSystem(Path path);
 		void writeToFileSystem(String path) const;
@@ -110,6 +110,7 @@ namespace Halley {
 	class ResourceLoader
 	{
 		friend class ResourceCollectionBase;
+		friend class AssetPackBenchmark; // Times loaders on their own, with data it's already fetched
 
 	public:
 		const String& getName() const { return name; }
@@ -121,6 +122,12 @@ namespace Halley {
 		std::unique_ptr<ResourceDataStream> getStream();
 		Future<std::unique_ptr<ResourceDataStatic>> getAsync() const;
 
+		// For resources that read their data again later (e.g. to stream in more detail); must not outlive Resources
+		std::function<std::unique_ptr<ResourceDataStatic>()> getFetcher() const;
+
+		// Reads and decompresses an asset's data; safe to call from any thread
+		static std::unique_ptr<ResourceDataStatic> fetchStatic(IResourceLocator& locator, const String& name, AssetType type, const Metadata& meta);
+
 	private:
 		ResourceLoader(ResourceLoader&& loader) noexcept;
 		ResourceLoader(IResourceLocator& locator, const String& name, AssetType type, ResourceLoadPriority priority, const HalleyAPI* api);
@@ -132,6 +139,7 @@ namespace Halley {
 		ResourceLoadPriority priority;
 		const HalleyAPI* api;
 		const Metadata* metadata;
+		mutable std::unique_ptr<ResourceDataStatic> prefetched;
 		bool loaded = false;
 	};
 
@@ -0,0 +1,94 @@
+#pragma once
+#include <halley/time/halleytime.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace Halley
+{
+	enum class FramePacerPowerMode
+	{
+		Performance, // Waits on a high resolution timer, then spins for the last stretch
+		Sustained    // Caps at the sustained frame rate, and only ever sleeps; for mobile, where holding a steady lower rate beats thermal throttling
+	};
+
+	struct FramePacerStats
+	{
+		Time averageFrameTime = 0;
+		Time frameTimeDeviation = 0; // Standard deviation
+		Time maxFrameTime = 0;
+		double timeDilation = 1.0; // Simulated time over real time; below 1 when fixed steps had to be dropped
+		int64_t droppedFixedSteps = 0;
+	};
+
+	// Decides how many fixed steps each frame runs and how long variable steps are, and waits out frame caps.
+	// Fixed steps run at a constant delta; when there are more due than maxCatchUpSteps, the rest are dropped and the game slows down instead of falling further behind.
+	// Deadlines are kept on a fixed grid rather than being relative to when the frame ended, so that waits don't accumulate drift.
+	class FramePacer
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		explicit FramePacer(int fixedFPS = 60);
+
+		void setFixedFPS(int fps);
+		int getFixedFPS() const;
+		void setMaxCatchUpSteps(int steps);
+
+		// 0 leaves it uncapped, e.g. when vsync paces the frames
+		void setFrameCap(int fps);
+
+		// With the display's refresh rate known, capped frame intervals are rounded up to a whole number of refreshes, and deadlines are
+		// aligned to when frames have been observed to end, so presents don't straddle a vsync
+		void setRefreshRate(int hz);
+
+		void setPowerMode(FramePacerPowerMode mode, int sustainedFPS = 30);
+		FramePacerPowerMode getPowerMode() const;
+
+		void reset();
+
+		void beginFrame();
+		int getFixedSteps() const;
+		Time getFixedDelta() const;
+		Time getVariableDelta() const;
+		void endFrame();
+
+		// As endFrame(), but the wait is spent calling poll() every pollInterval, and only ever sleeping in between.
+		// For dedicated servers, to handle network traffic as it arrives without spinning on a core another instance could be using.
+		void endFrame(const std::function<void()>& poll, Clock::duration pollInterval);
+
+		const FramePacerStats& getStats() const;
+
+		// Sleeps as precisely as the platform allows, then spins the rest if allowed to
+		static void waitUntil(Clock::time_point time, bool allowSpin);
+
+	private:
+		constexpr static size_t nSamples = 120;
+
+		int fixedFPS;
+		int maxCatchUpSteps = 5;
+		int frameCap = 0;
+		int refreshRate = 0;
+		FramePacerPowerMode powerMode = FramePacerPowerMode::Performance;
+		int sustainedFPS = 30;
+
+		Clock::time_point lastFrameStart;
+		Clock::time_point nextDeadline;
+		bool started = false;
+		Time accumulator = 0;
+		int fixedSteps = 0;
+		Time variableDelta = 0;
+
+		std::array<Time, nSamples> samples;
+		size_t nextSample = 0;
+		size_t sampleCount = 0;
+		Time simulatedTime = 0;
+		Time realTime = 0;
+		FramePacerStats stats;
+
+		Clock::duration getFrameInterval() const;
+		bool advanceDeadline(); // False if there's nothing to wait for
+		void addSample(Time frameTime);
+	};
+}
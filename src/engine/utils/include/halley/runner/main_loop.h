@@ -1,5 +1,6 @@
 #pragma once
 #include <halley/time/halleytime.h>
+#include "frame_pacer.h"
 
 namespace Halley
 {
@@ -24,6 +25,13 @@ namespace Halley
 		virtual void onTerminatedInError(const std::string& error) = 0;
 
 		virtual int getTargetFPS() = 0;
+
+		// The pacer outlives the loop it's given in, and is reconfigured for each one
+		virtual void setFramePacer(FramePacer* pacer) {}
+
+		// Dedicated servers run one frame per fixed step, calling onServerPoll() while they wait for the next one instead of sleeping
+		virtual bool isDedicatedServer() const { return false; }
+		virtual void onServerPoll() {}
 	};
 
 	class MainLoop
@@ -37,7 +45,7 @@ namespace Halley
 		GameLoader& reloader;
 
 		int fps = 60;
-		bool capFrameRate = false;
+		FramePacer pacer;
 
 		void runLoop();
 		bool isRunning() const;
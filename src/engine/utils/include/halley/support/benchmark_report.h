@@ -0,0 +1,85 @@
+#pragma once
+
+#include "halley/text/halleystring.h"
+#include "halley/data_structures/vector.h"
+#include "halley/data_structures/tree_map.h"
+#include "halley/file/path.h"
+#include "halley/data_structures/maybe.h"
+#include <functional>
+#include <iosfwd>
+
+namespace Halley {
+	// What a benchmark measured, written as JSON by every benchmark under src/tests (with --json=<file>) and by pack-benchmark,
+	// so "halley-cmd benchmark-compare" can check one run against another. Along with the commit and the machine it ran on,
+	// each metric keeps every sample it took (one per repetition, frame, buffer, tick...), as telling a slowdown from noise
+	// takes more than their averages. The statistics written next to them are for people reading the file; loading only uses the samples.
+	class BenchmarkReport {
+	public:
+		enum class Better {
+			Lower, // Times
+			Higher // Throughputs
+		};
+
+		struct Metric {
+			String name; // Unique in the report, e.g. "sprites_10k/draw"
+			String unit;
+			Better better = Better::Lower;
+			bool exact = false; // Counts that are the same on every run (e.g. draw calls), rather than measurements with noise
+			Vector<double> samples;
+
+			void add(double sample);
+
+			double getMin() const;
+			double getMax() const;
+			double getMean() const;
+			double getMedian() const;
+			double getStandardDeviation() const;
+			double getPercentile(double fraction) const; // Interpolated between the two nearest samples
+		};
+
+		BenchmarkReport() = default;
+		BenchmarkReport(String benchmark, String commit); // Also records the machine it's running on, and when
+
+		Metric& addMetric(const String& name, const String& unit, Better better = Better::Lower, bool exact = false);
+		void add(const String& name, const String& unit, double sample, Better better = Better::Lower); // Adds the metric if needed
+
+		const String& getBenchmark() const { return benchmark; }
+		const String& getCommit() const { return commit; }
+		const String& getDate() const { return date; }
+		const TreeMap<String, String>& getMachine() const { return machine; }
+		const Vector<Metric>& getMetrics() const { return metrics; }
+		const Metric* tryGetMetric(const String& name) const;
+
+		String toJSON() const;
+		static BenchmarkReport fromJSON(const String& json);
+
+		void save(const Path& path) const;
+		static BenchmarkReport load(const Path& path);
+
+	private:
+		String benchmark;
+		String commit;
+		String date; // UTC, ISO 8601
+		TreeMap<String, String> machine;
+		Vector<Metric> metrics;
+	};
+
+	// Where a benchmark writes its results, and what to call the run, as given on its command line:
+	// CSV rows appended to --out=<file> for spreadsheets, and a BenchmarkReport written to --json=<file>, both tagged with --label=<e.g. commit>.
+	struct BenchmarkOutput {
+		String label = "local";
+		String csvPath;
+		String jsonPath;
+
+		// Takes --label=, --out= and --json=, each with prefix after the dashes (e.g. "benchmark-"); false if arg is none of them
+		bool parseArgument(const String& arg, const String& prefix = "");
+
+		// Saves the report, if there's a JSON path
+		void writeJSON(const BenchmarkReport& report) const;
+		// Has writeRows append to the CSV file, if there's a path to it
+		void appendCSV(const std::function<void(std::ostream&)>& writeRows) const;
+
+		// The value of arg if it's --name=<value>
+		static Maybe<String> getArgument(const String& arg, const String& name);
+	};
+}
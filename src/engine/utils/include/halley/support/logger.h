@@ -3,6 +3,11 @@
 #include <exception>
 #include <set>
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <condition_variable>
 
 namespace Halley
 {
@@ -33,15 +38,45 @@ namespace Halley
 		bool devMode;
 	};
 
+	// Lets a call site through a number of times per second, see HALLEY_LOG_RATE_LIMITED
+	class LogRateLimit
+	{
+	public:
+		explicit LogRateLimit(int maxPerSecond = 10);
+
+		bool shouldLog();
+		size_t takeSuppressed(); // How many were held back since this was last called
+
+	private:
+		const int maxPerSecond;
+		std::atomic<int64_t> windowStart;
+		std::atomic<int> count;
+		std::atomic<size_t> suppressed;
+	};
+
+	class LoggerThreadBuffer;
+
 	class Logger
 	{
 	public:
+		Logger();
+		~Logger();
+
 		static void setInstance(Logger& logger);
 
 		static void addSink(ILoggerSink& sink);
 		static void removeSink(ILoggerSink& sink);
 
+		// When async, log() only queues the message on a buffer for the calling thread, and a background thread hands
+		// them to the sinks, in order. If a thread's buffer fills up, its messages are dropped rather than waited on.
+		static void setAsync(bool async);
+		static bool isAsync();
+
+		// Hands everything queued to the sinks right now, on the calling thread. Call before anything that might not return, like crashing.
+		static void flush();
+
 		static void log(LoggerLevel level, const String& msg);
+		static void log(LoggerLevel level, const String& msg, size_t suppressed);
 		static void logDev(const String& msg);
 		static void logInfo(const String& msg);
 		static void logWarning(const String& msg);
@@ -52,5 +87,34 @@ namespace Halley
 		static Logger* instance;
 
 		std::set<ILoggerSink*> sinks;
+		std::recursive_mutex sinksMutex;
+
+		std::atomic<bool> async;
+		std::atomic<bool> wakeRequested;
+		std::atomic<uint64_t> nextSequence;
+		bool running = false;
+		std::thread thread;
+		std::mutex wakeMutex;
+		std::condition_variable wake;
+
+		std::vector<std::shared_ptr<LoggerThreadBuffer>> buffers;
+		std::mutex buffersMutex;
+		std::mutex drainMutex;
+
+		void deliver(LoggerLevel level, const String& msg);
+		void enqueue(LoggerLevel level, const String& msg);
+		LoggerThreadBuffer& getThreadBuffer();
+		void drain();
+		void stopThread();
+		void run();
 	};
 }
+
+// Logs at most a few times per second from this line, no matter how many threads hit it; msg isn't even built when held back
+#define HALLEY_LOG_RATE_LIMITED(level, msg) \
+	do { \
+		static ::Halley::LogRateLimit halleyLogRateLimit_; \
+		if (halleyLogRateLimit_.shouldLog()) { \
+			::Halley::Logger::log(level, msg, halleyLogRateLimit_.takeSuppressed()); \
+		} \
+	} while (false)
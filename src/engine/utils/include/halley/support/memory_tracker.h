@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <new>
+#include <vector>
+#include "halley/text/halleystring.h"
+
+namespace Halley {
+	// Identifies where memory is accounted. The built-in ones are always there; games and subsystems can register their own.
+	using MemoryTag = uint16_t;
+
+	namespace MemoryTags {
+		enum : MemoryTag {
+			Untagged,
+			Pools, // SizePool blocks, e.g. entities, components and messages
+			Audio,
+			GPUTextures,
+			GPUBuffers,
+			NumBuiltIn
+		};
+	}
+
+	struct MemoryTagStats
+	{
+		String name;
+		int64_t bytes = 0;
+		int64_t peakBytes = 0;
+		uint64_t allocations = 0; // Total ever made
+	};
+
+	// Lock-free running totals per tag. Nothing here allocates, so it can be called from allocators.
+	// It only counts what's reported to it, by the engine's pools, audio buffers, video backends and anything using TaggedAllocator.
+	class MemoryTracker
+	{
+	public:
+		constexpr static size_t maxTags = 256;
+
+		// Returns the same tag every time for the same name. Throws if there are too many.
+		static MemoryTag registerTag(const String& name);
+		static String getTagName(MemoryTag tag);
+
+		static void onAlloc(MemoryTag tag, size_t bytes);
+		static void onFree(MemoryTag tag, size_t bytes);
+
+		// The tag TaggedAllocators default to on this thread, see MemoryTagScope
+		static MemoryTag getCurrentTag();
+
+		static MemoryTagStats getStats(MemoryTag tag);
+		static std::vector<MemoryTagStats> getAllStats(); // Every tag that has ever been used
+		static int64_t getTotalBytes();
+
+	private:
+		friend class MemoryTagScope;
+		static MemoryTag& currentTag();
+	};
+
+	// Makes tag the current one on this thread until it goes out of scope
+	class MemoryTagScope
+	{
+	public:
+		explicit MemoryTagScope(MemoryTag tag);
+		~MemoryTagScope();
+
+		MemoryTagScope(const MemoryTagScope& other) = delete;
+		MemoryTagScope& operator=(const MemoryTagScope& other) = delete;
+
+	private:
+		MemoryTag prevTag;
+	};
+
+	// Standard allocator that reports to the tag that was current when it was created (or the one it's given).
+	// The tag travels with the container, so memory is always returned to the tag it was taken from.
+	template <typename T>
+	struct TaggedAllocator
+	{
+		using value_type = T;
+		using propagate_on_container_copy_assignment = std::true_type;
+		using propagate_on_container_move_assignment = std::true_type;
+		using propagate_on_container_swap = std::true_type;
+
+		MemoryTag tag;
+
+		TaggedAllocator() : tag(MemoryTracker::getCurrentTag()) {}
+		explicit TaggedAllocator(MemoryTag tag) : tag(tag) {}
+
+		template <typename U>
+		TaggedAllocator(const TaggedAllocator<U>& other) : tag(other.tag) {}
+
+		T* allocate(size_t n)
+		{
+			if (n > std::numeric_limits<size_t>::max() / sizeof(T)) {
+				throw std::bad_alloc();
+			}
+			auto p = static_cast<T*>(::operator new(n * sizeof(T)));
+			MemoryTracker::onAlloc(tag, n * sizeof(T));
+			return p;
+		}
+
+		void deallocate(T* p, size_t n)
+		{
+			MemoryTracker::onFree(tag, n * sizeof(T));
+			::operator delete(p);
+		}
+
+		template <typename U>
+		bool operator==(const TaggedAllocator<U>& other) const { return tag == other.tag; }
+
+		template <typename U>
+		bool operator!=(const TaggedAllocator<U>& other) const { return tag != other.tag; }
+	};
+
+	template <typename T> using TaggedVector = std::vector<T, TaggedAllocator<T>>;
+}
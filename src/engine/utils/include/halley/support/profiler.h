@@ -0,0 +1,122 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "halley/text/halleystring.h"
+
+namespace Halley {
+	class Serializer;
+	class Deserializer;
+
+	// A set of finished scopes, as retrieved from the Profiler
+	class ProfilerCapture
+	{
+	public:
+		struct Event
+		{
+			String name;
+			String detail;
+			int thread = 0;
+			int depth = 0;
+			int64_t startNs = 0;
+			int64_t endNs = 0;
+
+			void serialize(Serializer& s) const;
+			void deserialize(Deserializer& s);
+		};
+
+		std::vector<Event> events;
+		std::vector<String> threadNames;
+
+		bool empty() const { return events.empty(); }
+		void append(const ProfilerCapture& other);
+
+		// In Chrome's Trace Event format, load it on chrome://tracing
+		String toChromeTrace() const;
+
+		void serialize(Serializer& s) const;
+		void deserialize(Deserializer& s);
+	};
+
+	// Keeps track of how far a consumer has read into each thread's buffer, so streaming captures don't repeat events
+	struct ProfilerCursor
+	{
+		std::vector<uint64_t> positions;
+	};
+
+	// Records scopes into a ring buffer per thread. Recording never locks and is a single
+	// branch when disabled; captures copy out of the buffers from any thread.
+	// A thread only gets a buffer once it records something, and hands it over to the next one when it ends.
+	class Profiler
+	{
+	public:
+		static void setEnabled(bool enabled);
+		static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+		// Longest detail kept with an event, anything past it is cut off
+		constexpr static size_t maxDetailLength = 47;
+
+		static void setThreadName(const String& name);
+
+		// Returns a pointer that stays valid forever, for names that aren't string literals.
+		// Never freed, so only for names from a small set (e.g. systems); details are copied into the buffers instead.
+		static const char* intern(const String& str);
+
+		static int64_t getTime();
+		static void record(const char* name, const char* detail, int64_t startNs, int64_t endNs, int depth);
+
+		// Everything still in the buffers
+		static ProfilerCapture capture();
+		// Only what was recorded since the last call with the same cursor
+		static ProfilerCapture capture(ProfilerCursor& cursor);
+
+	private:
+		static std::atomic<bool> enabled;
+	};
+
+	class ProfilerScope
+	{
+	public:
+		explicit ProfilerScope(const char* name, const char* detail = nullptr)
+			: name(Profiler::isEnabled() ? name : nullptr)
+		{
+			if (this->name) {
+				begin(detail, detail ? strlen(detail) : 0);
+			}
+		}
+
+		ProfilerScope(const char* name, const String& detail)
+			: name(Profiler::isEnabled() ? name : nullptr)
+		{
+			if (this->name) {
+				begin(detail.c_str(), detail.size());
+			}
+		}
+
+		~ProfilerScope()
+		{
+			if (name) {
+				end();
+			}
+		}
+
+		ProfilerScope(const ProfilerScope& other) = delete;
+		ProfilerScope& operator=(const ProfilerScope& other) = delete;
+
+	private:
+		const char* name;
+		int64_t startNs = 0;
+		int depth = 0;
+		char detail[Profiler::maxDetailLength + 1]; // Copied, as it needn't outlive the scope
+
+		void begin(const char* detail, size_t length);
+		void end();
+	};
+}
+
+#define HALLEY_PROFILE_CONCAT_IMPL(a, b) a##b
+#define HALLEY_PROFILE_CONCAT(a, b) HALLEY_PROFILE_CONCAT_IMPL(a, b)
+#define HALLEY_PROFILE_SCOPE(name) Halley::ProfilerScope HALLEY_PROFILE_CONCAT(profilerScope_, __LINE__)(name)
+#define HALLEY_PROFILE_SCOPE_DETAIL(name, detail) Halley::ProfilerScope HALLEY_PROFILE_CONCAT(profilerScope_, __LINE__)(name, detail)
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include "halley/text/halleystring.h"
+
+namespace Halley {
+	class Serializer;
+	class Deserializer;
+
+	// One named sample, e.g. "world.fixed.ms" or "audio.voices"
+	struct TelemetryValue
+	{
+		String name;
+		double value = 0;
+
+		TelemetryValue() = default;
+		TelemetryValue(String name, double value);
+
+		void serialize(Serializer& s) const;
+		void deserialize(Deserializer& s);
+	};
+
+	class ITelemetrySource
+	{
+	public:
+		virtual ~ITelemetrySource() {}
+		virtual void getTelemetry(std::vector<TelemetryValue>& values) const = 0;
+	};
+
+	// Engine subsystems register here, so a frame's worth of numbers can be sampled without the game plumbing them through.
+	// capture() is meant to be called from the main thread; sources that are updated elsewhere must report thread-safely.
+	class Telemetry
+	{
+	public:
+		static void addSource(ITelemetrySource& source);
+		static void removeSource(ITelemetrySource& source);
+
+		static std::vector<TelemetryValue> capture();
+	};
+}
@@ -28,6 +28,7 @@
 #include <gsl/gsl_assert>
 #include <iomanip>
 #include <cstdint>
+#include "string_view.h"
 
 namespace Halley {
 
@@ -46,6 +47,8 @@ namespace Halley {
 		String(const char* utf8);
 		String(const char* utf8,size_t bytes);
 		String(const std::basic_string<Character>& str);
+		String(std::basic_string<Character>&& str) noexcept;
+		explicit String(StringView view);
 		String(const String& str) noexcept;
 		String(String&& str) noexcept;
 
@@ -74,19 +77,19 @@ namespace Halley {
 		String& trim(bool fromRight);
 		String& trimBoth();
 
-		bool contains(const String& string) const;
-		size_t find(String str) const;
+		bool contains(StringView string) const;
+		size_t find(StringView str) const;
 
-		String replaceAll(const String& before, const String& after) const;
-		String replaceOne(const String& before, const String& after) const;
+		String replaceAll(StringView before, StringView after) const;
+		String replaceOne(StringView before, StringView after) const;
 		void shrink();
 
 		String left(size_t n) const;
 		String right(size_t n) const;
 		String mid(size_t start,size_t count=npos) const;
 
-		bool startsWith(const String& string,bool caseSensitive=true) const;
-		bool endsWith(const String& string,bool caseSensitive=true) const;
+		bool startsWith(StringView string,bool caseSensitive=true) const;
+		bool endsWith(StringView string,bool caseSensitive=true) const;
 
 		void writeText(const Character* src,size_t len,size_t &pos);
 		void writeChar(const Character &src,size_t &pos);
@@ -140,7 +143,7 @@ namespace Halley {
 		inline const std::string& cppStr() const { return str; }
 
 		Vector<String> split(char delimiter) const;
-		Vector<String> split(String delimiter) const;
+		Vector<String> split(StringView delimiter) const;
 		static String concatList(const Vector<String>& list, String separator);
 
 		//////////
@@ -168,6 +171,12 @@ namespace Halley {
 		std::string str;
 	};
 
+	// Only valid until the string is changed or destroyed
+	inline StringView::StringView(const String& str)
+		: str(str.c_str())
+		, len(str.size())
+	{}
+
 	String operator+ (const String& lhp, const String& rhp);
 	std::ostream& operator<< (std::ostream& os, const String& rhp);
 	std::istream& operator>> (std::istream& is, String& rhp);
@@ -181,9 +190,6 @@ namespace std {
 	template<>
 	struct hash<Halley::String>
 	{
-		size_t operator()(const Halley::String& s) const 
-		{
-			return std::hash<std::string>()(s.cppStr());
-		}
+		size_t operator()(const Halley::String& s) const; // Hash::hash of the contents
 	};
 }
@@ -2,13 +2,16 @@
 
 #include "halleystring.h"
 #include <map>
+#include <memory>
 #include "halley/data_structures/maybe.h"
+#include "halley/resources/resource.h"
 
 namespace Halley {
 	class ConfigNode;
 	class ConfigFile;
 	class ConfigObserver;
 	class I18N;
+	class StringTable;
 
 	class LocalisedString
 	{
@@ -38,10 +41,11 @@ namespace Halley {
 
 	private:
 		explicit LocalisedString(String string);
-		explicit LocalisedString(const I18N& i18n, String key, String string);
+		explicit LocalisedString(const I18N& i18n, String key, uint64_t keyHash, String string);
 
 		const I18N* i18n = nullptr;
 		String key;
+		uint64_t keyHash = 0;
 		String string;
 		int i18nVersion = 0;
 	};
@@ -78,15 +82,19 @@ namespace Halley {
 	class I18N {
 	public:
 		I18N();
+		I18N(const I18N& other) = delete;
+		I18N& operator=(const I18N& other) = delete;
 
 		void update();
 		void loadLocalisationFile(const ConfigFile& config);
+		void loadStringTable(std::shared_ptr<const StringTable> table); // Searched before localisation files, latest loaded first
 
 		void setCurrentLanguage(const I18NLanguage& code);
 		void setFallbackLanguage(const I18NLanguage& code);
 		std::vector<I18NLanguage> getLanguagesAvailable() const;
 
 		LocalisedString get(const String& key) const;
+		LocalisedString get(const String& key, uint64_t keyHash) const; // keyHash from StringTable::hashKey(key)
 		LocalisedString getPreProcessedUserString(const String& string) const;
 
 		template <typename T>
@@ -105,13 +113,26 @@ namespace Halley {
 		char getDecimalSeparator() const;
 
 	private:
+		struct LoadedStringTable
+		{
+			std::shared_ptr<const StringTable> table;
+			ResourceObserver observer;
+			I18NLanguage language;
+		};
+
 		I18NLanguage currentLanguage;
 		Maybe<I18NLanguage> fallbackLanguage;
 		std::map<I18NLanguage, std::map<String, String>> strings;
 		std::map<String, ConfigObserver> observers;
+		bool localisationChanged = false;
+		std::vector<LoadedStringTable> stringTables;
+		std::vector<const StringTable*> currentTables;
+		std::vector<const StringTable*> fallbackTables;
 		int version = 0;
 
 		void loadLocalisation(const ConfigNode& node);
+		void updateLanguageTables();
+		bool find(const I18NLanguage& language, const std::vector<const StringTable*>& tables, const String& key, uint64_t keyHash, String& result) const;
 	};
 }
 
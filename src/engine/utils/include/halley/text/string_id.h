@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include "halleystring.h"
+
+namespace Halley {
+	// Interned string, which compares and hashes as the 64-bit hash of its contents.
+	// Constructing one hashes the string and interns it (once per distinct string, under a lock), so keep ids around instead of making them on every use.
+	// StringId::hash() is constexpr, for comparing against literals (e.g. in a switch) without any interning.
+	class StringId {
+	public:
+		StringId() = default;
+		explicit StringId(const String& str);
+		explicit StringId(const char* str);
+		explicit StringId(StringView str);
+
+		// FNV-1a
+		constexpr static uint64_t hash(const char* str, size_t len)
+		{
+			uint64_t result = 0xcbf29ce484222325ull;
+			for (size_t i = 0; i < len; ++i) {
+				result = (result ^ uint64_t(uint8_t(str[i]))) * 0x100000001b3ull;
+			}
+			return result;
+		}
+
+		constexpr static uint64_t hash(const char* str)
+		{
+			size_t len = 0;
+			while (str[len] != 0) {
+				++len;
+			}
+			return hash(str, len);
+		}
+
+		static uint64_t hash(const String& str)
+		{
+			return hash(str.c_str(), str.size());
+		}
+
+		uint64_t getHash() const { return value; }
+		const String& getString() const;
+		bool isEmpty() const { return str == nullptr; }
+
+		bool operator==(const StringId& other) const { return value == other.value; }
+		bool operator!=(const StringId& other) const { return value != other.value; }
+		bool operator<(const StringId& other) const { return value < other.value; }
+
+	private:
+		uint64_t value = 0;
+		const String* str = nullptr;
+
+		void intern(const char* s, size_t len);
+	};
+}
+
+namespace std {
+	template<>
+	struct hash<Halley::StringId>
+	{
+		size_t operator()(const Halley::StringId& v) const noexcept
+		{
+			return size_t(v.getHash());
+		}
+	};
+}
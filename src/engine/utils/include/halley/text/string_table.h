@@ -0,0 +1,54 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <gsl/gsl>
+#include "halleystring.h"
+#include "string_view.h"
+#include "halley/resources/resource.h"
+#include "halley/utils/utils.h"
+
+namespace Halley
+{
+	class ResourceLoader;
+	class ResourceDataStatic;
+
+	// The localised strings of one language, packed at import time into a single block that's used in place (straight from the asset
+	// pack's memory, when it's stored uncompressed), so loading doesn't build a map or allocate a String per entry.
+	// Keys are found through a minimal perfect hash built with the table: a lookup is one hash of the key, two probes and a key comparison.
+	// Lookups can take a precomputed key hash (see hashKey), which is how LocalisedString refreshes itself without rehashing its key.
+	class StringTable : public Resource
+	{
+	public:
+		StringTable();
+		explicit StringTable(Bytes data);
+
+		static Bytes build(const String& languageCode, const std::map<String, String>& strings);
+		static uint64_t hashKey(StringView key); // Stable across versions, as it's stored in the tables
+
+		StringView getLanguageCode() const;
+		size_t size() const;
+
+		bool find(StringView key, StringView& value) const;
+		bool find(uint64_t keyHash, StringView key, StringView& value) const;
+
+		static std::unique_ptr<StringTable> loadResource(ResourceLoader& loader);
+		constexpr static AssetType getAssetType() { return AssetType::StringTable; }
+		void reload(Resource&& resource) override;
+		size_t getMemoryUsage() const override;
+
+	private:
+		Bytes ownData;
+		std::shared_ptr<ResourceDataStatic> dataOwner;
+		gsl::span<const gsl::byte> data;
+
+		uint32_t count = 0;
+		uint32_t bucketCount = 0;
+		const gsl::byte* seeds = nullptr;
+		const gsl::byte* entries = nullptr;
+		const char* strings = nullptr;
+		StringView languageCode;
+
+		void setData(gsl::span<const gsl::byte> data, const String& name);
+	};
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <halley/data_structures/vector.h>
+
+namespace Halley {
+	class String;
+
+	// A range of characters owned by something else, usually a String, which must outlive it and not be changed while it's in use.
+	// Taking parts of it (left, mid, split...) doesn't allocate, so it's what to parse, compare and build ids with, only turning the
+	// result into a String when it needs to be kept.
+	// It isn't null terminated, so there's no c_str(); make a String from it for APIs that need one.
+	class StringView {
+	public:
+		constexpr static size_t npos = size_t(-1);
+
+		constexpr StringView() = default;
+		constexpr StringView(const char* str, size_t len) : str(str), len(len) {}
+		StringView(const char* str) : str(str), len(str ? strlen(str) : 0) {}
+		StringView(const std::string& str) : str(str.data()), len(str.size()) {}
+		StringView(const String& str); // In halleystring.h
+
+		const char* data() const { return str; }
+		size_t size() const { return len; }
+		size_t length() const { return len; }
+		bool isEmpty() const { return len == 0; }
+		const char* begin() const { return str; }
+		const char* end() const { return str + len; }
+		char operator[](size_t pos) const { return str[pos]; }
+
+		// Same clamping as String's
+		StringView substr(size_t pos, size_t count = npos) const
+		{
+			if (pos >= len) {
+				return StringView();
+			}
+			return StringView(str + pos, std::min(count, len - pos));
+		}
+		StringView left(size_t n) const { return substr(0, n); }
+		StringView right(size_t n) const { return n >= len ? *this : StringView(str + len - n, n); }
+		StringView mid(size_t start, size_t count = npos) const { return substr(start, count); }
+
+		size_t find(char character, size_t pos = 0) const
+		{
+			for (size_t i = pos; i < len; ++i) {
+				if (str[i] == character) {
+					return i;
+				}
+			}
+			return npos;
+		}
+
+		size_t find(StringView other, size_t pos = 0) const
+		{
+			if (other.len > len) {
+				return npos;
+			}
+			for (size_t i = pos; i + other.len <= len; ++i) {
+				if (memcmp(str + i, other.str, other.len) == 0) {
+					return i;
+				}
+			}
+			return npos;
+		}
+
+		size_t find_last_of(char character) const
+		{
+			for (size_t i = len; i > 0; --i) {
+				if (str[i - 1] == character) {
+					return i - 1;
+				}
+			}
+			return npos;
+		}
+
+		bool contains(StringView other) const { return find(other) != npos; }
+		bool startsWith(StringView other) const { return other.len <= len && memcmp(str, other.str, other.len) == 0; }
+		bool endsWith(StringView other) const { return other.len <= len && memcmp(str + len - other.len, other.str, other.len) == 0; }
+
+		// Always at least one part, like String::split
+		Vector<StringView> split(char delimiter) const
+		{
+			Vector<StringView> result;
+			result.reserve(size_t(std::count(begin(), end(), delimiter)) + 1);
+			size_t startPos = 0;
+			while (true) {
+				const size_t endPos = find(delimiter, startPos);
+				if (endPos == npos) {
+					result.push_back(substr(startPos));
+					return result;
+				}
+				result.push_back(substr(startPos, endPos - startPos));
+				startPos = endPos + 1;
+			}
+		}
+
+		int compare(StringView other) const
+		{
+			const int result = len > 0 && other.len > 0 ? memcmp(str, other.str, std::min(len, other.len)) : 0;
+			if (result != 0) {
+				return result;
+			}
+			return len < other.len ? -1 : (len > other.len ? 1 : 0);
+		}
+
+	private:
+		const char* str = nullptr;
+		size_t len = 0;
+	};
+
+	inline bool operator==(StringView a, StringView b) { return a.size() == b.size() && (a.size() == 0 || memcmp(a.data(), b.data(), a.size()) == 0); }
+	inline bool operator!=(StringView a, StringView b) { return !(a == b); }
+	inline bool operator<(StringView a, StringView b) { return a.compare(b) < 0; }
+}
+
+namespace std {
+	template<>
+	struct hash<Halley::StringView>
+	{
+		size_t operator()(Halley::StringView s) const; // Same as hash<Halley::String> of the same contents
+	};
+}
+
+namespace Halley {
+	// Transparent hash and equality, for hash tables with String keys (such as FlatHashMap) to be searched by StringView without copying
+	struct StringViewHash
+	{
+		using is_transparent = void;
+		size_t operator()(StringView s) const { return std::hash<StringView>()(s); }
+	};
+
+	struct StringViewEqual
+	{
+		using is_transparent = void;
+		bool operator()(StringView a, StringView b) const { return a == b; }
+	};
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <gsl/gsl>
 #include "utils.h"
 
 namespace Halley {
@@ -7,7 +9,26 @@ namespace Halley {
 
 	class Encrypt {
 	public:
+		// AES-128 in CBC mode, with PKCS7 padding. The whole buffer has to be processed at once.
 		static Bytes encrypt(const Bytes& iv, const String& key, const Bytes& data);
 		static Bytes decrypt(const Bytes& iv, const String& key, const Bytes& data);
+
+		// AES-128 in counter mode. Encrypting and decrypting are the same operation, and any range can be processed on its own
+		// given its offset into the stream, so data can be decrypted on demand and from several threads at once.
+		// Uses AES-NI or ARMv8 crypto instructions where available.
+		class CounterMode {
+		public:
+			CounterMode(const Bytes& iv, const String& key);
+
+			void apply(gsl::span<gsl::byte> data, uint64_t offset) const;
+
+			static bool isHardwareAccelerated();
+
+		private:
+			std::array<uint8_t, 176> roundKeys;
+			std::array<uint8_t, 16> iv;
+
+			void generateKeystream(uint64_t firstBlock, size_t nBlocks, uint8_t* dst) const;
+		};
 	};
-}
\ No newline at end of file
+}
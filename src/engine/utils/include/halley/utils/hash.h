@@ -1,17 +1,18 @@
 #pragma once
 
 #include <cstdint>
+#include <array>
 #include <gsl/gsl>
 #include "utils.h"
 
-struct XXH64_state_s;
-typedef struct XXH64_state_s XXH64_state_t;
-
 namespace Halley {
+	// Hashes are fast but not cryptographic, and can change between versions of Halley, so only store them where a mismatch
+	// just means redoing work (e.g. import caches). For anything else persisted (e.g. save file headers), use hashXXH64.
     class Hash {
     public:
         static uint64_t hash(const Bytes& bytes);
         static uint64_t hash(gsl::span<const gsl::byte> bytes);
+        static uint64_t hashXXH64(gsl::span<const gsl::byte> bytes);
 		
     	template <typename T>
     	static uint64_t hashValue(const T& v)
@@ -22,6 +23,7 @@ namespace Halley {
 		static uint32_t compressTo32(uint64_t value);
 
 
+		// Gives the same result as hash() over all the bytes fed, however they're split up
 		class Hasher
 		{
 		public:
@@ -40,7 +42,14 @@ namespace Halley {
 
 		private:
 			bool ready;
-			XXH64_state_t* data;
+			bool hadBlocks;
+			uint64_t length;
+			std::array<uint64_t, 3> state;
+			size_t bufferLen;
+			std::array<uint8_t, 48> buffer;
+			std::array<uint8_t, 16> lastBlockEnd; // Short tails are read overlapping the data before them
+
+			void reset();
 		};
     };
 }
@@ -0,0 +1,337 @@
+#include "halley/audio/polyphase_resampler.h"
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386)
+#define HAS_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace Halley;
+
+struct AudioPolyphaseResampler::FilterTable
+{
+	size_t taps = 0; // Always a multiple of 4
+	size_t phases = 0;
+	bool interpolated = false; // If set, there's one extra phase at the end, the same as the first one shifted by one sample
+	std::vector<float> coefficients;
+
+	const float* getPhase(size_t phase) const
+	{
+		return coefficients.data() + phase * taps;
+	}
+};
+
+namespace {
+	constexpr uint64_t maxExactPhases = 256;
+	constexpr size_t interpolatedPhases = 128;
+	constexpr size_t maxTaps = 128;
+
+	struct QualitySettings
+	{
+		size_t zeroCrossings;
+		double rolloff;
+		double beta;
+	};
+
+	QualitySettings getQualitySettings(AudioResamplerQuality quality)
+	{
+		switch (quality) {
+		case AudioResamplerQuality::Fast:
+			return { 4, 0.85, 5.0 };
+		case AudioResamplerQuality::High:
+			return { 16, 0.95, 9.0 };
+		default:
+			return { 8, 0.9, 7.0 };
+		}
+	}
+
+	uint64_t gcd(uint64_t a, uint64_t b)
+	{
+		while (b != 0) {
+			const uint64_t t = a % b;
+			a = b;
+			b = t;
+		}
+		return a;
+	}
+
+	double besselI0(double x)
+	{
+		double sum = 1.0;
+		double term = 1.0;
+		const double halfX = x * 0.5;
+		for (int k = 1; k < 50; ++k) {
+			term *= (halfX / k) * (halfX / k);
+			sum += term;
+			if (term < sum * 1e-12) {
+				break;
+			}
+		}
+		return sum;
+	}
+
+	std::shared_ptr<const AudioPolyphaseResampler::FilterTable> makeTable(size_t phases, bool interpolated, size_t taps, double cutoff, double beta)
+	{
+		constexpr double pi = 3.14159265358979323846;
+
+		auto table = std::make_shared<AudioPolyphaseResampler::FilterTable>();
+		table->taps = taps;
+		table->phases = phases;
+		table->interpolated = interpolated;
+
+		const size_t nPhases = interpolated ? phases + 1 : phases;
+		table->coefficients.resize(nPhases * taps);
+
+		const double halfWidth = double(taps / 2);
+		const double i0Beta = besselI0(beta);
+		for (size_t p = 0; p < nPhases; ++p) {
+			// Offset of the output sample past the centre tap, in input samples
+			const double offset = double(p) / double(phases);
+			float* dst = table->coefficients.data() + p * taps;
+
+			double sum = 0;
+			for (size_t j = 0; j < taps; ++j) {
+				const double x = double(j) - (halfWidth - 1) - offset;
+				const double u = x / halfWidth;
+				const double window = std::abs(u) < 1.0 ? besselI0(beta * std::sqrt(1.0 - u * u)) / i0Beta : 0.0;
+				const double t = pi * cutoff * x;
+				const double sinc = std::abs(t) < 1e-9 ? 1.0 : std::sin(t) / t;
+				const double value = cutoff * sinc * window;
+				dst[j] = float(value);
+				sum += value;
+			}
+
+			// Normalise each phase for unity gain, otherwise DC picks up a ripple at the phase rate
+			if (sum > 1e-9) {
+				for (size_t j = 0; j < taps; ++j) {
+					dst[j] = float(dst[j] / sum);
+				}
+			}
+		}
+
+		return table;
+	}
+
+	std::shared_ptr<const AudioPolyphaseResampler::FilterTable> getTable(size_t phases, bool interpolated, size_t taps, double cutoff, AudioResamplerQuality quality)
+	{
+		// Every emitter with a pitch shift gets its own resampler, so share tables for as long as anyone is using them
+		using Key = std::tuple<size_t, bool, size_t, int64_t, int>;
+		static std::mutex mutex;
+		static std::map<Key, std::weak_ptr<const AudioPolyphaseResampler::FilterTable>> tables;
+
+		const Key key(phases, interpolated, taps, std::llround(cutoff * 1000000.0), int(quality));
+		std::unique_lock<std::mutex> lock(mutex);
+		auto& entry = tables[key];
+		auto table = entry.lock();
+		if (!table) {
+			table = makeTable(phases, interpolated, taps, cutoff, getQualitySettings(quality).beta);
+			entry = table;
+
+			// Clean up whatever expired
+			for (auto iter = tables.begin(); iter != tables.end(); ) {
+				if (iter->second.expired()) {
+					iter = tables.erase(iter);
+				} else {
+					++iter;
+				}
+			}
+		}
+		return table;
+	}
+
+	float dotProduct(const float* a, const float* b, size_t n)
+	{
+#if defined(HAS_SSE)
+		__m128 acc0 = _mm_setzero_ps();
+		__m128 acc1 = _mm_setzero_ps();
+		size_t i = 0;
+		for (; i + 8 <= n; i += 8) {
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+		}
+		if (i < n) {
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+		}
+		__m128 sum = _mm_add_ps(acc0, acc1);
+		__m128 shuf = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1));
+		sum = _mm_add_ps(sum, shuf);
+		shuf = _mm_movehl_ps(shuf, sum);
+		sum = _mm_add_ss(sum, shuf);
+		return _mm_cvtss_f32(sum);
+#elif defined(HAS_NEON)
+		float32x4_t acc = vdupq_n_f32(0.0f);
+		for (size_t i = 0; i < n; i += 4) {
+			acc = vmlaq_f32(acc, vld1q_f32(a + i), vld1q_f32(b + i));
+		}
+		const float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+		return vget_lane_f32(vpadd_f32(pair, pair), 0);
+#else
+		float acc[4] = { 0, 0, 0, 0 };
+		for (size_t i = 0; i < n; i += 4) {
+			for (size_t j = 0; j < 4; ++j) {
+				acc[j] += a[i + j] * b[i + j];
+			}
+		}
+		return acc[0] + acc[1] + acc[2] + acc[3];
+#endif
+	}
+}
+
+AudioPolyphaseResampler::AudioPolyphaseResampler(int from, int to, size_t nChannels, AudioResamplerQuality quality)
+	: channels(nChannels)
+{
+	Expects(from > 0);
+	Expects(to > 0);
+	Expects(nChannels > 0);
+
+	const uint64_t div = gcd(uint64_t(from), uint64_t(to));
+	upFactor = uint64_t(to) / div;
+	downFactor = uint64_t(from) / div;
+	stepInt = size_t(downFactor / upFactor);
+	stepFrac = downFactor % upFactor;
+
+	if (upFactor != downFactor) {
+		const auto settings = getQualitySettings(quality);
+		const bool interpolated = upFactor > maxExactPhases;
+
+		// When going down, the filter has to be stretched to cut off at the output's Nyquist frequency
+		double scale = std::min(1.0, double(upFactor) / double(downFactor));
+		if (interpolated) {
+			// Keeps the number of distinct tables down, as pitch shifts can produce any ratio
+			scale = std::max(1.0, std::floor(scale * 64.0)) / 64.0;
+		}
+		const size_t taps = std::min(maxTaps, (size_t(std::ceil(2 * settings.zeroCrossings / scale)) + 3) / 4 * 4);
+		const size_t phases = interpolated ? interpolatedPhases : size_t(upFactor);
+		table = getTable(phases, interpolated, taps, settings.rolloff * scale, quality);
+	}
+
+	reset();
+}
+
+AudioPolyphaseResampler::~AudioPolyphaseResampler() = default;
+
+AudioResamplerResult AudioPolyphaseResampler::resample(gsl::span<const float> src, gsl::span<float> dst, size_t channel)
+{
+	return process(channels.at(channel), src.data(), size_t(src.size()), 1, dst.data(), size_t(dst.size()), 1);
+}
+
+AudioResamplerResult AudioPolyphaseResampler::resampleInterleaved(gsl::span<const float> src, gsl::span<float> dst)
+{
+	const size_t nChannels = channels.size();
+	const size_t srcLen = size_t(src.size()) / nChannels;
+	const size_t dstLen = size_t(dst.size()) / nChannels;
+
+	AudioResamplerResult result = { 0, 0 };
+	for (size_t i = 0; i < nChannels; ++i) {
+		result = process(channels[i], src.data() + i, srcLen, nChannels, dst.data() + i, dstLen, nChannels);
+	}
+	return result;
+}
+
+size_t AudioPolyphaseResampler::getInputSamplesNeeded(size_t numOutputSamples) const
+{
+	return getInputSamplesNeeded(channels[0], numOutputSamples);
+}
+
+size_t AudioPolyphaseResampler::numOutputSamples(size_t numInputSamples) const
+{
+	return size_t(uint64_t(numInputSamples) * upFactor / downFactor);
+}
+
+void AudioPolyphaseResampler::reset()
+{
+	// Half a filter of silence in front, so that the first output lines up with the first input
+	const size_t history = table ? table->taps / 2 - 1 : 0;
+	for (auto& c: channels) {
+		c.buffer.assign(history, 0.0f);
+		c.pos = 0;
+		c.phase = 0;
+	}
+}
+
+size_t AudioPolyphaseResampler::getInputSamplesNeeded(const ChannelState& state, size_t numOutputSamples) const
+{
+	if (numOutputSamples == 0) {
+		return 0;
+	}
+	if (!table) {
+		return numOutputSamples;
+	}
+
+	const uint64_t lastPhase = state.phase + uint64_t(numOutputSamples - 1) * downFactor;
+	const size_t end = state.pos + size_t(lastPhase / upFactor) + table->taps;
+	return end > state.buffer.size() ? end - state.buffer.size() : 0;
+}
+
+AudioResamplerResult AudioPolyphaseResampler::process(ChannelState& state, const float* src, size_t srcLen, size_t srcStride, float* dst, size_t dstLen, size_t dstStride)
+{
+	AudioResamplerResult result;
+
+	if (!table) {
+		// Same rate, just copy
+		const size_t n = std::min(srcLen, dstLen);
+		for (size_t i = 0; i < n; ++i) {
+			dst[i * dstStride] = src[i * srcStride];
+		}
+		result.nRead = n;
+		result.nWritten = n;
+		return result;
+	}
+
+	// Only take in as much as is needed, so callers can ask for exact amounts
+	auto& buffer = state.buffer;
+	const size_t nRead = std::min(srcLen, getInputSamplesNeeded(state, dstLen));
+	const size_t start = buffer.size();
+	buffer.resize(start + nRead);
+	for (size_t i = 0; i < nRead; ++i) {
+		buffer[start + i] = src[i * srcStride];
+	}
+
+	const size_t taps = table->taps;
+	size_t nWritten = 0;
+	while (nWritten < dstLen && state.pos + taps <= buffer.size()) {
+		dst[nWritten * dstStride] = filterSample(buffer.data() + state.pos, state.phase);
+		++nWritten;
+
+		state.pos += stepInt;
+		state.phase += stepFrac;
+		if (state.phase >= upFactor) {
+			state.phase -= upFactor;
+			++state.pos;
+		}
+	}
+
+	// Keep only what's still needed for the next outputs
+	const size_t consumed = std::min(state.pos, buffer.size());
+	buffer.erase(buffer.begin(), buffer.begin() + consumed);
+	state.pos -= consumed;
+
+	result.nRead = nRead;
+	result.nWritten = nWritten;
+	return result;
+}
+
+float AudioPolyphaseResampler::filterSample(const float* src, uint64_t phase) const
+{
+	const size_t taps = table->taps;
+	if (!table->interpolated) {
+		return dotProduct(src, table->getPhase(size_t(phase)), taps);
+	}
+
+	// Too many phases to store them all, so blend the two nearest ones
+	const double t = double(phase) * double(table->phases) / double(upFactor);
+	const size_t idx = std::min(size_t(t), table->phases - 1);
+	const float frac = float(t - double(idx));
+	const float a = dotProduct(src, table->getPhase(idx), taps);
+	const float b = dotProduct(src, table->getPhase(idx + 1), taps);
+	return a + (b - a) * frac;
+}
@@ -1,10 +1,41 @@
 #include <cstring>
+#include <algorithm>
 #include <string>
 #include "halley/bytes/byte_serializer.h"
 #include "halley/text/halleystring.h"
 
 using namespace Halley;
 
+SerializedChunks::SerializedChunks(Bytes bytes)
+{
+	append(std::move(bytes));
+}
+
+void SerializedChunks::append(Bytes bytes)
+{
+	if (!bytes.empty()) {
+		size += bytes.size();
+		chunks.push_back(std::make_shared<const Bytes>(std::move(bytes)));
+	}
+}
+
+void SerializedChunks::append(const SerializedChunks& other)
+{
+	chunks.insert(chunks.end(), other.chunks.begin(), other.chunks.end());
+	size += other.size;
+}
+
+Bytes SerializedChunks::toBytes() const
+{
+	Bytes result(size);
+	size_t pos = 0;
+	for (auto& c: chunks) {
+		memcpy(result.data() + pos, c->data(), c->size());
+		pos += c->size();
+	}
+	return result;
+}
+
 Serializer::Serializer()
 	: dryRun(true)
 {}
@@ -14,6 +45,43 @@ Serializer::Serializer(gsl::span<gsl::byte> dst)
 	, dst(dst)
 {}
 
+Serializer::Serializer(SerializedChunks& dst, size_t chunkSize)
+	: dryRun(false)
+	, chunks(&dst)
+	, chunkSize(chunkSize)
+{
+	Expects(chunkSize >= sizeof(uint64_t));
+}
+
+Serializer::~Serializer()
+{
+	flush();
+}
+
+void Serializer::flush()
+{
+	if (chunks && pos > 0) {
+		if (pos == chunk.size()) {
+			chunks->append(std::move(chunk));
+		} else {
+			// Copied to its actual size, rather than keeping a whole chunk's capacity around for the rest of it
+			chunks->append(Bytes(chunk.begin(), chunk.begin() + pos));
+		}
+		chunk = Bytes();
+		dst = gsl::span<gsl::byte>();
+		pos = 0;
+	}
+}
+
+void Serializer::nextChunk()
+{
+	// Values never straddle chunks, so this wastes at most the size of the value that didn't fit
+	flush();
+	chunk.resize(chunkSize);
+	dst = gsl::as_writeable_bytes(gsl::span<Byte>(chunk));
+	pos = 0;
+}
+
 Serializer& Serializer::operator<<(const std::string& str)
 {
 	const unsigned int sz = static_cast<unsigned int>(str.size());
@@ -27,6 +95,14 @@ Serializer& Serializer::operator<<(const String& str)
 	return (*this << str.cppStr());
 }
 
+Serializer& Serializer::operator<<(StringView str)
+{
+	const unsigned int sz = static_cast<unsigned int>(str.size());
+	*this << sz;
+	*this << gsl::as_bytes(gsl::span<const char>(str.data(), sz));
+	return *this;
+}
+
 Serializer& Serializer::operator<<(const Path& path)
 {
 	return (*this << path.string());
@@ -35,9 +111,26 @@ Serializer& Serializer::operator<<(const Path& path)
 Serializer& Serializer::operator<<(gsl::span<const gsl::byte> span)
 {
 	if (!dryRun) {
-		memcpy(dst.data() + size, span.data(), span.size_bytes());
+		if (chunks) {
+			// Split over as many chunks as needed
+			size_t done = 0;
+			const size_t total = size_t(span.size_bytes());
+			while (done < total) {
+				if (pos == size_t(dst.size())) {
+					nextChunk();
+				}
+				const size_t n = std::min(total - done, size_t(dst.size()) - pos);
+				memcpy(dst.data() + pos, span.data() + done, n);
+				pos += n;
+				done += n;
+			}
+		} else {
+			memcpy(dst.data() + pos, span.data(), span.size_bytes());
+			pos += span.size_bytes();
+		}
 	}
 	size += span.size_bytes();
+	bitOffset = 0;
 	return *this;
 }
 
@@ -45,14 +138,43 @@ Serializer& Serializer::operator<<(const Bytes& bytes)
 {
 	const unsigned int byteSize = static_cast<unsigned int>(bytes.size());
 	*this << byteSize;
+	return *this << gsl::as_bytes(gsl::span<const Byte>(bytes));
+}
 
-	if (!dryRun) {
-		memcpy(dst.data() + size, bytes.data(), bytes.size());
+Serializer& Serializer::writeBits(uint64_t value, int nBits)
+{
+	Expects(nBits > 0 && nBits <= 64);
+
+	while (nBits > 0) {
+		if (bitOffset == 0) {
+			if (!dryRun) {
+				*getWritePtr(1) = gsl::byte(0);
+			}
+			++size;
+		}
+
+		const int n = std::min(nBits, 8 - bitOffset);
+		if (!dryRun) {
+			const auto mask = uint64_t((1 << n) - 1);
+			dst[pos - 1] |= gsl::byte((value & mask) << bitOffset);
+		}
+		value >>= n;
+		nBits -= n;
+		bitOffset = (bitOffset + n) % 8;
 	}
-	size += bytes.size();
 	return *this;
 }
 
+void Serializer::setVersion(int v)
+{
+	version = v;
+}
+
+int Serializer::getVersion() const
+{
+	return version;
+}
+
 Deserializer::Deserializer(gsl::span<const gsl::byte> src)
 	: pos(0)
 	, src(src)
@@ -65,6 +187,13 @@ Deserializer::Deserializer(const Bytes& src)
 {
 }
 
+Deserializer::Deserializer(gsl::span<const gsl::byte> src, bool canBorrow)
+	: pos(0)
+	, src(src)
+	, borrowing(canBorrow)
+{
+}
+
 Deserializer& Deserializer::operator>>(std::string& str)
 {
 	unsigned int sz;
@@ -95,6 +224,7 @@ Deserializer& Deserializer::operator>>(Path& p)
 
 Deserializer& Deserializer::operator>>(gsl::span<gsl::byte>& span)
 {
+	bitOffset = 0;
 	if (span.empty()) {
 		return *this;
 	}
@@ -119,6 +249,53 @@ Deserializer& Deserializer::operator>>(Bytes& bytes)
 	return *this;
 }
 
+Deserializer& Deserializer::operator>>(StringView& str)
+{
+	Expects(borrowing);
+
+	unsigned int sz;
+	*this >> sz;
+	ensureSufficientBytesRemaining(sz);
+
+	str = StringView(reinterpret_cast<const char*>(src.data() + pos), sz);
+	pos += sz;
+	return *this;
+}
+
+Deserializer& Deserializer::borrow(gsl::span<const gsl::byte>& bytes)
+{
+	Expects(borrowing);
+
+	unsigned int sz;
+	*this >> sz;
+	ensureSufficientBytesRemaining(sz);
+
+	bytes = src.subspan(pos, sz);
+	pos += sz;
+	return *this;
+}
+
+uint64_t Deserializer::readBits(int nBits)
+{
+	Expects(nBits > 0 && nBits <= 64);
+
+	uint64_t result = 0;
+	int nRead = 0;
+	while (nRead < nBits) {
+		if (bitOffset == 0) {
+			ensureSufficientBytesRemaining(1);
+			++pos;
+		}
+
+		const int n = std::min(nBits - nRead, 8 - bitOffset);
+		const auto byte = uint64_t(uint8_t(src[pos - 1]) >> bitOffset) & uint64_t((1 << n) - 1);
+		result |= byte << nRead;
+		nRead += n;
+		bitOffset = (bitOffset + n) % 8;
+	}
+	return result;
+}
+
 void Deserializer::setVersion(int v)
 {
 	version = v;
@@ -1,6 +1,9 @@
+#include <array>
 #include <cstdlib>
+#include <cstring>
 #include <memory>
 #include "halley/bytes/compression.h"
+#include "halley/bytes/byte_serializer.h"
 //#include "../../contrib/lodepng/lodepng.h"
 #include "../../contrib/zlib/zlib.h"
 #include "halley/support/exception.h"
@@ -18,6 +21,33 @@ static void zlibFree(voidpf opaque, voidpf address)
 	free(address);
 }
 
+bool Compression::isValidCodec(const String& codec)
+{
+	return codec == "deflate" || codec == "lz4";
+}
+
+Bytes Compression::compress(gsl::span<const gsl::byte> bytes, const String& codec)
+{
+	if (codec == "deflate") {
+		return compress(bytes);
+	} else if (codec == "lz4") {
+		return compressLZ4(bytes);
+	} else {
+		throw Exception("Unknown compression codec: \"" + codec + "\"", HalleyExceptions::Compression);
+	}
+}
+
+Bytes Compression::decompress(gsl::span<const gsl::byte> bytes, const String& codec, size_t maxSize)
+{
+	if (codec == "deflate") {
+		return decompress(bytes, maxSize);
+	} else if (codec == "lz4") {
+		return decompressLZ4(bytes, maxSize);
+	} else {
+		throw Exception("Unknown compression codec: \"" + codec + "\"", HalleyExceptions::Compression);
+	}
+}
+
 Bytes Compression::compress(const Bytes& bytes)
 {
 	return compress(gsl::as_bytes(gsl::span<const Byte>(bytes)));
@@ -28,6 +58,44 @@ Bytes Compression::compress(gsl::span<const gsl::byte> bytes)
 	return compressRaw(bytes, true);
 }
 
+Bytes Compression::compress(const SerializedChunks& chunks)
+{
+	z_stream stream;
+	stream.zalloc = &zlibAlloc;
+	stream.zfree = &zlibFree;
+	stream.opaque = nullptr;
+	int res = deflateInit(&stream, Z_DEFAULT_COMPRESSION);
+	if (res != Z_OK) {
+		throw Exception("Unable to initialize zlib compression", HalleyExceptions::Compression);
+	}
+
+	const uint64_t inSize = chunks.getSize();
+	Bytes result(8 + size_t(deflateBound(&stream, uLong(inSize))));
+	memcpy(result.data(), &inSize, 8);
+	stream.avail_out = uInt(result.size() - 8);
+	stream.next_out = result.data() + 8;
+
+	const auto& inputs = chunks.getChunks();
+	for (size_t i = 0; i <= inputs.size(); ++i) {
+		const bool last = i == inputs.size();
+		stream.avail_in = last ? 0 : uInt(inputs[i]->size());
+		stream.next_in = last ? nullptr : const_cast<unsigned char*>(inputs[i]->data());
+		do {
+			res = deflate(&stream, last ? Z_FINISH : Z_NO_FLUSH);
+			if (res == Z_STREAM_ERROR || (res == Z_BUF_ERROR && stream.avail_out == 0)) {
+				deflateEnd(&stream);
+				throw Exception("Unable to compress data.", HalleyExceptions::Compression);
+			}
+		} while (last ? res != Z_STREAM_END : stream.avail_in > 0);
+	}
+
+	const size_t outSize = size_t(stream.total_out);
+	deflateEnd(&stream);
+
+	result.resize(8 + outSize);
+	return result;
+}
+
 Bytes Compression::decompress(const Bytes& bytes, size_t maxSize)
 {
 	return decompress(gsl::as_bytes(gsl::span<const Byte>(bytes)), maxSize);
@@ -50,7 +118,12 @@ static void deleter(const char* data)
 
 std::shared_ptr<const char> Compression::decompressToSharedPtr(gsl::span<const gsl::byte> bytes, size_t& size, size_t maxSize)
 {
-	auto out = decompress(bytes, maxSize);
+	return decompressToSharedPtr(bytes, "deflate", size, maxSize);
+}
+
+std::shared_ptr<const char> Compression::decompressToSharedPtr(gsl::span<const gsl::byte> bytes, const String& codec, size_t& size, size_t maxSize)
+{
+	auto out = decompress(bytes, codec, maxSize);
 	
 	size = out.size();
 	auto rawResult = new char[out.size()];
@@ -168,3 +241,225 @@ Bytes Compression::decompressRaw(gsl::span<const gsl::byte> bytes, size_t maxSiz
 		return result;
 	}
 }
+
+namespace {
+	constexpr size_t lz4MinMatch = 4;
+	constexpr size_t lz4LastLiterals = 5; // The format requires the last 5 bytes to be literals...
+	constexpr size_t lz4MatchFindLimit = 12; // ...and the last match to start at least 12 bytes before the end
+	constexpr size_t lz4MaxOffset = 65535;
+	constexpr int lz4HashLog = 16;
+
+	uint32_t read32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, 4);
+		return v;
+	}
+
+	uint32_t lz4Hash(uint32_t v)
+	{
+		return (v * 2654435761u) >> (32 - lz4HashLog);
+	}
+
+	uint8_t* writeLength(uint8_t* dst, size_t len)
+	{
+		while (len >= 255) {
+			*dst++ = 255;
+			len -= 255;
+		}
+		*dst++ = uint8_t(len);
+		return dst;
+	}
+
+	uint8_t* writeSequence(uint8_t* dst, const uint8_t* literals, size_t nLiterals, size_t offset, size_t matchLen)
+	{
+		uint8_t& token = *dst++;
+		token = uint8_t(std::min(nLiterals, size_t(15)) << 4);
+		if (nLiterals >= 15) {
+			dst = writeLength(dst, nLiterals - 15);
+		}
+		if (nLiterals > 0) {
+			memcpy(dst, literals, nLiterals);
+			dst += nLiterals;
+		}
+
+		if (matchLen > 0) {
+			*dst++ = uint8_t(offset & 0xFF);
+			*dst++ = uint8_t(offset >> 8);
+			const size_t len = matchLen - lz4MinMatch;
+			token |= uint8_t(std::min(len, size_t(15)));
+			if (len >= 15) {
+				dst = writeLength(dst, len - 15);
+			}
+		}
+		return dst;
+	}
+
+	bool readLength(const uint8_t*& src, const uint8_t* srcEnd, size_t& len)
+	{
+		uint8_t b;
+		do {
+			if (src == srcEnd) {
+				return false;
+			}
+			b = *src++;
+			len += b;
+		} while (b == 255);
+		return true;
+	}
+}
+
+Bytes Compression::compressLZ4(gsl::span<const gsl::byte> bytes)
+{
+	const uint64_t inSize = bytes.size_bytes();
+	const size_t n = size_t(inSize);
+	const auto src = reinterpret_cast<const uint8_t*>(bytes.data());
+
+	// Worst case is all literals: one extra length byte per 255 of them, plus the token
+	Bytes result(8 + n + n / 255 + 16);
+	memcpy(result.data(), &inSize, 8);
+	uint8_t* dst = result.data() + 8;
+
+	size_t anchor = 0;
+	if (n > lz4MatchFindLimit) {
+		// Positions are stored plus one, so zero means empty
+		std::vector<uint32_t> table(size_t(1) << lz4HashLog, 0);
+		const size_t matchLimit = n - lz4LastLiterals;
+		size_t pos = 0;
+		size_t misses = 0;
+
+		while (pos < n - lz4MatchFindLimit) {
+			const uint32_t seq = read32(src + pos);
+			auto& entry = table[lz4Hash(seq)];
+			const size_t ref = entry;
+			entry = uint32_t(pos + 1);
+
+			if (ref != 0 && pos - (ref - 1) <= lz4MaxOffset && read32(src + ref - 1) == seq) {
+				const size_t matchPos = ref - 1;
+				size_t len = lz4MinMatch;
+				while (pos + len < matchLimit && src[matchPos + len] == src[pos + len]) {
+					++len;
+				}
+
+				dst = writeSequence(dst, src + anchor, pos - anchor, pos - matchPos, len);
+				pos += len;
+				anchor = pos;
+				misses = 0;
+			} else {
+				// Skip ahead faster through data that doesn't compress
+				pos += 1 + (misses++ >> 6);
+			}
+		}
+	}
+
+	dst = writeSequence(dst, src + anchor, n - anchor, 0, 0);
+	result.resize(size_t(dst - result.data()));
+	return result;
+}
+
+Bytes Compression::decompressLZ4(gsl::span<const gsl::byte> bytes, size_t maxSize)
+{
+	Expects(bytes.size_bytes() >= 8);
+	uint64_t expectedSize;
+	memcpy(&expectedSize, bytes.data(), 8);
+	if (expectedSize > uint64_t(maxSize)) {
+		throw Exception("File is too big to decompress: " + String::prettySize(expectedSize), HalleyExceptions::Compression);
+	}
+
+	auto result = Bytes(size_t(expectedSize));
+	auto src = reinterpret_cast<const uint8_t*>(bytes.data()) + 8;
+	const auto srcEnd = reinterpret_cast<const uint8_t*>(bytes.data()) + bytes.size_bytes();
+	uint8_t* const dstStart = result.data();
+	uint8_t* dst = dstStart;
+	uint8_t* const dstEnd = dstStart + result.size();
+
+	auto fail = [] () { throw Exception("Unable to decompress LZ4 stream, data is corrupt.", HalleyExceptions::Compression); };
+
+	while (src < srcEnd) {
+		const uint8_t token = *src++;
+
+		// Literals
+		size_t nLiterals = token >> 4;
+		if (nLiterals == 15 && !readLength(src, srcEnd, nLiterals)) {
+			fail();
+		}
+		if (nLiterals > size_t(srcEnd - src) || nLiterals > size_t(dstEnd - dst)) {
+			fail();
+		}
+		if (nLiterals > 0) {
+			memcpy(dst, src, nLiterals);
+			src += nLiterals;
+			dst += nLiterals;
+		}
+
+		if (src == srcEnd) {
+			// The last sequence has no match
+			break;
+		}
+
+		// Match
+		if (srcEnd - src < 2) {
+			fail();
+		}
+		const size_t offset = size_t(src[0]) | (size_t(src[1]) << 8);
+		src += 2;
+		size_t len = token & 15;
+		if (len == 15 && !readLength(src, srcEnd, len)) {
+			fail();
+		}
+		len += lz4MinMatch;
+		if (offset == 0 || offset > size_t(dst - dstStart) || len > size_t(dstEnd - dst)) {
+			fail();
+		}
+
+		const uint8_t* match = dst - offset;
+		if (offset >= len) {
+			memcpy(dst, match, len);
+			dst += len;
+		} else {
+			// Overlapping, the match repeats what it's writing
+			for (size_t i = 0; i < len; ++i) {
+				*dst++ = *match++;
+			}
+		}
+	}
+
+	if (dst != dstEnd) {
+		throw Exception("Unexpected outsize (" + toString(size_t(dst - dstStart)) + ") when decompressing LZ4, expected (" + toString(expectedSize) + ").", HalleyExceptions::Compression);
+	}
+	return result;
+}
+
+Bytes Compression::compressChunked(gsl::span<const gsl::byte> bytes, const String& codec, size_t chunkSize)
+{
+	Expects(chunkSize > 0);
+	const size_t totalSize = size_t(bytes.size_bytes());
+	const size_t numChunks = (totalSize + chunkSize - 1) / chunkSize;
+
+	std::vector<Bytes> chunks(numChunks);
+	for (size_t i = 0; i < numChunks; ++i) {
+		const size_t start = i * chunkSize;
+		chunks[i] = compress(bytes.subspan(std::ptrdiff_t(start), std::ptrdiff_t(std::min(chunkSize, totalSize - start))), codec);
+	}
+
+	ChunkedHeader header;
+	header.chunkSize = uint32_t(chunkSize);
+	header.numChunks = uint32_t(numChunks);
+	header.totalSize = totalSize;
+
+	std::vector<uint64_t> offsets(numChunks + 1);
+	uint64_t pos = sizeof(ChunkedHeader) + offsets.size() * sizeof(uint64_t);
+	for (size_t i = 0; i < numChunks; ++i) {
+		offsets[i] = pos;
+		pos += chunks[i].size();
+	}
+	offsets[numChunks] = pos;
+
+	auto result = Bytes(size_t(pos));
+	memcpy(result.data(), &header, sizeof(header));
+	memcpy(result.data() + sizeof(header), offsets.data(), offsets.size() * sizeof(uint64_t));
+	for (size_t i = 0; i < numChunks; ++i) {
+		memcpy(result.data() + offsets[i], chunks[i].data(), chunks[i].size());
+	}
+	return result;
+}
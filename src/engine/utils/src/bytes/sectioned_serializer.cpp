@@ -0,0 +1,128 @@
+#include "halley/bytes/sectioned_serializer.h"
+#include "halley/support/exception.h"
+#include <cstring>
+
+using namespace Halley;
+
+namespace {
+	constexpr uint32_t magic = 0x43455348; // "HSEC"
+}
+
+void SectionedSerializer::setSection(const String& name, Writer writer)
+{
+	Expects(writer);
+	auto& section = sections[name];
+	section.writer = std::move(writer);
+	section.dirty = true;
+}
+
+void SectionedSerializer::removeSection(const String& name)
+{
+	sections.erase(name);
+}
+
+void SectionedSerializer::markDirty(const String& name)
+{
+	getSection(name).dirty = true;
+}
+
+void SectionedSerializer::markAllDirty()
+{
+	for (auto& s: sections) {
+		s.second.dirty = true;
+	}
+}
+
+bool SectionedSerializer::isDirty(const String& name) const
+{
+	return getSection(name).dirty;
+}
+
+void SectionedSerializer::setVersion(int v)
+{
+	if (version != v) {
+		version = v;
+		markAllDirty();
+	}
+}
+
+SerializedChunks SectionedSerializer::serialize()
+{
+	for (auto& s: sections) {
+		auto& section = s.second;
+		if (section.dirty) {
+			section.data = SerializedChunks(); // Let go of the old bytes first, unless the last result still holds them
+			section.data = Serializer::toChunks(section.writer, version);
+			section.dirty = false;
+		}
+	}
+
+	const auto header = Serializer::toBytes([&] (Serializer& s)
+	{
+		s << magic << uint32_t(sections.size());
+		for (auto& section: sections) {
+			s << section.first << uint64_t(section.second.data.getSize());
+		}
+	});
+
+	SerializedChunks result;
+	result.append(Serializer::toBytes(uint32_t(header.size())));
+	result.append(header);
+	for (auto& section: sections) {
+		result.append(section.second.data);
+	}
+	return result;
+}
+
+std::map<String, gsl::span<const gsl::byte>> SectionedSerializer::deserialize(gsl::span<const gsl::byte> data)
+{
+	const auto totalSize = size_t(data.size_bytes());
+	uint32_t headerSize = 0;
+	if (totalSize < sizeof(headerSize)) {
+		throw Exception("Sectioned data is truncated.", HalleyExceptions::Utils);
+	}
+	memcpy(&headerSize, data.data(), sizeof(headerSize));
+	if (totalSize - sizeof(headerSize) < headerSize) {
+		throw Exception("Sectioned data is truncated.", HalleyExceptions::Utils);
+	}
+
+	Deserializer s(data.subspan(sizeof(headerSize), headerSize));
+	uint32_t fileMagic;
+	uint32_t count;
+	s >> fileMagic >> count;
+	if (fileMagic != magic) {
+		throw Exception("Data is not sectioned.", HalleyExceptions::Utils);
+	}
+
+	std::map<String, gsl::span<const gsl::byte>> result;
+	size_t pos = sizeof(headerSize) + headerSize;
+	for (uint32_t i = 0; i < count; ++i) {
+		String name;
+		uint64_t size;
+		s >> name >> size;
+		if (size > totalSize - pos) {
+			throw Exception("Section \"" + name + "\" is truncated.", HalleyExceptions::Utils);
+		}
+		result[name] = data.subspan(pos, size_t(size));
+		pos += size_t(size);
+	}
+	return result;
+}
+
+SectionedSerializer::Section& SectionedSerializer::getSection(const String& name)
+{
+	const auto iter = sections.find(name);
+	if (iter == sections.end()) {
+		throw Exception("Unknown section: \"" + name + "\"", HalleyExceptions::Utils);
+	}
+	return iter->second;
+}
+
+const SectionedSerializer::Section& SectionedSerializer::getSection(const String& name) const
+{
+	const auto iter = sections.find(name);
+	if (iter == sections.end()) {
+		throw Exception("Unknown section: \"" + name + "\"", HalleyExceptions::Utils);
+	}
+	return iter->second;
+}
@@ -0,0 +1,83 @@
+#include "halley/concurrency/deferred_destructor.h"
+#include "halley/concurrency/concurrent.h"
+#include "halley/concurrency/executor.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
+
+using namespace Halley;
+
+DeferredDestructor::~DeferredDestructor()
+{
+	flush();
+}
+
+void DeferredDestructor::destroyOnWorker(std::shared_ptr<void> object)
+{
+	if (object) {
+		toWorker.push_back(std::move(object));
+	}
+}
+
+void DeferredDestructor::destroyOnMainThread(std::shared_ptr<void> object)
+{
+	if (object) {
+		onMainThread.push_back(std::move(object));
+	}
+}
+
+void DeferredDestructor::destroyIncrementally(std::function<bool(Time maxTime)> step)
+{
+	Expects(step);
+	incremental.push_back(std::move(step));
+}
+
+void DeferredDestructor::update(Time maxTime)
+{
+	// Everything handed over since the last update goes to a worker in one batch
+	if (!toWorker.empty()) {
+		if (Executors::isDefined()) {
+			auto batch = std::make_shared<Vector<std::shared_ptr<void>>>(std::move(toWorker));
+			onWorkers.push_back(Concurrent::execute(Executors::getCPUAux(), [batch] () { batch->clear(); }));
+		}
+		toWorker.clear();
+	}
+	onWorkers.erase(std::remove_if(onWorkers.begin(), onWorkers.end(), [] (const Future<void>& f) { return f.isReady(); }), onWorkers.end());
+
+	const auto start = std::chrono::steady_clock::now();
+	auto getRemaining = [&] ()
+	{
+		return std::max(0.0, maxTime - std::chrono::duration<Time>(std::chrono::steady_clock::now() - start).count());
+	};
+
+	for (bool first = true; !onMainThread.empty() && (first || getRemaining() > 0); first = false) {
+		onMainThread.pop_front();
+	}
+
+	// Taking at least one step, even if the budget went on the above, so teardown always moves on
+	for (bool first = true; !incremental.empty() && (first || getRemaining() > 0); first = false) {
+		if (incremental.front()(getRemaining())) {
+			incremental.pop_front();
+		}
+	}
+}
+
+void DeferredDestructor::flush()
+{
+	for (auto& f: onWorkers) {
+		f.wait();
+	}
+	onWorkers.clear();
+	toWorker.clear();
+	onMainThread.clear();
+	while (!incremental.empty()) {
+		if (incremental.front()(std::numeric_limits<Time>::infinity())) {
+			incremental.pop_front();
+		}
+	}
+}
+
+size_t DeferredDestructor::getNumPending() const
+{
+	return toWorker.size() + onMainThread.size() + incremental.size() + onWorkers.size();
+}
@@ -1,59 +1,203 @@
+#include <algorithm>
+#include <iterator>
 #include <halley/concurrency/concurrent.h>
 #include <halley/concurrency/executor.h>
 #include <halley/support/exception.h>
 #include "halley/text/string_converter.h"
 #include "halley/support/logger.h"
+#include "halley/support/profiler.h"
+#include "halley/os/os.h"
 
 using namespace Halley;
 
 Executors* Executors::instance = nullptr;
 
+namespace {
+	struct CurrentWorker
+	{
+		const ExecutionQueue* queue = nullptr;
+		int idx = -1;
+	};
+	thread_local CurrentWorker currentWorker;
+}
+
 ExecutionQueue::ExecutionQueue()
-	: aborted(false)
+	: workerCount(0)
+	, queuedCount(0)
+	, attachedCount(0)
+	, aborted(false)
 {
 	hasTasks.store(false);
 }
 
 TaskBase ExecutionQueue::getNext()
 {
-	std::unique_lock<std::mutex> lock(mutex);
-	while (queue.empty()) {
-		if (!aborted) {
-			condition.wait(lock);
+	TaskBase value;
+	while (true) {
+		if (tryGetTask(value)) {
+			return value;
 		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [&] () { return queuedCount.load() > 0 || aborted.load(); });
 		if (aborted) {
 			queue.clear();
 			return TaskBase([] () {});
 		}
 	}
-
-	TaskBase value = queue.front();
-	queue.pop_front();
-	return value;
 }
 
 std::vector<TaskBase> ExecutionQueue::getAll()
 {
-	std::unique_lock<std::mutex> lock(mutex);
-	hasTasks.store(false);
-	std::vector<TaskBase> tasks(queue.begin(), queue.end());
-	queue.clear();
+	std::vector<TaskBase> tasks;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		hasTasks.store(false);
+		tasks.assign(std::make_move_iterator(queue.begin()), std::make_move_iterator(queue.end()));
+		queue.clear();
+	}
+
+	const int n = workerCount.load();
+	for (int i = 0; i < n; ++i) {
+		auto& worker = *workers[i];
+		std::unique_lock<std::mutex> lock(worker.mutex);
+		tasks.insert(tasks.end(), std::make_move_iterator(worker.tasks.begin()), std::make_move_iterator(worker.tasks.end()));
+		worker.tasks.clear();
+	}
+
+	queuedCount -= int(tasks.size());
 	return tasks;
 }
 
+bool ExecutionQueue::tryRunNext()
+{
+	TaskBase task;
+	if (tryGetTask(task)) {
+		HALLEY_PROFILE_SCOPE("Executor task");
+		task();
+		return true;
+	}
+	return false;
+}
+
+bool ExecutionQueue::tryGetTask(TaskBase& task)
+{
+	if (queuedCount.load() <= 0) {
+		return false;
+	}
+
+	// Own tasks first, newest first, as they're likely to still be in cache
+	const int self = getCurrentWorker();
+	if (self >= 0) {
+		auto& worker = *workers[self];
+		std::unique_lock<std::mutex> lock(worker.mutex);
+		if (!worker.tasks.empty()) {
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+			--queuedCount;
+			return true;
+		}
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!queue.empty()) {
+			task = std::move(queue.front());
+			queue.pop_front();
+			hasTasks.store(!queue.empty());
+			--queuedCount;
+			return true;
+		}
+	}
+
+	// Steal the oldest task from someone else, starting after ourselves to spread the load
+	const int n = workerCount.load();
+	for (int i = 1; i <= n; ++i) {
+		const int victim = (std::max(self, 0) + i) % n;
+		if (victim == self) {
+			continue;
+		}
+		auto& worker = *workers[victim];
+		std::unique_lock<std::mutex> lock(worker.mutex);
+		if (!worker.tasks.empty()) {
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+			--queuedCount;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+int ExecutionQueue::getCurrentWorker() const
+{
+	return currentWorker.queue == this ? currentWorker.idx : -1;
+}
+
 void ExecutionQueue::addToQueue(TaskBase task)
 {
 #if HAS_THREADS
-	std::unique_lock<std::mutex> lock(mutex);
-	queue.emplace_back(task);
-	hasTasks.store(true);
+	const int self = getCurrentWorker();
+	if (self >= 0) {
+		auto& worker = *workers[self];
+		std::unique_lock<std::mutex> lock(worker.mutex);
+		worker.tasks.emplace_back(std::move(task));
+	} else {
+		std::unique_lock<std::mutex> lock(mutex);
+		queue.emplace_back(std::move(task));
+		hasTasks.store(true);
+	}
+	++queuedCount;
 
+	{
+		// Makes sure that a sleeping worker either sees the new count or gets the notification
+		std::unique_lock<std::mutex> lock(mutex);
+	}
 	condition.notify_one();
 #else
 	task();
 #endif
 }
 
+void ExecutionQueue::addToWorker(size_t worker, TaskBase task)
+{
+#if HAS_THREADS
+	std::array<int, maxWorkers> attached;
+	int nAttached = 0;
+	const int n = workerCount.load();
+	for (int i = 0; i < n; ++i) {
+		if (workers[i]->attached) {
+			attached[nAttached++] = i;
+		}
+	}
+
+	bool queued = false;
+	if (nAttached > 0) {
+		auto& dst = *workers[attached[worker % size_t(nAttached)]];
+		std::unique_lock<std::mutex> lock(dst.mutex);
+		// Might've detached since, and then nobody would look at its deque first
+		if (dst.attached) {
+			dst.tasks.emplace_back(std::move(task));
+			queued = true;
+		}
+	}
+	if (!queued) {
+		addToQueue(std::move(task));
+		return;
+	}
+	++queuedCount;
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+	}
+	// There's no telling which sleeping thread notify_one would wake, and it's the owner that should get the first go at it
+	condition.notify_all();
+#else
+	task();
+#endif
+}
+
 Executors& Executors::get()
 {
 	if (!instance) {
@@ -72,13 +216,58 @@ size_t ExecutionQueue::threadCount() const
 	return attachedCount.load();
 }
 
-void ExecutionQueue::onAttached()
+int ExecutionQueue::onAttached()
 {
 	++attachedCount;
+
+	std::unique_lock<std::mutex> lock(mutex);
+	const int n = workerCount.load();
+	for (int i = 0; i < n; ++i) {
+		auto& worker = *workers[i];
+		std::unique_lock<std::mutex> workerLock(worker.mutex);
+		if (!worker.attached) {
+			worker.attached = true;
+			return i;
+		}
+	}
+
+	if (n >= maxWorkers) {
+		// Still works, it just won't have a deque of its own
+		return -1;
+	}
+	workers[n] = std::make_unique<WorkerQueue>();
+	workerCount.store(n + 1);
+	return n;
+}
+
+void ExecutionQueue::setWorkerThread(int worker)
+{
+	currentWorker.queue = worker >= 0 ? this : nullptr;
+	currentWorker.idx = worker;
 }
 
-void ExecutionQueue::onDetached()
+void ExecutionQueue::onDetached(int worker)
 {
+	if (worker >= 0) {
+		// Anything left on its deque goes back to everyone
+		std::deque<TaskBase> leftover;
+		{
+			auto& w = *workers[worker];
+			std::unique_lock<std::mutex> lock(w.mutex);
+			w.attached = false;
+			leftover.swap(w.tasks);
+		}
+
+		if (!leftover.empty()) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				queue.insert(queue.end(), std::make_move_iterator(leftover.begin()), std::make_move_iterator(leftover.end()));
+				hasTasks.store(true);
+			}
+			condition.notify_all();
+		}
+	}
+
 	--attachedCount;
 }
 
@@ -104,14 +293,14 @@ Executor::Executor(ExecutionQueue& queue)
 	, running(true)
 {
 #if HAS_THREADS
-	queue.onAttached();
+	workerIdx = queue.onAttached();
 #endif
 }
 
 Executor::~Executor()
 {
 #if HAS_THREADS
-	queue.onDetached();
+	queue.onDetached(workerIdx);
 #endif
 }
 
@@ -120,6 +309,7 @@ bool Executor::runPending()
 #if HAS_THREADS
 	auto tasks = queue.getAll();
 	for (auto& t : tasks) {
+		HALLEY_PROFILE_SCOPE("Executor task");
 		t();
 	}
 #endif
@@ -129,10 +319,12 @@ bool Executor::runPending()
 void Executor::runForever()
 {
 #if HAS_THREADS
+	queue.setWorkerThread(workerIdx);
 	try {
 		while (running)	{
 			auto next = queue.getNext();
 			if (running) {
+				HALLEY_PROFILE_SCOPE("Executor task");
 				next();
 			}
 		}
@@ -142,6 +334,7 @@ void Executor::runForever()
 	} catch (...) {
 		Logger::logError("Executor aborting due to unknown exception.");
 	}
+	queue.setWorkerThread(-1);
 #endif
 }
 
@@ -153,18 +346,115 @@ void Executor::stop()
 #endif
 }
 
+std::vector<std::vector<int>> ThreadPoolTopology::getPlacement(const std::vector<CPUCore>& cores) const
+{
+	std::vector<CPUCore> allowed;
+	if (!cpus.empty()) {
+		for (auto cpu: cpus) {
+			const auto iter = std::find_if(cores.begin(), cores.end(), [&] (const CPUCore& c) { return c.id == cpu; });
+			if (iter != cores.end()) {
+				allowed.push_back(*iter);
+			} else {
+				CPUCore core;
+				core.id = cpu;
+				allowed.push_back(core);
+			}
+		}
+	} else {
+		for (auto& c: cores) {
+			if ((!coreClass || c.coreClass == coreClass.get()) && (!numaNode || c.numaNode == numaNode.get())) {
+				allowed.push_back(c);
+			}
+		}
+		if (allowed.empty()) {
+			// Asked for something the hardware doesn't have, e.g. efficiency cores on a desktop CPU
+			allowed = cores;
+		}
+	}
+
+	const size_t n = threads > 0 ? threads : std::max(size_t(1), allowed.size());
+	std::vector<std::vector<int>> result(n);
+	if (allowed.empty()) {
+		return result;
+	}
+
+	std::vector<int> nodes;
+	for (auto& c: allowed) {
+		if (std::find(nodes.begin(), nodes.end(), c.numaNode) == nodes.end()) {
+			nodes.push_back(c.numaNode);
+		}
+	}
+	std::sort(nodes.begin(), nodes.end());
+	const bool spread = spreadNumaNodes && nodes.size() > 1;
+
+	if (pinToCores) {
+		// Takes a CPU from each node in turn, when spreading
+		std::vector<int> order;
+		if (spread) {
+			std::vector<std::vector<int>> byNode(nodes.size());
+			for (auto& c: allowed) {
+				byNode[std::find(nodes.begin(), nodes.end(), c.numaNode) - nodes.begin()].push_back(c.id);
+			}
+			for (size_t i = 0; order.size() < allowed.size(); ++i) {
+				for (auto& ids: byNode) {
+					if (i < ids.size()) {
+						order.push_back(ids[i]);
+					}
+				}
+			}
+		} else {
+			for (auto& c: allowed) {
+				order.push_back(c.id);
+			}
+		}
+		for (size_t i = 0; i < n; ++i) {
+			result[i] = { order[i % order.size()] };
+		}
+	} else if (spread) {
+		for (size_t i = 0; i < n; ++i) {
+			const int node = nodes[i % nodes.size()];
+			for (auto& c: allowed) {
+				if (c.numaNode == node) {
+					result[i].push_back(c.id);
+				}
+			}
+		}
+	} else if (allowed.size() < cores.size() || !cpus.empty()) {
+		std::vector<int> ids;
+		for (auto& c: allowed) {
+			ids.push_back(c.id);
+		}
+		std::fill(result.begin(), result.end(), ids);
+	}
+	return result;
+}
+
 ThreadPool::ThreadPool(const String& name, ExecutionQueue& queue, size_t n, MakeThread makeThread)
+	: ThreadPool(name, queue, std::vector<std::vector<int>>(n), std::move(makeThread))
+{
+}
+
+ThreadPool::ThreadPool(const String& name, ExecutionQueue& queue, const ThreadPoolTopology& topology, MakeThread makeThread)
+	: ThreadPool(name, queue, topology.getPlacement(OS::get().getCPUTopology()), std::move(makeThread))
+{
+}
+
+ThreadPool::ThreadPool(const String& name, ExecutionQueue& queue, std::vector<std::vector<int>> placement, MakeThread makeThread)
 	: name(name)
 {
 #if HAS_THREADS
+	const size_t n = placement.size();
 	for (size_t i = 0; i < n; i++) {
 		executors.emplace_back(std::make_unique<Executor>(queue));
 	}
 	threads.resize(n);
 
 	for (size_t i = 0; i < n; i++) {
-		threads[i] = makeThread(name + " Pool " + toString(i), [this, i]()
+		threads[i] = makeThread(name + " Pool " + toString(i), [this, i, cpus = std::move(placement[i])] ()
 		{
+			if (!cpus.empty() && !OS::get().setThreadAffinity(cpus)) {
+				Logger::logWarning("Unable to set the CPU affinity of " + this->name + " Pool " + toString(i));
+			}
 			try {
 				executors[i]->runForever();
 			} catch (std::exception& e) {
@@ -5,10 +5,123 @@
 #endif
 #include "binpack2d.hpp"
 #include <queue>
+#include <limits>
 #include "halley/support/logger.h"
 
 using namespace Halley;
 
+namespace {
+	class MaxRectsPage
+	{
+	public:
+		struct Placement
+		{
+			Rect4i rect;
+			bool rotated = false;
+			int shortSide = std::numeric_limits<int>::max();
+			int longSide = std::numeric_limits<int>::max();
+
+			bool isBetterThan(const Placement& other) const
+			{
+				return shortSide < other.shortSide || (shortSide == other.shortSide && longSide < other.longSide);
+			}
+		};
+
+		explicit MaxRectsPage(Vector2i size)
+		{
+			freeRects.push_back(Rect4i(Vector2i(), size));
+		}
+
+		Placement findPlacement(Vector2i size, bool canRotate) const
+		{
+			Placement best;
+			for (auto& free: freeRects) {
+				tryPlacement(free, size, false, best);
+				if (canRotate && size.x != size.y) {
+					tryPlacement(free, Vector2i(size.y, size.x), true, best);
+				}
+			}
+			return best;
+		}
+
+		void place(const Rect4i& used)
+		{
+			std::vector<Rect4i> next;
+			next.reserve(freeRects.size() + 4);
+			for (auto& free: freeRects) {
+				if (!free.overlaps(used)) {
+					next.push_back(free);
+					continue;
+				}
+
+				// Keep the maximal free rectangles on each side of the used one; they may overlap each other
+				if (used.getLeft() > free.getLeft()) {
+					next.push_back(Rect4i(free.getLeft(), free.getTop(), used.getLeft() - free.getLeft(), free.getHeight()));
+				}
+				if (used.getRight() < free.getRight()) {
+					next.push_back(Rect4i(used.getRight(), free.getTop(), free.getRight() - used.getRight(), free.getHeight()));
+				}
+				if (used.getTop() > free.getTop()) {
+					next.push_back(Rect4i(free.getLeft(), free.getTop(), free.getWidth(), used.getTop() - free.getTop()));
+				}
+				if (used.getBottom() < free.getBottom()) {
+					next.push_back(Rect4i(free.getLeft(), used.getBottom(), free.getWidth(), free.getBottom() - used.getBottom()));
+				}
+			}
+			freeRects = std::move(next);
+			prune();
+		}
+
+	private:
+		std::vector<Rect4i> freeRects;
+
+		static void tryPlacement(const Rect4i& free, Vector2i size, bool rotated, Placement& best)
+		{
+			if (size.x > free.getWidth() || size.y > free.getHeight()) {
+				return;
+			}
+
+			Placement candidate;
+			candidate.rect = Rect4i(free.getTopLeft(), size.x, size.y);
+			candidate.rotated = rotated;
+			const int leftoverX = free.getWidth() - size.x;
+			const int leftoverY = free.getHeight() - size.y;
+			candidate.shortSide = std::min(leftoverX, leftoverY);
+			candidate.longSide = std::max(leftoverX, leftoverY);
+			if (candidate.isBetterThan(best)) {
+				best = candidate;
+			}
+		}
+
+		static bool isContainedIn(const Rect4i& a, const Rect4i& b)
+		{
+			return a.getLeft() >= b.getLeft() && a.getTop() >= b.getTop() && a.getRight() <= b.getRight() && a.getBottom() <= b.getBottom();
+		}
+
+		void prune()
+		{
+			// Any free rectangle entirely inside another one is redundant
+			const size_t n = freeRects.size();
+			std::vector<char> redundant(n, 0);
+			for (size_t i = 0; i < n; ++i) {
+				for (size_t j = 0; j < n && !redundant[i]; ++j) {
+					if (i != j && !redundant[j] && isContainedIn(freeRects[i], freeRects[j])) {
+						redundant[i] = 1;
+					}
+				}
+			}
+
+			size_t k = 0;
+			for (size_t i = 0; i < n; ++i) {
+				if (!redundant[i]) {
+					freeRects[k++] = freeRects[i];
+				}
+			}
+			freeRects.resize(k);
+		}
+	};
+}
+
 boost::optional<Vector<BinPackResult>> BinPack::pack(const std::vector<BinPackEntry>& entries, Vector2i binSize)
 {
 	using T = void*;
@@ -86,3 +199,64 @@ boost::optional<Vector<BinPackResult>> BinPack::fastPack(const std::vector<BinPa
 
 	return result;
 }
+
+boost::optional<Vector<BinPackResult>> BinPack::maxRectsPack(const std::vector<BinPackEntry>& entries, Vector2i binSize, int maxPages)
+{
+	Expects(maxPages >= 1);
+
+	// Biggest first, which is what makes MaxRects work well without having to search the whole remaining set each time
+	std::vector<const BinPackEntry*> sorted;
+	sorted.reserve(entries.size());
+	for (auto& e: entries) {
+		sorted.push_back(&e);
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [] (const BinPackEntry* a, const BinPackEntry* b)
+	{
+		const int aMaj = std::max(a->size.x, a->size.y);
+		const int bMaj = std::max(b->size.x, b->size.y);
+		if (aMaj != bMaj) {
+			return aMaj > bMaj;
+		}
+		return a->size.x * a->size.y > b->size.x * b->size.y;
+	});
+
+	Vector<BinPackResult> results;
+	results.reserve(entries.size());
+	std::vector<MaxRectsPage> pages;
+	pages.emplace_back(binSize);
+
+	for (auto* e: sorted) {
+		if (e->size.x <= 0 || e->size.y <= 0) {
+			results.push_back(BinPackResult(Rect4i(0, 0, std::max(0, e->size.x), std::max(0, e->size.y)), false, e->data, 0));
+			continue;
+		}
+
+		int bestPage = -1;
+		MaxRectsPage::Placement best;
+		for (int i = 0; i < int(pages.size()); ++i) {
+			auto placement = pages[i].findPlacement(e->size, e->canRotate);
+			if (placement.isBetterThan(best)) {
+				best = placement;
+				bestPage = i;
+			}
+		}
+
+		if (bestPage == -1) {
+			if (int(pages.size()) >= maxPages) {
+				return {};
+			}
+			pages.emplace_back(binSize);
+			best = pages.back().findPlacement(e->size, e->canRotate);
+			if (best.rect.isEmpty()) {
+				// Doesn't fit even on an empty page
+				return {};
+			}
+			bestPage = int(pages.size()) - 1;
+		}
+
+		pages[bestPage].place(best.rect);
+		results.push_back(BinPackResult(best.rect, best.rotated, e->data, bestPage));
+	}
+
+	return results;
+}
@@ -0,0 +1,98 @@
+#include "halley/data_structures/frame_arena.h"
+#include <algorithm>
+#include <new>
+
+using namespace Halley;
+
+std::atomic<uint64_t> FrameArena::currentFrame(0);
+constexpr size_t FrameArena::minBlockSize;
+
+FrameArena::~FrameArena()
+{
+	for (auto& b: blocks) {
+		::operator delete(b.data);
+	}
+}
+
+FrameArena& FrameArena::get()
+{
+	thread_local FrameArena arena;
+	return arena;
+}
+
+void FrameArena::endFrame()
+{
+	currentFrame.fetch_add(1, std::memory_order_release);
+}
+
+void* FrameArena::allocate(size_t size, size_t alignment)
+{
+	const uint64_t now = currentFrame.load(std::memory_order_acquire);
+	if (frame != now) {
+		frame = now;
+		reset();
+	}
+
+	auto align = [&] (char* p) { return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + alignment - 1) & ~uintptr_t(alignment - 1)); };
+	char* result = top ? align(top) : nullptr;
+	if (!result || result + size > end) {
+		addBlock(size + alignment);
+		result = align(top);
+	}
+	top = result + size;
+	return result;
+}
+
+void FrameArena::deallocate(void* p, size_t size)
+{
+	// Anything from an earlier frame (or another thread's arena) is already gone, or isn't ours to reclaim
+	char* c = static_cast<char*>(p);
+	if (frame == currentFrame.load(std::memory_order_acquire) && !blocks.empty() && c >= blocks.back().data && c + size == top) {
+		top = c;
+	}
+}
+
+size_t FrameArena::getCapacity() const
+{
+	size_t total = 0;
+	for (auto& b: blocks) {
+		total += b.size;
+	}
+	return total;
+}
+
+void FrameArena::reset()
+{
+	if (blocks.empty()) {
+		return;
+	}
+
+	// A frame that needed several blocks will probably need as much again, so they're merged into one big enough for all of it
+	if (blocks.size() > 1) {
+		const size_t used = usedInPreviousBlocks + size_t(top - blocks.back().data);
+		for (auto& b: blocks) {
+			::operator delete(b.data);
+		}
+		blocks.clear();
+		top = end = nullptr;
+		usedInPreviousBlocks = 0;
+		addBlock(used);
+	}
+
+	top = blocks.back().data;
+	end = top + blocks.back().size;
+	usedInPreviousBlocks = 0;
+}
+
+void FrameArena::addBlock(size_t minSize)
+{
+	if (!blocks.empty()) {
+		usedInPreviousBlocks += size_t(top - blocks.back().data);
+	}
+
+	const size_t size = std::max(std::max(minSize, minBlockSize), blocks.empty() ? size_t(0) : blocks.back().size * 2);
+	Block block{ static_cast<char*>(::operator new(size)), size };
+	blocks.push_back(block);
+	top = block.data;
+	end = block.data + block.size;
+}
@@ -1,20 +1,22 @@
 #include <boost/pool/pool.hpp>
+#include <atomic>
+#include <memory>
 #include "halley/data_structures/memory_pool.h"
 
 using namespace Halley;
 
 PoolPool& PoolPool::get()
 {
-	static PoolPool* pools = nullptr;
-	if (!pools) {
-		pools = new PoolPool();
-	}
+	static PoolPool* pools = new PoolPool();
 	return *pools;
 }
 
 SizePool* PoolPool::getPool(size_t size)
 {
-	auto& pools = get().pools;
+	auto& instance = get();
+	std::unique_lock<std::mutex> lock(instance.mutex);
+
+	auto& pools = instance.pools;
 	auto iter = pools.find(size);
 	if (iter != pools.end()) {
 		return iter->second;
@@ -25,25 +27,275 @@ SizePool* PoolPool::getPool(size_t size)
 	return pool;
 }
 
-typedef boost::pool<boost::default_user_allocator_malloc_free> PoolType;
 
-SizePool::SizePool(size_t size)
+namespace {
+	typedef boost::pool<boost::default_user_allocator_malloc_free> PoolType;
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	struct Batch
+	{
+		FreeBlock* head;
+		size_t count;
+	};
+
+	class PoolImpl;
+
+	// Only ever touched by its own thread, other than the counters (read by getStats) and while detaching
+	struct ThreadCache
+	{
+		PoolImpl* owner = nullptr;
+		FreeBlock* head = nullptr;
+		size_t count = 0;
+		std::atomic<size_t> allocs;
+		std::atomic<size_t> frees;
+
+		ThreadCache() : allocs(0), frees(0) {}
+
+		void countAlloc() { allocs.store(allocs.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+		void countFree() { frees.store(frees.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+	};
+
+	class PoolImpl
+	{
+	public:
+		PoolImpl(size_t size, const char* name, size_t id, MemoryTag tag)
+			: name(name)
+			, blockSize(size)
+			, batchSize(std::min(size_t(256), std::max(size_t(8), size_t(8192) / std::max(size, sizeof(FreeBlock)))))
+			, id(id)
+			, tag(tag)
+			, pool(std::max(size, sizeof(FreeBlock)), batchSize)
+		{}
+
+		~PoolImpl()
+		{
+			// Whatever threads still have cached belongs to this pool's memory, so they just forget about it
+			std::unique_lock<std::mutex> lock(mutex);
+			for (auto& c: caches) {
+				c->owner = nullptr;
+				c->head = nullptr;
+				c->count = 0;
+			}
+			MemoryTracker::onFree(tag, capacity * std::max(blockSize, sizeof(FreeBlock)));
+		}
+
+		void refill(ThreadCache& cache)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!depot.empty()) {
+				auto batch = depot.back();
+				depot.pop_back();
+				depotCount -= batch.count;
+				cache.head = batch.head;
+				cache.count = batch.count;
+			} else {
+				for (size_t i = 0; i < batchSize; ++i) {
+					auto block = static_cast<FreeBlock*>(pool.malloc());
+					if (!block) {
+						throw std::bad_alloc();
+					}
+					block->next = cache.head;
+					cache.head = block;
+				}
+				cache.count += batchSize;
+				capacity += batchSize;
+				MemoryTracker::onAlloc(tag, batchSize * std::max(blockSize, sizeof(FreeBlock)));
+			}
+		}
+
+		void spill(ThreadCache& cache)
+		{
+			// Keeps the first batch, so the most recently freed blocks (the ones most likely to still be in cache) stay here
+			FreeBlock* last = cache.head;
+			for (size_t i = 1; i < batchSize; ++i) {
+				last = last->next;
+			}
+			Batch batch{ last->next, cache.count - batchSize };
+			last->next = nullptr;
+			cache.count = batchSize;
+
+			std::unique_lock<std::mutex> lock(mutex);
+			depot.push_back(batch);
+			depotCount += batch.count;
+		}
+
+		void attach(ThreadCache& cache)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			cache.owner = this;
+			caches.push_back(&cache);
+		}
+
+		void detach(ThreadCache& cache)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (cache.head) {
+				depot.push_back(Batch{ cache.head, cache.count });
+				depotCount += cache.count;
+			}
+			retiredAllocs += cache.allocs.load(std::memory_order_relaxed);
+			retiredFrees += cache.frees.load(std::memory_order_relaxed);
+			caches.erase(std::remove(caches.begin(), caches.end(), &cache), caches.end());
+			cache.owner = nullptr;
+			cache.head = nullptr;
+			cache.count = 0;
+		}
+
+		SizePool::Stats getStats() const
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			size_t allocs = retiredAllocs;
+			size_t frees = retiredFrees;
+			for (auto& c: caches) {
+				allocs += c->allocs.load(std::memory_order_relaxed);
+				frees += c->frees.load(std::memory_order_relaxed);
+			}
+
+			// Blocks can be freed on a different thread than they were allocated on, so counters are only consistent in total
+			SizePool::Stats stats;
+			stats.name = name;
+			stats.blockSize = blockSize;
+			stats.capacity = capacity;
+			stats.inUse = allocs >= frees ? std::min(allocs - frees, capacity) : 0;
+			stats.freeInDepot = depotCount;
+			stats.freeInThreadCaches = capacity - std::min(capacity, stats.inUse + depotCount);
+			return stats;
+		}
+
+		const char* const name;
+		const size_t blockSize;
+		const size_t batchSize;
+		const size_t id;
+		const MemoryTag tag;
+
+	private:
+		mutable std::mutex mutex;
+		PoolType pool;
+		std::vector<Batch> depot;
+		size_t depotCount = 0;
+		size_t capacity = 0;
+		std::vector<ThreadCache*> caches;
+		size_t retiredAllocs = 0;
+		size_t retiredFrees = 0;
+	};
+
+	// Pools are numbered as they're created, so each thread can find its cache for one with a single index
+	struct ThreadCaches
+	{
+		std::vector<std::unique_ptr<ThreadCache>> byPool;
+
+		ThreadCache& get(PoolImpl& pool)
+		{
+			if (pool.id >= byPool.size()) {
+				byPool.resize(pool.id + 1);
+			}
+			auto& cache = byPool[pool.id];
+			if (!cache) {
+				cache = std::make_unique<ThreadCache>();
+				pool.attach(*cache);
+			}
+			return *cache;
+		}
+
+		~ThreadCaches()
+		{
+			for (auto& c: byPool) {
+				if (c && c->owner) {
+					c->owner->detach(*c);
+				}
+			}
+		}
+	};
+
+	ThreadCaches& getThreadCaches()
+	{
+		thread_local ThreadCaches caches;
+		return caches;
+	}
+
+	struct PoolRegistry
+	{
+		std::mutex mutex;
+		std::vector<PoolImpl*> pools;
+		size_t nextId = 0;
+	};
+
+	PoolRegistry& getRegistry()
+	{
+		static PoolRegistry* registry = new PoolRegistry();
+		return *registry;
+	}
+}
+
+SizePool::SizePool(size_t size, const char* name, MemoryTag tag)
 	: size(size)
 {
-	pimpl = new PoolType(size);
+	auto& registry = getRegistry();
+	std::unique_lock<std::mutex> lock(registry.mutex);
+	auto impl = new PoolImpl(size, name, registry.nextId++, tag);
+	registry.pools.push_back(impl);
+	pimpl = impl;
 }
 
 SizePool::~SizePool()
 {
-	delete reinterpret_cast<PoolType*>(pimpl);
+	auto impl = reinterpret_cast<PoolImpl*>(pimpl);
+	{
+		auto& registry = getRegistry();
+		std::unique_lock<std::mutex> lock(registry.mutex);
+		registry.pools.erase(std::remove(registry.pools.begin(), registry.pools.end(), impl), registry.pools.end());
+	}
+	delete impl;
 }
 
 void* SizePool::alloc()
 {
-	return reinterpret_cast<PoolType*>(pimpl)->malloc();
+	auto& impl = *reinterpret_cast<PoolImpl*>(pimpl);
+	auto& cache = getThreadCaches().get(impl);
+	if (!cache.head) {
+		impl.refill(cache);
+	}
+
+	FreeBlock* block = cache.head;
+	cache.head = block->next;
+	--cache.count;
+	cache.countAlloc();
+	return block;
 }
 
 void SizePool::free(void* p)
 {
-	reinterpret_cast<PoolType*>(pimpl)->free(p);
+	auto& impl = *reinterpret_cast<PoolImpl*>(pimpl);
+	auto& cache = getThreadCaches().get(impl);
+
+	auto block = static_cast<FreeBlock*>(p);
+	block->next = cache.head;
+	cache.head = block;
+	++cache.count;
+	cache.countFree();
+
+	if (cache.count >= 2 * impl.batchSize) {
+		impl.spill(cache);
+	}
+}
+
+SizePool::Stats SizePool::getStats() const
+{
+	return reinterpret_cast<const PoolImpl*>(pimpl)->getStats();
+}
+
+std::vector<SizePool::Stats> SizePool::getAllStats()
+{
+	auto& registry = getRegistry();
+	std::unique_lock<std::mutex> lock(registry.mutex);
+	std::vector<Stats> result;
+	result.reserve(registry.pools.size());
+	for (auto& p: registry.pools) {
+		result.push_back(p->getStats());
+	}
+	return result;
 }
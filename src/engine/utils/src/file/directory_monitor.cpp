@@ -4,6 +4,10 @@
 
 using namespace Halley;
 
+#ifdef __APPLE__
+#include <TargetConditionals.h>
+#endif
+
 #if defined(_WIN32) && !defined(WINDOWS_STORE)
 
 #define WIN32_LEAN_AND_MEAN
@@ -15,30 +19,64 @@ namespace Halley {
 	public:
 		DirectoryMonitorPimpl(const Path& path)
 			: path(path)
+			, buffer(16 * 1024) // DWORDs, so 64 KB, which is the limit for network drives
 		{
-			handle = FindFirstChangeNotification(path.string().c_str(), true, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE);
+			dirHandle = CreateFileW(path.getString().getUTF16().c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+			overlapped = {};
+			overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+			if (dirHandle != INVALID_HANDLE_VALUE) {
+				queueRead();
+			}
 		}
 
 		~DirectoryMonitorPimpl()
 		{
-			FindCloseChangeNotification(handle);
+			if (dirHandle != INVALID_HANDLE_VALUE) {
+				if (reading) {
+					DWORD bytes;
+					CancelIo(dirHandle);
+					GetOverlappedResult(dirHandle, &overlapped, &bytes, TRUE);
+				}
+				CloseHandle(dirHandle);
+			}
+			CloseHandle(overlapped.hEvent);
 		}
 
 		bool poll()
 		{
-			bool changed = false;
+			return !getChanges().empty();
+		}
+
+		std::vector<DirectoryMonitor::Event> getChanges()
+		{
+			std::vector<DirectoryMonitor::Event> events;
+			if (dirHandle == INVALID_HANDLE_VALUE || !reading) {
+				events.emplace_back(DirectoryMonitor::ChangeType::Unknown);
+				return events;
+			}
+
 			while (true) {
-				auto result = WaitForSingleObject(handle, 0);
-				if (result == WAIT_OBJECT_0) {
-					changed = true;
-					FindNextChangeNotification(handle);
-				} else if (result == WAIT_TIMEOUT) {
+				DWORD bytes = 0;
+				if (!GetOverlappedResult(dirHandle, &overlapped, &bytes, FALSE)) {
+					const auto error = GetLastError();
+					if (error == ERROR_IO_INCOMPLETE) {
+						break;
+					}
+					events.emplace_back(DirectoryMonitor::ChangeType::Unknown);
+				} else if (bytes == 0) {
+					// The buffer overflowed, so this is all we get
+					events.emplace_back(DirectoryMonitor::ChangeType::Unknown);
+				} else {
+					readEvents(events);
+				}
+
+				reading = false;
+				queueRead();
+				if (!reading) {
 					break;
-				} else if (result == WAIT_FAILED || WAIT_ABANDONED) {
-					throw Exception("Failed to wait for object.", HalleyExceptions::Utils);
 				}
 			}
-			return changed;
+			return events;
 		}
 
 		bool hasRealImplementation() const
@@ -47,8 +85,373 @@ namespace Halley {
 		}
 
 	private:
-		HANDLE handle;
+		HANDLE dirHandle = INVALID_HANDLE_VALUE;
+		OVERLAPPED overlapped;
 		Path path;
+		std::vector<DWORD> buffer;
+		bool reading = false;
+
+		void queueRead()
+		{
+			const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE;
+			reading = ReadDirectoryChangesW(dirHandle, buffer.data(), DWORD(buffer.size() * sizeof(DWORD)), TRUE, filter, nullptr, &overlapped, nullptr) != 0;
+		}
+
+		void readEvents(std::vector<DirectoryMonitor::Event>& events)
+		{
+			String renamedFrom;
+			auto data = reinterpret_cast<const char*>(buffer.data());
+			while (true) {
+				auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(data);
+				const auto name = String(std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)).c_str()).replaceAll("\\", "/");
+
+				switch (info->Action) {
+				case FILE_ACTION_ADDED:
+					events.emplace_back(DirectoryMonitor::ChangeType::FileAdded, name);
+					break;
+				case FILE_ACTION_REMOVED:
+					events.emplace_back(DirectoryMonitor::ChangeType::FileRemoved, name);
+					break;
+				case FILE_ACTION_MODIFIED:
+					events.emplace_back(DirectoryMonitor::ChangeType::FileModified, name);
+					break;
+				case FILE_ACTION_RENAMED_OLD_NAME:
+					renamedFrom = name;
+					break;
+				case FILE_ACTION_RENAMED_NEW_NAME:
+					events.emplace_back(DirectoryMonitor::ChangeType::FileRenamed, name, renamedFrom);
+					break;
+				default:
+					events.emplace_back(DirectoryMonitor::ChangeType::Unknown, name);
+				}
+
+				if (info->NextEntryOffset == 0) {
+					break;
+				}
+				data += info->NextEntryOffset;
+			}
+		}
+	};
+}
+
+#elif defined(__linux__) && !defined(__ANDROID__)
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <map>
+
+namespace Halley {
+	class DirectoryMonitorPimpl
+	{
+	public:
+		DirectoryMonitorPimpl(const Path& path)
+			: root(path.getString())
+		{
+			fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+			if (fd >= 0 && !addWatches("")) {
+				// Ran out of watches (see /proc/sys/fs/inotify/max_user_watches), so parts of it aren't monitored
+				overflowed = true;
+			}
+		}
+
+		~DirectoryMonitorPimpl()
+		{
+			if (fd >= 0) {
+				close(fd);
+			}
+		}
+
+		bool poll()
+		{
+			return !getChanges().empty();
+		}
+
+		std::vector<DirectoryMonitor::Event> getChanges()
+		{
+			std::vector<DirectoryMonitor::Event> events;
+			if (fd < 0 || overflowed) {
+				events.emplace_back(DirectoryMonitor::ChangeType::Unknown);
+				if (fd < 0) {
+					return events;
+				}
+			}
+
+			alignas(inotify_event) char buffer[16 * 1024];
+			while (true) {
+				const auto len = read(fd, buffer, sizeof(buffer));
+				if (len <= 0) {
+					// EAGAIN, nothing else queued
+					break;
+				}
+				for (const char* p = buffer; p < buffer + len; ) {
+					auto& event = *reinterpret_cast<const inotify_event*>(p);
+					onEvent(event, events);
+					p += sizeof(inotify_event) + event.len;
+				}
+			}
+
+			// The other half of a move never came, so it went somewhere that isn't monitored
+			for (auto& m: pendingMoves) {
+				if (m.second.second) {
+					removeWatches(m.second.first);
+				}
+				events.emplace_back(DirectoryMonitor::ChangeType::FileRemoved, m.second.first);
+			}
+			pendingMoves.clear();
+
+			return events;
+		}
+
+		bool hasRealImplementation() const
+		{
+			return fd >= 0;
+		}
+
+	private:
+		constexpr static uint32_t watchMask = IN_CREATE | IN_DELETE | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+		String root;
+		int fd = -1;
+		bool overflowed = false;
+		std::map<int, String> dirs; // Relative path of each watched directory, as inotify doesn't watch recursively
+		std::map<uint32_t, std::pair<String, bool>> pendingMoves; // Moved from, by cookie, with whether it was a directory
+
+		bool addWatches(const String& dir)
+		{
+			const String fullPath = dir.isEmpty() ? root : root + "/" + dir;
+			const int wd = inotify_add_watch(fd, fullPath.c_str(), watchMask);
+			if (wd < 0) {
+				return errno != ENOSPC;
+			}
+			dirs[wd] = dir;
+
+			bool ok = true;
+			if (auto handle = opendir(fullPath.c_str())) {
+				while (auto entry = readdir(handle)) {
+					const String name = entry->d_name;
+					if (name == "." || name == "..") {
+						continue;
+					}
+					const String child = dir.isEmpty() ? name : dir + "/" + name;
+					bool isDir = entry->d_type == DT_DIR;
+					if (entry->d_type == DT_UNKNOWN) {
+						struct stat st;
+						isDir = stat((root + "/" + child).c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+					}
+					if (isDir) {
+						ok = addWatches(child) && ok;
+					}
+				}
+				closedir(handle);
+			}
+			return ok;
+		}
+
+		void removeWatches(const String& dir)
+		{
+			for (auto iter = dirs.begin(); iter != dirs.end(); ) {
+				if (iter->second == dir || iter->second.startsWith(dir + "/")) {
+					inotify_rm_watch(fd, iter->first);
+					iter = dirs.erase(iter);
+				} else {
+					++iter;
+				}
+			}
+		}
+
+		void renameWatches(const String& from, const String& to)
+		{
+			for (auto& d: dirs) {
+				if (d.second == from) {
+					d.second = to;
+				} else if (d.second.startsWith(from + "/")) {
+					d.second = to + d.second.mid(from.size());
+				}
+			}
+		}
+
+		void onEvent(const inotify_event& event, std::vector<DirectoryMonitor::Event>& events)
+		{
+			if (event.mask & IN_Q_OVERFLOW) {
+				events.emplace_back(DirectoryMonitor::ChangeType::Unknown);
+				return;
+			}
+
+			auto dirIter = dirs.find(event.wd);
+			if (dirIter == dirs.end()) {
+				return;
+			}
+			if (event.mask & IN_IGNORED) {
+				// The directory itself is gone, and its parent reports that
+				dirs.erase(dirIter);
+				return;
+			}
+			if (event.len == 0) {
+				return;
+			}
+
+			const String fileName = event.name;
+			const String name = dirIter->second.isEmpty() ? fileName : dirIter->second + "/" + fileName;
+			const bool isDir = (event.mask & IN_ISDIR) != 0;
+
+			if (event.mask & IN_CREATE) {
+				if (isDir && !addWatches(name)) {
+					overflowed = true;
+				}
+				events.emplace_back(DirectoryMonitor::ChangeType::FileAdded, name);
+			} else if (event.mask & IN_DELETE) {
+				events.emplace_back(DirectoryMonitor::ChangeType::FileRemoved, name);
+			} else if (event.mask & IN_CLOSE_WRITE) {
+				events.emplace_back(DirectoryMonitor::ChangeType::FileModified, name);
+			} else if (event.mask & IN_MOVED_FROM) {
+				pendingMoves[event.cookie] = std::make_pair(name, isDir);
+			} else if (event.mask & IN_MOVED_TO) {
+				auto moveIter = pendingMoves.find(event.cookie);
+				if (moveIter != pendingMoves.end()) {
+					if (isDir) {
+						renameWatches(moveIter->second.first, name);
+					}
+					events.emplace_back(DirectoryMonitor::ChangeType::FileRenamed, name, moveIter->second.first);
+					pendingMoves.erase(moveIter);
+				} else {
+					// Moved in from somewhere that isn't monitored
+					if (isDir && !addWatches(name)) {
+						overflowed = true;
+					}
+					events.emplace_back(DirectoryMonitor::ChangeType::FileAdded, name);
+				}
+			}
+		}
+	};
+}
+
+#elif defined(__APPLE__) && !TARGET_OS_IPHONE
+
+#include <CoreServices/CoreServices.h>
+#include <sys/stat.h>
+#include <climits>
+#include <cstdlib>
+#include <mutex>
+
+namespace Halley {
+	class DirectoryMonitorPimpl
+	{
+	public:
+		DirectoryMonitorPimpl(const Path& path)
+		{
+			// Events come with resolved paths (e.g. /private/var rather than /var), so the root has to be resolved too
+			char resolved[PATH_MAX];
+			root = realpath(path.getString().c_str(), resolved) ? String(resolved) : path.getString();
+
+			CFStringRef cfPath = CFStringCreateWithCString(nullptr, root.c_str(), kCFStringEncodingUTF8);
+			CFArrayRef paths = CFArrayCreate(nullptr, reinterpret_cast<const void**>(&cfPath), 1, &kCFTypeArrayCallBacks);
+			FSEventStreamContext context = { 0, this, nullptr, nullptr, nullptr };
+			stream = FSEventStreamCreate(nullptr, &onEvents, &context, paths, kFSEventStreamEventIdSinceNow, 0.05, kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagNoDefer);
+			CFRelease(paths);
+			CFRelease(cfPath);
+
+			if (stream) {
+				queue = dispatch_queue_create("halley.directory_monitor", DISPATCH_QUEUE_SERIAL);
+				FSEventStreamSetDispatchQueue(stream, queue);
+				if (!FSEventStreamStart(stream)) {
+					destroyStream();
+				}
+			}
+		}
+
+		~DirectoryMonitorPimpl()
+		{
+			destroyStream();
+		}
+
+		bool poll()
+		{
+			return !getChanges().empty();
+		}
+
+		std::vector<DirectoryMonitor::Event> getChanges()
+		{
+			std::vector<DirectoryMonitor::Event> events;
+			if (!stream) {
+				events.emplace_back(DirectoryMonitor::ChangeType::Unknown);
+				return events;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			std::swap(events, pending);
+			return events;
+		}
+
+		bool hasRealImplementation() const
+		{
+			return stream != nullptr;
+		}
+
+	private:
+		String root;
+		FSEventStreamRef stream = nullptr;
+		dispatch_queue_t queue = nullptr;
+
+		std::mutex mutex;
+		std::vector<DirectoryMonitor::Event> pending;
+
+		void destroyStream()
+		{
+			if (stream) {
+				FSEventStreamStop(stream);
+				FSEventStreamInvalidate(stream);
+				FSEventStreamRelease(stream);
+				stream = nullptr;
+			}
+			if (queue) {
+				// Waits for any callback still running
+				dispatch_sync_f(queue, nullptr, [] (void*) {});
+				dispatch_release(queue);
+				queue = nullptr;
+			}
+		}
+
+		static void onEvents(ConstFSEventStreamRef, void* info, size_t n, void* eventPaths, const FSEventStreamEventFlags flags[], const FSEventStreamEventId[])
+		{
+			auto& self = *static_cast<DirectoryMonitorPimpl*>(info);
+			auto paths = static_cast<char**>(eventPaths);
+
+			std::lock_guard<std::mutex> lock(self.mutex);
+			for (size_t i = 0; i < n; ++i) {
+				self.onEvent(paths[i], flags[i]);
+			}
+		}
+
+		void onEvent(const char* path, FSEventStreamEventFlags flags)
+		{
+			constexpr FSEventStreamEventFlags rescanFlags = kFSEventStreamEventFlagMustScanSubDirs | kFSEventStreamEventFlagUserDropped | kFSEventStreamEventFlagKernelDropped | kFSEventStreamEventFlagRootChanged;
+			if (flags & rescanFlags) {
+				pending.emplace_back(DirectoryMonitor::ChangeType::Unknown);
+				return;
+			}
+
+			const String fullPath = path;
+			if (!fullPath.startsWith(root + "/")) {
+				return;
+			}
+			const String name = fullPath.mid(root.size() + 1);
+
+			// Flags accumulate everything that happened to the path since the last event, and the two halves of a rename don't come
+			// with anything to pair them up, so what's there now is what counts
+			struct stat st;
+			const bool exists = lstat(path, &st) == 0;
+			if (!exists) {
+				if (flags & (kFSEventStreamEventFlagItemRemoved | kFSEventStreamEventFlagItemRenamed)) {
+					pending.emplace_back(DirectoryMonitor::ChangeType::FileRemoved, name);
+				}
+			} else if (flags & (kFSEventStreamEventFlagItemCreated | kFSEventStreamEventFlagItemRenamed)) {
+				pending.emplace_back(DirectoryMonitor::ChangeType::FileAdded, name);
+			} else if (flags & (kFSEventStreamEventFlagItemModified | kFSEventStreamEventFlagItemInodeMetaMod)) {
+				pending.emplace_back(DirectoryMonitor::ChangeType::FileModified, name);
+			}
+		}
 	};
 }
 
@@ -62,11 +465,22 @@ namespace Halley {
 		DirectoryMonitorPimpl(const Path&) {}
 		bool poll() { return true; };
 		bool hasRealImplementation() const { return false; }
+
+		std::vector<DirectoryMonitor::Event> getChanges()
+		{
+			return { DirectoryMonitor::Event(DirectoryMonitor::ChangeType::Unknown) };
+		}
 	};
 }
 
 #endif
 
+DirectoryMonitor::Event::Event(ChangeType type, String name, String oldName)
+	: type(type)
+	, name(std::move(name))
+	, oldName(std::move(oldName))
+{}
+
 DirectoryMonitor::DirectoryMonitor(const Path& p)
 	: pimpl(std::make_unique<DirectoryMonitorPimpl>(p))
 {}
@@ -82,3 +496,8 @@ bool DirectoryMonitor::hasRealImplementation() const
 {
 	return pimpl->hasRealImplementation();
 }
+
+std::vector<DirectoryMonitor::Event> DirectoryMonitor::getChanges()
+{
+	return pimpl->getChanges();
+}
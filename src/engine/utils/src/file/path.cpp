@@ -23,19 +23,27 @@ Path::Path(const String& name)
 	setPath(name);
 }
 
-void Path::setPath(const String& value)
+void Path::setPath(StringView value)
 {
-	String rawPath = value;
 #ifdef _WIN32
-	rawPath = rawPath.replaceAll("\\", "/");
+	const String rawPath = String(value).replaceAll("\\", "/");
+	const StringView path = rawPath;
+#else
+	const StringView path = value;
 #endif
 
-	pathParts = rawPath.split('/');
+	// Split as views, so each part is only copied once, into its own String
+	const auto parts = path.split('/');
+	pathParts.clear();
+	pathParts.reserve(parts.size());
+	for (auto& p: parts) {
+		pathParts.emplace_back(p);
+	}
 	normalise();
 }
 
 Path::Path(std::vector<String> parts)
-	: pathParts(parts)
+	: pathParts(std::move(parts))
 {
 	normalise();
 }
@@ -45,9 +53,9 @@ void Path::normalise()
 	size_t writePos = 0;
 	bool lastIsBack = false;
 
-	auto write = [&] (const String& p)
+	auto write = [&] (String p)
 	{
-		pathParts.at(writePos++) = p;
+		pathParts.at(writePos++) = std::move(p);
 		lastIsBack = false;
 	};
 
@@ -56,26 +64,26 @@ void Path::normalise()
 		bool first = i == 0;
 		bool last = i == n - 1;
 
-		String current = pathParts[i]; // Important: don't make this a reference
+		String current = std::move(pathParts[i]); // Important: don't make this a reference, as write() may overwrite it
 		if (current == "") {
 			if (first) {
-				write(current);
+				write(std::move(current));
 			} else if (last) {
 				write(".");
 			}
 		} else if (current == ".") {
 			if (first || last) {
-				write(current);
+				write(std::move(current));
 			}
 		} else if (current == "..") {
 			if (writePos > 0 && pathParts[writePos - 1] != "..") {
 				--writePos;
 				lastIsBack = true;
 			} else {
-				write(current);
+				write(std::move(current));
 			}
 		} else {
-			write(current);
+			write(std::move(current));
 		}
 	}
 	if (lastIsBack) {
@@ -104,7 +112,7 @@ Path Path::getFilename() const
 
 Path Path::getStem() const
 {
-	String filename = pathParts.back();
+	const String& filename = pathParts.back();
 	if (filename == "." || filename == "..") {
 		return filename;
 	}
@@ -114,7 +122,7 @@ Path Path::getStem() const
 
 String Path::getExtension() const
 {
-	String filename = pathParts.back();
+	const String& filename = pathParts.back();
 	if (filename == "." || filename == "..") {
 		return filename;
 	}
@@ -124,17 +132,23 @@ String Path::getExtension() const
 
 String Path::getString() const
 {
-	std::stringstream s;
+	size_t size = 0;
+	for (auto& p : pathParts) {
+		size += p.size() + 1;
+	}
+
+	std::string s;
+	s.reserve(size);
 	bool first = true;
 	for (auto& p : pathParts) {
 		if (first) {
 			first = false;
 		} else {
-			s << "/";
+			s += '/';
 		}
-		s << p;
+		s += p.cppStr();
 	}
-	return s.str();
+	return s;
 }
 
 String Path::toString() const
@@ -154,14 +168,20 @@ Path Path::dropFront(int numberFolders) const
 
 Path Path::parentPath() const
 {
-	return Path(getString() + "/..");
+	if (pathParts.empty()) {
+		return Path("/..");
+	}
+	// Same as appending "/.." to the string, without joining and splitting it again
+	auto parts = pathParts;
+	parts.emplace_back("..");
+	return Path(std::move(parts));
 }
 
 Path Path::replaceExtension(String newExtension) const
 {
 	auto parts = pathParts;
 	parts.back() = getStem().getString() + newExtension;
-	return Path(parts);
+	return Path(std::move(parts));
 }
 
 Path Path::operator/(const char* other) const
@@ -172,10 +192,11 @@ Path Path::operator/(const char* other) const
 Path Path::operator/(const Path& other) const 
 {
 	auto parts = pathParts;
+	parts.reserve(parts.size() + other.pathParts.size());
 	for (auto& p : other.pathParts) {
 		parts.push_back(p);
 	}
-	return Path(parts);
+	return Path(std::move(parts));
 }
 
 Path Path::operator/(const String& other) const
@@ -285,7 +306,7 @@ Path Path::makeRelativeTo(const Path& path) const
 		result.emplace_back(me.pathParts[i]);
 	}
 
-	return Path(result);
+	return Path(std::move(result));
 }
 
 Path Path::changeRelativeRoot(const Path& currentParent, const Path& newParent) const
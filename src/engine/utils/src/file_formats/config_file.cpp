@@ -2,9 +2,26 @@
 #include "halley/bytes/byte_serializer.h"
 #include "halley/support/exception.h"
 #include "halley/core/resources/resource_collection.h"
+#include <algorithm>
+#include <cstring>
 
 using namespace Halley;
 
+namespace {
+	// Guards the observer lists of every ConfigFile, and the observers waiting for dispatchChanges()
+	std::mutex& getObserversMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	std::vector<ConfigObserver*>& getPendingObservers()
+	{
+		static std::vector<ConfigObserver*> pending;
+		return pending;
+	}
+}
+
 ConfigNode::ConfigNode()
 {
 }
@@ -460,6 +477,15 @@ String ConfigNode::asString() const
 	}
 }
 
+StringView ConfigNode::asStringView() const
+{
+	if (type == ConfigNodeType::String) {
+		return *reinterpret_cast<String*>(ptrData);
+	} else {
+		throw Exception(getNodeDebugId() + " is not a string", HalleyExceptions::Resources);
+	}
+}
+
 int ConfigNode::asInt(int defaultValue) const
 {
 	if (type == ConfigNodeType::Undefined) {
@@ -711,40 +737,189 @@ String ConfigNode::backTrackFullNodeName() const
 	}
 }
 
+namespace {
+	// Binary layout, all integers native-endian:
+	//   Header, Node[numNodes], StringRef[numStrings], string data (null-terminated), bytes data
+	// Nodes are laid out breadth-first, so each container's children are contiguous; the root is node 0.
+	constexpr uint32_t binaryMagic = 0x47464348; // "HCFG"
+	constexpr uint32_t noKey = 0xFFFFFFFF;
+
+	struct BinaryHeader
+	{
+		uint32_t magic;
+		uint32_t numNodes;
+		uint32_t numStrings;
+		uint32_t stringDataSize;
+		uint32_t bytesDataSize;
+	};
+
+	struct BinaryNode
+	{
+		uint32_t type;
+		int32_t line;
+		int32_t column;
+		uint32_t key; // String index if the parent is a map
+		uint32_t a; // Value, string index, first child or bytes offset
+		uint32_t b; // Second vector component, child count or bytes size
+	};
+
+	struct BinaryStringRef
+	{
+		uint32_t offset;
+		uint32_t length;
+	};
+
+	template <typename T>
+	T readAt(gsl::span<const gsl::byte> data, size_t offset)
+	{
+		// The layout can sit at any offset inside a pack, so don't assume alignment
+		T result;
+		memcpy(&result, data.data() + offset, sizeof(T));
+		return result;
+	}
+
+	template <typename T>
+	uint32_t toBits(T value)
+	{
+		static_assert(sizeof(T) == sizeof(uint32_t), "Expected 32-bit value");
+		uint32_t result;
+		memcpy(&result, &value, sizeof(T));
+		return result;
+	}
+
+	template <typename T>
+	T fromBits(uint32_t value)
+	{
+		static_assert(sizeof(T) == sizeof(uint32_t), "Expected 32-bit value");
+		T result;
+		memcpy(&result, &value, sizeof(T));
+		return result;
+	}
+}
+
+struct ConfigFile::BinaryLayout
+{
+	gsl::span<const gsl::byte> data;
+	BinaryHeader header;
+	size_t nodesOffset;
+	size_t stringRefsOffset;
+	size_t stringDataOffset;
+	size_t bytesDataOffset;
+
+	explicit BinaryLayout(gsl::span<const gsl::byte> data)
+		: data(data)
+	{
+		if (size_t(data.size()) < sizeof(BinaryHeader)) {
+			throw Exception("Binary config file is truncated.", HalleyExceptions::Resources);
+		}
+		header = readAt<BinaryHeader>(data, 0);
+		if (header.magic != binaryMagic || header.numNodes == 0) {
+			throw Exception("Invalid binary config file.", HalleyExceptions::Resources);
+		}
+
+		nodesOffset = sizeof(BinaryHeader);
+		stringRefsOffset = nodesOffset + size_t(header.numNodes) * sizeof(BinaryNode);
+		stringDataOffset = stringRefsOffset + size_t(header.numStrings) * sizeof(BinaryStringRef);
+		bytesDataOffset = stringDataOffset + size_t(header.stringDataSize);
+		if (bytesDataOffset + size_t(header.bytesDataSize) > size_t(data.size())) {
+			throw Exception("Binary config file is truncated.", HalleyExceptions::Resources);
+		}
+	}
+
+	BinaryNode getNode(uint32_t idx) const
+	{
+		if (idx >= header.numNodes) {
+			throw Exception("Invalid node index in binary config file.", HalleyExceptions::Resources);
+		}
+		return readAt<BinaryNode>(data, nodesOffset + size_t(idx) * sizeof(BinaryNode));
+	}
+
+	String getString(uint32_t idx) const
+	{
+		if (idx >= header.numStrings) {
+			throw Exception("Invalid string index in binary config file.", HalleyExceptions::Resources);
+		}
+		const auto ref = readAt<BinaryStringRef>(data, stringRefsOffset + size_t(idx) * sizeof(BinaryStringRef));
+		if (size_t(ref.offset) + size_t(ref.length) > size_t(header.stringDataSize)) {
+			throw Exception("Invalid string in binary config file.", HalleyExceptions::Resources);
+		}
+		return String(reinterpret_cast<const char*>(data.data() + stringDataOffset + ref.offset), ref.length);
+	}
+
+	Bytes getBytes(uint32_t offset, uint32_t size) const
+	{
+		if (size_t(offset) + size_t(size) > size_t(header.bytesDataSize)) {
+			throw Exception("Invalid byte sequence in binary config file.", HalleyExceptions::Resources);
+		}
+		const auto start = reinterpret_cast<const Byte*>(data.data() + bytesDataOffset + offset);
+		return Bytes(start, start + size);
+	}
+};
+
 ConfigFile::ConfigFile()
+	: materialized(true)
 {
 }
 
 ConfigFile::ConfigFile(ConfigFile&& other)
+	: materialized(true)
 {
-	root = std::move(other.root);
-	updateRoot();
+	*this = std::move(other);
+}
+
+ConfigFile::~ConfigFile()
+{
+	std::unique_lock<std::mutex> lock(getObserversMutex());
+	for (auto* observer: observers) {
+		observer->subscribed = false;
+		observer->file = nullptr;
+	}
 }
 
 ConfigFile& ConfigFile::operator=(ConfigFile&& other)
 {
+	std::unique_lock<std::mutex> lock(other.materializeMutex);
 	root = std::move(other.root);
-	updateRoot();
+	binaryOwner = std::move(other.binaryOwner);
+	binary = other.binary;
+	materialized = other.materialized.load();
+	other.binary = {};
+	other.materialized = true;
+	lock.unlock();
+
+	if (materialized) {
+		updateRoot();
+	}
 	return *this;
 }
 
 ConfigNode& ConfigFile::getRoot()
 {
+	materialize();
 	return root;
 }
 
 const ConfigNode& ConfigFile::getRoot() const
 {
+	materialize();
 	return root;
 }
 
-constexpr int curVersion = 2;
+constexpr int curVersion = 3;
 
 void ConfigFile::serialize(Serializer& s) const
 {
 	int version = curVersion;
 	s << version;
-	s << root;
+
+	std::unique_lock<std::mutex> lock(materializeMutex);
+	if (!materialized) {
+		// Never touched since loading, so the layout can be written back as it is
+		s << static_cast<unsigned int>(binary.size());
+		s << binary;
+	} else {
+		s << toBinary(root);
+	}
 }
 
 void ConfigFile::deserialize(Deserializer& s)
@@ -752,18 +927,45 @@ void ConfigFile::deserialize(Deserializer& s)
 	int version;
 	s >> version;
 	s.setVersion(version);
-	s >> root;
 
-	updateRoot();
+	if (version >= 3) {
+		auto data = std::make_shared<Bytes>();
+		s >> *data;
+		const auto span = gsl::as_bytes(gsl::span<const Byte>(*data));
+		setBinary(std::move(data), span);
+	} else {
+		root = ConfigNode();
+		s >> root;
+		updateRoot();
+	}
 }
 
 std::unique_ptr<ConfigFile> ConfigFile::loadResource(ResourceLoader& loader)
 {
 	auto config = std::make_unique<ConfigFile>();
 
-	auto data = loader.getStatic();
-	Deserializer s(data->getSpan());
-	s >> *config;
+	std::shared_ptr<ResourceDataStatic> data = loader.getStatic();
+	const auto span = data->getSpan();
+
+	int version = 0;
+	if (size_t(span.size()) >= sizeof(int)) {
+		memcpy(&version, span.data(), sizeof(int));
+	}
+
+	if (version >= 3) {
+		// Read in place from the loaded data, rather than copying it out
+		uint32_t size = 0;
+		if (size_t(span.size()) >= sizeof(int) + sizeof(uint32_t)) {
+			memcpy(&size, span.data() + sizeof(int), sizeof(uint32_t));
+		}
+		if (sizeof(int) + sizeof(uint32_t) + size_t(size) > size_t(span.size())) {
+			throw Exception("Config file \"" + loader.getName() + "\" is truncated.", HalleyExceptions::Resources);
+		}
+		config->setBinary(data, span.subspan(sizeof(int) + sizeof(uint32_t), size));
+	} else {
+		Deserializer s(span);
+		s >> *config;
+	}
 
 	return config;
 }
@@ -771,10 +973,17 @@ std::unique_ptr<ConfigFile> ConfigFile::loadResource(ResourceLoader& loader)
 void ConfigFile::reload(Resource&& resource)
 {
 	*this = std::move(dynamic_cast<ConfigFile&>(resource));
-	updateRoot();
+
+	std::unique_lock<std::mutex> lock(getObserversMutex());
+	for (auto* observer: observers) {
+		if (!observer->pending) {
+			observer->pending = true;
+			getPendingObservers().push_back(observer);
+		}
+	}
 }
 
-void ConfigFile::updateRoot()
+void ConfigFile::updateRoot() const
 {
 	root.propagateParentingInformation(this);
 	Ensures(root.parentIdx == 0);
@@ -782,6 +991,206 @@ void ConfigFile::updateRoot()
 	Ensures(root.parentFile == this);
 }
 
+void ConfigFile::setBinary(std::shared_ptr<const void> owner, gsl::span<const gsl::byte> data)
+{
+	BinaryLayout layout(data); // Validates the header up front, so errors show up at load time
+
+	std::unique_lock<std::mutex> lock(materializeMutex);
+	root = ConfigNode();
+	binaryOwner = std::move(owner);
+	binary = data;
+	materialized = false;
+}
+
+void ConfigFile::materialize() const
+{
+	if (materialized.load(std::memory_order_acquire)) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(materializeMutex);
+	if (!materialized.load(std::memory_order_relaxed)) {
+		fromBinary(BinaryLayout(binary), 0, root);
+		updateRoot();
+		binary = {};
+		binaryOwner.reset();
+		materialized.store(true, std::memory_order_release);
+	}
+}
+
+Bytes ConfigFile::toBinary(const ConfigNode& root)
+{
+	std::vector<BinaryNode> nodes;
+	std::vector<const ConfigNode*> order;
+	std::vector<uint32_t> keys;
+	std::vector<BinaryStringRef> stringRefs;
+	Bytes stringData;
+	Bytes bytesData;
+	std::map<String, uint32_t> stringIds;
+
+	auto intern = [&] (const String& str) -> uint32_t
+	{
+		auto iter = stringIds.find(str);
+		if (iter != stringIds.end()) {
+			return iter->second;
+		}
+		const auto id = uint32_t(stringRefs.size());
+		stringRefs.push_back(BinaryStringRef{ uint32_t(stringData.size()), uint32_t(str.size()) });
+		stringData.insert(stringData.end(), reinterpret_cast<const Byte*>(str.c_str()), reinterpret_cast<const Byte*>(str.c_str()) + str.size());
+		stringData.push_back(0);
+		stringIds[str] = id;
+		return id;
+	};
+
+	order.push_back(&root);
+	keys.push_back(noKey);
+	for (size_t i = 0; i < order.size(); ++i) {
+		const auto& node = *order[i];
+		BinaryNode bn;
+		bn.type = uint32_t(node.type);
+		bn.line = node.line;
+		bn.column = node.column;
+		bn.key = keys[i];
+		bn.a = 0;
+		bn.b = 0;
+
+		switch (node.type) {
+			case ConfigNodeType::String:
+				bn.a = intern(node.asString());
+				break;
+			case ConfigNodeType::Sequence:
+				bn.a = uint32_t(order.size());
+				bn.b = uint32_t(node.asSequence().size());
+				for (auto& e: node.asSequence()) {
+					order.push_back(&e);
+					keys.push_back(noKey);
+				}
+				break;
+			case ConfigNodeType::Map:
+				bn.a = uint32_t(order.size());
+				bn.b = uint32_t(node.asMap().size());
+				for (auto& e: node.asMap()) {
+					order.push_back(&e.second);
+					keys.push_back(intern(e.first));
+				}
+				break;
+			case ConfigNodeType::Int:
+				bn.a = toBits(node.intData);
+				break;
+			case ConfigNodeType::Float:
+				bn.a = toBits(node.floatData);
+				break;
+			case ConfigNodeType::Int2:
+				bn.a = toBits(node.vec2iData.x);
+				bn.b = toBits(node.vec2iData.y);
+				break;
+			case ConfigNodeType::Float2:
+				bn.a = toBits(node.vec2fData.x);
+				bn.b = toBits(node.vec2fData.y);
+				break;
+			case ConfigNodeType::Bytes:
+				bn.a = uint32_t(bytesData.size());
+				bn.b = uint32_t(node.asBytes().size());
+				bytesData.insert(bytesData.end(), node.asBytes().begin(), node.asBytes().end());
+				break;
+			case ConfigNodeType::Undefined:
+				break;
+			default:
+				throw Exception("Unknown configuration node type.", HalleyExceptions::Resources);
+		}
+
+		nodes.push_back(bn);
+	}
+
+	BinaryHeader header;
+	header.magic = binaryMagic;
+	header.numNodes = uint32_t(nodes.size());
+	header.numStrings = uint32_t(stringRefs.size());
+	header.stringDataSize = uint32_t(stringData.size());
+	header.bytesDataSize = uint32_t(bytesData.size());
+
+	Bytes result(sizeof(BinaryHeader) + nodes.size() * sizeof(BinaryNode) + stringRefs.size() * sizeof(BinaryStringRef) + stringData.size() + bytesData.size());
+	size_t pos = 0;
+	auto write = [&] (const void* src, size_t size)
+	{
+		if (size > 0) {
+			memcpy(result.data() + pos, src, size);
+			pos += size;
+		}
+	};
+	write(&header, sizeof(header));
+	write(nodes.data(), nodes.size() * sizeof(BinaryNode));
+	write(stringRefs.data(), stringRefs.size() * sizeof(BinaryStringRef));
+	write(stringData.data(), stringData.size());
+	write(bytesData.data(), bytesData.size());
+	Ensures(pos == result.size());
+
+	return result;
+}
+
+void ConfigFile::fromBinary(const BinaryLayout& layout, uint32_t idx, ConfigNode& dst)
+{
+	const auto node = layout.getNode(idx);
+	const auto checkChildren = [&] ()
+	{
+		// Breadth-first layout means children always come after their parent, which also rules out cycles
+		if (node.a <= idx || size_t(node.a) + size_t(node.b) > size_t(layout.header.numNodes)) {
+			throw Exception("Invalid children in binary config file.", HalleyExceptions::Resources);
+		}
+	};
+
+	switch (ConfigNodeType(node.type)) {
+		case ConfigNodeType::String:
+			dst = layout.getString(node.a);
+			break;
+		case ConfigNodeType::Sequence:
+			{
+				checkChildren();
+				ConfigNode::SequenceType seq(node.b);
+				for (uint32_t i = 0; i < node.b; ++i) {
+					fromBinary(layout, node.a + i, seq[i]);
+				}
+				dst = std::move(seq);
+			}
+			break;
+		case ConfigNodeType::Map:
+			{
+				checkChildren();
+				ConfigNode::MapType map;
+				for (uint32_t i = 0; i < node.b; ++i) {
+					const uint32_t childIdx = node.a + i;
+					// Keys were written in map order, so each insertion goes straight at the end
+					auto iter = map.emplace_hint(map.end(), layout.getString(layout.getNode(childIdx).key), ConfigNode());
+					fromBinary(layout, childIdx, iter->second);
+				}
+				dst = std::move(map);
+			}
+			break;
+		case ConfigNodeType::Int:
+			dst = fromBits<int>(node.a);
+			break;
+		case ConfigNodeType::Float:
+			dst = fromBits<float>(node.a);
+			break;
+		case ConfigNodeType::Int2:
+			dst = Vector2i(fromBits<int>(node.a), fromBits<int>(node.b));
+			break;
+		case ConfigNodeType::Float2:
+			dst = Vector2f(fromBits<float>(node.a), fromBits<float>(node.b));
+			break;
+		case ConfigNodeType::Bytes:
+			dst = layout.getBytes(node.a, node.b);
+			break;
+		case ConfigNodeType::Undefined:
+			dst = ConfigNode();
+			break;
+		default:
+			throw Exception("Unknown configuration node type.", HalleyExceptions::Resources);
+	}
+
+	dst.setOriginalPosition(node.line, node.column);
+}
+
 ConfigObserver::ConfigObserver()
 {
 }
@@ -797,6 +1206,50 @@ ConfigObserver::ConfigObserver(const ConfigFile& file)
 {
 }
 
+ConfigObserver::ConfigObserver(const ConfigObserver& other)
+	: assetVersion(other.assetVersion)
+	, file(other.file)
+	, node(other.node)
+{
+}
+
+ConfigObserver::ConfigObserver(ConfigObserver&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+ConfigObserver::~ConfigObserver()
+{
+	unsubscribe();
+}
+
+ConfigObserver& ConfigObserver::operator=(const ConfigObserver& other)
+{
+	if (this != &other) {
+		const bool wasPending = unsubscribe();
+		assetVersion = other.assetVersion;
+		file = other.file;
+		node = other.node;
+		subscribe(wasPending);
+	}
+	return *this;
+}
+
+ConfigObserver& ConfigObserver::operator=(ConfigObserver&& other) noexcept
+{
+	if (this != &other) {
+		unsubscribe();
+		const bool wasPending = other.unsubscribe();
+		assetVersion = other.assetVersion;
+		file = other.file;
+		node = other.node;
+		listener = std::move(other.listener);
+		other.listener = {};
+		subscribe(wasPending);
+	}
+	return *this;
+}
+
 const ConfigNode& ConfigObserver::getRoot() const
 {
 	Expects(node);
@@ -825,5 +1278,67 @@ String ConfigObserver::getAssetId() const
 	}
 }
 
+void ConfigObserver::setListener(std::function<void()> l)
+{
+	const bool wasPending = unsubscribe();
+	listener = std::move(l);
+	subscribe(wasPending);
+}
+
+void ConfigObserver::dispatchChanges()
+{
+	// One at a time, as listeners may destroy or create other observers
+	auto& pendingObservers = getPendingObservers();
+	while (true) {
+		ConfigObserver* observer;
+		{
+			std::unique_lock<std::mutex> lock(getObserversMutex());
+			if (pendingObservers.empty()) {
+				return;
+			}
+			observer = pendingObservers.front();
+			pendingObservers.erase(pendingObservers.begin());
+			observer->pending = false;
+		}
+		if (observer->listener) {
+			observer->listener();
+		}
+	}
+}
+
+void ConfigObserver::subscribe(bool markPending)
+{
+	if (!listener) {
+		return;
+	}
+
+	std::unique_lock<std::mutex> lock(getObserversMutex());
+	if (file) {
+		file->observers.push_back(this);
+		subscribed = true;
+	}
+	if (markPending) {
+		pending = true;
+		getPendingObservers().push_back(this);
+	}
+}
+
+bool ConfigObserver::unsubscribe()
+{
+	std::unique_lock<std::mutex> lock(getObserversMutex());
+	const bool wasPending = pending;
+	if (subscribed) {
+		auto& observers = file->observers;
+		observers.erase(std::remove(observers.begin(), observers.end(), this), observers.end());
+		subscribed = false;
+	}
+	if (pending) {
+		auto& pendingObservers = getPendingObservers();
+		pendingObservers.erase(std::remove(pendingObservers.begin(), pendingObservers.end(), this), pendingObservers.end());
+		pending = false;
+	}
+	return wasPending;
+}
+
 ConfigNode ConfigNode::undefinedConfigNode;
 String ConfigNode::undefinedConfigNodeName;
@@ -23,14 +23,157 @@
 #include "halley/file_formats/image.h"
 #include "../../contrib/stb_image/stb_image.h"
 #include "../../contrib/lodepng/lodepng.h"
+#include "../../contrib/zlib/zlib.h"
+#include "png_decoder.h"
 #include "halley/support/exception.h"
 #include "halley/resources/resource_data.h"
 #include "halley/text/string_converter.h"
 #include "halley/bytes/byte_serializer.h"
 #include "halley/support/logger.h"
+#include "halley/bytes/compression.h"
+#include "halley/concurrency/concurrent.h"
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAS_SSE2
+#include <emmintrin.h>
+#if defined(__SSSE3__) || defined(__AVX__)
+#define HAS_SSSE3
+#include <tmmintrin.h>
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#include <arm_neon.h>
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define HAS_NEON_TBL
+#endif
+#endif
 
 using namespace Halley;
 
+namespace {
+	// lodepng's own inflate and deflate are far slower than zlib's
+	unsigned zlibDecompress(unsigned char** out, size_t* outSize, const unsigned char* in, size_t inSize, const LodePNGDecompressSettings*)
+	{
+		try {
+			auto result = Compression::decompressRaw(gsl::as_bytes(gsl::span<const unsigned char>(in, inSize)), std::numeric_limits<size_t>::max());
+			*out = static_cast<unsigned char*>(malloc(std::max(result.size(), size_t(1))));
+			memcpy(*out, result.data(), result.size());
+			*outSize = result.size();
+			return 0;
+		} catch (Exception&) {
+			return 1;
+		}
+	}
+
+	unsigned zlibCompressFast(unsigned char** out, size_t* outSize, const unsigned char* in, size_t inSize, const LodePNGCompressSettings*)
+	{
+		z_stream stream;
+		memset(&stream, 0, sizeof(stream));
+		if (deflateInit(&stream, 1) != Z_OK) {
+			return 1;
+		}
+
+		const size_t size = size_t(deflateBound(&stream, uLong(inSize)));
+		*out = static_cast<unsigned char*>(malloc(size));
+		stream.next_in = const_cast<unsigned char*>(in);
+		stream.avail_in = uInt(inSize);
+		stream.next_out = *out;
+		stream.avail_out = uInt(size);
+		const int res = deflate(&stream, Z_FINISH);
+		*outSize = size_t(stream.total_out);
+		deflateEnd(&stream);
+
+		if (res != Z_STREAM_END) {
+			free(*out);
+			*out = nullptr;
+			return 1;
+		}
+		return 0;
+	}
+
+	// First pixel in [from, to) that isn't fully transparent, or to if there's none
+	size_t findFirstOpaque(const uint32_t* row, size_t from, size_t to)
+	{
+		size_t x = from;
+#if defined(HAS_SSE2)
+		const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+		const __m128i zero = _mm_setzero_si128();
+		for (; x + 4 <= to; x += 4) {
+			const __m128i alpha = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x)), alphaMask);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) != 0xFFFF) {
+				break;
+			}
+		}
+#elif defined(HAS_NEON)
+		const uint32x4_t alphaMask = vdupq_n_u32(0xFF000000u);
+		for (; x + 4 <= to; x += 4) {
+			const uint32x4_t alpha = vandq_u32(vld1q_u32(row + x), alphaMask);
+			if (vgetq_lane_u64(vreinterpretq_u64_u32(alpha), 0) != 0 || vgetq_lane_u64(vreinterpretq_u64_u32(alpha), 1) != 0) {
+				break;
+			}
+		}
+#endif
+		for (; x < to; ++x) {
+			if ((row[x] >> 24) != 0) {
+				return x;
+			}
+		}
+		return to;
+	}
+
+	// Last pixel in [from, to) that isn't fully transparent, or to if there's none
+	size_t findLastOpaque(const uint32_t* row, size_t from, size_t to)
+	{
+		size_t x = to;
+#if defined(HAS_SSE2)
+		const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+		const __m128i zero = _mm_setzero_si128();
+		for (; x >= from + 4; x -= 4) {
+			const __m128i alpha = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x - 4)), alphaMask);
+			if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, zero)) != 0xFFFF) {
+				break;
+			}
+		}
+#elif defined(HAS_NEON)
+		const uint32x4_t alphaMask = vdupq_n_u32(0xFF000000u);
+		for (; x >= from + 4; x -= 4) {
+			const uint32x4_t alpha = vandq_u32(vld1q_u32(row + x - 4), alphaMask);
+			if (vgetq_lane_u64(vreinterpretq_u64_u32(alpha), 0) != 0 || vgetq_lane_u64(vreinterpretq_u64_u32(alpha), 1) != 0) {
+				break;
+			}
+		}
+#endif
+		for (; x > from; --x) {
+			if ((row[x - 1] >> 24) != 0) {
+				return x - 1;
+			}
+		}
+		return to;
+	}
+
+	template <typename F>
+	void forEachRowBand(size_t rows, size_t bytesPerRow, F f)
+	{
+		constexpr size_t rowsPerTask = 64;
+		if (rows * bytesPerRow < 1024 * 1024 || !Executors::isDefined()) {
+			f(size_t(0), rows);
+			return;
+		}
+
+		std::vector<size_t> bands;
+		for (size_t y = 0; y < rows; y += rowsPerTask) {
+			bands.push_back(y);
+		}
+		Concurrent::foreach(Executors::getCPU(), bands.begin(), bands.end(), [&] (size_t y)
+		{
+			f(y, std::min(y + rowsPerTask, rows));
+		}, 1);
+	}
+}
+
 Image::Image(Format format, Vector2i size)
 	: px(nullptr, [](char*){})
 	, dataLen(0)
@@ -131,31 +274,40 @@ Image::Format Image::getFormat() const
 
 Rect4i Image::getTrimRect() const
 {
-	int x0 = w;
-	int x1 = 0;
-	int y0 = h;
-	int y1 = 0;
-
-	const unsigned int* src = reinterpret_cast<const unsigned int*>(px.get());
-	for (int y = 0; y < int(h); y++) {
-		for (int x = 0; x < int(w); x++) {
-			unsigned int px = src[x + y * w];
-			int alpha = int(px >> 24);
-
-			if (alpha > 0) {
-				x0 = std::min(x0, x);
-				y0 = std::min(y0, y);
-				x1 = std::max(x1, x);
-				y1 = std::max(y1, y);
-			}
-		}
-	}
+	const uint32_t* src = reinterpret_cast<const uint32_t*>(px.get());
+	auto getRow = [&] (size_t y) { return src + y * w; };
 
-	if (x0 > x1 || y0 > y1) {
+	// Top and bottom rows with anything in them, then, between them, only the columns outside of what's been found so far need looking at
+	size_t y0 = 0;
+	while (y0 < h && findFirstOpaque(getRow(y0), 0, w) == w) {
+		++y0;
+	}
+	if (y0 == h) {
 		return Rect4i();
 	}
+	size_t y1 = h - 1;
+	while (y1 > y0 && findFirstOpaque(getRow(y1), 0, w) == w) {
+		--y1;
+	}
+
+	size_t x0 = w;
+	size_t x1 = 0;
+	bool foundRight = false;
+	for (size_t y = y0; y <= y1; ++y) {
+		const auto row = getRow(y);
+		const size_t left = findFirstOpaque(row, 0, x0);
+		if (left < x0) {
+			x0 = left;
+		}
+		const size_t rightFrom = foundRight ? x1 + 1 : 0;
+		const size_t right = findLastOpaque(row, rightFrom, w);
+		if (right < w) {
+			x1 = right;
+			foundRight = true;
+		}
+	}
 
-	return Rect4i(Vector2i(x0, y0), Vector2i(x1 + 1, y1 + 1));
+	return Rect4i(Vector2i(int(x0), int(y0)), Vector2i(int(x1) + 1, int(y1) + 1));
 }
 
 Rect4i Image::getRect() const
@@ -166,11 +318,7 @@ Rect4i Image::getRect() const
 void Image::clear(int colour)
 {
 	int* dst = reinterpret_cast<int*>(px.get());
-	for (unsigned int y = 0; y < h; y++) {
-		for (unsigned int x = 0; x < w; x++) {
-			*dst++ = colour;
-		}
-	}
+	std::fill_n(dst, size_t(w) * size_t(h), colour);
 }
 
 void Image::blitFrom(Vector2i pos, const char* buffer, size_t width, size_t height, size_t pitch, size_t bpp)
@@ -200,9 +348,9 @@ void Image::blitFrom(Vector2i pos, const char* buffer, size_t width, size_t heig
 		}
 	} else if (bpp == 32) {
 		const int* src = reinterpret_cast<const int*>(buffer);
-		for (size_t y = yMin; y < yMax; y++) {
-			for (size_t x = xMin; x < xMax; x++) {
-				dst[x + y * w] = src[x + y * pitch];
+		if (xMax > xMin) {
+			for (size_t y = yMin; y < yMax; y++) {
+				memcpy(dst + xMin + y * w, src + xMin + y * pitch, (xMax - xMin) * sizeof(int));
 			}
 		}
 	} else {
@@ -384,21 +532,37 @@ void Image::deserialize(Deserializer& s)
 void Image::load(gsl::span<const gsl::byte> bytes, Format targetFormat)
 {
 	if (isPNG(bytes)) {
-		unsigned char* pixels;
-		unsigned int x, y;
-		lodepng::State state;
+		unsigned char* pixels = nullptr;
+		unsigned int x = 0;
+		unsigned int y = 0;
 		LodePNGColorType colorFormat;
+		int nChannels;
 		switch (targetFormat) {
 		case Format::Indexed:
 			colorFormat = LCT_GREY;
+			nChannels = 1;
 			break;
 		case Format::RGB:
 			colorFormat = LCT_RGB;
+			nChannels = 3;
 			break;
 		default:
 			colorFormat = LCT_RGBA;
+			nChannels = 4;
+		}
+
+#ifndef WITH_LODEPNG_DECODER
+		pixels = reinterpret_cast<unsigned char*>(PNGDecoder::decode(bytes, nChannels, x, y));
+#endif
+		if (!pixels) {
+			LodePNGState state;
+			lodepng_state_init(&state);
+			state.info_raw.colortype = colorFormat;
+			state.info_raw.bitdepth = 8;
+			state.decoder.zlibsettings.custom_zlib = &zlibDecompress;
+			lodepng_decode(&pixels, &x, &y, &state, reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size());
+			lodepng_state_cleanup(&state);
 		}
-		lodepng_decode_memory(&pixels, &x, &y, reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size(), colorFormat, 8);
 
 		px = std::unique_ptr<char, void(*)(char*)>(reinterpret_cast<char*>(pixels), [](char* data) { free(data); });
 		w = x;
@@ -427,22 +591,121 @@ void Image::preMultiply()
 {
 	Expects(format == Format::RGBA);
 
-	size_t n = w * h;
 	unsigned int* data = reinterpret_cast<unsigned int*>(px.get());
-	for (size_t i = 0; i < n; i++) {
-		unsigned int cur = data[i];
-		unsigned int r, g, b, a;
-		convertIntToRGBA(cur, r, g, b, a);
-		++a;
-		data[i] = ((r * a >> 8) & 0xFF)
-			    | ((g * a) & 0xFF00)
-				| ((b * a << 8) & 0xFF0000)
-				| ((a-1) << 24);
-	}
+	const size_t rowLen = w;
+	forEachRowBand(h, rowLen * 4, [&] (size_t y0, size_t y1)
+	{
+		// Colour times (alpha + 1), over 256, which the vector paths fit in 16 bits per channel
+		size_t i = y0 * rowLen;
+		const size_t end = y1 * rowLen;
+#if defined(HAS_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i one = _mm_set1_epi16(1);
+		const __m128i alphaMask = _mm_set1_epi32(int(0xFF000000));
+		auto mulAlpha = [&] (__m128i c)
+		{
+			const __m128i alpha = _mm_add_epi16(_mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3)), one);
+			return _mm_srli_epi16(_mm_mullo_epi16(c, alpha), 8);
+		};
+		for (; i + 4 <= end; i += 4) {
+			const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+			const __m128i result = _mm_packus_epi16(mulAlpha(_mm_unpacklo_epi8(p, zero)), mulAlpha(_mm_unpackhi_epi8(p, zero)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_or_si128(_mm_andnot_si128(alphaMask, result), _mm_and_si128(p, alphaMask)));
+		}
+#elif defined(HAS_NEON)
+		const uint16x8_t one = vdupq_n_u16(1);
+		for (; i + 8 <= end; i += 8) {
+			auto* p = reinterpret_cast<uint8_t*>(data + i);
+			uint8x8x4_t c = vld4_u8(p);
+			const uint16x8_t alpha = vaddw_u8(one, c.val[3]);
+			for (int j = 0; j < 3; ++j) {
+				c.val[j] = vshrn_n_u16(vmulq_u16(vmovl_u8(c.val[j]), alpha), 8);
+			}
+			vst4_u8(p, c);
+		}
+#endif
+		for (; i < end; i++) {
+			unsigned int cur = data[i];
+			unsigned int r, g, b, a;
+			convertIntToRGBA(cur, r, g, b, a);
+			++a;
+			data[i] = ((r * a >> 8) & 0xFF)
+					| ((g * a) & 0xFF00)
+					| ((b * a << 8) & 0xFF0000)
+					| ((a-1) << 24);
+		}
+	});
 
 	format = Format::RGBAPremultiplied;
 }
 
+void Image::swizzle(int r, int g, int b, int a)
+{
+	Expects(getBytesPerPixel() == 4);
+	Expects(r >= 0 && r < 4 && g >= 0 && g < 4 && b >= 0 && b < 4 && a >= 0 && a < 4);
+
+	const uint8_t order[4] = { uint8_t(r), uint8_t(g), uint8_t(b), uint8_t(a) };
+	auto* data = reinterpret_cast<uint8_t*>(px.get());
+	forEachRowBand(h, size_t(w) * 4, [&] (size_t y0, size_t y1)
+	{
+		size_t i = y0 * w;
+		const size_t end = y1 * w;
+#if defined(HAS_SSSE3) || defined(HAS_NEON_TBL)
+		uint8_t shuffle[16];
+		for (int j = 0; j < 16; ++j) {
+			shuffle[j] = uint8_t((j & ~3) + order[j & 3]);
+		}
+#if defined(HAS_SSSE3)
+		const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffle));
+		for (; i + 4 <= end; i += 4) {
+			auto* p = reinterpret_cast<__m128i*>(data + i * 4);
+			_mm_storeu_si128(p, _mm_shuffle_epi8(_mm_loadu_si128(p), mask));
+		}
+#else
+		const uint8x16_t mask = vld1q_u8(shuffle);
+		for (; i + 4 <= end; i += 4) {
+			vst1q_u8(data + i * 4, vqtbl1q_u8(vld1q_u8(data + i * 4), mask));
+		}
+#endif
+#endif
+		for (; i < end; ++i) {
+			uint8_t* p = data + i * 4;
+			const uint8_t src[4] = { p[0], p[1], p[2], p[3] };
+			for (int j = 0; j < 4; ++j) {
+				p[j] = src[order[j]];
+			}
+		}
+	});
+
+	if (format == Format::RGBAPremultiplied && a != 3) {
+		format = Format::RGBA; // Whatever's in alpha now, the colours weren't multiplied by it
+	}
+}
+
+void Image::bleedEdges(Rect4i rect, int amount)
+{
+	Expects(getBytesPerPixel() == 4);
+	rect = rect.intersection(getRect());
+	if (rect.getWidth() <= 0 || rect.getHeight() <= 0 || amount <= 0) {
+		return;
+	}
+
+	// Each row of the grown area takes the nearest row of rect, and then its ends are filled with its first and last pixels
+	const Rect4i grown = Rect4i(rect.getTopLeft() - Vector2i(amount, amount), rect.getBottomRight() + Vector2i(amount, amount)).intersection(getRect());
+	auto* data = reinterpret_cast<uint32_t*>(px.get());
+	const size_t left = size_t(rect.getLeft());
+	const size_t right = size_t(rect.getRight());
+	for (int y = grown.getTop(); y < grown.getBottom(); ++y) {
+		uint32_t* row = data + size_t(y) * w;
+		const int srcY = clamp(y, rect.getTop(), rect.getBottom() - 1);
+		if (srcY != y) {
+			memcpy(row + left, data + size_t(srcY) * w + left, (right - left) * sizeof(uint32_t));
+		}
+		std::fill(row + grown.getLeft(), row + left, row[left]);
+		std::fill(row + right, row + grown.getRight(), row[right - 1]);
+	}
+}
+
 int Image::getPixel(Vector2i pos) const
 {
 	Expects(getBytesPerPixel() == 4);
@@ -457,7 +720,7 @@ int Image::getPixelAlpha(Vector2i pos) const
 	return pixel >> 24;
 }
 
-Bytes Image::savePNGToBytes(bool allowDepthReduce) const
+Bytes Image::savePNGToBytes(bool allowDepthReduce, bool fastCompression) const
 {
 	unsigned char* bytes;
 	size_t size;
@@ -482,6 +745,9 @@ Bytes Image::savePNGToBytes(bool allowDepthReduce) const
 	state.info_png.color.colortype = colFormat;
 	state.info_png.color.bitdepth = 8;
 	state.encoder.auto_convert = allowDepthReduce ? 1 : 0;
+	if (fastCompression) {
+		state.encoder.zlibsettings.custom_zlib = &zlibCompressFast;
+	}
 	lodepng_encode(&bytes, &size, reinterpret_cast<unsigned char*>(px.get()), w, h, &state);
 	auto errorCode = state.error;
 	lodepng_state_cleanup(&state);
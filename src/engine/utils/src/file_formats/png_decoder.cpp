@@ -0,0 +1,389 @@
+#include "png_decoder.h"
+#include "halley/bytes/compression.h"
+#include "halley/concurrency/concurrent.h"
+#include "halley/support/exception.h"
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386)
+#define HAS_SSE
+#include <emmintrin.h>
+#endif
+
+using namespace Halley;
+
+namespace {
+	enum ColourType : uint8_t {
+		Grey = 0,
+		RGB = 2,
+		Palette = 3,
+		GreyAlpha = 4,
+		RGBA = 6
+	};
+
+	struct PNGInfo {
+		uint32_t w = 0;
+		uint32_t h = 0;
+		uint8_t colourType = 0;
+		size_t bpp = 0; // Bytes per pixel in the file
+
+		std::array<std::array<uint8_t, 4>, 256> palette;
+		bool hasKey = false;
+		std::array<uint8_t, 3> key; // Transparent colour for Grey and RGB
+
+		std::vector<uint8_t> idat;
+	};
+
+	uint32_t readBE32(const uint8_t* p)
+	{
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+	}
+
+	// Only validates what decoding depends on; CRCs aren't checked
+	bool readChunks(gsl::span<const gsl::byte> bytes, PNGInfo& info)
+	{
+		const auto* data = reinterpret_cast<const uint8_t*>(bytes.data());
+		const size_t size = size_t(bytes.size());
+		size_t pos = 8;
+		bool hasHeader = false;
+
+		for (auto& entry: info.palette) {
+			entry = {{ 0, 0, 0, 255 }};
+		}
+
+		while (pos + 12 <= size) {
+			const size_t length = readBE32(data + pos);
+			const uint8_t* type = data + pos + 4;
+			const uint8_t* chunk = data + pos + 8;
+			if (length > size - pos - 12) {
+				return false;
+			}
+			pos += length + 12;
+
+			if (memcmp(type, "IHDR", 4) == 0) {
+				if (length != 13) {
+					return false;
+				}
+				info.w = readBE32(chunk);
+				info.h = readBE32(chunk + 4);
+				const uint8_t bitDepth = chunk[8];
+				info.colourType = chunk[9];
+				const uint8_t interlace = chunk[12];
+				if (bitDepth != 8 || interlace != 0 || chunk[10] != 0 || chunk[11] != 0) {
+					return false;
+				}
+				switch (info.colourType) {
+					case Grey: info.bpp = 1; break;
+					case RGB: info.bpp = 3; break;
+					case Palette: info.bpp = 1; break;
+					case GreyAlpha: info.bpp = 2; break;
+					case RGBA: info.bpp = 4; break;
+					default: return false;
+				}
+				hasHeader = true;
+			} else if (!hasHeader) {
+				return false;
+			} else if (memcmp(type, "PLTE", 4) == 0) {
+				if (length % 3 != 0 || length > 256 * 3) {
+					return false;
+				}
+				for (size_t i = 0; i < length / 3; ++i) {
+					info.palette[i] = {{ chunk[i * 3], chunk[i * 3 + 1], chunk[i * 3 + 2], 255 }};
+				}
+			} else if (memcmp(type, "tRNS", 4) == 0) {
+				if (info.colourType == Palette) {
+					if (length > 256) {
+						return false;
+					}
+					for (size_t i = 0; i < length; ++i) {
+						info.palette[i][3] = chunk[i];
+					}
+				} else if (info.colourType == Grey && length == 2) {
+					// Keys are 16-bit, so one with the high byte set never matches
+					info.hasKey = chunk[0] == 0;
+					info.key = {{ chunk[1], chunk[1], chunk[1] }};
+				} else if (info.colourType == RGB && length == 6) {
+					info.hasKey = chunk[0] == 0 && chunk[2] == 0 && chunk[4] == 0;
+					info.key = {{ chunk[1], chunk[3], chunk[5] }};
+				} else {
+					return false;
+				}
+			} else if (memcmp(type, "IDAT", 4) == 0) {
+				info.idat.insert(info.idat.end(), chunk, chunk + length);
+			} else if (memcmp(type, "IEND", 4) == 0) {
+				break;
+			}
+		}
+
+		// Keep well clear of overflowing any of the sizes below
+		return hasHeader && info.w > 0 && info.h > 0 && uint64_t(info.w) * uint64_t(info.h) <= (uint64_t(1) << 28) && !info.idat.empty();
+	}
+
+	uint8_t paeth(int a, int b, int c)
+	{
+		const int pa = std::abs(b - c);
+		const int pb = std::abs(a - c);
+		const int pc = std::abs(a + b - 2 * c);
+		if (pa <= pb && pa <= pc) {
+			return uint8_t(a);
+		}
+		return uint8_t(pb <= pc ? b : c);
+	}
+
+	void unfilterScalar(uint8_t filter, uint8_t* row, const uint8_t* prev, size_t n, size_t bpp)
+	{
+		switch (filter) {
+		case 1:
+			for (size_t i = bpp; i < n; ++i) {
+				row[i] = uint8_t(row[i] + row[i - bpp]);
+			}
+			break;
+		case 3:
+			for (size_t i = 0; i < bpp; ++i) {
+				row[i] = uint8_t(row[i] + (prev[i] >> 1));
+			}
+			for (size_t i = bpp; i < n; ++i) {
+				row[i] = uint8_t(row[i] + ((int(row[i - bpp]) + int(prev[i])) >> 1));
+			}
+			break;
+		case 4:
+			for (size_t i = 0; i < bpp; ++i) {
+				row[i] = uint8_t(row[i] + prev[i]);
+			}
+			for (size_t i = bpp; i < n; ++i) {
+				row[i] = uint8_t(row[i] + paeth(row[i - bpp], prev[i], prev[i - bpp]));
+			}
+			break;
+		}
+	}
+
+#ifdef HAS_SSE
+	// Each pixel depends on the one to its left, so these go one pixel at a time, but do all four channels at once
+	__m128i load4(const uint8_t* p)
+	{
+		int32_t v;
+		memcpy(&v, p, 4);
+		return _mm_cvtsi32_si128(v);
+	}
+
+	void store4(uint8_t* p, __m128i v)
+	{
+		const int32_t x = _mm_cvtsi128_si32(v);
+		memcpy(p, &x, 4);
+	}
+
+	__m128i abs16(__m128i x)
+	{
+		return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+	}
+
+	__m128i select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	void unfilterRGBA(uint8_t filter, uint8_t* row, const uint8_t* prev, size_t n)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		switch (filter) {
+		case 1:
+			{
+				__m128i a = zero;
+				for (size_t i = 0; i < n; i += 4) {
+					a = _mm_add_epi8(a, load4(row + i));
+					store4(row + i, a);
+				}
+			}
+			break;
+		case 3:
+			{
+				const __m128i one = _mm_set1_epi8(1);
+				__m128i a = zero;
+				for (size_t i = 0; i < n; i += 4) {
+					const __m128i b = load4(prev + i);
+					// avg_epu8 rounds up, where PNG rounds down
+					const __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+					a = _mm_add_epi8(load4(row + i), avg);
+					store4(row + i, a);
+				}
+			}
+			break;
+		case 4:
+			{
+				__m128i a = zero;
+				__m128i c = zero;
+				for (size_t i = 0; i < n; i += 4) {
+					const __m128i b = _mm_unpacklo_epi8(load4(prev + i), zero);
+					const __m128i pa0 = _mm_sub_epi16(b, c);
+					const __m128i pb0 = _mm_sub_epi16(a, c);
+					const __m128i pc = abs16(_mm_add_epi16(pa0, pb0));
+					const __m128i pa = abs16(pa0);
+					const __m128i pb = abs16(pb0);
+					const __m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+					const __m128i nearest = select(_mm_cmpeq_epi16(smallest, pa), a, select(_mm_cmpeq_epi16(smallest, pb), b, c));
+
+					const __m128i d = _mm_add_epi8(load4(row + i), _mm_packus_epi16(nearest, zero));
+					store4(row + i, d);
+					a = _mm_unpacklo_epi8(d, zero);
+					c = b;
+				}
+			}
+			break;
+		}
+	}
+#endif
+
+	void unfilterRow(uint8_t filter, uint8_t* row, const uint8_t* prev, size_t n, size_t bpp)
+	{
+		if (filter == 0) {
+			return;
+		}
+		if (filter == 2) {
+			for (size_t i = 0; i < n; ++i) {
+				row[i] = uint8_t(row[i] + prev[i]);
+			}
+			return;
+		}
+
+#ifdef HAS_SSE
+		if (bpp == 4) {
+			unfilterRGBA(filter, row, prev, n);
+			return;
+		}
+#endif
+		unfilterScalar(filter, row, prev, n, bpp);
+	}
+
+	// Matches lodepng's conversions, e.g. grey is taken from the red channel
+	void convertRow(const PNGInfo& info, const uint8_t* src, uint8_t* dst, int dstChannels)
+	{
+		const size_t w = info.w;
+		switch (info.colourType) {
+		case Grey:
+			for (size_t x = 0; x < w; ++x) {
+				const uint8_t v = src[x];
+				for (int c = 0; c < std::min(dstChannels, 3); ++c) {
+					*dst++ = v;
+				}
+				if (dstChannels == 4) {
+					*dst++ = info.hasKey && v == info.key[0] ? 0 : 255;
+				}
+			}
+			break;
+		case GreyAlpha:
+			for (size_t x = 0; x < w; ++x) {
+				const uint8_t v = src[x * 2];
+				for (int c = 0; c < std::min(dstChannels, 3); ++c) {
+					*dst++ = v;
+				}
+				if (dstChannels == 4) {
+					*dst++ = src[x * 2 + 1];
+				}
+			}
+			break;
+		case RGB:
+			if (dstChannels == 3) {
+				memcpy(dst, src, w * 3);
+			} else if (dstChannels == 4) {
+				for (size_t x = 0; x < w; ++x) {
+					const uint8_t* p = src + x * 3;
+					dst[0] = p[0];
+					dst[1] = p[1];
+					dst[2] = p[2];
+					dst[3] = info.hasKey && p[0] == info.key[0] && p[1] == info.key[1] && p[2] == info.key[2] ? 0 : 255;
+					dst += 4;
+				}
+			} else {
+				for (size_t x = 0; x < w; ++x) {
+					dst[x] = src[x * 3];
+				}
+			}
+			break;
+		case Palette:
+			for (size_t x = 0; x < w; ++x) {
+				const auto& entry = info.palette[src[x]];
+				memcpy(dst, entry.data(), size_t(dstChannels));
+				dst += dstChannels;
+			}
+			break;
+		case RGBA:
+			if (dstChannels == 4) {
+				memcpy(dst, src, w * 4);
+			} else {
+				for (size_t x = 0; x < w; ++x) {
+					memcpy(dst, src + x * 4, size_t(dstChannels));
+					dst += dstChannels;
+				}
+			}
+			break;
+		}
+	}
+}
+
+char* PNGDecoder::decode(gsl::span<const gsl::byte> bytes, int dstChannels, unsigned& w, unsigned& h)
+{
+	Expects(dstChannels == 1 || dstChannels == 3 || dstChannels == 4);
+
+	PNGInfo info;
+	if (!readChunks(bytes, info)) {
+		return nullptr;
+	}
+
+	const size_t stride = size_t(info.w) * info.bpp;
+	const size_t filteredSize = (stride + 1) * info.h;
+	Bytes scanlines;
+	try {
+		scanlines = Compression::decompressRaw(gsl::as_bytes(gsl::span<const uint8_t>(info.idat)), filteredSize, filteredSize);
+	} catch (Exception&) {
+		return nullptr;
+	}
+	if (scanlines.size() < filteredSize) {
+		return nullptr;
+	}
+
+	// Unfiltering has to go in order, as each row depends on the one above it
+	const std::vector<uint8_t> zeroRow(stride, 0);
+	for (size_t y = 0; y < info.h; ++y) {
+		uint8_t* line = scanlines.data() + y * (stride + 1);
+		const uint8_t filter = line[0];
+		if (filter > 4) {
+			return nullptr;
+		}
+		const uint8_t* prev = y > 0 ? line - stride : zeroRow.data();
+		unfilterRow(filter, line + 1, prev, stride, info.bpp);
+	}
+
+	const size_t dstStride = size_t(info.w) * size_t(dstChannels);
+	auto* result = static_cast<uint8_t*>(malloc(dstStride * info.h));
+	if (!result) {
+		return nullptr;
+	}
+
+	// Conversion is independent per row, so large images are split across threads
+	constexpr size_t rowsPerTask = 64;
+	std::vector<size_t> bands;
+	for (size_t y = 0; y < info.h; y += rowsPerTask) {
+		bands.push_back(y);
+	}
+	auto convertBand = [&] (size_t y0)
+	{
+		const size_t y1 = std::min(y0 + rowsPerTask, size_t(info.h));
+		for (size_t y = y0; y < y1; ++y) {
+			convertRow(info, scanlines.data() + y * (stride + 1) + 1, result + y * dstStride, dstChannels);
+		}
+	};
+	const bool parallel = dstStride * info.h >= 1024 * 1024 && Executors::isDefined();
+	if (parallel) {
+		Concurrent::foreach(Executors::getCPU(), bands.begin(), bands.end(), convertBand, 1);
+	} else {
+		for (auto y: bands) {
+			convertBand(y);
+		}
+	}
+
+	w = info.w;
+	h = info.h;
+	return reinterpret_cast<char*>(result);
+}
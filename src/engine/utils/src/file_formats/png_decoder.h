@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+#include <gsl/gsl>
+
+namespace Halley {
+	// Decodes the PNGs that the engine actually ships (8 bits per channel, not interlaced) with zlib and SIMD unfiltering,
+	// straight into 1, 3 or 4 channels per pixel, converting the same way lodepng does.
+	// Anything else (16-bit, sub-byte, interlaced, corrupt) returns nullptr, and should be decoded with lodepng instead.
+	class PNGDecoder {
+	public:
+		// The result is allocated with malloc
+		static char* decode(gsl::span<const gsl::byte> bytes, int dstChannels, unsigned& w, unsigned& h);
+	};
+}
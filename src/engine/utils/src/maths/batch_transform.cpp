@@ -0,0 +1,299 @@
+#include "halley/maths/batch_transform.h"
+#include "halley/maths/matrix4.h"
+#include <gsl/gsl_assert>
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386)
+#define HAS_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace Halley;
+
+static_assert(sizeof(Vector2f) == 2 * sizeof(float), "Vector2f must be two packed floats");
+
+namespace {
+	// The kernels are written once, over these
+#if defined(HAS_SSE)
+	#define HAS_SIMD
+	using F4 = __m128;
+	inline F4 set4(float v) { return _mm_set1_ps(v); }
+	inline F4 load4(const float* p) { return _mm_loadu_ps(p); }
+	inline void store4(float* p, F4 v) { _mm_storeu_ps(p, v); }
+	inline F4 add4(F4 a, F4 b) { return _mm_add_ps(a, b); }
+	inline F4 sub4(F4 a, F4 b) { return _mm_sub_ps(a, b); }
+	inline F4 mul4(F4 a, F4 b) { return _mm_mul_ps(a, b); }
+	inline F4 div4(F4 a, F4 b) { return _mm_div_ps(a, b); }
+	inline F4 min4(F4 a, F4 b) { return _mm_min_ps(a, b); }
+	inline F4 max4(F4 a, F4 b) { return _mm_max_ps(a, b); }
+
+	inline void loadXY(const Vector2f* p, F4& x, F4& y)
+	{
+		const F4 a = _mm_loadu_ps(&p[0].x);
+		const F4 b = _mm_loadu_ps(&p[2].x);
+		x = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+		y = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+	}
+
+	inline void storeXY(Vector2f* p, F4 x, F4 y)
+	{
+		_mm_storeu_ps(&p[0].x, _mm_unpacklo_ps(x, y));
+		_mm_storeu_ps(&p[2].x, _mm_unpackhi_ps(x, y));
+	}
+#elif defined(HAS_NEON)
+	#define HAS_SIMD
+	using F4 = float32x4_t;
+	inline F4 set4(float v) { return vdupq_n_f32(v); }
+	inline F4 load4(const float* p) { return vld1q_f32(p); }
+	inline void store4(float* p, F4 v) { vst1q_f32(p, v); }
+	inline F4 add4(F4 a, F4 b) { return vaddq_f32(a, b); }
+	inline F4 sub4(F4 a, F4 b) { return vsubq_f32(a, b); }
+	inline F4 mul4(F4 a, F4 b) { return vmulq_f32(a, b); }
+	inline F4 min4(F4 a, F4 b) { return vminq_f32(a, b); }
+	inline F4 max4(F4 a, F4 b) { return vmaxq_f32(a, b); }
+
+	inline F4 div4(F4 a, F4 b)
+	{
+		// ARMv7 only has a reciprocal estimate, which wouldn't match the scalar maths
+		float x[4];
+		float y[4];
+		vst1q_f32(x, a);
+		vst1q_f32(y, b);
+		for (int i = 0; i < 4; ++i) {
+			x[i] /= y[i];
+		}
+		return vld1q_f32(x);
+	}
+
+	inline void loadXY(const Vector2f* p, F4& x, F4& y)
+	{
+		const float32x4x2_t v = vld2q_f32(&p[0].x);
+		x = v.val[0];
+		y = v.val[1];
+	}
+
+	inline void storeXY(Vector2f* p, F4 x, F4 y)
+	{
+		float32x4x2_t v;
+		v.val[0] = x;
+		v.val[1] = y;
+		vst2q_f32(&p[0].x, v);
+	}
+#endif
+
+	void checkSizes(gsl::span<const Vector2f> positions, gsl::span<const Vector2f> pivots, gsl::span<const Vector2f> sizes, gsl::span<const float> rotations)
+	{
+		Expects(pivots.size() == positions.size());
+		Expects(sizes.size() == positions.size());
+		Expects(rotations.size() == positions.size());
+	}
+
+	// Corners relative to the position, before rotating
+	struct QuadExtents
+	{
+		float x0, x1, y0, y1;
+
+		QuadExtents(Vector2f pivot, Vector2f size)
+			: x0(-pivot.x * size.x)
+			, x1(-pivot.x * size.x + size.x)
+			, y0(-pivot.y * size.y)
+			, y1(-pivot.y * size.y + size.y)
+		{}
+	};
+
+	inline void computeAABB(Vector2f pos, Vector2f pivot, Vector2f size, float rotation, float& minX, float& minY, float& maxX, float& maxY)
+	{
+		// x' = c * x - s * y and y' = s * x + c * y, so each coordinate's extremes are the sum of the extremes of each term
+		const QuadExtents e(pivot, size);
+		const float c = std::cos(rotation);
+		const float s = std::sin(rotation);
+		minX = pos.x + std::min(c * e.x0, c * e.x1) + std::min(-s * e.y0, -s * e.y1);
+		maxX = pos.x + std::max(c * e.x0, c * e.x1) + std::max(-s * e.y0, -s * e.y1);
+		minY = pos.y + std::min(s * e.x0, s * e.x1) + std::min(c * e.y0, c * e.y1);
+		maxY = pos.y + std::max(s * e.x0, s * e.x1) + std::max(c * e.y0, c * e.y1);
+	}
+
+#if defined(HAS_SIMD)
+	struct QuadExtents4
+	{
+		F4 posX, posY, c, s, x0, x1, y0, y1;
+
+		QuadExtents4(const Vector2f* positions, const Vector2f* pivots, const Vector2f* sizes, const float* rotations)
+		{
+			// There's no vector sin or cos, but these are a small part of the cost
+			float cs[4];
+			float sn[4];
+			for (int i = 0; i < 4; ++i) {
+				cs[i] = std::cos(rotations[i]);
+				sn[i] = std::sin(rotations[i]);
+			}
+			c = load4(cs);
+			s = load4(sn);
+
+			F4 pivotX, pivotY, sizeX, sizeY;
+			loadXY(positions, posX, posY);
+			loadXY(pivots, pivotX, pivotY);
+			loadXY(sizes, sizeX, sizeY);
+			const F4 zero = set4(0);
+			x0 = mul4(sub4(zero, pivotX), sizeX);
+			x1 = add4(x0, sizeX);
+			y0 = mul4(sub4(zero, pivotY), sizeY);
+			y1 = add4(y0, sizeY);
+		}
+	};
+#endif
+}
+
+void BatchTransform::transformPoints(const Matrix4f& m, gsl::span<const Vector2f> src, gsl::span<Vector2f> dst)
+{
+	Expects(dst.size() >= src.size());
+
+	const float m00 = m.getElement(0, 0);
+	const float m10 = m.getElement(1, 0);
+	const float m30 = m.getElement(3, 0);
+	const float m01 = m.getElement(0, 1);
+	const float m11 = m.getElement(1, 1);
+	const float m31 = m.getElement(3, 1);
+	const float m03 = m.getElement(0, 3);
+	const float m13 = m.getElement(1, 3);
+	const float m33 = m.getElement(3, 3);
+	const bool affine = m03 == 0 && m13 == 0 && m33 == 1; // w is always 1, and dividing by it wouldn't change anything
+
+	const size_t n = size_t(src.size());
+	size_t i = 0;
+#if defined(HAS_SIMD)
+	const F4 v00 = set4(m00);
+	const F4 v10 = set4(m10);
+	const F4 v30 = set4(m30);
+	const F4 v01 = set4(m01);
+	const F4 v11 = set4(m11);
+	const F4 v31 = set4(m31);
+	const F4 v03 = set4(m03);
+	const F4 v13 = set4(m13);
+	const F4 v33 = set4(m33);
+	for (; i + 4 <= n; i += 4) {
+		F4 x, y;
+		loadXY(src.data() + i, x, y);
+		F4 rx = add4(add4(mul4(v00, x), mul4(v10, y)), v30);
+		F4 ry = add4(add4(mul4(v01, x), mul4(v11, y)), v31);
+		if (!affine) {
+			const F4 w = add4(add4(mul4(v03, x), mul4(v13, y)), v33);
+			rx = div4(rx, w);
+			ry = div4(ry, w);
+		}
+		storeXY(dst.data() + i, rx, ry);
+	}
+#endif
+	for (; i < n; ++i) {
+		const Vector2f p = src[i];
+		float rx = m00 * p.x + m10 * p.y + m30;
+		float ry = m01 * p.x + m11 * p.y + m31;
+		if (!affine) {
+			const float w = m03 * p.x + m13 * p.y + m33;
+			rx /= w;
+			ry /= w;
+		}
+		dst[i] = Vector2f(rx, ry);
+	}
+}
+
+void BatchTransform::computeQuads(gsl::span<const Vector2f> positions, gsl::span<const Vector2f> pivots, gsl::span<const Vector2f> sizes, gsl::span<const float> rotations, gsl::span<Vector2f> corners)
+{
+	checkSizes(positions, pivots, sizes, rotations);
+	Expects(corners.size() >= positions.size() * 4);
+
+	const size_t n = size_t(positions.size());
+	size_t i = 0;
+#if defined(HAS_SIMD)
+	for (; i + 4 <= n; i += 4) {
+		const QuadExtents4 q(positions.data() + i, pivots.data() + i, sizes.data() + i, rotations.data() + i);
+		const F4 xs[4] = { q.x0, q.x1, q.x1, q.x0 };
+		const F4 ys[4] = { q.y0, q.y0, q.y1, q.y1 };
+
+		for (size_t k = 0; k < 4; ++k) {
+			const F4 x = add4(q.posX, sub4(mul4(q.c, xs[k]), mul4(q.s, ys[k])));
+			const F4 y = add4(q.posY, add4(mul4(q.s, xs[k]), mul4(q.c, ys[k])));
+
+			// Corner k of four quads, which are four corners apart in the output
+			Vector2f result[4];
+			storeXY(result, x, y);
+			for (size_t j = 0; j < 4; ++j) {
+				corners[(i + j) * 4 + k] = result[j];
+			}
+		}
+	}
+#endif
+	for (; i < n; ++i) {
+		const QuadExtents e(pivots[i], sizes[i]);
+		const float c = std::cos(rotations[i]);
+		const float s = std::sin(rotations[i]);
+		const Vector2f pos = positions[i];
+		const float xs[4] = { e.x0, e.x1, e.x1, e.x0 };
+		const float ys[4] = { e.y0, e.y0, e.y1, e.y1 };
+		for (size_t k = 0; k < 4; ++k) {
+			corners[i * 4 + k] = pos + Vector2f(c * xs[k] - s * ys[k], s * xs[k] + c * ys[k]);
+		}
+	}
+}
+
+void BatchTransform::computeAABBs(gsl::span<const Vector2f> positions, gsl::span<const Vector2f> pivots, gsl::span<const Vector2f> sizes, gsl::span<const float> rotations, gsl::span<Rect4f> aabbs)
+{
+	checkSizes(positions, pivots, sizes, rotations);
+	Expects(aabbs.size() >= positions.size());
+
+	// Small batches at a time, so the split arrays stay in the cache
+	constexpr size_t chunk = 64;
+	float minX[chunk];
+	float minY[chunk];
+	float maxX[chunk];
+	float maxY[chunk];
+	const size_t n = size_t(positions.size());
+	for (size_t start = 0; start < n; start += chunk) {
+		const auto len = ptrdiff_t(std::min(chunk, n - start));
+		const auto first = ptrdiff_t(start);
+		computeAABBs(positions.subspan(first, len), pivots.subspan(first, len), sizes.subspan(first, len), rotations.subspan(first, len),
+			gsl::span<float>(minX, len), gsl::span<float>(minY, len), gsl::span<float>(maxX, len), gsl::span<float>(maxY, len));
+		for (ptrdiff_t i = 0; i < len; ++i) {
+			aabbs[first + i] = Rect4f(Vector2f(minX[i], minY[i]), Vector2f(maxX[i], maxY[i]));
+		}
+	}
+}
+
+void BatchTransform::computeAABBs(gsl::span<const Vector2f> positions, gsl::span<const Vector2f> pivots, gsl::span<const Vector2f> sizes, gsl::span<const float> rotations,
+	gsl::span<float> minX, gsl::span<float> minY, gsl::span<float> maxX, gsl::span<float> maxY)
+{
+	checkSizes(positions, pivots, sizes, rotations);
+	Expects(minX.size() >= positions.size() && minY.size() >= positions.size());
+	Expects(maxX.size() >= positions.size() && maxY.size() >= positions.size());
+
+	const size_t n = size_t(positions.size());
+	size_t i = 0;
+#if defined(HAS_SIMD)
+	const F4 zero = set4(0);
+	for (; i + 4 <= n; i += 4) {
+		const QuadExtents4 q(positions.data() + i, pivots.data() + i, sizes.data() + i, rotations.data() + i);
+		const F4 ns = sub4(zero, q.s);
+		const F4 ax0 = mul4(q.c, q.x0);
+		const F4 ax1 = mul4(q.c, q.x1);
+		const F4 bx0 = mul4(ns, q.y0);
+		const F4 bx1 = mul4(ns, q.y1);
+		const F4 ay0 = mul4(q.s, q.x0);
+		const F4 ay1 = mul4(q.s, q.x1);
+		const F4 by0 = mul4(q.c, q.y0);
+		const F4 by1 = mul4(q.c, q.y1);
+		store4(minX.data() + i, add4(q.posX, add4(min4(ax0, ax1), min4(bx0, bx1))));
+		store4(maxX.data() + i, add4(q.posX, add4(max4(ax0, ax1), max4(bx0, bx1))));
+		store4(minY.data() + i, add4(q.posY, add4(min4(ay0, ay1), min4(by0, by1))));
+		store4(maxY.data() + i, add4(q.posY, add4(max4(ay0, ay1), max4(by0, by1))));
+	}
+#endif
+	for (; i < n; ++i) {
+		computeAABB(positions[i], pivots[i], sizes[i], rotations[i], minX[i], minY[i], maxX[i], maxY[i]);
+	}
+}
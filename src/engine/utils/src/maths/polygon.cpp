@@ -62,6 +62,12 @@ void Polygon::realize()
 	}
 	aabb.set(Vector2f(x1, y1), Vector2f(x2, y2));
 	outerRadius = sqrt(outerRadius);
+
+	// Edge normals are the separating axes to try, and don't move with the origin
+	normals.resize(len);
+	for (size_t i=0;i<len;i++) {
+		normals[i] = (vertices[(i+1)%len] - vertices[i]).orthoLeft().unit();
+	}
 }
 
 
@@ -128,9 +134,7 @@ bool Polygon::overlaps(const Polygon &param,Vector2f *translation,Vector2f *coll
 	size_t len2 = param.vertices.size();
 	for (size_t i=0; i<len1+len2; i++) {
 		// Find the orthonormal axis
-		Vector2f axis;
-		if (i < len1) axis = (vertices[(i+1)%len1] - vertices[i]).orthoLeft().unit();
-		else axis = (param.vertices[(i-len1+1)%len2] - param.vertices[i-len1]).orthoLeft().unit();
+		const Vector2f axis = i < len1 ? normals[i] : param.normals[i-len1];
 
 		// Project both polygons there
 		float min1, max1, min2, max2;
@@ -0,0 +1,287 @@
+#include "halley/maths/polygon_batch.h"
+#include <algorithm>
+#include <limits>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386)
+#define HAS_SSE
+#include <xmmintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define HAS_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace Halley;
+
+struct PolygonBatch::Shape
+{
+	const float* vertexX;
+	const float* vertexY;
+	size_t nVertices; // Multiple of 4
+	const float* axisX;
+	const float* axisY;
+	size_t nAxes;
+	float originX;
+	float originY;
+	float radius;
+};
+
+namespace {
+	// Padding repeats the last vertex, which doesn't change the projection
+	void appendVertices(const VertexList& vertices, Vector<float>& xs, Vector<float>& ys)
+	{
+		const size_t n = vertices.size();
+		const size_t padded = (n + 3) & ~size_t(3);
+		for (size_t i = 0; i < padded; ++i) {
+			const auto& v = vertices[std::min(i, n - 1)];
+			xs.push_back(v.x);
+			ys.push_back(v.y);
+		}
+	}
+
+	void project(const PolygonBatch::Shape& shape, float ax, float ay, float& outMin, float& outMax);
+
+	bool doOverlap(const PolygonBatch::Shape& a, const PolygonBatch::Shape& b)
+	{
+		if (a.nVertices == 0 || b.nVertices == 0) {
+			return false;
+		}
+
+		// Check if they are within overlap range
+		const float dx = a.originX - b.originX;
+		const float dy = a.originY - b.originY;
+		const float maxDist = a.radius + b.radius;
+		if (dx * dx + dy * dy >= maxDist * maxDist) {
+			return false;
+		}
+
+		auto separates = [&] (float ax, float ay)
+		{
+			float min1, max1, min2, max2;
+			project(a, ax, ay, min1, max1);
+			project(b, ax, ay, min2, max2);
+			const float dist = min1 < min2 ? min2 - max1 : min1 - max2;
+			return dist >= 0;
+		};
+
+		for (size_t i = 0; i < a.nAxes; ++i) {
+			if (separates(a.axisX[i], a.axisY[i])) {
+				return false;
+			}
+		}
+		for (size_t i = 0; i < b.nAxes; ++i) {
+			if (separates(b.axisX[i], b.axisY[i])) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// The origin is factored out of the dot product, so it's added once rather than to every vertex
+	void project(const PolygonBatch::Shape& shape, float ax, float ay, float& outMin, float& outMax)
+	{
+		const float* xs = shape.vertexX;
+		const float* ys = shape.vertexY;
+		const size_t n = shape.nVertices;
+		float min;
+		float max;
+
+#if defined(HAS_SSE)
+		const __m128 axisX = _mm_set1_ps(ax);
+		const __m128 axisY = _mm_set1_ps(ay);
+		__m128 vMin = _mm_set1_ps(std::numeric_limits<float>::max());
+		__m128 vMax = _mm_set1_ps(std::numeric_limits<float>::lowest());
+		for (size_t i = 0; i < n; i += 4) {
+			const __m128 dot = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(xs + i), axisX), _mm_mul_ps(_mm_loadu_ps(ys + i), axisY));
+			vMin = _mm_min_ps(vMin, dot);
+			vMax = _mm_max_ps(vMax, dot);
+		}
+		vMin = _mm_min_ps(vMin, _mm_shuffle_ps(vMin, vMin, _MM_SHUFFLE(2, 3, 0, 1)));
+		vMin = _mm_min_ss(vMin, _mm_movehl_ps(vMin, vMin));
+		vMax = _mm_max_ps(vMax, _mm_shuffle_ps(vMax, vMax, _MM_SHUFFLE(2, 3, 0, 1)));
+		vMax = _mm_max_ss(vMax, _mm_movehl_ps(vMax, vMax));
+		min = _mm_cvtss_f32(vMin);
+		max = _mm_cvtss_f32(vMax);
+#elif defined(HAS_NEON)
+		const float32x4_t axisX = vdupq_n_f32(ax);
+		const float32x4_t axisY = vdupq_n_f32(ay);
+		float32x4_t vMin = vdupq_n_f32(std::numeric_limits<float>::max());
+		float32x4_t vMax = vdupq_n_f32(std::numeric_limits<float>::lowest());
+		for (size_t i = 0; i < n; i += 4) {
+			const float32x4_t dot = vmlaq_f32(vmulq_f32(vld1q_f32(xs + i), axisX), vld1q_f32(ys + i), axisY);
+			vMin = vminq_f32(vMin, dot);
+			vMax = vmaxq_f32(vMax, dot);
+		}
+		float32x2_t pMin = vpmin_f32(vget_low_f32(vMin), vget_high_f32(vMin));
+		float32x2_t pMax = vpmax_f32(vget_low_f32(vMax), vget_high_f32(vMax));
+		min = vget_lane_f32(vpmin_f32(pMin, pMin), 0);
+		max = vget_lane_f32(vpmax_f32(pMax, pMax), 0);
+#else
+		min = std::numeric_limits<float>::max();
+		max = std::numeric_limits<float>::lowest();
+		for (size_t i = 0; i < n; ++i) {
+			const float dot = xs[i] * ax + ys[i] * ay;
+			min = std::min(min, dot);
+			max = std::max(max, dot);
+		}
+#endif
+
+		const float offset = ax * shape.originX + ay * shape.originY;
+		outMin = min + offset;
+		outMax = max + offset;
+	}
+
+	// A single polygon, laid out like the ones in the batch for the duration of a query
+	class QueryShape {
+	public:
+		explicit QueryShape(const Polygon& polygon)
+		{
+			auto& vertices = polygon.getVertices();
+			if (!vertices.empty()) {
+				appendVertices(vertices, vertexX, vertexY);
+			}
+			for (auto& n: polygon.getNormals()) {
+				axisX.push_back(n.x);
+				axisY.push_back(n.y);
+			}
+
+			shape.vertexX = vertexX.data();
+			shape.vertexY = vertexY.data();
+			shape.nVertices = vertexX.size();
+			shape.axisX = axisX.data();
+			shape.axisY = axisY.data();
+			shape.nAxes = axisX.size();
+			shape.originX = polygon.getOrigin().x;
+			shape.originY = polygon.getOrigin().y;
+			shape.radius = polygon.getRadius();
+		}
+
+		const PolygonBatch::Shape& get() const { return shape; }
+
+	private:
+		Vector<float> vertexX;
+		Vector<float> vertexY;
+		Vector<float> axisX;
+		Vector<float> axisY;
+		PolygonBatch::Shape shape;
+	};
+}
+
+PolygonBatch::PolygonId PolygonBatch::add(const Polygon& polygon)
+{
+	const auto id = PolygonId(size());
+	auto& vertices = polygon.getVertices();
+
+	vertexStart.push_back(uint32_t(vertexX.size()));
+	if (!vertices.empty()) {
+		appendVertices(vertices, vertexX, vertexY);
+	}
+	vertexCount.push_back(uint32_t(vertexX.size()) - vertexStart.back());
+
+	axisStart.push_back(uint32_t(axisX.size()));
+	for (auto& n: polygon.getNormals()) {
+		axisX.push_back(n.x);
+		axisY.push_back(n.y);
+	}
+	axisCount.push_back(uint32_t(axisX.size()) - axisStart.back());
+
+	originX.push_back(polygon.getOrigin().x);
+	originY.push_back(polygon.getOrigin().y);
+	radius.push_back(polygon.getRadius());
+	return id;
+}
+
+void PolygonBatch::setOrigin(PolygonId id, Vector2f origin)
+{
+	originX.at(id) = origin.x;
+	originY.at(id) = origin.y;
+}
+
+Vector2f PolygonBatch::getOrigin(PolygonId id) const
+{
+	return Vector2f(originX.at(id), originY.at(id));
+}
+
+size_t PolygonBatch::size() const
+{
+	return radius.size();
+}
+
+void PolygonBatch::clear()
+{
+	vertexX.clear();
+	vertexY.clear();
+	axisX.clear();
+	axisY.clear();
+	vertexStart.clear();
+	vertexCount.clear();
+	axisStart.clear();
+	axisCount.clear();
+	originX.clear();
+	originY.clear();
+	radius.clear();
+}
+
+bool PolygonBatch::overlaps(PolygonId id, const Polygon& polygon) const
+{
+	Expects(id < size());
+	return doOverlap(getShape(id), QueryShape(polygon).get());
+}
+
+bool PolygonBatch::overlaps(PolygonId id, const PolygonBatch& other, PolygonId otherId) const
+{
+	Expects(id < size());
+	Expects(otherId < other.size());
+	return doOverlap(getShape(id), other.getShape(otherId));
+}
+
+void PolygonBatch::getOverlapping(const Polygon& polygon, Vector<PolygonId>& result) const
+{
+	const QueryShape query(polygon);
+	const auto n = PolygonId(size());
+	for (PolygonId i = 0; i < n; ++i) {
+		if (doOverlap(getShape(i), query.get())) {
+			result.push_back(i);
+		}
+	}
+}
+
+void PolygonBatch::getOverlapping(const Polygon& polygon, gsl::span<const PolygonId> candidates, Vector<PolygonId>& result) const
+{
+	const QueryShape query(polygon);
+	for (auto i: candidates) {
+		Expects(i < size());
+		if (doOverlap(getShape(i), query.get())) {
+			result.push_back(i);
+		}
+	}
+}
+
+void PolygonBatch::getOverlappingPairs(const PolygonBatch& other, gsl::span<const std::pair<PolygonId, PolygonId>> pairs, Vector<size_t>& result) const
+{
+	const size_t n = size_t(pairs.size());
+	for (size_t i = 0; i < n; ++i) {
+		const auto& pair = pairs[i];
+		Expects(pair.first < size());
+		Expects(pair.second < other.size());
+		if (doOverlap(getShape(pair.first), other.getShape(pair.second))) {
+			result.push_back(i);
+		}
+	}
+}
+
+PolygonBatch::Shape PolygonBatch::getShape(PolygonId id) const
+{
+	Shape shape;
+	shape.vertexX = vertexX.data() + vertexStart[id];
+	shape.vertexY = vertexY.data() + vertexStart[id];
+	shape.nVertices = vertexCount[id];
+	shape.axisX = axisX.data() + axisStart[id];
+	shape.axisY = axisY.data() + axisStart[id];
+	shape.nAxes = axisCount[id];
+	shape.originX = originX[id];
+	shape.originY = originY[id];
+	shape.radius = radius[id];
+	return shape;
+}
@@ -26,11 +26,75 @@
 #include "mt199937ar.h"
 using namespace Halley;
 
+namespace {
+	// Used to expand seeds into xoshiro's state, as recommended by its authors, since it must not be all zeroes
+	uint64_t splitMix64(uint64_t& x)
+	{
+		uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	inline uint64_t rotl(uint64_t x, int k)
+	{
+		return (x << k) | (x >> (64 - k));
+	}
+
+	inline uint64_t xoshiroNext(std::array<uint64_t, 4>& s)
+	{
+		const uint64_t result = rotl(s[1] * 5, 7) * 9;
+		const uint64_t t = s[1] << 17;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 45);
+		return result;
+	}
+
+	// The top bits are the best ones
+	inline float toFloat(uint64_t x)
+	{
+		return float(x >> 40) * (1.0f / 16777216.0f);
+	}
+
+	inline double toDouble(uint64_t x)
+	{
+		return double(x >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+	constexpr uint32_t defaultSeed = 5489; // Same as MT19937's
+}
+
 Random::Random()
-	: generator(std::make_unique<MT199937AR>())
+	: Random(Algorithm::MT19937)
 {
 }
 
+Random::Random(Algorithm algorithm)
+	: algorithm(algorithm)
+{
+	if (algorithm == Algorithm::MT19937) {
+		generator = std::make_unique<MT199937AR>();
+	} else {
+		setSeed(defaultSeed);
+	}
+}
+
+Random::Random(uint32_t seed, Algorithm algorithm)
+	: Random(algorithm)
+{
+	setSeed(seed);
+}
+
+Random::Random(gsl::span<const gsl::byte> data, Algorithm algorithm)
+	: Random(algorithm)
+{
+	setSeed(data);
+}
+
 Random::Random(uint32_t seed)
 	: generator(std::make_unique<MT199937AR>())
 {
@@ -80,7 +144,7 @@ int64_t Random::getInt(int64_t min, int64_t max)
 	if (min > max) {
 		std::swap(min, max);
 	}
-	const int64_t base = int64_t((uint64_t(getRawInt()) << 32ull) | uint64_t(getRawInt()));
+	const int64_t base = int64_t(getRawInt64());
 	const uint64_t range = uint64_t(max - min + 1);
 	if (range == 0) { // If min and max correspond to the whole range represented, this blows up
 		return int64_t(base);
@@ -93,7 +157,7 @@ uint64_t Random::getInt(uint64_t min, uint64_t max)
 	if (min > max) {
 		std::swap(min, max);
 	}
-	const uint64_t base = (uint64_t(getRawInt()) << 32ull) | uint64_t(getRawInt());
+	const uint64_t base = getRawInt64();
 	const uint64_t range = max - min + 1;
 	if (range == 0) { // If min and max correspond to the whole range represented, this blows up
 		return base;
@@ -148,28 +212,149 @@ void Random::getBytes(gsl::span<gsl::byte> dst)
 
 void Random::setSeed(uint32_t seed)
 {
-	 generator->init_genrand(seed);
+	if (algorithm == Algorithm::MT19937) {
+		generator->init_genrand(seed);
+	} else {
+		uint64_t x = seed;
+		for (auto& s: state) {
+			s = splitMix64(x);
+		}
+	}
 }
 
 void Random::setSeed(gsl::span<const gsl::byte> data)
 {
-	std::vector<uint32_t> initData(alignUp(size_t(data.size_bytes()), sizeof(uint32_t)) / sizeof(uint32_t), 0);
-	memcpy(initData.data(), data.data(), data.size_bytes());
-	generator->init_by_array(initData.data(), initData.size());
+	if (algorithm == Algorithm::MT19937) {
+		std::vector<uint32_t> initData(alignUp(size_t(data.size_bytes()), sizeof(uint32_t)) / sizeof(uint32_t), 0);
+		memcpy(initData.data(), data.data(), data.size_bytes());
+		generator->init_by_array(initData.data(), initData.size());
+	} else {
+		// Every byte of the seed goes through the mixer, so seeds that only differ at the end still give unrelated states
+		uint64_t x = uint64_t(data.size_bytes());
+		for (ptrdiff_t pos = 0; pos < data.size_bytes(); pos += 8) {
+			uint64_t chunk = 0;
+			memcpy(&chunk, data.data() + pos, size_t(std::min(ptrdiff_t(8), data.size_bytes() - pos)));
+			x ^= chunk;
+			splitMix64(x);
+		}
+		for (auto& s: state) {
+			s = splitMix64(x);
+		}
+	}
+}
+
+void Random::fill(gsl::span<float> dst)
+{
+	if (algorithm == Algorithm::MT19937) {
+		for (auto& v: dst) {
+			v = float(generator->genrand_real2());
+		}
+	} else {
+		// On a local copy, so the state stays in registers for the whole loop
+		auto s = state;
+		for (auto& v: dst) {
+			v = toFloat(xoshiroNext(s));
+		}
+		state = s;
+	}
+}
+
+void Random::fill(gsl::span<float> dst, float min, float max)
+{
+	fill(dst);
+	const float range = max - min;
+	for (auto& v: dst) {
+		v = v * range + min;
+	}
+}
+
+void Random::fill(gsl::span<uint32_t> dst)
+{
+	if (algorithm == Algorithm::MT19937) {
+		for (auto& v: dst) {
+			v = generator->genrand_int32();
+		}
+	} else {
+		auto s = state;
+		for (auto& v: dst) {
+			v = uint32_t(xoshiroNext(s) >> 32);
+		}
+		state = s;
+	}
+}
+
+Random::Algorithm Random::getAlgorithm() const
+{
+	return algorithm;
+}
+
+void Random::jump()
+{
+	if (algorithm != Algorithm::Xoshiro256) {
+		throw Exception("Only Xoshiro256 can jump ahead.", HalleyExceptions::Utils);
+	}
+
+	constexpr std::array<uint64_t, 4> jumpPoly = {{ 0x180EC6D33CFD0ABAull, 0xD5A61266F0C9392Cull, 0xA9582618E03FC9AAull, 0x39ABDC4529B1661Cull }};
+	std::array<uint64_t, 4> result = {{ 0, 0, 0, 0 }};
+	for (auto poly: jumpPoly) {
+		for (int b = 0; b < 64; ++b) {
+			if (poly & (uint64_t(1) << b)) {
+				for (size_t i = 0; i < 4; ++i) {
+					result[i] ^= state[i];
+				}
+			}
+			xoshiroNext(state);
+		}
+	}
+	state = result;
+}
+
+Random Random::splitStream()
+{
+	Random result(Algorithm::Xoshiro256);
+	result.state = state;
+	jump(); // Throws if this isn't Xoshiro256 too
+	return result;
 }
 
 uint32_t Random::getRawInt()
 {
-	return generator->genrand_int32();
+	if (algorithm == Algorithm::MT19937) {
+		return generator->genrand_int32();
+	} else {
+		return uint32_t(nextXoshiro() >> 32);
+	}
 }
 
 float Random::getRawFloat()
 {
-	return float(generator->genrand_real2());
+	if (algorithm == Algorithm::MT19937) {
+		return float(generator->genrand_real2());
+	} else {
+		return toFloat(nextXoshiro());
+	}
 }
 
 double Random::getRawDouble()
 {
-	return generator->genrand_res53();
+	if (algorithm == Algorithm::MT19937) {
+		return generator->genrand_res53();
+	} else {
+		return toDouble(nextXoshiro());
+	}
+}
+
+uint64_t Random::getRawInt64()
+{
+	if (algorithm == Algorithm::MT19937) {
+		return (uint64_t(getRawInt()) << 32ull) | uint64_t(getRawInt());
+	} else {
+		return nextXoshiro();
+	}
+}
+
+uint64_t Random::nextXoshiro()
+{
+	return xoshiroNext(state);
 }
 
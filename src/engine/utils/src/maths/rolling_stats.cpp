@@ -0,0 +1,65 @@
+#include "halley/maths/rolling_stats.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace Halley;
+
+RollingStats::RollingStats(size_t maxSamples)
+	: maxSamples(std::max(maxSamples, size_t(1)))
+{
+	samples.reserve(this->maxSamples);
+}
+
+void RollingStats::add(int64_t value)
+{
+	if (samples.size() < maxSamples) {
+		samples.push_back(value);
+	} else {
+		samples[next] = value;
+	}
+	next = (next + 1) % maxSamples;
+}
+
+void RollingStats::clear()
+{
+	samples.clear();
+	next = 0;
+}
+
+int64_t RollingStats::getLatest() const
+{
+	if (samples.empty()) {
+		return 0;
+	}
+	return samples[(next + maxSamples - 1) % maxSamples];
+}
+
+int64_t RollingStats::getMax() const
+{
+	return samples.empty() ? 0 : *std::max_element(samples.begin(), samples.end());
+}
+
+int64_t RollingStats::getAverage() const
+{
+	if (samples.empty()) {
+		return 0;
+	}
+	int64_t total = 0;
+	for (auto s: samples) {
+		total += s;
+	}
+	return total / int64_t(samples.size());
+}
+
+int64_t RollingStats::getPercentile(float fraction) const
+{
+	if (samples.empty()) {
+		return 0;
+	}
+	const auto rank = size_t(std::ceil(double(fraction) * double(samples.size())));
+	const auto idx = std::min(rank > 0 ? rank - 1 : 0, samples.size() - 1);
+
+	Vector<int64_t> sorted = samples;
+	std::nth_element(sorted.begin(), sorted.begin() + idx, sorted.end());
+	return sorted[idx];
+}
@@ -0,0 +1,97 @@
+#include "halley/maths/transform_2d.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace Halley;
+
+Transform2D::Transform2D()
+	: scale(1, 1)
+{}
+
+Transform2D::Transform2D(Vector2f position, Angle1f rotation, Vector2f scale)
+	: position(position)
+	, rotation(rotation)
+	, scale(scale)
+{}
+
+bool Transform2D::operator==(const Transform2D& other) const
+{
+	return position == other.position && rotation.getRadians() == other.rotation.getRadians() && scale == other.scale;
+}
+
+bool Transform2D::operator!=(const Transform2D& other) const
+{
+	return !(*this == other);
+}
+
+Affine2D::Affine2D(float a, float b, float c, float d, float tx, float ty)
+	: a(a)
+	, b(b)
+	, c(c)
+	, d(d)
+	, tx(tx)
+	, ty(ty)
+{}
+
+Affine2D::Affine2D(const Transform2D& transform)
+{
+	float s;
+	float co;
+	transform.rotation.sincos(s, co);
+	a = co * transform.scale.x;
+	b = s * transform.scale.x;
+	c = -s * transform.scale.y;
+	d = co * transform.scale.y;
+	tx = transform.position.x;
+	ty = transform.position.y;
+}
+
+Affine2D Affine2D::operator*(const Affine2D& o) const
+{
+	return Affine2D(
+		a * o.a + c * o.b,
+		b * o.a + d * o.b,
+		a * o.c + c * o.d,
+		b * o.c + d * o.d,
+		a * o.tx + c * o.ty + tx,
+		b * o.tx + d * o.ty + ty);
+}
+
+Vector2f Affine2D::transformPoint(Vector2f p) const
+{
+	return Vector2f(a * p.x + c * p.y + tx, b * p.x + d * p.y + ty);
+}
+
+Vector2f Affine2D::transformVector(Vector2f v) const
+{
+	return Vector2f(a * v.x + c * v.y, b * v.x + d * v.y);
+}
+
+Rect4f Affine2D::transformBounds(Rect4f bounds) const
+{
+	// The centre moves like a point, and the half-extents grow by the absolute value of each axis' contribution
+	const Vector2f centre = transformPoint(bounds.getCenter());
+	const Vector2f half = bounds.getSize() * 0.5f;
+	const Vector2f extent(std::abs(a) * half.x + std::abs(c) * half.y, std::abs(b) * half.x + std::abs(d) * half.y);
+	return Rect4f(centre - extent, centre + extent);
+}
+
+Transform2D Affine2D::decompose() const
+{
+	const float scaleX = std::sqrt(a * a + b * b);
+	const float det = a * d - b * c;
+	const float scaleY = scaleX > 0 ? det / scaleX : std::sqrt(c * c + d * d);
+	return Transform2D(Vector2f(tx, ty), Angle1f::fromRadians(std::atan2(b, a)), Vector2f(scaleX, scaleY));
+}
+
+Matrix4f Affine2D::toMatrix() const
+{
+	// Column-major, like the rest of Matrix4f
+	const float elements[] = {
+		a, b, 0, 0,
+		c, d, 0, 0,
+		0, 0, 1, 0,
+		tx, ty, 0, 1
+	};
+	return Matrix4f(elements);
+}
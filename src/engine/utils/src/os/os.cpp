@@ -27,7 +27,9 @@
 #include "os_linux.h"
 #include "os_freebsd.h"
 #include "halley/support/exception.h"
+#include <algorithm>
 #include <fstream>
+#include <thread>
 
 using namespace Halley;
 
@@ -131,6 +133,16 @@ int OS::runCommand(String)
 	throw Exception("Running commands is not implemented in this platform.", HalleyExceptions::OS);
 }
 
+std::unique_ptr<MemoryMappedFile> OS::mapFile(const Path&)
+{
+	return {};
+}
+
+bool OS::evictFileCache(const Path&)
+{
+	return false;
+}
+
 std::shared_ptr<IClipboard> OS::getClipboard()
 {
 	return {};
@@ -140,4 +152,23 @@ void OS::openURL(const String& url)
 {
 }
 
+uint64_t OS::getMemoryUsage()
+{
+	return 0;
+}
+
+std::vector<CPUCore> OS::getCPUTopology()
+{
+	std::vector<CPUCore> result(std::max(1u, std::thread::hardware_concurrency()));
+	for (size_t i = 0; i < result.size(); ++i) {
+		result[i].id = int(i);
+	}
+	return result;
+}
+
+bool OS::setThreadAffinity(const std::vector<int>& cpus)
+{
+	return false;
+}
+
 OS* OS::osInstance = nullptr;
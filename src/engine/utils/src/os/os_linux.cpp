@@ -118,4 +118,18 @@ void OSLinux::openURL(const String& url)
 	}
 }
 
+uint64_t OSLinux::getMemoryUsage()
+{
+	// Second field is the resident set, in pages
+	FILE* fp = fopen("/proc/self/statm", "r");
+	if (!fp) {
+		return 0;
+	}
+	unsigned long long size = 0;
+	unsigned long long resident = 0;
+	const int n = fscanf(fp, "%llu %llu", &size, &resident);
+	fclose(fp);
+	return n == 2 ? uint64_t(resident) * uint64_t(sysconf(_SC_PAGESIZE)) : 0;
+}
+
 #endif
\ No newline at end of file
@@ -33,6 +33,13 @@
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sched.h>
+#include <algorithm>
+#include <fstream>
+#endif
 
 using namespace Halley;
 
@@ -170,4 +177,180 @@ std::vector<Path> Halley::OSUnix::enumerateDirectory(const Path& path)
 	return result;
 }
 
+namespace {
+	class MemoryMappedFileUnix final : public Halley::MemoryMappedFile {
+	public:
+		MemoryMappedFileUnix(void* data, size_t size)
+			: data(data)
+			, size(size)
+		{}
+
+		~MemoryMappedFileUnix()
+		{
+			munmap(data, size);
+		}
+
+		gsl::span<const gsl::byte> getData() const override
+		{
+			return gsl::span<const gsl::byte>(static_cast<const gsl::byte*>(data), size);
+		}
+
+	private:
+		void* data;
+		size_t size;
+	};
+}
+
+std::unique_ptr<Halley::MemoryMappedFile> Halley::OSUnix::mapFile(const Path& path)
+{
+	int fd = open(path.string().c_str(), O_RDONLY);
+	if (fd < 0) {
+		return {};
+	}
+
+	Stat st;
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return {};
+	}
+
+	// The mapping keeps its own reference to the file
+	const size_t size = size_t(st.st_size);
+	void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		return {};
+	}
+	return std::make_unique<MemoryMappedFileUnix>(data, size);
+}
+
+#ifdef __linux__
+namespace {
+	const char* cpuSysPath = "/sys/devices/system/cpu/";
+
+	std::string readSysFile(const std::string& path)
+	{
+		std::ifstream in(path);
+		std::string line;
+		std::getline(in, line);
+		return line;
+	}
+
+	long long readSysNumber(const std::string& path)
+	{
+		const auto str = readSysFile(path);
+		return str.empty() ? -1 : atoll(str.c_str());
+	}
+
+	// Lists such as "0-3,8,10-11"
+	std::vector<int> parseCPUList(const std::string& str)
+	{
+		std::vector<int> result;
+		size_t pos = 0;
+		while (pos < str.size()) {
+			const auto end = std::min(str.find(',', pos), str.size());
+			const auto range = str.substr(pos, end - pos);
+			const auto dash = range.find('-');
+			const int first = atoi(range.c_str());
+			const int last = dash == std::string::npos ? first : atoi(range.c_str() + dash + 1);
+			for (int i = first; i <= last; ++i) {
+				result.push_back(i);
+			}
+			pos = end + 1;
+		}
+		return result;
+	}
+
+	int getNumaNode(int cpu)
+	{
+		// The CPU's folder has a link to its node's, where there's more than one
+		const auto path = cpuSysPath + ("cpu" + std::to_string(cpu));
+		DIR* dir = opendir(path.c_str());
+		int node = 0;
+		if (dir) {
+			while (dirent* entry = readdir(dir)) {
+				if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+					node = atoi(entry->d_name + 4);
+					break;
+				}
+			}
+			closedir(dir);
+		}
+		return node;
+	}
+}
+
+std::vector<CPUCore> OSUnix::getCPUTopology()
+{
+	auto ids = parseCPUList(readSysFile(std::string(cpuSysPath) + "online"));
+	if (ids.empty()) {
+		return OS::getCPUTopology();
+	}
+
+	std::vector<CPUCore> result(ids.size());
+	for (size_t i = 0; i < ids.size(); ++i) {
+		result[i].id = ids[i];
+		result[i].numaNode = getNumaNode(ids[i]);
+	}
+
+	// Hybrid x86 CPUs list their E-cores as their own PMU
+	const auto atoms = parseCPUList(readSysFile("/sys/devices/cpu_atom/cpus"));
+	if (!atoms.empty()) {
+		for (auto& core: result) {
+			if (std::find(atoms.begin(), atoms.end(), core.id) != atoms.end()) {
+				core.coreClass = CPUCoreClass::Efficiency;
+			}
+		}
+		return result;
+	}
+
+	// Otherwise, the slowest tier is efficiency cores, if it's well behind the fastest; big.LITTLE gives capacities, anything else at least max clocks
+	std::vector<long long> speeds(result.size());
+	for (const char* file: { "/cpu_capacity", "/cpufreq/cpuinfo_max_freq" }) {
+		for (size_t i = 0; i < result.size(); ++i) {
+			speeds[i] = readSysNumber(cpuSysPath + ("cpu" + std::to_string(result[i].id)) + file);
+		}
+		const auto range = std::minmax_element(speeds.begin(), speeds.end());
+		if (*range.first > 0) {
+			if (*range.first * 100 < *range.second * 85) {
+				for (size_t i = 0; i < result.size(); ++i) {
+					if (speeds[i] == *range.first) {
+						result[i].coreClass = CPUCoreClass::Efficiency;
+					}
+				}
+			}
+			break;
+		}
+	}
+
+	return result;
+}
+
+bool OSUnix::setThreadAffinity(const std::vector<int>& cpus)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (auto cpu: cpus) {
+		if (cpu >= 0 && cpu < CPU_SETSIZE) {
+			CPU_SET(cpu, &set);
+		}
+	}
+	return CPU_COUNT(&set) > 0 && sched_setaffinity(0, sizeof(set), &set) == 0; // 0 is the calling thread
+}
+
+bool OSUnix::evictFileCache(const Path& path)
+{
+	int fd = open(path.string().c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	// Only clean pages are dropped, so anything still being written out stays
+	fdatasync(fd);
+	const bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	close(fd);
+	return ok;
+}
+#endif
+
 #endif
@@ -37,8 +37,15 @@ namespace Halley {
 		virtual String getUserDataDir() override;
 		void createDirectories(const Path& path) override;
 		std::vector<Path> enumerateDirectory(const Path& path) override;
+		std::unique_ptr<MemoryMappedFile> mapFile(const Path& path) override;
 
 		int runCommand(String command) override;
+
+#ifdef __linux__
+		std::vector<CPUCore> getCPUTopology() override;
+		bool setThreadAffinity(const std::vector<int>& cpus) override;
+		bool evictFileCache(const Path& path) override;
+#endif
 	};
 }
 
@@ -29,6 +29,8 @@
 
 #include <thread>
 #include <chrono>
+#include <limits>
+#include <algorithm>
 #include <iostream>
 #include <winuser.h>
 #include <Lmcons.h>
@@ -41,10 +43,12 @@
 #include <fstream>
 #include <Windows.h>
 #include <shellapi.h>
+#include <Psapi.h>
 
 #pragma comment(lib, "wbemuuid.lib")
 //#pragma comment(lib, "comsupp.lib")
 #pragma comment(lib, "comsuppw.lib")
+#pragma comment(lib, "psapi.lib")
 
 
 using namespace Halley;
@@ -431,6 +435,78 @@ std::vector<Path> OSWin32::enumerateDirectory(const Path& rootPath)
 	return result;
 }
 
+namespace {
+	class MemoryMappedFileWin32 final : public MemoryMappedFile {
+	public:
+		MemoryMappedFileWin32(HANDLE file, HANDLE mapping, const void* data, size_t size)
+			: file(file)
+			, mapping(mapping)
+			, data(data)
+			, size(size)
+		{}
+
+		~MemoryMappedFileWin32()
+		{
+			UnmapViewOfFile(data);
+			CloseHandle(mapping);
+			CloseHandle(file);
+		}
+
+		gsl::span<const gsl::byte> getData() const override
+		{
+			return gsl::span<const gsl::byte>(static_cast<const gsl::byte*>(data), size);
+		}
+
+	private:
+		HANDLE file;
+		HANDLE mapping;
+		const void* data;
+		size_t size;
+	};
+}
+
+std::unique_ptr<MemoryMappedFile> OSWin32::mapFile(const Path& path)
+{
+	auto pathStr = path.getString().replaceAll("/", "\\").getUTF16();
+	HANDLE file = CreateFileW(pathStr.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return {};
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0 || uint64_t(fileSize.QuadPart) > uint64_t(std::numeric_limits<size_t>::max())) {
+		CloseHandle(file);
+		return {};
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping) {
+		CloseHandle(file);
+		return {};
+	}
+
+	const void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return {};
+	}
+
+	return std::make_unique<MemoryMappedFileWin32>(file, mapping, data, size_t(fileSize.QuadPart));
+}
+
+bool OSWin32::evictFileCache(const Path& path)
+{
+	// Opening a file unbuffered makes the cache manager flush and drop whatever it had of it
+	auto pathStr = path.getString().replaceAll("/", "\\").getUTF16();
+	HANDLE file = CreateFileW(pathStr.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	CloseHandle(file);
+	return true;
+}
+
 void OSWin32::displayError(const std::string& cs)
 {
 	std::string error = "Halley has aborted with an unhandled exception: \n\n" + cs;
@@ -622,4 +698,91 @@ void OSWin32::openURL(const String& url)
 	}
 }
 
+uint64_t OSWin32::getMemoryUsage()
+{
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return uint64_t(counters.WorkingSetSize);
+	}
+	return 0;
+}
+
+namespace {
+	// Logical CPUs are numbered across processor groups, 64 to each
+	template <typename F>
+	void forEachCPU(const GROUP_AFFINITY& mask, F f)
+	{
+		for (int bit = 0; bit < 64; ++bit) {
+			if (mask.Mask & (KAFFINITY(1) << bit)) {
+				f(int(mask.Group) * 64 + bit);
+			}
+		}
+	}
+}
+
+std::vector<CPUCore> OSWin32::getCPUTopology()
+{
+	DWORD size = 0;
+	GetLogicalProcessorInformationEx(RelationAll, nullptr, &size);
+	std::vector<char> buffer(size);
+	if (size == 0 || !GetLogicalProcessorInformationEx(RelationAll, reinterpret_cast<SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data()), &size)) {
+		return OS::getCPUTopology();
+	}
+
+	std::vector<CPUCore> result;
+	std::vector<int> efficiencyClass;
+	std::vector<std::pair<int, int>> nodes; // CPU, node
+	for (DWORD pos = 0; pos < size; ) {
+		auto& info = *reinterpret_cast<const SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX*>(buffer.data() + pos);
+		if (info.Relationship == RelationProcessorCore) {
+			for (WORD i = 0; i < info.Processor.GroupCount; ++i) {
+				forEachCPU(info.Processor.GroupMask[i], [&] (int cpu)
+				{
+					CPUCore core;
+					core.id = cpu;
+					result.push_back(core);
+					efficiencyClass.push_back(int(info.Processor.EfficiencyClass));
+				});
+			}
+		} else if (info.Relationship == RelationNumaNode) {
+			forEachCPU(info.NumaNode.GroupMask, [&] (int cpu) { nodes.emplace_back(cpu, int(info.NumaNode.NodeNumber)); });
+		}
+		pos += info.Size;
+	}
+	if (result.empty()) {
+		return OS::getCPUTopology();
+	}
+
+	// Higher efficiency classes are faster; only hybrid CPUs have more than one
+	const auto minClass = *std::min_element(efficiencyClass.begin(), efficiencyClass.end());
+	const auto maxClass = *std::max_element(efficiencyClass.begin(), efficiencyClass.end());
+	for (size_t i = 0; i < result.size(); ++i) {
+		if (minClass != maxClass && efficiencyClass[i] == minClass) {
+			result[i].coreClass = CPUCoreClass::Efficiency;
+		}
+		for (auto& n: nodes) {
+			if (n.first == result[i].id) {
+				result[i].numaNode = n.second;
+			}
+		}
+	}
+	return result;
+}
+
+bool OSWin32::setThreadAffinity(const std::vector<int>& cpus)
+{
+	// A thread can only be in one group, so any CPUs outside the first one's are left out
+	if (cpus.empty()) {
+		return false;
+	}
+	GROUP_AFFINITY affinity = {};
+	affinity.Group = WORD(cpus[0] / 64);
+	for (auto cpu: cpus) {
+		if (cpu / 64 == affinity.Group) {
+			affinity.Mask |= KAFFINITY(1) << (cpu % 64);
+		}
+	}
+	return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+}
+
 #endif
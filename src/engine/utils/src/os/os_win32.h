@@ -46,6 +46,8 @@ namespace Halley {
 		void createDirectories(const Path& path) override;
 		void atomicWriteFile(const Path& path, const Bytes& data, Maybe<Path> backupOldVersionPath) override;
 		std::vector<Path> enumerateDirectory(const Path& path) override;
+		std::unique_ptr<MemoryMappedFile> mapFile(const Path& path) override;
+		bool evictFileCache(const Path& path) override;
 
 		void displayError(const std::string& cs) override;
 		void onWindowCreated(void* window) override;
@@ -55,6 +57,10 @@ namespace Halley {
 		std::shared_ptr<IClipboard> getClipboard() override;
 
 		void openURL(const String& url) override;
+		uint64_t getMemoryUsage() override;
+
+		std::vector<CPUCore> getCPUTopology() override;
+		bool setThreadAffinity(const std::vector<int>& cpus) override;
 
 	private:
 		String runWMIQuery(String query, String parameter) const;
@@ -29,6 +29,11 @@ void Resource::onLoaded(Resources& resources)
 {
 }
 
+size_t Resource::getMemoryUsage() const
+{
+	return 0;
+}
+
 int Resource::getAssetVersion() const
 {
 	return assetVersion;
@@ -75,9 +75,9 @@ String ResourceDataStatic::getString() const
 	return String(static_cast<const char*>(getData()), getSize());
 }
 
-void ResourceDataStatic::inflate()
+void ResourceDataStatic::inflate(const String& codec)
 {
-	data = Compression::decompressToSharedPtr(getSpan(), size);
+	data = Compression::decompressToSharedPtr(getSpan(), codec, size);
 }
 
 std::unique_ptr<ResourceDataStatic> ResourceDataStatic::loadFromFileSystem(Path path)
@@ -117,8 +117,12 @@ ResourceDataStream::ResourceDataStream(String path, ResourceDataMakeReader makeR
 ResourceLoader::ResourceLoader(ResourceLoader&& loader) noexcept
 	: locator(loader.locator)
 	, name(std::move(loader.name))
+	, type(loader.type)
 	, priority(loader.priority)
 	, api(loader.api)
+	, metadata(loader.metadata)
+	, prefetched(std::move(loader.prefetched))
+	, loaded(loader.loaded)
 {
 }
 
@@ -138,20 +142,32 @@ ResourceLoader::ResourceLoader(IResourceLocator& locator, const String& name, As
 
 std::unique_ptr<ResourceDataStatic> ResourceLoader::getStatic()
 {
-	auto result = locator.getStatic(name, type);
-	if (result) {
-		if (metadata->getString("asset_compression", "") == "deflate") {
-			try {
-				result->inflate();
-			} catch (Exception &e) {
-				throw Exception("Failed to load resource \"" + getName() + "\" due to inflate exception: " + e.what(), HalleyExceptions::Resources);
-			}
+	std::unique_ptr<ResourceDataStatic> result;
+	if (prefetched) {
+		result = std::move(prefetched);
+	} else {
+		try {
+			result = fetchStatic(locator, name, type, *metadata);
+		} catch (Exception &e) {
+			throw Exception("Failed to load resource \"" + getName() + "\" due to exception: " + e.what(), HalleyExceptions::Resources);
 		}
+	}
+	if (result) {
 		loaded = true;
 	}
 	return result;
 }
 
+std::unique_ptr<ResourceDataStatic> ResourceLoader::fetchStatic(IResourceLocator& locator, const String& name, AssetType type, const Metadata& meta)
+{
+	auto result = locator.getStatic(name, type);
+	const auto codec = meta.getString("asset_compression", "");
+	if (result && !codec.isEmpty()) {
+		result->inflate(codec);
+	}
+	return result;
+}
+
 std::unique_ptr<ResourceDataStream> ResourceLoader::getStream()
 {
 	auto result = locator.getStream(name, type);
@@ -163,16 +179,30 @@ std::unique_ptr<ResourceDataStream> ResourceLoader::getStream()
 
 Future<std::unique_ptr<ResourceDataStatic>> ResourceLoader::getAsync() const
 {
+	if (prefetched) {
+		Promise<std::unique_ptr<ResourceDataStatic>> promise;
+		promise.setValue(std::move(prefetched));
+		return promise.getFuture();
+	}
+
 	std::reference_wrapper<IResourceLocator> loc = locator;
 	auto n = name;
 	auto t = type;
 	auto meta = getMeta();
 	return Concurrent::execute(Executors::getDiskIO(), [meta, loc, n, t] () -> std::unique_ptr<ResourceDataStatic>
 	{
-		auto result = loc.get().getStatic(n, t);
-		if (meta.getString("asset_compression", "") == "deflate") {
-			result->inflate();
-		}
-		return result;
+		return fetchStatic(loc.get(), n, t, meta);
 	});
 }
+
+std::function<std::unique_ptr<ResourceDataStatic>()> ResourceLoader::getFetcher() const
+{
+	std::reference_wrapper<IResourceLocator> loc = locator;
+	auto n = name;
+	auto t = type;
+	auto meta = getMeta();
+	return [meta, loc, n, t] () -> std::unique_ptr<ResourceDataStatic>
+	{
+		return fetchStatic(loc.get(), n, t, meta);
+	};
+}
@@ -0,0 +1,242 @@
+#include "halley/runner/frame_pacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <gsl/gsl_assert>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+using namespace Halley;
+
+FramePacer::FramePacer(int fixedFPS)
+	: fixedFPS(fixedFPS)
+{
+	Expects(fixedFPS > 0);
+	samples.fill(0);
+}
+
+void FramePacer::setFixedFPS(int fps)
+{
+	Expects(fps > 0);
+	fixedFPS = fps;
+}
+
+int FramePacer::getFixedFPS() const
+{
+	return fixedFPS;
+}
+
+void FramePacer::setMaxCatchUpSteps(int steps)
+{
+	Expects(steps > 0);
+	maxCatchUpSteps = steps;
+}
+
+void FramePacer::setFrameCap(int fps)
+{
+	Expects(fps >= 0);
+	frameCap = fps;
+}
+
+void FramePacer::setRefreshRate(int hz)
+{
+	Expects(hz >= 0);
+	refreshRate = hz;
+}
+
+void FramePacer::setPowerMode(FramePacerPowerMode mode, int fps)
+{
+	Expects(fps > 0);
+	powerMode = mode;
+	sustainedFPS = fps;
+}
+
+FramePacerPowerMode FramePacer::getPowerMode() const
+{
+	return powerMode;
+}
+
+void FramePacer::reset()
+{
+	started = false;
+	accumulator = 0;
+	fixedSteps = 0;
+	variableDelta = 0;
+}
+
+void FramePacer::beginFrame()
+{
+	const auto now = Clock::now();
+	if (!started) {
+		started = true;
+		lastFrameStart = nextDeadline = now;
+		realTime = simulatedTime = 0;
+	}
+
+	const Time elapsed = std::chrono::duration<Time>(now - lastFrameStart).count();
+	lastFrameStart = now;
+	addSample(elapsed);
+
+	// Anything longer than this was a stall (loading, a debugger break...), not something to catch up on
+	const Time realDelta = std::min(elapsed, 0.25);
+	const Time fixedDelta = getFixedDelta();
+
+	accumulator += realDelta;
+	fixedSteps = int(accumulator / fixedDelta);
+	int dropped = 0;
+	if (fixedSteps > maxCatchUpSteps) {
+		dropped = fixedSteps - maxCatchUpSteps;
+		stats.droppedFixedSteps += dropped;
+		accumulator -= dropped * fixedDelta;
+		fixedSteps = maxCatchUpSteps;
+	}
+	accumulator -= fixedSteps * fixedDelta;
+
+	variableDelta = std::min(realDelta, 0.1); // Never step by more than 100ms
+
+	// Dilation over the last second or so
+	realTime = realTime * 0.98 + realDelta;
+	simulatedTime = simulatedTime * 0.98 + realDelta - dropped * fixedDelta;
+	stats.timeDilation = realTime > 0 ? std::max(0.0, simulatedTime / realTime) : 1.0;
+}
+
+int FramePacer::getFixedSteps() const
+{
+	return fixedSteps;
+}
+
+Time FramePacer::getFixedDelta() const
+{
+	return 1.0 / fixedFPS;
+}
+
+Time FramePacer::getVariableDelta() const
+{
+	return variableDelta;
+}
+
+void FramePacer::endFrame()
+{
+	if (advanceDeadline()) {
+		waitUntil(nextDeadline, powerMode == FramePacerPowerMode::Performance);
+	}
+}
+
+void FramePacer::endFrame(const std::function<void()>& poll, Clock::duration pollInterval)
+{
+	Expects(pollInterval > Clock::duration::zero());
+
+	const bool wait = advanceDeadline();
+	poll();
+	while (wait) {
+		const auto now = Clock::now();
+		if (now >= nextDeadline) {
+			break;
+		}
+		waitUntil(std::min(nextDeadline, now + pollInterval), false);
+		poll();
+	}
+}
+
+bool FramePacer::advanceDeadline()
+{
+	const auto interval = getFrameInterval();
+	if (interval == Clock::duration::zero()) {
+		return false;
+	}
+
+	const auto now = Clock::now();
+	nextDeadline += interval;
+	if (nextDeadline < now) {
+		// Missed it; rather than rushing through frames to catch up, start a new grid from here
+		nextDeadline = now;
+		return false;
+	}
+	return true;
+}
+
+const FramePacerStats& FramePacer::getStats() const
+{
+	return stats;
+}
+
+FramePacer::Clock::duration FramePacer::getFrameInterval() const
+{
+	int cap = frameCap;
+	if (powerMode == FramePacerPowerMode::Sustained) {
+		cap = cap > 0 ? std::min(cap, sustainedFPS) : sustainedFPS;
+	}
+	if (cap <= 0) {
+		return Clock::duration::zero();
+	}
+
+	auto interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / cap));
+	if (refreshRate > 0) {
+		const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / refreshRate));
+		const auto periods = std::max<int64_t>(1, (interval.count() + period.count() - period.count() / 10) / period.count());
+		interval = period * periods;
+	}
+	return interval;
+}
+
+void FramePacer::addSample(Time frameTime)
+{
+	samples[nextSample] = frameTime;
+	nextSample = (nextSample + 1) % nSamples;
+	sampleCount = std::min(sampleCount + 1, nSamples);
+
+	Time sum = 0;
+	Time maxTime = 0;
+	for (size_t i = 0; i < sampleCount; ++i) {
+		sum += samples[i];
+		maxTime = std::max(maxTime, samples[i]);
+	}
+	const Time mean = sum / sampleCount;
+	Time variance = 0;
+	for (size_t i = 0; i < sampleCount; ++i) {
+		variance += (samples[i] - mean) * (samples[i] - mean);
+	}
+
+	stats.averageFrameTime = mean;
+	stats.frameTimeDeviation = std::sqrt(variance / sampleCount);
+	stats.maxFrameTime = maxTime;
+}
+
+void FramePacer::waitUntil(Clock::time_point time, bool allowSpin)
+{
+	// Sleeps overshoot by up to a scheduler tick, so stop short of the deadline and spin the rest
+	const auto spinMargin = allowSpin ? std::chrono::microseconds(1500) : std::chrono::microseconds(0);
+	const auto sleepUntil = time - spinMargin;
+
+#ifdef _WIN32
+	static thread_local HANDLE timer = [] ()
+	{
+		HANDLE t = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		return t ? t : CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+	}();
+	const auto remaining = sleepUntil - Clock::now();
+	if (timer && remaining > Clock::duration::zero()) {
+		LARGE_INTEGER due;
+		due.QuadPart = -int64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count() / 100); // Relative, in 100ns units
+		if (SetWaitableTimerEx(timer, &due, 0, nullptr, nullptr, nullptr, 0)) {
+			WaitForSingleObject(timer, INFINITE);
+		}
+	}
+#else
+	if (sleepUntil > Clock::now()) {
+		std::this_thread::sleep_until(sleepUntil);
+	}
+#endif
+
+	if (allowSpin) {
+		while (Clock::now() < time) {
+			std::this_thread::yield();
+		}
+	}
+}
@@ -7,12 +7,14 @@
 
 #include "halley/core/api/halley_api.h"
 
-#include <chrono>
-#include <thread>
 #include <cstdint>
 
 using namespace Halley;
 
+namespace {
+	constexpr auto serverPollInterval = std::chrono::milliseconds(1);
+}
+
 MainLoop::MainLoop(IMainLoopable& target, GameLoader& reloader)
 	: target(target)
 	, reloader(reloader)
@@ -21,7 +23,6 @@ MainLoop::MainLoop(IMainLoopable& target, GameLoader& reloader)
 
 void MainLoop::run()
 {
-	capFrameRate = true;
 	fps = target.getTargetFPS();
 
 	do {
@@ -33,16 +34,28 @@ void MainLoop::runLoop()
 {
 	std::cout << ConsoleColour(Console::GREEN) << "\nStarting main loop." << ConsoleColour() << std::endl;
 
-	using Clock = std::chrono::steady_clock;
-	using namespace std::chrono_literals;
+	if (fps > 0 && target.isDedicatedServer()) {
+		pacer.setFixedFPS(fps);
+		pacer.setFrameCap(fps);
+		pacer.reset();
+		target.setFramePacer(&pacer);
+
+		const auto poll = [&] () { target.onServerPoll(); };
+		while (isRunning()) {
+			if (target.transitionStage()) {
+				pacer.reset();
+			}
 
-	int64_t nSteps = 0;
-	Clock::time_point startTime;
-	Clock::time_point targetTime;
-	Clock::time_point lastTime;
-	startTime = targetTime = lastTime = Clock::now();
+			pacer.beginFrame();
+			for (int i = 0; i < pacer.getFixedSteps(); i++) {
+				target.onFixedUpdate(pacer.getFixedDelta());
+			}
+			target.onVariableUpdate(pacer.getVariableDelta());
+			pacer.endFrame(poll, serverPollInterval);
+		}
 
-	if (fps <= 0) {
+		target.setFramePacer(nullptr);
+	} else if (fps <= 0) {
 		while (isRunning()) {
 			target.transitionStage();
 			constexpr Time fixedDelta = 1.0 / 60.0;
@@ -50,37 +63,24 @@ void MainLoop::runLoop()
 			target.onVariableUpdate(fixedDelta);
 		}
 	} else {
+		pacer.setFixedFPS(fps);
+		pacer.reset();
+		target.setFramePacer(&pacer);
+
 		while (isRunning()) {
 			if (target.transitionStage()) {
-				// Reset counters
-				startTime = targetTime = lastTime = Clock::now();
-				nSteps = 0;
-			}
-			Clock::time_point curTime = Clock::now();
-
-			// Got any fixed updates to do?
-			if (curTime >= targetTime) {
-				// Figure out how many steps we need...
-				const Time fixedDelta = 1.0 / fps;
-				int stepsNeeded = int(std::chrono::duration<float>(targetTime - curTime).count() * fps);
-
-				// Run up to 5 (if we're more than 5 frames late, ignore them. C'est la vie)
-				for (int i = 0; i < std::min(stepsNeeded, 5); i++) {
-					target.onFixedUpdate(fixedDelta);
-				}
-
-				// Update target
-				nSteps += stepsNeeded;
-				targetTime = startTime + std::chrono::microseconds((nSteps * 1000000ll) / fps);
-			} else {
-				// Nope, release CPU
-				std::this_thread::yield();
+				pacer.reset();
 			}
 
-			// Run variable update
-			target.onVariableUpdate(std::min(std::chrono::duration<float>(curTime - lastTime).count(), 0.1f)); // Never step by more than 100ms
-			lastTime = curTime;
+			pacer.beginFrame();
+			for (int i = 0; i < pacer.getFixedSteps(); i++) {
+				target.onFixedUpdate(pacer.getFixedDelta());
+			}
+			target.onVariableUpdate(pacer.getVariableDelta());
+			pacer.endFrame();
 		}
+
+		target.setFramePacer(nullptr);
 	}
 
 	std::cout << ConsoleColour(Console::GREEN) << "Main loop terminated." << ConsoleColour() << std::endl;
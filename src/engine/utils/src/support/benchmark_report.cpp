@@ -0,0 +1,316 @@
+#include "halley/support/benchmark_report.h"
+#include "halley/support/exception.h"
+#include "halley/file_formats/json/json.h"
+#include "halley/os/os.h"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <thread>
+#include <gsl/gsl_assert>
+
+using namespace Halley;
+
+namespace {
+	constexpr int formatVersion = 1;
+
+	String getCompiler()
+	{
+#if defined(__clang__)
+		return String("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+		return String("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+		return "msvc " + toString(_MSC_VER);
+#else
+		return "unknown";
+#endif
+	}
+
+	String getCurrentDate()
+	{
+		const auto now = std::time(nullptr);
+		std::tm tm;
+#ifdef _WIN32
+		gmtime_s(&tm, &now);
+#else
+		gmtime_r(&now, &tm);
+#endif
+		char buffer[32];
+		std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tm);
+		return buffer;
+	}
+
+	void appendQuoted(std::string& result, const String& str)
+	{
+		result += Json::valueToQuotedString(str.c_str());
+	}
+
+	void appendNumber(std::string& result, double value)
+	{
+		result += Json::valueToString(value);
+	}
+}
+
+void BenchmarkReport::Metric::add(double sample)
+{
+	// Anything that isn't finite (e.g. a rate over no time at all) can't be compared, nor written as JSON
+	if (std::isfinite(sample)) {
+		samples.push_back(sample);
+	}
+}
+
+double BenchmarkReport::Metric::getMin() const
+{
+	return samples.empty() ? 0.0 : *std::min_element(samples.begin(), samples.end());
+}
+
+double BenchmarkReport::Metric::getMax() const
+{
+	return samples.empty() ? 0.0 : *std::max_element(samples.begin(), samples.end());
+}
+
+double BenchmarkReport::Metric::getMean() const
+{
+	return samples.empty() ? 0.0 : std::accumulate(samples.begin(), samples.end(), 0.0) / double(samples.size());
+}
+
+double BenchmarkReport::Metric::getMedian() const
+{
+	return getPercentile(0.5);
+}
+
+double BenchmarkReport::Metric::getStandardDeviation() const
+{
+	if (samples.size() < 2) {
+		return 0.0;
+	}
+	const double mean = getMean();
+	double total = 0;
+	for (auto& s: samples) {
+		total += (s - mean) * (s - mean);
+	}
+	return std::sqrt(total / double(samples.size() - 1));
+}
+
+double BenchmarkReport::Metric::getPercentile(double fraction) const
+{
+	if (samples.empty()) {
+		return 0.0;
+	}
+
+	auto sorted = samples;
+	std::sort(sorted.begin(), sorted.end());
+	const double pos = std::max(0.0, std::min(1.0, fraction)) * double(sorted.size() - 1);
+	const auto i = size_t(pos);
+	const double t = pos - double(i);
+	return i + 1 < sorted.size() ? sorted[i] * (1.0 - t) + sorted[i + 1] * t : sorted[i];
+}
+
+BenchmarkReport::BenchmarkReport(String benchmark, String commit)
+	: benchmark(std::move(benchmark))
+	, commit(std::move(commit))
+	, date(getCurrentDate())
+{
+	const auto computer = OS::get().getComputerData();
+	machine["computer"] = computer.computerName;
+	machine["cpu"] = computer.cpuName;
+	machine["threads"] = toString(std::thread::hardware_concurrency());
+	machine["ram"] = toString(computer.RAM);
+	machine["gpu"] = computer.gpuName;
+	machine["os"] = computer.osName;
+	machine["compiler"] = getCompiler();
+	machine["arch"] = toString(sizeof(void*) * 8) + "-bit";
+#ifdef NDEBUG
+	machine["build"] = "release";
+#else
+	machine["build"] = "debug";
+#endif
+}
+
+BenchmarkReport::Metric& BenchmarkReport::addMetric(const String& name, const String& unit, Better better, bool exact)
+{
+	Expects(!tryGetMetric(name));
+	metrics.emplace_back();
+	auto& metric = metrics.back();
+	metric.name = name;
+	metric.unit = unit;
+	metric.better = better;
+	metric.exact = exact;
+	return metric;
+}
+
+void BenchmarkReport::add(const String& name, const String& unit, double sample, Better better)
+{
+	for (auto& m: metrics) {
+		if (m.name == name) {
+			m.add(sample);
+			return;
+		}
+	}
+	addMetric(name, unit, better).add(sample);
+}
+
+const BenchmarkReport::Metric* BenchmarkReport::tryGetMetric(const String& name) const
+{
+	for (auto& m: metrics) {
+		if (m.name == name) {
+			return &m;
+		}
+	}
+	return nullptr;
+}
+
+String BenchmarkReport::toJSON() const
+{
+	// Written out by hand, so each metric fits on a line however many samples it has
+	std::string result;
+	result += "{\n\t\"format\": " + toString(formatVersion).cppStr() + ",\n\t\"benchmark\": ";
+	appendQuoted(result, benchmark);
+	result += ",\n\t\"commit\": ";
+	appendQuoted(result, commit);
+	result += ",\n\t\"date\": ";
+	appendQuoted(result, date);
+
+	result += ",\n\t\"machine\": {";
+	bool first = true;
+	for (auto& m: machine) {
+		result += first ? "\n\t\t" : ",\n\t\t";
+		first = false;
+		appendQuoted(result, m.first);
+		result += ": ";
+		appendQuoted(result, m.second);
+	}
+	result += "\n\t},\n\t\"metrics\": [";
+
+	first = true;
+	for (auto& m: metrics) {
+		result += first ? "\n\t\t{ \"name\": " : ",\n\t\t{ \"name\": ";
+		first = false;
+		appendQuoted(result, m.name);
+		result += ", \"unit\": ";
+		appendQuoted(result, m.unit);
+		result += m.better == Better::Lower ? ", \"better\": \"lower\"" : ", \"better\": \"higher\"";
+		result += m.exact ? ", \"exact\": true" : ", \"exact\": false";
+
+		result += ", \"count\": " + toString(m.samples.size()).cppStr();
+		const std::pair<const char*, double> stats[] = {
+			{ "min", m.getMin() },
+			{ "max", m.getMax() },
+			{ "mean", m.getMean() },
+			{ "median", m.getMedian() },
+			{ "stddev", m.getStandardDeviation() },
+			{ "p90", m.getPercentile(0.9) }
+		};
+		for (auto& s: stats) {
+			result += ", \"";
+			result += s.first;
+			result += "\": ";
+			appendNumber(result, s.second);
+		}
+
+		result += ", \"samples\": [";
+		for (size_t i = 0; i < m.samples.size(); ++i) {
+			if (i > 0) {
+				result += ", ";
+			}
+			appendNumber(result, m.samples[i]);
+		}
+		result += "] }";
+	}
+	result += "\n\t]\n}\n";
+	return result;
+}
+
+BenchmarkReport BenchmarkReport::fromJSON(const String& json)
+{
+	Json::Reader reader;
+	Json::Value root;
+	if (!reader.parse(json.cppStr(), root, false) || !root.isObject()) {
+		throw Exception("Unable to parse benchmark report: " + String(reader.getFormattedErrorMessages()), HalleyExceptions::Utils);
+	}
+	if (root["format"].asInt() != formatVersion) {
+		throw Exception("Unsupported benchmark report format: " + toString(root["format"].asInt()), HalleyExceptions::Utils);
+	}
+
+	BenchmarkReport report;
+	report.benchmark = root["benchmark"].asString();
+	report.commit = root["commit"].asString();
+	report.date = root["date"].asString();
+
+	const auto& machineNode = root["machine"];
+	for (auto& key: machineNode.getMemberNames()) {
+		report.machine[key] = machineNode[key].asString();
+	}
+
+	for (auto& node: root["metrics"]) {
+		auto& metric = report.addMetric(node["name"].asString(), node["unit"].asString(), node["better"].asString() == "higher" ? Better::Higher : Better::Lower, node["exact"].asBool());
+		for (auto& sample: node["samples"]) {
+			metric.add(sample.asDouble());
+		}
+	}
+	return report;
+}
+
+void BenchmarkReport::save(const Path& path) const
+{
+	const auto json = toJSON();
+	const auto data = reinterpret_cast<const Byte*>(json.c_str());
+	Path::writeFile(path, Bytes(data, data + json.size()));
+}
+
+BenchmarkReport BenchmarkReport::load(const Path& path)
+{
+	const auto data = Path::readFile(path);
+	if (data.empty()) {
+		throw Exception("Unable to read benchmark report from " + path.string(), HalleyExceptions::File);
+	}
+	return fromJSON(String(reinterpret_cast<const char*>(data.data()), data.size()));
+}
+
+bool BenchmarkOutput::parseArgument(const String& arg, const String& prefix)
+{
+	if (auto value = getArgument(arg, prefix + "label")) {
+		label = value.get();
+	} else if (auto value = getArgument(arg, prefix + "out")) {
+		csvPath = value.get();
+	} else if (auto value = getArgument(arg, prefix + "json")) {
+		jsonPath = value.get();
+	} else {
+		return false;
+	}
+	return true;
+}
+
+void BenchmarkOutput::writeJSON(const BenchmarkReport& report) const
+{
+	if (!jsonPath.isEmpty()) {
+		report.save(jsonPath);
+		std::cout << "Results for \"" << label << "\" written to " << jsonPath << std::endl;
+	}
+}
+
+void BenchmarkOutput::appendCSV(const std::function<void(std::ostream&)>& writeRows) const
+{
+	if (csvPath.isEmpty()) {
+		return;
+	}
+
+	std::ofstream out(csvPath.cppStr(), std::ios::app);
+	if (!out) {
+		throw Exception("Unable to write benchmark results to " + csvPath, HalleyExceptions::File);
+	}
+	writeRows(out);
+	std::cout << "Results for \"" << label << "\" appended to " << csvPath << std::endl;
+}
+
+Maybe<String> BenchmarkOutput::getArgument(const String& arg, const String& name)
+{
+	const String start = "--" + name + "=";
+	if (arg.startsWith(start)) {
+		return arg.mid(start.length());
+	}
+	return {};
+}
@@ -3,9 +3,118 @@
 #include <gsl/gsl_assert>
 #include <iostream>
 #include "halley/support/console.h"
+#include "halley/text/string_converter.h"
+#include <algorithm>
+#include <chrono>
+#include <limits>
 
 using namespace Halley;
 
+namespace Halley {
+	// Single producer (the thread it belongs to), single consumer (whoever is draining, under Logger::drainMutex)
+	class LoggerThreadBuffer
+	{
+	public:
+		struct Record
+		{
+			uint64_t sequence;
+			LoggerLevel level;
+			String msg;
+		};
+
+		explicit LoggerThreadBuffer(size_t capacity)
+			: records(capacity)
+			, head(0)
+			, tail(0)
+			, dropped(0)
+		{}
+
+		bool push(uint64_t sequence, LoggerLevel level, const String& msg)
+		{
+			const auto t = tail.load(std::memory_order_relaxed);
+			if (t - head.load(std::memory_order_acquire) >= records.size()) {
+				dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			auto& record = records[t % records.size()];
+			record.sequence = sequence;
+			record.level = level;
+			record.msg = msg;
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+
+		void popAll(std::vector<Record>& dst)
+		{
+			auto h = head.load(std::memory_order_relaxed);
+			const auto t = tail.load(std::memory_order_acquire);
+			for (; h != t; ++h) {
+				dst.push_back(std::move(records[h % records.size()]));
+			}
+			head.store(h, std::memory_order_release);
+		}
+
+		bool isFilling() const
+		{
+			return (tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed)) * 2 >= records.size();
+		}
+
+		bool isEmpty() const
+		{
+			return tail.load(std::memory_order_acquire) == head.load(std::memory_order_relaxed);
+		}
+
+		size_t takeDropped()
+		{
+			return dropped.exchange(0, std::memory_order_relaxed);
+		}
+
+	private:
+		std::vector<Record> records;
+		std::atomic<size_t> head;
+		std::atomic<size_t> tail;
+		std::atomic<size_t> dropped;
+	};
+}
+
+namespace {
+	constexpr size_t threadBufferCapacity = 1024;
+
+	struct CurrentThreadBuffer
+	{
+		Logger* owner = nullptr;
+		std::shared_ptr<LoggerThreadBuffer> buffer;
+	};
+	thread_local CurrentThreadBuffer currentThreadBuffer;
+}
+
+LogRateLimit::LogRateLimit(int maxPerSecond)
+	: maxPerSecond(maxPerSecond)
+	, windowStart(std::numeric_limits<int64_t>::min() / 2)
+	, count(0)
+	, suppressed(0)
+{
+}
+
+bool LogRateLimit::shouldLog()
+{
+	const int64_t now = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	auto start = windowStart.load(std::memory_order_relaxed);
+	if (now - start >= 1000 && windowStart.compare_exchange_strong(start, now, std::memory_order_relaxed)) {
+		const int n = count.exchange(0, std::memory_order_relaxed);
+		if (n > maxPerSecond) {
+			suppressed.fetch_add(size_t(n - maxPerSecond), std::memory_order_relaxed);
+		}
+	}
+	return count.fetch_add(1, std::memory_order_relaxed) < maxPerSecond;
+}
+
+size_t LogRateLimit::takeSuppressed()
+{
+	return suppressed.exchange(0, std::memory_order_relaxed);
+}
+
 StdOutSink::StdOutSink(bool devMode)
 	: devMode(devMode)
 {
@@ -33,6 +142,18 @@ void StdOutSink::log(LoggerLevel level, const String& msg)
 	std::cout << msg << ConsoleColour() << std::endl;
 }
 
+Logger::Logger()
+	: async(false)
+	, wakeRequested(false)
+	, nextSequence(0)
+{
+}
+
+Logger::~Logger()
+{
+	stopThread();
+}
+
 void Logger::setInstance(Logger& logger)
 {
 	instance = &logger;
@@ -41,26 +162,69 @@ void Logger::setInstance(Logger& logger)
 void Logger::addSink(ILoggerSink& sink)
 {
 	Expects(instance);
+	std::unique_lock<std::recursive_mutex> lock(instance->sinksMutex);
 	instance->sinks.insert(&sink);
 }
 
 void Logger::removeSink(ILoggerSink& sink)
 {
 	Expects(instance);
+	std::unique_lock<std::recursive_mutex> lock(instance->sinksMutex);
 	instance->sinks.erase(&sink);
 }
 
+void Logger::setAsync(bool async)
+{
+	Expects(instance);
+	auto& logger = *instance;
+	if (async == logger.running) {
+		return;
+	}
+
+	if (async) {
+		logger.running = true;
+		logger.async = true;
+		logger.thread = std::thread([&logger] () { logger.run(); });
+	} else {
+		logger.stopThread();
+		logger.drain();
+	}
+}
+
+bool Logger::isAsync()
+{
+	return instance && instance->async;
+}
+
+void Logger::flush()
+{
+	if (instance) {
+		instance->drain();
+	}
+}
+
 void Logger::log(LoggerLevel level, const String& msg)
 {
 	if (instance) {
-		for (auto& s: instance->sinks) {
-			s->log(level, msg);
+		if (instance->async) {
+			instance->enqueue(level, msg);
+		} else {
+			instance->deliver(level, msg);
 		}
 	} else {
 		std::cout << msg << std::endl;
 	}
 }
 
+void Logger::log(LoggerLevel level, const String& msg, size_t suppressed)
+{
+	if (suppressed > 0) {
+		log(level, msg + " (" + toString(suppressed) + " similar messages suppressed)");
+	} else {
+		log(level, msg);
+	}
+}
+
 void Logger::logDev(const String& msg)
 {
 	log(LoggerLevel::Dev, msg);
@@ -86,4 +250,90 @@ void Logger::logException(const std::exception& e)
 	logError(e.what());
 }
 
+void Logger::deliver(LoggerLevel level, const String& msg)
+{
+	std::unique_lock<std::recursive_mutex> lock(sinksMutex);
+	for (auto& s: sinks) {
+		s->log(level, msg);
+	}
+}
+
+void Logger::enqueue(LoggerLevel level, const String& msg)
+{
+	auto& buffer = getThreadBuffer();
+	buffer.push(nextSequence.fetch_add(1, std::memory_order_relaxed), level, msg);
+
+	// Errors are often the last thing before a crash, so don't sit on them
+	if (level == LoggerLevel::Error || buffer.isFilling()) {
+		wakeRequested = true;
+		wake.notify_one();
+	}
+}
+
+LoggerThreadBuffer& Logger::getThreadBuffer()
+{
+	auto& current = currentThreadBuffer;
+	if (current.owner != this || !current.buffer) {
+		current.owner = this;
+		current.buffer = std::make_shared<LoggerThreadBuffer>(threadBufferCapacity);
+		std::unique_lock<std::mutex> lock(buffersMutex);
+		buffers.push_back(current.buffer);
+	}
+	return *current.buffer;
+}
+
+void Logger::drain()
+{
+	std::unique_lock<std::mutex> drainLock(drainMutex);
+
+	std::vector<LoggerThreadBuffer::Record> records;
+	size_t dropped = 0;
+	{
+		std::unique_lock<std::mutex> lock(buffersMutex);
+		for (auto& buffer: buffers) {
+			buffer->popAll(records);
+			dropped += buffer->takeDropped();
+		}
+
+		// Threads that are gone only have the reference here left
+		buffers.erase(std::remove_if(buffers.begin(), buffers.end(), [] (const std::shared_ptr<LoggerThreadBuffer>& b) { return b.use_count() == 1 && b->isEmpty(); }), buffers.end());
+	}
+
+	// Each thread's buffer is in order, but they have to be interleaved back
+	std::sort(records.begin(), records.end(), [] (const LoggerThreadBuffer::Record& a, const LoggerThreadBuffer::Record& b) { return a.sequence < b.sequence; });
+	for (auto& r: records) {
+		deliver(r.level, r.msg);
+	}
+
+	if (dropped > 0) {
+		deliver(LoggerLevel::Warning, "Dropped " + toString(dropped) + " log messages, as they came in faster than they could be written.");
+	}
+}
+
+void Logger::stopThread()
+{
+	if (running) {
+		async = false;
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			running = false;
+		}
+		wake.notify_all();
+		thread.join();
+	}
+}
+
+void Logger::run()
+{
+	std::unique_lock<std::mutex> lock(wakeMutex);
+	while (running) {
+		wake.wait_for(lock, std::chrono::milliseconds(10), [&] () { return !running || wakeRequested; });
+		wakeRequested = false;
+
+		lock.unlock();
+		drain();
+		lock.lock();
+	}
+}
+
 Logger* Logger::instance = nullptr;
@@ -0,0 +1,128 @@
+#include "halley/support/memory_tracker.h"
+#include "halley/support/exception.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+
+using namespace Halley;
+
+namespace {
+	struct TagCounters
+	{
+		std::atomic<int64_t> bytes;
+		std::atomic<int64_t> peakBytes;
+		std::atomic<uint64_t> allocations;
+	};
+
+	// Zero-initialised before any dynamic initialisation, so allocations made by other statics can be counted
+	std::array<TagCounters, MemoryTracker::maxTags> counters;
+	std::atomic<size_t> numTags(MemoryTags::NumBuiltIn);
+
+	std::mutex& getNamesMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	std::vector<String>& getNames()
+	{
+		static std::vector<String> names = { "untagged", "pools", "audio", "gpuTextures", "gpuBuffers" };
+		return names;
+	}
+}
+
+MemoryTag MemoryTracker::registerTag(const String& name)
+{
+	std::unique_lock<std::mutex> lock(getNamesMutex());
+	auto& names = getNames();
+	for (size_t i = 0; i < names.size(); ++i) {
+		if (names[i] == name) {
+			return MemoryTag(i);
+		}
+	}
+	if (names.size() >= maxTags) {
+		throw Exception("Too many memory tags, can't register \"" + name + "\".", HalleyExceptions::Utils);
+	}
+	names.push_back(name);
+	numTags.store(names.size(), std::memory_order_release);
+	return MemoryTag(names.size() - 1);
+}
+
+String MemoryTracker::getTagName(MemoryTag tag)
+{
+	std::unique_lock<std::mutex> lock(getNamesMutex());
+	auto& names = getNames();
+	return tag < names.size() ? names[tag] : String("unknown");
+}
+
+void MemoryTracker::onAlloc(MemoryTag tag, size_t bytes)
+{
+	auto& c = counters[tag < maxTags ? tag : MemoryTags::Untagged];
+	const int64_t total = c.bytes.fetch_add(int64_t(bytes), std::memory_order_relaxed) + int64_t(bytes);
+	c.allocations.fetch_add(1, std::memory_order_relaxed);
+
+	int64_t peak = c.peakBytes.load(std::memory_order_relaxed);
+	while (total > peak && !c.peakBytes.compare_exchange_weak(peak, total, std::memory_order_relaxed)) {}
+}
+
+void MemoryTracker::onFree(MemoryTag tag, size_t bytes)
+{
+	counters[tag < maxTags ? tag : MemoryTags::Untagged].bytes.fetch_sub(int64_t(bytes), std::memory_order_relaxed);
+}
+
+MemoryTag& MemoryTracker::currentTag()
+{
+	thread_local MemoryTag tag = MemoryTags::Untagged;
+	return tag;
+}
+
+MemoryTag MemoryTracker::getCurrentTag()
+{
+	return currentTag();
+}
+
+MemoryTagStats MemoryTracker::getStats(MemoryTag tag)
+{
+	MemoryTagStats result;
+	if (tag < maxTags) {
+		auto& c = counters[tag];
+		result.name = getTagName(tag);
+		result.bytes = c.bytes.load(std::memory_order_relaxed);
+		result.peakBytes = c.peakBytes.load(std::memory_order_relaxed);
+		result.allocations = c.allocations.load(std::memory_order_relaxed);
+	}
+	return result;
+}
+
+std::vector<MemoryTagStats> MemoryTracker::getAllStats()
+{
+	std::vector<MemoryTagStats> result;
+	const size_t n = numTags.load(std::memory_order_acquire);
+	for (size_t i = 0; i < n; ++i) {
+		if (counters[i].allocations.load(std::memory_order_relaxed) > 0) {
+			result.push_back(getStats(MemoryTag(i)));
+		}
+	}
+	return result;
+}
+
+int64_t MemoryTracker::getTotalBytes()
+{
+	int64_t total = 0;
+	const size_t n = numTags.load(std::memory_order_acquire);
+	for (size_t i = 0; i < n; ++i) {
+		total += counters[i].bytes.load(std::memory_order_relaxed);
+	}
+	return total;
+}
+
+MemoryTagScope::MemoryTagScope(MemoryTag tag)
+	: prevTag(MemoryTracker::currentTag())
+{
+	MemoryTracker::currentTag() = tag;
+}
+
+MemoryTagScope::~MemoryTagScope()
+{
+	MemoryTracker::currentTag() = prevTag;
+}
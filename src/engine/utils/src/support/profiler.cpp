@@ -0,0 +1,336 @@
+#include "halley/support/profiler.h"
+#include "halley/bytes/byte_serializer.h"
+#include "halley/text/string_converter.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+
+using namespace Halley;
+
+std::atomic<bool> Profiler::enabled(false);
+constexpr size_t Profiler::maxDetailLength;
+
+namespace {
+	// Each thread only ever writes to its own buffer, so pushing is just a few relaxed stores plus one release.
+	// Readers copy a range and then check that the writer hasn't lapped them while they were at it.
+	class ThreadBuffer
+	{
+	public:
+		constexpr static size_t capacity = 8192;
+		constexpr static size_t detailWords = (Profiler::maxDetailLength + 1) / sizeof(uint64_t);
+		static_assert((Profiler::maxDetailLength + 1) % sizeof(uint64_t) == 0, "Details must fill whole words");
+
+		struct Slot
+		{
+			std::atomic<const char*> name;
+			std::array<std::atomic<uint64_t>, detailWords> detail; // Null-terminated, packed into words so it can be written like the rest
+			std::atomic<int64_t> startNs;
+			std::atomic<int64_t> endNs;
+			std::atomic<int> depth;
+		};
+
+		explicit ThreadBuffer(int idx)
+			: idx(idx)
+			, writePos(0)
+		{}
+
+		void push(const char* name, const char* detail, int64_t startNs, int64_t endNs, int depth)
+		{
+			const uint64_t pos = writePos.load(std::memory_order_relaxed);
+			auto& slot = slots[pos % capacity];
+			slot.name.store(name, std::memory_order_relaxed);
+
+			// Only up to the word with the terminator, which is as far as readers go
+			size_t length = 0;
+			while (detail && length < Profiler::maxDetailLength && detail[length] != 0) {
+				++length;
+			}
+			for (size_t i = 0; i <= length / sizeof(uint64_t); ++i) {
+				uint64_t word = 0;
+				const size_t offset = i * sizeof(uint64_t);
+				if (offset < length) {
+					memcpy(&word, detail + offset, std::min(sizeof(uint64_t), length - offset));
+				}
+				slot.detail[i].store(word, std::memory_order_relaxed);
+			}
+
+			slot.startNs.store(startNs, std::memory_order_relaxed);
+			slot.endNs.store(endNs, std::memory_order_relaxed);
+			slot.depth.store(depth, std::memory_order_relaxed);
+			writePos.store(pos + 1, std::memory_order_release);
+		}
+
+		uint64_t read(uint64_t from, std::vector<ProfilerCapture::Event>& dst) const
+		{
+			const uint64_t end = writePos.load(std::memory_order_acquire);
+			from = std::max(from, end > capacity ? end - capacity : 0);
+
+			const size_t first = dst.size();
+			for (uint64_t pos = from; pos < end; ++pos) {
+				auto& slot = slots[pos % capacity];
+				ProfilerCapture::Event event;
+				event.name = slot.name.load(std::memory_order_relaxed);
+				char detail[Profiler::maxDetailLength + 1];
+				for (size_t i = 0; i < detailWords; ++i) {
+					const uint64_t word = slot.detail[i].load(std::memory_order_relaxed);
+					memcpy(detail + i * sizeof(uint64_t), &word, sizeof(uint64_t));
+					if (memchr(&word, 0, sizeof(uint64_t))) {
+						break;
+					}
+				}
+				detail[Profiler::maxDetailLength] = 0; // In case it was being overwritten, which gets it dropped below anyway
+				if (detail[0] != 0) {
+					event.detail = detail;
+				}
+				event.thread = idx;
+				event.depth = slot.depth.load(std::memory_order_relaxed);
+				event.startNs = slot.startNs.load(std::memory_order_relaxed);
+				event.endNs = slot.endNs.load(std::memory_order_relaxed);
+				dst.push_back(std::move(event));
+			}
+
+			// Anything the writer might have overwritten in the meantime is unreliable, so drop it
+			std::atomic_thread_fence(std::memory_order_acquire);
+			const uint64_t endAfter = writePos.load(std::memory_order_relaxed);
+			if (endAfter > capacity && endAfter - capacity > from) {
+				const size_t nBad = size_t(std::min(endAfter - capacity, end) - from);
+				dst.erase(dst.begin() + first, dst.begin() + first + nBad);
+			}
+			return end;
+		}
+
+		const int idx;
+		String name;
+
+	private:
+		std::atomic<uint64_t> writePos;
+		std::array<Slot, capacity> slots;
+	};
+
+	struct ProfilerState
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadBuffer>> threads;
+		std::vector<ThreadBuffer*> freeThreads; // Left behind by threads that ended, still captured until they're reused
+		std::set<String> interned;
+		std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+	};
+
+	ProfilerState& getState()
+	{
+		static ProfilerState state;
+		return state;
+	}
+
+	// Buffers are only taken by threads that record something, and given back when they end,
+	// so threads that come and go (or never record) don't each keep one around
+	struct CurrentThread
+	{
+		ThreadBuffer* buffer = nullptr;
+		String name;
+
+		~CurrentThread()
+		{
+			if (buffer) {
+				auto& state = getState();
+				std::unique_lock<std::mutex> lock(state.mutex);
+				state.freeThreads.push_back(buffer);
+			}
+		}
+	};
+
+	thread_local CurrentThread currentThread;
+	thread_local int currentDepth = 0;
+
+	ThreadBuffer& getThreadBuffer()
+	{
+		if (!currentThread.buffer) {
+			auto& state = getState();
+			std::unique_lock<std::mutex> lock(state.mutex);
+			if (state.freeThreads.empty()) {
+				state.threads.push_back(std::make_unique<ThreadBuffer>(int(state.threads.size())));
+				currentThread.buffer = state.threads.back().get();
+			} else {
+				currentThread.buffer = state.freeThreads.back();
+				state.freeThreads.pop_back();
+			}
+			auto& buffer = *currentThread.buffer;
+			buffer.name = currentThread.name.isEmpty() ? "Thread " + toString(buffer.idx) : currentThread.name;
+		}
+		return *currentThread.buffer;
+	}
+
+	void appendEscaped(std::string& dst, const String& str)
+	{
+		for (char c: str.cppStr()) {
+			switch (c) {
+			case '"': dst += "\\\""; break;
+			case '\\': dst += "\\\\"; break;
+			case '\n': dst += "\\n"; break;
+			case '\t': dst += "\\t"; break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char buffer[8];
+					snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+					dst += buffer;
+				} else {
+					dst += c;
+				}
+			}
+		}
+	}
+}
+
+void Profiler::setEnabled(bool e)
+{
+	enabled.store(e, std::memory_order_relaxed);
+}
+
+void Profiler::setThreadName(const String& name)
+{
+	currentThread.name = name;
+	if (currentThread.buffer) {
+		std::unique_lock<std::mutex> lock(getState().mutex);
+		currentThread.buffer->name = name;
+	}
+}
+
+const char* Profiler::intern(const String& str)
+{
+	auto& state = getState();
+	std::unique_lock<std::mutex> lock(state.mutex);
+	return state.interned.insert(str).first->c_str();
+}
+
+int64_t Profiler::getTime()
+{
+	using namespace std::chrono;
+	return duration_cast<nanoseconds>(steady_clock::now() - getState().epoch).count();
+}
+
+void Profiler::record(const char* name, const char* detail, int64_t startNs, int64_t endNs, int depth)
+{
+	getThreadBuffer().push(name, detail, startNs, endNs, depth);
+}
+
+ProfilerCapture Profiler::capture()
+{
+	ProfilerCursor cursor;
+	return capture(cursor);
+}
+
+ProfilerCapture Profiler::capture(ProfilerCursor& cursor)
+{
+	auto& state = getState();
+	std::unique_lock<std::mutex> lock(state.mutex);
+
+	ProfilerCapture result;
+	cursor.positions.resize(state.threads.size(), 0);
+	for (size_t i = 0; i < state.threads.size(); ++i) {
+		auto& thread = *state.threads[i];
+		result.threadNames.push_back(thread.name);
+		cursor.positions[i] = thread.read(cursor.positions[i], result.events);
+	}
+	return result;
+}
+
+void ProfilerScope::begin(const char* d, size_t length)
+{
+	length = std::min(length, Profiler::maxDetailLength);
+	if (length > 0) {
+		memcpy(detail, d, length);
+	}
+	detail[length] = 0;
+	depth = currentDepth++;
+	startNs = Profiler::getTime();
+}
+
+void ProfilerScope::end()
+{
+	--currentDepth;
+	Profiler::record(name, detail, startNs, Profiler::getTime(), depth);
+}
+
+void ProfilerCapture::append(const ProfilerCapture& other)
+{
+	events.insert(events.end(), other.events.begin(), other.events.end());
+	if (other.threadNames.size() > threadNames.size()) {
+		threadNames.resize(other.threadNames.size());
+	}
+	for (size_t i = 0; i < other.threadNames.size(); ++i) {
+		threadNames[i] = other.threadNames[i];
+	}
+}
+
+String ProfilerCapture::toChromeTrace() const
+{
+	std::string result;
+	result.reserve(64 + events.size() * 96);
+	result += "{\"traceEvents\":[";
+
+	bool first = true;
+	char buffer[128];
+	for (size_t i = 0; i < threadNames.size(); ++i) {
+		result += first ? "\n" : ",\n";
+		first = false;
+		snprintf(buffer, sizeof(buffer), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%d,\"args\":{\"name\":\"", int(i));
+		result += buffer;
+		appendEscaped(result, threadNames[i]);
+		result += "\"}}";
+	}
+
+	for (auto& e: events) {
+		result += first ? "\n" : ",\n";
+		first = false;
+		result += "{\"name\":\"";
+		appendEscaped(result, e.name);
+		snprintf(buffer, sizeof(buffer), "\",\"cat\":\"halley\",\"ph\":\"X\",\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f", e.thread, e.startNs / 1000.0, (e.endNs - e.startNs) / 1000.0);
+		result += buffer;
+		if (!e.detail.isEmpty()) {
+			result += ",\"args\":{\"detail\":\"";
+			appendEscaped(result, e.detail);
+			result += "\"}";
+		}
+		result += "}";
+	}
+
+	result += "\n]}\n";
+	return result;
+}
+
+void ProfilerCapture::serialize(Serializer& s) const
+{
+	s << events;
+	s << threadNames;
+}
+
+void ProfilerCapture::deserialize(Deserializer& s)
+{
+	s >> events;
+	s >> threadNames;
+}
+
+void ProfilerCapture::Event::serialize(Serializer& s) const
+{
+	s << name;
+	s << detail;
+	s << thread;
+	s << depth;
+	s << startNs;
+	s << endNs;
+}
+
+void ProfilerCapture::Event::deserialize(Deserializer& s)
+{
+	s >> name;
+	s >> detail;
+	s >> thread;
+	s >> depth;
+	s >> startNs;
+	s >> endNs;
+}
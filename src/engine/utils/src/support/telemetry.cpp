@@ -0,0 +1,60 @@
+#include "halley/support/telemetry.h"
+#include "halley/bytes/byte_serializer.h"
+#include <algorithm>
+#include <mutex>
+
+using namespace Halley;
+
+namespace {
+	std::mutex& getSourcesMutex()
+	{
+		static std::mutex mutex;
+		return mutex;
+	}
+
+	std::vector<ITelemetrySource*>& getSources()
+	{
+		static std::vector<ITelemetrySource*> sources;
+		return sources;
+	}
+}
+
+TelemetryValue::TelemetryValue(String name, double value)
+	: name(std::move(name))
+	, value(value)
+{}
+
+void TelemetryValue::serialize(Serializer& s) const
+{
+	s << name;
+	s << value;
+}
+
+void TelemetryValue::deserialize(Deserializer& s)
+{
+	s >> name;
+	s >> value;
+}
+
+void Telemetry::addSource(ITelemetrySource& source)
+{
+	std::unique_lock<std::mutex> lock(getSourcesMutex());
+	getSources().push_back(&source);
+}
+
+void Telemetry::removeSource(ITelemetrySource& source)
+{
+	std::unique_lock<std::mutex> lock(getSourcesMutex());
+	auto& sources = getSources();
+	sources.erase(std::remove(sources.begin(), sources.end(), &source), sources.end());
+}
+
+std::vector<TelemetryValue> Telemetry::capture()
+{
+	std::unique_lock<std::mutex> lock(getSourcesMutex());
+	std::vector<TelemetryValue> result;
+	for (auto& source: getSources()) {
+		source->getTelemetry(result);
+	}
+	return result;
+}
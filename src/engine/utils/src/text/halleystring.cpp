@@ -29,8 +29,10 @@
 #include <sstream>
 #include <iomanip>
 #include <cstring>
+#include <algorithm>
 #include <gsl/gsl_assert>
 #include "halley/text/string_converter.h"
+#include "halley/utils/hash.h"
 
 using namespace Halley;
 
@@ -59,6 +61,16 @@ String::String(const std::basic_string<Character>& _str)
 {
 }
 
+String::String(std::basic_string<Character>&& _str) noexcept
+: str(std::move(_str))
+{
+}
+
+String::String(StringView view)
+: str(view.data(), view.size())
+{
+}
+
 
 String::String(const wchar_t* utf16)
 {
@@ -219,9 +231,9 @@ size_t String::length() const
 }
 
 
-bool String::contains(const String& string) const
+bool String::contains(StringView string) const
 {
-	return str.find(string) != npos;
+	return find(string) != npos;
 }
 
 
@@ -244,26 +256,42 @@ String String::mid(size_t start,size_t count) const
 }
 
 
-bool String::startsWith(const String& string,bool caseSensitive) const
+namespace {
+	bool asciiEqualNoCase(const char* a, const char* b, size_t len)
+	{
+		for (size_t i = 0; i < len; ++i) {
+			char ca = a[i];
+			char cb = b[i];
+			if (ca >= 'A' && ca <= 'Z') {
+				ca += 'a' - 'A';
+			}
+			if (cb >= 'A' && cb <= 'Z') {
+				cb += 'a' - 'A';
+			}
+			if (ca != cb) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+bool String::startsWith(StringView string,bool caseSensitive) const
 {
 	if (caseSensitive) {
-		String tmp = String(str.substr(0, string.size()));
-		return str.compare(0, string.size(), string) == 0;
+		return StringView(*this).startsWith(string);
 	} else {
-		return asciiLower().startsWith(string.asciiLower(), true);
+		return size() >= string.size() && asciiEqualNoCase(str.data(), string.data(), string.size());
 	}
 }
 
 
-bool String::endsWith(const String& string,bool caseSensitive) const
+bool String::endsWith(StringView string,bool caseSensitive) const
 {
 	if (caseSensitive) {
-		size_t strSize = string.size();
-		size_t sz = size();
-		if (sz < strSize) return false;
-		return str.compare(sz - strSize, strSize, string) == 0;
+		return StringView(*this).endsWith(string);
 	} else {
-		return asciiLower().endsWith(string.asciiLower(), true);
+		return size() >= string.size() && asciiEqualNoCase(str.data() + size() - string.size(), string.data(), string.size());
 	}
 }
 
@@ -881,6 +909,7 @@ Halley::String Halley::String::prettySize(long long bytes)
 Vector<String> Halley::String::split(char delimiter) const
 {
 	Vector<String> result;
+	result.reserve(size_t(std::count(str.begin(), str.end(), delimiter)) + 1);
 	
 	size_t startPos = 0;
 	while (true) {
@@ -899,15 +928,14 @@ Vector<String> Halley::String::split(char delimiter) const
 	return result;
 }
 
-Vector<String> String::split(String delimiter) const
+Vector<String> String::split(StringView delimiter) const
 {
 	Vector<String> result;
 	
 	size_t size = delimiter.size();
 	size_t startPos = 0;
-	const char* cStr = delimiter.c_str();
 	while (true) {
-		size_t endPos = find(cStr, startPos);
+		size_t endPos = str.find(delimiter.data(), startPos, size);
 		if (endPos == npos) {
 			// No more delimiters
 			result.push_back(substr(startPos));
@@ -924,14 +952,20 @@ Vector<String> String::split(String delimiter) const
 
 String String::concatList(const Vector<String>& list, String separator)
 {
-	std::stringstream ss;
+	size_t total = 0;
+	for (auto& s: list) {
+		total += s.size() + separator.size();
+	}
+
+	std::string result;
+	result.reserve(total);
 	for (size_t i = 0; i < list.size(); i++) {
 		if (i != 0) {
-			ss << separator.cppStr();
+			result += separator.cppStr();
 		}
-		ss << list[i].cppStr();
+		result += list[i].cppStr();
 	}
-	return ss.str();
+	return result;
 }
 
 void String::appendCharacter(int unicode)
@@ -950,25 +984,39 @@ void String::appendCharacter(int unicode)
 	}
 }
 
-String String::replaceAll(const String& before, const String& after) const
+String String::replaceAll(StringView before, StringView after) const
 {
 	size_t pos = find(before);
-	if (pos == std::string::npos) {
+	if (pos == std::string::npos || before.isEmpty()) {
 		return *this;
-	} else {
-		size_t len = before.length();
-		return substr(0, pos) + after + substr(pos + len).replaceAll(before, after);
 	}
+
+	// Built in one go, instead of a new string for every match
+	std::string result;
+	result.reserve(str.size());
+	size_t last = 0;
+	while (pos != std::string::npos) {
+		result.append(str, last, pos - last);
+		result.append(after.data(), after.size());
+		last = pos + before.size();
+		pos = str.find(before.data(), last, before.size());
+	}
+	result.append(str, last, std::string::npos);
+	return result;
 }
 
-String String::replaceOne(const String& before, const String& after) const
+String String::replaceOne(StringView before, StringView after) const
 {
 	size_t pos = find(before);
 	if (pos == std::string::npos) {
 		return *this;
 	} else {
-		size_t len = before.length();
-		return substr(0, pos) + after + substr(pos + len);
+		std::string result;
+		result.reserve(str.size() - before.size() + after.size());
+		result.append(str, 0, pos);
+		result.append(after.data(), after.size());
+		result.append(str, pos + before.size(), std::string::npos);
+		return result;
 	}
 }
 
@@ -977,9 +1025,9 @@ void String::shrink()
 	str.reserve(length());
 }
 
-size_t String::find(String s) const
+size_t String::find(StringView s) const
 {
-	return str.find(s.c_str());
+	return str.find(s.data(), 0, s.size());
 }
 
 std::ostream& Halley::operator<< (std::ostream& os, const String& rhp)
@@ -1079,3 +1127,12 @@ char& String::operator[](size_t pos)
 	return str[pos];
 }
 
+size_t std::hash<Halley::String>::operator()(const Halley::String& s) const
+{
+	return size_t(Halley::Hash::hash(gsl::as_bytes(gsl::span<const char>(s.c_str(), s.size()))));
+}
+
+size_t std::hash<Halley::StringView>::operator()(Halley::StringView s) const
+{
+	return size_t(Halley::Hash::hash(gsl::as_bytes(gsl::span<const char>(s.data(), s.size()))));
+}
@@ -1,6 +1,7 @@
 #include <utility>
 #include "halley/text/i18n.h"
 #include "halley/file_formats/config_file.h"
+#include "halley/text/string_table.h"
 
 using namespace Halley;
 
@@ -10,29 +11,73 @@ I18N::I18N()
 
 void I18N::update()
 {
-	for (auto& o: observers) {
-		if (o.second.needsUpdate()) {
-			o.second.update();
-			loadLocalisation(o.second.getRoot());
+	if (localisationChanged) {
+		localisationChanged = false;
+		for (auto& o: observers) {
+			if (o.second.needsUpdate()) {
+				o.second.update();
+				loadLocalisation(o.second.getRoot());
+			}
+		}
+	}
+
+	bool tablesChanged = false;
+	for (auto& t: stringTables) {
+		if (t.observer.needsUpdate()) {
+			t.observer.update();
+			t.language = I18NLanguage(String(t.table->getLanguageCode()));
+			tablesChanged = true;
 		}
 	}
+	if (tablesChanged) {
+		updateLanguageTables();
+		++version;
+	}
 }
 
 void I18N::setCurrentLanguage(const I18NLanguage& code)
 {
 	currentLanguage = code;
+	updateLanguageTables();
 	++version;
 }
 
 void I18N::setFallbackLanguage(const I18NLanguage& code)
 {
 	fallbackLanguage = code;
+	updateLanguageTables();
 }
 
 void I18N::loadLocalisationFile(const ConfigFile& config)
 {
 	loadLocalisation(config.getRoot());
-	observers[config.getAssetId()] = ConfigObserver(config);
+	auto& observer = observers[config.getAssetId()];
+	observer = ConfigObserver(config);
+	observer.setListener([this] () { localisationChanged = true; });
+}
+
+void I18N::loadStringTable(std::shared_ptr<const StringTable> table)
+{
+	Expects(table);
+	auto language = I18NLanguage(String(table->getLanguageCode()));
+	const auto& res = *table;
+	stringTables.push_back(LoadedStringTable{ std::move(table), ResourceObserver(res), std::move(language) });
+	updateLanguageTables();
+	++version;
+}
+
+void I18N::updateLanguageTables()
+{
+	// Kept as plain lists for the current and fallback languages, so lookups don't go looking for their language's tables every time
+	currentTables.clear();
+	fallbackTables.clear();
+	for (auto i = stringTables.rbegin(); i != stringTables.rend(); ++i) {
+		if (i->language == currentLanguage) {
+			currentTables.push_back(i->table.get());
+		} else if (fallbackLanguage && i->language == fallbackLanguage.get()) {
+			fallbackTables.push_back(i->table.get());
+		}
+	}
 }
 
 void I18N::loadLocalisation(const ConfigNode& root)
@@ -53,30 +98,55 @@ std::vector<I18NLanguage> I18N::getLanguagesAvailable() const
 	for (auto& e: strings) {
 		result.push_back(e.first);
 	}
+	for (auto& t: stringTables) {
+		if (std::find(result.begin(), result.end(), t.language) == result.end()) {
+			result.push_back(t.language);
+		}
+	}
 	return result;
 }
 
 LocalisedString I18N::get(const String& key) const
 {
-	auto curLang = strings.find(currentLanguage);
-	if (curLang != strings.end()) {
-		auto i = curLang->second.find(key);
-		if (i != curLang->second.end()) {
-			return LocalisedString(*this, key, i->second);
-		}
+	return get(key, StringTable::hashKey(key));
+}
+
+LocalisedString I18N::get(const String& key, uint64_t keyHash) const
+{
+	String result;
+	if (find(currentLanguage, currentTables, key, keyHash, result)) {
+		return LocalisedString(*this, key, keyHash, std::move(result));
 	}
 
 	if (fallbackLanguage && fallbackLanguage.get() != currentLanguage) {
-		auto defLang = strings.find(fallbackLanguage.get());
-		if (defLang != strings.end()) {
-			auto i = defLang->second.find(key);
-			if (i != defLang->second.end()) {
-				return LocalisedString(*this, key, i->second);
-			}
+		if (find(fallbackLanguage.get(), fallbackTables, key, keyHash, result)) {
+			return LocalisedString(*this, key, keyHash, std::move(result));
 		}
 	}
 
-	return LocalisedString(*this, key, "#MISSING#");
+	return LocalisedString(*this, key, keyHash, "#MISSING#");
+}
+
+bool I18N::find(const I18NLanguage& language, const std::vector<const StringTable*>& tables, const String& key, uint64_t keyHash, String& result) const
+{
+	StringView value;
+	for (auto table: tables) {
+		if (table->find(keyHash, key, value)) {
+			result = String(value);
+			return true;
+		}
+	}
+
+	auto lang = strings.find(language);
+	if (lang != strings.end()) {
+		auto i = lang->second.find(key);
+		if (i != lang->second.end()) {
+			result = i->second;
+			return true;
+		}
+	}
+
+	return false;
 }
 
 LocalisedString I18N::getPreProcessedUserString(const String& string) const
@@ -122,9 +192,10 @@ LocalisedString::LocalisedString(String string)
 {
 }
 
-LocalisedString::LocalisedString(const I18N& i18n, String key, String string)
+LocalisedString::LocalisedString(const I18N& i18n, String key, uint64_t keyHash, String string)
 	: i18n(&i18n)
 	, key(std::move(key))
+	, keyHash(keyHash)
 	, string(std::move(string))
 	, i18nVersion(i18n.getVersion())
 {
@@ -275,7 +346,7 @@ bool LocalisedString::checkForUpdates()
 	if (i18n) {
 		const auto curVersion = i18n->getVersion();
 		if (i18nVersion != curVersion) {
-			const auto newValue = i18n->get(key);
+			const auto newValue = i18n->get(key, keyHash);
 			i18nVersion = curVersion;
 			if (string != newValue.string) {
 				string = newValue.string;
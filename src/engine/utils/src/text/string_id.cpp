@@ -0,0 +1,58 @@
+#include "halley/text/string_id.h"
+#include "halley/support/exception.h"
+#include <memory>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+
+using namespace Halley;
+
+namespace {
+	struct InternTable {
+		std::mutex mutex;
+		std::unordered_map<uint64_t, std::unique_ptr<String>> strings;
+	};
+
+	InternTable& getInternTable()
+	{
+		// Intentionally leaked, so ids in static objects can still be used while others are being destroyed
+		static InternTable* table = new InternTable();
+		return *table;
+	}
+}
+
+StringId::StringId(const String& str)
+{
+	intern(str.c_str(), str.size());
+}
+
+StringId::StringId(const char* str)
+{
+	intern(str, strlen(str));
+}
+
+StringId::StringId(StringView str)
+{
+	intern(str.data(), str.size());
+}
+
+const String& StringId::getString() const
+{
+	static const String empty;
+	return str ? *str : empty;
+}
+
+void StringId::intern(const char* s, size_t len)
+{
+	value = hash(s, len);
+
+	auto& table = getInternTable();
+	std::unique_lock<std::mutex> lock(table.mutex);
+	auto& entry = table.strings[value];
+	if (!entry) {
+		entry = std::make_unique<String>(s, len);
+	} else if (entry->size() != len || memcmp(entry->c_str(), s, len) != 0) {
+		throw Exception("StringId collision between \"" + *entry + "\" and \"" + String(s, len) + "\"", HalleyExceptions::Utils);
+	}
+	str = entry.get();
+}
@@ -0,0 +1,301 @@
+#include "halley/text/string_table.h"
+#include "halley/resources/resource_data.h"
+#include "halley/support/exception.h"
+#include "halley/utils/hash.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace Halley;
+
+namespace {
+	// Layout: Header, then a uint32_t seed per bucket, then an Entry per string, then the characters of the language code, keys and values
+	constexpr uint32_t magic = 0x42545348; // "HSTB"
+	constexpr uint32_t currentVersion = 1;
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t count;
+		uint32_t bucketCount;
+		uint32_t languageLength; // The language code is at the start of the characters
+		uint32_t charactersSize;
+	};
+
+	struct Entry
+	{
+		uint64_t keyHash;
+		uint32_t keyOffset;
+		uint32_t keyLength;
+		uint32_t valueOffset;
+		uint32_t valueLength;
+	};
+
+	// The data isn't necessarily aligned (e.g. inside an asset pack), so everything is read through memcpy, which compiles to plain loads
+	template <typename T>
+	T read(const gsl::byte* src)
+	{
+		T result;
+		memcpy(&result, src, sizeof(T));
+		return result;
+	}
+
+	uint32_t getBucket(uint64_t keyHash, uint32_t bucketCount)
+	{
+		return uint32_t((keyHash >> 32) % bucketCount);
+	}
+
+	uint32_t getSlot(uint64_t keyHash, uint32_t seed, uint32_t count)
+	{
+		uint64_t x = keyHash ^ (uint64_t(seed) * 0x9E3779B97F4A7C15ull);
+		x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+		x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+		x ^= x >> 31;
+		return uint32_t(x % count);
+	}
+
+	// Hash and displace: buckets are placed largest first, each trying seeds until all of its keys land on free slots.
+	// Returns false if some bucket can't be placed, in which case it's worth trying again with more buckets.
+	bool buildPerfectHash(const std::vector<uint64_t>& hashes, uint32_t bucketCount, std::vector<uint32_t>& seeds, std::vector<uint32_t>& slotToKey)
+	{
+		const auto count = uint32_t(hashes.size());
+
+		std::vector<std::vector<uint32_t>> buckets(bucketCount);
+		for (uint32_t i = 0; i < count; ++i) {
+			buckets[getBucket(hashes[i], bucketCount)].push_back(i);
+		}
+		std::vector<uint32_t> order(bucketCount);
+		for (uint32_t i = 0; i < bucketCount; ++i) {
+			order[i] = i;
+		}
+		std::stable_sort(order.begin(), order.end(), [&] (uint32_t a, uint32_t b) { return buckets[a].size() > buckets[b].size(); });
+
+		seeds.assign(bucketCount, 0);
+		slotToKey.assign(count, std::numeric_limits<uint32_t>::max());
+		std::vector<uint32_t> slots;
+		const uint32_t maxSeed = std::max(count, 256u) * 64;
+
+		for (auto bucketIdx: order) {
+			const auto& bucket = buckets[bucketIdx];
+			if (bucket.empty()) {
+				break;
+			}
+
+			bool placed = false;
+			for (uint32_t seed = 0; seed < maxSeed && !placed; ++seed) {
+				slots.clear();
+				placed = true;
+				for (auto key: bucket) {
+					const auto slot = getSlot(hashes[key], seed, count);
+					if (slotToKey[slot] != std::numeric_limits<uint32_t>::max() || std::find(slots.begin(), slots.end(), slot) != slots.end()) {
+						placed = false;
+						break;
+					}
+					slots.push_back(slot);
+				}
+				if (placed) {
+					seeds[bucketIdx] = seed;
+					for (size_t i = 0; i < bucket.size(); ++i) {
+						slotToKey[slots[i]] = bucket[i];
+					}
+				}
+			}
+			if (!placed) {
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+StringTable::StringTable()
+{
+	setData({}, "");
+}
+
+StringTable::StringTable(Bytes bytes)
+	: ownData(std::move(bytes))
+{
+	setData(gsl::as_bytes(gsl::span<const Byte>(ownData)), "");
+}
+
+Bytes StringTable::build(const String& languageCode, const std::map<String, String>& strings)
+{
+	std::vector<uint64_t> hashes;
+	hashes.reserve(strings.size());
+	std::vector<const std::pair<const String, String>*> values;
+	values.reserve(strings.size());
+	for (auto& s: strings) {
+		hashes.push_back(hashKey(s.first));
+		values.push_back(&s);
+	}
+
+	{
+		auto sorted = hashes;
+		std::sort(sorted.begin(), sorted.end());
+		auto dupe = std::adjacent_find(sorted.begin(), sorted.end());
+		if (dupe != sorted.end()) {
+			auto key = std::find(hashes.begin(), hashes.end(), *dupe) - hashes.begin();
+			throw Exception("String table for \"" + languageCode + "\" has keys with the same hash, including \"" + values[key]->first + "\"", HalleyExceptions::Resources);
+		}
+	}
+
+	const auto count = uint32_t(strings.size());
+	std::vector<uint32_t> seeds;
+	std::vector<uint32_t> slotToKey;
+	uint32_t bucketCount = count / 2 + 1;
+	if (count > 0) {
+		while (!buildPerfectHash(hashes, bucketCount, seeds, slotToKey)) {
+			bucketCount *= 2;
+		}
+	} else {
+		seeds.assign(bucketCount, 0);
+	}
+
+	String characters = languageCode;
+	std::vector<Entry> entries(count);
+	for (uint32_t slot = 0; slot < count; ++slot) {
+		const auto key = slotToKey[slot];
+		auto& e = entries[slot];
+		e.keyHash = hashes[key];
+		e.keyOffset = uint32_t(characters.size());
+		e.keyLength = uint32_t(values[key]->first.size());
+		characters += values[key]->first;
+		e.valueOffset = uint32_t(characters.size());
+		e.valueLength = uint32_t(values[key]->second.size());
+		characters += values[key]->second;
+	}
+
+	Header header;
+	header.magic = magic;
+	header.version = currentVersion;
+	header.count = count;
+	header.bucketCount = bucketCount;
+	header.languageLength = uint32_t(languageCode.size());
+	header.charactersSize = uint32_t(characters.size());
+
+	Bytes result(sizeof(Header) + seeds.size() * sizeof(uint32_t) + entries.size() * sizeof(Entry) + characters.size());
+	size_t pos = 0;
+	auto write = [&] (const void* src, size_t size)
+	{
+		if (size > 0) {
+			memcpy(result.data() + pos, src, size);
+			pos += size;
+		}
+	};
+	write(&header, sizeof(Header));
+	write(seeds.data(), seeds.size() * sizeof(uint32_t));
+	write(entries.data(), entries.size() * sizeof(Entry));
+	write(characters.c_str(), characters.size());
+	Ensures(pos == result.size());
+
+	return result;
+}
+
+uint64_t StringTable::hashKey(StringView key)
+{
+	return Hash::hashXXH64(gsl::as_bytes(gsl::span<const char>(key.data(), key.size())));
+}
+
+StringView StringTable::getLanguageCode() const
+{
+	return languageCode;
+}
+
+size_t StringTable::size() const
+{
+	return count;
+}
+
+bool StringTable::find(StringView key, StringView& value) const
+{
+	return find(hashKey(key), key, value);
+}
+
+bool StringTable::find(uint64_t keyHash, StringView key, StringView& value) const
+{
+	if (count == 0) {
+		return false;
+	}
+
+	const auto seed = read<uint32_t>(seeds + sizeof(uint32_t) * getBucket(keyHash, bucketCount));
+	const auto entry = read<Entry>(entries + sizeof(Entry) * getSlot(keyHash, seed, count));
+	if (entry.keyHash != keyHash || StringView(strings + entry.keyOffset, entry.keyLength) != key) {
+		return false;
+	}
+
+	value = StringView(strings + entry.valueOffset, entry.valueLength);
+	return true;
+}
+
+std::unique_ptr<StringTable> StringTable::loadResource(ResourceLoader& loader)
+{
+	auto table = std::make_unique<StringTable>();
+	table->dataOwner = loader.getStatic();
+	table->setData(table->dataOwner->getSpan(), loader.getName());
+	return table;
+}
+
+void StringTable::reload(Resource&& resource)
+{
+	*this = std::move(dynamic_cast<StringTable&>(resource));
+}
+
+size_t StringTable::getMemoryUsage() const
+{
+	return size_t(data.size_bytes());
+}
+
+void StringTable::setData(gsl::span<const gsl::byte> span, const String& name)
+{
+	data = span;
+	count = 0;
+	bucketCount = 0;
+	seeds = entries = nullptr;
+	strings = nullptr;
+	languageCode = StringView();
+
+	if (span.empty()) {
+		return;
+	}
+
+	auto fail = [&] (const String& reason)
+	{
+		throw Exception("String table \"" + name + "\" " + reason, HalleyExceptions::Resources);
+	};
+
+	const auto size = size_t(span.size_bytes());
+	if (size < sizeof(Header)) {
+		fail("is truncated.");
+	}
+	const auto header = read<Header>(span.data());
+	if (header.magic != magic) {
+		fail("is not a string table.");
+	}
+	if (header.version != currentVersion) {
+		fail("has unsupported version " + toString(header.version) + ".");
+	}
+
+	const size_t seedsPos = sizeof(Header);
+	const size_t entriesPos = seedsPos + size_t(header.bucketCount) * sizeof(uint32_t);
+	const size_t stringsPos = entriesPos + size_t(header.count) * sizeof(Entry);
+	if (header.bucketCount == 0 || stringsPos + header.charactersSize != size || header.languageLength > header.charactersSize) {
+		fail("is truncated.");
+	}
+
+	seeds = span.data() + seedsPos;
+	entries = span.data() + entriesPos;
+	strings = reinterpret_cast<const char*>(span.data() + stringsPos);
+
+	// Checked once here, so lookups don't have to
+	for (uint32_t i = 0; i < header.count; ++i) {
+		const auto entry = read<Entry>(entries + sizeof(Entry) * i);
+		if (size_t(entry.keyOffset) + entry.keyLength > header.charactersSize || size_t(entry.valueOffset) + entry.valueLength > header.charactersSize) {
+			fail("has an entry out of bounds.");
+		}
+	}
+
+	count = header.count;
+	bucketCount = header.bucketCount;
+	languageCode = StringView(strings, header.languageLength);
+}
@@ -5,6 +5,26 @@
 #include "halley/support/exception.h"
 #include "halley/support/logger.h"
 #include "halley/text/encode.h"
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386)
+#define HAS_AESNI
+#include <wmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define AESNI_FUNCTION
+#else
+#include <cpuid.h>
+// Only these functions are built for AES-NI, as the CPU is checked at runtime
+#define AESNI_FUNCTION __attribute__((target("aes,sse2")))
+#endif
+#endif
+
+#if (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES)) && (defined(__aarch64__) || defined(_M_ARM64))
+// Only when the build targets CPUs that have them, there's no portable way to check at runtime
+#define HAS_ARM_AES
+#include <arm_neon.h>
+#endif
 
 using namespace Halley;
 
@@ -65,3 +85,158 @@ Bytes Encrypt::decrypt(const Bytes& iv, const String& key, const Bytes& data)
 
 	return result;
 }
+
+namespace {
+	// Counter blocks are the IV plus the block index, as a 128-bit big endian number
+	void makeCounter(const std::array<uint8_t, 16>& iv, uint64_t block, uint8_t* dst)
+	{
+		uint64_t carry = block;
+		for (int i = 15; i >= 0; --i) {
+			const uint64_t sum = uint64_t(iv[i]) + (carry & 0xFF);
+			dst[i] = uint8_t(sum);
+			carry = (carry >> 8) + (sum >> 8);
+		}
+	}
+
+#ifdef HAS_AESNI
+	bool cpuHasAESNI()
+	{
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs, 1);
+		return (regs[2] & (1 << 25)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+			return false;
+		}
+		return (ecx & (1 << 25)) != 0;
+#endif
+	}
+
+	// Four blocks at a time, as each AES round has a few cycles of latency but can start every cycle
+	AESNI_FUNCTION void encryptBlocksAESNI(const uint8_t* roundKeys, const uint8_t* src, uint8_t* dst, size_t nBlocks)
+	{
+		__m128i keys[11];
+		for (int r = 0; r < 11; ++r) {
+			keys[r] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(roundKeys + r * 16));
+		}
+
+		size_t i = 0;
+		for (; i + 4 <= nBlocks; i += 4) {
+			__m128i b0 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16)), keys[0]);
+			__m128i b1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16 + 16)), keys[0]);
+			__m128i b2 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16 + 32)), keys[0]);
+			__m128i b3 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16 + 48)), keys[0]);
+			for (int r = 1; r < 10; ++r) {
+				b0 = _mm_aesenc_si128(b0, keys[r]);
+				b1 = _mm_aesenc_si128(b1, keys[r]);
+				b2 = _mm_aesenc_si128(b2, keys[r]);
+				b3 = _mm_aesenc_si128(b3, keys[r]);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16), _mm_aesenclast_si128(b0, keys[10]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16 + 16), _mm_aesenclast_si128(b1, keys[10]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16 + 32), _mm_aesenclast_si128(b2, keys[10]));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16 + 48), _mm_aesenclast_si128(b3, keys[10]));
+		}
+		for (; i < nBlocks; ++i) {
+			__m128i b = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 16)), keys[0]);
+			for (int r = 1; r < 10; ++r) {
+				b = _mm_aesenc_si128(b, keys[r]);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 16), _mm_aesenclast_si128(b, keys[10]));
+		}
+	}
+
+	const bool useAESNI = cpuHasAESNI();
+#endif
+
+#ifdef HAS_ARM_AES
+	void encryptBlocksARM(const uint8_t* roundKeys, const uint8_t* src, uint8_t* dst, size_t nBlocks)
+	{
+		uint8x16_t keys[11];
+		for (int r = 0; r < 11; ++r) {
+			keys[r] = vld1q_u8(roundKeys + r * 16);
+		}
+
+		for (size_t i = 0; i < nBlocks; ++i) {
+			uint8x16_t b = vld1q_u8(src + i * 16);
+			for (int r = 0; r < 9; ++r) {
+				b = vaesmcq_u8(vaeseq_u8(b, keys[r]));
+			}
+			b = veorq_u8(vaeseq_u8(b, keys[9]), keys[10]);
+			vst1q_u8(dst + i * 16, b);
+		}
+	}
+#endif
+}
+
+Encrypt::CounterMode::CounterMode(const Bytes& iv, const String& key)
+{
+	Expects(iv.size() == 16);
+	Expects(key.size() >= 16);
+
+	AES_ctx ctx;
+	std::memset(&ctx, 0, sizeof(ctx));
+	AES_init_ctx(&ctx, reinterpret_cast<const uint8_t*>(key.c_str()));
+	static_assert(sizeof(ctx.RoundKey) == sizeof(roundKeys), "Unexpected AES key schedule size");
+	memcpy(roundKeys.data(), ctx.RoundKey, roundKeys.size());
+	memcpy(this->iv.data(), iv.data(), this->iv.size());
+}
+
+void Encrypt::CounterMode::apply(gsl::span<gsl::byte> data, uint64_t offset) const
+{
+	constexpr size_t chunkBlocks = 64;
+	std::array<uint8_t, chunkBlocks * 16> keystream;
+
+	auto dst = reinterpret_cast<uint8_t*>(data.data());
+	const size_t n = size_t(data.size());
+	uint64_t block = offset / 16;
+	size_t skip = size_t(offset % 16);
+
+	for (size_t pos = 0; pos < n; ) {
+		const size_t bytes = std::min(n - pos, keystream.size() - skip);
+		const size_t blocks = (skip + bytes + 15) / 16;
+		generateKeystream(block, blocks, keystream.data());
+		for (size_t i = 0; i < bytes; ++i) {
+			dst[pos + i] ^= keystream[skip + i];
+		}
+		pos += bytes;
+		block += blocks;
+		skip = 0;
+	}
+}
+
+bool Encrypt::CounterMode::isHardwareAccelerated()
+{
+#if defined(HAS_AESNI)
+	return useAESNI;
+#elif defined(HAS_ARM_AES)
+	return true;
+#else
+	return false;
+#endif
+}
+
+void Encrypt::CounterMode::generateKeystream(uint64_t firstBlock, size_t nBlocks, uint8_t* dst) const
+{
+	for (size_t i = 0; i < nBlocks; ++i) {
+		makeCounter(iv, firstBlock + i, dst + i * 16);
+	}
+
+#if defined(HAS_AESNI)
+	if (useAESNI) {
+		encryptBlocksAESNI(roundKeys.data(), dst, dst, nBlocks);
+		return;
+	}
+#elif defined(HAS_ARM_AES)
+	encryptBlocksARM(roundKeys.data(), dst, dst, nBlocks);
+	return;
+#endif
+
+	AES_ctx ctx;
+	memcpy(ctx.RoundKey, roundKeys.data(), roundKeys.size());
+	for (size_t i = 0; i < nBlocks; ++i) {
+		AES_ECB_encrypt(&ctx, dst + i * 16);
+	}
+}
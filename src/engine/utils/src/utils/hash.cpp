@@ -1,15 +1,144 @@
 #include "halley/utils/hash.h"
 #include "../contrib/xxhash/xxhash.h"
 #include "halley/support/exception.h"
+#include <algorithm>
+#include <cstring>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
 
 using namespace Halley;
 
+// wyhash (final version 4, by Wang Yi, public domain). Three independent 64x64->128 multiply chains over 48-byte blocks,
+// which keeps the multiplier busy without needing any vector instructions.
+namespace {
+	constexpr uint64_t secret0 = 0x2d358dccaa6c78a5ull;
+	constexpr uint64_t secret1 = 0x8bb84b93962eacc9ull;
+	constexpr uint64_t secret2 = 0x4b33a62ed433d4a3ull;
+	constexpr uint64_t secret3 = 0x4d5a2da51de1aa47ull;
+
+	inline void mum(uint64_t& a, uint64_t& b)
+	{
+#if defined(__SIZEOF_INT128__)
+		__uint128_t r = a;
+		r *= b;
+		a = uint64_t(r);
+		b = uint64_t(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+		a = _umul128(a, b, &b);
+#else
+		const uint64_t ha = a >> 32;
+		const uint64_t hb = b >> 32;
+		const uint64_t la = uint32_t(a);
+		const uint64_t lb = uint32_t(b);
+		const uint64_t rh = ha * hb;
+		const uint64_t rm0 = ha * lb;
+		const uint64_t rm1 = hb * la;
+		const uint64_t rl = la * lb;
+		const uint64_t t = rl + (rm0 << 32);
+		uint64_t carry = t < rl ? 1 : 0;
+		const uint64_t lo = t + (rm1 << 32);
+		carry += lo < t ? 1 : 0;
+		a = lo;
+		b = rh + (rm0 >> 32) + (rm1 >> 32) + carry;
+#endif
+	}
+
+	inline uint64_t mix(uint64_t a, uint64_t b)
+	{
+		mum(a, b);
+		return a ^ b;
+	}
+
+	inline uint64_t read8(const uint8_t* p)
+	{
+		uint64_t v;
+		memcpy(&v, p, 8);
+		return v;
+	}
+
+	inline uint64_t read4(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, 4);
+		return v;
+	}
+
+	inline uint64_t read3(const uint8_t* p, size_t k)
+	{
+		return (uint64_t(p[0]) << 16) | (uint64_t(p[k >> 1]) << 8) | p[k - 1];
+	}
+
+	inline uint64_t initialSeed()
+	{
+		return mix(secret0, secret1);
+	}
+
+	inline void processBlock(const uint8_t* p, std::array<uint64_t, 3>& state)
+	{
+		state[0] = mix(read8(p) ^ secret1, read8(p + 8) ^ state[0]);
+		state[1] = mix(read8(p + 16) ^ secret2, read8(p + 24) ^ state[1]);
+		state[2] = mix(read8(p + 32) ^ secret3, read8(p + 40) ^ state[2]);
+	}
+
+	// p points at the last i bytes (at most 48) out of len; if len > 16, the 16 bytes before p must be readable
+	uint64_t finish(uint64_t seed, const uint8_t* p, size_t i, uint64_t len)
+	{
+		uint64_t a;
+		uint64_t b;
+		if (len <= 16) {
+			if (len >= 4) {
+				a = (read4(p) << 32) | read4(p + ((len >> 3) << 2));
+				b = (read4(p + len - 4) << 32) | read4(p + len - 4 - ((len >> 3) << 2));
+			} else if (len > 0) {
+				a = read3(p, size_t(len));
+				b = 0;
+			} else {
+				a = b = 0;
+			}
+		} else {
+			while (i > 16) {
+				seed = mix(read8(p) ^ secret1, read8(p + 8) ^ seed);
+				i -= 16;
+				p += 16;
+			}
+			a = read8(p + i - 16);
+			b = read8(p + i - 8);
+		}
+
+		a ^= secret1;
+		b ^= seed;
+		mum(a, b);
+		return mix(a ^ secret0 ^ len, b ^ secret1);
+	}
+}
+
 uint64_t Hash::hash(const Bytes& bytes)
 {
 	return hash(gsl::as_bytes(gsl::span<const Byte>(bytes)));
 }
 
 uint64_t Hash::hash(gsl::span<const gsl::byte> bytes)
+{
+	auto p = reinterpret_cast<const uint8_t*>(bytes.data());
+	const auto len = size_t(bytes.size_bytes());
+	size_t i = len;
+
+	uint64_t seed = initialSeed();
+	if (i > 48) {
+		std::array<uint64_t, 3> state = {{ seed, seed, seed }};
+		do {
+			processBlock(p, state);
+			p += 48;
+			i -= 48;
+		} while (i > 48);
+		seed = state[0] ^ state[1] ^ state[2];
+	}
+	return finish(seed, p, i, len);
+}
+
+uint64_t Hash::hashXXH64(gsl::span<const gsl::byte> bytes)
 {
 	return XXH64(bytes.data(), size_t(bytes.size_bytes()), 0);
 }
@@ -23,27 +152,68 @@ uint32_t Hash::compressTo32(uint64_t value)
 
 Hash::Hasher::Hasher()
 {
-	data = XXH64_createState();
-	XXH64_reset(data, 0);
-	ready = true;
+	reset();
 }
 
-Hash::Hasher::~Hasher()
-{
-	XXH64_freeState(data);
-}
+Hash::Hasher::~Hasher() = default;
 
 void Hash::Hasher::feedBytes(gsl::span<const gsl::byte> bytes)
 {
 	if (!ready) {
-		XXH64_reset(data, 0);
-		ready = true;
+		reset();
+	}
+
+	auto src = reinterpret_cast<const uint8_t*>(bytes.data());
+	auto size = size_t(bytes.size_bytes());
+	length += size;
+
+	// A block can only be processed once it's known not to be the last 48 bytes, as those are finished differently
+	while (size > 0) {
+		if (bufferLen == buffer.size()) {
+			processBlock(buffer.data(), state);
+			memcpy(lastBlockEnd.data(), buffer.data() + 32, 16);
+			hadBlocks = true;
+			bufferLen = 0;
+		}
+
+		if (bufferLen == 0) {
+			if (size > buffer.size()) {
+				do {
+					processBlock(src, state);
+					src += 48;
+					size -= 48;
+				} while (size > buffer.size());
+				memcpy(lastBlockEnd.data(), src - 16, 16);
+				hadBlocks = true;
+			}
+		}
+
+		const size_t n = std::min(buffer.size() - bufferLen, size);
+		memcpy(buffer.data() + bufferLen, src, n);
+		bufferLen += n;
+		src += n;
+		size -= n;
 	}
-	XXH64_update(data, bytes.data(), size_t(bytes.size_bytes()));
 }
 
 uint64_t Hash::Hasher::digest()
 {
 	ready = false;
-	return XXH64_digest(data);
+
+	std::array<uint8_t, 64> tail;
+	memcpy(tail.data(), lastBlockEnd.data(), 16);
+	memcpy(tail.data() + 16, buffer.data(), bufferLen);
+	const auto seed = hadBlocks ? state[0] ^ state[1] ^ state[2] : state[0];
+	return finish(seed, tail.data() + 16, bufferLen, length);
+}
+
+void Hash::Hasher::reset()
+{
+	const auto seed = initialSeed();
+	state = {{ seed, seed, seed }};
+	length = 0;
+	bufferLen = 0;
+	hadBlocks = false;
+	lastBlockEnd.fill(0);
+	ready = true;
 }
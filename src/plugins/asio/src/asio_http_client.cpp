@@ -0,0 +1,663 @@
+#include "asio_http_client.h"
+#include "halley/core/api/system_api.h"
+#include "halley/support/logger.h"
+#include "halley/text/string_converter.h"
+#include <sstream>
+using namespace Halley;
+
+namespace {
+	constexpr int requestTimeout = 30; // Seconds, for each step of the exchange
+}
+
+struct AsioHTTPClient::Connection
+{
+	explicit Connection(asio::io_service& service)
+		: socket(service)
+	{}
+
+	TCPSocket socket;
+	asio::streambuf buffer;
+	std::chrono::steady_clock::time_point lastUsed;
+};
+
+class AsioHTTPClient::Exchange : public std::enable_shared_from_this<Exchange>
+{
+public:
+	Exchange(AsioHTTPClient& client, std::shared_ptr<Request> request, std::shared_ptr<Connection> connection, bool reused)
+		: client(client)
+		, request(std::move(request))
+		, connection(std::move(connection))
+		, resolver(client.service)
+		, timer(client.service)
+		, reused(reused)
+	{}
+
+	void begin()
+	{
+		if (connection->socket.is_open()) {
+			write();
+		} else {
+			connect();
+		}
+	}
+
+	void cancel()
+	{
+		finish(0, true, false);
+	}
+
+	const std::shared_ptr<Request>& getRequest() const
+	{
+		return request;
+	}
+
+private:
+	enum class BodyMode
+	{
+		None,
+		Length,
+		Chunked,
+		UntilClosed
+	};
+
+	AsioHTTPClient& client;
+	std::shared_ptr<Request> request;
+	std::shared_ptr<Connection> connection;
+	asio::ip::tcp::resolver resolver;
+	asio::steady_timer timer;
+	bool reused;
+	bool gotResponse = false;
+	bool done = false;
+	std::string outHeader;
+
+	int code = 0;
+	std::map<String, String> headers;
+	Bytes body;
+	BodyMode mode = BodyMode::None;
+	size_t remaining = 0;
+	bool keepAlive = false;
+
+	void arm()
+	{
+		// Re-arming cancels the previous wait, so this only fires if a single step stalls
+		std::weak_ptr<Exchange> weak = shared_from_this();
+		timer.expires_from_now(std::chrono::seconds(requestTimeout));
+		timer.async_wait([weak] (const boost::system::error_code& ec)
+		{
+			auto self = weak.lock();
+			if (!ec && self && !self->done) {
+				boost::system::error_code ignored;
+				self->resolver.cancel();
+				self->connection->socket.close(ignored);
+			}
+		});
+	}
+
+	void connect()
+	{
+		auto self = shared_from_this();
+		arm();
+		resolver.async_resolve(request->host.cppStr(), toString(request->port).cppStr(), [self] (const boost::system::error_code& ec, asio::ip::tcp::resolver::results_type result)
+		{
+			if (ec) {
+				self->fail("Unable to resolve " + self->request->host + ": " + ec.message());
+				return;
+			}
+			asio::async_connect(self->connection->socket, result, [self] (const boost::system::error_code& ec, const TCPEndpoint&)
+			{
+				if (ec) {
+					self->fail("Unable to connect to " + self->request->host + ":" + toString(self->request->port) + ": " + ec.message());
+				} else {
+					self->write();
+				}
+			});
+		});
+	}
+
+	void write()
+	{
+		std::stringstream s;
+		s << request->method << " " << (request->path.isEmpty() ? String("/") : request->path) << " HTTP/1.1\r\n";
+		s << "Host: " << request->host;
+		if (request->port != 80) {
+			s << ":" << request->port;
+		}
+		s << "\r\n";
+		s << "Connection: keep-alive\r\n";
+		if (!request->postData.empty() || request->method == "POST" || request->method == "PUT") {
+			if (!request->contentType.isEmpty()) {
+				s << "Content-Type: " << request->contentType << "\r\n";
+			}
+			s << "Content-Length: " << request->postData.size() << "\r\n";
+		}
+		for (auto& h: request->headers) {
+			s << h.first << ": " << h.second << "\r\n";
+		}
+		s << "\r\n";
+		outHeader = s.str();
+
+		std::array<asio::const_buffer, 2> buffers = {{ asio::buffer(outHeader), asio::buffer(request->postData) }};
+		auto self = shared_from_this();
+		arm();
+		asio::async_write(connection->socket, buffers, [self] (const boost::system::error_code& ec, size_t)
+		{
+			if (ec) {
+				self->fail("Error sending request to " + self->request->host + ": " + ec.message());
+			} else {
+				self->readHeader();
+			}
+		});
+	}
+
+	void readHeader()
+	{
+		auto self = shared_from_this();
+		arm();
+		asio::async_read_until(connection->socket, connection->buffer, "\r\n\r\n", [self] (const boost::system::error_code& ec, size_t)
+		{
+			if (ec) {
+				self->fail("Error reading response from " + self->request->host + ": " + ec.message());
+			} else {
+				self->onHeader();
+			}
+		});
+	}
+
+	void onHeader()
+	{
+		gotResponse = true;
+
+		std::istream stream(&connection->buffer);
+		std::string line;
+		std::getline(stream, line);
+		String version;
+		{
+			std::stringstream statusLine(line);
+			std::string v;
+			statusLine >> v >> code;
+			version = v;
+		}
+		if (!version.startsWith("HTTP/") || code == 0) {
+			fail("Malformed response from " + request->host + ": " + String(line));
+			return;
+		}
+
+		while (std::getline(stream, line) && line != "\r" && !line.empty()) {
+			String header = line;
+			auto colon = header.find(':');
+			if (colon != String::npos) {
+				headers[header.substr(0, colon).trimBoth().asciiLower()] = header.substr(colon + 1).trimBoth();
+			}
+		}
+
+		auto connectionHeader = getHeader("connection").asciiLower();
+		keepAlive = version == "HTTP/1.1" ? connectionHeader != "close" : connectionHeader == "keep-alive";
+
+		if (request->method == "HEAD" || code == 204 || code == 304 || (code >= 100 && code < 200)) {
+			mode = BodyMode::None;
+		} else if (getHeader("transfer-encoding").asciiLower().find("chunked") != String::npos) {
+			mode = BodyMode::Chunked;
+		} else if (headers.find("content-length") != headers.end()) {
+			mode = BodyMode::Length;
+			remaining = size_t(getHeader("content-length").toInteger64());
+		} else {
+			mode = BodyMode::UntilClosed;
+			keepAlive = false;
+		}
+
+		switch (mode) {
+		case BodyMode::None:
+			succeed();
+			break;
+		case BodyMode::Chunked:
+			readChunkSize();
+			break;
+		default:
+			readBody();
+		}
+	}
+
+	String getHeader(const String& name) const
+	{
+		auto iter = headers.find(name);
+		return iter != headers.end() ? iter->second : String();
+	}
+
+	void readBody()
+	{
+		// Used for Content-Length bodies, the data part of each chunk, and bodies that run until the server hangs up
+		const bool untilClosed = mode == BodyMode::UntilClosed;
+		const size_t buffered = connection->buffer.size();
+		if (!deliver(untilClosed ? buffered : std::min(buffered, remaining))) {
+			return;
+		}
+
+		if (!untilClosed && remaining == 0) {
+			if (mode == BodyMode::Chunked) {
+				readChunkEnd();
+			} else {
+				succeed();
+			}
+			return;
+		}
+
+		auto self = shared_from_this();
+		arm();
+		asio::async_read(connection->socket, connection->buffer, asio::transfer_at_least(1), [self, untilClosed] (const boost::system::error_code& ec, size_t)
+		{
+			if (ec == asio::error::eof && untilClosed) {
+				if (self->deliver(self->connection->buffer.size())) {
+					self->succeed();
+				}
+			} else if (ec) {
+				self->fail("Error reading response body from " + self->request->host + ": " + ec.message());
+			} else {
+				self->readBody();
+			}
+		});
+	}
+
+	void readLine(std::function<void(std::string)> callback)
+	{
+		auto self = shared_from_this();
+		arm();
+		asio::async_read_until(connection->socket, connection->buffer, "\r\n", [self, callback] (const boost::system::error_code& ec, size_t)
+		{
+			if (ec) {
+				self->fail("Error reading response body from " + self->request->host + ": " + ec.message());
+			} else {
+				std::istream stream(&self->connection->buffer);
+				std::string line;
+				std::getline(stream, line);
+				if (!line.empty() && line.back() == '\r') {
+					line.pop_back();
+				}
+				callback(std::move(line));
+			}
+		});
+	}
+
+	void readChunkSize()
+	{
+		auto self = shared_from_this();
+		readLine([self] (std::string line)
+		{
+			// Chunk extensions after ';' are allowed, and ignored
+			size_t size = 0;
+			std::stringstream s(line.substr(0, line.find(';')));
+			if (!(s >> std::hex >> size)) {
+				self->fail("Malformed chunk in response from " + self->request->host);
+			} else if (size == 0) {
+				self->readTrailer();
+			} else {
+				self->remaining = size;
+				self->readBody();
+			}
+		});
+	}
+
+	void readChunkEnd()
+	{
+		auto self = shared_from_this();
+		readLine([self] (std::string line)
+		{
+			if (!line.empty()) {
+				self->fail("Malformed chunk in response from " + self->request->host);
+			} else {
+				self->readChunkSize();
+			}
+		});
+	}
+
+	void readTrailer()
+	{
+		auto self = shared_from_this();
+		readLine([self] (std::string line)
+		{
+			if (line.empty()) {
+				self->succeed();
+			} else {
+				self->readTrailer();
+			}
+		});
+	}
+
+	bool deliver(size_t n)
+	{
+		if (request->promise.isCancelled()) {
+			finish(code, true, false);
+			return false;
+		}
+		if (n == 0) {
+			return true;
+		}
+
+		auto data = asio::buffer_cast<const gsl::byte*>(connection->buffer.data());
+		if (request->sink) {
+			if (!request->sink(gsl::span<const gsl::byte>(data, n))) {
+				connection->buffer.consume(n);
+				finish(code, true, false);
+				return false;
+			}
+		} else {
+			auto bytes = reinterpret_cast<const Byte*>(data);
+			body.insert(body.end(), bytes, bytes + n);
+		}
+		connection->buffer.consume(n);
+		remaining -= std::min(remaining, n);
+		return true;
+	}
+
+	void succeed()
+	{
+		finish(code, false, keepAlive && connection->buffer.size() == 0);
+	}
+
+	void fail(const String& error)
+	{
+		if (done) {
+			return;
+		}
+
+		// A kept-alive connection might have been closed by the server while it sat in the pool, so give it one more go on a new one
+		if (reused && !gotResponse) {
+			done = true;
+			timer.cancel();
+			boost::system::error_code ignored;
+			connection->socket.close(ignored);
+			client.onRetry(shared_from_this(), request);
+			return;
+		}
+
+		Logger::logError("HTTP " + request->method + " " + request->host + request->path + " failed: " + error);
+		finish(gotResponse ? code : 0, false, false);
+	}
+
+	void finish(int responseCode, bool cancelled, bool reusable)
+	{
+		if (done) {
+			return;
+		}
+		done = true;
+		timer.cancel();
+
+		auto response = std::make_unique<AsioHTTPResponse>(responseCode, std::move(body), std::move(headers));
+		if (cancelled) {
+			response->setCancelled();
+		}
+		request->promise.setValue(std::move(response));
+
+		if (!reusable) {
+			boost::system::error_code ignored;
+			connection->socket.close(ignored);
+		}
+		client.onFinished(shared_from_this(), reusable ? connection : std::shared_ptr<Connection>());
+	}
+};
+
+AsioHTTPClient::AsioHTTPClient(SystemAPI* system)
+	: work(std::make_unique<asio::io_service::work>(service))
+	, sweepTimer(service)
+{
+	auto run = [this] ()
+	{
+		service.run();
+	};
+	thread = system ? system->createThread("HTTP", ThreadPriority::Normal, run) : std::thread(run);
+}
+
+AsioHTTPClient::~AsioHTTPClient()
+{
+	work.reset();
+	service.stop();
+	if (thread.joinable()) {
+		thread.join();
+	}
+
+	// Nothing else runs now, so anything still waiting gets a cancelled response
+	auto leftover = std::move(active);
+	for (auto& exchange: leftover) {
+		exchange->cancel();
+	}
+	for (auto& pool: pools) {
+		for (auto& request: pool.second.queue) {
+			cancel(*request);
+		}
+	}
+	for (auto& request: incoming) {
+		cancel(*request);
+	}
+	active.clear();
+	pools.clear();
+}
+
+void AsioHTTPClient::submit(std::shared_ptr<Request> request)
+{
+	{
+		std::unique_lock<std::mutex> lock(incomingMutex);
+		incoming.push_back(std::move(request));
+	}
+	service.post([this] ()
+	{
+		std::deque<std::shared_ptr<Request>> requests;
+		{
+			std::unique_lock<std::mutex> lock(incomingMutex);
+			requests = std::move(incoming);
+			incoming.clear();
+		}
+		for (auto& r: requests) {
+			auto key = getPoolKey(*r);
+			pools[key].queue.push_back(std::move(r));
+			dispatch(key);
+		}
+	});
+}
+
+void AsioHTTPClient::cancel(Request& request)
+{
+	auto response = std::make_unique<AsioHTTPResponse>(0, Bytes(), std::map<String, String>());
+	response->setCancelled();
+	request.promise.setValue(std::move(response));
+}
+
+String AsioHTTPClient::getPoolKey(const Request& request)
+{
+	return request.host.asciiLower() + ":" + toString(request.port);
+}
+
+void AsioHTTPClient::dispatch(const String& key)
+{
+	auto& pool = pools[key];
+	const auto now = std::chrono::steady_clock::now();
+
+	while (!pool.queue.empty()) {
+		// Prefer the most recently used connection, as it's the least likely to have been dropped by the server
+		std::shared_ptr<Connection> connection;
+		while (!pool.idle.empty() && !connection) {
+			auto candidate = std::move(pool.idle.back());
+			pool.idle.pop_back();
+			if (candidate->socket.is_open() && now - candidate->lastUsed < std::chrono::seconds(idleTimeout)) {
+				connection = std::move(candidate);
+			} else {
+				boost::system::error_code ignored;
+				candidate->socket.close(ignored);
+				--pool.open;
+			}
+		}
+
+		const bool reused = static_cast<bool>(connection);
+		if (!reused) {
+			if (pool.open >= maxConnectionsPerHost) {
+				return;
+			}
+			connection = std::make_shared<Connection>(service);
+			++pool.open;
+		}
+
+		auto request = std::move(pool.queue.front());
+		pool.queue.pop_front();
+		start(std::move(request), std::move(connection), reused);
+	}
+}
+
+void AsioHTTPClient::start(std::shared_ptr<Request> request, std::shared_ptr<Connection> connection, bool reused)
+{
+	auto exchange = std::make_shared<Exchange>(*this, std::move(request), std::move(connection), reused);
+	active.insert(exchange);
+	exchange->begin();
+}
+
+void AsioHTTPClient::onFinished(std::shared_ptr<Exchange> exchange, std::shared_ptr<Connection> reusable)
+{
+	if (active.erase(exchange) == 0) {
+		// Already being torn down by the destructor
+		return;
+	}
+
+	// The exchange is done with the connection by now, so the next request in the queue can have it straight away
+	auto key = getPoolKey(*exchange->getRequest());
+	auto& pool = pools[key];
+	if (reusable) {
+		reusable->lastUsed = std::chrono::steady_clock::now();
+		pool.idle.push_back(std::move(reusable));
+		scheduleSweep();
+	} else {
+		--pool.open;
+	}
+	dispatch(key);
+}
+
+void AsioHTTPClient::onRetry(std::shared_ptr<Exchange> exchange, std::shared_ptr<Request> request)
+{
+	// The stale connection is replaced by a fresh one, which keeps its place in the pool's count, rather than going through the queue
+	active.erase(exchange);
+	start(std::move(request), std::make_shared<Connection>(service), false);
+}
+
+void AsioHTTPClient::scheduleSweep()
+{
+	if (sweepScheduled) {
+		return;
+	}
+	sweepScheduled = true;
+	sweepTimer.expires_from_now(std::chrono::seconds(idleTimeout));
+	sweepTimer.async_wait([this] (const boost::system::error_code& ec)
+	{
+		sweepScheduled = false;
+		if (!ec) {
+			sweepIdle();
+		}
+	});
+}
+
+void AsioHTTPClient::sweepIdle()
+{
+	const auto now = std::chrono::steady_clock::now();
+	bool anyLeft = false;
+	for (auto& p: pools) {
+		auto& pool = p.second;
+		pool.idle.erase(std::remove_if(pool.idle.begin(), pool.idle.end(), [&] (const std::shared_ptr<Connection>& c)
+		{
+			if (c->socket.is_open() && now - c->lastUsed < std::chrono::seconds(idleTimeout)) {
+				return false;
+			}
+			boost::system::error_code ignored;
+			c->socket.close(ignored);
+			--pool.open;
+			return true;
+		}), pool.idle.end());
+		anyLeft |= !pool.idle.empty();
+	}
+	if (anyLeft) {
+		scheduleSweep();
+	}
+}
+
+AsioHTTPResponse::AsioHTTPResponse(int code, Bytes body, std::map<String, String> headers)
+	: code(code)
+	, body(std::move(body))
+	, headers(std::move(headers))
+{}
+
+int AsioHTTPResponse::getResponseCode() const
+{
+	return code;
+}
+
+const Bytes& AsioHTTPResponse::getBody() const
+{
+	return body;
+}
+
+const std::map<String, String>& AsioHTTPResponse::getHeaders() const
+{
+	return headers;
+}
+
+AsioHTTPRequest::AsioHTTPRequest(AsioHTTPClient& client, const String& method, const String& url)
+	: client(client)
+	, url(url)
+	, request(std::make_shared<AsioHTTPClient::Request>())
+{
+	request->method = method;
+}
+
+void AsioHTTPRequest::setPostData(const String& contentType, const Bytes& data)
+{
+	request->contentType = contentType;
+	request->postData = data;
+}
+
+void AsioHTTPRequest::setHeader(const String& headerName, const String& headerValue)
+{
+	request->headers[headerName] = headerValue;
+}
+
+bool AsioHTTPRequest::setResponseSink(std::function<bool(gsl::span<const gsl::byte>)> sink)
+{
+	request->sink = std::move(sink);
+	return true;
+}
+
+Future<std::unique_ptr<HTTPResponse>> AsioHTTPRequest::send()
+{
+	Expects(request);
+	auto future = request->promise.getFuture();
+	if (parseURL()) {
+		client.submit(std::move(request));
+	} else {
+		request->promise.setValue(std::make_unique<AsioHTTPResponse>(0, Bytes(), std::map<String, String>()));
+		request.reset();
+	}
+	return future;
+}
+
+bool AsioHTTPRequest::parseURL()
+{
+	if (url.startsWith("https://", false)) {
+		Logger::logError("Unable to request " + url + ": HTTPS is not supported by this network API.");
+		return false;
+	}
+	if (!url.startsWith("http://", false)) {
+		Logger::logError("Unable to request " + url + ": malformed URL.");
+		return false;
+	}
+
+	const auto rest = url.substr(7);
+	const auto pathStart = rest.find('/');
+	auto host = rest.substr(0, pathStart);
+	request->path = pathStart == String::npos ? String("/") : rest.substr(pathStart);
+
+	const auto portStart = host.find(':');
+	if (portStart != String::npos) {
+		const auto port = host.substr(portStart + 1);
+		if (!port.isInteger()) {
+			Logger::logError("Unable to request " + url + ": malformed port.");
+			return false;
+		}
+		request->port = port.toInteger();
+		host = host.substr(0, portStart);
+	}
+	request->host = host;
+	return !host.isEmpty();
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "asio_tcp_connection.h"
+#include "halley/core/api/platform_api.h"
+#include "halley/data_structures/hash_map.h"
+#include <deque>
+#include <set>
+#include <thread>
+
+namespace Halley
+{
+	class SystemAPI;
+
+	// Runs every HTTP request on a single background io_service, so nothing blocks while waiting on the server.
+	// Connections are kept alive and reused for further requests to the same host, up to maxConnectionsPerHost at a time;
+	// anything over that waits in a queue for a connection to free up.
+	class AsioHTTPClient
+	{
+	public:
+		struct Request
+		{
+			String method;
+			String host;
+			int port = 80;
+			String path;
+			std::map<String, String> headers;
+			String contentType;
+			Bytes postData;
+			std::function<bool(gsl::span<const gsl::byte>)> sink;
+			Promise<std::unique_ptr<HTTPResponse>> promise;
+		};
+
+		explicit AsioHTTPClient(SystemAPI* system);
+		~AsioHTTPClient();
+
+		void submit(std::shared_ptr<Request> request);
+
+	private:
+		struct Connection;
+		class Exchange;
+
+		struct HostPool
+		{
+			std::vector<std::shared_ptr<Connection>> idle;
+			std::deque<std::shared_ptr<Request>> queue;
+			int open = 0;
+		};
+
+		constexpr static int maxConnectionsPerHost = 4;
+		constexpr static int idleTimeout = 20; // Seconds
+
+		asio::io_service service;
+		std::unique_ptr<asio::io_service::work> work;
+		asio::steady_timer sweepTimer;
+		bool sweepScheduled = false;
+		std::thread thread;
+
+		std::mutex incomingMutex;
+		std::deque<std::shared_ptr<Request>> incoming;
+
+		// Only touched from the io_service thread
+		HashMap<String, HostPool> pools;
+		std::set<std::shared_ptr<Exchange>> active;
+
+		static String getPoolKey(const Request& request);
+		static void cancel(Request& request);
+		void dispatch(const String& key);
+		void start(std::shared_ptr<Request> request, std::shared_ptr<Connection> connection, bool reused);
+		void onFinished(std::shared_ptr<Exchange> exchange, std::shared_ptr<Connection> reusable);
+		void onRetry(std::shared_ptr<Exchange> exchange, std::shared_ptr<Request> request);
+		void scheduleSweep();
+		void sweepIdle();
+	};
+
+	class AsioHTTPResponse : public HTTPResponse
+	{
+	public:
+		AsioHTTPResponse(int code, Bytes body, std::map<String, String> headers);
+
+		int getResponseCode() const override;
+		const Bytes& getBody() const override;
+		const std::map<String, String>& getHeaders() const;
+
+	private:
+		int code;
+		Bytes body;
+		std::map<String, String> headers;
+	};
+
+	class AsioHTTPRequest : public HTTPRequest
+	{
+	public:
+		AsioHTTPRequest(AsioHTTPClient& client, const String& method, const String& url);
+
+		void setPostData(const String& contentType, const Bytes& data) override;
+		void setHeader(const String& headerName, const String& headerValue) override;
+		bool setResponseSink(std::function<bool(gsl::span<const gsl::byte>)> sink) override;
+		Future<std::unique_ptr<HTTPResponse>> send() override;
+
+	private:
+		AsioHTTPClient& client;
+		String url;
+		std::shared_ptr<AsioHTTPClient::Request> request;
+
+		bool parseURL();
+	};
+}
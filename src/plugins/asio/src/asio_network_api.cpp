@@ -1,9 +1,16 @@
 #include "asio_network_api.h"
 #include "asio_tcp_network_service.h"
 #include "asio_udp_network_service.h"
+#include "asio_http_client.h"
 
 using namespace Halley;
 
+AsioNetworkAPI::AsioNetworkAPI(SystemAPI* system)
+	: system(system)
+{}
+
+AsioNetworkAPI::~AsioNetworkAPI() = default;
+
 std::unique_ptr<NetworkService> AsioNetworkAPI::createService(NetworkProtocol protocol, int port)
 {
 	if (protocol == NetworkProtocol::TCP) {
@@ -15,5 +22,30 @@ std::unique_ptr<NetworkService> AsioNetworkAPI::createService(NetworkProtocol pr
 	}
 }
 
-void AsioNetworkAPI::init() {}
-void AsioNetworkAPI::deInit() {}
+std::unique_ptr<NetworkService> AsioNetworkAPI::createHighFanInService(NetworkProtocol protocol, int port, size_t numSockets)
+{
+	if (protocol == NetworkProtocol::UDP) {
+		if (numSockets == 0) {
+			numSockets = std::max(size_t(1), size_t(std::thread::hardware_concurrency()));
+		}
+		return std::make_unique<AsioUDPNetworkService>(port, IPVersion::IPv4, numSockets, system);
+	} else {
+		return createService(protocol, port);
+	}
+}
+
+std::unique_ptr<HTTPRequest> AsioNetworkAPI::makeHTTPRequest(const String& method, const String& url)
+{
+	Expects(httpClient);
+	return std::make_unique<AsioHTTPRequest>(*httpClient, method, url);
+}
+
+void AsioNetworkAPI::init()
+{
+	httpClient = std::make_unique<AsioHTTPClient>(system);
+}
+
+void AsioNetworkAPI::deInit()
+{
+	httpClient.reset();
+}
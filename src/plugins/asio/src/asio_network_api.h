@@ -3,11 +3,23 @@
 
 namespace Halley
 {
+	class AsioHTTPClient;
+
 	class AsioNetworkAPI : public NetworkAPIInternal
 	{
 	public:
+		explicit AsioNetworkAPI(SystemAPI* system);
+		~AsioNetworkAPI();
+
 		std::unique_ptr<NetworkService> createService(NetworkProtocol protocol, int port) override;
+		std::unique_ptr<NetworkService> createHighFanInService(NetworkProtocol protocol, int port, size_t numSockets) override;
+		std::unique_ptr<HTTPRequest> makeHTTPRequest(const String& method, const String& url) override;
 		void init() override;
 		void deInit() override;
+		bool canInitInBackground() const override { return true; }
+
+	private:
+		SystemAPI* system;
+		std::unique_ptr<AsioHTTPClient> httpClient;
 	};
 }
@@ -9,7 +9,9 @@ AsioTCPConnection::AsioTCPConnection(asio::io_service& service, TCPSocket socket
 	: service(service)
 	, socket(std::move(socket))
 	, status(ConnectionStatus::Connected)
-{}
+{
+	setNoDelay();
+}
 
 AsioTCPConnection::AsioTCPConnection(asio::io_service& service, String host, int port)
 	: service(service)
@@ -27,6 +29,7 @@ AsioTCPConnection::AsioTCPConnection(asio::io_service& service, String host, int
 				socket.connect(r, ec2);
 				if (!ec2) {
 					Logger::logDev("Connected to " + host + ":" + toString(port));
+					setNoDelay();
 					status = ConnectionStatus::Connected;
 					break;
 				}
@@ -102,10 +105,7 @@ void AsioTCPConnection::send(OutboundNetworkPacket&& packet)
 	std::unique_lock<std::mutex> lock(mutex);
 	if (status == ConnectionStatus::Connected) {
 		sendQueue.emplace_back(std::move(bs));
-
-		if (sendQueue.size() == 1) {
-			trySend();
-		}
+		trySend();
 	}
 }
 
@@ -139,33 +139,45 @@ bool AsioTCPConnection::needsPolling() const
 
 void AsioTCPConnection::trySend()
 {
-	if (!sendQueue.empty() && status == ConnectionStatus::Connected) {
+	if (!writing && !sendQueue.empty() && status == ConnectionStatus::Connected) {
 		needsPoll = true;
+		writing = true;
 
-		sendingQueue.emplace_back(std::move(sendQueue.front()));
-		sendQueue.pop_front();
-		auto& toSend = sendingQueue.back();
+		// Whatever piled up while the last write was in flight goes out together, rather than as one small write per packet
+		size_t size = 0;
+		for (auto& b: sendQueue) {
+			size += b.size();
+		}
+		sending.resize(size);
+		size_t pos = 0;
+		for (auto& b: sendQueue) {
+			memcpy(sending.data() + pos, b.data(), b.size());
+			pos += b.size();
+		}
+		sendQueue.clear();
 
-		socket.async_write_some(asio::buffer(toSend.data(), toSend.size()), [=] (const boost::system::error_code& ec, size_t bytesWritten)
+		asio::async_write(socket, asio::buffer(sending.data(), sending.size()), [=] (const boost::system::error_code& ec, size_t)
 		{
+			std::unique_lock<std::mutex> lock(mutex);
+			writing = false;
 			if (ec) {
+				lock.unlock();
 				Logger::logError("Error sending data on TCP socket: " + ec.message());
 				close();
 			} else {
-				auto& front = sendingQueue.front();
-				if (bytesWritten == front.size()) {
-					sendingQueue.pop_front();
-				} else {
-					front.erase(front.begin(), front.begin() + bytesWritten);
-				}
-
-				std::unique_lock<std::mutex> lock(mutex);
 				trySend();
 			}
 		});
 	}
 }
 
+void AsioTCPConnection::setNoDelay()
+{
+	// Packets are already coalesced by trySend() and by the message queue, so Nagle would only add latency
+	boost::system::error_code ec;
+	socket.set_option(asio::ip::tcp::no_delay(true), ec);
+}
+
 void AsioTCPConnection::tryReceive()
 {
 	if (!reading && status == ConnectionStatus::Connected) {
@@ -39,15 +39,17 @@ namespace Halley
 		ConnectionStatus status;
 
 		std::list<Bytes> sendQueue;
-		std::list<Bytes> sendingQueue;
+		Bytes sending; // Everything queued when the current write started, as a single buffer
 		Bytes receiveQueue;
 		Bytes receiveBuffer;
 		bool reading = false;
+		bool writing = false;
 		bool needsPoll = false;
 
 		mutable std::mutex mutex;
 
 		void trySend();
+		void setNoDelay();
 		void tryReceive();
 	};
 }
@@ -47,7 +47,7 @@ void AsioUDPConnection::send(OutboundNetworkPacket&& packet)
 		std::array<unsigned char, 2> id = { 0, 0 };
 		size_t len = 0;
 		if (connectionId >= 128) {
-			id[0] = (connectionId >> 8) & 0x7F;
+			id[0] = 0x80 | ((connectionId >> 8) & 0x7F);
 			id[1] = connectionId & 0xFF;
 			len = 2;
 		} else {
@@ -56,16 +56,29 @@ void AsioUDPConnection::send(OutboundNetworkPacket&& packet)
 		}
 		packet.addHeader(gsl::as_bytes(gsl::span<unsigned char>(id).subspan(0, len)));
 
+#ifdef HAS_UDP_BATCHED_IO
+		// The service sends everything queued at the end of its update
+		pendingSend.emplace_back(std::move(packet));
+#else
 		bool needsSend = pendingSend.empty();
 		pendingSend.emplace_back(std::move(packet));
 		if (needsSend) {
 			sendNext();
 		}
+#endif
 	}
 }
 
 bool AsioUDPConnection::receive(InboundNetworkPacket& packet)
 {
+	if (pendingReceive.empty()) {
+		std::unique_lock<std::mutex> lock(receivedMutex);
+		for (auto& p: received) {
+			pendingReceive.emplace_back(std::move(p));
+		}
+		received.clear();
+	}
+
 	if (pendingReceive.empty()) {
 		return false;
 	} else {
@@ -100,6 +113,14 @@ void AsioUDPConnection::onReceive(gsl::span<const gsl::byte> data)
 	}
 }
 
+void AsioUDPConnection::onReceive(InboundNetworkPacket&& packet)
+{
+	if (packet.getSize() <= 1500) {
+		std::unique_lock<std::mutex> lock(receivedMutex);
+		received.emplace_back(std::move(packet));
+	}
+}
+
 void AsioUDPConnection::setError(const std::string& cs)
 {
 	error = cs;
@@ -12,9 +12,16 @@
 
 #include <deque>
 #include <array>
+#include <mutex>
+#include <vector>
 #include <string>
 #include <gsl/gsl>
 
+// recvmmsg/sendmmsg move many datagrams per syscall, which matters when one process serves lots of connections
+#if defined(__linux__) && !defined(__ANDROID__)
+#define HAS_UDP_BATCHED_IO
+#endif
+
 namespace Halley
 {
 	class NetworkService;
@@ -33,6 +40,7 @@ namespace Halley
 		
 		bool matchesEndpoint(const UDPEndpoint& remoteEndpoint) const;
 		void onReceive(gsl::span<const gsl::byte> data);
+		void onReceive(InboundNetworkPacket&& packet); // From any thread, for open connections, which hand it to receive() as is
 		void setError(const std::string& cs);
 		
 		void open(short connectionId);
@@ -40,6 +48,12 @@ namespace Halley
 		void terminateConnection();
 		short getConnectionId() const { return connectionId; }
 
+		// Used by the service to send queued packets in batches, where supported
+		const UDPEndpoint& getRemote() const { return remote; }
+		size_t getNumPendingSend() const { return pendingSend.size(); }
+		gsl::span<const gsl::byte> getPendingSend(size_t idx) const { return pendingSend[idx].getBytes(); }
+		void popPendingSend() { pendingSend.pop_front(); }
+
 	private:
 		UDPSocket& socket;
 		UDPEndpoint remote;
@@ -48,6 +62,8 @@ namespace Halley
 
 		std::deque<OutboundNetworkPacket> pendingSend;
 		std::deque<InboundNetworkPacket> pendingReceive;
+		std::mutex receivedMutex;
+		std::vector<InboundNetworkPacket> received; // By onReceive(InboundNetworkPacket&&), moved to pendingReceive when it runs out
 		std::array<gsl::byte, 2048> sendBuffer;
 		std::string error;
 
@@ -6,6 +6,18 @@
 #include <iostream>
 #include <unordered_map>
 #include <halley/support/exception.h>
+#include "halley/core/api/system_api.h"
+
+#ifdef HAS_UDP_BATCHED_IO
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#endif
 
 using namespace Halley;
 namespace asio = boost::asio;
@@ -22,19 +34,165 @@ struct HandshakeOpen
 	// TODO: public-key encrypted temporary key
 };
 
+namespace {
+	constexpr int maxConnectionId = 0x7FFF; // Has to fit in a two-byte header, see AsioUDPConnection::send
 
+	bool readConnectionId(gsl::span<const gsl::byte> data, short& id, size_t& headerSize)
+	{
+		if (data.size_bytes() == 0) {
+			return false;
+		}
+		const auto first = static_cast<unsigned char>(data[0]);
+		if (first & 0x80) {
+			if (data.size_bytes() < 2) {
+				return false;
+			}
+			id = short(((first & 0x7F) << 8) | static_cast<unsigned char>(data[1]));
+			headerSize = 2;
+		} else {
+			id = short(first);
+			headerSize = 1;
+		}
+		return true;
+	}
+}
+
+
+
+#ifdef HAS_UDP_BATCHED_IO
+struct AsioUDPNetworkService::BatchedIO
+{
+	constexpr static size_t batchSize = 32;
+
+	std::array<mmsghdr, batchSize> msgs;
+	std::array<iovec, batchSize> iovecs;
+	std::array<sockaddr_storage, batchSize> addresses;
+	std::array<std::array<gsl::byte, 2048>, batchSize> receiveBuffers;
+	std::array<AsioUDPConnection*, batchSize> owners;
+};
+
+struct AsioUDPNetworkService::FanIn
+{
+	constexpr static size_t batchSize = 32;
+	constexpr static size_t receiveSize = 2048;
+
+	struct Receiver
+	{
+		UDPSocket* socket;
+		std::thread thread;
+		std::atomic<uint64_t> epoch{ 0 }; // Advanced after every batch, see retireConnection()
+
+		std::array<mmsghdr, batchSize> msgs;
+		std::array<iovec, batchSize> iovecs;
+		std::array<sockaddr_storage, batchSize> addresses;
+		std::array<NetworkPacketBuffer, batchSize> buffers; // Moved into the packets, and taken again from the pool
+	};
+
+	struct Unrouted
+	{
+		UDPEndpoint remote;
+		NetworkPacketBuffer data;
+	};
+
+	struct Retired
+	{
+		std::shared_ptr<AsioUDPConnection> connection;
+		std::vector<uint64_t> epochs;
+	};
+
+	SystemAPI* system;
+	std::atomic<bool> running{ false };
+
+	// Indexed by connection id; only update() writes it
+	std::unique_ptr<std::atomic<AsioUDPConnection*>[]> connections;
+
+	std::vector<std::unique_ptr<UDPSocket>> extraSockets;
+	std::vector<std::unique_ptr<Receiver>> receivers;
+
+	std::mutex unroutedMutex;
+	std::vector<Unrouted> unrouted; // Connection requests, and anything else not for an open connection
+	std::vector<Unrouted> unroutedProcessing;
+
+	std::vector<Retired> retired;
+
+	explicit FanIn(SystemAPI* system)
+		: system(system)
+		, connections(new std::atomic<AsioUDPConnection*>[maxConnectionId + 1])
+	{
+		for (int i = 0; i <= maxConnectionId; ++i) {
+			connections[i].store(nullptr, std::memory_order_relaxed);
+		}
+	}
+};
+
+namespace {
+	void setFanInSocketOptions(UDPSocket& socket)
+	{
+		const int fd = socket.native_handle();
+		const int enable = 1;
+		if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0) {
+			throw Exception(String("Unable to set SO_REUSEPORT: ") + strerror(errno), HalleyExceptions::NetworkPlugin);
+		}
+
+		// Many remotes sending at once overflow the default buffer; the kernel caps this at net.core.rmem_max
+		const int receiveBufferSize = 4 * 1024 * 1024;
+		setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBufferSize, sizeof(receiveBufferSize));
+
+		// Receivers block, but wake up every so often to notice they're being stopped
+		timeval timeout;
+		timeout.tv_sec = 0;
+		timeout.tv_usec = 100 * 1000;
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	}
+}
+#endif
 
-AsioUDPNetworkService::AsioUDPNetworkService(int port, IPVersion version)
+AsioUDPNetworkService::AsioUDPNetworkService(int port, IPVersion version, size_t numReceiveSockets, SystemAPI* system)
 	: localEndpoint(version == IPVersion::IPv4 ? asio::ip::udp::v4() : asio::ip::udp::v6(), static_cast<unsigned short>(port))
-	, socket(service, localEndpoint)
+	, socket(service)
+#ifdef HAS_UDP_BATCHED_IO
+	, batchedIO(std::make_unique<BatchedIO>())
+#endif
 {
 	Expects(port == 0 || port > 1024);
 	Expects(port < 65536);
+
+	socket.open(localEndpoint.protocol());
+
+#ifdef HAS_UDP_BATCHED_IO
+	if (numReceiveSockets > 0) {
+		fanIn = std::make_unique<FanIn>(system);
+		setFanInSocketOptions(socket);
+		socket.bind(localEndpoint);
+
+		// The others share whichever port the first one got
+		localEndpoint = socket.local_endpoint();
+		for (size_t i = 1; i < numReceiveSockets; ++i) {
+			auto extra = std::make_unique<UDPSocket>(service);
+			extra->open(localEndpoint.protocol());
+			setFanInSocketOptions(*extra);
+			extra->bind(localEndpoint);
+			fanIn->extraSockets.push_back(std::move(extra));
+		}
+		return;
+	}
+#else
+	if (numReceiveSockets > 0) {
+		std::cout << "Receiving UDP on several sockets isn't supported on this platform, using just one." << std::endl;
+	}
+#endif
+
+	socket.bind(localEndpoint);
 }
 
 
 AsioUDPNetworkService::~AsioUDPNetworkService()
 {
+#ifdef HAS_UDP_BATCHED_IO
+	// Before anything the receivers might be using goes away
+	stopFanIn();
+#endif
+
 	for (auto& conn : activeConnections) {
 		try {
 			conn.second->terminateConnection();
@@ -63,11 +221,27 @@ void AsioUDPNetworkService::update()
 	}
 
 	for (auto i: toErase) {
+		publishConnection(i, nullptr);
+#ifdef HAS_UDP_BATCHED_IO
+		if (fanIn) {
+			retireConnection(active[i]);
+		}
+#endif
 		active.erase(i);
 	}
 
 	// Update service
 	service.poll();
+
+#ifdef HAS_UDP_BATCHED_IO
+	if (fanIn) {
+		receiveUnrouted();
+		releaseRetired();
+	} else if (startedListening) {
+		receiveBatched();
+	}
+	sendBatched();
+#endif
 }
 
 void AsioUDPNetworkService::setAcceptingConnections(bool accepting)
@@ -92,6 +266,7 @@ std::shared_ptr<IConnection> AsioUDPNetworkService::tryAcceptConnection()
 		conn->open(id);
 
 		activeConnections[id] = conn;
+		publishConnection(id, conn.get());
 		pending.pop_front();
 		return conn;
 	}
@@ -119,7 +294,14 @@ void AsioUDPNetworkService::startListening()
 {
 	if (!startedListening) {
 		startedListening = true;
+#ifdef HAS_UDP_BATCHED_IO
+		// Otherwise, update() drains the socket
+		if (fanIn) {
+			startFanIn();
+		}
+#else
 		receiveNext();
+#endif
 	}
 }
 
@@ -147,6 +329,289 @@ void AsioUDPNetworkService::receiveNext()
 	});
 }
 
+#ifdef HAS_UDP_BATCHED_IO
+void AsioUDPNetworkService::receiveBatched()
+{
+	auto& io = *batchedIO;
+	const auto fd = socket.native_handle();
+
+	while (true) {
+		for (size_t i = 0; i < BatchedIO::batchSize; ++i) {
+			io.iovecs[i].iov_base = io.receiveBuffers[i].data();
+			io.iovecs[i].iov_len = io.receiveBuffers[i].size();
+			auto& hdr = io.msgs[i].msg_hdr;
+			memset(&hdr, 0, sizeof(hdr));
+			hdr.msg_name = &io.addresses[i];
+			hdr.msg_namelen = sizeof(sockaddr_storage);
+			hdr.msg_iov = &io.iovecs[i];
+			hdr.msg_iovlen = 1;
+		}
+
+		const int n = recvmmsg(fd, io.msgs.data(), static_cast<unsigned int>(BatchedIO::batchSize), MSG_DONTWAIT, nullptr);
+		if (n < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				std::cout << "Error receiving packets: " << strerror(errno) << std::endl;
+			}
+			return;
+		}
+
+		for (int i = 0; i < n; ++i) {
+			auto& hdr = io.msgs[i].msg_hdr;
+			if (hdr.msg_flags & MSG_TRUNC) {
+				// Too big to be one of ours
+				continue;
+			}
+
+			memcpy(remoteEndpoint.data(), &io.addresses[i], hdr.msg_namelen);
+			remoteEndpoint.resize(hdr.msg_namelen);
+			try {
+				receivePacket(gsl::span<gsl::byte>(io.receiveBuffers[i].data(), io.msgs[i].msg_len), nullptr);
+			} catch (...) {
+				std::cout << "Exception while receiving a packet." << std::endl;
+			}
+		}
+
+		if (size_t(n) < BatchedIO::batchSize) {
+			return;
+		}
+	}
+}
+
+void AsioUDPNetworkService::sendBatched()
+{
+	// Everything queued by every connection goes out together; packets of one connection stay in order
+	auto& io = *batchedIO;
+	size_t n = 0;
+
+	for (auto& c: activeConnections) {
+		auto& conn = *c.second;
+
+		size_t nGathered = 0;
+		while (nGathered < conn.getNumPendingSend()) {
+			auto data = conn.getPendingSend(nGathered++);
+			auto& remote = conn.getRemote();
+
+			io.iovecs[n].iov_base = const_cast<gsl::byte*>(data.data());
+			io.iovecs[n].iov_len = size_t(data.size_bytes());
+			auto& hdr = io.msgs[n].msg_hdr;
+			memset(&hdr, 0, sizeof(hdr));
+			hdr.msg_name = const_cast<sockaddr*>(remote.data());
+			hdr.msg_namelen = socklen_t(remote.size());
+			hdr.msg_iov = &io.iovecs[n];
+			hdr.msg_iovlen = 1;
+			io.owners[n] = &conn;
+			++n;
+
+			if (n == BatchedIO::batchSize) {
+				if (!flushSendBatch(n)) {
+					return;
+				}
+				n = 0;
+				nGathered = 0;
+			}
+		}
+	}
+
+	flushSendBatch(n);
+}
+
+void AsioUDPNetworkService::startFanIn()
+{
+	auto& fan = *fanIn;
+	fan.running = true;
+
+	std::vector<UDPSocket*> sockets = { &socket };
+	for (auto& s: fan.extraSockets) {
+		sockets.push_back(s.get());
+	}
+
+	for (size_t i = 0; i < sockets.size(); ++i) {
+		auto receiver = std::make_unique<FanIn::Receiver>();
+		receiver->socket = sockets[i];
+		fan.receivers.push_back(std::move(receiver));
+	}
+
+	for (size_t i = 0; i < fan.receivers.size(); ++i) {
+		auto run = [this, i] ()
+		{
+			runFanInReceiver(i);
+		};
+		const auto name = String("UDP Receiver ") + toString(i);
+		fan.receivers[i]->thread = fan.system ? fan.system->createThread(name, ThreadPriority::High, run) : std::thread(run);
+	}
+}
+
+void AsioUDPNetworkService::stopFanIn()
+{
+	if (!fanIn || !fanIn->running) {
+		return;
+	}
+
+	auto& fan = *fanIn;
+	fan.running = false;
+	for (auto& r: fan.receivers) {
+		// Wakes up a receiver blocked on it, else it notices on its next timeout
+		::shutdown(r->socket->native_handle(), SHUT_RD);
+	}
+	for (auto& r: fan.receivers) {
+		if (r->thread.joinable()) {
+			r->thread.join();
+		}
+	}
+	fan.receivers.clear();
+}
+
+void AsioUDPNetworkService::runFanInReceiver(size_t idx)
+{
+	auto& fan = *fanIn;
+	auto& r = *fan.receivers[idx];
+	const auto fd = r.socket->native_handle();
+
+	while (fan.running) {
+		for (size_t i = 0; i < FanIn::batchSize; ++i) {
+			auto& buffer = r.buffers[i];
+			if (buffer.size() != FanIn::receiveSize) {
+				buffer.resize(FanIn::receiveSize);
+			}
+			r.iovecs[i].iov_base = buffer.data();
+			r.iovecs[i].iov_len = buffer.size();
+			auto& hdr = r.msgs[i].msg_hdr;
+			memset(&hdr, 0, sizeof(hdr));
+			hdr.msg_name = &r.addresses[i];
+			hdr.msg_namelen = sizeof(sockaddr_storage);
+			hdr.msg_iov = &r.iovecs[i];
+			hdr.msg_iovlen = 1;
+		}
+
+		// Blocks until there's at least one, then takes whatever else is already there
+		const int n = recvmmsg(fd, r.msgs.data(), static_cast<unsigned int>(FanIn::batchSize), MSG_WAITFORONE, nullptr);
+		if (n < 0) {
+			if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && fan.running) {
+				std::cout << "Error receiving packets: " << strerror(errno) << std::endl;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		}
+
+		for (int i = 0; i < n; ++i) {
+			auto& hdr = r.msgs[i].msg_hdr;
+			const size_t size = r.msgs[i].msg_len;
+			if ((hdr.msg_flags & MSG_TRUNC) || size == 0) {
+				// Too big to be one of ours
+				continue;
+			}
+
+			auto& buffer = r.buffers[i];
+			buffer.resize(size);
+
+			UDPEndpoint remote;
+			memcpy(remote.data(), &r.addresses[i], hdr.msg_namelen);
+			remote.resize(hdr.msg_namelen);
+
+			short id = 0;
+			size_t headerSize = 0;
+			if (!readConnectionId(buffer.getSpan(), id, headerSize) || id < 0) {
+				continue;
+			}
+
+			auto* connection = id > 0 ? fan.connections[id].load(std::memory_order_acquire) : nullptr;
+			if (connection) {
+				// The kernel sends each remote to the same socket, so packets of one connection still arrive in order
+				if (connection->matchesEndpoint(remote)) {
+					connection->onReceive(InboundNetworkPacket(std::move(buffer), headerSize));
+				}
+			} else {
+				std::unique_lock<std::mutex> lock(fan.unroutedMutex);
+				fan.unrouted.push_back(FanIn::Unrouted{ remote, std::move(buffer) });
+			}
+		}
+
+		// Nothing loaded from the table before this is used after it
+		r.epoch.fetch_add(1, std::memory_order_acq_rel);
+	}
+}
+
+void AsioUDPNetworkService::receiveUnrouted()
+{
+	auto& fan = *fanIn;
+	{
+		std::unique_lock<std::mutex> lock(fan.unroutedMutex);
+		std::swap(fan.unrouted, fan.unroutedProcessing);
+	}
+
+	for (auto& packet: fan.unroutedProcessing) {
+		remoteEndpoint = packet.remote;
+		try {
+			receivePacket(packet.data.getSpan(), nullptr);
+		} catch (...) {
+			std::cout << "Exception while receiving a packet." << std::endl;
+		}
+	}
+	fan.unroutedProcessing.clear();
+}
+
+void AsioUDPNetworkService::retireConnection(std::shared_ptr<AsioUDPConnection> connection)
+{
+	// It's out of the table, but a receiver might have loaded it just before; once every receiver is past the batch it was on, none has
+	auto& fan = *fanIn;
+	FanIn::Retired r;
+	r.connection = std::move(connection);
+	for (auto& receiver: fan.receivers) {
+		r.epochs.push_back(receiver->epoch.load(std::memory_order_acquire));
+	}
+	fan.retired.push_back(std::move(r));
+}
+
+void AsioUDPNetworkService::releaseRetired()
+{
+	auto& fan = *fanIn;
+	fan.retired.erase(std::remove_if(fan.retired.begin(), fan.retired.end(), [&] (const FanIn::Retired& r)
+	{
+		for (size_t i = 0; i < r.epochs.size() && i < fan.receivers.size(); ++i) {
+			if (fan.receivers[i]->epoch.load(std::memory_order_acquire) == r.epochs[i]) {
+				return false;
+			}
+		}
+		return true;
+	}), fan.retired.end());
+}
+
+bool AsioUDPNetworkService::flushSendBatch(size_t n)
+{
+	auto& io = *batchedIO;
+	const auto fd = socket.native_handle();
+
+	size_t done = 0;
+	bool ok = true;
+	while (done < n) {
+		const int sent = sendmmsg(fd, io.msgs.data() + done, static_cast<unsigned int>(n - done), 0);
+		if (sent < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+				// Socket is full, try the rest on the next update
+				ok = false;
+				break;
+			}
+
+			// Only the first packet failed; drop it and carry on with the rest
+			std::cout << "Error sending packet: " << strerror(errno) << std::endl;
+			io.owners[done]->setError(strerror(errno));
+			io.owners[done]->close();
+			++done;
+		} else {
+			done += size_t(sent);
+		}
+	}
+
+	// Slots were filled in queue order, so this pops exactly the packets that went out
+	for (size_t i = 0; i < done; ++i) {
+		io.owners[i]->popPendingSend();
+	}
+	return ok;
+}
+#endif
+
 void AsioUDPNetworkService::receivePacket(gsl::span<gsl::byte> received, std::string* error)
 {
 	if (error) {
@@ -167,22 +632,13 @@ void AsioUDPNetworkService::receivePacket(gsl::span<gsl::byte> received, std::st
 
 	// Read connection id
 	short id = -1;
-	std::array<unsigned char, 2> bytes;
-	auto dst = gsl::as_writeable_bytes(gsl::span<unsigned char, 2>(bytes));
-	dst[0] = received[0];
-	if (bytes[0] & 0x80) {
-		if (received.size_bytes() < 2) {
-			// Invalid header
-			std::cout << "Invalid header\n";
-			return;
-		}
-		dst[1] = received[1];
-		received = received.subspan(2);
-		id = short(bytes[0] & 0x7F) | short(bytes[1]);
-	} else {
-		received = received.subspan(1);
-		id = short(bytes[0]);
+	size_t headerSize = 0;
+	if (!readConnectionId(received, id, headerSize)) {
+		// Invalid header
+		std::cout << "Invalid header\n";
+		return;
 	}
+	received = received.subspan(headerSize);
 
 	// No connection id, check if it's a connection request
 	if (id == 0 && isValidConnectionRequest(received)) {
@@ -222,6 +678,7 @@ void AsioUDPNetworkService::receivePacket(gsl::span<gsl::byte> received, std::st
 					short newId = connection->getConnectionId();
 					if (newId != 0) {
 						activeConnections[newId] = connection;
+						publishConnection(newId, connection.get());
 						activeConnections.erase(conn);
 					}
 				}
@@ -244,10 +701,19 @@ bool AsioUDPNetworkService::isValidConnectionRequest(gsl::span<const gsl::byte>
 
 short AsioUDPNetworkService::getFreeId() const
 {
-	for (int i = 1; i < 1024; i++) {
+	for (int i = 1; i <= maxConnectionId; i++) {
 		if (activeConnections.find(i) == activeConnections.end()) {
 			return static_cast<short>(i);
 		}
 	}
 	throw Exception("Unable to find empty connection id", HalleyExceptions::NetworkPlugin);
 }
+
+void AsioUDPNetworkService::publishConnection(short id, AsioUDPConnection* connection)
+{
+#ifdef HAS_UDP_BATCHED_IO
+	if (fanIn && id > 0 && id <= maxConnectionId) {
+		fanIn->connections[id].store(connection, std::memory_order_release);
+	}
+#endif
+}
@@ -14,10 +14,15 @@ namespace asio = boost::asio;
 
 namespace Halley
 {
+	class SystemAPI;
+
 	class AsioUDPNetworkService : public NetworkService
 	{
 	public:
-		AsioUDPNetworkService(int port, IPVersion version = IPVersion::IPv4);
+		// With numReceiveSockets > 0, where HAS_UDP_BATCHED_IO, that many sockets are bound to the port with SO_REUSEPORT, so the kernel
+		// spreads remotes across them, and each is drained by a thread of its own. Packets for open connections are found by their id,
+		// in a table read without locks, and handed over in the buffer they were received into; anything else is left to update().
+		AsioUDPNetworkService(int port, IPVersion version = IPVersion::IPv4, size_t numReceiveSockets = 0, SystemAPI* system = nullptr);
 		~AsioUDPNetworkService();
 
 		void update() override;
@@ -39,11 +44,31 @@ namespace Halley
 
 		std::array<gsl::byte, 2048> receiveBuffer;
 
+#ifdef HAS_UDP_BATCHED_IO
+		struct BatchedIO;
+		std::unique_ptr<BatchedIO> batchedIO;
+
+		void receiveBatched();
+		void sendBatched();
+		bool flushSendBatch(size_t n);
+
+		struct FanIn;
+		std::unique_ptr<FanIn> fanIn;
+
+		void startFanIn();
+		void stopFanIn();
+		void runFanInReceiver(size_t idx);
+		void receiveUnrouted();
+		void retireConnection(std::shared_ptr<AsioUDPConnection> connection);
+		void releaseRetired();
+#endif
+
 		void startListening();
 		void receiveNext();
 		void receivePacket(gsl::span<gsl::byte> data, std::string* error);
 		bool isValidConnectionRequest(gsl::span<const gsl::byte> data);
 		short getFreeId() const;
+		void publishConnection(short id, AsioUDPConnection* connection);
 	};
 
 }
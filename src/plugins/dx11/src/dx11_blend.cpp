@@ -81,7 +81,9 @@ DX11Blend::~DX11Blend()
 void DX11Blend::bind(DX11Video& video)
 {
 	Expects(state);
-	video.getDeviceContext().OMSetBlendState(state, nullptr, 0xFFFFFFFF);
+	if (video.getStateCache().setBlend(state)) {
+		video.getDeviceContext().OMSetBlendState(state, nullptr, 0xFFFFFFFF);
+	}
 }
 
 DX11Blend& DX11Blend::operator=(DX11Blend&& other) noexcept
@@ -2,6 +2,7 @@
 #include "halley/utils/utils.h"
 #include "dx11_video.h"
 #include <minwinbase.h>
+#include "halley/support/memory_tracker.h"
 using namespace Halley;
 
 DX11Buffer::DX11Buffer(DX11Video& video, Type type, size_t initialSize)
@@ -22,8 +23,10 @@ DX11Buffer::DX11Buffer(DX11Buffer&& other) noexcept
 	, lastSize(other.lastSize)
 	, lastPos(other.lastPos)
 	, waitingReset(other.waitingReset)
+	, gpuBytes(other.gpuBytes)
 {
 	other.buffer = nullptr;
+	other.gpuBytes = 0;
 }
 
 DX11Buffer::~DX11Buffer()
@@ -66,7 +69,10 @@ void DX11Buffer::setData(gsl::span<const gsl::byte> data)
 		resData.SysMemPitch = 0;
 		resData.SysMemSlicePitch = 0;
 
-		video.getDevice().CreateBuffer(&bd, &resData, &buffer);
+		if (SUCCEEDED(video.getDevice().CreateBuffer(&bd, &resData, &buffer))) {
+			gpuBytes = size_t(bd.ByteWidth);
+			MemoryTracker::onAlloc(MemoryTags::GPUBuffers, gpuBytes);
+		}
 	} else {
 		if (size_t(data.size_bytes()) > curSize) {
 			resize(size_t(data.size_bytes()));
@@ -125,6 +131,8 @@ void DX11Buffer::clear()
 		buffer->Release();
 		buffer = nullptr;
 	}
+	MemoryTracker::onFree(MemoryTags::GPUBuffers, gpuBytes);
+	gpuBytes = 0;
 	curSize = 0;
 }
 
@@ -132,10 +140,7 @@ void DX11Buffer::resize(size_t requestedSize)
 {
 	size_t targetSize = std::max(size_t(256), nextPowerOf2(requestedSize));
 
-	if (buffer) {
-		buffer->Release();
-		buffer = nullptr;
-	}
+	clear();
 
 	D3D11_BUFFER_DESC bd;
 	ZeroMemory(&bd, sizeof(bd));
@@ -162,5 +167,7 @@ void DX11Buffer::resize(size_t requestedSize)
 	}
 
 	curSize = targetSize;
+	gpuBytes = targetSize;
+	MemoryTracker::onAlloc(MemoryTags::GPUBuffers, gpuBytes);
 	reset();
 }
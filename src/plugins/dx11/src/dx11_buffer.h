@@ -43,6 +43,7 @@ namespace Halley {
 		size_t lastSize = 0;
 		size_t lastPos = 0;
 		bool waitingReset = false;
+		size_t gpuBytes = 0; // As reported to MemoryTracker
 
 		void resize(size_t size);
 	};
@@ -0,0 +1,91 @@
+#include "dx11_depth_stencil.h"
+#include <gsl/gsl>
+#include "dx11_video.h"
+#include "halley/core/graphics/material/material_definition.h"
+using namespace Halley;
+
+static D3D11_COMPARISON_FUNC getComparisonFunc(DepthStencilComparisonFunction func)
+{
+	switch (func) {
+	case DepthStencilComparisonFunction::Never: return D3D11_COMPARISON_NEVER;
+	case DepthStencilComparisonFunction::Less: return D3D11_COMPARISON_LESS;
+	case DepthStencilComparisonFunction::Equal: return D3D11_COMPARISON_EQUAL;
+	case DepthStencilComparisonFunction::LessEqual: return D3D11_COMPARISON_LESS_EQUAL;
+	case DepthStencilComparisonFunction::Greater: return D3D11_COMPARISON_GREATER;
+	case DepthStencilComparisonFunction::NotEqual: return D3D11_COMPARISON_NOT_EQUAL;
+	case DepthStencilComparisonFunction::GreaterEqual: return D3D11_COMPARISON_GREATER_EQUAL;
+	case DepthStencilComparisonFunction::Always: return D3D11_COMPARISON_ALWAYS;
+	}
+	return D3D11_COMPARISON_ALWAYS;
+}
+
+static D3D11_STENCIL_OP getStencilOp(StencilWriteOperation op)
+{
+	switch (op) {
+	case StencilWriteOperation::Keep: return D3D11_STENCIL_OP_KEEP;
+	case StencilWriteOperation::Zero: return D3D11_STENCIL_OP_ZERO;
+	case StencilWriteOperation::Replace: return D3D11_STENCIL_OP_REPLACE;
+	case StencilWriteOperation::IncrementClamp: return D3D11_STENCIL_OP_INCR_SAT;
+	case StencilWriteOperation::DecrementClamp: return D3D11_STENCIL_OP_DECR_SAT;
+	case StencilWriteOperation::Invert: return D3D11_STENCIL_OP_INVERT;
+	case StencilWriteOperation::IncrementWrap: return D3D11_STENCIL_OP_INCR;
+	case StencilWriteOperation::DecrementWrap: return D3D11_STENCIL_OP_DECR;
+	}
+	return D3D11_STENCIL_OP_KEEP;
+}
+
+DX11DepthStencil::DX11DepthStencil(DX11Video& video, const MaterialDepthStencil& definition)
+{
+	D3D11_DEPTH_STENCIL_DESC desc;
+
+	// D3D only writes depth if the test is enabled, so "always" is used to write without testing
+	desc.DepthEnable = definition.isDepthTestEnabled() || definition.isDepthWriteEnabled();
+	desc.DepthWriteMask = definition.isDepthWriteEnabled() ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+	desc.DepthFunc = definition.isDepthTestEnabled() ? getComparisonFunc(definition.getDepthComparisonFunction()) : D3D11_COMPARISON_ALWAYS;
+
+	desc.StencilEnable = definition.isStencilTestEnabled();
+	desc.StencilReadMask = UINT8(definition.getStencilReadMask());
+	desc.StencilWriteMask = UINT8(definition.getStencilWriteMask());
+	desc.FrontFace.StencilFunc = getComparisonFunc(definition.getStencilComparisonFunction());
+	desc.FrontFace.StencilPassOp = getStencilOp(definition.getStencilOpPass());
+	desc.FrontFace.StencilDepthFailOp = getStencilOp(definition.getStencilOpDepthFail());
+	desc.FrontFace.StencilFailOp = getStencilOp(definition.getStencilOpStencilFail());
+	desc.BackFace = desc.FrontFace;
+	stencilReference = UINT(definition.getStencilReference());
+
+	auto result = video.getDevice().CreateDepthStencilState(&desc, &state);
+	if (result != S_OK) {
+		throw Exception("Unable to create depth stencil state", HalleyExceptions::VideoPlugin);
+	}
+}
+
+DX11DepthStencil::DX11DepthStencil(DX11DepthStencil&& other) noexcept
+	: state(other.state)
+	, stencilReference(other.stencilReference)
+{
+	other.state = nullptr;
+}
+
+DX11DepthStencil::~DX11DepthStencil()
+{
+	if (state) {
+		state->Release();
+		state = nullptr;
+	}
+}
+
+void DX11DepthStencil::bind(DX11Video& video)
+{
+	Expects(state);
+	if (video.getStateCache().setDepthStencil(state, stencilReference)) {
+		video.getDeviceContext().OMSetDepthStencilState(state, stencilReference);
+	}
+}
+
+DX11DepthStencil& DX11DepthStencil::operator=(DX11DepthStencil&& other) noexcept
+{
+	state = other.state;
+	stencilReference = other.stencilReference;
+	other.state = nullptr;
+	return *this;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <d3d11.h>
+#undef min
+#undef max
+
+namespace Halley
+{
+	class MaterialDepthStencil;
+	class DX11Video;
+
+	class DX11DepthStencil
+	{
+	public:
+		DX11DepthStencil(DX11Video& video, const MaterialDepthStencil& definition);
+		DX11DepthStencil(DX11DepthStencil&& other) noexcept;
+		~DX11DepthStencil();
+
+		void bind(DX11Video& video);
+		DX11DepthStencil& operator=(DX11DepthStencil&& other) noexcept;
+
+	private:
+		ID3D11DepthStencilState* state = nullptr;
+		UINT stencilReference = 0;
+	};
+}
@@ -1,8 +1,16 @@
 #include "dx11_material_constant_buffer.h"
+#include <atomic>
 using namespace Halley;
 
+static uint64_t makeBindStamp()
+{
+	static std::atomic<uint64_t> next(1);
+	return next++;
+}
+
 DX11MaterialConstantBuffer::DX11MaterialConstantBuffer(DX11Video& video)
 	: buffer(video, DX11Buffer::Type::Constant)
+	, bindStamp(makeBindStamp())
 {
 }
 
@@ -10,9 +18,15 @@ void DX11MaterialConstantBuffer::update(const MaterialDataBlock& dataBlock)
 {
 	buffer.reset();
 	buffer.setData(dataBlock.getData());
+	bindStamp = makeBindStamp();
 }
 
 DX11Buffer& DX11MaterialConstantBuffer::getBuffer()
 {
 	return buffer;
 }
+
+uint64_t DX11MaterialConstantBuffer::getBindStamp() const
+{
+	return bindStamp;
+}
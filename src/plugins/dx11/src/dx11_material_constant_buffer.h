@@ -12,7 +12,11 @@ namespace Halley
 		void update(const MaterialDataBlock& dataBlock) override;
 		DX11Buffer& getBuffer();
 
+		// Unique to this buffer and its current contents, so painters can skip binding it again
+		uint64_t getBindStamp() const;
+
 	private:
 		DX11Buffer buffer;
+		uint64_t bindStamp;
 	};
 }
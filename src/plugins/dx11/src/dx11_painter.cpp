@@ -11,12 +11,20 @@
 #include "halley/core/graphics/render_target/render_target.h"
 #include "dx11_render_target.h"
 #include "halley/core/game/game_platform.h"
+#include <array>
 using namespace Halley;
 
-DX11Painter::DX11Painter(DX11Video& video, Resources& resources)
+constexpr static size_t vertexBufferSize = 8 * 1024 * 1024;
+
+DX11Painter::DX11Painter(DX11Video& video, Resources& resources, bool deferred)
 	: Painter(resources)
 	, video(video)
 {
+	if (deferred) {
+		deferredContext = video.createDeferredContext();
+		deferredStateCache = std::make_unique<DX11StateCache>();
+	}
+
 #ifdef WINDOWS_STORE
 	// Due to the architecture of "some" platforms available here, updating a dynamic buffer is extremely slow if it's still in use
 	constexpr size_t numBuffers = 2;
@@ -24,29 +32,80 @@ DX11Painter::DX11Painter(DX11Video& video, Resources& resources)
 	constexpr size_t numBuffers = 1;
 #endif
 	for (size_t i = 0; i < numBuffers; ++i) {
-		vertexBuffers.emplace_back(video, DX11Buffer::Type::Vertex, 8 * 1024 * 1024);
-		indexBuffers.emplace_back(video, DX11Buffer::Type::Index, 128 * 1024);
+		vertexBuffers.emplace_back(video, DX11Buffer::Type::Vertex, vertexBufferSize);
+		indexBuffers.emplace_back(video, DX11Buffer::Type::Index, 256 * 1024);
+	}
+}
+
+DX11Painter::~DX11Painter()
+{
+	for (size_t i = 0; i < gpuTimerFrames; ++i) {
+		for (auto* query: timestampQueries[i]) {
+			query->Release();
+		}
+		if (disjointQueries[i]) {
+			disjointQueries[i]->Release();
+		}
+	}
+
+	if (deferredContext) {
+		deferredContext->Release();
+		deferredContext = nullptr;
 	}
 }
 
 void DX11Painter::doStartRender()
 {
+	if (deferredContext) {
+		video.bindDeferredContext(deferredContext, deferredStateCache.get());
+
+		// Deferred contexts can only map with NO_OVERWRITE after a DISCARD in the same command list
+		for (size_t i = 0; i < vertexBuffers.size(); ++i) {
+			vertexBuffers[i].reset();
+			indexBuffers[i].reset();
+		}
+		curBuffer = 0;
+	}
+
+	// Something else (e.g. video playback) might have used the context since the last frame
+	video.getStateCache().reset();
+
 	if (!normalRaster) {
 		normalRaster = std::make_unique<DX11Rasterizer>(video, false);
 		scissorRaster = std::make_unique<DX11Rasterizer>(video, true);
 	}
 	normalRaster->bind(video);
+	boundBlocks.clear();
 }
 
 void DX11Painter::doEndRender()
 {
+	logElidedStateChanges(video.getStateCache().takeElidedCalls());
+
+	if (deferredContext) {
+		ID3D11CommandList* commandList = nullptr;
+		auto result = deferredContext->FinishCommandList(FALSE, &commandList);
+		video.bindDeferredContext(nullptr, nullptr);
+		if (result != S_OK) {
+			throw Exception("Unable to finish recording command list", HalleyExceptions::VideoPlugin);
+		}
+		video.queueCommandList(*this, commandList);
+	}
 }
 
-void DX11Painter::clear(Colour colour)
+void DX11Painter::doClear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil)
 {
-	const float col[] = { colour.r, colour.g, colour.b, colour.a };
-	auto view = dynamic_cast<IDX11RenderTarget&>(getActiveRenderTarget()).getRenderTargetView();
-	video.getDeviceContext().ClearRenderTargetView(view, col);
+	auto& target = dynamic_cast<IDX11RenderTarget&>(getActiveRenderTarget());
+	if (colour) {
+		const float col[] = { colour->r, colour->g, colour->b, colour->a };
+		video.getDeviceContext().ClearRenderTargetView(target.getRenderTargetView(), col);
+	}
+
+	auto depthStencilView = target.getDepthStencilView();
+	if (depthStencilView && (depth || stencil)) {
+		const UINT flags = (depth ? D3D11_CLEAR_DEPTH : 0) | (stencil ? D3D11_CLEAR_STENCIL : 0);
+		video.getDeviceContext().ClearDepthStencilView(depthStencilView, flags, depth ? depth.get() : 1.0f, stencil ? stencil.get() : 0);
+	}
 }
 
 void DX11Painter::setMaterialPass(const Material& material, int passN)
@@ -54,21 +113,24 @@ void DX11Painter::setMaterialPass(const Material& material, int passN)
 	auto& pass = material.getDefinition().getPass(passN);
 
 	// Shader
-	auto& shader = static_cast<DX11Shader&>(pass.getShader());
-	shader.setMaterialLayout(video, material.getDefinition().getAttributes());
+	auto& shader = static_cast<DX11Shader&>(pass.getShader(material.getVariant()));
+	shader.setMaterialLayout(video, material.getDefinition().getAttributes(), instancedDraw);
 	shader.bind(video);
 
 	// Blend
 	getBlendMode(pass.getBlend()).bind(video);
 
+	// Depth/stencil
+	getDepthStencil(pass.getDepthStencil()).bind(video);
+
 	// Texture
 	int textureUnit = 0;
 	for (auto& tex: material.getTextureUniforms()) {
-		auto texture = std::static_pointer_cast<const DX11Texture>(material.getTexture(textureUnit));
+		auto& texture = material.getTexture(textureUnit);
 		if (!texture) {
 			throw Exception("Error binding texture to texture unit #" + toString(textureUnit) + " with material \"" + material.getDefinition().getName() + "\": texture is null.", HalleyExceptions::VideoPlugin);
 		} else {
-			texture->bind(video, textureUnit);
+			static_cast<const DX11Texture&>(texture->getBindable()).bind(video, textureUnit);
 		}
 		++textureUnit;
 	}
@@ -79,7 +141,17 @@ void DX11Painter::setMaterialData(const Material& material)
 	auto& devCon = video.getDeviceContext();
 	for (auto& block: material.getDataBlocks()) {
 		if (block.getType() != MaterialDataBlockType::SharedExternal) {
-			auto& buffer = static_cast<DX11MaterialConstantBuffer&>(block.getConstantBuffer()).getBuffer();
+			auto& constantBuffer = static_cast<DX11MaterialConstantBuffer&>(block.getConstantBuffer());
+			const size_t bindPoint = size_t(block.getBindPoint());
+			if (boundBlocks.size() <= bindPoint) {
+				boundBlocks.resize(bindPoint + 1, 0);
+			}
+			if (boundBlocks[bindPoint] == constantBuffer.getBindStamp()) {
+				continue;
+			}
+			boundBlocks[bindPoint] = constantBuffer.getBindStamp();
+
+			auto& buffer = constantBuffer.getBuffer();
 			auto dxBuffer = buffer.getBuffer();
 			if (Halley::getPlatform() == GamePlatform::UWP || Halley::getPlatform() == GamePlatform::XboxOne) {
 				UINT firstConstant[] = { buffer.getOffset() / 16 };
@@ -94,14 +166,15 @@ void DX11Painter::setMaterialData(const Material& material)
 	}
 }
 
-void DX11Painter::setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, unsigned short* indices, bool standardQuadsOnly)
+void DX11Painter::setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly)
 {
 	const size_t stride = material.getVertexStride();
 	const size_t vertexDataSize = stride * numVertices;
 
-	if (!vertexBuffers[curBuffer].canFit(vertexDataSize) || !indexBuffers[curBuffer].canFit(numIndices * sizeof(unsigned short))) {
+	if (!vertexBuffers[curBuffer].canFit(vertexDataSize) || !indexBuffers[curBuffer].canFit(numIndices * sizeof(IndexType))) {
 		rotateBuffers();
 	}
+	instancedDraw = false;
 
 	{
 		auto& vb = vertexBuffers[curBuffer];
@@ -114,8 +187,8 @@ void DX11Painter::setVertices(const MaterialDefinition& material, size_t numVert
 
 	{
 		auto& ib = indexBuffers[curBuffer];
-		ib.setData(gsl::as_bytes(gsl::span<unsigned short>(indices, numIndices)));
-		video.getDeviceContext().IASetIndexBuffer(ib.getBuffer(), DXGI_FORMAT_R16_UINT, ib.getOffset());
+		ib.setData(gsl::as_bytes(gsl::span<IndexType>(indices, numIndices)));
+		video.getDeviceContext().IASetIndexBuffer(ib.getBuffer(), DXGI_FORMAT_R32_UINT, ib.getOffset());
 	}
 }
 
@@ -126,6 +199,136 @@ void DX11Painter::drawTriangles(size_t numIndices)
 	devCon.DrawIndexed(UINT(numIndices), 0, 0);
 }
 
+bool DX11Painter::supports32BitIndices() const
+{
+	return true;
+}
+
+size_t DX11Painter::getMaxBatchBytes() const
+{
+	return vertexBufferSize;
+}
+
+bool DX11Painter::supportsInstancing() const
+{
+	return true;
+}
+
+bool DX11Painter::supportsGPUTimers() const
+{
+	// Results can only be read on the immediate context, and deferred ones can't have disjoint queries
+	return !deferredContext;
+}
+
+void DX11Painter::beginGPUTimerFrame(size_t frame)
+{
+	auto& disjoint = disjointQueries.at(frame);
+	if (!disjoint) {
+		disjoint = createQuery(D3D11_QUERY_TIMESTAMP_DISJOINT);
+	}
+	video.getDeviceContext().Begin(disjoint);
+}
+
+void DX11Painter::writeGPUTimestamp(size_t frame, size_t idx)
+{
+	auto& queries = timestampQueries.at(frame);
+	while (idx >= queries.size()) {
+		queries.push_back(createQuery(D3D11_QUERY_TIMESTAMP));
+	}
+	video.getDeviceContext().End(queries[idx]);
+}
+
+void DX11Painter::endGPUTimerFrame(size_t frame)
+{
+	video.getDeviceContext().End(disjointQueries.at(frame));
+}
+
+bool DX11Painter::readGPUTimestamps(size_t frame, size_t count, Vector<int64_t>& dst)
+{
+	auto& context = video.getImmediateContext();
+	auto* disjoint = disjointQueries.at(frame);
+	auto& queries = timestampQueries.at(frame);
+	if (!disjoint || count > queries.size()) {
+		return true;
+	}
+
+	// Only waits for the GPU to get to the end of the frame, never flushes it
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjointData;
+	if (context.GetData(disjoint, &disjointData, sizeof(disjointData), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) {
+		return false;
+	}
+	if (disjointData.Disjoint || disjointData.Frequency == 0) {
+		return true; // The clock changed partway through (e.g. the GPU throttled), so none of these mean anything
+	}
+
+	dst.resize(count);
+	const UINT64 frequency = disjointData.Frequency;
+	for (size_t i = 0; i < count; ++i) {
+		UINT64 ticks = 0;
+		if (context.GetData(queries[i], &ticks, sizeof(ticks), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) {
+			dst.clear();
+			return false;
+		}
+		dst[i] = int64_t(ticks / frequency * 1'000'000'000ull + ticks % frequency * 1'000'000'000ull / frequency);
+	}
+	return true;
+}
+
+ID3D11Query* DX11Painter::createQuery(D3D11_QUERY type)
+{
+	D3D11_QUERY_DESC desc;
+	desc.Query = type;
+	desc.MiscFlags = 0;
+
+	ID3D11Query* query = nullptr;
+	if (FAILED(video.getDevice().CreateQuery(&desc, &query))) {
+		throw Exception("Unable to create GPU timer query", HalleyExceptions::VideoPlugin);
+	}
+	return query;
+}
+
+void DX11Painter::setInstances(const MaterialDefinition& material, size_t numInstances, void* instanceData)
+{
+	const size_t stride = material.getVertexStride();
+	const size_t instanceDataSize = stride * numInstances;
+
+	if (!vertexBuffers[curBuffer].canFit(instanceDataSize)) {
+		rotateBuffers();
+	}
+	instancedDraw = true;
+
+	// These are only written once, so they're never reset
+	if (!quadVertexBuffer) {
+		// a_vertPos, see Painter::drawSprites
+		const std::array<Vector4f, 4> quad = {{ Vector4f(0, 0, 0, 0), Vector4f(1, 0, 1, 0), Vector4f(1, 1, 1, 1), Vector4f(0, 1, 0, 1) }};
+		quadVertexBuffer = std::make_unique<DX11Buffer>(video, DX11Buffer::Type::Vertex);
+		quadVertexBuffer->setData(gsl::as_bytes(gsl::span<const Vector4f>(quad)));
+
+		std::array<IndexType, 6> indices;
+		generateQuadIndices(0, 1, indices.data());
+		quadIndexBuffer = std::make_unique<DX11Buffer>(video, DX11Buffer::Type::Index);
+		quadIndexBuffer->setData(gsl::as_bytes(gsl::span<IndexType>(indices)));
+	}
+
+	{
+		auto& vb = vertexBuffers[curBuffer];
+		vb.setData(gsl::span<const gsl::byte>(reinterpret_cast<const gsl::byte*>(instanceData), instanceDataSize));
+		ID3D11Buffer* buffers[] = { quadVertexBuffer->getBuffer(), vb.getBuffer() };
+		UINT strides[] = { UINT(sizeof(Vector4f)), UINT(stride) };
+		UINT offsets[] = { quadVertexBuffer->getOffset(), vb.getOffset() };
+		video.getDeviceContext().IASetVertexBuffers(0, 2, buffers, strides, offsets);
+	}
+
+	video.getDeviceContext().IASetIndexBuffer(quadIndexBuffer->getBuffer(), DXGI_FORMAT_R32_UINT, quadIndexBuffer->getOffset());
+}
+
+void DX11Painter::drawInstancedQuads(size_t numInstances)
+{
+	auto& devCon = video.getDeviceContext();
+	devCon.IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	devCon.DrawIndexedInstanced(6, UINT(numInstances), 0, 0, 0);
+}
+
 void DX11Painter::setViewPort(Rect4i rect)
 {
 	auto fRect = Rect4f(rect);
@@ -173,6 +376,19 @@ DX11Blend& DX11Painter::getBlendMode(BlendType type)
 	return getBlendMode(type);
 }
 
+DX11DepthStencil& DX11Painter::getDepthStencil(const MaterialDepthStencil& depthStencil)
+{
+	// Materials only ever use a handful of these, so a linear search is fine
+	for (auto& ds: depthStencils) {
+		if (ds.first == depthStencil) {
+			return ds.second;
+		}
+	}
+
+	depthStencils.emplace_back(depthStencil, DX11DepthStencil(video, depthStencil));
+	return depthStencils.back().second;
+}
+
 void DX11Painter::rotateBuffers()
 {
 	Expects (vertexBuffers.size() == indexBuffers.size());
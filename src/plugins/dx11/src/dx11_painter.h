@@ -1,6 +1,9 @@
 #pragma once
 #include "halley/core/graphics/painter.h"
 #include "dx11_buffer.h"
+#include "dx11_state_cache.h"
+#include "dx11_depth_stencil.h"
+#include "halley/core/graphics/material/material_definition.h"
 #include <map>
 
 namespace Halley
@@ -12,35 +15,64 @@ namespace Halley
 	class DX11Painter : public Painter
 	{
 	public:
-		explicit DX11Painter(DX11Video& video, Resources& resources);
+		// A deferred painter records each frame on its own deferred context, so it can be used from any one thread at a time
+		DX11Painter(DX11Video& video, Resources& resources, bool deferred = false);
+		~DX11Painter();
 		
-		void clear(Colour colour) override;
 		void setMaterialPass(const Material& material, int pass) override;
 		void setMaterialData(const Material& material) override;
 
 		void doStartRender() override;
 		void doEndRender() override;
+		void doClear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil) override;
 
-		void setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, unsigned short* indices, bool standardQuadsOnly) override;
+		void setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly) override;
 		void drawTriangles(size_t numIndices) override;
+		bool supports32BitIndices() const override;
+		size_t getMaxBatchBytes() const override;
+
+		bool supportsInstancing() const override;
+		void setInstances(const MaterialDefinition& material, size_t numInstances, void* instanceData) override;
+		void drawInstancedQuads(size_t numInstances) override;
+
 		void setViewPort(Rect4i rect) override;
 		void setClip(Rect4i clip, bool enable) override;
 
 		void onUpdateProjection(Material& material) override;
 
+		bool supportsGPUTimers() const override;
+		void beginGPUTimerFrame(size_t frame) override;
+		void writeGPUTimestamp(size_t frame, size_t idx) override;
+		void endGPUTimerFrame(size_t frame) override;
+		bool readGPUTimestamps(size_t frame, size_t count, Vector<int64_t>& dst) override;
+
 	private:
 		DX11Video& video;
+		ID3D11DeviceContext1* deferredContext = nullptr;
+		std::unique_ptr<DX11StateCache> deferredStateCache;
 
 		std::vector<DX11Buffer> vertexBuffers;
 		std::vector<DX11Buffer> indexBuffers;
+		std::unique_ptr<DX11Buffer> quadVertexBuffer;
+		std::unique_ptr<DX11Buffer> quadIndexBuffer;
 		ID3D11InputLayout* layout;
 		std::map<BlendType, DX11Blend> blendModes;
+		std::vector<std::pair<MaterialDepthStencil, DX11DepthStencil>> depthStencils;
 		std::unique_ptr<DX11Rasterizer> normalRaster;
 		std::unique_ptr<DX11Rasterizer> scissorRaster;
 
 		size_t curBuffer = 0;
+		bool instancedDraw = false;
+		std::vector<uint64_t> boundBlocks; // Bind stamp of the constant buffer at each bind point
+
+		// Timestamps are only meaningful within a disjoint query, which also gives their frequency
+		std::array<std::vector<ID3D11Query*>, gpuTimerFrames> timestampQueries;
+		std::array<ID3D11Query*, gpuTimerFrames> disjointQueries = {};
+
+		ID3D11Query* createQuery(D3D11_QUERY type);
 
 		DX11Blend& getBlendMode(BlendType type);
+		DX11DepthStencil& getDepthStencil(const MaterialDepthStencil& depthStencil);
 		void rotateBuffers();
 	};
 }
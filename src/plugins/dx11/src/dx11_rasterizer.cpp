@@ -34,5 +34,7 @@ DX11Rasterizer::~DX11Rasterizer()
 
 void DX11Rasterizer::bind(DX11Video& video)
 {
-	video.getDeviceContext().RSSetState(rasterizer);
+	if (video.getStateCache().setRasterizer(rasterizer)) {
+		video.getDeviceContext().RSSetState(rasterizer);
+	}
 }
@@ -10,6 +10,11 @@ DX11Shader::DX11Shader(DX11Video& video, const ShaderDefinition& definition)
 	for (auto& shader: definition.shaders) {
 		loadShader(video, shader.first, shader.second);
 	}
+
+	// The bytecode is compiled at import, so the layout is the remaining cost; make it now rather than on the first draw
+	if (vertexShader && !definition.vertexAttributes.empty()) {
+		layout = makeLayout(video, definition.vertexAttributes, false);
+	}
 }
 
 DX11Shader::~DX11Shader()
@@ -30,6 +35,10 @@ DX11Shader::~DX11Shader()
 		layout->Release();
 		layout = nullptr;
 	}
+	if (instancedLayout) {
+		instancedLayout->Release();
+		instancedLayout = nullptr;
+	}
 }
 
 void DX11Shader::loadShader(DX11Video& video, ShaderType type, const Bytes& bytes)
@@ -72,14 +81,19 @@ int DX11Shader::getBlockLocation(const String& name, ShaderType stage)
 void DX11Shader::bind(DX11Video& video)
 {
 	Expects(vertexShader);
-	Expects(layout);
+	Expects(activeLayout);
 
 	auto& devCon = video.getDeviceContext();
-	devCon.VSSetShader(vertexShader, nullptr, 0);
-	devCon.GSSetShader(geometryShader, nullptr, 0);
-	devCon.PSSetShader(pixelShader, nullptr, 0);
+	auto& cache = video.getStateCache();
+	if (cache.setShaders(vertexShader, geometryShader, pixelShader)) {
+		devCon.VSSetShader(vertexShader, nullptr, 0);
+		devCon.GSSetShader(geometryShader, nullptr, 0);
+		devCon.PSSetShader(pixelShader, nullptr, 0);
+	}
 
-	devCon.IASetInputLayout(layout);
+	if (cache.setInputLayout(activeLayout)) {
+		devCon.IASetInputLayout(activeLayout);
+	}
 }
 
 static DXGI_FORMAT getDX11Format(ShaderParameterType type)
@@ -106,12 +120,17 @@ static DXGI_FORMAT getDX11Format(ShaderParameterType type)
 	}
 }
 
-void DX11Shader::setMaterialLayout(DX11Video& video, const std::vector<MaterialAttribute>& attributes)
+void DX11Shader::setMaterialLayout(DX11Video& video, const std::vector<MaterialAttribute>& attributes, bool instanced)
 {
-	if (layout) {
-		return;
+	auto& target = instanced ? instancedLayout : layout;
+	if (!target) {
+		target = makeLayout(video, attributes, instanced);
 	}
+	activeLayout = target;
+}
 
+ID3D11InputLayout* DX11Shader::makeLayout(DX11Video& video, const std::vector<MaterialAttribute>& attributes, bool instanced)
+{
 	Expects(!vertexBlob.empty());
 
 	std::vector<std::array<char, 64>> names(attributes.size());
@@ -119,11 +138,12 @@ void DX11Shader::setMaterialLayout(DX11Video& video, const std::vector<MaterialA
 
 	for (size_t i = 0; i < desc.size(); ++i) {
 		auto& a = attributes[i];
-		
+		const bool perInstance = instanced && a.instanced;
+
 		UINT semanticIndex = 0;
-		UINT inputSlot = 0;
+		UINT inputSlot = perInstance ? 1 : 0;
 		DXGI_FORMAT format = getDX11Format(a.type);
-		UINT byteOffset = a.offset;
+		UINT byteOffset = instanced && !perInstance ? 0 : a.offset;
 
 		String name = a.name.asciiUpper();
 		if (name.startsWith("A_")) {
@@ -135,12 +155,17 @@ void DX11Shader::setMaterialLayout(DX11Video& video, const std::vector<MaterialA
 		}
 		strcpy_s(names[i].data(), 64, name.c_str());
 
-		desc[i] = { names[i].data(), semanticIndex, format, inputSlot, byteOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+		if (perInstance) {
+			desc[i] = { names[i].data(), semanticIndex, format, inputSlot, byteOffset, D3D11_INPUT_PER_INSTANCE_DATA, 1 };
+		} else {
+			desc[i] = { names[i].data(), semanticIndex, format, inputSlot, byteOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 };
+		}
 	}
 
-	HRESULT result = video.getDevice().CreateInputLayout(desc.data(), UINT(desc.size()), vertexBlob.data(), vertexBlob.size(), &layout);
-	if (result != S_OK) {
+	ID3D11InputLayout* result = nullptr;
+	HRESULT hr = video.getDevice().CreateInputLayout(desc.data(), UINT(desc.size()), vertexBlob.data(), vertexBlob.size(), &result);
+	if (hr != S_OK) {
 		throw Exception("Unable to create input layout for shader " + name, HalleyExceptions::VideoPlugin);
 	}
-	vertexBlob.clear();
+	return result;
 }
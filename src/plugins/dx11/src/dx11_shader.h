@@ -19,7 +19,8 @@ namespace Halley
 		int getBlockLocation(const String& name, ShaderType stage) override;
 
 		void bind(DX11Video& video);
-		void setMaterialLayout(DX11Video& video, const std::vector<MaterialAttribute>& attributes);
+		// Instanced layouts read a_vertPos per vertex from slot 0, and everything else per instance from slot 1
+		void setMaterialLayout(DX11Video& video, const std::vector<MaterialAttribute>& attributes, bool instanced);
 
 	private:
 		String name;
@@ -27,8 +28,11 @@ namespace Halley
 		ID3D11PixelShader* pixelShader = nullptr;
 		ID3D11GeometryShader* geometryShader = nullptr;
 		ID3D11InputLayout* layout = nullptr;
+		ID3D11InputLayout* instancedLayout = nullptr;
+		ID3D11InputLayout* activeLayout = nullptr;
 		Bytes vertexBlob;
 
 		void loadShader(DX11Video& video, ShaderType type, const Bytes& bytes);
+		ID3D11InputLayout* makeLayout(DX11Video& video, const std::vector<MaterialAttribute>& attributes, bool instanced);
 	};
 }
@@ -0,0 +1,102 @@
+#include "dx11_state_cache.h"
+using namespace Halley;
+
+DX11StateCache::DX11StateCache()
+{
+	reset();
+}
+
+bool DX11StateCache::setShaders(ID3D11VertexShader* vs, ID3D11GeometryShader* gs, ID3D11PixelShader* ps)
+{
+	if (vertexShader == vs && geometryShader == gs && pixelShader == ps) {
+		++elidedCalls;
+		return false;
+	}
+	vertexShader = vs;
+	geometryShader = gs;
+	pixelShader = ps;
+	return true;
+}
+
+bool DX11StateCache::setInputLayout(ID3D11InputLayout* value)
+{
+	if (layout == value) {
+		++elidedCalls;
+		return false;
+	}
+	layout = value;
+	return true;
+}
+
+bool DX11StateCache::setBlend(ID3D11BlendState* value)
+{
+	if (blend == value) {
+		++elidedCalls;
+		return false;
+	}
+	blend = value;
+	return true;
+}
+
+bool DX11StateCache::setDepthStencil(ID3D11DepthStencilState* value, UINT reference)
+{
+	if (depthStencil == value && stencilReference == reference) {
+		++elidedCalls;
+		return false;
+	}
+	depthStencil = value;
+	stencilReference = reference;
+	return true;
+}
+
+bool DX11StateCache::setRasterizer(ID3D11RasterizerState* value)
+{
+	if (rasterizer == value) {
+		++elidedCalls;
+		return false;
+	}
+	rasterizer = value;
+	return true;
+}
+
+bool DX11StateCache::setTexture(int textureUnit, ID3D11ShaderResourceView* srv, ID3D11SamplerState* sampler)
+{
+	if (textureUnit < 0 || size_t(textureUnit) >= maxTextureUnits) {
+		return true;
+	}
+
+	auto& curTexture = textures[textureUnit];
+	auto& curSampler = samplers[textureUnit];
+	if (curTexture == srv && curSampler == sampler) {
+		++elidedCalls;
+		return false;
+	}
+	curTexture = srv;
+	curSampler = sampler;
+	return true;
+}
+
+void DX11StateCache::reset()
+{
+	vertexShader = nullptr;
+	geometryShader = nullptr;
+	pixelShader = nullptr;
+	layout = nullptr;
+	blend = nullptr;
+	depthStencil = nullptr;
+	rasterizer = nullptr;
+	invalidateTextures();
+}
+
+void DX11StateCache::invalidateTextures()
+{
+	textures.fill(nullptr);
+	samplers.fill(nullptr);
+}
+
+size_t DX11StateCache::takeElidedCalls()
+{
+	const size_t n = elidedCalls;
+	elidedCalls = 0;
+	return n;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <d3d11.h>
+#undef min
+#undef max
+
+namespace Halley
+{
+	// What's currently bound to the device context, so that redundant calls can be skipped.
+	// Pointers are safe to compare, as the context holds a reference to everything bound to it; nullptr means unknown.
+	class DX11StateCache
+	{
+	public:
+		constexpr static size_t maxTextureUnits = 16;
+
+		DX11StateCache();
+
+		// Each of these returns whether the state changed, in which case the caller should make the call
+		bool setShaders(ID3D11VertexShader* vertexShader, ID3D11GeometryShader* geometryShader, ID3D11PixelShader* pixelShader);
+		bool setInputLayout(ID3D11InputLayout* layout);
+		bool setBlend(ID3D11BlendState* blend);
+		bool setDepthStencil(ID3D11DepthStencilState* depthStencil, UINT stencilReference);
+		bool setRasterizer(ID3D11RasterizerState* rasterizer);
+		bool setTexture(int textureUnit, ID3D11ShaderResourceView* srv, ID3D11SamplerState* sampler);
+
+		// Forgets everything, for when something else might have used the context
+		void reset();
+
+		// Binding render targets unbinds their textures from shader inputs
+		void invalidateTextures();
+
+		// Number of calls skipped since the last call
+		size_t takeElidedCalls();
+
+	private:
+		ID3D11VertexShader* vertexShader = nullptr;
+		ID3D11GeometryShader* geometryShader = nullptr;
+		ID3D11PixelShader* pixelShader = nullptr;
+		ID3D11InputLayout* layout = nullptr;
+		ID3D11BlendState* blend = nullptr;
+		ID3D11DepthStencilState* depthStencil = nullptr;
+		UINT stencilReference = 0;
+		ID3D11RasterizerState* rasterizer = nullptr;
+		std::array<ID3D11ShaderResourceView*, maxTextureUnits> textures;
+		std::array<ID3D11SamplerState*, maxTextureUnits> samplers;
+		size_t elidedCalls = 0;
+	};
+}
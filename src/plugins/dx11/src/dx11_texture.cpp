@@ -1,6 +1,7 @@
 #include "dx11_texture.h"
 #include "dx11_video.h"
 #include "halley/core/graphics/texture_descriptor.h"
+#include "halley/support/memory_tracker.h"
 using namespace Halley;
 
 DX11Texture::DX11Texture(DX11Video& video, Vector2i size)
@@ -24,21 +25,21 @@ DX11Texture::~DX11Texture()
 		texture->Release();
 		texture = nullptr;
 	}
+	MemoryTracker::onFree(MemoryTags::GPUTextures, gpuBytes);
 }
 
 DX11Texture& DX11Texture::operator=(DX11Texture&& other) noexcept
 {
 	other.waitForLoad();
 
-	texture = other.texture;
-	srv = other.srv;
-	samplerState = other.samplerState;
+	// Swap, so that the other one releases the previous resources
+	std::swap(texture, other.texture);
+	std::swap(srv, other.srv);
+	std::swap(samplerState, other.samplerState);
+	std::swap(gpuBytes, other.gpuBytes);
 	format = other.format;
 	size = other.size;
-
-	other.texture = nullptr;
-	other.srv = nullptr;
-	other.samplerState = nullptr;
+	layers = other.layers;
 
 	doneLoading();
 
@@ -49,10 +50,16 @@ void DX11Texture::load(TextureDescriptor&& descriptor)
 {
 	int bpp = 0;
 
+	// Smaller than the texture's size if mip streaming left out the finer levels
+	const auto texSize = descriptor.size;
+	Expects(descriptor.layers >= 1);
+	layers = descriptor.layers;
+
 	CD3D11_TEXTURE2D_DESC desc;
-	desc.Width = size.x;
-	desc.Height = size.y;
-	desc.MipLevels = desc.ArraySize = 1;
+	desc.Width = texSize.x;
+	desc.Height = texSize.y;
+	desc.MipLevels = 1;
+	desc.ArraySize = UINT(layers);
 	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 
 	switch (descriptor.format) {
@@ -68,9 +75,16 @@ void DX11Texture::load(TextureDescriptor&& descriptor)
 		bpp = 4;
 		break;
 	case TextureFormat::DEPTH:
-		desc.Format = DXGI_FORMAT_D32_FLOAT;
+		// Typeless, so it can be both a depth-stencil view and a shader resource view (of just the depth)
+		desc.Format = DXGI_FORMAT_R24G8_TYPELESS;
 		bpp = 4;
 		break;
+	case TextureFormat::BC1:
+		desc.Format = DXGI_FORMAT_BC1_UNORM;
+		break;
+	case TextureFormat::BC3:
+		desc.Format = DXGI_FORMAT_BC3_UNORM;
+		break;
 	default:
 		throw Exception("Unknown texture format", HalleyExceptions::VideoPlugin);
 	}
@@ -87,8 +101,44 @@ void DX11Texture::load(TextureDescriptor&& descriptor)
 
 	D3D11_SUBRESOURCE_DATA* res = nullptr;
 	D3D11_SUBRESOURCE_DATA subResData;
+	std::vector<D3D11_SUBRESOURCE_DATA> levels;
+
+	const bool compressed = TextureDescriptor::isCompressed(descriptor.format);
+	const size_t layerBytes = size_t(descriptor.pixelData.getSpan().size()) / size_t(layers);
+	const bool hasMipChain = descriptor.useMipMap && !descriptor.pixelData.empty() && layerBytes > TextureDescriptor::getLevelByteSize(texSize, descriptor.format);
+	if (compressed || hasMipChain || (layers > 1 && !descriptor.pixelData.empty())) {
+		// Each mip level stored by the importer becomes a subresource; for compressed formats, pitch is per row of 4x4 blocks.
+		// Subresources go by layer, then by level, which is also how layers are laid out in the pixel data.
+		if (descriptor.pixelData.empty()) {
+			throw Exception("Block-compressed textures must be created with their data", HalleyExceptions::VideoPlugin);
+		}
+		const auto data = descriptor.pixelData.getSpan();
+		const int maxLevels = descriptor.useMipMap ? TextureDescriptor::getNumMipLevels(texSize) : 1;
+		for (int layer = 0; layer < layers; ++layer) {
+			size_t pos = 0;
+			for (int level = 0; level < maxLevels; ++level) {
+				const auto levelSize = TextureDescriptor::getMipLevelSize(texSize, level);
+				const size_t bytes = TextureDescriptor::getLevelByteSize(levelSize, descriptor.format);
+				if (pos + bytes > layerBytes) {
+					break;
+				}
+				D3D11_SUBRESOURCE_DATA levelData;
+				levelData.pSysMem = data.data() + size_t(layer) * layerBytes + pos;
+				levelData.SysMemPitch = compressed ? UINT(bytes / size_t((levelSize.y + 3) / 4)) : UINT(levelSize.x * bpp);
+				levelData.SysMemSlicePitch = UINT(bytes);
+				levels.push_back(levelData);
+				pos += bytes;
+			}
+		}
+		if (levels.empty()) {
+			throw Exception("Not enough data for texture", HalleyExceptions::VideoPlugin);
+		}
 
-	if (descriptor.pixelData.empty()) {
+		desc.MipLevels = UINT(levels.size() / size_t(layers));
+		desc.Usage = descriptor.canBeUpdated ? D3D11_USAGE_DEFAULT : D3D11_USAGE_IMMUTABLE;
+		desc.CPUAccessFlags = 0;
+		res = levels.data();
+	} else if (descriptor.pixelData.empty()) {
 		desc.Usage = D3D11_USAGE_DEFAULT;
 		desc.CPUAccessFlags = 0;
 	} else {
@@ -99,7 +149,7 @@ void DX11Texture::load(TextureDescriptor&& descriptor)
 		}
 		desc.CPUAccessFlags = 0;
 		subResData.pSysMem = descriptor.pixelData.getSpan().data();
-		subResData.SysMemPitch = descriptor.pixelData.getStrideOr(bpp * size.x);
+		subResData.SysMemPitch = descriptor.pixelData.getStrideOr(bpp * texSize.x);
 		subResData.SysMemSlicePitch = subResData.SysMemPitch;
 		res = &subResData;
 	}
@@ -109,11 +159,26 @@ void DX11Texture::load(TextureDescriptor&& descriptor)
 		throw Exception("Error loading texture.", HalleyExceptions::VideoPlugin);
 	}
 
+	MemoryTracker::onFree(MemoryTags::GPUTextures, gpuBytes);
+	gpuBytes = 0;
+	for (UINT level = 0; level < desc.MipLevels; ++level) {
+		gpuBytes += TextureDescriptor::getLevelByteSize(TextureDescriptor::getMipLevelSize(texSize, int(level)), descriptor.format) * size_t(layers);
+	}
+	MemoryTracker::onAlloc(MemoryTags::GPUTextures, gpuBytes);
+
 	CD3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
-	srvDesc.Format = desc.Format;
-	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srvDesc.Texture2D.MipLevels = 1;
-	srvDesc.Texture2D.MostDetailedMip = 0;
+	srvDesc.Format = descriptor.format == TextureFormat::DEPTH ? DXGI_FORMAT_R24_UNORM_X8_TYPELESS : desc.Format;
+	if (layers > 1) {
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+		srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+		srvDesc.Texture2DArray.MostDetailedMip = 0;
+		srvDesc.Texture2DArray.FirstArraySlice = 0;
+		srvDesc.Texture2DArray.ArraySize = desc.ArraySize;
+	} else {
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+		srvDesc.Texture2D.MipLevels = desc.MipLevels;
+		srvDesc.Texture2D.MostDetailedMip = 0;
+	}
 
 	result = video.getDevice().CreateShaderResourceView(texture, &srvDesc, &srv);
 	if (result != S_OK) {
@@ -131,6 +196,30 @@ void DX11Texture::load(TextureDescriptor&& descriptor)
 	doneLoading();
 }
 
+void DX11Texture::loadPlane(ID3D11Texture2D* tex, DXGI_FORMAT viewFormat)
+{
+	Expects(tex);
+	tex->AddRef();
+	texture = tex;
+	format = viewFormat;
+
+	CD3D11_SHADER_RESOURCE_VIEW_DESC srvDesc(D3D11_SRV_DIMENSION_TEXTURE2D, viewFormat, 0, 1);
+	HRESULT result = video.getDevice().CreateShaderResourceView(texture, &srvDesc, &srv);
+	if (result != S_OK) {
+		throw Exception("Error creating shader resource view", HalleyExceptions::VideoPlugin);
+	}
+
+	auto samplerDesc = CD3D11_SAMPLER_DESC(CD3D11_DEFAULT());
+	samplerDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
+	samplerDesc.AddressU = samplerDesc.AddressV = samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
+	result = video.getDevice().CreateSamplerState(&samplerDesc, &samplerState);
+	if (result != S_OK) {
+		throw Exception("Error creating sampler", HalleyExceptions::VideoPlugin);
+	}
+
+	doneLoading();
+}
+
 void DX11Texture::reload(Resource&& resource)
 {
 	*this = std::move(dynamic_cast<DX11Texture&>(resource));
@@ -140,6 +229,10 @@ void DX11Texture::bind(DX11Video& video, int textureUnit) const
 {
 	waitForLoad();
 
+	if (!video.getStateCache().setTexture(textureUnit, srv, samplerState)) {
+		return;
+	}
+
 	ID3D11ShaderResourceView* srvs[] = { srv };
 	ID3D11SamplerState* samplers[] = { samplerState };
 	video.getDeviceContext().PSSetShaderResources(textureUnit, 1, srvs);
@@ -19,6 +19,9 @@ namespace Halley
 		void load(TextureDescriptor&& descriptor) override;
 		void reload(Resource&& resource) override;
 
+		// Views one plane of an existing texture, e.g. R8 or R8G8 on an NV12 one; the texture can be shared between planes
+		void loadPlane(ID3D11Texture2D* texture, DXGI_FORMAT viewFormat);
+
 		void bind(DX11Video& video, int textureUnit) const;
 		
 		DXGI_FORMAT getFormat() const;
@@ -30,5 +33,6 @@ namespace Halley
 		ID3D11ShaderResourceView* srv = nullptr;
 		ID3D11SamplerState* samplerState = nullptr;
 		DXGI_FORMAT format;
+		size_t gpuBytes = 0; // As reported to MemoryTracker
 	};
 }
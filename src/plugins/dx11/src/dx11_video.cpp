@@ -13,23 +13,37 @@
 #include "dx11_loader.h"
 #include "halley/support/logger.h"
 #include "halley/support/debug.h"
+#include <algorithm>
 
 #pragma comment (lib, "d3d11.lib")
 #pragma comment (lib, "Dxgi.lib")
 
 using namespace Halley;
 
+namespace {
+	struct BoundContext
+	{
+		ID3D11DeviceContext1* context = nullptr;
+		DX11StateCache* stateCache = nullptr;
+	};
+
+	thread_local BoundContext boundContext;
+}
+
 DX11Video::DX11Video(SystemAPI& system)
 	: system(system)
+	, gpuFrameTime(0)
 {}
 
 void DX11Video::init()
 {
 	loader = std::make_unique<DX11Loader>(*this);
+	uploadQueue = std::make_unique<TextureUploadQueue>(Executors::getVideoAux());
 }
 
 void DX11Video::deInit()
 {
+	uploadQueue.reset();
 	loader.reset();
 	releaseD3D();
 }
@@ -56,7 +70,7 @@ void DX11Video::initD3D(Window& window)
 
 	ID3D11DeviceContext* dc;
 	D3D_FEATURE_LEVEL featureLevels[] = { D3D_FEATURE_LEVEL_11_0, D3D_FEATURE_LEVEL_10_1, D3D_FEATURE_LEVEL_10_0 };
-	uint32_t flags = 0;
+	uint32_t flags = D3D11_CREATE_DEVICE_VIDEO_SUPPORT; // Lets Media Foundation decode straight into textures on this device
 	if (Debug::isDebug()) {
 		flags |= D3D11_CREATE_DEVICE_DEBUG;
 	}
@@ -136,23 +150,48 @@ void DX11Video::initSwapChain(Window& window)
 
 void DX11Video::initBackBuffer()
 {
-	if (backbuffer) {
-		backbuffer->Release();
-		backbuffer = nullptr;
-	}
+	releaseBackBuffer();
 
 	ID3D11Texture2D *pBackBuffer;
     swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<LPVOID*>(&pBackBuffer));
     device->CreateRenderTargetView(pBackBuffer, nullptr, &backbuffer);
+
+	// Depth/stencil buffer for the screen, the same size as the back buffer
+	D3D11_TEXTURE2D_DESC backBufferDesc;
+	pBackBuffer->GetDesc(&backBufferDesc);
     pBackBuffer->Release();
+
+	CD3D11_TEXTURE2D_DESC depthDesc(DXGI_FORMAT_D24_UNORM_S8_UINT, backBufferDesc.Width, backBufferDesc.Height, 1, 1, D3D11_BIND_DEPTH_STENCIL);
+	auto result = device->CreateTexture2D(&depthDesc, nullptr, &depthStencilBuffer);
+	if (result != S_OK) {
+		throw Exception("Unable to create depth stencil buffer", HalleyExceptions::VideoPlugin);
+	}
+	CD3D11_DEPTH_STENCIL_VIEW_DESC viewDesc(D3D11_DSV_DIMENSION_TEXTURE2D, depthDesc.Format);
+	result = device->CreateDepthStencilView(depthStencilBuffer, &viewDesc, &depthStencilView);
+	if (result != S_OK) {
+		throw Exception("Unable to create depth stencil view", HalleyExceptions::VideoPlugin);
+	}
 }
 
-void DX11Video::resizeSwapChain(Vector2i size)
+void DX11Video::releaseBackBuffer()
 {
 	if (backbuffer) {
 		backbuffer->Release();
 		backbuffer = nullptr;
 	}
+	if (depthStencilView) {
+		depthStencilView->Release();
+		depthStencilView = nullptr;
+	}
+	if (depthStencilBuffer) {
+		depthStencilBuffer->Release();
+		depthStencilBuffer = nullptr;
+	}
+}
+
+void DX11Video::resizeSwapChain(Vector2i size)
+{
+	releaseBackBuffer();
 	
 	HRESULT result = swapChain->ResizeBuffers(0, size.x, size.y, DXGI_FORMAT_UNKNOWN, 0);
 	if (result != S_OK) {
@@ -170,16 +209,20 @@ void DX11Video::releaseD3D()
 		return;
 	}
 
-	if (backbuffer) {
-		backbuffer->Release();
-		backbuffer = nullptr;
-	}
+	releaseBackBuffer();
 
 	if (swapChain) {
 		swapChain->Release();
 		swapChain = nullptr;
 	}
 
+	for (auto& c: pendingCommandLists) {
+		c.second->Release();
+	}
+	pendingCommandLists.clear();
+
+	releaseFrameQueries();
+
 	device->Release();
 	deviceContext->Release();
 	initialised = false;
@@ -187,11 +230,86 @@ void DX11Video::releaseD3D()
 
 void DX11Video::startRender()
 {
+	uploadQueue->onFrame();
+	beginFrameQuery();
 }
 
 void DX11Video::finishRender()
 {
-    swapChain->Present(useVsync ? 1 : 0, 0);
+	// Nothing else will use the context before the next frame resets it, so there's no point restoring its state
+	executeCommandLists(nullptr, false);
+	stateCache.reset();
+
+	endFrameQuery();
+
+	swapChain->Present(useVsync ? 1 : 0, 0);
+}
+
+TextureUploadQueue* DX11Video::getTextureUploadQueue()
+{
+	return uploadQueue.get();
+}
+
+int64_t DX11Video::getGPUFrameNanoSeconds() const
+{
+	return gpuFrameTime.load(std::memory_order_relaxed);
+}
+
+void DX11Video::beginFrameQuery()
+{
+	auto& query = frameQueries[frameQueryIdx];
+	if (!query.disjoint) {
+		D3D11_QUERY_DESC desc = {};
+		desc.Query = D3D11_QUERY_TIMESTAMP_DISJOINT;
+		if (device->CreateQuery(&desc, &query.disjoint) != S_OK) {
+			return;
+		}
+		desc.Query = D3D11_QUERY_TIMESTAMP;
+		device->CreateQuery(&desc, &query.start);
+		device->CreateQuery(&desc, &query.end);
+	}
+
+	// This is the oldest one; if it's still not done, it's dropped rather than waited on
+	if (query.pending) {
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+		UINT64 start = 0;
+		UINT64 end = 0;
+		if (deviceContext->GetData(query.disjoint, &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK
+			&& deviceContext->GetData(query.start, &start, sizeof(start), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK
+			&& deviceContext->GetData(query.end, &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) == S_OK
+			&& !disjoint.Disjoint && disjoint.Frequency > 0) {
+			gpuFrameTime.store(int64_t((end - start) * 1000000000ull / disjoint.Frequency), std::memory_order_relaxed);
+		}
+		query.pending = false;
+	}
+
+	deviceContext->Begin(query.disjoint);
+	deviceContext->End(query.start);
+}
+
+void DX11Video::endFrameQuery()
+{
+	auto& query = frameQueries[frameQueryIdx];
+	if (!query.disjoint) {
+		return;
+	}
+
+	deviceContext->End(query.end);
+	deviceContext->End(query.disjoint);
+	query.pending = true;
+	frameQueryIdx = (frameQueryIdx + 1) % frameQueries.size();
+}
+
+void DX11Video::releaseFrameQueries()
+{
+	for (auto& q: frameQueries) {
+		for (auto query: { q.disjoint, q.start, q.end }) {
+			if (query) {
+				query->Release();
+			}
+		}
+		q = FrameQuery();
+	}
 }
 
 void DX11Video::setWindow(WindowDefinition&& windowDescriptor)
@@ -241,7 +359,7 @@ std::unique_ptr<ScreenRenderTarget> DX11Video::createScreenRenderTarget()
 		resizeSwapChain(view.getSize());
 	}
 
-	return std::make_unique<DX11ScreenRenderTarget>(*this, view, backbuffer);
+	return std::make_unique<DX11ScreenRenderTarget>(*this, view, backbuffer, depthStencilView);
 }
 
 std::unique_ptr<MaterialConstantBuffer> DX11Video::createConstantBuffer()
@@ -251,9 +369,23 @@ std::unique_ptr<MaterialConstantBuffer> DX11Video::createConstantBuffer()
 
 std::unique_ptr<Painter> DX11Video::makePainter(Resources& resources)
 {
+	if (!uploadQueue->getPlaceholder()) {
+		uploadQueue->createPlaceholder(*this);
+	}
 	return std::make_unique<DX11Painter>(*this, resources);
 }
 
+std::unique_ptr<Painter> DX11Video::makeDeferredPainter(Resources& resources)
+{
+	return std::make_unique<DX11Painter>(*this, resources, true);
+}
+
+void DX11Video::submitDeferred(Painter& painter)
+{
+	// The immediate painter is probably halfway through its frame, so its state has to survive this
+	executeCommandLists(&painter, true);
+}
+
 String DX11Video::getShaderLanguage()
 {
 	return "hlsl";
@@ -265,10 +397,72 @@ ID3D11Device& DX11Video::getDevice()
 }
 
 ID3D11DeviceContext1& DX11Video::getDeviceContext()
+{
+	return boundContext.context ? *boundContext.context : *deviceContext;
+}
+
+DX11StateCache& DX11Video::getStateCache()
+{
+	return boundContext.stateCache ? *boundContext.stateCache : stateCache;
+}
+
+ID3D11DeviceContext1& DX11Video::getImmediateContext()
 {
 	return *deviceContext;
 }
 
+ID3D11DeviceContext1* DX11Video::createDeferredContext()
+{
+	ID3D11DeviceContext* dc = nullptr;
+	auto result = device->CreateDeferredContext(0, &dc);
+	if (result != S_OK) {
+		throw Exception("Unable to create deferred context", HalleyExceptions::VideoPlugin);
+	}
+
+	ID3D11DeviceContext1* context = nullptr;
+	dc->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(&context));
+	dc->Release();
+	if (!context) {
+		throw Exception("Deferred context doesn't support ID3D11DeviceContext1", HalleyExceptions::VideoPlugin);
+	}
+	return context;
+}
+
+void DX11Video::bindDeferredContext(ID3D11DeviceContext1* context, DX11StateCache* cache)
+{
+	Expects((context == nullptr) == (cache == nullptr));
+	boundContext.context = context;
+	boundContext.stateCache = cache;
+}
+
+void DX11Video::queueCommandList(const Painter& painter, ID3D11CommandList* commandList)
+{
+	std::unique_lock<std::mutex> lock(commandListMutex);
+	pendingCommandLists.emplace_back(&painter, commandList);
+}
+
+void DX11Video::executeCommandLists(const Painter* painter, bool restoreState)
+{
+	// Lists are executed in the order they finished recording, so painters that depend on each other should be submitted explicitly
+	std::vector<ID3D11CommandList*> toExecute;
+	{
+		std::unique_lock<std::mutex> lock(commandListMutex);
+		auto keep = std::stable_partition(pendingCommandLists.begin(), pendingCommandLists.end(), [&] (const std::pair<const Painter*, ID3D11CommandList*>& c)
+		{
+			return painter && c.first != painter;
+		});
+		for (auto i = keep; i != pendingCommandLists.end(); ++i) {
+			toExecute.push_back(i->second);
+		}
+		pendingCommandLists.erase(keep, pendingCommandLists.end());
+	}
+
+	for (auto& list: toExecute) {
+		deviceContext->ExecuteCommandList(list, restoreState ? TRUE : FALSE);
+		list->Release();
+	}
+}
+
 SystemAPI& DX11Video::getSystem()
 {
 	return system;
@@ -281,3 +475,39 @@ void* DX11Video::getImplementationPointer(const String& id)
 	}
 	return nullptr;
 }
+
+bool DX11Video::copyNativeTexture(const String& type, void* handle, int arraySlice, std::vector<std::shared_ptr<Texture>>& planes)
+{
+	if (type != "ID3D11Texture2D" || !handle) {
+		return false;
+	}
+
+	auto src = static_cast<ID3D11Texture2D*>(handle);
+	D3D11_TEXTURE2D_DESC srcDesc;
+	src->GetDesc(&srcDesc);
+	if (srcDesc.Format != DXGI_FORMAT_NV12) {
+		return false;
+	}
+
+	const auto size = Vector2i(int(srcDesc.Width), int(srcDesc.Height));
+	if (planes.size() != 2 || planes[0]->getSize() != size) {
+		// Decoder surfaces come from a small pool and are often texture arrays, so frames are copied out of them on the GPU
+		CD3D11_TEXTURE2D_DESC desc(DXGI_FORMAT_NV12, srcDesc.Width, srcDesc.Height, 1, 1, D3D11_BIND_SHADER_RESOURCE);
+		ID3D11Texture2D* texture = nullptr;
+		if (device->CreateTexture2D(&desc, nullptr, &texture) != S_OK) {
+			throw Exception("Unable to create NV12 texture", HalleyExceptions::VideoPlugin);
+		}
+
+		auto luma = std::make_shared<DX11Texture>(*this, size);
+		luma->loadPlane(texture, DXGI_FORMAT_R8_UNORM);
+		auto chroma = std::make_shared<DX11Texture>(*this, size / 2);
+		chroma->loadPlane(texture, DXGI_FORMAT_R8G8_UNORM);
+		texture->Release();
+
+		planes = { luma, chroma };
+	}
+
+	auto& dst = static_cast<DX11Texture&>(*planes[0]);
+	deviceContext->CopySubresourceRegion(dst.getTexture(), 0, 0, 0, 0, src, UINT(arraySlice), nullptr);
+	return true;
+}
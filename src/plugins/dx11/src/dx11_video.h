@@ -2,6 +2,11 @@
 
 #include "halley/core/api/halley_api_internal.h"
 #include "halley/core/graphics/window.h"
+#include "halley/core/graphics/texture_upload_queue.h"
+#include "dx11_state_cache.h"
+#include <array>
+#include <atomic>
+#include <mutex>
 #include <d3d11.h>
 #include <D3D11_1.h>
 #include <DXGI1_2.h>
@@ -35,15 +40,26 @@ namespace Halley {
 		void deInit() override;
 		
 		std::unique_ptr<Painter> makePainter(Resources& resources) override;
+		std::unique_ptr<Painter> makeDeferredPainter(Resources& resources) override;
+		void submitDeferred(Painter& painter) override;
 
 		String getShaderLanguage() override;
+		int64_t getGPUFrameNanoSeconds() const override;
+		TextureUploadQueue* getTextureUploadQueue() override;
 
 		ID3D11Device& getDevice();
-		ID3D11DeviceContext1& getDeviceContext();
+		ID3D11DeviceContext1& getDeviceContext(); // The deferred context bound to this thread, if any
+		DX11StateCache& getStateCache();
+		ID3D11DeviceContext1& getImmediateContext();
+
+		ID3D11DeviceContext1* createDeferredContext();
+		void bindDeferredContext(ID3D11DeviceContext1* context, DX11StateCache* cache); // nullptr goes back to the immediate context
+		void queueCommandList(const Painter& painter, ID3D11CommandList* commandList);
 		
 		SystemAPI& getSystem();
 
 		void* getImplementationPointer(const String& id) override;
+		bool copyNativeTexture(const String& type, void* handle, int arraySlice, std::vector<std::shared_ptr<Texture>>& planes) override;
 
 	private:
 		SystemAPI& system;
@@ -53,16 +69,42 @@ namespace Halley {
 		ID3D11DeviceContext1* deviceContext = nullptr;
 		IDXGISwapChain1* swapChain = nullptr;
 		ID3D11RenderTargetView* backbuffer = nullptr;
+		ID3D11Texture2D* depthStencilBuffer = nullptr;
+		ID3D11DepthStencilView* depthStencilView = nullptr;
 
 		Vector2i swapChainSize;
 		bool initialised = false;
 		bool useVsync = false;
 
 		std::unique_ptr<DX11Loader> loader;
+		std::unique_ptr<TextureUploadQueue> uploadQueue; // Runs on the loader
+		DX11StateCache stateCache;
+
+		// A ring of frame timestamp queries, so they can be read back a few frames later without stalling
+		struct FrameQuery
+		{
+			ID3D11Query* disjoint = nullptr;
+			ID3D11Query* start = nullptr;
+			ID3D11Query* end = nullptr;
+			bool pending = false;
+		};
+		std::array<FrameQuery, 4> frameQueries;
+		size_t frameQueryIdx = 0;
+		std::atomic<int64_t> gpuFrameTime;
+
+		std::mutex commandListMutex;
+		std::vector<std::pair<const Painter*, ID3D11CommandList*>> pendingCommandLists;
+
+		void executeCommandLists(const Painter* painter, bool restoreState);
+
+		void beginFrameQuery();
+		void endFrameQuery();
+		void releaseFrameQueries();
 
 		void initD3D(Window& window);
 		void initSwapChain(Window& window);
 		void initBackBuffer();
+		void releaseBackBuffer();
 		void resizeSwapChain(Vector2i size);
 		void releaseD3D();
 	};
@@ -9,6 +9,7 @@
 #include "halley/support/logger.h"
 #include "halley/core/game/game_platform.h"
 #include "halley/maths/random.h"
+#include <d3d11.h>
 
 using namespace Halley;
 
@@ -76,7 +77,7 @@ void MFMoviePlayer::init()
 	inputByteStream->AddRef();
 
 	IMFAttributes* attributes = nullptr;
-	HRESULT hr = MFCreateAttributes(&attributes, 1);
+	HRESULT hr = MFCreateAttributes(&attributes, 2);
 	if (!SUCCEEDED(hr)) {
 		throw Exception("Unable to create attributes", HalleyExceptions::MoviePlugin);
 	}
@@ -90,23 +91,23 @@ void MFMoviePlayer::init()
 	}
 	*/
 
-	// DX11 acceleration
+	// DX11 acceleration: frames are decoded into textures on the video device, and copied from there on the GPU
 	IMFDXGIDeviceManager* deviceManager = nullptr;
-	/*
 	auto dx11Device = static_cast<IUnknown*>(getVideoAPI().getImplementationPointer("ID3D11Device"));
 	if (dx11Device) {
 		UINT resetToken;
 		hr = MFCreateDXGIDeviceManager(&resetToken, &deviceManager);
-		if (!SUCCEEDED(hr)) {
-			throw Exception("Unable to create DXGI Device Manager");
+		if (SUCCEEDED(hr)) {
+			hr = deviceManager->ResetDevice(dx11Device, resetToken);
 		}
-		hr = deviceManager->ResetDevice(dx11Device, resetToken);
-		if (!SUCCEEDED(hr)) {
-			throw Exception("Unable to reset DXGI Device Manager with device");
+		if (SUCCEEDED(hr)) {
+			attributes->SetUnknown(MF_SOURCE_READER_D3D_MANAGER, deviceManager);
+			attributes->SetUINT32(MF_READWRITE_ENABLE_HARDWARE_TRANSFORMS, TRUE);
+			useNativeFrames = true;
+		} else {
+			Logger::logWarning("Unable to set up DXGI Device Manager, video will be decoded on the CPU");
 		}
-		attributes->SetUnknown(MF_SOURCE_READER_D3D_MANAGER, deviceManager);
 	}
-	*/
 
 	hr = MFCreateSourceReaderFromByteStream(inputByteStream, attributes, &reader);
 	if (!SUCCEEDED(hr)) {
@@ -322,24 +323,29 @@ HRESULT MFMoviePlayer::onReadSample(HRESULT hr, DWORD streamIndex, DWORD streamF
 				surface->Release();
 				*/
 				
-				IMF2DBuffer* buffer2d = nullptr;
-				hr = buffer->QueryInterface(__uuidof(IMF2DBuffer), reinterpret_cast<void**>(&buffer2d));
-				if (SUCCEEDED(hr)) {
-					BYTE* src;
-					LONG pitch;
-					buffer2d->Lock2D(&src, &pitch);
-					readVideoSample(sampleTime, reinterpret_cast<gsl::byte*>(src), pitch);
-					buffer2d->Unlock2D();
-					buffer2d->Release();
-				} else if (hr == E_NOINTERFACE) {
-					BYTE* src;
-					DWORD maxLen;
-					DWORD curLen;
-					buffer->Lock(&src, &maxLen, &curLen);
-					readVideoSample(sampleTime, reinterpret_cast<gsl::byte*>(src), minStride);
-					buffer->Unlock();
-				} else {
-					throw Exception("Error while querying for 2D buffer: " + toString(hr), HalleyExceptions::MoviePlugin);
+				const bool sentNative = useNativeFrames && readNativeVideoSample(sampleTime, buffer);
+				if (!sentNative) {
+					useNativeFrames = false; // Don't try again for every frame
+
+					IMF2DBuffer* buffer2d = nullptr;
+					hr = buffer->QueryInterface(__uuidof(IMF2DBuffer), reinterpret_cast<void**>(&buffer2d));
+					if (SUCCEEDED(hr)) {
+						BYTE* src;
+						LONG pitch;
+						buffer2d->Lock2D(&src, &pitch);
+						readVideoSample(sampleTime, reinterpret_cast<gsl::byte*>(src), pitch);
+						buffer2d->Unlock2D();
+						buffer2d->Release();
+					} else if (hr == E_NOINTERFACE) {
+						BYTE* src;
+						DWORD maxLen;
+						DWORD curLen;
+						buffer->Lock(&src, &maxLen, &curLen);
+						readVideoSample(sampleTime, reinterpret_cast<gsl::byte*>(src), minStride);
+						buffer->Unlock();
+					} else {
+						throw Exception("Error while querying for 2D buffer: " + toString(hr), HalleyExceptions::MoviePlugin);
+					}
 				}
 			}
 
@@ -361,6 +367,25 @@ HRESULT MFMoviePlayer::onReadSample(HRESULT hr, DWORD streamIndex, DWORD streamF
 	return S_OK;
 }
 
+bool MFMoviePlayer::readNativeVideoSample(Time time, IMFMediaBuffer* buffer)
+{
+	IMFDXGIBuffer* dxgiBuffer = nullptr;
+	if (!SUCCEEDED(buffer->QueryInterface(__uuidof(IMFDXGIBuffer), reinterpret_cast<void**>(&dxgiBuffer)))) {
+		return false;
+	}
+
+	bool result = false;
+	ID3D11Texture2D* texture = nullptr;
+	if (SUCCEEDED(dxgiBuffer->GetResource(__uuidof(ID3D11Texture2D), reinterpret_cast<void**>(&texture)))) {
+		UINT subresource = 0;
+		dxgiBuffer->GetSubresourceIndex(&subresource);
+		result = onNativeVideoFrameAvailable(time, "ID3D11Texture2D", texture, int(subresource));
+		texture->Release();
+	}
+	dxgiBuffer->Release();
+	return result;
+}
+
 void MFMoviePlayer::readVideoSample(Time time, const gsl::byte* data, int stride)
 {
 	if (!data) {
@@ -39,12 +39,14 @@ namespace Halley
 		IMFSourceReaderCallback* sampleReceiver = nullptr;
 		int minStride;
 		bool supportIMF2DBuffer = true;
+		bool useNativeFrames = false;
 
 		void init();
 		void deInit();
 
 		HRESULT onReadSample(HRESULT hrStatus, DWORD dwStreamIndex, DWORD dwStreamFlags, LONGLONG llTimestamp, IMFSample* pSample);
 
+		bool readNativeVideoSample(Time time, IMFMediaBuffer* buffer);
 		void readVideoSample(Time time, const gsl::byte* data, int stride);
 		void readAudioSample(Time time, gsl::span<const gsl::byte> data);
 	};
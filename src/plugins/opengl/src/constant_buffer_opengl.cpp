@@ -4,10 +4,18 @@
 #include "gl_utils.h"
 #include "halley/support/exception.h"
 #include "texture_opengl.h"
+#include <atomic>
 
 using namespace Halley;
 
+static uint64_t makeBindStamp()
+{
+	static std::atomic<uint64_t> next(1);
+	return next++;
+}
+
 ConstantBufferOpenGL::ConstantBufferOpenGL()
+	: bindStamp(makeBindStamp())
 {
 	buffer.init(GL_UNIFORM_BUFFER);
 }
@@ -20,6 +28,7 @@ ConstantBufferOpenGL::~ConstantBufferOpenGL()
 void ConstantBufferOpenGL::update(const MaterialDataBlock& dataBlock)
 {
 	buffer.setData(dataBlock.getData());
+	bindStamp = makeBindStamp();
 }
 
 void ConstantBufferOpenGL::bind(int bindPoint)
@@ -27,3 +36,8 @@ void ConstantBufferOpenGL::bind(int bindPoint)
 	buffer.bindToTarget(bindPoint);
 	glCheckError();
 }
+
+uint64_t ConstantBufferOpenGL::getBindStamp() const
+{
+	return bindStamp;
+}
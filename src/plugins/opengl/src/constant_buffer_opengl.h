@@ -12,7 +12,11 @@ namespace Halley
 		void update(const MaterialDataBlock& dataBlock) override;
 		void bind(int bindPoint);
 
+		// Unique to this buffer and its current contents, so painters can skip binding it again
+		uint64_t getBindStamp() const;
+
 	private:
 		GLBuffer buffer;
+		uint64_t bindStamp;
 	};
 }
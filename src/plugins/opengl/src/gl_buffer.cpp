@@ -1,4 +1,7 @@
 #include "gl_buffer.h"
+#include <halley/utils/utils.h>
+#include <gsl/gsl_assert>
+#include <halley/support/memory_tracker.h>
 
 using namespace Halley;
 
@@ -9,6 +12,7 @@ GLBuffer::~GLBuffer()
 	if (name != 0) {
 		glBindBuffer(target, 0);
 		glDeleteBuffers(1, &name);
+		MemoryTracker::onFree(MemoryTags::GPUBuffers, capacity);
 	}
 }
 
@@ -26,8 +30,10 @@ void GLBuffer::setData(gsl::span<const gsl::byte> data)
 	bind();
 	size = size_t(data.size_bytes());
 	if (capacity < size) {
+		MemoryTracker::onFree(MemoryTags::GPUBuffers, capacity);
 		capacity = nextPowerOf2(size);
 		glBufferData(target, capacity, nullptr, usage);
+		MemoryTracker::onAlloc(MemoryTags::GPUBuffers, capacity);
 	}
 	glBufferSubData(target, 0, size, data.data());
 
@@ -39,6 +45,11 @@ size_t GLBuffer::getSize() const
 	return size;
 }
 
+GLuint GLBuffer::getName() const
+{
+	return name;
+}
+
 void GLBuffer::bind()
 {
 	glBindBuffer(target, name);
@@ -50,3 +61,190 @@ void GLBuffer::bindToTarget(GLuint index)
 	glBindBufferRange(target, index, name, 0, size);
 	glCheckError();
 }
+
+
+GLStreamBuffer::GLStreamBuffer()
+{
+#ifdef WITH_OPENGL
+	fences.fill(nullptr);
+#endif
+}
+
+GLStreamBuffer::~GLStreamBuffer()
+{
+#ifdef WITH_OPENGL
+	for (auto& f: fences) {
+		if (f) {
+			glDeleteSync(f);
+		}
+	}
+	if (name != 0) {
+		if (persistentData || mapped) {
+			bind();
+			glUnmapBuffer(target);
+		}
+		glBindBuffer(target, 0);
+		glDeleteBuffers(1, &name);
+		MemoryTracker::onFree(MemoryTags::GPUBuffers, segmentSize * numSegments);
+	}
+#endif
+}
+
+void GLStreamBuffer::init(GLenum t, size_t size)
+{
+#ifdef WITH_OPENGL
+	if (name != 0) {
+		return;
+	}
+
+	target = t;
+	segmentSize = alignUp(size, size_t(256));
+	const size_t totalSize = segmentSize * numSegments;
+
+	glGenBuffers(1, &name);
+	bind();
+	if (ogl_ext_ARB_buffer_storage == ogl_LOAD_SUCCEEDED) {
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(target, totalSize, nullptr, flags);
+		persistentData = static_cast<char*>(glMapBufferRange(target, 0, totalSize, flags));
+		mode = persistentData ? Mode::Persistent : Mode::Unavailable;
+	}
+	if (mode == Mode::Unavailable) {
+		// Buffer storage is immutable, so a failed persistent setup needs a new buffer
+		if (persistentData == nullptr && ogl_ext_ARB_buffer_storage == ogl_LOAD_SUCCEEDED) {
+			glDeleteBuffers(1, &name);
+			glGenBuffers(1, &name);
+			bind();
+		}
+		glBufferData(target, totalSize, nullptr, GL_STREAM_DRAW);
+		mode = Mode::Unsynchronised;
+	}
+	MemoryTracker::onAlloc(MemoryTags::GPUBuffers, totalSize);
+	segment = numSegments - 1;
+	head = getSegmentEnd();
+	glCheckError();
+#else
+	(void)t;
+	(void)size;
+#endif
+}
+
+bool GLStreamBuffer::isAvailable() const
+{
+	return mode != Mode::Unavailable;
+}
+
+void GLStreamBuffer::startFrame()
+{
+#ifdef WITH_OPENGL
+	if (!isAvailable()) {
+		return;
+	}
+
+	segment = (segment + 1) % numSegments;
+	head = segment * segmentSize;
+
+	auto& fence = fences[segment];
+	if (fence) {
+		// Normally already signalled, as this segment was last used numSegments frames ago
+		GLbitfield flags = 0;
+		while (true) {
+			GLenum result = glClientWaitSync(fence, flags, 1000000);
+			if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED || result == GL_WAIT_FAILED) {
+				break;
+			}
+			flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		}
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+#endif
+}
+
+void GLStreamBuffer::endFrame()
+{
+#ifdef WITH_OPENGL
+	if (!isAvailable()) {
+		return;
+	}
+	if (mapped) {
+		commit(0);
+	}
+
+	auto& fence = fences[segment];
+	if (fence) {
+		glDeleteSync(fence);
+	}
+	fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glCheckError();
+#endif
+}
+
+char* GLStreamBuffer::map(size_t minBytes, size_t& capacity)
+{
+	Expects(mapped == nullptr);
+
+	if (!isAvailable() || head + minBytes > getSegmentEnd()) {
+		capacity = 0;
+		return nullptr;
+	}
+
+	capacity = getSegmentEnd() - head;
+	mappedOffset = head;
+	if (mode == Mode::Persistent) {
+		mapped = persistentData + head;
+	} else {
+#ifdef WITH_OPENGL
+		bind();
+		mapped = static_cast<char*>(glMapBufferRange(target, head, capacity, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT));
+		glCheckError();
+#endif
+		if (!mapped) {
+			capacity = 0;
+		}
+	}
+	return mapped;
+}
+
+bool GLStreamBuffer::isMapped(const void* ptr) const
+{
+	return mapped != nullptr && ptr == mapped;
+}
+
+size_t GLStreamBuffer::commit(size_t bytes)
+{
+	Expects(mapped != nullptr);
+	Expects(mappedOffset + bytes <= getSegmentEnd());
+
+#ifdef WITH_OPENGL
+	if (mode == Mode::Unsynchronised) {
+		bind();
+		if (bytes > 0) {
+			glFlushMappedBufferRange(target, 0, bytes);
+		}
+		glUnmapBuffer(target);
+		glCheckError();
+	}
+#endif
+
+	const size_t offset = mappedOffset;
+	mapped = nullptr;
+	head = std::min(alignUp(offset + bytes, size_t(16)), getSegmentEnd());
+	return offset;
+}
+
+void GLStreamBuffer::bind()
+{
+	glBindBuffer(target, name);
+	glCheckError();
+}
+
+GLuint GLStreamBuffer::getName() const
+{
+	return name;
+}
+
+size_t GLStreamBuffer::getSegmentEnd() const
+{
+	return (segment + 1) * segmentSize;
+}
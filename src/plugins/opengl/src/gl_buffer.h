@@ -2,6 +2,7 @@
 
 #include "halley_gl.h"
 #include <gsl/gsl>
+#include <array>
 
 namespace Halley
 {
@@ -16,6 +17,7 @@ namespace Halley
 		void init(GLenum target, GLenum usage = GL_STREAM_DRAW);
 		void setData(gsl::span<const gsl::byte> data);
 		size_t getSize() const;
+		GLuint getName() const;
 
 	private:
 		GLenum target = 0;
@@ -24,4 +26,57 @@ namespace Halley
 		size_t capacity = 0;
 		size_t size = 0;
 	};
+
+	// A buffer split in one segment per frame in flight, which the CPU writes straight into.
+	// Uses a persistently mapped buffer with ARB_buffer_storage, or unsynchronised glMapBufferRange otherwise;
+	// either way, fences make sure that a segment is only reused once the GPU is done with it.
+	class GLStreamBuffer
+	{
+	public:
+		GLStreamBuffer();
+		~GLStreamBuffer();
+
+		void init(GLenum target, size_t segmentSize);
+		bool isAvailable() const;
+
+		void startFrame();
+		void endFrame();
+
+		// Returns at least minBytes of memory to write into, or nullptr if this frame's segment is exhausted
+		char* map(size_t minBytes, size_t& capacity);
+		bool isMapped(const void* ptr) const;
+
+		// Ends writing to the memory returned by map(), returning its offset in the buffer
+		size_t commit(size_t bytes);
+
+		void bind();
+		GLuint getName() const;
+
+	private:
+		constexpr static size_t numSegments = 3;
+
+		enum class Mode
+		{
+			Unavailable,
+			Persistent,
+			Unsynchronised
+		};
+
+		GLenum target = 0;
+		GLuint name = 0;
+		Mode mode = Mode::Unavailable;
+		size_t segmentSize = 0;
+		size_t segment = 0;
+		size_t head = 0;
+
+		char* persistentData = nullptr;
+		char* mapped = nullptr;
+		size_t mappedOffset = 0;
+
+#ifdef WITH_OPENGL
+		std::array<GLsync, numSegments> fences;
+#endif
+
+		size_t getSegmentEnd() const;
+	};
 }
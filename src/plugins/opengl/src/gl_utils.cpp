@@ -26,6 +26,9 @@
 #include <gsl/gsl_assert>
 #include "halley/text/string_converter.h"
 #include "halley_gl.h"
+#include "halley/core/graphics/material/material_definition.h"
+#include <atomic>
+#include <algorithm>
 
 #ifdef __APPLE__
 #include <pthread.h>
@@ -105,20 +108,32 @@ namespace Halley {
 			scissoring = false;
 			curBlend = BlendType::Undefined;
 			hasClearCol = false;
+			textureEpoch = 0;
+			elidedCalls = 0;
+			hasDepthStencil = false;
+			clipDistances = 0;
 		}
 
 		int curTexUnit;
 		int numUnits;
-		std::array<int, 8> curTex;
+		std::array<int, 8> curTex; // -1 if unknown
 		BlendType curBlend;
 		Rect4i viewport;
 		Colour clearCol;
 		bool scissoring;
 		bool hasClearCol;
+		uint64_t textureEpoch;
+		size_t elidedCalls;
+		MaterialDepthStencil depthStencil;
+		bool hasDepthStencil;
+		int clipDistances;
 	};
 
 }
 
+// Texture names can be reused as soon as they're deleted, even if another context still has the old one bound
+static std::atomic<uint64_t> textureDeletions(0);
+
 #ifdef __APPLE__
 static pthread_once_t key_once = PTHREAD_ONCE_INIT;
 static pthread_key_t key;
@@ -207,7 +222,70 @@ void GLUtils::setBlendType(BlendType type)
 
 		// Update current
 		state.curBlend = type;
+	} else {
+		++state.elidedCalls;
+	}
+}
+
+static GLenum getGLComparison(DepthStencilComparisonFunction func)
+{
+	switch (func) {
+	case DepthStencilComparisonFunction::Never: return GL_NEVER;
+	case DepthStencilComparisonFunction::Less: return GL_LESS;
+	case DepthStencilComparisonFunction::Equal: return GL_EQUAL;
+	case DepthStencilComparisonFunction::LessEqual: return GL_LEQUAL;
+	case DepthStencilComparisonFunction::Greater: return GL_GREATER;
+	case DepthStencilComparisonFunction::NotEqual: return GL_NOTEQUAL;
+	case DepthStencilComparisonFunction::GreaterEqual: return GL_GEQUAL;
+	case DepthStencilComparisonFunction::Always: return GL_ALWAYS;
+	}
+	return GL_ALWAYS;
+}
+
+static GLenum getGLStencilOp(StencilWriteOperation op)
+{
+	switch (op) {
+	case StencilWriteOperation::Keep: return GL_KEEP;
+	case StencilWriteOperation::Zero: return GL_ZERO;
+	case StencilWriteOperation::Replace: return GL_REPLACE;
+	case StencilWriteOperation::IncrementClamp: return GL_INCR;
+	case StencilWriteOperation::DecrementClamp: return GL_DECR;
+	case StencilWriteOperation::Invert: return GL_INVERT;
+	case StencilWriteOperation::IncrementWrap: return GL_INCR_WRAP;
+	case StencilWriteOperation::DecrementWrap: return GL_DECR_WRAP;
 	}
+	return GL_KEEP;
+}
+
+void GLUtils::setDepthStencil(const MaterialDepthStencil& ds)
+{
+	if (checked && state.hasDepthStencil && state.depthStencil == ds) {
+		++state.elidedCalls;
+		return;
+	}
+
+	// Depth writes need the test enabled in GL, so "always" is used to write without testing
+	if (ds.isDepthTestEnabled() || ds.isDepthWriteEnabled()) {
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(ds.isDepthTestEnabled() ? getGLComparison(ds.getDepthComparisonFunction()) : GL_ALWAYS);
+	} else {
+		glDisable(GL_DEPTH_TEST);
+	}
+	glDepthMask(ds.isDepthWriteEnabled() ? GL_TRUE : GL_FALSE);
+	glCheckError();
+
+	if (ds.isStencilTestEnabled()) {
+		glEnable(GL_STENCIL_TEST);
+		glStencilFunc(getGLComparison(ds.getStencilComparisonFunction()), ds.getStencilReference(), GLuint(ds.getStencilReadMask()));
+		glStencilOp(getGLStencilOp(ds.getStencilOpStencilFail()), getGLStencilOp(ds.getStencilOpDepthFail()), getGLStencilOp(ds.getStencilOpPass()));
+		glStencilMask(GLuint(ds.getStencilWriteMask()));
+	} else {
+		glDisable(GL_STENCIL_TEST);
+	}
+	glCheckError();
+
+	state.depthStencil = ds;
+	state.hasDepthStencil = true;
 }
 
 void GLUtils::setTextureUnit(int n)
@@ -219,17 +297,32 @@ void GLUtils::setTextureUnit(int n)
 		glActiveTexture(GL_TEXTURE0 + n);
 		glCheckError();
 		state.curTexUnit = n;
+	} else {
+		++state.elidedCalls;
 	}
 }
 
 void GLUtils::bindTexture(int id)
+{
+	bindTexture(id, GL_TEXTURE_2D);
+}
+
+void GLUtils::bindTexture(int id, unsigned int target)
 {
 	Expects(id >= 0);
 
-	if (true || !checked || id != state.curTex[state.curTexUnit]) {
+	const uint64_t epoch = textureDeletions.load(std::memory_order_acquire);
+	if (state.textureEpoch != epoch) {
+		state.curTex.fill(-1);
+		state.textureEpoch = epoch;
+	}
+
+	if (!checked || id != state.curTex[state.curTexUnit]) {
 		state.curTex[state.curTexUnit] = id;
-		glBindTexture(GL_TEXTURE_2D, id);
+		glBindTexture(target, id);
 		glCheckError();
+	} else {
+		++state.elidedCalls;
 	}
 }
 
@@ -271,6 +364,24 @@ void GLUtils::setNumberOfTextureUnits(int n)
 
 void GLUtils::resetState()
 {
+	state.hasDepthStencil = false;
+}
+
+void GLUtils::onTextureDeleted()
+{
+	textureDeletions.fetch_add(1, std::memory_order_release);
+}
+
+void GLUtils::logElidedCall()
+{
+	++state.elidedCalls;
+}
+
+size_t GLUtils::takeElidedCalls()
+{
+	const size_t n = state.elidedCalls;
+	state.elidedCalls = 0;
+	return n;
 }
 
 void GLUtils::setViewPort(Rect4i r)
@@ -278,6 +389,8 @@ void GLUtils::setViewPort(Rect4i r)
 	if (state.viewport != r) {
 		glViewport(r.getX(), r.getY(), r.getWidth(), r.getHeight());
 		state.viewport = r;
+	} else {
+		++state.elidedCalls;
 	}
 }
 
@@ -296,18 +409,62 @@ void GLUtils::setScissor(Rect4i r, bool enable)
 	}
 }
 
+void GLUtils::setClipDistances(int n)
+{
+#ifdef WITH_OPENGL
+	if (n == state.clipDistances) {
+		++state.elidedCalls;
+		return;
+	}
+	for (int i = std::min(n, state.clipDistances); i < std::max(n, state.clipDistances); ++i) {
+		if (i < n) {
+			glEnable(GL_CLIP_DISTANCE0 + i);
+		} else {
+			glDisable(GL_CLIP_DISTANCE0 + i);
+		}
+	}
+	state.clipDistances = n;
+#endif
+}
+
 Halley::Rect4i GLUtils::getViewPort() const
 {
 	return state.viewport;
 }
 
-void GLUtils::clear(Colour col)
+void GLUtils::clear(Maybe<Colour> col, Maybe<float> depth, Maybe<uint8_t> stencil)
 {
-	if (!state.hasClearCol || col != state.clearCol) {
-		glClearColor(col.r, col.g, col.b, col.a);
-		state.clearCol = col;
-		state.hasClearCol = true;
+	GLbitfield mask = 0;
+	if (col) {
+		if (!state.hasClearCol || col.get() != state.clearCol) {
+			glClearColor(col->r, col->g, col->b, col->a);
+			state.clearCol = col.get();
+			state.hasClearCol = true;
+		}
+		mask |= GL_COLOR_BUFFER_BIT;
 	}
-	glClear(GL_COLOR_BUFFER_BIT);
+
+	// Clears are masked by the write masks, so those are opened up, and the material state has to be set again after
+	if (depth) {
+		glDepthMask(GL_TRUE);
+#ifdef WITH_OPENGL
+		glClearDepth(depth.get());
+#else
+		glClearDepthf(depth.get());
+#endif
+		mask |= GL_DEPTH_BUFFER_BIT;
+		state.hasDepthStencil = false;
+	}
+	if (stencil) {
+		glStencilMask(0xFF);
+		glClearStencil(stencil.get());
+		mask |= GL_STENCIL_BUFFER_BIT;
+		state.hasDepthStencil = false;
+	}
+
+	if (mask != 0) {
+		glClear(mask);
+	}
+	glCheckError();
 }
 
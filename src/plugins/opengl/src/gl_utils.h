@@ -25,11 +25,14 @@
 #include "halley/maths/rect.h"
 #include "halley/maths/colour.h"
 #include <halley/core/graphics/blend.h>
+#include <halley/data_structures/maybe.h>
+#include <cstdint>
 
 namespace Halley {
 
 	class Texture;
 	class GLInternals;
+	class MaterialDepthStencil;
 
 	class GLUtils {
 	public:
@@ -39,17 +42,27 @@ namespace Halley {
 		GLUtils& operator=(const GLUtils&) = delete;
 
 		void setBlendType(BlendType type);
+		void setDepthStencil(const MaterialDepthStencil& depthStencil);
 
 		void bindTexture(int id);
+		void bindTexture(int id, unsigned int target); // e.g. GL_TEXTURE_2D_ARRAY
 		void setTextureUnit(int n);
 		void setNumberOfTextureUnits(int n);
 		void resetState();
 
+		// Must be called before deleting any texture, as that changes bindings in every context that had it bound
+		static void onTextureDeleted();
+
+		// Number of calls skipped because the state was already set, on this thread, since the last call
+		void logElidedCall();
+		size_t takeElidedCalls();
+
 		void setViewPort(Rect4i rect);
 		void setScissor(Rect4i rect, bool enable);
+		void setClipDistances(int n); // Enables the first n, and disables the rest
 		Rect4i getViewPort() const;
 
-		void clear(Colour col);
+		void clear(Maybe<Colour> col, Maybe<float> depth, Maybe<uint8_t> stencil);
 		static void doGlCheckError(const char* file = "", long line = 0);
 		
 	private:
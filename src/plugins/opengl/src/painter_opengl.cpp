@@ -4,10 +4,23 @@
 #include "shader_opengl.h"
 #include "constant_buffer_opengl.h"
 #include "halley/core/graphics/material/material_parameter.h"
+#include "halley/core/graphics/static_vertex_buffer.h"
 #include "texture_opengl.h"
+#include "halley/utils/hash.h"
+#include <array>
 
 using namespace Halley;
 
+// Vertex memory available per frame before falling back to uploading each batch
+constexpr static size_t vertexStreamSegmentSize = 4 * 1024 * 1024;
+
+// GLES 2 can only draw 16-bit indices
+#ifdef WITH_OPENGL_ES2
+constexpr static GLenum glIndexType = GL_UNSIGNED_SHORT;
+#else
+constexpr static GLenum glIndexType = GL_UNSIGNED_INT;
+#endif
+
 PainterOpenGL::PainterOpenGL(Resources& resources)
 	: Painter(resources)
 {}
@@ -20,6 +33,13 @@ PainterOpenGL::~PainterOpenGL()
 		glDeleteVertexArrays(1, &vao);
 		vao = 0;
 	}
+	releaseVertexArrays(true);
+	for (auto& queries: timestampQueries) {
+		if (!queries.empty()) {
+			glDeleteQueries(GLsizei(queries.size()), queries.data());
+			queries.clear();
+		}
+	}
 #endif
 }
 
@@ -34,10 +54,15 @@ void PainterOpenGL::doStartRender()
 	glUtils->setNumberOfTextureUnits(1);
 	glUtils->bindTexture(0);
 	glUtils->setScissor(Rect4i(), false);
+	glUtils->resetState();
+	boundBlocks.clear();
 
 	vertexBuffer.init(GL_ARRAY_BUFFER);
+	vertexStream.init(GL_ARRAY_BUFFER, vertexStreamSegmentSize);
+	vertexStream.startFrame();
 	elementBuffer.init(GL_ELEMENT_ARRAY_BUFFER);
 	stdQuadElementBuffer.init(GL_ELEMENT_ARRAY_BUFFER, GL_STATIC_DRAW);
+	quadVertexBuffer.init(GL_ARRAY_BUFFER, GL_STATIC_DRAW);
 
 #ifdef WITH_OPENGL
 	if (vao == 0) {
@@ -57,33 +82,40 @@ void PainterOpenGL::doStartRender()
 
 void PainterOpenGL::doEndRender()
 {
+	vertexStream.endFrame();
+	releaseStaticBuffers();
+	logElidedStateChanges(glUtils->takeElidedCalls());
 #ifdef WITH_OPENGL
 	glBindVertexArray(0);
+	if (++frameNumber % 256 == 0) {
+		releaseVertexArrays(false);
+	}
 #endif
 	glCheckError();
 }
 
-void PainterOpenGL::clear(Colour colour)
+void PainterOpenGL::doClear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil)
 {
 	glCheckError();
-	glClearColor(colour.r, colour.g, colour.b, colour.a);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glCheckError();
+	glUtils->clear(colour, depth, stencil);
 }
 
 void PainterOpenGL::setMaterialPass(const Material& material, int passNumber)
 {
 	auto& pass = material.getDefinition().getPass(passNumber);
 
-	// Set blend and shader
+	// Set blend, depth/stencil and shader
 	glUtils->setBlendType(pass.getBlend());
-	ShaderOpenGL& shader = static_cast<ShaderOpenGL&>(pass.getShader());
+	glUtils->setDepthStencil(pass.getDepthStencil());
+	glUtils->setClipDistances(material.getDefinition().hasShaderClip() ? 4 : 0); // See sprite.vertex.glsl
+	const int variant = material.getVariant();
+	ShaderOpenGL& shader = static_cast<ShaderOpenGL&>(pass.getShader(variant));
 	shader.bind();
 
 	// Bind constant buffer
 	// TODO: move this logic to Painter?
 	for (auto& dataBlock: material.getDataBlocks()) {
-		int address = dataBlock.getAddress(passNumber, ShaderType::Combined);
+		int address = dataBlock.getAddress(passNumber, ShaderType::Combined, variant);
 		if (address != -1) {
 			shader.setUniformBlockBinding(address, dataBlock.getBindPoint());
 		}
@@ -93,14 +125,14 @@ void PainterOpenGL::setMaterialPass(const Material& material, int passNumber)
 	// TODO: move this logic to Painter?
 	int textureUnit = 0;
 	for (auto& tex: material.getTextureUniforms()) {
-		int location = tex.getAddress(passNumber, ShaderType::Combined);
+		int location = tex.getAddress(passNumber, ShaderType::Combined, variant);
 		if (location != -1) {
-			auto texture = std::static_pointer_cast<const TextureOpenGL>(material.getTexture(textureUnit));
+			auto& texture = material.getTexture(textureUnit);
 			if (!texture) {
 				throw Exception("Error binding texture to texture unit #" + toString(textureUnit) + " with material \"" + material.getDefinition().getName() + "\": texture is null.", HalleyExceptions::VideoPlugin);					
 			} else {
-				glUniform1i(location, textureUnit);
-				texture->bind(textureUnit);
+				shader.setTextureUnit(location, textureUnit);
+				static_cast<const TextureOpenGL&>(texture->getBindable()).bind(textureUnit);
 			}
 		}
 		++textureUnit;
@@ -111,7 +143,15 @@ void PainterOpenGL::setMaterialData(const Material& material)
 {
 	for (auto& dataBlock: material.getDataBlocks()) {
 		if (dataBlock.getType() != MaterialDataBlockType::SharedExternal) {
-			static_cast<ConstantBufferOpenGL&>(dataBlock.getConstantBuffer()).bind(dataBlock.getBindPoint());
+			auto& buffer = static_cast<ConstantBufferOpenGL&>(dataBlock.getConstantBuffer());
+			const size_t bindPoint = size_t(dataBlock.getBindPoint());
+			if (boundBlocks.size() <= bindPoint) {
+				boundBlocks.resize(bindPoint + 1, 0);
+			}
+			if (boundBlocks[bindPoint] != buffer.getBindStamp()) {
+				buffer.bind(int(bindPoint));
+				boundBlocks[bindPoint] = buffer.getBindStamp();
+			}
 		}
 	}
 }
@@ -132,40 +172,284 @@ void PainterOpenGL::onUpdateProjection(Material& material)
 	setMaterialData(material);
 }
 
-void PainterOpenGL::setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, unsigned short* indices, bool standardQuadsOnly)
+void PainterOpenGL::setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly)
 {
 	Expects(numVertices > 0);
 	Expects(numIndices >= numVertices);
 	Expects(vertexData);
 	Expects(indices);
 
+	// Load vertices into VBO, and bind attributes; first, as the index buffer binding belongs to the vertex array
+	GLuint buffer = 0;
+	const size_t baseOffset = uploadVertices(vertexData, numVertices * material.getVertexStride(), buffer);
+	bindVertexAttributes(material, buffer, baseOffset, false);
+
 	// Load indices into VBO
 	if (standardQuadsOnly) {
-		if (stdQuadElementBuffer.getSize() < numIndices * sizeof(unsigned short)) {
-			size_t indicesToAllocate = nextPowerOf2(numIndices);
-			std::vector<unsigned short> tmp(indicesToAllocate);
-			generateQuadIndices(0, indicesToAllocate / 6, tmp.data());
-			stdQuadElementBuffer.setData(gsl::as_bytes(gsl::span<unsigned short>(tmp)));
+		bindStandardQuadIndices(numIndices);
+	} else {
+		setIndexData(elementBuffer, indices, numIndices);
+	}
+}
+
+bool PainterOpenGL::supportsInstancing() const
+{
+#ifdef WITH_OPENGL
+	return true;
+#else
+	return false;
+#endif
+}
+
+void PainterOpenGL::setInstances(const MaterialDefinition& material, size_t numInstances, void* instanceData)
+{
+	Expects(numInstances > 0);
+	Expects(instanceData);
+
+	// a_vertPos, see Painter::drawSprites; bindVertexAttributes reads it from here
+	if (quadVertexBuffer.getSize() == 0) {
+		const std::array<Vector4f, 4> quad = {{ Vector4f(0, 0, 0, 0), Vector4f(1, 0, 1, 0), Vector4f(1, 1, 1, 1), Vector4f(0, 1, 0, 1) }};
+		quadVertexBuffer.setData(gsl::as_bytes(gsl::span<const Vector4f>(quad)));
+	}
+
+	GLuint buffer = 0;
+	const size_t baseOffset = uploadVertices(instanceData, numInstances * material.getVertexStride(), buffer);
+	bindVertexAttributes(material, buffer, baseOffset, true);
+	bindStandardQuadIndices(6);
+}
+
+bool PainterOpenGL::supportsStaticVertices() const
+{
+	return true;
+}
+
+void PainterOpenGL::setStaticVertices(const MaterialDefinition& material, const std::shared_ptr<const StaticVertexBuffer>& buffer)
+{
+	Expects(buffer);
+	Expects(buffer->getNumVertices() > 0);
+
+	auto& entry = staticBuffers[buffer->getId()];
+	if (!entry.buffer) {
+		entry.owner = buffer;
+		entry.buffer = std::make_unique<GLBuffer>();
+		entry.buffer->init(GL_ARRAY_BUFFER, GL_STATIC_DRAW);
+		entry.buffer->setData(gsl::as_bytes(gsl::span<const char>(buffer->getData(), buffer->getSize())));
+	} else {
+		entry.buffer->bind();
+	}
+	bindVertexAttributes(material, entry.buffer->getName(), 0, false);
+
+	const size_t numVertices = buffer->getNumVertices();
+	bindStandardQuadIndices(numVertices * 3 / 2);
+}
+
+bool PainterOpenGL::supportsGPUTimers() const
+{
+	// Timer queries are core since 3.3, but GLES only has them as an extension
+#ifdef WITH_OPENGL
+	return true;
+#else
+	return false;
+#endif
+}
+
+void PainterOpenGL::writeGPUTimestamp(size_t frame, size_t idx)
+{
+#ifdef WITH_OPENGL
+	auto& queries = timestampQueries.at(frame);
+	if (idx >= queries.size()) {
+		const size_t prevSize = queries.size();
+		queries.resize(std::min(std::max(idx + 1, std::max(prevSize * 2, size_t(16))), maxGPUTimestamps));
+		glGenQueries(GLsizei(queries.size() - prevSize), queries.data() + prevSize);
+		glCheckError();
+	}
+	glQueryCounter(queries[idx], GL_TIMESTAMP);
+	glCheckError();
+#endif
+}
+
+bool PainterOpenGL::readGPUTimestamps(size_t frame, size_t count, Vector<int64_t>& dst)
+{
+#ifdef WITH_OPENGL
+	auto& queries = timestampQueries.at(frame);
+	if (count == 0 || count > queries.size()) {
+		return true;
+	}
+
+	// They complete in order, so if the last one is done, they all are
+	GLint available = 0;
+	glGetQueryObjectiv(queries[count - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		return false;
+	}
+
+	dst.resize(count);
+	for (size_t i = 0; i < count; ++i) {
+		GLuint64 value = 0;
+		glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &value);
+		dst[i] = int64_t(value);
+	}
+	glCheckError();
+	return true;
+#else
+	return true;
+#endif
+}
+
+void PainterOpenGL::releaseStaticBuffers()
+{
+	bool released = false;
+	for (auto iter = staticBuffers.begin(); iter != staticBuffers.end(); ) {
+		if (iter->second.owner.expired()) {
+			iter = staticBuffers.erase(iter);
+			released = true;
+		} else {
+			++iter;
+		}
+	}
+
+#ifdef WITH_OPENGL
+	// Vertex arrays reading from a deleted buffer have to go before its name is reused, as they'd be found for the new one
+	if (released) {
+		for (auto iter = vertexArrays.begin(); iter != vertexArrays.end(); ) {
+			if (!glIsBuffer(iter->second.vertexBuffer)) {
+				glDeleteVertexArrays(1, &iter->second.vao);
+				iter = vertexArrays.erase(iter);
+			} else {
+				++iter;
+			}
+		}
+	}
+#endif
+}
+
+void PainterOpenGL::releaseVertexArrays(bool all)
+{
+#ifdef WITH_OPENGL
+	// Layouts not drawn for a while (e.g. from materials that were reloaded) are let go of
+	for (auto iter = vertexArrays.begin(); iter != vertexArrays.end(); ) {
+		if (all || iter->second.lastFrame + 256 < frameNumber) {
+			glDeleteVertexArrays(1, &iter->second.vao);
+			iter = vertexArrays.erase(iter);
 		} else {
-			stdQuadElementBuffer.bind();
+			++iter;
 		}
+	}
+	glCheckError();
+#endif
+}
+
+void PainterOpenGL::bindStandardQuadIndices(size_t numIndices)
+{
+	const size_t indexSize = glIndexType == GL_UNSIGNED_INT ? sizeof(IndexType) : sizeof(unsigned short);
+	if (stdQuadElementBuffer.getSize() < numIndices * indexSize) {
+		size_t indicesToAllocate = nextPowerOf2(numIndices);
+		std::vector<IndexType> tmp(indicesToAllocate);
+		generateQuadIndices(0, indicesToAllocate / 6, tmp.data());
+		setIndexData(stdQuadElementBuffer, tmp.data(), tmp.size());
 	} else {
-		elementBuffer.setData(gsl::as_bytes(gsl::span<unsigned short>(indices, numIndices)));
+		stdQuadElementBuffer.bind();
 	}
+}
 
-	// Load vertices into VBO
-	size_t bytesSize = numVertices * material.getVertexStride();
-	vertexBuffer.setData(gsl::as_bytes(gsl::span<char>(static_cast<char*>(vertexData), bytesSize)));
+void PainterOpenGL::setIndexData(GLBuffer& buffer, const IndexType* indices, size_t numIndices)
+{
+	if (glIndexType == GL_UNSIGNED_INT) {
+		buffer.setData(gsl::as_bytes(gsl::span<const IndexType>(indices, numIndices)));
+	} else {
+		// Batches are small enough for this not to lose anything, see Painter::supports32BitIndices
+		narrowIndices.resize(numIndices);
+		for (size_t i = 0; i < numIndices; ++i) {
+			narrowIndices[i] = static_cast<unsigned short>(indices[i]);
+		}
+		buffer.setData(gsl::as_bytes(gsl::span<const unsigned short>(narrowIndices)));
+	}
+}
 
-	// Set attributes
-	setupVertexAttributes(material);
+size_t PainterOpenGL::uploadVertices(void* vertexData, size_t bytesSize, GLuint& buffer)
+{
+	// Unless the Painter already wrote them to the stream
+	if (vertexStream.isMapped(vertexData)) {
+		const size_t baseOffset = vertexStream.commit(bytesSize);
+		vertexStream.bind();
+		buffer = vertexStream.getName();
+		return baseOffset;
+	} else {
+		vertexBuffer.setData(gsl::as_bytes(gsl::span<char>(static_cast<char*>(vertexData), bytesSize)));
+		buffer = vertexBuffer.getName();
+		return 0;
+	}
 }
 
-void PainterOpenGL::setupVertexAttributes(const MaterialDefinition& material)
+void PainterOpenGL::bindVertexAttributes(const MaterialDefinition& material, GLuint buffer, size_t baseOffset, bool instanced)
+{
+#ifdef WITH_OPENGL
+	// Vertices are drawn from a base vertex, so only where they start within a vertex affects the attributes (and streamed batches mostly
+	// share a handful of those). Instances can't be offset like that, so their attributes are moved instead, keeping the same array.
+	const size_t stride = material.getVertexStride();
+	const size_t attributeOffset = instanced ? baseOffset : baseOffset % stride;
+	baseVertex = instanced ? 0 : GLint(baseOffset / stride);
+
+	Hash::Hasher hasher;
+	hasher.feed(buffer);
+	hasher.feed(stride);
+	hasher.feed(instanced ? size_t(0) : attributeOffset);
+	hasher.feed(instanced);
+	for (auto& attribute: material.getAttributes()) {
+		hasher.feed(attribute.location);
+		hasher.feed(attribute.type);
+		hasher.feed(attribute.offset);
+		hasher.feed(attribute.instanced);
+	}
+
+	auto& vertexArray = vertexArrays[hasher.digest()];
+	vertexArray.lastFrame = frameNumber;
+	if (vertexArray.vao == 0) {
+		glGenVertexArrays(1, &vertexArray.vao);
+		glBindVertexArray(vertexArray.vao);
+		vertexArray.vertexBuffer = buffer;
+
+		if (instanced) {
+			quadVertexBuffer.bind();
+			for (auto& attribute: material.getAttributes()) {
+				if (!attribute.instanced) {
+					glEnableVertexAttribArray(attribute.location);
+					glVertexAttribPointer(attribute.location, 4, GL_FLOAT, GL_FALSE, GLsizei(sizeof(Vector4f)), nullptr);
+					glVertexAttribDivisor(attribute.location, 0);
+				}
+			}
+			glBindBuffer(GL_ARRAY_BUFFER, buffer);
+		}
+		setupVertexAttributes(material, attributeOffset, instanced);
+		vertexArray.attributeOffset = attributeOffset;
+	} else {
+		glBindVertexArray(vertexArray.vao);
+		if (vertexArray.attributeOffset != attributeOffset) {
+			setupVertexAttributes(material, attributeOffset, instanced);
+			vertexArray.attributeOffset = attributeOffset;
+		}
+	}
+	glCheckError();
+#else
+	setupVertexAttributes(material, baseOffset, instanced);
+#endif
+}
+
+char* PainterOpenGL::beginVertexStream(size_t minBytes, size_t& capacity)
+{
+	return vertexStream.map(minBytes, capacity);
+}
+
+void PainterOpenGL::setupVertexAttributes(const MaterialDefinition& material, size_t baseOffset, bool instanced)
 {
 	// Set vertex attribute pointers in VBO
 	size_t vertexStride = material.getVertexStride();
 	for (auto& attribute : material.getAttributes()) {
+		if (instanced && !attribute.instanced) {
+			// Set by setInstances
+			continue;
+		}
+
 		int count = 0;
 		int type = 0;
 		switch (attribute.type) {
@@ -205,8 +489,11 @@ void PainterOpenGL::setupVertexAttributes(const MaterialDefinition& material)
 			break;
 		}
 		glEnableVertexAttribArray(attribute.location);
-		size_t offset = attribute.offset;
+		size_t offset = baseOffset + attribute.offset;
 		glVertexAttribPointer(attribute.location, count, type, GL_FALSE, GLsizei(vertexStride), reinterpret_cast<GLvoid*>(offset));
+#ifdef WITH_OPENGL
+		glVertexAttribDivisor(attribute.location, instanced ? 1 : 0);
+#endif
 		glCheckError();
 	}
 
@@ -218,6 +505,31 @@ void PainterOpenGL::drawTriangles(size_t numIndices)
 	Expects(numIndices > 0);
 	Expects(numIndices % 3 == 0);
 
-	glDrawElements(GL_TRIANGLES, int(numIndices), GL_UNSIGNED_SHORT, nullptr);
+#ifdef WITH_OPENGL
+	glDrawElementsBaseVertex(GL_TRIANGLES, int(numIndices), glIndexType, nullptr, baseVertex);
+#else
+	glDrawElements(GL_TRIANGLES, int(numIndices), glIndexType, nullptr);
+#endif
 	glCheckError();
 }
+
+bool PainterOpenGL::supports32BitIndices() const
+{
+	return glIndexType == GL_UNSIGNED_INT;
+}
+
+size_t PainterOpenGL::getMaxBatchBytes() const
+{
+	// So that a batch always fits in what's left of a fresh stream segment
+	return vertexStreamSegmentSize;
+}
+
+void PainterOpenGL::drawInstancedQuads(size_t numInstances)
+{
+	Expects(numInstances > 0);
+
+#ifdef WITH_OPENGL
+	glDrawElementsInstanced(GL_TRIANGLES, 6, glIndexType, nullptr, GLsizei(numInstances));
+	glCheckError();
+#endif
+}
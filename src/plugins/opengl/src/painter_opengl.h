@@ -3,6 +3,7 @@
 #include "halley/core/graphics/painter.h"
 #include "halley_gl.h"
 #include "gl_buffer.h"
+#include <halley/data_structures/hash_map.h>
 
 namespace Halley
 {
@@ -17,28 +18,73 @@ namespace Halley
 
 		void doStartRender() override;
 		void doEndRender() override;
+		void doClear(Maybe<Colour> colour, Maybe<float> depth, Maybe<uint8_t> stencil) override;
 
-		void clear(Colour colour) override;
 		void setMaterialPass(const Material& material, int pass) override;
 		void setMaterialData(const Material& material) override;
 
 		void setClip(Rect4i clip, bool enable) override;
 
 	protected:
-		void setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, unsigned short* indices, bool standardQuadsOnly) override;
+		void setVertices(const MaterialDefinition& material, size_t numVertices, void* vertexData, size_t numIndices, IndexType* indices, bool standardQuadsOnly) override;
+		char* beginVertexStream(size_t minBytes, size_t& capacity) override;
 		void drawTriangles(size_t numIndices) override;
+		bool supports32BitIndices() const override;
+		size_t getMaxBatchBytes() const override;
+
+		bool supportsInstancing() const override;
+		void setInstances(const MaterialDefinition& material, size_t numInstances, void* instanceData) override;
+		void drawInstancedQuads(size_t numInstances) override;
+
+		bool supportsStaticVertices() const override;
+		void setStaticVertices(const MaterialDefinition& material, const std::shared_ptr<const StaticVertexBuffer>& buffer) override;
+
+		bool supportsGPUTimers() const override;
+		void writeGPUTimestamp(size_t frame, size_t idx) override;
+		bool readGPUTimestamps(size_t frame, size_t count, Vector<int64_t>& dst) override;
+
 		void setViewPort(Rect4i rect) override;
 		void onUpdateProjection(Material& material) override;
 
 	private:
 #ifdef WITH_OPENGL
 		GLuint vao = 0;
+		std::array<std::vector<GLuint>, gpuTimerFrames> timestampQueries; // GL_TIMESTAMP queries, created as they're first needed
+
+		// A vertex array per attribute layout and vertex buffer, so draws bind one instead of specifying every attribute again
+		struct VertexArray
+		{
+			GLuint vao = 0;
+			GLuint vertexBuffer = 0;
+			size_t attributeOffset = 0;
+			uint64_t lastFrame = 0;
+		};
+		HashMap<uint64_t, VertexArray> vertexArrays;
+		GLint baseVertex = 0;
+		uint64_t frameNumber = 0;
 #endif
 		GLBuffer vertexBuffer;
+		GLStreamBuffer vertexStream;
 		GLBuffer elementBuffer;
 		GLBuffer stdQuadElementBuffer;
+		GLBuffer quadVertexBuffer;
 		std::unique_ptr<GLUtils> glUtils;
+		std::vector<uint64_t> boundBlocks; // Bind stamp of the constant buffer at each bind point
+		std::vector<unsigned short> narrowIndices;
+
+		struct StaticBuffer
+		{
+			std::weak_ptr<const StaticVertexBuffer> owner;
+			std::unique_ptr<GLBuffer> buffer;
+		};
+		HashMap<uint64_t, StaticBuffer> staticBuffers; // By StaticVertexBuffer id, deleted once the buffer is gone
 
-		void setupVertexAttributes(const MaterialDefinition& material);
+		void bindStandardQuadIndices(size_t numIndices);
+		void setIndexData(GLBuffer& buffer, const IndexType* indices, size_t numIndices);
+		size_t uploadVertices(void* vertexData, size_t bytesSize, GLuint& buffer);
+		void bindVertexAttributes(const MaterialDefinition& material, GLuint buffer, size_t baseOffset, bool instanced);
+		void setupVertexAttributes(const MaterialDefinition& material, size_t baseOffset, bool instanced);
+		void releaseStaticBuffers();
+		void releaseVertexArrays(bool all);
 	};
 }
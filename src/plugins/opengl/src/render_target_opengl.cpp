@@ -52,7 +52,12 @@ void TextureRenderTargetOpenGL::init()
 			glCheckError();
 		}
 		if (depth) {
-			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, dynamic_cast<TextureOpenGL&>(*depth).getNativeId(), 0);
+#ifdef WITH_OPENGL
+			const GLenum depthAttachment = GL_DEPTH_STENCIL_ATTACHMENT;
+#else
+			const GLenum depthAttachment = GL_DEPTH_ATTACHMENT;
+#endif
+			glFramebufferTexture2D(GL_FRAMEBUFFER, depthAttachment, GL_TEXTURE_2D, dynamic_cast<TextureOpenGL&>(*depth).getNativeId(), 0);
 			glCheckError();
 		}
 
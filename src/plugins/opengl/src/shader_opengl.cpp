@@ -3,6 +3,9 @@
 #include "halley/support/console.h"
 #include "shader_opengl.h"
 #include "halley/core/graphics/material/material_definition.h"
+#include "halley/core/api/save_data.h"
+#include "halley/utils/hash.h"
+#include "halley/support/logger.h"
 #include "gl_utils.h"
 #include "halley_gl.h"
 
@@ -14,15 +17,123 @@ static ShaderOpenGL* currentShader = nullptr;
 #pragma warning(disable: 4996)
 #endif
 
-ShaderOpenGL::ShaderOpenGL(const ShaderDefinition& definition)
+ProgramBinaryCacheOpenGL::ProgramBinaryCacheOpenGL(std::shared_ptr<ISaveData> storage)
+	: storage(std::move(storage))
+{
+	for (auto str: { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+		auto value = glGetString(str);
+		driverId += String(value ? reinterpret_cast<const char*>(value) : "") + "\n";
+	}
+	glCheckError();
+}
+
+bool ProgramBinaryCacheOpenGL::isSupported()
+{
+#ifdef WITH_OPENGL
+	if (ogl_ext_ARB_get_program_binary != ogl_LOAD_SUCCEEDED) {
+		return false;
+	}
+	int nFormats = 0;
+	glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &nFormats);
+	glCheckError();
+	return nFormats > 0;
+#else
+	return false;
+#endif
+}
+
+String ProgramBinaryCacheOpenGL::getKey(const ShaderDefinition& definition) const
+{
+	Hash::Hasher hasher;
+	hasher.feedBytes(gsl::as_bytes(gsl::span<const char>(driverId.c_str(), driverId.size())));
+	for (auto& s: definition.shaders) {
+		hasher.feed(int(s.first));
+		hasher.feed(uint64_t(s.second.size()));
+		hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(s.second)));
+	}
+	for (auto& a: definition.vertexAttributes) {
+		hasher.feed(a.location);
+		hasher.feedBytes(gsl::as_bytes(gsl::span<const char>(a.name.c_str(), a.name.size())));
+	}
+	return "gl_" + toString(hasher.digest(), 16);
+}
+
+bool ProgramBinaryCacheOpenGL::load(const String& key, unsigned int program)
+{
+#ifdef WITH_OPENGL
+	Bytes data;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		data = storage->getData(key);
+	}
+	if (data.size() <= sizeof(uint32_t)) {
+		return false;
+	}
+
+	uint32_t format;
+	memcpy(&format, data.data(), sizeof(format));
+	glProgramBinary(program, GLenum(format), data.data() + sizeof(format), GLsizei(data.size() - sizeof(format)));
+	glGetError(); // Formats the driver doesn't take anymore are an error, but just mean compiling again
+
+	int result = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &result);
+	glCheckError();
+	return result == GL_TRUE;
+#else
+	return false;
+#endif
+}
+
+void ProgramBinaryCacheOpenGL::store(const String& key, unsigned int program)
+{
+#ifdef WITH_OPENGL
+	int length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	glCheckError();
+	if (length <= 0) {
+		return;
+	}
+
+	Bytes data(sizeof(uint32_t) + size_t(length));
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, data.data() + sizeof(uint32_t));
+	glCheckError();
+	const uint32_t format32 = uint32_t(format);
+	memcpy(data.data(), &format32, sizeof(format32));
+	data.resize(sizeof(uint32_t) + size_t(length));
+
+	try {
+		std::unique_lock<std::mutex> lock(mutex);
+		storage->setData(key, data);
+	} catch (std::exception& e) {
+		Logger::logWarning("Unable to store program binary: " + String(e.what()));
+	}
+#endif
+}
+
+ShaderOpenGL::ShaderOpenGL(const ShaderDefinition& definition, ProgramBinaryCacheOpenGL* binaryCache)
 {
 	id = glCreateProgram();
 	glCheckError();	
 
 	name = definition.name;
 	setAttributes(definition.vertexAttributes);
+
+	String cacheKey;
+	if (binaryCache) {
+		cacheKey = binaryCache->getKey(definition);
+		if (binaryCache->load(cacheKey, id)) {
+			onLinked();
+			return;
+		}
+	}
+
 	loadShaders(definition.shaders);
-	compile();
+	compile(binaryCache != nullptr);
+
+	if (binaryCache) {
+		binaryCache->store(cacheKey, id);
+	}
 }
 
 ShaderOpenGL::~ShaderOpenGL()
@@ -39,6 +150,8 @@ void ShaderOpenGL::bind()
 		glUseProgram(id);
 		glCheckError();
 		currentShader = this;
+	} else {
+		GLUtils().logElidedCall();
 	}
 }
 
@@ -114,7 +227,7 @@ void ShaderOpenGL::loadShaders(const std::map<ShaderType, Bytes>& sources)
 	}
 }
 
-void ShaderOpenGL::compile()
+void ShaderOpenGL::compile(bool retrievable)
 {
 	if (!ready) {
 		// Create program
@@ -122,6 +235,12 @@ void ShaderOpenGL::compile()
 			glAttachShader(id, shaders[i]);
 			glCheckError();
 		}
+#ifdef WITH_OPENGL
+		if (retrievable) {
+			glProgramParameteri(id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+			glCheckError();
+		}
+#endif
 		glLinkProgram(id);
 		glCheckError();
 
@@ -146,12 +265,19 @@ void ShaderOpenGL::compile()
 			std::cout << ConsoleColour(Console::YELLOW) << "\nIn shader \"" << name << "\":\n==========\n" << log << "\n==========" << ConsoleColour() << std::endl;
 		}
 
-		uniformLocations.clear();
-		attributeLocations.clear();
-		ready = true;
+		onLinked();
 	}
 }
 
+void ShaderOpenGL::onLinked()
+{
+	uniformLocations.clear();
+	attributeLocations.clear();
+	blockBindings.clear();
+	textureUnits.clear();
+	ready = true;
+}
+
 void ShaderOpenGL::destroy()
 {
 	if (ready) {
@@ -167,6 +293,10 @@ void ShaderOpenGL::destroy()
 		}
 	}
 
+	if (currentShader == this) {
+		currentShader = nullptr;
+	}
+
 	if (id != 0) {
 		glDeleteProgram(id);
 		glCheckError();
@@ -176,8 +306,30 @@ void ShaderOpenGL::destroy()
 
 void ShaderOpenGL::setUniformBlockBinding(unsigned int blockIndex, unsigned int binding)
 {
+	if (blockBindings.size() <= blockIndex) {
+		blockBindings.resize(blockIndex + 1, -1);
+	}
+	if (blockBindings[blockIndex] == int(binding)) {
+		GLUtils().logElidedCall();
+		return;
+	}
+
 	glUniformBlockBinding(id, blockIndex, binding);
 	glCheckError();
+	blockBindings[blockIndex] = int(binding);
+}
+
+void ShaderOpenGL::setTextureUnit(int location, int textureUnit)
+{
+	auto iter = textureUnits.find(location);
+	if (iter != textureUnits.end() && iter->second == textureUnit) {
+		GLUtils().logElidedCall();
+		return;
+	}
+
+	glUniform1i(location, textureUnit);
+	glCheckError();
+	textureUnits[location] = textureUnit;
 }
 
 int ShaderOpenGL::getUniformLocation(const String& name, ShaderType stage)
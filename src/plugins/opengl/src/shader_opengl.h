@@ -2,19 +2,42 @@
 
 #include "halley/core/graphics/shader.h"
 #include <halley/data_structures/hash_map.h>
+#include <memory>
+#include <mutex>
 
 namespace Halley
 {
+	class ISaveData;
+
+	// Keeps linked programs from previous runs, so they don't have to be compiled and linked again.
+	// Entries are keyed on the driver as well as on the sources, since drivers reject binaries from other versions.
+	class ProgramBinaryCacheOpenGL
+	{
+	public:
+		explicit ProgramBinaryCacheOpenGL(std::shared_ptr<ISaveData> storage); // Needs a current context
+		static bool isSupported();
+
+		String getKey(const ShaderDefinition& definition) const;
+		bool load(const String& key, unsigned int program);
+		void store(const String& key, unsigned int program);
+
+	private:
+		std::shared_ptr<ISaveData> storage;
+		String driverId;
+		std::mutex mutex;
+	};
+
 	class ShaderOpenGL final : public Shader
 	{
 	public:
-		explicit ShaderOpenGL(const ShaderDefinition& definition);
+		explicit ShaderOpenGL(const ShaderDefinition& definition, ProgramBinaryCacheOpenGL* binaryCache = nullptr);
 		~ShaderOpenGL();
 
 		void bind();
 		void unbind();
 		void destroy();
 		void setUniformBlockBinding(unsigned int blockIndex, unsigned int binding);
+		void setTextureUnit(int location, int textureUnit); // Shader must be bound
 
 		int getUniformLocation(const String& name, ShaderType stage) override;
 		int getBlockLocation(const String& name, ShaderType stage) override;
@@ -32,10 +55,15 @@ namespace Halley
 		HashMap<String, unsigned int> uniformLocations;
 		HashMap<String, unsigned int> blockLocations;
 
+		// What's been set on the linked program, to skip redundant calls
+		Vector<int> blockBindings;
+		HashMap<int, int> textureUnits;
+
 		String name;
 
 		void loadShaders(const std::map<ShaderType, Bytes>& shaders);
-		void compile();
+		void compile(bool retrievable = false);
+		void onLinked();
 		void setAttributes(const Vector<MaterialAttribute>& attributes);
 	};
 }
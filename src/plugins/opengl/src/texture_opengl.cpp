@@ -7,11 +7,85 @@
 #include "video_opengl.h"
 #include "halley/support/logger.h"
 #include "halley/text/string_converter.h"
+#include <cstring>
+#include "halley/support/memory_tracker.h"
+
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
 
 using namespace Halley;
 
+namespace {
+	// Pixel data for a single upload, staged in a pixel unpack buffer when on the loader thread.
+	// That lets the driver schedule the copy into the texture instead of reading client memory there and then;
+	// the buffer can be deleted straight away, as GL keeps it alive until the copy is done.
+	class PixelSource {
+	public:
+		PixelSource(gsl::span<const gsl::byte> data, bool stage)
+			: data(reinterpret_cast<const char*>(data.data()))
+		{
+#ifdef WITH_OPENGL
+			if (stage && !data.empty()) {
+				const auto size = GLsizeiptr(data.size());
+				glGenBuffers(1, &buffer);
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+				glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+				void* dst = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+				if (dst) {
+					memcpy(dst, data.data(), size_t(size));
+					staged = glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+				}
+				if (!staged) {
+					// Mapping can fail (or the contents get lost when unmapping), fall back to client memory
+					release();
+				}
+				glCheckError();
+			}
+#endif
+		}
+
+		~PixelSource()
+		{
+			release();
+		}
+
+		PixelSource(const PixelSource& other) = delete;
+		PixelSource& operator=(const PixelSource& other) = delete;
+
+		const void* at(size_t offset) const
+		{
+			if (staged) {
+				return reinterpret_cast<const void*>(offset);
+			}
+			return data ? data + offset : nullptr;
+		}
+
+	private:
+		const char* data;
+		unsigned int buffer = 0;
+		bool staged = false;
+
+		void release()
+		{
+#ifdef WITH_OPENGL
+			if (buffer != 0) {
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+				glDeleteBuffers(1, &buffer);
+				buffer = 0;
+				staged = false;
+			}
+#endif
+		}
+	};
+}
+
 TextureOpenGL::TextureOpenGL(VideoOpenGL& parent, Vector2i size)
 	: Texture(size)
+	, target(GL_TEXTURE_2D)
 	, parent(parent)
 {
 	glGenTextures(1, &textureId);
@@ -22,18 +96,24 @@ TextureOpenGL::~TextureOpenGL()
 {
 	waitForOpenGLLoad();
 	if (textureId != 0) {
+		GLUtils::onTextureDeleted();
 		glDeleteTextures(1, &textureId);
 		textureId = 0;
 	}
+	MemoryTracker::onFree(MemoryTags::GPUTextures, gpuBytes);
 }
 
 TextureOpenGL& TextureOpenGL::operator=(TextureOpenGL&& other) noexcept
 {
 	other.waitForOpenGLLoad();
 
+	// Swap, so that the other one deletes the previous texture
 	size = other.size;
-	textureId = other.textureId;
+	std::swap(textureId, other.textureId);
+	std::swap(gpuBytes, other.gpuBytes);
 	texSize = other.texSize;
+	target = other.target;
+	layers = other.layers;
 
 	doneLoading();
 
@@ -42,11 +122,39 @@ TextureOpenGL& TextureOpenGL::operator=(TextureOpenGL&& other) noexcept
 
 void TextureOpenGL::load(TextureDescriptor&& d)
 {
+	Expects(d.layers >= 1);
+	if (texSize != d.size || layers != d.layers) {
+		if (texSize != Vector2i() && (d.layers > 1) != (layers > 1)) {
+			// A texture name can't change target once it's been bound
+			GLUtils::onTextureDeleted();
+			glDeleteTextures(1, &textureId);
+			glGenTextures(1, &textureId);
+		}
+		layers = d.layers;
+#ifdef WITH_OPENGL
+		target = layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+#else
+		if (layers > 1) {
+			throw Exception("Texture arrays are not supported on OpenGL ES", HalleyExceptions::VideoPlugin);
+		}
+#endif
+		texSize = Vector2i();
+	}
+
 	GLUtils glUtils;
-	glUtils.bindTexture(textureId);
+	glUtils.bindTexture(textureId, target);
 	
 	if (texSize != d.size) {
 		create(d.size, d.format, d.useMipMap, d.useFiltering, d.clamp, d.pixelData);
+
+		// Roughly what the driver holds on to, ignoring padding
+		MemoryTracker::onFree(MemoryTags::GPUTextures, gpuBytes);
+		gpuBytes = 0;
+		const int levels = d.useMipMap ? TextureDescriptor::getNumMipLevels(d.size) : 1;
+		for (int level = 0; level < levels; ++level) {
+			gpuBytes += TextureDescriptor::getLevelByteSize(TextureDescriptor::getMipLevelSize(d.size, level), d.format) * size_t(layers);
+		}
+		MemoryTracker::onAlloc(MemoryTags::GPUTextures, gpuBytes);
 	} else if (!d.pixelData.empty()) {
 		updateImage(d.pixelData, d.format, d.useMipMap);
 	}
@@ -81,18 +189,15 @@ void TextureOpenGL::waitForOpenGLLoad() const
 
 #ifdef WITH_OPENGL
 	if (fence) {
-		GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, GLuint64(10000000000));
-		if (result == GL_TIMEOUT_EXPIRED) {
-			//throw Exception("Timeout waiting for texture to load.");
-			Logger::logError("Timeout waiting for texture fence to sync. Graphics might be corrupted.");
-		}
-		else if (result == GL_WAIT_FAILED) {
+		// The loader thread already flushed, so have this context's command stream wait on the GPU instead of stalling here
+		const GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result == GL_WAIT_FAILED) {
 			glCheckError();
+		} else if (result == GL_TIMEOUT_EXPIRED) {
+			glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
 		}
-		else if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
-			glDeleteSync(fence);
-			fence = nullptr;
-		}
+		glDeleteSync(fence);
+		fence = nullptr;
 	}
 #endif
 }
@@ -103,7 +208,7 @@ void TextureOpenGL::bind(int textureUnit) const
 	waitForOpenGLLoad();
 	GLUtils glUtils;
 	glUtils.setTextureUnit(textureUnit);
-	glUtils.bindTexture(textureId);
+	glUtils.bindTexture(textureId, target);
 }
 
 void TextureOpenGL::create(Vector2i size, TextureFormat format, bool useMipMap, bool useFiltering, bool clamp, TextureDescriptorImageData& pixelData)
@@ -112,75 +217,203 @@ void TextureOpenGL::create(Vector2i size, TextureFormat format, bool useMipMap,
 	Expects(size.y > 0);
 	Expects(size.x <= 4096);
 	Expects(size.y <= 4096);
+	Expects(layers == 1 || format != TextureFormat::DEPTH);
 	glCheckError();
 
 #ifdef WITH_OPENGL
 	GLuint pixFormat = GL_UNSIGNED_BYTE;
 
 	if (useMipMap) {
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, -1);
+		glTexParameteri(target, GL_TEXTURE_LOD_BIAS, -1);
 	}
 
 	GLuint wrap = clamp ? GL_CLAMP_TO_EDGE : GL_REPEAT;
 
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+	glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+	glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
 #else
 	GLuint pixFormat = GL_UNSIGNED_BYTE;
 #endif
 	int filtering = useFiltering ? GL_LINEAR : GL_NEAREST;
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, useMipMap ? GL_LINEAR_MIPMAP_LINEAR : filtering);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filtering);
+	glTexParameteri(target, GL_TEXTURE_MIN_FILTER, useMipMap ? GL_LINEAR_MIPMAP_LINEAR : filtering);
+	glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filtering);
 
 #ifdef WITH_OPENGL
 	if (format == TextureFormat::DEPTH) {
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+		glTexParameteri(target, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+		glTexParameteri(target, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
 	}
 #endif
 
+	if (TextureDescriptor::isCompressed(format)) {
+		if (pixelData.empty()) {
+			throw Exception("Block-compressed textures must be created with their data", HalleyExceptions::VideoPlugin);
+		}
+		uploadLevels(size, format, useMipMap, pixelData, false);
+		texSize = size;
+		return;
+	}
+
 	GLuint glFormat = getGLFormat(format);
-	GLuint format2 = glFormat;
+	GLuint format2 = getGLDataFormat(format);
 	int stride = pixelData.empty() ? size.x : pixelData.getStrideOr(size.x);
 #ifdef WITH_OPENGL
-	if (format2 == GL_RGBA16F || format2 == GL_RGBA16) format2 = GL_RGBA;
-	if (format2 == GL_DEPTH_COMPONENT24) format2 = GL_DEPTH_COMPONENT;
 	glPixelStorei(GL_UNPACK_ALIGNMENT, TextureDescriptor::getBitsPerPixel(format));
 	glPixelStorei(GL_PACK_ROW_LENGTH, stride);
-#else
-	if (format2 == GL_DEPTH_COMPONENT16) format2 = GL_DEPTH_COMPONENT;
 #endif
 
-	if (pixelData.empty()) {
+	if (format == TextureFormat::DEPTH) {
+		// Depth attachments are never uploaded to, so they just need allocating
+		glTexImage2D(GL_TEXTURE_2D, 0, glFormat, size.x, size.y, 0, format2, getGLPixelType(format), nullptr);
+		glCheckError();
+	} else if (pixelData.empty()) {
 		Vector<char> blank;
-		blank.resize(size.x * size.y * TextureDescriptor::getBitsPerPixel(format));
-		glTexImage2D(GL_TEXTURE_2D, 0, glFormat, size.x, size.y, 0, format2, pixFormat, blank.data());
+		blank.resize(size.x * size.y * layers * TextureDescriptor::getBitsPerPixel(format));
+		if (layers > 1) {
+#ifdef WITH_OPENGL
+			glTexImage3D(target, 0, glFormat, size.x, size.y, layers, 0, format2, pixFormat, blank.data());
+#endif
+		} else {
+			glTexImage2D(GL_TEXTURE_2D, 0, glFormat, size.x, size.y, 0, format2, pixFormat, blank.data());
+		}
+		glCheckError();
 	} else {
-		glTexImage2D(GL_TEXTURE_2D, 0, glFormat, size.x, size.y, 0, format2, pixFormat, pixelData.getBytes());
+		uploadLevels(size, format, useMipMap, pixelData, false);
 	}
-	glCheckError();
 
 	texSize = size;
 }
 
 void TextureOpenGL::updateImage(TextureDescriptorImageData& pixelData, TextureFormat format, bool useMipMap)
 {
-	int stride = pixelData.getStrideOr(size.x);
+	if (!TextureDescriptor::isCompressed(format)) {
+		int stride = pixelData.getStrideOr(texSize.x);
+#ifdef WITH_OPENGL
+		glPixelStorei(GL_UNPACK_ALIGNMENT, TextureDescriptor::getBitsPerPixel(format));
+		glPixelStorei(GL_PACK_ROW_LENGTH, stride);
+#endif
+	}
+
+	uploadLevels(texSize, format, useMipMap, pixelData, true);
+}
+
+void TextureOpenGL::uploadLevels(Vector2i size, TextureFormat format, bool useMipMap, const TextureDescriptorImageData& pixelData, bool update)
+{
+	// Uses whatever mip levels the importer stored; mipmaps can't be generated for compressed formats, so that's all there is for those.
+	// Each layer of an array has the same levels, and they're stored one layer after the other.
+	const auto data = pixelData.getSpan();
+	const bool compressed = TextureDescriptor::isCompressed(format);
+	const GLenum glFormat = getGLFormat(format);
+	const GLenum dataFormat = getGLDataFormat(format);
+	const int maxLevels = useMipMap ? TextureDescriptor::getNumMipLevels(size) : 1;
+	const size_t layerBytes = size_t(data.size()) / size_t(layers);
 
+	int numLevels = 0;
+	for (size_t total = 0; numLevels < maxLevels; ++numLevels) {
+		total += TextureDescriptor::getLevelByteSize(TextureDescriptor::getMipLevelSize(size, numLevels), format);
+		if (total > layerBytes) {
+			break;
+		}
+	}
+	if (numLevels == 0) {
+		throw Exception("Not enough data for a " + toString(size.x) + "x" + toString(size.y) + " " + toString(format) + " texture", HalleyExceptions::VideoPlugin);
+	}
+
+	if (layers > 1 && !update) {
+		// Before staging, as allocating with a pixel unpack buffer bound would read from it
+		const bool generate = !compressed && useMipMap && numLevels == 1;
+		allocateLayers(size, format, generate ? 1 : numLevels);
+	}
+	PixelSource src(data, parent.isLoaderThread());
+
+	size_t pos = 0;
+	for (int level = 0; level < numLevels; ++level) {
+		const auto levelSize = TextureDescriptor::getMipLevelSize(size, level);
+		const size_t bytes = TextureDescriptor::getLevelByteSize(levelSize, format);
+		if (layers > 1) {
 #ifdef WITH_OPENGL
-	glPixelStorei(GL_UNPACK_ALIGNMENT, TextureDescriptor::getBitsPerPixel(format));
-	glPixelStorei(GL_PACK_ROW_LENGTH, stride);
+			for (int layer = 0; layer < layers; ++layer) {
+				const auto layerSrc = src.at(size_t(layer) * layerBytes + pos);
+				if (compressed) {
+					glCompressedTexSubImage3D(target, level, 0, 0, layer, levelSize.x, levelSize.y, 1, glFormat, GLsizei(bytes), layerSrc);
+				} else {
+					glTexSubImage3D(target, level, 0, 0, layer, levelSize.x, levelSize.y, 1, dataFormat, GL_UNSIGNED_BYTE, layerSrc);
+				}
+			}
 #endif
-	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.x, size.y, getGLFormat(format), GL_UNSIGNED_BYTE, pixelData.getBytes());
-	glCheckError();
+		} else if (compressed) {
+			if (update) {
+				glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, levelSize.x, levelSize.y, glFormat, GLsizei(bytes), src.at(pos));
+			} else {
+				glCompressedTexImage2D(GL_TEXTURE_2D, level, glFormat, levelSize.x, levelSize.y, 0, GLsizei(bytes), src.at(pos));
+			}
+		} else {
+			if (update) {
+				glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, levelSize.x, levelSize.y, dataFormat, GL_UNSIGNED_BYTE, src.at(pos));
+			} else {
+				glTexImage2D(GL_TEXTURE_2D, level, glFormat, levelSize.x, levelSize.y, 0, dataFormat, GL_UNSIGNED_BYTE, src.at(pos));
+			}
+		}
+		glCheckError();
+		pos += bytes;
+	}
 
+	int level = numLevels;
+	if (!compressed && useMipMap && level == 1 && maxLevels > 1) {
 #ifndef WITH_OPENGL_ES
-	// Generate mipmap
-	if (useMipMap) {
-		glGenerateMipmap(GL_TEXTURE_2D);
+		// Only the top level was supplied (e.g. from a PNG), so have the driver make the rest
+		glGenerateMipmap(target);
 		glCheckError();
+		level = maxLevels;
+#endif
+	}
+
+#ifdef GL_TEXTURE_MAX_LEVEL
+	glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, level - 1);
+#endif
+}
+
+void TextureOpenGL::allocateLayers(Vector2i size, TextureFormat format, int levels)
+{
+#ifdef WITH_OPENGL
+	const GLenum glFormat = getGLFormat(format);
+	for (int level = 0; level < levels; ++level) {
+		const auto levelSize = TextureDescriptor::getMipLevelSize(size, level);
+		if (TextureDescriptor::isCompressed(format)) {
+			const size_t bytes = TextureDescriptor::getLevelByteSize(levelSize, format) * size_t(layers);
+			glCompressedTexImage3D(target, level, glFormat, levelSize.x, levelSize.y, layers, 0, GLsizei(bytes), nullptr);
+		} else {
+			glTexImage3D(target, level, glFormat, levelSize.x, levelSize.y, layers, 0, getGLDataFormat(format), GL_UNSIGNED_BYTE, nullptr);
+		}
+		glCheckError();
+	}
+#endif
+}
+
+unsigned TextureOpenGL::getGLDataFormat(TextureFormat format)
+{
+	GLuint result = getGLFormat(format);
+#ifdef WITH_OPENGL
+	if (result == GL_RGBA16F || result == GL_RGBA16) result = GL_RGBA;
+	if (result == GL_DEPTH24_STENCIL8) result = GL_DEPTH_STENCIL;
+#else
+	if (result == GL_DEPTH_COMPONENT16) result = GL_DEPTH_COMPONENT;
+#endif
+	return result;
+}
+
+unsigned TextureOpenGL::getGLPixelType(TextureFormat format)
+{
+#ifdef WITH_OPENGL
+	if (format == TextureFormat::DEPTH) {
+		return GL_UNSIGNED_INT_24_8;
+	}
+#else
+	if (format == TextureFormat::DEPTH) {
+		return GL_UNSIGNED_SHORT;
 	}
 #endif
+	return GL_UNSIGNED_BYTE;
 }
 
 unsigned TextureOpenGL::getGLFormat(TextureFormat format)
@@ -194,10 +427,14 @@ unsigned TextureOpenGL::getGLFormat(TextureFormat format)
 		return GL_RGBA;
 	case TextureFormat::DEPTH:
 #ifdef WITH_OPENGL
-		return GL_DEPTH_COMPONENT24;
+		return GL_DEPTH24_STENCIL8;
 #else
 		return GL_DEPTH_COMPONENT16;
 #endif
+	case TextureFormat::BC1:
+		return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case TextureFormat::BC3:
+		return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
 	default:
 		throw Exception("Unknown texture format: " + toString(static_cast<int>(format)), HalleyExceptions::VideoPlugin);
 	}
@@ -26,14 +26,20 @@ namespace Halley
 	private:
 		void updateImage(TextureDescriptorImageData& pixelData, TextureFormat format, bool useMipMap);
 		void create(Vector2i size, TextureFormat format, bool useMipMap, bool useFiltering, bool clamp, TextureDescriptorImageData& imgData);
+		void uploadLevels(Vector2i size, TextureFormat format, bool useMipMap, const TextureDescriptorImageData& pixelData, bool update);
+		void allocateLayers(Vector2i size, TextureFormat format, int levels);
 
 		static unsigned int getGLFormat(TextureFormat format);
+		static unsigned int getGLDataFormat(TextureFormat format);
+		static unsigned int getGLPixelType(TextureFormat format);
 
 		void waitForOpenGLLoad() const;
 		void finishLoading();
 
 		unsigned int textureId = 0;
+		unsigned int target; // GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY if it has more than one layer
 		Vector2i texSize;
+		size_t gpuBytes = 0; // As reported to MemoryTracker
 		VideoOpenGL& parent;
 #ifdef WITH_OPENGL
 		mutable GLsync fence = nullptr;
@@ -11,6 +11,7 @@
 #include "halley/text/string_converter.h"
 #include "constant_buffer_opengl.h"
 #include "halley/core/graphics/material/uniform_type.h"
+#include "halley/core/api/save_data.h"
 using namespace Halley;
 
 #ifdef _MSC_VER
@@ -36,7 +37,17 @@ void VideoOpenGL::init()
 
 void VideoOpenGL::deInit()
 {
+	uploadQueue.reset();
 	loaderThread.reset();
+	programBinaryCache.reset();
+
+#ifdef WITH_OPENGL
+	if (frameQueries[0] != 0 && contextOwner.load() == std::this_thread::get_id()) {
+		glDeleteQueries(GLsizei(numFrameQueries), frameQueries.data());
+	}
+#endif
+	frameQueries = {};
+	frameQueryPending = {};
 
 	context.reset();
 	system.destroyWindow(window);
@@ -51,6 +62,7 @@ void VideoOpenGL::deInit()
 VideoOpenGL::VideoOpenGL(SystemAPI& system)
 	: system(system)
 	, initialized(false)
+	, gpuFrameTime(0)
 {
 }
 
@@ -72,7 +84,11 @@ void VideoOpenGL::setWindow(WindowDefinition&& windowDefinition)
 		initialized = true;
 	} else {
 		window->update(windowDefinition);
-		clearScreen();
+
+		// If a render thread owns the context, it'll simply draw over the new size
+		if (contextOwner.load() == std::this_thread::get_id()) {
+			clearScreen();
+		}
 	}
 }
 
@@ -101,6 +117,7 @@ void VideoOpenGL::initOpenGL()
 	// Create OpenGL context
 	context = system.createGLContext();
 	context->bind();
+	contextOwner = std::this_thread::get_id();
 	
 	initGLBindings();
 
@@ -129,6 +146,10 @@ void VideoOpenGL::initOpenGL()
 
 	setupDebugCallback();
 
+	if (ProgramBinaryCacheOpenGL::isSupported()) {
+		programBinaryCache = std::make_unique<ProgramBinaryCacheOpenGL>(system.getStorageContainer(SaveDataType::Cache, "shaders"));
+	}
+
 	std::cout << ConsoleColour(Console::GREEN) << "OpenGL init done.\n" << ConsoleColour() << std::endl;
 }
 
@@ -145,6 +166,7 @@ void VideoOpenGL::initGLBindings()
 void VideoOpenGL::startLoaderThread()
 {
 	loaderThread = std::make_unique<LoaderThreadOpenGL>(system, *context);
+	uploadQueue = std::make_unique<TextureUploadQueue>(Executors::getVideoAux());
 }
 
 void VideoOpenGL::setupDebugCallback()
@@ -175,6 +197,7 @@ void VideoOpenGL::onSuspend()
 		glDebugMessageCallback(nullptr, nullptr);
 		glCheckError();
 	}
+	uploadQueue.reset();
 	loaderThread.reset();
 #endif
 }
@@ -185,6 +208,7 @@ void VideoOpenGL::onResume()
 	initGLBindings();
 	setupDebugCallback();
 	startLoaderThread();
+	uploadQueue->createPlaceholder(*this);
 }
 
 void VideoOpenGL::clearScreen()
@@ -364,8 +388,16 @@ String VideoOpenGL::getShaderLanguage()
 	return "glsl";
 }
 
+int64_t VideoOpenGL::getGPUFrameNanoSeconds() const
+{
+	return gpuFrameTime.load(std::memory_order_relaxed);
+}
+
 std::unique_ptr<Painter> VideoOpenGL::makePainter(Resources& resources)
 {
+	if (uploadQueue && !uploadQueue->getPlaceholder()) {
+		uploadQueue->createPlaceholder(*this);
+	}
 	return std::make_unique<PainterOpenGL>(resources);
 }
 
@@ -376,7 +408,7 @@ std::unique_ptr<Texture> VideoOpenGL::createTexture(Vector2i size)
 
 std::unique_ptr<Shader> VideoOpenGL::createShader(const ShaderDefinition& definition)
 {
-	return std::make_unique<ShaderOpenGL>(definition);
+	return std::make_unique<ShaderOpenGL>(definition, programBinaryCache.get());
 }
 
 std::unique_ptr<ScreenRenderTarget> VideoOpenGL::createScreenRenderTarget()
@@ -389,6 +421,31 @@ std::unique_ptr<TextureRenderTarget> VideoOpenGL::createTextureRenderTarget()
 	return std::make_unique<TextureRenderTargetOpenGL>();
 }
 
+TextureUploadQueue* VideoOpenGL::getTextureUploadQueue()
+{
+	return uploadQueue.get();
+}
+
+bool VideoOpenGL::canRenderOnAnotherThread() const
+{
+	// Not yet: textures, shaders and buffers are still created, loaded and deleted with GL calls on whichever thread
+	// asks for them, which is the main one for most resources, and it'd have no context once a render thread took it.
+	// Framebuffers would also have to be deleted on the render thread, as they aren't shared between contexts.
+	return false;
+}
+
+void VideoOpenGL::acquireRenderContext()
+{
+	context->bind();
+	contextOwner = std::this_thread::get_id();
+}
+
+void VideoOpenGL::releaseRenderContext()
+{
+	context->unbind();
+	contextOwner = std::thread::id();
+}
+
 bool VideoOpenGL::isLoaderThread() const
 {
 	return loaderThread && std::this_thread::get_id() == loaderThread->getThreadId();
@@ -406,17 +463,64 @@ void VideoOpenGL::startRender()
 		Debug::trace("Game::RenderScreen loaded texture");
 	}
 	*/
+
+	if (uploadQueue) {
+		uploadQueue->onFrame();
+	}
+
+	beginFrameQuery();
 }
 
 void VideoOpenGL::finishRender()
 {
 	HALLEY_DEBUG_TRACE();
+	endFrameQuery();
 	flip();
 	HALLEY_DEBUG_TRACE();
 
 	glCheckError();
 }
 
+void VideoOpenGL::beginFrameQuery()
+{
+#ifdef WITH_OPENGL
+	if (frameQueries[0] == 0) {
+		glGenQueries(GLsizei(numFrameQueries), frameQueries.data());
+		glCheckError();
+	}
+
+	// This is the oldest one; if it's still not done, it's dropped rather than waited on
+	const auto query = frameQueries[frameQueryIdx];
+	if (frameQueryPending[frameQueryIdx]) {
+		GLint available = 0;
+		glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available) {
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+			gpuFrameTime.store(int64_t(elapsed), std::memory_order_relaxed);
+		}
+		frameQueryPending[frameQueryIdx] = false;
+	}
+
+	glBeginQuery(GL_TIME_ELAPSED, query);
+	glCheckError();
+#endif
+}
+
+void VideoOpenGL::endFrameQuery()
+{
+#ifdef WITH_OPENGL
+	if (frameQueries[0] == 0) {
+		return;
+	}
+
+	glEndQuery(GL_TIME_ELAPSED);
+	glCheckError();
+	frameQueryPending[frameQueryIdx] = true;
+	frameQueryIdx = (frameQueryIdx + 1) % numFrameQueries;
+#endif
+}
+
 void VideoOpenGL::flip()
 {
 	window->swap();
@@ -1,14 +1,19 @@
 #pragma once
 
 #include <map>
+#include <array>
+#include <atomic>
 #include <mutex>
+#include <thread>
 #include <halley/data_structures/flat_map.h>
 #include "halley/core/api/halley_api_internal.h"
 #include "halley/core/graphics/window.h"
 #include "loader_thread_opengl.h"
+#include "halley/core/graphics/texture_upload_queue.h"
 
 namespace Halley {
 	class SystemAPI;
+	class ProgramBinaryCacheOpenGL;
 
 	class VideoOpenGL final : public VideoAPIInternal
 	{
@@ -31,6 +36,12 @@ namespace Halley {
 		std::unique_ptr<MaterialConstantBuffer> createConstantBuffer() override;
 
 		String getShaderLanguage() override;
+		int64_t getGPUFrameNanoSeconds() const override;
+		TextureUploadQueue* getTextureUploadQueue() override;
+
+		bool canRenderOnAnotherThread() const override;
+		void acquireRenderContext() override;
+		void releaseRenderContext() override;
 
 		bool isLoaderThread() const;
 
@@ -47,6 +58,8 @@ namespace Halley {
 		void clearScreen();
 		void startLoaderThread();
 		void flip();
+		void beginFrameQuery();
+		void endFrameQuery();
 
 		void setupDebugCallback();
 		void setUpEnumMap();
@@ -59,11 +72,21 @@ namespace Halley {
 		mutable std::mutex messagesMutex;
 
 		std::unique_ptr<GLContext> context;
+		std::atomic<std::thread::id> contextOwner;
 		bool initialized = false;
 
 		std::unique_ptr<LoaderThreadOpenGL> loaderThread;
+		std::unique_ptr<TextureUploadQueue> uploadQueue; // Runs on the loader thread
+		std::unique_ptr<ProgramBinaryCacheOpenGL> programBinaryCache;
 				
 		std::shared_ptr<Window> window;
 		bool useVsync = false;
+
+		// A ring of frame timer queries, so they can be read back a few frames later without stalling
+		constexpr static size_t numFrameQueries = 4;
+		std::array<unsigned int, numFrameQueries> frameQueries = {};
+		std::array<bool, numFrameQueries> frameQueryPending = {};
+		size_t frameQueryIdx = 0;
+		std::atomic<int64_t> gpuFrameTime;
 	};
 }
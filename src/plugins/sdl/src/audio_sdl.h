@@ -21,6 +21,7 @@ namespace Halley
 	public:
 		void init() override;
 		void deInit() override;
+		bool canInitInBackground() const override { return true; } // SDL's audio subsystem is separate from video and events
 
 		Vector<std::unique_ptr<const AudioDevice>> getAudioDevices() override;
 		AudioSpec openAudioDevice(const AudioSpec& requestedFormat, const AudioDevice* device, AudioCallback prepareAudioCallback) override;
@@ -25,6 +25,7 @@
 #include "input_keyboard_sdl.h"
 #include "halley/core/input/input_touch.h"
 #include <SDL.h>
+#include <algorithm>
 #include "halley/support/console.h"
 #include "halley/text/string_converter.h"
 
@@ -77,10 +78,23 @@ void InputSDL::init()
 
 	SDL_JoystickEventState(SDL_QUERY);
 	SDL_JoystickEventState(SDL_ENABLE);
+
+	eventQueue = std::make_shared<InputEventQueue>();
+	for (auto& k: keyboards) {
+		k->setEventQueue(eventQueue);
+	}
+	for (auto& m: mice) {
+		m->setEventQueue(eventQueue);
+	}
+	for (auto& j: joysticks) {
+		j->setEventQueue(eventQueue);
+	}
 }
 
 void InputSDL::deInit()
 {
+	setEventThreadEnabled(false);
+	eventQueue.reset();
 	keyboards.clear();
 	mice.clear();
 	sdlJoys.clear();
@@ -151,8 +165,104 @@ void InputSDL::beginEvents(Time t)
 	}
 }
 
+std::shared_ptr<InputEventQueue> InputSDL::getEventQueue() const
+{
+	return eventQueue;
+}
+
+void InputSDL::sampleLateInput()
+{
+	// Events pumped here stay queued, and are processed as usual next frame
+	SDL_PumpEvents();
+	for (auto& m: mice) {
+		m->updateRemap(mouseRemap);
+	}
+}
+
+void InputSDL::setEventThreadEnabled(bool enabled)
+{
+	if (enabled == isEventThreadEnabled()) {
+		return;
+	}
+
+	if (enabled) {
+		threadEvents = std::make_unique<SPSCQueue<SDL_Event>>(1024);
+		eventThreadRunning = true;
+		eventThread = std::thread([this] () { runEventThread(); });
+	} else {
+		eventThreadRunning = false;
+		eventThread.join();
+
+		// Whatever it had taken from SDL still gets processed
+		processThreadEvents();
+		threadEvents.reset();
+	}
+}
+
+bool InputSDL::isEventThreadEnabled() const
+{
+	return eventThread.joinable();
+}
+
+void InputSDL::runEventThread()
+{
+	system.setThreadName("SDL input");
+	while (eventThreadRunning) {
+		takeThreadEvents();
+		SDL_Delay(1);
+	}
+}
+
+int InputSDL::takeThreadEvents()
+{
+	// Only ever held for the time it takes to move a few events, so waiting for the other thread is just a spin
+	while (takingEvents.test_and_set(std::memory_order_acquire)) {
+		std::this_thread::yield();
+	}
+
+	constexpr int bufferSize = 64;
+	SDL_Event buffer[bufferSize];
+	int total = 0;
+	while (true) {
+		// Only as many as fit, so the rest wait in SDL's queue while the main thread catches up
+		const int space = int(std::min(threadEvents->capacity() - threadEvents->size(), size_t(bufferSize)));
+		const int n = space > 0 ? SDL_PeepEvents(buffer, space, SDL_GETEVENT, SDL_KEYDOWN, SDL_FINGERMOTION) : 0;
+		if (n <= 0) {
+			break;
+		}
+		for (int i = 0; i < n; ++i) {
+			threadEvents->tryPush(std::move(buffer[i]));
+		}
+		total += n;
+	}
+
+	takingEvents.clear(std::memory_order_release);
+	return total;
+}
+
+void InputSDL::processThreadEvents()
+{
+	if (!threadEvents) {
+		return;
+	}
+
+	// The ones just pumped are taken here rather than waiting for the thread, so they're not a frame late
+	SDL_Event event;
+	do {
+		while (threadEvents->tryPop(event)) {
+			processEvent(event);
+		}
+	} while (eventThreadRunning && takeThreadEvents() > 0);
+}
+
 void InputSDL::processEvent(SDL_Event& event)
 {
+	// Events are only pumped once per frame, but SDL knows when each one was received
+	if (eventQueue) {
+		const auto age = int64_t(SDL_GetTicks() - event.common.timestamp);
+		eventQueue->setEventTime(InputEventQueue::getTime() - std::max(age, int64_t(0)) * 1000000);
+	}
+
 	switch (event.type) {
 		case SDL_KEYDOWN:
 		case SDL_KEYUP:
@@ -201,6 +311,11 @@ void InputSDL::processEvent(SDL_Event& event)
 		default:
 			break;
 	}
+
+	if (eventQueue) {
+		// Polled devices are stamped when they're read
+		eventQueue->setEventTime(0);
+	}
 }
 
 void InputSDL::setMouseRemapping(std::function<Vector2f(Vector2i)> remapFunction)
@@ -22,7 +22,10 @@
 #pragma once
 
 #include "halley/core/api/halley_api_internal.h"
+#include "halley/concurrency/spsc_queue.h"
+#include <atomic>
 #include <map>
+#include <thread>
 #include <SDL.h>
 #include "input_joystick_sdl.h"
 
@@ -52,12 +55,22 @@ namespace Halley {
 
 		void processEvent(SDL_Event& event);
 
+		// While the event thread runs, input events are left in SDL's queue for it, and this processes them instead, after pumping
+		bool isEventThreadEnabled() const;
+		void processThreadEvents();
+
 		void setMouseRemapping(std::function<Vector2f(Vector2i)> remapFunction) override;
+		std::shared_ptr<InputEventQueue> getEventQueue() const override;
+		void sampleLateInput() override;
 
 	private:
 		void init() override;
 		void deInit() override;
 		void beginEvents(Time t) override;
+		void setEventThreadEnabled(bool enabled) override;
+
+		void runEventThread();
+		int takeThreadEvents();
 
 		void processJoyEvent(int n, SDL_Event& event);
 		void processTouch(int type, long long touchId, long long fingerId, float x, float y);
@@ -72,6 +85,15 @@ namespace Halley {
 		std::map<int, std::shared_ptr<InputTouch>> touchEvents;
 
 		std::function<Vector2f(Vector2i)> mouseRemap;
+		std::shared_ptr<InputEventQueue> eventQueue;
+
+		// SDL only lets the thread with the windows pump events, but its queue can be read from anywhere, so this thread takes input
+		// events out of it as they arrive between pumps (e.g. while Windows runs a modal loop to move the window), and passes them on
+		// to the main thread without locks. Both threads take events from SDL, each holding the flag while it does, so they're queued in order.
+		std::thread eventThread;
+		std::atomic<bool> eventThreadRunning { false };
+		std::atomic_flag takingEvents = ATOMIC_FLAG_INIT;
+		std::unique_ptr<SPSCQueue<SDL_Event>> threadEvents;
 	};
 
 };
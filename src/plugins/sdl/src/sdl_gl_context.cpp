@@ -33,6 +33,11 @@ void SDLGLContext::bind()
 	SDL_GL_MakeCurrent(window, context);
 }
 
+void SDLGLContext::unbind()
+{
+	SDL_GL_MakeCurrent(window, nullptr);
+}
+
 std::unique_ptr<GLContext> SDLGLContext::createSharedContext()
 {
 	return std::make_unique<SDLGLContext>(window, sharedContext);
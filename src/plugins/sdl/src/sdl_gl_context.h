@@ -12,6 +12,7 @@ namespace Halley
 		~SDLGLContext();
 
 		void bind() override;
+		void unbind() override;
 		std::unique_ptr<GLContext> createSharedContext() override;
 
 	private:
@@ -92,7 +92,7 @@ Bytes SDLSaveHeader::getIV() const
 uint64_t SDLSaveHeader::computeHash(const String& path, const String& key)
 {
 	String filename = path + ":" + key;
-	return Hash::hash(gsl::as_bytes(gsl::span<const char>(filename.c_str(), filename.length())));
+	return Hash::hashXXH64(gsl::as_bytes(gsl::span<const char>(filename.c_str(), filename.length())));
 }
 
 SDLSaveData::SDLSaveData(SaveDataType type, Path dir, Maybe<String> key)
@@ -150,7 +150,7 @@ void SDLSaveData::setData(const String& path, const Bytes& rawData, bool commit)
 {
 	Expects (!path.isEmpty());
 
-	Bytes finalData;
+	Bytes encryptedData;
 	const bool encrypted = static_cast<bool>(key);
 
 	if (encrypted) {
@@ -159,16 +159,15 @@ void SDLSaveData::setData(const String& path, const Bytes& rawData, bool commit)
 		SDLSaveHeader header;
 		header.generateIV();
 		header.v0.fileNameHash = SDLSaveHeader::computeHash(path, k);
-		header.v1.dataHash = Hash::hash(rawData);
-		auto encryptedData = Encrypt::encrypt(header.getIV(), k, rawData);
+		header.v1.dataHash = Hash::hashXXH64(gsl::as_bytes(gsl::span<const Byte>(rawData)));
+		auto cipherText = Encrypt::encrypt(header.getIV(), k, rawData);
 		
 		// Pack
-		finalData.resize(sizeof(header) + encryptedData.size());
-		memcpy(finalData.data(), &header, sizeof(header));
-		memcpy(finalData.data() + sizeof(header), encryptedData.data(), encryptedData.size());
-	} else {
-		finalData = rawData;
+		encryptedData.resize(sizeof(header) + cipherText.size());
+		memcpy(encryptedData.data(), &header, sizeof(header));
+		memcpy(encryptedData.data() + sizeof(header), cipherText.data(), cipherText.size());
 	}
+	const Bytes& finalData = encrypted ? encryptedData : rawData; // Not copied when unencrypted, as saves can be big
 
 	// Paths
 	auto dstPath = dir / path;
@@ -234,7 +233,7 @@ Maybe<Bytes> SDLSaveData::doGetData(const Path& path, const String& filename)
 	auto finalData = Encrypt::decrypt(header.getIV(), k, rawData);
 
 	// Final validation
-	if (header.v0.version >= 1 && header.v1.dataHash != Hash::hash(finalData)) {
+	if (header.v0.version >= 1 && header.v1.dataHash != Hash::hashXXH64(gsl::as_bytes(gsl::span<const Byte>(finalData)))) {
 		Logger::logError("Corrupted save file: " + filename);
 		if (!path.getExtension().endsWith(".bak")) {
 			corruptedFiles.insert(path.getString());
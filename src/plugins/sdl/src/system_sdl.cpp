@@ -73,9 +73,24 @@ Path SystemSDL::getUnpackedAssetsPath(const Path& gamePath) const
 
 bool SystemSDL::generateEvents(VideoAPI* video, InputAPI* input)
 {
+	auto sdlInput = dynamic_cast<InputSDL*>(input);
+	const bool inputThread = sdlInput && sdlInput->isEventThreadEnabled();
+
 	SDL_Event event;
 	SDL_PumpEvents();
-	while (SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) > 0) {
+	if (inputThread) {
+		// Input events are left for the input thread's queue, and everything else is peeped around them
+		sdlInput->processThreadEvents();
+	}
+	auto nextEvent = [&] ()
+	{
+		if (inputThread) {
+			return SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_KEYDOWN - 1) > 0
+				|| SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_FINGERMOTION + 1, SDL_LASTEVENT) > 0;
+		}
+		return SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) > 0;
+	};
+	while (nextEvent()) {
 		switch (event.type) {
 			case SDL_KEYDOWN:
 			case SDL_KEYUP:
@@ -94,7 +109,6 @@ bool SystemSDL::generateEvents(VideoAPI* video, InputAPI* input)
 			case SDL_FINGERDOWN:
 			case SDL_FINGERMOTION:
 			{
-				auto sdlInput = dynamic_cast<InputSDL*>(input);
 				if (sdlInput) {
 					sdlInput->processEvent(event);
 				}
@@ -339,6 +353,34 @@ void SystemSDL::setThreadName(const String& name)
 #endif
 }
 
+void SystemSDL::setThreadPriority(ThreadPriority priority)
+{
+	SDL_ThreadPriority sdlPriority = SDL_THREAD_PRIORITY_NORMAL;
+	switch (priority) {
+	case ThreadPriority::Low:
+		sdlPriority = SDL_THREAD_PRIORITY_LOW;
+		break;
+	case ThreadPriority::Normal:
+		sdlPriority = SDL_THREAD_PRIORITY_NORMAL;
+		break;
+	case ThreadPriority::High:
+		sdlPriority = SDL_THREAD_PRIORITY_HIGH;
+		break;
+	case ThreadPriority::Realtime:
+#if SDL_VERSION_ATLEAST(2, 0, 9)
+		sdlPriority = SDL_THREAD_PRIORITY_TIME_CRITICAL;
+#else
+		sdlPriority = SDL_THREAD_PRIORITY_HIGH;
+#endif
+		break;
+	}
+
+	if (SDL_SetThreadPriority(sdlPriority) != 0) {
+		// Usually needs extra permissions (e.g. rtkit on Linux), so it's not worth failing over
+		Logger::logWarning("Unable to set thread priority: " + String(SDL_GetError()));
+	}
+}
+
 void SystemSDL::printDebugInfo() const
 {
 	std::cout << std::endl << ConsoleColour(Console::GREEN) << "Initializing Video Display...\n" << ConsoleColour();
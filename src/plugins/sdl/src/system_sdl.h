@@ -42,6 +42,7 @@ namespace Halley
 		std::shared_ptr<IClipboard> getClipboard() const override;
 
 		void setThreadName(const String& name) override;
+		void setThreadPriority(ThreadPriority priority) override;
 
 	private:
 		void processVideoEvent(VideoAPI* video, const SDL_Event& event);
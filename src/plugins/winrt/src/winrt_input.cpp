@@ -14,6 +14,14 @@ void WinRTInput::init()
 	}
 	keyboard = std::make_shared<WinRTKeyboard>();
 	mouse = std::make_shared<WinRTMouse>();
+
+	// Keyboard and mouse push from the CoreWindow callbacks, so they're stamped as soon as the OS dispatches them
+	eventQueue = std::make_shared<InputEventQueue>();
+	for (auto& g: gamepads) {
+		g->setEventQueue(eventQueue);
+	}
+	keyboard->setEventQueue(eventQueue);
+	mouse->setEventQueue(eventQueue);
 }
 
 void WinRTInput::deInit()
@@ -76,4 +84,9 @@ Vector<std::shared_ptr<InputTouch>> WinRTInput::getTouchEvents()
 	return {};
 }
 
+std::shared_ptr<InputEventQueue> WinRTInput::getEventQueue() const
+{
+	return eventQueue;
+}
+
 #endif
@@ -27,9 +27,12 @@ namespace Halley
 		Vector<std::shared_ptr<InputTouch>> getNewTouchEvents() override;
 		Vector<std::shared_ptr<InputTouch>> getTouchEvents() override;
 
+		std::shared_ptr<InputEventQueue> getEventQueue() const override;
+
 	private:
 		std::vector<std::shared_ptr<InputJoystick>> gamepads;
 		std::shared_ptr<WinRTKeyboard> keyboard;
 		std::shared_ptr<WinRTMouse> mouse;
+		std::shared_ptr<InputEventQueue> eventQueue;
 	};
 }
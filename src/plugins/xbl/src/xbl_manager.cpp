@@ -161,8 +161,11 @@ void XBLManager::init()
 		xboxLiveContext.reset();
 		gameSaveProvider.reset();
 		status = XBLStatus::Disconnected;
-		achievementsStatus = XBLAchievementsStatus::Uninitialized;
-		achievementStatus.clear();
+		{
+			std::unique_lock<std::mutex> lock(achievementMutex);
+			achievementsStatus = XBLAchievementsStatus::Uninitialized;
+			achievementStatus.clear();
+		}
 		playerLoggedOut = true;
 	});
 }
@@ -172,39 +175,46 @@ void XBLManager::deInit()
 	using namespace xbox::services::system;
 	xbox_live_user::remove_sign_out_completed_handler(signOutHandler);
 
+	std::unique_lock<std::mutex> lock(achievementMutex);
 	achievementsStatus = XBLAchievementsStatus::Uninitialized;
 	achievementStatus.clear();
 }
 
 std::shared_ptr<ISaveData> XBLManager::getSaveContainer(const String& name)
 {
+	std::unique_lock<std::mutex> lock(saveStorageMutex);
 	auto iter = saveStorage.find(name);
 	if (iter == saveStorage.end()) {
 		auto save = std::make_shared<XBLSaveData>(*this, name);
 		saveStorage[name] = save;
+		if (status == XBLStatus::Connected) {
+			// Otherwise, getConnectedStorage() fetches it along with the others
+			save->recreate();
+		}
 		return save;
 	} else {
 		return iter->second;
 	}
 }
 
-void XBLManager::recreateCloudSaveContainer()
+Future<void> XBLManager::recreateCloudSaveContainer()
 {
-	if (status == XBLStatus::Connected)
-	{
-		Concurrent::execute([=]() -> void
-		{
-			gameSaveProvider.reset();
-			status = XBLStatus::Disconnected;
-			getConnectedStorage().get();
+	Promise<void> promise;
+	auto future = promise.getFuture();
 
-			std::map<String, std::shared_ptr<ISaveData>>::iterator iter;
-			for (iter = saveStorage.begin(); iter != saveStorage.end(); ++iter)
-			{
-				std::dynamic_pointer_cast<XBLSaveData>(iter->second)->recreate();
-			}
-		}).get();
+	if (status == XBLStatus::Connected) {
+		gameSaveProvider.reset();
+		status = XBLStatus::Disconnected;
+		getConnectedStorage().Completed([promise] (const winrt::Windows::Foundation::IAsyncAction&, winrt::Windows::Foundation::AsyncStatus)
+		{
+			auto localPromise = promise;
+			localPromise.set();
+		});
+	} else {
+		promise.set();
 	}
+
+	return future;
 }
 
 Maybe<winrt::Windows::Gaming::XboxLive::Storage::GameSaveProvider> XBLManager::getProvider() const
@@ -300,28 +310,43 @@ Future<AuthTokenResult> XBLManager::getAuthToken(const AuthTokenParameters& para
 	}
 }
 
-void XBLManager::setAchievementProgress(const String& achievementId, int currentProgress, int maximumValue)
+Future<bool> XBLManager::setAchievementProgress(const String& achievementId, int currentProgress, int maximumValue)
 {
+	Promise<bool> promise;
+	auto future = promise.getFuture();
+
 	if (xboxUser != nullptr && xboxLiveContext != nullptr)
 	{
 		string_t id (achievementId.cppStr().begin(), achievementId.cppStr().end());
 		int progress = (int)floor(((float)currentProgress / (float)maximumValue) * 100.f);
 		xboxLiveContext->achievement_service().update_achievement(xboxUser->xbox_user_id(), id, progress).then([=] (xbox::services::xbox_live_result<void> result)
 		{ 
+			auto localPromise = promise;
 			if (result.err())
 			{
 				Logger::logError(String("Error unlocking achievement '") + achievementId + String("': ") + result.err().value() + " "  + result.err_message());
+				localPromise.setValue(false);
 			}
-			else if (progress == 100)
+			else
 			{
-				achievementStatus[id] = true;
+				if (progress == 100)
+				{
+					std::unique_lock<std::mutex> lock(achievementMutex);
+					achievementStatus[id] = true;
+				}
+				localPromise.setValue(true);
 			}
 		});
+	} else {
+		promise.setValue(false);
 	}
+
+	return future;
 }
 
 bool XBLManager::isAchievementUnlocked(const String& achievementId, bool defaultValue)
 {
+	std::unique_lock<std::mutex> lock(achievementMutex);
 	if (achievementsStatus == XBLAchievementsStatus::Uninitialized)
 	{
 		Logger::logWarning(String("Trying to get the achievement status before starting the retrieve task!"));
@@ -329,14 +354,9 @@ bool XBLManager::isAchievementUnlocked(const String& achievementId, bool default
 	}
 	else if (achievementsStatus == XBLAchievementsStatus::Retrieving)
 	{
-		unsigned long long timeout = GetTickCount64() + 5000;
-		while (achievementsStatus == XBLAchievementsStatus::Retrieving && GetTickCount64() < timeout) {}
-
-		if (achievementsStatus == XBLAchievementsStatus::Retrieving)
-		{
-			Logger::logWarning(String("Achievements are taking too long to load!"));
-			return false;
-		}
+		// Not waited for, as that would stall the frame on a slow connection
+		Logger::logWarning(String("Achievements haven't been retrieved yet!"));
+		return false;
 	}
 
 	string_t id(achievementId.cppStr().begin(), achievementId.cppStr().end());
@@ -451,6 +471,9 @@ winrt::Windows::Foundation::IAsyncAction XBLManager::getConnectedStorage()
 {
 	using namespace winrt::Windows::Gaming::XboxLive::Storage;
 
+	// Everything below waits on the network, so none of it should hold up the thread that signed in
+	co_await winrt::resume_background();
+
 	try
 	{
 		auto windowsUser = co_await winrt::Windows::System::User::FindAllAsync();
@@ -477,17 +500,80 @@ winrt::Windows::Foundation::IAsyncAction XBLManager::getConnectedStorage()
 		xboxUser.reset();
 		xboxLiveContext.reset();
 		gameSaveProvider.reset();
-		achievementsStatus = XBLAchievementsStatus::Uninitialized;
-		achievementStatus.clear();
+		{
+			std::unique_lock<std::mutex> lock(achievementMutex);
+			achievementsStatus = XBLAchievementsStatus::Uninitialized;
+			achievementStatus.clear();
+		}
 		playerLoggedOut = true;
+		co_return;
+	}
+
+	// Prefetched here, so the game finds its saves ready as soon as it's signed in
+	std::vector<std::shared_ptr<XBLSaveData>> containers;
+	{
+		std::unique_lock<std::mutex> lock(saveStorageMutex);
+		if (saveStorage.find("") == saveStorage.end()) {
+			saveStorage[""] = std::make_shared<XBLSaveData>(*this, "");
+		}
+		for (auto& save: saveStorage) {
+			containers.push_back(std::static_pointer_cast<XBLSaveData>(save.second));
+		}
+	}
+	for (auto& container: containers) {
+		co_await container->recreate();
+	}
+}
+
+namespace {
+	using AchievementsResult = xbox::services::xbox_live_result<xbox::services::achievements::achievements_result>;
+
+	// Each page is requested from the continuation of the one before, so no thread sits waiting for them
+	void readAchievementPages(AchievementsResult result, std::function<void(const xbox::services::achievements::achievement&)> onAchievement, std::function<void(bool)> onDone)
+	{
+		try
+		{
+			if (result.err())
+			{
+				Logger::logError(String("Error retrieving achievements: ") + result.err().value() + " " + result.err_message());
+				onDone(false);
+				return;
+			}
+
+			auto achievements = result.payload().items();
+			for (auto& achievement: achievements)
+			{
+				onAchievement(achievement);
+			}
+
+			if (result.payload().has_next())
+			{
+				result.payload().get_next(32).then([=](AchievementsResult next)
+				{
+					readAchievementPages(next, onAchievement, onDone);
+				});
+			}
+			else
+			{
+				onDone(true);
+			}
+		}
+		catch (...)
+		{
+			onDone(false);
+		}
 	}
 }
 
 void XBLManager::retrieveUserAchievementsState()
 {
-	achievementsStatus = XBLAchievementsStatus::Retrieving;
-	achievementStatus.clear();
+	{
+		std::unique_lock<std::mutex> lock(achievementMutex);
+		achievementsStatus = XBLAchievementsStatus::Retrieving;
+		achievementStatus.clear();
+	}
 
+	const auto gamertag = String(xboxUser->gamertag().c_str());
 	xboxLiveContext->achievement_service().get_achievements_for_title_id(
 		xboxUser->xbox_user_id(),
 		xboxLiveContext->application_config()->title_id(),
@@ -496,47 +582,23 @@ void XBLManager::retrieveUserAchievementsState()
 		xbox::services::achievements::achievement_order_by::title_id,
 		0,
 		0)
-		.then([=](xbox::services::xbox_live_result<xbox::services::achievements::achievements_result> result)
+		.then([=](AchievementsResult result)
 	{
-		try
+		readAchievementPages(result, [=](const xbox::services::achievements::achievement& achievement)
 		{
-			bool receivedMoreAchievements;
-			do
-			{
-				receivedMoreAchievements = false;
-				if (result.err())
-				{
-					Logger::logError(String("Error retrieving achievements for user '") + xboxUser->gamertag().c_str() + String("': ") + result.err().value() + " " + result.err_message());
-					achievementsStatus = XBLAchievementsStatus::Uninitialized;
-				}
-				else
-				{
-					std::vector<xbox::services::achievements::achievement> achievements = result.payload().items();
-					for (unsigned int i = 0; i < achievements.size(); ++i)
-					{
-						xbox::services::achievements::achievement achievement = achievements[i];
-						bool isAchieved = (achievement.progress_state() == xbox::services::achievements::achievement_progress_state::achieved);
-						Logger::logInfo(String("Achievement '") + achievement.name().c_str() + String("' (ID '") + achievement.id().c_str() + String("'): ") + (isAchieved ? String("Achieved") : String("Locked")));
-						achievementStatus[achievement.id()] = isAchieved;
-					}
-
-					if (result.payload().has_next())
-					{
-						result = result.payload().get_next(32).get();
-						receivedMoreAchievements = true;
-					}
-					else
-					{
-						achievementsStatus = XBLAchievementsStatus::Ready;
-					}
-				}
-			} while (receivedMoreAchievements);
-		}
-		catch (...)
+			bool isAchieved = (achievement.progress_state() == xbox::services::achievements::achievement_progress_state::achieved);
+			Logger::logInfo(String("Achievement '") + achievement.name().c_str() + String("' (ID '") + achievement.id().c_str() + String("'): ") + (isAchieved ? String("Achieved") : String("Locked")));
+			std::unique_lock<std::mutex> lock(achievementMutex);
+			achievementStatus[achievement.id()] = isAchieved;
+		}, [=](bool ok)
 		{
-			achievementsStatus = XBLAchievementsStatus::Uninitialized;
-			Logger::logError(String("Error retrieving achievements for user '") + xboxUser->gamertag().c_str() + String("'"));
-		}
+			if (!ok)
+			{
+				Logger::logError(String("Error retrieving achievements for user '") + gamertag + String("'"));
+			}
+			std::unique_lock<std::mutex> lock(achievementMutex);
+			achievementsStatus = ok ? XBLAchievementsStatus::Ready : XBLAchievementsStatus::Uninitialized;
+		});
 	});
 }
 
@@ -548,9 +610,7 @@ void XBLManager::showPlayerInfo(String playerId)
 XBLSaveData::XBLSaveData(XBLManager& manager, String containerName)
 	: manager(manager)
 	, containerName(containerName.isEmpty() ? "save" : containerName)
-	, isSaving(false)
 {
-	updateContainer();
 }
 
 void XBLManager::setProfanityCheckForbiddenWordsList(std::vector<String> words)
@@ -612,8 +672,8 @@ bool XBLManager::isSuspended() const
 
 bool XBLSaveData::isReady() const
 {
-	updateContainer();
-	return gameSaveContainer.is_initialized();
+	std::unique_lock<std::recursive_mutex> lock(mutex);
+	return ready && manager.getStatus() == XBLStatus::Connected;
 }
 
 Bytes XBLSaveData::getData(const String& path)
@@ -622,45 +682,12 @@ Bytes XBLSaveData::getData(const String& path)
 		throw Exception("Container is not ready yet!", HalleyExceptions::PlatformPlugin);
 	}
 
-	return Concurrent::execute([&] () -> Bytes
-	{
-		if (isSaving)
-		{
-			unsigned long long timeout = GetTickCount64() + 3000;
-			while (isSaving && GetTickCount64() < timeout) {}
-
-			if (isSaving)
-			{
-				Logger::logWarning(String("Saving data to connected storage is taking too long!"));
-			}
-		}
-
-		auto key = winrt::hstring(path.getUTF16());
-		std::vector<winrt::hstring> updates;
-		updates.push_back(key);
-		auto view = winrt::single_threaded_vector(std::move(updates)).GetView();
-
-		auto gameBlob = gameSaveContainer->GetAsync(view).get();
-
-		if (gameBlob.Status() == winrt::Windows::Gaming::XboxLive::Storage::GameSaveErrorStatus::Ok) {
-			if (gameBlob.Value().HasKey(key)) {
-				auto buffer = gameBlob.Value().Lookup(key);
-
-				auto size = buffer.Length();
-				Bytes result(size);
-				auto dataReader = winrt::Windows::Storage::Streams::DataReader::FromBuffer(buffer);
-				dataReader.ReadBytes(winrt::array_view<uint8_t>(result));
-
-				return result;
-			}
-		}
-		else
-		{
-			Logger::logError(String("Error getting Blob '") + path + String("': ") + (int)gameBlob.Status());
-		}
-
-		return {};
-	}).get();
+	std::unique_lock<std::recursive_mutex> lock(mutex);
+	auto iter = blobs.find(path);
+	if (iter != blobs.end()) {
+		return iter->second;
+	}
+	return {};
 }
 
 std::vector<String> XBLSaveData::enumerate(const String& root)
@@ -669,21 +696,14 @@ std::vector<String> XBLSaveData::enumerate(const String& root)
 		throw Exception("Container is not ready yet!", HalleyExceptions::PlatformPlugin);
 	}
 
-	return Concurrent::execute([&] () -> std::vector<String>
-	{
-		std::vector<String> results;
-
-		auto query = gameSaveContainer->CreateBlobInfoQuery(root.getUTF16().c_str());
-		auto info = query.GetBlobInfoAsync().get();
-		if (info.Status() == winrt::Windows::Gaming::XboxLive::Storage::GameSaveErrorStatus::Ok) {
-			auto& entries = info.Value();
-			for (uint32_t i = 0; i < entries.Size(); ++i) {
-				results.push_back(String(entries.GetAt(i).Name().c_str()));
-			}
+	std::vector<String> results;
+	std::unique_lock<std::recursive_mutex> lock(mutex);
+	for (auto& blob: blobs) {
+		if (blob.first.startsWith(root)) {
+			results.push_back(blob.first);
 		}
-
-		return results;
-	}).get();
+	}
+	return results;
 }
 
 void XBLSaveData::setData(const String& path, const Bytes& data, bool commit)
@@ -692,24 +712,10 @@ void XBLSaveData::setData(const String& path, const Bytes& data, bool commit)
 		throw Exception("Container is not ready yet!", HalleyExceptions::PlatformPlugin);
 	}
 
-	isSaving = true;
-	Concurrent::execute([=]() -> void
-	{
-		auto dataWriter = winrt::Windows::Storage::Streams::DataWriter();
-		dataWriter.WriteBytes(winrt::array_view<const uint8_t>(data));
-
-		std::map<winrt::hstring, winrt::Windows::Storage::Streams::IBuffer> updates;
-		updates[winrt::hstring(path.getUTF16())] = dataWriter.DetachBuffer();
-		auto view = winrt::single_threaded_map(std::move(updates)).GetView();
-
-		auto result = gameSaveContainer->SubmitUpdatesAsync(view, {}, L"").get();
-		if (result.Status() != winrt::Windows::Gaming::XboxLive::Storage::GameSaveErrorStatus::Ok)
-		{
-			Logger::logError(String("Error saving Blob '") + path + String("': ") + (int)result.Status());
-		}
-
-		isSaving = false;
-	});
+	std::unique_lock<std::recursive_mutex> lock(mutex);
+	blobs[path] = data;
+	pendingChanges[path] = data;
+	submitPending();
 }
 
 void XBLSaveData::removeData(const String& path)
@@ -718,19 +724,10 @@ void XBLSaveData::removeData(const String& path)
 		throw Exception("Container is not ready yet!", HalleyExceptions::PlatformPlugin);
 	}
 
-	Concurrent::execute([=]() -> void
-	{
-		auto key = winrt::hstring(path.getUTF16());
-		std::vector<winrt::hstring> updates;
-		updates.push_back(key);
-		auto view = winrt::single_threaded_vector(std::move(updates)).GetView();
-
-		auto result = gameSaveContainer->SubmitUpdatesAsync({}, view, L"").get();
-		if (result.Status() != winrt::Windows::Gaming::XboxLive::Storage::GameSaveErrorStatus::Ok)
-		{
-			Logger::logError(String("Error deleting Blob '") + path + String("': ") + (int)result.Status());
-		}
-	}).get();
+	std::unique_lock<std::recursive_mutex> lock(mutex);
+	blobs.erase(path);
+	pendingChanges[path] = Maybe<Bytes>();
+	submitPending();
 }
 
 void XBLSaveData::commit()
@@ -738,23 +735,134 @@ void XBLSaveData::commit()
 	
 }
 
-void XBLSaveData::recreate()
+winrt::Windows::Foundation::IAsyncAction XBLSaveData::recreate()
 {
-	if (manager.getStatus() == XBLStatus::Connected) {
+	using namespace winrt::Windows::Gaming::XboxLive::Storage;
+
+	Maybe<GameSaveContainer> container;
+	uint32_t curGeneration;
+	{
+		std::unique_lock<std::recursive_mutex> lock(mutex);
 		gameSaveContainer.reset();
-		gameSaveContainer = manager.getProvider()->CreateContainer(containerName.getUTF16().c_str());
+		ready = false;
+		curGeneration = ++generation;
+		if (manager.getStatus() == XBLStatus::Connected) {
+			gameSaveContainer = manager.getProvider()->CreateContainer(containerName.getUTF16().c_str());
+			container = gameSaveContainer;
+		}
+	}
+	if (!container) {
+		co_return;
+	}
+
+	co_await winrt::resume_background();
+
+	std::map<String, Bytes> loaded;
+	bool ok = false;
+	try
+	{
+		auto info = co_await container->CreateBlobInfoQuery(L"").GetBlobInfoAsync();
+		if (info.Status() == GameSaveErrorStatus::Ok) {
+			std::vector<winrt::hstring> names;
+			auto entries = info.Value();
+			for (uint32_t i = 0; i < entries.Size(); ++i) {
+				names.push_back(entries.GetAt(i).Name());
+			}
+
+			if (names.empty()) {
+				ok = true;
+			} else {
+				auto gameBlobs = co_await container->GetAsync(winrt::single_threaded_vector(std::move(names)).GetView());
+				if (gameBlobs.Status() == GameSaveErrorStatus::Ok) {
+					for (const auto& blob: gameBlobs.Value()) {
+						auto buffer = blob.Value();
+						Bytes data(buffer.Length());
+						auto dataReader = winrt::Windows::Storage::Streams::DataReader::FromBuffer(buffer);
+						dataReader.ReadBytes(winrt::array_view<uint8_t>(data));
+						loaded[String(blob.Key().c_str())] = std::move(data);
+					}
+					ok = true;
+				} else {
+					Logger::logError(String("Error getting Blobs from '") + containerName + String("': ") + (int)gameBlobs.Status());
+				}
+			}
+		} else {
+			Logger::logError(String("Error enumerating Blobs in '") + containerName + String("': ") + (int)info.Status());
+		}
+	}
+	catch (...)
+	{
+		Logger::logError(String("Error fetching container '") + containerName + String("'"));
+	}
+
+	std::unique_lock<std::recursive_mutex> lock(mutex);
+	if (ok && curGeneration == generation) {
+		// Whatever was changed before the container was recreated still stands, and is still to be submitted
+		blobs = std::move(loaded);
+		for (auto& change: pendingChanges) {
+			if (change.second) {
+				blobs[change.first] = change.second.get();
+			} else {
+				blobs.erase(change.first);
+			}
+		}
+		ready = true;
+		submitPending();
 	}
 }
 
-void XBLSaveData::updateContainer() const
+void XBLSaveData::submitPending()
 {
-	if (manager.getStatus() == XBLStatus::Connected) {
-		if (!gameSaveContainer) {
-			gameSaveContainer = manager.getProvider()->CreateContainer(containerName.getUTF16().c_str());
+	using namespace winrt::Windows::Gaming::XboxLive::Storage;
+
+	// Needs the mutex held. Only one submission is in flight at a time, so they land in order; what's changed meanwhile goes in the next
+	if (submitting || pendingChanges.empty() || !gameSaveContainer) {
+		return;
+	}
+
+	std::map<winrt::hstring, winrt::Windows::Storage::Streams::IBuffer> updates;
+	std::vector<winrt::hstring> removals;
+	for (auto& change: pendingChanges) {
+		auto key = winrt::hstring(change.first.getUTF16());
+		if (change.second) {
+			auto dataWriter = winrt::Windows::Storage::Streams::DataWriter();
+			dataWriter.WriteBytes(winrt::array_view<const uint8_t>(change.second.get()));
+			updates[key] = dataWriter.DetachBuffer();
+		} else {
+			removals.push_back(key);
 		}
-	} else {
-		gameSaveContainer.reset();
 	}
+	pendingChanges.clear();
+	submitting = true;
+
+	winrt::Windows::Foundation::Collections::IMapView<winrt::hstring, winrt::Windows::Storage::Streams::IBuffer> updateView{ nullptr };
+	if (!updates.empty()) {
+		updateView = winrt::single_threaded_map(std::move(updates)).GetView();
+	}
+	winrt::Windows::Foundation::Collections::IIterable<winrt::hstring> removalView{ nullptr };
+	if (!removals.empty()) {
+		removalView = winrt::single_threaded_vector(std::move(removals)).GetView();
+	}
+
+	gameSaveContainer->SubmitUpdatesAsync(updateView, removalView, L"").Completed([this] (const winrt::Windows::Foundation::IAsyncOperation<GameSaveOperationResult>& op, winrt::Windows::Foundation::AsyncStatus asyncStatus)
+	{
+		try
+		{
+			if (asyncStatus != winrt::Windows::Foundation::AsyncStatus::Completed) {
+				Logger::logError(String("Error saving to '") + containerName + String("': ") + (int)asyncStatus);
+			} else if (op.GetResults().Status() != GameSaveErrorStatus::Ok) {
+				Logger::logError(String("Error saving to '") + containerName + String("': ") + (int)op.GetResults().Status());
+			}
+		}
+		catch (...)
+		{
+			Logger::logError(String("Error saving to '") + containerName + String("'"));
+		}
+
+		std::unique_lock<std::recursive_mutex> lock(mutex);
+		submitting = false;
+		submitPending();
+	});
 }
 
 void XBLManager::update()
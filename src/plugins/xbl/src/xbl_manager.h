@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <map>
+#include <mutex>
 #include <winrt/base.h>
 #include <winrt/Windows.Gaming.XboxLive.Storage.h>
 #include "halley/data_structures/maybe.h"
@@ -89,13 +90,13 @@ namespace Halley {
 		bool isSignedIn() const;
 
 		std::shared_ptr<ISaveData> getSaveContainer(const String& name);
-		void recreateCloudSaveContainer();
+		Future<void> recreateCloudSaveContainer(); // Resolves once the containers are fetched again
 
 		Maybe<winrt::Windows::Gaming::XboxLive::Storage::GameSaveProvider> getProvider() const;
 		XBLStatus getStatus() const;
 		Future<AuthTokenResult> getAuthToken(const AuthTokenParameters& parameters);
-		void setAchievementProgress(const String& achievementId, int currentProgress, int maximumValue);
-		bool isAchievementUnlocked(const String& achievementId, bool defaultValue);
+		Future<bool> setAchievementProgress(const String& achievementId, int currentProgress, int maximumValue);
+		bool isAchievementUnlocked(const String& achievementId, bool defaultValue); // Doesn't wait: false until they're retrieved
 
 		String getPlayerName();
 		bool playerHasLoggedOut();
@@ -121,7 +122,7 @@ namespace Halley {
 		void setPreparingToJoinCallback(PlatformPreparingToJoinCallback callback);
 		void setJoinErrorCallback(PlatformJoinErrorCallback callback);
 
-		void setProfanityCheckForbiddenWordsList(std::vector<String> words);
+		void setProfanityCheckForbiddenWordsList(std::vector<String> words);
 		String performProfanityCheck(String text);
 
 		void suspend();
@@ -136,7 +137,9 @@ namespace Halley {
 		std::shared_ptr<xbox::services::xbox_live_context> xboxLiveContext;
 		Maybe<winrt::Windows::Gaming::XboxLive::Storage::GameSaveProvider> gameSaveProvider;
 		std::map<String, std::shared_ptr<ISaveData>> saveStorage;
+		std::mutex saveStorageMutex;
 		std::map<std::wstring, bool> achievementStatus;
+		mutable std::mutex achievementMutex; // Also guards achievementsStatus, as both are filled in by callbacks
 		PlatformJoinCallback joinCallback;
 		PlatformPreparingToJoinCallback preparingToJoinCallback;
 		PlatformJoinErrorCallback joinErrorCallback;
@@ -203,6 +206,8 @@ namespace Halley {
 		void xblMultiplayerPoolProcess();
 	};
 
+	// Every blob in the container is read once it's created (see recreate()), so getData and enumerate answer from memory.
+	// Changes go into that copy straight away, and are submitted in the background in the order they were made.
 	class XBLSaveData : public ISaveData {
 	public:
 		explicit XBLSaveData(XBLManager& manager, String containerName);
@@ -214,14 +219,20 @@ namespace Halley {
 		void removeData(const String& path) override;
 		void commit() override;
 
-		void recreate();
+		winrt::Windows::Foundation::IAsyncAction recreate(); // Completes once the blobs are fetched, on a worker
 	private:
-		bool isSaving;
 		XBLManager& manager;
 		String containerName;
-		mutable Maybe<winrt::Windows::Gaming::XboxLive::Storage::GameSaveContainer> gameSaveContainer;
 
-		void updateContainer() const;
+		mutable std::recursive_mutex mutex; // Completed() handlers run straight away if the operation already finished
+		Maybe<winrt::Windows::Gaming::XboxLive::Storage::GameSaveContainer> gameSaveContainer;
+		std::map<String, Bytes> blobs;
+		std::map<String, Maybe<Bytes>> pendingChanges; // Not submitted yet; empty for removals
+		bool ready = false;
+		bool submitting = false;
+		uint32_t generation = 0; // Of the container, so a fetch that's overtaken by recreate() is discarded
+
+		void submitPending();
 	};
 
 	class XBLMultiplayerSession : public MultiplayerSession {
@@ -0,0 +1,124 @@
+#include "benchmark_stage.h"
+#include <iomanip>
+
+using namespace Halley;
+
+BenchmarkStage::BenchmarkStage(Options options)
+	: options(std::move(options))
+{}
+
+void BenchmarkStage::init()
+{
+	const std::array<std::pair<const char*, AudioMixerType>, 4> mixers = {{
+		{ "scalar", AudioMixerType::Scalar },
+		{ "sse", AudioMixerType::SSE },
+		{ "avx", AudioMixerType::AVX },
+		{ "neon", AudioMixerType::NEON }
+	}};
+
+	std::cout << "Offline audio benchmark, " << options.buffers << " buffers per run" << std::endl;
+	std::cout << std::left << std::setw(8) << "mixer" << std::right << std::setw(8) << "voices"
+		<< std::setw(10) << "total" << std::setw(10) << "max" << std::setw(10) << "budget"
+		<< std::setw(10) << "mixer" << std::setw(10) << "decoder" << std::setw(10) << "resample" << std::setw(8) << "over" << "   (us per buffer)" << std::endl;
+
+	const auto voiceCounts = options.voices > 0 ? std::vector<int>{ options.voices } : std::vector<int>{ 16, 64, 256 };
+	for (auto& m: mixers) {
+		if ((options.mixer == "all" || options.mixer == m.first) && AudioOfflineRenderer::isMixerSupported(m.second)) {
+			for (int voices: voiceCounts) {
+				run(m.first, m.second, voices);
+			}
+		}
+	}
+
+	report();
+	getCoreAPI().quit();
+}
+
+void BenchmarkStage::run(const String& mixerName, AudioMixerType mixer, int voices)
+{
+	AudioOfflineRenderer renderer(AudioSpec(48000, 2, 512, AudioSampleFormat::Float), mixer);
+	renderer.setMaxVoices(size_t(voices));
+	renderer.setGroupGain("music", 0.8f);
+	renderer.setGroupGain("sfx", 0.5f);
+
+	auto music = getResources().get<AudioClip>("Loveshadow_-_Marcos_Theme.ogg");
+	music->waitForLoad();
+	renderer.play(music, AudioPosition::makeFixed(), 1.0f, true, "music");
+
+	const std::array<const char*, 12> notes = {{ "c1", "c1s", "d1", "d1s", "e1", "f1", "f1s", "g1", "g1s", "a1", "a1s", "b1" }};
+	for (int i = 1; i < voices; ++i) {
+		auto clip = getResources().get<AudioClip>(String(notes[i % notes.size()]) + ".ogg");
+		clip->waitForLoad();
+		const float pan = float(i % 9) / 4.0f - 1.0f;
+		const float pitch = i % 3 == 0 ? 0.9f + 0.05f * float(i % 5) : 1.0f;
+		renderer.play(clip, AudioPosition::makeUI(pan), 0.5f, true, i % 2 == 0 ? "sfx" : "", pitch);
+	}
+
+	// The first few buffers start voices and allocate, which isn't what's being measured
+	for (int i = 0; i < 16; ++i) {
+		renderer.generateBuffer();
+	}
+
+	Result result;
+	result.mixer = mixerName;
+	result.voices = voices;
+	result.budget = renderer.getBufferBudget();
+	const auto nBuffers = size_t(std::max(0, options.buffers));
+	result.totals.reserve(nBuffers);
+	result.mixers.reserve(nBuffers);
+	result.decoders.reserve(nBuffers);
+	result.resamplers.reserve(nBuffers);
+	for (int i = 0; i < options.buffers; ++i) {
+		const auto& stats = renderer.generateBuffer();
+		result.average.total += stats.total;
+		result.average.mixer += stats.mixer;
+		result.average.decoder += stats.decoder;
+		result.average.resampler += stats.resampler;
+		result.maxTotal = std::max(result.maxTotal, stats.total);
+		result.overBudget += stats.total > result.budget ? 1 : 0;
+		result.totals.push_back(double(stats.total));
+		result.mixers.push_back(double(stats.mixer));
+		result.decoders.push_back(double(stats.decoder));
+		result.resamplers.push_back(double(stats.resampler));
+	}
+
+	const int64_t n = std::max(1, options.buffers);
+	result.average.total /= n;
+	result.average.mixer /= n;
+	result.average.decoder /= n;
+	result.average.resampler /= n;
+	results.push_back(result);
+
+	auto us = [] (int64_t ns) { return double(ns) / 1000.0; };
+	std::cout << std::left << std::setw(8) << result.mixer << std::right << std::setw(8) << result.voices << std::fixed << std::setprecision(1)
+		<< std::setw(10) << us(result.average.total) << std::setw(10) << us(result.maxTotal) << std::setw(10) << us(result.budget)
+		<< std::setw(10) << us(result.average.mixer) << std::setw(10) << us(result.average.decoder) << std::setw(10) << us(result.average.resampler)
+		<< std::setw(8) << result.overBudget << std::endl;
+}
+
+void BenchmarkStage::report() const
+{
+	if (!options.output.jsonPath.isEmpty()) {
+		BenchmarkReport json("audio", options.output.label);
+		for (auto& r: results) {
+			const auto prefix = r.mixer + "/" + toString(r.voices) + "/";
+			json.addMetric(prefix + "total", "ns").samples = r.totals;
+			json.addMetric(prefix + "mixer", "ns").samples = r.mixers;
+			json.addMetric(prefix + "decoder", "ns").samples = r.decoders;
+			json.addMetric(prefix + "resampler", "ns").samples = r.resamplers;
+			json.addMetric(prefix + "over_budget", "buffers").add(double(r.overBudget));
+		}
+		options.output.writeJSON(json);
+	}
+
+	// Times are nanoseconds per buffer
+	options.output.appendCSV([&] (std::ostream& out)
+	{
+		for (auto& r: results) {
+			out << options.output.label << "," << r.mixer << "," << r.voices
+				<< "," << r.average.total << "," << r.maxTotal << "," << r.budget
+				<< "," << r.average.mixer << "," << r.average.decoder << "," << r.average.resampler
+				<< "," << r.overBudget << "\n";
+		}
+	});
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "prec.h"
+
+// Runs the audio engine offline, without an output device, for each mixer available and a few voice counts, then quits.
+// Voices are a streamed music track plus static clips, some pitched (so resampled), spread over groups with different gains.
+// Results are printed, and also appended as CSV to --out=<file>, tagged with --label=<e.g. commit>.
+// --json=<file> writes each buffer's timings as a BenchmarkReport.
+class BenchmarkStage final : public Halley::Stage
+{
+public:
+	struct Options
+	{
+		Halley::BenchmarkOutput output;
+		Halley::String mixer = "all";
+		int buffers = 2000;
+		int voices = 0; // 0 runs a few different counts
+	};
+
+	explicit BenchmarkStage(Options options);
+
+	void init() override;
+
+private:
+	struct Result
+	{
+		Halley::String mixer;
+		int voices;
+		Halley::AudioBufferStats average;
+		int64_t maxTotal = 0;
+		int64_t budget = 0;
+		int overBudget = 0;
+
+		Halley::Vector<double> totals; // Each buffer's
+		Halley::Vector<double> mixers;
+		Halley::Vector<double> decoders;
+		Halley::Vector<double> resamplers;
+	};
+
+	Options options;
+	Halley::Vector<Result> results;
+
+	void run(const Halley::String& mixerName, Halley::AudioMixerType mixer, int voices);
+	void report() const;
+};
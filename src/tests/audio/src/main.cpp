@@ -1,5 +1,6 @@
 #include "prec.h"
 #include "test_stage.h"
+#include "benchmark_stage.h"
 
 using namespace Halley;
 
@@ -18,18 +19,39 @@ namespace Stages {
 class AudioTestGame final : public Game
 {
 public:
+	void init(const Environment&, const Vector<String>& args) override
+	{
+		for (auto& arg : args) {
+			if (arg == "--offline") {
+				offline = true;
+			} else if (auto mixer = BenchmarkOutput::getArgument(arg, "mixer")) {
+				benchmarkOptions.mixer = mixer.get();
+			} else if (auto voices = BenchmarkOutput::getArgument(arg, "voices")) {
+				benchmarkOptions.voices = voices->toInteger();
+			} else if (auto buffers = BenchmarkOutput::getArgument(arg, "buffers")) {
+				benchmarkOptions.buffers = buffers->toInteger();
+			} else if (!benchmarkOptions.output.parseArgument(arg)) {
+				std::cout << "Unknown argument \"" << arg << "\".\n";
+			}
+		}
+	}
+
 	int initPlugins(IPluginRegistry &registry) override
 	{
 		initSDLSystemPlugin(registry);
+		if (offline) {
+			// Mixes on its own, without an AudioOutputAPI
+			return 0;
+		}
 		initSDLAudioPlugin(registry);
 		initSDLInputPlugin(registry);
 		initOpenGLPlugin(registry);
 		return HalleyAPIFlags::Video | HalleyAPIFlags::Audio | HalleyAPIFlags::Input;
 	}
 
-	void initResourceLocator(Path dataPath, ResourceLocator& locator) override
+	void initResourceLocator(const Path& gamePath, const Path& assetsPath, const Path& unpackedAssetsPath, ResourceLocator& locator) override
 	{
-		locator.addFileSystem(dataPath);
+		locator.addFileSystem(unpackedAssetsPath);
 	}
 
 	std::unique_ptr<Stage> makeStage(StageID id) override
@@ -52,17 +74,26 @@ public:
 		return "halley/audio-test";
 	}
 
-	bool isDevBuild() const override
+	bool isDevMode() const override
 	{
 		return true;
 	}
 
 	std::unique_ptr<Stage> startGame(const HalleyAPI* api) override
 	{
+		if (offline) {
+			return std::make_unique<BenchmarkStage>(benchmarkOptions);
+		}
+
 		api->audio->startPlayback();
-		api->video->setWindow(WindowDefinition(WindowType::Window, Vector2i(1280, 720), getName()), true);
+		api->video->setWindow(WindowDefinition(WindowType::Window, Vector2i(1280, 720), getName()));
+		api->video->setVsync(true);
 		return std::make_unique<TestStage>();
 	}
+
+private:
+	bool offline = false;
+	BenchmarkStage::Options benchmarkOptions;
 };
 
 HalleyGame(AudioTestGame);
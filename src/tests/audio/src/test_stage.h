@@ -10,6 +10,7 @@ public:
 	void onRender(Halley::RenderContext& context) const override;
 
 private:
+	Halley::AudioHandle music;
 	bool playingMusic = true;
 	float pan = 0.0f;
 };
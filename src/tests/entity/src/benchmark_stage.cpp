@@ -0,0 +1,203 @@
+#include "benchmark_stage.h"
+#include "registry.h"
+#include "components/position_component.h"
+#include "components/time_component.h"
+#include "components/velocity_component.h"
+#include <iomanip>
+#include <limits>
+
+using namespace Halley;
+
+namespace {
+	constexpr Time timeStep = 1.0 / 60.0;
+
+	int getRepetitions(size_t n)
+	{
+		// Enough to get a stable minimum, without big worlds taking minutes
+		return n >= 1000000 ? 3 : (n >= 100000 ? 5 : 20);
+	}
+
+	EntityId addEntity(World& world, size_t i)
+	{
+		return world.createEntity()
+			.addComponent(PositionComponent(Vector2f(float(i % 1280), float(i % 720))))
+			.addComponent(VelocityComponent(Vector2f(1, 1)))
+			.getEntityId();
+	}
+}
+
+BenchmarkStage::BenchmarkStage(BenchmarkOutput output, String filter)
+	: output(std::move(output))
+	, filter(std::move(filter))
+	, jsonReport("entity", this->output.label)
+{}
+
+void BenchmarkStage::init()
+{
+	for (size_t n: { size_t(1000), size_t(10000), size_t(100000), size_t(1000000) }) {
+		benchmarkCreate(n);
+		for (size_t dirty: { size_t(1), size_t(10), size_t(100) }) {
+			benchmarkUpdateEntities(n, dirty);
+		}
+		benchmarkIterate(n);
+		benchmarkTryGetComponent(n);
+		benchmarkMessages(n);
+	}
+
+	report();
+	getCoreAPI().quit();
+}
+
+template <typename Setup, typename Body>
+void BenchmarkStage::run(const String& name, size_t n, Setup setup, Body body)
+{
+	if (!filter.isEmpty() && !name.contains(filter)) {
+		return;
+	}
+
+	// Best of a few runs, as anything slower than that is noise from elsewhere. Setup isn't timed, nor is tearing it down.
+	int64_t best = std::numeric_limits<int64_t>::max();
+	auto& metric = jsonReport.addMetric(name + "/" + toString(n), "ns");
+	for (int i = 0; i < getRepetitions(n); ++i) {
+		auto state = setup();
+		Stopwatch timer;
+		body(state);
+		const auto elapsed = timer.elapsedNanoSeconds();
+		best = std::min(best, elapsed);
+		metric.add(double(elapsed));
+	}
+
+	results.push_back(Result{ name, n, best });
+	std::cout << std::left << std::setw(20) << name << std::right << std::setw(9) << n
+		<< std::fixed << std::setw(12) << std::setprecision(3) << (double(best) / 1000000.0) << " ms"
+		<< std::setw(10) << std::setprecision(1) << (double(best) / double(n)) << " ns/entity" << std::endl;
+}
+
+std::unique_ptr<World> BenchmarkStage::makeWorld(Vector<String> systemNames, size_t n, Vector<EntityId>* ids) const
+{
+	auto world = std::make_unique<World>(&getAPI(), false);
+	for (auto& name: systemNames) {
+		world->addSystem(createSystem(name), TimeLine::FixedUpdate);
+	}
+	if (ids) {
+		ids->reserve(n);
+	}
+	for (size_t i = 0; i < n; ++i) {
+		auto id = addEntity(*world, i);
+		if (ids) {
+			ids->push_back(id);
+		}
+	}
+	world->spawnPending();
+	return world;
+}
+
+void BenchmarkStage::benchmarkCreate(size_t n)
+{
+	run("create_spawn", n, [&] ()
+	{
+		return makeWorld({ "BenchmarkIterateSystem" }, 0);
+	}, [&] (std::unique_ptr<World>& world)
+	{
+		for (size_t i = 0; i < n; ++i) {
+			addEntity(*world, i);
+		}
+		world->spawnPending();
+	});
+}
+
+void BenchmarkStage::benchmarkUpdateEntities(size_t n, size_t dirtyPercent)
+{
+	// Flipping a component on some entities moves them out of (or back into) the family, which is what updateEntities() has to do
+	Vector<EntityId> ids;
+	auto world = makeWorld({ "BenchmarkIterateSystem" }, n, &ids);
+	const size_t stride = 100 / dirtyPercent;
+
+	run("update_dirty_" + toString(dirtyPercent) + "%", n, [&] ()
+	{
+		for (size_t i = 0; i < ids.size(); i += stride) {
+			auto e = world->getEntity(ids[i]);
+			if (e.hasComponent<VelocityComponent>()) {
+				e.removeComponent<VelocityComponent>();
+			} else {
+				e.addComponent(VelocityComponent(Vector2f(1, 1)));
+			}
+		}
+		return world.get();
+	}, [&] (World* w)
+	{
+		w->spawnPending();
+	});
+}
+
+void BenchmarkStage::benchmarkIterate(size_t n)
+{
+	auto world = makeWorld({ "BenchmarkIterateSystem" }, n);
+	world->step(TimeLine::FixedUpdate, timeStep);
+
+	run("family_iterate", n, [&] ()
+	{
+		return world.get();
+	}, [&] (World* w)
+	{
+		w->step(TimeLine::FixedUpdate, timeStep);
+	});
+}
+
+void BenchmarkStage::benchmarkTryGetComponent(size_t n)
+{
+	// Half of the lookups miss, as systems often check for optional components entities mostly don't have
+	Vector<EntityId> ids;
+	auto world = makeWorld({}, n, &ids);
+	for (size_t i = 0; i < ids.size(); i += 2) {
+		world->getEntity(ids[i]).addComponent(TimeComponent(0.0f));
+	}
+	world->spawnPending();
+
+	float total = 0;
+	run("try_get_component", n, [&] ()
+	{
+		return world.get();
+	}, [&] (World* w)
+	{
+		for (auto& id: ids) {
+			auto e = w->getEntity(id);
+			if (auto time = e.tryGetComponent<TimeComponent>()) {
+				total += time->elapsed;
+			}
+			total += e.tryGetComponent<PositionComponent>()->position.x;
+		}
+	});
+
+	// So the lookups can't be optimised out
+	if (total < 0) {
+		std::cout << total;
+	}
+}
+
+void BenchmarkStage::benchmarkMessages(size_t n)
+{
+	// Every entity gets one message a step, which is received on the next one
+	auto world = makeWorld({ "BenchmarkSendSystem", "BenchmarkReceiveSystem" }, n);
+	world->step(TimeLine::FixedUpdate, timeStep);
+	world->step(TimeLine::FixedUpdate, timeStep);
+
+	run("messages", n, [&] ()
+	{
+		return world.get();
+	}, [&] (World* w)
+	{
+		w->step(TimeLine::FixedUpdate, timeStep);
+	});
+}
+
+void BenchmarkStage::report() const
+{
+	output.writeJSON(jsonReport);
+	output.appendCSV([&] (std::ostream& out)
+	{
+		for (auto& r: results) {
+			out << output.label << "," << r.name << "," << r.entities << "," << r.nanoSeconds << "\n";
+		}
+	});
+}
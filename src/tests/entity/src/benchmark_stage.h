@@ -0,0 +1,40 @@
+#pragma once
+
+#include "prec.h"
+
+// Times the entity system's hot paths at increasing world sizes, then quits. Run the test with --benchmark.
+// Results are printed, and also appended as CSV to --benchmark-out=<file>, tagged with --benchmark-label=<e.g. commit>,
+// so runs from different commits can be compared. --benchmark-json=<file> writes every repetition, as a BenchmarkReport.
+class BenchmarkStage final : public Halley::EntityStage
+{
+public:
+	BenchmarkStage(Halley::BenchmarkOutput output, Halley::String filter);
+
+	void init() override;
+
+private:
+	struct Result
+	{
+		Halley::String name;
+		size_t entities;
+		int64_t nanoSeconds;
+	};
+
+	Halley::BenchmarkOutput output;
+	Halley::String filter;
+	Halley::Vector<Result> results;
+	Halley::BenchmarkReport jsonReport;
+
+	template <typename Setup, typename Body>
+	void run(const Halley::String& name, size_t n, Setup setup, Body body);
+
+	std::unique_ptr<Halley::World> makeWorld(Halley::Vector<Halley::String> systemNames, size_t n, Halley::Vector<Halley::EntityId>* ids = nullptr) const;
+
+	void benchmarkCreate(size_t n);
+	void benchmarkUpdateEntities(size_t n, size_t dirtyPercent);
+	void benchmarkIterate(size_t n);
+	void benchmarkTryGetComponent(size_t n);
+	void benchmarkMessages(size_t n);
+
+	void report() const;
+};
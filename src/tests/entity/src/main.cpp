@@ -1,5 +1,6 @@
 #include "prec.h"
 #include "test_stage.h"
+#include "benchmark_stage.h"
 
 using namespace Halley;
 
@@ -31,18 +32,34 @@ public:
 class EntityTestGame final : public Game
 {
 public:
+	void init(const Environment&, const Vector<String>& args) override
+	{
+		for (auto& arg : args) {
+			if (arg == "--benchmark") {
+				benchmark = true;
+			} else if (auto filter = BenchmarkOutput::getArgument(arg, "benchmark-filter")) {
+				benchmarkFilter = filter.get();
+			} else if (!benchmarkOutput.parseArgument(arg, "benchmark-")) {
+				std::cout << "Unknown argument \"" << arg << "\".\n";
+			}
+		}
+	}
+
 	int initPlugins(IPluginRegistry &registry) override
 	{
 		initSDLSystemPlugin(registry);
+		if (benchmark) {
+			return 0;
+		}
 		initSDLAudioPlugin(registry);
 		initSDLInputPlugin(registry);
 		initOpenGLPlugin(registry);
 		return HalleyAPIFlags::Video | HalleyAPIFlags::Audio | HalleyAPIFlags::Input;
 	}
 
-	void initResourceLocator(Path dataPath, ResourceLocator& locator) override
+	void initResourceLocator(const Path& gamePath, const Path& assetsPath, const Path& unpackedAssetsPath, ResourceLocator& locator) override
 	{
-		locator.addFileSystem(dataPath);
+		locator.addFileSystem(unpackedAssetsPath);
 	}
 
 	std::unique_ptr<Stage> makeStage(StageID id) override
@@ -69,16 +86,26 @@ public:
 		return "halley/entity-test";
 	}
 
-	bool isDevBuild() const override
+	bool isDevMode() const override
 	{
 		return true;
 	}
 
 	std::unique_ptr<Stage> startGame(const HalleyAPI* api) override
 	{
-		api->video->setWindow(WindowDefinition(WindowType::Window, Vector2i(1280, 720), getName()), true);
+		if (benchmark) {
+			return std::make_unique<BenchmarkStage>(benchmarkOutput, benchmarkFilter);
+		}
+
+		api->video->setWindow(WindowDefinition(WindowType::Window, Vector2i(1280, 720), getName()));
+		api->video->setVsync(true);
 		return std::make_unique<TestStage>();
 	}
+
+private:
+	bool benchmark = false;
+	BenchmarkOutput benchmarkOutput;
+	String benchmarkFilter;
 };
 
 HalleyGame(EntityTestGame);
@@ -0,0 +1,11 @@
+#include "systems/benchmark_iterate_system.h"
+
+class BenchmarkIterateSystem final : public BenchmarkIterateSystemBase<BenchmarkIterateSystem> {
+public:
+	void update(Halley::Time time, MainFamily& e)
+	{
+		e.position.position += e.velocity.velocity * float(time);
+	}
+};
+
+REGISTER_SYSTEM(BenchmarkIterateSystem)
@@ -0,0 +1,15 @@
+#include "systems/benchmark_receive_system.h"
+
+class BenchmarkReceiveSystem final : public BenchmarkReceiveSystemBase<BenchmarkReceiveSystem> {
+public:
+	void update(Halley::Time, MainFamily&)
+	{
+	}
+
+	void onMessageReceived(const BenchmarkPingMessage& msg, MainFamily& e)
+	{
+		e.velocity.velocity.x += msg.value;
+	}
+};
+
+REGISTER_SYSTEM(BenchmarkReceiveSystem)
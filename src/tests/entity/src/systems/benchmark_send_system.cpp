@@ -0,0 +1,11 @@
+#include "systems/benchmark_send_system.h"
+
+class BenchmarkSendSystem final : public BenchmarkSendSystemBase<BenchmarkSendSystem> {
+public:
+	void update(Halley::Time time, MainFamily& e)
+	{
+		sendMessage(e.entityId, BenchmarkPingMessage(e.position.position.x * float(time)));
+	}
+};
+
+REGISTER_SYSTEM(BenchmarkSendSystem)
@@ -0,0 +1,126 @@
+#include "loopback_network.h"
+
+using namespace Halley;
+
+namespace {
+	class LoopbackConnection final : public IConnection
+	{
+	public:
+		LoopbackConnection(std::shared_ptr<LoopbackNetworkService::Link> link, int side)
+			: link(std::move(link))
+			, side(side)
+		{}
+
+		void close() override
+		{
+			link->closed = true;
+		}
+
+		ConnectionStatus getStatus() const override
+		{
+			if (link->closed) {
+				return ConnectionStatus::Closed;
+			}
+			return link->accepted ? ConnectionStatus::Connected : ConnectionStatus::Connecting;
+		}
+
+		void send(OutboundNetworkPacket&& packet) override
+		{
+			// Like UDP, anything sent before the other end is there is just lost
+			if (getStatus() == ConnectionStatus::Connected) {
+				Bytes bytes(packet.getSize());
+				packet.copyTo(gsl::as_writeable_bytes(gsl::span<Byte>(bytes)));
+				link->inbox[1 - side].push_back(std::move(bytes));
+			}
+		}
+
+		bool receive(InboundNetworkPacket& packet) override
+		{
+			auto& inbox = link->inbox[side];
+			if (inbox.empty()) {
+				return false;
+			}
+			packet = InboundNetworkPacket(gsl::as_bytes(gsl::span<const Byte>(inbox.front())));
+			inbox.pop_front();
+			return true;
+		}
+
+	private:
+		std::shared_ptr<LoopbackNetworkService::Link> link;
+		int side;
+	};
+}
+
+bool LoopbackConditions::isPerfect() const
+{
+	return avgLag <= 0 && lagVariance <= 0 && packetLoss <= 0 && duplication <= 0;
+}
+
+LoopbackNetworkService::LoopbackNetworkService(LoopbackNetwork& network, int port, LoopbackConditions conditions)
+	: network(network)
+	, port(port)
+	, conditions(conditions)
+{}
+
+LoopbackNetworkService::~LoopbackNetworkService()
+{
+	setAcceptingConnections(false);
+	for (auto& p: pending) {
+		p->closed = true;
+	}
+}
+
+void LoopbackNetworkService::update()
+{
+}
+
+void LoopbackNetworkService::setAcceptingConnections(bool accept)
+{
+	if (accept == accepting) {
+		return;
+	}
+
+	accepting = accept;
+	if (accepting) {
+		if (network.listening.find(port) != network.listening.end()) {
+			throw Exception("Loopback port " + toString(port) + " is already in use.", HalleyExceptions::Network);
+		}
+		network.listening[port] = this;
+	} else {
+		network.listening.erase(port);
+	}
+}
+
+std::shared_ptr<IConnection> LoopbackNetworkService::tryAcceptConnection()
+{
+	while (accepting && !pending.empty()) {
+		auto link = pending.front();
+		pending.pop_front();
+		if (!link->closed) {
+			link->accepted = true;
+			return makeConnection(std::move(link), 1);
+		}
+	}
+	return {};
+}
+
+std::shared_ptr<IConnection> LoopbackNetworkService::connect(String, int remotePort)
+{
+	auto link = std::make_shared<Link>();
+	auto iter = network.listening.find(remotePort);
+	if (iter != network.listening.end()) {
+		iter->second->pending.push_back(link);
+	} else {
+		link->closed = true;
+	}
+	return makeConnection(std::move(link), 0);
+}
+
+std::shared_ptr<IConnection> LoopbackNetworkService::makeConnection(std::shared_ptr<Link> link, int side) const
+{
+	auto connection = std::make_shared<LoopbackConnection>(std::move(link), side);
+	if (conditions.isPerfect()) {
+		return connection;
+	}
+	return std::make_shared<InstabilitySimulator>(connection, conditions.avgLag, conditions.lagVariance, conditions.packetLoss, conditions.duplication);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "prec.h"
+#include <deque>
+#include <map>
+
+// Lets several NetworkSessions in the same process talk to each other without any sockets.
+// Whatever a service connects or accepts can go through an InstabilitySimulator, to fake lag, loss and duplication.
+struct LoopbackConditions
+{
+	float avgLag = 0;
+	float lagVariance = 0;
+	float packetLoss = 0;
+	float duplication = 0;
+
+	bool isPerfect() const;
+};
+
+class LoopbackNetworkService;
+
+class LoopbackNetwork
+{
+	friend class LoopbackNetworkService;
+
+private:
+	std::map<int, LoopbackNetworkService*> listening;
+};
+
+class LoopbackNetworkService final : public Halley::NetworkService
+{
+public:
+	LoopbackNetworkService(LoopbackNetwork& network, int port, LoopbackConditions conditions);
+	~LoopbackNetworkService();
+
+	void update() override;
+
+	void setAcceptingConnections(bool accepting) override;
+	std::shared_ptr<Halley::IConnection> tryAcceptConnection() override;
+	std::shared_ptr<Halley::IConnection> connect(Halley::String address, int port) override;
+
+	struct Link
+	{
+		std::array<std::deque<Halley::Bytes>, 2> inbox; // By the side that receives it
+		bool accepted = false;
+		bool closed = false;
+	};
+
+private:
+	LoopbackNetwork& network;
+	int port;
+	LoopbackConditions conditions;
+	bool accepting = false;
+	std::deque<std::shared_ptr<Link>> pending;
+
+	std::shared_ptr<Halley::IConnection> makeConnection(std::shared_ptr<Link> link, int side) const;
+};
@@ -1,22 +1,64 @@
 #include "prec.h"
 #include "test_stage.h"
+#include "soak_stage.h"
 
 using namespace Halley;
 
 void initOpenGLPlugin(IPluginRegistry &registry);
+void initSDLSystemPlugin(IPluginRegistry &registry);
+void initSDLInputPlugin(IPluginRegistry &registry);
+void initAsioPlugin(IPluginRegistry &registry);
 
 class NetworkTestGame final : public Game
 {
 public:
+	void init(const Environment&, const Vector<String>& args) override
+	{
+		for (auto& arg : args) {
+			if (arg == "--soak") {
+				soak = true;
+			} else if (auto clients = BenchmarkOutput::getArgument(arg, "clients")) {
+				soakOptions.clients = clients->toInteger();
+			} else if (auto duration = BenchmarkOutput::getArgument(arg, "duration")) {
+				soakOptions.duration = duration->toFloat();
+			} else if (auto tickRate = BenchmarkOutput::getArgument(arg, "tick-rate")) {
+				soakOptions.tickRate = tickRate->toInteger();
+			} else if (auto messages = BenchmarkOutput::getArgument(arg, "messages")) {
+				soakOptions.messagesPerTick = messages->toInteger();
+			} else if (auto messageSize = BenchmarkOutput::getArgument(arg, "message-size")) {
+				soakOptions.messageSize = messageSize->toInteger();
+			} else if (auto stateSize = BenchmarkOutput::getArgument(arg, "state-size")) {
+				soakOptions.stateSize = stateSize->toInteger();
+			} else if (auto lag = BenchmarkOutput::getArgument(arg, "lag")) {
+				soakOptions.conditions.avgLag = lag->toFloat();
+			} else if (auto lagVariance = BenchmarkOutput::getArgument(arg, "lag-variance")) {
+				soakOptions.conditions.lagVariance = lagVariance->toFloat();
+			} else if (auto loss = BenchmarkOutput::getArgument(arg, "loss")) {
+				soakOptions.conditions.packetLoss = loss->toFloat();
+			} else if (auto duplication = BenchmarkOutput::getArgument(arg, "duplication")) {
+				soakOptions.conditions.duplication = duplication->toFloat();
+			} else if (!soakOptions.output.parseArgument(arg)) {
+				std::cout << "Unknown argument \"" << arg << "\".\n";
+			}
+		}
+	}
+
 	int initPlugins(IPluginRegistry &registry) override
 	{
+		initSDLSystemPlugin(registry);
+		if (soak) {
+			// Everything goes through a loopback network, so no devices (or sockets) are needed
+			return 0;
+		}
+		initSDLInputPlugin(registry);
 		initOpenGLPlugin(registry);
-		return HalleyAPIFlags::Video | HalleyAPIFlags::Audio | HalleyAPIFlags::Input;
+		initAsioPlugin(registry);
+		return HalleyAPIFlags::Video | HalleyAPIFlags::Input | HalleyAPIFlags::Network;
 	}
 
-	void initResourceLocator(Path dataPath, ResourceLocator& locator) override
+	void initResourceLocator(const Path& gamePath, const Path& assetsPath, const Path& unpackedAssetsPath, ResourceLocator& locator) override
 	{
-		locator.addFileSystem(dataPath);
+		locator.addFileSystem(unpackedAssetsPath);
 	}
 
 	String getName() const override
@@ -29,16 +71,24 @@ public:
 		return "halley/network-test";
 	}
 
-	bool isDevBuild() const override
+	bool isDevMode() const override
 	{
 		return true;
 	}
 
 	std::unique_ptr<Stage> startGame(const HalleyAPI* api) override
 	{
-		api->video->setWindow(WindowDefinition(WindowType::Window, Vector2i(1280, 720), getName()), false);
+		if (soak) {
+			return std::make_unique<SoakStage>(soakOptions);
+		}
+		api->video->setWindow(WindowDefinition(WindowType::Window, Vector2i(1280, 720), getName()));
+		api->video->setVsync(false);
 		return std::make_unique<TestStage>();
 	}
+
+private:
+	bool soak = false;
+	SoakStage::Options soakOptions;
 };
 
 HalleyGame(NetworkTestGame);
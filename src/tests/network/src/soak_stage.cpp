@@ -0,0 +1,405 @@
+#include "soak_stage.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <thread>
+
+using namespace Halley;
+
+namespace {
+	using Clock = std::chrono::steady_clock;
+
+	constexpr int hostPort = 4113;
+	constexpr float joinTimeout = 10.0f;
+
+	int64_t getNow()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+	}
+
+	struct MessageHeader
+	{
+		int32_t sender;
+		uint32_t seq;
+		int64_t sentAt; // Nanoseconds, everyone shares the same clock
+	};
+
+	float getPercentile(Vector<float> values, float fraction)
+	{
+		if (values.empty()) {
+			return 0;
+		}
+		std::sort(values.begin(), values.end());
+		const auto idx = std::min(values.size() - 1, size_t(std::lround(double(fraction) * double(values.size() - 1))));
+		return values[idx];
+	}
+
+	struct StatsTotals
+	{
+		uint64_t packetsSent = 0;
+		uint64_t bytesSent = 0;
+		uint64_t subPacketsSent = 0;
+		uint64_t subPacketsResent = 0;
+		uint64_t subPacketsLost = 0;
+		uint64_t sharedDataSent = 0;
+		uint64_t sharedDataResent = 0;
+
+		explicit StatsTotals(const std::vector<NetworkConnectionStats>& stats)
+		{
+			for (auto& s: stats) {
+				packetsSent += s.packetsSent;
+				bytesSent += s.bytesSent;
+				subPacketsSent += s.subPacketsSent;
+				subPacketsResent += s.subPacketsResent;
+				subPacketsLost += s.subPacketsLost;
+				for (auto& c: s.channels) {
+					if (c.channel == -1) {
+						sharedDataSent += c.messagesSent;
+						sharedDataResent += c.messagesResent;
+					}
+				}
+			}
+		}
+
+		// Peers that went away between the two are simply missing from the later one
+		static uint64_t diff(uint64_t after, uint64_t before)
+		{
+			return after > before ? after - before : 0;
+		}
+	};
+
+	float getRatio(uint64_t a, uint64_t b)
+	{
+		return b > 0 ? float(double(a) / double(b)) : 0.0f;
+	}
+
+	// Every message's latency would make for a huge report, and some thousands are plenty to tell a change apart
+	Vector<double> getEvenlySpaced(const Vector<float>& values, size_t maxCount)
+	{
+		Vector<double> result;
+		const size_t stride = std::max(size_t(1), (values.size() + maxCount - 1) / maxCount);
+		result.reserve(values.size() / stride + 1);
+		for (size_t i = 0; i < values.size(); i += stride) {
+			result.push_back(double(values[i]));
+		}
+		return result;
+	}
+}
+
+class SoakStage::SessionData final : public SharedData
+{
+public:
+	uint32_t tick = 0;
+	int64_t sentAt = 0;
+
+	void serialize(Serializer& s) const override
+	{
+		s << tick;
+		s << sentAt;
+	}
+
+	void deserialize(Deserializer& s) override
+	{
+		s >> tick;
+		s >> sentAt;
+	}
+};
+
+class SoakStage::PeerData final : public SharedData
+{
+public:
+	uint32_t tick = 0;
+	int64_t sentAt = 0;
+	std::vector<float> values;
+
+	void serialize(Serializer& s) const override
+	{
+		s << tick;
+		s << sentAt;
+		s << values;
+	}
+
+	void deserialize(Deserializer& s) override
+	{
+		s >> tick;
+		s >> sentAt;
+		s >> values;
+	}
+};
+
+SoakStage::Options::Options()
+{
+	conditions.avgLag = 0.05f;
+	conditions.lagVariance = 0.02f;
+	conditions.packetLoss = 0.05f;
+	conditions.duplication = 0.02f;
+}
+
+SoakStage::SoakStage(Options options)
+	: options(std::move(options))
+{}
+
+SoakStage::~SoakStage() = default;
+
+void SoakStage::init()
+{
+	Expects(options.clients > 0);
+	Expects(options.tickRate > 0);
+	Expects(options.messageSize >= int(sizeof(MessageHeader)) && options.messageSize <= 1024);
+
+	const auto& c = options.conditions;
+	std::cout << "Network soak test: " << options.clients << " clients for " << options.duration << "s at " << options.tickRate << " Hz, "
+		<< options.messagesPerTick << " x " << options.messageSize << " byte messages and " << options.stateSize << " floats of SharedData per peer per tick" << std::endl;
+	std::cout << "Lag " << int(c.avgLag * 1000) << " +/- " << int(c.lagVariance * 1000) << " ms, " << c.packetLoss * 100 << "% loss, " << c.duplication * 100 << "% duplication" << std::endl;
+
+	join();
+	run();
+	peers.clear();
+	getCoreAPI().quit();
+}
+
+void SoakStage::join()
+{
+	auto makePeer = [&] ()
+	{
+		auto peer = std::make_unique<Peer>();
+		peer->service = std::make_unique<LoopbackNetworkService>(network, hostPort + int(peers.size()), options.conditions);
+		peer->session = std::make_unique<Session>(*peer->service);
+		peers.push_back(std::move(peer));
+		return peers.back().get();
+	};
+
+	auto host = makePeer();
+	host->session->setMaxClients(options.clients + 1);
+	host->session->host(hostPort);
+	host->joined = true;
+
+	for (int i = 0; i < options.clients; ++i) {
+		makePeer()->session->join("localhost", hostPort);
+	}
+
+	// SetPeerId is only sent once, so under loss some clients might never finish joining; those are reported and left out
+	const auto start = Clock::now();
+	const auto tickLength = std::chrono::duration<double>(1.0 / options.tickRate);
+	auto nextTick = start;
+	while (std::chrono::duration<float>(Clock::now() - start).count() < joinTimeout) {
+		bool allJoined = true;
+		for (auto& p: peers) {
+			step(*p, getNow(), false);
+			p->joined = p->joined || p->session->getStatus() == ConnectionStatus::Connected;
+			allJoined = allJoined && p->joined;
+		}
+		if (allJoined) {
+			break;
+		}
+
+		nextTick += std::chrono::duration_cast<Clock::duration>(tickLength);
+		std::this_thread::sleep_until(nextTick);
+	}
+
+	for (auto& p: peers) {
+		if (!p->joined) {
+			p->session->close();
+		}
+	}
+	peers.erase(std::remove_if(peers.begin(), peers.end(), [] (const std::unique_ptr<Peer>& p) { return !p->joined; }), peers.end());
+	std::cout << "Joined: " << (int(peers.size()) - 1) << "/" << options.clients << " clients in " << std::chrono::duration<float>(Clock::now() - start).count() << "s" << std::endl;
+}
+
+void SoakStage::run()
+{
+	const auto before = NetworkStats::capture();
+	for (auto& p: peers) {
+		p->updateTime = 0;
+		p->tickTimes.clear();
+		p->messagesSent = 0;
+	}
+
+	const auto tickLength = std::chrono::duration<double>(1.0 / options.tickRate);
+	const int nTicks = std::max(1, int(std::lround(options.duration * float(options.tickRate))));
+	const auto start = Clock::now();
+	auto nextTick = start;
+	for (int i = 0; i < nTicks; ++i) {
+		++tick;
+		for (auto& p: peers) {
+			step(*p, getNow(), true);
+		}
+
+		nextTick += std::chrono::duration_cast<Clock::duration>(tickLength);
+		std::this_thread::sleep_until(nextTick);
+	}
+
+	const auto after = NetworkStats::capture();
+	report(before, after);
+}
+
+void SoakStage::step(Peer& peer, int64_t now, bool measure)
+{
+	auto& session = *peer.session;
+	const auto startTime = getNow();
+
+	if (measure && session.getStatus() == ConnectionStatus::Connected) {
+		if (session.getType() == NetworkSessionType::Host) {
+			auto& sessionData = session.getMutableSessionSharedData();
+			sessionData.tick = tick;
+			sessionData.sentAt = now;
+			sessionData.markModified();
+		}
+
+		// A quarter of the values change every tick, which is roughly what deltas are meant for
+		auto& data = session.getMySharedData();
+		data.tick = tick;
+		data.sentAt = now;
+		data.values.resize(size_t(options.stateSize));
+		for (size_t i = tick % 4; i < data.values.size(); i += 4) {
+			data.values[i] = std::sin(float(tick) * 0.05f + float(i));
+		}
+		data.markModified();
+
+		Bytes bytes(size_t(options.messageSize), 0);
+		for (int i = 0; i < options.messagesPerTick; ++i) {
+			MessageHeader header{ session.getMyPeerId(), peer.nextSeq++, now };
+			memcpy(bytes.data(), &header, sizeof(header));
+			session.send(OutboundNetworkPacket(bytes));
+			++peer.messagesSent;
+		}
+	}
+
+	session.update();
+	receive(peer, getNow(), measure);
+
+	const auto elapsed = getNow() - startTime;
+	peer.updateTime += elapsed;
+	if (measure) {
+		peer.tickTimes.push_back(double(elapsed));
+	}
+}
+
+void SoakStage::receive(Peer& peer, int64_t now, bool measure)
+{
+	auto& session = *peer.session;
+
+	InboundNetworkPacket packet;
+	while (session.receive(packet)) {
+		auto bytes = packet.getBytes();
+		if (measure && size_t(bytes.size()) >= sizeof(MessageHeader)) {
+			MessageHeader header;
+			memcpy(&header, bytes.data(), sizeof(header));
+			messageLatencies.push_back(float(now - header.sentAt) / 1000000.0f);
+			++messagesDelivered;
+		}
+	}
+
+	if (!measure || session.getStatus() != ConnectionStatus::Connected) {
+		return;
+	}
+
+	// Only the latest state is ever delivered, so skipped ticks aren't lost, just superseded
+	auto observe = [&] (int ownerId, uint32_t dataTick, int64_t sentAt)
+	{
+		auto& last = peer.lastTickSeen[ownerId];
+		if (dataTick != 0 && dataTick != last) {
+			last = dataTick;
+			sharedDataLatencies.push_back(float(now - sentAt) / 1000000.0f);
+		}
+	};
+
+	if (session.getType() == NetworkSessionType::Client) {
+		auto& sessionData = session.getSessionSharedData();
+		observe(-1, sessionData.tick, sessionData.sentAt);
+	}
+	for (auto& other: peers) {
+		const int id = other->session->getMyPeerId();
+		if (id != session.getMyPeerId()) {
+			if (auto data = session.tryGetClientSharedData(id)) {
+				observe(id, data->tick, data->sentAt);
+			}
+		}
+	}
+}
+
+void SoakStage::report(const std::vector<NetworkConnectionStats>& beforeStats, const std::vector<NetworkConnectionStats>& afterStats) const
+{
+	const StatsTotals before(beforeStats);
+	const StatsTotals after(afterStats);
+	auto diff = [&] (uint64_t StatsTotals::* field) { return StatsTotals::diff(after.*field, before.*field); };
+
+	const int nPeers = int(peers.size());
+	const float duration = std::max(options.duration, 0.001f);
+
+	uint64_t messagesSent = 0;
+	int64_t clientTime = 0;
+	int64_t maxClientTime = 0;
+	for (int i = 0; i < nPeers; ++i) {
+		messagesSent += peers[i]->messagesSent;
+		if (i > 0) {
+			clientTime += peers[i]->updateTime;
+			maxClientTime = std::max(maxClientTime, peers[i]->updateTime);
+		}
+	}
+	const uint64_t messagesExpected = messagesSent * uint64_t(std::max(0, nPeers - 1));
+
+	const float bytesPerSecond = float(diff(&StatsTotals::bytesSent)) / duration;
+	const float messageP50 = getPercentile(messageLatencies, 0.5f);
+	const float messageP99 = getPercentile(messageLatencies, 0.99f);
+	const float sharedDataP50 = getPercentile(sharedDataLatencies, 0.5f);
+	const float sharedDataP99 = getPercentile(sharedDataLatencies, 0.99f);
+	const float sharedDataResendRate = getRatio(diff(&StatsTotals::sharedDataResent), diff(&StatsTotals::sharedDataSent));
+	const float subPacketResendRate = getRatio(diff(&StatsTotals::subPacketsResent), diff(&StatsTotals::subPacketsSent));
+	const float subPacketLossRate = getRatio(diff(&StatsTotals::subPacketsLost), diff(&StatsTotals::subPacketsSent));
+
+	// Per tick, so it can be compared against the tick budget
+	const auto ticks = int64_t(std::max(1, int(std::lround(options.duration * float(options.tickRate)))));
+	const float hostUs = float(peers[0]->updateTime / ticks) / 1000.0f;
+	const float clientUs = nPeers > 1 ? float(clientTime / (ticks * (nPeers - 1))) / 1000.0f : 0.0f;
+	const float maxClientUs = float(maxClientTime / ticks) / 1000.0f;
+
+	std::cout << std::fixed << std::setprecision(2);
+	std::cout << std::left << std::setw(16) << "throughput" << bytesPerSecond / 1024.0f << " KB/s sent in total, " << bytesPerSecond / 1024.0f / float(std::max(1, nPeers)) << " KB/s per peer, "
+		<< float(diff(&StatsTotals::packetsSent)) / duration << " packets/s" << std::endl;
+	std::cout << std::setw(16) << "messages" << messagesDelivered << "/" << messagesExpected << " delivered (" << getRatio(messagesDelivered, messagesExpected) * 100.0f << "%), "
+		<< "p50 " << messageP50 << " ms, p99 " << messageP99 << " ms" << std::endl;
+	std::cout << std::setw(16) << "shared data" << sharedDataLatencies.size() << " updates seen, p50 " << sharedDataP50 << " ms, p99 " << sharedDataP99 << " ms" << std::endl;
+	std::cout << std::setw(16) << "resends" << sharedDataResendRate * 100.0f << "% of SharedData updates, " << subPacketResendRate * 100.0f << "% of sub-packets, "
+		<< subPacketLossRate * 100.0f << "% of sub-packets lost" << std::endl;
+	std::cout << std::setw(16) << "cpu" << "host " << hostUs << " us/tick, clients " << clientUs << " us/tick on average (" << maxClientUs << " max)" << std::endl;
+	std::cout << std::defaultfloat;
+
+	if (!options.output.jsonPath.isEmpty()) {
+		writeJSON(bytesPerSecond, getRatio(messagesDelivered, messagesExpected), sharedDataResendRate, subPacketResendRate);
+	}
+
+	options.output.appendCSV([&] (std::ostream& out)
+	{
+		const auto& c = options.conditions;
+		out << options.output.label << "," << options.clients << "," << (nPeers - 1) << "," << options.duration << "," << options.tickRate
+			<< "," << options.messagesPerTick << "," << options.messageSize << "," << options.stateSize
+			<< "," << c.avgLag << "," << c.lagVariance << "," << c.packetLoss << "," << c.duplication
+			<< "," << bytesPerSecond << "," << messagesDelivered << "," << messagesExpected << "," << messageP50 << "," << messageP99
+			<< "," << sharedDataP50 << "," << sharedDataP99 << "," << sharedDataResendRate << "," << subPacketResendRate << "," << subPacketLossRate
+			<< "," << hostUs << "," << clientUs << "," << maxClientUs << "\n";
+	});
+}
+
+void SoakStage::writeJSON(float bytesPerSecond, float deliveredRate, float sharedDataResendRate, float subPacketResendRate) const
+{
+	constexpr size_t maxLatencySamples = 10000;
+
+	BenchmarkReport json("network_soak", options.output.label);
+	json.addMetric("host_update", "ns").samples = peers[0]->tickTimes;
+	auto& clientUpdate = json.addMetric("client_update", "ns");
+	for (size_t i = 1; i < peers.size(); ++i) {
+		clientUpdate.samples.insert(clientUpdate.samples.end(), peers[i]->tickTimes.begin(), peers[i]->tickTimes.end());
+	}
+	json.addMetric("message_latency", "ms").samples = getEvenlySpaced(messageLatencies, maxLatencySamples);
+	json.addMetric("shared_data_latency", "ms").samples = getEvenlySpaced(sharedDataLatencies, maxLatencySamples);
+
+	// Totals over the whole run, so there's only one sample of each to go by
+	json.add("sent", "bytes/s", bytesPerSecond);
+	json.add("messages_delivered", "ratio", deliveredRate, BenchmarkReport::Better::Higher);
+	json.add("shared_data_resends", "ratio", sharedDataResendRate);
+	json.add("sub_packet_resends", "ratio", subPacketResendRate);
+
+	options.output.writeJSON(json);
+}
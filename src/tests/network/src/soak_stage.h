@@ -0,0 +1,66 @@
+#pragma once
+
+#include "prec.h"
+#include "loopback_network.h"
+
+// Runs a host and a number of clients in this process, all through NetworkSession over a loopback network with simulated
+// lag, loss and duplication, then quits. Every peer changes its SharedData and sends a few messages each tick.
+// Results are printed, and also appended as CSV to --out=<file>, tagged with --label=<e.g. commit>.
+// --json=<file> writes each tick's update times and the latencies seen as a BenchmarkReport.
+class SoakStage final : public Halley::Stage
+{
+public:
+	struct Options
+	{
+		Halley::BenchmarkOutput output;
+		int clients = 16;
+		float duration = 30.0f; // Seconds, not counting the time it takes everyone to join
+		int tickRate = 60;
+		int messagesPerTick = 4; // Per peer
+		int messageSize = 64; // Bytes
+		int stateSize = 32; // Floats in each peer's SharedData
+		LoopbackConditions conditions;
+
+		Options();
+	};
+
+	explicit SoakStage(Options options);
+	~SoakStage();
+
+	void init() override;
+
+private:
+	class SessionData;
+	class PeerData;
+	using Session = Halley::NetworkSessionImpl<SessionData, PeerData>;
+
+	struct Peer
+	{
+		std::unique_ptr<Halley::NetworkService> service;
+		std::unique_ptr<Session> session;
+		bool joined = false;
+
+		int64_t updateTime = 0; // Nanoseconds
+		Halley::Vector<double> tickTimes; // Each measured tick's
+		uint32_t nextSeq = 0;
+		uint64_t messagesSent = 0;
+		std::map<int, uint32_t> lastTickSeen; // By the owner of the SharedData, -1 is the session's
+	};
+
+	Options options;
+	LoopbackNetwork network;
+	Halley::Vector<std::unique_ptr<Peer>> peers; // The host is the first one
+	uint32_t tick = 0;
+
+	uint64_t messagesDelivered = 0;
+	Halley::Vector<float> messageLatencies; // Milliseconds
+	Halley::Vector<float> sharedDataLatencies;
+
+	void join();
+	void run();
+	void step(Peer& peer, int64_t now, bool measure);
+	void receive(Peer& peer, int64_t now, bool measure);
+
+	void report(const std::vector<Halley::NetworkConnectionStats>& before, const std::vector<Halley::NetworkConnectionStats>& after) const;
+	void writeJSON(float bytesPerSecond, float deliveredRate, float sharedDataResendRate, float subPacketResendRate) const;
+};
@@ -2,6 +2,7 @@
 #include "halley/text/string_converter.h"
 #include "halley/net/connection/iconnection.h"
 #include "halley/net/connection/network_message.h"
+#include "halley/net/connection/message_queue_udp.h"
 
 using namespace Halley;
 
@@ -9,9 +10,10 @@ using namespace Halley;
 class NoOpMsg : public NetworkMessage
 {
 public:
-	size_t getSerializedSize() const override { return 0; }	
-	void serializeTo(gsl::span<gsl::byte> /*dst*/) const override {}	
-	void deserializeFrom(gsl::span<const gsl::byte> /*src*/) override {}
+	NoOpMsg() {}
+	NoOpMsg(gsl::span<const gsl::byte> /*src*/) {}
+
+	void serialize(Serializer& /*s*/) const override {}
 };
 
 class TextMsg : public NetworkMessage
@@ -24,21 +26,17 @@ public:
 		: str(str)
 	{}
 
-	String getString() const { return str; }
-
-	size_t getSerializedSize() const override
-	{
-		return str.size();
-	}
-	
-	void serializeTo(gsl::span<gsl::byte> dst) const override
+	TextMsg(gsl::span<const gsl::byte> src)
 	{
-		memcpy(dst.data(), str.c_str(), str.size());
+		Deserializer s(src);
+		s >> str;
 	}
-	
-	void deserializeFrom(gsl::span<const gsl::byte> src) override
+
+	String getString() const { return str; }
+
+	void serialize(Serializer& s) const override
 	{
-		str = String(reinterpret_cast<const char*>(src.data()), src.size());
+		s << str;
 	}
 
 private:
@@ -81,14 +79,14 @@ void TestStage::updateNetwork()
 		if (key->isButtonPressed(Keys::S)) {
 			// Server
 			isClient = false;
-			network = getNetworkAPI().createService(4113);
+			network = getNetworkAPI().createService(NetworkProtocol::UDP, 4113);
 			network->setAcceptingConnections(true);
 			std::cout << "Listening..." << std::endl;
 		}
 		else if (key->isButtonPressed(Keys::C)) {
 			// Client
 			isClient = true;
-			network = getNetworkAPI().createService(0);
+			network = getNetworkAPI().createService(NetworkProtocol::UDP);
 			setConnection(network->connect("127.0.0.1", 4113));			
 			std::cout << "Connecting as client." << std::endl;
 		}
@@ -109,7 +107,7 @@ void TestStage::updateNetwork()
 				}
 			}
 			
-			if (connection->getStatus() == ConnectionStatus::Open) {
+			if (connection->getStatus() == ConnectionStatus::Connected) {
 				if (key->isButtonPressed(Keys::Space)) {
 					msgs->enqueue(std::make_unique<TextMsg>("ding"), 1);
 				}
@@ -152,7 +150,7 @@ void TestStage::setConnection(std::shared_ptr<Halley::IConnection> conn)
 	auto base = unstable ? std::make_shared<InstabilitySimulator>(conn, 0.1f, 0.03f, 0.1f, 0.05f) : conn;
 	connection = std::make_shared<ReliableConnection>(base);
 	
-	msgs = std::make_unique<MessageQueue>(connection);
+	msgs = std::make_unique<MessageQueueUDP>(connection);
 	msgs->setChannel(0, ChannelSettings(false, false, false));
 	msgs->setChannel(1, ChannelSettings(true, false, false));
 	msgs->setChannel(2, ChannelSettings(false, true, false));
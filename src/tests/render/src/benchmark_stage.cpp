@@ -0,0 +1,245 @@
+#include "benchmark_stage.h"
+#include <iomanip>
+
+using namespace Halley;
+
+BenchmarkStage::BenchmarkStage(Options options)
+	: options(std::move(options))
+{
+	scenes = {
+		{ "sprites_1k", SceneType::Sprites, 1000, 1 },
+		{ "sprites_10k", SceneType::Sprites, 10000, 1 },
+		{ "sprites_10k_16mat", SceneType::Sprites, 10000, 16 },
+		{ "sprites_100k", SceneType::Sprites, 100000, 1 },
+		{ "sprites_100k_16mat", SceneType::Sprites, 100000, 16 },
+		{ "text_100", SceneType::Text, 100, 1 },
+		{ "text_1k", SceneType::Text, 1000, 1 },
+		{ "ui_100", SceneType::UI, 100, 1 },
+		{ "ui_1k", SceneType::UI, 1000, 1 }
+	};
+}
+
+void BenchmarkStage::init()
+{
+	font = getResources().get<Font>("Ubuntu Bold");
+	uiInput = std::make_shared<InputButtonBase>(4);
+
+	std::cout << "Rendering benchmark on " << options.video << ", " << options.frames << " frames per scene" << std::endl;
+	std::cout << std::left << std::setw(20) << "scene" << std::right
+		<< std::setw(10) << "update" << std::setw(10) << "build" << std::setw(10) << "draw" << std::setw(10) << "flush" << std::setw(10) << "gpu"
+		<< std::setw(8) << "calls" << std::setw(10) << "vertices" << std::setw(10) << "triangles" << "   (us per frame)" << std::endl;
+
+	setupScene(scenes[0]);
+}
+
+void BenchmarkStage::onVariableUpdate(Time time)
+{
+	if (frame == warmUpFrames + options.frames) {
+		finishScene();
+		if (++curScene == scenes.size()) {
+			report();
+			getCoreAPI().quit();
+			return;
+		}
+		setupScene(scenes[curScene]);
+	}
+	++frame;
+
+	// The GPU time comes from a few frames ago, which the warm up makes sure was one of this scene's
+	if (isMeasuring()) {
+		auto gpuTime = getVideoAPI().getGPUFrameNanoSeconds();
+		if (gpuTime > 0) {
+			results.back().gpu += gpuTime;
+			results.back().gpuFrames++;
+			results.back().gpus.push_back(double(gpuTime));
+		}
+	}
+
+	Stopwatch timer;
+	updateScene(time);
+	const auto updateTime = timer.elapsedNanoSeconds();
+
+	timer.reset();
+	timer.start();
+	buildScene();
+	const auto buildTime = timer.elapsedNanoSeconds();
+
+	if (isMeasuring()) {
+		auto& result = results.back();
+		result.update += updateTime;
+		result.build += buildTime;
+		result.updates.push_back(double(updateTime));
+		result.builds.push_back(double(buildTime));
+	}
+}
+
+void BenchmarkStage::onRender(RenderContext& context) const
+{
+	context.bind([&] (Painter& painter)
+	{
+		painter.clear(Colour(0.1f, 0.1f, 0.1f));
+
+		Stopwatch timer;
+		spritePainter.draw(1, painter);
+		const auto drawTime = timer.elapsedNanoSeconds();
+
+		timer.reset();
+		timer.start();
+		painter.flush();
+		const auto flushTime = timer.elapsedNanoSeconds();
+
+		if (isMeasuring()) {
+			auto& result = results.back();
+			result.frames++;
+			result.draw += drawTime;
+			result.flush += flushTime;
+			result.draws.push_back(double(drawTime));
+			result.flushes.push_back(double(flushTime));
+			result.drawCalls = painter.getNumDrawCalls();
+			result.vertices = painter.getNumVertices();
+			result.triangles = painter.getNumTriangles();
+		}
+	});
+}
+
+void BenchmarkStage::setupScene(const Scene& scene)
+{
+	sprites.clear();
+	texts.clear();
+	ui.reset();
+	frame = 0;
+
+	Result result;
+	result.scene = scene.name;
+	results.push_back(result);
+
+	const auto screenSize = Vector2f(getVideoAPI().getWindow().getDefinition().getSize());
+	auto baseSprite = Sprite().setImage(getResources(), "halley/halley_icon_dist.png");
+	baseSprite.setSize(Vector2f(16, 16));
+
+	switch (scene.type) {
+	case SceneType::Sprites:
+		{
+			// Each material is its own clone, so sprites only batch with the others using the same one
+			Vector<std::shared_ptr<Material>> materials;
+			for (int i = 0; i < scene.materials; ++i) {
+				materials.push_back(baseSprite.getMaterial().clone());
+			}
+
+			sprites.reserve(size_t(scene.count));
+			for (int i = 0; i < scene.count; ++i) {
+				sprites.push_back(baseSprite.clone());
+				auto& sprite = sprites.back();
+				sprite.setMaterial(materials[size_t(i) % materials.size()]);
+				sprite.setPos(Vector2f(std::fmod(i * 7.31f, screenSize.x), std::fmod(i * 3.17f, screenSize.y)));
+			}
+		}
+		break;
+
+	case SceneType::Text:
+		texts.reserve(size_t(scene.count));
+		for (int i = 0; i < scene.count; ++i) {
+			texts.emplace_back(font, "The quick brown fox jumps over the lazy dog " + toString(i), 14.0f);
+			auto& text = texts.back();
+			text.setPosition(Vector2f(std::fmod(i * 13.7f, screenSize.x), std::fmod(i * 17.0f, screenSize.y)));
+		}
+		break;
+
+	case SceneType::UI:
+		{
+			ui = std::make_unique<UIRoot>(nullptr, Rect4f(Vector2f(), screenSize));
+			auto container = std::make_shared<UIWidget>("container", Vector2f(), UISizer(UISizerType::Vertical));
+			std::shared_ptr<UIWidget> row;
+			for (int i = 0; i < scene.count; ++i) {
+				if (i % 50 == 0) {
+					row = std::make_shared<UIWidget>("row" + toString(i / 50), Vector2f(), UISizer(UISizerType::Horizontal));
+					container->add(row);
+				}
+				row->add(std::make_shared<UIImage>(baseSprite.clone()));
+			}
+			ui->addChild(container);
+		}
+		break;
+	}
+}
+
+void BenchmarkStage::updateScene(Time time)
+{
+	const auto offset = Vector2f(float(frame % 2) * 2.0f - 1.0f, 0.0f);
+	for (auto& sprite: sprites) {
+		sprite.setPos(sprite.getPosition() + offset);
+	}
+
+	if (ui) {
+		ui->update(time, UIInputType::Keyboard, uiInput, uiInput);
+	}
+}
+
+void BenchmarkStage::buildScene()
+{
+	spritePainter.start(sprites.size() + texts.size());
+	for (auto& sprite: sprites) {
+		spritePainter.add(sprite, 1, 0, 0);
+	}
+	for (auto& text: texts) {
+		spritePainter.add(text, 1, 0, 0);
+	}
+	if (ui) {
+		ui->draw(spritePainter, 1, 0);
+	}
+}
+
+void BenchmarkStage::finishScene()
+{
+	auto& r = results.back();
+	auto perFrame = [&] (int64_t ns, int frames) { return frames > 0 ? double(ns) / double(frames) / 1000.0 : 0.0; };
+
+	std::cout << std::left << std::setw(20) << r.scene << std::right << std::fixed << std::setprecision(1)
+		<< std::setw(10) << perFrame(r.update, r.frames) << std::setw(10) << perFrame(r.build, r.frames)
+		<< std::setw(10) << perFrame(r.draw, r.frames) << std::setw(10) << perFrame(r.flush, r.frames)
+		<< std::setw(10) << perFrame(r.gpu, r.gpuFrames)
+		<< std::setw(8) << r.drawCalls << std::setw(10) << r.vertices << std::setw(10) << r.triangles << std::endl;
+}
+
+bool BenchmarkStage::isMeasuring() const
+{
+	return frame > warmUpFrames;
+}
+
+void BenchmarkStage::report() const
+{
+	if (!options.output.jsonPath.isEmpty()) {
+		// Runs on different video APIs aren't comparable, so each is its own benchmark
+		BenchmarkReport json("render/" + options.video, options.output.label);
+		for (auto& r: results) {
+			const std::pair<const char*, const Vector<double>*> times[] = {
+				{ "update", &r.updates },
+				{ "build", &r.builds },
+				{ "draw", &r.draws },
+				{ "flush", &r.flushes },
+				{ "gpu", &r.gpus }
+			};
+			for (auto& t: times) {
+				if (!t.second->empty()) {
+					json.addMetric(r.scene + "/" + t.first, "ns").samples = *t.second;
+				}
+			}
+			json.addMetric(r.scene + "/draw_calls", "", BenchmarkReport::Better::Lower, true).add(double(r.drawCalls));
+			json.addMetric(r.scene + "/vertices", "", BenchmarkReport::Better::Lower, true).add(double(r.vertices));
+			json.addMetric(r.scene + "/triangles", "", BenchmarkReport::Better::Lower, true).add(double(r.triangles));
+		}
+		options.output.writeJSON(json);
+	}
+
+	// Times are nanoseconds per frame, the GPU one is 0 where there are no timer queries
+	options.output.appendCSV([&] (std::ostream& out)
+	{
+		for (auto& r: results) {
+			const int frames = std::max(1, r.frames);
+			out << options.output.label << "," << options.video << "," << r.scene
+				<< "," << (r.update / frames) << "," << (r.build / frames) << "," << (r.draw / frames) << "," << (r.flush / frames)
+				<< "," << (r.gpuFrames > 0 ? r.gpu / r.gpuFrames : 0)
+				<< "," << r.drawCalls << "," << r.vertices << "," << r.triangles << "\n";
+		}
+	});
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "prec.h"
+
+// Draws a fixed list of scripted scenes (sprites with a few materials, text, UI trees) for a number of frames each, then quits.
+// Records the CPU time of each stage of a frame, the GPU frame time where the video API has timer queries, and the painter's
+// draw call counters. Results are printed, and also appended as CSV to --out=<file>, tagged with --label=<e.g. commit>.
+// --json=<file> writes each frame's timings as a BenchmarkReport.
+// Run with --dummy to use the dummy video plugin, which leaves out the backend and gives CPU-only numbers.
+class BenchmarkStage final : public Halley::Stage
+{
+public:
+	struct Options
+	{
+		Halley::String video;
+		Halley::BenchmarkOutput output;
+		int frames = 300;
+	};
+
+	explicit BenchmarkStage(Options options);
+
+	void init() override;
+	void onVariableUpdate(Halley::Time time) override;
+	void onRender(Halley::RenderContext& context) const override;
+
+private:
+	enum class SceneType
+	{
+		Sprites,
+		Text,
+		UI
+	};
+
+	struct Scene
+	{
+		Halley::String name;
+		SceneType type;
+		int count;
+		int materials;
+	};
+
+	struct Result
+	{
+		Halley::String scene;
+		int frames = 0;
+		int64_t update = 0; // Nanoseconds, over every frame
+		int64_t build = 0;
+		int64_t draw = 0;
+		int64_t flush = 0;
+		int64_t gpu = 0;
+		int gpuFrames = 0;
+		size_t drawCalls = 0; // Per frame
+		size_t vertices = 0;
+		size_t triangles = 0;
+
+		Halley::Vector<double> updates; // Each frame's
+		Halley::Vector<double> builds;
+		Halley::Vector<double> draws;
+		Halley::Vector<double> flushes;
+		Halley::Vector<double> gpus;
+	};
+
+	constexpr static int warmUpFrames = 10;
+
+	Options options;
+	Halley::Vector<Scene> scenes;
+	size_t curScene = 0;
+	int frame = 0;
+
+	std::shared_ptr<const Halley::Font> font;
+	Halley::Vector<Halley::Sprite> sprites;
+	Halley::Vector<Halley::TextRenderer> texts;
+	std::unique_ptr<Halley::UIRoot> ui;
+	std::shared_ptr<Halley::InputDevice> uiInput;
+
+	mutable Halley::SpritePainter spritePainter;
+	mutable Halley::Vector<Result> results;
+
+	void setupScene(const Scene& scene);
+	void updateScene(Halley::Time time);
+	void buildScene();
+	void finishScene();
+	bool isMeasuring() const;
+
+	void report() const;
+};
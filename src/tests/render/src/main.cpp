@@ -0,0 +1,77 @@
+#include "prec.h"
+#include "benchmark_stage.h"
+
+using namespace Halley;
+
+void initSDLSystemPlugin(IPluginRegistry &registry);
+#ifdef _WIN32
+void initDX11Plugin(IPluginRegistry &registry);
+#else
+void initOpenGLPlugin(IPluginRegistry &registry);
+#endif
+
+class RenderTestGame final : public Game
+{
+public:
+	void init(const Environment&, const Vector<String>& args) override
+	{
+		for (auto& arg : args) {
+			if (arg == "--dummy") {
+				options.video = "dummy";
+			} else if (auto frames = BenchmarkOutput::getArgument(arg, "frames")) {
+				options.frames = frames->toInteger();
+			} else if (!options.output.parseArgument(arg)) {
+				std::cout << "Unknown argument \"" << arg << "\".\n";
+			}
+		}
+	}
+
+	int initPlugins(IPluginRegistry &registry) override
+	{
+		initSDLSystemPlugin(registry);
+
+		// Without a video plugin, the dummy one is used, which only measures the CPU side
+		if (options.video != "dummy") {
+#ifdef _WIN32
+			initDX11Plugin(registry);
+			options.video = "dx11";
+#else
+			initOpenGLPlugin(registry);
+			options.video = "opengl";
+#endif
+		}
+		return HalleyAPIFlags::Video;
+	}
+
+	void initResourceLocator(const Path& gamePath, const Path& assetsPath, const Path& unpackedAssetsPath, ResourceLocator& locator) override
+	{
+		locator.addFileSystem(unpackedAssetsPath);
+	}
+
+	String getName() const override
+	{
+		return "Render test";
+	}
+
+	String getDataPath() const override
+	{
+		return "halley/render-test";
+	}
+
+	bool isDevMode() const override
+	{
+		return true;
+	}
+
+	std::unique_ptr<Stage> startGame(const HalleyAPI* api) override
+	{
+		api->video->setWindow(WindowDefinition(WindowType::Window, Vector2i(1280, 720), getName()));
+		api->video->setVsync(false);
+		return std::make_unique<BenchmarkStage>(options);
+	}
+
+private:
+	BenchmarkStage::Options options;
+};
+
+HalleyGame(RenderTestGame);
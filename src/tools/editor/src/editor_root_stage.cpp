@@ -1,5 +1,6 @@
 #include "editor_root_stage.h"
 #include "console/console_window.h"
+#include "telemetry/telemetry_window.h"
 #include "halley_editor.h"
 #include "ui/taskbar/taskbar.h"
 #include "halley/tools/assets/check_assets_task.h"
@@ -44,6 +45,9 @@ void EditorRootStage::onVariableUpdate(Time time)
 
 	if (devConServer) {
 		devConServer->update();
+		if (telemetry && telemetryVisible) {
+			telemetry->addSamples(devConServer->takeTelemetry());
+		}
 	}
 
 	auto& prefs = editor.getPreferences();
@@ -76,6 +80,11 @@ void EditorRootStage::onRender(RenderContext& context) const
 		if (console) {
 			console->draw(painter, Rect4f(view.getTopLeft() + Vector2f(16, 16), view.getBottomRight() - Vector2f(16, 80)));
 		}
+
+		if (telemetry && telemetryVisible) {
+			const float width = std::min(560.0f, view.getWidth() / 2);
+			telemetry->draw(painter, Rect4f(Vector2f(view.getRight() - 16 - width, view.getTop() + 16), view.getBottomRight() - Vector2f(16, 80)));
+		}
 	});
 }
 
@@ -164,6 +173,20 @@ void EditorRootStage::updateUI(Time time)
 	if (console) {
 		console->update(*kb);
 	}
+
+	if (telemetry && kb->isButtonPressed(Keys::F3)) {
+		setTelemetryVisible(!telemetryVisible);
+	}
+}
+
+void EditorRootStage::setTelemetryVisible(bool visible)
+{
+	// Games only stream telemetry while someone is looking at it
+	telemetryVisible = visible;
+	telemetry->clear();
+	if (devConServer) {
+		devConServer->setTelemetryEnabled(visible);
+	}
 }
 
 void EditorRootStage::loadProject()
@@ -172,4 +195,5 @@ void EditorRootStage::loadProject()
 	tasks->addTask(EditorTaskAnchor(std::make_unique<CheckAssetsTask>(*project, false)));
 
 	console = std::make_unique<ConsoleWindow>(getResources());
+	telemetry = std::make_unique<TelemetryWindow>(getResources());
 }
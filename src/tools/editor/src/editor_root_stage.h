@@ -6,6 +6,7 @@
 namespace Halley {
 	class HalleyEditor;
 	class ConsoleWindow;
+	class TelemetryWindow;
 	class TaskBar;
 	class EditorUIFactory;
 	class Project;
@@ -34,6 +35,8 @@ namespace Halley {
 		std::shared_ptr<UIWidget> uiMainPanel;
 
 		std::unique_ptr<ConsoleWindow> console;
+		std::unique_ptr<TelemetryWindow> telemetry;
+		bool telemetryVisible = false;
 		
 		std::unique_ptr<EditorTaskSet> tasks;
 		std::unique_ptr<TaskBar> taskBar;
@@ -44,6 +47,7 @@ namespace Halley {
 		void createLoadProjectUI();
 
 		void updateUI(Time time);
+		void setTelemetryVisible(bool visible);
 
 		void loadProject();
 	};
@@ -0,0 +1,187 @@
+#include "telemetry_window.h"
+#include <halley/core/graphics/text/text_renderer.h>
+#include <halley/core/graphics/material/material.h>
+#include <halley/core/graphics/material/material_parameter.h>
+#include <halley/text/string_converter.h>
+#include <algorithm>
+
+using namespace Halley;
+
+namespace {
+	const Colour4f seriesColours[] = {
+		Colour4f(0.2f, 1.0f, 0.3f),
+		Colour4f(1.0f, 0.8f, 0.2f),
+		Colour4f(0.3f, 0.6f, 1.0f),
+		Colour4f(1.0f, 0.3f, 0.4f)
+	};
+}
+
+TelemetryWindow::TelemetryWindow(Resources& resources)
+{
+	background = Sprite()
+		.setImage(resources, "round_rect.png", "Halley/DistanceFieldSprite")
+		.setColour(Colour4f(0.0f, 0.0f, 0.0f, 0.6f))
+		.setPivot(Vector2f(0, 0));
+
+	background.getMaterial()
+		.set("tex0", resources.get<Texture>("round_rect.png"))
+		.set("u_smoothness", 1.0f / 16.0f)
+		.set("u_outline", 0.5f)
+		.set("u_outlineColour", Colour(0.47f, 0.47f, 0.47f));
+
+	solid = Sprite().setMaterial(resources, "Halley/SolidColour").setSize(Vector2f(1, 1)).setPivot(Vector2f(0, 0.5f));
+
+	font = resources.get<Font>("Inconsolata Medium");
+
+	addGraph("Engine time (ms): fixed, variable, render", { "core.fixed.engine.ms", "core.variable.engine.ms", "core.render.engine.ms" });
+	addGraph("Draw calls", { "painter.drawCalls" });
+	addGraph("Memory (MB): process, resources, GPU textures", { "memory.process.bytes", "resources.bytes", "memory.gpuTextures.bytes" }, 1.0f / (1024.0f * 1024.0f));
+	addGraph("Audio: voices, virtual voices", { "audio.voices", "audio.virtualVoices" });
+}
+
+void TelemetryWindow::addGraph(const String& label, std::vector<String> series, float scale)
+{
+	graphs.push_back(Graph{ label, std::move(series), scale });
+}
+
+void TelemetryWindow::addSamples(const std::vector<std::vector<TelemetryValue>>& samples)
+{
+	for (auto& sample: samples) {
+		for (auto& v: sample) {
+			auto& h = history[v.name];
+			h.push_back(float(v.value));
+			if (h.size() > maxSamples) {
+				h.pop_front();
+			}
+		}
+	}
+	if (!samples.empty()) {
+		latest = samples.back();
+	}
+}
+
+void TelemetryWindow::clear()
+{
+	history.clear();
+	latest.clear();
+}
+
+void TelemetryWindow::draw(Painter& painter, Rect4f bounds) const
+{
+	Rect4f innerBounds = bounds.shrink(12);
+	Rect4f outerBounds = bounds.grow(8);
+
+	background.clone()
+		.setPos(outerBounds.getTopLeft())
+		.scaleTo(outerBounds.getSize())
+		.draw(painter);
+
+	const float size = 16;
+	const float lineH = font->getLineHeightAtSize(size);
+	TextRenderer text;
+	text.setFont(font).setSize(size).setColour(Colour(1, 1, 1));
+
+	if (latest.empty()) {
+		text.setText("Waiting for telemetry from a connected game...").setPosition(innerBounds.getTopLeft()).draw(painter);
+		return;
+	}
+
+	// Slowest systems go below the graphs, which share whatever space is left
+	std::vector<const TelemetryValue*> systems;
+	for (auto& v: latest) {
+		if (v.name.contains(".system.")) {
+			systems.push_back(&v);
+		}
+	}
+	std::sort(systems.begin(), systems.end(), [] (const TelemetryValue* a, const TelemetryValue* b) { return a->value > b->value; });
+	systems.resize(std::min(systems.size(), maxSystemsListed));
+
+	const float listHeight = systems.empty() ? 0.0f : lineH * float(systems.size() + 1);
+	const float graphHeight = (innerBounds.getHeight() - listHeight) / float(std::max(graphs.size(), size_t(1)));
+
+	Vector2f cursor = innerBounds.getTopLeft();
+	for (auto& graph: graphs) {
+		drawGraph(painter, graph, Rect4f(cursor, innerBounds.getWidth(), graphHeight - 8));
+		cursor.y += graphHeight;
+	}
+
+	if (!systems.empty()) {
+		text.setColour(Colour(0.8f, 1.0f, 0.8f)).setText("Slowest systems (ms)").setPosition(cursor).draw(painter);
+		text.setColour(Colour(1, 1, 1));
+		cursor.y += lineH;
+		for (auto* s: systems) {
+			// "world.<timeline>.system.<name>.ms"
+			const String name = s->name.mid(s->name.find(".system.") + 8).replaceAll(".ms", "");
+			text.setText(name).setAlignment(0).setPosition(cursor).draw(painter);
+			text.setText(toString(s->value, 3)).setAlignment(1).setPosition(cursor + Vector2f(innerBounds.getWidth(), 0)).draw(painter);
+			cursor.y += lineH;
+		}
+	}
+}
+
+void TelemetryWindow::drawGraph(Painter& painter, const Graph& graph, Rect4f area) const
+{
+	const float size = 14;
+	const float lineH = font->getLineHeightAtSize(size);
+
+	// Scale to the largest value that's still in the history, so spikes are visible until they scroll off
+	float maxValue = 0;
+	for (auto& name: graph.series) {
+		auto iter = history.find(name);
+		if (iter != history.end()) {
+			for (auto v: iter->second) {
+				maxValue = std::max(maxValue, v * graph.scale);
+			}
+		}
+	}
+	maxValue = maxValue > 0 ? maxValue * 1.1f : 1.0f;
+
+	String current;
+	for (auto& name: graph.series) {
+		auto iter = history.find(name);
+		current += (current.isEmpty() ? "" : " / ") + (iter != history.end() && !iter->second.empty() ? toString(iter->second.back() * graph.scale, 2) : String("-"));
+	}
+
+	TextRenderer text;
+	text.setFont(font).setSize(size).setColour(Colour(0.8f, 0.8f, 0.8f));
+	text.setText(graph.label).setAlignment(0).setPosition(area.getTopLeft()).draw(painter);
+	text.setText(current + "  (max " + toString(maxValue / 1.1f, 2) + ")").setAlignment(1).setPosition(area.getTopRight()).draw(painter);
+
+	const Rect4f plot(area.getTopLeft() + Vector2f(0, lineH), area.getBottomRight());
+	solid.clone()
+		.setColour(Colour4f(1, 1, 1, 0.08f))
+		.setPivot(Vector2f(0, 0))
+		.setPos(plot.getTopLeft())
+		.scaleTo(plot.getSize())
+		.draw(painter);
+
+	// Newest sample on the right edge
+	const float dx = plot.getWidth() / float(maxSamples - 1);
+	for (size_t s = 0; s < graph.series.size(); ++s) {
+		auto iter = history.find(graph.series[s]);
+		if (iter == history.end() || iter->second.size() < 2) {
+			continue;
+		}
+		auto& values = iter->second;
+		const auto colour = seriesColours[s % (sizeof(seriesColours) / sizeof(seriesColours[0]))];
+		const float x0 = plot.getRight() - dx * float(values.size() - 1);
+		auto getPoint = [&] (size_t i)
+		{
+			return Vector2f(x0 + dx * float(i), plot.getBottom() - plot.getHeight() * (values[i] * graph.scale / maxValue));
+		};
+		for (size_t i = 1; i < values.size(); ++i) {
+			drawLine(painter, getPoint(i - 1), getPoint(i), colour);
+		}
+	}
+}
+
+void TelemetryWindow::drawLine(Painter& painter, Vector2f a, Vector2f b, Colour4f colour) const
+{
+	const auto delta = b - a;
+	solid.clone()
+		.setColour(colour)
+		.setPos(a)
+		.scaleTo(Vector2f(delta.length(), 2.0f))
+		.setRotation(delta.angle())
+		.draw(painter);
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <deque>
+#include <halley/maths/rect.h>
+#include <halley/maths/colour.h>
+#include <halley/core/resources/resources.h>
+#include <halley/core/graphics/sprite/sprite.h>
+#include <halley/core/graphics/text/font.h>
+#include <halley/support/telemetry.h>
+#include <halley/data_structures/hash_map.h>
+
+namespace Halley
+{
+	class Painter;
+
+	// Live graphs of the telemetry streamed by connected games over DevCon
+	class TelemetryWindow
+	{
+	public:
+		explicit TelemetryWindow(Resources& resources);
+
+		// Each series is a telemetry value name, multiplied by scale for display
+		void addGraph(const String& label, std::vector<String> series, float scale = 1.0f);
+
+		void addSamples(const std::vector<std::vector<TelemetryValue>>& samples);
+		void clear();
+
+		void draw(Painter& painter, Rect4f bounds) const;
+
+	private:
+		struct Graph
+		{
+			String label;
+			std::vector<String> series;
+			float scale;
+		};
+
+		constexpr static size_t maxSamples = 300;
+		constexpr static size_t maxSystemsListed = 8;
+
+		Sprite background;
+		Sprite solid;
+		std::shared_ptr<const Font> font;
+
+		std::vector<Graph> graphs;
+		HashMap<String, std::deque<float>> history;
+		std::vector<TelemetryValue> latest;
+
+		void drawGraph(Painter& painter, const Graph& graph, Rect4f area) const;
+		void drawLine(Painter& painter, Vector2f a, Vector2f b, Colour4f colour) const;
+	};
+}
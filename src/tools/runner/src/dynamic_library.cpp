@@ -104,6 +104,11 @@ void* DynamicLibrary::getBaseAddress() const
 	return handle;
 }
 
+std::string DynamicLibrary::getPath() const
+{
+	return libPath.string();
+}
+
 bool DynamicLibrary::hasChanged() const
 {
 	// Never got debug symbols, so disable hot-reload
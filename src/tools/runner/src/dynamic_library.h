@@ -22,6 +22,7 @@ namespace Halley
 
 		void* getFunction(std::string name) const;
 		void* getBaseAddress() const;
+		std::string getPath() const; // Of the copy that's loaded, if it's loaded with another name
 
 		bool hasChanged() const;
 
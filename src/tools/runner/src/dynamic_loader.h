@@ -28,6 +28,7 @@ namespace Halley
 		IHalleyEntryPoint* entry = nullptr;
 		IMainLoopable* core = nullptr;
 
+		SymbolLoader symbolLoader;
 		Vector<DebugSymbol> symbols;
 		Vector<DebugSymbol> prevSymbols;
 		
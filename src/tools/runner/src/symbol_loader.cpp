@@ -25,7 +25,7 @@ static BOOL CALLBACK loadSymbolsCallback(SYMBOL_INFO* symInfo, unsigned long sym
 	return 1;
 }
 
-static void loadSymbolsImpl(DynamicLibrary& dll, Vector<DebugSymbol>& vector)
+static bool initializeSymbols()
 {
 	DWORD options = SymGetOptions();
 	options &= ~SYMOPT_DEFERRED_LOADS;
@@ -35,20 +35,39 @@ static void loadSymbolsImpl(DynamicLibrary& dll, Vector<DebugSymbol>& vector)
 	options |= SYMOPT_UNDNAME;
 	SymSetOptions(options);
 
-	HANDLE hProcess = GetCurrentProcess();
-	if(!SymInitialize(hProcess, nullptr, true)) {
-		throw Exception("Unable to initialize Symbol loading", HalleyExceptions::Core);
-	}
+	// Not invading the process, which would load the symbols of every module in it, on every reload
+	return SymInitialize(GetCurrentProcess(), nullptr, FALSE) != 0;
+}
 
-	long long baseAddr = long long(dll.getBaseAddress());
+static void cleanupSymbols()
+{
+	SymCleanup(GetCurrentProcess());
+}
 
-	SymEnumSymbols(hProcess, baseAddr, "*", loadSymbolsCallback, &vector);
+static void loadSymbolsImpl(DynamicLibrary& dll, Vector<DebugSymbol>& vector)
+{
+	HANDLE hProcess = GetCurrentProcess();
+	const DWORD64 baseAddr = DWORD64(dll.getBaseAddress());
 
-	SymCleanup(hProcess);
+	// Each reload is a new copy of the library, at its own path and address, so the previous one is never reused
+	if (!SymLoadModuleEx(hProcess, nullptr, dll.getPath().c_str(), nullptr, baseAddr, 0, nullptr, 0) && GetLastError() != ERROR_SUCCESS) {
+		throw Exception("Unable to load symbols for " + dll.getPath(), HalleyExceptions::Core);
+	}
+	SymEnumSymbols(hProcess, baseAddr, "*", loadSymbolsCallback, &vector);
+	SymUnloadModule64(hProcess, baseAddr);
 }
 
 #else
 
+static bool initializeSymbols()
+{
+	return true;
+}
+
+static void cleanupSymbols()
+{
+}
+
 static void loadSymbolsImpl(DynamicLibrary&, Vector<DebugSymbol>&)
 {
 }
@@ -76,8 +95,24 @@ void DebugSymbol::appendToName(size_t id)
 	name += ss.str();
 }
 
+SymbolLoader::SymbolLoader()
+{
+	initialized = initializeSymbols();
+}
+
+SymbolLoader::~SymbolLoader()
+{
+	if (initialized) {
+		cleanupSymbols();
+	}
+}
+
 Vector<DebugSymbol> SymbolLoader::loadSymbols(DynamicLibrary& dll)
 {
+	if (!initialized) {
+		throw Exception("Unable to initialize Symbol loading", HalleyExceptions::Core);
+	}
+
 	Vector<DebugSymbol> results;
 	loadSymbolsImpl(dll, results);
 
@@ -20,9 +20,17 @@ namespace Halley
 		size_t size;
 	};
 
+	// Keeps the symbol handler initialised between reloads, so each one only loads the symbols of the game's module,
+	// instead of those of every module in the process
 	class SymbolLoader
 	{
 	public:
-		static Vector<DebugSymbol> loadSymbols(DynamicLibrary& dll);
+		SymbolLoader();
+		~SymbolLoader();
+
+		Vector<DebugSymbol> loadSymbols(DynamicLibrary& dll);
+
+	private:
+		bool initialized = false;
 	};
 }
@@ -58,12 +58,14 @@ namespace Halley
 		String name;
 		AssetType type;
 		std::map<String, PlatformVersion> platformVersions;
+		std::vector<std::pair<AssetType, String>> dependencies; // Assets loaded along with this one, see IAssetCollector::addDependency
 
 		void serialize(Serializer& s) const
 		{
 			s << name;
 			s << type;
 			s << platformVersions;
+			s << dependencies;
 		}
 		
 		void deserialize(Deserializer& s)
@@ -71,6 +73,7 @@ namespace Halley
 			s >> name;
 			s >> type;
 			s >> platformVersions;
+			s >> dependencies;
 		}
 	};
 
@@ -80,6 +83,10 @@ namespace Halley
 		virtual ~IAssetCollector() {}
 		virtual void output(const String& name, AssetType type, const Bytes& data, Maybe<Metadata> metadata = {}, const String& platform = "pc") = 0;
 		virtual void addAdditionalAsset(ImportingAsset&& asset) = 0;
+
+		// Records that loading an output also loads another asset, so Resources::prefetch can fetch both ahead of time
+		virtual void addDependency(const String& name, AssetType type, const String& dependencyName, AssetType dependencyType) = 0;
+
 		virtual bool reportProgress(float progress, const String& label = "") = 0;
 		virtual Bytes readAdditionalFile(const Path& filePath) = 0;
 		virtual const Path& getDestinationDirectory() = 0;
@@ -94,6 +101,9 @@ namespace Halley
 		virtual void import(const ImportingAsset&, IAssetCollector&) {}
 		virtual int dropFrontCount() const { return 1; }
 
+		// Bump whenever the output for the same input changes, so content-hashed imports and shared import caches are invalidated
+		virtual int getVersion() const { return 0; }
+
 		virtual String getAssetId(const Path& file, const Maybe<Metadata>& metadata) const
 		{
 			return file.dropFront(dropFrontCount()).string();
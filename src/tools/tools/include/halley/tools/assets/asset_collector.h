@@ -12,6 +12,7 @@ namespace Halley {
 		void output(const String& name, AssetType type, const Bytes& data, Maybe<Metadata> metadata, const String& platform) override;
 
 		void addAdditionalAsset(ImportingAsset&& asset) override;
+		void addDependency(const String& name, AssetType type, const String& dependencyName, AssetType dependencyType) override;
 		bool reportProgress(float progress, const String& label) override;
 		const Path& getDestinationDirectory() override;
 		Bytes readAdditionalFile(const Path& filePath) override;
@@ -31,5 +32,7 @@ namespace Halley {
 		std::vector<ImportingAsset> additionalAssets;
 		std::vector<TimestampedPath> additionalInputs;
 		std::vector<std::pair<Path, Bytes>> outFiles;
+
+		AssetResource& getAsset(const String& name, AssetType type);
 	};
 }
@@ -15,6 +15,7 @@ namespace Halley
 		IAssetImporter& getRootImporter(Path path) const;
 		std::vector<std::reference_wrapper<IAssetImporter>> getImporters(ImportAssetType type) const;
 		const std::vector<Path>& getAssetsSrc() const;
+		uint64_t getVersionHash() const;
 
 	private:
 		std::map<ImportAssetType, std::vector<std::unique_ptr<IAssetImporter>>> importers;
@@ -2,6 +2,7 @@
 #include "../tasks/editor_task.h"
 #include "import_assets_database.h"
 #include "halley/file/directory_monitor.h"
+#include "halley/resources/metadata.h"
 
 namespace Halley
 {
@@ -24,9 +25,30 @@ namespace Halley
 		DirectoryMonitor monitorGenSrc;
 		bool oneShot;
 
+		// Directory metas seen by the last full scan, for each source path; changing any of them triggers another full scan
+		std::map<String, std::vector<Path>> scannedDirectoryMetas;
+
+		using ChangedFile = std::pair<Path, Path>; // Source path, file relative to it
+
+		// Parsed .meta files, so a directory meta isn't parsed again for every file under it
+		struct ParsedMeta
+		{
+			int64_t timestamp = 0;
+			using Table = std::vector<std::pair<String, String>>;
+			std::vector<std::pair<std::vector<String>, Table>> entries; // Match patterns (none matches everything) and their data
+		};
+		std::map<String, ParsedMeta> parsedMetas;
+
 		static std::vector<ImportAssetsDatabaseEntry> filterNeedsImporting(ImportAssetsDatabase& db, const std::map<String, ImportAssetsDatabaseEntry>& assets);
+		static bool collectChanges(DirectoryMonitor& monitor, const Path& srcPath, std::vector<ChangedFile>& changes);
+		static bool hasRemovedOutputs(DirectoryMonitor& monitor);
 		void checkAllAssets(ImportAssetsDatabase& db, std::vector<Path> srcPaths, Path dstPath, String taskName, bool packAfter);
+		bool checkChangedAssets(ImportAssetsDatabase& db, const std::vector<ChangedFile>& changes, Path dstPath, String taskName, bool packAfter);
+		void addImportTasks(ImportAssetsDatabase& db, std::map<String, ImportAssetsDatabaseEntry>& assets, std::vector<ImportAssetsDatabaseEntry> toDelete, bool dbChanged, Path dstPath, String taskName, bool packAfter);
+		void computeInputHashes(ImportAssetsDatabase& db, std::map<String, ImportAssetsDatabaseEntry>& assets) const;
 		Maybe<Path> findDirectoryMeta(const std::vector<Path>& metas, const Path& path) const;
+		const ParsedMeta& getParsedMeta(const Path& path, int64_t timestamp, bool isDirectoryMeta);
+		Metadata getMetaData(const Path& inputFilePath, Maybe<Path> dirMetaPath, int64_t dirMetaTimestamp, Maybe<Path> privateMetaPath, int64_t privateMetaTimestamp);
 		bool importFile(ImportAssetsDatabase& db, std::map<String, ImportAssetsDatabaseEntry>& assets, const bool isCodegen, const std::vector<Path>& directoryMetas, const Path& srcPath, const Path& filePath);
 	};
 }
@@ -22,6 +22,8 @@ namespace Halley
 		std::vector<TimestampedPath> additionalInputFiles; // These were requested by the importer, rather than enumerated directly
 		std::vector<AssetResource> outputFiles;
 		ImportAssetType assetType = ImportAssetType::Undefined;
+		uint64_t inputHash = 0; // Input contents, metadata and importer versions; only set when content hashing
+		uint64_t additionalInputHash = 0;
 
 		ImportAssetsDatabaseEntry() {}
 
@@ -62,6 +64,7 @@ namespace Halley
 		public:
 			std::array<int64_t, 3> timestamp;
 			Metadata metadata;
+			uint64_t contentHash = 0;
 
 			void serialize(Serializer& s) const;
 			void deserialize(Deserializer& s);
@@ -75,8 +78,14 @@ namespace Halley
 		std::unique_ptr<AssetDatabase> makeAssetDatabase(const String& platform) const;
 
 		bool needToLoadInputMetadata(const Path& path, std::array<int64_t, 3> timestamps) const;
-		void setInputFileMetadata(const Path& path, std::array<int64_t, 3> timestamps, const Metadata& data);
+		void setInputFileMetadata(const Path& path, std::array<int64_t, 3> timestamps, const Metadata& data, uint64_t contentHash = 0);
 		Maybe<Metadata> getMetadata(const Path& path) const;
+		uint64_t getInputFileHash(const Path& path) const;
+
+		// Decide what needs importing by comparing contents rather than timestamps, which don't survive checkouts
+		void setContentHashing(bool enabled);
+		bool isContentHashing() const;
+		static uint64_t hashFileContents(const std::vector<TimestampedPath>& files);
 
 		bool needsImporting(const ImportAssetsDatabaseEntry& asset) const;
 		void markAsImported(const ImportAssetsDatabaseEntry& asset);
@@ -87,6 +96,11 @@ namespace Halley
 
 		std::vector<AssetResource> getOutFiles(String assetId) const;
 
+		// For incremental checks: the assets that were built from this file, or from files under it if it's a directory,
+		// including the ones that only read it as an additional input.
+		std::vector<String> getAssetsFromInput(const Path& srcDir, const Path& path) const;
+		Maybe<ImportAssetsDatabaseEntry> getImportedAsset(const String& assetId) const;
+
 		void serialize(Serializer& s) const;
 		void deserialize(Deserializer& s);
 
@@ -99,7 +113,18 @@ namespace Halley
 		std::map<String, AssetEntry> assetsImported;
 		std::map<String, AssetEntry> assetsFailed; // Ephemeral
 		std::map<String, InputFileEntry> inputFiles;
+		bool contentHashing = false;
+
+		// One per platform, built on first use and then patched as assets are imported or deleted
+		mutable std::vector<std::unique_ptr<AssetDatabase>> assetDbs;
+
+		bool hasMissingOutputs(const ImportAssetsDatabaseEntry& asset) const;
+		AssetDatabase& getAssetDatabase(size_t platformIdx) const;
+		void addToAssetDatabases(const ImportAssetsDatabaseEntry& asset) const;
+		void removeFromAssetDatabases(const ImportAssetsDatabaseEntry& asset) const;
+		static const AssetResource::PlatformVersion* getPlatformVersion(const AssetResource& resource, const String& platform);
 		
 		mutable std::mutex mutex;
+		mutable std::mutex saveMutex;
 	};
 }
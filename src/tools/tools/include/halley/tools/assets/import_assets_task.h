@@ -4,6 +4,7 @@
 #include "import_assets_database.h"
 #include <vector>
 #include <set>
+#include <chrono>
 
 namespace Halley
 {
@@ -16,6 +17,7 @@ namespace Halley
 
 	protected:
 		void run() override;
+		bool mergeWith(EditorTask& other) override;
 
 	private:
 		ImportAssetsDatabase& db;
@@ -33,10 +35,14 @@ namespace Halley
 		size_t assetsToImport{};
 
 		std::mutex mutex;
+		std::mutex saveMutex;
+		std::chrono::steady_clock::time_point lastSave;
 		
 		std::string curFileLabel;
 
 		bool importAsset(ImportAssetsDatabaseEntry& asset);
+		void saveDatabaseIfNeeded();
+		static int getImportPhase(ImportAssetType type);
 
 		std::vector<Path> loadFont(const ImportAssetsDatabaseEntry& asset, Path dstDir);
 		std::vector<Path> genericImporter(const ImportAssetsDatabaseEntry& asset, Path dstDir);
@@ -0,0 +1,33 @@
+#pragma once
+#include "halley/file/path.h"
+#include "halley/plugin/iasset_importer.h"
+#include "halley/data_structures/maybe.h"
+#include <vector>
+
+namespace Halley
+{
+	// Imported outputs, keyed by ImportAssetsDatabaseEntry::inputHash, in a directory that can be shared between machines (e.g. a network drive for CI)
+	class ImportCache
+	{
+	public:
+		struct Entry
+		{
+			std::vector<TimestampedPath> additionalInputs;
+			uint64_t additionalInputHash = 0;
+			std::vector<AssetResource> outputs;
+			std::vector<std::pair<Path, Bytes>> outFiles;
+		};
+
+		ImportCache(Path directory, std::vector<Path> assetsSrc);
+
+		// Only returns entries whose additional inputs still have the same contents here
+		Maybe<Entry> load(uint64_t key) const;
+		void store(uint64_t key, const Entry& entry) const;
+
+	private:
+		Path directory;
+		std::vector<Path> assetsSrc;
+
+		Path getPath(uint64_t key) const;
+	};
+}
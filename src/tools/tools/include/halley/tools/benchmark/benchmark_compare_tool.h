@@ -0,0 +1,62 @@
+#pragma once
+#include "halley/tools/cli_tool.h"
+#include "halley/support/benchmark_report.h"
+
+namespace Halley {
+	// Compares every metric of a benchmark report with the same one in a baseline report (see BenchmarkReport).
+	// A metric only counts as slower (or faster) when its median moved past the threshold, and a one-sided Mann-Whitney U test
+	// on the samples says a shift that big is unlikely to be noise. Samples taken in a row (e.g. frames) aren't independent,
+	// so the test is somewhat optimistic; the threshold is what keeps that from flagging noise.
+	// Exact metrics are compared directly, and those with a single sample can't be tested, so they're only ever inconclusive.
+	class BenchmarkComparison {
+	public:
+		enum class Verdict {
+			Unchanged,
+			Slower, // Worse, rather than taking longer, for metrics where higher is better
+			Faster,
+			Inconclusive, // Moved past the threshold, but not by more than the noise
+			Missing, // Only in the baseline
+			New // Only in the current report
+		};
+
+		struct Options {
+			double threshold = 0.05; // Relative change of the median
+			double alpha = 0.05; // Largest p-value taken as significant
+		};
+
+		struct Result {
+			String name;
+			String unit;
+			Verdict verdict = Verdict::Unchanged;
+			double baseline = 0; // Medians
+			double current = 0;
+			double change = 0; // Relative to the baseline, positive when worse
+			double pValue = 1; // Of the change being noise, 1 if it wasn't tested
+		};
+
+		BenchmarkComparison(const BenchmarkReport& baseline, const BenchmarkReport& current, Options options);
+
+		const Vector<Result>& getResults() const { return results; }
+		bool hasRegressions() const;
+
+		const Vector<String>& getMachineDifferences() const { return machineDifferences; } // Which could account for changes too
+
+		// The probability of seeing samples of a at least this much larger than those of b, if both came from the same distribution
+		static double getMannWhitneyPValue(const Vector<double>& a, const Vector<double>& b);
+
+	private:
+		Options options;
+		Vector<Result> results;
+		Vector<String> machineDifferences;
+
+		Result compare(const BenchmarkReport::Metric& baseline, const BenchmarkReport::Metric& current) const;
+	};
+
+	// halley-cmd benchmark-compare [-t thresholdPercent] [-a alpha] [-v] baseline.json current.json
+	// -v lists unchanged metrics too. Returns 1 if anything got slower, so it can be used to gate a build.
+	class BenchmarkCompareTool : public CommandLineTool
+	{
+	public:
+		int run(Vector<std::string> args) override;
+	};
+}
@@ -22,6 +22,8 @@ namespace Halley
 	protected:
 		std::unique_ptr<HalleyStatics> statics;
 		std::vector<String> platforms;
+		bool contentHash = false;
+		String importCache;
 		Environment env;
 	};
 
@@ -3,6 +3,7 @@
 #include "icode_generator.h"
 #include <halley/data_structures/hash_map.h>
 #include <gsl/gsl>
+#include <map>
 #include "halley/file/path.h"
 
 namespace YAML
@@ -16,14 +17,38 @@ namespace Halley
 	class SystemSchema;
 	class MessageSchema;
 	class CustomTypeSchema;
+	class Serializer;
+	class Deserializer;
 
 	class Codegen
 	{
+		// What the last run generated, saved with its output. Schemas whose inputs hash the same as last time aren't generated again,
+		// and components and messages keep their ids, so adding or removing one doesn't rewrite (and rebuild) all the others.
+		struct State
+		{
+			struct Output
+			{
+				uint64_t hash = 0;
+				std::vector<Path> files; // Relative to the output directory
+
+				void serialize(Serializer& s) const;
+				void deserialize(Deserializer& s);
+			};
+
+			std::map<String, int> componentIds;
+			std::map<String, int> messageIds;
+			std::map<String, Output> outputs; // By generator directory, kind and name, e.g. "cpp/component:Sprite"
+
+			void serialize(Serializer& s) const;
+			void deserialize(Deserializer& s);
+		};
+
 		struct Stats
 		{
 			int written = 0;
 			int skipped = 0;
 			std::vector<Path> files;
+			State state;
 		};
 
 		static bool doNothing(float, String) { return true; }
@@ -44,16 +69,21 @@ namespace Halley
 
 	private:
 		void addSource(String name, gsl::span<const gsl::byte> data);
-		void addComponent(YAML::Node rootNode);
-		void addSystem(YAML::Node rootNode);
-		void addMessage(YAML::Node rootNode);
+		void addComponent(YAML::Node rootNode, uint64_t sourceHash);
+		void addSystem(YAML::Node rootNode, uint64_t sourceHash);
+		void addMessage(YAML::Node rootNode, uint64_t sourceHash);
 		void addType(YAML::Node rootNode);
 		String getInclude(String typeName) const;
 
+		State loadState(const Path& path) const;
+		void assignIds(const State& previous, State& next);
+		void generateIfChanged(const String& key, uint64_t hash, const Path& directory, const Path& genDir, const std::function<CodeGenResult()>& generate, const State& previous, Stats& stats) const;
+
 		bool verbose;
 		HashMap<String, ComponentSchema> components;
 		HashMap<String, SystemSchema> systems;
 		HashMap<String, MessageSchema> messages;
 		HashMap<String, CustomTypeSchema> types;
+		HashMap<String, uint64_t> sourceHashes; // By kind and name, e.g. "component:Sprite"
 	};
 }
\ No newline at end of file
@@ -10,6 +10,15 @@ namespace YAML
 
 namespace Halley
 {
+	// A member marked "index: hash" or "index: sorted", which gets an alias in its component for a HashEntityIndex or SortedEntityIndex of it
+	class ComponentIndexSchema
+	{
+	public:
+		String member;
+		String type;
+		bool sorted = false;
+	};
+
 	class ComponentSchema
 	{
 	public:
@@ -19,6 +28,10 @@ namespace Halley
 		int id = -1;
 		String name;
 		Vector<VariableSchema> members;
+		Vector<MemberSerializationSchema> memberSerialization; // One per member
+		bool serializable = false; // Generates serialize/deserialize, used by world snapshots instead of a raw copy
+		bool replicated = false; // Sent to peers by EntityReplicator, implies serializable
+		Vector<ComponentIndexSchema> indices;
 		std::unordered_set<String> includeFiles;
 	};
 }
\ No newline at end of file
@@ -1,6 +1,12 @@
 #pragma once
 
 #include <halley/text/halleystring.h>
+#include <halley/data_structures/vector.h>
+
+namespace YAML
+{
+	class Node;
+}
 
 namespace Halley
 {
@@ -34,6 +40,22 @@ namespace Halley
 		{}
 	};
 
+	// How generated serializers write a member, from its annotations in the schema
+	class MemberSerializationSchema
+	{
+	public:
+		int bits = 0; // Bit-packed into this many bits, if set
+		bool quantized = false; // Mapped onto bits over [rangeMin, rangeMax], kept as written in the schema
+		String rangeMin;
+		String rangeMax;
+		int version = 0; // Only serialized if the stream's version is at least this
+
+		bool isDefault() const { return bits == 0 && version == 0; }
+
+		// Members are either "name: type", or "name: { type: ..., bits: ..., range: [min, max], version: ... }"
+		static void parseMembers(YAML::Node node, Vector<VariableSchema>& members, Vector<MemberSerializationSchema>& serialization, const String& owner);
+	};
+
 	class MethodSchema
 	{
 	public:
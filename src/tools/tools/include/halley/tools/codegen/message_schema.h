@@ -19,6 +19,8 @@ namespace Halley
 		int id = -1;
 		String name;
 		Vector<VariableSchema> members;
+		Vector<MemberSerializationSchema> memberSerialization; // One per member
+		bool serializable = false; // Generates serialize/deserialize
 		std::unordered_set<String> includeFiles;
 	};
 }
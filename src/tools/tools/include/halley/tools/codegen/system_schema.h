@@ -18,6 +18,12 @@ namespace Halley
 		Parallel
 	};
 
+	enum class SystemAffinity
+	{
+		Any,
+		Sticky
+	};
+
 	enum class SystemAccess
 	{
 		Pure = 0,
@@ -78,7 +84,11 @@ namespace Halley
 		SystemAccess access = SystemAccess::Pure;
 		SystemMethod method = SystemMethod::Update;
 		CodegenLanguage language = CodegenLanguage::CPlusPlus;
-		int smearing = 0;
+		int smearing = 1; // Updates 1/smearing of the family each step, passing each entity the time since it was last updated
+
+		// Parallel strategy only
+		int grainSize = 0;
+		SystemAffinity affinity = SystemAffinity::Any;
 
 		std::unordered_set<String> includeFiles;
 
@@ -10,6 +10,16 @@ namespace Halley
 	class DistanceFieldGenerator
 	{
 	public:
-		static std::unique_ptr<Image> generate(Image& src, Vector2i size, float radius);
+		enum class Mode
+		{
+			BruteForce, // Searches the area within radius of every pixel
+			Exact // Linear time Euclidean distance transform, much faster with large radii or images
+		};
+
+		static std::unique_ptr<Image> generate(Image& src, Vector2i size, float radius, Mode mode = Mode::BruteForce);
+
+	private:
+		static std::unique_ptr<Image> generateBruteForce(Image& src, Vector2i size, float radius);
+		static std::unique_ptr<Image> generateExact(Image& src, Vector2i size, float radius);
 	};
 }
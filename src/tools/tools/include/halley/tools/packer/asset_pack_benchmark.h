@@ -0,0 +1,77 @@
+#pragma once
+#include "halley/text/halleystring.h"
+#include "halley/file/path.h"
+#include "halley/tools/cli_tool.h"
+#include "halley/core/resources/asset_database.h"
+#include "halley/resources/resource.h"
+#include "halley/utils/encrypt.h"
+#include "halley/support/benchmark_report.h"
+#include <array>
+#include <map>
+
+namespace Halley {
+	class AssetPack;
+	class ResourceDataStatic;
+
+	// Loads every asset in a pack as the game would, timing each step on its own: reading it from the pack, decrypting it,
+	// decompressing it, and deserializing it with its type's loader. Types whose loaders need a running video or audio device
+	// (textures stored raw, shaders, materials, fonts) are read, decrypted and decompressed, but not deserialized.
+	// A cold run asks the OS to drop the pack from its file cache first (see OS::evictFileCache); warm runs follow it.
+	// With -j <file>, the MB/s of every run are also written as a BenchmarkReport, tagged with -l <commit>.
+	class AssetPackBenchmark {
+	public:
+		enum class Phase {
+			Read,
+			Decrypt,
+			Decompress, // Measured by the bytes that come out
+			Deserialize
+		};
+		constexpr static size_t numPhases = 4;
+
+		struct Timing {
+			uint64_t bytes = 0;
+			int64_t nanoSeconds = 0;
+			size_t count = 0;
+
+			void add(uint64_t bytes, int64_t nanoSeconds);
+			double getMegabytesPerSecond() const;
+		};
+
+		struct Results {
+			std::map<AssetType, std::array<Timing, numPhases>> byType;
+			std::array<Timing, numPhases> total; // Including whatever's done to the whole pack at once
+			bool cold = false;
+			bool evicted = false; // Whether a cold run really started from disk
+
+			void keepBest(const Results& other);
+		};
+
+		AssetPackBenchmark(Path path, String encryptionKey = "");
+		~AssetPackBenchmark();
+
+		Results run(bool cold);
+		void printResults(const Results& results) const;
+		void addToReport(BenchmarkReport& report, const String& prefix, const Results& results) const;
+
+	private:
+		struct Asset {
+			AssetType type;
+			String name;
+			AssetDatabase::Entry entry;
+		};
+
+		class Locator;
+
+		Path path;
+		String encryptionKey;
+
+		void loadAsset(AssetPack& pack, Locator& locator, const Asset& asset, const Encrypt::CounterMode* cipher, Results& results);
+		bool deserialize(Locator& locator, const Asset& asset, std::unique_ptr<ResourceDataStatic> data);
+	};
+
+	class AssetPackBenchmarkTool : public CommandLineTool
+	{
+	public:
+		int run(Vector<std::string> args) override;
+	};
+}
@@ -33,6 +33,8 @@ namespace Halley {
 
 		void parseTable(Deserializer s, const Bytes& packBytes);
 	    void parseTypedDB(Deserializer& s, const Bytes& packBytes);
+		void parseCompactTable(const AssetDatabase& db, const Bytes& packBytes);
+		void addEntry(int assetType, String key, AssetDatabase::Entry entry, const Bytes& packBytes);
 		void computeHash();
     };
 
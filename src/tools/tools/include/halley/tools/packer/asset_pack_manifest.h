@@ -16,10 +16,12 @@ namespace Halley {
 		bool checkMatch(const String& asset) const;
 		bool isEncrypted() const;
 		const String& getEncryptionKey() const;
+		const String& getCompression() const;
 
 	private:
 		String name;
 		String encryptionKey;
+		String compression;
 		std::vector<String> matches;
 	};
 
@@ -4,12 +4,15 @@
 #include "halley/resources/resource.h"
 #include "halley/core/resources/asset_database.h"
 #include "halley/data_structures/maybe.h"
+#include "halley/utils/utils.h"
 #include <set>
 
 namespace Halley {
 	class Project;
 	class AssetPackManifest;
 	class Path;
+	class Serializer;
+	class Deserializer;
 		
 	class AssetPackListing {
 	public:
@@ -18,24 +21,30 @@ namespace Halley {
 			String name;
 			String path;
 			Metadata metadata;
+			std::vector<std::pair<AssetType, String>> dependencies;
 
 			bool operator<(const Entry& other) const;
 		};
 		
 		AssetPackListing();
-		AssetPackListing(String name, String encryptionKey);
+		AssetPackListing(String name, String encryptionKey, String compression = "");
 		
 		void addFile(AssetType type, const String& name, const AssetDatabase::Entry& entry);
 		const std::vector<Entry>& getEntries() const;
 		const String& getEncryptionKey() const;
+		const String& getCompression() const;
 		
 		void setActive(bool active);
 		bool isActive() const;
+
+		// By name, or, if they're in accessOrder (by "type:name"), ahead of the rest in that order, so what's loaded together is read together
 		void sort();
+		void sort(const std::map<String, size_t>& accessOrder);
 
 	private:
 		String name;
 		String encryptionKey;
+		String compression;
 
 		bool active = false;
 
@@ -48,8 +57,24 @@ namespace Halley {
 		static void packPlatform(Project& project, Maybe<std::set<String>> assetsToPack, const std::vector<String>& deletedAssets, const String& platform);
 
 	private:
-		static std::map<String, AssetPackListing> sortIntoPacks(const AssetPackManifest& manifest, const AssetDatabase& srcAssetDb, Maybe<std::set<String>> assetsToPack, const std::vector<String>& deletedAssets);
-		static void generatePacks(std::map<String, AssetPackListing> packs, const Path& src, const Path& dst);
-		static void generatePack(const String& packId, const AssetPackListing& pack, const Path& src, const Path& dst);
+		// What a pack was last generated from, so packs whose contents are unchanged can be skipped, and large ones patched
+		struct PackState {
+			uint64_t hash = 0;
+			uint64_t fileSize = 0;
+			std::map<String, uint64_t> entries; // By "type:name"
+
+			void serialize(Serializer& s) const;
+			void deserialize(Deserializer& s);
+		};
+
+		static std::map<String, AssetPackListing> sortIntoPacks(const AssetPackManifest& manifest, const AssetDatabase& srcAssetDb, Maybe<std::set<String>> assetsToPack, const std::vector<String>& deletedAssets, const std::map<String, size_t>& accessOrder);
+		static std::map<String, size_t> loadAccessTraces(const Path& path);
+		static void generatePacks(std::map<String, AssetPackListing> packs, const Path& src, const Path& dst, const Path& statePath);
+		static PackState generatePack(const String& packId, const AssetPackListing& pack, const Path& src, const Path& dst, const PackState* previous);
+		static void writePack(const String& packId, const AssetPackListing& pack, const Path& src, const Path& dst);
+		static bool patchPack(const String& packId, const AssetPackListing& pack, const Path& src, const Path& dst, const PackState& previous, const PackState& next);
+
+		static PackState hashPack(const AssetPackListing& pack, const Path& src);
+		static std::pair<Bytes, Metadata> readEntry(const AssetPackListing& pack, const AssetPackListing::Entry& entry, const Path& src);
 	};
 }
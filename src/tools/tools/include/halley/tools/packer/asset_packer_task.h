@@ -14,6 +14,7 @@ namespace Halley
 
 	protected:
 		void run() override;
+		bool mergeWith(EditorTask& other) override;
 
 	private:
 		Project& project;
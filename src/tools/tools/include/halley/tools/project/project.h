@@ -8,6 +8,7 @@
 namespace Halley
 {
 	class ImportAssetsDatabase;
+	class ImportCache;
 
 	class HalleyStatics;
 	class IHalleyPlugin;
@@ -33,10 +34,16 @@ namespace Halley
 
 		void setAssetPackManifest(const Path& path);
 		Path getAssetPackManifestPath() const;
+		Path getAccessTracesPath() const; // Saved by Resources::stopAccessTrace(), to lay out packs in the order assets are loaded
 
 		ImportAssetsDatabase& getImportAssetsDatabase() const;
 		ImportAssetsDatabase& getCodegenDatabase() const;
 
+		// Decide what to reimport based on contents instead of timestamps, optionally reusing outputs from a (shared) cache directory
+		void setContentHashing(bool enabled);
+		void setImportCache(const Path& path);
+		ImportCache* getImportCache() const;
+
 		const AssetImporter& getAssetImporter() const;
 		std::vector<std::unique_ptr<IAssetImporter>> getAssetImportersFromPlugins(ImportAssetType type) const;
 
@@ -52,6 +59,7 @@ namespace Halley
 
 		std::unique_ptr<ImportAssetsDatabase> importAssetsDatabase;
 		std::unique_ptr<ImportAssetsDatabase> codegenDatabase;
+		std::unique_ptr<ImportCache> importCache;
 		std::unique_ptr<AssetImporter> assetImporter;
 
 		std::vector<HalleyPluginPtr> plugins;
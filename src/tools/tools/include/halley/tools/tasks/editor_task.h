@@ -29,6 +29,15 @@ namespace Halley
 		EditorTask(String name, bool isCancellable, bool isVisible);
 
 		virtual void run() = 0;
+
+		// Called on a task that hasn't started yet, when another with the same exclusive key is queued right behind it.
+		// Returning true means this one has taken over all of the other's work, and the other is dropped without running.
+		virtual bool mergeWith(EditorTask& other);
+
+		// Tasks sharing a key (usually what they write to) never run at the same time, and run in the order they were queued,
+		// except for continuations, which take their parent's place in line
+		void setExclusiveKey(String key);
+
 		void addContinuation(EditorTaskAnchor&& task);
 		void setContinuations(Vector<EditorTaskAnchor>&& tasks);
 		void setProgress(float progress, String label = "");
@@ -50,6 +59,7 @@ namespace Halley
 		std::atomic<float> progress;
 		String name;
 		String progressLabel;
+		String exclusiveKey;
 
 		std::atomic<bool> cancelled;
 		std::atomic<bool> hasPendingTasksOnQueue;
@@ -75,6 +85,8 @@ namespace Halley
 
 		void terminate();
 		void update(float time);
+		bool isReadyToStart() const;
+		void start(ExecutionQueue& queue);
 
 		EditorTaskStatus getStatus() const;
 		String getName() const;
@@ -84,9 +96,16 @@ namespace Halley
 		bool canCancel() const;
 		bool isVisible() const;
 		void cancel();
+		bool isCancelled() const;
+		bool isParentCancelled() const;
 
 		int getId() const { return id; }
 		void setId(int value);
+		int getOrder() const { return order; } // Place in line among tasks with the same exclusive key
+		void setOrder(int value);
+
+		const String& getExclusiveKey() const;
+		bool tryMerge(EditorTaskAnchor& other);
 
 		bool hasError() const;
 		const String& getError() const;
@@ -110,5 +129,6 @@ namespace Halley
 		String progressLabel;
 
 		int id = 0;
+		int order = 0;
 	};
 }
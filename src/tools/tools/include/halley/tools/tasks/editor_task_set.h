@@ -1,7 +1,9 @@
 #pragma once
 #include "editor_task.h"
 #include "halley/time/halleytime.h"
+#include "halley/concurrency/executor.h"
 #include <list>
+#include <memory>
 
 namespace Halley
 {
@@ -14,6 +16,10 @@ namespace Halley
 		virtual void onTaskError(const std::shared_ptr<EditorTaskAnchor>& task) = 0;
 	};
 
+	// Runs editor tasks on its own thread pool, so long-running ones (like CheckAssetsTask) don't take workers away from the CPU queue.
+	// Tasks are started as soon as anything they must wait for is done: tasks with the same exclusive key go one at a time, in order,
+	// and a task queued behind one with its key that hasn't started yet may be merged into it instead (see EditorTask::mergeWith).
+	// Cancelling a task also cancels the pending tasks it added.
 	class EditorTaskSet
 	{
 	public:
@@ -28,8 +34,14 @@ namespace Halley
 		const std::list<std::shared_ptr<EditorTaskAnchor>>& getTasks() const;
 
 	private:
+		ExecutionQueue queue;
+		std::unique_ptr<ThreadPool> threadPool;
+
 		std::list<std::shared_ptr<EditorTaskAnchor>> tasks;
 		EditorTaskSetListener* listener = nullptr;
 		int nextId = 0;
+
+		void addTask(EditorTaskAnchor&& editorTaskAnchor, int order);
+		bool canStart(const EditorTaskAnchor& task) const;
 	};
 }
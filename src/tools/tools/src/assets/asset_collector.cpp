@@ -4,6 +4,7 @@
 #include "halley/resources/metadata.h"
 #include "halley/support/logger.h"
 #include "halley/bytes/compression.h"
+#include <algorithm>
 
 using namespace Halley;
 
@@ -21,34 +22,30 @@ void AssetCollector::output(const String& name, AssetType type, const Bytes& dat
 	Path filePath = Path(toString(type)) / id;
 	Path fullPath = Path(platform) / filePath;
 
-	if (metadata && metadata->getString("asset_compression", "") == "deflate") {
-		auto newData = Compression::compress(data);
+	const auto compression = metadata ? metadata->getString("asset_compression", "") : String();
+	if (!compression.isEmpty()) {
+		auto newData = Compression::compress(gsl::as_bytes(gsl::span<const Byte>(data)), compression);
 		outFiles.emplace_back(fullPath, newData);
 	} else {
 		outFiles.emplace_back(fullPath, data);
 	}
 
-	// Find existing entry, otherwise create a new one
-	AssetResource* result = nullptr;
-	for (auto& a: assets) {
-		if (a.name == name && a.type == type) {
-			result = &a;
-		}
-	}
-	if (!result) {
-		assets.emplace_back();
-		result = &assets.back();
-		result->name = name;
-		result->type = type;
-	}
-
 	// Store information about this asset version
 	AssetResource::PlatformVersion version;
 	version.filepath = fullPath.string();
 	if (metadata) {
 		version.metadata = metadata.get();
 	}
-	result->platformVersions[platform] = std::move(version);
+	getAsset(name, type).platformVersions[platform] = std::move(version);
+}
+
+void AssetCollector::addDependency(const String& name, AssetType type, const String& dependencyName, AssetType dependencyType)
+{
+	auto& deps = getAsset(name, type).dependencies;
+	auto dep = std::make_pair(dependencyType, dependencyName);
+	if (std::find(deps.begin(), deps.end(), dep) == deps.end()) {
+		deps.push_back(std::move(dep));
+	}
 }
 
 void AssetCollector::addAdditionalAsset(ImportingAsset&& additionalAsset)
@@ -97,3 +94,18 @@ const std::vector<TimestampedPath>& AssetCollector::getAdditionalInputs() const
 {
 	return additionalInputs;
 }
+
+AssetResource& AssetCollector::getAsset(const String& name, AssetType type)
+{
+	// Find existing entry, otherwise create a new one
+	for (auto& a: assets) {
+		if (a.name == name && a.type == type) {
+			return a;
+		}
+	}
+	assets.emplace_back();
+	auto& result = assets.back();
+	result.name = name;
+	result.type = type;
+	return result;
+}
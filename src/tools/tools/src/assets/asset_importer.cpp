@@ -13,10 +13,13 @@
 #include "importers/spritesheet_importer.h"
 #include "importers/bitmap_font_importer.h"
 #include "importers/shader_importer.h"
+#include "importers/lua_importer.h"
+#include "importers/string_table_importer.h"
 #include "halley/text/string_converter.h"
 #include "halley/tools/project/project.h"
 #include <boost/variant/detail/substitute.hpp>
 #include "importers/texture_importer.h"
+#include "halley/utils/hash.h"
 
 using namespace Halley;
 
@@ -38,6 +41,8 @@ AssetImporter::AssetImporter(Project& project, const std::vector<Path>& assetsSr
 		std::make_unique<SpriteSheetImporter>(),
 		std::make_unique<ShaderImporter>(),
 		std::make_unique<TextureImporter>(),
+		std::make_unique<LuaImporter>(),
+		std::make_unique<StringTableImporter>(),
 		std::make_unique<IAssetImporter>()
 	};
 
@@ -68,6 +73,8 @@ IAssetImporter& AssetImporter::getRootImporter(Path path) const
 		type = ImportAssetType::Material;
 	} else if (root == "config") {
 		type = ImportAssetType::Config;
+	} else if (root == "strings") {
+		type = ImportAssetType::StringTable;
 	} else if (root == "audio") {
 		type = ImportAssetType::Audio;
 	} else if (root == "audio_event") {
@@ -78,6 +85,8 @@ IAssetImporter& AssetImporter::getRootImporter(Path path) const
 		type = ImportAssetType::Skip;
 	} else if (root == "texture") {
 		type = ImportAssetType::Texture;
+	} else if (root == "lua") {
+		type = ImportAssetType::LuaScript;
 	}
 
 	return getImporters(type).at(0);
@@ -102,3 +111,16 @@ const std::vector<Path>& AssetImporter::getAssetsSrc() const
 {
 	return assetsSrc;
 }
+
+uint64_t AssetImporter::getVersionHash() const
+{
+	// Importers feed into each other (e.g. images into textures), so any of them changing affects every asset
+	Hash::Hasher hasher;
+	for (auto& typeImporters: importers) {
+		hasher.feed(int(typeImporters.first));
+		for (auto& importer: typeImporters.second) {
+			hasher.feed(importer->getVersion());
+		}
+	}
+	return hasher.digest();
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <set>
 #include <thread>
 #include "halley/tools/assets/check_assets_task.h"
@@ -10,6 +11,8 @@
 #include "halley/support/logger.h"
 #include "../yaml/halley-yamlcpp.h"
 #include "halley/resources/resource_data.h"
+#include "halley/bytes/byte_serializer.h"
+#include "halley/utils/hash.h"
 
 using namespace Halley;
 using namespace std::chrono_literals;
@@ -29,9 +32,21 @@ void CheckAssetsTask::run()
 {
 	bool first = true;
 	while (!isCancelled()) {
-		if (first | monitorAssets.poll() | monitorAssetsSrc.poll() | monitorSharedAssetsSrc.poll()) { // Don't short-circuit
+		// When the monitors can tell which files changed, only the assets built from them (and the ones depending on them) are looked at
+		std::vector<ChangedFile> changes;
+		bool fullScan = first;
+		fullScan |= !collectChanges(monitorAssetsSrc, project.getAssetsSrcPath(), changes);
+		fullScan |= !collectChanges(monitorSharedAssetsSrc, project.getSharedAssetsSrcPath(), changes);
+		fullScan |= hasRemovedOutputs(monitorAssets);
+
+		auto& db = project.getImportAssetsDatabase();
+		if (!fullScan && !changes.empty()) {
+			Logger::logInfo("Checking " + toString(changes.size()) + " changed asset files...");
+			fullScan = !checkChangedAssets(db, changes, project.getUnpackedAssetsPath(), "Importing assets", true);
+		}
+		if (fullScan) {
 			Logger::logInfo("Scanning for asset changes...");
-			checkAllAssets(project.getImportAssetsDatabase(), { project.getAssetsSrcPath(), project.getSharedAssetsSrcPath() }, project.getUnpackedAssetsPath(), "Importing assets", true);
+			checkAllAssets(db, { project.getAssetsSrcPath(), project.getSharedAssetsSrcPath() }, project.getUnpackedAssetsPath(), "Importing assets", true);
 		}
 
 		if (first | monitorGen.poll() | monitorGenSrc.poll()) {
@@ -41,63 +56,90 @@ void CheckAssetsTask::run()
 
 		first = false;
 
-		while (hasPendingTasks()) {
-			std::this_thread::sleep_for(5ms);
-		}
-
+		// Imports queued while others are still going wait for them (and get merged together), so there's no need to wait here
 		if (oneShot) {
-			return;
+			break;
 		}
 		std::this_thread::sleep_for(monitorAssets.hasRealImplementation() ? 100ms : 1000ms);
 	}
+
+	// Pending tasks report back to this one when they're done, so it can't go away before them
+	while (hasPendingTasks()) {
+		std::this_thread::sleep_for(5ms);
+	}
 }
 
-static void loadMetaTable(Metadata& meta, const YAML::Node& root)
+static std::vector<std::pair<String, String>> loadMetaTable(const YAML::Node& root)
 {
+	std::vector<std::pair<String, String>> table;
 	for (YAML::const_iterator it = root.begin(); it != root.end(); ++it) {
 		String key = it->first.as<std::string>();
 		String value = it->second.as<std::string>();
-		meta.set(key, value);
+		table.emplace_back(std::move(key), std::move(value));
 	}
+	return table;
 }
 
-static void loadMetaData(Metadata& meta, const Path& path, bool isDirectoryMeta, String assetId)
+static void applyMetaTable(Metadata& meta, const std::vector<std::pair<String, String>>& table)
 {
+	for (auto& kv: table) {
+		meta.set(kv.first, kv.second);
+	}
+}
+
+const CheckAssetsTask::ParsedMeta& CheckAssetsTask::getParsedMeta(const Path& path, int64_t timestamp, bool isDirectoryMeta)
+{
+	auto iter = parsedMetas.find(path.getString());
+	if (iter != parsedMetas.end() && iter->second.timestamp == timestamp) {
+		return iter->second;
+	}
+
 	auto data = ResourceDataStatic::loadFromFileSystem(path);
 	auto root = YAML::Load(data->getString());
 
+	ParsedMeta parsed;
+	parsed.timestamp = timestamp;
 	if (isDirectoryMeta) {
 		for (const auto& rootList: root) {
-			bool matches = true;
-			if (rootList["match"]) {
-				matches = false;
-				for (auto& pattern: rootList["match"]) {
-					auto p = pattern.as<std::string>();
-					if (assetId.contains(p)) {
-						matches = true;
-						break;
+			// Entries without data never apply, as the first matching one with data is the one used
+			if (rootList["data"]) {
+				std::vector<String> patterns;
+				if (rootList["match"]) {
+					for (auto& pattern: rootList["match"]) {
+						patterns.push_back(pattern.as<std::string>());
 					}
 				}
-			}
-			if (matches && rootList["data"]) {
-				loadMetaTable(meta, rootList["data"]);
-				return;
+				parsed.entries.emplace_back(std::move(patterns), loadMetaTable(rootList["data"]));
 			}
 		}
 	} else {
-		loadMetaTable(meta, root);
+		parsed.entries.emplace_back(std::vector<String>(), loadMetaTable(root));
 	}
+
+	auto& result = parsedMetas[path.getString()];
+	result = std::move(parsed);
+	return result;
 }
 
-static Metadata getMetaData(Path inputFilePath, Maybe<Path> dirMetaPath, Maybe<Path> privateMetaPath)
+Metadata CheckAssetsTask::getMetaData(const Path& inputFilePath, Maybe<Path> dirMetaPath, int64_t dirMetaTimestamp, Maybe<Path> privateMetaPath, int64_t privateMetaTimestamp)
 {
 	Metadata meta;
 	try {
 		if (dirMetaPath) {
-			loadMetaData(meta, dirMetaPath.get(), true, inputFilePath.toString());
+			const String assetId = inputFilePath.toString();
+			for (auto& entry: getParsedMeta(dirMetaPath.get(), dirMetaTimestamp, true).entries) {
+				const auto& patterns = entry.first;
+				const bool matches = patterns.empty() || std::any_of(patterns.begin(), patterns.end(), [&] (const String& p) { return assetId.contains(p); });
+				if (matches) {
+					applyMetaTable(meta, entry.second);
+					break;
+				}
+			}
 		}
 		if (privateMetaPath) {
-			loadMetaData(meta, privateMetaPath.get(), false, inputFilePath.toString());
+			for (auto& entry: getParsedMeta(privateMetaPath.get(), privateMetaTimestamp, false).entries) {
+				applyMetaTable(meta, entry.second);
+			}
 		}
 	} catch (std::exception& e) {
 		throw Exception("Error parsing metafile for " + inputFilePath + ": " + e.what(), HalleyExceptions::Tools);
@@ -105,6 +147,17 @@ static Metadata getMetaData(Path inputFilePath, Maybe<Path> dirMetaPath, Maybe<P
 	return meta;
 }
 
+static uint64_t hashInputFile(const Path& path, const Metadata& meta)
+{
+	Hash::Hasher hasher;
+	const auto data = FileSystem::readFile(path);
+	hasher.feed(uint64_t(data.size()));
+	hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(data)));
+	const auto metaData = Serializer::toBytes(meta);
+	hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(metaData)));
+	return hasher.digest();
+}
+
 bool CheckAssetsTask::importFile(ImportAssetsDatabase& db, std::map<String, ImportAssetsDatabaseEntry>& assets, const bool isCodegen, const std::vector<Path>& directoryMetas, const Path& srcPath, const Path& filePath) {
 	std::array<int64_t, 3> timestamps = {{ 0, 0, 0 }};
 	bool dbChanged = false;
@@ -130,9 +183,11 @@ bool CheckAssetsTask::importFile(ImportAssetsDatabase& db, std::map<String, Impo
 	}
 
 	// Load metadata if needed
-	if (db.needToLoadInputMetadata(filePath, timestamps)) {
-		Metadata meta = getMetaData(filePath, dirMetaPath, privateMetaPath);
-		db.setInputFileMetadata(filePath, timestamps, meta);
+	const bool contentHashing = db.isContentHashing();
+	if (db.needToLoadInputMetadata(filePath, timestamps) || (contentHashing && db.getInputFileHash(filePath) == 0)) {
+		Metadata meta = getMetaData(filePath, dirMetaPath, timestamps[1], privateMetaPath, timestamps[2]);
+		const uint64_t contentHash = contentHashing ? hashInputFile(srcPath / filePath, meta) : 0;
+		db.setInputFileMetadata(filePath, timestamps, meta, contentHash);
 		dbChanged = true;
 	}
 
@@ -190,6 +245,9 @@ void CheckAssetsTask::checkAllAssets(ImportAssetsDatabase& db, std::vector<Path>
 				directoryMetas.push_back(filePath);
 			}
 		}
+		if (!isCodegen) {
+			scannedDirectoryMetas[srcPath.getString()] = directoryMetas;
+		}
 
 		// Next, go through normal files
 		for (auto& filePath : allFiles) {
@@ -201,13 +259,103 @@ void CheckAssetsTask::checkAllAssets(ImportAssetsDatabase& db, std::vector<Path>
 		}
 	}
 
+	// Check for missing input files
+	db.markAssetsAsStillPresent(assets);
+	addImportTasks(db, assets, db.getAllMissing(), dbChanged, dstPath, taskName, packAfter);
+}
+
+bool CheckAssetsTask::checkChangedAssets(ImportAssetsDatabase& db, const std::vector<ChangedFile>& changes, Path dstPath, String taskName, bool packAfter)
+{
+	std::set<String> affected;
+	std::map<String, ChangedFile> toCheck;
+	auto addFile = [&] (const Path& srcPath, const Path& filePath)
+	{
+		toCheck[(srcPath / filePath).getString()] = ChangedFile(srcPath, filePath);
+	};
+
+	for (auto& change: changes) {
+		const auto& srcPath = change.first;
+		auto filePath = change.second;
+		if (filePath.getFilename() == "_dir.meta" || scannedDirectoryMetas.find(srcPath.getString()) == scannedDirectoryMetas.end()) {
+			return false;
+		}
+		if (filePath.getExtension() == ".meta") {
+			filePath = filePath.replaceExtension("");
+		}
+
+		// Everything built from it, or from files under it if it was a directory that got removed or renamed
+		for (auto& id: db.getAssetsFromInput(srcPath, filePath)) {
+			affected.insert(id);
+		}
+
+		const auto fullPath = srcPath / filePath;
+		if (FileSystem::isDirectory(fullPath)) {
+			// New files could have come with it
+			return false;
+		} else if (FileSystem::exists(fullPath)) {
+			addFile(srcPath, filePath);
+		}
+	}
+
+	// Other inputs of the affected assets have to be there too, or they'd look like they lost them
+	for (auto& id: affected) {
+		auto asset = db.getImportedAsset(id);
+		for (auto& input: asset->inputFiles) {
+			if (FileSystem::exists(asset->srcDir / input.first)) {
+				addFile(asset->srcDir, input.first);
+			}
+		}
+	}
+
+	std::map<String, ImportAssetsDatabaseEntry> assets;
+	bool dbChanged = false;
+	for (auto& file: toCheck) {
+		const auto& srcPath = file.second.first;
+		dbChanged = dbChanged | importFile(db, assets, false, scannedDirectoryMetas[srcPath.getString()], srcPath, file.second.second);
+	}
+
+	// A new file can also join an existing asset which wasn't affected otherwise
+	std::map<String, ChangedFile> extraFiles;
+	for (auto& a: assets) {
+		if (affected.find(a.first) == affected.end()) {
+			auto asset = db.getImportedAsset(a.first);
+			if (asset) {
+				for (auto& input: asset->inputFiles) {
+					const auto key = (asset->srcDir / input.first).getString();
+					if (toCheck.find(key) == toCheck.end() && FileSystem::exists(asset->srcDir / input.first)) {
+						extraFiles[key] = ChangedFile(asset->srcDir, input.first);
+					}
+				}
+			}
+		}
+	}
+	for (auto& file: extraFiles) {
+		const auto& srcPath = file.second.first;
+		dbChanged = dbChanged | importFile(db, assets, false, scannedDirectoryMetas[srcPath.getString()], srcPath, file.second.second);
+	}
+
+	// Affected assets that no longer have any inputs are gone
+	std::vector<ImportAssetsDatabaseEntry> toDelete;
+	for (auto& id: affected) {
+		if (assets.find(id) == assets.end()) {
+			toDelete.push_back(db.getImportedAsset(id).get());
+		}
+	}
+
+	addImportTasks(db, assets, std::move(toDelete), dbChanged, dstPath, taskName, packAfter);
+	return true;
+}
+
+void CheckAssetsTask::addImportTasks(ImportAssetsDatabase& db, std::map<String, ImportAssetsDatabaseEntry>& assets, std::vector<ImportAssetsDatabaseEntry> toDelete, bool dbChanged, Path dstPath, String taskName, bool packAfter)
+{
 	if (dbChanged) {
 		db.save();
 	}
 
-	// Check for missing input files
-	db.markAssetsAsStillPresent(assets);
-	auto toDelete = db.getAllMissing();
+	if (db.isContentHashing()) {
+		computeInputHashes(db, assets);
+	}
+
 	std::vector<String> deletedAssets;
 	if (!toDelete.empty()) {
 		for (auto& a: toDelete) {
@@ -228,6 +376,32 @@ void CheckAssetsTask::checkAllAssets(ImportAssetsDatabase& db, std::vector<Path>
 	}
 }
 
+bool CheckAssetsTask::collectChanges(DirectoryMonitor& monitor, const Path& srcPath, std::vector<ChangedFile>& changes)
+{
+	bool known = true;
+	for (auto& event: monitor.getChanges()) {
+		if (event.type == DirectoryMonitor::ChangeType::Unknown) {
+			known = false;
+		} else {
+			if (event.type == DirectoryMonitor::ChangeType::FileRenamed && !event.oldName.isEmpty()) {
+				changes.emplace_back(srcPath, Path(event.oldName));
+			}
+			changes.emplace_back(srcPath, Path(event.name));
+		}
+	}
+	return known;
+}
+
+bool CheckAssetsTask::hasRemovedOutputs(DirectoryMonitor& monitor)
+{
+	// Outputs being written are the importer's own doing, so only outputs going away need a full scan
+	bool removed = false;
+	for (auto& event: monitor.getChanges()) {
+		removed |= event.type == DirectoryMonitor::ChangeType::Unknown || event.type == DirectoryMonitor::ChangeType::FileRemoved || event.type == DirectoryMonitor::ChangeType::FileRenamed;
+	}
+	return removed;
+}
+
 std::vector<ImportAssetsDatabaseEntry> CheckAssetsTask::filterNeedsImporting(ImportAssetsDatabase& db, const std::map<String, ImportAssetsDatabaseEntry>& assets)
 {
 	Vector<ImportAssetsDatabaseEntry> toImport;
@@ -241,6 +415,29 @@ std::vector<ImportAssetsDatabaseEntry> CheckAssetsTask::filterNeedsImporting(Imp
 	return toImport;
 }
 
+void CheckAssetsTask::computeInputHashes(ImportAssetsDatabase& db, std::map<String, ImportAssetsDatabaseEntry>& assets) const
+{
+	Hash::Hasher base;
+	base.feed(project.getAssetImporter().getVersionHash());
+	for (auto& platform: project.getPlatforms()) {
+		base.feedBytes(gsl::as_bytes(gsl::span<const char>(platform.c_str(), platform.size())));
+	}
+	const uint64_t versionHash = base.digest();
+
+	for (auto& a: assets) {
+		auto& asset = a.second;
+		Hash::Hasher hasher;
+		hasher.feed(versionHash);
+		hasher.feed(int(asset.assetType));
+		for (auto& input: asset.inputFiles) {
+			const auto name = input.first.getString();
+			hasher.feedBytes(gsl::as_bytes(gsl::span<const char>(name.c_str(), name.size())));
+			hasher.feed(db.getInputFileHash(input.first));
+		}
+		asset.inputHash = std::max(uint64_t(1), hasher.digest()); // 0 means "not hashed"
+	}
+}
+
 Maybe<Path> CheckAssetsTask::findDirectoryMeta(const std::vector<Path>& metas, const Path& path) const
 {
 	auto parent = path.parentPath();
@@ -12,6 +12,7 @@ DeleteAssetsTask::DeleteAssetsTask(ImportAssetsDatabase& db, Path assetsPath, Ve
 	, assetsPath(assetsPath)
 	, assets(assets)
 {
+	setExclusiveKey(assetsPath.getString());
 }
 
 void DeleteAssetsTask::run()
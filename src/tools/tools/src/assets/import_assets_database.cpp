@@ -2,8 +2,10 @@
 #include "halley/bytes/byte_serializer.h"
 #include "halley/resources/resource_data.h"
 #include "halley/tools/file/filesystem.h"
+#include "halley/utils/hash.h"
+#include <algorithm>
 
-constexpr static int currentAssetVersion = 53;
+constexpr static int currentAssetVersion = 56;
 
 using namespace Halley;
 
@@ -16,6 +18,8 @@ void ImportAssetsDatabaseEntry::serialize(Serializer& s) const
 	s << outputFiles;
 	int t = int(assetType);
 	s << t;
+	s << inputHash;
+	s << additionalInputHash;
 }
 
 void ImportAssetsDatabaseEntry::deserialize(Deserializer& s)
@@ -28,6 +32,8 @@ void ImportAssetsDatabaseEntry::deserialize(Deserializer& s)
 	int t;
 	s >> t;
 	assetType = ImportAssetType(t);
+	s >> inputHash;
+	s >> additionalInputHash;
 }
 
 void ImportAssetsDatabase::AssetEntry::serialize(Serializer& s) const
@@ -48,6 +54,7 @@ void ImportAssetsDatabase::InputFileEntry::serialize(Serializer& s) const
 		s << timestamp[i];
 	}
 	s << metadata;
+	s << contentHash;
 }
 
 void ImportAssetsDatabase::InputFileEntry::deserialize(Deserializer& s)
@@ -63,6 +70,7 @@ void ImportAssetsDatabase::InputFileEntry::deserialize(Deserializer& s)
 		timestamp[i] = 0;
 	}
 	s >> metadata;
+	s >> contentHash;
 }
 
 ImportAssetsDatabase::ImportAssetsDatabase(Path directory, Path dbFile, Path assetsDbFile, std::vector<String> platforms)
@@ -86,12 +94,24 @@ void ImportAssetsDatabase::load()
 
 void ImportAssetsDatabase::save() const
 {
-	std::lock_guard<std::mutex> lock(mutex);
-	FileSystem::writeFile(dbFile, Serializer::toBytes(*this));
-	for (auto& platform: platforms) {
+	// Saves are serialised, so an older snapshot never overwrites a newer one
+	std::lock_guard<std::mutex> saveLock(saveMutex);
+
+	Bytes dbData;
+	std::vector<Bytes> assetDbData;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		dbData = Serializer::toBytes(*this);
+		for (size_t i = 0; i < platforms.size(); ++i) {
+			assetDbData.push_back(Serializer::toBytes(getAssetDatabase(i)));
+		}
+	}
+
+	// Write outside the main lock, so importers aren't blocked on disk I/O
+	FileSystem::writeFile(dbFile, dbData);
+	for (auto& data: assetDbData) {
 		// TODO: fix this
-		auto assetDb = makeAssetDatabase(platform);
-		FileSystem::writeFile(assetsDbFile, Serializer::toBytes(*assetDb));
+		FileSystem::writeFile(assetsDbFile, data);
 	}
 }
 
@@ -116,7 +136,7 @@ bool ImportAssetsDatabase::needToLoadInputMetadata(const Path& path, std::array<
 	return false;
 }
 
-void ImportAssetsDatabase::setInputFileMetadata(const Path& path, std::array<int64_t, 3> timestamps, const Metadata& data)
+void ImportAssetsDatabase::setInputFileMetadata(const Path& path, std::array<int64_t, 3> timestamps, const Metadata& data, uint64_t contentHash)
 {
 	std::lock_guard<std::mutex> lock(mutex);
 
@@ -124,6 +144,7 @@ void ImportAssetsDatabase::setInputFileMetadata(const Path& path, std::array<int
 	auto& input = inputFiles[pathStr];
 	input.timestamp = timestamps;
 	input.metadata = data;
+	input.contentHash = contentHash;
 }
 
 Maybe<Metadata> ImportAssetsDatabase::getMetadata(const Path& path) const
@@ -139,6 +160,46 @@ Maybe<Metadata> ImportAssetsDatabase::getMetadata(const Path& path) const
 	}
 }
 
+uint64_t ImportAssetsDatabase::getInputFileHash(const Path& path) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	auto iter = inputFiles.find(path.toString());
+	if (iter == inputFiles.end()) {
+		return 0;
+	} else {
+		return iter->second.contentHash;
+	}
+}
+
+void ImportAssetsDatabase::setContentHashing(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	contentHashing = enabled;
+}
+
+bool ImportAssetsDatabase::isContentHashing() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return contentHashing;
+}
+
+uint64_t ImportAssetsDatabase::hashFileContents(const std::vector<TimestampedPath>& files)
+{
+	// Paths are left out so that the hash matches on machines with the project checked out elsewhere
+	Hash::Hasher hasher;
+	for (auto& f: files) {
+		if (FileSystem::exists(f.first)) {
+			const auto data = FileSystem::readFile(f.first);
+			hasher.feed(uint64_t(data.size()));
+			hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(data)));
+		} else {
+			hasher.feed(uint64_t(-1));
+		}
+	}
+	return hasher.digest();
+}
+
 bool ImportAssetsDatabase::needsImporting(const ImportAssetsDatabaseEntry& asset) const
 {
 	std::lock_guard<std::mutex> lock(mutex);
@@ -168,6 +229,26 @@ bool ImportAssetsDatabase::needsImporting(const ImportAssetsDatabaseEntry& asset
 		return true;
 	}
 
+	if (contentHashing) {
+		// Inputs and their metadata are summarised by inputHash, and additional inputs are only rehashed if they were touched
+		if (asset.inputHash == 0 || asset.inputHash != oldAsset.inputHash) {
+			return true;
+		}
+
+		bool additionalTouched = false;
+		for (auto& i: oldAsset.additionalInputFiles) {
+			if (!FileSystem::exists(i.first) || FileSystem::getLastWriteTime(i.first) != i.second) {
+				additionalTouched = true;
+				break;
+			}
+		}
+		if (additionalTouched && hashFileContents(oldAsset.additionalInputFiles) != oldAsset.additionalInputHash) {
+			return true;
+		}
+
+		return !failed && hasMissingOutputs(oldAsset);
+	}
+
 	// Any of the input files changed?
 	// Note: We don't have to check old files on new input, because the size matches and all entries matched.
 	for (auto& i: asset.inputFiles) {
@@ -193,16 +274,18 @@ bool ImportAssetsDatabase::needsImporting(const ImportAssetsDatabaseEntry& asset
 	}
 
 	// Have any of the output files gone missing?
-	if (!failed) {
-		for (auto& o: oldAsset.outputFiles) {
-			for (auto& version: o.platformVersions) {
-				if (!FileSystem::exists(directory / version.second.filepath)) {
-					return true;
-				}
+	return !failed && hasMissingOutputs(oldAsset);
+}
+
+bool ImportAssetsDatabase::hasMissingOutputs(const ImportAssetsDatabaseEntry& asset) const
+{
+	for (auto& o: asset.outputFiles) {
+		for (auto& version: o.platformVersions) {
+			if (!FileSystem::exists(directory / version.second.filepath)) {
+				return true;
 			}
 		}
 	}
-
 	return false;
 }
 
@@ -213,6 +296,11 @@ void ImportAssetsDatabase::markAsImported(const ImportAssetsDatabaseEntry& asset
 	entry.present = true;
 
 	std::lock_guard<std::mutex> lock(mutex);
+	auto prevIter = assetsImported.find(asset.assetId);
+	if (prevIter != assetsImported.end()) {
+		removeFromAssetDatabases(prevIter->second.asset);
+	}
+	addToAssetDatabases(asset);
 	assetsImported[asset.assetId] = entry;
 	
 	auto failIter = assetsFailed.find(asset.assetId);
@@ -224,7 +312,11 @@ void ImportAssetsDatabase::markAsImported(const ImportAssetsDatabaseEntry& asset
 void ImportAssetsDatabase::markDeleted(const ImportAssetsDatabaseEntry& asset)
 {
 	std::lock_guard<std::mutex> lock(mutex);
-	assetsImported.erase(asset.assetId);
+	auto iter = assetsImported.find(asset.assetId);
+	if (iter != assetsImported.end()) {
+		removeFromAssetDatabases(iter->second.asset);
+		assetsImported.erase(iter);
+	}
 }
 
 void ImportAssetsDatabase::markFailed(const ImportAssetsDatabaseEntry& asset)
@@ -257,6 +349,53 @@ std::vector<ImportAssetsDatabaseEntry> ImportAssetsDatabase::getAllMissing() con
 	return result;
 }
 
+std::vector<String> ImportAssetsDatabase::getAssetsFromInput(const Path& srcDir, const Path& path) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const auto relative = path.getString();
+	const auto relativeDir = relative + "/";
+	const auto absolute = (srcDir / path).getString();
+	const auto absoluteDir = absolute + "/";
+
+	std::vector<String> result;
+	for (auto& a: assetsImported) {
+		auto& asset = a.second.asset;
+		bool found = false;
+		if (asset.srcDir == srcDir) {
+			for (auto& i: asset.inputFiles) {
+				const auto name = i.first.getString();
+				if (name == relative || name.startsWith(relativeDir)) {
+					found = true;
+					break;
+				}
+			}
+		}
+		for (auto& i: asset.additionalInputFiles) {
+			if (found) {
+				break;
+			}
+			const auto name = i.first.getString();
+			found = name == absolute || name.startsWith(absoluteDir);
+		}
+		if (found) {
+			result.push_back(a.first);
+		}
+	}
+	return result;
+}
+
+Maybe<ImportAssetsDatabaseEntry> ImportAssetsDatabase::getImportedAsset(const String& assetId) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto iter = assetsImported.find(assetId);
+	if (iter != assetsImported.end()) {
+		return iter->second.asset;
+	} else {
+		return {};
+	}
+}
+
 std::vector<AssetResource> ImportAssetsDatabase::getOutFiles(String assetId) const
 {
 	auto iter = assetsImported.find(assetId);
@@ -288,29 +427,70 @@ void ImportAssetsDatabase::deserialize(Deserializer& s)
 			s >> inputFiles;
 		}
 	}
+	assetDbs.clear();
 }
 
 std::unique_ptr<AssetDatabase> ImportAssetsDatabase::makeAssetDatabase(const String& platform) const
 {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const auto iter = std::find(platforms.begin(), platforms.end(), platform);
+	if (iter != platforms.end()) {
+		return std::make_unique<AssetDatabase>(getAssetDatabase(size_t(iter - platforms.begin())));
+	}
+
 	auto result = std::make_unique<AssetDatabase>();
 	for (auto& a: assetsImported) {
-		auto& asset = a.second.asset;
-		for (auto& o: asset.outputFiles) {
-			auto iter = o.platformVersions.find(platform);
-			const AssetResource::PlatformVersion* version = nullptr;
-			if (iter != o.platformVersions.end()) {
-				version = &iter->second;
-			} else {
-				iter = o.platformVersions.find("pc");
-				if (iter != o.platformVersions.end()) {
-					version = &iter->second;
-				}
+		for (auto& o: a.second.asset.outputFiles) {
+			auto version = getPlatformVersion(o, platform);
+			if (version) {
+				result->addAsset(o.name, o.type, AssetDatabase::Entry(version->filepath, version->metadata, o.dependencies));
 			}
+		}
+	}
+	return result;
+}
 
+AssetDatabase& ImportAssetsDatabase::getAssetDatabase(size_t platformIdx) const
+{
+	// Only built in full once; after that, it's kept up to date by addToAssetDatabases and removeFromAssetDatabases
+	if (assetDbs.empty()) {
+		for (size_t i = 0; i < platforms.size(); ++i) {
+			assetDbs.push_back(std::make_unique<AssetDatabase>());
+		}
+		for (auto& a: assetsImported) {
+			addToAssetDatabases(a.second.asset);
+		}
+	}
+	return *assetDbs.at(platformIdx);
+}
+
+void ImportAssetsDatabase::addToAssetDatabases(const ImportAssetsDatabaseEntry& asset) const
+{
+	for (size_t i = 0; i < assetDbs.size(); ++i) {
+		for (auto& o: asset.outputFiles) {
+			auto version = getPlatformVersion(o, platforms[i]);
 			if (version) {
-				result->addAsset(o.name, o.type, AssetDatabase::Entry(version->filepath, version->metadata));
+				assetDbs[i]->addAsset(o.name, o.type, AssetDatabase::Entry(version->filepath, version->metadata, o.dependencies));
 			}
 		}
 	}
-	return result;
+}
+
+void ImportAssetsDatabase::removeFromAssetDatabases(const ImportAssetsDatabaseEntry& asset) const
+{
+	for (auto& db: assetDbs) {
+		for (auto& o: asset.outputFiles) {
+			db->removeAsset(o.name, o.type);
+		}
+	}
+}
+
+const AssetResource::PlatformVersion* ImportAssetsDatabase::getPlatformVersion(const AssetResource& resource, const String& platform)
+{
+	auto iter = resource.platformVersions.find(platform);
+	if (iter == resource.platformVersions.end()) {
+		iter = resource.platformVersions.find("pc");
+	}
+	return iter != resource.platformVersions.end() ? &iter->second : nullptr;
 }
@@ -1,8 +1,13 @@
 #include <thread>
+#include <map>
+#include <numeric>
+#include <exception>
+#include <algorithm>
 #include "halley/tools/assets/import_assets_task.h"
 #include "halley/tools/assets/check_assets_task.h"
 #include "halley/tools/project/project.h"
 #include "halley/tools/assets/import_assets_database.h"
+#include "halley/tools/assets/import_cache.h"
 #include "halley/resources/resource_data.h"
 #include "halley/tools/file/filesystem.h"
 #include "halley/tools/assets/asset_collector.h"
@@ -24,46 +29,95 @@ ImportAssetsTask::ImportAssetsTask(String taskName, ImportAssetsDatabase& db, co
 	, files(std::move(files))
 	, deletedAssets(std::move(deletedAssets))
 	, totalImportTime(0)
-{}
+{
+	setExclusiveKey(assetsPath.getString());
+}
+
+bool ImportAssetsTask::mergeWith(EditorTask& other)
+{
+	auto o = dynamic_cast<ImportAssetsTask*>(&other);
+	if (!o || &o->db != &db || o->assetsPath != assetsPath || o->packAfter != packAfter) {
+		return false;
+	}
+
+	// The other one was queued later, so its view of each asset is the latest
+	std::map<String, size_t> byId;
+	for (size_t i = 0; i < files.size(); ++i) {
+		byId[files[i].assetId] = i;
+	}
+	for (auto& f: o->files) {
+		auto iter = byId.find(f.assetId);
+		if (iter != byId.end()) {
+			files[iter->second] = std::move(f);
+		} else {
+			byId[f.assetId] = files.size();
+			files.push_back(std::move(f));
+		}
+	}
+	for (auto& d: o->deletedAssets) {
+		if (std::find(deletedAssets.begin(), deletedAssets.end(), d) == deletedAssets.end()) {
+			deletedAssets.push_back(std::move(d));
+		}
+	}
+	return true;
+}
 
 void ImportAssetsTask::run()
 {
+	// Another import of the same assets may have run while this was queued
+	files.erase(std::remove_if(files.begin(), files.end(), [&] (const ImportAssetsDatabaseEntry& f) { return !db.needsImporting(f); }), files.end());
+	if (files.empty() && deletedAssets.empty()) {
+		return;
+	}
+
 	Stopwatch timer;
 	using namespace std::chrono_literals;
-	auto lastSave = std::chrono::steady_clock::now();
+	lastSave = std::chrono::steady_clock::now();
 
 	assetsImported = 0;
 	assetsToImport = files.size();
-	std::vector<Future<void>> tasks;
+
+	// Assets are imported in phases, so anything an importer might depend on (e.g. shaders for materials) is done first
+	std::map<int, std::vector<size_t>> phases;
+	for (size_t i = 0; i < files.size(); ++i) {
+		phases[getImportPhase(files[i].assetType)].push_back(i);
+	}
 
 	constexpr bool parallelImport = !Debug::isDebug();
+	const size_t maxWorkers = parallelImport ? std::max(size_t(1), size_t(std::thread::hardware_concurrency())) : 1;
 
-	for (size_t i = 0; i < files.size(); ++i) {
-		auto importFunc = [&, i] () {
-			if (isCancelled()) {
-				return;
-			}
+	for (auto& phase: phases) {
+		auto& indices = phase.second;
+		std::atomic<size_t> next(0);
 
-			if (importAsset(files[i])) {
-				++assetsImported;
-				setProgress(float(assetsImported) * 0.98f / float(assetsToImport), files[i].assetId);
-			}
+		// Each worker pulls the next asset as it finishes the last, so a few slow assets don't hold up a whole batch
+		auto worker = [&] () {
+			for (size_t j = next++; j < indices.size() && !isCancelled(); j = next++) {
+				auto& asset = files[indices[j]];
+				importAsset(asset);
 
-			auto now = std::chrono::steady_clock::now();
-			if (now - lastSave > 1s) {
-				db.save();
-				lastSave = now;
+				const size_t done = ++assetsImported;
+				setProgress(float(done) * 0.98f / float(assetsToImport), asset.assetId);
+				saveDatabaseIfNeeded();
 			}
 		};
 
-		if (parallelImport) {
-			tasks.push_back(Concurrent::execute(Executors::getCPUAux(), importFunc));
+		const size_t nWorkers = std::min(maxWorkers, indices.size());
+		if (nWorkers > 1) {
+			std::vector<Future<void>> tasks;
+			for (size_t i = 0; i < nWorkers; ++i) {
+				tasks.push_back(Concurrent::execute(Executors::getCPUAux(), worker));
+			}
+			Concurrent::whenAll(tasks.begin(), tasks.end()).get();
 		} else {
-			importFunc();
+			worker();
+		}
+
+		if (isCancelled()) {
+			break;
 		}
 	}
 
-	Concurrent::whenAll(tasks.begin(), tasks.end()).get();
 	db.save();
 
 	if (!isCancelled()) {
@@ -80,6 +134,35 @@ void ImportAssetsTask::run()
 	Logger::logInfo("Import took " + toString(realTime) + " seconds, on which " + toString(importTime) + " seconds of work were performed (" + toString(importTime / realTime) + "x realtime)");
 }
 
+void ImportAssetsTask::saveDatabaseIfNeeded()
+{
+	using namespace std::chrono_literals;
+
+	// Only one worker saves at a time; the rest carry on importing rather than queueing up behind it
+	std::unique_lock<std::mutex> lock(saveMutex, std::try_to_lock);
+	if (lock.owns_lock()) {
+		auto now = std::chrono::steady_clock::now();
+		if (now - lastSave > 1s) {
+			db.save();
+			lastSave = std::chrono::steady_clock::now();
+		}
+	}
+}
+
+int ImportAssetsTask::getImportPhase(ImportAssetType type)
+{
+	switch (type) {
+	case ImportAssetType::Material:
+	case ImportAssetType::Sprite:
+	case ImportAssetType::AudioEvent:
+		return 1;
+	case ImportAssetType::Animation:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
 bool ImportAssetsTask::importAsset(ImportAssetsDatabaseEntry& asset)
 {
 	Logger::logInfo("Importing " + asset.assetId);
@@ -88,57 +171,102 @@ bool ImportAssetsTask::importAsset(ImportAssetsDatabaseEntry& asset)
 	std::vector<AssetResource> out;
 	std::vector<std::pair<Path, Bytes>> outFiles;
 	std::vector<TimestampedPath> additionalInputs;
-	try {
-		// Create queue
-		std::list<ImportingAsset> toLoad;
-
-		// Load files from disk
-		ImportingAsset importingAsset;
-		importingAsset.assetId = asset.assetId;
-		importingAsset.assetType = asset.assetType;
-		for (auto& f: asset.inputFiles) {
-			auto meta = db.getMetadata(f.first);
-			importingAsset.inputFiles.emplace_back(ImportingAssetFile(f.first, FileSystem::readFile(asset.srcDir / f.first), meta ? meta.get() : Metadata()));
-		}
-		toLoad.emplace_back(std::move(importingAsset));
-
-		// Import
-		while (!toLoad.empty()) {
-			auto cur = std::move(toLoad.front());
-			toLoad.pop_front();
-			
-			AssetCollector collector(cur, assetsPath, importer.getAssetsSrc(), [=] (float assetProgress, const String& label) -> bool
-			{
-				//setProgress(lerp(curFileProgressStart, curFileProgressEnd, assetProgress), curFileLabel + " " + label);
-				return !isCancelled();
-			});
-
-			for (auto& importer: importer.getImporters(cur.assetType)) {
-				importer.get().import(cur, collector);
-			}
-			
-			for (auto& additional: collector.collectAdditionalAssets()) {
-				toLoad.emplace_front(std::move(additional));
-			}
 
-			for (auto& outFile: collector.collectOutFiles()) {
-				outFiles.push_back(std::move(outFile));
-			}
+	// With content hashing, an identical import might already have been done (possibly on another machine)
+	auto cache = db.isContentHashing() ? project.getImportCache() : nullptr;
+	auto cached = cache ? cache->load(asset.inputHash) : Maybe<ImportCache::Entry>();
+	if (cached) {
+		Logger::logInfo("- " + asset.assetId + " found in import cache");
+		out = std::move(cached->outputs);
+		outFiles = std::move(cached->outFiles);
+		additionalInputs = std::move(cached->additionalInputs);
+	} else {
+		try {
+			// Create queue
+			std::list<ImportingAsset> toLoad;
 
-			for (auto& o: collector.getAssets()) {
-				out.push_back(o);
+			// Load files from disk
+			ImportingAsset importingAsset;
+			importingAsset.assetId = asset.assetId;
+			importingAsset.assetType = asset.assetType;
+			for (auto& f: asset.inputFiles) {
+				auto meta = db.getMetadata(f.first);
+				importingAsset.inputFiles.emplace_back(ImportingAssetFile(f.first, FileSystem::readFile(asset.srcDir / f.first), meta ? meta.get() : Metadata()));
 			}
+			toLoad.emplace_back(std::move(importingAsset));
 
-			for (auto& i: collector.getAdditionalInputs()) {
-				additionalInputs.push_back(i);
+			// Import
+			// Additional assets produced together (e.g. every variant of a material's shaders) are independent, so they're imported in parallel
+			struct Imported {
+				std::vector<ImportingAsset> additionalAssets;
+				std::vector<std::pair<Path, Bytes>> outFiles;
+				std::vector<AssetResource> assets;
+				std::vector<TimestampedPath> additionalInputs;
+				std::exception_ptr error; // Rethrown once the batch is done, as the parallel loop can't carry it
+			};
+
+			while (!toLoad.empty()) {
+				std::vector<ImportingAsset> batch(std::make_move_iterator(toLoad.begin()), std::make_move_iterator(toLoad.end()));
+				toLoad.clear();
+				std::vector<Imported> results(batch.size());
+
+				std::vector<size_t> indices(batch.size());
+				std::iota(indices.begin(), indices.end(), size_t(0));
+				Concurrent::foreach(Executors::getCPU(), indices.begin(), indices.end(), [&] (size_t i)
+				{
+					auto& cur = batch[i];
+					auto& result = results[i];
+					try {
+						AssetCollector collector(cur, assetsPath, importer.getAssetsSrc(), [=] (float assetProgress, const String& label) -> bool
+					{
+							//setProgress(lerp(curFileProgressStart, curFileProgressEnd, assetProgress), curFileLabel + " " + label);
+							return !isCancelled();
+						});
+
+						for (auto& importer: importer.getImporters(cur.assetType)) {
+							importer.get().import(cur, collector);
+						}
+
+						result.additionalAssets = collector.collectAdditionalAssets();
+						result.outFiles = collector.collectOutFiles();
+						result.assets = collector.getAssets();
+						result.additionalInputs = collector.getAdditionalInputs();
+					} catch (...) {
+						result.error = std::current_exception();
+					}
+				}, 1);
+
+				for (auto& result: results) {
+					if (result.error) {
+						std::rethrow_exception(result.error);
+					}
+				}
+
+				for (auto& result: results) {
+					for (auto& additional: result.additionalAssets) {
+						toLoad.emplace_back(std::move(additional));
+					}
+
+					for (auto& outFile: result.outFiles) {
+						outFiles.push_back(std::move(outFile));
+					}
+
+					for (auto& o: result.assets) {
+						out.push_back(o);
+					}
+
+					for (auto& i: result.additionalInputs) {
+						additionalInputs.push_back(i);
+					}
+				}
 			}
-		}
-	} catch (std::exception& e) {
-		addError("\"" + asset.assetId + "\" - " + e.what());
-		asset.additionalInputFiles = std::move(additionalInputs);
-		db.markFailed(asset);
+		} catch (std::exception& e) {
+			addError("\"" + asset.assetId + "\" - " + e.what());
+			asset.additionalInputFiles = std::move(additionalInputs);
+			db.markFailed(asset);
 
-		return false;
+			return false;
+		}
 	}
 
 	// Check if it didn't get cancelled
@@ -171,6 +299,17 @@ bool ImportAssetsTask::importAsset(ImportAssetsDatabaseEntry& asset)
 	}
 
 	// Store output in db
+	if (db.isContentHashing()) {
+		asset.additionalInputHash = cached ? cached->additionalInputHash : ImportAssetsDatabase::hashFileContents(additionalInputs);
+		if (cache && !cached) {
+			ImportCache::Entry entry;
+			entry.additionalInputs = additionalInputs;
+			entry.additionalInputHash = asset.additionalInputHash;
+			entry.outputs = out;
+			entry.outFiles = outFiles;
+			cache->store(asset.inputHash, entry);
+		}
+	}
 	asset.additionalInputFiles = std::move(additionalInputs);
 	asset.outputFiles = std::move(out);
 	db.markAsImported(asset);
@@ -0,0 +1,108 @@
+#include "halley/tools/assets/import_cache.h"
+#include "halley/tools/assets/import_assets_database.h"
+#include "halley/tools/file/filesystem.h"
+#include "halley/bytes/byte_serializer.h"
+#include "halley/support/logger.h"
+#include "halley/text/string_converter.h"
+#include <chrono>
+#include <thread>
+
+using namespace Halley;
+
+constexpr static int currentCacheVersion = 2;
+
+ImportCache::ImportCache(Path directory, std::vector<Path> assetsSrc)
+	: directory(std::move(directory))
+	, assetsSrc(std::move(assetsSrc))
+{
+}
+
+Maybe<ImportCache::Entry> ImportCache::load(uint64_t key) const
+{
+	const auto path = getPath(key);
+	if (key == 0 || !FileSystem::exists(path)) {
+		return {};
+	}
+
+	try {
+		auto data = FileSystem::readFile(path);
+		Deserializer s(data);
+
+		int version;
+		s >> version;
+		if (version != currentCacheVersion) {
+			return {};
+		}
+
+		// Additional inputs are stored relative to whichever source root they came from, as absolute paths differ between machines
+		std::vector<std::pair<int, String>> additional;
+		Entry entry;
+		s >> additional;
+		s >> entry.additionalInputHash;
+		s >> entry.outputs;
+		s >> entry.outFiles;
+
+		for (auto& a: additional) {
+			if (a.first < 0 || a.first >= int(assetsSrc.size())) {
+				return {};
+			}
+			const auto file = assetsSrc[a.first] / a.second;
+			entry.additionalInputs.emplace_back(file, FileSystem::getLastWriteTime(file));
+		}
+
+		if (ImportAssetsDatabase::hashFileContents(entry.additionalInputs) != entry.additionalInputHash) {
+			return {};
+		}
+		return entry;
+	} catch (std::exception& e) {
+		Logger::logWarning("Ignoring unreadable import cache entry " + path + ": " + e.what());
+		return {};
+	}
+}
+
+void ImportCache::store(uint64_t key, const Entry& entry) const
+{
+	if (key == 0) {
+		return;
+	}
+
+	std::vector<std::pair<int, String>> additional;
+	for (auto& a: entry.additionalInputs) {
+		bool found = false;
+		for (int i = 0; i < int(assetsSrc.size()) && !found; ++i) {
+			const auto relative = FileSystem::getRelative(a.first, assetsSrc[i]);
+			if (!relative.getString().isEmpty() && !relative.getString().startsWith("..")) {
+				additional.emplace_back(i, relative.getString());
+				found = true;
+			}
+		}
+		if (!found) {
+			// Depends on something outside the source roots, which other machines can't be expected to have
+			return;
+		}
+	}
+
+	auto data = Serializer::toBytes([&] (Serializer& s)
+	{
+		s << currentCacheVersion;
+		s << additional;
+		s << entry.additionalInputHash;
+		s << entry.outputs;
+		s << entry.outFiles;
+	});
+
+	// Written under a unique name and then renamed, so other machines sharing the cache never see a partial file
+	const auto path = getPath(key);
+	const auto unique = std::hash<std::thread::id>()(std::this_thread::get_id()) ^ size_t(std::chrono::steady_clock::now().time_since_epoch().count());
+	const auto tmpPath = path.replaceExtension(".tmp" + toString(uint64_t(unique), 16));
+	FileSystem::writeFile(tmpPath, data);
+	if (!FileSystem::rename(tmpPath, path)) {
+		FileSystem::remove(tmpPath);
+	}
+}
+
+Path ImportCache::getPath(uint64_t key) const
+{
+	const auto name = toString(key, 16);
+	return directory / name.left(2) / (name + ".cache");
+}
@@ -28,6 +28,12 @@ int ImportTool::run(Vector<std::string> args)
 			const Path manifestPath = FileSystem::getAbsolute(Path(args[2]));
 			proj->setAssetPackManifest(manifestPath);
 		}
+		if (contentHash) {
+			proj->setContentHashing(true);
+		}
+		if (!importCache.isEmpty()) {
+			proj->setImportCache(FileSystem::getAbsolute(Path(importCache)));
+		}
 		Logger::logInfo("Importing project at \"" + projectPath + "\", with Halley root at \"" + halleyRootPath + "\" and manifest at \"" + proj->getAssetPackManifestPath() + "\"");
 
 		auto tasks = std::make_unique<EditorTaskSet>();
@@ -53,7 +59,7 @@ int ImportTool::run(Vector<std::string> args)
 			return 0;
 		}
 	} else {
-		Logger::logError("Usage: halley-cmd import projDir halleyDir");
+		Logger::logError("Usage: halley-cmd import projDir halleyDir [manifest] [--platforms=pc,...] [--content-hash] [--import-cache=dir]");
 		return 1;
 	}
 }
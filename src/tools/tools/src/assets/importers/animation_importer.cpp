@@ -12,6 +12,13 @@ void AnimationImporter::import(const ImportingAsset& asset, IAssetCollector& col
 	Animation animation;
 	parseAnimation(animation, gsl::as_bytes(gsl::span<const Byte>(asset.inputFiles.at(0).data)));
 	collector.output(animation.getName(), AssetType::Animation, Serializer::toBytes(animation));
+	addDependencies(animation, collector);
+}
+
+void AnimationImporter::addDependencies(const Animation& animation, IAssetCollector& collector)
+{
+	collector.addDependency(animation.getName(), AssetType::Animation, animation.getSpriteSheetName(), AssetType::SpriteSheet);
+	collector.addDependency(animation.getName(), AssetType::Animation, animation.getMaterialName(), AssetType::MaterialDefinition);
 }
 
 void AnimationImporter::parseAnimation(Animation& animation, gsl::span<const gsl::byte> data)
@@ -10,9 +10,11 @@ namespace Halley
 	{
 	public:
 		ImportAssetType getType() const override { return ImportAssetType::Animation; }
+		int getVersion() const override { return 1; }
 
 		void import(const ImportingAsset& asset, IAssetCollector& collector) override;
 
 		static void parseAnimation(Animation& animation, gsl::span<const gsl::byte> data);
+		static void addDependencies(const Animation& animation, IAssetCollector& collector);
 	};
 }
@@ -4,6 +4,7 @@
 #include "halley/resources/metadata.h"
 #include "halley/audio/vorbis_dec.h"
 #include "halley/audio/resampler.h"
+#include "halley/audio/adpcm.h"
 
 #include "ogg/ogg.h"
 #include "vorbis/codec.h"
@@ -21,6 +22,7 @@ void AudioImporter::import(const ImportingAsset& asset, IAssetCollector& collect
 	Path mainFile = asset.inputFiles.at(0).name;
 	auto& rawData = asset.inputFiles[0].data;
 	auto resData = std::make_shared<ResourceDataStatic>(rawData.data(), rawData.size(), mainFile.string(), false);
+	Metadata meta = asset.inputFiles.at(0).metadata;
 	Bytes encodedData;
 	const Bytes* fileData = &rawData;
 
@@ -30,6 +32,13 @@ void AudioImporter::import(const ImportingAsset& asset, IAssetCollector& collect
 	bool needsEncoding = false;
 	bool needsResampling = false;
 
+	// "adpcm" and "vorbis" keep the clip compressed in memory at runtime; ADPCM has to be encoded here, from the full decoded clip
+	const bool toADPCM = meta.getString("compression", "none") == "adpcm";
+	if (toADPCM && meta.getBool("streaming", false)) {
+		Logger::logWarning(asset.assetId + " can't be both streaming and ADPCM compressed; disabling streaming.");
+		meta.set("streaming", false);
+	}
+
 	if (mainFile.getExtension() == ".ogg") { // assuming Ogg Vorbis
 		// Load vorbis data
 		VorbisData vorbis(resData);
@@ -42,9 +51,9 @@ void AudioImporter::import(const ImportingAsset& asset, IAssetCollector& collect
 		}
 
 		// Decode
-		if (sampleRate != 48000) {
+		if (sampleRate != 48000 || toADPCM) {
 			vorbis.read(samples);
-			needsResampling = true;
+			needsResampling = sampleRate != 48000;
 		}
 	} else {
 		throw Exception("Unsupported audio format: " + mainFile.getExtension(), HalleyExceptions::Tools);
@@ -61,15 +70,18 @@ void AudioImporter::import(const ImportingAsset& asset, IAssetCollector& collect
 		needsEncoding = true;
 	}
 
-	// Encode to vorbis
-	if (needsEncoding) {
+	// Encode
+	if (toADPCM) {
+		encodedData = ADPCMData::encode(samples);
+		fileData = &encodedData;
+		samples.clear();
+	} else if (needsEncoding) {
 		encodedData = encodeVorbis(numChannels, sampleRate, samples);
 		fileData = &encodedData;
 		samples.clear();
 	}
 
 	// Write metadata
-	Metadata meta = asset.inputFiles.at(0).metadata;
 	meta.set("channels", numChannels);
 	meta.set("sampleRate", sampleRate);
 
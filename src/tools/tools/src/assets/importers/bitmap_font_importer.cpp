@@ -5,6 +5,7 @@
 #include "halley/tools/file/filesystem.h"
 #include "halley/bytes/byte_serializer.h"
 #include "halley/file_formats/image.h"
+#include "font_importer.h"
 
 using namespace Halley;
 
@@ -39,6 +40,7 @@ void BitmapFontImporter::import(const ImportingAsset& asset, IAssetCollector& co
 	// Generate font from XML
 	Font font = parseBitmapFontXML(imageSize, xmlData);
 	collector.output(font.getName(), AssetType::Font, Serializer::toBytes(font));
+	FontImporter::addDependencies(font, collector);
 
 	// Pass image forward
 	ImportingAsset image;
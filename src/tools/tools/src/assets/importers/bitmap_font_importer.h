@@ -9,6 +9,7 @@ namespace Halley
 	{
 	public:
 		ImportAssetType getType() const override { return ImportAssetType::BitmapFont; }
+		int getVersion() const override { return 2; }
 
 		String getAssetId(const Path& file, const Maybe<Metadata>& metadata) const override;
 
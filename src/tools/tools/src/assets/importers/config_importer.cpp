@@ -2,6 +2,7 @@
 #include "halley/bytes/byte_serializer.h"
 #include "halley/file_formats/config_file.h"
 #include "../../yaml/halley-yamlcpp.h"
+#include "../../yaml/yaml_config_parser.h"
 #include "halley/tools/file/filesystem.h"
 
 using namespace Halley;
@@ -35,26 +36,27 @@ ConfigNode ConfigImporter::parseYAMLNode(const YAML::Node& node)
 		}
 		result = std::move(list);
 	} else if (node.IsScalar()) {
-		auto str = String(node.as<std::string>());
-		if (str.isNumber()) {
-			if (str.isInteger()) {
-				result = str.toInteger();
-			} else {
-				result = str.toFloat();
-			}
-		} else {
-			result = str;
-		}
+		result = YAMLConfigParser::makeScalar(node.as<std::string>());
 	}
 
 	result.setOriginalPosition(node.Mark().line, node.Mark().column);
 	return result;
 }
 
-void ConfigImporter::parseConfig(ConfigFile& config, gsl::span<const gsl::byte> data)
+ConfigNode ConfigImporter::parseConfigNode(gsl::span<const gsl::byte> data)
 {
+	// Most data files only use plain YAML (or JSON), which can be read directly; yaml-cpp gets the rest
+	ConfigNode result;
+	if (YAMLConfigParser::tryParse(data, result)) {
+		return result;
+	}
+
 	String strData(reinterpret_cast<const char*>(data.data()), data.size());
 	YAML::Node root = YAML::Load(strData.cppStr());
+	return parseYAMLNode(root);
+}
 
-	config.getRoot() = parseYAMLNode(root);
+void ConfigImporter::parseConfig(ConfigFile& config, gsl::span<const gsl::byte> data)
+{
+	config.getRoot() = parseConfigNode(data);
 }
@@ -16,6 +16,7 @@ namespace Halley
 		void import(const ImportingAsset& asset, IAssetCollector& collector) override;
 
 		static ConfigNode parseYAMLNode(const YAML::Node& node);
+		static ConfigNode parseConfigNode(gsl::span<const gsl::byte> data);
 		static void parseConfig(ConfigFile& config, gsl::span<const gsl::byte> data);
 	};
 }
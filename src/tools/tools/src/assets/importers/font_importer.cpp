@@ -57,7 +57,17 @@ void FontImporter::import(const ImportingAsset& asset, IAssetCollector& collecto
 
 	auto fontName = result.font->getName();
 
+	// Ship the font file itself, so glyphs that weren't baked can be rasterised at runtime
+	if (meta.getBool("dynamicGlyphs", false)) {
+		const auto sourceName = "fontData/" + fontName;
+		collector.output(sourceName, AssetType::BinaryFile, asset.inputFiles[0].data);
+		result.font->setDynamicGlyphSource(sourceName);
+		collector.addDependency(fontName, AssetType::Font, sourceName, AssetType::BinaryFile);
+		collector.addDependency(fontName, AssetType::Font, "Halley/Sprite", AssetType::MaterialDefinition);
+	}
+
 	collector.output(fontName, AssetType::Font, Serializer::toBytes(*result.font));
+	FontImporter::addDependencies(*result.font, collector);
 
 	if (meta.hasKey("filtering")) {
 		result.imageMeta->set("filtering", meta.getBool("filtering"));
@@ -69,3 +79,13 @@ void FontImporter::import(const ImportingAsset& asset, IAssetCollector& collecto
 	image.inputFiles.emplace_back(ImportingAssetFile(fontName, Serializer::toBytes(*result.image), *result.imageMeta));
 	collector.addAdditionalAsset(std::move(image));
 }
+
+void FontImporter::addDependencies(const Font& font, IAssetCollector& collector)
+{
+	const auto name = font.getName();
+	collector.addDependency(name, AssetType::Font, font.getImageName(), AssetType::Texture);
+	collector.addDependency(name, AssetType::Font, font.isDistanceField() ? "Halley/Text" : "Halley/Sprite", AssetType::MaterialDefinition);
+	for (auto& fallback: font.getFallback()) {
+		collector.addDependency(name, AssetType::Font, fallback, AssetType::Font);
+	}
+}
@@ -3,11 +3,16 @@
 
 namespace Halley
 {
+	class Font;
+
 	class FontImporter : public IAssetImporter
 	{
 	public:
 		ImportAssetType getType() const override { return ImportAssetType::Font; }
+		int getVersion() const override { return 2; }
 
 		void import(const ImportingAsset& asset, IAssetCollector& collector) override;
+
+		static void addDependencies(const Font& font, IAssetCollector& collector);
 	};
 }
@@ -18,9 +18,19 @@ void ImageImporter::import(const ImportingAsset& asset, IAssetCollector& collect
 	// Load image
 	Path mainFile = asset.inputFiles.at(0).name;
 	auto span = gsl::as_bytes(gsl::span<const Byte>(input.data));
+	const auto format = fromString<Image::Format>(meta.getString("format", "undefined"));
+	const auto swizzle = meta.getString("swizzle", "rgba"); // e.g. "bgra" for images saved with red and blue swapped
 	std::unique_ptr<Image> image;
 	if (meta.getString("compression", "png") == "png") {
-		image = std::make_unique<Image>(span, fromString<Image::Format>(meta.getString("format", "undefined")));
+		// Swizzled before premultiplying, as that needs to know which channel is alpha
+		const bool swizzling = swizzle != "rgba";
+		image = std::make_unique<Image>(span, swizzling && format == Image::Format::Undefined ? Image::Format::RGBA : format);
+		if (swizzling) {
+			swizzleImage(*image, swizzle);
+			if (format == Image::Format::Undefined) {
+				image->preMultiply();
+			}
+		}
 	} else {
 		image = std::make_unique<Image>();
 		Deserializer s(span);
@@ -49,6 +59,26 @@ void ImageImporter::import(const ImportingAsset& asset, IAssetCollector& collect
 	collector.addAdditionalAsset(std::move(imageAsset));
 }
 
+void ImageImporter::swizzleImage(Image& image, const String& order)
+{
+	if (order.size() != 4) {
+		throw Exception("Invalid swizzle \"" + order + "\", expected four of r, g, b and a", HalleyExceptions::Tools);
+	}
+	int channels[4];
+	for (size_t i = 0; i < 4; ++i) {
+		const auto pos = String("rgba").find(order[i]);
+		if (pos == String::npos) {
+			throw Exception("Invalid swizzle \"" + order + "\", expected four of r, g, b and a", HalleyExceptions::Tools);
+		}
+		channels[i] = int(pos);
+	}
+
+	if (image.getBytesPerPixel() != 4) {
+		throw Exception("Swizzling requires an RGBA image", HalleyExceptions::Tools);
+	}
+	image.swizzle(channels[0], channels[1], channels[2], channels[3]);
+}
+
 std::unique_ptr<Image> ImageImporter::convertToIndexed(const Image& image, const Image& palette)
 {
 	auto lookup = makePaletteConversion(palette);
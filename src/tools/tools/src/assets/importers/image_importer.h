@@ -12,6 +12,7 @@ namespace Halley
 		void import(const ImportingAsset& asset, IAssetCollector& collector) override;
 
 	private:
+		static void swizzleImage(Image& image, const String& order);
 		static std::unique_ptr<Image> convertToIndexed(const Image& image, const Image& palette);
 		static std::unordered_map<uint32_t, uint32_t> makePaletteConversion(const Image& palette);
 	};
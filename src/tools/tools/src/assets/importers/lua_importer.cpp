@@ -0,0 +1,44 @@
+#include "lua_importer.h"
+#include "halley/support/exception.h"
+#include "halley/tools/file/filesystem.h"
+#include <lua.hpp>
+#include <memory>
+
+using namespace Halley;
+
+void LuaImporter::import(const ImportingAsset& asset, IAssetCollector& collector)
+{
+	auto& input = asset.inputFiles.at(0);
+	auto& meta = input.metadata;
+
+	// Bytecode only loads on the same VM with the same word sizes, so platforms that differ from the importer need source
+	if (!meta.getBool("precompile", true)) {
+		collector.output(asset.assetId, AssetType::BinaryFile, input.data, meta);
+		return;
+	}
+
+	// Same chunk name LuaState would give it, for the error messages of scripts that keep their debug info
+	const String chunkName = Path(asset.assetId).dropFront(1).replaceExtension("").string();
+
+	std::unique_ptr<lua_State, void(*)(lua_State*)> lua(luaL_newstate(), &lua_close);
+	luaL_openlibs(lua.get());
+	auto L = lua.get();
+
+	if (luaL_loadbuffer(L, reinterpret_cast<const char*>(input.data.data()), input.data.size(), chunkName.c_str()) != 0) {
+		throw Exception("Error compiling " + asset.assetId + ":\n\t" + String(lua_tostring(L, -1)), HalleyExceptions::Tools);
+	}
+
+	// string.dump rather than lua_dump, as only it can strip debug info on LuaJIT as well
+	lua_getglobal(L, "string");
+	lua_getfield(L, -1, "dump");
+	lua_remove(L, -2);
+	lua_pushvalue(L, -2);
+	lua_pushboolean(L, meta.getBool("stripDebugInfo", true) ? 1 : 0);
+	if (lua_pcall(L, 2, 1, 0) != 0) {
+		throw Exception("Error precompiling " + asset.assetId + ":\n\t" + String(lua_tostring(L, -1)), HalleyExceptions::Tools);
+	}
+
+	size_t size = 0;
+	const auto data = reinterpret_cast<const Byte*>(lua_tolstring(L, -1, &size));
+	collector.output(asset.assetId, AssetType::BinaryFile, Bytes(data, data + size), meta);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include "halley/plugin/iasset_importer.h"
+
+namespace Halley
+{
+	class LuaImporter : public IAssetImporter
+	{
+	public:
+		ImportAssetType getType() const override { return ImportAssetType::LuaScript; }
+
+		void import(const ImportingAsset& asset, IAssetCollector& collector) override;
+		int dropFrontCount() const override { return 0; }
+		int getVersion() const override { return 1; }
+	};
+}
@@ -1,7 +1,6 @@
 #include "material_importer.h"
 #include "halley/bytes/byte_serializer.h"
 #include "halley/core/graphics/material/material_definition.h"
-#include "../../yaml/halley-yamlcpp.h"
 #include "halley/tools/file/filesystem.h"
 #include "halley/text/string_converter.h"
 #include "config_importer.h"
@@ -11,22 +10,30 @@ using namespace Halley;
 void MaterialImporter::import(const ImportingAsset& asset, IAssetCollector& collector)
 {
 	Path basePath = asset.inputFiles.at(0).name.parentPath();
-	auto material = parseMaterial(basePath, gsl::as_bytes(gsl::span<const Byte>(asset.inputFiles.at(0).data)), collector);
+	std::vector<PassShader> shaders;
+	auto material = parseMaterial(basePath, gsl::as_bytes(gsl::span<const Byte>(asset.inputFiles.at(0).data)), collector, shaders);
 	collector.output(material.getName(), AssetType::MaterialDefinition, Serializer::toBytes(material));
+
+	// Variants are only known once the whole material is (including passes inherited from base, which use its keywords)
+	for (auto& shader: shaders) {
+		for (auto variant: material.getVariants()) {
+			auto shaderAsset = makeVariant(shader, material, variant);
+			collector.addDependency(material.getName(), AssetType::MaterialDefinition, shaderAsset.assetId, AssetType::Shader);
+			collector.addAdditionalAsset(std::move(shaderAsset));
+		}
+	}
 }
 
-MaterialDefinition MaterialImporter::parseMaterial(Path basePath, gsl::span<const gsl::byte> data, IAssetCollector& collector) const
+MaterialDefinition MaterialImporter::parseMaterial(Path basePath, gsl::span<const gsl::byte> data, IAssetCollector& collector, std::vector<PassShader>& shaders) const
 {
-	String strData(reinterpret_cast<const char*>(data.data()), data.size());
-	YAML::Node yamlRoot = YAML::Load(strData.cppStr());
-	auto root = ConfigImporter::parseYAMLNode(yamlRoot);
+	auto root = ConfigImporter::parseConfigNode(data);
 
 	// Load base material
 	MaterialDefinition material;
 	if (root.hasKey("base")) {
 		String baseName = root["base"].asString();
 		auto otherData = collector.readAdditionalFile(basePath / baseName);
-		material = parseMaterial(basePath, gsl::as_bytes(gsl::span<Byte>(otherData)), collector);
+		material = parseMaterial(basePath, gsl::as_bytes(gsl::span<Byte>(otherData)), collector, shaders);
 	}
 	material.load(root);
 
@@ -34,39 +41,62 @@ MaterialDefinition MaterialImporter::parseMaterial(Path basePath, gsl::span<cons
 	int passN = 0;
 	if (root.hasKey("passes")) {
 		for (auto& passNode: root["passes"].asSequence()) {
-			loadPass(material, passNode, collector, passN++);
+			loadPass(material, passNode, collector, passN++, shaders);
 		}
 	}
 
 	return material;
 }
 
-void MaterialImporter::loadPass(MaterialDefinition& material, const ConfigNode& node, IAssetCollector& collector, int passN)
+void MaterialImporter::loadPass(MaterialDefinition& material, const ConfigNode& node, IAssetCollector& collector, int passN, std::vector<PassShader>& shaders)
 {
 	String passName = material.getName() + "_pass_" + toString(passN);
 
 	auto shaderTypes = { "vertex", "geometry", "pixel" };
 
 	for (auto& shaderEntry: node["shader"]) {
-		String language = shaderEntry["language"].asString();
-		String shaderName = passName;
-		ImportingAsset shaderAsset;
-		shaderAsset.assetId = shaderName + ":" + language;
-		shaderAsset.assetType = ImportAssetType::Shader;
+		PassShader shader;
+		shader.passName = passName;
+		shader.language = shaderEntry["language"].asString();
 		for (auto& curType: shaderTypes) {
 			if (shaderEntry.hasKey(curType)) {
 				auto data = loadShader(shaderEntry[curType].asString(), collector);
 				Metadata meta;
-				meta.set("language", language);
-				shaderAsset.inputFiles.emplace_back(ImportingAssetFile(shaderName + "." + curType, std::move(data), meta));
+				meta.set("language", shader.language);
+				shader.inputFiles.emplace_back(ImportingAssetFile(passName + "." + curType, std::move(data), meta));
 			}
 		}
-		collector.addAdditionalAsset(std::move(shaderAsset));
+		shaders.push_back(std::move(shader)); // One per language, only the one matching the video API gets loaded
 	}
 
 	material.addPass(MaterialPass(passName, node));
 }
 
+ImportingAsset MaterialImporter::makeVariant(const PassShader& shader, const MaterialDefinition& material, uint32_t variant)
+{
+	ImportingAsset shaderAsset;
+	shaderAsset.assetId = MaterialPass::getShaderAssetId(shader.passName, variant) + ":" + shader.language;
+	shaderAsset.assetType = ImportAssetType::Shader;
+
+	// The defines go before the source; the shader importer then puts anything that has to come first (e.g. #version) before them
+	String defines;
+	const auto& keywords = material.getKeywords();
+	for (size_t i = 0; i < keywords.size(); ++i) {
+		if (variant & (uint32_t(1) << i)) {
+			defines += "#define " + keywords[i] + " 1\n";
+		}
+	}
+
+	for (auto& input: shader.inputFiles) {
+		Bytes data(defines.size() + input.data.size());
+		memcpy(data.data(), defines.c_str(), defines.size());
+		memcpy(data.data() + defines.size(), input.data.data(), input.data.size());
+		shaderAsset.inputFiles.emplace_back(ImportingAssetFile(input.name, std::move(data), input.metadata));
+	}
+
+	return shaderAsset;
+}
+
 Bytes MaterialImporter::loadShader(const String& name, IAssetCollector& collector)
 {
 	std::set<String> loaded;
@@ -11,14 +11,23 @@ namespace Halley
 	class MaterialImporter : public IAssetImporter
 	{
 	public:
+		// A pass's shader sources in one language, before the material's keywords are defined in them for each variant
+		struct PassShader {
+			String passName;
+			String language;
+			std::vector<ImportingAssetFile> inputFiles;
+		};
+
 		ImportAssetType getType() const override { return ImportAssetType::Material; }
+		int getVersion() const override { return 3; }
 
 		void import(const ImportingAsset& asset, IAssetCollector& collector) override;
 
-		MaterialDefinition parseMaterial(Path basePath, gsl::span<const gsl::byte> data, IAssetCollector& collector) const;
+		MaterialDefinition parseMaterial(Path basePath, gsl::span<const gsl::byte> data, IAssetCollector& collector, std::vector<PassShader>& shaders) const;
 
 	private:
-		static void loadPass(MaterialDefinition& material, const ConfigNode& node, IAssetCollector& collector, int passN);
+		static void loadPass(MaterialDefinition& material, const ConfigNode& node, IAssetCollector& collector, int passN, std::vector<PassShader>& shaders);
+		static ImportingAsset makeVariant(const PassShader& shader, const MaterialDefinition& material, uint32_t variant);
 		static void loadUniforms(MaterialDefinition& material, const YAML::Node& topNode);
 		static void loadTextures(MaterialDefinition& material, const YAML::Node& topNode);
 		static void loadAttributes(MaterialDefinition& material, const YAML::Node& topNode);
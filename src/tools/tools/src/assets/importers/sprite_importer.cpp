@@ -10,6 +10,10 @@
 #include "halley/text/string_converter.h"
 #include "../../sprites/aseprite_reader.h"
 #include "halley/support/logger.h"
+#include "animation_importer.h"
+#include "halley/concurrency/concurrent.h"
+#include "halley/utils/hash.h"
+#include <numeric>
 
 using namespace Halley;
 
@@ -104,13 +108,15 @@ void SpriteImporter::import(const ImportingAsset& asset, IAssetCollector& collec
 		// Write animation
 		Animation animation = generateAnimation(spriteName, spriteSheetName, meta.getString("material", "Halley/Sprite"), frames);
 		collector.output(spriteName, AssetType::Animation, Serializer::toBytes(animation));
+		AnimationImporter::addDependencies(animation, collector);
 
 		std::move(frames.begin(), frames.end(), std::back_inserter(totalFrames));
 	}
 
 	// Generate atlas + spritesheet
 	SpriteSheet spriteSheet;
-	auto atlasImage = generateAtlas(atlasName, totalFrames, spriteSheet);
+	const int padding = startMeta ? std::max(0, startMeta->getInt("padding", 0)) : 0;
+	auto atlasImage = generateAtlas(atlasName, totalFrames, spriteSheet, padding);
 	spriteSheet.setTextureName(atlasName);
 
 	// Image metafile
@@ -135,6 +141,7 @@ void SpriteImporter::import(const ImportingAsset& asset, IAssetCollector& collec
 
 	// Write spritesheet
 	collector.output(spriteSheetName, AssetType::SpriteSheet, Serializer::toBytes(spriteSheet));
+	collector.addDependency(spriteSheetName, AssetType::SpriteSheet, atlasName, AssetType::Texture);
 }
 
 String SpriteImporter::getAssetId(const Path& file, const Maybe<Metadata>& metadata) const
@@ -178,7 +185,7 @@ Animation SpriteImporter::generateAnimation(const String& spriteName, const Stri
 	return animation;
 }
 
-std::unique_ptr<Image> SpriteImporter::generateAtlas(const String& atlasName, std::vector<ImageData>& images, SpriteSheet& spriteSheet)
+std::unique_ptr<Image> SpriteImporter::generateAtlas(const String& atlasName, std::vector<ImageData>& images, SpriteSheet& spriteSheet, int padding)
 {
 	if (images.size() > 1) {
 		Logger::logInfo("Generating atlas \"" + atlasName + "\" with " + toString(images.size()) + " sprites...");
@@ -189,58 +196,115 @@ std::unique_ptr<Image> SpriteImporter::generateAtlas(const String& atlasName, st
 	std::vector<BinPackEntry> entries;
 	entries.reserve(images.size());
 	for (auto& img: images) {
-		auto size = img.clip.getSize();
+		auto size = img.clip.getSize() + Vector2i(2 * padding, 2 * padding);
 		totalImageArea += size.x * size.y;
 		entries.emplace_back(size, &img);
 	}
 
+	// Check if this exact set of sizes has been packed before
+	Hash::Hasher hasher;
+	for (auto& e: entries) {
+		hasher.feed(e.size);
+	}
+	const uint64_t layoutKey = hasher.digest();
+	Maybe<AtlasLayout> layout;
+	{
+		std::unique_lock<std::mutex> lock(layoutCacheMutex);
+		auto iter = layoutCache.find(layoutKey);
+		if (iter != layoutCache.end()) {
+			layout = iter->second;
+		}
+	}
+
+	if (!layout) {
+		layout = packAtlas(entries, images, totalImageArea);
+		std::unique_lock<std::mutex> lock(layoutCacheMutex);
+		if (layoutCache.size() >= 256) {
+			layoutCache.clear();
+		}
+		layoutCache[layoutKey] = layout.get();
+	}
+
+	const auto size = layout->size;
+	if (images.size() > 1) {
+		Logger::logInfo("Atlas \"" + atlasName + "\" generated at " + toString(size.x) + "x" + toString(size.y) + " px with " + toString(images.size()) + " sprites. Total image area is " + toString(totalImageArea) + " px^2, sqrt = " + toString(lround(sqrt(totalImageArea))) + " px.");
+	}
+
+	std::vector<BinPackResult> results;
+	results.reserve(images.size());
+	for (size_t i = 0; i < images.size(); ++i) {
+		results.emplace_back(layout->placements[i].first, layout->placements[i].second, &images[i]);
+	}
+	return makeAtlas(results, size, spriteSheet, padding);
+}
+
+SpriteImporter::AtlasLayout SpriteImporter::packAtlas(const std::vector<BinPackEntry>& entries, const std::vector<ImageData>& images, int64_t totalImageArea)
+{
 	// Figure out a reasonable pack size to start with
 	const int minSize = nextPowerOf2(int(sqrt(double(totalImageArea)))) / 2;
 	const int64_t guessArea = int64_t(minSize) * int64_t(minSize);
 	const int maxSize = 4096;
 	int curSize = std::min(maxSize, std::max(32, int(minSize)));
 
-	// Try packing
+	// Try 64x64, then 128x64, 128x128, 256x128, etc
+	std::vector<Vector2i> candidates;
 	bool wide = guessArea > 2 * totalImageArea;
 	while (true) {
 		Vector2i size(curSize * (wide ? 2 : 1), curSize);
 		if (size.x > maxSize || size.y > maxSize) {
-			// Give up!
-			throw Exception("Unable to pack " + toString(images.size()) + " sprites in a reasonably sized atlas! curSize at " + toString(curSize) + ", maxSize is " + toString(maxSize) + ". Total image area is " + toString(totalImageArea) + " px^2, sqrt = " + toString(lround(sqrt(totalImageArea))) + " px.", HalleyExceptions::Tools);
+			break;
 		}
-
-		Logger::logInfo("Trying " + toString(size.x) + "x" + toString(size.y) + " px...");
-		auto res = BinPack::pack(entries, size);
-		if (res.is_initialized()) {
-			// Found a pack
-			if (images.size() > 1) {
-				Logger::logInfo("Atlas \"" + atlasName + "\" generated at " + toString(size.x) + "x" + toString(size.y) + " px with " + toString(images.size()) + " sprites. Total image area is " + toString(totalImageArea) + " px^2, sqrt = " + toString(lround(sqrt(totalImageArea))) + " px.");
-			}
-
-			
-			return makeAtlas(res.get(), size, spriteSheet);
+		candidates.push_back(size);
+		if (wide) {
+			wide = false;
+			curSize *= 2;
 		} else {
-			// Try 64x64, then 128x64, 128x128, 256x128, etc
-			if (wide) {
-				wide = false;
-				curSize *= 2;
-			} else {
-				wide = true;
+			wide = true;
+		}
+	}
+
+	// Try as many sizes at once as there are threads, and take the smallest one that fits
+	const size_t waveSize = std::max(size_t(1), Executors::getCPU().threadCount());
+	for (size_t waveStart = 0; waveStart < candidates.size(); waveStart += waveSize) {
+		const size_t waveEnd = std::min(candidates.size(), waveStart + waveSize);
+		std::vector<boost::optional<Vector<BinPackResult>>> attempts(waveEnd - waveStart);
+		std::vector<size_t> indices(attempts.size());
+		std::iota(indices.begin(), indices.end(), size_t(0));
+		Concurrent::foreach(Executors::getCPU(), indices.begin(), indices.end(), [&] (size_t i)
+		{
+			attempts[i] = BinPack::maxRectsPack(entries, candidates[waveStart + i]);
+		}, 1);
+
+		for (size_t i = 0; i < attempts.size(); ++i) {
+			if (attempts[i]) {
+				AtlasLayout layout;
+				layout.placements.resize(images.size());
+				for (auto& r: attempts[i].get()) {
+					const size_t idx = reinterpret_cast<const ImageData*>(r.data) - images.data();
+					layout.placements.at(idx) = std::make_pair(r.rect, r.rotated);
+				}
+				layout.size = shrinkAtlas(attempts[i].get());
+				return layout;
 			}
 		}
 	}
+
+	// Give up!
+	throw Exception("Unable to pack " + toString(images.size()) + " sprites in a reasonably sized atlas! maxSize is " + toString(maxSize) + ". Total image area is " + toString(totalImageArea) + " px^2, sqrt = " + toString(lround(sqrt(totalImageArea))) + " px.", HalleyExceptions::Tools);
 }
 
-std::unique_ptr<Image> SpriteImporter::makeAtlas(const std::vector<BinPackResult>& result, Vector2i origSize, SpriteSheet& spriteSheet)
+std::unique_ptr<Image> SpriteImporter::makeAtlas(const std::vector<BinPackResult>& result, Vector2i size, SpriteSheet& spriteSheet, int padding)
 {
-	Vector2i size = shrinkAtlas(result);
-
 	auto image = std::make_unique<Image>(Image::Format::RGBA, size);
 	image->clear(0);
 
 	for (auto& packedImg: result) {
 		ImageData* img = reinterpret_cast<ImageData*>(packedImg.data);
-		image->blitFrom(packedImg.rect.getTopLeft(), *img->img, img->clip, packedImg.rotated);
+		// Each sprite is packed with padding on all sides, which is filled with its edges so filtering doesn't bleed in its neighbours
+		const auto paddingSize = Vector2i(padding, padding);
+		const auto rect = Rect4i(packedImg.rect.getTopLeft() + paddingSize, packedImg.rect.getBottomRight() - paddingSize);
+		image->blitFrom(rect.getTopLeft(), *img->img, img->clip, packedImg.rotated);
+		image->bleedEdges(rect, padding);
 
 		const auto borderTL = img->clip.getTopLeft();
 		const auto borderBR = img->img->getSize() - img->clip.getSize() - borderTL;
@@ -252,7 +316,7 @@ std::unique_ptr<Image> SpriteImporter::makeAtlas(const std::vector<BinPackResult
 		entry.rotated = packedImg.rotated;
 		entry.pivot = Vector2f(img->pivot - img->clip.getTopLeft()) / entry.size;
 		entry.origPivot = img->pivot;
-		entry.coords = (Rect4f(Vector2f(packedImg.rect.getTopLeft()) + offset, Vector2f(packedImg.rect.getBottomRight()) + offset)) / Vector2f(size);
+		entry.coords = (Rect4f(Vector2f(rect.getTopLeft()) + offset, Vector2f(rect.getBottomRight()) + offset)) / Vector2f(size);
 		entry.trimBorder = Vector4s(short(borderTL.x), short(borderTL.y), short(borderBR.x), short(borderBR.y));
 		entry.slices = img->slices;
 
@@ -3,6 +3,7 @@
 #include "halley/file_formats/image.h"
 #include "halley/core/graphics/sprite/sprite_sheet.h"
 #include "halley/data_structures/bin_pack.h"
+#include <mutex>
 
 namespace Halley
 {
@@ -28,15 +29,27 @@ namespace Halley
 	{
 	public:
 		ImportAssetType getType() const override { return ImportAssetType::Sprite; }
+		int getVersion() const override { return 2; }
 
 		void import(const ImportingAsset& asset, IAssetCollector& collector) override;
 		String getAssetId(const Path& file, const Maybe<Metadata>& metadata) const override;
 
 	private:
+		struct AtlasLayout
+		{
+			Vector2i size;
+			std::vector<std::pair<Rect4i, bool>> placements; // Rect and rotation, by image index
+		};
+
+		// Importing the same set of sprite sizes always ends up with the same layout, so it doesn't need packing again
+		std::mutex layoutCacheMutex;
+		std::map<uint64_t, AtlasLayout> layoutCache;
+
 		Animation generateAnimation(const String& spriteName, const String& spriteSheetName, const String& materialName, const std::vector<ImageData>& frameData);
 
-		std::unique_ptr<Image> generateAtlas(const String& atlasName, std::vector<ImageData>& images, SpriteSheet& spriteSheet);
-		std::unique_ptr<Image> makeAtlas(const std::vector<BinPackResult>& result, Vector2i size, SpriteSheet& spriteSheet);
+		std::unique_ptr<Image> generateAtlas(const String& atlasName, std::vector<ImageData>& images, SpriteSheet& spriteSheet, int padding);
+		AtlasLayout packAtlas(const std::vector<BinPackEntry>& entries, const std::vector<ImageData>& images, int64_t totalImageArea);
+		std::unique_ptr<Image> makeAtlas(const std::vector<BinPackResult>& result, Vector2i size, SpriteSheet& spriteSheet, int padding);
 		Vector2i shrinkAtlas(const std::vector<BinPackResult>& results) const;
 
 		std::vector<ImageData> splitImagesInGrid(const std::vector<ImageData>& images, Vector2i grid);
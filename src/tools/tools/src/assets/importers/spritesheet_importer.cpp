@@ -10,4 +10,7 @@ void SpriteSheetImporter::import(const ImportingAsset& asset, IAssetCollector& c
 	SpriteSheet sheet;
 	sheet.loadJson(gsl::as_bytes(gsl::span<const Byte>(asset.inputFiles.at(0).data)));
 	collector.output(asset.assetId, AssetType::SpriteSheet, Serializer::toBytes(sheet));
+	if (!sheet.getTextureName().isEmpty()) {
+		collector.addDependency(asset.assetId, AssetType::SpriteSheet, sheet.getTextureName(), AssetType::Texture);
+	}
 }
@@ -7,6 +7,7 @@ namespace Halley
 	{
 	public:
 		ImportAssetType getType() const override { return ImportAssetType::SpriteSheet; }
+		int getVersion() const override { return 1; }
 
 		void import(const ImportingAsset& asset, IAssetCollector& collector) override;
 	};
@@ -0,0 +1,24 @@
+#include "string_table_importer.h"
+#include "config_importer.h"
+#include "halley/text/string_table.h"
+#include "halley/text/i18n.h"
+using namespace Halley;
+
+void StringTableImporter::import(const ImportingAsset& asset, IAssetCollector& collector)
+{
+	const auto& data = gsl::as_bytes(gsl::span<const Byte>(asset.inputFiles.at(0).data));
+	const auto root = ConfigImporter::parseConfigNode(data);
+	const auto name = Path(asset.assetId).replaceExtension("").string();
+
+	Metadata meta = asset.inputFiles.at(0).metadata;
+	meta.set("asset_keep_uncompressed", true);
+
+	for (auto& language: root.asMap()) {
+		std::map<String, String> strings;
+		for (auto& e: language.second.asMap()) {
+			strings[e.first] = e.second.asString();
+		}
+		const auto languageCode = I18NLanguage(language.first).getISOCode();
+		collector.output(name + "/" + languageCode, AssetType::StringTable, StringTable::build(languageCode, strings), meta);
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "halley/plugin/iasset_importer.h"
+
+namespace Halley
+{
+	// Takes a localisation file (with a map of strings per language, as I18N::loadLocalisationFile reads) and outputs a StringTable per
+	// language, named "<asset>/<language>". They're kept uncompressed, even in compressed packs, so they can be used in place.
+	class StringTableImporter : public IAssetImporter
+	{
+	public:
+		ImportAssetType getType() const override { return ImportAssetType::StringTable; }
+		int getVersion() const override { return 1; }
+
+		void import(const ImportingAsset& asset, IAssetCollector& collector) override;
+	};
+}
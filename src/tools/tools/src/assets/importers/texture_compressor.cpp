@@ -0,0 +1,351 @@
+#include "texture_compressor.h"
+#include "texture_mipmapper.h"
+#include "halley/file_formats/image.h"
+#include "halley/support/exception.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace Halley;
+
+namespace {
+	struct RGB {
+		int r, g, b;
+	};
+
+	uint16_t quantise565(float r, float g, float b)
+	{
+		auto q = [] (float v, int maxValue) { return uint16_t(std::min(std::max(int(std::lround(v * maxValue / 255.0f)), 0), maxValue)); };
+		return uint16_t((q(r, 31) << 11) | (q(g, 63) << 5) | q(b, 31));
+	}
+
+	RGB expand565(uint16_t c)
+	{
+		const int r = (c >> 11) & 31;
+		const int g = (c >> 5) & 63;
+		const int b = c & 31;
+		return RGB{ (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+	}
+
+	int distance(const RGB& a, const uint8_t* px)
+	{
+		const int dr = a.r - px[0];
+		const int dg = a.g - px[1];
+		const int db = a.b - px[2];
+		return dr * dr + dg * dg + db * db;
+	}
+
+	void writeU16(uint8_t* dst, uint16_t value)
+	{
+		dst[0] = uint8_t(value & 0xFF);
+		dst[1] = uint8_t(value >> 8);
+	}
+
+	void writeU32(uint8_t* dst, uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i) {
+			dst[i] = uint8_t(value >> (8 * i));
+		}
+	}
+}
+
+bool TextureCompressor::canCompress(const Image& image)
+{
+	const auto format = image.getFormat();
+	return format == Image::Format::RGBA || format == Image::Format::RGBAPremultiplied;
+}
+
+Bytes TextureCompressor::compress(const Image& image, TextureFormat format, bool mipMaps)
+{
+	if (!TextureDescriptor::isCompressed(format)) {
+		throw Exception("Not a block-compressed texture format: " + toString(format), HalleyExceptions::Tools);
+	}
+	if (!canCompress(image)) {
+		throw Exception("Only RGBA images can be block-compressed", HalleyExceptions::Tools);
+	}
+
+	const Vector2i size = image.getSize();
+	const bool premultiplied = image.getFormat() == Image::Format::RGBAPremultiplied;
+	const int levels = mipMaps ? TextureDescriptor::getNumMipLevels(size) : 1;
+	size_t totalBytes = 0;
+	for (int i = 0; i < levels; ++i) {
+		totalBytes += TextureDescriptor::getLevelByteSize(TextureDescriptor::getMipLevelSize(size, i), format);
+	}
+
+	Bytes result;
+	result.reserve(totalBytes);
+
+	auto src = reinterpret_cast<const uint8_t*>(image.getPixels());
+	Vector<uint8_t> level(src, src + size_t(size.x) * size_t(size.y) * 4);
+	for (int i = 0; i < levels; ++i) {
+		const auto levelSize = TextureDescriptor::getMipLevelSize(size, i);
+		if (i > 0) {
+			level = TextureMipmapper::downsample(level, TextureDescriptor::getMipLevelSize(size, i - 1), levelSize, premultiplied);
+		}
+		compressLevel(level.data(), levelSize, format, result);
+	}
+
+	Ensures(result.size() == totalBytes);
+	return result;
+}
+
+void TextureCompressor::compressLevel(const uint8_t* rgba, Vector2i size, TextureFormat format, Bytes& dst)
+{
+	const bool hasAlphaBlock = format == TextureFormat::BC3;
+	const size_t blockBytes = hasAlphaBlock ? 16 : 8;
+	const int blocksW = (size.x + 3) / 4;
+	const int blocksH = (size.y + 3) / 4;
+
+	size_t pos = dst.size();
+	dst.resize(pos + size_t(blocksW) * size_t(blocksH) * blockBytes);
+
+	std::array<uint8_t, 64> block;
+	for (int by = 0; by < blocksH; ++by) {
+		for (int bx = 0; bx < blocksW; ++bx) {
+			// Blocks hanging past the edge repeat the last row/column, so they don't skew the endpoints
+			for (int y = 0; y < 4; ++y) {
+				const int sy = std::min(by * 4 + y, size.y - 1);
+				for (int x = 0; x < 4; ++x) {
+					const int sx = std::min(bx * 4 + x, size.x - 1);
+					memcpy(block.data() + (y * 4 + x) * 4, rgba + (size_t(sy) * size_t(size.x) + size_t(sx)) * 4, 4);
+				}
+			}
+
+			uint8_t* out = reinterpret_cast<uint8_t*>(dst.data()) + pos;
+			if (hasAlphaBlock) {
+				encodeAlphaBlock(block.data(), out);
+				encodeColourBlock(block.data(), false, out + 8);
+			} else {
+				encodeColourBlock(block.data(), true, out);
+			}
+			pos += blockBytes;
+		}
+	}
+}
+
+void TextureCompressor::encodeColourBlock(const uint8_t* block, bool allowTransparency, uint8_t* dst)
+{
+	// BC1 can mark pixels as fully transparent, at the cost of one of the interpolated colours
+	bool transparent[16];
+	bool hasTransparent = false;
+	int nOpaque = 0;
+	float mean[3] = { 0, 0, 0 };
+	for (int i = 0; i < 16; ++i) {
+		transparent[i] = allowTransparency && block[i * 4 + 3] < 128;
+		hasTransparent |= transparent[i];
+		if (!transparent[i]) {
+			for (int c = 0; c < 3; ++c) {
+				mean[c] += block[i * 4 + c];
+			}
+			++nOpaque;
+		}
+	}
+
+	if (nOpaque == 0) {
+		writeU16(dst, 0);
+		writeU16(dst + 2, 0);
+		writeU32(dst + 4, 0xFFFFFFFFu);
+		return;
+	}
+	for (int c = 0; c < 3; ++c) {
+		mean[c] /= float(nOpaque);
+	}
+
+	// Endpoints are the extremes along the principal axis of the block's colours
+	float cov[6] = { 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < 16; ++i) {
+		if (!transparent[i]) {
+			const float r = block[i * 4] - mean[0];
+			const float g = block[i * 4 + 1] - mean[1];
+			const float b = block[i * 4 + 2] - mean[2];
+			cov[0] += r * r;
+			cov[1] += r * g;
+			cov[2] += r * b;
+			cov[3] += g * g;
+			cov[4] += g * b;
+			cov[5] += b * b;
+		}
+	}
+	float axis[3] = { 1, 1, 1 };
+	for (int iter = 0; iter < 8; ++iter) {
+		const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		const float len = std::max(std::max(std::abs(x), std::abs(y)), std::abs(z));
+		if (len < 1e-6f) {
+			break;
+		}
+		axis[0] = x / len;
+		axis[1] = y / len;
+		axis[2] = z / len;
+	}
+
+	float minT = 0;
+	float maxT = 0;
+	const float axisLen2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	for (int i = 0; i < 16; ++i) {
+		if (!transparent[i]) {
+			const float t = ((block[i * 4] - mean[0]) * axis[0] + (block[i * 4 + 1] - mean[1]) * axis[1] + (block[i * 4 + 2] - mean[2]) * axis[2]) / axisLen2;
+			minT = std::min(minT, t);
+			maxT = std::max(maxT, t);
+		}
+	}
+
+	auto encode = [&] (const float* e0, const float* e1, uint16_t& c0, uint16_t& c1, uint32_t& indices)
+	{
+		c0 = quantise565(e0[0], e0[1], e0[2]);
+		c1 = quantise565(e1[0], e1[1], e1[2]);
+
+		// The order of the endpoints selects the mode: c0 > c1 is four colours, otherwise three plus transparent
+		if (hasTransparent ? c0 > c1 : c0 < c1) {
+			std::swap(c0, c1);
+		}
+
+		indices = 0;
+		if (c0 == c1 && !hasTransparent) {
+			return;
+		}
+
+		const RGB p0 = expand565(c0);
+		const RGB p1 = expand565(c1);
+		RGB palette[4];
+		int nColours;
+		if (hasTransparent) {
+			palette[0] = p0;
+			palette[1] = p1;
+			palette[2] = RGB{ (p0.r + p1.r) / 2, (p0.g + p1.g) / 2, (p0.b + p1.b) / 2 };
+			nColours = 3;
+		} else {
+			palette[0] = p0;
+			palette[1] = p1;
+			palette[2] = RGB{ (2 * p0.r + p1.r) / 3, (2 * p0.g + p1.g) / 3, (2 * p0.b + p1.b) / 3 };
+			palette[3] = RGB{ (p0.r + 2 * p1.r) / 3, (p0.g + 2 * p1.g) / 3, (p0.b + 2 * p1.b) / 3 };
+			nColours = 4;
+		}
+
+		for (int i = 0; i < 16; ++i) {
+			uint32_t best = 3;
+			if (!transparent[i]) {
+				int bestDist = std::numeric_limits<int>::max();
+				for (int j = 0; j < nColours; ++j) {
+					const int d = distance(palette[j], block + i * 4);
+					if (d < bestDist) {
+						bestDist = d;
+						best = uint32_t(j);
+					}
+				}
+			}
+			indices |= best << (2 * i);
+		}
+	};
+
+	float e0[3];
+	float e1[3];
+	for (int c = 0; c < 3; ++c) {
+		e0[c] = mean[c] + axis[c] * maxT;
+		e1[c] = mean[c] + axis[c] * minT;
+	}
+
+	uint16_t c0;
+	uint16_t c1;
+	uint32_t indices;
+	encode(e0, e1, c0, c1, indices);
+
+	// One least squares pass over the chosen indices usually tightens the endpoints noticeably on gradients
+	if (!hasTransparent && c0 != c1) {
+		static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		float aa = 0, ab = 0, bb = 0;
+		float ax[3] = { 0, 0, 0 };
+		float bx[3] = { 0, 0, 0 };
+		for (int i = 0; i < 16; ++i) {
+			const float a = weights[(indices >> (2 * i)) & 3];
+			const float b = 1.0f - a;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < 3; ++c) {
+				ax[c] += a * block[i * 4 + c];
+				bx[c] += b * block[i * 4 + c];
+			}
+		}
+
+		const float det = aa * bb - ab * ab;
+		if (std::abs(det) > 1e-4f) {
+			float r0[3];
+			float r1[3];
+			for (int c = 0; c < 3; ++c) {
+				r0[c] = (ax[c] * bb - bx[c] * ab) / det;
+				r1[c] = (bx[c] * aa - ax[c] * ab) / det;
+			}
+
+			uint16_t rc0;
+			uint16_t rc1;
+			uint32_t rIndices;
+			encode(r0, r1, rc0, rc1, rIndices);
+
+			auto error = [&] (uint16_t ec0, uint16_t ec1, uint32_t eIndices)
+			{
+				const RGB p0 = expand565(ec0);
+				const RGB p1 = expand565(ec1);
+				const RGB palette[4] = { p0, p1, RGB{ (2 * p0.r + p1.r) / 3, (2 * p0.g + p1.g) / 3, (2 * p0.b + p1.b) / 3 }, RGB{ (p0.r + 2 * p1.r) / 3, (p0.g + 2 * p1.g) / 3, (p0.b + 2 * p1.b) / 3 } };
+				int total = 0;
+				for (int i = 0; i < 16; ++i) {
+					total += distance(ec0 == ec1 ? p0 : palette[(eIndices >> (2 * i)) & 3], block + i * 4);
+				}
+				return total;
+			};
+			if (error(rc0, rc1, rIndices) < error(c0, c1, indices)) {
+				c0 = rc0;
+				c1 = rc1;
+				indices = rIndices;
+			}
+		}
+	}
+
+	writeU16(dst, c0);
+	writeU16(dst + 2, c1);
+	writeU32(dst + 4, indices);
+}
+
+void TextureCompressor::encodeAlphaBlock(const uint8_t* block, uint8_t* dst)
+{
+	int minA = 255;
+	int maxA = 0;
+	for (int i = 0; i < 16; ++i) {
+		minA = std::min(minA, int(block[i * 4 + 3]));
+		maxA = std::max(maxA, int(block[i * 4 + 3]));
+	}
+
+	dst[0] = uint8_t(maxA);
+	dst[1] = uint8_t(minA);
+	uint64_t bits = 0;
+	if (maxA > minA) {
+		// a0 > a1 selects eight levels, interpolated between the two
+		int palette[8];
+		palette[0] = maxA;
+		palette[1] = minA;
+		for (int i = 2; i < 8; ++i) {
+			palette[i] = ((8 - i) * maxA + (i - 1) * minA) / 7;
+		}
+
+		for (int i = 0; i < 16; ++i) {
+			const int a = block[i * 4 + 3];
+			uint64_t best = 0;
+			int bestDist = 256;
+			for (int j = 0; j < 8; ++j) {
+				const int d = std::abs(palette[j] - a);
+				if (d < bestDist) {
+					bestDist = d;
+					best = uint64_t(j);
+				}
+			}
+			bits |= best << (3 * i);
+		}
+	}
+
+	for (int i = 0; i < 6; ++i) {
+		dst[2 + i] = uint8_t(bits >> (8 * i));
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "halley/core/graphics/texture_descriptor.h"
+#include "halley/utils/utils.h"
+
+namespace Halley
+{
+	class Image;
+
+	// Encodes RGBA images into the block-compressed TextureFormats (BC1/BC3, a.k.a. DXT1/DXT5)
+	class TextureCompressor
+	{
+	public:
+		static bool canCompress(const Image& image);
+
+		// Output contains every mip level if mipMaps is set, largest first, in the layout expected by the video plugins
+		static Bytes compress(const Image& image, TextureFormat format, bool mipMaps);
+
+	private:
+		static void compressLevel(const uint8_t* rgba, Vector2i size, TextureFormat format, Bytes& dst);
+		static void encodeColourBlock(const uint8_t* block, bool allowTransparency, uint8_t* dst);
+		static void encodeAlphaBlock(const uint8_t* block, uint8_t* dst);
+	};
+}
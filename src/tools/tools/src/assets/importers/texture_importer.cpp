@@ -1,7 +1,10 @@
 #include "texture_importer.h"
+#include "texture_compressor.h"
+#include "texture_mipmapper.h"
 #include "halley/tools/assets/import_assets_database.h"
 #include "halley/tools/file/filesystem.h"
 #include "halley/file_formats/image.h"
+#include "halley/support/logger.h"
 
 using namespace Halley;
 
@@ -9,13 +12,74 @@ void TextureImporter::import(const ImportingAsset& asset, IAssetCollector& colle
 {
 	// Update metadata
 	auto meta = asset.inputFiles.at(0).metadata;
-	meta.set("compression", "png");
 
 	// Get image
 	Image image;
 	Deserializer s(asset.inputFiles.at(0).data);
 	s >> image;
 
-	// Encode to PNG and save
-	collector.output(asset.assetId, AssetType::Texture, image.savePNGToBytes(), meta);
+	// Mip streaming needs the whole chain stored
+	const bool mipStreaming = meta.getBool("mipStreaming", false);
+	if (mipStreaming) {
+		meta.set("mipmap", true);
+	}
+	const bool mipMap = meta.getBool("mipmap", false);
+	const int mipLevels = mipMap ? TextureDescriptor::getNumMipLevels(image.getSize()) : 1;
+
+	// Block-compress, if requested and possible
+	const auto blockCompression = meta.getString("blockCompression", "none");
+	if (blockCompression != "none") {
+		const auto format = fromString<TextureFormat>(blockCompression);
+		if (!TextureDescriptor::isCompressed(format)) {
+			throw Exception("Unknown block compression \"" + blockCompression + "\" in " + asset.assetId, HalleyExceptions::Tools);
+		}
+
+		// The size can't change, as sprite sheets already have their UVs normalised to it
+		const auto size = image.getSize();
+		if (!TextureCompressor::canCompress(image)) {
+			Logger::logWarning(asset.assetId + " is not an RGBA image, so it can't be block-compressed.");
+		} else if (size.x % 4 != 0 || size.y % 4 != 0) {
+			Logger::logWarning(asset.assetId + " is " + toString(size.x) + "x" + toString(size.y) + ", which isn't a multiple of 4, so it can't be block-compressed.");
+		} else {
+			meta.set("compression", "raw");
+			meta.set("format", toString(format));
+			meta.set("mipLevels", mipLevels);
+			collector.output(asset.assetId, AssetType::Texture, TextureCompressor::compress(image, format, mipMap), meta);
+			return;
+		}
+	}
+
+	// Store the mip chain, rather than leaving it to the driver's filter at load time
+	if (mipMap) {
+		if (TextureMipmapper::canMipmap(image)) {
+			meta.set("compression", "raw");
+			meta.set("mipLevels", mipLevels);
+			collector.output(asset.assetId, AssetType::Texture, TextureMipmapper::makeMipChain(image), meta);
+			return;
+		} else if (mipStreaming) {
+			Logger::logWarning(asset.assetId + " is not an RGBA image, so it can't use mip streaming.");
+		}
+	}
+
+	// Raw texels skip decoding at load entirely, and are uploaded straight from the pack if it's memory-mapped
+	if (meta.getBool("rawTexture", false)) {
+		if (image.getBytesPerPixel() != 4) {
+			Logger::logWarning(asset.assetId + " is not an RGBA image, so it can't be stored raw.");
+		} else {
+			const auto rawCompression = meta.getString("rawTextureCompression", "none");
+			if (rawCompression != "none") {
+				meta.set("asset_compression", rawCompression);
+			}
+			meta.set("compression", "raw");
+			meta.set("mipLevels", 1);
+			const auto* pixels = reinterpret_cast<const Byte*>(image.getPixels());
+			collector.output(asset.assetId, AssetType::Texture, Bytes(pixels, pixels + size_t(image.getWidth()) * image.getHeight() * 4), meta);
+			return;
+		}
+	}
+
+	// Encode to PNG and save; "pngCompression": "fast" is for work in progress, where import time matters more than size
+	meta.set("compression", "png");
+	const bool fastPNG = meta.getString("pngCompression", "default") == "fast";
+	collector.output(asset.assetId, AssetType::Texture, image.savePNGToBytes(true, fastPNG), meta);
 }
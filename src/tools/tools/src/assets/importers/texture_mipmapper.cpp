@@ -0,0 +1,117 @@
+#include "texture_mipmapper.h"
+#include "halley/file_formats/image.h"
+#include "halley/support/exception.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace Halley;
+
+namespace {
+	// Pixels are assumed to be sRGB, so averaging them directly would darken edges and fine detail
+	struct GammaTables {
+		std::array<float, 256> toLinear;
+		std::array<uint8_t, 4096> fromLinear;
+
+		GammaTables()
+		{
+			for (size_t i = 0; i < toLinear.size(); ++i) {
+				const float c = float(i) / 255.0f;
+				toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (size_t i = 0; i < fromLinear.size(); ++i) {
+				const float l = float(i) / float(fromLinear.size() - 1);
+				const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				fromLinear[i] = uint8_t(std::min(std::max(std::lround(c * 255.0f), 0l), 255l));
+			}
+		}
+
+		uint8_t encode(float linear) const
+		{
+			const float scaled = std::min(std::max(linear, 0.0f), 1.0f) * float(fromLinear.size() - 1);
+			return fromLinear[size_t(scaled + 0.5f)];
+		}
+	};
+
+	const GammaTables& getGammaTables()
+	{
+		static GammaTables tables;
+		return tables;
+	}
+}
+
+bool TextureMipmapper::canMipmap(const Image& image)
+{
+	const auto format = image.getFormat();
+	return format == Image::Format::RGBA || format == Image::Format::RGBAPremultiplied;
+}
+
+Bytes TextureMipmapper::makeMipChain(const Image& image)
+{
+	if (!canMipmap(image)) {
+		throw Exception("Only RGBA images can have their mip chain generated on import", HalleyExceptions::Tools);
+	}
+
+	const Vector2i size = image.getSize();
+	const bool premultiplied = image.getFormat() == Image::Format::RGBAPremultiplied;
+	const int levels = TextureDescriptor::getNumMipLevels(size);
+	size_t totalBytes = 0;
+	for (int i = 0; i < levels; ++i) {
+		totalBytes += TextureDescriptor::getLevelByteSize(TextureDescriptor::getMipLevelSize(size, i), TextureFormat::RGBA);
+	}
+
+	Bytes result;
+	result.reserve(totalBytes);
+
+	auto src = reinterpret_cast<const uint8_t*>(image.getPixels());
+	Vector<uint8_t> level(src, src + size_t(size.x) * size_t(size.y) * 4);
+	for (int i = 0; i < levels; ++i) {
+		if (i > 0) {
+			level = downsample(level, TextureDescriptor::getMipLevelSize(size, i - 1), TextureDescriptor::getMipLevelSize(size, i), premultiplied);
+		}
+		result.insert(result.end(), level.begin(), level.end());
+	}
+
+	Ensures(result.size() == totalBytes);
+	return result;
+}
+
+Vector<uint8_t> TextureMipmapper::downsample(const Vector<uint8_t>& rgba, Vector2i size, Vector2i newSize, bool premultiplied)
+{
+	auto& gamma = getGammaTables();
+	constexpr float weights[4] = { 1.0f, 3.0f, 3.0f, 1.0f };
+
+	Vector<uint8_t> result(size_t(newSize.x) * size_t(newSize.y) * 4);
+	for (int y = 0; y < newSize.y; ++y) {
+		for (int x = 0; x < newSize.x; ++x) {
+			// Four source pixels each way, centred on the 2x2 block this pixel covers, clamped at the edges
+			float colour[3] = { 0, 0, 0 };
+			float alpha = 0;
+			float colourWeight = 0;
+			float totalWeight = 0;
+			for (int j = 0; j < 4; ++j) {
+				const int sy = clamp(y * 2 - 1 + j, 0, size.y - 1);
+				for (int i = 0; i < 4; ++i) {
+					const int sx = clamp(x * 2 - 1 + i, 0, size.x - 1);
+					const uint8_t* px = rgba.data() + (size_t(sy) * size.x + sx) * 4;
+					const float w = weights[i] * weights[j];
+					const float a = px[3] / 255.0f;
+					const float cw = premultiplied ? w : w * a;
+					for (int c = 0; c < 3; ++c) {
+						colour[c] += gamma.toLinear[px[c]] * cw;
+					}
+					colourWeight += cw;
+					alpha += a * w;
+					totalWeight += w;
+				}
+			}
+
+			uint8_t* dst = result.data() + (size_t(y) * newSize.x + x) * 4;
+			for (int c = 0; c < 3; ++c) {
+				dst[c] = colourWeight > 0 ? gamma.encode(colour[c] / colourWeight) : 0;
+			}
+			dst[3] = uint8_t(std::lround(alpha / totalWeight * 255.0f));
+		}
+	}
+	return result;
+}
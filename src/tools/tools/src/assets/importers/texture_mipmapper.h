@@ -0,0 +1,21 @@
+#pragma once
+#include "halley/core/graphics/texture_descriptor.h"
+#include "halley/utils/utils.h"
+
+namespace Halley
+{
+	class Image;
+
+	// Builds mip chains for RGBA images at import time, so they don't depend on the driver's (usually box) filter
+	class TextureMipmapper
+	{
+	public:
+		static bool canMipmap(const Image& image);
+
+		// Every mip level of the image, largest first, in the layout expected by the video plugins
+		static Bytes makeMipChain(const Image& image);
+
+		// Halves an RGBA level with a [1 3 3 1] tent filter in linear space; straight alpha colours are weighted by alpha
+		static Vector<uint8_t> downsample(const Vector<uint8_t>& rgba, Vector2i size, Vector2i newSize, bool premultiplied);
+	};
+}
@@ -0,0 +1,306 @@
+#include "halley/tools/benchmark/benchmark_compare_tool.h"
+#include "halley/text/string_converter.h"
+#include "halley/support/console.h"
+#include "halley/support/logger.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <tuple>
+
+using namespace Halley;
+
+namespace {
+	constexpr size_t maxExactSamples = 400; // Product of both sample counts, past which the normal approximation is used
+
+	double getRelativeChange(double from, double to)
+	{
+		if (from != 0) {
+			return (to - from) / std::abs(from);
+		}
+		return to == from ? 0.0 : std::copysign(std::numeric_limits<double>::infinity(), to - from);
+	}
+
+	// Number of orderings of m samples of a and n of b in which u pairs have the one from a larger, for every u up to m * n
+	Vector<double> getExactUDistribution(size_t m, size_t n)
+	{
+		// f[i][j][u], built up from the largest sample down: if it's from a, it's larger than all j of b
+		Vector<Vector<Vector<double>>> f(m + 1, Vector<Vector<double>>(n + 1));
+		for (size_t i = 0; i <= m; ++i) {
+			for (size_t j = 0; j <= n; ++j) {
+				auto& cur = f[i][j];
+				cur.resize(i * j + 1, 0.0);
+				if (i == 0 || j == 0) {
+					cur[0] = 1;
+					continue;
+				}
+				auto& withA = f[i - 1][j];
+				auto& withB = f[i][j - 1];
+				for (size_t u = 0; u < cur.size(); ++u) {
+					cur[u] = (u >= j && u - j < withA.size() ? withA[u - j] : 0.0) + (u < withB.size() ? withB[u] : 0.0);
+				}
+			}
+		}
+		return f[m][n];
+	}
+
+	String formatValue(double value)
+	{
+		std::stringstream ss;
+		ss << std::setprecision(4) << value;
+		return ss.str();
+	}
+
+	String formatChange(double change)
+	{
+		if (std::isinf(change)) {
+			return change > 0 ? "+inf" : "-inf";
+		}
+		return (change >= 0 ? "+" : "") + toString(change * 100.0, 1) + "%";
+	}
+}
+
+BenchmarkComparison::BenchmarkComparison(const BenchmarkReport& baseline, const BenchmarkReport& current, Options options)
+	: options(options)
+{
+	for (auto& m: current.getMetrics()) {
+		if (auto base = baseline.tryGetMetric(m.name)) {
+			results.push_back(compare(*base, m));
+		} else {
+			Result result;
+			result.name = m.name;
+			result.unit = m.unit;
+			result.verdict = Verdict::New;
+			result.current = m.getMedian();
+			results.push_back(result);
+		}
+	}
+
+	for (auto& m: baseline.getMetrics()) {
+		if (!current.tryGetMetric(m.name)) {
+			Result result;
+			result.name = m.name;
+			result.unit = m.unit;
+			result.verdict = Verdict::Missing;
+			result.baseline = m.getMedian();
+			results.push_back(result);
+		}
+	}
+
+	const auto& a = baseline.getMachine();
+	const auto& b = current.getMachine();
+	for (auto& key: { "computer", "cpu", "threads", "gpu", "os", "compiler", "arch", "build" }) {
+		const auto iterA = a.find(key);
+		const auto iterB = b.find(key);
+		const String valueA = iterA != a.end() ? iterA->second : "";
+		const String valueB = iterB != b.end() ? iterB->second : "";
+		if (valueA != valueB) {
+			machineDifferences.push_back(String(key) + ": \"" + valueA + "\" -> \"" + valueB + "\"");
+		}
+	}
+}
+
+bool BenchmarkComparison::hasRegressions() const
+{
+	return std::any_of(results.begin(), results.end(), [] (const Result& r) { return r.verdict == Verdict::Slower; });
+}
+
+BenchmarkComparison::Result BenchmarkComparison::compare(const BenchmarkReport::Metric& base, const BenchmarkReport::Metric& cur) const
+{
+	Result result;
+	result.name = cur.name;
+	result.unit = cur.unit;
+	result.baseline = base.getMedian();
+	result.current = cur.getMedian();
+
+	const bool lowerIsBetter = cur.better == BenchmarkReport::Better::Lower;
+	result.change = getRelativeChange(result.baseline, result.current) * (lowerIsBetter ? 1.0 : -1.0);
+	const bool worse = result.change > 0;
+
+	if (std::abs(result.change) <= options.threshold) {
+		result.verdict = Verdict::Unchanged;
+	} else if (cur.exact) {
+		result.verdict = worse ? Verdict::Slower : Verdict::Faster;
+	} else if (base.samples.size() < 2 || cur.samples.size() < 2) {
+		result.verdict = Verdict::Inconclusive;
+	} else {
+		// Tested in the direction the median moved
+		const bool currentIsLarger = worse == lowerIsBetter;
+		result.pValue = currentIsLarger ? getMannWhitneyPValue(cur.samples, base.samples) : getMannWhitneyPValue(base.samples, cur.samples);
+		if (result.pValue <= options.alpha) {
+			result.verdict = worse ? Verdict::Slower : Verdict::Faster;
+		} else {
+			result.verdict = Verdict::Inconclusive;
+		}
+	}
+
+	return result;
+}
+
+double BenchmarkComparison::getMannWhitneyPValue(const Vector<double>& a, const Vector<double>& b)
+{
+	const size_t m = a.size();
+	const size_t n = b.size();
+	if (m == 0 || n == 0) {
+		return 1.0;
+	}
+
+	// Ranks of both together, ties getting the average of the ranks they span
+	Vector<std::pair<double, bool>> all; // Value, and whether it's from a
+	all.reserve(m + n);
+	for (auto& v: a) {
+		all.emplace_back(v, true);
+	}
+	for (auto& v: b) {
+		all.emplace_back(v, false);
+	}
+	std::sort(all.begin(), all.end(), [] (const std::pair<double, bool>& x, const std::pair<double, bool>& y) { return x.first < y.first; });
+
+	double rankSumA = 0;
+	double tieTerm = 0;
+	for (size_t i = 0; i < all.size(); ) {
+		size_t j = i + 1;
+		while (j < all.size() && all[j].first == all[i].first) {
+			++j;
+		}
+		const double rank = double(i + j + 1) / 2.0; // Ranks are 1-based
+		for (size_t k = i; k < j; ++k) {
+			if (all[k].second) {
+				rankSumA += rank;
+			}
+		}
+		const double t = double(j - i);
+		tieTerm += t * t * t - t;
+		i = j;
+	}
+
+	// Pairs with the one from a larger, ties counting as half
+	const double u = rankSumA - double(m * (m + 1)) / 2.0;
+
+	if (tieTerm == 0 && m * n <= maxExactSamples) {
+		const auto dist = getExactUDistribution(m, n);
+		double total = 0;
+		double atLeast = 0;
+		for (size_t i = 0; i < dist.size(); ++i) {
+			total += dist[i];
+			if (double(i) >= u) {
+				atLeast += dist[i];
+			}
+		}
+		return atLeast / total;
+	}
+
+	const double nTotal = double(m + n);
+	const double mean = double(m * n) / 2.0;
+	const double variance = double(m * n) / 12.0 * ((nTotal + 1.0) - tieTerm / (nTotal * (nTotal - 1.0)));
+	if (variance <= 0) {
+		return 1.0; // Everything is the same value
+	}
+	const double z = (u - mean - 0.5) / std::sqrt(variance); // With continuity correction
+	return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+int BenchmarkCompareTool::run(Vector<std::string> args)
+{
+	try {
+		BenchmarkComparison::Options options;
+		bool verbose = false;
+		Vector<String> paths;
+		for (size_t i = 0; i < args.size(); ++i) {
+			if (args[i] == "-t" && i + 1 < args.size()) {
+				options.threshold = double(String(args[++i]).toFloat()) / 100.0;
+			} else if (args[i] == "-a" && i + 1 < args.size()) {
+				options.alpha = double(String(args[++i]).toFloat());
+			} else if (args[i] == "-v") {
+				verbose = true;
+			} else {
+				paths.push_back(args[i]);
+			}
+		}
+
+		if (paths.size() != 2) {
+			Logger::logError("Usage: halley-cmd benchmark-compare [-t thresholdPercent] [-a alpha] [-v] baseline.json current.json");
+			return 1;
+		}
+
+		const auto baseline = BenchmarkReport::load(paths[0]);
+		const auto current = BenchmarkReport::load(paths[1]);
+		if (baseline.getBenchmark() != current.getBenchmark()) {
+			Logger::logError("Can't compare results of \"" + current.getBenchmark() + "\" against a baseline of \"" + baseline.getBenchmark() + "\".");
+			return 1;
+		}
+
+		const BenchmarkComparison comparison(baseline, current, options);
+
+		auto stdCol = ConsoleColour();
+		auto strCol = ConsoleColour(Console::DARK_GREY);
+		std::cout << "Benchmark " << strCol << current.getBenchmark() << stdCol
+			<< " at " << current.getCommit() << " (" << current.getDate() << "), against " << baseline.getCommit() << " (" << baseline.getDate() << ")\n";
+		std::cout << "Threshold " << toString(options.threshold * 100.0, 1) << "%, alpha " << options.alpha << "\n";
+		if (!comparison.getMachineDifferences().empty()) {
+			std::cout << ConsoleColour(Console::YELLOW) << "Not run on the same machine, so changes might be down to that:" << stdCol << "\n";
+			for (auto& d: comparison.getMachineDifferences()) {
+				std::cout << "    " << d << "\n";
+			}
+		}
+
+		using Verdict = BenchmarkComparison::Verdict;
+		const std::array<std::tuple<Verdict, const char*, Console::ColourType>, 6> groups = {{
+			std::make_tuple(Verdict::Slower, "Slower", Console::RED),
+			std::make_tuple(Verdict::Faster, "Faster", Console::GREEN),
+			std::make_tuple(Verdict::Inconclusive, "Changed, but within noise or with too few samples to tell", Console::YELLOW),
+			std::make_tuple(Verdict::Missing, "Missing", Console::YELLOW),
+			std::make_tuple(Verdict::New, "New", Console::DARK_GREY),
+			std::make_tuple(Verdict::Unchanged, "Unchanged", Console::DARK_GREY)
+		}};
+
+		for (auto& group: groups) {
+			const auto verdict = std::get<0>(group);
+			if (verdict == Verdict::Unchanged && !verbose) {
+				continue;
+			}
+
+			bool first = true;
+			for (auto& r: comparison.getResults()) {
+				if (r.verdict != verdict) {
+					continue;
+				}
+				if (first) {
+					std::cout << ConsoleColour(std::get<2>(group)) << std::get<1>(group) << ":" << stdCol << "\n";
+					first = false;
+				}
+
+				std::cout << "    " << strCol << std::left << std::setw(40) << r.name.cppStr() << stdCol << std::right;
+				if (verdict == Verdict::Missing) {
+					std::cout << std::setw(12) << formatValue(r.baseline) << " " << r.unit;
+				} else if (verdict == Verdict::New) {
+					std::cout << std::setw(12) << formatValue(r.current) << " " << r.unit;
+				} else {
+					std::cout << std::setw(12) << formatValue(r.baseline) << " -> " << std::setw(12) << formatValue(r.current) << " " << std::left << std::setw(6) << r.unit.cppStr() << std::right
+						<< ConsoleColour(std::get<2>(group)) << std::setw(9) << formatChange(r.change) << stdCol;
+					if (r.pValue < 1) {
+						std::cout << "  p=" << formatValue(r.pValue);
+					}
+				}
+				std::cout << "\n";
+			}
+		}
+
+		std::array<size_t, 6> counts = {};
+		for (auto& r: comparison.getResults()) {
+			counts[size_t(r.verdict)]++;
+		}
+		std::cout << counts[size_t(Verdict::Slower)] << " slower, " << counts[size_t(Verdict::Faster)] << " faster, "
+			<< counts[size_t(Verdict::Inconclusive)] << " inconclusive and " << counts[size_t(Verdict::Unchanged)] << " unchanged." << std::endl;
+
+		return comparison.hasRegressions() ? 1 : 0;
+	} catch (std::exception& e) {
+		Logger::logException(e);
+		return 1;
+	} catch (...) {
+		Logger::logError("Unknown exception comparing benchmark results.");
+		return 1;
+	}
+}
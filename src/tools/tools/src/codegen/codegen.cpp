@@ -8,6 +8,9 @@
 #include "halley/tools/file/filesystem.h"
 #include "halley/support/logger.h"
 #include "halley/text/string_converter.h"
+#include "halley/bytes/byte_serializer.h"
+#include "halley/utils/hash.h"
+#include <set>
 
 #ifdef _MSC_VER
 	#ifdef _DEBUG
@@ -25,6 +28,84 @@
 
 using namespace Halley;
 
+namespace {
+	// Bump whenever the generated code changes, so everything is generated again
+	constexpr int codegenVersion = 1;
+
+	const char* stateFileName = ".codegen_state";
+
+	void feedString(Hash::Hasher& hasher, const String& str)
+	{
+		hasher.feed(str.size());
+		hasher.feedBytes(gsl::as_bytes(gsl::span<const char>(str.c_str(), str.size())));
+	}
+
+	void feedIncludes(Hash::Hasher& hasher, const std::unordered_set<String>& includes)
+	{
+		// Sorted, as the set's order isn't stable
+		std::set<String> sorted(includes.begin(), includes.end());
+		for (auto& i: sorted) {
+			feedString(hasher, i);
+		}
+	}
+
+	void assignStableIds(std::vector<String> names, const std::map<String, int>& previous, std::map<String, int>& next)
+	{
+		// Everything that's still there keeps its id, and new ones fill the gaps left by whatever was removed
+		std::set<int> used;
+		for (auto& name: names) {
+			auto iter = previous.find(name);
+			if (iter != previous.end()) {
+				next[name] = iter->second;
+				used.insert(iter->second);
+			}
+		}
+
+		std::sort(names.begin(), names.end());
+		int nextId = 0;
+		for (auto& name: names) {
+			if (next.find(name) == next.end()) {
+				while (used.find(nextId) != used.end()) {
+					++nextId;
+				}
+				next[name] = nextId;
+				used.insert(nextId);
+			}
+		}
+	}
+}
+
+void Codegen::State::Output::serialize(Serializer& s) const
+{
+	s << hash;
+	s << files;
+}
+
+void Codegen::State::Output::deserialize(Deserializer& s)
+{
+	s >> hash;
+	s >> files;
+}
+
+void Codegen::State::serialize(Serializer& s) const
+{
+	s << codegenVersion;
+	s << componentIds;
+	s << messageIds;
+	s << outputs;
+}
+
+void Codegen::State::deserialize(Deserializer& s)
+{
+	int version;
+	s >> version;
+	if (version == codegenVersion) {
+		s >> componentIds;
+		s >> messageIds;
+		s >> outputs;
+	}
+}
+
 void Codegen::run(Path inDir, Path outDir)
 {
 	throw Exception("Not supported", HalleyExceptions::Tools);
@@ -101,10 +182,7 @@ void Codegen::validate(ProgressReporter progress)
 void Codegen::process()
 {
 	{
-		int id = 0;
 		for (auto& comp : components) {
-			comp.second.id = id++;
-
 			for (auto& m: comp.second.members) {
 				String i = getInclude(m.type.name);
 				if (i != "") {
@@ -115,10 +193,7 @@ void Codegen::process()
 	}
 	
 	{
-		int id = 0;
 		for (auto& msg : messages) {
-			msg.second.id = id++;
-
 			for (auto& m: msg.second.members) {
 				String i = getInclude(m.type.name);
 				if (i != "") {
@@ -212,35 +287,88 @@ void Codegen::writeFiles(Path dir, const CodeGenResult& files, Stats& stats) con
 
 std::vector<Path> Codegen::generateCode(Path directory, ProgressReporter progress)
 {
+	const Path statePath = directory / stateFileName;
+	const State previous = loadState(statePath);
+
 	Vector<std::unique_ptr<ICodeGenerator>> gens;
 	gens.emplace_back(std::make_unique<CodegenCPP>());
 	Stats stats;
+	assignIds(previous, stats.state);
 
 	for (auto& gen : gens) {
 		Path genDir = directory / gen->getDirectory();
+		const String keyPrefix = gen->getDirectory().string() + "/";
 		Vector<ComponentSchema> comps;
 		Vector<SystemSchema> syss;
 
+		// Each output is hashed from everything it's generated from, which, for a system, is only its own schema and includes,
+		// as it refers to components and messages by name
 		for (auto& comp : components) {
-			writeFiles(genDir, gen->generateComponent(comp.second), stats);
+			Hash::Hasher hasher;
+			hasher.feed(codegenVersion);
+			hasher.feed(sourceHashes.at("component:" + comp.first));
+			hasher.feed(comp.second.id);
+			feedIncludes(hasher, comp.second.includeFiles);
+
+			generateIfChanged(keyPrefix + "component:" + comp.first, hasher.digest(), directory, genDir, [&] () { return gen->generateComponent(comp.second); }, previous, stats);
 			comps.push_back(comp.second);
 		}
 		for (auto& sys : systems) {
 			if (sys.second.language == gen->getLanguage()) {
-				writeFiles(genDir, gen->generateSystem(sys.second), stats);
+				Hash::Hasher hasher;
+				hasher.feed(codegenVersion);
+				hasher.feed(sourceHashes.at("system:" + sys.first));
+				feedIncludes(hasher, sys.second.includeFiles);
+
+				generateIfChanged(keyPrefix + "system:" + sys.first, hasher.digest(), directory, genDir, [&] () { return gen->generateSystem(sys.second); }, previous, stats);
 			}
 			syss.push_back(sys.second);
 		}
 		for (auto& msg : messages) {
-			writeFiles(genDir, gen->generateMessage(msg.second), stats);
+			Hash::Hasher hasher;
+			hasher.feed(codegenVersion);
+			hasher.feed(sourceHashes.at("message:" + msg.first));
+			hasher.feed(msg.second.id);
+			feedIncludes(hasher, msg.second.includeFiles);
+
+			generateIfChanged(keyPrefix + "message:" + msg.first, hasher.digest(), directory, genDir, [&] () { return gen->generateMessage(msg.second); }, previous, stats);
 		}
 
-		// Registry
+		// Registry, which is only one file, and depends on everything
+		const size_t firstFile = stats.files.size();
 		writeFiles(genDir, gen->generateRegistry(comps, syss), stats);
+		auto& registry = stats.state.outputs[keyPrefix + "registry"];
+		for (size_t i = firstFile; i < stats.files.size(); ++i) {
+			registry.files.push_back(FileSystem::getRelative(stats.files[i], directory));
+		}
+	}
+
+	auto getFiles = [] (const State& state)
+	{
+		std::set<String> result;
+		for (auto& o: state.outputs) {
+			for (auto& f: o.second.files) {
+				result.insert(f.string());
+			}
+		}
+		return result;
+	};
+	const auto previousFiles = getFiles(previous);
+	const auto currentFiles = getFiles(stats.state);
+
+	// Whatever was generated for schemas that are gone
+	for (auto& f: previousFiles) {
+		if (currentFiles.find(f) == currentFiles.end()) {
+			FileSystem::remove(directory / f);
+			if (verbose) {
+				std::cout << "* Removed " << (directory / f) << std::endl;
+			}
+		}
 	}
+	const bool filesChanged = previousFiles != currentFiles;
 
-	// Has changes
-	if (stats.written > 0) {
+	// Only a new or removed file needs CMake to run again; touching it on every change would have every build reconfigure
+	if (filesChanged) {
 		auto cmakeLists = directory.parentPath() / Path("CMakeLists.txt");
 		if (verbose) {
 			std::cout << "Touching " << cmakeLists.string() << std::endl;
@@ -248,6 +376,8 @@ std::vector<Path> Codegen::generateCode(Path directory, ProgressReporter progres
 		utime(cmakeLists.string().c_str(), nullptr);
 	}
 
+	FileSystem::writeFile(statePath, Serializer::toBytes(stats.state));
+
 	if (verbose) {
 		std::cout << "Codegen: " << stats.written << " written, " << stats.skipped << " skipped." << std::endl;
 	}
@@ -259,6 +389,70 @@ std::vector<Path> Codegen::generateCode(Path directory, ProgressReporter progres
 	return out;
 }
 
+Codegen::State Codegen::loadState(const Path& path) const
+{
+	State state;
+	if (FileSystem::exists(path)) {
+		try {
+			auto data = FileSystem::readFile(path);
+			auto s = Deserializer(data);
+			s >> state;
+		} catch (...) {
+			// Generating everything again is always safe
+			state = State();
+		}
+	}
+	return state;
+}
+
+void Codegen::assignIds(const State& previous, State& next)
+{
+	std::vector<String> names;
+	for (auto& comp : components) {
+		names.push_back(comp.first);
+	}
+	assignStableIds(names, previous.componentIds, next.componentIds);
+	for (auto& comp : components) {
+		comp.second.id = next.componentIds.at(comp.first);
+	}
+
+	names.clear();
+	for (auto& msg : messages) {
+		names.push_back(msg.first);
+	}
+	assignStableIds(names, previous.messageIds, next.messageIds);
+	for (auto& msg : messages) {
+		msg.second.id = next.messageIds.at(msg.first);
+	}
+}
+
+void Codegen::generateIfChanged(const String& key, uint64_t hash, const Path& directory, const Path& genDir, const std::function<CodeGenResult()>& generate, const State& previous, Stats& stats) const
+{
+	auto iter = previous.outputs.find(key);
+	if (iter != previous.outputs.end() && iter->second.hash == hash) {
+		const auto& files = iter->second.files;
+		const bool allThere = std::all_of(files.begin(), files.end(), [&] (const Path& f) { return FileSystem::exists(directory / f); });
+		if (allThere) {
+			// Would be generated exactly as it was last time
+			stats.skipped += int(files.size());
+			for (auto& f: files) {
+				stats.files.push_back(directory / f);
+			}
+			stats.state.outputs[key] = iter->second;
+			return;
+		}
+	}
+
+	const size_t firstFile = stats.files.size();
+	writeFiles(genDir, generate(), stats);
+
+	auto& output = stats.state.outputs[key];
+	output.hash = hash;
+	for (size_t i = firstFile; i < stats.files.size(); ++i) {
+		output.files.push_back(FileSystem::getRelative(stats.files[i], directory));
+	}
+}
+
 void Codegen::addSource(String path, gsl::span<const gsl::byte> data)
 {
 	String strData(reinterpret_cast<const char*>(data.data()), data.size());
@@ -266,6 +460,8 @@ void Codegen::addSource(String path, gsl::span<const gsl::byte> data)
 
 	for (auto document: documents) {
 		String curPos = path + ":" + toString(document.Mark().line) + ":" + toString(document.Mark().column);
+		const String dumped = YAML::Dump(document);
+		const uint64_t sourceHash = Hash::hash(gsl::as_bytes(gsl::span<const char>(dumped.c_str(), dumped.size())));
 
 		if (!document.IsDefined() || document.IsNull()) {
 			throw Exception("Invalid document in stream.", HalleyExceptions::Tools);
@@ -274,11 +470,11 @@ void Codegen::addSource(String path, gsl::span<const gsl::byte> data)
 		if (document.IsScalar()) {
 			throw Exception("YAML parse error in codegen definitions:\n\"" + document.as<std::string>() + "\"\nat " + curPos, HalleyExceptions::Tools);
 		} else if (document["component"].IsDefined()) {
-			addComponent(document);
+			addComponent(document, sourceHash);
 		} else if (document["system"].IsDefined()) {
-			addSystem(document);
+			addSystem(document, sourceHash);
 		} else if (document["message"].IsDefined()) {
-			addMessage(document);
+			addMessage(document, sourceHash);
 		} else if (document["type"].IsDefined()) {
 			addType(document);
 		} else {
@@ -287,34 +483,37 @@ void Codegen::addSource(String path, gsl::span<const gsl::byte> data)
 	}
 }
 
-void Codegen::addComponent(YAML::Node rootNode)
+void Codegen::addComponent(YAML::Node rootNode, uint64_t sourceHash)
 {
 	auto comp = ComponentSchema(rootNode["component"]);
 
 	if (components.find(comp.name) == components.end()) {
 		components[comp.name] = comp;
+		sourceHashes["component:" + comp.name] = sourceHash;
 	} else {
 		throw Exception("Component already declared: " + comp.name, HalleyExceptions::Tools);
 	}
 }
 
-void Codegen::addSystem(YAML::Node rootNode)
+void Codegen::addSystem(YAML::Node rootNode, uint64_t sourceHash)
 {
 	auto sys = SystemSchema(rootNode["system"]);
 
 	if (systems.find(sys.name) == systems.end()) {
 		systems[sys.name] = sys;
+		sourceHashes["system:" + sys.name] = sourceHash;
 	} else {
 		throw Exception("System already declared: " + sys.name, HalleyExceptions::Tools);
 	}
 }
 
-void Codegen::addMessage(YAML::Node rootNode)
+void Codegen::addMessage(YAML::Node rootNode, uint64_t sourceHash)
 {
 	auto msg = MessageSchema(rootNode["message"]);
 
 	if (messages.find(msg.name) == messages.end()) {
 		messages[msg.name] = msg;
+		sourceHashes["message:" + msg.name] = sourceHash;
 	} else {
 		throw Exception("Message already declared: " + msg.name, HalleyExceptions::Tools);
 	}
@@ -1,4 +1,5 @@
 #include "../yaml/halley-yamlcpp.h"
+#include <halley/support/exception.h>
 #include <halley/tools/codegen/component_schema.h>
 
 using namespace Halley;
@@ -9,9 +10,27 @@ ComponentSchema::ComponentSchema(YAML::Node node)
 {
 	name = node["name"].as<std::string>();
 
+	MemberSerializationSchema::parseMembers(node["members"], members, memberSerialization, name);
+
+	serializable = node["serializable"].as<bool>(false);
+	replicated = node["replicated"].as<bool>(false);
+
 	for (auto memberEntry : node["members"]) {
 		for (auto m = memberEntry.begin(); m != memberEntry.end(); ++m) {
-			members.emplace_back(VariableSchema(TypeSchema(m->second.as<std::string>()), m->first.as<std::string>()));
+			if (!m->second.IsMap() || !m->second["index"].IsDefined()) {
+				continue;
+			}
+
+			ComponentIndexSchema index;
+			index.member = m->first.as<std::string>();
+			index.type = m->second["type"].as<std::string>();
+			const String kind = m->second["index"].as<std::string>();
+			if (kind == "sorted") {
+				index.sorted = true;
+			} else if (kind != "hash") {
+				throw Exception("Unknown index type for member " + index.member + " of " + name + ": " + kind, HalleyExceptions::Tools);
+			}
+			indices.push_back(index);
 		}
 	}
 }
@@ -93,11 +93,20 @@ CodeGenResult CodegenCPP::generateMessage(MessageSchema message)
 CodeGenResult CodegenCPP::generateRegistry(const Vector<ComponentSchema>& components, const Vector<SystemSchema>& systems)
 {
 	Vector<String> registryCpp {
-		"#include <halley.hpp>",
+		"#include <halley.hpp>"
+	};
+
+	for (auto& comp: components) {
+		if (comp.replicated) {
+			registryCpp.push_back("#include \"components/" + toFileName(comp.name + "Component") + ".h\"");
+		}
+	}
+
+	registryCpp.insert(registryCpp.end(), {
 		"using namespace Halley;",
 		"",
 		"// System factory functions"
-	};
+	});
 
 	for (auto& sys: systems) {
 		registryCpp.push_back("System* halleyCreate" + sys.name + "System();");
@@ -129,6 +138,18 @@ CodeGenResult CodegenCPP::generateRegistry(const Vector<ComponentSchema>& compon
 		"			throw Exception(\"System not found: \" + name, HalleyExceptions::Entity);",
 		"		}",
 		"		return std::unique_ptr<System>(result->second());",
+		"	}",
+		"",
+		"	void initializeReplicatedComponents() {"
+	});
+
+	for (auto& comp: components) {
+		if (comp.replicated) {
+			registryCpp.push_back("		TypeDeleter<" + comp.name + "Component>::initialize();");
+		}
+	}
+
+	registryCpp.insert(registryCpp.end(), {
 		"	}",
 		"}"
 	});
@@ -138,6 +159,9 @@ CodeGenResult CodegenCPP::generateRegistry(const Vector<ComponentSchema>& compon
 		"",
 		"namespace Halley {",
 		"	std::unique_ptr<System> createSystem(String name);",
+		"",
+		"	// Replicas can only be loaded for components that this side knows about, call this before receiving any",
+		"	void initializeReplicatedComponents();",
 		"}"
 	};
 
@@ -147,6 +171,54 @@ CodeGenResult CodegenCPP::generateRegistry(const Vector<ComponentSchema>& compon
 	return result;
 }
 
+static bool needsSerializers(bool serializable, const Vector<MemberSerializationSchema>& serialization)
+{
+	// Annotating any member asks for serializers just as well
+	if (serialization.empty()) {
+		return false;
+	}
+	return serializable || std::any_of(serialization.begin(), serialization.end(), [] (const MemberSerializationSchema& m) { return !m.isDefault(); });
+}
+
+static void addSerializers(CPPClassGenerator& gen, const Vector<VariableSchema>& members, const Vector<MemberSerializationSchema>& serialization)
+{
+	Expects(members.size() == serialization.size());
+
+	Vector<String> serializeBody;
+	Vector<String> deserializeBody;
+	for (size_t i = 0; i < members.size(); ++i) {
+		auto& m = members[i];
+		auto& ser = serialization[i];
+
+		String write;
+		String read;
+		if (ser.quantized) {
+			const String range = m.type.name + "(" + ser.rangeMin + "), " + m.type.name + "(" + ser.rangeMax + "), " + toString(ser.bits);
+			write = "s.serializeQuantized(" + m.name + ", " + range + ");";
+			read = "s.deserializeQuantized(" + m.name + ", " + range + ");";
+		} else if (ser.bits > 0) {
+			write = "s.serializeBits(" + m.name + ", " + toString(ser.bits) + ");";
+			read = "s.deserializeBits(" + m.name + ", " + toString(ser.bits) + ");";
+		} else {
+			write = "s << " + m.name + ";";
+			read = "s >> " + m.name + ";";
+		}
+
+		if (ser.version > 0) {
+			const String condition = "if (s.getVersion() >= " + toString(ser.version) + ") {";
+			serializeBody.insert(serializeBody.end(), { condition, "\t" + write, "}" });
+			deserializeBody.insert(deserializeBody.end(), { condition, "\t" + read, "}" });
+		} else {
+			serializeBody.push_back(write);
+			deserializeBody.push_back(read);
+		}
+	}
+
+	gen.addMethodDefinition(MethodSchema(TypeSchema("void"), { VariableSchema(TypeSchema("Halley::Serializer&"), "s") }, "serialize", true), serializeBody)
+		.addBlankLine()
+		.addMethodDefinition(MethodSchema(TypeSchema("void"), { VariableSchema(TypeSchema("Halley::Deserializer&"), "s") }, "deserialize"), deserializeBody);
+}
+
 Vector<String> CodegenCPP::generateComponentHeader(ComponentSchema component)
 {
 	Vector<String> contents = {
@@ -163,8 +235,17 @@ Vector<String> CodegenCPP::generateComponentHeader(ComponentSchema component)
 
 	auto gen = CPPClassGenerator(component.name + "Component", "Halley::Component", CPPAccess::Public, true)
 		.addAccessLevelSection(CPPAccess::Public)
-		.addMember(VariableSchema(TypeSchema("int", false, true, true), "componentIndex", toString(component.id)))
-		.addBlankLine()
+		.addMember(VariableSchema(TypeSchema("int", false, true, true), "componentIndex", toString(component.id)));
+
+	if (component.replicated) {
+		gen.addMember(VariableSchema(TypeSchema("bool", false, true, true), "replicated", "true"));
+	}
+
+	for (auto& index: component.indices) {
+		gen.addTypeDefinition(upperFirst(index.member) + "Index", String(index.sorted ? "Halley::SortedEntityIndex<" : "Halley::HashEntityIndex<") + index.type + ">");
+	}
+
+	gen.addBlankLine()
 		.addMembers(component.members)
 		.addBlankLine()
 		.addDefaultConstructor();
@@ -174,6 +255,11 @@ Vector<String> CodegenCPP::generateComponentHeader(ComponentSchema component)
 			.addConstructor(component.members);
 	}
 
+	if (needsSerializers(component.serializable || component.replicated, component.memberSerialization)) {
+		gen.addBlankLine();
+		addSerializers(gen, component.members, component.memberSerialization);
+	}
+
 	gen.finish()
 		.writeTo(contents);
 
@@ -218,13 +304,27 @@ public:
 			stratImpl = "static_cast<T*>(this)->" + methodName + "(" + methodArgName + ");";
 		} else if (system.strategy == SystemStrategy::Individual) {
 			familyArgs.push_back(VariableSchema(TypeSchema("MainFamily&"), "e"));
-			stratImpl = "invokeIndividual([this, &" + methodArgName + "] (auto& e) { static_cast<T*>(this)->" + methodName + "(" + methodArgName + ", e); }, mainFamily);";
+			if (system.smearing > 1) {
+				stratImpl = "invokeSmeared([this] (auto& e, Halley::Time elapsed) { static_cast<T*>(this)->" + methodName + "(elapsed, e); }, mainFamily, " + toString(system.smearing) + ", " + methodArgName + ");";
+			} else {
+				stratImpl = "invokeIndividual([this, &" + methodArgName + "] (auto& e) { static_cast<T*>(this)->" + methodName + "(" + methodArgName + ", e); }, mainFamily);";
+			}
 		} else if (system.strategy == SystemStrategy::Parallel) {
 			familyArgs.push_back(VariableSchema(TypeSchema("MainFamily&"), "e"));
-			stratImpl = "invokeParallel([this, &" + methodArgName + "] (auto& e) { static_cast<T*>(this)->" + methodName + "(" + methodArgName + ", e); }, mainFamily);";
+			const String affinity = system.affinity == SystemAffinity::Sticky ? "Halley::ParallelAffinity::Sticky" : "Halley::ParallelAffinity::Any";
+			if (system.smearing > 1) {
+				stratImpl = "invokeSmearedParallel([this] (auto& e, Halley::Time elapsed) { static_cast<T*>(this)->" + methodName + "(elapsed, e); }, mainFamily, " + toString(system.smearing) + ", " + methodArgName + ", " + toString(system.grainSize) + ", " + affinity + ");";
+			} else {
+				stratImpl = "invokeParallel([this, &" + methodArgName + "] (auto& e) { static_cast<T*>(this)->" + methodName + "(" + methodArgName + ", e); }, mainFamily, " + toString(system.grainSize) + ", " + affinity + ");";
+			}
 		} else {
 			throw Exception("Unsupported strategy in " + system.name + "System", HalleyExceptions::Tools);
 		}
+
+		if (system.method == SystemMethod::Render) {
+			// Each render system's GPU time is a scope of its own, see Painter::beginGPUScope
+			stratImpl = "rc.beginGPUScope(getName()); " + stratImpl + " rc.endGPUScope();";
+		}
 	}
 
 	String methodName;
@@ -291,7 +391,8 @@ Vector<String> CodegenCPP::generateSystemHeader(SystemSchema& system) const
 				.addBlankLine()
 				.addTypeDefinition("Type", "Halley::FamilyType<" + String::concatList(convert<ComponentReferenceSchema, String>(fam.components, [](auto& comp)
 				{
-					return comp.optional ? "Halley::MaybeRef<" + comp.name + "Component>" : comp.name + "Component";
+					String type = (comp.write ? "" : "const ") + comp.name + "Component";
+					return comp.optional ? "Halley::MaybeRef<" + type + ">" : type;
 				}), ", ") + ">")
 				.addBlankLine()
 				.addAccessLevelSection(CPPAccess::Protected)
@@ -315,8 +416,10 @@ Vector<String> CodegenCPP::generateSystemHeader(SystemSchema& system) const
 	// Receive messages
 	bool hasReceive = false;
 	Vector<String> msgsReceived;
+	Vector<String> msgsSent;
 	for (auto& msg : system.messages) {
 		if (msg.send) {
+			msgsSent.push_back(msg.name + "Message::messageIndex");
 			sysClassGen.addMethodDefinition(MethodSchema(TypeSchema("void"), { VariableSchema(TypeSchema("Halley::EntityId"), "entityId"), VariableSchema(TypeSchema(msg.name + "Message&", true), "msg") }, "sendMessage"), "sendMessageGeneric(entityId, msg);");
 		}
 		if (msg.receive) {
@@ -374,9 +477,17 @@ Vector<String> CodegenCPP::generateSystemHeader(SystemSchema& system) const
 			.addBlankLine();
 	}
 
+	// Systems that can reach the world or the API may have side effects the scheduler can't see
+	String concurrency = "Halley::SystemConcurrency::Any";
+	if (system.access != SystemAccess::Pure) {
+		concurrency = "Halley::SystemConcurrency::Exclusive";
+	} else if (system.strategy == SystemStrategy::Parallel) {
+		concurrency = "Halley::SystemConcurrency::CallingThread";
+	}
+
 	sysClassGen
 		.addAccessLevelSection(CPPAccess::Public)
-		.addCustomConstructor({}, { VariableSchema(TypeSchema(""), "System", "{" + String::concatList(convert<FamilySchema, String>(system.families, [](auto& fam) { return "&" + fam.name + "Family"; }), ", ") + "}, {" + String::concatList(msgsReceived, ", ") + "}") })
+		.addCustomConstructor({}, { VariableSchema(TypeSchema(""), "System", "{" + String::concatList(convert<FamilySchema, String>(system.families, [](auto& fam) { return "&" + fam.name + "Family"; }), ", ") + "}, {" + String::concatList(msgsReceived, ", ") + "}, {" + String::concatList(msgsSent, ", ") + "}, " + concurrency) })
 		.finish()
 		.writeTo(contents);
 
@@ -448,8 +559,14 @@ Vector<String> CodegenCPP::generateMessageHeader(MessageSchema message)
 			.addBlankLine();
 	}
 
-	gen.addMethodDefinition(MethodSchema(TypeSchema("size_t"), {}, "getSize", true, false, true, true), "return sizeof(" + message.name + "Message);")
-		.finish()
+	gen.addMethodDefinition(MethodSchema(TypeSchema("size_t"), {}, "getSize", true, false, true, true), "return sizeof(" + message.name + "Message);");
+
+	if (needsSerializers(message.serializable, message.memberSerialization)) {
+		gen.addBlankLine();
+		addSerializers(gen, message.members, message.memberSerialization);
+	}
+
+	gen.finish()
 		.writeTo(contents);
 
 	return contents;
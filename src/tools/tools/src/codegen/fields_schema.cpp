@@ -0,0 +1,45 @@
+#include "../yaml/halley-yamlcpp.h"
+#include <halley/support/exception.h>
+#include <halley/tools/codegen/fields_schema.h>
+
+using namespace Halley;
+
+void MemberSerializationSchema::parseMembers(YAML::Node node, Vector<VariableSchema>& members, Vector<MemberSerializationSchema>& serialization, const String& owner)
+{
+	for (auto memberEntry : node) {
+		for (auto m = memberEntry.begin(); m != memberEntry.end(); ++m) {
+			const String memberName = m->first.as<std::string>();
+			MemberSerializationSchema ser;
+
+			if (m->second.IsMap()) {
+				members.emplace_back(VariableSchema(TypeSchema(m->second["type"].as<std::string>()), memberName));
+
+				ser.bits = m->second["bits"].as<int>(0);
+				ser.version = m->second["version"].as<int>(0);
+				if (ser.bits < 0 || ser.bits > 64) {
+					throw Exception("Member " + memberName + " of " + owner + " must have between 1 and 64 bits", HalleyExceptions::Tools);
+				}
+
+				auto range = m->second["range"];
+				if (range.IsDefined()) {
+					if (!range.IsSequence() || range.size() != 2) {
+						throw Exception("Range of member " + memberName + " of " + owner + " must be [min, max]", HalleyExceptions::Tools);
+					}
+					if (ser.bits == 0) {
+						throw Exception("Member " + memberName + " of " + owner + " has a range, but no bits to quantize it into", HalleyExceptions::Tools);
+					}
+					ser.quantized = true;
+					ser.rangeMin = range[0].as<std::string>();
+					ser.rangeMax = range[1].as<std::string>();
+					if (range[0].as<double>() >= range[1].as<double>()) {
+						throw Exception("Range of member " + memberName + " of " + owner + " is empty", HalleyExceptions::Tools);
+					}
+				}
+			} else {
+				members.emplace_back(VariableSchema(TypeSchema(m->second.as<std::string>()), memberName));
+			}
+
+			serialization.push_back(ser);
+		}
+	}
+}
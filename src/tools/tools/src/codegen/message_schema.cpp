@@ -9,9 +9,7 @@ MessageSchema::MessageSchema(YAML::Node node)
 {
 	name = node["name"].as<std::string>();
 
-	for (auto memberEntry : node["members"]) {
-		for (auto m = memberEntry.begin(); m != memberEntry.end(); ++m) {
-			members.emplace_back(VariableSchema(TypeSchema(m->second.as<std::string>()), m->first.as<std::string>()));
-		}
-	}
+	MemberSerializationSchema::parseMembers(node["members"], members, memberSerialization, name);
+
+	serializable = node["serializable"].as<bool>(false);
 }
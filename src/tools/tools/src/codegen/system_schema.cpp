@@ -1,5 +1,6 @@
 #include "../yaml/halley-yamlcpp.h"
 #include <halley/support/exception.h>
+#include <halley/text/string_converter.h>
 #include <halley/tools/codegen/system_schema.h>
 
 using namespace Halley;
@@ -79,7 +80,31 @@ SystemSchema::SystemSchema(YAML::Node node)
 		}
 	}
 
+	if (node["grainSize"].IsDefined() || node["affinity"].IsDefined()) {
+		if (strategy != SystemStrategy::Parallel) {
+			throw Exception("grainSize and affinity only apply to systems with the parallel strategy.", HalleyExceptions::Resources);
+		}
+		grainSize = node["grainSize"].as<int>(0);
+		if (grainSize < 0) {
+			throw Exception("Invalid grainSize: " + toString(grainSize), HalleyExceptions::Resources);
+		}
+		String affinityStr = node["affinity"].as<std::string>("any");
+		if (affinityStr == "any") {
+			affinity = SystemAffinity::Any;
+		} else if (affinityStr == "sticky") {
+			affinity = SystemAffinity::Sticky;
+		} else {
+			throw Exception("Unknown affinity type: " + affinityStr, HalleyExceptions::Resources);
+		}
+	}
+
 	smearing = node["smearing"].as<int>(1);
+	if (smearing < 1) {
+		throw Exception("Invalid smearing: " + toString(smearing), HalleyExceptions::Resources);
+	}
+	if (smearing > 1 && (method != SystemMethod::Update || strategy == SystemStrategy::Global)) {
+		throw Exception("smearing only applies to update systems with the individual or parallel strategy.", HalleyExceptions::Resources);
+	}
 
 	if (node["access"].IsDefined()) {
 		int accessValue = 0;
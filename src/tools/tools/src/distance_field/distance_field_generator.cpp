@@ -1,7 +1,10 @@
 #include "halley/tools/distance_field/distance_field_generator.h"
 #include <cassert>
 #include <halley/file_formats/image.h>
+#include <halley/concurrency/concurrent.h>
 #include <gsl/gsl_assert>
+#include <limits>
+#include <numeric>
 
 using namespace Halley;
 
@@ -38,7 +41,155 @@ static float getDistanceAt(const int* src, int srcW, int srcH, int xCentre, int
 	return finalValue;
 }
 
-std::unique_ptr<Image> DistanceFieldGenerator::generate(Image& srcImg, Vector2i size, float radius)
+static float getDistanceValue(float distSqr, bool isInside, float radius)
+{
+	if (radius < 0.001f) {
+		return isInside ? 1.0f : 0.0f;
+	}
+
+	const float dist = std::sqrt(distSqr);
+	const float normalDistance = (2 * dist - 1) / (2 * radius);
+	return clamp(0.5f * (isInside ? 1.0f + normalDistance : 1.0f - normalDistance), 0.0f, 1.0f);
+}
+
+// Squared distance from each sample to the lower envelope of the parabolas (q - p)^2 + f(p), in O(n).
+// From Felzenszwalb and Huttenlocher, "Distance Transforms of Sampled Functions"; v and z are scratch space.
+static void distanceTransform1D(const float* f, float* d, int n, Vector<int>& v, Vector<float>& z)
+{
+	constexpr float inf = std::numeric_limits<float>::infinity();
+	v.resize(n);
+	z.resize(n + 1);
+
+	int k = -1;
+	for (int q = 0; q < n; ++q) {
+		if (f[q] == inf) {
+			continue;
+		}
+
+		float s = 0;
+		while (k >= 0) {
+			const int p = v[k];
+			s = ((f[q] + float(q * q)) - (f[p] + float(p * p))) / float(2 * (q - p));
+			if (s > z[k]) {
+				break;
+			}
+			--k;
+		}
+		++k;
+		v[k] = q;
+		z[k] = k == 0 ? -inf : s;
+		z[k + 1] = inf;
+	}
+
+	if (k < 0) {
+		std::fill(d, d + n, inf);
+		return;
+	}
+
+	int j = 0;
+	for (int q = 0; q < n; ++q) {
+		while (z[j + 1] < float(q)) {
+			++j;
+		}
+		const int p = v[j];
+		d[q] = float((q - p) * (q - p)) + f[p];
+	}
+}
+
+// Squared distance from every pixel to the closest one where inside[i] == target
+static Vector<float> getSquaredDistances(const Vector<char>& inside, int w, int h, char target)
+{
+	constexpr float inf = std::numeric_limits<float>::infinity();
+	Vector<float> result(size_t(w) * size_t(h));
+
+	Vector<int> columns(w);
+	std::iota(columns.begin(), columns.end(), 0);
+	Concurrent::foreach(columns.begin(), columns.end(), [&] (int x)
+	{
+		Vector<float> f(h);
+		Vector<float> d(h);
+		Vector<int> v;
+		Vector<float> z;
+		for (int y = 0; y < h; ++y) {
+			f[y] = inside[x + y * w] == target ? 0.0f : inf;
+		}
+		distanceTransform1D(f.data(), d.data(), h, v, z);
+		for (int y = 0; y < h; ++y) {
+			result[x + y * w] = d[y];
+		}
+	});
+
+	Vector<int> rows(h);
+	std::iota(rows.begin(), rows.end(), 0);
+	Concurrent::foreach(rows.begin(), rows.end(), [&] (int y)
+	{
+		Vector<float> f(result.begin() + y * w, result.begin() + (y + 1) * w);
+		Vector<int> v;
+		Vector<float> z;
+		distanceTransform1D(f.data(), result.data() + y * w, w, v, z);
+	});
+
+	return result;
+}
+
+std::unique_ptr<Image> DistanceFieldGenerator::generate(Image& srcImg, Vector2i size, float radius, Mode mode)
+{
+	switch (mode) {
+	case Mode::Exact:
+		return generateExact(srcImg, size, radius);
+	default:
+		return generateBruteForce(srcImg, size, radius);
+	}
+}
+
+std::unique_ptr<Image> DistanceFieldGenerator::generateExact(Image& srcImg, Vector2i size, float radius)
+{
+	Expects(srcImg.getPixels() != nullptr);
+	const int srcW = srcImg.getWidth();
+	const int srcH = srcImg.getHeight();
+	const int* src = reinterpret_cast<int*>(srcImg.getPixels());
+
+	Vector<char> inside(size_t(srcW) * size_t(srcH));
+	for (size_t i = 0; i < inside.size(); ++i) {
+		inside[i] = ((src[i] & 0xFF000000) >> 24) > 127 ? 1 : 0;
+	}
+
+	// Unlike the brute force search, this isn't limited to a window around each sample; anything past the radius saturates
+	const auto distToOutside = getSquaredDistances(inside, srcW, srcH, 0);
+	const auto distToInside = getSquaredDistances(inside, srcW, srcH, 1);
+
+	auto dstImg = std::make_unique<Image>(Image::Format::RGBA, size);
+
+	const int w = size.x;
+	const int h = size.y;
+	int* dstStart = reinterpret_cast<int*>(dstImg->getPixels());
+
+	const int texelW = srcW / w;
+	const int texelH = srcH / h;
+	const float srcRadius = radius * srcW / w;
+
+	Vector<int> rows(h);
+	std::iota(rows.begin(), rows.end(), 0);
+	Concurrent::foreach(rows.begin(), rows.end(), [&] (int y)
+	{
+		for (int x = 0; x < w; x++) {
+			float distAcc = 0;
+			for (int j = 0; j < texelH; j++) {
+				for (int i = 0; i < texelW; i++) {
+					const size_t idx = size_t(x * srcW / w + i) + size_t(y * srcH / h + j) * size_t(srcW);
+					const bool isInside = inside[idx] != 0;
+					distAcc += getDistanceValue(isInside ? distToOutside[idx] : distToInside[idx], isInside, srcRadius);
+				}
+			}
+			int distance = clamp(int(distAcc * 255 / (texelW * texelH)), 0, 255);
+			dstStart[x + y * w] = Image::convertRGBAToInt(255, 255, 255, distance);
+		}
+	});
+
+	return dstImg;
+}
+
+std::unique_ptr<Image> DistanceFieldGenerator::generateBruteForce(Image& srcImg, Vector2i size, float radius)
 {
 	Expects(srcImg.getPixels() != nullptr);
 	const int srcW = srcImg.getWidth();
@@ -9,8 +9,8 @@ using namespace Halley;
 
 int DistanceFieldTool::run(Vector<std::string> args)
 {
-	if (args.size() != 4) {
-		std::cout << "Usage: halley-cmd distField srcFile dstFile WxH radius" << std::endl;
+	if (args.size() != 4 && args.size() != 5) {
+		std::cout << "Usage: halley-cmd distField srcFile dstFile WxH radius [bruteForce|exact]" << std::endl;
 		return 1;
 	}
 
@@ -18,13 +18,22 @@ int DistanceFieldTool::run(Vector<std::string> args)
 	auto res = String(args[2]).split('x');
 	Vector2i size(res[0].toInteger(), res[1].toInteger());
 	float radius = String(args[3]).toFloat();
+	auto mode = DistanceFieldGenerator::Mode::BruteForce;
+	if (args.size() == 5) {
+		if (args[4] == "exact") {
+			mode = DistanceFieldGenerator::Mode::Exact;
+		} else if (args[4] != "bruteForce") {
+			std::cout << "Unknown mode: " << args[4] << std::endl;
+			return 1;
+		}
+	}
 
 	// Load image
 	auto data = ResourceDataStatic::loadFromFileSystem(args[0]);
 	auto inputImg = std::make_unique<Image>(*data);
 
 	// Process image
-	auto result = DistanceFieldGenerator::generate(*inputImg, size, radius);
+	auto result = DistanceFieldGenerator::generate(*inputImg, size, radius, mode);
 	inputImg.reset();
 
 	// Output image
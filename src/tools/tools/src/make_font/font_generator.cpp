@@ -2,6 +2,8 @@
 #include <future>
 #include <cstdint>
 #include <atomic>
+#include <map>
+#include <numeric>
 
 #include "halley/tools/make_font/font_generator.h"
 #include "halley/tools/distance_field/distance_field_generator.h"
@@ -12,24 +14,176 @@
 #include "halley/concurrency/concurrent.h"
 #include "halley/tools/file/filesystem.h"
 #include "halley/core/graphics/text/font.h"
+#include "halley/utils/hash.h"
 
 using namespace Halley;
 
-static boost::optional<Vector<BinPackResult>> tryPacking(FontFace& font, float fontSize, Vector2i packSize, float scale, float borderSuperSampled, const std::vector<int>& characters)
+namespace {
+	// FreeType faces can't be shared between threads, so each worker borrows its own
+	class FontFacePool
+	{
+	public:
+		class Lease
+		{
+		public:
+			Lease(FontFacePool& pool, std::unique_ptr<FontFace> face)
+				: pool(pool)
+				, face(std::move(face))
+			{}
+
+			Lease(Lease&& other) = default;
+
+			~Lease()
+			{
+				if (face) {
+					pool.release(std::move(face));
+				}
+			}
+
+			FontFace& operator*() const { return *face; }
+			FontFace* operator->() const { return face.get(); }
+
+		private:
+			FontFacePool& pool;
+			std::unique_ptr<FontFace> face;
+		};
+
+		explicit FontFacePool(gsl::span<const gsl::byte> fontFile)
+			: fontFile(fontFile)
+		{}
+
+		void setSize(float size)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			fontSize = size;
+			for (auto& f: freeFaces) {
+				f->setSize(size);
+			}
+		}
+
+		Lease acquire()
+		{
+			std::unique_ptr<FontFace> face;
+			float size;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				size = fontSize;
+				if (!freeFaces.empty()) {
+					face = std::move(freeFaces.back());
+					freeFaces.pop_back();
+				}
+			}
+			if (!face) {
+				face = std::make_unique<FontFace>(fontFile);
+				face->setSize(size);
+			}
+			return Lease(*this, std::move(face));
+		}
+
+	private:
+		gsl::span<const gsl::byte> fontFile;
+		float fontSize = 0;
+		std::mutex mutex;
+		std::vector<std::unique_ptr<FontFace>> freeFaces;
+
+		void release(std::unique_ptr<FontFace> face)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			freeFaces.push_back(std::move(face));
+		}
+	};
+
+	// Finished glyphs, so that importing the same font again with a few more characters only renders the new ones
+	class GlyphImageCache
+	{
+	public:
+		struct Key
+		{
+			uint64_t fontHash;
+			int fontSize;
+			float radius;
+			int superSample;
+			int mode;
+			int charcode;
+
+			bool operator<(const Key& other) const
+			{
+				return std::tie(fontHash, fontSize, radius, superSample, mode, charcode) < std::tie(other.fontHash, other.fontSize, other.radius, other.superSample, other.mode, other.charcode);
+			}
+		};
+
+		static GlyphImageCache& get()
+		{
+			static GlyphImageCache cache;
+			return cache;
+		}
+
+		std::shared_ptr<Image> find(const Key& key)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			const auto iter = glyphs.find(key);
+			return iter != glyphs.end() ? iter->second : std::shared_ptr<Image>();
+		}
+
+		void store(const Key& key, std::shared_ptr<Image> image)
+		{
+			const size_t bytes = image->getByteSize();
+			std::lock_guard<std::mutex> lock(mutex);
+			if (totalBytes + bytes > maxBytes) {
+				glyphs.clear();
+				totalBytes = 0;
+			}
+			auto& entry = glyphs[key];
+			if (!entry) {
+				totalBytes += bytes;
+			}
+			entry = std::move(image);
+		}
+
+	private:
+		constexpr static size_t maxBytes = 512 * 1024 * 1024;
+
+		std::mutex mutex;
+		std::map<Key, std::shared_ptr<Image>> glyphs;
+		size_t totalBytes = 0;
+	};
+}
+
+static std::vector<std::pair<int, Vector2i>> getGlyphSizes(FontFacePool& faces, float fontSize, const std::vector<int>& characters)
 {
-	font.setSize(fontSize);
+	faces.setSize(fontSize);
+
+	std::vector<int> codes;
+	{
+		auto font = faces.acquire();
+		for (int code : font->getCharCodes()) {
+			if (std::binary_search(characters.begin(), characters.end(), code)) {
+				codes.push_back(code);
+			}
+		}
+	}
+
+	// Loading every glyph is slow for big fonts, and this gets done for each size tried
+	std::vector<std::pair<int, Vector2i>> result(codes.size());
+	Concurrent::foreach(Executors::getCPU(), codes.begin(), codes.end(), [&] (const int& code)
+	{
+		auto font = faces.acquire();
+		result[&code - codes.data()] = std::make_pair(code, font->getGlyphSize(code));
+	});
+	return result;
+}
 
+static boost::optional<Vector<BinPackResult>> tryPacking(const std::vector<std::pair<int, Vector2i>>& glyphSizes, Vector2i packSize, float scale, float borderSuperSampled)
+{
 	Vector<BinPackEntry> entries;
-	for (int code : font.getCharCodes()) {
-		if (std::binary_search(characters.begin(), characters.end(), code)) {
-			Vector2i glyphSize = font.getGlyphSize(code);
-			int padding = int(2 * borderSuperSampled);
-			Vector2i superSampleSize = glyphSize + Vector2i(padding, padding);
-			Vector2i finalSize(Vector2f(superSampleSize) * scale + Vector2f(1, 1));
-
-			size_t payload = size_t(code);
-			entries.push_back(BinPackEntry(finalSize, reinterpret_cast<void*>(payload)));
-		}
+	for (auto& glyph : glyphSizes) {
+		Vector2i glyphSize = glyph.second;
+		int padding = int(2 * borderSuperSampled);
+		Vector2i superSampleSize = glyphSize + Vector2i(padding, padding);
+		Vector2i finalSize(Vector2f(superSampleSize) * scale + Vector2f(1, 1));
+
+		size_t payload = size_t(glyph.first);
+		entries.push_back(BinPackEntry(finalSize, reinterpret_cast<void*>(payload)));
 	}
 
 	constexpr bool fastPack = true;
@@ -84,7 +238,7 @@ FontGeneratorResult FontGenerator::generateFont(const Metadata& meta, gsl::span<
 		return FontGeneratorResult();
 	}
 
-	FontFace font(fontFile);
+	FontFacePool faces(fontFile);
 
 	int fontSize = 0;
 	Vector2i imageSize;
@@ -92,12 +246,13 @@ FontGeneratorResult FontGenerator::generateFont(const Metadata& meta, gsl::span<
 
 	if (sizeInfo.fontSize) {
 		fontSize = int(sizeInfo.fontSize.get());
+		const auto glyphSizes = getGlyphSizes(faces, float(fontSize), characters);
 
 		constexpr int minSize = 16;
 		constexpr int maxSize = 4096;
 		for (int i = 0; i < (2 * fastLog2Floor(uint32_t(maxSize / minSize))); ++i) {
 			auto curSize = Vector2i(minSize << ((i + 1) / 2), minSize << (i / 2));
-			result = tryPacking(font, float(fontSize), curSize, scale, borderSuperSample, characters);
+			result = tryPacking(glyphSizes, curSize, scale, borderSuperSample);
 			if (result) {
 				imageSize = curSize;
 				break;
@@ -113,7 +268,7 @@ FontGeneratorResult FontGenerator::generateFont(const Metadata& meta, gsl::span<
 		constexpr int maxFont = 1000;
 		result = binarySearch([&](int curFontSize) -> boost::optional<Vector<BinPackResult>>
 		{
-			return tryPacking(font, float(curFontSize), imageSize, scale, borderSuperSample, characters);
+			return tryPacking(getGlyphSizes(faces, float(curFontSize), characters), imageSize, scale, borderSuperSample);
 		}, minFont, maxFont, fontSize);
 	} else {
 		throw Exception("Neither font size nor image size were specified", HalleyExceptions::Tools);
@@ -122,7 +277,7 @@ FontGeneratorResult FontGenerator::generateFont(const Metadata& meta, gsl::span<
 	if (!result) {
 		throw Exception("Unable to generate font", HalleyExceptions::Tools);
 	}
-	font.setSize(float(fontSize));
+	faces.setSize(float(fontSize));
 	
 	if (!progressReporter(0.1f, "Encoding")) {
 		return FontGeneratorResult();
@@ -132,11 +287,12 @@ FontGeneratorResult FontGenerator::generateFont(const Metadata& meta, gsl::span<
 	dstImg->clear(0);
 
 	Vector<CharcodeEntry> codes;
-	Vector<Future<void>> futures;
-	std::mutex m;
 	std::atomic<int> nDone(0);
 	std::atomic<bool> keepGoing(true);
 
+	const auto mode = meta.getString("distanceField", "bruteForce") == "exact" ? DistanceFieldGenerator::Mode::Exact : DistanceFieldGenerator::Mode::BruteForce;
+	const uint64_t fontHash = Hash::hash(fontFile);
+
 	auto& pack = result.get();
 	if (verbose) {
 		std::cout << "Rendering " << pack.size() << " glyphs";
@@ -144,50 +300,63 @@ FontGeneratorResult FontGenerator::generateFont(const Metadata& meta, gsl::span<
 
 	for (auto& r : pack) {
 		int charcode = int(reinterpret_cast<size_t>(r.data));
-		Rect4i dstRect = r.rect;
-		Rect4i srcRect = dstRect * superSample;
-		codes.push_back(CharcodeEntry(charcode, dstRect));
+		codes.push_back(CharcodeEntry(charcode, r.rect));
+	}
 
-		futures.push_back(Concurrent::execute([=, &m, &font, &dstImg, &nDone, &keepGoing] {
-			if (!keepGoing) {
-				return;
-			}
+	std::vector<std::exception_ptr> errors(pack.size());
+	Concurrent::foreach(Executors::getCPU(), pack.begin(), pack.end(), [&] (const BinPackResult& r) {
+		if (!keepGoing) {
+			return;
+		}
 
-			if (verbose) {
-				std::cout << "+";
-			}
+		if (verbose) {
+			std::cout << "+";
+		}
 
-			auto tmpImg = std::make_unique<Image>(Image::Format::RGBA, srcRect.getSize());
-			tmpImg->clear(0);
-			{
-				std::lock_guard<std::mutex> g(m);
-				font.drawGlyph(*tmpImg, charcode, Vector2i(lround(borderSuperSample), lround(borderSuperSample)));
+		const int charcode = int(reinterpret_cast<size_t>(r.data));
+		const Rect4i dstRect = r.rect;
+		const GlyphImageCache::Key key{ fontHash, fontSize, radius, superSample, int(mode), charcode };
+
+		try {
+			auto finalGlyphImg = GlyphImageCache::get().find(key);
+			if (!finalGlyphImg || finalGlyphImg->getSize() != dstRect.getSize()) {
+				const Rect4i srcRect = dstRect * superSample;
+				auto tmpImg = std::make_unique<Image>(Image::Format::RGBA, srcRect.getSize());
+				tmpImg->clear(0);
+				faces.acquire()->drawGlyph(*tmpImg, charcode, Vector2i(lround(borderSuperSample), lround(borderSuperSample)));
+
+				if (!keepGoing) {
+					return;
+				}
+				finalGlyphImg = DistanceFieldGenerator::generate(*tmpImg, dstRect.getSize(), radius, mode);
+				GlyphImageCache::get().store(key, finalGlyphImg);
 			}
 
-			if (!keepGoing) {
-				return;
-			}
-			auto finalGlyphImg = DistanceFieldGenerator::generate(*tmpImg, dstRect.getSize(), radius);
+			// Each glyph has its own rect, so they can all be written at once
 			dstImg->blitFrom(dstRect.getTopLeft(), *finalGlyphImg);
+		} catch (...) {
+			errors[&r - pack.data()] = std::current_exception();
+			keepGoing = false;
+			return;
+		}
 
-			tmpImg.reset();
-			finalGlyphImg.reset();
-
-			if (verbose) {
-				std::cout << "-";
-			}
-			float progress = lerp(0.1f, 0.95f, float(++nDone) / float(pack.size()));
-				
-			if (!progressReporter(progress, "Generating")) {
-				keepGoing = false;
-			}
-		}));
-	}
+		if (verbose) {
+			std::cout << "-";
+		}
+		float progress = lerp(0.1f, 0.95f, float(++nDone) / float(pack.size()));
+			
+		if (!progressReporter(progress, "Generating")) {
+			keepGoing = false;
+		}
+	}, 1);
 	std::sort(codes.begin(), codes.end(), [](const CharcodeEntry& a, const CharcodeEntry& b) { return a.charcode < b.charcode; });
 
-	for (auto& f : futures) {
-		f.get();
+	for (auto& e: errors) {
+		if (e) {
+			std::rethrow_exception(e);
+		}
 	}
+
 	if (!keepGoing) {
 		return FontGeneratorResult();
 	}
@@ -201,7 +370,7 @@ FontGeneratorResult FontGenerator::generateFont(const Metadata& meta, gsl::span<
 
 	FontGeneratorResult genResult;
 	genResult.success = true;
-	genResult.font = generateFontMapBinary(meta, font, codes, scale, sizeInfo.replacementScale, radius, imageSize);
+	genResult.font = generateFontMapBinary(meta, *faces.acquire(), codes, scale, sizeInfo.replacementScale, radius, imageSize);
 	genResult.image = std::move(dstImg);
 	genResult.imageMeta = generateTextureMeta();
 	progressReporter(1.0f, "Done");
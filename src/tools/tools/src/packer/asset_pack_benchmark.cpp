@@ -0,0 +1,423 @@
+#include "halley/tools/packer/asset_pack_benchmark.h"
+#include "halley/core/resources/asset_pack.h"
+#include "halley/core/graphics/sprite/animation.h"
+#include "halley/core/graphics/sprite/sprite_sheet.h"
+#include "halley/audio/audio_clip.h"
+#include "halley/audio/audio_event.h"
+#include "halley/file_formats/binary_file.h"
+#include "halley/file_formats/config_file.h"
+#include "halley/file_formats/image.h"
+#include "halley/file_formats/text_file.h"
+#include "halley/text/string_table.h"
+#include "halley/text/string_converter.h"
+#include "halley/bytes/byte_serializer.h"
+#include "halley/utils/encrypt.h"
+#include "halley/time/stopwatch.h"
+#include "halley/support/console.h"
+#include "halley/support/logger.h"
+#include "halley/os/os.h"
+#include <fstream>
+#include <iomanip>
+
+using namespace Halley;
+
+namespace {
+	// Reads the pack like the game does when it isn't preloaded or memory mapped
+	class FileDataReader : public ResourceDataReader {
+	public:
+		explicit FileDataReader(const Path& path)
+			: stream(path.string(), std::ios::binary)
+		{
+			if (!stream.is_open()) {
+				throw Exception("Unable to open \"" + path.string() + "\"", HalleyExceptions::Tools);
+			}
+			stream.seekg(0, std::ios::end);
+			fileSize = size_t(stream.tellg());
+			stream.seekg(0, std::ios::beg);
+		}
+
+		size_t size() const override
+		{
+			return fileSize;
+		}
+
+		int read(gsl::span<gsl::byte> dst) override
+		{
+			stream.read(reinterpret_cast<char*>(dst.data()), dst.size());
+			return int(stream.gcount());
+		}
+
+		void seek(int64_t pos, int whence) override
+		{
+			stream.clear();
+			stream.seekg(pos, whence == SEEK_SET ? std::ios::beg : (whence == SEEK_CUR ? std::ios::cur : std::ios::end));
+		}
+
+		size_t tell() const override
+		{
+			return size_t(stream.tellg());
+		}
+
+		void close() override
+		{
+			stream.close();
+		}
+
+	private:
+		mutable std::ifstream stream;
+		size_t fileSize = 0;
+	};
+}
+
+// Only there to give loaders the metadata of the asset being deserialized; its data has already been fetched
+class AssetPackBenchmark::Locator : public IResourceLocator {
+public:
+	explicit Locator(AssetPack& pack)
+		: pack(pack)
+	{}
+
+	void setCurrent(const Asset& asset)
+	{
+		current = &asset;
+	}
+
+	const Metadata& getMetaData(const String& resource, AssetType type) const override
+	{
+		Expects(current && current->name == resource && current->type == type);
+		return current->entry.meta;
+	}
+
+	// Not used by the loaders benchmarked, as their data is given to them, but there for completeness
+	std::unique_ptr<ResourceDataStatic> getStatic(const String& asset, AssetType type) override
+	{
+		return std::unique_ptr<ResourceDataStatic>(dynamic_cast<ResourceDataStatic*>(pack.getData(asset, type, false).release()));
+	}
+
+	std::unique_ptr<ResourceDataStream> getStream(const String& asset, AssetType type) override
+	{
+		return std::unique_ptr<ResourceDataStream>(dynamic_cast<ResourceDataStream*>(pack.getData(asset, type, true).release()));
+	}
+
+private:
+	AssetPack& pack;
+	const Asset* current = nullptr;
+};
+
+void AssetPackBenchmark::Timing::add(uint64_t b, int64_t ns)
+{
+	bytes += b;
+	nanoSeconds += ns;
+	++count;
+}
+
+double AssetPackBenchmark::Timing::getMegabytesPerSecond() const
+{
+	return nanoSeconds > 0 ? (double(bytes) / (1024.0 * 1024.0)) / (double(nanoSeconds) / 1000000000.0) : 0.0;
+}
+
+void AssetPackBenchmark::Results::keepBest(const Results& other)
+{
+	// Per type and step, as each has its own noise
+	auto keep = [] (std::array<Timing, numPhases>& cur, const std::array<Timing, numPhases>& o)
+	{
+		for (size_t i = 0; i < numPhases; ++i) {
+			if (cur[i].count == 0 || (o[i].count > 0 && o[i].nanoSeconds < cur[i].nanoSeconds)) {
+				cur[i] = o[i];
+			}
+		}
+	};
+	for (auto& t: other.byType) {
+		keep(byType[t.first], t.second);
+	}
+	keep(total, other.total);
+}
+
+AssetPackBenchmark::AssetPackBenchmark(Path path, String encryptionKey)
+	: path(std::move(path))
+	, encryptionKey(std::move(encryptionKey))
+{
+}
+
+AssetPackBenchmark::~AssetPackBenchmark() = default;
+
+AssetPackBenchmark::Results AssetPackBenchmark::run(bool cold)
+{
+	Results results;
+	results.cold = cold;
+	if (cold) {
+		results.evicted = OS::get().evictFileCache(path);
+	}
+
+	// The header says whether it's encrypted, and how
+	auto reader = std::make_unique<FileDataReader>(path);
+	AssetPackHeader header;
+	if (reader->read(gsl::as_writeable_bytes(gsl::span<AssetPackHeader>(&header, 1))) != int(sizeof(header))) {
+		throw Exception("Asset pack \"" + path.string() + "\" is invalid (too small)", HalleyExceptions::Tools);
+	}
+	reader->seek(0, SEEK_SET);
+	const bool counterMode = memcmp(header.identifier.data(), "HALLEYPC", 8) == 0;
+	const bool encrypted = !encryptionKey.isEmpty() && std::any_of(header.iv.begin(), header.iv.end(), [] (char c) { return c != 0; });
+
+	// Opened without the key, as decryption is timed here rather than left to the pack
+	AssetPack pack(std::move(reader));
+	std::unique_ptr<Encrypt::CounterMode> cipher;
+	if (encrypted && counterMode) {
+		cipher = std::make_unique<Encrypt::CounterMode>(Bytes(header.iv.begin(), header.iv.end()), encryptionKey);
+	} else if (encrypted) {
+		// CBC packs can only be read and decrypted whole, when they're loaded
+		Stopwatch readTime;
+		pack.readToMemory();
+		results.total[size_t(Phase::Read)].add(pack.getData().size(), readTime.elapsedNanoSeconds());
+
+		Stopwatch decryptTime;
+		pack.decrypt(encryptionKey);
+		results.total[size_t(Phase::Decrypt)].add(pack.getData().size(), decryptTime.elapsedNanoSeconds());
+	}
+
+	std::vector<Asset> assets;
+	auto& db = pack.getAssetDatabase();
+	for (auto type: db.getTypes()) {
+		db.getDatabase(type).forEach([&] (const String& name, const AssetDatabase::Entry& entry)
+		{
+			assets.push_back(Asset{ type, name, entry });
+		});
+	}
+
+	// In pack order, so a cold read is as sequential as the game's would be at best
+	std::sort(assets.begin(), assets.end(), [] (const Asset& a, const Asset& b)
+	{
+		return a.entry.path.split(':').at(0).toInteger64() < b.entry.path.split(':').at(0).toInteger64();
+	});
+
+	Locator locator(pack);
+	for (auto& asset: assets) {
+		loadAsset(pack, locator, asset, cipher.get(), results);
+	}
+
+	return results;
+}
+
+void AssetPackBenchmark::loadAsset(AssetPack& pack, Locator& locator, const Asset& asset, const Encrypt::CounterMode* cipher, Results& results)
+{
+	auto& timings = results.byType[asset.type];
+	auto addTiming = [&] (Phase phase, uint64_t bytes, int64_t ns)
+	{
+		timings[size_t(phase)].add(bytes, ns);
+		results.total[size_t(phase)].add(bytes, ns);
+	};
+
+	const auto splitPath = asset.entry.path.split(':');
+	const size_t pos = size_t(splitPath.at(0).toInteger64());
+	const size_t size = size_t(splitPath.at(1).toInteger64());
+
+	std::unique_ptr<ResourceDataStatic> data;
+	if (pack.getData().empty()) {
+		auto buffer = new char[size];
+		data = std::make_unique<ResourceDataStatic>(buffer, size, asset.name, true);
+		const auto span = gsl::as_writeable_bytes(gsl::span<char>(buffer, size));
+
+		Stopwatch readTime;
+		pack.readData(pos, span);
+		addTiming(Phase::Read, size, readTime.elapsedNanoSeconds());
+
+		if (cipher) {
+			Stopwatch decryptTime;
+			cipher->apply(span, pos);
+			addTiming(Phase::Decrypt, size, decryptTime.elapsedNanoSeconds());
+		}
+	} else {
+		// Already in memory, each asset is then referenced in place
+		data = std::unique_ptr<ResourceDataStatic>(dynamic_cast<ResourceDataStatic*>(pack.getData(asset.name, asset.type, false).release()));
+	}
+
+	const auto codec = asset.entry.meta.getString("asset_compression", "");
+	if (!codec.isEmpty()) {
+		Stopwatch decompressTime;
+		data->inflate(codec);
+		addTiming(Phase::Decompress, data->getSize(), decompressTime.elapsedNanoSeconds());
+	}
+
+	if (!asset.entry.meta.getBool("streaming", false)) {
+		const auto dataSize = data->getSize();
+		Stopwatch deserializeTime;
+		if (deserialize(locator, asset, std::move(data))) {
+			addTiming(Phase::Deserialize, dataSize, deserializeTime.elapsedNanoSeconds());
+		}
+	}
+}
+
+bool AssetPackBenchmark::deserialize(Locator& locator, const Asset& asset, std::unique_ptr<ResourceDataStatic> data)
+{
+	locator.setCurrent(asset);
+	ResourceLoader loader(locator, asset.name, asset.type, ResourceLoadPriority::Normal, nullptr);
+	auto& meta = asset.entry.meta;
+
+	// The same as each loader does, short of anything that needs the rest of the engine (dependencies, devices)
+	switch (asset.type) {
+	case AssetType::BinaryFile:
+		loader.prefetched = std::move(data);
+		BinaryFile::loadResource(loader);
+		return true;
+	case AssetType::TextFile:
+		loader.prefetched = std::move(data);
+		TextFile::loadResource(loader);
+		return true;
+	case AssetType::ConfigFile:
+		loader.prefetched = std::move(data);
+		ConfigFile::loadResource(loader);
+		return true;
+	case AssetType::StringTable:
+		loader.prefetched = std::move(data);
+		StringTable::loadResource(loader);
+		return true;
+	case AssetType::Image:
+		loader.prefetched = std::move(data);
+		Image::loadResource(loader);
+		return true;
+	case AssetType::AudioEvent:
+		loader.prefetched = std::move(data);
+		AudioEvent::loadResource(loader);
+		return true;
+	case AssetType::SpriteSheet:
+		{
+			SpriteSheet sheet;
+			Deserializer s(data->getSpan(), true);
+			sheet.deserialize(s);
+			return true;
+		}
+	case AssetType::Animation:
+		{
+			Animation animation;
+			Deserializer s(data->getSpan());
+			s >> animation;
+			return true;
+		}
+	case AssetType::AudioClip:
+		{
+			AudioClip clip(size_t(meta.getInt("channels", 1)));
+			clip.loadFromStatic(std::shared_ptr<ResourceDataStatic>(std::move(data)), meta);
+			return true;
+		}
+	case AssetType::Texture:
+		if (meta.getString("compression") == "png") {
+			Image image(*data, meta);
+			return true;
+		}
+		return false; // Otherwise uploaded as it is
+	default:
+		return false;
+	}
+}
+
+void AssetPackBenchmark::printResults(const Results& results) const
+{
+	auto stdCol = ConsoleColour();
+	auto infoCol = ConsoleColour(Console::MAGENTA);
+	auto strCol = ConsoleColour(Console::DARK_GREY);
+
+	std::cout << "  " << (results.cold ? "Cold" : "Warm") << " cache";
+	if (results.cold && !results.evicted) {
+		std::cout << strCol << " (couldn't evict the pack from the OS's file cache, so this might be warm)" << stdCol;
+	}
+	std::cout << ", MB/s for read, decrypt, decompress, deserialize:\n";
+
+	auto printRow = [&] (const String& label, const std::array<Timing, numPhases>& timings)
+	{
+		size_t count = 0;
+		for (auto& t: timings) {
+			count = std::max(count, t.count);
+		}
+		std::cout << "    " << strCol << std::left << std::setw(20) << label.cppStr() << stdCol << std::right << std::setw(6) << count << " assets";
+		for (auto& t: timings) {
+			if (t.count > 0) {
+				std::cout << infoCol << std::setw(12) << toString(t.getMegabytesPerSecond(), 1).cppStr() << stdCol;
+			} else {
+				std::cout << std::setw(12) << "-";
+			}
+		}
+		std::cout << "\n";
+	};
+
+	for (auto& t: results.byType) {
+		printRow(toString(t.first), t.second);
+	}
+	printRow("total", results.total);
+}
+
+void AssetPackBenchmark::addToReport(BenchmarkReport& report, const String& prefix, const Results& results) const
+{
+	const std::array<const char*, numPhases> phaseNames = {{ "read", "decrypt", "decompress", "deserialize" }};
+	auto addRow = [&] (const String& label, const std::array<Timing, numPhases>& timings)
+	{
+		for (size_t i = 0; i < numPhases; ++i) {
+			if (timings[i].count > 0) {
+				report.add(prefix + label + "/" + phaseNames[i], "MB/s", timings[i].getMegabytesPerSecond(), BenchmarkReport::Better::Higher);
+			}
+		}
+	};
+
+	for (auto& t: results.byType) {
+		addRow(toString(t.first), t.second);
+	}
+	addRow("total", results.total);
+}
+
+int AssetPackBenchmarkTool::run(Vector<std::string> args)
+{
+	try {
+		String key;
+		String jsonPath;
+		String label = "local";
+		Vector<String> packs;
+		for (size_t i = 0; i < args.size(); ++i) {
+			if (args[i] == "-k" && i + 1 < args.size()) {
+				key = args[++i];
+			} else if (args[i] == "-j" && i + 1 < args.size()) {
+				jsonPath = args[++i];
+			} else if (args[i] == "-l" && i + 1 < args.size()) {
+				label = args[++i];
+			} else {
+				packs.push_back(args[i]);
+			}
+		}
+
+		if (packs.empty()) {
+			Logger::logError("Usage: halley-cmd pack-benchmark [-k encryptionKey] [-j report.json] [-l label] path/to/pack1.dat [path/to/pack2.dat ...]");
+			return 1;
+		}
+
+		constexpr int warmRuns = 3;
+		BenchmarkReport report("pack", label);
+		for (auto& packPath: packs) {
+			AssetPackBenchmark benchmark(packPath, key);
+			std::cout << "Pack " << ConsoleColour(Console::DARK_GREY) << packPath << ConsoleColour() << "\n";
+			const auto prefix = Path(packPath).getFilename().string() + "/";
+			const auto cold = benchmark.run(true);
+			benchmark.addToReport(report, prefix + "cold/", cold);
+			benchmark.printResults(cold);
+
+			// Best of a few, as warm runs are mostly measuring noise otherwise; the report gets all of them
+			auto warm = benchmark.run(false);
+			benchmark.addToReport(report, prefix + "warm/", warm);
+			for (int i = 1; i < warmRuns; ++i) {
+				const auto next = benchmark.run(false);
+				benchmark.addToReport(report, prefix + "warm/", next);
+				warm.keepBest(next);
+			}
+			benchmark.printResults(warm);
+			std::cout << std::endl;
+		}
+
+		if (!jsonPath.isEmpty()) {
+			report.save(jsonPath);
+			std::cout << "Results for \"" << label << "\" written to " << jsonPath << std::endl;
+		}
+		return 0;
+	} catch (std::exception& e) {
+		Logger::logException(e);
+		return 1;
+	} catch (...) {
+		Logger::logError("Unknown exception benchmarking packs.");
+		return 1;
+	}
+}
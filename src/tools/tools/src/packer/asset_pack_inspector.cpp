@@ -29,9 +29,16 @@ void AssetPackInspector::parse(const Bytes& bytes)
 	s >> tableSpan;
 
 	rawTableSize = tableData.size();
-	auto rawTableData = Compression::decompress(tableData);
-	tableSize = rawTableData.size();
-	parseTable(Deserializer(rawTableData), bytes);
+	if (AssetDatabase::isCompact(gsl::as_bytes(gsl::span<const Byte>(tableData)))) {
+		AssetDatabase db;
+		db.loadCompact(gsl::as_bytes(gsl::span<const Byte>(tableData)), true);
+		tableSize = tableData.size();
+		parseCompactTable(db, bytes);
+	} else {
+		auto rawTableData = Compression::decompress(tableData);
+		tableSize = rawTableData.size();
+		parseTable(Deserializer(rawTableData), bytes);
+	}
 
 	// Generated sorted entries
 	sortedEntries.resize(entries.size());
@@ -70,16 +77,30 @@ void AssetPackInspector::parseTypedDB(Deserializer& s, const Bytes& packBytes)
 		String key;
 		AssetDatabase::Entry entry;
 		s >> key >> entry;
+		addEntry(curAssetType, std::move(key), std::move(entry), packBytes);
+	}
+}
 
-		auto splitPath = entry.path.split(':');
-		size_t pos = splitPath.at(0).toInteger64();
-		size_t size = splitPath.at(1).toInteger64();
-		auto hash = Hash::hash(gsl::as_bytes(gsl::span<const Byte>(packBytes.data() + pos + dataStartPos, size)));
-
-		entries.emplace_back(curAssetType, hash, std::move(key), std::move(entry));
+void AssetPackInspector::parseCompactTable(const AssetDatabase& db, const Bytes& packBytes)
+{
+	for (auto type: db.getTypes()) {
+		db.getDatabase(type).forEach([&] (const String& key, const AssetDatabase::Entry& entry)
+		{
+			addEntry(int(type), key, entry, packBytes);
+		});
 	}
 }
 
+void AssetPackInspector::addEntry(int assetType, String key, AssetDatabase::Entry entry, const Bytes& packBytes)
+{
+	auto splitPath = entry.path.split(':');
+	size_t pos = splitPath.at(0).toInteger64();
+	size_t size = splitPath.at(1).toInteger64();
+	auto hash = Hash::hash(gsl::as_bytes(gsl::span<const Byte>(packBytes.data() + pos + dataStartPos, size)));
+
+	entries.emplace_back(assetType, hash, std::move(key), std::move(entry));
+}
+
 void AssetPackInspector::computeHash()
 {
 	Hash::Hasher hasher;
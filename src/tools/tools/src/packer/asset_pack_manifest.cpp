@@ -1,7 +1,7 @@
 #include "halley/tools/packer/asset_pack_manifest.h"
 #include "halley/file_formats/config_file.h"
 #include "halley/tools/packer/asset_packer.h"
-#include <yaml-cpp/yaml.h>
+#include "halley/bytes/compression.h"
 #include "../assets/importers/config_importer.h"
 using namespace Halley;
 
@@ -13,6 +13,10 @@ AssetPackManifestEntry::AssetPackManifestEntry(const ConfigNode& node)
 {
 	name = node["name"].asString();
 	encryptionKey = node["encryptionKey"].asString("");
+	compression = node["compression"].asString("");
+	if (!compression.isEmpty() && !Compression::isValidCodec(compression)) {
+		throw Exception("Unknown compression \"" + compression + "\" for asset pack \"" + name + "\"", HalleyExceptions::Tools);
+	}
 	if (node.hasKey("matches")) {
 		for (auto& m: node["matches"].asSequence()) {
 			matches.push_back(m.asString());
@@ -45,12 +49,15 @@ const String& AssetPackManifestEntry::getEncryptionKey() const
 	return encryptionKey;
 }
 
+const String& AssetPackManifestEntry::getCompression() const
+{
+	return compression;
+}
+
 AssetPackManifest::AssetPackManifest(const Bytes& data)
 {
 	ConfigFile config;
-	String strData(reinterpret_cast<const char*>(data.data()), data.size());
-	YAML::Node root = YAML::Load(strData.cppStr());
-	config.getRoot() = ConfigImporter::parseYAMLNode(root);
+	ConfigImporter::parseConfig(config, gsl::as_bytes(gsl::span<const Byte>(data)));
 	load(config);
 }
 
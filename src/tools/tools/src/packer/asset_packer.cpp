@@ -8,8 +8,37 @@
 #include "halley/core/resources/asset_pack.h"
 #include "halley/tools/project/project.h"
 #include "halley/tools/assets/import_assets_database.h"
+#include "halley/bytes/compression.h"
+#include "halley/concurrency/concurrent.h"
+#include "halley/utils/encrypt.h"
+#include "halley/utils/hash.h"
+#include <algorithm>
+#include <fstream>
+#include <numeric>
 using namespace Halley;
 
+namespace {
+	// Below this, rewriting the whole pack is quick enough, and keeps it compact
+	constexpr uint64_t minPatchSize = 64 * 1024 * 1024;
+
+	// Past this fraction of the data being superseded entries, a patch rewrites the whole pack instead
+	constexpr float maxPatchWaste = 0.5f;
+}
+
+void AssetPacker::PackState::serialize(Serializer& s) const
+{
+	s << hash;
+	s << fileSize;
+	s << entries;
+}
+
+void AssetPacker::PackState::deserialize(Deserializer& s)
+{
+	s >> hash;
+	s >> fileSize;
+	s >> entries;
+}
+
 
 bool AssetPackListing::Entry::operator<(const Entry& other) const
 {
@@ -20,15 +49,16 @@ AssetPackListing::AssetPackListing()
 {
 }
 
-AssetPackListing::AssetPackListing(String name, String encryptionKey)
+AssetPackListing::AssetPackListing(String name, String encryptionKey, String compression)
 	: name(name)
 	, encryptionKey(encryptionKey)
+	, compression(compression)
 {
 }
 
 void AssetPackListing::addFile(AssetType type, const String& name, const AssetDatabase::Entry& entry)
 {
-	entries.push_back(Entry{ type, name, entry.path, entry.meta });
+	entries.push_back(Entry{ type, name, entry.path, entry.meta, entry.dependencies });
 }
 
 const std::vector<AssetPackListing::Entry>& AssetPackListing::getEntries() const
@@ -41,6 +71,11 @@ const String& AssetPackListing::getEncryptionKey() const
 	return encryptionKey;
 }
 
+const String& AssetPackListing::getCompression() const
+{
+	return compression;
+}
+
 void AssetPackListing::setActive(bool a)
 {
 	active = a;
@@ -56,6 +91,32 @@ void AssetPackListing::sort()
 	std::sort(entries.begin(), entries.end());
 }
 
+void AssetPackListing::sort(const std::map<String, size_t>& accessOrder)
+{
+	if (accessOrder.empty()) {
+		sort();
+		return;
+	}
+
+	std::vector<std::pair<size_t, Entry*>> keys;
+	keys.reserve(entries.size());
+	for (auto& e: entries) {
+		const auto iter = accessOrder.find(toString(e.type) + ":" + e.name);
+		keys.emplace_back(iter != accessOrder.end() ? iter->second : std::numeric_limits<size_t>::max(), &e);
+	}
+	std::sort(keys.begin(), keys.end(), [] (const std::pair<size_t, Entry*>& a, const std::pair<size_t, Entry*>& b)
+	{
+		return a.first != b.first ? a.first < b.first : *a.second < *b.second;
+	});
+
+	std::vector<Entry> sorted;
+	sorted.reserve(entries.size());
+	for (auto& k: keys) {
+		sorted.push_back(std::move(*k.second));
+	}
+	entries = std::move(sorted);
+}
+
 void AssetPacker::pack(Project& project, Maybe<std::set<String>> assetsToPack, const std::vector<String>& deletedAssets)
 {
 	for (auto& platform: project.getPlatforms()) {
@@ -73,35 +134,64 @@ void AssetPacker::packPlatform(Project& project, Maybe<std::set<String>> assetsT
 	const auto manifest = AssetPackManifest(FileSystem::readFile(project.getAssetPackManifestPath()));
 
 	// Sort into packs
-	const std::map<String, AssetPackListing> packs = sortIntoPacks(manifest, *db, assetsToPack, deletedAssets);
+	const auto accessOrder = loadAccessTraces(project.getAccessTracesPath());
+	const std::map<String, AssetPackListing> packs = sortIntoPacks(manifest, *db, assetsToPack, deletedAssets, accessOrder);
 
 	// Generate packs
-	generatePacks(packs, src, dst);
+	generatePacks(packs, src, dst, src / ("packs-" + platform + ".db"));
+}
+
+std::map<String, size_t> AssetPacker::loadAccessTraces(const Path& path)
+{
+	// Traces are merged in order of file name, each only adding the assets that none before it had, so what a trace loads
+	// that earlier ones didn't ends up contiguous (e.g. with a trace per level, each level's own assets are together)
+	auto files = FileSystem::enumerateDirectory(path);
+	std::sort(files.begin(), files.end(), [] (const Path& a, const Path& b) { return a.string() < b.string(); });
+
+	std::map<String, size_t> result;
+	for (auto& file: files) {
+		const auto bytes = FileSystem::readFile(path / file);
+		const auto lines = String(reinterpret_cast<const char*>(bytes.data()), bytes.size()).split('\n');
+		for (auto line: lines) {
+			line.trimBoth();
+			if (!line.isEmpty() && result.find(line) == result.end()) {
+				const auto pos = result.size();
+				result[line] = pos;
+			}
+		}
+	}
+
+	if (!files.empty()) {
+		Logger::logInfo("Laying out packs by " + toString(files.size()) + " access trace(s), covering " + toString(result.size()) + " assets.");
+	}
+	return result;
 }
 
-std::map<String, AssetPackListing> AssetPacker::sortIntoPacks(const AssetPackManifest& manifest, const AssetDatabase& srcAssetDb, Maybe<std::set<String>> assetsToPack, const std::vector<String>& deletedAssets)
+std::map<String, AssetPackListing> AssetPacker::sortIntoPacks(const AssetPackManifest& manifest, const AssetDatabase& srcAssetDb, Maybe<std::set<String>> assetsToPack, const std::vector<String>& deletedAssets, const std::map<String, size_t>& accessOrder)
 {
 	std::map<String, AssetPackListing> packs;
 	for (auto typeName: EnumNames<AssetType>()()) {
 		const auto type = fromString<AssetType>(typeName);
 		auto& db = srcAssetDb.getDatabase(type);
-		for (auto& assetEntry: db.getAssets()) {
-			const String assetName = String(typeName) + ":" + assetEntry.first;
+		db.forEach([&] (const String& name, const AssetDatabase::Entry& assetEntry) {
+			const String assetName = String(typeName) + ":" + name;
 
 			// Find which pack this asset goes into
 			auto packEntry = manifest.getPack("~:" + assetName);
 			String packName;
 			String encryptionKey;
+			String compression;
 			if (packEntry) {
 				packName = packEntry.get().get().getName();
 				encryptionKey = packEntry.get().get().getEncryptionKey();
+				compression = packEntry.get().get().getCompression();
 			}
 
 			// Retrieve pack
 			auto iter = packs.find(packName);
 			if (iter == packs.end()) {
 				// Pack doesn't exist yet, create it first
-				packs[packName] = AssetPackListing(packName, encryptionKey);
+				packs[packName] = AssetPackListing(packName, encryptionKey, compression);
 				iter = packs.find(packName);
 
 				// Initialise it to active if there's no asset list to pack
@@ -118,13 +208,13 @@ std::map<String, AssetPackListing> AssetPacker::sortIntoPacks(const AssetPackMan
 			}
 
 			// Add file to pack
-			iter->second.addFile(type, assetEntry.first, assetEntry.second);
-		}
+			iter->second.addFile(type, name, assetEntry);
+		});
 	}
 
 	// Sort all packs
 	for (auto& p: packs) {
-		p.second.sort();
+		p.second.sort(accessOrder);
 	}
 
 	// Activate any packs that contain deleted assets
@@ -145,8 +235,19 @@ std::map<String, AssetPackListing> AssetPacker::sortIntoPacks(const AssetPackMan
 	return packs;
 }
 
-void AssetPacker::generatePacks(std::map<String, AssetPackListing> packs, const Path& src, const Path& dst)
+void AssetPacker::generatePacks(std::map<String, AssetPackListing> packs, const Path& src, const Path& dst, const Path& statePath)
 {
+	std::map<String, PackState> states;
+	if (FileSystem::exists(statePath)) {
+		try {
+			Deserializer::fromBytes(states, FileSystem::readFile(statePath));
+		} catch (...) {
+			Logger::logWarning("Unable to read \"" + statePath.string() + "\", all packs will be rewritten.");
+			states.clear();
+		}
+	}
+
+	std::vector<String> toGenerate;
 	for (auto& packListing: packs) {
 		if (packListing.first.isEmpty()) {
 			Logger::logWarning("The following assets will not be packed:");
@@ -158,13 +259,76 @@ void AssetPacker::generatePacks(std::map<String, AssetPackListing> packs, const
 			// Only pack if this pack listing is active or if it doesn't exist
 			auto dstPack = dst / packListing.first + ".dat";
 			if (packListing.second.isActive() || !FileSystem::exists(dstPack)) {
-				generatePack(packListing.first, packListing.second, src, dstPack);
+				toGenerate.push_back(packListing.first);
 			}
 		}
 	}
+
+	// Packs don't depend on each other, so they're all generated in parallel
+	struct Result {
+		Maybe<PackState> state;
+		std::exception_ptr error; // Rethrown once they're all done, as the parallel loop can't carry it
+	};
+	std::vector<Result> results(toGenerate.size());
+	std::vector<size_t> indices(toGenerate.size());
+	std::iota(indices.begin(), indices.end(), size_t(0));
+	Concurrent::foreach(Executors::getCPU(), indices.begin(), indices.end(), [&] (size_t i)
+	{
+		const auto& packId = toGenerate[i];
+		const auto stateIter = states.find(packId);
+		try {
+			results[i].state = generatePack(packId, packs.at(packId), src, dst / packId + ".dat", stateIter != states.end() ? &stateIter->second : nullptr);
+		} catch (...) {
+			results[i].error = std::current_exception();
+		}
+	}, 1);
+
+	for (size_t i = 0; i < toGenerate.size(); ++i) {
+		if (results[i].state) {
+			states[toGenerate[i]] = std::move(results[i].state.get());
+		} else {
+			// Whatever is on disk now can't be trusted as a baseline
+			states.erase(toGenerate[i]);
+		}
+	}
+	for (auto iter = states.begin(); iter != states.end(); ) {
+		if (packs.find(iter->first) == packs.end()) {
+			iter = states.erase(iter);
+		} else {
+			++iter;
+		}
+	}
+	FileSystem::writeFile(statePath, Serializer::toBytes(states));
+
+	for (auto& r: results) {
+		if (r.error) {
+			std::rethrow_exception(r.error);
+		}
+	}
+}
+
+AssetPacker::PackState AssetPacker::generatePack(const String& packId, const AssetPackListing& packListing, const Path& src, const Path& dst, const PackState* previous)
+{
+	auto state = hashPack(packListing, src);
+
+	const bool exists = FileSystem::exists(dst);
+	if (previous && exists && FileSystem::fileSize(dst) == previous->fileSize) {
+		if (previous->hash == state.hash) {
+			Logger::logInfo("- Skipped \"" + packId + "\", as nothing in it changed.");
+			return *previous;
+		}
+		if (previous->fileSize >= minPatchSize && patchPack(packId, packListing, src, dst, *previous, state)) {
+			state.fileSize = FileSystem::fileSize(dst);
+			return state;
+		}
+	}
+
+	writePack(packId, packListing, src, dst);
+	state.fileSize = FileSystem::fileSize(dst);
+	return state;
 }
 
-void AssetPacker::generatePack(const String& packId, const AssetPackListing& packListing, const Path& src, const Path& dst)
+void AssetPacker::writePack(const String& packId, const AssetPackListing& packListing, const Path& src, const Path& dst)
 {
 	AssetPack pack;
 	AssetDatabase& db = pack.getAssetDatabase();
@@ -172,21 +336,17 @@ void AssetPacker::generatePack(const String& packId, const AssetPackListing& pac
 
 	for (auto& entry: packListing.getEntries()) {
 		//Logger::logDev("  [" + toString(entry.type) + "] " + entry.name);
+		auto fileData = readEntry(packListing, entry, src);
 
-		// Read original file
-		auto fileData = FileSystem::readFile(src / entry.path);
 		const size_t pos = data.size();
-		const size_t size = fileData.size();
-		if (size == 0) {
-			throw Exception("Unable to pack: \"" + (src / entry.path) + "\". File not found or empty.", HalleyExceptions::Tools);
-		}
+		const size_t size = fileData.first.size();
 		
 		// Read data into pack data
 		data.reserve(nextPowerOf2(pos + size));
 		data.resize(pos + size);
-		memcpy(data.data() + pos, fileData.data(), size);
+		memcpy(data.data() + pos, fileData.first.data(), size);
 
-		db.addAsset(entry.name, entry.type, AssetDatabase::Entry(toString(pos) + ":" + toString(size), entry.metadata));
+		db.addAsset(entry.name, entry.type, AssetDatabase::Entry(toString(pos) + ":" + toString(size), fileData.second, entry.dependencies));
 	}
 
 	if (!packListing.getEncryptionKey().isEmpty()) {
@@ -194,7 +354,179 @@ void AssetPacker::generatePack(const String& packId, const AssetPackListing& pac
 		pack.encrypt(packListing.getEncryptionKey());
 	}
 
-	// Write pack
-	FileSystem::writeFile(dst, pack.writeOut());
+	// Write pack, leaving room for the database to grow, in case it's patched later
+	const size_t assetDbSize = db.toCompact().size();
+	FileSystem::writeFile(dst, pack.writeOut(assetDbSize + assetDbSize / 4 + 4096));
 	Logger::logInfo("- Packed " + toString(packListing.getEntries().size()) + " entries on \"" + packId + "\" (" + String::prettySize(data.size()) + ").");
 }
+
+bool AssetPacker::patchPack(const String& packId, const AssetPackListing& packListing, const Path& src, const Path& dst, const PackState& previous, const PackState& next)
+{
+	// Changed entries are appended, and the database is rewritten in the room it has, so nothing else in the file moves
+	std::fstream file(dst.string(), std::ios::in | std::ios::out | std::ios::binary);
+	if (!file) {
+		return false;
+	}
+
+	AssetPackHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || header.assetDbStartPos > header.dataStartPos || header.dataStartPos > previous.fileSize) {
+		return false;
+	}
+
+	// Counter mode lets new data be encrypted on its own, at its offset; older packs have to be rewritten
+	const auto& encryptionKey = packListing.getEncryptionKey();
+	const bool hasIV = std::any_of(header.iv.begin(), header.iv.end(), [] (char c) { return c != 0; });
+	if (encryptionKey.isEmpty() ? hasIV : (!hasIV || memcmp(header.identifier.data(), "HALLEYPC", 8) != 0)) {
+		return false;
+	}
+
+	AssetDatabase oldDb;
+	const size_t assetDbCapacity = size_t(header.dataStartPos - header.assetDbStartPos);
+	try {
+		Bytes assetDbBytes(assetDbCapacity);
+		file.seekg(std::streamoff(header.assetDbStartPos));
+		file.read(reinterpret_cast<char*>(assetDbBytes.data()), std::streamsize(assetDbBytes.size()));
+		if (!file) {
+			return false;
+		}
+		oldDb.loadPacked(gsl::as_bytes(gsl::span<const Byte>(assetDbBytes)), false);
+	} catch (...) {
+		return false;
+	}
+
+	AssetDatabase db;
+	uint64_t liveSize = 0;
+	std::vector<const AssetPackListing::Entry*> changed;
+	for (auto& entry: packListing.getEntries()) {
+		const auto key = toString(entry.type) + ":" + entry.name;
+		const auto prevIter = previous.entries.find(key);
+		const auto old = oldDb.getDatabase(entry.type).tryGet(entry.name);
+		if (old && prevIter != previous.entries.end() && prevIter->second == next.entries.at(key)) {
+			const auto ps = old->path.split(':');
+			liveSize += uint64_t(ps.at(1).toInteger64());
+			db.addAsset(entry.name, entry.type, AssetDatabase::Entry(*old));
+		} else {
+			changed.push_back(&entry);
+		}
+	}
+
+	if (changed.empty()) {
+		// Only the layout changed (e.g. from new access traces), which patching can't do
+		return false;
+	}
+
+	std::vector<std::pair<Bytes, Metadata>> changedData;
+	uint64_t appendSize = 0;
+	for (auto& entry: changed) {
+		changedData.push_back(readEntry(packListing, *entry, src));
+		appendSize += changedData.back().first.size();
+	}
+
+	const uint64_t oldDataSize = previous.fileSize - header.dataStartPos;
+	const uint64_t wasted = oldDataSize - std::min(oldDataSize, liveSize);
+	if (float(wasted) > maxPatchWaste * float(oldDataSize + appendSize)) {
+		return false;
+	}
+
+	uint64_t pos = oldDataSize;
+	for (size_t i = 0; i < changed.size(); ++i) {
+		const auto size = changedData[i].first.size();
+		db.addAsset(changed[i]->name, changed[i]->type, AssetDatabase::Entry(toString(pos) + ":" + toString(size), changedData[i].second, changed[i]->dependencies));
+		pos += size;
+	}
+
+	auto assetDbBytes = db.toCompact();
+	if (assetDbBytes.size() > assetDbCapacity) {
+		return false;
+	}
+	assetDbBytes.resize(assetDbCapacity, 0);
+
+	// Data first, so the file is still valid with the old database if this is interrupted
+	std::unique_ptr<Encrypt::CounterMode> cipher;
+	if (!encryptionKey.isEmpty()) {
+		Bytes iv(header.iv.size());
+		memcpy(iv.data(), header.iv.data(), iv.size());
+		cipher = std::make_unique<Encrypt::CounterMode>(iv, encryptionKey);
+	}
+	pos = oldDataSize;
+	file.seekp(std::streamoff(header.dataStartPos + oldDataSize));
+	for (auto& d: changedData) {
+		if (cipher) {
+			cipher->apply(gsl::as_writeable_bytes(gsl::span<Byte>(d.first)), size_t(pos));
+		}
+		file.write(reinterpret_cast<const char*>(d.first.data()), std::streamsize(d.first.size()));
+		pos += d.first.size();
+	}
+	file.flush();
+	file.seekp(std::streamoff(header.assetDbStartPos));
+	file.write(reinterpret_cast<const char*>(assetDbBytes.data()), std::streamsize(assetDbBytes.size()));
+	file.flush();
+	if (!file) {
+		throw Exception("Unable to patch \"" + dst + "\".", HalleyExceptions::Tools);
+	}
+
+	Logger::logInfo("- Patched " + toString(changed.size()) + " of " + toString(packListing.getEntries().size()) + " entries on \"" + packId + "\" (" + String::prettySize(appendSize) + " appended).");
+	return true;
+}
+
+AssetPacker::PackState AssetPacker::hashPack(const AssetPackListing& packListing, const Path& src)
+{
+	// Entries are hashed on what goes into them, so it's all read, but that's still much cheaper than writing the pack out
+	const auto& entries = packListing.getEntries();
+	std::vector<uint64_t> hashes(entries.size());
+	std::vector<size_t> indices(entries.size());
+	std::iota(indices.begin(), indices.end(), size_t(0));
+	Concurrent::foreach(Executors::getCPU(), indices.begin(), indices.end(), [&] (size_t i)
+	{
+		auto& entry = entries[i];
+		const auto fileData = FileSystem::readFile(src / entry.path);
+		const auto meta = Serializer::toBytes(entry.metadata);
+		const auto dependencies = Serializer::toBytes(entry.dependencies);
+
+		Hash::Hasher hasher;
+		hasher.feed(Hash::hash(fileData));
+		hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(meta)));
+		hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(dependencies)));
+		hashes[i] = hasher.digest();
+	});
+
+	PackState state;
+	Hash::Hasher hasher;
+	const auto settings = Serializer::toBytes(packListing.getEncryptionKey() + ":" + packListing.getCompression());
+	hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(settings)));
+	for (size_t i = 0; i < entries.size(); ++i) {
+		const auto key = toString(entries[i].type) + ":" + entries[i].name;
+		const auto keyBytes = Serializer::toBytes(key);
+		hasher.feedBytes(gsl::as_bytes(gsl::span<const Byte>(keyBytes)));
+		hasher.feed(hashes[i]);
+		state.entries[key] = hashes[i];
+	}
+	state.hash = hasher.digest();
+	return state;
+}
+
+std::pair<Bytes, Metadata> AssetPacker::readEntry(const AssetPackListing& packListing, const AssetPackListing::Entry& entry, const Path& src)
+{
+	// Read original file
+	auto fileData = FileSystem::readFile(src / entry.path);
+	if (fileData.empty()) {
+		throw Exception("Unable to pack: \"" + (src / entry.path) + "\". File not found or empty.", HalleyExceptions::Tools);
+	}
+
+	// Apply the pack's codec to anything that isn't already compressed, or asked to be kept as is (to be used in place once mapped);
+	// streamed assets are compressed in chunks, so they can still seek
+	auto metadata = entry.metadata;
+	const auto& compression = packListing.getCompression();
+	if (!compression.isEmpty() && metadata.getString("asset_compression", "").isEmpty() && !metadata.getBool("asset_keep_uncompressed", false)) {
+		if (metadata.getBool("streaming", false)) {
+			fileData = Compression::compressChunked(gsl::as_bytes(gsl::span<const Byte>(fileData)), compression);
+			metadata.set("asset_stream_compression", compression);
+		} else {
+			fileData = Compression::compress(gsl::as_bytes(gsl::span<const Byte>(fileData)), compression);
+			metadata.set("asset_compression", compression);
+		}
+	}
+
+	return { std::move(fileData), std::move(metadata) };
+}
@@ -2,6 +2,7 @@
 #include "halley/tools/project/project.h"
 #include "halley/core/devcon/devcon_server.h"
 #include "halley/support/logger.h"
+#include <algorithm>
 
 using namespace Halley;
 
@@ -11,6 +12,29 @@ AssetPackerTask::AssetPackerTask(Project& project, Maybe<std::set<String>> asset
 	, assetsToPack(std::move(assetsToPack))
 	, deletedAssets(std::move(deletedAssets))
 {
+	// Packs what the importer writes, so it can't run alongside it
+	setExclusiveKey(project.getUnpackedAssetsPath().getString());
+}
+
+bool AssetPackerTask::mergeWith(EditorTask& other)
+{
+	auto o = dynamic_cast<AssetPackerTask*>(&other);
+	if (!o || &o->project != &project) {
+		return false;
+	}
+
+	// No set means packing everything
+	if (assetsToPack && o->assetsToPack) {
+		assetsToPack->insert(o->assetsToPack->begin(), o->assetsToPack->end());
+	} else {
+		assetsToPack.reset();
+	}
+	for (auto& d: o->deletedAssets) {
+		if (std::find(deletedAssets.begin(), deletedAssets.end(), d) == deletedAssets.end()) {
+			deletedAssets.push_back(std::move(d));
+		}
+	}
+	return true;
 }
 
 void AssetPackerTask::run()
@@ -1,4 +1,5 @@
 #include "halley/tools/assets/import_assets_database.h"
+#include "halley/tools/assets/import_cache.h"
 #include "halley/tools/project/project.h"
 #include "halley/tools/file/filesystem.h"
 #include "halley/core/game/halley_statics.h"
@@ -68,6 +69,11 @@ Path Project::getAssetPackManifestPath() const
 	return assetPackManifest;
 }
 
+Path Project::getAccessTracesPath() const
+{
+	return rootPath / "access_traces";
+}
+
 ImportAssetsDatabase& Project::getImportAssetsDatabase() const
 {
 	return *importAssetsDatabase;
@@ -78,6 +84,23 @@ ImportAssetsDatabase& Project::getCodegenDatabase() const
 	return *codegenDatabase;
 }
 
+void Project::setContentHashing(bool enabled)
+{
+	importAssetsDatabase->setContentHashing(enabled);
+}
+
+void Project::setImportCache(const Path& path)
+{
+	// Cache entries are keyed by content hash, so the cache implies content hashing
+	setContentHashing(true);
+	importCache = std::make_unique<ImportCache>(path, std::vector<Path>{getSharedAssetsSrcPath(), getAssetsSrcPath()});
+}
+
+ImportCache* Project::getImportCache() const
+{
+	return importCache.get();
+}
+
 const AssetImporter& Project::getAssetImporter() const
 {
 	return *assetImporter;
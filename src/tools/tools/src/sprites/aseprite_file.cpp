@@ -3,7 +3,8 @@
 #include "halley/utils/utils.h"
 #include "halley/support/logger.h"
 #include "halley/bytes/compression.h"
-#include <limits>
+#include "halley/concurrency/concurrent.h"
+#include <numeric>
 using namespace Halley;
 
 // Specs are at https://github.com/aseprite/aseprite/blob/master/docs/ase-file-specs.md
@@ -131,13 +132,21 @@ struct AsepriteFileTagsEntryData
 };
 
 
-void AsepriteCel::loadImage(AsepriteDepth depth, const std::vector<uint32_t>& palette)
+void AsepriteCel::loadImage(AsepriteDepth depth, size_t bpp, const std::vector<uint32_t>& palette)
 {
+	const size_t n = size_t(size.x * size.y);
+	if (!compressedData.empty()) {
+		rawData = Compression::decompressRaw(compressedData, n * bpp, n * bpp);
+		compressedData = {};
+	}
+	if (rawData.size() < n * bpp) {
+		throw Exception("Invalid cel data", HalleyExceptions::Tools);
+	}
+
 	imgData = std::make_unique<Image>(Image::Format::RGBA, size);
 	imgData->clear(Image::convertRGBAToInt(0, 0, 0, 0));
 
 	auto dst = reinterpret_cast<uint32_t*>(imgData->getPixels());
-	const size_t n = size_t(size.x * size.y);
 
 	if (depth == AsepriteDepth::Indexed8) {
 		const auto src = reinterpret_cast<uint8_t*>(rawData.data());
@@ -166,6 +175,9 @@ void AsepriteCel::loadImage(AsepriteDepth depth, const std::vector<uint32_t>& pa
 			dst[i] = src[i];
 		}
 	}
+
+	rawData.clear();
+	rawData.shrink_to_fit();
 }
 
 void AsepriteCel::drawAt(Image& dstImage, uint8_t opacity, AsepriteBlendMode blendMode) const
@@ -252,6 +264,42 @@ void AsepriteFile::load(gsl::span<const gsl::byte> data)
 		// Next frame
 		pos = frameStartPos + frameHeader.dataSize;
 	}
+
+	loadCelImages();
+}
+
+void AsepriteFile::loadCelImages()
+{
+	// Inflating and converting the cels is most of the work here, and each one is independent of the others
+	std::vector<AsepriteCel*> cels;
+	for (auto& frame: frames) {
+		for (auto& cel: frame.cels) {
+			if (!cel.linked) {
+				cels.push_back(&cel);
+			}
+		}
+	}
+
+	const size_t bpp = getBPP();
+	std::vector<std::exception_ptr> errors(cels.size());
+	std::vector<size_t> indices(cels.size());
+	std::iota(indices.begin(), indices.end(), size_t(0));
+	Concurrent::foreach(Executors::getCPU(), indices.begin(), indices.end(), [&] (size_t i)
+	{
+		auto& cel = *cels[i];
+		const bool background = cel.layer < layers.size() && layers[cel.layer].background;
+		try {
+			cel.loadImage(colourDepth, bpp, background ? paletteBg : paletteTransparent);
+		} catch (...) {
+			errors[i] = std::current_exception();
+		}
+	});
+
+	for (auto& e: errors) {
+		if (e) {
+			std::rethrow_exception(e);
+		}
+	}
 }
 
 void AsepriteFile::addFrame(uint16_t duration)
@@ -352,8 +400,8 @@ void AsepriteFile::addCelChunk(gsl::span<const gsl::byte> span)
 			}
 			memcpy(cel.rawData.data(), span.data(), cel.rawData.size());
 		} else if (type == 2) {
-			// ZLIB compressed
-			cel.rawData = Compression::decompressRaw(span, std::numeric_limits<size_t>::max());
+			// ZLIB compressed, inflated later along with all the others
+			cel.compressedData = span;
 		}
 	} else if (type == 1) {
 		// Linked
@@ -416,7 +464,7 @@ void AsepriteFile::addTagsChunk(gsl::span<const gsl::byte> span)
 	}
 }
 
-AsepriteCel* AsepriteFile::getCelAt(int frameNumber, int layerNumber)
+const AsepriteCel* AsepriteFile::getCelAt(int frameNumber, int layerNumber) const
 {
 	if (frameNumber < 0 || frameNumber >= int(frames.size())) {
 		throw Exception("Invalid frame number", HalleyExceptions::Tools);
@@ -454,7 +502,7 @@ const std::vector<AsepriteTag>& AsepriteFile::getTags() const
 	return tags;
 }
 
-std::unique_ptr<Image> AsepriteFile::makeFrameImage(int frameNumber)
+std::unique_ptr<Image> AsepriteFile::makeFrameImage(int frameNumber) const
 {
 	auto frameImage = std::make_unique<Image>(Image::Format::RGBA, size);
 	frameImage->clear(Image::convertRGBAToInt(0, 0, 0, 0));
@@ -465,9 +513,6 @@ std::unique_ptr<Image> AsepriteFile::makeFrameImage(int frameNumber)
 			auto* cel = getCelAt(frameNumber, layerNumber);
 			if (cel) {
 				const uint8_t opacity = uint8_t(clamp((uint32_t(cel->opacity) * uint32_t(layer.opacity)) / 255, uint32_t(0), uint32_t(255)));
-				if (!cel->imgData) {
-					cel->loadImage(colourDepth, layer.background ? paletteBg : paletteTransparent);
-				}
 				cel->drawAt(*frameImage, opacity, layer.blendMode);
 			}
 		}
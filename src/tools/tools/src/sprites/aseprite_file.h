@@ -28,9 +28,10 @@ namespace Halley {
 		bool linked = false;
 
 		Bytes rawData;
+		gsl::span<const gsl::byte> compressedData; // Points into the file data, so only valid during AsepriteFile::load
 		std::unique_ptr<Image> imgData;
 
-		void loadImage(AsepriteDepth depth, const std::vector<uint32_t>& palette);
+		void loadImage(AsepriteDepth depth, size_t bpp, const std::vector<uint32_t>& palette);
 		void drawAt(Image& image, uint8_t opacity, AsepriteBlendMode blendMode) const;
 	};
 
@@ -111,7 +112,8 @@ namespace Halley {
 		void load(gsl::span<const gsl::byte> data);
 
 		const std::vector<AsepriteTag>& getTags() const;
-		std::unique_ptr<Image> makeFrameImage(int n);
+		std::unique_ptr<Image> makeFrameImage(int n) const; // Safe to call from several threads at once
+
 	    const AsepriteFrame& getFrame(int n) const;
 	    size_t getNumberOfFrames() const;
 
@@ -151,7 +153,8 @@ namespace Halley {
 			return result;
 		}
 
-	    AsepriteCel* getCelAt(int frameNumber, int layerNumber);
+	    void loadCelImages();
+	    const AsepriteCel* getCelAt(int frameNumber, int layerNumber) const;
 	    size_t getBPP() const;
 
 		Vector2i size;
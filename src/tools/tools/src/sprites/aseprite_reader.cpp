@@ -1,125 +1,13 @@
 #include "aseprite_reader.h"
-#include "halley/tools/file/filesystem.h"
-#include "halley/core/graphics/sprite/sprite_sheet.h"
 #include "halley/file/path.h"
 #include "halley/file_formats/image.h"
 #include "../assets/importers/sprite_importer.h"
 #include "halley/support/logger.h"
 #include "aseprite_file.h"
+#include "halley/concurrency/concurrent.h"
+#include <numeric>
 using namespace Halley;
 
-std::vector<ImageData> AsepriteExternalReader::loadImagesFromPath(Path tmp, bool trim) {
-	std::vector<ImageData> frameData;
-	for (auto p : FileSystem::enumerateDirectory(tmp)) {
-		if (p.getExtension() == ".png") {
-			ImageData data;
-
-			auto bytes = FileSystem::readFile(tmp / p);
-			data.img = std::make_unique<Image>(gsl::as_bytes(gsl::span<Byte>(bytes)));
-			auto parsedName = p.getStem().getString().split("___");
-			if (parsedName.size() != 3 || parsedName[0] != "out") {
-				throw Exception("Error parsing filename: " + p.getStem().getString(), HalleyExceptions::Tools);
-			}
-			data.sequenceName = parsedName[1];
-			data.frameNumber = parsedName[2].toInteger();
-			data.clip = trim ? data.img->getTrimRect() : data.img->getRect();
-			frameData.push_back(std::move(data));
-		}
-	}
-	return frameData;
-}
-
-std::map<int, int> AsepriteExternalReader::getSpriteDurations(Path jsonPath) {
-	std::map<int, int> durations;
-	SpriteSheet spriteSheet;
-	auto jsonData = FileSystem::readFile(jsonPath);
-	spriteSheet.loadJson(gsl::as_bytes(gsl::span<Byte>(jsonData)));
-
-	// Load durations
-	for (auto& name: spriteSheet.getSpriteNames()) {
-		auto& sprite = spriteSheet.getSprite(name);
-		auto parsedNames = Path(name).getStem().getString().split("___");
-		int f = parsedNames.back().toInteger();
-		durations[f] = sprite.duration;
-	}
-
-	return durations;
-}
-
-void AsepriteExternalReader::processFrameData(String spriteName, std::vector<ImageData>& frameData, std::map<int, int> durations) {
-	String baseName = Path(spriteName).getFilename().string();
-
-	std::sort(frameData.begin(), frameData.end(), [] (const ImageData& a, const ImageData& b) -> bool {
-		return a.frameNumber < b.frameNumber;
-	});
-
-	struct TagInfo {
-		int num = 0;
-		int cur = 0;
-	};
-
-	std::map<String, TagInfo> tags;
-	for (auto& frame: frameData) {
-		tags[frame.sequenceName].num++;
-	}
-
-	for (auto& frame: frameData) {
-		int origFrameNumber = frame.frameNumber;
-
-		auto& tag = tags[frame.sequenceName];
-		frame.duration = durations[frame.frameNumber];
-		frame.frameNumber = tag.cur++;
-
-		bool hasFrameNumber = tag.num > 1;
-
-		std::stringstream ss;
-		ss << baseName.cppStr();
-		if (frame.sequenceName != "") {
-			ss << "_" << frame.sequenceName.cppStr();
-		}
-		if (hasFrameNumber) {
-			ss << "_" << std::setw(3) << std::setfill('0') << frame.frameNumber;
-		}
-
-		frame.filenames.emplace_back(ss.str());
-		if (origFrameNumber == 0) {
-			frame.filenames.emplace_back(":img:" + spriteName);
-		}
-	}
-}
-
-std::vector<ImageData> AsepriteExternalReader::importAseprite(String spriteName, gsl::span<const gsl::byte> fileData, bool trim)
-{
-	// Make temporary folder
-	Path tmp = FileSystem::getTemporaryPath();
-	FileSystem::createDir(tmp);
-	Path tmpFilePath = tmp / "sprite.ase";
-	FileSystem::createParentDir(tmpFilePath);
-	FileSystem::writeFile(tmpFilePath, fileData);
-
-	// Run aseprite
-	Path jsonPath = tmpFilePath.parentPath() / "data.json";
-	Path baseOutputPath = tmpFilePath.parentPath() / "out";
-	if (FileSystem::runCommand("aseprite -b " + tmpFilePath.getString() + " --list-tags --data " + jsonPath.getString() + " --filename-format {path}/out___{tag}___{frame000}.png --save-as " + baseOutputPath.getString() + ".png") != 0) {
-		throw Exception("Unable to execute aseprite.", HalleyExceptions::Tools);
-	}
-
-	// Load all images
-	std::vector<ImageData> frameData = loadImagesFromPath(tmp, trim);
-	std::map<int, int> durations = getSpriteDurations(jsonPath);
-
-	// Remove temp
-	FileSystem::remove(tmp);
-
-	// Process images
-	processFrameData(spriteName, frameData, durations);
-	return frameData;
-}
-
-
-////////////
-
-
 std::vector<ImageData> AsepriteReader::importAseprite(String spriteName, gsl::span<const gsl::byte> fileData, bool trim)
 {
 	const String baseName = Path(spriteName).getFilename().string();
@@ -154,36 +42,59 @@ std::vector<ImageData> AsepriteReader::importAseprite(String spriteName, gsl::sp
 		}
 	}
 
-	// Create frames
-	std::vector<ImageData> frameData;
+	// Lay out frames, then compose them all in parallel
+	struct FrameRef {
+		int frameN;
+		int index;
+		const std::pair<String, std::vector<int>>* tag;
+	};
+	std::vector<FrameRef> refs;
 	for (auto& t: tags) {
 		int i = 0;
 		for (auto& frameN: t.second) {
-			frameData.push_back(ImageData());
-			auto& imgData = frameData.back();
+			refs.push_back(FrameRef{ frameN, i++, &t });
+		}
+	}
 
-			imgData.img = aseFile.makeFrameImage(frameN);
-			imgData.frameNumber = i;
-			imgData.sequenceName = t.first;
-			imgData.duration = aseFile.getFrame(frameN).duration;
+	std::vector<ImageData> frameData(refs.size());
+	std::vector<std::exception_ptr> errors(refs.size());
+	std::vector<size_t> indices(refs.size());
+	std::iota(indices.begin(), indices.end(), size_t(0));
+	Concurrent::foreach(Executors::getCPU(), indices.begin(), indices.end(), [&] (size_t j)
+	{
+		const auto& ref = refs[j];
+		auto& imgData = frameData[j];
+		try {
+			imgData.img = aseFile.makeFrameImage(ref.frameN);
 			imgData.clip = trim ? imgData.img->getTrimRect() : imgData.img->getRect();
+		} catch (...) {
+			errors[j] = std::current_exception();
+			return;
+		}
 
-			std::stringstream ss;
-			ss << baseName.cppStr();
-			if (imgData.sequenceName != "") {
-				ss << "_" << imgData.sequenceName.cppStr();
-			}
-			const bool hasFrameNumber = t.second.size() > 1;
-			if (hasFrameNumber) {
-				ss << "_" << std::setw(3) << std::setfill('0') << imgData.frameNumber;
-			}
+		imgData.frameNumber = ref.index;
+		imgData.sequenceName = ref.tag->first;
+		imgData.duration = aseFile.getFrame(ref.frameN).duration;
 
-			imgData.filenames.emplace_back(ss.str());
-			if (frameN == 0) {
-				imgData.filenames.emplace_back(":img:" + spriteName);
-			}
+		std::stringstream ss;
+		ss << baseName.cppStr();
+		if (imgData.sequenceName != "") {
+			ss << "_" << imgData.sequenceName.cppStr();
+		}
+		const bool hasFrameNumber = ref.tag->second.size() > 1;
+		if (hasFrameNumber) {
+			ss << "_" << std::setw(3) << std::setfill('0') << imgData.frameNumber;
+		}
+
+		imgData.filenames.emplace_back(ss.str());
+		if (ref.frameN == 0) {
+			imgData.filenames.emplace_back(":img:" + spriteName);
+		}
+	});
 
-			i++;
+	for (auto& e: errors) {
+		if (e) {
+			std::rethrow_exception(e);
 		}
 	}
 
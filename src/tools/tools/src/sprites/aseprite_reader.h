@@ -10,17 +10,6 @@ namespace Halley
 	class Image;
 	struct ImageData;
 
-	class AsepriteExternalReader
-	{
-	public:
-		static std::vector<ImageData> importAseprite(String baseName, gsl::span<const gsl::byte> fileData, bool trim);
-
-	private:
-		static std::vector<ImageData> loadImagesFromPath(Path tmp, bool crop);
-		static std::map<int, int> getSpriteDurations(Path jsonPath);
-		static void processFrameData(String baseName, std::vector<ImageData>& frameData, std::map<int, int> durations);
-	};
-
 	class AsepriteReader
 	{
 	public:
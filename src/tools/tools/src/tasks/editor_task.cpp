@@ -19,6 +19,16 @@ EditorTask::EditorTask(String name, bool isCancellable, bool isVisible)
 	, isVisible(isVisible)
 {}
 
+bool EditorTask::mergeWith(EditorTask& other)
+{
+	return false;
+}
+
+void EditorTask::setExclusiveKey(String key)
+{
+	exclusiveKey = std::move(key);
+}
+
 void EditorTask::addContinuation(EditorTaskAnchor&& task)
 {
 	std::lock_guard<std::mutex> lock(mutex);
@@ -135,10 +145,6 @@ void EditorTaskAnchor::update(float time)
 {
 	if (status == EditorTaskStatus::WaitingToStart) {
 		timeToStart -= time;
-		if (timeToStart <= 0) {
-			status = EditorTaskStatus::Started;
-			taskFuture = Concurrent::execute(Task<void>([this]() { task->run(); }));
-		}
 	} else if (status == EditorTaskStatus::Started) {
 		bool done = taskFuture.hasValue();
 		if (done) {
@@ -155,6 +161,18 @@ void EditorTaskAnchor::update(float time)
 	}
 }
 
+bool EditorTaskAnchor::isReadyToStart() const
+{
+	return status == EditorTaskStatus::WaitingToStart && timeToStart <= 0;
+}
+
+void EditorTaskAnchor::start(ExecutionQueue& queue)
+{
+	Expects(status == EditorTaskStatus::WaitingToStart);
+	status = EditorTaskStatus::Started;
+	taskFuture = Concurrent::execute(queue, Task<void>([this]() { task->run(); }));
+}
+
 EditorTaskStatus EditorTaskAnchor::getStatus() const
 {
 	return status;
@@ -190,11 +208,52 @@ void EditorTaskAnchor::cancel()
 	}
 }
 
+bool EditorTaskAnchor::isCancelled() const
+{
+	return task->cancelled;
+}
+
+bool EditorTaskAnchor::isParentCancelled() const
+{
+	return parent && parent->cancelled;
+}
+
 void EditorTaskAnchor::setId(int value)
 {
 	id = value;
 }
 
+void EditorTaskAnchor::setOrder(int value)
+{
+	order = value;
+}
+
+const String& EditorTaskAnchor::getExclusiveKey() const
+{
+	return task->exclusiveKey;
+}
+
+bool EditorTaskAnchor::tryMerge(EditorTaskAnchor& other)
+{
+	// Only work that hasn't started can be taken on, and only by a task that hasn't started either
+	if (status != EditorTaskStatus::WaitingToStart || other.status != EditorTaskStatus::WaitingToStart) {
+		return false;
+	}
+	if (task->exclusiveKey.isEmpty() || task->exclusiveKey != other.task->exclusiveKey) {
+		return false;
+	}
+	if (!task->mergeWith(*other.task)) {
+		return false;
+	}
+
+	// Its continuations would have run after it, so they run after this instead
+	std::lock_guard<std::mutex> lock(task->mutex);
+	for (auto& c: other.getContinuations()) {
+		task->continuations.emplace_back(std::move(c));
+	}
+	return true;
+}
+
 bool EditorTaskAnchor::hasError() const
 {
 	return error;
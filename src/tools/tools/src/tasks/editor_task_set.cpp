@@ -1,4 +1,5 @@
 #include "halley/tools/tasks/editor_task_set.h"
+#include "halley/support/profiler.h"
 #include <thread>
 #include <chrono>
 #include <iostream>
@@ -7,7 +8,17 @@ using namespace Halley;
 using namespace std::chrono_literals;
 
 EditorTaskSet::EditorTaskSet() 
-{}
+{
+	// Most tasks spend their time waiting on work they've farmed out to the CPU queues, so there's no point in matching the core count
+	const size_t nThreads = std::max(size_t(4), size_t(std::thread::hardware_concurrency() / 2));
+	threadPool = std::make_unique<ThreadPool>("Editor Tasks", queue, nThreads, [] (String name, std::function<void()> runnable) -> std::thread
+	{
+		return std::thread([=] () {
+			Profiler::setThreadName(name);
+			runnable();
+		});
+	});
+}
 
 EditorTaskSet::~EditorTaskSet()
 {
@@ -24,28 +35,34 @@ EditorTaskSet::~EditorTaskSet()
 		std::this_thread::sleep_for(25ms);
 		update(0.025f);
 	}
+
+	threadPool.reset();
 }
 
 void EditorTaskSet::update(Time time)
 {
-	Vector<EditorTaskAnchor> toAdd;
+	// Finished tasks go first, so whatever they unblock (including their own continuations) can start right away
+	std::vector<std::pair<EditorTaskAnchor, int>> toAdd;
 
 	auto next = tasks.begin();
 	for (auto iter = tasks.begin(); iter != tasks.end(); iter = next) {
 		++next;
 
 		auto& task = *iter;
+		if (task->isParentCancelled()) {
+			task->cancel();
+		}
 		task->update(static_cast<float>(time));
 
 		auto subTasks = task->getPendingTasks();
 		for (auto& t : subTasks) {
-			toAdd.push_back(std::move(t));
+			toAdd.emplace_back(std::move(t), nextId);
 		}
 
 		if (task->getStatus() == EditorTaskStatus::Done) {
 			auto newTasks = task->getContinuations();
 			for (auto& t : newTasks) {
-				toAdd.push_back(std::move(t));
+				toAdd.emplace_back(std::move(t), task->getOrder());
 			}
 			task->terminate();
 			if (listener) {
@@ -59,19 +76,66 @@ void EditorTaskSet::update(Time time)
 	}
 
 	for (auto& t: toAdd) {
-		addTask(std::move(t));
+		addTask(std::move(t.first), t.second);
+	}
+
+	for (auto& t: tasks) {
+		if (t->isReadyToStart() && canStart(*t)) {
+			t->start(queue);
+		}
 	}
 }
 
 void EditorTaskSet::addTask(EditorTaskAnchor&& task)
+{
+	addTask(std::move(task), nextId);
+}
+
+void EditorTaskSet::addTask(EditorTaskAnchor&& task, int order)
 {
 	task.setId(nextId++);
+	task.setOrder(order);
+
+	// If the last task in line for this key hasn't started yet, it might as well do this one's work too
+	const auto& key = task.getExclusiveKey();
+	if (!key.isEmpty()) {
+		std::shared_ptr<EditorTaskAnchor> last;
+		for (auto& t: tasks) {
+			if (t->getExclusiveKey() == key && (!last || t->getOrder() > last->getOrder() || (t->getOrder() == last->getOrder() && t->getId() > last->getId()))) {
+				last = t;
+			}
+		}
+		if (last && last->getOrder() <= order && last->tryMerge(task)) {
+			task.terminate();
+			return;
+		}
+	}
+
 	tasks.emplace_back(std::make_shared<EditorTaskAnchor>(std::move(task)));
 	if (listener) {
 		listener->onTaskAdded(tasks.back());
 	}
 }
 
+bool EditorTaskSet::canStart(const EditorTaskAnchor& task) const
+{
+	const auto& key = task.getExclusiveKey();
+	if (key.isEmpty()) {
+		return true;
+	}
+
+	// Anything with the same key that's ahead in line, or already running, goes first
+	for (auto& t: tasks) {
+		if (t.get() != &task && t->getExclusiveKey() == key) {
+			const bool ahead = t->getOrder() < task.getOrder() || (t->getOrder() == task.getOrder() && t->getId() < task.getId());
+			if (ahead || t->getStatus() == EditorTaskStatus::Started) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
 void EditorTaskSet::setListener(EditorTaskSetListener& l)
 {
 	listener = &l;
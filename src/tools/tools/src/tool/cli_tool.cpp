@@ -9,6 +9,8 @@
 #include "halley/core/game/halley_statics.h"
 #include "halley/tools/vs_project/vs_project_tool.h"
 #include "halley/tools/packer/asset_pack_inspector.h"
+#include "halley/tools/packer/asset_pack_benchmark.h"
+#include "halley/tools/benchmark/benchmark_compare_tool.h"
 
 using namespace Halley;
 
@@ -20,6 +22,8 @@ CommandLineTools::CommandLineTools()
 	factories["makeFont"] = []() { return std::make_unique<MakeFontTool>(); };
 	factories["pack"] = []() { return std::make_unique<AssetPackerTool>(); };
 	factories["pack-inspector"] = []() { return std::make_unique<AssetPackInspectorTool>(); };
+	factories["pack-benchmark"] = []() { return std::make_unique<AssetPackBenchmarkTool>(); };
+	factories["benchmark-compare"] = []() { return std::make_unique<BenchmarkCompareTool>(); };
 	factories["vs_project"] = []() { return std::make_unique<VSProjectTool>(); };
 }
 
@@ -56,6 +60,10 @@ int CommandLineTool::runRaw(int argc, char** argv)
 		if (arg.startsWith("--")) {
 			if (arg.startsWith("--platforms=")) {
 				platforms = arg.mid(12).split(',');
+			} else if (arg == "--content-hash") {
+				contentHash = true;
+			} else if (arg.startsWith("--import-cache=")) {
+				importCache = arg.mid(15);
 			}
 		} else {
 			args.push_back(arg.cppStr());
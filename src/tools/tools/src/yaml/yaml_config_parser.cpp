@@ -0,0 +1,674 @@
+#include "yaml_config_parser.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace Halley;
+
+namespace {
+	// Thrown on anything this parser doesn't handle, to leave the whole file to yaml-cpp
+	struct Unsupported {};
+
+	bool isBlank(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	bool isNullScalar(const std::string& str)
+	{
+		return str == "~" || str == "null" || str == "Null" || str == "NULL";
+	}
+
+	void appendUTF8(std::string& out, uint32_t cp)
+	{
+		if (cp < 0x80) {
+			out += char(cp);
+		} else if (cp < 0x800) {
+			out += char(0xC0 | (cp >> 6));
+			out += char(0x80 | (cp & 0x3F));
+		} else if (cp < 0x10000) {
+			out += char(0xE0 | (cp >> 12));
+			out += char(0x80 | ((cp >> 6) & 0x3F));
+			out += char(0x80 | (cp & 0x3F));
+		} else if (cp < 0x110000) {
+			out += char(0xF0 | (cp >> 18));
+			out += char(0x80 | ((cp >> 12) & 0x3F));
+			out += char(0x80 | ((cp >> 6) & 0x3F));
+			out += char(0x80 | (cp & 0x3F));
+		} else {
+			throw Unsupported();
+		}
+	}
+
+	class Parser
+	{
+	public:
+		Parser(const char* text, size_t size)
+			: text(text)
+			, size(size)
+		{
+			splitLines();
+		}
+
+		void parse(ConfigNode& result)
+		{
+			if (lines.empty()) {
+				result = ConfigNode();
+				result.setOriginalPosition(-1, -1); // Like yaml-cpp's null mark
+				return;
+			}
+
+			size_t li = 0;
+			parseBlockNode(li, size_t(indentOf(0)), result);
+			if (li != lines.size()) {
+				throw Unsupported();
+			}
+		}
+
+	private:
+		struct Line
+		{
+			size_t start; // Offset of its first character
+			size_t end; // Offset past its last character, line break excluded
+			int number;
+			int indent; // -1 if it's indented with tabs, which is only fine inside flow collections
+		};
+
+		const char* text;
+		const size_t size;
+		std::vector<Line> lines; // Only the ones with something other than whitespace and comments
+
+		void splitLines()
+		{
+			size_t p = 0;
+			if (size >= 3 && memcmp(text, "\xEF\xBB\xBF", 3) == 0) {
+				p = 3;
+			}
+
+			for (int number = 0; p < size; ++number) {
+				const size_t lineBreak = std::find(text + p, text + size, '\n') - text;
+				size_t end = lineBreak;
+				if (end > p && text[end - 1] == '\r') {
+					--end;
+				}
+
+				size_t c = p;
+				while (c < end && text[c] == ' ') {
+					++c;
+				}
+				if (!isRestBlank(c, end)) {
+					if (c == p && isMarker(p, end)) {
+						// Only the first document is loaded, as with YAML::Load, so anything after its end doesn't matter
+						if (text[p] == '.' && isRestBlank(p + 3, end)) {
+							break;
+						}
+						// Only one document start is fine, before anything else
+						if (text[p] != '-' || !lines.empty() || !isRestBlank(p + 3, end)) {
+							throw Unsupported();
+						}
+					} else {
+						lines.push_back(Line{ p, end, number, text[c] == '\t' ? -1 : int(c - p) });
+					}
+				}
+
+				p = lineBreak + 1;
+			}
+		}
+
+		bool isMarker(size_t p, size_t end) const
+		{
+			if (text[p] == '%') {
+				return true;
+			}
+			const bool dashes = end - p >= 3 && memcmp(text + p, "---", 3) == 0;
+			const bool dots = end - p >= 3 && memcmp(text + p, "...", 3) == 0;
+			return (dashes || dots) && (end - p == 3 || isBlank(text[p + 3]));
+		}
+
+		bool isRestBlank(size_t p, size_t end) const
+		{
+			while (p < end && isBlank(text[p])) {
+				++p;
+			}
+			return p == end || text[p] == '#';
+		}
+
+		int indentOf(size_t li) const
+		{
+			const int indent = lines[li].indent;
+			if (indent < 0) {
+				throw Unsupported();
+			}
+			return indent;
+		}
+
+		char lineChar(size_t li, size_t col) const
+		{
+			const size_t p = lines[li].start + col;
+			return p < lines[li].end ? text[p] : '\0';
+		}
+
+		size_t lineIndexAt(size_t p) const
+		{
+			auto iter = std::upper_bound(lines.begin(), lines.end(), p, [] (size_t pos, const Line& line) { return pos < line.start; });
+			return size_t(iter - lines.begin()) - 1;
+		}
+
+		void mark(ConfigNode& node, size_t p) const
+		{
+			const auto& line = lines[lineIndexAt(p)];
+			node.setOriginalPosition(line.number, int(p - line.start));
+		}
+
+		bool isSeqEntry(size_t li, size_t col) const
+		{
+			if (lineChar(li, col) != '-') {
+				return false;
+			}
+			const char next = lineChar(li, col + 1);
+			if (next == '\t') {
+				throw Unsupported();
+			}
+			return next == '\0' || next == ' ';
+		}
+
+		// Where the ':' of a block mapping key starting here is, if it is one
+		bool findKeyColon(size_t li, size_t col, size_t& colon) const
+		{
+			const auto& line = lines[li];
+			const size_t p = line.start + col;
+			const char ch = text[p];
+
+			size_t q = p;
+			if (ch == '"' || ch == '\'') {
+				std::string dummy;
+				if (!tryParseQuoted(q, line.end, dummy)) {
+					return false;
+				}
+				while (q < line.end && isBlank(text[q])) {
+					++q;
+				}
+				if (q == line.end || text[q] != ':') {
+					return false;
+				}
+			} else if (ch == '[' || ch == '{') {
+				return false;
+			} else if (ch == '?' && (p + 1 == line.end || isBlank(text[p + 1]))) {
+				throw Unsupported();
+			} else {
+				for (; q < line.end; ++q) {
+					if (text[q] == ':') {
+						if (q + 1 == line.end || isBlank(text[q + 1])) {
+							break;
+						}
+					} else if (text[q] == '#' && q > p && isBlank(text[q - 1])) {
+						return false;
+					}
+				}
+				if (q == line.end) {
+					return false;
+				}
+			}
+
+			if (q + 1 < line.end && !isBlank(text[q + 1])) {
+				return false;
+			}
+			colon = q;
+			return true;
+		}
+
+		bool isKey(size_t li, size_t col) const
+		{
+			size_t colon;
+			return findKeyColon(li, col, colon);
+		}
+
+		void parseBlockNode(size_t& li, size_t col, ConfigNode& out)
+		{
+			if (isSeqEntry(li, col)) {
+				parseBlockSeq(li, col, out);
+			} else if (isKey(li, col)) {
+				parseBlockMap(li, col, out);
+			} else {
+				parseInlineValue(li, col, out);
+			}
+		}
+
+		void parseBlockMap(size_t& li, size_t col, ConfigNode& out)
+		{
+			const int indent = int(col);
+			const size_t startPos = lines[li].start + col;
+			ConfigNode::MapType map;
+
+			while (true) {
+				String key;
+				const size_t afterColon = parseKey(li, col, key);
+
+				ConfigNode value;
+				parseValue(li, afterColon, indent, true, value);
+				map[std::move(key)] = std::move(value);
+
+				if (li >= lines.size()) {
+					break;
+				}
+				const int nextIndent = indentOf(li);
+				if (nextIndent < indent) {
+					break;
+				}
+				if (nextIndent > indent || isSeqEntry(li, size_t(nextIndent)) || !isKey(li, size_t(nextIndent))) {
+					throw Unsupported();
+				}
+				col = size_t(nextIndent);
+			}
+
+			out = std::move(map);
+			mark(out, startPos);
+		}
+
+		void parseBlockSeq(size_t& li, size_t col, ConfigNode& out)
+		{
+			const int indent = int(col);
+			const size_t startPos = lines[li].start + col;
+			ConfigNode::SequenceType seq;
+
+			while (true) {
+				ConfigNode item;
+				parseValue(li, col + 1, indent, false, item);
+				seq.push_back(std::move(item));
+
+				if (li >= lines.size()) {
+					break;
+				}
+				const int nextIndent = indentOf(li);
+				if (nextIndent < indent) {
+					break;
+				}
+				if (nextIndent > indent) {
+					throw Unsupported();
+				}
+				if (!isSeqEntry(li, size_t(nextIndent))) {
+					// Back to the mapping this is the value of, which makes sure that it is one
+					break;
+				}
+				col = size_t(nextIndent);
+			}
+
+			out = std::move(seq);
+			mark(out, startPos);
+		}
+
+		// The value after a "key:" or "-" ending at col, which can also start on the next lines
+		void parseValue(size_t& li, size_t col, int parentIndent, bool isMapValue, ConfigNode& out)
+		{
+			const auto& line = lines[li];
+			size_t p = line.start + col;
+			while (p < line.end && isBlank(text[p])) {
+				++p;
+			}
+
+			if (p == line.end || text[p] == '#') {
+				const size_t next = li + 1;
+				if (next < lines.size()) {
+					const int nextIndent = indentOf(next);
+					if (nextIndent > parentIndent) {
+						li = next;
+						parseBlockNode(li, size_t(nextIndent), out);
+						return;
+					}
+					if (isMapValue && nextIndent == parentIndent && isSeqEntry(next, size_t(nextIndent))) {
+						li = next;
+						parseBlockSeq(li, size_t(nextIndent), out);
+						return;
+					}
+				}
+				out = ConfigNode();
+				mark(out, p);
+				li = next;
+				return;
+			}
+
+			const size_t valueCol = p - line.start;
+			if (isSeqEntry(li, valueCol) || isKey(li, valueCol)) {
+				// A compact collection, which is fine as a sequence entry ("- a: b", "- - a"), but not as a mapping value
+				if (isMapValue) {
+					throw Unsupported();
+				}
+				parseBlockNode(li, valueCol, out);
+			} else {
+				parseInlineValue(li, valueCol, out);
+			}
+		}
+
+		// A scalar or flow collection, which must be the last thing on its line
+		void parseInlineValue(size_t& li, size_t col, ConfigNode& out)
+		{
+			const size_t lineEnd = lines[li].end;
+			size_t p = lines[li].start + col;
+			const size_t startPos = p;
+			const char ch = text[p];
+
+			if (ch == '[' || ch == '{') {
+				parseFlowNode(p, out);
+			} else if (ch == '"' || ch == '\'') {
+				std::string str;
+				if (!tryParseQuoted(p, lineEnd, str)) {
+					throw Unsupported();
+				}
+				out = YAMLConfigParser::makeScalar(String(std::move(str)));
+				mark(out, startPos);
+			} else {
+				checkPlainStart(p, lineEnd);
+				size_t end = p;
+				while (end < lineEnd && !(text[end] == '#' && isBlank(text[end - 1]))) {
+					++end;
+				}
+				p = end;
+				while (end > startPos && isBlank(text[end - 1])) {
+					--end;
+				}
+				makePlainScalar(startPos, end, out);
+			}
+
+			li = lineIndexAt(p);
+			if (!isRestBlank(p, lines[li].end)) {
+				throw Unsupported();
+			}
+			++li;
+		}
+
+		// Returns the column past the ':'
+		size_t parseKey(size_t li, size_t col, String& key) const
+		{
+			size_t colon;
+			if (!findKeyColon(li, col, colon)) {
+				throw Unsupported();
+			}
+
+			const auto& line = lines[li];
+			size_t p = line.start + col;
+			if (text[p] == '"' || text[p] == '\'') {
+				std::string str;
+				tryParseQuoted(p, line.end, str);
+				key = String(std::move(str));
+			} else {
+				checkPlainStart(p, line.end);
+				size_t end = colon;
+				while (end > p && isBlank(text[end - 1])) {
+					--end;
+				}
+				std::string str(text + p, end - p);
+				if (str.empty() || isNullScalar(str)) {
+					throw Unsupported();
+				}
+				key = String(std::move(str));
+			}
+			return colon + 1 - line.start;
+		}
+
+		void checkPlainStart(size_t p, size_t end) const
+		{
+			const char ch = text[p];
+			if (strchr("&*!|>%@`,[]{}#", ch)) {
+				throw Unsupported();
+			}
+			if ((ch == '-' || ch == '?' || ch == ':') && (p + 1 == end || isBlank(text[p + 1]))) {
+				throw Unsupported();
+			}
+		}
+
+		void makePlainScalar(size_t start, size_t end, ConfigNode& out) const
+		{
+			std::string str(text + start, end - start);
+			if (str.empty()) {
+				throw Unsupported();
+			}
+			if (isNullScalar(str)) {
+				out = ConfigNode();
+			} else {
+				out = YAMLConfigParser::makeScalar(String(std::move(str)));
+			}
+			mark(out, start);
+		}
+
+		// Leaves p past the closing quote; fails if the string doesn't end before end, or spans lines
+		bool tryParseQuoted(size_t& p, size_t end, std::string& out) const
+		{
+			const char quote = text[p++];
+			while (true) {
+				if (p >= end || text[p] == '\n' || text[p] == '\r') {
+					return false;
+				}
+				const char c = text[p++];
+				if (c == quote) {
+					if (quote == '\'' && p < end && text[p] == '\'') {
+						out += '\'';
+						++p;
+						continue;
+					}
+					return true;
+				}
+				if (c == '\\' && quote == '"') {
+					if (p >= end) {
+						return false;
+					}
+					const char e = text[p++];
+					switch (e) {
+					case 'n': out += '\n'; break;
+					case 't': case '\t': out += '\t'; break;
+					case 'r': out += '\r'; break;
+					case '0': out += '\0'; break;
+					case 'a': out += '\a'; break;
+					case 'b': out += '\b'; break;
+					case 'e': out += '\x1b'; break;
+					case 'f': out += '\f'; break;
+					case 'v': out += '\v'; break;
+					case ' ': case '"': case '/': case '\\': out += e; break;
+					case 'x': appendUTF8(out, parseHex(p, end, 2)); break;
+					case 'u': appendUTF8(out, parseHex(p, end, 4)); break;
+					case 'U': appendUTF8(out, parseHex(p, end, 8)); break;
+					default: throw Unsupported();
+					}
+				} else {
+					out += c;
+				}
+			}
+		}
+
+		uint32_t parseHex(size_t& p, size_t end, int digits) const
+		{
+			uint32_t value = 0;
+			for (int i = 0; i < digits; ++i, ++p) {
+				if (p >= end) {
+					throw Unsupported();
+				}
+				const char c = text[p];
+				value <<= 4;
+				if (c >= '0' && c <= '9') {
+					value |= uint32_t(c - '0');
+				} else if (c >= 'a' && c <= 'f') {
+					value |= uint32_t(c - 'a' + 10);
+				} else if (c >= 'A' && c <= 'F') {
+					value |= uint32_t(c - 'A' + 10);
+				} else {
+					throw Unsupported();
+				}
+			}
+			return value;
+		}
+
+		void skipFlowSpace(size_t& p) const
+		{
+			while (p < size) {
+				const char c = text[p];
+				if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+					++p;
+				} else if (c == '#' && p > 0 && isspace(static_cast<unsigned char>(text[p - 1]))) {
+					while (p < size && text[p] != '\n') {
+						++p;
+					}
+				} else {
+					break;
+				}
+			}
+		}
+
+		char flowChar(size_t p) const
+		{
+			return p < size ? text[p] : '\0';
+		}
+
+		void parseFlowNode(size_t& p, ConfigNode& out)
+		{
+			const size_t startPos = p;
+			const char ch = flowChar(p);
+
+			if (ch == '[') {
+				ConfigNode::SequenceType seq;
+				++p;
+				skipFlowSpace(p);
+				while (flowChar(p) != ']') {
+					ConfigNode item;
+					parseFlowNode(p, item);
+					seq.push_back(std::move(item));
+					skipFlowSpace(p);
+					if (!expectFlowSeparator(p, ']')) {
+						break;
+					}
+				}
+				++p;
+				out = std::move(seq);
+				mark(out, startPos);
+			} else if (ch == '{') {
+				ConfigNode::MapType map;
+				++p;
+				skipFlowSpace(p);
+				while (flowChar(p) != '}') {
+					String key;
+					parseFlowKey(p, key);
+					skipFlowSpace(p);
+
+					ConfigNode value;
+					if (flowChar(p) == ':') {
+						++p;
+						skipFlowSpace(p);
+						if (flowChar(p) == ',' || flowChar(p) == '}') {
+							mark(value, p);
+						} else {
+							parseFlowNode(p, value);
+							skipFlowSpace(p);
+						}
+					} else {
+						mark(value, p);
+					}
+					map[std::move(key)] = std::move(value);
+
+					if (!expectFlowSeparator(p, '}')) {
+						break;
+					}
+				}
+				++p;
+				out = std::move(map);
+				mark(out, startPos);
+			} else if (ch == '"' || ch == '\'') {
+				std::string str;
+				if (!tryParseQuoted(p, size, str)) {
+					throw Unsupported();
+				}
+				out = YAMLConfigParser::makeScalar(String(std::move(str)));
+				mark(out, startPos);
+			} else {
+				const size_t end = scanFlowPlain(p);
+				makePlainScalar(startPos, end, out);
+			}
+		}
+
+		// After an entry: true if another one might follow, false if the collection is done (leaving p on its closing bracket)
+		bool expectFlowSeparator(size_t& p, char close) const
+		{
+			const char c = flowChar(p);
+			if (c == close) {
+				return false;
+			}
+			if (c != ',') {
+				throw Unsupported();
+			}
+			++p;
+			skipFlowSpace(p);
+			return flowChar(p) != close;
+		}
+
+		void parseFlowKey(size_t& p, String& key) const
+		{
+			const char ch = flowChar(p);
+			if (ch == '"' || ch == '\'') {
+				std::string str;
+				if (!tryParseQuoted(p, size, str)) {
+					throw Unsupported();
+				}
+				key = String(std::move(str));
+			} else {
+				const size_t start = p;
+				const size_t end = scanFlowPlain(p);
+				std::string str(text + start, end - start);
+				if (str.empty() || isNullScalar(str)) {
+					throw Unsupported();
+				}
+				key = String(std::move(str));
+			}
+		}
+
+		// Leaves p past the scalar and returns where its text ends, trailing whitespace excluded
+		size_t scanFlowPlain(size_t& p) const
+		{
+			const size_t start = p;
+			checkPlainStart(p, size);
+			while (p < size) {
+				const char c = text[p];
+				if (c == '\n' || c == '\r' || strchr(",[]{}", c)) {
+					break;
+				}
+				if (c == ':') {
+					const char next = flowChar(p + 1);
+					if (next == '\0' || isspace(static_cast<unsigned char>(next)) || strchr(",[]{}", next)) {
+						break;
+					}
+					// Whether "a:b" is one scalar or a pair depends on the YAML version, so leave it to yaml-cpp
+					throw Unsupported();
+				}
+				if (c == '#' && isBlank(text[p - 1])) {
+					break;
+				}
+				++p;
+			}
+
+			size_t end = p;
+			while (end > start && isBlank(text[end - 1])) {
+				--end;
+			}
+			return end;
+		}
+	};
+}
+
+bool YAMLConfigParser::tryParse(gsl::span<const gsl::byte> data, ConfigNode& result)
+{
+	try {
+		Parser parser(reinterpret_cast<const char*>(data.data()), size_t(data.size()));
+		parser.parse(result);
+		return true;
+	} catch (Unsupported&) {
+		return false;
+	}
+}
+
+ConfigNode YAMLConfigParser::makeScalar(String str)
+{
+	if (str.isNumber()) {
+		if (str.isInteger()) {
+			return ConfigNode(str.toInteger());
+		} else {
+			return ConfigNode(str.toFloat());
+		}
+	}
+	return ConfigNode(std::move(str));
+}
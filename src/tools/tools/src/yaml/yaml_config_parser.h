@@ -0,0 +1,20 @@
+#pragma once
+
+#include <gsl/gsl>
+#include "halley/file_formats/config_file.h"
+
+namespace Halley
+{
+	// Parses YAML (and so JSON) straight into a ConfigNode, without yaml-cpp building a document of its own first.
+	// It only knows the parts of YAML that data files actually use: block and flow collections, plain and quoted scalars and comments.
+	// Anything else (anchors, tags, block scalars, scalars spanning several lines, multiple documents...) makes it give up, so the caller
+	// can fall back to yaml-cpp, which is also the one to report any errors.
+	class YAMLConfigParser
+	{
+	public:
+		static bool tryParse(gsl::span<const gsl::byte> data, ConfigNode& result);
+
+		// How scalars become config values, whichever parser read them
+		static ConfigNode makeScalar(String str);
+	};
+}